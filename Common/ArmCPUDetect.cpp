@@ -236,6 +236,14 @@ void CPUInfo::Detect()
 	bIDIVt = isVFP4;
 	bFP = false;
 	bASIMD = false;
+#if defined(__ARM_FEATURE_CRYPTO)
+	// If we were built for them, they're there.
+	bAES = true;
+	bSHA = true;
+#endif
+#if defined(__ARM_FEATURE_CRC32)
+	bCRC32 = true;
+#endif
 #else // PPSSPP_PLATFORM(LINUX)
 	truncate_cpy(cpu_string, GetCPUString().c_str());
 	truncate_cpy(brand_string, GetCPUBrandString().c_str());
@@ -260,6 +268,9 @@ void CPUInfo::Detect()
 	// These two require ARMv8 or higher
 	bFP = CheckCPUFeature("fp");
 	bASIMD = CheckCPUFeature("asimd");
+	bAES = CheckCPUFeature("aes");
+	bSHA = CheckCPUFeature("sha1") && CheckCPUFeature("sha2");
+	bCRC32 = CheckCPUFeature("crc32");
 	num_cores = GetCoreCount();
 #endif
 #if PPSSPP_ARCH(ARM64)
@@ -290,6 +301,9 @@ std::string CPUInfo::Summarize()
 	if (bNEON) sum += ", NEON";
 	if (bIDIVa) sum += ", IDIVa";
 	if (bIDIVt) sum += ", IDIVt";
+	if (bAES) sum += ", AES";
+	if (bSHA) sum += ", SHA";
+	if (bCRC32) sum += ", CRC32";
 	if (CPU64bit) sum += ", 64-bit";
 
 	return sum;
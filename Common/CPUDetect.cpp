@@ -173,6 +173,7 @@ void CPUInfo::Detect() {
 				bFMA = true;
 		}
 		if ((cpu_id[2] >> 25) & 1) bAES = true;
+		if ((cpu_id[2] >> 1)  & 1) bPCLMUL = true;
 
 		if ((cpu_id[3] >> 24) & 1)
 		{
@@ -185,9 +186,13 @@ void CPUInfo::Detect() {
 		//  - Is the XSAVE bit set in CPUID? ( >>26)
 		//  - Is the OSXSAVE bit set in CPUID? ( >>27)
 		//  - XGETBV result has the XCR bit set.
+		bool osSavesAVX512 = false;
 		if (((cpu_id[2] >> 28) & 1) && ((cpu_id[2] >> 27) & 1) && ((cpu_id[2] >> 26) & 1))
 		{
-			if ((_xgetbv(_XCR_XFEATURE_ENABLED_MASK) & 0x6) == 0x6)
+			unsigned long long xcr0 = _xgetbv(_XCR_XFEATURE_ENABLED_MASK);
+			// The opmask and both halves of the upper ZMM registers have to be saved too.
+			osSavesAVX512 = (xcr0 & 0xE6) == 0xE6;
+			if ((xcr0 & 0x6) == 0x6)
 			{
 				bAVX = true;
 				if ((cpu_id[2] >> 12) & 1)
@@ -205,6 +210,12 @@ void CPUInfo::Detect() {
 				bBMI1 = true;
 			if ((cpu_id[1] >> 8) & 1)
 				bBMI2 = true;
+			if (((cpu_id[1] >> 16) & 1) && osSavesAVX512)
+				bAVX512F = bAVX2;
+			if (((cpu_id[1] >> 30) & 1) && bAVX512F)
+				bAVX512BW = true;
+			if ((cpu_id[1] >> 29) & 1)
+				bSHA = true;
 		}
 	}
 	if (max_ex_fn >= 0x80000004) {
@@ -281,8 +292,12 @@ std::string CPUInfo::Summarize()
 	if (bSSE4_2) sum += ", SSE4.2";
 	if (HTT) sum += ", HTT";
 	if (bAVX) sum += ", AVX";
+	if (bAVX2) sum += ", AVX2";
+	if (bAVX512F) sum += ", AVX-512";
 	if (bFMA) sum += ", FMA";
 	if (bAES) sum += ", AES";
+	if (bSHA) sum += ", SHA";
+	if (bPCLMUL) sum += ", PCLMUL";
 	if (bLongMode) sum += ", 64-bit support";
 	return sum;
 }
@@ -52,8 +52,15 @@ struct CPUInfo {
 	bool bSSE4A;
 	bool bAVX;
 	bool bAVX2;
+	bool bAVX512F;
+	bool bAVX512BW;
 	bool bFMA;
 	bool bAES;
+	// SHA-1 and SHA-256 instructions (SHA extensions on x86, sha1+sha2 on ARMv8.)
+	bool bSHA;
+	// Carry-less multiply on x86 (PCLMULQDQ), CRC32 instructions on ARMv8.
+	bool bPCLMUL;
+	bool bCRC32;
 	bool bLAHFSAHF64;
 	bool bLongMode;
 	bool bAtom;
@@ -15,12 +15,20 @@
 // Official SVN repository and contact information can be found at
 // http://code.google.com/p/dolphin-emu/
 
+#include <algorithm>
+#include <atomic>
 #include <cstdlib>
 #include <cstring>
 #include <snappy-c.h>
 
 #include "ChunkFile.h"
 #include "StringUtils.h"
+#include "ThreadPools.h"
+
+// GlobalThreadPool::Loop is overloaded, so it can't be passed as a ParallelLoop directly.
+static void GlobalLoop(const std::function<void(int, int)> &loop, int lower, int upper) {
+	GlobalThreadPool::Loop(loop, lower, upper);
+}
 
 PointerWrapSection PointerWrap::Section(const char *title, int ver) {
 	return Section(title, ver, ver);
@@ -62,7 +70,15 @@ void PointerWrap::SetError(Error error_) {
 	}
 }
 
+void PointerWrap::Prepare(size_t size) {
+	if (source_ && mode == MODE_READ && !source_->Prepare(*ptr - source_->Base(), size)) {
+		ERROR_LOG(SAVESTATE, "Savestate failure: unable to read %d bytes at %d", (int)size, (int)(*ptr - source_->Base()));
+		SetError(ERROR_FAILURE);
+	}
+}
+
 bool PointerWrap::ExpectVoid(void *data, int size) {
+	Prepare(size);
 	switch (mode) {
 	case MODE_READ:	if (memcmp(data, *ptr, size) != 0) return false; break;
 	case MODE_WRITE: memcpy(*ptr, data, size); break;
@@ -77,7 +93,41 @@ bool PointerWrap::ExpectVoid(void *data, int size) {
 	return true;
 }
 
+void PointerWrap::SetGather(std::vector<Segment> *segments) {
+	segments_ = segments;
+	flatStart_ = *ptr;
+}
+
+void PointerWrap::FinishGather() {
+	if (segments_ && mode == MODE_WRITE && *ptr != flatStart_) {
+		segments_->push_back({ flatStart_, (size_t)(*ptr - flatStart_) });
+	}
+	flatStart_ = *ptr;
+	segments_ = nullptr;
+}
+
 void PointerWrap::DoVoid(void *data, int size) {
+	if (segments_ && size >= GATHER_MIN_SIZE && (mode == MODE_WRITE || mode == MODE_MEASURE)) {
+		// Keep a reference instead, and don't take up any space at ptr.
+		if (mode == MODE_WRITE) {
+			if (*ptr != flatStart_)
+				segments_->push_back({ flatStart_, (size_t)(*ptr - flatStart_) });
+			segments_->push_back({ (const u8 *)data, (size_t)size });
+			flatStart_ = *ptr;
+		}
+		return;
+	}
+	if (source_ && mode == MODE_READ && size >= GATHER_MIN_SIZE) {
+		// Let the source decode straight into place.
+		if (!source_->Read(*ptr - source_->Base(), (u8 *)data, size)) {
+			ERROR_LOG(SAVESTATE, "Savestate failure: unable to read %d bytes at %d", size, (int)(*ptr - source_->Base()));
+			SetError(ERROR_FAILURE);
+		}
+		(*ptr) += size;
+		return;
+	}
+
+	Prepare(size);
 	switch (mode) {
 	case MODE_READ:	memcpy(data, *ptr, size); break;
 	case MODE_WRITE: memcpy(*ptr, data, size); break;
@@ -94,6 +144,8 @@ void PointerWrap::DoVoid(void *data, int size) {
 void PointerWrap::Do(std::string &x) {
 	int stringLen = (int)x.length() + 1;
 	Do(stringLen);
+	// When reading, this is the saved length.
+	Prepare(stringLen);
 
 	switch (mode) {
 	case MODE_READ:		x = (char*)*ptr; break;
@@ -107,6 +159,8 @@ void PointerWrap::Do(std::string &x) {
 void PointerWrap::Do(std::wstring &x) {
 	int stringLen = sizeof(wchar_t)*((int)x.length() + 1);
 	Do(stringLen);
+	// When reading, this is the saved length.
+	Prepare(stringLen);
 
 	switch (mode) {
 	case MODE_READ:		x = (wchar_t*)*ptr; break;
@@ -250,7 +304,18 @@ CChunkFileReader::Error CChunkFileReader::LoadFile(const std::string &filename,
 	}
 
 	_buffer = buffer;
-	if (header.Compress) {
+	if (header.Compress == COMPRESS_SNAPPY_CHUNKS) {
+		u8 *uncomp_buffer = new u8[header.UncompressedSize];
+		if (!DecompressChunks(buffer, sz, uncomp_buffer, header.UncompressedSize, &GlobalLoop)) {
+			ERROR_LOG(SAVESTATE, "ChunkReader: Bad compressed chunks");
+			delete [] uncomp_buffer;
+			delete [] buffer;
+			return ERROR_BAD_FILE;
+		}
+		_buffer = uncomp_buffer;
+		sz = header.UncompressedSize;
+		delete [] buffer;
+	} else if (header.Compress) {
 		u8 *uncomp_buffer = new u8[header.UncompressedSize];
 		size_t uncomp_size = header.UncompressedSize;
 		snappy_uncompress((const char *)buffer, sz, (char *)uncomp_buffer, &uncomp_size);
@@ -267,37 +332,330 @@ CChunkFileReader::Error CChunkFileReader::LoadFile(const std::string &filename,
 	return ERROR_NONE;
 }
 
-// Takes ownership of buffer.
-CChunkFileReader::Error CChunkFileReader::SaveFile(const std::string &filename, const std::string &title, const char *gitVersion, u8 *buffer, size_t sz) {
+namespace {
+
+
+// Finds size bytes at offset into the segments, only copying if they span more than one.
+const u8 *GatherRange(const std::vector<PointerWrap::Segment> &segments, size_t offset, size_t size, std::vector<u8> &temp) {
+	size_t pos = 0;
+	size_t i = 0;
+	while (i < segments.size() && pos + segments[i].size <= offset) {
+		pos += segments[i].size;
+		++i;
+	}
+	if (i < segments.size() && offset + size <= pos + segments[i].size)
+		return segments[i].data + (offset - pos);
+
+	temp.resize(size);
+	size_t done = 0;
+	for (; done < size && i < segments.size(); ++i) {
+		size_t segOffset = offset + done - pos;
+		size_t n = std::min(size - done, segments[i].size - segOffset);
+		memcpy(&temp[done], segments[i].data + segOffset, n);
+		done += n;
+		pos += segments[i].size;
+	}
+	return temp.data();
+}
+
+size_t SegmentsSize(const std::vector<PointerWrap::Segment> &segments) {
+	size_t sz = 0;
+	for (auto &seg : segments)
+		sz += seg.size;
+	return sz;
+}
+
+}
+
+// Uncompressed data, either in place in a mapped file or an old state decompressed all at once.
+class CChunkFileReader::BufferSource : public PointerWrap::Source {
+public:
+	BufferSource(File::MappedFile *file, u8 *data, size_t size, u8 *owned) : file_(file), data_(data), size_(size), owned_(owned) {
+	}
+	~BufferSource() {
+		delete file_;
+		delete [] owned_;
+	}
+
+	u8 *Base() override {
+		return data_;
+	}
+	size_t Size() const override {
+		return size_;
+	}
+	bool Prepare(size_t pos, size_t size) override {
+		return pos <= size_ && size <= size_ - pos;
+	}
+	bool Read(size_t pos, u8 *data, size_t size) override {
+		if (!Prepare(pos, size))
+			return false;
+		memcpy(data, data_ + pos, size);
+		return true;
+	}
+
+private:
+	File::MappedFile *file_;
+	u8 *data_;
+	size_t size_;
+	u8 *owned_;
+};
+
+// Decodes chunks only as they're used.  Large blocks get their whole chunks decoded directly
+// into them, so those parts of the buffer are never touched.
+class CChunkFileReader::ChunkedSource : public PointerWrap::Source {
+public:
+	ChunkedSource(File::MappedFile *file, const u8 *src, size_t srcSize, size_t size) : file_(file), src_(src), srcSize_(srcSize), size_(size) {
+	}
+	~ChunkedSource() {
+		delete file_;
+		delete [] buffer_;
+	}
+
+	bool Init() {
+		if (!ParseChunkTable(src_, srcSize_, size_, table_, offsets_))
+			return false;
+		// Deliberately not cleared, so the pages aren't used until written.
+		buffer_ = new u8[size_ == 0 ? 1 : size_];
+		ready_.resize(table_.count);
+		return true;
+	}
+
+	u8 *Base() override {
+		return buffer_;
+	}
+	size_t Size() const override {
+		return size_;
+	}
+
+	bool Prepare(size_t pos, size_t size) override {
+		if (pos > size_ || size > size_ - pos)
+			return false;
+		if (size == 0)
+			return true;
+		for (u32 c = (u32)(pos / table_.chunkSize); c <= (pos + size - 1) / table_.chunkSize; ++c) {
+			if (!ready_[c]) {
+				if (!DecodeChunk(src_, table_, offsets_, c, buffer_ + (size_t)c * table_.chunkSize, size_))
+					return false;
+				ready_[c] = 1;
+			}
+		}
+		return true;
+	}
+
+	bool Read(size_t pos, u8 *data, size_t size) override {
+		if (pos > size_ || size > size_ - pos)
+			return false;
+
+		// Only chunks completely inside the block can go direct, the last chunk may be short.
+		const size_t end = pos + size;
+		u32 first = (u32)((pos + table_.chunkSize - 1) / table_.chunkSize);
+		u32 last = end == size_ ? table_.count : (u32)(end / table_.chunkSize);
+		if (first >= last) {
+			if (!Prepare(pos, size))
+				return false;
+			memcpy(data, buffer_ + pos, size);
+			return true;
+		}
+
+		size_t directStart = (size_t)first * table_.chunkSize;
+		size_t directEnd = std::min((size_t)last * table_.chunkSize, size_);
+		if (directStart > pos) {
+			if (!Prepare(pos, directStart - pos))
+				return false;
+			memcpy(data, buffer_ + pos, directStart - pos);
+		}
+		if (end > directEnd) {
+			if (!Prepare(directEnd, end - directEnd))
+				return false;
+			memcpy(data + (directEnd - pos), buffer_ + directEnd, end - directEnd);
+		}
+
+		std::atomic<bool> failed(false);
+		GlobalThreadPool::Loop([&](int lower, int upper) {
+			for (int c = lower; c < upper; ++c) {
+				size_t offset = (size_t)c * table_.chunkSize;
+				u8 *dest = data + (offset - pos);
+				if (ready_[c]) {
+					memcpy(dest, buffer_ + offset, std::min((size_t)table_.chunkSize, size_ - offset));
+				} else if (!DecodeChunk(src_, table_, offsets_, c, dest, size_)) {
+					failed = true;
+				}
+			}
+		}, first, last);
+		return !failed;
+	}
+
+private:
+	File::MappedFile *file_;
+	const u8 *src_;
+	size_t srcSize_;
+	size_t size_;
+	u8 *buffer_ = nullptr;
+	ChunkTable table_;
+	std::vector<size_t> offsets_;
+	std::vector<u8> ready_;
+};
+
+CChunkFileReader::Error CChunkFileReader::OpenFile(const std::string &filename, const char *gitVersion, PointerWrap::Source *&source, std::string *failureReason) {
+	if (!File::Exists(filename)) {
+		*failureReason = "LoadStateDoesntExist";
+		ERROR_LOG(SAVESTATE, "ChunkReader: File doesn't exist");
+		return ERROR_BAD_FILE;
+	}
+
+	SChunkHeader header;
+	size_t dataOffset;
+	{
+		File::IOFile pFile(filename, "rb");
+		Error err = LoadFileHeader(pFile, header, nullptr);
+		if (err != ERROR_NONE) {
+			return err;
+		}
+		dataOffset = (size_t)pFile.Tell();
+	}
+
+	if (header.Compress != COMPRESS_NONE && header.Compress != COMPRESS_SNAPPY_CHUNKS) {
+		// Older states are one snappy stream, so have to be decompressed all at once.
+		u8 *buffer = nullptr;
+		size_t sz;
+		Error err = LoadFile(filename, gitVersion, buffer, sz, failureReason);
+		if (err == ERROR_NONE)
+			source = new BufferSource(nullptr, buffer, sz, buffer);
+		return err;
+	}
+
+	File::MappedFile *file = new File::MappedFile();
+	if (!file->Open(filename) || file->Size() < dataOffset + header.ExpectedSize) {
+		ERROR_LOG(SAVESTATE, "ChunkReader: Error reading file");
+		delete file;
+		return ERROR_BAD_FILE;
+	}
+
+	u8 *data = file->Data() + dataOffset;
+	if (header.Compress == COMPRESS_NONE) {
+		source = new BufferSource(file, data, header.ExpectedSize, nullptr);
+		return ERROR_NONE;
+	}
+
+	ChunkedSource *chunked = new ChunkedSource(file, data, header.ExpectedSize, header.UncompressedSize);
+	if (!chunked->Init()) {
+		ERROR_LOG(SAVESTATE, "ChunkReader: Bad compressed chunks");
+		delete chunked;
+		return ERROR_BAD_FILE;
+	}
+	source = chunked;
+	return ERROR_NONE;
+}
+
+void CChunkFileReader::CompressChunkRange(const std::vector<PointerWrap::Segment> &segments, size_t totalSize, int first, int last, std::vector<std::vector<u8>> &out, const ParallelLoop &loop) {
+	out.resize(last - first);
+	loop([&](int lower, int upper) {
+		std::vector<u8> temp;
+		for (int i = lower; i < upper; ++i) {
+			size_t offset = (size_t)i * CHUNK_SIZE;
+			size_t size = std::min((size_t)CHUNK_SIZE, totalSize - offset);
+			const u8 *data = GatherRange(segments, offset, size, temp);
+
+			std::vector<u8> &dest = out[i - first];
+			size_t len = snappy_max_compressed_length(size);
+			dest.resize(len);
+			snappy_compress((const char *)data, size, (char *)&dest[0], &len);
+			dest.resize(len);
+		}
+	}, first, last);
+}
+
+void CChunkFileReader::CompressChunks(const std::vector<PointerWrap::Segment> &segments, std::vector<u8> *dest, const ParallelLoop &loop) {
+	size_t sz = SegmentsSize(segments);
+	ChunkTable table;
+	table.chunkSize = CHUNK_SIZE;
+	table.count = (u32)((sz + CHUNK_SIZE - 1) / CHUNK_SIZE);
+
+	std::vector<std::vector<u8>> chunks;
+	CompressChunkRange(segments, sz, 0, table.count, chunks, loop);
+
+	dest->resize(sizeof(table) + table.count * sizeof(u32));
+	memcpy(&(*dest)[0], &table, sizeof(table));
+	for (u32 i = 0; i < table.count; ++i) {
+		u32 len = (u32)chunks[i].size();
+		memcpy(&(*dest)[sizeof(table) + i * sizeof(u32)], &len, sizeof(len));
+		dest->insert(dest->end(), chunks[i].begin(), chunks[i].end());
+	}
+}
+
+bool CChunkFileReader::ParseChunkTable(const u8 *src, size_t srcSize, size_t destSize, ChunkTable &table, std::vector<size_t> &offsets) {
+	if (srcSize < sizeof(table))
+		return false;
+	memcpy(&table, src, sizeof(table));
+	if (table.chunkSize == 0 || table.count != (destSize + table.chunkSize - 1) / table.chunkSize)
+		return false;
+	size_t dataStart = sizeof(table) + (size_t)table.count * sizeof(u32);
+	if (srcSize < dataStart)
+		return false;
+
+	// Find where each chunk starts, so they can be decoded in any order.
+	offsets.resize(table.count + 1);
+	offsets[0] = dataStart;
+	for (u32 i = 0; i < table.count; ++i) {
+		u32 len;
+		memcpy(&len, src + sizeof(table) + i * sizeof(u32), sizeof(len));
+		offsets[i + 1] = offsets[i] + len;
+		if (offsets[i + 1] > srcSize)
+			return false;
+	}
+	return true;
+}
+
+bool CChunkFileReader::DecodeChunk(const u8 *src, const ChunkTable &table, const std::vector<size_t> &offsets, u32 chunk, u8 *dest, size_t destSize) {
+	size_t offset = (size_t)chunk * table.chunkSize;
+	size_t expected = std::min((size_t)table.chunkSize, destSize - offset);
+	size_t len = expected;
+	snappy_status status = snappy_uncompress((const char *)src + offsets[chunk], offsets[chunk + 1] - offsets[chunk], (char *)dest, &len);
+	return status == SNAPPY_OK && len == expected;
+}
+
+bool CChunkFileReader::DecompressChunks(const u8 *src, size_t srcSize, u8 *dest, size_t destSize, const ParallelLoop &loop) {
+	ChunkTable table;
+	std::vector<size_t> offsets;
+	if (!ParseChunkTable(src, srcSize, destSize, table, offsets))
+		return false;
+
+	std::atomic<bool> failed(false);
+	loop([&](int lower, int upper) {
+		for (int i = lower; i < upper; ++i) {
+			if (!DecodeChunk(src, table, offsets, i, dest + (size_t)i * table.chunkSize, destSize))
+				failed = true;
+		}
+	}, 0, (int)table.count);
+	return !failed;
+}
+
+CChunkFileReader::Error CChunkFileReader::SaveFile(const std::string &filename, const std::string &title, const char *gitVersion, const u8 *buffer, size_t sz) {
+	std::vector<PointerWrap::Segment> segments;
+	segments.push_back({ buffer, sz });
+	return SaveFile(filename, title, gitVersion, segments);
+}
+
+CChunkFileReader::Error CChunkFileReader::SaveFile(const std::string &filename, const std::string &title, const char *gitVersion, const std::vector<PointerWrap::Segment> &segments) {
 	INFO_LOG(SAVESTATE, "ChunkReader: Writing %s", filename.c_str());
 
 	File::IOFile pFile(filename, "wb");
 	if (!pFile) {
 		ERROR_LOG(SAVESTATE, "ChunkReader: Error opening file for write");
-		free(buffer);
 		return ERROR_BAD_FILE;
 	}
 
-	// Make sure we can allocate a buffer to compress before compressing.
-	size_t write_len = snappy_max_compressed_length(sz);
-	u8 *compressed_buffer = (u8 *)malloc(write_len);
-	u8 *write_buffer = buffer;
-	if (!compressed_buffer) {
-		ERROR_LOG(SAVESTATE, "ChunkReader: Unable to allocate compressed buffer");
-		// We'll save uncompressed.  Better than not saving...
-		write_len = sz;
-	} else {
-		snappy_compress((const char *)buffer, sz, (char *)compressed_buffer, &write_len);
-		free(buffer);
+	size_t sz = SegmentsSize(segments);
+	ChunkTable table;
+	table.chunkSize = CHUNK_SIZE;
+	table.count = (u32)((sz + CHUNK_SIZE - 1) / CHUNK_SIZE);
+	std::vector<u32> chunkSizes(table.count);
 
-		write_buffer = compressed_buffer;
-	}
-
-	// Create header
+	// Create header.  The compressed size isn't known yet, so it's written again at the end.
 	SChunkHeader header;
-	header.Compress = compressed_buffer ? 1 : 0;
+	header.Compress = COMPRESS_SNAPPY_CHUNKS;
 	header.Revision = REVISION_CURRENT;
-	header.ExpectedSize = (u32)write_len;
+	header.ExpectedSize = 0;
 	header.UncompressedSize = (u32)sz;
 	truncate_cpy(header.GitVersion, gitVersion);
 
@@ -308,23 +666,46 @@ CChunkFileReader::Error CChunkFileReader::SaveFile(const std::string &filename,
 	// Now let's start writing out the file...
 	if (!pFile.WriteArray(&header, 1)) {
 		ERROR_LOG(SAVESTATE, "ChunkReader: Failed writing header");
-		free(write_buffer);
 		return ERROR_BAD_FILE;
 	}
 	if (!pFile.WriteArray(titleFixed, sizeof(titleFixed))) {
 		ERROR_LOG(SAVESTATE, "ChunkReader: Failed writing title");
-		free(write_buffer);
+		return ERROR_BAD_FILE;
+	}
+	if (!pFile.WriteArray(&table, 1) || (table.count != 0 && !pFile.WriteArray(&chunkSizes[0], table.count))) {
+		ERROR_LOG(SAVESTATE, "ChunkReader: Failed writing chunk table");
 		return ERROR_BAD_FILE;
 	}
 
-	if (!pFile.WriteBytes(write_buffer, write_len)) {
-		ERROR_LOG(SAVESTATE, "ChunkReader: Failed writing compressed data");
-		free(write_buffer);
+	// Compress a batch at a time across the thread pool, writing each out as it's done.
+	size_t written = sizeof(table) + table.count * sizeof(u32);
+	std::vector<std::vector<u8>> chunks;
+	for (u32 first = 0; first < table.count; first += CHUNK_BATCH) {
+		u32 last = std::min(first + (u32)CHUNK_BATCH, table.count);
+		CompressChunkRange(segments, sz, first, last, chunks, &GlobalLoop);
+		for (u32 i = first; i < last; ++i) {
+			const std::vector<u8> &chunk = chunks[i - first];
+			if (!pFile.WriteBytes(&chunk[0], chunk.size())) {
+				ERROR_LOG(SAVESTATE, "ChunkReader: Failed writing compressed data");
+				return ERROR_BAD_FILE;
+			}
+			chunkSizes[i] = (u32)chunk.size();
+			written += chunk.size();
+		}
+	}
+	INFO_LOG(SAVESTATE, "Savestate: Compressed %i bytes into %i", (int)sz, (int)written);
+
+	header.ExpectedSize = (u32)written;
+	if (!pFile.Seek(0, SEEK_SET) || !pFile.WriteArray(&header, 1)) {
+		ERROR_LOG(SAVESTATE, "ChunkReader: Failed writing header");
 		return ERROR_BAD_FILE;
-	} else if (sz != write_len) {
-		INFO_LOG(SAVESTATE, "Savestate: Compressed %i bytes into %i", (int)sz, (int)write_len);
 	}
-	free(write_buffer);
+	if (table.count != 0) {
+		if (!pFile.Seek(sizeof(header) + sizeof(titleFixed) + sizeof(table), SEEK_SET) || !pFile.WriteArray(&chunkSizes[0], table.count)) {
+			ERROR_LOG(SAVESTATE, "ChunkReader: Failed writing chunk table");
+			return ERROR_BAD_FILE;
+		}
+	}
 
 	INFO_LOG(SAVESTATE, "ChunkReader: Done writing %s", filename.c_str());
 	return ERROR_NONE;
@@ -30,6 +30,7 @@
 // - Serialization code for anything complex has to be manually written.
 
 #include <cstdlib>
+#include <functional>
 #include <map>
 #include <unordered_map>
 #include <deque>
@@ -129,9 +130,47 @@ class PointerWrap
 	Mode mode;
 	Error error;
 
+	// A run of output bytes, see SetGather().
+	struct Segment {
+		const u8 *data;
+		size_t size;
+	};
+
+	// Blocks at least this big are gathered by reference.
+	enum { GATHER_MIN_SIZE = 64 * 1024 };
+
+	// Supplies the data for MODE_READ on demand, so large blocks can be decoded straight into place.
+	class Source {
+	public:
+		virtual ~Source() {}
+		// The buffer that ptr moves through, only filled in where Prepare() was called.
+		virtual u8 *Base() = 0;
+		virtual size_t Size() const = 0;
+		// Makes sure [pos, pos + size) of the buffer is filled in.
+		virtual bool Prepare(size_t pos, size_t size) = 0;
+		// Copies [pos, pos + size) to data, bypassing the buffer where possible.
+		virtual bool Read(size_t pos, u8 *data, size_t size) = 0;
+	};
+
+private:
+	std::vector<Segment> *segments_;
+	u8 *flatStart_;
+	Source *source_;
+
+	void Prepare(size_t size);
+
 public:
-	PointerWrap(u8 **ptr_, Mode mode_) : ptr(ptr_), mode(mode_), error(ERROR_NONE) {}
-	PointerWrap(unsigned char **ptr_, int mode_) : ptr((u8**)ptr_), mode((Mode)mode_), error(ERROR_NONE) {}
+	PointerWrap(u8 **ptr_, Mode mode_) : ptr(ptr_), mode(mode_), error(ERROR_NONE), segments_(nullptr), flatStart_(nullptr), source_(nullptr) {}
+	PointerWrap(unsigned char **ptr_, int mode_) : ptr((u8**)ptr_), mode((Mode)mode_), error(ERROR_NONE), segments_(nullptr), flatStart_(nullptr), source_(nullptr) {}
+
+	// In MODE_WRITE, large blocks (like RAM) are added to segments by reference instead of being
+	// copied, and everything else is written to ptr as usual.  Call FinishGather() when done, and
+	// the segments in order are the state.  The data must not change until they're written out.
+	// In MODE_MEASURE, large blocks aren't counted, so the result is the size needed at ptr.
+	void SetGather(std::vector<Segment> *segments);
+	void FinishGather();
+	// In MODE_READ, ask source for data before using it.  ptr should start at source->Base().
+	void SetSource(Source *source) { source_ = source; }
 
 	PointerWrapSection Section(const char *title, int ver);
 
@@ -626,12 +665,15 @@ class CChunkFileReader
 	{
 		*failureReason = "LoadStateWrongVersion";
 
-		u8 *ptr = nullptr;
-		size_t sz;
-		Error error = LoadFile(filename, gitVersion, ptr, sz, failureReason);
+		PointerWrap::Source *source = nullptr;
+		Error error = OpenFile(filename, gitVersion, source, failureReason);
 		if (error == ERROR_NONE) {
-			error = LoadPtr(ptr, _class);
-			delete [] ptr;
+			u8 *ptr = source->Base();
+			PointerWrap p(&ptr, PointerWrap::MODE_READ);
+			p.SetSource(source);
+			_class.DoState(p);
+			error = p.error != p.ERROR_FAILURE ? ERROR_NONE : ERROR_BROKEN_STATE;
+			delete source;
 		}
 		
 		INFO_LOG(SAVESTATE, "ChunkReader: Done loading %s", filename.c_str());
@@ -645,18 +687,40 @@ class CChunkFileReader
 	template<class T>
 	static Error Save(const std::string &filename, const std::string &title, const char *gitVersion, T& _class)
 	{
-		// Get data
-		size_t const sz = MeasurePtr(_class);
-		u8 *buffer = (u8 *)malloc(sz);
-		if (!buffer)
-			return ERROR_BAD_ALLOC;
-		Error error = SavePtr(buffer, _class);
+		// Large blocks (like RAM) go straight from their owner to the compressor, so we only
+		// need to allocate space for everything else.
+		std::vector<PointerWrap::Segment> segments;
+		u8 *ptr = nullptr;
+		PointerWrap p(&ptr, PointerWrap::MODE_MEASURE);
+		p.SetGather(&segments);
+		_class.DoState(p);
+		std::vector<u8> buffer((size_t)ptr);
 
-		// SaveFile takes ownership of buffer
-		if (error == ERROR_NONE)
-			error = SaveFile(filename, title, gitVersion, buffer, sz);
-		return error;
+		ptr = buffer.data();
+		p.SetMode(PointerWrap::MODE_WRITE);
+		p.SetGather(&segments);
+		_class.DoState(p);
+		p.FinishGather();
+
+		if (p.error == PointerWrap::ERROR_FAILURE) {
+			ERROR_LOG(SAVESTATE, "Savestate failure: error while saving.");
+			return ERROR_BROKEN_STATE;
+		}
+		return SaveFile(filename, title, gitVersion, segments);
 	}
+
+	// Compresses and writes out a state already saved with SavePtr, safe to call from any thread.
+	static Error SaveFile(const std::string &filename, const std::string &title, const char *gitVersion, const u8 *buffer, size_t sz);
+	// Same, but for a state saved in gather mode.  The data is compressed as it's written.
+	static Error SaveFile(const std::string &filename, const std::string &title, const char *gitVersion, const std::vector<PointerWrap::Segment> &segments);
+
+	// Runs slices of [lower, upper) of a loop, possibly in parallel.  Normally GlobalThreadPool::Loop.
+	typedef std::function<void(const std::function<void(int, int)> &, int, int)> ParallelLoop;
+
+	// Compresses data into independently decodable snappy chunks (see COMPRESS_SNAPPY_CHUNKS.)
+	static void CompressChunks(const std::vector<PointerWrap::Segment> &segments, std::vector<u8> *dest, const ParallelLoop &loop);
+	// Decompresses the output of CompressChunks into exactly destSize bytes.
+	static bool DecompressChunks(const u8 *src, size_t srcSize, u8 *dest, size_t destSize, const ParallelLoop &loop);
 	
 	template <class T>
 	static Error Verify(T& _class)
@@ -697,10 +761,38 @@ class CChunkFileReader
 	enum {
 		REVISION_MIN = 4,
 		REVISION_TITLE = 5,
-		REVISION_CURRENT = REVISION_TITLE,
+		REVISION_CHUNKS = 6,
+		REVISION_CURRENT = REVISION_CHUNKS,
+	};
+
+	enum {
+		COMPRESS_NONE = 0,
+		COMPRESS_SNAPPY = 1,
+		// A u32 chunk size and count, then the compressed size of each chunk, then the chunks.
+		// Every chunk but the last is CHUNK_SIZE bytes uncompressed.
+		COMPRESS_SNAPPY_CHUNKS = 2,
 	};
 
+	enum {
+		CHUNK_SIZE = 256 * 1024,
+		// How many chunks to compress ahead of writing, bounds memory use when saving.
+		CHUNK_BATCH = 64,
+	};
+
+	struct ChunkTable {
+		u32 chunkSize;
+		u32 count;
+	};
+
+	class BufferSource;
+	class ChunkedSource;
+
+	static bool ParseChunkTable(const u8 *src, size_t srcSize, size_t destSize, ChunkTable &table, std::vector<size_t> &offsets);
+	static bool DecodeChunk(const u8 *src, const ChunkTable &table, const std::vector<size_t> &offsets, u32 chunk, u8 *dest, size_t destSize);
+	static void CompressChunkRange(const std::vector<PointerWrap::Segment> &segments, size_t totalSize, int first, int last, std::vector<std::vector<u8>> &out, const ParallelLoop &loop);
+
 	static Error LoadFile(const std::string &filename, const char *gitVersion, u8 *&buffer, size_t &sz, std::string *failureReason);
-	static Error SaveFile(const std::string &filename, const std::string &title, const char *gitVersion, u8 *buffer, size_t sz);
+	// Maps the file if possible, so uncompressed or chunked states are read in place.
+	static Error OpenFile(const std::string &filename, const char *gitVersion, PointerWrap::Source *&source, std::string *failureReason);
 	static Error LoadFileHeader(File::IOFile &pFile, SChunkHeader &header, std::string *title);
 };
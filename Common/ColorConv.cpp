@@ -29,6 +29,10 @@
 #include <smmintrin.h>
 #endif
 
+#ifdef HAVE_AVX2_DISPATCH
+#include <immintrin.h>
+#endif
+
 inline u16 RGBA8888toRGB565(u32 px) {
 	return ((px >> 3) & 0x001F) | ((px >> 5) & 0x07E0) | ((px >> 8) & 0xF800);
 }
@@ -278,7 +282,7 @@ void ConvertRGBA8888ToRGBA4444(u16 *dst, const u32 *src, u32 numPixels) {
 	}
 }
 
-void ConvertRGBA565ToRGBA8888(u32 *dst32, const u16 *src, u32 numPixels) {
+void ConvertRGBA565ToRGBA8888Basic(u32 *dst32, const u16 *src, u32 numPixels) {
 #ifdef _M_SSE
 	const __m128i mask5 = _mm_set1_epi16(0x001f);
 	const __m128i mask6 = _mm_set1_epi16(0x003f);
@@ -332,7 +336,7 @@ void ConvertRGBA565ToRGBA8888(u32 *dst32, const u16 *src, u32 numPixels) {
 	}
 }
 
-void ConvertRGBA5551ToRGBA8888(u32 *dst32, const u16 *src, u32 numPixels) {
+void ConvertRGBA5551ToRGBA8888Basic(u32 *dst32, const u16 *src, u32 numPixels) {
 #ifdef _M_SSE
 	const __m128i mask5 = _mm_set1_epi16(0x001f);
 	const __m128i mask8 = _mm_set1_epi16(0x00ff);
@@ -386,7 +390,7 @@ void ConvertRGBA5551ToRGBA8888(u32 *dst32, const u16 *src, u32 numPixels) {
 	}
 }
 
-void ConvertRGBA4444ToRGBA8888(u32 *dst32, const u16 *src, u32 numPixels) {
+void ConvertRGBA4444ToRGBA8888Basic(u32 *dst32, const u16 *src, u32 numPixels) {
 #ifdef _M_SSE
 	const __m128i mask4 = _mm_set1_epi16(0x000f);
 
@@ -635,6 +639,88 @@ void ConvertRGB565ToBGR565Basic(u16 *dst, const u16 *src, u32 numPixels) {
 	}
 }
 
+#ifdef HAVE_AVX2_DISPATCH
+// These follow the SSE2 paths above, but do 16 pixels at a time and don't need alignment.
+// The unpacks only work within each 128-bit half, so the halves are put back in order here.
+TARGET_AVX2
+static inline void InterleaveStore8888AVX2(u32 *dst, const __m256i &rg, const __m256i &ba) {
+	const __m256i lo = _mm256_unpacklo_epi16(rg, ba);
+	const __m256i hi = _mm256_unpackhi_epi16(rg, ba);
+	_mm256_storeu_si256((__m256i *)dst, _mm256_permute2x128_si256(lo, hi, 0x20));
+	_mm256_storeu_si256((__m256i *)dst + 1, _mm256_permute2x128_si256(lo, hi, 0x31));
+}
+
+TARGET_AVX2
+static void ConvertRGBA565ToRGBA8888AVX2(u32 *dst, const u16 *src, u32 numPixels) {
+	const __m256i mask5 = _mm256_set1_epi16(0x001f);
+	const __m256i mask6 = _mm256_set1_epi16(0x003f);
+	const __m256i mask8 = _mm256_set1_epi16(0x00ff);
+	const __m256i a = _mm256_set1_epi16((short)0xff00);
+
+	u32 i = 0;
+	for (; i + 16 <= numPixels; i += 16) {
+		const __m256i c = _mm256_loadu_si256((const __m256i *)(src + i));
+
+		__m256i r = _mm256_and_si256(c, mask5);
+		r = _mm256_and_si256(_mm256_or_si256(_mm256_slli_epi16(r, 3), _mm256_srli_epi16(r, 2)), mask8);
+		__m256i g = _mm256_and_si256(_mm256_srli_epi16(c, 5), mask6);
+		g = _mm256_slli_epi16(_mm256_or_si256(_mm256_slli_epi16(g, 2), _mm256_srli_epi16(g, 4)), 8);
+		__m256i b = _mm256_and_si256(_mm256_srli_epi16(c, 11), mask5);
+		b = _mm256_and_si256(_mm256_or_si256(_mm256_slli_epi16(b, 3), _mm256_srli_epi16(b, 2)), mask8);
+
+		InterleaveStore8888AVX2(dst + i, _mm256_or_si256(r, g), _mm256_or_si256(b, a));
+	}
+	ConvertRGBA565ToRGBA8888Basic(dst + i, src + i, numPixels - i);
+}
+
+TARGET_AVX2
+static void ConvertRGBA5551ToRGBA8888AVX2(u32 *dst, const u16 *src, u32 numPixels) {
+	const __m256i mask5 = _mm256_set1_epi16(0x001f);
+	const __m256i mask8 = _mm256_set1_epi16(0x00ff);
+
+	u32 i = 0;
+	for (; i + 16 <= numPixels; i += 16) {
+		const __m256i c = _mm256_loadu_si256((const __m256i *)(src + i));
+
+		__m256i r = _mm256_and_si256(c, mask5);
+		r = _mm256_and_si256(_mm256_or_si256(_mm256_slli_epi16(r, 3), _mm256_srli_epi16(r, 2)), mask8);
+		__m256i g = _mm256_and_si256(_mm256_srli_epi16(c, 5), mask5);
+		g = _mm256_slli_epi16(_mm256_or_si256(_mm256_slli_epi16(g, 3), _mm256_srli_epi16(g, 2)), 8);
+		__m256i b = _mm256_and_si256(_mm256_srli_epi16(c, 10), mask5);
+		b = _mm256_and_si256(_mm256_or_si256(_mm256_slli_epi16(b, 3), _mm256_srli_epi16(b, 2)), mask8);
+		__m256i a = _mm256_slli_epi16(_mm256_srai_epi16(c, 15), 8);
+
+		InterleaveStore8888AVX2(dst + i, _mm256_or_si256(r, g), _mm256_or_si256(b, a));
+	}
+	ConvertRGBA5551ToRGBA8888Basic(dst + i, src + i, numPixels - i);
+}
+
+TARGET_AVX2
+static void ConvertRGBA4444ToRGBA8888AVX2(u32 *dst, const u16 *src, u32 numPixels) {
+	const __m256i mask4 = _mm256_set1_epi16(0x000f);
+
+	u32 i = 0;
+	for (; i + 16 <= numPixels; i += 16) {
+		const __m256i c = _mm256_loadu_si256((const __m256i *)(src + i));
+
+		__m256i r = _mm256_and_si256(c, mask4);
+		__m256i g = _mm256_slli_epi16(_mm256_and_si256(_mm256_srli_epi16(c, 4), mask4), 8);
+		__m256i b = _mm256_and_si256(_mm256_srli_epi16(c, 8), mask4);
+		__m256i a = _mm256_slli_epi16(_mm256_srli_epi16(c, 12), 8);
+
+		__m256i rg = _mm256_or_si256(r, g);
+		__m256i ba = _mm256_or_si256(b, a);
+		rg = _mm256_or_si256(rg, _mm256_slli_epi16(rg, 4));
+		ba = _mm256_or_si256(ba, _mm256_slli_epi16(ba, 4));
+
+		InterleaveStore8888AVX2(dst + i, rg, ba);
+	}
+	ConvertRGBA4444ToRGBA8888Basic(dst + i, src + i, numPixels - i);
+}
+#endif
+
+static const char *colorConvVariant = "Generic";
+
 // Reuse the logic from the header - if these aren't defined, we need externs.
 #ifndef ConvertRGBA4444ToABGR4444
 Convert16bppTo16bppFunc ConvertRGBA4444ToABGR4444 = &ConvertRGBA4444ToABGR4444Basic;
@@ -642,12 +728,39 @@ Convert16bppTo16bppFunc ConvertRGBA5551ToABGR1555 = &ConvertRGBA5551ToABGR1555Ba
 Convert16bppTo16bppFunc ConvertRGB565ToBGR565 = &ConvertRGB565ToBGR565Basic;
 #endif
 
+#ifndef ConvertRGBA565ToRGBA8888
+Convert16bppTo32bppFunc ConvertRGBA565ToRGBA8888 = &ConvertRGBA565ToRGBA8888Basic;
+Convert16bppTo32bppFunc ConvertRGBA5551ToRGBA8888 = &ConvertRGBA5551ToRGBA8888Basic;
+Convert16bppTo32bppFunc ConvertRGBA4444ToRGBA8888 = &ConvertRGBA4444ToRGBA8888Basic;
+#endif
+
 void SetupColorConv() {
+#if PPSSPP_ARCH(ARM64)
+	colorConvVariant = "NEON";
+#elif defined(_M_SSE)
+	colorConvVariant = "SSE2";
+#endif
+#ifdef HAVE_AVX2_DISPATCH
+	if (cpu_info.bAVX2) {
+		ConvertRGBA565ToRGBA8888 = &ConvertRGBA565ToRGBA8888AVX2;
+		ConvertRGBA5551ToRGBA8888 = &ConvertRGBA5551ToRGBA8888AVX2;
+		ConvertRGBA4444ToRGBA8888 = &ConvertRGBA4444ToRGBA8888AVX2;
+		colorConvVariant = "AVX2";
+	}
+#endif
 #if PPSSPP_ARCH(ARMV7) && PPSSPP_ARCH(ARM_NEON)
 	if (cpu_info.bNEON) {
+		colorConvVariant = "NEON";
 		ConvertRGBA4444ToABGR4444 = &ConvertRGBA4444ToABGR4444NEON;
 		ConvertRGBA5551ToABGR1555 = &ConvertRGBA5551ToABGR1555NEON;
 		ConvertRGB565ToBGR565 = &ConvertRGB565ToBGR565NEON;
+		ConvertRGBA565ToRGBA8888 = &ConvertRGBA565ToRGBA8888NEON;
+		ConvertRGBA5551ToRGBA8888 = &ConvertRGBA5551ToRGBA8888NEON;
+		ConvertRGBA4444ToRGBA8888 = &ConvertRGBA4444ToRGBA8888NEON;
 	}
 #endif
 }
+
+const char *GetColorConvVariant() {
+	return colorConvVariant;
+}
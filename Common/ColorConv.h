@@ -22,6 +22,8 @@
 #include "ColorConvNEON.h"
 
 void SetupColorConv();
+// Which SIMD implementation SetupColorConv picked, for display.
+const char *GetColorConvVariant();
 
 inline u8 Convert4To8(u8 v) {
 	// Swizzle bits: 00001234 -> 12341234
@@ -123,9 +125,9 @@ void ConvertBGRA8888ToRGBA5551(u16 *dst, const u32 *src, u32 numPixels);
 void ConvertBGRA8888ToRGB565(u16 *dst, const u32 *src, u32 numPixels);
 void ConvertBGRA8888ToRGBA4444(u16 *dst, const u32 *src, u32 numPixels);
 
-void ConvertRGBA565ToRGBA8888(u32 *dst, const u16 *src, u32 numPixels);
-void ConvertRGBA5551ToRGBA8888(u32 *dst, const u16 *src, u32 numPixels);
-void ConvertRGBA4444ToRGBA8888(u32 *dst, const u16 *src, u32 numPixels);
+void ConvertRGBA565ToRGBA8888Basic(u32 *dst, const u16 *src, u32 numPixels);
+void ConvertRGBA5551ToRGBA8888Basic(u32 *dst, const u16 *src, u32 numPixels);
+void ConvertRGBA4444ToRGBA8888Basic(u32 *dst, const u16 *src, u32 numPixels);
 
 void ConvertABGR565ToRGBA8888(u32 *dst, const u16 *src, u32 numPixels);
 void ConvertABGR1555ToRGBA8888(u32 *dst, const u16 *src, u32 numPixels);
@@ -162,3 +164,17 @@ extern Convert16bppTo16bppFunc ConvertRGBA5551ToABGR1555;
 #else
 extern Convert16bppTo16bppFunc ConvertRGB565ToBGR565;
 #endif
+
+#if PPSSPP_ARCH(ARM64)
+#define ConvertRGBA565ToRGBA8888 ConvertRGBA565ToRGBA8888NEON
+#define ConvertRGBA5551ToRGBA8888 ConvertRGBA5551ToRGBA8888NEON
+#define ConvertRGBA4444ToRGBA8888 ConvertRGBA4444ToRGBA8888NEON
+#elif !PPSSPP_ARCH(ARM) && !PPSSPP_ARCH(X86) && !PPSSPP_ARCH(AMD64)
+#define ConvertRGBA565ToRGBA8888 ConvertRGBA565ToRGBA8888Basic
+#define ConvertRGBA5551ToRGBA8888 ConvertRGBA5551ToRGBA8888Basic
+#define ConvertRGBA4444ToRGBA8888 ConvertRGBA4444ToRGBA8888Basic
+#else
+extern Convert16bppTo32bppFunc ConvertRGBA565ToRGBA8888;
+extern Convert16bppTo32bppFunc ConvertRGBA5551ToRGBA8888;
+extern Convert16bppTo32bppFunc ConvertRGBA4444ToRGBA8888;
+#endif
@@ -111,4 +111,84 @@ void ConvertRGB565ToBGR565NEON(u16 *dst, const u16 *src, u32 numPixels) {
 	}
 }
 
+// Expands 5 or 6 bits to 8 by repeating the top bits, like Convert5To8/Convert6To8.
+static inline uint8x8_t Expand5To8NEON(uint16x8_t c, int shift) {
+	const uint8x8_t v = vmovn_u16(vandq_u16(vshlq_u16(c, vdupq_n_s16(-shift)), vdupq_n_u16(0x1F)));
+	return vorr_u8(vshl_n_u8(v, 3), vshr_n_u8(v, 2));
+}
+
+static inline uint8x8_t Expand4To8NEON(uint16x8_t c, int shift) {
+	const uint8x8_t v = vmovn_u16(vandq_u16(vshlq_u16(c, vdupq_n_s16(-shift)), vdupq_n_u16(0x0F)));
+	return vorr_u8(vshl_n_u8(v, 4), v);
+}
+
+void ConvertRGBA565ToRGBA8888NEON(u32 *dst, const u16 *src, u32 numPixels) {
+	u32 simdable = (numPixels / 8) * 8;
+	for (u32 i = 0; i < simdable; i += 8) {
+		const uint16x8_t c = vld1q_u16(src);
+
+		uint8x8x4_t res;
+		res.val[0] = Expand5To8NEON(c, 0);
+		const uint8x8_t g = vmovn_u16(vandq_u16(vshrq_n_u16(c, 5), vdupq_n_u16(0x3F)));
+		res.val[1] = vorr_u8(vshl_n_u8(g, 2), vshr_n_u8(g, 4));
+		res.val[2] = Expand5To8NEON(c, 11);
+		res.val[3] = vdup_n_u8(0xFF);
+		// Interleaves the bytes back into RGBA.
+		vst4_u8((u8 *)dst, res);
+
+		src += 8;
+		dst += 8;
+	}
+	numPixels -= simdable;
+
+	if (numPixels > 0) {
+		ConvertRGBA565ToRGBA8888Basic(dst, src, numPixels);
+	}
+}
+
+void ConvertRGBA5551ToRGBA8888NEON(u32 *dst, const u16 *src, u32 numPixels) {
+	u32 simdable = (numPixels / 8) * 8;
+	for (u32 i = 0; i < simdable; i += 8) {
+		const uint16x8_t c = vld1q_u16(src);
+
+		uint8x8x4_t res;
+		res.val[0] = Expand5To8NEON(c, 0);
+		res.val[1] = Expand5To8NEON(c, 5);
+		res.val[2] = Expand5To8NEON(c, 10);
+		// Arithmetic shift smears the alpha bit into 0xFFFF or 0.
+		res.val[3] = vmovn_u16(vreinterpretq_u16_s16(vshrq_n_s16(vreinterpretq_s16_u16(c), 15)));
+		vst4_u8((u8 *)dst, res);
+
+		src += 8;
+		dst += 8;
+	}
+	numPixels -= simdable;
+
+	if (numPixels > 0) {
+		ConvertRGBA5551ToRGBA8888Basic(dst, src, numPixels);
+	}
+}
+
+void ConvertRGBA4444ToRGBA8888NEON(u32 *dst, const u16 *src, u32 numPixels) {
+	u32 simdable = (numPixels / 8) * 8;
+	for (u32 i = 0; i < simdable; i += 8) {
+		const uint16x8_t c = vld1q_u16(src);
+
+		uint8x8x4_t res;
+		res.val[0] = Expand4To8NEON(c, 0);
+		res.val[1] = Expand4To8NEON(c, 4);
+		res.val[2] = Expand4To8NEON(c, 8);
+		res.val[3] = Expand4To8NEON(c, 12);
+		vst4_u8((u8 *)dst, res);
+
+		src += 8;
+		dst += 8;
+	}
+	numPixels -= simdable;
+
+	if (numPixels > 0) {
+		ConvertRGBA4444ToRGBA8888Basic(dst, src, numPixels);
+	}
+}
+
 #endif // PPSSPP_ARCH(ARM_NEON)
@@ -97,3 +97,13 @@
 #  define _M_SSE 0x200
 # endif
 #endif
+
+// Marks a function that may use AVX2 intrinsics even though the file is built for the baseline.
+// Only call such functions after checking cpu_info.bAVX2, usually by picking them in a Setup func.
+#if defined(_M_SSE) && (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define HAVE_AVX2_DISPATCH 1
+#elif defined(_M_SSE) && defined(_MSC_VER) && _MSC_VER >= 1800
+#define TARGET_AVX2
+#define HAVE_AVX2_DISPATCH 1
+#endif
@@ -0,0 +1,189 @@
+// Copyright (c) 2012- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <algorithm>
+
+#include "ppsspp_config.h"
+#include "Common/CPUDetect.h"
+#include "Common/Crypto/crc32.h"
+
+#if PPSSPP_ARCH(X86) || PPSSPP_ARCH(AMD64)
+#define CRC32_ACCEL_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#define CRC32_ACCEL_TARGET
+#else
+#define CRC32_ACCEL_TARGET __attribute__((target("pclmul,sse4.1")))
+#endif
+#elif PPSSPP_ARCH(ARM64) && defined(__ARM_FEATURE_CRC32)
+#define CRC32_ACCEL_ARMV8
+#include <arm_acle.h>
+#endif
+
+extern "C" {
+#include "zlib.h"
+}
+
+// zlib takes lengths as uInt, so feed it in pieces well under 4GB.
+static uint32_t crc32_zlib(uint32_t crc, const uint8_t *data, size_t len) {
+	while (len > 0) {
+		const uInt chunk = (uInt)std::min(len, (size_t)0x40000000);
+		crc = (uint32_t)crc32(crc, data, chunk);
+		data += chunk;
+		len -= chunk;
+	}
+	return crc;
+}
+
+#if defined(CRC32_ACCEL_X86)
+
+CRC32_ACCEL_TARGET static inline __m128i crc32_fold16(__m128i acc, __m128i next, __m128i k) {
+	const __m128i lo = _mm_clmulepi64_si128(acc, k, 0x00);
+	const __m128i hi = _mm_clmulepi64_si128(acc, k, 0x11);
+	return _mm_xor_si128(_mm_xor_si128(hi, next), lo);
+}
+
+// Folds 64 bytes at a time with carry-less multiplies, then Barrett reduces to 32 bits.
+// See Intel's "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction."
+// The constants are for the bit-reflected zlib polynomial 0x04C11DB7.
+// Requires len >= 64 and a multiple of 16. Takes and returns the inverted crc.
+CRC32_ACCEL_TARGET static uint32_t crc32_fold_pclmul(const uint8_t *buf, size_t len, uint32_t crc) {
+	alignas(16) static const uint64_t k1k2[] = { 0x0154442bd4ULL, 0x01c6e41596ULL };
+	alignas(16) static const uint64_t k3k4[] = { 0x01751997d0ULL, 0x00ccaa009eULL };
+	alignas(16) static const uint64_t k5k0[] = { 0x0163cd6124ULL, 0x0000000000ULL };
+	alignas(16) static const uint64_t poly[] = { 0x01db710641ULL, 0x01f7011641ULL };
+
+	__m128i x1 = _mm_loadu_si128((const __m128i *)(buf + 0x00));
+	__m128i x2 = _mm_loadu_si128((const __m128i *)(buf + 0x10));
+	__m128i x3 = _mm_loadu_si128((const __m128i *)(buf + 0x20));
+	__m128i x4 = _mm_loadu_si128((const __m128i *)(buf + 0x30));
+	x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(crc));
+
+	__m128i k = _mm_load_si128((const __m128i *)k1k2);
+	buf += 64;
+	len -= 64;
+
+	while (len >= 64) {
+		const __m128i x5 = _mm_clmulepi64_si128(x1, k, 0x00);
+		const __m128i x6 = _mm_clmulepi64_si128(x2, k, 0x00);
+		const __m128i x7 = _mm_clmulepi64_si128(x3, k, 0x00);
+		const __m128i x8 = _mm_clmulepi64_si128(x4, k, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, k, 0x11);
+		x2 = _mm_clmulepi64_si128(x2, k, 0x11);
+		x3 = _mm_clmulepi64_si128(x3, k, 0x11);
+		x4 = _mm_clmulepi64_si128(x4, k, 0x11);
+
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i *)(buf + 0x00)));
+		x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i *)(buf + 0x10)));
+		x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i *)(buf + 0x20)));
+		x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i *)(buf + 0x30)));
+
+		buf += 64;
+		len -= 64;
+	}
+
+	// Fold the four lanes into one.
+	k = _mm_load_si128((const __m128i *)k3k4);
+	x1 = crc32_fold16(x1, x2, k);
+	x1 = crc32_fold16(x1, x3, k);
+	x1 = crc32_fold16(x1, x4, k);
+
+	while (len >= 16) {
+		x1 = crc32_fold16(x1, _mm_loadu_si128((const __m128i *)buf), k);
+		buf += 16;
+		len -= 16;
+	}
+
+	// 128 bits down to 64.
+	const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+	x2 = _mm_clmulepi64_si128(x1, k, 0x10);
+	x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+
+	k = _mm_loadl_epi64((const __m128i *)k5k0);
+	x2 = _mm_srli_si128(x1, 4);
+	x1 = _mm_and_si128(x1, mask32);
+	x1 = _mm_clmulepi64_si128(x1, k, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	// Barrett reduction to 32 bits.
+	k = _mm_load_si128((const __m128i *)poly);
+	x2 = _mm_and_si128(x1, mask32);
+	x2 = _mm_clmulepi64_si128(x2, k, 0x10);
+	x2 = _mm_and_si128(x2, mask32);
+	x2 = _mm_clmulepi64_si128(x2, k, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	return (uint32_t)_mm_extract_epi32(x1, 1);
+}
+
+static bool crc32_accel_available() {
+	return cpu_info.bPCLMUL && cpu_info.bSSE4_1;
+}
+
+uint32_t crc32_update(uint32_t crc, const uint8_t *data, size_t len) {
+	if (len >= 64 && crc32_accel_available()) {
+		const size_t chunk = len & ~(size_t)15;
+		crc = ~crc32_fold_pclmul(data, chunk, ~crc);
+		data += chunk;
+		len -= chunk;
+	}
+	return crc32_zlib(crc, data, len);
+}
+
+#elif defined(CRC32_ACCEL_ARMV8)
+
+static bool crc32_accel_available() {
+	return cpu_info.bCRC32;
+}
+
+uint32_t crc32_update(uint32_t crc, const uint8_t *data, size_t len) {
+	if (!crc32_accel_available())
+		return crc32_zlib(crc, data, len);
+
+	crc = ~crc;
+	while (len > 0 && ((uintptr_t)data & 7) != 0) {
+		crc = __crc32b(crc, *data++);
+		--len;
+	}
+	while (len >= 32) {
+		const uint64_t *p = (const uint64_t *)data;
+		crc = __crc32d(crc, p[0]);
+		crc = __crc32d(crc, p[1]);
+		crc = __crc32d(crc, p[2]);
+		crc = __crc32d(crc, p[3]);
+		data += 32;
+		len -= 32;
+	}
+	while (len >= 8) {
+		crc = __crc32d(crc, *(const uint64_t *)data);
+		data += 8;
+		len -= 8;
+	}
+	while (len > 0) {
+		crc = __crc32b(crc, *data++);
+		--len;
+	}
+	return ~crc;
+}
+
+#else
+
+uint32_t crc32_update(uint32_t crc, const uint8_t *data, size_t len) {
+	return crc32_zlib(crc, data, len);
+}
+
+#endif
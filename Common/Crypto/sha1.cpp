@@ -33,9 +33,26 @@
 #include "polarssl/sha1.h"
 */
 #include "sha1.h"
+#include <stdint.h>
 #include <string.h>
 #include <stdio.h>
 
+#include "ppsspp_config.h"
+#include "Common/CPUDetect.h"
+
+#if PPSSPP_ARCH(X86) || PPSSPP_ARCH(AMD64)
+#define SHA1_ACCEL_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#define SHA1_ACCEL_TARGET
+#else
+#define SHA1_ACCEL_TARGET __attribute__((target("sha,sse4.1")))
+#endif
+#elif PPSSPP_ARCH(ARM64) && defined(__ARM_FEATURE_CRYPTO)
+#define SHA1_ACCEL_ARMV8
+#include <arm_neon.h>
+#endif
+
 /*
  * 32-bit integer manipulation macros (big endian)
  */
@@ -230,6 +247,130 @@ static void sha1_process( sha1_context *ctx, unsigned char data[64] )
     ctx->state[4] += E;
 }
 
+#ifdef SHA1_ACCEL_X86
+
+// Each group does 4 rounds, m holds the last 16 message words.
+// The rounds function immediate has to be a constant, so there's one loop for each.
+#define SHA1_ACCEL_GROUP(func) \
+    { \
+        __m128i &cur = m[g & 3]; \
+        if( g < 4 ) \
+            cur = _mm_shuffle_epi8( _mm_loadu_si128( (const __m128i *)( data + g * 16 ) ), swapMask ); \
+        else \
+            cur = _mm_sha1msg2_epu32( _mm_xor_si128( _mm_sha1msg1_epu32( cur, m[( g + 1 ) & 3] ), m[( g + 2 ) & 3] ), m[( g + 3 ) & 3] ); \
+        const __m128i x = g == 0 ? _mm_add_epi32( e0, cur ) : _mm_sha1nexte_epu32( e, cur ); \
+        e = abcd; \
+        abcd = _mm_sha1rnds4_epu32( abcd, x, func ); \
+    }
+
+SHA1_ACCEL_TARGET static void sha1_process_accel( uint32_t state[5], const unsigned char *data, int blocks )
+{
+    const __m128i swapMask = _mm_set_epi64x( 0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL );
+    __m128i abcd = _mm_shuffle_epi32( _mm_loadu_si128( (const __m128i *)state ), 0x1B );
+    __m128i e0 = _mm_set_epi32( (int)state[4], 0, 0, 0 );
+    __m128i m[4];
+    __m128i e;
+    int g;
+
+    for( ; blocks > 0; blocks--, data += 64 )
+    {
+        const __m128i abcdSave = abcd;
+        const __m128i e0Save = e0;
+        e = _mm_setzero_si128();
+
+        for( g = 0; g < 5; g++ )
+            SHA1_ACCEL_GROUP( 0 );
+        for( ; g < 10; g++ )
+            SHA1_ACCEL_GROUP( 1 );
+        for( ; g < 15; g++ )
+            SHA1_ACCEL_GROUP( 2 );
+        for( ; g < 20; g++ )
+            SHA1_ACCEL_GROUP( 3 );
+
+        e0 = _mm_sha1nexte_epu32( e, e0Save );
+        abcd = _mm_add_epi32( abcd, abcdSave );
+    }
+
+    _mm_storeu_si128( (__m128i *)state, _mm_shuffle_epi32( abcd, 0x1B ) );
+    state[4] = (uint32_t)_mm_extract_epi32( e0, 3 );
+}
+
+#undef SHA1_ACCEL_GROUP
+
+static bool sha1_accel_available()
+{
+    return cpu_info.bSHA && cpu_info.bSSE4_1;
+}
+
+#elif defined(SHA1_ACCEL_ARMV8)
+
+static void sha1_process_accel( uint32_t state[5], const unsigned char *data, int blocks )
+{
+    static const uint32_t k[4] = { 0x5A827999, 0x6ED9EBA1, 0x8F1BBCDC, 0xCA62C1D6 };
+    uint32x4_t abcd = vld1q_u32( state );
+    uint32_t e0 = state[4];
+    uint32x4_t m[4];
+
+    for( ; blocks > 0; blocks--, data += 64 )
+    {
+        const uint32x4_t abcdSave = abcd;
+        const uint32_t e0Save = e0;
+        uint32_t e = e0;
+
+        for( int g = 0; g < 20; g++ )
+        {
+            uint32x4_t &cur = m[g & 3];
+            if( g < 4 )
+                cur = vreinterpretq_u32_u8( vrev32q_u8( vld1q_u8( data + g * 16 ) ) );
+            else
+                cur = vsha1su1q_u32( vsha1su0q_u32( cur, m[( g + 1 ) & 3], m[( g + 2 ) & 3] ), m[( g + 3 ) & 3] );
+
+            const uint32x4_t x = vaddq_u32( cur, vdupq_n_u32( k[g / 5] ) );
+            const uint32_t nextE = vsha1h_u32( vgetq_lane_u32( abcd, 0 ) );
+            if( g < 5 )
+                abcd = vsha1cq_u32( abcd, e, x );
+            else if( g >= 10 && g < 15 )
+                abcd = vsha1mq_u32( abcd, e, x );
+            else
+                abcd = vsha1pq_u32( abcd, e, x );
+            e = nextE;
+        }
+
+        e0 = e + e0Save;
+        abcd = vaddq_u32( abcd, abcdSave );
+    }
+
+    vst1q_u32( state, abcd );
+    state[4] = e0;
+}
+
+static bool sha1_accel_available()
+{
+    return cpu_info.bSHA;
+}
+
+#endif
+
+static void sha1_process_blocks( sha1_context *ctx, unsigned char *data, int blocks )
+{
+#if defined(SHA1_ACCEL_X86) || defined(SHA1_ACCEL_ARMV8)
+    if( sha1_accel_available() )
+    {
+        // The context uses unsigned long, which isn't always 32 bits.
+        uint32_t state[5];
+        int i;
+        for( i = 0; i < 5; i++ )
+            state[i] = (uint32_t)ctx->state[i];
+        sha1_process_accel( state, data, blocks );
+        for( i = 0; i < 5; i++ )
+            ctx->state[i] = state[i];
+        return;
+    }
+#endif
+    for( ; blocks > 0; blocks--, data += 64 )
+        sha1_process( ctx, data );
+}
+
 /*
  * SHA-1 process buffer
  */
@@ -254,17 +395,17 @@ void sha1_update( sha1_context *ctx, unsigned char *input, int ilen )
     {
         memcpy( (void *) (ctx->buffer + left),
                 (void *) input, fill );
-        sha1_process( ctx, ctx->buffer );
+        sha1_process_blocks( ctx, ctx->buffer, 1 );
         input += fill;
         ilen  -= fill;
         left = 0;
     }
 
-    while( ilen >= 64 )
+    if( ilen >= 64 )
     {
-        sha1_process( ctx, input );
-        input += 64;
-        ilen  -= 64;
+        sha1_process_blocks( ctx, input, ilen / 64 );
+        input += ilen & ~63;
+        ilen  &= 63;
     }
 
     if( ilen > 0 )
@@ -20,8 +20,23 @@
 
 #include <string.h>
 
+#include "ppsspp_config.h"
+#include "Common/CPUDetect.h"
 #include "sha256.h"
 
+#if PPSSPP_ARCH(X86) || PPSSPP_ARCH(AMD64)
+#define SHA256_ACCEL_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#define SHA256_ACCEL_TARGET
+#else
+#define SHA256_ACCEL_TARGET __attribute__((target("sha,sse4.1")))
+#endif
+#elif PPSSPP_ARCH(ARM64) && defined(__ARM_FEATURE_CRYPTO)
+#define SHA256_ACCEL_ARMV8
+#include <arm_neon.h>
+#endif
+
 #define GET_uint32_t(n,b,i)                       \
 {                                               \
     (n) = ( (uint32_t) (b)[(i)    ] << 24 )       \
@@ -184,6 +199,131 @@ void sha256_process( sha256_context *ctx, const uint8_t data[64] )
     ctx->state[7] += H;
 }
 
+#if defined(SHA256_ACCEL_X86) || defined(SHA256_ACCEL_ARMV8)
+
+static const uint32_t sha256_k[64] =
+{
+    0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+    0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+    0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+    0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+    0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+    0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+    0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+    0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2,
+};
+
+#endif
+
+#ifdef SHA256_ACCEL_X86
+
+// Each pass does 4 rounds, w holds the last 16 message words.
+SHA256_ACCEL_TARGET static void sha256_process_accel( sha256_context *ctx, const uint8_t *data, uint32_t blocks )
+{
+    const __m128i swapMask = _mm_set_epi64x( 0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL );
+    __m128i w[4];
+    __m128i tmp = _mm_loadu_si128( (const __m128i *)&ctx->state[0] );
+    __m128i state1 = _mm_loadu_si128( (const __m128i *)&ctx->state[4] );
+    __m128i state0;
+
+    // The instructions want ABEF and CDGH.
+    tmp = _mm_shuffle_epi32( tmp, 0xB1 );
+    state1 = _mm_shuffle_epi32( state1, 0x1B );
+    state0 = _mm_alignr_epi8( tmp, state1, 8 );
+    state1 = _mm_blend_epi16( state1, tmp, 0xF0 );
+
+    for( ; blocks > 0; blocks--, data += 64 )
+    {
+        const __m128i save0 = state0;
+        const __m128i save1 = state1;
+
+        for( int i = 0; i < 16; i++ )
+        {
+            __m128i &cur = w[i & 3];
+            if( i < 4 )
+                cur = _mm_shuffle_epi8( _mm_loadu_si128( (const __m128i *)( data + i * 16 ) ), swapMask );
+            else
+                cur = _mm_sha256msg2_epu32( _mm_add_epi32( _mm_sha256msg1_epu32( cur, w[( i + 1 ) & 3] ), _mm_alignr_epi8( w[( i + 3 ) & 3], w[( i + 2 ) & 3], 4 ) ), w[( i + 3 ) & 3] );
+
+            __m128i msg = _mm_add_epi32( cur, _mm_loadu_si128( (const __m128i *)&sha256_k[i * 4] ) );
+            state1 = _mm_sha256rnds2_epu32( state1, state0, msg );
+            msg = _mm_shuffle_epi32( msg, 0x0E );
+            state0 = _mm_sha256rnds2_epu32( state0, state1, msg );
+        }
+
+        state0 = _mm_add_epi32( state0, save0 );
+        state1 = _mm_add_epi32( state1, save1 );
+    }
+
+    tmp = _mm_shuffle_epi32( state0, 0x1B );
+    state1 = _mm_shuffle_epi32( state1, 0xB1 );
+    state0 = _mm_blend_epi16( tmp, state1, 0xF0 );
+    state1 = _mm_alignr_epi8( state1, tmp, 8 );
+
+    _mm_storeu_si128( (__m128i *)&ctx->state[0], state0 );
+    _mm_storeu_si128( (__m128i *)&ctx->state[4], state1 );
+}
+
+static bool sha256_accel_available()
+{
+    return cpu_info.bSHA && cpu_info.bSSE4_1;
+}
+
+#elif defined(SHA256_ACCEL_ARMV8)
+
+static void sha256_process_accel( sha256_context *ctx, const uint8_t *data, uint32_t blocks )
+{
+    uint32x4_t w[4];
+    uint32x4_t state0 = vld1q_u32( &ctx->state[0] );
+    uint32x4_t state1 = vld1q_u32( &ctx->state[4] );
+
+    for( ; blocks > 0; blocks--, data += 64 )
+    {
+        const uint32x4_t save0 = state0;
+        const uint32x4_t save1 = state1;
+
+        for( int i = 0; i < 16; i++ )
+        {
+            uint32x4_t &cur = w[i & 3];
+            if( i < 4 )
+                cur = vreinterpretq_u32_u8( vrev32q_u8( vld1q_u8( data + i * 16 ) ) );
+            else
+                cur = vsha256su1q_u32( vsha256su0q_u32( cur, w[( i + 1 ) & 3] ), w[( i + 2 ) & 3], w[( i + 3 ) & 3] );
+
+            const uint32x4_t msg = vaddq_u32( cur, vld1q_u32( &sha256_k[i * 4] ) );
+            const uint32x4_t prev0 = state0;
+            state0 = vsha256hq_u32( state0, state1, msg );
+            state1 = vsha256h2q_u32( state1, prev0, msg );
+        }
+
+        state0 = vaddq_u32( state0, save0 );
+        state1 = vaddq_u32( state1, save1 );
+    }
+
+    vst1q_u32( &ctx->state[0], state0 );
+    vst1q_u32( &ctx->state[4], state1 );
+}
+
+static bool sha256_accel_available()
+{
+    return cpu_info.bSHA;
+}
+
+#endif
+
+static void sha256_process_blocks( sha256_context *ctx, const uint8_t *data, uint32_t blocks )
+{
+#if defined(SHA256_ACCEL_X86) || defined(SHA256_ACCEL_ARMV8)
+    if( sha256_accel_available() )
+    {
+        sha256_process_accel( ctx, data, blocks );
+        return;
+    }
+#endif
+    for( ; blocks > 0; blocks--, data += 64 )
+        sha256_process( ctx, data );
+}
+
 void sha256_update( sha256_context *ctx, const uint8_t *input, uint32_t length )
 {
     uint32_t left, fill;
@@ -203,17 +343,17 @@ void sha256_update( sha256_context *ctx, const uint8_t *input, uint32_t length )
     {
         memcpy( (void *) (ctx->buffer + left),
                 (void *) input, fill );
-        sha256_process( ctx, ctx->buffer );
+        sha256_process_blocks( ctx, ctx->buffer, 1 );
         length -= fill;
         input  += fill;
         left = 0;
     }
 
-    while( length >= 64 )
+    if( length >= 64 )
     {
-        sha256_process( ctx, input );
-        length -= 64;
-        input  += 64;
+        sha256_process_blocks( ctx, input, length / 64 );
+        input  += length & ~63;
+        length &= 63;
     }
 
     if( length )
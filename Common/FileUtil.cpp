@@ -39,7 +39,10 @@
 #include <sys/types.h>
 #include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #endif
 
 #if defined(__DragonFly__) || defined(__FreeBSD__) || defined(__FreeBSD_kernel__) || defined(__NetBSD__)
@@ -894,4 +897,64 @@ bool IOFile::Resize(u64 size)
 	return m_good;
 }
 
+MappedFile::~MappedFile() {
+#if defined(_WIN32) && !PPSSPP_PLATFORM(UWP)
+	if (mapped_)
+		UnmapViewOfFile(data_);
+	if (mapping_)
+		CloseHandle((HANDLE)mapping_);
+#elif !defined(_WIN32)
+	if (mapped_)
+		munmap(data_, size_);
+#endif
+}
+
+bool MappedFile::Open(const std::string &filename, bool allowFallback) {
+#if defined(_WIN32) && !PPSSPP_PLATFORM(UWP)
+	HANDLE file = CreateFileW(ConvertUTF8ToWString(filename).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file != INVALID_HANDLE_VALUE) {
+		LARGE_INTEGER fileSize;
+		if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0) {
+			mapping_ = CreateFileMapping(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+			if (mapping_)
+				data_ = (u8 *)MapViewOfFile((HANDLE)mapping_, FILE_MAP_COPY, 0, 0, 0);
+			if (data_) {
+				size_ = (size_t)fileSize.QuadPart;
+				mapped_ = true;
+			}
+		}
+		CloseHandle(file);
+	}
+#elif !defined(_WIN32)
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd != -1) {
+		struct stat st;
+		if (fstat(fd, &st) == 0 && st.st_size > 0) {
+			void *p = mmap(nullptr, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+			if (p != MAP_FAILED) {
+				data_ = (u8 *)p;
+				size_ = (size_t)st.st_size;
+				mapped_ = true;
+			}
+		}
+		close(fd);
+	}
+#endif
+	if (mapped_)
+		return true;
+	if (!allowFallback)
+		return false;
+
+	// Couldn't map it, so just read it all in.
+	IOFile pFile(filename, "rb");
+	if (!pFile)
+		return false;
+	fallback_.resize((size_t)pFile.GetSize());
+	if (!fallback_.empty() && !pFile.ReadBytes(&fallback_[0], fallback_.size()))
+		return false;
+	data_ = fallback_.empty() ? nullptr : &fallback_[0];
+	size_ = fallback_.size();
+	return true;
+}
+
 } // namespace
@@ -196,4 +196,35 @@ class IOFile {
 	bool m_good;
 };
 
+// A read-only view of a whole file, mapped copy-on-write when the platform allows.
+// Otherwise the file is read into memory (unless allowFallback is false), so Data() is always usable after Open().
+class MappedFile {
+public:
+	MappedFile() {}
+	~MappedFile();
+
+	bool Open(const std::string &filename, bool allowFallback = true);
+
+	u8 *Data() {
+		return data_;
+	}
+	size_t Size() const {
+		return size_;
+	}
+	bool IsMapped() const {
+		return mapped_;
+	}
+
+private:
+	MappedFile(const MappedFile &) = delete;
+	void operator=(const MappedFile &) = delete;
+
+	u8 *data_ = nullptr;
+	size_t size_ = 0;
+	bool mapped_ = false;
+	std::vector<u8> fallback_;
+	// A HANDLE on Windows.
+	void *mapping_ = nullptr;
+};
+
 }  // namespace
@@ -3,6 +3,18 @@
 #include <cstring>
 #include <vector>
 
+#include "ppsspp_config.h"
+
+#if PPSSPP_ARCH(X86) || PPSSPP_ARCH(AMD64)
+#include <emmintrin.h>
+#elif PPSSPP_ARCH(ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 #include "ext/xxhash.h"
 #include "Common/CommonFuncs.h"
 #include "Common/Log.h"
@@ -328,3 +340,258 @@ class PrehashMap {
 	int count_ = 0;
 	int removedCount_ = 0;
 };
+
+// Hashing policies for GroupHashMap.
+template<class K>
+struct KeyHasher {
+	uint32_t operator()(const K &k) const {
+		return HashKey(k);
+	}
+};
+
+// For keys that already are well-distributed hashes, like PrehashMap's.
+struct PrehashedKey {
+	uint32_t operator()(uint32_t k) const {
+		return k;
+	}
+};
+
+// Swiss table style open addressing. Every slot has a control byte holding 7 bits of its hash
+// (or EMPTY / DELETED), and probing checks a whole group of 16 control bytes with a few SIMD ops,
+// so full keys only get compared on likely matches. Pays off for large tables with big keys,
+// where misses no longer walk long linear runs. At the sizes our caches usually have it's on par
+// with DenseHashMap, and slower than PrehashMap for prehashed keys. Same interface as DenseHashMap.
+template <class Key, class Value, Value NullValue, class Hasher = KeyHasher<Key>>
+class GroupHashMap {
+public:
+	GroupHashMap(int initialCapacity) {
+		capacity_ = GROUP_SIZE;
+		while (capacity_ < initialCapacity)
+			capacity_ *= 2;
+		map.resize(capacity_);
+		ctrl.resize(capacity_, CTRL_EMPTY);
+	}
+
+	// Returns NullValue if no entry was found.
+	Value Get(const Key &key) const {
+		uint32_t hash = Hasher()(key);
+		uint32_t groupMask = capacity_ / GROUP_SIZE - 1;
+		uint32_t g = (hash >> 7) & groupMask;
+		for (uint32_t probe = 1; probe <= groupMask + 1; probe++) {
+			const uint8_t *group = &ctrl[g * GROUP_SIZE];
+			for (uint64_t m = MatchByte(group, (uint8_t)(hash & 0x7F)); m != 0; m = ClearSlot(m)) {
+				const Pair &pair = map[g * GROUP_SIZE + FirstSlot(m)];
+				if (KeyEquals(key, pair.key))
+					return pair.value;
+			}
+			if (MatchByte(group, CTRL_EMPTY))
+				return NullValue;
+			// Triangular probing over a power of two group count visits every group.
+			g = (g + probe) & groupMask;
+		}
+		return NullValue;
+	}
+
+	// Returns false if we already had the key! Which is a bit different.
+	bool Insert(const Key &key, Value value) {
+		// Tombstones count against the load too, since they lengthen probes just the same.
+		if ((count_ + removedCount_) * 8 >= capacity_ * 7) {
+			Grow(count_ * 2 >= capacity_ ? 2 : 1);
+		}
+		uint32_t hash = Hasher()(key);
+		uint8_t h2 = (uint8_t)(hash & 0x7F);
+		uint32_t groupMask = capacity_ / GROUP_SIZE - 1;
+		uint32_t g = (hash >> 7) & groupMask;
+		int target = -1;
+		for (uint32_t probe = 1; probe <= groupMask + 1; probe++) {
+			const uint8_t *group = &ctrl[g * GROUP_SIZE];
+			for (uint64_t m = MatchByte(group, h2); m != 0; m = ClearSlot(m)) {
+				if (KeyEquals(key, map[g * GROUP_SIZE + FirstSlot(m)].key)) {
+					// Bad! We already got this one. Let's avoid this case.
+					_assert_msg_(SYSTEM, false, "GroupHashMap: Duplicate key inserted");
+					return false;
+				}
+			}
+			if (target < 0) {
+				uint64_t avail = MatchFree(group);
+				if (avail)
+					target = g * GROUP_SIZE + FirstSlot(avail);
+			}
+			if (MatchByte(group, CTRL_EMPTY))
+				break;
+			g = (g + probe) & groupMask;
+		}
+		if (target < 0) {
+			// FULL! Error. Should not happen thanks to Grow().
+			_assert_msg_(SYSTEM, false, "GroupHashMap: Hit full on Insert()");
+			return false;
+		}
+		if (ctrl[target] == CTRL_DELETED) {
+			removedCount_--;
+		}
+		ctrl[target] = h2;
+		map[target].key = key;
+		map[target].value = value;
+		count_++;
+		return true;
+	}
+
+	bool Remove(const Key &key) {
+		uint32_t hash = Hasher()(key);
+		uint32_t groupMask = capacity_ / GROUP_SIZE - 1;
+		uint32_t g = (hash >> 7) & groupMask;
+		for (uint32_t probe = 1; probe <= groupMask + 1; probe++) {
+			uint8_t *group = &ctrl[g * GROUP_SIZE];
+			for (uint64_t m = MatchByte(group, (uint8_t)(hash & 0x7F)); m != 0; m = ClearSlot(m)) {
+				int slot = FirstSlot(m);
+				if (KeyEquals(key, map[g * GROUP_SIZE + slot].key)) {
+					// Probes stop at a group with an empty slot, so no chain runs through this one
+					// and the slot can go straight back to empty.
+					if (MatchByte(group, CTRL_EMPTY)) {
+						group[slot] = CTRL_EMPTY;
+					} else {
+						group[slot] = CTRL_DELETED;
+						removedCount_++;
+					}
+					count_--;
+					return true;
+				}
+			}
+			if (MatchByte(group, CTRL_EMPTY))
+				return false;
+			g = (g + probe) & groupMask;
+		}
+		return false;
+	}
+
+	size_t size() const {
+		return count_;
+	}
+
+	template<class T>
+	inline void Iterate(T func) const {
+		for (size_t i = 0; i < map.size(); i++) {
+			if ((ctrl[i] & 0x80) == 0) {
+				func(map[i].key, map[i].value);
+			}
+		}
+	}
+
+	void Clear() {
+		memset(ctrl.data(), CTRL_EMPTY, ctrl.size());
+		count_ = 0;
+		removedCount_ = 0;
+	}
+
+	void Rebuild() {
+		Grow(1);
+	}
+
+	void Maintain() {
+		// Heuristic
+		if (removedCount_ >= capacity_ / 4) {
+			Rebuild();
+		}
+	}
+
+private:
+	enum : uint8_t {
+		CTRL_EMPTY = 0x80,
+		CTRL_DELETED = 0xFE,
+	};
+	static const int GROUP_SIZE = 16;
+
+#if PPSSPP_ARCH(ARM_NEON)
+	// NEON has no movemask, narrowing gives four bits per slot instead.
+	static const int SLOT_SHIFT = 2;
+	static const uint64_t SLOT_BITS = 0xF;
+
+	static uint64_t MatchMask(uint8x16_t eq) {
+		uint8x8_t narrowed = vshrn_n_u16(vreinterpretq_u16_u8(eq), 4);
+		return vget_lane_u64(vreinterpret_u64_u8(narrowed), 0);
+	}
+	static uint64_t MatchByte(const uint8_t *group, uint8_t b) {
+		return MatchMask(vceqq_u8(vld1q_u8(group), vdupq_n_u8(b)));
+	}
+	// Empty or deleted, the only control bytes with the top bit set.
+	static uint64_t MatchFree(const uint8_t *group) {
+		return MatchMask(vcltq_s8(vreinterpretq_s8_u8(vld1q_u8(group)), vdupq_n_s8(0)));
+	}
+#else
+	static const int SLOT_SHIFT = 0;
+	static const uint64_t SLOT_BITS = 1;
+
+#if PPSSPP_ARCH(X86) || PPSSPP_ARCH(AMD64)
+	static uint64_t MatchByte(const uint8_t *group, uint8_t b) {
+		__m128i g = _mm_loadu_si128((const __m128i *)group);
+		return (uint64_t)_mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8((char)b)));
+	}
+	static uint64_t MatchFree(const uint8_t *group) {
+		return (uint64_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)group));
+	}
+#else
+	static uint64_t MatchByte(const uint8_t *group, uint8_t b) {
+		uint64_t mask = 0;
+		for (int i = 0; i < GROUP_SIZE; i++)
+			mask |= (uint64_t)(group[i] == b) << i;
+		return mask;
+	}
+	static uint64_t MatchFree(const uint8_t *group) {
+		uint64_t mask = 0;
+		for (int i = 0; i < GROUP_SIZE; i++)
+			mask |= (uint64_t)(group[i] >> 7) << i;
+		return mask;
+	}
+#endif
+#endif
+
+	static int FirstSlot(uint64_t mask) {
+#ifdef _MSC_VER
+		unsigned long index;
+		if ((uint32_t)mask != 0) {
+			_BitScanForward(&index, (uint32_t)mask);
+		} else {
+			_BitScanForward(&index, (uint32_t)(mask >> 32));
+			index += 32;
+		}
+		return (int)index >> SLOT_SHIFT;
+#else
+		return __builtin_ctzll(mask) >> SLOT_SHIFT;
+#endif
+	}
+	static uint64_t ClearSlot(uint64_t mask) {
+		return mask & ~(SLOT_BITS << (FirstSlot(mask) << SLOT_SHIFT));
+	}
+
+	void Grow(int factor) {
+		// We simply move out the existing data, then we re-insert the old.
+		// This is extremely non-atomic and will need synchronization.
+		std::vector<Pair> old = std::move(map);
+		std::vector<uint8_t> oldCtrl = std::move(ctrl);
+		// Can't assume move will clear, it just may clear.
+		map.clear();
+		ctrl.clear();
+
+		int oldCount = count_;
+		capacity_ *= factor;
+		map.resize(capacity_);
+		ctrl.resize(capacity_, CTRL_EMPTY);
+		count_ = 0;  // Insert will update it.
+		removedCount_ = 0;
+		for (size_t i = 0; i < old.size(); i++) {
+			if ((oldCtrl[i] & 0x80) == 0) {
+				Insert(old[i].key, old[i].value);
+			}
+		}
+		_assert_msg_(SYSTEM, oldCount == count_, "GroupHashMap: count should not change in Grow()");
+	}
+	struct Pair {
+		Key key;
+		Value value;
+	};
+	std::vector<Pair> map;
+	std::vector<uint8_t> ctrl;
+	int capacity_;
+	int count_ = 0;
+	int removedCount_ = 0;
+};
@@ -18,8 +18,13 @@
 #include "ppsspp_config.h"
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <thread>
 
 #include "base/logging.h"
+#include "thread/threadutil.h"
 #include "util/text/utf8.h"
 #include "LogManager.h"
 #include "ConsoleListener.h"
@@ -74,6 +79,146 @@ void AndroidAssertLog(const char *func, const char *file, int line, const char *
 
 LogManager *LogManager::logManager_ = NULL;
 
+// A bounded lock-free queue of log messages (Vyukov's MPMC ring, here with one consumer.)
+// Callers claim a slot, take the time and format the message text into it, and that's all.
+// The header, listeners, and file writes happen on the log thread.  When full, messages are
+// dropped and counted rather than blocking the emulator.
+class AsyncLogQueue {
+public:
+	AsyncLogQueue(LogManager *manager) : manager_(manager) {
+		for (u32 i = 0; i < QUEUE_SIZE; ++i)
+			records_[i].sequence.store(i, std::memory_order_relaxed);
+		thread_ = std::thread([this] { ThreadFunc(); });
+	}
+
+	// Anything already queued still gets written.
+	~AsyncLogQueue() {
+		stop_ = true;
+		wakeCond_.notify_one();
+		thread_.join();
+	}
+
+	void Push(LogTypes::LOG_LEVELS level, LogTypes::LOG_TYPE type, const char *file, int line, const char *format, va_list args) {
+		u32 pos = enqueuePos_.load(std::memory_order_relaxed);
+		Record *r;
+		while (true) {
+			r = &records_[pos & (QUEUE_SIZE - 1)];
+			const u32 seq = r->sequence.load(std::memory_order_acquire);
+			const s32 diff = (s32)(seq - pos);
+			if (diff == 0) {
+				if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			} else if (diff < 0) {
+				dropped_.fetch_add(1, std::memory_order_relaxed);
+				return;
+			} else {
+				pos = enqueuePos_.load(std::memory_order_relaxed);
+			}
+		}
+
+		r->level = level;
+		r->type = type;
+		r->file = file;
+		r->line = line;
+		Common::Timer::GetTimeNow(&r->seconds, &r->millis);
+		// The thread might be gone by the time we write this out.
+		r->hasThreadName = hleCurrentThreadName != nullptr;
+		if (r->hasThreadName)
+			truncate_cpy(r->threadName, hleCurrentThreadName);
+		int len = vsnprintf(r->msg, sizeof(r->msg), format, args);
+		if (len < 0)
+			len = 0;
+		r->msgLen = std::min(len, (int)sizeof(r->msg) - 1);
+		r->sequence.store(pos + 1, std::memory_order_release);
+
+		if (sleeping_.load(std::memory_order_acquire))
+			wakeCond_.notify_one();
+	}
+
+	u32 DroppedCount() const {
+		return dropped_.load(std::memory_order_relaxed);
+	}
+
+private:
+	struct Record {
+		std::atomic<u32> sequence;
+		LogTypes::LOG_LEVELS level;
+		LogTypes::LOG_TYPE type;
+		const char *file;
+		int line;
+		s64 seconds;
+		int millis;
+		bool hasThreadName;
+		char threadName[16];
+		int msgLen;
+		char msg[1024];
+	};
+
+	bool PopOne() {
+		Record &r = records_[dequeuePos_ & (QUEUE_SIZE - 1)];
+		const u32 seq = r.sequence.load(std::memory_order_acquire);
+		if (seq != dequeuePos_ + 1)
+			return false;
+
+		char formattedTime[13];
+		Common::Timer::FormatTime(r.seconds, r.millis, formattedTime);
+		manager_->Dispatch(r.level, r.type, r.file, r.line, r.hasThreadName ? r.threadName : nullptr, formattedTime, r.msg, r.msgLen);
+
+		r.sequence.store(dequeuePos_ + QUEUE_SIZE, std::memory_order_release);
+		dequeuePos_++;
+		return true;
+	}
+
+	void ReportDropped() {
+		const u32 dropped = dropped_.load(std::memory_order_relaxed);
+		if (dropped == reportedDropped_)
+			return;
+
+		char msg[64];
+		int len = snprintf(msg, sizeof(msg), "(%u log messages dropped, log queue was full)", dropped - reportedDropped_);
+		reportedDropped_ = dropped;
+		char formattedTime[13];
+		Common::Timer::GetTimeFormatted(formattedTime);
+		manager_->Dispatch(LogTypes::LWARNING, LogTypes::COMMON, __FILE__, __LINE__, nullptr, formattedTime, msg, len);
+	}
+
+	void ThreadFunc() {
+		setCurrentThreadName("Log");
+
+		while (true) {
+			if (PopOne())
+				continue;
+			ReportDropped();
+			if (stop_)
+				break;
+
+			std::unique_lock<std::mutex> guard(wakeLock_);
+			sleeping_ = true;
+			// Check again, in case a message landed before the flag was set.  The timeout covers the rest.
+			const Record &next = records_[dequeuePos_ & (QUEUE_SIZE - 1)];
+			if (next.sequence.load(std::memory_order_acquire) != dequeuePos_ + 1 && !stop_)
+				wakeCond_.wait_for(guard, std::chrono::milliseconds(50));
+			sleeping_ = false;
+		}
+	}
+
+	enum { QUEUE_SIZE = 1024 };
+
+	LogManager *manager_;
+	Record records_[QUEUE_SIZE];
+	std::atomic<u32> enqueuePos_{ 0 };
+	// Only touched by the log thread.
+	u32 dequeuePos_ = 0;
+	std::atomic<u32> dropped_{ 0 };
+	u32 reportedDropped_ = 0;
+
+	std::atomic<bool> sleeping_{ false };
+	std::atomic<bool> stop_{ false };
+	std::mutex wakeLock_;
+	std::condition_variable wakeCond_;
+	std::thread thread_;
+};
+
 struct LogNameTableEntry {
 	LogTypes::LOG_TYPE logType;
 	const char *name;
@@ -150,9 +295,15 @@ LogManager::LogManager() {
 #endif
 	AddListener(ringLog_);
 #endif
+
+	queue_ = new AsyncLogQueue(this);
 }
 
 LogManager::~LogManager() {
+	// Flush what's queued before the listeners go away.
+	delete queue_;
+	queue_ = nullptr;
+
 	for (int i = 0; i < LogTypes::NUMBER_OF_LOGS; ++i) {
 #if !defined(MOBILE_DEVICE) || defined(_DEBUG)
 		RemoveListener(fileLog_);
@@ -208,6 +359,36 @@ void LogManager::Log(LogTypes::LOG_LEVELS level, LogTypes::LOG_TYPE type, const
 	if (level > log.level || !log.enabled)
 		return;
 
+	if (queue_) {
+		queue_->Push(level, type, file, line, format, args);
+		return;
+	}
+
+	// Only during startup and shutdown.
+	char formattedTime[13];
+	Common::Timer::GetTimeFormatted(formattedTime);
+
+	char msgBuf[1024];
+	std::string longMsg;
+	va_list args_copy;
+
+	va_copy(args_copy, args);
+	size_t neededBytes = vsnprintf(msgBuf, sizeof(msgBuf), format, args);
+	const char *msg = msgBuf;
+	if (neededBytes >= sizeof(msgBuf)) {
+		// Needed more space? Re-run vsnprintf.
+		longMsg.resize(neededBytes + 1);
+		vsnprintf(&longMsg[0], neededBytes + 1, format, args_copy);
+		msg = longMsg.c_str();
+	}
+	va_end(args_copy);
+
+	Dispatch(level, type, file, line, hleCurrentThreadName, formattedTime, msg, neededBytes);
+}
+
+void LogManager::Dispatch(LogTypes::LOG_LEVELS level, LogTypes::LOG_TYPE type, const char *file, int line, const char *threadName, const char *formattedTime, const char *msg, size_t msgLen) {
+	const LogChannel &log = log_[type];
+
 	LogMessage message;
 	message.level = level;
 	message.log = log.m_shortName;
@@ -225,41 +406,25 @@ void LogManager::Log(LogTypes::LOG_LEVELS level, LogTypes::LOG_TYPE type, const
 		if (fileshort != file)
 			file = fileshort + 1;
 	}
-	
-	char formattedTime[13];
 
 	std::lock_guard<std::mutex> lk(log_lock_);
-	Common::Timer::GetTimeFormatted(formattedTime);
 
-	size_t prefixLen;
-	if (hleCurrentThreadName) {
-		prefixLen = snprintf(message.header, sizeof(message.header), "%s %-12.12s %c[%s]: %s:%d",
+	if (threadName) {
+		snprintf(message.header, sizeof(message.header), "%s %-12.12s %c[%s]: %s:%d",
 			formattedTime,
-			hleCurrentThreadName, level_to_char[(int)level],
+			threadName, level_to_char[(int)level],
 			log.m_shortName,
 			file, line);
 	} else {
-		prefixLen = snprintf(message.header, sizeof(message.header), "%s %s:%d %c[%s]:",
+		snprintf(message.header, sizeof(message.header), "%s %s:%d %c[%s]:",
 			formattedTime,
 			file, line, level_to_char[(int)level],
 			log.m_shortName);
 	}
 
-	char msgBuf[1024];
-	va_list args_copy;
-
-	va_copy(args_copy, args);
-	size_t neededBytes = vsnprintf(msgBuf, sizeof(msgBuf), format, args);
-	if (neededBytes > sizeof(msgBuf)) {
-		// Needed more space? Re-run vsnprintf.
-		message.msg.resize(neededBytes + 1);
-		vsnprintf(&message.msg[0], neededBytes + 1, format, args_copy);
-	} else {
-		message.msg.resize(neededBytes + 1);
-		memcpy(&message.msg[0], msgBuf, neededBytes);
-	}
-	message.msg[message.msg.size() - 1] = '\n';
-	va_end(args_copy);
+	message.msg.resize(msgLen + 1);
+	memcpy(&message.msg[0], msg, msgLen);
+	message.msg[msgLen] = '\n';
 
 	std::lock_guard<std::mutex> listeners_lock(listeners_lock_);
 	for (auto &iter : listeners_) {
@@ -267,6 +432,10 @@ void LogManager::Log(LogTypes::LOG_LEVELS level, LogTypes::LOG_TYPE type, const
 	}
 }
 
+u32 LogManager::GetDroppedCount() const {
+	return queue_ ? queue_->DroppedCount() : 0;
+}
+
 bool LogManager::IsEnabled(LogTypes::LOG_LEVELS level, LogTypes::LOG_TYPE type) {
 	LogChannel &log = log_[type];
 	if (level > log.level || !log.enabled)
@@ -102,6 +102,7 @@ struct LogChannel {
 };
 
 class ConsoleListener;
+class AsyncLogQueue;
 
 class LogManager {
 private:
@@ -122,6 +123,13 @@ class LogManager {
 	std::mutex log_lock_;
 	std::mutex listeners_lock_;
 	std::vector<LogListener*> listeners_;
+	// Listeners (file writes especially) run on a thread, callers only queue the message.
+	AsyncLogQueue *queue_ = nullptr;
+
+	friend class AsyncLogQueue;
+	void Dispatch(LogTypes::LOG_LEVELS level, LogTypes::LOG_TYPE type, const char *file, int line,
+		const char *threadName, const char *formattedTime, const char *msg, size_t msgLen);
+
 public:
 	void AddListener(LogListener *listener);
 	void RemoveListener(LogListener *listener);
@@ -132,6 +140,8 @@ class LogManager {
 	void Log(LogTypes::LOG_LEVELS level, LogTypes::LOG_TYPE type, 
 			 const char *file, int line, const char *fmt, va_list args);
 	bool IsEnabled(LogTypes::LOG_LEVELS level, LogTypes::LOG_TYPE type);
+	// Messages dropped because the queue was full, since startup.
+	u32 GetDroppedCount() const;
 
 	LogChannel *GetLogChannel(LogTypes::LOG_TYPE type) {
 		return &log_[type];
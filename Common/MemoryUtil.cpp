@@ -33,6 +33,7 @@
 #ifdef __APPLE__
 #include <sys/types.h>
 #include <sys/mman.h>
+#include <sys/sysctl.h>
 #include <mach/vm_param.h>
 #endif
 
@@ -348,3 +349,42 @@ int GetMemoryProtectPageSize() {
 #endif
 	return MEM_PAGE_SIZE;
 }
+
+uint64_t GetPhysicalMemoryBytes() {
+#if defined(_WIN32)
+	MEMORYSTATUSEX status{};
+	status.dwLength = sizeof(status);
+	if (GlobalMemoryStatusEx(&status))
+		return status.ullTotalPhys;
+	return 0;
+#elif defined(__APPLE__)
+	uint64_t size = 0;
+	size_t len = sizeof(size);
+	if (sysctlbyname("hw.memsize", &size, &len, nullptr, 0) == 0)
+		return size;
+	return 0;
+#elif defined(_SC_PHYS_PAGES)
+	long pages = sysconf(_SC_PHYS_PAGES);
+	if (pages <= 0)
+		return 0;
+	return (uint64_t)pages * (uint64_t)MEM_PAGE_SIZE;
+#else
+	return 0;
+#endif
+}
+
+uint64_t GetResidentMemoryBytes() {
+#if defined(__linux__)
+	FILE *f = fopen("/proc/self/statm", "r");
+	if (!f)
+		return 0;
+	unsigned long long total = 0, resident = 0;
+	int found = fscanf(f, "%llu %llu", &total, &resident);
+	fclose(f);
+	if (found != 2)
+		return 0;
+	return resident * (uint64_t)MEM_PAGE_SIZE;
+#else
+	return 0;
+#endif
+}
@@ -45,6 +45,11 @@ void FreeAlignedMemory(void* ptr);
 
 int GetMemoryProtectPageSize();
 
+// Both return 0 where unknown.
+uint64_t GetPhysicalMemoryBytes();
+// What the process actually has in RAM, as opposed to reserved address space.
+uint64_t GetResidentMemoryBytes();
+
 template <typename T>
 class SimpleBuf {
 public:
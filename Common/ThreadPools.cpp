@@ -3,16 +3,31 @@
 #include "../Core/Config.h"
 
 std::shared_ptr<ThreadPool> GlobalThreadPool::pool;
-bool  GlobalThreadPool::initialized = false;
+std::once_flag GlobalThreadPool::initialized;
 
 void GlobalThreadPool::Loop(const std::function<void(int,int)>& loop, int lower, int upper) {
 	Inititialize();
 	pool->ParallelLoop(loop, lower, upper);
 }
 
+void GlobalThreadPool::Loop(const std::function<void(int,int)>& loop, int lower, int upper, int minGrain) {
+	Inititialize();
+	pool->ParallelLoop(loop, lower, upper, minGrain);
+}
+
+void GlobalThreadPool::Run(TaskGroup &group, const std::function<void()> &task, TaskPriority priority) {
+	Inititialize();
+	pool->Run(group, task, priority);
+}
+
+void GlobalThreadPool::Wait(TaskGroup &group) {
+	Inititialize();
+	pool->Wait(group);
+}
+
 void GlobalThreadPool::Inititialize() {
-	if(!initialized) {
+	// Several threads may now run loops at once, so this needs to be safe too.
+	std::call_once(initialized, [] {
 		pool = std::make_shared<ThreadPool>(g_Config.iNumWorkerThreads);
-		initialized = true;
-	}
+	});
 }
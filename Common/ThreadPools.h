@@ -7,9 +7,15 @@ class GlobalThreadPool {
 	// will execute slices of "loop" from "lower" to "upper"
 	// in parallel on the global thread pool
 	static void Loop(const std::function<void(int,int)>& loop, int lower, int upper);
+	// Same, but slices will be at least minGrain long.  Use for cheap iterations.
+	static void Loop(const std::function<void(int,int)>& loop, int lower, int upper, int minGrain);
+
+	// Queues a task on the global pool, to be joined with Wait().
+	static void Run(TaskGroup &group, const std::function<void()> &task, TaskPriority priority = TaskPriority::NORMAL);
+	static void Wait(TaskGroup &group);
 
 private:
 	static std::shared_ptr<ThreadPool> pool;
-	static bool initialized;
+	static std::once_flag initialized;
 	static void Inititialize();
 };
@@ -196,27 +196,40 @@ u64 Timer::GetLocalTimeSinceJan1970()
 // in the form 00:00:000.
 void Timer::GetTimeFormatted(char formattedTime[13])
 {
-	time_t sysTime;
-	struct tm * gmTime;
-	char tmp[13];
-
-	time(&sysTime);
-	gmTime = localtime(&sysTime);
-
-	strftime(tmp, 6, "%M:%S", gmTime);
+	s64 seconds;
+	int millis;
+	GetTimeNow(&seconds, &millis);
+	FormatTime(seconds, millis, formattedTime);
+}
 
-	// Now tack on the milliseconds
+void Timer::GetTimeNow(s64 *seconds, int *millis)
+{
 #ifdef _WIN32
 	struct timeb tp;
 	(void)::ftime(&tp);
-	snprintf(formattedTime, 13, "%s:%03i", tmp, tp.millitm);
+	*seconds = tp.time;
+	*millis = tp.millitm;
 #else
 	struct timeval t;
 	(void)gettimeofday(&t, NULL);
-	snprintf(formattedTime, 13, "%s:%03d", tmp, (int)(t.tv_usec / 1000));
+	*seconds = t.tv_sec;
+	*millis = (int)(t.tv_usec / 1000);
 #endif
 }
 
+void Timer::FormatTime(s64 seconds, int millis, char formattedTime[13])
+{
+	time_t sysTime = (time_t)seconds;
+	struct tm * gmTime;
+	char tmp[13];
+
+	gmTime = localtime(&sysTime);
+	strftime(tmp, 6, "%M:%S", gmTime);
+
+	// Now tack on the milliseconds
+	snprintf(formattedTime, 13, "%s:%03d", tmp, millis);
+}
+
 // Returns a timestamp with decimals for precise time comparisons
 // ----------------
 double Timer::GetDoubleTime()
@@ -43,6 +43,9 @@ class Timer
 	static double GetDoubleTime();
 
   static void GetTimeFormatted(char formattedTime[13]);
+	// GetTimeFormatted() in two steps, so loggers can take the time now and format it later.
+	static void GetTimeNow(s64 *seconds, int *millis);
+	static void FormatTime(s64 seconds, int millis, char formattedTime[13]);
 	std::string GetTimeElapsedFormatted() const;
 	u64 GetTimeElapsed() const;
 
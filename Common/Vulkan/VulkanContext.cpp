@@ -1,4 +1,5 @@
 #define __STDC_LIMIT_MACROS
+#include <algorithm>
 #include <cstdlib>
 #include <cstdint>
 #include <assert.h>
@@ -81,6 +82,18 @@ const char *PresentModeString(VkPresentModeKHR presentMode) {
 	}
 }
 
+const char *SurfaceTransformString(VkSurfaceTransformFlagBitsKHR transform) {
+	switch (transform) {
+	case VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR: return "IDENTITY";
+	case VK_SURFACE_TRANSFORM_ROTATE_90_BIT_KHR: return "ROTATE_90";
+	case VK_SURFACE_TRANSFORM_ROTATE_180_BIT_KHR: return "ROTATE_180";
+	case VK_SURFACE_TRANSFORM_ROTATE_270_BIT_KHR: return "ROTATE_270";
+	case VK_SURFACE_TRANSFORM_HORIZONTAL_MIRROR_BIT_KHR: return "MIRROR";
+	case VK_SURFACE_TRANSFORM_INHERIT_BIT_KHR: return "INHERIT";
+	default: return "OTHER";
+	}
+}
+
 VulkanContext::VulkanContext() {
 #if SIMULATE_VULKAN_FAILURE == 1
 	return;
@@ -521,6 +534,9 @@ void VulkanContext::ChooseDevice(int physical_device) {
 	if (featuresAvailable_.samplerAnisotropy) {
 		featuresEnabled_.samplerAnisotropy = true;
 	}
+	if (featuresAvailable_.textureCompressionBC) {
+		featuresEnabled_.textureCompressionBC = true;
+	}
 	// For easy wireframe mode, someday.
 	if (featuresEnabled_.fillModeNonSolid) {
 		featuresEnabled_.fillModeNonSolid = true;
@@ -562,6 +578,7 @@ VkResult VulkanContext::CreateDevice() {
 	assert(found);
 
 	deviceExtensionsLookup_.DEDICATED_ALLOCATION = EnableDeviceExtension(VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME);
+	deviceExtensionsLookup_.EXT_SHADER_STENCIL_EXPORT = EnableDeviceExtension(VK_EXT_SHADER_STENCIL_EXPORT_EXTENSION_NAME);
 
 	VkDeviceCreateInfo device_info{ VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO };
 	device_info.queueCreateInfoCount = 1;
@@ -832,6 +849,10 @@ bool VulkanContext::InitSwapchain() {
 	for (size_t i = 0; i < presentModeCount; i++) {
 		ILOG("Supported present mode: %d (%s)", presentModes[i], PresentModeString(presentModes[i]));
 	}
+	if (flags_ & VULKAN_FLAG_PRESENT_FIFO) {
+		// Required to be supported, so no need to look for it.
+		swapchainPresentMode = VK_PRESENT_MODE_FIFO_KHR;
+	}
 	for (size_t i = 0; i < presentModeCount; i++) {
 		if (swapchainPresentMode == VK_PRESENT_MODE_MAX_ENUM_KHR) {
 			// Default to the first present mode from the list.
@@ -850,30 +871,32 @@ bool VulkanContext::InitSwapchain() {
 			break;
 		}
 	}
-#ifdef __ANDROID__
-	// HACK
-	swapchainPresentMode = VK_PRESENT_MODE_FIFO_KHR;
-#endif
 	ILOG("Chosen present mode: %d (%s)", swapchainPresentMode, PresentModeString(swapchainPresentMode));
 	delete[] presentModes;
 	// Determine the number of VkImage's to use in the swap chain (we desire to
 	// own only 1 image at a time, besides the images being displayed and
-	// queued for display):
+	// queued for display), unless asked for a specific count:
 	uint32_t desiredNumberOfSwapChainImages = surfCapabilities_.minImageCount + 1;
-	ILOG("numSwapChainImages: %d", desiredNumberOfSwapChainImages);
+	if (desiredSwapchainImages_ > 0) {
+		desiredNumberOfSwapChainImages = std::max((uint32_t)desiredSwapchainImages_, surfCapabilities_.minImageCount);
+	}
 	if ((surfCapabilities_.maxImageCount > 0) &&
 		(desiredNumberOfSwapChainImages > surfCapabilities_.maxImageCount))
 	{
 		// Application must settle for fewer images than desired:
 		desiredNumberOfSwapChainImages = surfCapabilities_.maxImageCount;
 	}
+	ILOG("numSwapChainImages: %d", desiredNumberOfSwapChainImages);
 
+	// We don't rotate what we draw, so when the display is rotated (like on most Android
+	// devices in landscape), the compositor has to.  Log it so it shows up in reports.
 	VkSurfaceTransformFlagBitsKHR preTransform;
 	if (surfCapabilities_.supportedTransforms & VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR) {
 		preTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
 	} else {
 		preTransform = surfCapabilities_.currentTransform;
 	}
+	ILOG("Surface transform: %s, using %s", SurfaceTransformString(surfCapabilities_.currentTransform), SurfaceTransformString(preTransform));
 
 	VkSwapchainCreateInfoKHR swap_chain_info = { VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR };
 	swap_chain_info.surface = surface_;
@@ -915,6 +938,10 @@ bool VulkanContext::InitSwapchain() {
 		return false;
 	}
 
+	presentMode_ = swapchainPresentMode;
+	swapchainImageCount_ = desiredNumberOfSwapChainImages;
+	preTransform_ = preTransform;
+
 	return true;
 }
 
@@ -13,8 +13,21 @@ enum {
 	VULKAN_FLAG_PRESENT_MAILBOX = 2,
 	VULKAN_FLAG_PRESENT_IMMEDIATE = 4,
 	VULKAN_FLAG_PRESENT_FIFO_RELAXED = 8,
+	// FIFO is always available, this just makes it win over the first mode in the list.
+	VULKAN_FLAG_PRESENT_FIFO = 16,
 };
 
+// Maps the VulkanPresentMode setting (0 = the platform's default, 1 = FIFO, 2 = FIFO_RELAXED, 3 = MAILBOX)
+// to present flags, each falling back to FIFO where it's not supported.
+inline uint32_t VulkanPresentModeFlags(int mode, uint32_t defaultFlags) {
+	switch (mode) {
+	case 1: return VULKAN_FLAG_PRESENT_FIFO;
+	case 2: return VULKAN_FLAG_PRESENT_FIFO_RELAXED | VULKAN_FLAG_PRESENT_FIFO;
+	case 3: return VULKAN_FLAG_PRESENT_MAILBOX | VULKAN_FLAG_PRESENT_FIFO;
+	default: return defaultFlags;
+	}
+}
+
 enum {
 	VULKAN_VENDOR_NVIDIA = 0x000010de,
 	VULKAN_VENDOR_INTEL = 0x00008086,   // Haha!
@@ -25,6 +38,8 @@ enum {
 };
 
 std::string VulkanVendorString(uint32_t vendorId);
+const char *PresentModeString(VkPresentModeKHR presentMode);
+const char *SurfaceTransformString(VkSurfaceTransformFlagBitsKHR transform);
 
 // Not all will be usable on all platforms, of course...
 enum WindowSystem {
@@ -104,6 +119,7 @@ class VulkanDeleteList {
 // For fast extension-enabled checks.
 struct VulkanDeviceExtensions {
 	bool DEDICATED_ALLOCATION;
+	bool EXT_SHADER_STENCIL_EXPORT;
 };
 
 // Useful for debugging on ARM Mali. This eliminates transaction elimination
@@ -181,6 +197,13 @@ class VulkanContext {
 	int GetGraphicsQueueFamilyIndex() const {
 		return graphics_queue_family_index_;
 	}
+	const VkQueueFamilyProperties &GetQueueFamilyProperties(int family) const {
+		return queue_props[family];
+	}
+
+	const VkPhysicalDeviceMemoryProperties &GetMemoryProperties() const {
+		return memory_properties;
+	}
 
 	const VkPhysicalDeviceProperties &GetPhysicalDeviceProperties() {
 		return gpu_props;
@@ -203,6 +226,13 @@ class VulkanContext {
 	const VulkanPhysicalDeviceInfo &GetDeviceInfo() const { return deviceInfo_; }
 	const VkSurfaceCapabilitiesKHR &GetSurfaceCapabilities() const { return surfCapabilities_; }
 
+	// 0 picks one more than the surface's minimum. Applies the next time the swapchain is created.
+	void SetDesiredSwapchainImages(int count) { desiredSwapchainImages_ = count; }
+	// What the current swapchain was created with.
+	VkPresentModeKHR GetPresentMode() const { return presentMode_; }
+	uint32_t GetSwapchainImageCount() const { return swapchainImageCount_; }
+	VkSurfaceTransformFlagBitsKHR GetPreTransform() const { return preTransform_; }
+
 	bool IsInstanceExtensionAvailable(const char *name) const {
 		for (auto &iter : instance_extension_properties_) {
 			if (!strcmp(name, iter.extensionName))
@@ -310,6 +340,10 @@ class VulkanContext {
 
 	VkSwapchainKHR swapchain_ = VK_NULL_HANDLE;
 	VkFormat swapchainFormat_;
+	int desiredSwapchainImages_ = 0;
+	VkPresentModeKHR presentMode_ = VK_PRESENT_MODE_FIFO_KHR;
+	uint32_t swapchainImageCount_ = 0;
+	VkSurfaceTransformFlagBitsKHR preTransform_ = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
 
 	uint32_t queue_count = 0;
 
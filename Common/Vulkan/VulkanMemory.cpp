@@ -18,6 +18,9 @@
 // Additionally, Common/Vulkan/* , including this file, are also licensed
 // under the public domain.
 
+#include <algorithm>
+#include <iterator>
+
 #include "Common/Log.h"
 #include "Common/Vulkan/VulkanMemory.h"
 #include "math/math_util.h"
@@ -206,23 +209,24 @@ size_t VulkanDeviceAllocator::Allocate(const VkMemoryRequirements &reqs, VkDevic
 	size_t align = reqs.alignment <= SLAB_GRAIN_SIZE ? 1 : (size_t)(reqs.alignment >> SLAB_GRAIN_SHIFT);
 	size_t blocks = (size_t)((size + SLAB_GRAIN_SIZE - 1) >> SLAB_GRAIN_SHIFT);
 
-	const size_t numSlabs = slabs_.size();
-	for (size_t i = 0; i < numSlabs; ++i) {
-		// We loop starting at the last successful allocation.
-		// This helps us "creep forward", and also spend less time allocating.
-		const size_t actualSlab = (lastSlab_ + i) % numSlabs;
-		Slab &slab = slabs_[actualSlab];
-		size_t start = slab.nextFree;
-
-		while (start < slab.usage.size()) {
-			start = (start + align - 1) & ~(align - 1);
-			if (AllocateFromSlab(slab, start, blocks)) {
-				// Allocated?  Great, let's return right away.
-				*deviceMemory = slab.deviceMemory;
-				lastSlab_ = actualSlab;
-				return start << SLAB_GRAIN_SHIFT;
-			}
-		} 
+	// Try the fullest slabs first. That way the emptier ones tend to drain over time as textures
+	// come and go, and Decimate() can give them back, which keeps fragmentation from building up.
+	std::vector<size_t> order;
+	order.reserve(slabs_.size());
+	for (size_t i = 0; i < slabs_.size(); ++i) {
+		order.push_back(i);
+	}
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+		return slabs_[a].usedBlocks > slabs_[b].usedBlocks;
+	});
+
+	for (size_t index : order) {
+		Slab &slab = slabs_[index];
+		size_t start;
+		if (AllocateFromSlab(slab, start, blocks, align)) {
+			*deviceMemory = slab.deviceMemory;
+			return start << SLAB_GRAIN_SHIFT;
+		}
 	}
 
 	// Okay, we couldn't fit it into any existing slabs.  We need a new one.
@@ -232,10 +236,9 @@ size_t VulkanDeviceAllocator::Allocate(const VkMemoryRequirements &reqs, VkDevic
 
 	// Guaranteed to be the last one, unless it failed to allocate.
 	Slab &slab = slabs_[slabs_.size() - 1];
-	size_t start = 0;
-	if (AllocateFromSlab(slab, start, blocks)) {
+	size_t start;
+	if (AllocateFromSlab(slab, start, blocks, align)) {
 		*deviceMemory = slab.deviceMemory;
-		lastSlab_ = slabs_.size() - 1;
 		return start << SLAB_GRAIN_SHIFT;
 	}
 
@@ -243,53 +246,96 @@ size_t VulkanDeviceAllocator::Allocate(const VkMemoryRequirements &reqs, VkDevic
 	return ALLOCATE_FAILED;
 }
 
-bool VulkanDeviceAllocator::AllocateFromSlab(Slab &slab, size_t &start, size_t blocks) {
+// Best fit among the free ranges of the slab.
+bool VulkanDeviceAllocator::AllocateFromSlab(Slab &slab, size_t &start, size_t blocks, size_t align) {
 	assert(!destroyed_);
-	bool matched = true;
 
-	if (start + blocks > slab.usage.size()) {
-		start = slab.usage.size();
+	auto best = slab.freeRanges.end();
+	size_t bestStart = 0;
+	size_t bestWaste = (size_t)-1;
+	for (auto it = slab.freeRanges.begin(); it != slab.freeRanges.end(); ++it) {
+		size_t alignedStart = (it->first + align - 1) & ~(align - 1);
+		size_t end = it->first + it->second;
+		if (alignedStart + blocks > end) {
+			continue;
+		}
+		size_t waste = it->second - blocks;
+		if (waste < bestWaste) {
+			best = it;
+			bestStart = alignedStart;
+			bestWaste = waste;
+			if (waste == 0) {
+				break;
+			}
+		}
+	}
+	if (best == slab.freeRanges.end()) {
 		return false;
 	}
 
-	for (size_t i = 0; i < blocks; ++i) {
-		if (slab.usage[start + i]) {
-			// If we just ran into one, there's probably an allocation size.
-			auto it = slab.allocSizes.find(start + i);
-			if (it != slab.allocSizes.end()) {
-				start += i + it->second;
-			} else {
-				// We don't know how big it is, so just skip to the next one.
-				start += i + 1;
-			}
-			return false;
-		}
+	// Carve the allocation out of the range, giving back what's left on either side.
+	size_t rangeStart = best->first;
+	size_t rangeEnd = best->first + best->second;
+	slab.freeRanges.erase(best);
+	if (bestStart > rangeStart) {
+		slab.freeRanges[rangeStart] = bestStart - rangeStart;
+	}
+	if (bestStart + blocks < rangeEnd) {
+		slab.freeRanges[bestStart + blocks] = rangeEnd - (bestStart + blocks);
 	}
 
-	// Okay, this run is good.  Actually mark it.
 	for (size_t i = 0; i < blocks; ++i) {
-		slab.usage[start + i] = 1;
-	}
-	slab.nextFree = start + blocks;
-	if (slab.nextFree >= slab.usage.size()) {
-		slab.nextFree = 0;
+		slab.usage[bestStart + i] = 1;
 	}
+	slab.usedBlocks += blocks;
 
 	// Remember the size so we can free.
-	slab.allocSizes[start] = blocks;
+	slab.allocSizes[bestStart] = blocks;
+	start = bestStart;
 	return true;
 }
 
+void VulkanDeviceAllocator::AddFreeRange(Slab &slab, size_t start, size_t blocks) {
+	auto next = slab.freeRanges.lower_bound(start);
+	if (next != slab.freeRanges.begin()) {
+		auto prev = std::prev(next);
+		if (prev->first + prev->second == start) {
+			start = prev->first;
+			blocks += prev->second;
+			slab.freeRanges.erase(prev);
+		}
+	}
+	if (next != slab.freeRanges.end() && start + blocks == next->first) {
+		blocks += next->second;
+		slab.freeRanges.erase(next);
+	}
+	slab.freeRanges[start] = blocks;
+}
+
 int VulkanDeviceAllocator::ComputeUsagePercent() const {
-	int blockSum = 0;
-	int blocksUsed = 0;
+	size_t blockSum = 0;
+	size_t blocksUsed = 0;
 	for (size_t i = 0; i < slabs_.size(); i++) {
-		blockSum += (int)slabs_[i].usage.size();
-		for (size_t j = 0; j < slabs_[i].usage.size(); j++) {
-			blocksUsed += slabs_[i].usage[j] != 0 ? 1 : 0;
-		}
+		blockSum += slabs_[i].usage.size();
+		blocksUsed += slabs_[i].usedBlocks;
+	}
+	return blockSum == 0 ? 0 : (int)(100 * blocksUsed / blockSum);
+}
+
+VkDeviceSize VulkanDeviceAllocator::GetTotalSlabBytes() const {
+	VkDeviceSize total = 0;
+	for (const Slab &slab : slabs_) {
+		total += slab.Size();
+	}
+	return total;
+}
+
+VkDeviceSize VulkanDeviceAllocator::GetHeapSize() const {
+	if (memoryTypeIndex_ == UNDEFINED_MEMORY_TYPE) {
+		return 0;
 	}
-	return blockSum == 0 ? 0 : 100 * blocksUsed / blockSum;
+	const VkPhysicalDeviceMemoryProperties &props = vulkan_->GetMemoryProperties();
+	return props.memoryHeaps[props.memoryTypes[memoryTypeIndex_].heapIndex].size;
 }
 
 std::vector<uint8_t> VulkanDeviceAllocator::GetSlabUsage(int slabIndex) const {
@@ -357,6 +403,8 @@ void VulkanDeviceAllocator::ExecuteFree(FreeInfo *userdata) {
 				slab.usage[start + i] = 0;
 			}
 			slab.allocSizes.erase(it);
+			slab.usedBlocks -= size;
+			AddFreeRange(slab, start, size);
 		} else {
 			// Ack, a double free?
 			_assert_msg_(G3D, false, "Double free? Block missing at offset %d", (int)userdata->offset);
@@ -398,6 +446,7 @@ bool VulkanDeviceAllocator::AllocateSlab(VkDeviceSize minBytes) {
 	Slab &slab = slabs_[slabs_.size() - 1];
 	slab.deviceMemory = deviceMemory;
 	slab.usage.resize((size_t)(alloc.allocationSize >> SLAB_GRAIN_SHIFT));
+	slab.freeRanges[0] = slab.usage.size();
 
 	return true;
 }
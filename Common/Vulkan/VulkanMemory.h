@@ -1,5 +1,6 @@
 #pragma once
 
+#include <map>
 #include <vector>
 #include <unordered_map>
 #include "Common/Vulkan/VulkanContext.h"
@@ -153,6 +154,10 @@ class VulkanDeviceAllocator {
 	int ComputeUsagePercent() const;
 	std::vector<uint8_t> GetSlabUsage(int slab) const;
 
+	// Bytes held in slabs, and the size of the heap they come from (0 before the first allocation.)
+	VkDeviceSize GetTotalSlabBytes() const;
+	VkDeviceSize GetHeapSize() const;
+
 private:
 	static const size_t SLAB_GRAIN_SIZE = 1024;
 	static const uint8_t SLAB_GRAIN_SHIFT = 10;
@@ -162,9 +167,11 @@ class VulkanDeviceAllocator {
 		VkDeviceMemory deviceMemory;
 		std::vector<uint8_t> usage;
 		std::unordered_map<size_t, size_t> allocSizes;
-		size_t nextFree;
+		// Free runs of blocks, start -> length. Neighbours are always merged.
+		std::map<size_t, size_t> freeRanges;
+		size_t usedBlocks = 0;
 
-		size_t Size() {
+		size_t Size() const {
 			return usage.size() * SLAB_GRAIN_SIZE;
 		}
 	};
@@ -185,13 +192,13 @@ class VulkanDeviceAllocator {
 	}
 
 	bool AllocateSlab(VkDeviceSize minBytes);
-	bool AllocateFromSlab(Slab &slab, size_t &start, size_t blocks);
+	bool AllocateFromSlab(Slab &slab, size_t &start, size_t blocks, size_t align);
+	static void AddFreeRange(Slab &slab, size_t start, size_t blocks);
 	void Decimate();
 	void ExecuteFree(FreeInfo *userdata);
 
 	VulkanContext *const vulkan_;
 	std::vector<Slab> slabs_;
-	size_t lastSlab_ = 0;
 	size_t minSlabSize_;
 	const size_t maxSlabSize_;
 	uint32_t memoryTypeIndex_ = UNDEFINED_MEMORY_TYPE;
@@ -8,9 +8,14 @@
 #define __STDC_CONSTANT_MACROS 1
 #endif
 
-#include <string>
+#include <condition_variable>
 #include <cstdint>
+#include <deque>
+#include <mutex>
 #include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
 
 #ifdef USE_FFMPEG
 
@@ -23,6 +28,7 @@ extern "C" {
 
 #endif
 
+#include "thread/threadutil.h"
 #include "Common/FileUtil.h"
 #include "Common/MsgHandler.h"
 #include "Common/ColorConv.h"
@@ -53,6 +59,27 @@ static SwsContext* s_sws_context = nullptr;
 
 #endif
 
+// Frames are converted on the emu thread, scaled and encoded on s_encode_thread.
+// If the encoder falls further behind than this, new frames are dropped rather than stalling emulation.
+static const size_t MAX_QUEUED_FRAMES = 8;
+
+struct QueuedFrame {
+	std::vector<u8> data;  // RGB24
+	u32 width;
+	u32 height;
+	s64 pts;
+};
+
+static std::thread s_encode_thread;
+static std::mutex s_queue_lock;
+static std::condition_variable s_queue_cond;
+static std::deque<QueuedFrame> s_queue;
+static std::vector<std::vector<u8>> s_free_buffers;
+static bool s_encode_stop = false;
+static s64 s_next_pts = 0;
+static int s_frames_encoded = 0;
+static int s_frames_dropped = 0;
+
 static int s_bytes_per_pixel;
 static int s_width;
 static int s_height;
@@ -72,6 +99,53 @@ static void InitAVCodec() {
 	}
 }
 
+#ifdef USE_FFMPEG
+
+static void PreparePacket(AVPacket* pkt) {
+	av_init_packet(pkt);
+	pkt->data = nullptr;
+	pkt->size = 0;
+}
+
+static bool SupportsPixelFormat(const AVCodec *codec, AVPixelFormat fmt) {
+	for (const AVPixelFormat *p = codec->pix_fmts; p && *p != AV_PIX_FMT_NONE; ++p) {
+		if (*p == fmt)
+			return true;
+	}
+	return false;
+}
+
+static AVCodec *FindHardwareEncoder() {
+	// Encoders that take frames from system memory. VAAPI would need frames uploaded to the device first.
+	static const char *const names[] = { "h264_nvenc", "nvenc_h264", "h264_qsv", "h264_amf", "h264_videotoolbox" };
+	for (const char *name : names) {
+		AVCodec *codec = avcodec_find_encoder_by_name(name);
+		if (codec)
+			return codec;
+	}
+	return nullptr;
+}
+
+static void WritePacket(AVPacket *pkt) {
+	// Write the compressed frame in the media file.
+	if (pkt->pts != (s64)AV_NOPTS_VALUE)
+	{
+		pkt->pts = av_rescale_q(pkt->pts, s_stream->codec->time_base, s_stream->time_base);
+	}
+	if (pkt->dts != (s64)AV_NOPTS_VALUE)
+	{
+		pkt->dts = av_rescale_q(pkt->dts, s_stream->codec->time_base, s_stream->time_base);
+	}
+#if LIBAVCODEC_VERSION_INT < AV_VERSION_INT(56, 60, 100)
+	if (s_stream->codec->coded_frame->key_frame)
+		pkt->flags |= AV_PKT_FLAG_KEY;
+#endif
+	pkt->stream_index = s_stream->index;
+	av_interleaved_write_frame(s_format_context, pkt);
+}
+
+#endif
+
 bool AVIDump::Start(int w, int h)
 {
 	s_width = w;
@@ -81,9 +155,17 @@ bool AVIDump::Start(int w, int h)
 
 	InitAVCodec();
 	bool success = CreateAVI();
-	if (!success)
+	if (!success) {
 		CloseFile();
-	return success;
+		return false;
+	}
+
+	s_next_pts = 0;
+	s_frames_encoded = 0;
+	s_frames_dropped = 0;
+	s_encode_stop = false;
+	s_encode_thread = std::thread(&EncodeThreadFunc);
+	return true;
 }
 
 bool AVIDump::CreateAVI() {
@@ -112,9 +194,17 @@ bool AVIDump::CreateAVI() {
 		return false;
 	}
 
-	s_stream->codec->codec_id = g_Config.bUseFFV1 ? AV_CODEC_ID_FFV1 : s_format_context->oformat->video_codec;
-	if (!g_Config.bUseFFV1)
-		s_stream->codec->codec_tag = MKTAG('X', 'V', 'I', 'D');  // Force XVID FourCC for better compatibility
+	// Hardware H.264 encoders take most of the encoding cost off the CPU, try them before the software codec.
+	if (!g_Config.bUseFFV1 && g_Config.bHardwareVideoEncoder)
+		codec = FindHardwareEncoder();
+
+	if (codec) {
+		s_stream->codec->codec_id = codec->id;
+	} else {
+		s_stream->codec->codec_id = g_Config.bUseFFV1 ? AV_CODEC_ID_FFV1 : s_format_context->oformat->video_codec;
+		if (!g_Config.bUseFFV1)
+			s_stream->codec->codec_tag = MKTAG('X', 'V', 'I', 'D');  // Force XVID FourCC for better compatibility
+	}
 	s_stream->codec->codec_type = AVMEDIA_TYPE_VIDEO;
 	s_stream->codec->bit_rate = 400000;
 	s_stream->codec->width = s_width;
@@ -123,8 +213,23 @@ bool AVIDump::CreateAVI() {
 	s_stream->codec->time_base.den = 60000;
 	s_stream->codec->gop_size = 12;
 	s_stream->codec->pix_fmt = g_Config.bUseFFV1 ? AV_PIX_FMT_BGRA : AV_PIX_FMT_YUV420P;
+	if (codec && codec->pix_fmts && !SupportsPixelFormat(codec, AV_PIX_FMT_YUV420P)) {
+		// Some hardware encoders only take NV12, swscale converts to it just as well.
+		s_stream->codec->pix_fmt = codec->pix_fmts[0];
+	}
 
-	if (!(codec = avcodec_find_encoder(s_stream->codec->codec_id)) || (avcodec_open2(s_stream->codec, codec, nullptr) < 0))
+	if (codec && avcodec_open2(s_stream->codec, codec, nullptr) < 0) {
+		WARN_LOG(G3D, "Could not open hardware encoder %s, falling back to software", codec->name);
+		avcodec_close(s_stream->codec);
+		codec = nullptr;
+		s_stream->codec->codec_id = s_format_context->oformat->video_codec;
+		s_stream->codec->codec_tag = MKTAG('X', 'V', 'I', 'D');
+		s_stream->codec->pix_fmt = AV_PIX_FMT_YUV420P;
+	} else if (codec) {
+		NOTICE_LOG(G3D, "Using hardware encoder %s", codec->name);
+	}
+
+	if (!codec && (!(codec = avcodec_find_encoder(s_stream->codec->codec_id)) || (avcodec_open2(s_stream->codec, codec, nullptr) < 0)))
 	{
 		return false;
 	}
@@ -157,16 +262,6 @@ bool AVIDump::CreateAVI() {
 #endif
 }
 
-#ifdef USE_FFMPEG
-
-static void PreparePacket(AVPacket* pkt) {
-	av_init_packet(pkt);
-	pkt->data = nullptr;
-	pkt->size = 0;
-}
-
-#endif
-
 void AVIDump::AddFrame()
 {
 	gpuDebug->GetCurrentFramebuffer(buf, GPU_DBG_FRAMEBUF_DISPLAY);
@@ -176,6 +271,51 @@ void AVIDump::AddFrame()
 	u8 *flipbuffer = nullptr;
 	const u8 *buffer = ConvertBufferToScreenshot(buf, false, flipbuffer, w, h);
 
+	// The frame keeps its time slot even if it's dropped, so the video doesn't speed up.
+	s64 pts = s_next_pts++;
+	if (buffer && s_encode_thread.joinable()) {
+		std::unique_lock<std::mutex> guard(s_queue_lock);
+		if (s_queue.size() >= MAX_QUEUED_FRAMES) {
+			s_frames_dropped++;
+		} else {
+			QueuedFrame frame;
+			if (!s_free_buffers.empty()) {
+				frame.data = std::move(s_free_buffers.back());
+				s_free_buffers.pop_back();
+			}
+			frame.data.assign(buffer, buffer + w * h * 3);
+			frame.width = w;
+			frame.height = h;
+			frame.pts = pts;
+			s_queue.push_back(std::move(frame));
+			s_queue_cond.notify_one();
+		}
+	}
+	delete[] flipbuffer;
+}
+
+void AVIDump::EncodeThreadFunc() {
+	setCurrentThreadName("AVIDump");
+
+	std::unique_lock<std::mutex> guard(s_queue_lock);
+	while (true) {
+		while (s_queue.empty() && !s_encode_stop)
+			s_queue_cond.wait(guard);
+		// Finish what's queued before stopping, those frames were already counted as recorded.
+		if (s_queue.empty())
+			break;
+
+		QueuedFrame frame = std::move(s_queue.front());
+		s_queue.pop_front();
+		guard.unlock();
+		EncodeFrame(frame.data.data(), frame.width, frame.height, frame.pts);
+		guard.lock();
+		s_free_buffers.push_back(std::move(frame.data));
+	}
+}
+
+void AVIDump::EncodeFrame(const u8 *buffer, u32 w, u32 h, s64 pts)
+{
 #ifdef USE_FFMPEG
 
 	s_src_frame->data[0] = const_cast<u8*>(buffer);
@@ -193,44 +333,53 @@ void AVIDump::AddFrame()
 	s_scaled_frame->format = s_stream->codec->pix_fmt;
 	s_scaled_frame->width = s_width;
 	s_scaled_frame->height = s_height;
+	s_scaled_frame->pts = pts;
 
-	// Encode and write the image.
+	// Encode and write the image. Encoders with delay (like the hardware ones) may hand the packet back later.
 	AVPacket pkt;
 	PreparePacket(&pkt);
 	int got_packet;
 	int error = avcodec_encode_video2(s_stream->codec, &pkt, s_scaled_frame, &got_packet);
-	while (!error && got_packet)
-	{
-		// Write the compressed frame in the media file.
-		if (pkt.pts != (s64)AV_NOPTS_VALUE)
-		{
-			pkt.pts = av_rescale_q(pkt.pts, s_stream->codec->time_base, s_stream->time_base);
-		}
-		if (pkt.dts != (s64)AV_NOPTS_VALUE)
-		{
-			pkt.dts = av_rescale_q(pkt.dts, s_stream->codec->time_base, s_stream->time_base);
-		}
-#if LIBAVCODEC_VERSION_INT < AV_VERSION_INT(56, 60, 100)
-		if (s_stream->codec->coded_frame->key_frame)
-			pkt.flags |= AV_PKT_FLAG_KEY;
+	if (!error && got_packet)
+		WritePacket(&pkt);
+	if (error)
+		ERROR_LOG(G3D, "Error while encoding video: %d", error);
+	else
+		s_frames_encoded++;
 #endif
-		pkt.stream_index = s_stream->index;
-		av_interleaved_write_frame(s_format_context, &pkt);
+}
 
-		// Handle delayed frames.
+void AVIDump::FlushEncoder() {
+#ifdef USE_FFMPEG
+	// Handle delayed frames.
+	AVPacket pkt;
+	PreparePacket(&pkt);
+	int got_packet;
+	int error = avcodec_encode_video2(s_stream->codec, &pkt, nullptr, &got_packet);
+	while (!error && got_packet) {
+		WritePacket(&pkt);
 		PreparePacket(&pkt);
 		error = avcodec_encode_video2(s_stream->codec, &pkt, nullptr, &got_packet);
 	}
-	if (error)
-		ERROR_LOG(G3D, "Error while encoding video: %d", error);
 #endif
-	delete[] flipbuffer;
 }
 
 void AVIDump::Stop() {
+	if (s_encode_thread.joinable()) {
+		{
+			std::lock_guard<std::mutex> guard(s_queue_lock);
+			s_encode_stop = true;
+			s_queue_cond.notify_one();
+		}
+		s_encode_thread.join();
+		s_free_buffers.clear();
+#ifdef USE_FFMPEG
+		FlushEncoder();
+		av_write_trailer(s_format_context);
+#endif
+		NOTICE_LOG(G3D, "Frame dump: %d frames encoded, %d dropped", s_frames_encoded, s_frames_dropped);
+	}
 #ifdef USE_FFMPEG
-
-	av_write_trailer(s_format_context);
 	CloseFile();
 	s_file_index = 0;
 #endif
@@ -13,6 +13,9 @@ class AVIDump
 	static bool CreateAVI();
 	static void CloseFile();
 	static void CheckResolution(int width, int height);
+	static void EncodeThreadFunc();
+	static void EncodeFrame(const u8 *buffer, u32 w, u32 h, s64 pts);
+	static void FlushEncoder();
 
 public:
 	static bool Start(int w, int h);
@@ -57,6 +57,8 @@ struct CompatFlags {
 	bool RequireDefaultCPUClock;
 	bool DisableReadbacks;
 	bool DisableAccurateDepth;
+	bool AsyncTextureDecode;
+	bool DelayedReadbacks;
 };
 
 class IniFile;
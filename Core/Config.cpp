@@ -34,6 +34,7 @@
 #include "Common/FileUtil.h"
 #include "Common/KeyMap.h"
 #include "Common/LogManager.h"
+#include "Common/MemoryUtil.h"
 #include "Common/OSVersion.h"
 #include "Common/StringUtils.h"
 #include "Common/Vulkan/VulkanLoader.h"
@@ -350,6 +351,8 @@ static ConfigSetting generalSettings[] = {
 	ConfigSetting("CheckForNewVersion", &g_Config.bCheckForNewVersion, true),
 	ConfigSetting("Language", &g_Config.sLanguageIni, &DefaultLangRegion),
 	ConfigSetting("ForceLagSync", &g_Config.bForceLagSync, false, true, true),
+	ConfigSetting("LowLatencyPacing", &g_Config.bLowLatencyPacing, false, true, true),
+	ReportedConfigSetting("RunAheadFrames", &g_Config.iRunAheadFrames, 0, true, true),
 
 	ReportedConfigSetting("NumWorkerThreads", &g_Config.iNumWorkerThreads, &DefaultNumWorkers, true, true),
 	ConfigSetting("EnableAutoLoad", &g_Config.bEnableAutoLoad, false, true, true),
@@ -358,12 +361,14 @@ static ConfigSetting generalSettings[] = {
 
 	ConfigSetting("ScreenshotsAsPNG", &g_Config.bScreenshotsAsPNG, false, true, true),
 	ConfigSetting("UseFFV1", &g_Config.bUseFFV1, false),
+	ConfigSetting("HardwareVideoEncoder", &g_Config.bHardwareVideoEncoder, false),
 	ConfigSetting("DumpFrames", &g_Config.bDumpFrames, false),
 	ConfigSetting("DumpAudio", &g_Config.bDumpAudio, false),
 	ConfigSetting("SaveLoadResetsAVdumping", &g_Config.bSaveLoadResetsAVdumping, false),
 	ConfigSetting("StateSlot", &g_Config.iCurrentStateSlot, 0, true, true),
 	ConfigSetting("EnableStateUndo", &g_Config.bEnableStateUndo, &DefaultEnableStateUndo, true, true),
 	ConfigSetting("RewindFlipFrequency", &g_Config.iRewindFlipFrequency, 0, true, true),
+	ConfigSetting("RewindWriteTracking", &g_Config.bRewindWriteTracking, false, true, true),
 
 	ConfigSetting("GridView1", &g_Config.bGridView1, true),
 	ConfigSetting("GridView2", &g_Config.bGridView2, true),
@@ -374,6 +379,10 @@ static ConfigSetting generalSettings[] = {
 	ConfigSetting("ReportingHost", &g_Config.sReportHost, "default"),
 	ConfigSetting("AutoSaveSymbolMap", &g_Config.bAutoSaveSymbolMap, false, true, true),
 	ConfigSetting("CacheFullIsoInRam", &g_Config.bCacheFullIsoInRam, false, true, true),
+	ConfigSetting("LearnedReadAhead", &g_Config.bLearnedReadAhead, false, true, true),
+	ConfigSetting("CacheISODirectories", &g_Config.bCacheISODirectories, false, true, true),
+	ConfigSetting("CacheGameInfo", &g_Config.bCacheGameInfo, true),
+	ConfigSetting("ZSOCacheSize", &g_Config.iZSOCacheSize, 1024, true, true),
 	ConfigSetting("RemoteISOPort", &g_Config.iRemoteISOPort, 0, true, false),
 	ConfigSetting("LastRemoteISOServer", &g_Config.sLastRemoteISOServer, ""),
 	ConfigSetting("LastRemoteISOPort", &g_Config.iLastRemoteISOPort, 0),
@@ -396,6 +405,7 @@ static ConfigSetting generalSettings[] = {
 #endif
 	ConfigSetting("PauseWhenMinimized", &g_Config.bPauseWhenMinimized, false, true, true),
 	ConfigSetting("DumpDecryptedEboots", &g_Config.bDumpDecryptedEboot, false, true, true),
+	ConfigSetting("CacheDecryptedModules", &g_Config.bCacheDecryptedModules, false, true, true),
 	ConfigSetting("FullscreenOnDoubleclick", &g_Config.bFullscreenOnDoubleclick, true, false, false),
 
 	ReportedConfigSetting("MemStickInserted", &g_Config.bMemStickInserted, true, true, true),
@@ -410,12 +420,29 @@ static bool DefaultSasThread() {
 static ConfigSetting cpuSettings[] = {
 	ReportedConfigSetting("CPUCore", &g_Config.iCpuCore, &DefaultCpuCore, true, true),
 	ReportedConfigSetting("SeparateSASThread", &g_Config.bSeparateSASThread, &DefaultSasThread, true, true),
+	ReportedConfigSetting("ParallelSASMix", &g_Config.bParallelSASMix, false, true, true),
+	ReportedConfigSetting("HalfRateReverb", &g_Config.bHalfRateReverb, false, true, true),
+	ReportedConfigSetting("HardwareVideoDecode", &g_Config.bHardwareVideoDecode, false, true, true),
+	ReportedConfigSetting("VideoDecodeAhead", &g_Config.iVideoDecodeAhead, 0, true, true),
+	ReportedConfigSetting("AtracDecodeAhead", &g_Config.bAtracDecodeAhead, false, true, true),
+	ReportedConfigSetting("AtracLoopCache", &g_Config.bAtracLoopCache, false, true, true),
 	ReportedConfigSetting("SeparateIOThread", &g_Config.bSeparateIOThread, true, true, true),
+	ConfigSetting("SeparateDmacThread", &g_Config.bSeparateDmacThread, false, true, true),
+	ReportedConfigSetting("SeparateGPUThread", &g_Config.bSeparateGPUThread, false, true, true),
 	ReportedConfigSetting("IOTimingMethod", &g_Config.iIOTimingMethod, IOTIMING_FAST, true, true),
 	ConfigSetting("FastMemoryAccess", &g_Config.bFastMemory, true, true, true),
 	ReportedConfigSetting("FuncReplacements", &g_Config.bFuncReplacements, true, true, true),
 	ConfigSetting("HideSlowWarnings", &g_Config.bHideSlowWarnings, false, true, false),
 	ConfigSetting("PreloadFunctions", &g_Config.bPreloadFunctions, false, true, true),
+	ConfigSetting("PersistentIRCache", &g_Config.bPersistentIRCache, false, true, true),
+	ConfigSetting("FuncScanCache", &g_Config.bFuncScanCache, true, true, true),
+	ConfigSetting("IRBackgroundOptimize", &g_Config.bIRBackgroundOptimize, false, true, true),
+	ConfigSetting("IRTierUpThreshold", &g_Config.iIRTierUpThreshold, 0, true, true),
+	ConfigSetting("JitContinueBranches", &g_Config.bJitContinueBranches, false, true, true),
+	ConfigSetting("JitHostBlockTable", &g_Config.bJitHostBlockTable, false, true, true),
+	ConfigSetting("JitEvictOldBlocks", &g_Config.bJitEvictOldBlocks, false, true, true),
+	ConfigSetting("MemCheckPageProtection", &g_Config.bMemCheckPageProtection, false, true, true),
+	ConfigSetting("JitSkipIdleLoops", &g_Config.bJitSkipIdleLoops, false, true, true),
 	ReportedConfigSetting("CPUSpeed", &g_Config.iLockedCPUSpeed, 0, true, true),
 
 	ConfigSetting(false),
@@ -450,6 +477,24 @@ static bool DefaultFrameskipUnthrottle() {
 #endif
 }
 
+static int DefaultTextureMemoryBudget() {
+	// Phones share memory with the GPU, and drivers tend to get the app killed rather than fail allocations.
+#if defined(MOBILE_DEVICE)
+	// An eighth of RAM, so 128 MB on a 1 GB device.
+	uint64_t ramMB = GetPhysicalMemoryBytes() / (1024 * 1024);
+	if (ramMB == 0)
+		return 256;
+	return (int)std::max((uint64_t)64, std::min((uint64_t)256, ramMB / 8));
+#else
+	return 0;
+#endif
+}
+
+static bool DefaultLowMemoryMode() {
+	uint64_t ram = GetPhysicalMemoryBytes();
+	return ram != 0 && ram < 1536ULL * 1024 * 1024;
+}
+
 static int DefaultZoomType() {
 	return 2;
 }
@@ -513,6 +558,8 @@ static ConfigSetting graphicsSettings[] = {
 	ReportedConfigSetting("TextureFiltering", &g_Config.iTexFiltering, 1, true, true),
 	ReportedConfigSetting("BufferFiltering", &g_Config.iBufFilter, 1, true, true),
 	ReportedConfigSetting("InternalResolution", &g_Config.iInternalResolution, &DefaultInternalResolution, true, true),
+	ReportedConfigSetting("DynamicResolution", &g_Config.bDynamicResolution, false, true, true),
+	ReportedConfigSetting("DynamicResolutionMinScale", &g_Config.iDynamicResolutionMinScale, 50, true, true),
 	ReportedConfigSetting("AndroidHwScale", &g_Config.iAndroidHwScale, &DefaultAndroidHwScale),
 	ReportedConfigSetting("HighQualityDepth", &g_Config.bHighQualityDepth, true, true, true),
 	ReportedConfigSetting("FrameSkip", &g_Config.iFrameSkip, 0, true, true),
@@ -530,6 +577,11 @@ static ConfigSetting graphicsSettings[] = {
 	ReportedConfigSetting("VertexDecCache", &g_Config.bVertexCache, &DefaultVertexCache, true, true),
 	ReportedConfigSetting("TextureBackoffCache", &g_Config.bTextureBackoffCache, false, true, true),
 	ReportedConfigSetting("TextureSecondaryCache", &g_Config.bTextureSecondaryCache, false, true, true),
+	ReportedConfigSetting("TextureWriteTracking", &g_Config.bTextureWriteTracking, true, true, true),
+	ReportedConfigSetting("TextureSampledHash", &g_Config.bTextureSampledHash, false, true, true),
+	ReportedConfigSetting("TextureMemoryBudget", &g_Config.iTextureMemoryBudget, &DefaultTextureMemoryBudget, true, true),
+	ReportedConfigSetting("LowMemoryMode", &g_Config.bLowMemoryMode, &DefaultLowMemoryMode, true, true),
+	ReportedConfigSetting("GECommandCache", &g_Config.bGECommandCache, false, true, true),
 	ReportedConfigSetting("VertexDecJit", &g_Config.bVertexDecoderJit, &DefaultCodeGen, false),
 
 #ifndef MOBILE_DEVICE
@@ -546,12 +598,22 @@ static ConfigSetting graphicsSettings[] = {
 
 	ReportedConfigSetting("TrueColor", &g_Config.bTrueColor, true, true, true),
 	ReportedConfigSetting("ReplaceTextures", &g_Config.bReplaceTextures, true, true, true),
+	ReportedConfigSetting("ReplaceTexturesAsync", &g_Config.bReplaceTexturesAsync, true, true, true),
 	ReportedConfigSetting("SaveNewTextures", &g_Config.bSaveNewTextures, false, true, true),
 
 	ReportedConfigSetting("TexScalingLevel", &g_Config.iTexScalingLevel, 1, true, true),
 	ReportedConfigSetting("TexScalingType", &g_Config.iTexScalingType, 0, true, true),
 	ReportedConfigSetting("TexDeposterize", &g_Config.bTexDeposterize, false, true, true),
+	ConfigSetting("TexScalingAsync", &g_Config.bTexScalingAsync, true, true, true),
+	ConfigSetting("TexScalingDiskCache", &g_Config.bTexScalingDiskCache, false, true, true),
+	ConfigSetting("TexScalingGPU", &g_Config.bTexScalingGPU, true, true, true),
+	ReportedConfigSetting("ClutLookupInShader", &g_Config.bClutLookupInShader, true, true, true),
+	ReportedConfigSetting("AsyncPipelines", &g_Config.bAsyncPipelines, true, true, true),
 	ConfigSetting("VSyncInterval", &g_Config.bVSync, false, true, true),
+	ConfigSetting("InflightFrames", &g_Config.iInflightFrames, 3, true, true),
+	ConfigSetting("D3D11DeferredContext", &g_Config.bD3D11DeferredContext, false, true, true),
+	ConfigSetting("VulkanPresentMode", &g_Config.iVulkanPresentMode, 0, true, true),
+	ConfigSetting("VulkanSwapchainImages", &g_Config.iVulkanSwapchainImages, 0, true, true),
 	ReportedConfigSetting("DisableStencilTest", &g_Config.bDisableStencilTest, false, true, true),
 	ReportedConfigSetting("BloomHack", &g_Config.iBloomHack, 0, true, true),
 
@@ -577,8 +639,10 @@ static ConfigSetting soundSettings[] = {
 	ConfigSetting("AudioBackend", &g_Config.iAudioBackend, 0, true, true),
 	ConfigSetting("AudioLatency", &g_Config.iAudioLatency, 1, true, true),
 	ConfigSetting("ExtraAudioBuffering", &g_Config.bExtraAudioBuffering, false, true, false),
+	ConfigSetting("AdaptiveAudioLatency", &g_Config.bAdaptiveAudioLatency, false, true, false),
 	ConfigSetting("SoundSpeedHack", &g_Config.bSoundSpeedHack, false, true, true),
 	ConfigSetting("AudioResampler", &g_Config.bAudioResampler, true, true, true),
+	ConfigSetting("HighQualityResampler", &g_Config.bHighQualityResampler, false, true, true),
 	ConfigSetting("GlobalVolume", &g_Config.iGlobalVolume, VOLUME_MAX, true, true),
 
 	ConfigSetting(false),
@@ -800,6 +864,10 @@ static ConfigSetting debuggerSettings[] = {
 	ConfigSetting("ShowAllocatorDebug", &g_Config.bShowAllocatorDebug, false, false),
 	ConfigSetting("SkipDeadbeefFilling", &g_Config.bSkipDeadbeefFilling, false),
 	ConfigSetting("FuncHashMap", &g_Config.bFuncHashMap, false),
+	ConfigSetting("GERecordFrames", &g_Config.iGERecordFrames, 1),
+	ConfigSetting("StatsServer", &g_Config.bStatsServer, false),
+	ConfigSetting("StatsServerPort", &g_Config.iStatsServerPort, 8037),
+	ConfigSetting("StatsServerRate", &g_Config.iStatsServerRate, 10),
 
 	ConfigSetting(false),
 };
@@ -983,6 +1051,15 @@ void Config::Load(const char *iniFileName, const char *controllerIniFilename) {
 	if (iRenderingMode != FB_NON_BUFFERED_MODE && iRenderingMode != FB_BUFFERED_MODE) {
 		g_Config.iRenderingMode = FB_BUFFERED_MODE;
 	}
+	if (iInflightFrames < 1 || iInflightFrames > 3) {
+		iInflightFrames = 3;
+	}
+	if (iVulkanPresentMode < 0 || iVulkanPresentMode > 3) {
+		iVulkanPresentMode = 0;
+	}
+	if (iVulkanSwapchainImages < 0 || iVulkanSwapchainImages > 8) {
+		iVulkanSwapchainImages = 0;
+	}
 
 	// Check for an old dpad setting
 	IniFile::Section *control = iniFile.GetOrCreateSection("Control");
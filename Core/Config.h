@@ -97,11 +97,14 @@ struct Config {
 	int iNumWorkerThreads;
 	bool bScreenshotsAsPNG;
 	bool bUseFFV1;
+	bool bHardwareVideoEncoder;
 	bool bDumpFrames;
 	bool bDumpAudio;
 	bool bSaveLoadResetsAVdumping;
 	bool bEnableLogging;
 	bool bDumpDecryptedEboot;
+	// Keep decrypted EBOOTs/PRXs in the app cache, so later boots don't need to decrypt again.
+	bool bCacheDecryptedModules;
 	bool bFullscreenOnDoubleclick;
 #if defined(USING_WIN_UI)
 	bool bPauseOnLostFocus;
@@ -124,16 +127,53 @@ struct Config {
 	int iCpuCore;
 	bool bCheckForNewVersion;
 	bool bForceLagSync;
+	// Present first and throttle afterwards, so input is read closer to the next present.
+	bool bLowLatencyPacing;
+	// Emulate this many frames ahead each frame and show the last, then roll back.  0 is off.
+	int iRunAheadFrames;
 	bool bFuncReplacements;
 	bool bHideSlowWarnings;
 	bool bPreloadFunctions;
+	bool bPersistentIRCache;
+	bool bFuncScanCache;
+	bool bIRBackgroundOptimize;
+	int iIRTierUpThreshold;
+	bool bJitContinueBranches;
+	bool bJitHostBlockTable;
+	bool bJitEvictOldBlocks;
+	// Catch memchecks by protecting their pages (x86 jit only), instead of checking every access.
+	bool bMemCheckPageProtection;
+	bool bJitSkipIdleLoops;
 
 	bool bSeparateSASThread;
+	// Splits the SAS voices across the worker threads.
+	bool bParallelSASMix;
+	// Runs SAS reverb at half its rate, for slow devices.
+	bool bHalfRateReverb;
+	// Decodes videos with the platform's decoder through FFmpeg, when it has one.
+	bool bHardwareVideoDecode;
+	// How many video frames to decode ahead on a separate thread, 0 to decode when the game asks.
+	int iVideoDecodeAhead;
+	// Decodes each Atrac track's next frame on a separate thread, while the game does other work.
+	bool bAtracDecodeAhead;
+	// Keeps the decoded audio of short looping Atrac tracks, instead of decoding every pass again.
+	bool bAtracLoopCache;
 	bool bSeparateIOThread;
+	bool bSeparateDmacThread;
+	// Runs display lists on a separate thread in the GLES and Vulkan backends.
+	bool bSeparateGPUThread;
 	int iIOTimingMethod;
 	int iLockedCPUSpeed;
 	bool bAutoSaveSymbolMap;
 	bool bCacheFullIsoInRam;
+	// Remember what was read after each ISO file open, and prefetch it next time.
+	bool bLearnedReadAhead;
+	// Save parsed ISO directories to the cache directory, for faster mounts next time.
+	bool bCacheISODirectories;
+	// Remember game list titles and icons, so unchanged files aren't opened again.
+	bool bCacheGameInfo;
+	// In KB, how many decoded frames of .zso images to keep around.
+	int iZSOCacheSize;
 	int iRemoteISOPort;
 	std::string sLastRemoteISOServer;
 	int iLastRemoteISOPort;
@@ -165,6 +205,10 @@ struct Config {
 	bool bImmersiveMode;  // Mode on Android Kitkat 4.4 that hides the back button etc.
 	bool bSustainedPerformanceMode;  // Android: Slows clocks down to avoid overheating/speed fluctuations.
 	bool bVSync;
+	int iInflightFrames;  // GL: how many frames the CPU may queue ahead of the GPU, 1-3. Lower = less input lag.
+	bool bD3D11DeferredContext;  // Record on a deferred context and submit from a separate thread.
+	int iVulkanPresentMode;  // 0 = platform default, 1 = FIFO, 2 = FIFO_RELAXED, 3 = MAILBOX.
+	int iVulkanSwapchainImages;  // 0 = automatic (one more than the minimum).
 	int iFrameSkip;
 	bool bAutoFrameSkip;
 	bool bFrameSkipUnthrottle;
@@ -182,23 +226,38 @@ struct Config {
 	bool bVertexCache;
 	bool bTextureBackoffCache;
 	bool bTextureSecondaryCache;
+	bool bTextureWriteTracking;  // Protect texture memory to only rehash textures after they're written
+	bool bTextureSampledHash;  // Check big, long unchanged textures by sampling, with a periodic full hash
+	int iTextureMemoryBudget;  // In MB, the least recently used textures are evicted above it. 0 = no budget
+	bool bLowMemoryMode;  // Smaller caches and quicker texture eviction, on by default on devices with little RAM.
+	// Remembers runs of state commands in display lists and replays only their final values.
+	bool bGECommandCache;
 	bool bVertexDecoderJit;
 	bool bFullScreen;
 	bool bFullScreenMulti;
 	int iInternalResolution;  // 0 = Auto (native), 1 = 1x (480x272), 2 = 2x, 3 = 3x, 4 = 4x and so on.
+	bool bDynamicResolution;  // Scale the internal resolution down when GPU frame time gets too high.
+	int iDynamicResolutionMinScale;  // Percent of the internal resolution it may scale down to.
 	int iAnisotropyLevel;  // 0 - 5, powers of 2: 0 = 1x = no aniso
 	int bHighQualityDepth;
 	bool bTrueColor;
 	bool bReplaceTextures;
+	bool bReplaceTexturesAsync;  // Keep the original texture until the replacement has loaded
 	bool bSaveNewTextures;
 	int iTexScalingLevel; // 1 = off, 2 = 2x, ..., 5 = 5x
 	int iTexScalingType; // 0 = xBRZ, 1 = Hybrid
 	bool bTexDeposterize;
+	bool bTexScalingAsync;  // Show the unscaled texture until the scaled one is ready
+	bool bTexScalingDiskCache;  // Spill scaled textures evicted from RAM to disk, for this session
+	bool bTexScalingGPU;  // Use compute shaders for the scaling types that support it (Vulkan, bicubic only so far)
+	bool bClutLookupInShader;  // Upload unfiltered CLUT4/8 textures as indices and look up the palette in the shader
+	bool bAsyncPipelines;  // Vulkan: Create new pipelines on a thread, drawing with a similar one until done
 	int iFpsLimit;
 	int iForceMaxEmulatedFPS;
 	int iMaxRecent;
 	int iCurrentStateSlot;
 	int iRewindFlipFrequency;
+	bool bRewindWriteTracking;
 	bool bEnableStateUndo;
 	bool bEnableAutoLoad;
 	bool bEnableCheats;
@@ -222,6 +281,8 @@ struct Config {
 	int iAudioBackend;
 	int iGlobalVolume;
 	bool bExtraAudioBuffering;  // For bluetooth
+	// Lowers the buffered audio towards one host period, backing off on underruns.
+	bool bAdaptiveAudioLatency;
 
 	// Audio Hack
 	bool bSoundSpeedHack;
@@ -264,6 +325,8 @@ struct Config {
 	bool bShowDebugStats;
 	bool bShowAudioDebug;
 	bool bAudioResampler;
+	// Windowed sinc instead of linear interpolation when resampling.
+	bool bHighQualityResampler;
 
 	//Analog stick tilting
 	//the base x and y tilt. this inclination is treated as (0,0) and the tilt input
@@ -451,6 +514,13 @@ struct Config {
 	// Double edged sword: much easier debugging, but not accurate.
 	bool bSkipDeadbeefFilling;
 	bool bFuncHashMap;
+	// How many frames a GE dump recording captures.
+	int iGERecordFrames;
+	// Serve live stats, registers, and memory over HTTP, see Core/Debugger/StatsServer.h.
+	bool bStatsServer;
+	int iStatsServerPort;
+	// Default samples per second for /stats streams.
+	int iStatsServerRate;
 
 	// Volatile development settings
 	bool bShowFrameProfiler;
@@ -42,7 +42,7 @@ enum class CPUCore;
 
 // PSP_CoreParameter()
 struct CoreParameter {
-	CoreParameter() : thin3d(nullptr), collectEmuLog(0), unthrottle(false), fpsLimit(0), updateRecent(true), freezeNext(false), frozen(false), mountIsoLoader(nullptr) {}
+	CoreParameter() : thin3d(nullptr), collectEmuLog(0), unthrottle(false), fpsLimit(0), updateRecent(true), freezeNext(false), frozen(false), runningAhead(false), mountIsoLoader(nullptr) {}
 
 	CPUCore cpuCore;
 	GPUCore gpuCore;
@@ -79,6 +79,10 @@ struct CoreParameter {
 	bool freezeNext;
 	bool frozen;
 
+	// Set while emulating run-ahead frames that get rolled back, and while rolling them back.
+	// Those frames don't throttle, output audio or count in stats, and the rollback keeps caches.
+	bool runningAhead;
+
 	FileLoader *mountIsoLoader;
 
 	Compatibility compat;
@@ -16,15 +16,15 @@
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
 
+#include <algorithm>
+#include <atomic>
 #include <vector>
 #include <cstdio>
-#include <mutex>
 
 #include "base/logging.h"
 #include "profiler/profiler.h"
 
 #include "Common/MsgHandler.h"
-#include "Common/Atomics.h"
 #include "Core/CoreTiming.h"
 #include "Core/Core.h"
 #include "Core/Config.h"
@@ -66,17 +66,23 @@ struct BaseEvent
 
 typedef LinkedListItem<BaseEvent> Event;
 
-Event *first;
+// Pending events are kept in a binary min-heap ordered by time.  Events scheduled for the
+// same time run in the order they were scheduled, which is what order is for.
+struct QueuedEvent : public BaseEvent
+{
+	u64 order;
+};
+
+static std::vector<QueuedEvent> eventQueue;
+static u64 eventQueueOrder = 0;
+
+// Events from other threads are pushed onto tsIncoming without locking (newest first.)
+// The CPU thread takes the whole stack at once and appends it, oldest first, to
+// tsFirst/tsLast, which only it touches.  A null tsIncoming also lets Advance() skip MoveEvents.
+static std::atomic<Event *> tsIncoming(nullptr);
 Event *tsFirst;
 Event *tsLast;
 
-// event pools
-Event *eventPool = 0;
-Event *eventTsPool = 0;
-int allocatedTsEvents = 0;
-// Optimization to skip MoveEvents when possible.
-volatile u32 hasTsEvents = 0;
-
 // Downcount has been moved to currentMIPS, to save a couple of clocks in every ARM JIT block
 // as we can already reach that structure through a register.
 int slicelength;
@@ -86,8 +92,6 @@ s64 idledCycles;
 s64 lastGlobalTimeTicks;
 s64 lastGlobalTimeUs;
 
-static std::mutex externalEventLock;
-
 std::vector<MHzChangeCallback> mhzChangeCallbacks;
 
 void FireMhzChange() {
@@ -138,39 +142,63 @@ u64 GetGlobalTimeUs()
 	return lastGlobalTimeUs + usSinceLast;
 }
 
-Event* GetNewEvent()
+// std heaps are max-heaps, so this says which event should come out last.
+static bool EventIsLater(const QueuedEvent &a, const QueuedEvent &b)
 {
-	if(!eventPool)
-		return new Event;
-
-	Event* ev = eventPool;
-	eventPool = ev->next;
-	return ev;
+	if (a.time != b.time)
+		return a.time > b.time;
+	return a.order > b.order;
 }
 
-Event* GetNewTsEvent()
+static bool EventIsEarlier(const QueuedEvent &a, const QueuedEvent &b)
 {
-	allocatedTsEvents++;
+	return EventIsLater(b, a);
+}
 
-	if(!eventTsPool)
-		return new Event;
+// Only used to convert the queue to and from the savestate linked list format.
+Event* GetNewEvent()
+{
+	return new Event;
+}
 
-	Event* ev = eventTsPool;
-	eventTsPool = ev->next;
-	return ev;
+Event* GetNewTsEvent()
+{
+	return new Event;
 }
 
 void FreeEvent(Event* ev)
 {
-	ev->next = eventPool;
-	eventPool = ev;
+	delete ev;
 }
 
 void FreeTsEvent(Event* ev)
 {
-	ev->next = eventTsPool;
-	eventTsPool = ev;
-	allocatedTsEvents--;
+	delete ev;
+}
+
+// CPU thread only.  Moves everything other threads have pushed so far onto tsFirst/tsLast.
+static void TakeIncomingTsEvents()
+{
+	Event *incoming = tsIncoming.exchange(nullptr, std::memory_order_acquire);
+	if (!incoming)
+		return;
+
+	// Reverse the stack so the events keep the order they were scheduled in.
+	Event *ordered = nullptr;
+	Event *orderedLast = incoming;
+	while (incoming)
+	{
+		Event *next = incoming->next;
+		incoming->next = ordered;
+		ordered = incoming;
+		incoming = next;
+	}
+
+	if (tsLast)
+		tsLast->next = ordered;
+	else
+		tsFirst = ordered;
+	tsLast = orderedLast;
 }
 
 int RegisterEvent(const char *name, TimedCallback callback)
@@ -196,7 +224,7 @@ void RestoreRegisterEvent(int event_type, const char *name, TimedCallback callba
 
 void UnregisterAllEvents()
 {
-	if (first)
+	if (!eventQueue.empty())
 		PanicAlert("Cannot unregister events with events pending");
 	event_types.clear();
 }
@@ -209,7 +237,6 @@ void Init()
 	idledCycles = 0;
 	lastGlobalTimeTicks = 0;
 	lastGlobalTimeUs = 0;
-	hasTsEvents = 0;
 	mhzChangeCallbacks.clear();
 }
 
@@ -218,21 +245,7 @@ void Shutdown()
 	MoveEvents();
 	ClearPendingEvents();
 	UnregisterAllEvents();
-
-	while(eventPool)
-	{
-		Event *ev = eventPool;
-		eventPool = ev->next;
-		delete ev;
-	}
-
-	std::lock_guard<std::mutex> lk(externalEventLock);
-	while(eventTsPool)
-	{
-		Event *ev = eventTsPool;
-		eventTsPool = ev->next;
-		delete ev;
-	}
+	eventQueue.shrink_to_fit();
 }
 
 u64 GetTicks()
@@ -250,19 +263,17 @@ u64 GetIdleTicks()
 // schedule things to be executed on the main thread.
 void ScheduleEvent_Threadsafe(s64 cyclesIntoFuture, int event_type, u64 userdata)
 {
-	std::lock_guard<std::mutex> lk(externalEventLock);
 	Event *ne = GetNewTsEvent();
 	ne->time = GetTicks() + cyclesIntoFuture;
 	ne->type = event_type;
-	ne->next = 0;
 	ne->userdata = userdata;
-	if(!tsFirst)
-		tsFirst = ne;
-	if(tsLast)
-		tsLast->next = ne;
-	tsLast = ne;
 
-	Common::AtomicStoreRelease(hasTsEvents, 1);
+	Event *head = tsIncoming.load(std::memory_order_relaxed);
+	do
+	{
+		ne->next = head;
+	}
+	while (!tsIncoming.compare_exchange_weak(head, ne, std::memory_order_release, std::memory_order_relaxed));
 }
 
 // Same as ScheduleEvent_Threadsafe(0, ...) EXCEPT if we are already on the CPU thread
@@ -271,7 +282,6 @@ void ScheduleEvent_Threadsafe_Immediate(int event_type, u64 userdata)
 {
 	if(false) //Core::IsCPUThread())
 	{
-		std::lock_guard<std::mutex> lk(externalEventLock);
 		event_types[event_type].callback(userdata, 0);
 	}
 	else
@@ -280,30 +290,45 @@ void ScheduleEvent_Threadsafe_Immediate(int event_type, u64 userdata)
 
 void ClearPendingEvents()
 {
-	while (first)
-	{
-		Event *e = first->next;
-		FreeEvent(first);
-		first = e;
-	}
+	eventQueue.clear();
+	eventQueueOrder = 0;
 }
 
-void AddEventToQueue(Event* ne)
+static void AddEventToQueue(const BaseEvent &ev)
 {
-	Event* prev = NULL;
-	Event** pNext = &first;
-	for(;;)
-	{
-		Event*& next = *pNext;
-		if(!next || ne->time < next->time)
-		{
-			ne->next = next;
-			next = ne;
-			break;
-		}
-		prev = next;
-		pNext = &prev->next;
-	}
+	QueuedEvent qe;
+	qe.time = ev.time;
+	qe.userdata = ev.userdata;
+	qe.type = ev.type;
+	qe.order = eventQueueOrder++;
+	eventQueue.push_back(qe);
+	std::push_heap(eventQueue.begin(), eventQueue.end(), EventIsLater);
+}
+
+static void PopFirstEvent()
+{
+	std::pop_heap(eventQueue.begin(), eventQueue.end(), EventIsLater);
+	eventQueue.pop_back();
+}
+
+// Removes every queued event matching pred, only re-heapifying if something went away.
+template <typename Pred>
+static bool RemoveQueuedEvents(Pred pred)
+{
+	auto newEnd = std::remove_if(eventQueue.begin(), eventQueue.end(), pred);
+	if (newEnd == eventQueue.end())
+		return false;
+	eventQueue.erase(newEnd, eventQueue.end());
+	std::make_heap(eventQueue.begin(), eventQueue.end(), EventIsLater);
+	return true;
+}
+
+// Returns the pending events in the order they will fire.
+static std::vector<QueuedEvent> GetSortedEvents()
+{
+	std::vector<QueuedEvent> sorted = eventQueue;
+	std::sort(sorted.begin(), sorted.end(), EventIsEarlier);
+	return sorted;
 }
 
 // This must be run ONLY from within the cpu thread
@@ -311,10 +336,10 @@ void AddEventToQueue(Event* ne)
 // than Advance
 void ScheduleEvent(s64 cyclesIntoFuture, int event_type, u64 userdata)
 {
-	Event *ne = GetNewEvent();
-	ne->userdata = userdata;
-	ne->type = event_type;
-	ne->time = GetTicks() + cyclesIntoFuture;
+	BaseEvent ne;
+	ne.userdata = userdata;
+	ne.type = event_type;
+	ne.time = GetTicks() + cyclesIntoFuture;
 	AddEventToQueue(ne);
 }
 
@@ -322,51 +347,31 @@ void ScheduleEvent(s64 cyclesIntoFuture, int event_type, u64 userdata)
 s64 UnscheduleEvent(int event_type, u64 userdata)
 {
 	s64 result = 0;
-	if (!first)
+	if (eventQueue.empty())
 		return result;
-	while(first)
-	{
-		if (first->type == event_type && first->userdata == userdata)
-		{
-			result = first->time - GetTicks();
 
-			Event *next = first->next;
-			FreeEvent(first);
-			first = next;
-		}
-		else
-		{
-			break;
+	// Like the old list walk, report the latest matching event if there are several.
+	const QueuedEvent *latest = nullptr;
+	for (const QueuedEvent &ev : eventQueue) {
+		if (ev.type == event_type && ev.userdata == userdata) {
+			if (!latest || EventIsLater(ev, *latest))
+				latest = &ev;
 		}
 	}
-	if (!first)
+	if (!latest)
 		return result;
-	Event *prev = first;
-	Event *ptr = prev->next;
-	while (ptr)
-	{
-		if (ptr->type == event_type && ptr->userdata == userdata)
-		{
-			result = ptr->time - GetTicks();
-
-			prev->next = ptr->next;
-			FreeEvent(ptr);
-			ptr = prev->next;
-		}
-		else
-		{
-			prev = ptr;
-			ptr = ptr->next;
-		}
-	}
+	result = latest->time - GetTicks();
 
+	RemoveQueuedEvents([=](const QueuedEvent &ev) {
+		return ev.type == event_type && ev.userdata == userdata;
+	});
 	return result;
 }
 
 s64 UnscheduleThreadsafeEvent(int event_type, u64 userdata)
 {
 	s64 result = 0;
-	std::lock_guard<std::mutex> lk(externalEventLock);
+	TakeIncomingTsEvents();
 	if (!tsFirst)
 		return result;
 	while(tsFirst)
@@ -420,57 +425,23 @@ void RegisterMHzChangeCallback(MHzChangeCallback callback) {
 
 bool IsScheduled(int event_type)
 {
-	if (!first)
-		return false;
-	Event *e = first;
-	while (e) {
-		if (e->type == event_type)
+	for (const QueuedEvent &ev : eventQueue) {
+		if (ev.type == event_type)
 			return true;
-		e = e->next;
 	}
 	return false;
 }
 
 void RemoveEvent(int event_type)
 {
-	if (!first)
-		return;
-	while(first)
-	{
-		if (first->type == event_type)
-		{
-			Event *next = first->next;
-			FreeEvent(first);
-			first = next;
-		}
-		else
-		{
-			break;
-		}
-	}
-	if (!first)
-		return;
-	Event *prev = first;
-	Event *ptr = prev->next;
-	while (ptr)
-	{
-		if (ptr->type == event_type)
-		{
-			prev->next = ptr->next;
-			FreeEvent(ptr);
-			ptr = prev->next;
-		}
-		else
-		{
-			prev = ptr;
-			ptr = ptr->next;
-		}
-	}
+	RemoveQueuedEvents([=](const QueuedEvent &ev) {
+		return ev.type == event_type;
+	});
 }
 
 void RemoveThreadsafeEvent(int event_type)
 {
-	std::lock_guard<std::mutex> lk(externalEventLock);
+	TakeIncomingTsEvents();
 	if (!tsFirst)
 	{
 		return;
@@ -522,16 +493,14 @@ void RemoveAllEvents(int event_type)
 //This raise only the events required while the fifo is processing data
 void ProcessFifoWaitEvents()
 {
-	while (first)
+	while (!eventQueue.empty())
 	{
-		if (first->time <= (s64)GetTicks())
+		if (eventQueue.front().time <= (s64)GetTicks())
 		{
-//			LOG(CPU, "[Scheduler] %s		 (%lld, %lld) ",
-//				first->name ? first->name : "?", (u64)GetTicks(), (u64)first->time);
-			Event* evt = first;
-			first = first->next;
-			event_types[evt->type].callback(evt->userdata, (int)(GetTicks() - evt->time));
-			FreeEvent(evt);
+			// Pop before calling, the callback may well schedule more events.
+			QueuedEvent evt = eventQueue.front();
+			PopFirstEvent();
+			event_types[evt.type].callback(evt.userdata, (int)(GetTicks() - evt.time));
 		}
 		else
 		{
@@ -542,27 +511,17 @@ void ProcessFifoWaitEvents()
 
 void MoveEvents()
 {
-	Common::AtomicStoreRelease(hasTsEvents, 0);
+	TakeIncomingTsEvents();
 
-	std::lock_guard<std::mutex> lk(externalEventLock);
 	// Move events from async queue into main queue
 	while (tsFirst)
 	{
 		Event *next = tsFirst->next;
-		AddEventToQueue(tsFirst);
+		AddEventToQueue(*tsFirst);
+		FreeTsEvent(tsFirst);
 		tsFirst = next;
 	}
 	tsLast = NULL;
-
-	// Move free events to threadsafe pool
-	while(allocatedTsEvents > 0 && eventPool)
-	{
-		Event *ev = eventPool;
-		eventPool = ev->next;
-		ev->next = eventTsPool;
-		eventTsPool = ev;
-		allocatedTsEvents--;
-	}
 }
 
 void ForceCheck()
@@ -586,11 +545,11 @@ void Advance()
 	globalTimer += cyclesExecuted;
 	currentMIPS->downcount = slicelength;
 
-	if (Common::AtomicLoadAcquire(hasTsEvents))
+	if (tsIncoming.load(std::memory_order_relaxed))
 		MoveEvents();
 	ProcessFifoWaitEvents();
 
-	if (!first)
+	if (eventQueue.empty())
 	{
 		// This should never happen in PPSSPP.
 		// WARN_LOG_REPORT(TIME, "WARNING - no events in queue. Setting currentMIPS->downcount to 10000");
@@ -602,7 +561,7 @@ void Advance()
 	else
 	{
 		// Note that events can eat cycles as well.
-		int target = (int)(first->time - globalTimer);
+		int target = (int)(eventQueue.front().time - globalTimer);
 		if (target > MAX_SLICE_LENGTH)
 			target = MAX_SLICE_LENGTH;
 
@@ -614,12 +573,8 @@ void Advance()
 
 void LogPendingEvents()
 {
-	Event *ptr = first;
-	while (ptr)
-	{
-		//INFO_LOG(CPU, "PENDING: Now: %lld Pending: %lld Type: %d", globalTimer, ptr->time, ptr->type);
-		ptr = ptr->next;
-	}
+	//for (const QueuedEvent &ev : GetSortedEvents())
+	//	INFO_LOG(CPU, "PENDING: Now: %lld Pending: %lld Type: %d", globalTimer, ev.time, ev.type);
 }
 
 void Idle(int maxIdle)
@@ -628,10 +583,10 @@ void Idle(int maxIdle)
 	if (maxIdle != 0 && cyclesDown > maxIdle)
 		cyclesDown = maxIdle;
 
-	if (first && cyclesDown > 0)
+	if (!eventQueue.empty() && cyclesDown > 0)
 	{
 		int cyclesExecuted = slicelength - currentMIPS->downcount;
-		int cyclesNextEvent = (int) (first->time - globalTimer);
+		int cyclesNextEvent = (int) (eventQueue.front().time - globalTimer);
 
 		if (cyclesNextEvent < cyclesExecuted + cyclesDown)
 		{
@@ -652,21 +607,19 @@ void Idle(int maxIdle)
 
 std::string GetScheduledEventsSummary()
 {
-	Event *ptr = first;
 	std::string text = "Scheduled events\n";
 	text.reserve(1000);
-	while (ptr)
+	for (const QueuedEvent &ev : GetSortedEvents())
 	{
-		unsigned int t = ptr->type;
+		unsigned int t = ev.type;
 		if (t >= event_types.size())
 			PanicAlert("Invalid event type"); // %i", t);
-		const char *name = event_types[ptr->type].name;
+		const char *name = event_types[ev.type].name;
 		if (!name)
 			name = "[unknown]";
 		char temp[512];
-		sprintf(temp, "%s : %i %08x%08x\n", name, (int)ptr->time, (u32)(ptr->userdata >> 32), (u32)(ptr->userdata));
+		sprintf(temp, "%s : %i %08x%08x\n", name, (int)ev.time, (u32)(ev.userdata >> 32), (u32)(ev.userdata));
 		text += temp;
-		ptr = ptr->next;
 	}
 	return text;
 }
@@ -686,7 +639,7 @@ void Event_DoStateOld(PointerWrap &p, BaseEvent *ev)
 
 void DoState(PointerWrap &p)
 {
-	std::lock_guard<std::mutex> lk(externalEventLock);
+	TakeIncomingTsEvents();
 
 	auto s = p.Section("CoreTiming", 1, 3);
 	if (!s)
@@ -697,6 +650,19 @@ void DoState(PointerWrap &p)
 	// These (should) be filled in later by the modules.
 	event_types.resize(n, EventType(AntiCrashCallback, "INVALID EVENT"));
 
+	// The queue is stored as a time-ordered linked list, as it used to be kept in memory.
+	Event *first = nullptr;
+	Event **tail = &first;
+	for (const QueuedEvent &ev : GetSortedEvents()) {
+		Event *e = GetNewEvent();
+		e->time = ev.time;
+		e->userdata = ev.userdata;
+		e->type = ev.type;
+		e->next = nullptr;
+		*tail = e;
+		tail = &e->next;
+	}
+
 	if (s >= 3) {
 		p.DoLinkedList<BaseEvent, GetNewEvent, FreeEvent, Event_DoState>(first, (Event **) NULL);
 		p.DoLinkedList<BaseEvent, GetNewTsEvent, FreeTsEvent, Event_DoState>(tsFirst, &tsLast);
@@ -705,6 +671,18 @@ void DoState(PointerWrap &p)
 		p.DoLinkedList<BaseEvent, GetNewTsEvent, FreeTsEvent, Event_DoStateOld>(tsFirst, &tsLast);
 	}
 
+	if (p.mode == PointerWrap::MODE_READ) {
+		ClearPendingEvents();
+		// Adding in list order keeps events for the same time in their original order.
+		for (Event *e = first; e; e = e->next)
+			AddEventToQueue(*e);
+	}
+	while (first) {
+		Event *next = first->next;
+		FreeEvent(first);
+		first = next;
+	}
+
 	p.Do(CPU_HZ);
 	p.Do(slicelength);
 	p.Do(globalTimer);
@@ -216,6 +216,7 @@ bool CheatFileParser::ValidateGameID(const std::string &gameID) {
 
 static void __CheatStop() {
 	if (cheatEngine) {
+		cheatEngine->ReportCosts();
 		delete cheatEngine;
 		cheatEngine = nullptr;
 	}
@@ -325,7 +326,34 @@ void CWCheatEngine::ParseCheats() {
 	parser.Parse();
 	// TODO: Report errors.
 
+	ReportCosts();
 	cheats_ = parser.GetCheats();
+	Compile();
+}
+
+void CWCheatEngine::Compile() {
+	compiled_.clear();
+	compiled_.resize(cheats_.size());
+	for (size_t c = 0; c < cheats_.size(); ++c) {
+		const CheatCode &cheat = cheats_[c];
+		CompiledCheat &compiled = compiled_[c];
+		compiled.ops.reserve(cheat.lines.size());
+		compiled.next.reserve(cheat.lines.size());
+		for (size_t i = 0; i < cheat.lines.size(); ++i) {
+			size_t next = i;
+			compiled.ops.push_back(InterpretNextOp(cheat, next));
+			compiled.next.push_back(next);
+		}
+	}
+}
+
+void CWCheatEngine::ReportCosts() {
+	for (size_t c = 0; c < compiled_.size(); ++c) {
+		const CompiledCheat &compiled = compiled_[c];
+		if (compiled.runs == 0)
+			continue;
+		INFO_LOG(COMMON, "Cheat %d: %lld runs, %lld ops, %lld icache invalidations, %lld writes skipped as unchanged", (int)c, (long long)compiled.runs, (long long)compiled.opsExecuted, (long long)compiled.invalidations, (long long)compiled.skippedWrites);
+	}
 }
 
 u32 CWCheatEngine::GetAddress(u32 value) {
@@ -368,73 +396,36 @@ std::vector<std::string> CWCheatEngine::GetCodesList() {
 }
 
 void CWCheatEngine::InvalidateICache(u32 addr, int size) {
+	if (current_)
+		current_->invalidations++;
 	currentMIPS->InvalidateICache(addr & ~3, size);
 }
 
-enum class CheatOp {
-	Invalid,
-	Noop,
-
-	Write,
-	Add,
-	Subtract,
-	Or,
-	And,
-	Xor,
-
-	MultiWrite,
-
-	CopyBytesFrom,
-	Delay,
-
-	Assert,
-
-	IfEqual,
-	IfNotEqual,
-	IfLess,
-	IfGreater,
-
-	IfAddrEqual,
-	IfAddrNotEqual,
-	IfAddrLess,
-	IfAddrGreater,
-
-	IfPressed,
-	IfNotPressed,
-
-	CwCheatPointerCommands,
-};
+// Most cheats write the same constant every time they run. Leave memory, and more importantly
+// the JIT's blocks, alone when the value is already there.
+bool CWCheatEngine::WriteIfChanged(u32 addr, int sz, u32 val) {
+	bool same = false;
+	if (sz == 1)
+		same = Memory::Read_U8(addr) == (u8)val;
+	else if (sz == 2)
+		same = Memory::Read_U16(addr) == (u16)val;
+	else if (sz == 4)
+		same = Memory::Read_U32(addr) == val;
+	if (same) {
+		if (current_)
+			current_->skippedWrites++;
+		return false;
+	}
 
-struct CheatOperation {
-	CheatOp op;
-	uint32_t addr;
-	int sz;
-	uint32_t val;
-
-	union {
-		struct {
-			uint32_t count;
-			uint32_t step;
-			uint32_t add;
-		} multiWrite;
-		struct {
-			uint32_t destAddr;
-		} copyBytesFrom;
-		struct {
-			uint32_t skip;
-		} ifTypes;
-		struct {
-			uint32_t skip;
-			uint32_t compareAddr;
-		} ifAddrTypes;
-		struct {
-			int offset;
-			int baseOffset;
-			int count;
-			int type;
-		} pointerCommands;
-	};
-};
+	InvalidateICache(addr, 4);
+	if (sz == 1)
+		Memory::Write_U8((u8)val, addr);
+	else if (sz == 2)
+		Memory::Write_U16((u16)val, addr);
+	else if (sz == 4)
+		Memory::Write_U32(val, addr);
+	return true;
+}
 
 CheatOperation CWCheatEngine::InterpretNextCwCheat(const CheatCode &cheat, size_t &i) {
 	const CheatLine &line1 = cheat.lines[i++];
@@ -702,13 +693,12 @@ CheatOperation CWCheatEngine::InterpretNextOp(const CheatCode &cheat, size_t &i)
 
 void CWCheatEngine::ApplyMemoryOperator(const CheatOperation &op, uint32_t(*oper)(uint32_t, uint32_t)) {
 	if (Memory::IsValidAddress(op.addr)) {
-		InvalidateICache(op.addr, 4);
 		if (op.sz == 1)
-			Memory::Write_U8((u8)oper(Memory::Read_U8(op.addr), op.val), op.addr);
+			WriteIfChanged(op.addr, 1, oper(Memory::Read_U8(op.addr), op.val));
 		else if (op.sz == 2)
-			Memory::Write_U16((u16)oper(Memory::Read_U16(op.addr), op.val),op. addr);
+			WriteIfChanged(op.addr, 2, oper(Memory::Read_U16(op.addr), op.val));
 		else if (op.sz == 4)
-			Memory::Write_U32((u32)oper(Memory::Read_U32(op.addr), op.val), op.addr);
+			WriteIfChanged(op.addr, 4, oper(Memory::Read_U32(op.addr), op.val));
 	}
 }
 
@@ -762,13 +752,7 @@ void CWCheatEngine::ExecuteOp(const CheatOperation &op, const CheatCode &cheat,
 
 	case CheatOp::Write:
 		if (Memory::IsValidAddress(op.addr)) {
-			InvalidateICache(op.addr, 4);
-			if (op.sz == 1)
-				Memory::Write_U8((u8)op.val, op.addr);
-			else if (op.sz == 2)
-				Memory::Write_U16((u16)op.val, op.addr);
-			else if (op.sz == 4)
-				Memory::Write_U32((u32)op.val, op.addr);
+			WriteIfChanged(op.addr, op.sz, op.val);
 		}
 		break;
 
@@ -1025,13 +1009,19 @@ void CWCheatEngine::ExecuteOp(const CheatOperation &op, const CheatCode &cheat,
 }
 
 void CWCheatEngine::Run() {
-	for (CheatCode cheat : cheats_) {
-		// InterpretNextOp and ExecuteOp move i.
+	for (size_t c = 0; c < cheats_.size(); ++c) {
+		const CheatCode &cheat = cheats_[c];
+		current_ = &compiled_[c];
+		current_->runs++;
+		// The compiled op says where the next one starts, and ExecuteOp may move i further.
 		for (size_t i = 0; i < cheat.lines.size(); ) {
-			CheatOperation op = InterpretNextOp(cheat, i);
+			const CheatOperation &op = current_->ops[i];
+			i = current_->next[i];
 			ExecuteOp(op, cheat, i);
+			current_->opsExecuted++;
 		}
 	}
+	current_ = nullptr;
 }
 
 bool CWCheatEngine::HasCheats() {
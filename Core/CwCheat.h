@@ -34,7 +34,83 @@ struct CheatCode {
 	std::vector<CheatLine> lines;
 };
 
-struct CheatOperation;
+enum class CheatOp {
+	Invalid,
+	Noop,
+
+	Write,
+	Add,
+	Subtract,
+	Or,
+	And,
+	Xor,
+
+	MultiWrite,
+
+	CopyBytesFrom,
+	Delay,
+
+	Assert,
+
+	IfEqual,
+	IfNotEqual,
+	IfLess,
+	IfGreater,
+
+	IfAddrEqual,
+	IfAddrNotEqual,
+	IfAddrLess,
+	IfAddrGreater,
+
+	IfPressed,
+	IfNotPressed,
+
+	CwCheatPointerCommands,
+};
+
+struct CheatOperation {
+	CheatOp op;
+	uint32_t addr;
+	int sz;
+	uint32_t val;
+
+	union {
+		struct {
+			uint32_t count;
+			uint32_t step;
+			uint32_t add;
+		} multiWrite;
+		struct {
+			uint32_t destAddr;
+		} copyBytesFrom;
+		struct {
+			uint32_t skip;
+		} ifTypes;
+		struct {
+			uint32_t skip;
+			uint32_t compareAddr;
+		} ifAddrTypes;
+		struct {
+			int offset;
+			int baseOffset;
+			int count;
+			int type;
+		} pointerCommands;
+	};
+};
+
+// Cheats are interpreted once in ParseCheats. The operation starting at each line is kept, along with
+// the line that follows it, since conditionals skip by lines and may land anywhere.
+struct CompiledCheat {
+	std::vector<CheatOperation> ops;
+	std::vector<size_t> next;
+
+	// Cost counters, reported when the cheats are reloaded or stopped.
+	uint64_t runs = 0;
+	uint64_t opsExecuted = 0;
+	uint64_t invalidations = 0;
+	uint64_t skippedWrites = 0;
+};
 
 class CWCheatEngine {
 public:
@@ -44,6 +120,7 @@ class CWCheatEngine {
 	void CreateCheatFile();
 	void Run();
 	bool HasCheats();
+	void ReportCosts();
 
 private:
 	void InvalidateICache(u32 addr, int size);
@@ -53,10 +130,15 @@ class CWCheatEngine {
 	CheatOperation InterpretNextCwCheat(const CheatCode &cheat, size_t &i);
 	CheatOperation InterpretNextTempAR(const CheatCode &cheat, size_t &i);
 
+	void Compile();
+	bool WriteIfChanged(u32 addr, int sz, u32 val);
+
 	void ExecuteOp(const CheatOperation &op, const CheatCode &cheat, size_t &i);
 	void ApplyMemoryOperator(const CheatOperation &op, uint32_t(*oper)(uint32_t, uint32_t));
 	bool TestIf(const CheatOperation &op, bool(*oper)(int a, int b));
 	bool TestIfAddr(const CheatOperation &op, bool(*oper)(int a, int b));
 
 	std::vector<CheatCode> cheats_;
+	std::vector<CompiledCheat> compiled_;
+	CompiledCheat *current_ = nullptr;
 };
@@ -15,13 +15,18 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#include <algorithm>
+#include <cctype>
 #include <cstdio>
+#include <cstring>
 
 #include "Common/Log.h"
+#include "Core/Config.h"
 #include "Core/Core.h"
 #include "Core/Debugger/Breakpoints.h"
 #include "Core/Debugger/SymbolMap.h"
 #include "Core/Host.h"
+#include "Core/MemMap.h"
 #include "Core/MIPS/MIPSAnalyst.h"
 #include "Core/MIPS/MIPSDebugInterface.h"
 #include "Core/MIPS/JitCommon/JitCommon.h"
@@ -271,6 +276,7 @@ void CBreakPoints::ChangeBreakPointAddCond(u32 addr, const BreakPointCond &cond)
 	{
 		breakPoints_[bp].hasCond = true;
 		breakPoints_[bp].cond = cond;
+		breakPoints_[bp].cond.fast.Compile(cond.debug, cond.expressionString);
 		Update(addr);
 	}
 }
@@ -293,6 +299,110 @@ BreakPointCond *CBreakPoints::GetBreakPointCondition(u32 addr)
 	return NULL;
 }
 
+bool CBreakPoints::GetBreakPointFastCond(u32 addr, BreakPointFastCond *cond)
+{
+	size_t bp = FindBreakpoint(addr, true, false);
+	if (bp == INVALID_BREAKPOINT || !breakPoints_[bp].hasCond || !breakPoints_[bp].cond.fast.valid)
+		return false;
+	*cond = breakPoints_[bp].cond.fast;
+	return true;
+}
+
+static bool ParseFastCondNumber(const std::string &str, u32 &value)
+{
+	// Floats, suffixes and symbols are left to the full parser.
+	size_t start = 0;
+	if (str.size() > 2 && str[0] == '0' && tolower(str[1]) == 'x')
+		start = 2;
+	else if (str.size() > 1 && str[0] == '$')
+		start = 1;
+	else if (str.empty() || !isdigit(str[0]))
+		return false;
+	if (str.size() - start > 8)
+		return false;
+
+	value = 0;
+	for (size_t i = start; i < str.size(); ++i) {
+		if (!isxdigit(str[i]))
+			return false;
+		value = (value << 4) | (u32)(isdigit(str[i]) ? str[i] - '0' : tolower(str[i]) - 'a' + 10);
+	}
+	return true;
+}
+
+bool BreakPointFastCond::Compile(DebugInterface *debug, const std::string &expression)
+{
+	valid = false;
+	if (!debug)
+		return false;
+
+	// Split into a register, an optional comparison, and a number.
+	std::string tokens[3];
+	int count = 0;
+	size_t pos = 0;
+	while (pos < expression.size()) {
+		char c = expression[pos];
+		if (c == ' ' || c == '\t') {
+			++pos;
+			continue;
+		}
+		if (count >= 3)
+			return false;
+		size_t end = pos;
+		if (isalnum(c) || c == '$') {
+			while (end < expression.size() && (isalnum(expression[end]) || expression[end] == '$'))
+				++end;
+		} else {
+			while (end < expression.size() && strchr("=!<>", expression[end]))
+				++end;
+			if (end == pos)
+				return false;
+		}
+		tokens[count++] = expression.substr(pos, end - pos);
+		pos = end;
+	}
+	if (count != 1 && count != 3)
+		return false;
+
+	int foundReg = -1;
+	for (int i = 0; i < 32; i++) {
+		char regName[8];
+		snprintf(regName, sizeof(regName), "r%d", i);
+		if (!strcasecmp(tokens[0].c_str(), regName) || !strcasecmp(tokens[0].c_str(), debug->GetRegName(0, i))) {
+			foundReg = i;
+			break;
+		}
+	}
+	if (foundReg == -1)
+		return false;
+
+	if (count == 1) {
+		op = OP_NE;
+		value = 0;
+	} else {
+		static const struct {
+			const char *str;
+			Op op;
+		} ops[] = {
+			{ "==", OP_EQ }, { "!=", OP_NE }, { "<", OP_LT }, { "<=", OP_LE }, { ">", OP_GT }, { ">=", OP_GE },
+		};
+		bool foundOp = false;
+		for (auto &o : ops) {
+			if (tokens[1] == o.str) {
+				op = o.op;
+				foundOp = true;
+				break;
+			}
+		}
+		if (!foundOp || !ParseFastCondNumber(tokens[2], value))
+			return false;
+	}
+
+	reg = (u8)foundReg;
+	valid = true;
+	return true;
+}
+
 void CBreakPoints::ChangeBreakPointLogFormat(u32 addr, const std::string &fmt) {
 	size_t bp = FindBreakpoint(addr, true, false);
 	if (bp != INVALID_BREAKPOINT) {
@@ -306,8 +416,7 @@ BreakAction CBreakPoints::ExecBreakPoint(u32 addr) {
 	if (bp != INVALID_BREAKPOINT) {
 		if (breakPoints_[bp].hasCond) {
 			// Evaluate the breakpoint and abort if necessary.
-			auto cond = CBreakPoints::GetBreakPointCondition(currentMIPS->pc);
-			if (cond && !cond->Evaluate())
+			if (!breakPoints_[bp].cond.Evaluate())
 				return BREAK_ACTION_IGNORE;
 		}
 
@@ -524,6 +633,82 @@ bool CBreakPoints::HasMemChecks()
 	return !memChecks_.empty();
 }
 
+// A watched write-on-change hit, waiting for the access to finish.
+static MemCheck *watchOnChange = nullptr;
+static u32 watchAddr;
+static u32 watchPC;
+static int watchSize;
+static u8 watchOldData[16];
+
+// Called from the fault handler, before (and maybe after) the faulting access.
+static bool MemCheckWatchHit(u32 address, const u8 *hostPC, bool completed)
+{
+	if (completed) {
+		MemCheck *check = watchOnChange;
+		watchOnChange = nullptr;
+		if (check && memcmp(watchOldData, Memory::GetPointerUnchecked(watchAddr), watchSize) != 0)
+			check->Action(watchAddr, true, watchSize, watchPC);
+		return false;
+	}
+
+	// HLE does its own checks, and other threads (like the GPU) aren't reported.
+	u32 pc;
+	if (!MIPSComp::jit || !MIPSComp::jit->GetMemCheckSite(hostPC, &pc))
+		return false;
+
+	int size = MIPSAnalyst::OpMemoryAccessSize(pc);
+	if (size == 0 && MIPSAnalyst::OpHasDelaySlot(pc)) {
+		pc += 4;
+		size = MIPSAnalyst::OpMemoryAccessSize(pc);
+	}
+	if (size == 0)
+		return false;
+
+	// The page faulted, but the access might not touch any check on it.
+	bool write = MIPSAnalyst::IsOpMemoryWrite(pc);
+	MemCheck *check = CBreakPoints::GetMemCheck(address, size);
+	if (!check)
+		return false;
+
+	int mask = MEMCHECK_WRITE | MEMCHECK_WRITE_ONCHANGE;
+	if (write && (check->cond & mask) == mask) {
+		watchOnChange = check;
+		watchAddr = address;
+		watchPC = pc;
+		watchSize = std::min(size, (int)sizeof(watchOldData));
+		memcpy(watchOldData, Memory::GetPointerUnchecked(address), watchSize);
+		return true;
+	}
+	check->Action(address, write, size, pc);
+	return false;
+}
+
+void CBreakPoints::UpdateWatchedPages()
+{
+	watchOnChange = nullptr;
+	if (!g_Config.bMemCheckPageProtection || memChecks_.empty() || !Memory::IsActive()) {
+		Memory::ClearWatchedRanges();
+		return;
+	}
+
+	std::vector<Memory::WatchRange> ranges;
+	for (const MemCheck &check : memChecks_) {
+		ranges.push_back({ check.start, check.end != 0 ? check.end : check.start + 1, (check.cond & MEMCHECK_READ) != 0 });
+	}
+	Memory::SetWatchHitFunc(&MemCheckWatchHit);
+	Memory::SetWatchedRanges(ranges);
+}
+
+bool CBreakPoints::MemChecksUsePages()
+{
+	if (!g_Config.bMemCheckPageProtection || memChecks_.empty())
+		return false;
+	// Memory may have been reset (e.g. on boot) since the checks were added.
+	if (!Memory::IsWatchingPages())
+		UpdateWatchedPages();
+	return Memory::IsWatchingPages();
+}
+
 void CBreakPoints::Update(u32 addr)
 {
 	if (MIPSComp::jit)
@@ -537,10 +722,13 @@ void CBreakPoints::Update(u32 addr)
 		}
 		
 		// In case this is a delay slot, clear the previous instruction too.
-		if (addr != 0)
+		if (addr != 0) {
 			MIPSComp::jit->InvalidateCacheAt(addr - 4, 8);
-		else
+		} else {
+			// Blocks compiled against the old watch (or none) don't check the right things.
+			UpdateWatchedPages();
 			MIPSComp::jit->ClearCache();
+		}
 
 		if (resume)
 			Core_EnableStepping(false);
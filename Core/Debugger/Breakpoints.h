@@ -37,11 +37,42 @@ static inline BreakAction operator | (const BreakAction &lhs, const BreakAction
 	return BreakAction((u32)lhs | (u32)rhs);
 }
 
+// A condition like "a0 == 1234" or just "v0", which can be checked without the expression
+// parser, and inline by the jit.  Like expressions, numbers are hex by default.
+struct BreakPointFastCond
+{
+	enum Op : u8 {
+		OP_EQ, OP_NE, OP_LT, OP_LE, OP_GT, OP_GE,
+	};
+
+	bool valid = false;
+	u8 reg = 0;
+	Op op = OP_NE;
+	u32 value = 0;
+
+	bool Compile(DebugInterface *debug, const std::string &expression);
+
+	// Unsigned, same as the expression parser.
+	bool Evaluate(u32 regValue) const
+	{
+		switch (op) {
+		case OP_EQ: return regValue == value;
+		case OP_NE: return regValue != value;
+		case OP_LT: return regValue < value;
+		case OP_LE: return regValue <= value;
+		case OP_GT: return regValue > value;
+		case OP_GE: return regValue >= value;
+		}
+		return true;
+	}
+};
+
 struct BreakPointCond
 {
 	DebugInterface *debug;
 	PostfixExpression expression;
 	std::string expressionString;
+	BreakPointFastCond fast;
 
 	BreakPointCond() : debug(nullptr)
 	{
@@ -49,6 +80,8 @@ struct BreakPointCond
 
 	u32 Evaluate()
 	{
+		if (fast.valid)
+			return fast.Evaluate(debug->GetRegValue(0, fast.reg)) ? 1 : 0;
 		u32 result;
 		if (debug->parseExpression(expression,result) == false) return 0;
 		return result;
@@ -144,6 +177,8 @@ class CBreakPoints
 	static void ChangeBreakPointAddCond(u32 addr, const BreakPointCond &cond);
 	static void ChangeBreakPointRemoveCond(u32 addr);
 	static BreakPointCond *GetBreakPointCondition(u32 addr);
+	// True if the breakpoint's condition is simple enough for the jit to check inline.
+	static bool GetBreakPointFastCond(u32 addr, BreakPointFastCond *cond);
 
 	static void ChangeBreakPointLogFormat(u32 addr, const std::string &fmt);
 
@@ -174,6 +209,9 @@ class CBreakPoints
 	static const std::vector<BreakPoint> GetBreakpoints();
 
 	static bool HasMemChecks();
+	// True if memchecks are caught by watching pages, so the jit needn't check each access.
+	// Arms the watch if it isn't yet, so only call this on the emu thread (while compiling.)
+	static bool MemChecksUsePages();
 
 	static void Update(u32 addr = 0);
 
@@ -184,6 +222,7 @@ class CBreakPoints
 	static size_t FindBreakpoint(u32 addr, bool matchTemp = false, bool temp = false);
 	// Finds exactly, not using a range check.
 	static size_t FindMemCheck(u32 start, u32 end);
+	static void UpdateWatchedPages();
 
 	static std::vector<BreakPoint> breakPoints_;
 	static u32 breakSkipFirstAt_;
@@ -0,0 +1,152 @@
+// Copyright (c) 2017- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+#include "Common/FileUtil.h"
+#include "Common/Log.h"
+#include "Core/CoreTiming.h"
+#include "Core/Debugger/SamplingProfiler.h"
+#include "Core/Debugger/SymbolMap.h"
+#include "Core/MIPS/MIPS.h"
+#include "Core/MIPS/JitCommon/JitBlockCache.h"
+#include "Core/MIPS/JitCommon/JitCommon.h"
+
+namespace SamplingProfiler {
+
+static int sampleEvent = -1;
+static bool running = false;
+static int sampleIntervalUs = 100;
+// Events from a previous run (or a savestate) carry an older generation, and are ignored.
+static u64 sampleGeneration = 0;
+static u64 totalSamples = 0;
+static std::unordered_map<u32, u32> pcSamples;
+
+static void SampleCallback(u64 userdata, int cyclesLate) {
+	if (!running || userdata != sampleGeneration) {
+		return;
+	}
+
+	pcSamples[currentMIPS->pc]++;
+	totalSamples++;
+	CoreTiming::ScheduleEvent(usToCycles(sampleIntervalUs) - cyclesLate, sampleEvent, userdata);
+}
+
+void Init() {
+	// Always registered, so savestates are compatible whether profiling or not.
+	sampleEvent = CoreTiming::RegisterEvent("SamplingProfiler", &SampleCallback);
+	running = false;
+}
+
+void Shutdown() {
+	running = false;
+	pcSamples.clear();
+	totalSamples = 0;
+}
+
+void Start(int intervalUs) {
+	if (running || sampleEvent == -1)
+		return;
+	sampleIntervalUs = std::max(intervalUs, 1);
+	pcSamples.clear();
+	totalSamples = 0;
+	running = true;
+	sampleGeneration++;
+	// Usually started from the UI.
+	CoreTiming::ScheduleEvent_Threadsafe(usToCycles(sampleIntervalUs), sampleEvent, sampleGeneration);
+}
+
+void Stop() {
+	// Any pending event just won't reschedule.
+	running = false;
+}
+
+bool IsRunning() {
+	return running;
+}
+
+struct FunctionStats {
+	u32 address;
+	u64 samples;
+	int blocks;
+	u32 codeSize;
+};
+
+static u32 FunctionFor(u32 pc) {
+	u32 start = g_symbolMap ? g_symbolMap->GetFunctionStart(pc) : SymbolMap::INVALID_ADDRESS;
+	return start == SymbolMap::INVALID_ADDRESS ? pc : start;
+}
+
+bool WriteReport(const std::string &filename, int maxFunctions) {
+	std::unordered_map<u32, FunctionStats> functions;
+	for (const auto &it : pcSamples) {
+		u32 func = FunctionFor(it.first);
+		FunctionStats &stats = functions[func];
+		stats.address = func;
+		stats.samples += it.second;
+	}
+
+	// Count up the jit code generated for the sampled functions.
+	JitBlockCache *blocks = MIPSComp::jit ? MIPSComp::jit->GetBlockCache() : nullptr;
+	if (blocks) {
+		for (int i = 0; i < blocks->GetNumBlocks(); ++i) {
+			const JitBlock *b = blocks->GetBlock(i);
+			if (b->invalid)
+				continue;
+			auto it = functions.find(FunctionFor(b->originalAddress));
+			if (it == functions.end())
+				continue;
+			it->second.blocks++;
+			it->second.codeSize += b->codeSize;
+		}
+	}
+
+	std::vector<FunctionStats> sorted;
+	sorted.reserve(functions.size());
+	for (const auto &it : functions)
+		sorted.push_back(it.second);
+	std::sort(sorted.begin(), sorted.end(), [](const FunctionStats &a, const FunctionStats &b) {
+		return a.samples > b.samples;
+	});
+
+	FILE *f = File::OpenCFile(filename, "a");
+	if (!f) {
+		ERROR_LOG(CPU, "Unable to write guest profile to %s", filename.c_str());
+		return false;
+	}
+
+	fprintf(f, "%llu samples, one per %d us of emulated time\n", (unsigned long long)totalSamples, sampleIntervalUs);
+	fprintf(f, "\n%-40s %10s %8s %8s %8s %10s\n", "Function", "address", "samples", "%", "blocks", "code bytes");
+	for (int i = 0; i < (int)sorted.size() && i < maxFunctions; ++i) {
+		const FunctionStats &stats = sorted[i];
+		std::string name = g_symbolMap ? g_symbolMap->GetLabelString(stats.address) : "";
+		if (name.empty())
+			name = "(unknown)";
+		double percent = totalSamples ? stats.samples * 100.0 / totalSamples : 0.0;
+		if (blocks)
+			fprintf(f, "%-40s %08x %8llu %8.2f %8d %10u\n", name.c_str(), stats.address, (unsigned long long)stats.samples, percent, stats.blocks, stats.codeSize);
+		else
+			fprintf(f, "%-40s %08x %8llu %8.2f %8s %10s\n", name.c_str(), stats.address, (unsigned long long)stats.samples, percent, "-", "-");
+	}
+	fprintf(f, "\n");
+	fclose(f);
+	return true;
+}
+
+}
@@ -0,0 +1,39 @@
+// Copyright (c) 2017- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#pragma once
+
+#include <string>
+
+#include "Common/CommonTypes.h"
+
+// Samples the emulated PC at a fixed interval of emulated time, to find the hot guest functions.
+// Sampling runs from a CoreTiming event, so the PC is exact even when running jit code.
+namespace SamplingProfiler {
+
+// Called on kernel init and shutdown.
+void Init();
+void Shutdown();
+
+void Start(int intervalUs = 100);
+void Stop();
+bool IsRunning();
+
+// Writes the functions with the most samples, along with their jit block counts and code sizes.
+bool WriteReport(const std::string &filename, int maxFunctions = 50);
+
+}
@@ -0,0 +1,273 @@
+// Copyright (c) 2017- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "base/stringutil.h"
+#include "base/timeutil.h"
+#include "net/http_server.h"
+#include "net/sinks.h"
+#include "thread/executor.h"
+#include "thread/threadutil.h"
+
+#include "Common/Log.h"
+#include "Core/Config.h"
+#include "Core/MemMap.h"
+#include "Core/System.h"
+#include "Core/Debugger/StatsServer.h"
+#include "Core/HLE/__sceAudio.h"
+#include "Core/HLE/sceDisplay.h"
+#include "Core/MIPS/MIPS.h"
+#include "Core/MIPS/JitCommon/JitBlockCache.h"
+#include "Core/MIPS/JitCommon/JitCommon.h"
+#include "GPU/GPU.h"
+
+enum class ServerStatus {
+	STOPPED,
+	STARTING,
+	RUNNING,
+	STOPPING,
+};
+
+static std::mutex serverStatusLock;
+static std::condition_variable serverStatusCond;
+static ServerStatus serverStatus = ServerStatus::STOPPED;
+// Connections being handled, the server waits for these before going away.
+static int activeConnections = 0;
+static std::atomic<int> streamClients(0);
+// Held while reading emulated state, so PSP_Shutdown can't free it underneath us.
+static std::mutex inspectLock;
+
+static const u32 MAX_MEM_DUMP = 0x10000;
+
+// Each connection gets its own thread, so a stream doesn't block the other endpoints.
+class ConnectionThreadExecutor : public threading::Executor {
+public:
+	void Run(std::function<void()> func) override {
+		{
+			std::lock_guard<std::mutex> guard(serverStatusLock);
+			activeConnections++;
+		}
+		std::thread([func] {
+			setCurrentThreadName("StatsConnection");
+			func();
+
+			std::lock_guard<std::mutex> guard(serverStatusLock);
+			activeConnections--;
+			serverStatusCond.notify_all();
+		}).detach();
+	}
+};
+
+static void UpdateStatus(ServerStatus s) {
+	std::lock_guard<std::mutex> guard(serverStatusLock);
+	serverStatus = s;
+	serverStatusCond.notify_all();
+}
+
+static ServerStatus RetrieveStatus() {
+	std::lock_guard<std::mutex> guard(serverStatusLock);
+	return serverStatus;
+}
+
+static std::string FormatStatsLine(double now, double interval, int flips) {
+	float vps, fps, actualFps;
+	__DisplayGetFPS(&vps, &fps, &actualFps);
+	const AudioDebugStats *audio = __AudioGetDebugStats();
+
+	int jitBlocks = 0;
+	{
+		std::lock_guard<std::mutex> guard(inspectLock);
+		if (PSP_IsInited() && MIPSComp::jit) {
+			jitBlocks = MIPSComp::jit->GetBlockCacheDebugInterface()->GetNumBlocks();
+		}
+	}
+
+	// Per-frame counters are only reset each frame while debug stats are collected, see StatsServerHasClients().
+	double frameMs = flips > 0 ? (interval * 1000.0) / flips : 0.0;
+	return StringFromFormat(
+		"{\"time\": %0.3f, \"running\": %s, \"vps\": %0.2f, \"fps\": %0.2f, \"actual_fps\": %0.2f, \"frame_ms\": %0.3f, "
+		"\"flips\": %d, \"draw_calls\": %d, \"verts\": %d, \"textures_decoded\": %d, \"texture_invalidations\": %d, \"shader_switches\": %d, "
+		"\"jit_blocks\": %d, \"audio\": {\"buffered\": %d, \"watermark\": %d, \"bufsize\": %d, \"underruns\": %d, \"overruns\": %d}}\n",
+		now, PSP_IsInited() ? "true" : "false", vps, fps, actualFps, frameMs,
+		gpuStats.numFlips, gpuStats.numDrawCalls, gpuStats.numVertsSubmitted, gpuStats.numTexturesDecoded, gpuStats.numTextureInvalidations, gpuStats.numShaderSwitches,
+		jitBlocks, audio->buffered, audio->watermark, audio->bufsize, audio->underrunCount, audio->overrunCount);
+}
+
+static void HandleStats(const http::Request &request) {
+	int rate = g_Config.iStatsServerRate;
+	std::string value;
+	if (request.GetParamValue("rate", &value)) {
+		rate = atoi(value.c_str());
+	}
+	if (rate < 1)
+		rate = 1;
+	if (rate > 120)
+		rate = 120;
+
+	// No Content-Length, the stream ends when the client hangs up.
+	request.WriteHttpResponseHeader(200, -1, "application/x-ndjson", "Cache-Control: no-cache\r\n");
+	streamClients++;
+
+	double lastTime = real_time_now();
+	int lastFlips = gpuStats.numFlips;
+	while (RetrieveStatus() == ServerStatus::RUNNING) {
+		double now = real_time_now();
+		int flips = gpuStats.numFlips;
+		request.Out()->Push(FormatStatsLine(now, now - lastTime, flips - lastFlips));
+		if (!request.Out()->Flush()) {
+			break;
+		}
+
+		lastTime = now;
+		lastFlips = flips;
+		sleep_ms(1000 / rate);
+	}
+
+	streamClients--;
+}
+
+static void HandleRegs(const http::Request &request) {
+	std::lock_guard<std::mutex> guard(inspectLock);
+	if (!PSP_IsInited() || !currentMIPS) {
+		request.WriteHttpResponseHeader(503, -1, "text/plain");
+		request.Out()->Push("No game running.");
+		return;
+	}
+
+	std::string out = "{\"gpr\": [";
+	for (int i = 0; i < 32; ++i) {
+		out += StringFromFormat(i == 0 ? "\"%08x\"" : ", \"%08x\"", currentMIPS->r[i]);
+	}
+	out += StringFromFormat("], \"pc\": \"%08x\", \"hi\": \"%08x\", \"lo\": \"%08x\"}\n", currentMIPS->pc, currentMIPS->hi, currentMIPS->lo);
+
+	request.WriteHttpResponseHeader(200, out.size(), "application/json");
+	request.Out()->Push(out);
+}
+
+static void HandleMem(const http::Request &request) {
+	std::string addrParam, sizeParam;
+	if (!request.GetParamValue("addr", &addrParam)) {
+		request.WriteHttpResponseHeader(400, -1, "text/plain");
+		request.Out()->Push("Missing addr parameter.");
+		return;
+	}
+	u32 addr = (u32)strtoul(addrParam.c_str(), nullptr, 16);
+	u32 size = 256;
+	if (request.GetParamValue("size", &sizeParam)) {
+		size = (u32)strtoul(sizeParam.c_str(), nullptr, 0);
+	}
+	if (size == 0 || size > MAX_MEM_DUMP) {
+		request.WriteHttpResponseHeader(400, -1, "text/plain");
+		request.Out()->Push("Bad size parameter.");
+		return;
+	}
+
+	std::lock_guard<std::mutex> guard(inspectLock);
+	if (!PSP_IsInited()) {
+		request.WriteHttpResponseHeader(503, -1, "text/plain");
+		request.Out()->Push("No game running.");
+		return;
+	}
+	if (!Memory::IsValidRange(addr, size)) {
+		request.WriteHttpResponseHeader(400, -1, "text/plain");
+		request.Out()->Push("Invalid memory range.");
+		return;
+	}
+
+	const u8 *ptr = Memory::GetPointer(addr);
+	std::string out;
+	out.reserve((size / 16 + 1) * 60);
+	for (u32 i = 0; i < size; i += 16) {
+		out += StringFromFormat("%08x ", addr + i);
+		for (u32 j = i; j < i + 16 && j < size; ++j) {
+			out += StringFromFormat(" %02x", ptr[j]);
+		}
+		out += "\n";
+	}
+
+	request.WriteHttpResponseHeader(200, out.size(), "text/plain");
+	request.Out()->Push(out);
+}
+
+static void ExecuteServer() {
+	setCurrentThreadName("StatsServer");
+
+	auto http = new http::Server(new ConnectionThreadExecutor());
+	http->RegisterHandler("/stats", &HandleStats);
+	http->RegisterHandler("/regs", &HandleRegs);
+	http->RegisterHandler("/mem", &HandleMem);
+
+	if (!http->Listen(g_Config.iStatsServerPort)) {
+		ERROR_LOG(SYSTEM, "Stats server unable to listen on port %d", g_Config.iStatsServerPort);
+		UpdateStatus(ServerStatus::STOPPED);
+		delete http;
+		return;
+	}
+	NOTICE_LOG(SYSTEM, "Stats server listening on port %d", http->Port());
+	UpdateStatus(ServerStatus::RUNNING);
+
+	while (RetrieveStatus() == ServerStatus::RUNNING) {
+		http->RunSlice(1.0);
+	}
+
+	http->Stop();
+
+	// Streams notice the status change within one sample, and a stalled client within a few seconds.
+	std::unique_lock<std::mutex> guard(serverStatusLock);
+	serverStatusCond.wait(guard, [] { return activeConnections == 0; });
+	delete http;
+
+	serverStatus = ServerStatus::STOPPED;
+	serverStatusCond.notify_all();
+}
+
+bool StartStatsServer() {
+	std::lock_guard<std::mutex> guard(serverStatusLock);
+	if (serverStatus != ServerStatus::STOPPED) {
+		return false;
+	}
+
+	serverStatus = ServerStatus::STARTING;
+	std::thread(&ExecuteServer).detach();
+	return true;
+}
+
+void StopStatsServer() {
+	std::lock_guard<std::mutex> guard(serverStatusLock);
+	if (serverStatus == ServerStatus::RUNNING) {
+		serverStatus = ServerStatus::STOPPING;
+	}
+}
+
+bool IsStatsServerRunning() {
+	return RetrieveStatus() != ServerStatus::STOPPED;
+}
+
+bool StatsServerHasClients() {
+	return streamClients > 0;
+}
+
+void StatsServer_NotifyShutdown() {
+	// Readers check PSP_IsInited() under this lock, and it's already false by now.
+	std::lock_guard<std::mutex> guard(inspectLock);
+}
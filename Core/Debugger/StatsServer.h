@@ -0,0 +1,34 @@
+// Copyright (c) 2017- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#pragma once
+
+// A small HTTP server for watching a running game from another machine.
+//   /stats?rate=N      streams one line of JSON per sample, N per second, until the client disconnects.
+//   /regs              a single line of JSON with the GPRs, pc, hi, and lo.
+//   /mem?addr=X&size=N hex dump of emulated memory (addr in hex, size up to 64KB.)
+// Everything is read from the server's own threads, so the emulator does no extra work.
+
+bool StartStatsServer();
+void StopStatsServer();
+bool IsStatsServerRunning();
+
+// True while at least one /stats stream is open, so per-frame stats can be collected only then.
+bool StatsServerHasClients();
+
+// Called before emulated memory goes away, waits for any in progress reads to finish.
+void StatsServer_NotifyShutdown();
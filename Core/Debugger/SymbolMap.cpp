@@ -550,8 +550,7 @@ void SymbolMap::AddFunction(const char* name, u32 address, u32 size, int moduleI
 		// Refresh the active item if it exists.
 		auto active = activeFunctions.find(address);
 		if (active != activeFunctions.end() && active->second.module == moduleIndex) {
-			activeFunctions.erase(active);
-			activeFunctions.insert(std::make_pair(address, existing->second));
+			active->second = existing->second;
 		}
 	} else {
 		FunctionEntry func;
@@ -682,32 +681,39 @@ void SymbolMap::UpdateActiveSymbols() {
 		activeModuleIndexes[it->second.index] = it->second.start;
 	}
 
+	// Appending and sorting once is much faster than inserting one by one for big games.
+	activeFunctions.reserve(functions.size());
 	for (auto it = functions.begin(), end = functions.end(); it != end; ++it) {
 		const auto mod = activeModuleIndexes.find(it->second.module);
 		if (it->second.module == 0) {
-			activeFunctions.insert(std::make_pair(it->second.start, it->second));
+			activeFunctions.Append(it->second.start, it->second);
 		} else if (mod != activeModuleIndexes.end()) {
-			activeFunctions.insert(std::make_pair(mod->second + it->second.start, it->second));
+			activeFunctions.Append(mod->second + it->second.start, it->second);
 		}
 	}
+	activeFunctions.Sort();
 
+	activeLabels.reserve(labels.size());
 	for (auto it = labels.begin(), end = labels.end(); it != end; ++it) {
 		const auto mod = activeModuleIndexes.find(it->second.module);
 		if (it->second.module == 0) {
-			activeLabels.insert(std::make_pair(it->second.addr, it->second));
+			activeLabels.Append(it->second.addr, it->second);
 		} else if (mod != activeModuleIndexes.end()) {
-			activeLabels.insert(std::make_pair(mod->second + it->second.addr, it->second));
+			activeLabels.Append(mod->second + it->second.addr, it->second);
 		}
 	}
+	activeLabels.Sort();
 
+	activeData.reserve(data.size());
 	for (auto it = data.begin(), end = data.end(); it != end; ++it) {
 		const auto mod = activeModuleIndexes.find(it->second.module);
 		if (it->second.module == 0) {
-			activeData.insert(std::make_pair(it->second.start, it->second));
+			activeData.Append(it->second.start, it->second);
 		} else if (mod != activeModuleIndexes.end()) {
-			activeData.insert(std::make_pair(mod->second + it->second.start, it->second));
+			activeData.Append(mod->second + it->second.start, it->second);
 		}
 	}
+	activeData.Sort();
 
 	AssignFunctionIndices();
 	activeNeedUpdate_ = false;
@@ -725,8 +731,7 @@ bool SymbolMap::SetFunctionSize(u32 startAddress, u32 newSize) {
 		auto func = functions.find(symbolKey);
 		if (func != functions.end()) {
 			func->second.size = newSize;
-			activeFunctions.erase(funcInfo);
-			activeFunctions.insert(std::make_pair(startAddress, func->second));
+			funcInfo->second = func->second;
 		}
 	}
 
@@ -797,8 +802,7 @@ void SymbolMap::AddLabel(const char* name, u32 address, int moduleIndex) {
 			// Refresh the active item if it exists.
 			auto active = activeLabels.find(address);
 			if (active != activeLabels.end() && active->second.module == moduleIndex) {
-				activeLabels.erase(active);
-				activeLabels.insert(std::make_pair(address, label));
+				active->second = label;
 			}
 		}
 	} else {
@@ -832,8 +836,7 @@ void SymbolMap::SetLabelName(const char* name, u32 address) {
 			// Refresh the active item if it exists.
 			auto active = activeLabels.find(address);
 			if (active != activeLabels.end() && active->second.module == label->second.module) {
-				activeLabels.erase(active);
-				activeLabels.insert(std::make_pair(address, label->second));
+				active->second = label->second;
 			}
 		}
 	}
@@ -915,8 +918,7 @@ void SymbolMap::AddData(u32 address, u32 size, DataType type, int moduleIndex) {
 		// Refresh the active item if it exists.
 		auto active = activeData.find(address);
 		if (active != activeData.end() && active->second.module == moduleIndex) {
-			activeData.erase(active);
-			activeData.insert(std::make_pair(address, existing->second));
+			active->second = existing->second;
 		}
 	} else {
 		DataEntry entry;
@@ -17,6 +17,7 @@
 
 #pragma once
 
+#include <algorithm>
 #include <vector>
 #include <set>
 #include <map>
@@ -58,6 +59,68 @@ enum DataType {
 
 struct LabelDefinition;
 
+// Address -> entry, kept as a sorted vector so lookups are a cache friendly binary search.
+// Single inserts work like std::map, and rebuilds can Append() everything and Sort() once.
+template <typename T>
+class SortedAddressMap {
+public:
+	typedef std::pair<u32, T> value_type;
+	typedef typename std::vector<value_type>::iterator iterator;
+	typedef typename std::vector<value_type>::const_iterator const_iterator;
+	typedef typename std::vector<value_type>::reverse_iterator reverse_iterator;
+
+	iterator begin() { return entries_.begin(); }
+	iterator end() { return entries_.end(); }
+	const_iterator begin() const { return entries_.begin(); }
+	const_iterator end() const { return entries_.end(); }
+	reverse_iterator rbegin() { return entries_.rbegin(); }
+	reverse_iterator rend() { return entries_.rend(); }
+	size_t size() const { return entries_.size(); }
+	bool empty() const { return entries_.empty(); }
+	void clear() { entries_.clear(); }
+	void reserve(size_t n) { entries_.reserve(n); }
+
+	iterator lower_bound(u32 addr) {
+		return std::lower_bound(entries_.begin(), entries_.end(), addr, &KeyLess);
+	}
+	iterator upper_bound(u32 addr) {
+		return std::upper_bound(entries_.begin(), entries_.end(), addr, &LessKey);
+	}
+	iterator find(u32 addr) {
+		iterator it = lower_bound(addr);
+		return it != entries_.end() && it->first == addr ? it : entries_.end();
+	}
+
+	// Like std::map, leaves an existing entry alone.
+	std::pair<iterator, bool> insert(const value_type &v) {
+		iterator it = lower_bound(v.first);
+		if (it != entries_.end() && it->first == v.first)
+			return std::make_pair(it, false);
+		return std::make_pair(entries_.insert(it, v), true);
+	}
+	void erase(iterator it) {
+		entries_.erase(it);
+	}
+
+	// Must be followed by Sort() before any lookups.
+	void Append(u32 addr, const T &v) {
+		entries_.push_back(value_type(addr, v));
+	}
+	// Keeps the first appended of any duplicates, same as a series of insert()s would.
+	void Sort() {
+		std::stable_sort(entries_.begin(), entries_.end(), &EntryLess);
+		entries_.erase(std::unique(entries_.begin(), entries_.end(), &EntryEqual), entries_.end());
+	}
+
+private:
+	static bool KeyLess(const value_type &a, u32 b) { return a.first < b; }
+	static bool LessKey(u32 a, const value_type &b) { return a < b.first; }
+	static bool EntryLess(const value_type &a, const value_type &b) { return a.first < b.first; }
+	static bool EntryEqual(const value_type &a, const value_type &b) { return a.first == b.first; }
+
+	std::vector<value_type> entries_;
+};
+
 #ifdef _WIN32
 struct HWND__;
 typedef struct HWND__ *HWND;
@@ -152,10 +215,10 @@ class SymbolMap {
 		char name[128];
 	};
 
-	// These are flattened, read-only copies of the actual data in active modules only.
-	std::map<u32, const FunctionEntry> activeFunctions;
-	std::map<u32, const LabelEntry> activeLabels;
-	std::map<u32, const DataEntry> activeData;
+	// These are flattened copies of the actual data in active modules only.
+	SortedAddressMap<FunctionEntry> activeFunctions;
+	SortedAddressMap<LabelEntry> activeLabels;
+	SortedAddressMap<DataEntry> activeData;
 	bool activeNeedUpdate_ = false;
 
 	// This is indexed by the end address of the module.
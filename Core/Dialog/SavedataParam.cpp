@@ -36,6 +36,7 @@
 #include "image/png_load.h"
 
 #include <algorithm>
+#include <thread>
 
 static const std::string ICON0_FILENAME = "ICON0.PNG";
 static const std::string ICON1_FILENAME = "ICON1.PMF";
@@ -45,6 +46,9 @@ static const std::string SFO_FILENAME = "PARAM.SFO";
 
 static const std::string savePath = "ms0:/PSP/SAVEDATA/";
 
+// Save directories rarely hold more than a few MB, but games may put anything in them.
+static const u64 MAX_PREFETCH_SIZE = 32 * 1024 * 1024;
+
 namespace
 {
 	int getSizeNormalized(int size)
@@ -378,6 +382,9 @@ bool SavedataParam::Save(SceUtilitySavedataParam* param, const std::string &save
 	memset(cryptedHash,0,0x10);
 	// Encrypt save.
 	// TODO: Is this the correct difference between MAKEDATA and MAKEDATASECURE?
+	// The encryption is the slow part, so it runs alongside the file writes that don't depend on it.
+	// Only this thread touches chnnlsv until it's joined (its work buffer is global.)
+	std::thread cryptThread;
 	if (param->dataBuf.IsValid() && g_Config.bEncryptSave && secureMode)
 	{
 		cryptedSize = param->dataSize;
@@ -390,26 +397,54 @@ bool SavedataParam::Save(SceUtilitySavedataParam* param, const std::string &save
 		memcpy(cryptedData, data_, cryptedSize);
 
 		int decryptMode = DetermineCryptMode(param);
-		if (EncryptData(decryptMode, cryptedData, &cryptedSize, &aligned_len, cryptedHash, (HasKey(param) ? param->key : 0)) != 0)
-		{
-			I18NCategory *err = GetI18NCategory("Error");
-			host->NotifyUserMessage(err->T("Save encryption failed. This save won't work on real PSP"), 6.0f);
-			ERROR_LOG(SCEUTILITY,"Save encryption failed. This save won't work on real PSP");
-			delete[] cryptedData;
-			cryptedData = 0;
-		}
+		cryptThread = std::thread([=, &cryptedData, &cryptedSize, &cryptedHash]() mutable {
+			if (EncryptData(decryptMode, cryptedData, &cryptedSize, &aligned_len, cryptedHash, (HasKey(param) ? param->key : 0)) != 0)
+			{
+				I18NCategory *err = GetI18NCategory("Error");
+				host->NotifyUserMessage(err->T("Save encryption failed. This save won't work on real PSP"), 6.0f);
+				ERROR_LOG(SCEUTILITY,"Save encryption failed. This save won't work on real PSP");
+				delete[] cryptedData;
+				cryptedData = 0;
+			}
+		});
+	}
+
+	// SAVE ICON0
+	if (param->icon0FileData.buf.IsValid())
+	{
+		std::string icon0path = dirPath + "/" + ICON0_FILENAME;
+		WritePSPFile(icon0path, param->icon0FileData.buf, param->icon0FileData.bufSize);
+	}
+	// SAVE ICON1
+	if (param->icon1FileData.buf.IsValid())
+	{
+		std::string icon1path = dirPath + "/" + ICON1_FILENAME;
+		WritePSPFile(icon1path, param->icon1FileData.buf, param->icon1FileData.bufSize);
+	}
+	// SAVE PIC1
+	if (param->pic1FileData.buf.IsValid())
+	{
+		std::string pic1path = dirPath + "/" + PIC1_FILENAME;
+		WritePSPFile(pic1path, param->pic1FileData.buf, param->pic1FileData.bufSize);
+	}
+
+	// Save SND
+	if (param->snd0FileData.buf.IsValid())
+	{
+		std::string snd0path = dirPath + "/" + SND0_FILENAME;
+		WritePSPFile(snd0path, param->snd0FileData.buf, param->snd0FileData.bufSize);
 	}
 
 	// SAVE PARAM.SFO
 	ParamSFOData sfoFile;
 	std::string sfopath = dirPath+"/" + SFO_FILENAME;
-	PSPFileInfo sfoInfo = pspFileSystem.GetFileInfo(sfopath);
-	if (sfoInfo.exists) // Read old sfo if exist
-	{
-		std::vector<u8> sfoData;
-		if (pspFileSystem.ReadEntireFile(sfopath, sfoData) >= 0)
-			sfoFile.ReadSFO(sfoData);
-	}
+	std::vector<u8> oldSfoData;
+	if (ReadSaveFile(dirPath, SFO_FILENAME, oldSfoData)) // Read old sfo if exist
+		sfoFile.ReadSFO(oldSfoData);
+
+	// The file list below needs the hash.
+	if (cryptThread.joinable())
+		cryptThread.join();
 
 	// Update values
 	sfoFile.SetValue("TITLE",param->sfoParam.title,128);
@@ -511,33 +546,6 @@ bool SavedataParam::Save(SceUtilitySavedataParam* param, const std::string &save
 		delete[] cryptedData;
 	}
 
-
-	// SAVE ICON0
-	if (param->icon0FileData.buf.IsValid())
-	{
-		std::string icon0path = dirPath + "/" + ICON0_FILENAME;
-		WritePSPFile(icon0path, param->icon0FileData.buf, param->icon0FileData.bufSize);
-	}
-	// SAVE ICON1
-	if (param->icon1FileData.buf.IsValid())
-	{
-		std::string icon1path = dirPath + "/" + ICON1_FILENAME;
-		WritePSPFile(icon1path, param->icon1FileData.buf, param->icon1FileData.bufSize);
-	}
-	// SAVE PIC1
-	if (param->pic1FileData.buf.IsValid())
-	{
-		std::string pic1path = dirPath + "/" + PIC1_FILENAME;
-		WritePSPFile(pic1path, param->pic1FileData.buf, param->pic1FileData.bufSize);
-	}
-
-	// Save SND
-	if (param->snd0FileData.buf.IsValid())
-	{
-		std::string snd0path = dirPath + "/" + SND0_FILENAME;
-		WritePSPFile(snd0path, param->snd0FileData.buf, param->snd0FileData.bufSize);
-	}
-
 	return true;
 }
 
@@ -553,8 +561,21 @@ bool SavedataParam::Load(SceUtilitySavedataParam *param, const std::string &save
 		return false;
 	}
 
-	if(!LoadSaveData(param, saveDirName, dirPath, secureMode)) // Load main savedata
+	// Everything below reads from the save directory, so read it all at once.
+	PrefetchSaveFiles(dirPath);
+
+	INFO_LOG(SCEUTILITY,"Loading file with size %u in %s",param->dataBufSize,filePath.c_str());
+	std::vector<u8> saveData;
+	if (!ReadSaveFile(dirPath, GetFileName(param), saveData) || saveData.empty()) {
+		ERROR_LOG(SCEUTILITY,"Error reading file %s",filePath.c_str());
+		ClearPrefetchedFiles();
 		return false;
+	}
+
+	// Decrypting is the slow part, so the other files are loaded meanwhile.  They fill different fields.
+	std::thread dataThread([&]() {
+		LoadSaveData(param, saveDirName, saveData, secureMode); // Load main savedata
+	});
 
 	LoadSFO(param, dirPath);  // Load sfo
 
@@ -572,21 +593,14 @@ bool SavedataParam::Load(SceUtilitySavedataParam *param, const std::string &save
 	// Load SND0.AT3
 	LoadFile(dirPath, SND0_FILENAME, &param->snd0FileData);
 
+	dataThread.join();
+	ClearPrefetchedFiles();
 	return true;
 }
 
-bool SavedataParam::LoadSaveData(SceUtilitySavedataParam *param, const std::string &saveDirName, const std::string& dirPath, bool secureMode) {
+void SavedataParam::LoadSaveData(SceUtilitySavedataParam *param, const std::string &saveDirName, std::vector<u8> &saveData, bool secureMode) {
 	u8 *data_ = param->dataBuf;
-	std::string filePath = dirPath+"/"+GetFileName(param);
-	s64 readSize;
-	INFO_LOG(SCEUTILITY,"Loading file with size %u in %s",param->dataBufSize,filePath.c_str());
-	u8* saveData = 0;
-	int saveSize = -1;
-	if (!ReadPSPFile(filePath, &saveData, saveSize, &readSize)) {
-		ERROR_LOG(SCEUTILITY,"Error reading file %s",filePath.c_str());
-		return false;
-	}
-	saveSize = (int)readSize;
+	int saveSize = (int)saveData.size();
 
 	// copy back save name in request
 	strncpy(param->saveName, saveDirName.c_str(), 20);
@@ -595,15 +609,12 @@ bool SavedataParam::LoadSaveData(SceUtilitySavedataParam *param, const std::stri
 	bool isCrypted = prevCryptMode != 0 && secureMode;
 	bool saveDone = false;
 	if (isCrypted) {
-		LoadCryptedSave(param, data_, saveData, saveSize, prevCryptMode, saveDone);
+		LoadCryptedSave(param, data_, &saveData[0], saveSize, prevCryptMode, saveDone);
 	}
 	if (!saveDone) {
-		LoadNotCryptedSave(param, data_, saveData, saveSize);
+		LoadNotCryptedSave(param, data_, &saveData[0], saveSize);
 	}
 	param->dataSize = (SceSize)saveSize;
-	delete[] saveData;
-
-	return true;
 }
 
 int SavedataParam::DetermineCryptMode(const SceUtilitySavedataParam *param) const {
@@ -672,20 +683,16 @@ void SavedataParam::LoadNotCryptedSave(SceUtilitySavedataParam *param, u8 *data,
 
 void SavedataParam::LoadSFO(SceUtilitySavedataParam *param, const std::string& dirPath) {
 	ParamSFOData sfoFile;
-	std::string sfopath = dirPath+"/" + SFO_FILENAME;
-	PSPFileInfo sfoInfo = pspFileSystem.GetFileInfo(sfopath);
-	if (sfoInfo.exists) {
-		// Read sfo
-		std::vector<u8> sfoData;
-		if (pspFileSystem.ReadEntireFile(sfopath, sfoData) >= 0) {
-			sfoFile.ReadSFO(sfoData);
-
-			// copy back info in request
-			strncpy(param->sfoParam.title,sfoFile.GetValueString("TITLE").c_str(),128);
-			strncpy(param->sfoParam.savedataTitle,sfoFile.GetValueString("SAVEDATA_TITLE").c_str(),128);
-			strncpy(param->sfoParam.detail,sfoFile.GetValueString("SAVEDATA_DETAIL").c_str(),1024);
-			param->sfoParam.parentalLevel = sfoFile.GetValueInt("PARENTAL_LEVEL");
-		}
+	// Read sfo
+	std::vector<u8> sfoData;
+	if (ReadSaveFile(dirPath, SFO_FILENAME, sfoData)) {
+		sfoFile.ReadSFO(sfoData);
+
+		// copy back info in request
+		strncpy(param->sfoParam.title,sfoFile.GetValueString("TITLE").c_str(),128);
+		strncpy(param->sfoParam.savedataTitle,sfoFile.GetValueString("SAVEDATA_TITLE").c_str(),128);
+		strncpy(param->sfoParam.detail,sfoFile.GetValueString("SAVEDATA_DETAIL").c_str(),1024);
+		param->sfoParam.parentalLevel = sfoFile.GetValueInt("PARENTAL_LEVEL");
 	}
 }
 
@@ -728,10 +735,74 @@ void SavedataParam::LoadFile(const std::string& dirPath, const std::string& file
 	if(!fileData->buf.IsValid())
 		return;
 	u8 *buf = fileData->buf;
+	if (dirPath == prefetchedDir_) {
+		auto it = prefetchedFiles_.find(filename);
+		if (it != prefetchedFiles_.end()) {
+			readSize = std::min((s64)it->second.size(), (s64)fileData->bufSize);
+			if (readSize != 0) {
+				memcpy(buf, &it->second[0], (size_t)readSize);
+				fileData->size = readSize;
+			}
+			return;
+		}
+	}
 	if(ReadPSPFile(filePath, &buf, fileData->bufSize, &readSize))
 		fileData->size = readSize;
 }
 
+void SavedataParam::PrefetchSaveFiles(const std::string &dirPath) {
+	ClearPrefetchedFiles();
+
+	// The listing already has the sizes, so each file is just an open and one read.
+	u64 totalSize = 0;
+	auto files = pspFileSystem.GetDirListing(dirPath);
+	for (auto file = files.begin(), end = files.end(); file != end; ++file) {
+		if (file->type == FILETYPE_DIRECTORY || file->size == 0) {
+			continue;
+		}
+		if (totalSize + file->size > MAX_PREFETCH_SIZE) {
+			// Whatever's left is read as it's needed.
+			continue;
+		}
+
+		u32 handle = pspFileSystem.OpenFile(dirPath + "/" + file->name, FILEACCESS_READ);
+		if (handle == 0) {
+			continue;
+		}
+		std::vector<u8> &data = prefetchedFiles_[file->name];
+		data.resize((size_t)file->size);
+		size_t result = pspFileSystem.ReadFile(handle, &data[0], file->size);
+		pspFileSystem.CloseFile(handle);
+		if (result != file->size) {
+			prefetchedFiles_.erase(file->name);
+			continue;
+		}
+		totalSize += file->size;
+	}
+	prefetchedDir_ = dirPath;
+}
+
+void SavedataParam::ClearPrefetchedFiles() {
+	prefetchedDir_.clear();
+	prefetchedFiles_.clear();
+}
+
+bool SavedataParam::ReadSaveFile(const std::string &dirPath, const std::string &filename, std::vector<u8> &data) {
+	if (dirPath == prefetchedDir_) {
+		auto it = prefetchedFiles_.find(filename);
+		if (it != prefetchedFiles_.end()) {
+			data = it->second;
+			return true;
+		}
+	}
+
+	// Not prefetched (or named with a different case), so go to the file system.
+	std::string filePath = dirPath + "/" + filename;
+	if (!pspFileSystem.GetFileInfo(filePath).exists)
+		return false;
+	return pspFileSystem.ReadEntireFile(filePath, data) >= 0;
+}
+
 int SavedataParam::EncryptData(unsigned int mode,
 		 unsigned char *data,
 		 int *dataLen,
@@ -1665,35 +1736,30 @@ int SavedataParam::GetSaveCryptMode(SceUtilitySavedataParam* param, const std::s
 {
 	ParamSFOData sfoFile;
 	std::string dirPath = GetSaveFilePath(param, GetSaveDir(param, saveDirName));
-	std::string sfopath = dirPath + "/" + SFO_FILENAME;
-	PSPFileInfo sfoInfo = pspFileSystem.GetFileInfo(sfopath);
-	if(sfoInfo.exists) // Read sfo
+	std::vector<u8> sfoData;
+	if (ReadSaveFile(dirPath, SFO_FILENAME, sfoData)) // Read sfo
 	{
-		std::vector<u8> sfoData;
-		if (pspFileSystem.ReadEntireFile(sfopath, sfoData) >= 0)
-		{
-			sfoFile.ReadSFO(sfoData);
+		sfoFile.ReadSFO(sfoData);
 
-			// save created in PPSSPP and not encrypted has '0' in SAVEDATA_PARAMS
-			u32 tmpDataSize = 0;
-			const u8 *tmpDataOrig = sfoFile.GetValueData("SAVEDATA_PARAMS", &tmpDataSize);
-			if (tmpDataSize == 0 || !tmpDataOrig) {
-				return 0;
-			}
-			switch (tmpDataOrig[0]) {
-			case 0:
-				return 0;
-			case 0x01:
-				return 1;
-			case 0x21:
-				return 3;
-			case 0x41:
-				return 5;
-			default:
-				// Well, it's not zero, so yes.
-				ERROR_LOG_REPORT(SCEUTILITY, "Unexpected SAVEDATA_PARAMS hash flag: %02x", tmpDataOrig[0]);
-				return 1;
-			}
+		// save created in PPSSPP and not encrypted has '0' in SAVEDATA_PARAMS
+		u32 tmpDataSize = 0;
+		const u8 *tmpDataOrig = sfoFile.GetValueData("SAVEDATA_PARAMS", &tmpDataSize);
+		if (tmpDataSize == 0 || !tmpDataOrig) {
+			return 0;
+		}
+		switch (tmpDataOrig[0]) {
+		case 0:
+			return 0;
+		case 0x01:
+			return 1;
+		case 0x21:
+			return 3;
+		case 0x41:
+			return 5;
+		default:
+			// Well, it's not zero, so yes.
+			ERROR_LOG_REPORT(SCEUTILITY, "Unexpected SAVEDATA_PARAMS hash flag: %02x", tmpDataOrig[0]);
+			return 1;
 		}
 	}
 	return 0;
@@ -17,6 +17,11 @@
 
 #pragma once
 
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
 #include "Common/CommonTypes.h"
 #include "Core/MemMap.h"
 #include "Core/HLE/sceRtc.h"
@@ -354,7 +359,7 @@ class SavedataParam
 	void SetFileInfo(SaveFileInfo &saveInfo, PSPFileInfo &info, std::string saveName);
 	void ClearFileInfo(SaveFileInfo &saveInfo, const std::string &saveName);
 
-	bool LoadSaveData(SceUtilitySavedataParam *param, const std::string &saveDirName, const std::string& dirPath, bool secureMode);
+	void LoadSaveData(SceUtilitySavedataParam *param, const std::string &saveDirName, std::vector<u8> &saveData, bool secureMode);
 	void LoadCryptedSave(SceUtilitySavedataParam *param, u8 *data, u8 *saveData, int &saveSize, int prevCryptMode, bool &saveDone);
 	void LoadNotCryptedSave(SceUtilitySavedataParam *param, u8 *data, u8 *saveData, int &saveSize);
 	void LoadSFO(SceUtilitySavedataParam *param, const std::string& dirPath);
@@ -368,10 +373,18 @@ class SavedataParam
 
 	std::set<std::string> getSecureFileNames(std::string dirPath);
 
+	// Reads every file of the save directory in one pass, for Load() to use instead of the file system.
+	void PrefetchSaveFiles(const std::string &dirPath);
+	void ClearPrefetchedFiles();
+	bool ReadSaveFile(const std::string &dirPath, const std::string &filename, std::vector<u8> &data);
+
 	SceUtilitySavedataParam* pspParam;
 	int selectedSave;
 	SaveFileInfo *saveDataList;
 	SaveFileInfo *noSaveIcon;
 	int saveDataListCount;
 	int saveNameListDataCount;
+
+	std::string prefetchedDir_;
+	std::map<std::string, std::vector<u8>> prefetchedFiles_;
 };
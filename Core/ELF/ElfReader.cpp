@@ -15,6 +15,12 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#include <list>
+#include <mutex>
+#include <vector>
+
+#include "ext/xxhash.h"
+#include "Core/Config.h"
 #include "Core/MemMap.h"
 #include "Core/Reporting.h"
 #include "Core/MIPS/MIPSTables.h"
@@ -53,10 +59,101 @@ void addrToHiLo(u32 addr, u16 &hi, s16 &lo)
 	}
 }
 
+// Games that load the same overlay over and over mostly put it at the same address.
+// Keep the last few images after relocation so we can just copy them back.
+struct RelocatedImage {
+	u64 hash;
+	u32 vaddr;
+	std::vector<u8> data;
+};
+
+static std::list<RelocatedImage> relocatedImages;
+static size_t relocatedImagesBytes = 0;
+// Can be cleared from the UI thread when the system is low on memory.
+static std::mutex relocatedImagesLock;
+static const size_t MAX_RELOCATED_IMAGES_BYTES = 16 * 1024 * 1024;
+static const size_t MAX_RELOCATED_IMAGES_BYTES_LOWMEM = 2 * 1024 * 1024;
+
+void ElfReader::ClearRelocatedImages() {
+	std::lock_guard<std::mutex> guard(relocatedImagesLock);
+	relocatedImages.clear();
+	relocatedImagesBytes = 0;
+}
+
+size_t ElfReader::RelocatedImagesBytes() {
+	std::lock_guard<std::mutex> guard(relocatedImagesLock);
+	return relocatedImagesBytes;
+}
+
+bool ElfReader::RestoreRelocatedImage(u64 hash) {
+	std::lock_guard<std::mutex> guard(relocatedImagesLock);
+	for (auto it = relocatedImages.begin(); it != relocatedImages.end(); ++it) {
+		if (it->hash != hash || it->vaddr != vaddr)
+			continue;
+
+		size_t pos = 0;
+		for (int i = 0; i < header->e_phnum; i++) {
+			const Elf32_Phdr *p = segments + i;
+			if (p->p_type == PT_LOAD) {
+				memcpy(Memory::GetPointer(segmentVAddr[i]), &it->data[pos], p->p_memsz);
+				pos += p->p_memsz;
+			}
+		}
+
+		// Most recently used goes in front.
+		relocatedImages.splice(relocatedImages.begin(), relocatedImages, it);
+		return true;
+	}
+	return false;
+}
+
+void ElfReader::SaveRelocatedImage(u64 hash) {
+	size_t size = 0;
+	for (int i = 0; i < header->e_phnum; i++) {
+		if (segments[i].p_type == PT_LOAD)
+			size += segments[i].p_memsz;
+	}
+	const size_t maxBytes = g_Config.bLowMemoryMode ? MAX_RELOCATED_IMAGES_BYTES_LOWMEM : MAX_RELOCATED_IMAGES_BYTES;
+	if (size > maxBytes / 4)
+		return;
+
+	std::lock_guard<std::mutex> guard(relocatedImagesLock);
+	while (!relocatedImages.empty() && relocatedImagesBytes + size > maxBytes) {
+		relocatedImagesBytes -= relocatedImages.back().data.size();
+		relocatedImages.pop_back();
+	}
+
+	RelocatedImage image;
+	image.hash = hash;
+	image.vaddr = vaddr;
+	image.data.resize(size);
+	size_t pos = 0;
+	for (int i = 0; i < header->e_phnum; i++) {
+		const Elf32_Phdr *p = segments + i;
+		if (p->p_type == PT_LOAD) {
+			memcpy(&image.data[pos], Memory::GetPointer(segmentVAddr[i]), p->p_memsz);
+			pos += p->p_memsz;
+		}
+	}
+
+	relocatedImagesBytes += size;
+	relocatedImages.push_front(std::move(image));
+}
+
 bool ElfReader::LoadRelocations(const Elf32_Rel *rels, int numRelocs)
 {
 	int numErrors = 0;
 	DEBUG_LOG(LOADER, "Loading %i relocations...", numRelocs);
+
+	// For each reloc, the next LO16 after it.  HI16s use it to find their pair without scanning.
+	std::vector<int> nextLo16(numRelocs);
+	int next = -1;
+	for (int r = numRelocs - 1; r >= 0; r--) {
+		nextLo16[r] = next;
+		if ((rels[r].r_info & 0xF) == R_MIPS_LO16)
+			next = r;
+	}
+
 	for (int r = 0; r < numRelocs; r++)
 	{
 		// INFO_LOG(LOADER, "Loading reloc %i  (%p)...", r, rels + r);
@@ -127,24 +224,21 @@ bool ElfReader::LoadRelocations(const Elf32_Rel *rels, int numRelocs)
 				u32 cur = (op & 0xFFFF) << 16;
 				u16 hi = 0;
 				bool found = false;
-				for (int t = r + 1; t<numRelocs; t++)
+				for (int t = nextLo16[r]; t != -1; t = nextLo16[t])
 				{
-					if ((rels[t].r_info & 0xF) == R_MIPS_LO16) 
-					{
-						u32 corrLoAddr = rels[t].r_offset + segmentVAddr[readwrite];
-						if (log) {
-							DEBUG_LOG(LOADER,"Corresponding lo found at %08x", corrLoAddr);
-						}
-						if (Memory::IsValidAddress(corrLoAddr)) {
-							s16 lo = (s32)(s16)(u16)(Memory::ReadUnchecked_U32(corrLoAddr) & 0xFFFF); //signed??
-							cur += lo;
-							cur += relocateTo;
-							addrToHiLo(cur, hi, lo);
-							found = true;
-							break;
-						} else {
-							ERROR_LOG(LOADER, "Bad corrLoAddr %08x", corrLoAddr);
-						}
+					u32 corrLoAddr = rels[t].r_offset + segmentVAddr[readwrite];
+					if (log) {
+						DEBUG_LOG(LOADER,"Corresponding lo found at %08x", corrLoAddr);
+					}
+					if (Memory::IsValidAddress(corrLoAddr)) {
+						s16 lo = (s32)(s16)(u16)(Memory::ReadUnchecked_U32(corrLoAddr) & 0xFFFF); //signed??
+						cur += lo;
+						cur += relocateTo;
+						addrToHiLo(cur, hi, lo);
+						found = true;
+						break;
+					} else {
+						ERROR_LOG(LOADER, "Bad corrLoAddr %08x", corrLoAddr);
 					}
 				}
 				if (!found) {
@@ -503,6 +597,18 @@ int ElfReader::LoadInto(u32 loadAddress, bool fromTop)
 		}
 	}
 
+	// The result only depends on the file and where it went, so use the last one if we have it.
+	u64 imageHash = 0;
+	if (bRelocate) {
+		imageHash = XXH64(base, size_, 0);
+		if (RestoreRelocatedImage(imageHash)) {
+			DEBUG_LOG(LOADER, "Relocated image found in cache, skipping relocations");
+			return SCE_KERNEL_ERROR_OK;
+		}
+	}
+	// If anything went wrong, it might depend on what else was in memory.
+	bool relocsOk = true;
+
 	DEBUG_LOG(LOADER,"Relocations:");
 
 	// Second pass: Do necessary relocations
@@ -530,6 +636,7 @@ int ElfReader::LoadInto(u32 loadAddress, bool fromTop)
 				DEBUG_LOG(LOADER,"%s: Performing %i relocations on %s : offset = %08x", name, numRelocs, GetSectionName(sectionToModify), sections[i].sh_offset);
 				if (!LoadRelocations(rels, numRelocs)) {
 					WARN_LOG(LOADER, "LoadInto: Relocs failed, trying anyway");
+					relocsOk = false;
 				}			
 			}
 			else
@@ -577,6 +684,7 @@ int ElfReader::LoadInto(u32 loadAddress, bool fromTop)
 				Elf32_Rel *rels = (Elf32_Rel *)GetSegmentPtr(i);
 				if (!LoadRelocations(rels, numRelocs)) {
 					ERROR_LOG(LOADER, "LoadInto: Relocs failed, trying anyway (2)");
+					relocsOk = false;
 				}
 			} else if (p->p_type == PT_PSPREL2) {
 				INFO_LOG(LOADER,"Loading segment relocations2");
@@ -585,6 +693,10 @@ int ElfReader::LoadInto(u32 loadAddress, bool fromTop)
 		}
 	}
 
+	if (bRelocate && relocsOk) {
+		SaveRelocatedImage(imageHash);
+	}
+
 	return SCE_KERNEL_ERROR_OK;
 }
 
@@ -137,7 +137,14 @@ class ElfReader {
 	bool LoadRelocations(const Elf32_Rel *rels, int numRelocs);
 	void LoadRelocations2(int rel_seg);
 
+	// Forget relocated modules kept around for quick reloading.
+	static void ClearRelocatedImages();
+	static size_t RelocatedImagesBytes();
+
 private:
+	bool RestoreRelocatedImage(u64 hash);
+	void SaveRelocatedImage(u64 hash);
+
 	const char *base = nullptr;
 	const u32 *base32 = nullptr;
 	const Elf32_Ehdr *header = nullptr;
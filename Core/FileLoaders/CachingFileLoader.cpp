@@ -105,6 +105,23 @@ size_t CachingFileLoader::ReadAt(s64 absolutePos, size_t bytes, void *data, Flag
 	return readSize;
 }
 
+void CachingFileLoader::Prefetch(s64 absolutePos, size_t bytes) {
+	Prepare();
+	if (absolutePos >= filesize_ || bytes == 0) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::recursive_mutex> guard(blocksMutex_);
+		if (prefetches_.size() >= MAX_PREFETCHES_QUEUED) {
+			return;
+		}
+		prefetches_.push_back(std::make_pair(absolutePos, std::min(bytes, (size_t)(filesize_ - absolutePos))));
+	}
+
+	StartReadAhead(absolutePos);
+}
+
 void CachingFileLoader::InitCache() {
 	cacheSize_ = 0;
 	oldestGeneration_ = 0;
@@ -115,6 +132,10 @@ void CachingFileLoader::ShutdownCache() {
 	// TODO: Maybe add some hint that deletion is coming soon?
 	// We can't delete while the thread is running, so have to wait.
 	// This should only happen from the menu.
+	{
+		std::lock_guard<std::recursive_mutex> guard(blocksMutex_);
+		prefetches_.clear();
+	}
 	while (aheadThread_) {
 		sleep_ms(1);
 	}
@@ -280,10 +301,31 @@ void CachingFileLoader::StartReadAhead(s64 pos) {
 			if (block == blocks_.end()) {
 				guard.unlock();
 				SaveIntoCache(i << BLOCK_SHIFT, BLOCK_SIZE * BLOCK_READAHEAD, Flags::NONE, true);
+				guard.lock();
 				break;
 			}
 		}
 
+		while (!prefetches_.empty()) {
+			const s64 prefetchStartPos = prefetches_.front().first >> BLOCK_SHIFT;
+			const s64 prefetchEndPos = (prefetches_.front().first + prefetches_.front().second - 1) >> BLOCK_SHIFT;
+			prefetches_.pop_front();
+
+			for (s64 i = prefetchStartPos; i <= prefetchEndPos; ++i) {
+				if (blocks_.find(i) != blocks_.end()) {
+					continue;
+				}
+				if (cacheSize_ + MAX_BLOCKS_PER_READ > MAX_BLOCKS_CACHED) {
+					// Don't push out blocks already read just to prefetch.
+					prefetches_.clear();
+					break;
+				}
+				guard.unlock();
+				SaveIntoCache(i << BLOCK_SHIFT, (size_t)(prefetchEndPos - i + 1) << BLOCK_SHIFT, Flags::NONE, true);
+				guard.lock();
+			}
+		}
+
 		aheadThread_ = false;
 	});
 	th.detach();
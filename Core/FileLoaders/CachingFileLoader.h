@@ -17,6 +17,7 @@
 
 #pragma once
 
+#include <deque>
 #include <map>
 #include <mutex>
 
@@ -39,6 +40,7 @@ class CachingFileLoader : public FileLoader {
 		return ReadAt(absolutePos, bytes * count, data, flags) / bytes;
 	}
 	size_t ReadAt(s64 absolutePos, size_t bytes, void *data, Flags flags = Flags::NONE) override;
+	void Prefetch(s64 absolutePos, size_t bytes) override;
 
 	void Cancel() override;
 
@@ -58,6 +60,7 @@ class CachingFileLoader : public FileLoader {
 		MAX_BLOCKS_PER_READ = 16,
 		MAX_BLOCKS_CACHED = 4096, // 256 MB
 		BLOCK_READAHEAD = 4,
+		MAX_PREFETCHES_QUEUED = 64,
 	};
 
 	s64 filesize_ = 0;
@@ -79,6 +82,8 @@ class CachingFileLoader : public FileLoader {
 	};
 
 	std::map<s64, BlockInfo> blocks_;
+	// Ranges from Prefetch(), read by the readahead thread after its usual readahead.
+	std::deque<std::pair<s64, size_t>> prefetches_;
 	std::recursive_mutex blocksMutex_;
 	bool aheadThread_ = false;
 	std::once_flag preparedFlag_;
@@ -20,6 +20,11 @@
 #include <set>
 #include <mutex>
 #include <cstring>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
 
 #include "file/file_util.h"
 #include "file/free.h"
@@ -99,12 +104,16 @@ size_t DiskCachingFileLoader::ReadAt(s64 absolutePos, size_t bytes, void *data,
 		readSize = cache_->ReadFromCache(absolutePos, bytes, data);
 		// While in case the cache size is too small for the entire read.
 		while (readSize < bytes) {
-			readSize += cache_->SaveIntoCache(backend_, absolutePos + readSize, bytes - readSize, (u8 *)data + readSize, flags);
+			size_t bytesSaved = cache_->SaveIntoCache(backend_, absolutePos + readSize, bytes - readSize, (u8 *)data + readSize, flags);
+			readSize += bytesSaved;
 			// If there are already-cached blocks afterward, we have to read them.
 			size_t bytesFromCache = cache_->ReadFromCache(absolutePos + readSize, bytes - readSize, (u8 *)data + readSize);
 			readSize += bytesFromCache;
-			if (bytesFromCache == 0) {
-				// We can't read any more.
+			if (bytesSaved == 0 && bytesFromCache == 0) {
+				// Another thread evicted what it had just cached, or the cache broke.  Read the rest directly.
+				if (readSize < bytes) {
+					readSize += backend_->ReadAt(absolutePos + readSize, bytes - readSize, (u8 *)data + readSize, flags);
+				}
 				break;
 			}
 		}
@@ -201,13 +210,21 @@ void DiskCachingFileLoaderCache::InitCache(const std::string &path) {
 }
 
 void DiskCachingFileLoaderCache::ShutdownCache() {
+	std::lock_guard<std::mutex> guard(lock_);
+	std::lock_guard<std::mutex> fileGuard(fileLock_);
+
 	if (f_) {
+		// Don't leave half the index in the old generation scale.
+		while (rebalancing_) {
+			RebalanceGenerations();
+		}
+
 		bool failed = false;
 		if (fseek(f_, sizeof(FileHeader), SEEK_SET) != 0) {
 			failed = true;
 		} else if (fwrite(&index_[0], sizeof(BlockInfo), indexCount_, f_) != indexCount_) {
 			failed = true;
-		} else if (fflush(f_) != 0) {
+		} else if (!FlushFile()) {
 			failed = true;
 		}
 		if (failed) {
@@ -221,13 +238,12 @@ void DiskCachingFileLoaderCache::ShutdownCache() {
 
 	index_.clear();
 	blockIndexLookup_.clear();
+	dirtyIndexes_.clear();
 	cacheSize_ = 0;
 }
 
 size_t DiskCachingFileLoaderCache::ReadFromCache(s64 pos, size_t bytes, void *data) {
-	std::lock_guard<std::mutex> guard(lock_);
-
-	if (!f_) {
+	if (!IsValid() || bytes == 0) {
 		return 0;
 	}
 
@@ -238,17 +254,29 @@ size_t DiskCachingFileLoaderCache::ReadFromCache(s64 pos, size_t bytes, void *da
 	u8 *p = (u8 *)data;
 
 	for (s64 i = cacheStartPos; i <= cacheEndPos; ++i) {
+		std::unique_lock<std::mutex> guard(lock_);
+		if (!f_) {
+			return readSize;
+		}
+
 		auto &info = index_[i];
 		if (info.block == INVALID_BLOCK) {
 			return readSize;
 		}
-		info.generation = generation_;
+		info.generation = GenerationForBlock(info.block);
 		if (info.hits < std::numeric_limits<u16>::max()) {
 			++info.hits;
 		}
+		const u32 block = info.block;
+
+		// Take the file before letting go of the index.  Anyone who allocated or evicted
+		// this block got the file lock first, so we either wait for their data or read
+		// ours before they overwrite it.  Index lookups on other threads can run meanwhile.
+		std::lock_guard<std::mutex> fileGuard(fileLock_);
+		guard.unlock();
 
 		size_t toRead = std::min(bytes - readSize, (size_t)blockSize_ - offset);
-		if (!ReadBlockData(p + readSize, info, offset, toRead)) {
+		if (!ReadBlockData(p + readSize, block, offset, toRead)) {
 			return readSize;
 		}
 		readSize += toRead;
@@ -260,9 +288,10 @@ size_t DiskCachingFileLoaderCache::ReadFromCache(s64 pos, size_t bytes, void *da
 }
 
 size_t DiskCachingFileLoaderCache::SaveIntoCache(FileLoader *backend, s64 pos, size_t bytes, void *data, FileLoader::Flags flags) {
-	std::lock_guard<std::mutex> guard(lock_);
+	std::unique_lock<std::mutex> guard(lock_);
 
 	if (!f_) {
+		guard.unlock();
 		// Just to keep things working.
 		return backend->ReadAt(pos, bytes, data, flags);
 	}
@@ -285,56 +314,85 @@ size_t DiskCachingFileLoaderCache::SaveIntoCache(FileLoader *backend, s64 pos, s
 		}
 	}
 
-	if (!MakeCacheSpaceFor(blocksToRead) || blocksToRead == 0) {
+	if (blocksToRead == 0) {
 		return 0;
 	}
 
-	if (blocksToRead == 1) {
-		auto &info = index_[cacheStartPos];
+	// The backend may be slow (e.g. over http), so don't block cache hits while we wait on it.
+	guard.unlock();
+	u8 *wholeRead = new u8[blocksToRead * blockSize_];
+	size_t readBytes = backend->ReadAt(cacheStartPos * (u64)blockSize_, blocksToRead * blockSize_, wholeRead, flags);
+	const s64 readEnd = cacheStartPos * (s64)blockSize_ + (s64)readBytes;
+	guard.lock();
+
+	if (!f_) {
+		guard.unlock();
+		readSize = std::min(bytes, readBytes > offset ? readBytes - offset : 0);
+		memcpy(p, wholeRead + offset, readSize);
+		delete[] wholeRead;
+		return readSize;
+	}
 
-		u8 *buf = new u8[blockSize_];
-		size_t readBytes = backend->ReadAt(cacheStartPos * (u64)blockSize_, blockSize_, buf, flags);
+	MakeCacheSpaceFor(blocksToRead);
 
+	std::vector<BlockWrite> blockWrites;
+	blockWrites.reserve(blocksToRead);
+	for (size_t i = 0; i < blocksToRead; ++i) {
+		const u32 indexPos = (u32)cacheStartPos + (u32)i;
+		const s64 blockEnd = (s64)(indexPos + 1) * (s64)blockSize_;
+		auto &info = index_[indexPos];
 		// Check if it was written while we were busy.  Might happen if we thread.
-		if (info.block == INVALID_BLOCK && readBytes != 0) {
-			info.block = AllocateBlock((u32)cacheStartPos);
-			WriteBlockData(info, buf);
-			WriteIndexData((u32)cacheStartPos, info);
+		// Only whole blocks get cached, except the last one in the file.
+		if (info.block == INVALID_BLOCK && (blockEnd <= readEnd || (readEnd >= filesize_ && readBytes != 0))) {
+			info.block = AllocateBlock(indexPos);
+			if (info.block != INVALID_BLOCK) {
+				info.generation = GenerationForBlock(info.block);
+				info.hits = 0;
+				blockWrites.push_back({ info.block, wholeRead + (i * blockSize_) });
+				dirtyIndexes_.push_back(indexPos);
+				++cacheSize_;
+			}
 		}
 
-		size_t toRead = std::min(bytes - readSize, (size_t)blockSize_ - offset);
-		memcpy(p + readSize, buf + offset, toRead);
+		size_t available = readBytes > i * blockSize_ + offset ? readBytes - i * blockSize_ - offset : 0;
+		size_t toRead = std::min(std::min(bytes - readSize, (size_t)blockSize_ - offset), available);
+		memcpy(p + readSize, wholeRead + (i * blockSize_) + offset, toRead);
 		readSize += toRead;
+		offset = 0;
+	}
 
-		delete [] buf;
-	} else {
-		u8 *wholeRead = new u8[blocksToRead * blockSize_];
-		size_t readBytes = backend->ReadAt(cacheStartPos * (u64)blockSize_, blocksToRead * blockSize_, wholeRead, flags);
-
-		for (size_t i = 0; i < blocksToRead; ++i) {
-			auto &info = index_[cacheStartPos + i];
-			// Check if it was written while we were busy.  Might happen if we thread.
-			if (info.block == INVALID_BLOCK && readBytes != 0) {
-				info.block = AllocateBlock((u32)cacheStartPos + (u32)i);
-				WriteBlockData(info, wholeRead + (i * blockSize_));
-				// TODO: Doing each index together would probably be better.
-				WriteIndexData((u32)cacheStartPos + (u32)i, info);
-			}
-
-			size_t toRead = std::min(bytes - readSize, (size_t)blockSize_ - offset);
-			memcpy(p + readSize, wholeRead + (i * blockSize_) + offset, toRead);
-			readSize += toRead;
+	++generation_;
+	if (rebalancing_ || generation_ >= REBALANCE_START_GENERATION) {
+		RebalanceGenerations();
+	}
+	if (generation_ == std::numeric_limits<u16>::max()) {
+		// Shouldn't happen, the steps should've finished long before.  But just in case.
+		while (rebalancing_) {
+			RebalanceGenerations();
 		}
-		delete[] wholeRead;
 	}
 
-	cacheSize_ += blocksToRead;
-	++generation_;
+	std::vector<IndexWrite> indexWrites;
+	if (!blockWrites.empty() || dirtyIndexes_.size() >= MAX_DIRTY_INDEXES) {
+		std::sort(dirtyIndexes_.begin(), dirtyIndexes_.end());
+		dirtyIndexes_.erase(std::unique(dirtyIndexes_.begin(), dirtyIndexes_.end()), dirtyIndexes_.end());
+		indexWrites.reserve(dirtyIndexes_.size());
+		for (u32 indexPos : dirtyIndexes_) {
+			indexWrites.push_back({ indexPos, index_[indexPos] });
+		}
+		dirtyIndexes_.clear();
+	}
 
-	if (generation_ == std::numeric_limits<u16>::max()) {
-		RebalanceGenerations();
+	if (!indexWrites.empty() || !blockWrites.empty()) {
+		// Hand over to the file lock so readers wait for the data we just published in the index.
+		std::lock_guard<std::mutex> fileGuard(fileLock_);
+		guard.unlock();
+		WriteBatch(blockWrites, indexWrites);
+	} else {
+		guard.unlock();
 	}
 
+	delete[] wholeRead;
 	return readSize;
 }
 
@@ -342,7 +400,7 @@ bool DiskCachingFileLoaderCache::MakeCacheSpaceFor(size_t blocks) {
 	size_t goal = (size_t)maxBlocks_ - blocks;
 
 	while (cacheSize_ > goal) {
-		u16 minGeneration = generation_;
+		u16 minGeneration = rebalancing_ ? ScaleGeneration(generation_) : generation_;
 
 		// We increment the iterator inside because we delete things inside.
 		for (size_t i = 0; i < blockIndexLookup_.size(); ++i) {
@@ -350,22 +408,22 @@ bool DiskCachingFileLoaderCache::MakeCacheSpaceFor(size_t blocks) {
 				continue;
 			}
 			auto &info = index_[blockIndexLookup_[i]];
+			const u16 generation = EffectiveGeneration((u32)i, info.generation);
 
 			// Check for the minimum seen generation.
 			// TODO: Do this smarter?
-			if (info.generation != 0 && info.generation < minGeneration) {
-				minGeneration = info.generation;
+			if (generation != 0 && generation < minGeneration) {
+				minGeneration = generation;
 			}
 
 			// 0 means it was never used yet or was the first read (e.g. block descriptor.)
-			if (info.generation == oldestGeneration_ || info.generation == 0) {
+			if (generation == oldestGeneration_ || generation == 0) {
 				info.block = INVALID_BLOCK;
 				info.generation = 0;
 				info.hits = 0;
 				--cacheSize_;
 
-				// TODO: Doing this in chunks might be a lot better.
-				WriteIndexData(blockIndexLookup_[i], info);
+				dirtyIndexes_.push_back(blockIndexLookup_[i]);
 				blockIndexLookup_[i] = INVALID_INDEX;
 
 				// Keep going?
@@ -382,24 +440,58 @@ bool DiskCachingFileLoaderCache::MakeCacheSpaceFor(size_t blocks) {
 	return true;
 }
 
-void DiskCachingFileLoaderCache::RebalanceGenerations() {
-	// To make things easy, we will subtract oldestGeneration_ and cut in half.
+u16 DiskCachingFileLoaderCache::ScaleGeneration(u16 generation) const {
+	// To make things easy, we subtract the oldest generation and cut in half.
 	// That should give us more space but not break anything.
+	return generation > rebalanceBase_ ? (generation - rebalanceBase_) / 2 : 0;
+}
 
-	for (size_t i = 0; i < index_.size(); ++i) {
-		auto &info = index_[i];
-		if (info.block == INVALID_BLOCK) {
+u16 DiskCachingFileLoaderCache::EffectiveGeneration(u32 block, u16 generation) const {
+	// Blocks the rebalance hasn't reached yet are still in the old scale.
+	if (rebalancing_ && block >= rebalanceCursor_) {
+		return ScaleGeneration(generation);
+	}
+	return generation;
+}
+
+u16 DiskCachingFileLoaderCache::GenerationForBlock(u32 block) const {
+	// The opposite: blocks already rebalanced need the current generation in the new scale.
+	if (rebalancing_ && block < rebalanceCursor_) {
+		return ScaleGeneration(generation_);
+	}
+	return generation_;
+}
+
+void DiskCachingFileLoaderCache::RebalanceGenerations() {
+	// This runs a slice at a time, so no single read pays for the whole cache.
+	// There's plenty of generations left before overflow to finish it.
+	if (!rebalancing_) {
+		rebalancing_ = true;
+		rebalanceBase_ = oldestGeneration_;
+		rebalanceCursor_ = 0;
+		oldestGeneration_ = 0;
+	}
+
+	u32 end = std::min(rebalanceCursor_ + (u32)REBALANCE_BLOCKS_PER_STEP, (u32)blockIndexLookup_.size());
+	for (; rebalanceCursor_ < end; ++rebalanceCursor_) {
+		u32 indexPos = blockIndexLookup_[rebalanceCursor_];
+		if (indexPos == INVALID_INDEX) {
 			continue;
 		}
 
-		if (info.generation > oldestGeneration_) {
-			info.generation = (info.generation - oldestGeneration_) / 2;
-			// TODO: Doing this all at once would be much better.
-			WriteIndexData((u32)i, info);
+		auto &info = index_[indexPos];
+		u16 generation = ScaleGeneration(info.generation);
+		if (generation != info.generation) {
+			info.generation = generation;
+			dirtyIndexes_.push_back(indexPos);
 		}
 	}
 
-	oldestGeneration_ = 0;
+	if (rebalanceCursor_ >= blockIndexLookup_.size()) {
+		generation_ = ScaleGeneration(generation_);
+		rebalancing_ = false;
+		rebalanceCursor_ = 0;
+	}
 }
 
 u32 DiskCachingFileLoaderCache::AllocateBlock(u32 indexPos) {
@@ -447,11 +539,11 @@ s64 DiskCachingFileLoaderCache::GetBlockOffset(u32 block) {
 	return blockOffset + (s64)block * (s64)blockSize_;
 }
 
-bool DiskCachingFileLoaderCache::ReadBlockData(u8 *dest, BlockInfo &info, size_t offset, size_t size) {
+bool DiskCachingFileLoaderCache::ReadBlockData(u8 *dest, u32 block, size_t offset, size_t size) {
 	if (!f_) {
 		return false;
 	}
-	s64 blockOffset = GetBlockOffset(info.block);
+	s64 blockOffset = GetBlockOffset(block);
 
 	// Before we read, make sure the buffers are flushed.
 	// We might be trying to read an area we've recently written.
@@ -459,15 +551,15 @@ bool DiskCachingFileLoaderCache::ReadBlockData(u8 *dest, BlockInfo &info, size_t
 
 	bool failed = false;
 #ifdef __ANDROID__
-	if (lseek64(fd_, blockOffset, SEEK_SET) != blockOffset) {
+	if (lseek64(fd_, blockOffset + offset, SEEK_SET) != blockOffset + (s64)offset) {
 		failed = true;
-	} else if (read(fd_, dest + offset, size) != (ssize_t)size) {
+	} else if (read(fd_, dest, size) != (ssize_t)size) {
 		failed = true;
 	}
 #else
-	if (fseeko(f_, blockOffset, SEEK_SET) != 0) {
+	if (fseeko(f_, blockOffset + offset, SEEK_SET) != 0) {
 		failed = true;
-	} else if (fread(dest + offset, size, 1, f_) != 1) {
+	} else if (fread(dest, size, 1, f_) != 1) {
 		failed = true;
 	}
 #endif
@@ -479,11 +571,11 @@ bool DiskCachingFileLoaderCache::ReadBlockData(u8 *dest, BlockInfo &info, size_t
 	return !failed;
 }
 
-void DiskCachingFileLoaderCache::WriteBlockData(BlockInfo &info, u8 *src) {
+bool DiskCachingFileLoaderCache::WriteBlockData(u32 block, const u8 *src) {
 	if (!f_) {
-		return;
+		return false;
 	}
-	s64 blockOffset = GetBlockOffset(info.block);
+	s64 blockOffset = GetBlockOffset(block);
 
 	bool failed = false;
 #ifdef __ANDROID__
@@ -504,11 +596,12 @@ void DiskCachingFileLoaderCache::WriteBlockData(BlockInfo &info, u8 *src) {
 		ERROR_LOG(LOADER, "Unable to write disk cache data entry.");
 		CloseFileHandle();
 	}
+	return !failed;
 }
 
-void DiskCachingFileLoaderCache::WriteIndexData(u32 indexPos, BlockInfo &info) {
+bool DiskCachingFileLoaderCache::WriteIndexData(u32 indexPos, const BlockInfo *info, size_t count) {
 	if (!f_) {
-		return;
+		return false;
 	}
 
 	u32 offset = (u32)sizeof(FileHeader) + indexPos * (u32)sizeof(BlockInfo);
@@ -516,7 +609,7 @@ void DiskCachingFileLoaderCache::WriteIndexData(u32 indexPos, BlockInfo &info) {
 	bool failed = false;
 	if (fseek(f_, offset, SEEK_SET) != 0) {
 		failed = true;
-	} else if (fwrite(&info, sizeof(BlockInfo), 1, f_) != 1) {
+	} else if (fwrite(info, sizeof(BlockInfo), count, f_) != count) {
 		failed = true;
 	}
 
@@ -524,6 +617,51 @@ void DiskCachingFileLoaderCache::WriteIndexData(u32 indexPos, BlockInfo &info) {
 		ERROR_LOG(LOADER, "Unable to write disk cache index entry.");
 		CloseFileHandle();
 	}
+	return !failed;
+}
+
+void DiskCachingFileLoaderCache::WriteBatch(std::vector<BlockWrite> &blocks, const std::vector<IndexWrite> &indexes) {
+	// Data first, in file order, so the index never points at blocks that aren't on disk yet.
+	std::sort(blocks.begin(), blocks.end(), [](const BlockWrite &a, const BlockWrite &b) {
+		return a.block < b.block;
+	});
+	for (const BlockWrite &write : blocks) {
+		if (!WriteBlockData(write.block, write.src)) {
+			return;
+		}
+	}
+
+	// The indexes are sorted, so write each consecutive run at once.
+	std::vector<BlockInfo> run;
+	for (size_t i = 0; i < indexes.size(); ) {
+		const u32 first = indexes[i].indexPos;
+		run.clear();
+		do {
+			run.push_back(indexes[i].info);
+			++i;
+		} while (i < indexes.size() && indexes[i].indexPos == first + run.size());
+
+		if (!WriteIndexData(first, &run[0], run.size())) {
+			return;
+		}
+	}
+
+	// Just one sync for the whole batch.
+	if (!FlushFile()) {
+		ERROR_LOG(LOADER, "Unable to sync disk cache.");
+		CloseFileHandle();
+	}
+}
+
+bool DiskCachingFileLoaderCache::FlushFile() {
+	if (fflush(f_) != 0) {
+		return false;
+	}
+#if defined(_WIN32)
+	return _commit(_fileno(f_)) == 0;
+#else
+	return fsync(fileno(f_)) == 0;
+#endif
 }
 
 bool DiskCachingFileLoaderCache::LoadCacheFile(const std::string &path) {
@@ -96,12 +96,19 @@ class DiskCachingFileLoaderCache {
 	void ShutdownCache();
 	bool MakeCacheSpaceFor(size_t blocks);
 	void RebalanceGenerations();
+	u16 ScaleGeneration(u16 generation) const;
+	u16 EffectiveGeneration(u32 block, u16 generation) const;
+	u16 GenerationForBlock(u32 block) const;
 	u32 AllocateBlock(u32 indexPos);
 
 	struct BlockInfo;
-	bool ReadBlockData(u8 *dest, BlockInfo &info, size_t offset, size_t size);
-	void WriteBlockData(BlockInfo &info, u8 *src);
-	void WriteIndexData(u32 indexPos, BlockInfo &info);
+	struct BlockWrite;
+	struct IndexWrite;
+	bool ReadBlockData(u8 *dest, u32 block, size_t offset, size_t size);
+	bool WriteBlockData(u32 block, const u8 *src);
+	bool WriteIndexData(u32 indexPos, const BlockInfo *info, size_t count);
+	void WriteBatch(std::vector<BlockWrite> &blocks, const std::vector<IndexWrite> &indexes);
+	bool FlushFile();
 	s64 GetBlockOffset(u32 block);
 
 	std::string MakeCacheFilePath(const std::string &path);
@@ -140,6 +147,11 @@ class DiskCachingFileLoaderCache {
 		MAX_BLOCKS_UPPER_BOUND = 8192, // 512 MB
 		INVALID_BLOCK = 0xFFFFFFFF,
 		INVALID_INDEX = 0xFFFFFFFF,
+		// Leaves 16K generations of headroom, far more than the steps need.
+		REBALANCE_START_GENERATION = 0xC000,
+		REBALANCE_BLOCKS_PER_STEP = 256,
+		// Evictions alone don't force a sync until this many pile up.
+		MAX_DIRTY_INDEXES = 256,
 	};
 
 	int refCount_ = 0;
@@ -151,7 +163,13 @@ class DiskCachingFileLoaderCache {
 	u32 flags_;
 	size_t cacheSize_;
 	size_t indexCount_;
+	// Guards the index and block lookup.  Held only briefly, never across I/O.
 	std::mutex lock_;
+	// Guards f_/fd_ position and contents.  Always taken after lock_, if both.
+	std::mutex fileLock_;
+	bool rebalancing_ = false;
+	u16 rebalanceBase_ = 0;
+	u32 rebalanceCursor_ = 0;
 	std::string origPath_;
 
 	struct FileHeader {
@@ -176,8 +194,20 @@ class DiskCachingFileLoaderCache {
 		}
 	};
 
+	struct BlockWrite {
+		u32 block;
+		const u8 *src;
+	};
+
+	struct IndexWrite {
+		u32 indexPos;
+		BlockInfo info;
+	};
+
 	std::vector<BlockInfo> index_;
 	std::vector<u32> blockIndexLookup_;
+	// Index entries changed in memory but not yet written with a batch.
+	std::vector<u32> dirtyIndexes_;
 
 	FILE *f_ = nullptr;
 	int fd_ = 0;
@@ -18,13 +18,27 @@
 #include <algorithm>
 
 #include "base/stringutil.h"
+#include "base/timeutil.h"
 #include "Common/Common.h"
 #include "Core/FileLoaders/HTTPFileLoader.h"
 
+static std::mutex statsLock;
+static HTTPFileLoader::Stats stats;
+
 HTTPFileLoader::HTTPFileLoader(const std::string &filename)
 	: url_(filename), filename_(filename) {
 }
 
+static bool ResponseClosesConnection(const std::vector<std::string> &responseHeaders) {
+	for (std::string header : responseHeaders) {
+		if (startsWithNoCase(header, "Connection:")) {
+			std::transform(header.begin(), header.end(), header.begin(), tolower);
+			return header.find("close") != header.npos;
+		}
+	}
+	return false;
+}
+
 void HTTPFileLoader::Prepare() {
 	std::call_once(preparedFlag_, [this](){
 		if (!client_.Resolve(url_.Host().c_str(), url_.Port())) {
@@ -37,15 +51,16 @@ void HTTPFileLoader::Prepare() {
 			return;
 		}
 
+		// Ask for keepalive, if the server agrees we'll reuse the connection for reads.
+		client_.keepAlive_ = true;
 		int err = client_.SendRequest("HEAD", url_.Resource().c_str());
 		if (err < 0) {
 			Disconnect();
 			return;
 		}
 
-		Buffer readbuf;
 		std::vector<std::string> responseHeaders;
-		int code = client_.ReadResponseHeaders(&readbuf, responseHeaders);
+		int code = client_.ReadResponseHeaders(&readbuf_, responseHeaders);
 		if (code != 200) {
 			// Leave size at 0, invalid.
 			ERROR_LOG(LOADER, "HTTP request failed, got %03d for %s", code, filename_.c_str());
@@ -75,8 +90,13 @@ void HTTPFileLoader::Prepare() {
 			}
 		}
 
-		// TODO: Keepalive instead.
-		Disconnect();
+		keepAlive_ = !ResponseClosesConnection(responseHeaders);
+		client_.keepAlive_ = keepAlive_;
+		if (keepAlive_) {
+			responsesOnConnection_ = 1;
+		} else {
+			Disconnect();
+		}
 
 		if (!acceptsRange) {
 			WARN_LOG(LOADER, "HTTP server did not advertise support for range requests.");
@@ -118,7 +138,6 @@ std::string HTTPFileLoader::Path() const {
 
 size_t HTTPFileLoader::ReadAt(s64 absolutePos, size_t bytes, void *data, Flags flags) {
 	Prepare();
-	std::lock_guard<std::mutex> guard(readAtMutex_);
 
 	s64 absoluteEnd = std::min(absolutePos + (s64)bytes, filesize_);
 	if (absolutePos >= filesize_ || bytes == 0) {
@@ -126,29 +145,137 @@ size_t HTTPFileLoader::ReadAt(s64 absolutePos, size_t bytes, void *data, Flags f
 		return 0;
 	}
 
+	std::unique_lock<std::mutex> guard(readAtMutex_);
+	// Requests lost when a connection ends under them (e.g. a server's keepalive limit) are resent.
+	// Failures get one more try, since an idle connection may have been dropped by the server.
+	int failures = 0;
+	int losses = 0;
+	while (failures < 2 && losses < MAX_IN_FLIGHT * 2) {
+		std::shared_ptr<PendingRead> read;
+		// If a request on the way already covers this (e.g. from the readahead thread), share it.
+		for (const auto &other : inFlight_) {
+			if (other->pos <= absolutePos && other->end >= absoluteEnd) {
+				read = other;
+				break;
+			}
+		}
+
+		if (!read) {
+			// Without keepalive, every request needs its own connection, so only one at a time.
+			const size_t maxInFlight = keepAlive_ ? MAX_IN_FLIGHT : 1;
+			while (inFlight_.size() >= maxInFlight) {
+				inFlightCond_.wait(guard);
+			}
+			read = SendRangeRequest(absolutePos, absoluteEnd);
+			if (!read) {
+				// The connection's broken.  Let the responses already sent on it fail, then reconnect.
+				while (!inFlight_.empty()) {
+					inFlightCond_.wait(guard);
+				}
+				Disconnect();
+				failures++;
+				continue;
+			}
+		}
+
+		while (!read->done) {
+			if (readingResponse_ || inFlight_.empty()) {
+				inFlightCond_.wait(guard);
+				continue;
+			}
+
+			// Nobody's reading, so read the oldest response, whoever it's for.
+			readingResponse_ = true;
+			std::shared_ptr<PendingRead> front = inFlight_.front();
+			bool connectionEnds = !keepAlive_;
+			guard.unlock();
+			bool success = ReadRangeResponse(*front, &connectionEnds);
+			guard.lock();
+			readingResponse_ = false;
+
+			inFlight_.pop_front();
+			front->done = true;
+			front->failed = !success;
+			if (success) {
+				responsesOnConnection_++;
+			} else if (keepAlive_ && responsesOnConnection_ == 1) {
+				// Closed right after the first response, it must not really support keepalive.
+				WARN_LOG(LOADER, "HTTP server closed the connection, disabling keepalive");
+				keepAlive_ = false;
+				client_.keepAlive_ = false;
+			}
+			if (!success || connectionEnds) {
+				// Anything else sent on this connection won't get a response.
+				FailInFlight();
+			}
+			inFlightCond_.notify_all();
+		}
+
+		if (!read->failed) {
+			const size_t offset = (size_t)(absolutePos - read->pos);
+			size_t readBytes = read->data.size() > offset ? std::min(read->data.size() - offset, (size_t)(absoluteEnd - absolutePos)) : 0;
+			memcpy(data, read->data.data() + offset, readBytes);
+			filepos_ = absolutePos + readBytes;
+			return readBytes;
+		}
+
+		if (read->lost) {
+			losses++;
+		} else {
+			failures++;
+		}
+	}
+
+	return 0;
+}
+
+HTTPFileLoader::Stats HTTPFileLoader::GetStats() {
+	std::lock_guard<std::mutex> guard(statsLock);
+	return stats;
+}
+
+std::shared_ptr<HTTPFileLoader::PendingRead> HTTPFileLoader::SendRangeRequest(s64 pos, s64 end) {
 	Connect();
 	if (!connected_) {
-		return 0;
+		return nullptr;
 	}
 
 	char requestHeaders[4096];
 	// Note that the Range header is *inclusive*.
 	snprintf(requestHeaders, sizeof(requestHeaders),
-		"Range: bytes=%lld-%lld\r\n", absolutePos, absoluteEnd - 1);
+		"Range: bytes=%lld-%lld\r\n", pos, end - 1);
+
+	std::shared_ptr<PendingRead> read = std::make_shared<PendingRead>();
+	read->pos = pos;
+	read->end = end;
+	read->sentTime = real_time_now();
+	read->done = false;
+	read->failed = false;
+	read->lost = false;
 
 	int err = client_.SendRequest("GET", url_.Resource().c_str(), requestHeaders, nullptr);
 	if (err < 0) {
-		Disconnect();
-		return 0;
+		// If responses are still being read, that'll notice the broken connection.
+		if (inFlight_.empty()) {
+			Disconnect();
+		}
+		return nullptr;
 	}
 
-	Buffer readbuf;
+	inFlight_.push_back(read);
+	return read;
+}
+
+bool HTTPFileLoader::ReadRangeResponse(PendingRead &read, bool *connectionEnds) {
 	std::vector<std::string> responseHeaders;
-	int code = client_.ReadResponseHeaders(&readbuf, responseHeaders);
+	int code = client_.ReadResponseHeaders(&readbuf_, responseHeaders);
+	const double headersTime = real_time_now();
 	if (code != 206) {
 		ERROR_LOG(LOADER, "HTTP server did not respond with range, received code=%03d", code);
-		Disconnect();
-		return 0;
+		return false;
+	}
+	if (ResponseClosesConnection(responseHeaders)) {
+		*connectionEnds = true;
 	}
 
 	// TODO: Expire cache via ETag, etc.
@@ -161,10 +288,10 @@ size_t HTTPFileLoader::ReadAt(s64 absolutePos, size_t bytes, void *data, Flags f
 			std::string lowerHeader = header;
 			std::transform(lowerHeader.begin(), lowerHeader.end(), lowerHeader.begin(), tolower);
 			if (sscanf(lowerHeader.c_str(), "content-range: bytes %lld-%lld/%lld", &first, &last, &total) >= 2) {
-				if (first == absolutePos && last == absoluteEnd - 1) {
+				if (first == read.pos && last == read.end - 1) {
 					supportedResponse = true;
 				} else {
-					ERROR_LOG(LOADER, "Unexpected HTTP range: got %lld-%lld, wanted %lld-%lld.", first, last, absolutePos, absoluteEnd - 1);
+					ERROR_LOG(LOADER, "Unexpected HTTP range: got %lld-%lld, wanted %lld-%lld.", first, last, read.pos, read.end - 1);
 				}
 			} else {
 				ERROR_LOG(LOADER, "Unexpected HTTP range response: %s", header.c_str());
@@ -174,24 +301,40 @@ size_t HTTPFileLoader::ReadAt(s64 absolutePos, size_t bytes, void *data, Flags f
 
 	// TODO: Would be nice to read directly.
 	Buffer output;
-	int res = client_.ReadResponseEntity(&readbuf, responseHeaders, &output);
+	int res = client_.ReadResponseEntity(&readbuf_, responseHeaders, &output);
 	if (res != 0) {
 		ERROR_LOG(LOADER, "Unable to read HTTP response entity: %d", res);
 		// Let's take anything we got anyway.  Not worse than returning nothing?
+		// But we've lost track of where the next response starts.
+		*connectionEnds = true;
 	}
 
-	// TODO: Keepalive instead.
-	Disconnect();
-
 	if (!supportedResponse) {
 		ERROR_LOG(LOADER, "HTTP server did not respond with the range we wanted.");
-		return 0;
+		return false;
 	}
 
-	size_t readBytes = output.size();
-	output.Take(readBytes, (char *)data);
-	filepos_ = absolutePos + readBytes;
-	return readBytes;
+	output.TakeAll(&read.data);
+
+	const double doneTime = real_time_now();
+	std::lock_guard<std::mutex> guard(statsLock);
+	stats.requests++;
+	stats.bytes += read.data.size();
+	stats.latencySeconds += headersTime - read.sentTime;
+	// Count overlapping (pipelined) requests only once.
+	stats.busySeconds += doneTime - std::max(read.sentTime, lastDoneTime_);
+	lastDoneTime_ = doneTime;
+	return true;
+}
+
+void HTTPFileLoader::FailInFlight() {
+	for (const auto &read : inFlight_) {
+		read->done = true;
+		read->failed = true;
+		read->lost = true;
+	}
+	inFlight_.clear();
+	Disconnect();
 }
 
 void HTTPFileLoader::Connect() {
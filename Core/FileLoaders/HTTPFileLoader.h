@@ -17,8 +17,12 @@
 
 #pragma once
 
+#include <condition_variable>
+#include <deque>
+#include <memory>
 #include <mutex>
 
+#include "base/buffer.h"
 #include "net/http_client.h"
 #include "net/resolve.h"
 #include "net/url.h"
@@ -48,7 +52,34 @@ class HTTPFileLoader : public FileLoader {
 		cancelConnect_ = true;
 	}
 
+	struct Stats {
+		u64 requests;
+		u64 bytes;
+		// Time with at least one request outstanding, and the sum of time until headers arrived.
+		double busySeconds;
+		double latencySeconds;
+	};
+	// Totals for all remote reads so far, for the dev screen.
+	static Stats GetStats();
+
 private:
+	// A range request that has been sent, and whose response hasn't been used up yet.
+	struct PendingRead {
+		s64 pos;
+		s64 end;
+		double sentTime;
+		std::string data;
+		bool done;
+		bool failed;
+		// Never got a response, because the connection ended before it.
+		bool lost;
+	};
+
+	enum {
+		// With keepalive, requests are pipelined on one connection up to this many.
+		MAX_IN_FLIGHT = 4,
+	};
+
 	void Prepare();
 
 	void Connect();
@@ -58,8 +89,14 @@ class HTTPFileLoader : public FileLoader {
 			client_.Disconnect();
 		}
 		connected_ = false;
+		readbuf_.clear();
+		responsesOnConnection_ = 0;
 	}
 
+	std::shared_ptr<PendingRead> SendRangeRequest(s64 pos, s64 end);
+	bool ReadRangeResponse(PendingRead &read, bool *connectionEnds);
+	void FailInFlight();
+
 	s64 filesize_ = 0;
 	s64 filepos_ = 0;
 	Url url_;
@@ -67,6 +104,16 @@ class HTTPFileLoader : public FileLoader {
 	std::string filename_;
 	bool connected_ = false;
 	bool cancelConnect_ = false;
+	bool keepAlive_ = false;
+
+	// Responses come back in order, read by whichever waiting thread gets there first.
+	std::deque<std::shared_ptr<PendingRead>> inFlight_;
+	std::condition_variable inFlightCond_;
+	bool readingResponse_ = false;
+	// Only used by the thread reading a response, may hold the start of the next one.
+	Buffer readbuf_;
+	int responsesOnConnection_ = 0;
+	double lastDoneTime_ = 0.0;
 
 	std::once_flag preparedFlag_;
 	std::mutex readAtMutex_;
@@ -33,6 +33,7 @@ class LocalFileLoader : public FileLoader {
 	virtual s64 FileSize() override;
 	virtual std::string Path() const override;
 	virtual size_t ReadAt(s64 absolutePos, size_t bytes, size_t count, void *data, Flags flags = Flags::NONE) override;
+	virtual void Prefetch(s64 absolutePos, size_t bytes) override;
 
 private:
 #ifndef _WIN32
@@ -123,6 +123,13 @@ void RamCachingFileLoader::ShutdownCache() {
 	}
 }
 
+void RamCachingFileLoader::Prefetch(s64 absolutePos, size_t bytes) {
+	// Everything gets read eventually, this just moves the readahead there first.
+	if (absolutePos < filesize_) {
+		StartReadAhead(absolutePos);
+	}
+}
+
 void RamCachingFileLoader::Cancel() {
 	if (aheadThread_) {
 		std::lock_guard<std::mutex> guard(blocksMutex_);
@@ -39,6 +39,7 @@ class RamCachingFileLoader : public FileLoader {
 		return ReadAt(absolutePos, bytes * count, data, flags) / bytes;
 	}
 	size_t ReadAt(s64 absolutePos, size_t bytes, void *data, Flags flags = Flags::NONE) override;
+	void Prefetch(s64 absolutePos, size_t bytes) override;
 
 	void Cancel() override;
 
@@ -17,12 +17,16 @@
 
 
 #include "Common/FileUtil.h"
+#include "Common/Crypto/crc32.h"
 #include "Common/Swap.h"
+#include "Common/ThreadPools.h"
+#include "Core/Config.h"
 #include "Core/Loaders.h"
 #include "Core/FileSystems/BlockDevices.h"
 #include <cstdio>
 #include <cstring>
 #include <algorithm>
+#include <vector>
 
 extern "C"
 {
@@ -41,6 +45,8 @@ BlockDevice *constructBlockDevice(FileLoader *fileLoader) {
 	size_t size = fileLoader->ReadAt(0, 1, 4, buffer);
 	if (size == 4 && !memcmp(buffer, "CISO", 4))
 		return new CISOFileBlockDevice(fileLoader);
+	else if (size == 4 && !memcmp(buffer, "ZISO", 4))
+		return new ZSOFileBlockDevice(fileLoader);
 	else if (size == 4 && !memcmp(buffer, "\x00PBP", 4))
 		return new NPDRMDemoBlockDevice(fileLoader);
 	else
@@ -48,16 +54,32 @@ BlockDevice *constructBlockDevice(FileLoader *fileLoader) {
 }
 
 u32 BlockDevice::CalculateCRC() {
-	u32 crc = crc32(0, Z_NULL, 0);
-
-	u8 block[2048];
-	for (u32 i = 0; i < GetNumBlocks(); ++i) {
-		if (!ReadBlock(i, block, true)) {
-			ERROR_LOG(FILESYS, "Failed to read block for CRC");
+	// Large sequential reads, hashing each chunk on the thread pool while the next one loads.
+	const u32 CHUNK_BLOCKS = 256;
+	const u32 numBlocks = GetNumBlocks();
+	std::vector<u8> buffers[2];
+	buffers[0].resize(CHUNK_BLOCKS * GetBlockSize());
+	buffers[1].resize(CHUNK_BLOCKS * GetBlockSize());
+
+	u32 crc = 0;
+	TaskGroup hashing;
+	for (u32 start = 0, i = 0; start < numBlocks; start += CHUNK_BLOCKS, ++i) {
+		const u32 count = std::min(CHUNK_BLOCKS, numBlocks - start);
+		u8 *buf = buffers[i & 1].data();
+		const bool success = ReadBlocks(start, count, buf);
+		// The previous chunk must be hashed first, and its buffer is the next one we read into.
+		GlobalThreadPool::Wait(hashing);
+		if (!success) {
+			ERROR_LOG(FILESYS, "Failed to read blocks for CRC");
 			return 0;
 		}
-		crc = crc32(crc, block, 2048);
+
+		const size_t size = (size_t)count * GetBlockSize();
+		GlobalThreadPool::Run(hashing, [&crc, buf, size] {
+			crc = crc32_update(crc, buf, size);
+		});
 	}
+	GlobalThreadPool::Wait(hashing);
 
 	return crc;
 }
@@ -89,6 +111,10 @@ bool FileBlockDevice::ReadBlocks(u32 minBlock, int count, u8 *outPtr) {
 	return true;
 }
 
+void FileBlockDevice::Prefetch(u32 minBlock, u32 count) {
+	fileLoader_->Prefetch((u64)minBlock * (u64)GetBlockSize(), (size_t)count * GetBlockSize());
+}
+
 // .CSO format
 
 // compressed ISO(9660) header format
@@ -98,7 +124,7 @@ typedef struct ciso_header
 	u32_le header_size;             // +04 : header size (==0x18)
 	u64_le total_bytes;             // +08 : number of original data size
 	u32_le block_size;              // +10 : number of compressed block size
-	unsigned char ver;              // +14 : version 01
+	unsigned char ver;              // +14 : version 01 (or 02, which allows LZ4 frames)
 	unsigned char align;            // +15 : align of index value
 	unsigned char rsv_06[2];        // +16 : reserved
 #if 0
@@ -134,11 +160,12 @@ CISOFileBlockDevice::CISOFileBlockDevice(FileLoader *fileLoader)
 	{
 		VERBOSE_LOG(LOADER, "Valid CSO!");
 	}
-	if (hdr.ver > 1)
+	if (hdr.ver > 2)
 	{
 		ERROR_LOG(LOADER, "CSO version too high!");
 		//ARGH!
 	}
+	version = hdr.ver;
 
 	frameSize = hdr.block_size;
 	if ((frameSize & (frameSize - 1)) != 0)
@@ -159,9 +186,10 @@ CISOFileBlockDevice::CISOFileBlockDevice(FileLoader *fileLoader)
 
 	// We might read a bit of alignment too, so be prepared.
 	if (frameSize + (1 << indexShift) < CSO_READ_BUFFER_SIZE)
-		readBuffer = new u8[CSO_READ_BUFFER_SIZE];
+		readBufferSize = CSO_READ_BUFFER_SIZE;
 	else
-		readBuffer = new u8[frameSize + (1 << indexShift)];
+		readBufferSize = frameSize + (1 << indexShift);
+	readBuffer = new u8[readBufferSize];
 	zlibBuffer = new u8[frameSize + (1 << indexShift)];
 	zlibBufferFrame = numFrames;
 
@@ -196,6 +224,131 @@ CISOFileBlockDevice::~CISOFileBlockDevice()
 	delete [] zlibBuffer;
 }
 
+// Decodes a raw LZ4 block (no frame header), as written to CSO v2 files.
+// Stops once dest is full, since frames may be followed by alignment padding.
+// Returns the number of bytes written, or -1 if the data is corrupt.
+static int DecompressLZ4Block(const u8 *src, u32 srcSize, u8 *dest, u32 destSize) {
+	const u8 *ip = src;
+	const u8 *const iend = src + srcSize;
+	u8 *op = dest;
+	u8 *const oend = dest + destSize;
+
+	while (ip < iend) {
+		const u8 token = *ip++;
+
+		size_t literals = token >> 4;
+		if (literals == 15) {
+			u8 b;
+			do {
+				if (ip >= iend)
+					return -1;
+				b = *ip++;
+				literals += b;
+			} while (b == 255);
+		}
+		if (literals > (size_t)(iend - ip) || literals > (size_t)(oend - op))
+			return -1;
+		memcpy(op, ip, literals);
+		ip += literals;
+		op += literals;
+
+		// The last sequence has only literals.
+		if (ip >= iend || op == oend)
+			break;
+
+		if (iend - ip < 2)
+			return -1;
+		const size_t offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if (offset == 0 || offset > (size_t)(op - dest))
+			return -1;
+
+		size_t matchLength = token & 15;
+		if (matchLength == 15) {
+			u8 b;
+			do {
+				if (ip >= iend)
+					return -1;
+				b = *ip++;
+				matchLength += b;
+			} while (b == 255);
+		}
+		matchLength += 4;
+		if (matchLength > (size_t)(oend - op))
+			return -1;
+
+		const u8 *match = op - offset;
+		if (offset >= matchLength) {
+			memcpy(op, match, matchLength);
+			op += matchLength;
+		} else {
+			// Overlapping, this repeats the last offset bytes.
+			for (size_t i = 0; i < matchLength; ++i)
+				*op++ = *match++;
+		}
+	}
+
+	return (int)(op - dest);
+}
+
+CISOFileBlockDevice::FrameFormat CISOFileBlockDevice::GetFrameFormat(u32 frame) const {
+	const u32 idx = index[frame];
+	if (version >= 2) {
+		// In v2, the high bit means LZ4, and anything not smaller than a frame is stored.
+		const u64 readPos = (u64)(idx & 0x7FFFFFFF) << indexShift;
+		const u64 readEnd = (u64)(index[frame + 1] & 0x7FFFFFFF) << indexShift;
+		if (readEnd - readPos >= frameSize)
+			return FrameFormat::PLAIN;
+		return (idx & 0x80000000) ? FrameFormat::LZ4 : FrameFormat::DEFLATE;
+	}
+	return (idx & 0x80000000) ? FrameFormat::PLAIN : FrameFormat::DEFLATE;
+}
+
+// Decodes a whole frame into dest, which must hold frameSize bytes.  Doesn't touch
+// any shared state, so frames can be decoded on several threads at once.
+// For deflate frames, z must be an initialized raw inflate stream (it's reset after use.)
+bool CISOFileBlockDevice::DecodeFrame(u32 frame, const u8 *src, u32 srcSize, u8 *dest, z_stream *z) const {
+	switch (GetFrameFormat(frame)) {
+	case FrameFormat::PLAIN:
+		memcpy(dest, src, std::min(srcSize, frameSize));
+		if (srcSize < frameSize)
+			memset(dest + srcSize, 0, frameSize - srcSize);
+		return true;
+
+	case FrameFormat::LZ4:
+	{
+		int result = DecompressLZ4Block(src, srcSize, dest, frameSize);
+		if (result != (int)frameSize) {
+			ERROR_LOG(LOADER, "LZ4 frame %d: failed or size error %d != %d\n", frame, result, frameSize);
+			return false;
+		}
+		return true;
+	}
+
+	case FrameFormat::DEFLATE:
+	{
+		z->avail_in = srcSize;
+		z->next_in = (Bytef *)src;
+		z->avail_out = frameSize;
+		z->next_out = dest;
+
+		int status = inflate(z, Z_FINISH);
+		const u32 totalOut = (u32)z->total_out;
+		inflateReset(z);
+		if (status != Z_STREAM_END) {
+			ERROR_LOG(LOADER, "Inflate frame %d: failed - %s[%d]\n", frame, (z->msg) ? z->msg : "error", status);
+			return false;
+		}
+		if (totalOut != frameSize) {
+			ERROR_LOG(LOADER, "Inflate frame %d: block size error %d != %d\n", frame, totalOut, frameSize);
+			return false;
+		}
+		return true;
+	}
+	}
+	return false;
+}
+
 bool CISOFileBlockDevice::ReadBlock(int blockNumber, u8 *outPtr, bool uncached)
 {
 	FileLoader::Flags flags = uncached ? FileLoader::Flags::HINT_UNCACHED : FileLoader::Flags::NONE;
@@ -209,15 +362,14 @@ bool CISOFileBlockDevice::ReadBlock(int blockNumber, u8 *outPtr, bool uncached)
 	const u32 idx = index[frameNumber];
 	const u32 indexPos = idx & 0x7FFFFFFF;
 	const u32 nextIndexPos = index[frameNumber + 1] & 0x7FFFFFFF;
-	z_stream z;
 
 	const u64 compressedReadPos = (u64)indexPos << indexShift;
 	const u64 compressedReadEnd = (u64)nextIndexPos << indexShift;
-	const size_t compressedReadSize = (size_t)(compressedReadEnd - compressedReadPos);
+	const size_t compressedReadSize = std::min((size_t)(compressedReadEnd - compressedReadPos), readBufferSize);
 	const u32 compressedOffset = (blockNumber & ((1 << blockShift) - 1)) * GetBlockSize();
 
-	const int plain = idx & 0x80000000;
-	if (plain)
+	const FrameFormat format = GetFrameFormat(frameNumber);
+	if (format == FrameFormat::PLAIN)
 	{
 		int readSize = (u32)fileLoader_->ReadAt(compressedReadPos + compressedOffset, 1, GetBlockSize(), outPtr, flags);
 		if (readSize < GetBlockSize())
@@ -232,35 +384,29 @@ bool CISOFileBlockDevice::ReadBlock(int blockNumber, u8 *outPtr, bool uncached)
 	{
 		const u32 readSize = (u32)fileLoader_->ReadAt(compressedReadPos, 1, compressedReadSize, readBuffer, flags);
 
+		z_stream z;
 		z.zalloc = Z_NULL;
 		z.zfree = Z_NULL;
 		z.opaque = Z_NULL;
-		if(inflateInit2(&z, -15) != Z_OK)
+		if (format == FrameFormat::DEFLATE && inflateInit2(&z, -15) != Z_OK)
 		{
 			ERROR_LOG(LOADER, "GetBlockSize() ERROR: %s\n", (z.msg) ? z.msg : "?");
 			return false;
 		}
-		z.avail_in = readSize;
-		z.next_out = frameSize == (u32)GetBlockSize() ? outPtr : zlibBuffer;
-		z.avail_out = frameSize;
-		z.next_in = readBuffer;
 
-		int status = inflate(&z, Z_FINISH);
-		if (status != Z_STREAM_END)
-		{
-			ERROR_LOG(LOADER, "block %d: inflate : %s[%d]\n", blockNumber, (z.msg) ? z.msg : "error", status);
+		u8 *dest = frameSize == (u32)GetBlockSize() ? outPtr : zlibBuffer;
+		bool success = DecodeFrame(frameNumber, readBuffer, readSize, dest, &z);
+		if (format == FrameFormat::DEFLATE)
 			inflateEnd(&z);
-			memset(outPtr, 0, GetBlockSize());
-			return false;
-		}
-		if (z.total_out != frameSize)
+
+		if (!success)
 		{
-			ERROR_LOG(LOADER, "block %d: block size error %d != %d\n", blockNumber, (u32)z.total_out, frameSize);
-			inflateEnd(&z);
+			ERROR_LOG(LOADER, "block %d: unable to decode frame %d\n", blockNumber, frameNumber);
+			if (dest == zlibBuffer)
+				zlibBufferFrame = numFrames;
 			memset(outPtr, 0, GetBlockSize());
 			return false;
 		}
-		inflateEnd(&z);
 
 		if (frameSize != (u32)GetBlockSize())
 		{
@@ -281,85 +427,364 @@ bool CISOFileBlockDevice::ReadBlocks(u32 minBlock, int count, u8 *outPtr) {
 	}
 
 	const u32 lastBlock = std::min(minBlock + count, numBlocks) - 1;
-	const u32 missingBlocks = (lastBlock + 1 - minBlock) - count;
-	if (lastBlock < minBlock + count) {
+	const u32 missingBlocks = count - (lastBlock + 1 - minBlock);
+	if (missingBlocks != 0) {
 		memset(outPtr + GetBlockSize() * (count - missingBlocks), 0, GetBlockSize() * missingBlocks);
 	}
 
 	const u32 minFrameNumber = minBlock >> blockShift;
 	const u32 lastFrameNumber = lastBlock >> blockShift;
-	const u32 afterLastIndexPos = index[lastFrameNumber + 1] & 0x7FFFFFFF;
-	const u64 totalReadEnd = (u64)afterLastIndexPos << indexShift;
-
-	z_stream z;
-	z.zalloc = Z_NULL;
-	z.zfree = Z_NULL;
-	z.opaque = Z_NULL;
-	if (inflateInit2(&z, -15) != Z_OK) {
-		ERROR_LOG(LOADER, "Unable to initialize inflate: %s\n", (z.msg) ? z.msg : "?");
+	const u32 blocksPerFrame = 1 << blockShift;
+
+	auto framePos = [&](u32 frame) {
+		return (u64)(index[frame] & 0x7FFFFFFF) << indexShift;
+	};
+
+	// The last frame goes through zlibBuffer if it's partial, so a following single read can reuse it.
+	const bool keepLastFrame = (lastBlock & (blocksPerFrame - 1)) != blocksPerFrame - 1;
+	if (keepLastFrame && zlibBufferFrame == lastFrameNumber)
+		zlibBufferFrame = numFrames;
+	bool lastFrameDecoded = false;
+
+	u32 frame = minFrameNumber;
+	while (frame <= lastFrameNumber) {
+		// Read as many frames as fit in the buffer at once, at least one.
+		const u64 batchReadPos = framePos(frame);
+		u32 batchEnd = frame + 1;
+		while (batchEnd <= lastFrameNumber && framePos(batchEnd + 1) - batchReadPos <= readBufferSize)
+			++batchEnd;
+
+		const size_t chunkSize = (size_t)std::min(framePos(batchEnd) - batchReadPos, (u64)readBufferSize);
+		const size_t readSize = fileLoader_->ReadAt(batchReadPos, 1, chunkSize, readBuffer);
+		if (readSize < chunkSize) {
+			memset(readBuffer + readSize, 0, chunkSize - readSize);
+		}
+
+		// Frames are independent, so decode them in parallel.  Each range gets its own stream.
+		auto decodeFrames = [&](int lower, int upper) {
+			z_stream z;
+			bool zInitialized = false;
+			u8 *tempBuffer = nullptr;
+
+			for (u32 f = (u32)lower; f < (u32)upper; ++f) {
+				const u32 frameFirstBlock = f << blockShift;
+				const u32 startBlock = std::max(minBlock, frameFirstBlock);
+				const u32 endBlock = std::min(lastBlock + 1, frameFirstBlock + blocksPerFrame);
+				const u32 frameBlockOffset = startBlock - frameFirstBlock;
+				const u32 frameBlocks = endBlock - startBlock;
+				u8 *dest = outPtr + (startBlock - minBlock) * GetBlockSize();
+
+				const u64 srcOffset = framePos(f) - batchReadPos;
+				const u8 *src = readBuffer + (size_t)std::min(srcOffset, (u64)chunkSize);
+				const u32 srcSize = (u32)std::min(framePos(f + 1) - batchReadPos, (u64)chunkSize) - (u32)std::min(srcOffset, (u64)chunkSize);
+
+				if (GetFrameFormat(f) == FrameFormat::DEFLATE && !zInitialized) {
+					z.zalloc = Z_NULL;
+					z.zfree = Z_NULL;
+					z.opaque = Z_NULL;
+					if (inflateInit2(&z, -15) != Z_OK) {
+						ERROR_LOG(LOADER, "Unable to initialize inflate: %s\n", (z.msg) ? z.msg : "?");
+						memset(dest, 0, frameBlocks * GetBlockSize());
+						continue;
+					}
+					zInitialized = true;
+				}
+
+				u8 *frameDest = dest;
+				if (frameBlocks != blocksPerFrame) {
+					if (f == lastFrameNumber && keepLastFrame) {
+						frameDest = zlibBuffer;
+					} else {
+						if (!tempBuffer)
+							tempBuffer = new u8[frameSize];
+						frameDest = tempBuffer;
+					}
+				}
+
+				if (!DecodeFrame(f, src, srcSize, frameDest, &z)) {
+					memset(dest, 0, frameBlocks * GetBlockSize());
+				} else {
+					if (frameDest != dest)
+						memcpy(dest, frameDest + frameBlockOffset * GetBlockSize(), frameBlocks * GetBlockSize());
+					if (frameDest == zlibBuffer)
+						lastFrameDecoded = true;
+				}
+			}
+
+			if (zInitialized)
+				inflateEnd(&z);
+			delete [] tempBuffer;
+		};
+		GlobalThreadPool::Loop(decodeFrames, (int)frame, (int)batchEnd);
+
+		frame = batchEnd;
+	}
+
+	// In case we end up reusing it in a single read later.
+	if (lastFrameDecoded)
+		zlibBufferFrame = lastFrameNumber;
+	return true;
+}
+
+void CISOFileBlockDevice::Prefetch(u32 minBlock, u32 count) {
+	if (minBlock >= numBlocks || count == 0) {
+		return;
+	}
+
+	// Compressed frames are stored in order, so this is just the range from first to last.
+	const u32 lastBlock = std::min(minBlock + count, numBlocks) - 1;
+	const u64 readPos = (u64)(index[minBlock >> blockShift] & 0x7FFFFFFF) << indexShift;
+	const u64 readEnd = (u64)(index[(lastBlock >> blockShift) + 1] & 0x7FFFFFFF) << indexShift;
+	if (readEnd > readPos) {
+		fileLoader_->Prefetch(readPos, (size_t)(readEnd - readPos));
+	}
+}
+
+// .ZSO format, the CSO v1 header and index but with raw LZ4 frames.
+// The index high bit still marks stored (plain) frames.
+
+ZSOFileBlockDevice::ZSOFileBlockDevice(FileLoader *fileLoader)
+	: fileLoader_(fileLoader) {
+	CISO_H hdr;
+	size_t readSize = fileLoader->ReadAt(0, sizeof(CISO_H), 1, &hdr);
+	if (readSize != 1 || memcmp(hdr.magic, "ZISO", 4) != 0) {
+		WARN_LOG(LOADER, "Invalid ZSO!");
+	}
+	if (hdr.ver > 1) {
+		ERROR_LOG(LOADER, "ZSO version too high!");
+	}
+
+	frameSize_ = hdr.block_size;
+	if ((frameSize_ & (frameSize_ - 1)) != 0 || frameSize_ < 0x800) {
+		ERROR_LOG(LOADER, "ZSO block size %i unsupported, must be a power of two, at least one sector", frameSize_);
+		frameSize_ = 0x800;
+	}
+
+	blockShift_ = 0;
+	for (u32 i = frameSize_; i > 0x800; i >>= 1)
+		++blockShift_;
+
+	indexShift_ = hdr.align;
+	const u64 totalSize = hdr.total_bytes;
+	numFrames_ = (u32)((totalSize + frameSize_ - 1) / frameSize_);
+	numBlocks_ = (u32)(totalSize / GetBlockSize());
+	VERBOSE_LOG(LOADER, "ZSO numBlocks=%i numFrames=%i align=%i", numBlocks_, numFrames_, indexShift_);
+
+	// Multi-block reads fill the whole buffer, which must also fit one frame plus alignment.
+	readBufferSize_ = std::max((size_t)CSO_READ_BUFFER_SIZE, (size_t)frameSize_ + ((size_t)1 << indexShift_));
+	readBuffer_ = new u8[readBufferSize_];
+	frameBuffer_ = new u8[frameSize_];
+
+	index_.resize(numFrames_ + 1);
+	if (fileLoader->ReadAt(sizeof(hdr), sizeof(u32), index_.size(), &index_[0]) != index_.size()) {
+		memset(&index_[0], 0, index_.size() * sizeof(u32));
+	}
+
+	maxCachedFrames_ = std::max((size_t)g_Config.iZSOCacheSize * 1024 / frameSize_, (size_t)8);
+
+	// The volume descriptor and root directory get looked at for every path lookup.
+	PinFramesForBlocks(16, 1);
+	u8 desc[2048];
+	if (ReadBlock(16, desc) && memcmp(desc + 1, "CD001", 5) == 0) {
+		// Root directory record is at 156, with its LE extent and length at +2 and +10.
+		u32_le rootSector, rootSize;
+		memcpy(&rootSector, desc + 156 + 2, sizeof(rootSector));
+		memcpy(&rootSize, desc + 156 + 10, sizeof(rootSize));
+		PinFramesForBlocks(rootSector, std::min((u32)rootSize / 2048 + 1, 16U));
+	}
+}
+
+ZSOFileBlockDevice::~ZSOFileBlockDevice() {
+	for (auto &frame : cache_) {
+		delete [] frame.second.data;
+	}
+	delete [] readBuffer_;
+	delete [] frameBuffer_;
+}
+
+// Returns the compressed data of a frame.  Misses read ahead up to readAheadEnd,
+// so a run of frames only goes to the file loader once per buffer.
+const u8 *ZSOFileBlockDevice::ReadCompressedFrame(u32 frame, u64 readAheadEnd, u32 *size, bool uncached) {
+	const u64 pos = FramePos(frame);
+	const u64 end = FramePos(frame + 1);
+	if (end < pos || end - pos > readBufferSize_) {
+		ERROR_LOG(LOADER, "ZSO frame %d: bad index", frame);
+		return nullptr;
+	}
+
+	if (pos < readBufferStart_ || end > readBufferEnd_) {
+		FileLoader::Flags flags = uncached ? FileLoader::Flags::HINT_UNCACHED : FileLoader::Flags::NONE;
+		const size_t chunkSize = (size_t)std::min(std::max(readAheadEnd, end) - pos, (u64)readBufferSize_);
+		const size_t readSize = fileLoader_->ReadAt(pos, 1, chunkSize, readBuffer_, flags);
+		if (readSize < chunkSize) {
+			memset(readBuffer_ + readSize, 0, chunkSize - readSize);
+		}
+		readBufferStart_ = pos;
+		readBufferEnd_ = pos + chunkSize;
+	}
+
+	*size = (u32)(end - pos);
+	return readBuffer_ + (size_t)(pos - readBufferStart_);
+}
+
+bool ZSOFileBlockDevice::DecodeFrame(u32 frame, u8 *dest, u64 readAheadEnd, bool uncached) {
+	u32 srcSize;
+	const u8 *src = ReadCompressedFrame(frame, readAheadEnd, &srcSize, uncached);
+	if (!src) {
 		return false;
 	}
 
-	u64 readBufferStart = 0;
-	u64 readBufferEnd = 0;
-	u32 block = minBlock;
-	const u32 blocksPerFrame = 1 << blockShift;
-	for (u32 frame = minFrameNumber; frame <= lastFrameNumber; ++frame) {
-		const u32 idx = index[frame];
-		const u32 indexPos = idx & 0x7FFFFFFF;
-		const u32 nextIndexPos = index[frame + 1] & 0x7FFFFFFF;
-
-		const u64 frameReadPos = (u64)indexPos << indexShift;
-		const u64 frameReadEnd = (u64)nextIndexPos << indexShift;
-		const u32 frameReadSize = (u32)(frameReadEnd - frameReadPos);
-		const u32 frameBlockOffset = block & ((1 << blockShift) - 1);
-		const u32 frameBlocks = std::min(lastBlock - block + 1, blocksPerFrame - frameBlockOffset);
-
-		if (frameReadEnd > readBufferEnd) {
-			const s64 maxNeeded = totalReadEnd - frameReadPos;
-			const size_t chunkSize = (size_t)std::min(maxNeeded, (s64)std::max(frameReadSize, CSO_READ_BUFFER_SIZE));
-
-			const u32 readSize = (u32)fileLoader_->ReadAt(frameReadPos, 1, chunkSize, readBuffer);
-			if (readSize < chunkSize) {
-				memset(readBuffer + readSize, 0, chunkSize - readSize);
+	if (index_[frame] & 0x80000000) {
+		memcpy(dest, src, std::min(srcSize, frameSize_));
+		if (srcSize < frameSize_)
+			memset(dest + srcSize, 0, frameSize_ - srcSize);
+		return true;
+	}
+
+	int result = DecompressLZ4Block(src, srcSize, dest, frameSize_);
+	if (result != (int)frameSize_) {
+		ERROR_LOG(LOADER, "ZSO frame %d: LZ4 failed or size error %d != %d", frame, result, frameSize_);
+		return false;
+	}
+	return true;
+}
+
+const u8 *ZSOFileBlockDevice::GetCachedFrame(u32 frame) {
+	auto it = cache_.find(frame);
+	if (it != cache_.end()) {
+		if (it->second.data) {
+			it->second.generation = ++generation_;
+			return it->second.data;
+		}
+	} else if (cache_.size() >= maxCachedFrames_) {
+		// Evict the least recently used frame.  The cache is small, so a scan is fine.
+		auto oldest = cache_.end();
+		for (auto iter = cache_.begin(); iter != cache_.end(); ++iter) {
+			if (!iter->second.pinned && (oldest == cache_.end() || iter->second.generation < oldest->second.generation)) {
+				oldest = iter;
 			}
+		}
+		if (oldest != cache_.end()) {
+			delete [] oldest->second.data;
+			cache_.erase(oldest);
+		}
+	}
+
+	u8 *data = new u8[frameSize_];
+	if (!DecodeFrame(frame, data, 0, false)) {
+		delete [] data;
+		return nullptr;
+	}
+
+	CachedFrame &cached = cache_[frame];
+	cached.data = data;
+	cached.generation = ++generation_;
+	return data;
+}
+
+void ZSOFileBlockDevice::PinFramesForBlocks(u32 minBlock, u32 count) {
+	if (minBlock >= numBlocks_ || count == 0) {
+		return;
+	}
 
-			readBufferStart = frameReadPos;
-			readBufferEnd = frameReadPos + readSize;
+	const u32 lastBlock = std::min(minBlock + count, numBlocks_) - 1;
+	for (u32 frame = minBlock >> blockShift_; frame <= lastBlock >> blockShift_; ++frame) {
+		// Decoded on first use, and then never evicted.
+		CachedFrame &cached = cache_[frame];
+		if (!cached.pinned) {
+			cached.data = nullptr;
+			cached.generation = 0;
+			cached.pinned = true;
 		}
+	}
+}
 
-		u8 *rawBuffer = &readBuffer[frameReadPos - readBufferStart];
-		const int plain = idx & 0x80000000;
-		if (plain) {
-			memcpy(outPtr, rawBuffer + frameBlockOffset * GetBlockSize(), frameBlocks * GetBlockSize());
-		} else {
-			z.avail_in = frameReadSize;
-			z.next_out = frameBlocks == blocksPerFrame ? outPtr : zlibBuffer;
-			z.avail_out = frameSize;
-			z.next_in = rawBuffer;
-
-			int status = inflate(&z, Z_FINISH);
-			if (status != Z_STREAM_END) {
-				ERROR_LOG(LOADER, "Inflate frame %d: failed - %s[%d]\n", frame, (z.msg) ? z.msg : "error", status);
-				memset(outPtr, 0, frameBlocks * GetBlockSize());
-			} else if (z.total_out != frameSize) {
-				ERROR_LOG(LOADER, "Inflate frame %d: block size error %d != %d\n", frame, (u32)z.total_out, frameSize);
-				memset(outPtr, 0, frameBlocks * GetBlockSize());
-			} else if (frameBlocks != blocksPerFrame) {
-				memcpy(outPtr, zlibBuffer + frameBlockOffset * GetBlockSize(), frameBlocks * GetBlockSize());
-				// In case we end up reusing it in a single read later.
-				zlibBufferFrame = frame;
+bool ZSOFileBlockDevice::ReadBlock(int blockNumber, u8 *outPtr, bool uncached) {
+	if ((u32)blockNumber >= numBlocks_) {
+		memset(outPtr, 0, GetBlockSize());
+		return false;
+	}
+
+	const u32 frame = blockNumber >> blockShift_;
+	const u32 frameOffset = (blockNumber & ((1 << blockShift_) - 1)) * GetBlockSize();
+
+	const u8 *data = nullptr;
+	if (uncached && cache_.find(frame) == cache_.end()) {
+		// Don't push anything out of the cache (e.g. for CRC calculation.)
+		if (DecodeFrame(frame, frameBuffer_, 0, true))
+			data = frameBuffer_;
+	} else {
+		data = GetCachedFrame(frame);
+	}
+
+	if (!data) {
+		memset(outPtr, 0, GetBlockSize());
+		return false;
+	}
+	memcpy(outPtr, data + frameOffset, GetBlockSize());
+	return true;
+}
+
+bool ZSOFileBlockDevice::ReadBlocks(u32 minBlock, int count, u8 *outPtr) {
+	if (count == 1) {
+		return ReadBlock(minBlock, outPtr);
+	}
+	if (minBlock >= numBlocks_) {
+		memset(outPtr, 0, GetBlockSize() * count);
+		return false;
+	}
+
+	const u32 lastBlock = std::min(minBlock + count, numBlocks_) - 1;
+	const u32 missingBlocks = count - (lastBlock + 1 - minBlock);
+	if (missingBlocks != 0) {
+		memset(outPtr + GetBlockSize() * (count - missingBlocks), 0, GetBlockSize() * missingBlocks);
+	}
+
+	const u32 blocksPerFrame = 1 << blockShift_;
+	const u32 lastFrame = lastBlock >> blockShift_;
+	const u64 totalReadEnd = FramePos(lastFrame + 1);
+
+	bool success = true;
+	for (u32 frame = minBlock >> blockShift_; frame <= lastFrame; ++frame) {
+		const u32 frameFirstBlock = frame << blockShift_;
+		const u32 startBlock = std::max(minBlock, frameFirstBlock);
+		const u32 endBlock = std::min(lastBlock + 1, frameFirstBlock + blocksPerFrame);
+		const u32 frameBlocks = endBlock - startBlock;
+		u8 *dest = outPtr + (startBlock - minBlock) * GetBlockSize();
+
+		auto cached = cache_.find(frame);
+		if (frameBlocks == blocksPerFrame && (cached == cache_.end() || !cached->second.data)) {
+			// Streaming through whole frames, decode straight to the output and leave the cache alone.
+			if (!DecodeFrame(frame, dest, totalReadEnd, false)) {
+				memset(dest, 0, frameBlocks * GetBlockSize());
+				success = false;
 			}
+			continue;
+		}
 
-			inflateReset(&z);
+		const u8 *data = GetCachedFrame(frame);
+		if (data) {
+			memcpy(dest, data + (startBlock - frameFirstBlock) * GetBlockSize(), frameBlocks * GetBlockSize());
+		} else {
+			memset(dest, 0, frameBlocks * GetBlockSize());
+			success = false;
 		}
+	}
 
-		block += frameBlocks;
-		outPtr += frameBlocks * GetBlockSize();
+	return success;
+}
+
+void ZSOFileBlockDevice::Prefetch(u32 minBlock, u32 count) {
+	if (minBlock >= numBlocks_ || count == 0) {
+		return;
 	}
 
-	inflateEnd(&z);
-	return true;
+	const u32 lastBlock = std::min(minBlock + count, numBlocks_) - 1;
+	const u64 readPos = FramePos(minBlock >> blockShift_);
+	const u64 readEnd = FramePos((lastBlock >> blockShift_) + 1);
+	if (readEnd > readPos) {
+		fileLoader_->Prefetch(readPos, (size_t)(readEnd - readPos));
+	}
 }
 
 NPDRMDemoBlockDevice::NPDRMDemoBlockDevice(FileLoader *fileLoader)
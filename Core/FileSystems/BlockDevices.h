@@ -19,16 +19,21 @@
 
 // Abstractions around read-only blockdevices, such as PSP UMD discs.
 // CISOFileBlockDevice implements compressed iso images, CISO format.
+// ZSOFileBlockDevice implements the same layout with LZ4 frames, ZISO format.
 //
 // The ISOFileSystemReader reads from a BlockDevice, so it automatically works
 // with CISO images.
 
+#include <map>
 #include <mutex>
+#include <vector>
 
 #include "Common/CommonTypes.h"
+#include "Common/Swap.h"
 #include "Core/ELF/PBPReader.h"
 
 class FileLoader;
+struct z_stream_s;
 
 class BlockDevice {
 public:
@@ -43,6 +48,8 @@ class BlockDevice {
 		}
 		return true;
 	}
+	// Hint that these blocks will probably be read soon.
+	virtual void Prefetch(u32 minBlock, u32 count) {}
 	int GetBlockSize() const { return 2048;}  // forced, it cannot be changed by subclasses
 	virtual u32 GetNumBlocks() = 0;
 
@@ -55,28 +62,86 @@ class CISOFileBlockDevice : public BlockDevice {
 	~CISOFileBlockDevice();
 	bool ReadBlock(int blockNumber, u8 *outPtr, bool uncached = false) override;
 	bool ReadBlocks(u32 minBlock, int count, u8 *outPtr) override;
+	void Prefetch(u32 minBlock, u32 count) override;
 	u32 GetNumBlocks() override { return numBlocks; }
 
 private:
+	enum class FrameFormat {
+		PLAIN,
+		DEFLATE,
+		LZ4,
+	};
+
+	FrameFormat GetFrameFormat(u32 frame) const;
+	bool DecodeFrame(u32 frame, const u8 *src, u32 srcSize, u8 *dest, z_stream_s *z) const;
+
 	FileLoader *fileLoader_;
 	u32 *index;
 	u8 *readBuffer;
+	size_t readBufferSize;
 	u8 *zlibBuffer;
 	u32 zlibBufferFrame;
 	u8 indexShift;
 	u8 blockShift;
+	u8 version;
 	u32 frameSize;
 	u32 numBlocks;
 	u32 numFrames;
 };
 
 
+// Decoded frames are kept in a cache sized by config, and the frames holding the
+// volume descriptor and root directory stay cached so root lookups never decode.
+class ZSOFileBlockDevice : public BlockDevice {
+public:
+	ZSOFileBlockDevice(FileLoader *fileLoader);
+	~ZSOFileBlockDevice();
+	bool ReadBlock(int blockNumber, u8 *outPtr, bool uncached = false) override;
+	bool ReadBlocks(u32 minBlock, int count, u8 *outPtr) override;
+	void Prefetch(u32 minBlock, u32 count) override;
+	u32 GetNumBlocks() override { return numBlocks_; }
+
+private:
+	struct CachedFrame {
+		u8 *data;
+		u64 generation;
+		bool pinned;
+	};
+
+	u64 FramePos(u32 frame) const {
+		return (u64)(index_[frame] & 0x7FFFFFFF) << indexShift_;
+	}
+	const u8 *ReadCompressedFrame(u32 frame, u64 readAheadEnd, u32 *size, bool uncached);
+	bool DecodeFrame(u32 frame, u8 *dest, u64 readAheadEnd, bool uncached);
+	const u8 *GetCachedFrame(u32 frame);
+	void PinFramesForBlocks(u32 minBlock, u32 count);
+
+	FileLoader *fileLoader_;
+	std::vector<u32_le> index_;
+	u8 *readBuffer_;
+	size_t readBufferSize_;
+	u64 readBufferStart_ = 0;
+	u64 readBufferEnd_ = 0;
+	u8 *frameBuffer_;
+	u8 indexShift_;
+	u8 blockShift_;
+	u32 frameSize_;
+	u32 numBlocks_;
+	u32 numFrames_;
+
+	std::map<u32, CachedFrame> cache_;
+	size_t maxCachedFrames_;
+	u64 generation_ = 0;
+};
+
+
 class FileBlockDevice : public BlockDevice {
 public:
 	FileBlockDevice(FileLoader *fileLoader);
 	~FileBlockDevice();
 	bool ReadBlock(int blockNumber, u8 *outPtr, bool uncached = false) override;
 	bool ReadBlocks(u32 minBlock, int count, u8 *outPtr) override;
+	void Prefetch(u32 minBlock, u32 count) override;
 	u32 GetNumBlocks() override {return (u32)(filesize_ / GetBlockSize());}
 
 private:
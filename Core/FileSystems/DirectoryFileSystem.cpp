@@ -19,6 +19,9 @@
 
 #include <algorithm>
 #include <limits>
+#include <map>
+#include <mutex>
+#include <unordered_map>
 #include "file/free.h"
 #include "file/zip_read.h"
 #include "i18n/i18n.h"
@@ -51,6 +54,71 @@
 #endif
 
 #if HOST_IS_CASE_SENSITIVE
+struct CaseListing {
+	time_t mtime;
+	// Lowercase name -> name on disk.
+	std::unordered_map<std::string, std::string> names;
+};
+
+// Directory listings for case fixing, shared by all directory file systems.
+// Games often probe lots of files that don't exist, and listing a directory on an SD card
+// each time is very slow.
+static std::map<std::string, CaseListing> caseListings;
+static std::mutex caseListingsLock;
+static const size_t MAX_CASE_LISTINGS = 256;
+// Filesystems like FAT only have 2 second mtime precision, so newer listings might miss files.
+static const time_t CASE_LISTING_MTIME_SLOP = 2;
+
+static bool LookupFilenameCase(const std::string &path, std::string &filename) {
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0)
+		return false;
+
+	std::lock_guard<std::mutex> guard(caseListingsLock);
+	auto it = caseListings.find(path);
+	if (it == caseListings.end() || it->second.mtime != st.st_mtime) {
+		DIR *dirp = opendir(path.c_str());
+		if (!dirp)
+			return false;
+
+		CaseListing listing;
+		listing.mtime = st.st_mtime;
+
+		struct dirent_large { struct dirent entry; char padding[FILENAME_MAX+1]; } diren;
+		struct dirent *result = NULL;
+		while (!readdir_r(dirp, (dirent*) &diren, &result) && result)
+		{
+			std::string lower = result->d_name;
+			for (size_t i = 0; i < lower.size(); i++)
+				lower[i] = tolower(lower[i]);
+			// If two only differ by case, the last one listed wins.
+			listing.names[lower] = result->d_name;
+		}
+		closedir(dirp);
+
+		// Don't keep a listing that might have been taken mid-change, just use it once.
+		if (time(nullptr) - st.st_mtime <= CASE_LISTING_MTIME_SLOP) {
+			if (it != caseListings.end())
+				caseListings.erase(it);
+			auto found = listing.names.find(filename);
+			if (found == listing.names.end())
+				return false;
+			filename = found->second;
+			return true;
+		}
+
+		if (it == caseListings.end() && caseListings.size() >= MAX_CASE_LISTINGS)
+			caseListings.clear();
+		it = caseListings.emplace(path, std::move(listing)).first;
+	}
+
+	auto found = it->second.names.find(filename);
+	if (found == it->second.names.end())
+		return false;
+	filename = found->second;
+	return true;
+}
+
 static bool FixFilenameCase(const std::string &path, std::string &filename)
 {
 	// Are we lucky?
@@ -63,40 +131,7 @@ static bool FixFilenameCase(const std::string &path, std::string &filename)
 		filename[i] = tolower(filename[i]);
 	}
 
-	//TODO: lookup filename in cache for "path"
-
-	struct dirent_large { struct dirent entry; char padding[FILENAME_MAX+1]; } diren;
-	struct dirent_large;
-	struct dirent *result = NULL;
-
-	DIR *dirp = opendir(path.c_str());
-	if (!dirp)
-		return false;
-
-	bool retValue = false;
-
-	while (!readdir_r(dirp, (dirent*) &diren, &result) && result)
-	{
-		if (strlen(result->d_name) != filenameSize)
-			continue;
-
-		size_t i;
-		for (i = 0; i < filenameSize; i++)
-		{
-			if (filename[i] != tolower(result->d_name[i]))
-				break;
-		}
-
-		if (i < filenameSize)
-			continue;
-
-		filename = result->d_name;
-		retValue = true;
-	}
-
-	closedir(dirp);
-
-	return retValue;
+	return LookupFilenameCase(path, filename);
 }
 
 bool FixPathCase(std::string& basePath, std::string &path, FixPathCaseBehavior behavior)
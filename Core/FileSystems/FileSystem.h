@@ -127,6 +127,8 @@ class IFileSystem {
 	virtual int      DevType(u32 handle) = 0;
 	virtual int      Flags() = 0;
 	virtual u64      FreeSpace(const std::string &path) = 0;
+	// File systems that wrap another (sharing its state) should return it, so they're locked together.
+	virtual IFileSystem *GetDevice() { return this; }
 };
 
 
@@ -23,13 +23,32 @@
 #include "Common/Common.h"
 #include "Common/CommonTypes.h"
 #include "Common/ChunkFile.h"
+#include "Common/FileUtil.h"
+#include "Common/StringUtils.h"
 #include "Core/FileSystems/ISOFileSystem.h"
 #include "Core/HLE/sceKernel.h"
 #include "Core/MemMap.h"
 #include "Core/Reporting.h"
+#include "Core/System.h"
+#include "ext/xxhash.h"
 
 const int sectorSize = 2048;
 
+// How much reading after an open gets remembered for it, at most.
+static const u32 READAHEAD_WINDOW_SECTORS = 8192;
+static const size_t READAHEAD_MAX_RANGES = 64;
+// Opens still collecting reads.  More than this and the oldest stops early.
+static const size_t READAHEAD_MAX_PENDING = 8;
+static const size_t READAHEAD_MAX_FILES = 4096;
+
+static const u32 READAHEAD_HISTORY_MAGIC = 0x41525050;  // PPRA
+static const u32 READAHEAD_HISTORY_VERSION = 1;
+
+static const u32 DIRCACHE_MAGIC = 0x54445050;  // PPDT
+static const u32 DIRCACHE_VERSION = 1;
+// Smaller directories are faster to scan than to hash.
+static const size_t CHILD_INDEX_MIN_CHILDREN = 16;
+
 bool parseLBN(std::string filename, u32 *sectorStart, u32 *readSize) {
 	// The format of this is: "/sce_lbn" "0x"? HEX* ANY* "_size" "0x"? HEX* ANY*
 	// That means that "/sce_lbn/_size1/" is perfectly valid.
@@ -196,11 +215,36 @@ ISOFileSystem::ISOFileSystem(IHandleAllocator *_hAlloc, BlockDevice *_blockDevic
 }
 
 ISOFileSystem::~ISOFileSystem() {
+	if (!readAheadHistoryPath_.empty()) {
+		for (const PendingReadAhead &pending : readAheadPending_) {
+			FinishReadAhead(pending);
+		}
+		if (readAheadHistoryDirty_) {
+			SaveReadAheadHistory();
+		}
+	}
+	if (!dirCachePath_.empty() && dirCacheDirty_) {
+		SaveDirectoryCache();
+	}
 	delete blockDevice;
 	delete treeroot;
 }
 
 void ISOFileSystem::ReadDirectory(TreeEntry *root) {
+	if (!dirCachePath_.empty()) {
+		auto cached = dirCache_.find(root->startsector);
+		if (cached != dirCache_.end() && cached->second.dirsize == root->dirsize) {
+			for (const CachedDirEntry &e : cached->second.entries) {
+				AddChild(root, e.name, e.startsector, e.size, e.flags);
+			}
+			root->valid = true;
+			return;
+		}
+	}
+
+	CachedDirectory parsed;
+	parsed.dirsize = root->dirsize;
+
 	for (u32 secnum = root->startsector, endsector = root->startsector + (root->dirsize + 2047) / 2048; secnum < endsector; ++secnum) {
 		u8 theSector[2048];
 		if (!blockDevice->ReadBlock(secnum, theSector)) {
@@ -226,41 +270,74 @@ void ISOFileSystem::ReadDirectory(TreeEntry *root) {
 
 			offset += dir.size;
 
-			bool isFile = (dir.flags & 2) ? false : true;
-			bool relative;
-
-			TreeEntry *entry = new TreeEntry();
+			std::string name;
 			if (dir.identifierLength == 1 && (dir.firstIdChar == '\x00' || dir.firstIdChar == '.')) {
-				entry->name = ".";
-				relative = true;
+				name = ".";
 			} else if (dir.identifierLength == 1 && dir.firstIdChar == '\x01') {
-				entry->name = "..";
-				relative = true;
+				name = "..";
 			} else {
-				entry->name = std::string((const char *)&dir.firstIdChar, dir.identifierLength);
-				relative = false;
+				name = std::string((const char *)&dir.firstIdChar, dir.identifierLength);
 			}
 
-			entry->size = dir.dataLength();
-			entry->startingPosition = dir.firstDataSector() * 2048;
-			entry->isDirectory = !isFile;
-			entry->flags = dir.flags;
-			entry->parent = root;
-			entry->startsector = dir.firstDataSector();
-			entry->dirsize = dir.dataLength();
-			entry->valid = isFile;  // Can pre-mark as valid if file, as we don't recurse into those.
-			// Let's not excessively spam the log - I commented this line out.
-			//DEBUG_LOG(FILESYS, "%s: %s %08x %08x %i", entry->isDirectory?"D":"F", entry->name.c_str(), dir.firstDataSectorLE, entry->startingPosition, entry->startingPosition);
-
-			if (entry->isDirectory && !relative) {
-				if (entry->startsector == root->startsector) {
-					ERROR_LOG(FILESYS, "WARNING: Appear to have a recursive file system, breaking recursion. Probably corrupt ISO.");
-				}
+			AddChild(root, name, dir.firstDataSector(), dir.dataLength(), dir.flags);
+			if (!dirCachePath_.empty()) {
+				parsed.entries.push_back(CachedDirEntry{ name, dir.firstDataSector(), dir.dataLength(), dir.flags });
 			}
-			root->children.push_back(entry);
 		}
 	}
 	root->valid = true;
+
+	if (!dirCachePath_.empty()) {
+		dirCache_[root->startsector] = std::move(parsed);
+		dirCacheDirty_ = true;
+	}
+}
+
+ISOFileSystem::TreeEntry *ISOFileSystem::AddChild(TreeEntry *root, const std::string &name, u32 startsector, u32 size, u8 flags) {
+	bool isFile = (flags & 2) ? false : true;
+	bool relative = name == "." || name == "..";
+
+	TreeEntry *entry = new TreeEntry();
+	entry->name = name;
+	entry->size = size;
+	entry->startingPosition = startsector * 2048;
+	entry->isDirectory = !isFile;
+	entry->flags = flags;
+	entry->parent = root;
+	entry->startsector = startsector;
+	entry->dirsize = size;
+	entry->valid = isFile;  // Can pre-mark as valid if file, as we don't recurse into those.
+	// Let's not excessively spam the log - I commented this line out.
+	//DEBUG_LOG(FILESYS, "%s: %s %08x %08x %i", entry->isDirectory?"D":"F", entry->name.c_str(), startsector, entry->startingPosition, entry->startingPosition);
+
+	if (entry->isDirectory && !relative) {
+		if (entry->startsector == root->startsector) {
+			ERROR_LOG(FILESYS, "WARNING: Appear to have a recursive file system, breaking recursion. Probably corrupt ISO.");
+		}
+	}
+	root->children.push_back(entry);
+	return entry;
+}
+
+ISOFileSystem::TreeEntry *ISOFileSystem::FindChild(TreeEntry *dir, const std::string &name) {
+	if (dir->children.size() < CHILD_INDEX_MIN_CHILDREN) {
+		for (TreeEntry *child : dir->children) {
+			if (child->name == name)
+				return child;
+		}
+		return nullptr;
+	}
+
+	if (dir->childIndex.empty()) {
+		dir->childIndex.reserve(dir->children.size());
+		// emplace keeps the first of any duplicate names, like the scan did.
+		for (TreeEntry *child : dir->children) {
+			dir->childIndex.emplace(child->name, child);
+		}
+	}
+
+	auto it = dir->childIndex.find(name);
+	return it == dir->childIndex.end() ? nullptr : it->second;
 }
 
 ISOFileSystem::TreeEntry *ISOFileSystem::GetFromPath(const std::string &path, bool catchError) {
@@ -290,29 +367,19 @@ ISOFileSystem::TreeEntry *ISOFileSystem::GetFromPath(const std::string &path, bo
 			ReadDirectory(entry);
 		}
 		TreeEntry *nextEntry = nullptr;
-		std::string name = "";
 		if (pathLength > pathIndex) {
 			size_t nextSlashIndex = path.find_first_of('/', pathIndex);
 			if (nextSlashIndex == std::string::npos)
 				nextSlashIndex = pathLength;
 
-			const std::string firstPathComponent = path.substr(pathIndex, nextSlashIndex - pathIndex);
-			for (size_t i = 0; i < entry->children.size(); i++) {
-				const std::string &n = entry->children[i]->name;
-				if (firstPathComponent == n) {
-					//yay we got it
-					nextEntry = entry->children[i];
-					name = n;
-					break;
-				}
-			}
+			nextEntry = FindChild(entry, path.substr(pathIndex, nextSlashIndex - pathIndex));
 		}
-		
+
 		if (nextEntry) {
 			entry = nextEntry;
 			if (!entry->valid)
 				ReadDirectory(entry);
-			pathIndex += name.length();
+			pathIndex += entry->name.length();
 			if (pathIndex < pathLength && path[pathIndex] == '/')
 				++pathIndex;
 
@@ -357,6 +424,8 @@ u32 ISOFileSystem::OpenFile(std::string filename, FileAccess access, const char
 		if (strncmp(devicename, "umd0:", 5)==0 || strncmp(devicename, "umd1:", 5)==0)
 			entry.isBlockSectorMode = true;
 
+		if (!entry.isBlockSectorMode)
+			TrackFileOpen(filename);
 		entries[newHandle] = entry;
 		return newHandle;
 	}
@@ -377,6 +446,9 @@ u32 ISOFileSystem::OpenFile(std::string filename, FileAccess access, const char
 
 	entry.seekPos = 0;
 
+	// Opening the whole device says nothing about what's read next.
+	if (!entry.isBlockSectorMode)
+		TrackFileOpen(filename);
 	u32 newHandle = hAlloc->GetNewHandle();
 	entries[newHandle] = entry;
 	return newHandle;
@@ -482,6 +554,7 @@ size_t ISOFileSystem::ReadFile(u32 handle, u8 *pointer, s64 size, int &usec) {
 		
 		if (e.isBlockSectorMode) {
 			// Whole sectors! Shortcut to this simple code.
+			TrackRead(e.seekPos, (u32)size);
 			blockDevice->ReadBlocks(e.seekPos, (int)size, pointer);
 			if (abs((int)lastReadBlock_ - (int)e.seekPos) > 100) {
 				// This is an estimate, sometimes it takes 1+ seconds, but it definitely takes time.
@@ -524,6 +597,10 @@ size_t ISOFileSystem::ReadFile(u32 handle, u8 *pointer, s64 size, int &usec) {
 		u32 secNum = (u32)(positionOnIso / 2048);
 		u8 theSector[2048];
 
+		if (size > 0) {
+			TrackRead(secNum, (u32)((positionOnIso + size + 2047) / 2048) - secNum);
+		}
+
 		_dbg_assert_msg_(FILESYS, (middleSize & 2047) == 0, "Remaining size should be aligned");
 
 		const u8 *const start = pointer;
@@ -687,6 +764,254 @@ std::string ISOFileSystem::EntryFullPath(TreeEntry *e) {
 	return path;
 }
 
+void ISOFileSystem::EnableReadAheadHistory() {
+	// Identify the disc by its volume descriptor, which has the title and creation dates.
+	u8 desc[2048];
+	if (!blockDevice->ReadBlock(16, desc)) {
+		return;
+	}
+
+	const u64 hash = XXH64(desc, sizeof(desc), 0);
+	readAheadHistoryPath_ = GetSysDirectory(DIRECTORY_CACHE) + StringFromFormat("/%016llx.ppra", (unsigned long long)hash);
+	LoadReadAheadHistory();
+}
+
+void ISOFileSystem::TrackFileOpen(const std::string &filename) {
+	if (readAheadHistoryPath_.empty()) {
+		return;
+	}
+
+	// Opened again before we saw enough, so start over from this open.
+	for (auto it = readAheadPending_.begin(); it != readAheadPending_.end(); ++it) {
+		if (it->filename == filename) {
+			FinishReadAhead(*it);
+			readAheadPending_.erase(it);
+			break;
+		}
+	}
+	if (readAheadPending_.size() >= READAHEAD_MAX_PENDING) {
+		FinishReadAhead(readAheadPending_.front());
+		readAheadPending_.pop_front();
+	}
+	readAheadPending_.push_back(PendingReadAhead{ filename, std::vector<ReadAheadRange>(), 0 });
+
+	auto history = readAheadHistory_.find(filename);
+	if (history != readAheadHistory_.end()) {
+		for (const ReadAheadRange &range : history->second) {
+			blockDevice->Prefetch(range.start, range.count);
+		}
+	}
+}
+
+void ISOFileSystem::TrackRead(u32 startSector, u32 sectors) {
+	if (sectors == 0) {
+		return;
+	}
+
+	for (auto it = readAheadPending_.begin(); it != readAheadPending_.end(); ) {
+		PendingReadAhead &pending = *it;
+		if (!pending.ranges.empty() && startSector >= pending.ranges.back().start && startSector <= pending.ranges.back().start + pending.ranges.back().count) {
+			// Continues (or overlaps) the last read, just extend it.
+			ReadAheadRange &last = pending.ranges.back();
+			const u32 lastEnd = last.start + last.count;
+			const u32 newEnd = std::max(lastEnd, startSector + sectors);
+			pending.sectors += newEnd - lastEnd;
+			last.count = newEnd - last.start;
+		} else {
+			pending.ranges.push_back(ReadAheadRange{ startSector, sectors });
+			pending.sectors += sectors;
+		}
+
+		if (pending.sectors >= READAHEAD_WINDOW_SECTORS || pending.ranges.size() >= READAHEAD_MAX_RANGES) {
+			FinishReadAhead(pending);
+			it = readAheadPending_.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
+void ISOFileSystem::FinishReadAhead(const PendingReadAhead &pending) {
+	// We only learn from the last run, so an open followed by nothing forgets the old reads.
+	auto history = readAheadHistory_.find(pending.filename);
+	if (pending.ranges.empty()) {
+		if (history != readAheadHistory_.end()) {
+			readAheadHistory_.erase(history);
+			readAheadHistoryDirty_ = true;
+		}
+	} else if (history != readAheadHistory_.end()) {
+		if (!(history->second == pending.ranges)) {
+			history->second = pending.ranges;
+			readAheadHistoryDirty_ = true;
+		}
+	} else if (readAheadHistory_.size() < READAHEAD_MAX_FILES) {
+		readAheadHistory_[pending.filename] = pending.ranges;
+		readAheadHistoryDirty_ = true;
+	}
+}
+
+void ISOFileSystem::LoadReadAheadHistory() {
+	FILE *f = File::OpenCFile(readAheadHistoryPath_, "rb");
+	if (!f) {
+		return;
+	}
+
+	u32 header[3];
+	if (fread(header, sizeof(u32), 3, f) != 3 || header[0] != READAHEAD_HISTORY_MAGIC || header[1] != READAHEAD_HISTORY_VERSION) {
+		WARN_LOG(FILESYS, "Ignoring invalid readahead history %s", readAheadHistoryPath_.c_str());
+		fclose(f);
+		return;
+	}
+
+	const u32 count = std::min(header[2], (u32)READAHEAD_MAX_FILES);
+	for (u32 i = 0; i < count; ++i) {
+		u32 sizes[2];
+		if (fread(sizes, sizeof(u32), 2, f) != 2 || sizes[0] > 1024 || sizes[1] > READAHEAD_MAX_RANGES) {
+			break;
+		}
+
+		std::string filename(sizes[0], '\0');
+		std::vector<ReadAheadRange> ranges(sizes[1]);
+		if (fread(&filename[0], 1, sizes[0], f) != sizes[0] || fread(ranges.data(), sizeof(ReadAheadRange), sizes[1], f) != sizes[1]) {
+			break;
+		}
+		readAheadHistory_[filename] = ranges;
+	}
+
+	fclose(f);
+	INFO_LOG(FILESYS, "Loaded readahead history for %d files", (int)readAheadHistory_.size());
+}
+
+void ISOFileSystem::SaveReadAheadHistory() {
+	const std::string dir = GetSysDirectory(DIRECTORY_CACHE);
+	if (!File::Exists(dir)) {
+		File::CreateFullPath(dir);
+	}
+
+	FILE *f = File::OpenCFile(readAheadHistoryPath_, "wb");
+	if (!f) {
+		WARN_LOG(FILESYS, "Unable to save readahead history %s", readAheadHistoryPath_.c_str());
+		return;
+	}
+
+	const u32 header[3] = { READAHEAD_HISTORY_MAGIC, READAHEAD_HISTORY_VERSION, (u32)readAheadHistory_.size() };
+	fwrite(header, sizeof(u32), 3, f);
+	for (const auto &history : readAheadHistory_) {
+		const u32 sizes[2] = { (u32)history.first.size(), (u32)history.second.size() };
+		fwrite(sizes, sizeof(u32), 2, f);
+		fwrite(history.first.data(), 1, sizes[0], f);
+		fwrite(history.second.data(), sizeof(ReadAheadRange), sizes[1], f);
+	}
+	fclose(f);
+	readAheadHistoryDirty_ = false;
+}
+
+void ISOFileSystem::EnableDirectoryCache() {
+	// The volume descriptor alone may not change when files are replaced, so mix in the path table,
+	// which has every directory's location.
+	VolDescriptor desc;
+	if (!blockDevice->ReadBlock(16, (u8 *)&desc)) {
+		return;
+	}
+
+	const u32 pathTableSize = std::min((u32)desc.pathTableLengthLE, (u32)(64 * 1024));
+	std::vector<u8> pathTable((pathTableSize + 2047) & ~2047);
+	const u32 pathTableBlocks = (u32)pathTable.size() / 2048;
+	if (pathTableBlocks != 0 && !blockDevice->ReadBlocks((u16)desc.firstLETableSectorLE, (int)pathTableBlocks, &pathTable[0])) {
+		return;
+	}
+
+	u64 hash = XXH64(&desc, sizeof(desc), 0);
+	hash = XXH64(pathTable.data(), pathTableSize, hash);
+	dirCachePath_ = GetSysDirectory(DIRECTORY_CACHE) + StringFromFormat("/%016llx_%08x.ppdt", (unsigned long long)hash, blockDevice->GetNumBlocks());
+	LoadDirectoryCache();
+}
+
+void ISOFileSystem::LoadDirectoryCache() {
+	FILE *f = File::OpenCFile(dirCachePath_, "rb");
+	if (!f) {
+		return;
+	}
+
+	u32 header[3];
+	if (fread(header, sizeof(u32), 3, f) != 3 || header[0] != DIRCACHE_MAGIC || header[1] != DIRCACHE_VERSION) {
+		WARN_LOG(FILESYS, "Ignoring invalid directory cache %s", dirCachePath_.c_str());
+		fclose(f);
+		return;
+	}
+
+	bool failed = false;
+	const u32 numBlocks = blockDevice->GetNumBlocks();
+	for (u32 i = 0; i < header[2] && !failed; ++i) {
+		u32 dirHeader[3];
+		if (fread(dirHeader, sizeof(u32), 3, f) != 3 || dirHeader[0] >= numBlocks) {
+			failed = true;
+			break;
+		}
+
+		CachedDirectory dir;
+		dir.dirsize = dirHeader[1];
+		dir.entries.resize(dirHeader[2]);
+		for (CachedDirEntry &e : dir.entries) {
+			u32 pos[2];
+			u8 flagsAndLength[2];
+			if (fread(pos, sizeof(u32), 2, f) != 2 || fread(flagsAndLength, 1, 2, f) != 2) {
+				failed = true;
+				break;
+			}
+			e.startsector = pos[0];
+			e.size = pos[1];
+			e.flags = flagsAndLength[0];
+			e.name.resize(flagsAndLength[1]);
+			if (flagsAndLength[1] != 0 && fread(&e.name[0], 1, flagsAndLength[1], f) != flagsAndLength[1]) {
+				failed = true;
+				break;
+			}
+		}
+		if (!failed) {
+			dirCache_[dirHeader[0]] = std::move(dir);
+		}
+	}
+	fclose(f);
+
+	if (failed) {
+		// Partial data is fine, but write it out properly next time.
+		WARN_LOG(FILESYS, "Directory cache %s was truncated", dirCachePath_.c_str());
+		dirCacheDirty_ = true;
+	}
+	INFO_LOG(FILESYS, "Loaded %d cached directories", (int)dirCache_.size());
+}
+
+void ISOFileSystem::SaveDirectoryCache() {
+	const std::string dir = GetSysDirectory(DIRECTORY_CACHE);
+	if (!File::Exists(dir)) {
+		File::CreateFullPath(dir);
+	}
+
+	FILE *f = File::OpenCFile(dirCachePath_, "wb");
+	if (!f) {
+		WARN_LOG(FILESYS, "Unable to save directory cache %s", dirCachePath_.c_str());
+		return;
+	}
+
+	const u32 header[3] = { DIRCACHE_MAGIC, DIRCACHE_VERSION, (u32)dirCache_.size() };
+	fwrite(header, sizeof(u32), 3, f);
+	for (const auto &cached : dirCache_) {
+		const u32 dirHeader[3] = { cached.first, cached.second.dirsize, (u32)cached.second.entries.size() };
+		fwrite(dirHeader, sizeof(u32), 3, f);
+		for (const CachedDirEntry &e : cached.second.entries) {
+			// ISO 9660 identifiers are at most 255 bytes, their length is a u8 on disc too.
+			const u32 pos[2] = { e.startsector, e.size };
+			const u8 flagsAndLength[2] = { e.flags, (u8)e.name.size() };
+			fwrite(pos, sizeof(u32), 2, f);
+			fwrite(flagsAndLength, 1, 2, f);
+			fwrite(e.name.data(), 1, flagsAndLength[1], f);
+		}
+	}
+	fclose(f);
+	dirCacheDirty_ = false;
+}
+
 ISOFileSystem::TreeEntry::~TreeEntry() {
 	for (size_t i = 0; i < children.size(); ++i)
 		delete children[i];
@@ -19,6 +19,7 @@
 
 #include <map>
 #include <list>
+#include <unordered_map>
 
 #include "FileSystem.h"
 
@@ -54,6 +55,13 @@ class ISOFileSystem : public IFileSystem {
 	int  RenameFile(const std::string &from, const std::string &to) override { return -1; }
 	bool RemoveFile(const std::string &filename) override { return false; }
 
+	// Keeps a per-disc history (in the cache directory) of the sectors read after each file open,
+	// and prefetches them from the block device when that file is opened again on a later run.
+	void EnableReadAheadHistory();
+	// Keeps the parsed directories of each disc in the cache directory, so later mounts
+	// don't have to read and parse them again.
+	void EnableDirectoryCache();
+
 private:
 	struct TreeEntry {
 		TreeEntry() : flags(0), valid(false) {}
@@ -72,6 +80,8 @@ class ISOFileSystem : public IFileSystem {
 
 		bool valid;
 		std::vector<TreeEntry *> children;
+		// Built on the first lookup, for directories with many children.
+		std::unordered_map<std::string, TreeEntry *> childIndex;
 	};
 
 	struct OpenFileEntry {
@@ -92,9 +102,56 @@ class ISOFileSystem : public IFileSystem {
 
 	TreeEntry entireISO;
 
+	struct ReadAheadRange {
+		u32 start;
+		u32 count;
+
+		bool operator ==(const ReadAheadRange &other) const {
+			return start == other.start && count == other.count;
+		}
+	};
+	// Reads after an open, until enough sectors have been seen.
+	struct PendingReadAhead {
+		std::string filename;
+		std::vector<ReadAheadRange> ranges;
+		u32 sectors;
+	};
+
+	std::string readAheadHistoryPath_;
+	std::map<std::string, std::vector<ReadAheadRange>> readAheadHistory_;
+	std::list<PendingReadAhead> readAheadPending_;
+	bool readAheadHistoryDirty_ = false;
+
+	// Children of a directory, as read from the disc.
+	struct CachedDirEntry {
+		std::string name;
+		u32 startsector;
+		u32 size;
+		u8 flags;
+	};
+	struct CachedDirectory {
+		u32 dirsize;
+		std::vector<CachedDirEntry> entries;
+	};
+
+	std::string dirCachePath_;
+	// By starting sector of the directory.
+	std::map<u32, CachedDirectory> dirCache_;
+	bool dirCacheDirty_ = false;
+
 	void ReadDirectory(TreeEntry *root);
+	TreeEntry *AddChild(TreeEntry *root, const std::string &name, u32 startsector, u32 size, u8 flags);
+	TreeEntry *FindChild(TreeEntry *dir, const std::string &name);
 	TreeEntry *GetFromPath(const std::string &path, bool catchError = true);
 	std::string EntryFullPath(TreeEntry *e);
+
+	void TrackFileOpen(const std::string &filename);
+	void TrackRead(u32 startSector, u32 sectors);
+	void FinishReadAhead(const PendingReadAhead &pending);
+	void LoadReadAheadHistory();
+	void SaveReadAheadHistory();
+	void LoadDirectoryCache();
+	void SaveDirectoryCache();
 };
 
 // On the "umd0:" device, any file you open is the entire ISO.
@@ -151,6 +208,7 @@ class ISOBlockSystem : public IFileSystem {
 	bool RmDir(const std::string &dirname) override { return false; }
 	int  RenameFile(const std::string &from, const std::string &to) override { return -1; }
 	bool RemoveFile(const std::string &filename) override { return false; }
+	IFileSystem *GetDevice() override { return isoFileSystem_; }
 
 private:
 	ISOFileSystem *isoFileSystem_;
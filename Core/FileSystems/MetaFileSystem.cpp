@@ -22,6 +22,7 @@
 #include "Common/StringUtils.h"
 #include "Core/FileSystems/MetaFileSystem.h"
 #include "Core/HLE/sceKernelThread.h"
+#include "Core/MemMap.h"
 #include "Core/Reporting.h"
 #include "Core/System.h"
 
@@ -176,6 +177,36 @@ IFileSystem *MetaFileSystem::GetHandleOwner(u32 handle)
 	return 0;
 }
 
+std::unique_lock<std::recursive_mutex> MetaFileSystem::LockDevice(IFileSystem *system)
+{
+	std::lock_guard<std::recursive_mutex> guard(lock);
+	return std::unique_lock<std::recursive_mutex>(deviceLocks[system->GetDevice()]);
+}
+
+IFileSystem *MetaFileSystem::LockHandleDevice(u32 handle, std::unique_lock<std::recursive_mutex> &deviceGuard)
+{
+	while (true) {
+		std::recursive_mutex *deviceLock;
+		{
+			std::lock_guard<std::recursive_mutex> guard(lock);
+			IFileSystem *sys = GetHandleOwner(handle);
+			if (!sys)
+				return nullptr;
+
+			deviceLock = &deviceLocks[sys->GetDevice()];
+			std::unique_lock<std::recursive_mutex> attempt(*deviceLock, std::try_to_lock);
+			if (attempt.owns_lock()) {
+				deviceGuard = std::move(attempt);
+				return sys;
+			}
+		}
+
+		// The device is busy (probably async IO.)  Wait for it without blocking other devices,
+		// then look again, since the handle may have been closed or the system remounted meanwhile.
+		std::lock_guard<std::recursive_mutex> wait(*deviceLock);
+	}
+}
+
 bool MetaFileSystem::MapFilePath(const std::string &_inpath, std::string &outpath, MountPoint **system)
 {
 	std::lock_guard<std::recursive_mutex> guard(lock);
@@ -281,6 +312,8 @@ void MetaFileSystem::Mount(std::string prefix, IFileSystem *system)
 void MetaFileSystem::Unmount(std::string prefix, IFileSystem *system)
 {
 	std::lock_guard<std::recursive_mutex> guard(lock);
+	// Wait for anything still using it.
+	auto deviceGuard = LockDevice(system);
 	MountPoint x;
 	x.prefix = prefix;
 	x.system = system;
@@ -288,6 +321,9 @@ void MetaFileSystem::Unmount(std::string prefix, IFileSystem *system)
 }
 
 void MetaFileSystem::Remount(IFileSystem *oldSystem, IFileSystem *newSystem) {
+	std::lock_guard<std::recursive_mutex> guard(lock);
+	// The old one is usually deleted right after, so wait for anything still using it.
+	auto deviceGuard = LockDevice(oldSystem);
 	for (auto it = fileSystems.begin(); it != fileSystems.end(); ++it) {
 		if (it->system == oldSystem) {
 			it->system = newSystem;
@@ -324,6 +360,7 @@ void MetaFileSystem::Shutdown()
 
 	for (auto iter = toDelete.begin(); iter != toDelete.end(); ++iter)
 	{
+		auto deviceGuard = LockDevice(*iter);
 		delete *iter;
 	}
 
@@ -348,6 +385,7 @@ u32 MetaFileSystem::OpenFile(std::string filename, FileAccess access, const char
 	MountPoint *mount;
 	if (MapFilePath(filename, of, &mount))
 	{
+		auto deviceGuard = LockDevice(mount->system);
 		s32 res = mount->system->OpenFile(of, access, mount->prefix.c_str());
 		if (res < 0)
 		{
@@ -369,6 +407,7 @@ PSPFileInfo MetaFileSystem::GetFileInfo(std::string filename)
 	IFileSystem *system;
 	if (MapFilePath(filename, of, &system))
 	{
+		auto deviceGuard = LockDevice(system);
 		return system->GetFileInfo(of);
 	}
 	else
@@ -384,6 +423,7 @@ bool MetaFileSystem::GetHostPath(const std::string &inpath, std::string &outpath
 	std::string of;
 	IFileSystem *system;
 	if (MapFilePath(inpath, of, &system)) {
+		auto deviceGuard = LockDevice(system);
 		return system->GetHostPath(of, outpath);
 	} else {
 		return false;
@@ -397,6 +437,7 @@ std::vector<PSPFileInfo> MetaFileSystem::GetDirListing(std::string path)
 	IFileSystem *system;
 	if (MapFilePath(path, of, &system))
 	{
+		auto deviceGuard = LockDevice(system);
 		return system->GetDirListing(of);
 	}
 	else
@@ -454,6 +495,7 @@ bool MetaFileSystem::MkDir(const std::string &dirname)
 	IFileSystem *system;
 	if (MapFilePath(dirname, of, &system))
 	{
+		auto deviceGuard = LockDevice(system);
 		return system->MkDir(of);
 	}
 	else
@@ -469,6 +511,7 @@ bool MetaFileSystem::RmDir(const std::string &dirname)
 	IFileSystem *system;
 	if (MapFilePath(dirname, of, &system))
 	{
+		auto deviceGuard = LockDevice(system);
 		return system->RmDir(of);
 	}
 	else
@@ -501,6 +544,7 @@ int MetaFileSystem::RenameFile(const std::string &from, const std::string &to)
 		if (osystem != rsystem)
 			return SCE_KERNEL_ERROR_XDEV;
 
+		auto deviceGuard = LockDevice(osystem);
 		return osystem->RenameFile(of, rf);
 	}
 	else
@@ -516,6 +560,7 @@ bool MetaFileSystem::RemoveFile(const std::string &filename)
 	IFileSystem *system;
 	if (MapFilePath(filename, of, &system))
 	{
+		auto deviceGuard = LockDevice(system);
 		return system->RemoveFile(of);
 	}
 	else
@@ -526,8 +571,8 @@ bool MetaFileSystem::RemoveFile(const std::string &filename)
 
 int MetaFileSystem::Ioctl(u32 handle, u32 cmd, u32 indataPtr, u32 inlen, u32 outdataPtr, u32 outlen, int &usec)
 {
-	std::lock_guard<std::recursive_mutex> guard(lock);
-	IFileSystem *sys = GetHandleOwner(handle);
+	std::unique_lock<std::recursive_mutex> deviceGuard;
+	IFileSystem *sys = LockHandleDevice(handle, deviceGuard);
 	if (sys)
 		return sys->Ioctl(handle, cmd, indataPtr, inlen, outdataPtr, outlen, usec);
 	return SCE_KERNEL_ERROR_ERROR;
@@ -535,8 +580,8 @@ int MetaFileSystem::Ioctl(u32 handle, u32 cmd, u32 indataPtr, u32 inlen, u32 out
 
 int MetaFileSystem::DevType(u32 handle)
 {
-	std::lock_guard<std::recursive_mutex> guard(lock);
-	IFileSystem *sys = GetHandleOwner(handle);
+	std::unique_lock<std::recursive_mutex> deviceGuard;
+	IFileSystem *sys = LockHandleDevice(handle, deviceGuard);
 	if (sys)
 		return sys->DevType(handle);
 	return SCE_KERNEL_ERROR_ERROR;
@@ -544,26 +589,29 @@ int MetaFileSystem::DevType(u32 handle)
 
 void MetaFileSystem::CloseFile(u32 handle)
 {
-	std::lock_guard<std::recursive_mutex> guard(lock);
-	IFileSystem *sys = GetHandleOwner(handle);
+	std::unique_lock<std::recursive_mutex> deviceGuard;
+	IFileSystem *sys = LockHandleDevice(handle, deviceGuard);
 	if (sys)
 		sys->CloseFile(handle);
 }
 
 size_t MetaFileSystem::ReadFile(u32 handle, u8 *pointer, s64 size)
 {
-	std::lock_guard<std::recursive_mutex> guard(lock);
-	IFileSystem *sys = GetHandleOwner(handle);
+	// This is often PSP memory, and host reads can't fault on rewind's write tracking.
+	Memory::PrepareHostWrite(pointer, (size_t)size);
+	std::unique_lock<std::recursive_mutex> deviceGuard;
+	IFileSystem *sys = LockHandleDevice(handle, deviceGuard);
+	size_t result = 0;
 	if (sys)
-		return sys->ReadFile(handle, pointer, size);
-	else
-		return 0;
+		result = sys->ReadFile(handle, pointer, size);
+	Memory::FinishHostWrite(pointer, (size_t)size);
+	return result;
 }
 
 size_t MetaFileSystem::WriteFile(u32 handle, const u8 *pointer, s64 size)
 {
-	std::lock_guard<std::recursive_mutex> guard(lock);
-	IFileSystem *sys = GetHandleOwner(handle);
+	std::unique_lock<std::recursive_mutex> deviceGuard;
+	IFileSystem *sys = LockHandleDevice(handle, deviceGuard);
 	if (sys)
 		return sys->WriteFile(handle, pointer, size);
 	else
@@ -572,18 +620,21 @@ size_t MetaFileSystem::WriteFile(u32 handle, const u8 *pointer, s64 size)
 
 size_t MetaFileSystem::ReadFile(u32 handle, u8 *pointer, s64 size, int &usec)
 {
-	std::lock_guard<std::recursive_mutex> guard(lock);
-	IFileSystem *sys = GetHandleOwner(handle);
+	// This is often PSP memory, and host reads can't fault on rewind's write tracking.
+	Memory::PrepareHostWrite(pointer, (size_t)size);
+	std::unique_lock<std::recursive_mutex> deviceGuard;
+	IFileSystem *sys = LockHandleDevice(handle, deviceGuard);
+	size_t result = 0;
 	if (sys)
-		return sys->ReadFile(handle, pointer, size, usec);
-	else
-		return 0;
+		result = sys->ReadFile(handle, pointer, size, usec);
+	Memory::FinishHostWrite(pointer, (size_t)size);
+	return result;
 }
 
 size_t MetaFileSystem::WriteFile(u32 handle, const u8 *pointer, s64 size, int &usec)
 {
-	std::lock_guard<std::recursive_mutex> guard(lock);
-	IFileSystem *sys = GetHandleOwner(handle);
+	std::unique_lock<std::recursive_mutex> deviceGuard;
+	IFileSystem *sys = LockHandleDevice(handle, deviceGuard);
 	if (sys)
 		return sys->WriteFile(handle, pointer, size, usec);
 	else
@@ -592,8 +643,8 @@ size_t MetaFileSystem::WriteFile(u32 handle, const u8 *pointer, s64 size, int &u
 
 size_t MetaFileSystem::SeekFile(u32 handle, s32 position, FileMove type)
 {
-	std::lock_guard<std::recursive_mutex> guard(lock);
-	IFileSystem *sys = GetHandleOwner(handle);
+	std::unique_lock<std::recursive_mutex> deviceGuard;
+	IFileSystem *sys = LockHandleDevice(handle, deviceGuard);
 	if (sys)
 		return sys->SeekFile(handle,position,type);
 	else
@@ -622,8 +673,10 @@ u64 MetaFileSystem::FreeSpace(const std::string &path)
 	std::lock_guard<std::recursive_mutex> guard(lock);
 	std::string of;
 	IFileSystem *system;
-	if (MapFilePath(path, of, &system))
+	if (MapFilePath(path, of, &system)) {
+		auto deviceGuard = LockDevice(system);
 		return system->FreeSpace(of);
+	}
 	else
 		return 0;
 }
@@ -657,6 +710,7 @@ void MetaFileSystem::DoState(PointerWrap &p)
 
 	for (u32 i = 0; i < n; ++i) {
 		if (!skipPfat0 || fileSystems[i].prefix != "pfat0:") {
+			auto deviceGuard = LockDevice(fileSystems[i].system);
 			fileSystems[i].system->DoState(p);
 		}
 	}
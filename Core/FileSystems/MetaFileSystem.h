@@ -17,6 +17,7 @@
 
 #pragma once
 
+#include <map>
 #include <string>
 #include <vector>
 #include <mutex>
@@ -43,6 +44,12 @@ class MetaFileSystem : public IHandleAllocator, public IFileSystem {
 	std::string startingDirectory;
 	int lastOpenError;
 	std::recursive_mutex lock;  // must be recursive
+	// Held while using a device, so async IO on one device doesn't wait on another.
+	// Always taken after lock, if both.  Entries are never removed.
+	std::map<IFileSystem *, std::recursive_mutex> deviceLocks;
+
+	std::unique_lock<std::recursive_mutex> LockDevice(IFileSystem *system);
+	IFileSystem *LockHandleDevice(u32 handle, std::unique_lock<std::recursive_mutex> &deviceGuard);
 
 public:
 	MetaFileSystem() {
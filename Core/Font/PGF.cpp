@@ -73,8 +73,11 @@ static std::vector<int> getTable(const u8 *buf, int bpe, size_t length) {
 	return vec;
 }
 
+// Rough cap on decoded glyphs kept per font.  A full Japanese font decodes to several MB.
+static const size_t MAX_DECODED_GLYPH_BYTES = 1024 * 1024;
+
 PGF::PGF()
-	: fontData(0) {
+	: fontData(0), decodedGlyphBytes(0) {
 
 }
 
@@ -139,6 +142,8 @@ void PGF::DoState(PointerWrap &p) {
 		if (fontData) {
 			delete [] fontData;
 		}
+		decodedGlyphs.clear();
+		decodedGlyphBytes = 0;
 		if (fontDataSize) {
 			fontData = new u8[fontDataSize];
 			p.DoArray(fontData, (int)fontDataSize);
@@ -270,7 +275,10 @@ bool PGF::ReadPtr(const u8 *ptr, size_t dataSize) {
 	u32 fontDataOffset = (u32)(uptr - startPtr);
 
 	fontDataSize = dataSize - fontDataOffset;
+	delete [] fontData;
 	fontData = new u8[fontDataSize];
+	decodedGlyphs.clear();
+	decodedGlyphBytes = 0;
 	memcpy(fontData, uptr, fontDataSize);
 
 	// charmap.resize();
@@ -552,6 +560,109 @@ bool PGF::GetCharGlyph(int charCode, int glyphType, Glyph &glyph) const {
 	return true;
 }
 
+const std::vector<u8> &PGF::DecodeGlyph(const Glyph &glyph) const {
+	int numberPixels = glyph.w * glyph.h;
+	auto it = decodedGlyphs.find(glyph.ptr);
+	if (it != decodedGlyphs.end() && (int)it->second.size() == numberPixels) {
+		return it->second;
+	}
+
+	if (decodedGlyphBytes + numberPixels > MAX_DECODED_GLYPH_BYTES) {
+		decodedGlyphs.clear();
+		decodedGlyphBytes = 0;
+	}
+
+	std::vector<u8> &decodedPixels = decodedGlyphs[glyph.ptr];
+	decodedGlyphBytes += numberPixels - decodedPixels.size();
+	decodedPixels.resize(numberPixels);
+
+	size_t bitPtr = glyph.ptr * 8;
+	int pixelIndex = 0;
+	while (pixelIndex < numberPixels && bitPtr + 8 < fontDataSize * 8) {
+		// This is some kind of nibble based RLE compression.
+		int nibble = consumeBits(4, fontData, bitPtr);
+
+		int count;
+		int value = 0;
+		if (nibble < 8) {
+			value = consumeBits(4, fontData, bitPtr);
+			count = nibble + 1;
+		} else {
+			count = 16 - nibble;
+		}
+
+		for (int i = 0; i < count && pixelIndex < numberPixels; i++) {
+			if (nibble >= 8) {
+				value = consumeBits(4, fontData, bitPtr);
+			}
+
+			decodedPixels[pixelIndex++] = value | (value << 4);
+		}
+	}
+	// Pixels past the end of the data stay at zero, as before.
+	std::fill(decodedPixels.begin() + pixelIndex, decodedPixels.end(), 0);
+
+	return decodedPixels;
+}
+
+static const u8 fontPixelSizeInBytes[] = { 0, 0, 1, 3, 4 }; // 0 means 2 pixels per byte
+
+// Writes one pixel to a glyph image at base, a host pointer.  The caller checks the memory is valid.
+static void WriteFontPixel(u8 *base, int bpl, int bufWidth, int bufHeight, int x, int y, u8 pixelColor, FontPixelFormat pixelformat) {
+	if (x < 0 || x >= bufWidth || y < 0 || y >= bufHeight) {
+		return;
+	}
+
+	int pixelBytes = fontPixelSizeInBytes[pixelformat];
+	int bufMaxWidth = (pixelBytes == 0 ? bpl * 2 : bpl / pixelBytes);
+	if (x >= bufMaxWidth) {
+		return;
+	}
+
+	u8 *framebuffer = base + (y * bpl) + (pixelBytes == 0 ? x / 2 : x * pixelBytes);
+
+	switch (pixelformat) {
+	case PSP_FONT_PIXELFORMAT_4:
+	case PSP_FONT_PIXELFORMAT_4_REV:
+		{
+			// We always get a 8-bit value, so take only the top 4 bits.
+			const u8 pix4 = pixelColor >> 4;
+
+			int oldColor = *framebuffer;
+			int newColor;
+			if ((x & 1) != pixelformat) {
+				newColor = (pix4 << 4) | (oldColor & 0xF);
+			} else {
+				newColor = (oldColor & 0xF0) | pix4;
+			}
+			*framebuffer = newColor;
+			break;
+		}
+	case PSP_FONT_PIXELFORMAT_8:
+		{
+			*framebuffer = pixelColor;
+			break;
+		}
+	case PSP_FONT_PIXELFORMAT_24:
+		{
+			// Each channel has the same value.
+			framebuffer[0] = pixelColor;
+			framebuffer[1] = pixelColor;
+			framebuffer[2] = pixelColor;
+			break;
+		}
+	case PSP_FONT_PIXELFORMAT_32:
+		{
+			// Spread the 8 bits out into one write of 32 bits.
+			u32 pix32 = pixelColor;
+			pix32 |= pix32 << 8;
+			pix32 |= pix32 << 16;
+			*(u32_le *)framebuffer = pix32;
+			break;
+		}
+	}
+}
+
 void PGF::DrawCharacter(const GlyphImage *image, int clipX, int clipY, int clipWidth, int clipHeight, int charCode, int altCharCode, int glyphType) const {
 	Glyph glyph;
 	if (!GetCharGlyph(charCode, glyphType, glyph)) {
@@ -577,10 +688,6 @@ void PGF::DrawCharacter(const GlyphImage *image, int clipX, int clipY, int clipW
 		return;
 	}
 
-	size_t bitPtr = glyph.ptr * 8;
-	int numberPixels = glyph.w * glyph.h;
-	int pixelIndex = 0;
-
 	int x = image->xPos64 >> 6;
 	int y = image->yPos64 >> 6;
 	u8 xFrac = image->xPos64 & 0x3F;
@@ -597,31 +704,7 @@ void PGF::DrawCharacter(const GlyphImage *image, int clipX, int clipY, int clipW
 		clipHeight = 8192;
 
 	// Use a buffer so we can apply subpixel rendering.
-	// TODO: Cache this buffer per glyph?  Maybe even transpose it first?
-	std::vector<u8> decodedPixels;
-	decodedPixels.resize(numberPixels);
-
-	while (pixelIndex < numberPixels && bitPtr + 8 < fontDataSize * 8) {
-		// This is some kind of nibble based RLE compression.
-		int nibble = consumeBits(4, fontData, bitPtr);
-
-		int count;
-		int value = 0;
-		if (nibble < 8) {
-			value = consumeBits(4, fontData, bitPtr);
-			count = nibble + 1;
-		} else {
-			count = 16 - nibble;
-		}
-
-		for (int i = 0; i < count && pixelIndex < numberPixels; i++) {
-			if (nibble >= 8) {
-				value = consumeBits(4, fontData, bitPtr);
-			}
-
-			decodedPixels[pixelIndex++] = value | (value << 4);
-		}
-	}
+	const std::vector<u8> &decodedPixels = DecodeGlyph(glyph);
 
 	auto samplePixel = [&](int xx, int yy) -> u8 {
 		if (xx < 0 || yy < 0 || xx >= glyph.w || yy >= glyph.h) {
@@ -644,11 +727,29 @@ void PGF::DrawCharacter(const GlyphImage *image, int clipX, int clipY, int clipW
 	int renderX2 = std::min(clipX + clipWidth - x, glyph.w + (xFrac > 0 ? 1 : 0));
 	int renderY2 = std::min(clipY + clipHeight - y, glyph.h + (yFrac > 0 ? 1 : 0));
 
+	// If all the rows we might touch are valid memory, skip the address checks per pixel.
+	u8 *bufferData = nullptr;
+	int firstRow = std::max(0, y + renderY1);
+	int lastRow = std::min((int)image->bufHeight, y + renderY2);
+	if (firstRow < lastRow) {
+		u32 rowsStart = image->bufferPtr + firstRow * image->bytesPerLine;
+		if (Memory::IsValidRange(rowsStart, (lastRow - firstRow) * image->bytesPerLine)) {
+			bufferData = Memory::GetPointerUnchecked(image->bufferPtr);
+		}
+	}
+	const FontPixelFormat pixelFormat = (FontPixelFormat)(u32)image->pixelFormat;
+
 	if (xFrac == 0 && yFrac == 0) {
 		for (int yy = renderY1; yy < renderY2; ++yy) {
+			if (bufferData) {
+				for (int xx = renderX1; xx < renderX2; ++xx) {
+					WriteFontPixel(bufferData, image->bytesPerLine, image->bufWidth, image->bufHeight, x + xx, y + yy, samplePixel(xx, yy), pixelFormat);
+				}
+				continue;
+			}
 			for (int xx = renderX1; xx < renderX2; ++xx) {
 				u8 pixelColor = samplePixel(xx, yy);
-				SetFontPixel(image->bufferPtr, image->bytesPerLine, image->bufWidth, image->bufHeight, x + xx, y + yy, pixelColor, (FontPixelFormat)(u32)image->pixelFormat);
+				SetFontPixel(image->bufferPtr, image->bytesPerLine, image->bufWidth, image->bufHeight, x + xx, y + yy, pixelColor, pixelFormat);
 			}
 		}
 	} else {
@@ -662,7 +763,11 @@ void PGF::DrawCharacter(const GlyphImage *image, int clipX, int clipY, int clipW
 
 				// We multiplied an 8 bit value by 64 twice, so now we have a 20 bit value.
 				u8 pixelColor = blended >> 12;
-				SetFontPixel(image->bufferPtr, image->bytesPerLine, image->bufWidth, image->bufHeight, x + xx, y + yy, pixelColor, (FontPixelFormat)(u32)image->pixelFormat);
+				if (bufferData) {
+					WriteFontPixel(bufferData, image->bytesPerLine, image->bufWidth, image->bufHeight, x + xx, y + yy, pixelColor, pixelFormat);
+				} else {
+					SetFontPixel(image->bufferPtr, image->bytesPerLine, image->bufWidth, image->bufHeight, x + xx, y + yy, pixelColor, pixelFormat);
+				}
 			}
 		}
 	}
@@ -675,53 +780,17 @@ void PGF::SetFontPixel(u32 base, int bpl, int bufWidth, int bufHeight, int x, in
 		return;
 	}
 
-	static const u8 fontPixelSizeInBytes[] = { 0, 0, 1, 3, 4 }; // 0 means 2 pixels per byte
 	int pixelBytes = fontPixelSizeInBytes[pixelformat];
 	int bufMaxWidth = (pixelBytes == 0 ? bpl * 2 : bpl / pixelBytes);
 	if (x >= bufMaxWidth) {
 		return;
 	}
 
-	int framebufferAddr = base + (y * bpl) + (pixelBytes == 0 ? x / 2 : x * pixelBytes);
-
-	switch (pixelformat) {
-	case PSP_FONT_PIXELFORMAT_4:
-	case PSP_FONT_PIXELFORMAT_4_REV:
-		{
-			// We always get a 8-bit value, so take only the top 4 bits.
-			const u8 pix4 = pixelColor >> 4;
-
-			int oldColor = Memory::Read_U8(framebufferAddr);
-			int newColor;
-			if ((x & 1) != pixelformat) {
-				newColor = (pix4 << 4) | (oldColor & 0xF);
-			} else {
-				newColor = (oldColor & 0xF0) | pix4;
-			}
-			Memory::Write_U8(newColor, framebufferAddr);
-			break;
-		}
-	case PSP_FONT_PIXELFORMAT_8:
-		{
-			Memory::Write_U8(pixelColor, framebufferAddr);
-			break;
-		}
-	case PSP_FONT_PIXELFORMAT_24:
-		{
-			// Each channel has the same value.
-			Memory::Write_U8(pixelColor, framebufferAddr + 0);
-			Memory::Write_U8(pixelColor, framebufferAddr + 1);
-			Memory::Write_U8(pixelColor, framebufferAddr + 2);
-			break;
-		}
-	case PSP_FONT_PIXELFORMAT_32:
-		{
-			// Spread the 8 bits out into one write of 32 bits.
-			u32 pix32 = pixelColor;
-			pix32 |= pix32 << 8;
-			pix32 |= pix32 << 16;
-			Memory::Write_U32(pix32, framebufferAddr);
-			break;
-		}
+	u32 framebufferAddr = base + (y * bpl) + (pixelBytes == 0 ? x / 2 : x * pixelBytes);
+	if (!Memory::IsValidRange(framebufferAddr, pixelBytes == 0 ? 1 : pixelBytes)) {
+		ERROR_LOG(SCEFONT, "Font pixel out of memory at %08x", framebufferAddr);
+		return;
 	}
+
+	WriteFontPixel(Memory::GetPointerUnchecked(base), bpl, bufWidth, bufHeight, x, y, pixelColor, pixelformat);
 }
@@ -20,6 +20,7 @@
 #pragma once
 
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "Common/Log.h"
@@ -281,6 +282,7 @@ class PGF {
 	// Unused
 	int GetCharIndex(int charCode, const std::vector<int> &charmapCompressed);
 
+	const std::vector<u8> &DecodeGlyph(const Glyph &glyph) const;
 	void SetFontPixel(u32 base, int bpl, int bufWidth, int bufHeight, int x, int y, u8 pixelColor, FontPixelFormat pixelformat) const;
 
 	PGFHeaderRev3Extra rev3extra;
@@ -306,4 +308,8 @@ class PGF {
 	std::vector<Glyph> glyphs;
 	std::vector<Glyph> shadowGlyphs;
 	int firstGlyph;
+
+	// Decoded 8-bit glyph bitmaps, by glyph.ptr.  Not saved, text tends to reuse the same glyphs.
+	mutable std::unordered_map<u32, std::vector<u8>> decodedGlyphs;
+	mutable size_t decodedGlyphBytes;
 };
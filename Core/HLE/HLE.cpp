@@ -15,6 +15,7 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#include <algorithm>
 #include <cstdarg>
 #include <map>
 #include <vector>
@@ -68,6 +69,16 @@ static const char *hleAfterSyscallReschedReason;
 static const HLEFunction *latestSyscall = nullptr;
 static int idleOp;
 
+struct HLESyscallStats {
+	u32 calls;
+	// Only counted while coreCollectDebugStats is on.
+	double seconds;
+	// Emulated cycles eaten by the call itself, also only with debug stats.
+	s64 cycles;
+};
+// Indexed the same as moduleDB and each funcTable.
+static std::vector<std::vector<HLESyscallStats>> syscallStats;
+
 void hleDelayResultFinish(u64 userdata, int cycleslate)
 {
 	u32 error;
@@ -110,12 +121,14 @@ void HLEShutdown()
 	hleAfterSyscall = HLE_AFTER_NOTHING;
 	latestSyscall = nullptr;
 	moduleDB.clear();
+	syscallStats.clear();
 }
 
 void RegisterModule(const char *name, int numFunctions, const HLEFunction *funcTable)
 {
 	HLEModule module = {name, numFunctions, funcTable};
 	moduleDB.push_back(module);
+	syscallStats.push_back(std::vector<HLESyscallStats>(numFunctions, HLESyscallStats{}));
 }
 
 int GetModuleIndex(const char *moduleName)
@@ -401,7 +414,7 @@ inline void hleFinishSyscall(const HLEFunction &info)
 	hleAfterSyscallReschedReason = 0;
 }
 
-static void updateSyscallStats(int modulenum, int funcnum, double total)
+static void updateSyscallStats(int modulenum, int funcnum, double total, int cycles)
 {
 	const char *name = moduleDB[modulenum].funcTable[funcnum].name;
 	// Ignore this one, especially for msInSyscalls (although that ignores CoreTiming events.)
@@ -414,6 +427,8 @@ static void updateSyscallStats(int modulenum, int funcnum, double total)
 		kernelStats.slowestSyscallName = name;
 	}
 	kernelStats.msInSyscalls += total;
+	syscallStats[modulenum][funcnum].seconds += total;
+	syscallStats[modulenum][funcnum].cycles += cycles;
 
 	KernelStatsSyscall statCall(modulenum, funcnum);
 	auto summedStat = kernelStats.summedMsInSyscalls.find(statCall);
@@ -511,6 +526,41 @@ void *GetQuickSyscallFunc(MIPSOpcode op) {
 	return (void *)&CallSyscallWithoutFlags;
 }
 
+u32 *GetSyscallCallCounter(MIPSOpcode op) {
+	if (!GetSyscallFuncPointer(op))
+		return nullptr;
+	u32 callno = (op >> 6) & 0xFFFFF; //20 bits
+	int funcnum = callno & 0xFFF;
+	int modulenum = (callno & 0xFF000) >> 12;
+	return &syscallStats[modulenum][funcnum].calls;
+}
+
+std::vector<HLESyscallStatsEntry> hleGetSyscallStats() {
+	std::vector<HLESyscallStatsEntry> entries;
+	for (size_t m = 0; m < syscallStats.size(); ++m) {
+		for (size_t f = 0; f < syscallStats[m].size(); ++f) {
+			const HLESyscallStats &stats = syscallStats[m][f];
+			if (stats.calls == 0)
+				continue;
+			const char *name = moduleDB[m].funcTable[f].name;
+			entries.push_back(HLESyscallStatsEntry{ moduleDB[m].name, name ? name : "?", stats.calls, stats.seconds, stats.cycles });
+		}
+	}
+	std::sort(entries.begin(), entries.end(), [](const HLESyscallStatsEntry &a, const HLESyscallStatsEntry &b) {
+		return a.calls > b.calls;
+	});
+	return entries;
+}
+
+void hleLogSyscallStats() {
+	std::vector<HLESyscallStatsEntry> entries = hleGetSyscallStats();
+	const size_t maxEntries = std::min(entries.size(), (size_t)30);
+	for (size_t i = 0; i < maxEntries; ++i) {
+		const HLESyscallStatsEntry &e = entries[i];
+		NOTICE_LOG(HLE, "%s::%s: %u calls, %0.3f ms", e.module, e.name, e.calls, e.seconds * 1000.0);
+	}
+}
+
 static double hleSteppingTime = 0.0;
 void hleSetSteppingTime(double t)
 {
@@ -521,9 +571,11 @@ void CallSyscall(MIPSOpcode op)
 {
 	PROFILE_THIS_SCOPE("syscall");
 	double start = 0.0;  // need to initialize to fix the race condition where coreCollectDebugStats is enabled in the middle of this func.
+	int startDowncount = 0;
 	if (coreCollectDebugStats) {
 		time_update();
 		start = time_now_d();
+		startDowncount = currentMIPS->downcount;
 	}
 
 	const HLEFunction *info = GetSyscallFuncPointer(op);
@@ -532,6 +584,11 @@ void CallSyscall(MIPSOpcode op)
 		return;
 	}
 
+	u32 callno = (op >> 6) & 0xFFFFF; //20 bits
+	int funcnum = callno & 0xFFF;
+	int modulenum = (callno & 0xFF000) >> 12;
+	syscallStats[modulenum][funcnum].calls++;
+
 	if (info->func) {
 		if (op == idleOp)
 			info->func();
@@ -547,12 +604,10 @@ void CallSyscall(MIPSOpcode op)
 
 	if (coreCollectDebugStats) {
 		time_update();
-		u32 callno = (op >> 6) & 0xFFFFF; //20 bits
-		int funcnum = callno & 0xFFF;
-		int modulenum = (callno & 0xFF000) >> 12;
 		double total = time_now_d() - start - hleSteppingTime;
 		hleSteppingTime = 0.0;
-		updateSyscallStats(modulenum, funcnum, total);
+		// If the syscall ran events, the downcount was reset and this will be off.  Best effort.
+		updateSyscallStats(modulenum, funcnum, total, std::max(0, startDowncount - currentMIPS->downcount));
 	}
 }
 
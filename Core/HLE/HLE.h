@@ -19,6 +19,7 @@
 
 #include <cstdarg>
 #include <type_traits>
+#include <vector>
 #include "Common/CommonTypes.h"
 #include "Common/Log.h"
 #include "Core/MIPS/MIPS.h"
@@ -147,6 +148,20 @@ void WriteFuncMissingStub(u32 stubAddr, u32 nid);
 const HLEFunction *GetSyscallFuncPointer(MIPSOpcode op);
 // For jit, takes arg: const HLEFunction *
 void *GetQuickSyscallFunc(MIPSOpcode op);
+// Call count for a syscall, which jits bump directly when they skip CallSyscall.  May be null.
+u32 *GetSyscallCallCounter(MIPSOpcode op);
+struct HLESyscallStatsEntry {
+	const char *module;
+	const char *name;
+	u32 calls;
+	// These are only counted while coreCollectDebugStats is on.
+	double seconds;
+	s64 cycles;
+};
+// Every syscall called so far, most called first.
+std::vector<HLESyscallStatsEntry> hleGetSyscallStats();
+// Logs the most called syscalls, with time spent if debug stats were being collected.
+void hleLogSyscallStats();
 
 void hleDoLogInternal(LogTypes::LOG_TYPE t, LogTypes::LOG_LEVELS level, u64 res, const char *file, int line, const char *reportTag, char retmask, const char *reason, const char *formatted_reason);
 
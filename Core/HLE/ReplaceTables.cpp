@@ -26,6 +26,7 @@
 #include "Core/Debugger/Breakpoints.h"
 #include "Core/Debugger/SymbolMap.h"
 #include "Core/MemMap.h"
+#include "Core/MemMapHelpers.h"
 #include "Core/MIPS/JitCommon/JitCommon.h"
 #include "Core/MIPS/MIPSCodeUtils.h"
 #include "Core/MIPS/MIPSAnalyst.h"
@@ -140,13 +141,7 @@ static int Replace_memcpy() {
 			// Already logged.
 		} else if (std::min(destPtr, srcPtr) + bytes > std::max(destPtr, srcPtr)) {
 			// Overlap.  Star Ocean breaks if it's not handled in 16 bytes blocks.
-			const u32 blocks = bytes & ~0x0f;
-			for (u32 offset = 0; offset < blocks; offset += 0x10) {
-				memcpy(dst + offset, src + offset, 0x10);
-			}
-			for (u32 offset = blocks; offset < bytes; ++offset) {
-				dst[offset] = src[offset];
-			}
+			Memory::CopyBlocks16(dst, src, bytes);
 		} else {
 			memmove(dst, src, bytes);
 		}
@@ -243,20 +238,7 @@ static int Replace_memcpy_swizzled() {
 	const u8 *srcp = Memory::GetPointer(srcPtr);
 
 	if (dstp && srcp) {
-		const u8 *ysrcp = srcp;
-		for (u32 y = 0; y < h; y += 8) {
-			const u8 *xsrcp = ysrcp;
-			for (u32 x = 0; x < pitch; x += 16) {
-				const u8 *src = xsrcp;
-				for (int n = 0; n < 8; ++n) {
-					memcpy(dstp, src, 16);
-					src += pitch;
-					dstp += 16;
-				}
-				xsrcp += 16;
-			}
-			ysrcp += 8 * pitch;
-		}
+		Memory::CopySwizzled(dstp, srcp, pitch, h);
 	}
 
 	RETURN(0);
@@ -402,6 +384,87 @@ static int Replace_strncmp() {
 	return 10 + bytes / 4;  // approximation
 }
 
+static int Replace_memcmp() {
+	u32 aPtr = PARAM(0);
+	u32 bPtr = PARAM(1);
+	u32 bytes = PARAM(2);
+	int result = 0;
+	if (bytes != 0 && Memory::IsValidRange(aPtr, bytes) && Memory::IsValidRange(bPtr, bytes)) {
+		const u8 *a = Memory::GetPointerUnchecked(aPtr);
+		const u8 *b = Memory::GetPointerUnchecked(bPtr);
+		// Match the usual libc result of the byte difference, not just the sign.
+		for (u32 i = 0; i < bytes; ++i) {
+			if (a[i] != b[i]) {
+				result = (int)a[i] - (int)b[i];
+				bytes = i + 1;
+				break;
+			}
+		}
+	}
+	RETURN(result);
+	return 10 + bytes * 3;  // approximation
+}
+
+// Returns the length of the string, capped to valid memory.  -1 if it runs off the end.
+static int SafeStringLength(u32 ptr) {
+	u32 maxLen = Memory::IsValidAddress(ptr) ? Memory::ValidSize(ptr, 0x7FFFFFFF) : 0;
+	const char *str = (const char *)Memory::GetPointer(ptr);
+	if (!str || maxLen == 0)
+		return -1;
+	const char *end = (const char *)memchr(str, 0, maxLen);
+	return end ? (int)(end - str) : -1;
+}
+
+static int Replace_strchr() {
+	u32 strPtr = PARAM(0);
+	char c = (char)PARAM(1);
+	int len = SafeStringLength(strPtr);
+	u32 result = 0;
+	if (len >= 0) {
+		const char *str = (const char *)Memory::GetPointerUnchecked(strPtr);
+		// Like libc, searching for 0 finds the terminator.
+		const char *found = (const char *)memchr(str, c, len + 1);
+		if (found)
+			result = strPtr + (u32)(found - str);
+	}
+	RETURN(result);
+	return 7 + std::max(len, 0) * 4;  // approximation
+}
+
+static int Replace_strrchr() {
+	u32 strPtr = PARAM(0);
+	char c = (char)PARAM(1);
+	int len = SafeStringLength(strPtr);
+	u32 result = 0;
+	if (len >= 0) {
+		const char *str = (const char *)Memory::GetPointerUnchecked(strPtr);
+		for (int i = len; i >= 0; --i) {
+			if (str[i] == c) {
+				result = strPtr + i;
+				break;
+			}
+		}
+	}
+	RETURN(result);
+	return 7 + std::max(len, 0) * 5;  // approximation
+}
+
+static int Replace_strcat() {
+	u32 destPtr = PARAM(0);
+	u32 srcPtr = PARAM(1);
+	int destLen = SafeStringLength(destPtr);
+	int srcLen = SafeStringLength(srcPtr);
+	if (destLen >= 0 && srcLen >= 0 && Memory::IsValidRange(destPtr, destLen + srcLen + 1)) {
+		memmove(Memory::GetPointerUnchecked(destPtr + destLen), Memory::GetPointerUnchecked(srcPtr), srcLen + 1);
+#ifndef MOBILE_DEVICE
+		CBreakPoints::ExecMemCheck(srcPtr, false, srcLen + 1, currentMIPS->pc);
+		CBreakPoints::ExecMemCheck(destPtr + destLen, true, srcLen + 1, currentMIPS->pc);
+#endif
+	}
+	RETURN(destPtr);
+	return 10 + (std::max(destLen, 0) + std::max(srcLen, 0)) * 4;  // approximation
+}
+
 static int Replace_fabsf() {
 	RETURNF(fabsf(PARAMF(0)));
 	return 4;
@@ -602,6 +665,72 @@ static int Replace_dl_write_matrix() {
 	return 60;
 }
 
+// Appends commands to a display list struct laid out like dl_write_matrix's (write pointer in word 2.)
+// Returns false without writing anything if the list isn't valid memory.
+static bool WriteDLCommands(u32 dlStructPtr, const u32 *cmds, int count) {
+	if (!Memory::IsValidRange(dlStructPtr, 3 * sizeof(u32)))
+		return false;
+	u32_le *dlStruct = (u32_le *)Memory::GetPointerUnchecked(dlStructPtr);
+	const u32 destPtr = dlStruct[2];
+	if (!Memory::IsValidRange(destPtr, count * sizeof(u32)))
+		return false;
+
+	memcpy(Memory::GetPointerUnchecked(destPtr), cmds, count * sizeof(u32));
+#ifndef MOBILE_DEVICE
+	CBreakPoints::ExecMemCheck(dlStructPtr + 2 * sizeof(u32), true, sizeof(u32), currentMIPS->pc);
+	CBreakPoints::ExecMemCheck(destPtr, true, count * sizeof(u32), currentMIPS->pc);
+#endif
+	dlStruct[2] = destPtr + count * sizeof(u32);
+	return true;
+}
+
+// a0 = dl struct, a1 = prim, a2 = vertex type, a3 = count, t0 = indices, t1 = vertices
+// Same commands as sceGuDrawArray, in one go.
+static int Replace_dl_draw_array() {
+	const u32 prim = PARAM(1);
+	const u32 vtype = PARAM(2);
+	const u32 count = PARAM(3);
+	const u32 indices = PARAM(4);
+	const u32 vertices = PARAM(5);
+
+	u32 cmds[6];
+	int n = 0;
+	if (vtype != 0)
+		cmds[n++] = (GE_CMD_VERTEXTYPE << 24) | (vtype & 0x00FFFFFF);
+	if (indices != 0) {
+		cmds[n++] = (GE_CMD_BASE << 24) | ((indices >> 8) & 0x000F0000);
+		cmds[n++] = (GE_CMD_IADDR << 24) | (indices & 0x00FFFFFF);
+	}
+	if (vertices != 0) {
+		cmds[n++] = (GE_CMD_BASE << 24) | ((vertices >> 8) & 0x000F0000);
+		cmds[n++] = (GE_CMD_VADDR << 24) | (vertices & 0x00FFFFFF);
+	}
+	cmds[n++] = (GE_CMD_PRIM << 24) | ((prim & 7) << 16) | (count & 0xFFFF);
+
+	WriteDLCommands(PARAM(0), cmds, n);
+	RETURN(0);
+	return 20 + n * 6;
+}
+
+// a0 = dl struct, a1 = command, a2 = argument.  The common sendCommandi helper, used by most state setters.
+static int Replace_dl_send_command() {
+	const u32 cmd = ((PARAM(1) & 0xFF) << 24) | (PARAM(2) & 0x00FFFFFF);
+	WriteDLCommands(PARAM(0), &cmd, 1);
+	RETURN(0);
+	return 10;
+}
+
+// a0 = dl struct, a1 = command, f12 = argument.  Like sendCommandf, the float is sent as its top 24 bits.
+static int Replace_dl_send_command_float() {
+	float f = PARAMF(0);
+	u32 bits;
+	memcpy(&bits, &f, sizeof(bits));
+	const u32 cmd = ((PARAM(1) & 0xFF) << 24) | (bits >> 8);
+	WriteDLCommands(PARAM(0), &cmd, 1);
+	RETURN(0);
+	return 12;
+}
+
 static bool GetMIPSStaticAddress(u32 &addr, s32 lui_offset, s32 lw_offset) {
 	const MIPSOpcode upper = Memory::Read_Instruction(currentMIPS->pc + lui_offset, true);
 	if (upper != MIPS_MAKE_LUI(MIPS_GET_RT(upper), upper & 0xffff)) {
@@ -1267,10 +1396,18 @@ static const ReplacementTableEntry entries[] = {
 	{ "strncpy", &Replace_strncpy, 0, REPFLAG_DISABLED },
 	{ "strcmp", &Replace_strcmp, 0, REPFLAG_DISABLED },
 	{ "strncmp", &Replace_strncmp, 0, REPFLAG_DISABLED },
+	// These check their ranges, so they're safe to leave enabled.  Add hashes to knownfuncs.ini to use them.
+	{ "memcmp", &Replace_memcmp, 0, 0 },
+	{ "strchr", &Replace_strchr, 0, 0 },
+	{ "strrchr", &Replace_strrchr, 0, 0 },
+	{ "strcat", &Replace_strcat, 0, 0 },
 	{ "fabsf", &Replace_fabsf, JITFUNC(Replace_fabsf), REPFLAG_ALLOWINLINE | REPFLAG_DISABLED },
 	{ "dl_write_matrix", &Replace_dl_write_matrix, 0, REPFLAG_DISABLED }, // &MIPSComp::Jit::Replace_dl_write_matrix, REPFLAG_DISABLED },
 	{ "dl_write_matrix_2", &Replace_dl_write_matrix, 0, REPFLAG_DISABLED },
 	{ "gta_dl_write_matrix", &Replace_gta_dl_write_matrix, 0, REPFLAG_DISABLED },
+	{ "dl_draw_array", &Replace_dl_draw_array, 0, 0 },
+	{ "dl_send_command", &Replace_dl_send_command, 0, 0 },
+	{ "dl_send_command_float", &Replace_dl_send_command_float, 0, 0 },
 	// dl_write_matrix_3 doesn't take the dl as a parameter, it accesses a global instead. Need to extract the address of the global from the code when replacing...
 	// Haven't investigated write_matrix_4 and 5 but I think they are similar to 1 and 2.
 
@@ -1350,6 +1487,7 @@ static const ReplacementTableEntry entries[] = {
 
 static std::map<u32, u32> replacedInstructions;
 static std::unordered_map<std::string, std::vector<int> > replacementNameLookup;
+static u32 replacementHits[ARRAY_SIZE(entries)];
 
 void Replacement_Init() {
 	for (int i = 0; i < (int)ARRAY_SIZE(entries); i++) {
@@ -1360,6 +1498,7 @@ void Replacement_Init() {
 	}
 
 	skipGPUReplacements = 0;
+	memset(replacementHits, 0, sizeof(replacementHits));
 }
 
 void Replacement_Shutdown() {
@@ -1389,6 +1528,10 @@ const ReplacementTableEntry *GetReplacementFunc(int i) {
 	return &entries[i];
 }
 
+u32 *GetReplacementHitCounter(int i) {
+	return &replacementHits[i];
+}
+
 static bool WriteReplaceInstruction(u32 address, int index) {
 	u32 prevInstr = Memory::Read_Instruction(address, false).encoding;
 	if (MIPS_IS_REPLACEMENT(prevInstr)) {
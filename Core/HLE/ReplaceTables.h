@@ -65,6 +65,8 @@ void Replacement_Shutdown();
 int GetNumReplacementFuncs();
 std::vector<int> GetReplacementFuncIndexes(u64 hash, int funcSize);
 const ReplacementTableEntry *GetReplacementFunc(int index);
+// Incremented each time the replacement runs (not counted for inlined jit replacements.)
+u32 *GetReplacementHitCounter(int index);
 
 void WriteReplaceInstructions(u32 address, u64 hash, int size);
 void RestoreReplacedInstruction(u32 address);
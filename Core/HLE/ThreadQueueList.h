@@ -17,7 +17,9 @@
 
 #pragma once
 
+#include <cstring>
 #include "Core/HLE/sceKernel.h"
+#include "Common/BitSet.h"
 #include "Common/ChunkFile.h"
 
 struct ThreadQueueList {
@@ -25,6 +27,8 @@ struct ThreadQueueList {
 	static const int NUM_QUEUES = 128;
 	// Initial number of threads a single queue can handle.
 	static const int INITIAL_CAPACITY = 32;
+	// Words in the bitmap of non-empty priority levels.
+	static const int NUM_MASK_WORDS = NUM_QUEUES / 32;
 
 	struct Queue {
 		// Next ever-been-used queue (worse priority.)
@@ -51,6 +55,7 @@ struct ThreadQueueList {
 
 	ThreadQueueList() {
 		memset(queues, 0, sizeof(queues));
+		memset(nonEmpty, 0, sizeof(nonEmpty));
 		first = invalid();
 	}
 
@@ -75,37 +80,27 @@ struct ThreadQueueList {
 	}
 
 	inline SceUID pop_first() {
-		Queue *cur = first;
-		while (cur != invalid()) {
-			if (cur->size() > 0)
-				return cur->data[cur->first++];
-			cur = cur->next;
-		}
+		int priority = first_priority();
+		if (priority >= 0)
+			return pop_at(priority);
 
 		_dbg_assert_msg_(SCEKERNEL, false, "ThreadQueueList should not be empty.");
 		return 0;
 	}
 
 	inline SceUID pop_first_better(u32 priority) {
-		Queue *cur = first;
 		// Don't bother looking past (worse than) this priority.
-		Queue *stop = &queues[priority];
-		while (cur < stop) {
-			if (cur->size() > 0)
-				return cur->data[cur->first++];
-			cur = cur->next;
-		}
+		int best = first_priority();
+		if (best >= 0 && best < (int)priority)
+			return pop_at(best);
 
 		return 0;
 	}
 
 	inline SceUID peek_first() {
-		Queue *cur = first;
-		while (cur != invalid()) {
-			if (cur->size() > 0)
-				return cur->data[cur->first];
-			cur = cur->next;
-		}
+		int priority = first_priority();
+		if (priority >= 0)
+			return queues[priority].data[queues[priority].first];
 
 		return 0;
 	}
@@ -113,6 +108,7 @@ struct ThreadQueueList {
 	inline void push_front(u32 priority, const SceUID threadID) {
 		Queue *cur = &queues[priority];
 		cur->data[--cur->first] = threadID;
+		mark_non_empty(priority);
 		// If we ran out of room toward the front, add more room for next time.
 		if (cur->first == 0)
 			rebalance(priority);
@@ -121,6 +117,7 @@ struct ThreadQueueList {
 	inline void push_back(u32 priority, const SceUID threadID) {
 		Queue *cur = &queues[priority];
 		cur->data[cur->end++] = threadID;
+		mark_non_empty(priority);
 		if (cur->full())
 			rebalance(priority);
 	}
@@ -139,6 +136,8 @@ struct ThreadQueueList {
 
 				// Now we're one shorter.
 				--cur->end;
+				if (cur->empty())
+					mark_empty(priority);
 				return;
 			}
 		}
@@ -164,6 +163,7 @@ struct ThreadQueueList {
 				free(queues[i].data);
 		}
 		memset(queues, 0, sizeof(queues));
+		memset(nonEmpty, 0, sizeof(nonEmpty));
 		first = invalid();
 	}
 
@@ -212,6 +212,8 @@ struct ThreadQueueList {
 
 			if (size != 0)
 				p.DoArray(&cur->data[cur->first], size);
+			if (p.mode == p.MODE_READ && size != 0)
+				mark_non_empty(i);
 		}
 	}
 
@@ -220,6 +222,31 @@ struct ThreadQueueList {
 		return (Queue *)-1;
 	}
 
+	// Best (lowest) priority level with any threads in it, or -1 if there are none.
+	inline int first_priority() const {
+		for (int i = 0; i < NUM_MASK_WORDS; ++i) {
+			if (nonEmpty[i] != 0)
+				return i * 32 + LeastSignificantSetBit(nonEmpty[i]);
+		}
+		return -1;
+	}
+
+	inline SceUID pop_at(int priority) {
+		Queue *cur = &queues[priority];
+		SceUID threadID = cur->data[cur->first++];
+		if (cur->empty())
+			mark_empty(priority);
+		return threadID;
+	}
+
+	inline void mark_non_empty(u32 priority) {
+		nonEmpty[priority >> 5] |= 1U << (priority & 31);
+	}
+
+	inline void mark_empty(u32 priority) {
+		nonEmpty[priority >> 5] &= ~(1U << (priority & 31));
+	}
+
 	// Initialize a priority level and link to other queues.
 	void link(u32 priority, int size) {
 		_dbg_assert_msg_(SCEKERNEL, queues[priority].data == nullptr, "ThreadQueueList::Queue should only be initialized once.");
@@ -286,4 +313,6 @@ struct ThreadQueueList {
 	Queue *first;
 	// The priority level queues of thread ids.
 	Queue queues[NUM_QUEUES];
+	// One bit per priority level that has threads queued, so finding the best is quick.
+	u32 nonEmpty[NUM_MASK_WORDS];
 };
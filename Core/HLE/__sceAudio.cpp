@@ -18,6 +18,7 @@
 #include <atomic>
 #include <mutex>
 
+#include "profiler/profiler.h"
 #include "Common/CommonTypes.h"
 #include "Common/ChunkFile.h"
 #include "Common/FixedSizeQueue.h"
@@ -381,7 +382,8 @@ void __AudioUpdate(bool resetRecording) {
 		memset(mixBuffer, 0, hwBlockSize * 2 * sizeof(s32));
 	}
 
-	if (g_Config.bEnableSound) {
+	// Run-ahead frames are rolled back, the real frame already played this audio.
+	if (g_Config.bEnableSound && !PSP_CoreParameter().runningAhead) {
 		resampler.PushSamples(mixBuffer, hwBlockSize);
 #ifndef MOBILE_DEVICE
 		if (g_Config.bSaveLoadResetsAVdumping && resetRecording) {
@@ -423,6 +425,7 @@ void __AudioUpdate(bool resetRecording) {
 // numFrames is number of stereo frames.
 // This is called from *outside* the emulator thread.
 int __AudioMix(short *outstereo, int numFrames, int sampleRate) {
+	PROFILE_THIS_SCOPE("audiomix");
 	return resampler.Mix(outstereo, numFrames, false, sampleRate);
 }
 
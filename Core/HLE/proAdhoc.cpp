@@ -21,6 +21,7 @@
 // This is a direct port of Coldbird's code from http://code.google.com/p/aemu/
 // All credit goes to him!
 
+#include <algorithm>
 #include <cstring>
 #include "util/text/parsers.h"
 #include "Core/Core.h"
@@ -183,6 +184,22 @@ void changeBlockingMode(int fd, int nonblocking) {
 #endif
 }
 
+int waitForSocket(int fd, bool forWrite, int timeoutUs) {
+	fd_set fds;
+	FD_ZERO(&fds);
+	FD_SET(fd, &fds);
+	timeval tmout;
+	tmout.tv_sec = timeoutUs / 1000000;
+	tmout.tv_usec = timeoutUs % 1000000;
+	// nfds is ignored on Windows
+	int result = select(fd + 1, forWrite ? NULL : &fds, forWrite ? &fds : NULL, NULL, &tmout);
+	if (result < 0) {
+		// Don't let callers spin on a broken socket
+		sleep_ms(1);
+	}
+	return result;
+}
+
 int countAvailableNetworks(void) {
 	// Network Count
 	int count = 0;
@@ -1031,8 +1048,12 @@ int friendFinder(){
 		//  sceNetInetSend(metasocket, (const char *)&chat, sizeof(chat), 0);
 		//}
 
-		// Wait for Incoming Data
+		// Wait for Incoming Data, but not past the next ping. Leftover data in the RX Buffer may be a whole packet, so only wait briefly then
+		int waitUs = rxpos > 0 ? 1000 : 10000;
+		waitForSocket(metasocket, false, std::min<int>(waitUs, std::max<int>(0, (int)(lastping + PSP_ADHOCCTL_PING_TIMEOUT - now))));
 		int received = recv(metasocket, (char *)(rx + rxpos), sizeof(rx) - rxpos, 0);
+		// A socket closed by the server stays readable, don't spin on it
+		if (received == 0) sleep_ms(1);
 
 		// Free Network Lock
 		//_freeNetworkLock();
@@ -1242,8 +1263,6 @@ int friendFinder(){
 				rxpos -= 1;
 			}
 		}
-		// Original value was 10 ms, I think 100 is just fine
-		sleep_ms(1); // Using 1ms for faster response just like AdhocServer
 
 		// Don't do anything if it's paused, otherwise the log will be flooded
 		while (Core_IsStepping() && friendFinderRunning) sleep_ms(1);
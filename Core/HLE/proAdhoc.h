@@ -859,6 +859,15 @@ SceNetAdhocctlPeerInfo * findFriend(SceNetEtherAddr * MAC);
  */
 void changeBlockingMode(int fd, int nonblocking);
 
+/**
+ * Waits for a socket to become readable (or writable), so polling loops wake up as soon as data arrives
+ * @param fd File Descriptor of the socket
+ * @param forWrite true to wait for the socket to become writable instead
+ * @param timeoutUs Maximum time to wait in microseconds
+ * @return Positive if the socket is ready, 0 on timeout, negative on error
+ */
+int waitForSocket(int fd, bool forWrite, int timeoutUs);
+
 /**
  * Count Virtual Networks by analyzing the Friend List
  * @return Number of Virtual Networks
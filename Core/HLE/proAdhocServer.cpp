@@ -25,6 +25,8 @@
 #include <stdio.h>
 #include <string.h>
 #include <signal.h>
+#include <algorithm>
+#include <unordered_map>
 
 #if !defined(__APPLE__)
 #include <stdlib.h>
@@ -42,6 +44,7 @@
 #include <fcntl.h>
 #include <errno.h>
 //#include <sqlite3.h>
+#include "base/timeutil.h"
 #include "Common/FileUtil.h"
 #include "Core/Core.h"
 #include "Core/HLE/proAdhocServer.h"
@@ -53,6 +56,23 @@ uint32_t _db_user_count = 0;
 // User Database
 SceNetAdhocctlUserNode * _db_user = NULL;
 
+// User Database indexed by IP (Network Order), so Logins don't have to walk the whole list
+static std::unordered_map<uint32_t, SceNetAdhocctlUserNode *> _db_user_by_ip;
+
+// Status Logfile needs rewriting
+static bool _status_dirty = false;
+
+// Server Statistics, logged every SERVER_STATS_INTERVAL seconds
+#define SERVER_STATS_INTERVAL 60
+static struct {
+	uint32_t connections;
+	uint32_t recvs;
+	uint64_t bytes;
+	uint32_t wakeups;
+	double busytime;
+	double maxbusytime;
+} _stats;
+
 // Game Database
 SceNetAdhocctlGameNode * _db_game = NULL;
 
@@ -493,8 +513,8 @@ void login_user_stream(int fd, uint32_t ip)
 	if(_db_user_count < SERVER_USER_MAXIMUM)
 	{
 		// Check IP Duplication
-		SceNetAdhocctlUserNode * u = _db_user;
-		while(u != NULL && u->resolver.ip != ip) u = u->next;
+		auto existing = _db_user_by_ip.find(ip);
+		SceNetAdhocctlUserNode * u = existing != _db_user_by_ip.end() ? existing->second : NULL;
 
 		if (u != NULL) { // IP Already existed
 			uint8_t * ip4 = (uint8_t *)&u->resolver.ip;
@@ -523,6 +543,7 @@ void login_user_stream(int fd, uint32_t ip)
 				user->next = _db_user;
 				if(_db_user != NULL) _db_user->prev = user;
 				_db_user = user;
+				_db_user_by_ip[ip] = user;
 
 				// Initialize Death Clock
 				user->last_recv = time(NULL);
@@ -535,7 +556,7 @@ void login_user_stream(int fd, uint32_t ip)
 				_db_user_count++;
 
 				// Update Status Log
-				update_status();
+				request_status_update();
 
 				// Exit Function
 				return;
@@ -619,7 +640,7 @@ void login_user_data(SceNetAdhocctlUserNode * user, SceNetAdhocctlLoginPacketC2S
 			INFO_LOG(SCENET, "AdhocServer: %s (MAC: %02X:%02X:%02X:%02X:%02X:%02X - IP: %u.%u.%u.%u) started playing %s", (char *)user->resolver.name.data, user->resolver.mac.data[0], user->resolver.mac.data[1], user->resolver.mac.data[2], user->resolver.mac.data[3], user->resolver.mac.data[4], user->resolver.mac.data[5], ip[0], ip[1], ip[2], ip[3], safegamestr);
 
 			// Update Status Log
-			update_status();
+			request_status_update();
 
 			// Leave Function
 			return;
@@ -656,6 +677,9 @@ void logout_user(SceNetAdhocctlUserNode * user)
 	// Unlink Rightside
 	if(user->next != NULL) user->next->prev = user->prev;
 
+	// Remove from IP Index
+	_db_user_by_ip.erase(user->resolver.ip);
+
 	// Close Stream
 	closesocket(user->stream);
 
@@ -704,7 +728,7 @@ void logout_user(SceNetAdhocctlUserNode * user)
 	_db_user_count--;
 
 	// Update Status Log
-	update_status();
+	request_status_update();
 }
 
 /**
@@ -886,7 +910,7 @@ void connect_user(SceNetAdhocctlUserNode * user, SceNetAdhocctlGroupName * group
 				INFO_LOG(SCENET, "AdhocServer: %s (MAC: %02X:%02X:%02X:%02X:%02X:%02X - IP: %u.%u.%u.%u) joined %s group %s", (char *)user->resolver.name.data, user->resolver.mac.data[0], user->resolver.mac.data[1], user->resolver.mac.data[2], user->resolver.mac.data[3], user->resolver.mac.data[4], user->resolver.mac.data[5], ip[0], ip[1], ip[2], ip[3], safegamestr, safegroupstr);
 
 				// Update Status Log
-				update_status();
+				request_status_update();
 
 				// Exit Function
 				return;
@@ -1009,7 +1033,7 @@ void disconnect_user(SceNetAdhocctlUserNode * user)
 		user->group_prev = NULL;
 
 		// Update Status Log
-		update_status();
+		request_status_update();
 
 		// Exit Function
 		return;
@@ -1553,6 +1577,28 @@ void update_status(void)
  * @param size Size of Out Buffer
  * @return Reference to Out Buffer
  */
+void request_status_update(void)
+{
+	_status_dirty = true;
+}
+
+/**
+ * Log Server Statistics and reset the Counters
+ * @param elapsed Seconds since the last Report
+ */
+static void report_stats(double elapsed)
+{
+	// Count Games
+	uint32_t gamecount = 0;
+	for (SceNetAdhocctlGameNode * game = _db_game; game != NULL; game = game->next) gamecount++;
+
+	INFO_LOG(SCENET, "AdhocServer: %u users in %u games, %u new connections, %.1f recv/s (%.1f KB/s), %.1f wakeups/s, handling took %.3f ms avg / %.3f ms max",
+		_db_user_count, gamecount, _stats.connections, _stats.recvs / elapsed, _stats.bytes / 1024.0 / elapsed, _stats.wakeups / elapsed,
+		_stats.wakeups > 0 ? _stats.busytime * 1000.0 / _stats.wakeups : 0.0, _stats.maxbusytime * 1000.0);
+
+	memset(&_stats, 0, sizeof(_stats));
+}
+
 const char * strcpyxml(char * out, const char * in, uint32_t size)
 {
 	// Valid Arguments
@@ -1826,10 +1872,45 @@ int server_loop(int server)
 
 	// Create Empty Status Logfile
 	update_status();
+	double laststatus = real_time_now();
+	double laststats = laststatus;
+	memset(&_stats, 0, sizeof(_stats));
 
 	// Handling Loop
 	while (adhocServerRunning) //(_status == 1)
 	{
+		// Wait for Activity on the Server or any User Socket instead of polling everyone every millisecond.
+		// Users that don't fit into the fd_set (FD_SETSIZE is small on Windows) fall back to being polled.
+		fd_set readfds;
+		FD_ZERO(&readfds);
+		FD_SET(server, &readfds);
+		int maxfd = server;
+		bool pollall = _db_user_count + 1 > FD_SETSIZE;
+		bool leftovers = false;
+		for (SceNetAdhocctlUserNode * u = _db_user; u != NULL; u = u->next)
+		{
+			if (u->rxpos > 0) leftovers = true;
+			if (!pollall)
+			{
+				FD_SET(u->stream, &readfds);
+				maxfd = std::max(maxfd, u->stream);
+			}
+		}
+
+		// Leftovers in RX-Buffers (possibly partial Packets) keep the old 1ms Pace, Timeouts only need a coarse Wakeup
+		timeval tmout;
+		tmout.tv_sec = 0;
+		tmout.tv_usec = (leftovers || pollall) ? 1000 : 100000;
+		int activity = select(maxfd + 1, &readfds, NULL, NULL, &tmout);
+		if (activity < 0)
+		{
+			// Broken Socket somewhere, handle everyone like before
+			pollall = true;
+			sleep_ms(1);
+		}
+
+		double wakeup = real_time_now();
+
 		// Login Block
 		{
 			// Login Result
@@ -1866,6 +1947,7 @@ int server_loop(int server)
 						WARN_LOG(SCENET, "AdhocServer: Replacing IP %s with %u.%u.%u.%u", inet_ntoa(addr.sin_addr), pip[0], pip[1], pip[2], pip[3]);
 					}
 					login_user_stream(loginresult, sip);
+					_stats.connections++;
 				}
 			} while(loginresult != -1);
 		}
@@ -1877,11 +1959,22 @@ int server_loop(int server)
 			// Next User (for safe delete)
 			SceNetAdhocctlUserNode * next = user->next;
 
-			// Receive Data from User
-			int recvresult = recv(user->stream, (char*)user->rx + user->rxpos, sizeof(user->rx) - user->rxpos, 0);
+			// Receive Data from User (only if there is any)
+			int recvresult = -1;
+			bool recverror = false;
+			if (pollall || FD_ISSET(user->stream, &readfds))
+			{
+				recvresult = recv(user->stream, (char*)user->rx + user->rxpos, sizeof(user->rx) - user->rxpos, 0);
+				recverror = recvresult == 0 || (recvresult == -1 && errno != EAGAIN && errno != EWOULDBLOCK);
+				if (recvresult > 0)
+				{
+					_stats.recvs++;
+					_stats.bytes += recvresult;
+				}
+			}
 
 			// Connection Closed or Timed Out
-			if(recvresult == 0 || (recvresult == -1 && errno != EAGAIN && errno != EWOULDBLOCK) || get_user_state(user) == USER_STATE_TIMED_OUT)
+			if(recverror || get_user_state(user) == USER_STATE_TIMED_OUT)
 			{
 				// Logout User
 				logout_user(user);
@@ -2021,8 +2114,28 @@ int server_loop(int server)
 			user = next;
 		}
 
-		// Prevent needless CPU Overload (1ms Sleep)
-		sleep_ms(1);
+		// Handling Statistics
+		double now = real_time_now();
+		if (activity != 0)
+		{
+			double busy = now - wakeup;
+			_stats.wakeups++;
+			_stats.busytime += busy;
+			_stats.maxbusytime = std::max(_stats.maxbusytime, busy);
+		}
+		if (now - laststats >= SERVER_STATS_INTERVAL)
+		{
+			report_stats(now - laststats);
+			laststats = now;
+		}
+
+		// Rewrite the Status Logfile at most once per second
+		if (_status_dirty && now - laststatus >= 1.0)
+		{
+			_status_dirty = false;
+			update_status();
+			laststatus = now;
+		}
 
 		// Don't do anything if it's paused, otherwise the log will be flooded
 		while (adhocServerRunning && Core_IsStepping()) sleep_ms(1);
@@ -2031,6 +2144,13 @@ int server_loop(int server)
 	// Free User Database Memory
 	free_database();
 
+	// Write the final (empty) Status
+	if (_status_dirty)
+	{
+		_status_dirty = false;
+		update_status();
+	}
+
 	// Close Server Socket
 	closesocket(server);
 
@@ -360,6 +360,11 @@ void game_product_override(SceNetAdhocctlProductCode * product);
  */
 void update_status(void);
 
+/**
+ * Mark the Status Logfile as outdated, it gets rewritten by the Server Loop at most once per second
+ */
+void request_status_update(void);
+
 /**
 * Server Entry Point
 * @param argc Number of Arguments
@@ -16,7 +16,13 @@
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
 #include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
 
+#include "thread/threadutil.h"
 #include "Core/HLE/HLE.h"
 #include "Core/HLE/FunctionWrappers.h"
 #include "Core/MIPS/MIPS.h"
@@ -114,6 +120,9 @@ const int PSP_ATRAC_LOOP_STREAM_DATA_IS_ON_MEMORY = -3;
 const u32 ATRAC3_MAX_SAMPLES = 0x400;
 const u32 ATRAC3PLUS_MAX_SAMPLES = 0x800;
 
+// Per track, for bAtracLoopCache.  About 45 seconds of stereo.
+const size_t ATRAC_LOOP_CACHE_MAX_BYTES = 8 * 1024 * 1024;
+
 static const int atracDecodeDelay = 2300;
 
 #ifdef USE_FFMPEG
@@ -171,6 +180,44 @@ struct AVPacket {
 };
 #endif
 
+enum AtracAheadState {
+	ATRAC_AHEAD_NONE,
+	ATRAC_AHEAD_QUEUED,
+	ATRAC_AHEAD_DONE,
+};
+
+// What one _AtracDecodeData() call decoded, starting at sample.
+struct AtracDecodedFrame {
+	int sample;
+	int channels;
+	AtracDecodeResult result;
+	u32 numSamples;
+	std::vector<u8> pcm;
+};
+
+// Decoded output of a pass through the loop, by the sample each call started at.  Each pass
+// starts with the same seek, so decoding it again would only give the same output again.
+struct AtracLoopCache {
+	std::map<int, AtracDecodedFrame> frames;
+	size_t bytes = 0;
+	// A whole pass, from the loop start until it wrapped again, went in without gaps.
+	bool complete = false;
+	bool recording = false;
+	bool playing = false;
+	// The loop didn't fit, don't bother again.
+	bool tooLarge = false;
+
+	void Clear() {
+		frames.clear();
+		bytes = 0;
+		complete = false;
+		recording = false;
+		playing = false;
+	}
+};
+
+static void waitAtracDecodeAhead(Atrac *atrac);
+
 struct Atrac {
 	Atrac() : atracID_(-1), dataBuf_(0), decodePos_(0), bufferPos_(0),
 		channels_(0), outputChannels_(2), bitrate_(64), bytesPerFrame_(0), bufferMaxSize_(0), jointStereo_(0),
@@ -194,6 +241,8 @@ struct Atrac {
 	}
 
 	void ResetData() {
+		waitAtracDecodeAhead(this);
+		ResetDecodeCache();
 #ifdef USE_FFMPEG
 		ReleaseFFMPEGContext();
 #endif // USE_FFMPEG
@@ -433,6 +482,13 @@ struct Atrac {
 
 	PSPPointer<SceAtracId> context_;
 
+	// For bAtracDecodeAhead.  aheadState_ is guarded by atracDecodeLock while queued.
+	AtracAheadState aheadState_ = ATRAC_AHEAD_NONE;
+	AtracDecodedFrame ahead_;
+	AtracLoopCache loopCache_;
+	// The decoder isn't where currentSample_ says, and needs to seek before decoding.
+	bool decoderStale_ = false;
+
 #ifdef USE_FFMPEG
 	AVCodecContext  *codecCtx_ = nullptr;
 	SwrContext      *swrCtx_ = nullptr;
@@ -482,7 +538,7 @@ struct Atrac {
 		return ignoreDataBuf_ ? Memory::GetPointer(first_.addr) : dataBuf_;
 	}
 
-	void SeekToSample(int sample) {
+	void SeekToSample(int sample, bool force = false) {
 #ifdef USE_FFMPEG
 		// Discard any pending packet data.
 		packet_->size = 0;
@@ -492,9 +548,10 @@ struct Atrac {
 		const u32 unalignedSamples = (offsetSamples + sample) % SamplesPerFrame();
 		int seekFrame = sample + offsetSamples - unalignedSamples;
 
-		if ((sample != currentSample_ || sample == 0) && codecCtx_ != nullptr) {
+		if ((sample != currentSample_ || sample == 0 || force) && codecCtx_ != nullptr) {
 			// Prefill the decode buffer with packets before the first sample offset.
 			avcodec_flush_buffers(codecCtx_);
+			decoderStale_ = false;
 
 			int adjust = 0;
 			if (sample == 0) {
@@ -578,6 +635,194 @@ struct Atrac {
 #endif // USE_FFMPEG
 	}
 
+	// Where the next decode lines up with the frames: how many samples it skips, and at most outputs.
+	void DecodeRange(int *skipSamples, u32 *maxSamples) const {
+		// It seems like the PSP aligns the sample position to 0x800...?
+		int offsetSamples = firstSampleOffset_ + FirstOffsetExtra();
+		*skipSamples = 0;
+		*maxSamples = endSample_ + 1 - currentSample_;
+		u32 unalignedSamples = (offsetSamples + currentSample_) % SamplesPerFrame();
+		if (unalignedSamples != 0) {
+			// We're off alignment, possibly due to a loop.  Force it back on.
+			*maxSamples = SamplesPerFrame() - unalignedSamples;
+			*skipSamples = unalignedSamples;
+		}
+	}
+
+	// Decodes the output of a _AtracDecodeData() call at currentSample_ into outbuf, which may be
+	// null to skip.  This only touches the decoder, so it also runs on the decode ahead thread.
+	AtracDecodeResult DecodeFrame(int skipSamples, u32 maxSamples, u8 *outbuf, u32 *numSamples) {
+		SeekToSample(currentSample_, decoderStale_);
+		decoderStale_ = false;
+
+		AtracDecodeResult res = ATDECODE_FEEDME;
+		*numSamples = 0;
+		while (FillPacket(-skipSamples)) {
+			res = DecodePacket();
+			if (res == ATDECODE_FAILED)
+				return res;
+
+			if (res == ATDECODE_GOTFRAME) {
+#ifdef USE_FFMPEG
+				// got a frame
+				int skipped = std::min(skipSamples, frame_->nb_samples);
+				skipSamples -= skipped;
+				*numSamples = frame_->nb_samples - skipped;
+
+				// If we're at the end, clamp to samples we want.  It always returns a full chunk.
+				*numSamples = std::min(maxSamples, *numSamples);
+
+				if (skipped > 0 && *numSamples == 0) {
+					// Wait for the next one.
+					res = ATDECODE_FEEDME;
+				}
+
+				if (outbuf != NULL && *numSamples != 0) {
+					int inbufOffset = 0;
+					if (skipped != 0) {
+						AVSampleFormat fmt = (AVSampleFormat)frame_->format;
+						// We want the offset per channel.
+						inbufOffset = av_samples_get_buffer_size(NULL, 1, skipped, fmt, 1);
+					}
+
+					u8 *out = outbuf;
+					const u8 *inbuf[2] = {
+						frame_->extended_data[0] + inbufOffset,
+						frame_->extended_data[1] + inbufOffset,
+					};
+					int avret = swr_convert(swrCtx_, &out, *numSamples, inbuf, *numSamples);
+					if (avret < 0) {
+						ERROR_LOG(ME, "swr_convert: Error while converting %d", avret);
+					}
+				}
+#endif // USE_FFMPEG
+			}
+			if (res == ATDECODE_GOTFRAME || res == ATDECODE_BADFRAME) {
+				// We only want one frame per call, let's continue the next time.
+				break;
+			}
+		}
+		return res;
+	}
+
+	// Forgets anything decoded ahead or cached, when the data or decoder changes.
+	void ResetDecodeCache() {
+		aheadState_ = ATRAC_AHEAD_NONE;
+		loopCache_.Clear();
+		loopCache_.tooLarge = false;
+		decoderStale_ = false;
+	}
+
+	bool CanDecodeAhead() const {
+		// Streamed data is still being written by the game, and the loop cache needs no decoding.
+		if (bufferState_ != ATRAC_STATUS_ALL_DATA_LOADED || failedDecode_ || loopCache_.playing)
+			return false;
+		return currentSample_ < endSample_ || loopNum_ != 0;
+	}
+
+	// Runs on the decode ahead thread.
+	void DecodeAhead() {
+		int skipSamples;
+		u32 maxSamples;
+		DecodeRange(&skipSamples, &maxSamples);
+		ahead_.sample = currentSample_;
+		ahead_.channels = outputChannels_;
+		ahead_.pcm.resize(SamplesPerFrame() * outputChannels_ * sizeof(s16));
+		ahead_.result = DecodeFrame(skipSamples, maxSamples, &ahead_.pcm[0], &ahead_.numSamples);
+	}
+
+	// Uses what the thread decoded, if it's still for this position.  Call after waiting for it.
+	bool TakeDecodeAhead(u8 *outbuf, u32 *numSamples, AtracDecodeResult *res, const u8 **pcm) {
+		if (aheadState_ != ATRAC_AHEAD_DONE)
+			return false;
+		aheadState_ = ATRAC_AHEAD_NONE;
+		if (ahead_.sample != currentSample_ || ahead_.channels != outputChannels_) {
+			// Something moved us without the decoder, which has now decoded a frame too many.
+			decoderStale_ = true;
+			return false;
+		}
+
+		*res = ahead_.result;
+		*numSamples = ahead_.numSamples;
+		*pcm = &ahead_.pcm[0];
+		if (outbuf != nullptr && *res == ATDECODE_GOTFRAME)
+			memcpy(outbuf, &ahead_.pcm[0], *numSamples * outputChannels_ * sizeof(s16));
+		return true;
+	}
+
+	bool CanCacheLoop() const {
+		// Streamed data would have to be cached as it's added, only do whole tracks.
+		if (bufferState_ != ATRAC_STATUS_ALL_DATA_LOADED || loopCache_.tooLarge)
+			return false;
+		if (loopStartSample_ < 0 || loopEndSample_ <= loopStartSample_)
+			return false;
+		u64 loopBytes = (u64)(loopEndSample_ - loopStartSample_ + SamplesPerFrame()) * outputChannels_ * sizeof(s16);
+		return loopBytes <= ATRAC_LOOP_CACHE_MAX_BYTES;
+	}
+
+	bool PlayLoopCache(u8 *outbuf, u32 *numSamples) {
+		if (!loopCache_.playing)
+			return false;
+		auto it = loopCache_.frames.find(currentSample_);
+		if (it == loopCache_.frames.end() || it->second.channels != outputChannels_) {
+			// We're off the recorded pass.  The decoder sat it out, so it has to catch up first.
+			loopCache_.playing = false;
+			decoderStale_ = true;
+			return false;
+		}
+
+		*numSamples = it->second.numSamples;
+		if (outbuf != nullptr && !it->second.pcm.empty())
+			memcpy(outbuf, &it->second.pcm[0], it->second.pcm.size());
+		return true;
+	}
+
+	void RecordLoopCache(const u8 *pcm, u32 numSamples, AtracDecodeResult res) {
+		if (!loopCache_.recording)
+			return;
+		size_t pcmBytes = numSamples * outputChannels_ * sizeof(s16);
+		if (res != ATDECODE_GOTFRAME || (pcm == nullptr && numSamples != 0)) {
+			// This pass can't be played back exactly, so give up on it.
+			loopCache_.Clear();
+			return;
+		}
+		if (loopCache_.bytes + pcmBytes > ATRAC_LOOP_CACHE_MAX_BYTES) {
+			loopCache_.Clear();
+			loopCache_.tooLarge = true;
+			return;
+		}
+
+		AtracDecodedFrame &frame = loopCache_.frames[currentSample_];
+		frame.sample = currentSample_;
+		frame.channels = outputChannels_;
+		frame.result = res;
+		frame.numSamples = numSamples;
+		frame.pcm.assign(pcm, pcm + pcmBytes);
+		loopCache_.bytes += pcmBytes;
+	}
+
+	// At the loop wrapping around.  Returns true if the next pass comes from the loop cache.
+	bool LoopWrapped() {
+		if (!g_Config.bAtracLoopCache || !CanCacheLoop()) {
+			loopCache_.Clear();
+			return false;
+		}
+		if (loopCache_.recording)
+			loopCache_.complete = true;
+		loopCache_.recording = !loopCache_.complete;
+		// The last pass carries on past the loop end, so decode that one for real.
+		loopCache_.playing = loopCache_.complete && loopNum_ != 0;
+		return loopCache_.playing;
+	}
+
+	// When the game moves the play position, the current pass isn't one to record or play.
+	void StopLoopCachePass() {
+		if (!loopCache_.complete)
+			loopCache_.Clear();
+		loopCache_.recording = false;
+		loopCache_.playing = false;
+	}
+
 	void CalculateStreamInfo(u32 *readOffset);
 
 	u32 StreamBufferEnd() const {
@@ -622,6 +867,66 @@ static bool atracInited = true;
 static Atrac *atracIDs[PSP_NUM_ATRAC_IDS];
 static u32 atracIDTypes[PSP_NUM_ATRAC_IDS];
 
+// One thread decodes ahead for all tracks, see g_Config.bAtracDecodeAhead.
+static std::thread *atracDecodeThread = nullptr;
+static std::mutex atracDecodeLock;
+static std::condition_variable atracDecodeCond;
+static std::deque<Atrac *> atracDecodeQueue;
+static bool atracDecodeStop = false;
+
+static void AtracDecodeAheadThread() {
+	setCurrentThreadName("AtracDecode");
+
+	std::unique_lock<std::mutex> guard(atracDecodeLock);
+	while (!atracDecodeStop) {
+		if (atracDecodeQueue.empty()) {
+			atracDecodeCond.wait(guard);
+			continue;
+		}
+
+		Atrac *atrac = atracDecodeQueue.front();
+		atracDecodeQueue.pop_front();
+		// Nothing else touches the track until it's done, see waitAtracDecodeAhead().
+		guard.unlock();
+		atrac->DecodeAhead();
+		guard.lock();
+		atrac->aheadState_ = ATRAC_AHEAD_DONE;
+		atracDecodeCond.notify_all();
+	}
+}
+
+static void queueAtracDecodeAhead(Atrac *atrac) {
+	std::lock_guard<std::mutex> guard(atracDecodeLock);
+	if (!atracDecodeThread) {
+		atracDecodeStop = false;
+		atracDecodeThread = new std::thread(&AtracDecodeAheadThread);
+	}
+	atrac->aheadState_ = ATRAC_AHEAD_QUEUED;
+	atracDecodeQueue.push_back(atrac);
+	atracDecodeCond.notify_all();
+}
+
+// Call before touching the track at all, since the thread might still be decoding it.
+static void waitAtracDecodeAhead(Atrac *atrac) {
+	std::unique_lock<std::mutex> guard(atracDecodeLock);
+	while (atrac->aheadState_ == ATRAC_AHEAD_QUEUED)
+		atracDecodeCond.wait(guard);
+}
+
+static void stopAtracDecodeAhead() {
+	if (!atracDecodeThread)
+		return;
+
+	{
+		std::lock_guard<std::mutex> guard(atracDecodeLock);
+		atracDecodeStop = true;
+	}
+	atracDecodeCond.notify_all();
+	atracDecodeThread->join();
+	delete atracDecodeThread;
+	atracDecodeThread = nullptr;
+}
+
 void __AtracInit() {
 	atracInited = true;
 	memset(atracIDs, 0, sizeof(atracIDs));
@@ -646,6 +951,10 @@ void __AtracDoState(PointerWrap &p) {
 		return;
 
 	p.Do(atracInited);
+	for (int i = 0; i < PSP_NUM_ATRAC_IDS; ++i) {
+		if (atracIDs[i])
+			waitAtracDecodeAhead(atracIDs[i]);
+	}
 	for (int i = 0; i < PSP_NUM_ATRAC_IDS; ++i) {
 		bool valid = atracIDs[i] != NULL;
 		p.Do(valid);
@@ -664,6 +973,7 @@ void __AtracShutdown() {
 		delete atracIDs[i];
 		atracIDs[i] = NULL;
 	}
+	stopAtracDecodeAhead();
 }
 
 static Atrac *getAtrac(int atracID) {
@@ -671,6 +981,8 @@ static Atrac *getAtrac(int atracID) {
 		return NULL;
 	}
 	Atrac *atrac = atracIDs[atracID];
+	if (atrac)
+		waitAtracDecodeAhead(atrac);
 
 	if (atrac && atrac->context_.IsValid()) {
 		// Read in any changes from the game to the context.
@@ -1161,16 +1473,9 @@ u32 _AtracDecodeData(int atracID, u8 *outbuf, u32 outbufPtr, u32 *SamplesNum, u3
 			// TODO: This isn't at all right, but at least it makes the music "last" some time.
 			u32 numSamples = 0;
 
-			// It seems like the PSP aligns the sample position to 0x800...?
-			int offsetSamples = atrac->firstSampleOffset_ + atrac->FirstOffsetExtra();
-			int skipSamples = 0;
-			u32 maxSamples = atrac->endSample_ + 1 - atrac->currentSample_;
-			u32 unalignedSamples = (offsetSamples + atrac->currentSample_) % atrac->SamplesPerFrame();
-			if (unalignedSamples != 0) {
-				// We're off alignment, possibly due to a loop.  Force it back on.
-				maxSamples = atrac->SamplesPerFrame() - unalignedSamples;
-				skipSamples = unalignedSamples;
-			}
+			int skipSamples;
+			u32 maxSamples;
+			atrac->DecodeRange(&skipSamples, &maxSamples);
 
 			if (skipSamples != 0 && atrac->bufferHeaderSize_ == 0) {
 				// Skip the initial frame used to load state for the looped frame.
@@ -1179,60 +1484,23 @@ u32 _AtracDecodeData(int atracID, u8 *outbuf, u32 outbufPtr, u32 *SamplesNum, u3
 			}
 
 			if (!atrac->failedDecode_ && (atrac->codecType_ == PSP_MODE_AT_3 || atrac->codecType_ == PSP_MODE_AT_3_PLUS)) {
-				atrac->SeekToSample(atrac->currentSample_);
-
-				AtracDecodeResult res = ATDECODE_FEEDME;
-				while (atrac->FillPacket(-skipSamples)) {
-					res = atrac->DecodePacket();
+				AtracDecodeResult res = ATDECODE_GOTFRAME;
+				if (!atrac->PlayLoopCache(outbuf, &numSamples)) {
+					const u8 *pcm = outbuf;
+					if (!atrac->TakeDecodeAhead(outbuf, &numSamples, &res, &pcm)) {
+						res = atrac->DecodeFrame(skipSamples, maxSamples, outbuf, &numSamples);
+					}
 					if (res == ATDECODE_FAILED) {
 						*SamplesNum = 0;
 						*finish = 1;
 						return ATRAC_ERROR_ALL_DATA_DECODED;
 					}
+					atrac->RecordLoopCache(pcm, numSamples, res);
+				}
 
-					if (res == ATDECODE_GOTFRAME) {
-#ifdef USE_FFMPEG
-						// got a frame
-						int skipped = std::min(skipSamples, atrac->frame_->nb_samples);
-						skipSamples -= skipped;
-						numSamples = atrac->frame_->nb_samples - skipped;
-
-						// If we're at the end, clamp to samples we want.  It always returns a full chunk.
-						numSamples = std::min(maxSamples, numSamples);
-
-						if (skipped > 0 && numSamples == 0) {
-							// Wait for the next one.
-							res = ATDECODE_FEEDME;
-						}
-
-						if (outbuf != NULL && numSamples != 0) {
-							int inbufOffset = 0;
-							if (skipped != 0) {
-								AVSampleFormat fmt = (AVSampleFormat)atrac->frame_->format;
-								// We want the offset per channel.
-								inbufOffset = av_samples_get_buffer_size(NULL, 1, skipped, fmt, 1);
-							}
-
-							u8 *out = outbuf;
-							const u8 *inbuf[2] = {
-								atrac->frame_->extended_data[0] + inbufOffset,
-								atrac->frame_->extended_data[1] + inbufOffset,
-							};
-							int avret = swr_convert(atrac->swrCtx_, &out, numSamples, inbuf, numSamples);
-							if (outbufPtr != 0) {
-								u32 outBytes = numSamples * atrac->outputChannels_ * sizeof(s16);
-								CBreakPoints::ExecMemCheck(outbufPtr, true, outBytes, currentMIPS->pc);
-							}
-							if (avret < 0) {
-								ERROR_LOG(ME, "swr_convert: Error while converting %d", avret);
-							}
-						}
-#endif // USE_FFMPEG
-					}
-					if (res == ATDECODE_GOTFRAME || res == ATDECODE_BADFRAME) {
-						// We only want one frame per call, let's continue the next time.
-						break;
-					}
+				if (res == ATDECODE_GOTFRAME && outbuf != NULL && numSamples != 0 && outbufPtr != 0) {
+					u32 outBytes = numSamples * atrac->outputChannels_ * sizeof(s16);
+					CBreakPoints::ExecMemCheck(outbufPtr, true, outBytes, currentMIPS->pc);
 				}
 
 				if (res != ATDECODE_GOTFRAME && atrac->currentSample_ < atrac->endSample_) {
@@ -1261,11 +1529,18 @@ u32 _AtracDecodeData(int atracID, u8 *outbuf, u32 outbufPtr, u32 *SamplesNum, u3
 			bool hitEnd = atrac->currentSample_ >= atrac->endSample_ || (numSamples == 0 && atrac->first_.size >= atrac->first_.filesize);
 			int loopEndAdjusted = atrac->loopEndSample_ - atrac->FirstOffsetExtra() - atrac->firstSampleOffset_;
 			if ((hitEnd || atrac->currentSample_ > loopEndAdjusted) && loopNum != 0) {
-				atrac->SeekToSample(atrac->loopStartSample_ - atrac->FirstOffsetExtra() - atrac->firstSampleOffset_);
 				if (atrac->bufferState_ != ATRAC_STATUS_FOR_SCESAS) {
 					if (atrac->loopNum_ > 0)
 						atrac->loopNum_--;
 				}
+				int loopStart = atrac->loopStartSample_ - atrac->FirstOffsetExtra() - atrac->firstSampleOffset_;
+				if (atrac->LoopWrapped()) {
+					// Nothing to decode for this pass, so the decoder can seek if it's ever needed.
+					atrac->currentSample_ = loopStart;
+					atrac->decoderStale_ = true;
+				} else {
+					atrac->SeekToSample(loopStart);
+				}
 				if ((atrac->bufferState_ & ATRAC_STATUS_STREAMED_MASK) == ATRAC_STATUS_STREAMED_MASK) {
 					// Whatever bytes we have left were added from the loop.
 					u32 loopOffset = atrac->FileOffsetBySample(atrac->loopStartSample_ - atrac->FirstOffsetExtra() - atrac->firstSampleOffset_ - atrac->SamplesPerFrame() * 2);
@@ -1290,6 +1565,9 @@ u32 _AtracDecodeData(int atracID, u8 *outbuf, u32 outbufPtr, u32 *SamplesNum, u3
 			// refresh context_
 			_AtracGenerateContext(atrac, atrac->context_);
 		}
+		if (ret == 0 && g_Config.bAtracDecodeAhead && atrac->CanDecodeAhead()) {
+			queueAtracDecodeAhead(atrac);
+		}
 	}
 
 	return ret;
@@ -1740,6 +2018,7 @@ static u32 sceAtracResetPlayPosition(int atracID, int sample, int bytesWrittenFi
 		}
 
 		if (atrac->codecType_ == PSP_MODE_AT_3 || atrac->codecType_ == PSP_MODE_AT_3_PLUS) {
+			atrac->StopLoopCachePass();
 			atrac->SeekToSample(sample);
 		}
 
@@ -1785,6 +2064,7 @@ static int __AtracUpdateOutputMode(Atrac *atrac, int wanted_channels) {
 #endif // USE_FFMPEG
 
 int __AtracSetContext(Atrac *atrac) {
+	atrac->ResetDecodeCache();
 #ifdef USE_FFMPEG
 	InitFFmpeg();
 
@@ -15,150 +15,275 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+
 #include "zlib.h"
 
+#include "thread/threadutil.h"
+#include "Common/ChunkFile.h"
 #include "Common/CommonTypes.h"
+#include "Core/CoreTiming.h"
 #include "Core/HLE/HLE.h"
 #include "Core/HLE/FunctionWrappers.h"
 #include "Core/HLE/sceDeflt.h"
+#include "Core/HLE/sceKernel.h"
+#include "Core/HLE/sceKernelThread.h"
 #include "Core/MemMap.h"
 
-// All the decompress functions are identical with only differing window bits. Possibly should be one function
+// Smaller buffers are quicker to just inflate than to hand to the thread.
+static const u32 DEFLT_THREAD_MIN_SIZE = 64 * 1024;
+// A guess at the firmware's (software) inflate speed on the PSP, in output bytes per microsecond.
+static const u32 DEFLT_BYTES_PER_US = 16;
+// When to first check on a threaded inflate.  If it's not done by then, we wait for it.
+static const int DEFLT_FIRST_CHECK_US = 200;
 
-static int sceDeflateDecompress(u32 OutBuffer, int OutBufferLength, u32 InBuffer, u32 Crc32Addr) {
-	DEBUG_LOG(HLE, "sceGzipDecompress(%08x, %x, %08x, %08x)", OutBuffer, OutBufferLength, InBuffer, Crc32Addr);
-	int err;
-	uLong crc;
-	z_stream stream;
-	u8 *outBufferPtr;
-	u32 *crc32AddrPtr = 0;
+enum DefltThreadState {
+	DISABLED,
+	READY,
+	QUEUED,
+};
 
-	if (!Memory::IsValidAddress(OutBuffer) || !Memory::IsValidAddress(InBuffer)) {
-		ERROR_LOG(HLE, "sceZlibDecompress: Bad address %08x %08x", OutBuffer, InBuffer);
-		return 0;
-	}
-	if (Crc32Addr) {
-		if (!Memory::IsValidAddress(Crc32Addr)) {
-			ERROR_LOG(HLE, "sceZlibDecompress: Bad address %08x", Crc32Addr);
-			return 0;
-		}
-		crc32AddrPtr = (u32 *)Memory::GetPointer(Crc32Addr);
-	}
-	outBufferPtr = Memory::GetPointer(OutBuffer);
-	stream.next_in = (Bytef*)Memory::GetPointer(InBuffer);
-	stream.avail_in = (uInt)OutBufferLength;
-	stream.next_out = outBufferPtr;
-	stream.avail_out = (uInt)OutBufferLength;
+struct DefltThreadJob {
+	SceUID threadID;
+	u8 *out;
+	const u8 *in;
+	u32 length;
+	int windowBits;
+	u32 crcAddr;
+	// Set by the thread.
+	int result;
+	u32 crc;
+};
+
+struct DefltWait {
+	u64 startTicks;
+	int result;
+};
+
+static std::thread *defltThread;
+static std::mutex defltWakeMutex;
+static std::mutex defltDoneMutex;
+static std::condition_variable defltWake;
+static std::condition_variable defltDone;
+static volatile int defltThreadState = DefltThreadState::DISABLED;
+static DefltThreadJob defltThreadJob;
+static bool defltJobPending = false;
+static int defltDoneEvent = -1;
+// Threads waiting on a threaded inflate, with the result once it's in.
+static std::map<SceUID, DefltWait> defltWaits;
+
+// All the decompress functions are identical with only differing window bits.
+static int DefltInflate(u8 *out, const u8 *in, u32 length, int windowBits, u32 *crc) {
+	z_stream stream;
+	stream.next_in = (Bytef *)in;
+	// We don't know the input size, the output size will have to do.
+	stream.avail_in = (uInt)length;
+	stream.next_out = out;
+	stream.avail_out = (uInt)length;
 	stream.zalloc = (alloc_func)0;
 	stream.zfree = (free_func)0;
-	err = inflateInit2(&stream, -MAX_WBITS);
+	int err = inflateInit2(&stream, windowBits);
 	if (err != Z_OK) {
 		ERROR_LOG(HLE, "sceZlibDecompress: inflateInit2 failed %08x", err);
 		return 0;
 	}
 	err = inflate(&stream, Z_FINISH);
+	inflateEnd(&stream);
 	if (err != Z_STREAM_END) {
-		inflateEnd(&stream);
 		ERROR_LOG(HLE, "sceZlibDecompress: inflate failed %08x", err);
 		return 0;
 	}
-	inflateEnd(&stream);
-	if (crc32AddrPtr) {
-		crc = crc32(0L, Z_NULL, 0);
-		*crc32AddrPtr = crc32(crc, outBufferPtr, stream.total_out);
-	}
+	if (crc)
+		*crc = crc32(crc32(0L, Z_NULL, 0), out, stream.total_out);
 	return stream.total_out;
 }
 
+static int __DefltThread() {
+	setCurrentThreadName("Inflate");
 
-static int sceGzipDecompress(u32 OutBuffer, int OutBufferLength, u32 InBuffer, u32 Crc32Addr) {
-	DEBUG_LOG(HLE, "sceGzipDecompress(%08x, %x, %08x, %08x)", OutBuffer, OutBufferLength, InBuffer, Crc32Addr);
-	int err;
-	uLong crc;
-	z_stream stream;
-	u8 *outBufferPtr;
-	u32 *crc32AddrPtr = 0;
+	std::unique_lock<std::mutex> guard(defltWakeMutex);
+	while (defltThreadState != DefltThreadState::DISABLED) {
+		if (defltThreadState != DefltThreadState::QUEUED)
+			defltWake.wait(guard);
+		if (defltThreadState == DefltThreadState::QUEUED) {
+			DefltThreadJob &job = defltThreadJob;
+			job.result = DefltInflate(job.out, job.in, job.length, job.windowBits, job.crcAddr ? &job.crc : nullptr);
 
-	if (!Memory::IsValidAddress(OutBuffer) || !Memory::IsValidAddress(InBuffer)) {
-		ERROR_LOG(HLE, "sceZlibDecompress: Bad address %08x %08x", OutBuffer, InBuffer);
-		return 0;
-	}
-	if (Crc32Addr) {
-		if (!Memory::IsValidAddress(Crc32Addr)) {
-			ERROR_LOG(HLE, "sceZlibDecompress: Bad address %08x", Crc32Addr);
-			return 0;
+			defltDoneMutex.lock();
+			defltThreadState = DefltThreadState::READY;
+			defltDone.notify_one();
+			defltDoneMutex.unlock();
 		}
-		crc32AddrPtr = (u32 *)Memory::GetPointer(Crc32Addr);
 	}
-	outBufferPtr = Memory::GetPointer(OutBuffer);
-	stream.next_in = (Bytef*)Memory::GetPointer(InBuffer);
-	stream.avail_in = (uInt)OutBufferLength;
-	stream.next_out = outBufferPtr;
-	stream.avail_out = (uInt)OutBufferLength;
-	stream.zalloc = (alloc_func)0;
-	stream.zfree = (free_func)0;
-	err = inflateInit2(&stream, 16+MAX_WBITS);
-	if (err != Z_OK) {
-		ERROR_LOG(HLE, "sceZlibDecompress: inflateInit2 failed %08x", err);
-		return 0;
+	return 0;
+}
+
+void __DefltSync() {
+	if (defltThreadState == DefltThreadState::DISABLED)
+		return;
+
+	{
+		std::unique_lock<std::mutex> guard(defltDoneMutex);
+		while (defltThreadState == DefltThreadState::QUEUED)
+			defltDone.wait(guard);
 	}
-	err = inflate(&stream, Z_FINISH);
-	if (err != Z_STREAM_END) {
-		inflateEnd(&stream);
-		ERROR_LOG(HLE, "sceZlibDecompress: inflate failed %08x", err);
-		return 0;
+	// Only this thread queues, so the job is ours again.
+	if (defltJobPending) {
+		const DefltThreadJob &job = defltThreadJob;
+		Memory::FinishHostWrite(job.out, job.length);
+		if (job.crcAddr && job.result != 0)
+			Memory::Write_U32(job.crc, job.crcAddr);
+		auto it = defltWaits.find(job.threadID);
+		if (it != defltWaits.end())
+			it->second.result = job.result;
+		defltJobPending = false;
 	}
-	inflateEnd(&stream);
-	if (crc32AddrPtr) {
-		crc = crc32(0L, Z_NULL, 0);
-		*crc32AddrPtr = crc32(crc, outBufferPtr, stream.total_out);
+}
+
+static void __DefltEnqueue(const DefltThreadJob &job) {
+	if (!defltThread) {
+		defltThreadState = DefltThreadState::READY;
+		defltThread = new std::thread(__DefltThread);
 	}
-	return stream.total_out;
+
+	// Can't fault on another thread for rewind's write tracking (or the debugger's watches.)
+	Memory::PrepareHostWrite(job.out, job.length);
+	defltThreadJob = job;
+	defltJobPending = true;
+
+	defltWakeMutex.lock();
+	defltThreadState = DefltThreadState::QUEUED;
+	defltWake.notify_one();
+	defltWakeMutex.unlock();
 }
 
-static int sceZlibDecompress(u32 OutBuffer, int OutBufferLength, u32 InBuffer, u32 Crc32Addr) {
-	DEBUG_LOG(HLE, "sceZlibDecompress(%08x, %x, %08x, %08x)", OutBuffer, OutBufferLength, InBuffer, Crc32Addr);
-	int err;
-	uLong crc;
-	z_stream stream;
-	u8 *outBufferPtr;
-	u32 *crc32AddrPtr = 0;
+static void __DefltDisableThread() {
+	if (defltThreadState != DefltThreadState::DISABLED) {
+		__DefltSync();
+		defltWakeMutex.lock();
+		defltThreadState = DefltThreadState::DISABLED;
+		defltWake.notify_one();
+		defltWakeMutex.unlock();
+		defltThread->join();
+		delete defltThread;
+		defltThread = nullptr;
+	}
+}
 
-	if (!Memory::IsValidAddress(OutBuffer) || !Memory::IsValidAddress(InBuffer)) {
-		ERROR_LOG(HLE, "sceZlibDecompress: Bad address %08x %08x", OutBuffer, InBuffer);
-		return 0;
+static void __DefltDoneCheck(u64 userdata, int cycleslate) {
+	SceUID threadID = (SceUID)userdata;
+	// Make sure it's done, then wait out the rest of the time the PSP would've taken.
+	__DefltSync();
+
+	auto it = defltWaits.find(threadID);
+	if (it == defltWaits.end()) {
+		WARN_LOG(HLE, "Inflate finished for unknown thread %d", threadID);
+		return;
 	}
-	if (Crc32Addr) {
-		if (!Memory::IsValidAddress(Crc32Addr)) {
-			ERROR_LOG(HLE, "sceZlibDecompress: Bad address %08x", Crc32Addr);
-			return 0;
-		}
-		crc32AddrPtr = (u32 *)Memory::GetPointer(Crc32Addr);
+
+	const u64 doneTicks = it->second.startTicks + usToCycles((s64)(it->second.result / DEFLT_BYTES_PER_US));
+	const s64 remaining = (s64)(doneTicks - CoreTiming::GetTicks());
+	if (remaining > 0) {
+		CoreTiming::ScheduleEvent(remaining, defltDoneEvent, userdata);
+		return;
 	}
-	outBufferPtr = Memory::GetPointer(OutBuffer);
-	stream.next_in = (Bytef*)Memory::GetPointer(InBuffer);
-	stream.avail_in = (uInt)OutBufferLength;
-	stream.next_out = outBufferPtr;
-	stream.avail_out = (uInt)OutBufferLength;
-	stream.zalloc = (alloc_func)0;
-	stream.zfree = (free_func)0;
-	err = inflateInit2(&stream, MAX_WBITS);
-	if (err != Z_OK) {
-		ERROR_LOG(HLE, "sceZlibDecompress: inflateInit failed %08x", err);
+
+	const int result = it->second.result;
+	defltWaits.erase(it);
+
+	u32 error;
+	SceUID verify = __KernelGetWaitID(threadID, WAITTYPE_HLEDELAY, error);
+	if (error == 0 && verify == 1) {
+		__KernelResumeThreadFromWait(threadID, result);
+		__KernelReSchedule("woke from inflate");
+	} else {
+		WARN_LOG(HLE, "Someone else woke up inflate-blocked thread?");
+	}
+}
+
+void __DefltInit() {
+	defltWaits.clear();
+	defltJobPending = false;
+	defltDoneEvent = CoreTiming::RegisterEvent("DefltDone", __DefltDoneCheck);
+}
+
+void __DefltDoState(PointerWrap &p) {
+	auto s = p.Section("sceDeflt", 0, 1);
+
+	// Don't want to save (or load over) an inflate in progress.
+	__DefltSync();
+	if (s == 0) {
+		defltWaits.clear();
+		return;
+	}
+
+	p.Do(defltWaits);
+	p.Do(defltDoneEvent);
+	CoreTiming::RestoreRegisterEvent(defltDoneEvent, "DefltDone", __DefltDoneCheck);
+}
+
+void __DefltShutdown() {
+	__DefltDisableThread();
+	defltWaits.clear();
+}
+
+static int DefltDecompress(const char *name, u32 OutBuffer, int OutBufferLength, u32 InBuffer, u32 Crc32Addr, int windowBits) {
+	DEBUG_LOG(HLE, "%s(%08x, %x, %08x, %08x)", name, OutBuffer, OutBufferLength, InBuffer, Crc32Addr);
+	if (!Memory::IsValidAddress(OutBuffer) || !Memory::IsValidAddress(InBuffer)) {
+		ERROR_LOG(HLE, "%s: Bad address %08x %08x", name, OutBuffer, InBuffer);
 		return 0;
 	}
-	err = inflate(&stream, Z_FINISH);
-	if (err != Z_STREAM_END) {
-		inflateEnd(&stream);
-		ERROR_LOG(HLE, "sceZlibDecompress: inflate failed %08x", err);
+	if (Crc32Addr && !Memory::IsValidAddress(Crc32Addr)) {
+		ERROR_LOG(HLE, "%s: Bad address %08x", name, Crc32Addr);
 		return 0;
 	}
-	inflateEnd(&stream);
-	if (crc32AddrPtr) {
-		crc = crc32(0L, Z_NULL, 0);
-		*crc32AddrPtr = crc32(crc, outBufferPtr, stream.total_out);
+
+	u8 *outBufferPtr = Memory::GetPointer(OutBuffer);
+	const u8 *inBufferPtr = Memory::GetPointer(InBuffer);
+
+	// Big ones inflate on a thread, and the caller wakes up about when the PSP would be done.
+	bool threaded = OutBufferLength >= (int)DEFLT_THREAD_MIN_SIZE && Memory::IsValidRange(OutBuffer, OutBufferLength);
+	if (threaded && defltDoneEvent != -1 && __KernelIsDispatchEnabled()) {
+		// Only one at a time, another thread might still have one going.
+		__DefltSync();
+
+		DefltThreadJob job{};
+		job.threadID = __KernelGetCurThread();
+		job.out = outBufferPtr;
+		job.in = inBufferPtr;
+		job.length = (u32)OutBufferLength;
+		job.windowBits = windowBits;
+		job.crcAddr = Crc32Addr;
+		__DefltEnqueue(job);
+
+		DefltWait &wait = defltWaits[job.threadID];
+		wait.startTicks = CoreTiming::GetTicks();
+		wait.result = 0;
+		CoreTiming::ScheduleEvent(usToCycles(DEFLT_FIRST_CHECK_US), defltDoneEvent, job.threadID);
+		__KernelWaitCurThread(WAITTYPE_HLEDELAY, 1, 0, 0, false, "inflate");
+		return 0;
 	}
-	return stream.total_out;
+
+	u32 crc;
+	int result = DefltInflate(outBufferPtr, inBufferPtr, (u32)OutBufferLength, windowBits, Crc32Addr ? &crc : nullptr);
+	if (Crc32Addr && result != 0)
+		Memory::Write_U32(crc, Crc32Addr);
+	return result;
+}
+
+static int sceDeflateDecompress(u32 OutBuffer, int OutBufferLength, u32 InBuffer, u32 Crc32Addr) {
+	return DefltDecompress("sceDeflateDecompress", OutBuffer, OutBufferLength, InBuffer, Crc32Addr, -MAX_WBITS);
+}
+
+static int sceGzipDecompress(u32 OutBuffer, int OutBufferLength, u32 InBuffer, u32 Crc32Addr) {
+	return DefltDecompress("sceGzipDecompress", OutBuffer, OutBufferLength, InBuffer, Crc32Addr, 16 + MAX_WBITS);
+}
+
+static int sceZlibDecompress(u32 OutBuffer, int OutBufferLength, u32 InBuffer, u32 Crc32Addr) {
+	return DefltDecompress("sceZlibDecompress", OutBuffer, OutBufferLength, InBuffer, Crc32Addr, MAX_WBITS);
 }
 
 const HLEFunction sceDeflt[] = {
@@ -17,4 +17,12 @@
 
 #pragma once
 
+class PointerWrap;
+
+void __DefltInit();
+void __DefltDoState(PointerWrap &p);
+void __DefltShutdown();
+// Waits for an inflate still running on its thread, before something else reads the output.
+void __DefltSync();
+
 void Register_sceDeflt();
@@ -19,6 +19,7 @@
 #include <map>
 #include <cmath>
 #include <algorithm>
+#include <thread>
 
 // TODO: Move this somewhere else, cleanup.
 #ifndef _WIN32
@@ -42,6 +43,7 @@
 #include "Core/CoreParameter.h"
 #include "Core/Host.h"
 #include "Core/Reporting.h"
+#include "Core/SaveState.h"
 #include "Core/System.h"
 #include "Core/HLE/HLE.h"
 #include "Core/HLE/FunctionWrappers.h"
@@ -115,6 +117,21 @@ static const double timePerVblank = 1.001f / 60.0f;
 static double curFrameTime;
 static double lastFrameTime;
 static double nextFrameTime;
+// With low latency pacing, the throttle wait happens after the flip has been presented.
+static double pendingWaitTime;
+// Set by a timed flip, so hleAfterFlip only samples it once (run-ahead reruns the event.)
+static bool flipPresentPending;
+
+// Auto frameskip cost tracking, smoothed per flip.  Host time, in seconds.
+static double frameWorkStart;
+static double lastListSeconds;
+static double smoothedCpuCost;
+static double smoothedGpuCost;
+static double autoSkipRatio;
+static double autoSkipAccum;
+static bool autoSkipRenderBound;
+static int autoSkippedFrames;
+static int autoSkipHeldFrames;
 static int numVBlanks;
 static int numVBlanksSinceFlip;
 
@@ -158,6 +175,12 @@ static float flips = 0.0f;
 static int actualFlips = 0;  // taking frameskip into account
 static int lastActualFlips = 0;
 static float actualFps = 0;
+// Host time between consecutive presented flips, to show pacing jitter.
+static double presentIntervals[120];
+static const int presentIntervalsSize = (int)ARRAY_SIZE(presentIntervals);
+static int presentIntervalsPos = 0;
+static int presentIntervalsValid = 0;
+static double lastPresentTime = 0.0;
 // For the "max 60 fps" setting.
 static int lastFlipsTooFrequent = 0;
 static u64 lastFlipCycles = 0;
@@ -205,6 +228,20 @@ void __DisplayInit() {
 	lastFlipCycles = 0;
 	nextFlipCycles = 0;
 	wasPaused = false;
+	pendingWaitTime = 0.0;
+	flipPresentPending = false;
+	frameWorkStart = 0.0;
+	lastListSeconds = 0.0;
+	smoothedCpuCost = 0.0;
+	smoothedGpuCost = 0.0;
+	autoSkipRatio = 0.0;
+	autoSkipAccum = 0.0;
+	autoSkipRenderBound = false;
+	autoSkippedFrames = 0;
+	autoSkipHeldFrames = 0;
+	presentIntervalsPos = 0;
+	presentIntervalsValid = 0;
+	lastPresentTime = 0.0;
 
 	enterVblankEvent = CoreTiming::RegisterEvent("EnterVBlank", &hleEnterVblank);
 	leaveVblankEvent = CoreTiming::RegisterEvent("LeaveVBlank", &hleLeaveVblank);
@@ -316,6 +353,7 @@ void __DisplayDoState(PointerWrap &p) {
 		p.Do(nextFlipCycles);
 	}
 
+	gpu->SyncThread();
 	gpu->DoState(p);
 
 	if (p.mode == p.MODE_READ) {
@@ -460,20 +498,78 @@ static void CalculateFPS() {
 	}
 }
 
+static void RecordPresentInterval() {
+	time_update();
+	double now = time_now_d();
+	double interval = now - lastPresentTime;
+	lastPresentTime = now;
+	// Pauses and loading stalls aren't pacing, just skip them.
+	if (interval <= 0.0 || interval > 0.25) {
+		return;
+	}
+
+	presentIntervals[presentIntervalsPos++] = interval;
+	presentIntervalsPos = presentIntervalsPos % presentIntervalsSize;
+	if (presentIntervalsValid < presentIntervalsSize) {
+		++presentIntervalsValid;
+	}
+}
+
+static void GetPresentIntervalStats(double *mean, double *stddev, double *worst) {
+	*mean = 0.0;
+	*stddev = 0.0;
+	*worst = 0.0;
+	if (presentIntervalsValid == 0) {
+		return;
+	}
+
+	double sum = 0.0;
+	for (int i = 0; i < presentIntervalsValid; ++i) {
+		sum += presentIntervals[i];
+		*worst = std::max(*worst, presentIntervals[i]);
+	}
+	*mean = sum / presentIntervalsValid;
+
+	double variance = 0.0;
+	for (int i = 0; i < presentIntervalsValid; ++i) {
+		const double d = presentIntervals[i] - *mean;
+		variance += d * d;
+	}
+	*stddev = sqrt(variance / presentIntervalsValid);
+}
+
 void __DisplayGetDebugStats(char *stats, size_t bufsize) {
 	char statbuf[4096];
 	gpu->GetStats(statbuf, sizeof(statbuf));
 
+	double presentMean, presentStddev, presentWorst;
+	GetPresentIntervalStats(&presentMean, &presentStddev, &presentWorst);
+
+	char runAheadbuf[256] = "";
+	if (SaveState::IsRunningAhead()) {
+		double saveTime, loadTime;
+		int savedPages, loadedPages;
+		SaveState::GetRunAheadStats(&saveTime, &loadTime, &savedPages, &loadedPages);
+		snprintf(runAheadbuf, sizeof(runAheadbuf), "Run-ahead: save %0.2f ms (%d pages), load %0.2f ms (%d pages)\n", saveTime * 1000.0, savedPages, loadTime * 1000.0, loadedPages);
+	}
+
 	snprintf(stats, bufsize,
 		"Kernel processing time: %0.2f ms\n"
 		"Slowest syscall: %s : %0.2f ms\n"
-		"Most active syscall: %s : %0.2f ms\n%s",
+		"Most active syscall: %s : %0.2f ms\n"
+		"Present interval: %0.2f ms (jitter %0.2f ms, worst %0.2f ms)\n"
+		"Auto frameskip: cpu %0.2f ms, gpu %0.2f ms, %s, skip %d%% (skipped %d, held %d)\n"
+		"%s%s",
 		kernelStats.msInSyscalls * 1000.0f,
 		kernelStats.slowestSyscallName ? kernelStats.slowestSyscallName : "(none)",
 		kernelStats.slowestSyscallTime * 1000.0f,
 		kernelStats.summedSlowestSyscallName ? kernelStats.summedSlowestSyscallName : "(none)",
 		kernelStats.summedSlowestSyscallTime * 1000.0f,
-		statbuf);
+		presentMean * 1000.0, presentStddev * 1000.0, presentWorst * 1000.0,
+		smoothedCpuCost * 1000.0, smoothedGpuCost * 1000.0,
+		autoSkipRenderBound ? "render bound" : "cpu bound",
+		(int)(autoSkipRatio * 100.0), autoSkippedFrames, autoSkipHeldFrames,
+		runAheadbuf, statbuf);
 }
 
 enum {
@@ -486,6 +582,10 @@ void __DisplaySetWasPaused() {
 }
 
 static bool FrameTimingThrottled() {
+	// Frames ahead should be done as fast as possible, the real frame did the waiting.
+	if (PSP_CoreParameter().runningAhead) {
+		return false;
+	}
 	if (PSP_CoreParameter().fpsLimit == FPS_LIMIT_CUSTOM && g_Config.iFpsLimit == 0) {
 		return false;
 	}
@@ -502,6 +602,91 @@ static void DoFrameDropLogging(float scaledTimestep) {
 	}
 }
 
+// Sleeping is only accurate to a millisecond or two (worse on Windows), so sleep until just
+// before the goal and yield the rest of the way.  Overshooting here shows up as judder.
+static void WaitUntil(double goal) {
+#ifdef _WIN32
+	const double spinMargin = 0.002;
+#else
+	const double spinMargin = 0.001;
+#endif
+	time_update();
+	while (time_now_d() < goal - spinMargin) {
+#ifdef _WIN32
+		sleep_ms(1);
+#else
+		const double left = goal - spinMargin - time_now_d();
+		usleep((long)(left * 1000000));
+#endif
+		time_update();
+	}
+	while (time_now_d() < goal) {
+		std::this_thread::yield();
+		time_update();
+	}
+}
+
+// Splits the host time since the last frame into display list processing (render) and the rest
+// (emulation), using the GPU's list timing.  Skipped frames still run lists, but not draws, so
+// only rendered frames update the render cost.
+static void UpdateFrameCosts(double now) {
+	const double listSeconds = gpuStats.secondsProcessingDisplayListsTotal;
+	const double gpuCost = std::max(0.0, listSeconds - lastListSeconds);
+	const double workCost = now - frameWorkStart;
+	const bool valid = frameWorkStart != 0.0 && !wasPaused && workCost > 0.0 && workCost < 0.25;
+	lastListSeconds = listSeconds;
+	if (!valid) {
+		return;
+	}
+
+	const double smoothing = 0.1;
+	const bool renderedFrame = (gstate_c.skipDrawReason & SKIPDRAW_SKIPFRAME) == 0;
+	if (renderedFrame) {
+		smoothedGpuCost += (gpuCost - smoothedGpuCost) * smoothing;
+	}
+	// With the GPU on a thread, the list time overlaps emulation, so this is only a lower bound.
+	const double cpuCost = std::max(0.0, workCost - gpuCost);
+	smoothedCpuCost += (cpuCost - smoothedCpuCost) * smoothing;
+}
+
+// Decides whether auto frameskip should skip this frame.  Skipping only saves render cost, so
+// there's no point when emulation alone is over budget.  Otherwise, we work out what fraction
+// of frames must be skipped to fit the budget and spread those skips out evenly, rather than
+// skipping in bursts whenever we happen to be late, which judders a lot more.
+static bool DecideAutoFrameskip(double budget, bool late) {
+	double ratio;
+	if (g_Config.bSeparateGPUThread) {
+		// Emulation and rendering overlap, the slower one sets the pace.
+		autoSkipRenderBound = smoothedGpuCost >= budget;
+		ratio = smoothedGpuCost > 0.0 ? 1.0 - budget / smoothedGpuCost : 0.0;
+	} else {
+		autoSkipRenderBound = smoothedCpuCost < budget;
+		ratio = smoothedGpuCost > 0.0 ? (smoothedCpuCost + smoothedGpuCost - budget) / smoothedGpuCost : 0.0;
+	}
+	autoSkipRatio = std::min(std::max(ratio, 0.0), 1.0);
+
+	if (!autoSkipRenderBound) {
+		autoSkipAccum = 0.0;
+		if (late) {
+			autoSkipHeldFrames++;
+		}
+		return false;
+	}
+
+	if (autoSkipRatio > 0.0) {
+		autoSkipAccum += autoSkipRatio;
+	} else if (late) {
+		// A one-off spike, skip once to catch up.
+		autoSkipAccum = 1.0;
+	}
+	if (autoSkipAccum >= 1.0) {
+		autoSkipAccum -= 1.0;
+		autoSkippedFrames++;
+		return true;
+	}
+	return false;
+}
+
 // Let's collect all the throttling and frameskipping logic here.
 static void DoFrameTiming(bool &throttle, bool &skipFrame, float timestep) {
 	PROFILE_THIS_SCOPE("timing");
@@ -542,6 +727,7 @@ static void DoFrameTiming(bool &throttle, bool &skipFrame, float timestep) {
 		nextFrameTime = std::max(lastFrameTime + scaledTimestep, time_now_d() - maxFallBehindFrames * scaledTimestep);
 	}
 	curFrameTime = time_now_d();
+	UpdateFrameCosts(curFrameTime);
 
 	if (g_Config.bLogFrameDrops) {
 		DoFrameDropLogging(scaledTimestep);
@@ -551,9 +737,9 @@ static void DoFrameTiming(bool &throttle, bool &skipFrame, float timestep) {
 	bool useAutoFrameskip = g_Config.bAutoFrameSkip && g_Config.iRenderingMode != FB_NON_BUFFERED_MODE;
 	if (g_Config.bAutoFrameSkip || (g_Config.iFrameSkip == 0 && fpsLimiter == FPS_LIMIT_CUSTOM && g_Config.iFpsLimit > 60)) {
 		// autoframeskip
-		// Argh, we are falling behind! Let's skip a frame and see if we catch up.
-		if (curFrameTime > nextFrameTime && doFrameSkip) {
-			skipFrame = true;
+		// Argh, we are falling behind! Let's skip a frame and see if we catch up, if it'll help.
+		if (doFrameSkip) {
+			skipFrame = DecideAutoFrameskip(scaledTimestep, curFrameTime > nextFrameTime);
 		}
 	} else if (g_Config.iFrameSkip >= 1) {
 		// fixed frameskip
@@ -567,23 +753,20 @@ static void DoFrameTiming(bool &throttle, bool &skipFrame, float timestep) {
 		// If time gap is huge just jump (somebody unthrottled)
 		if (nextFrameTime - curFrameTime > 2*scaledTimestep) {
 			nextFrameTime = curFrameTime;
+		} else if (g_Config.bLowLatencyPacing) {
+			// Let the frame present now, we'll wait in hleAfterFlip instead.
+			// That way the game runs (and reads input) right before the next present.
+			pendingWaitTime = nextFrameTime;
 		} else {
 			// Wait until we've caught up.
-			while (time_now_d() < nextFrameTime) {
-#ifdef _WIN32
-				sleep_ms(1); // Sleep for 1ms on this thread
-#else
-				const double left = nextFrameTime - curFrameTime;
-				usleep((long)(left * 1000000));
-#endif
-				time_update();
-			}
+			WaitUntil(nextFrameTime);
 		}
 		curFrameTime = time_now_d();
 	}
 
 	lastFrameTime = nextFrameTime;
 	wasPaused = false;
+	frameWorkStart = time_now_d();
 }
 
 static void DoFrameIdleTiming() {
@@ -611,15 +794,7 @@ static void DoFrameIdleTiming() {
 	// Give a little extra wiggle room in case the next vblank does more work.
 	const double goal = lastFrameTime + (numVBlanksSinceFlip - 1) * scaledVblank - 0.001;
 	if (numVBlanksSinceFlip >= 2 && time_now_d() < goal) {
-		while (time_now_d() < goal) {
-#ifdef _WIN32
-			sleep_ms(1);
-#else
-			const double left = goal - time_now_d();
-			usleep((long)(left * 1000000));
-#endif
-			time_update();
-		}
+		WaitUntil(goal);
 	}
 }
 
@@ -629,6 +804,9 @@ void hleEnterVblank(u64 userdata, int cyclesLate) {
 
 	VERBOSE_LOG(SCEDISPLAY, "Enter VBlank %i", vbCount);
 
+	// Lists running on the GE thread must land before we latch or flip.
+	gpu->SyncThread();
+
 	isVblank = 1;
 	vCount++; // vCount increases at each VBLANK.
 	hCountBase += hCountPerVblank; // This is the "accumulated" hcount base.
@@ -660,7 +838,9 @@ void hleEnterVblank(u64 userdata, int cyclesLate) {
 	// Trigger VBlank interrupt handlers.
 	__TriggerInterrupt(PSP_INTR_IMMEDIATE | PSP_INTR_ONLY_IF_ENABLED | PSP_INTR_ALWAYS_RESCHED, PSP_VBLANK_INTR, PSP_INTR_SUB_ALL);
 
-	numVBlanks++;
+	// Run-ahead frames are rolled back, count them once when they're emulated for real.
+	if (!PSP_CoreParameter().runningAhead)
+		numVBlanks++;
 	numVBlanksSinceFlip++;
 
 	// TODO: Should this be done here or in hleLeaveVblank?
@@ -677,6 +857,7 @@ void hleEnterVblank(u64 userdata, int cyclesLate) {
 }
 
 void __DisplayFlip(int cyclesLate) {
+	gpu->SyncThread();
 	flippedThisFrame = true;
 	// We flip only if the framebuffer was dirty. This eliminates flicker when using
 	// non-buffered rendering. The interaction with frame skipping seems to need
@@ -689,7 +870,16 @@ void __DisplayFlip(int cyclesLate) {
 	if (shaderInfo && g_Config.iRenderingMode != FB_NON_BUFFERED_MODE)
 		postEffectRequiresFlip = shaderInfo->requires60fps;
 	const bool fbDirty = gpu->FramebufferDirty();
-	if (fbDirty || noRecentFlip || postEffectRequiresFlip) {
+	if ((fbDirty || noRecentFlip || postEffectRequiresFlip) && PSP_CoreParameter().runningAhead) {
+		// No timing or stats for frames that will be rolled back.  PSP_RunAheadFrame() decides what's drawn.
+		if (coreState == CORE_RUNNING) {
+			coreState = CORE_NEXTFRAME;
+			if ((gstate_c.skipDrawReason & SKIPDRAW_SKIPFRAME) == 0)
+				gpu->CopyDisplayToOutput();
+		}
+		CoreTiming::ScheduleEvent(0 - cyclesLate, afterFlipEvent, 0);
+		numVBlanksSinceFlip = 0;
+	} else if (fbDirty || noRecentFlip || postEffectRequiresFlip) {
 		CalculateFPS();
 
 		// Let the user know if we're running slow, so they know to adjust settings.
@@ -726,6 +916,7 @@ void __DisplayFlip(int cyclesLate) {
 
 		bool throttle, skipFrame;
 		DoFrameTiming(throttle, skipFrame, (float)numVBlanksSinceFlip * timePerVblank);
+		flipPresentPending = true;
 
 		int maxFrameskip = 8;
 		if (throttle) {
@@ -750,7 +941,7 @@ void __DisplayFlip(int cyclesLate) {
 
 		CoreTiming::ScheduleEvent(0 - cyclesLate, afterFlipEvent, 0);
 		numVBlanksSinceFlip = 0;
-	} else {
+	} else if (!PSP_CoreParameter().runningAhead) {
 		// Okay, there's no new frame to draw.  But audio may be playing, so we need to time still.
 		DoFrameIdleTiming();
 	}
@@ -759,6 +950,18 @@ void __DisplayFlip(int cyclesLate) {
 void hleAfterFlip(u64 userdata, int cyclesLate) {
 	gpu->BeginFrame();  // doesn't really matter if begin or end of frame.
 
+	// The flip has been presented by now (we return here after the swap.)
+	if (flipPresentPending) {
+		flipPresentPending = false;
+		RecordPresentInterval();
+	}
+	if (pendingWaitTime != 0.0) {
+		PROFILE_THIS_SCOPE("timing");
+		WaitUntil(pendingWaitTime);
+		pendingWaitTime = 0.0;
+		frameWorkStart = time_now_d();
+	}
+
 	// This seems like as good a time as any to check if the config changed.
 	if (lagSyncScheduled != g_Config.bForceLagSync) {
 		ScheduleLagSync();
@@ -840,6 +1043,7 @@ static u32 sceDisplaySetMode(int displayMode, int displayWidth, int displayHeigh
 	}
 
 	if (!hasSetMode) {
+		gpu->SyncThread();
 		gpu->InitClear();
 		hasSetMode = true;
 	}
@@ -861,6 +1065,7 @@ void __DisplaySetFramebuf(u32 topaddr, int linesize, int pixelFormat, int sync)
 	if (sync == PSP_DISPLAY_SETBUF_IMMEDIATE) {
 		// Write immediately to the current framebuffer parameters.
 		framebuf = fbstate;
+		gpu->SyncThread();
 		gpu->SetDisplayFramebuffer(framebuf.topaddr, framebuf.stride, framebuf.fmt);
 		// IMMEDIATE means that the buffer is fine. We can just flip immediately.
 		// Doing it in non-buffered though creates problems (black screen) on occasion though
@@ -15,13 +15,20 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "thread/threadutil.h"
 #include "Common/ChunkFile.h"
+#include "Core/Config.h"
 #include "Core/CoreTiming.h"
 #include "Core/MemMapHelpers.h"
 #include "Core/Reporting.h"
 #include "Core/HLE/HLE.h"
 #include "Core/HLE/sceDmac.h"
 #include "Core/HLE/sceKernel.h"
+#include "Core/HLE/sceKernelThread.h"
 #include "Core/HLE/FunctionWrappers.h"
 #include "Core/Debugger/Breakpoints.h"
 #include "GPU/GPUInterface.h"
@@ -29,34 +36,184 @@
 
 u64 dmacMemcpyDeadline;
 
+// Smaller copies take less time than waking the thread.
+static const u32 DMAC_THREAD_MIN_SIZE = 64 * 1024;
+
+enum DmacThreadState {
+	DISABLED,
+	READY,
+	QUEUED,
+};
+struct DmacThreadCopy {
+	u8 *dst;
+	const u8 *src;
+	u32 size;
+};
+
+static std::thread *dmacThread;
+static std::mutex dmacWakeMutex;
+static std::mutex dmacDoneMutex;
+static std::condition_variable dmacWake;
+static std::condition_variable dmacDone;
+static volatile int dmacThreadState = DmacThreadState::DISABLED;
+static DmacThreadCopy dmacThreadCopy;
+static int dmacCopyEvent = -1;
+
+static int __DmacThread() {
+	setCurrentThreadName("DMAC");
+
+	std::unique_lock<std::mutex> guard(dmacWakeMutex);
+	while (dmacThreadState != DmacThreadState::DISABLED) {
+		if (dmacThreadState != DmacThreadState::QUEUED)
+			dmacWake.wait(guard);
+		if (dmacThreadState == DmacThreadState::QUEUED) {
+			memcpy(dmacThreadCopy.dst, dmacThreadCopy.src, dmacThreadCopy.size);
+
+			dmacDoneMutex.lock();
+			dmacThreadState = DmacThreadState::READY;
+			dmacDone.notify_one();
+			dmacDoneMutex.unlock();
+		}
+	}
+	return 0;
+}
+
+void __DmacSync() {
+	if (dmacThreadState == DmacThreadState::DISABLED)
+		return;
+
+	{
+		std::unique_lock<std::mutex> guard(dmacDoneMutex);
+		while (dmacThreadState == DmacThreadState::QUEUED)
+			dmacDone.wait(guard);
+	}
+	// Only this thread queues, so the copy params are ours again.
+	if (dmacThreadCopy.size != 0) {
+		Memory::FinishHostWrite(dmacThreadCopy.dst, dmacThreadCopy.size);
+		dmacThreadCopy.size = 0;
+	}
+}
+
+static void __DmacEnqueueCopy(u8 *dst, const u8 *src, u32 size) {
+	// Can't fault on another thread for rewind's write tracking (or the debugger's watches.)
+	Memory::PrepareHostWrite(dst, size);
+	dmacThreadCopy.dst = dst;
+	dmacThreadCopy.src = src;
+	dmacThreadCopy.size = size;
+
+	dmacWakeMutex.lock();
+	dmacThreadState = DmacThreadState::QUEUED;
+	dmacWake.notify_one();
+	dmacWakeMutex.unlock();
+}
+
+static void __DmacDisableThread() {
+	if (dmacThreadState != DmacThreadState::DISABLED) {
+		__DmacSync();
+		dmacWakeMutex.lock();
+		dmacThreadState = DmacThreadState::DISABLED;
+		dmacWake.notify_one();
+		dmacWakeMutex.unlock();
+		dmacThread->join();
+		delete dmacThread;
+		dmacThread = nullptr;
+	}
+}
+
+static void __DmacCopyFinish(u64 userdata, int cycleslate) {
+	u32 error;
+	SceUID threadID = (SceUID)userdata;
+	SceUID verify = __KernelGetWaitID(threadID, WAITTYPE_HLEDELAY, error);
+	u64 result = __KernelGetWaitValue(threadID, error);
+
+	// The copy must have landed by the time the PSP would have finished it.
+	__DmacSync();
+
+	if (error == 0 && verify == 1) {
+		__KernelResumeThreadFromWait(threadID, result);
+		__KernelReSchedule("woke from dmac copy");
+	} else {
+		WARN_LOG(HLE, "Someone else woke up DMAC-blocked thread?");
+	}
+}
+
 void __DmacInit() {
 	dmacMemcpyDeadline = 0;
+	dmacThreadCopy.size = 0;
+	dmacCopyEvent = CoreTiming::RegisterEvent("DmacCopy", __DmacCopyFinish);
+
+	if (g_Config.bSeparateDmacThread) {
+		dmacThreadState = DmacThreadState::READY;
+		dmacThread = new std::thread(__DmacThread);
+	} else {
+		dmacThreadState = DmacThreadState::DISABLED;
+	}
 }
 
 void __DmacDoState(PointerWrap &p) {
-	auto s = p.Section("sceDmac", 0, 1);
+	auto s = p.Section("sceDmac", 0, 2);
 	if (s == 0) {
 		dmacMemcpyDeadline = 0;
 		return;
 	}
 
+	// Don't want to save (or load over) a copy in progress.
+	__DmacSync();
 	p.Do(dmacMemcpyDeadline);
+
+	if (s >= 2) {
+		p.Do(dmacCopyEvent);
+		CoreTiming::RestoreRegisterEvent(dmacCopyEvent, "DmacCopy", __DmacCopyFinish);
+	} else {
+		// Older states can't have the event scheduled, so copy on this thread.
+		dmacCopyEvent = -1;
+		__DmacDisableThread();
+	}
+}
+
+void __DmacShutdown() {
+	__DmacDisableThread();
 }
 
 static int __DmacMemcpy(u32 dst, u32 src, u32 size) {
+	// Seems like a copy doesn't start until the previous one finishes.
+	__DmacSync();
+
+	bool vram = Memory::IsVRAMAddress(src) || Memory::IsVRAMAddress(dst);
 	bool skip = false;
-	if (Memory::IsVRAMAddress(src) || Memory::IsVRAMAddress(dst)) {
+	if (vram) {
 		skip = gpu->PerformMemoryCopy(dst, src, size);
 	}
+
+	// This number seems strangely reproducible.
+	// Approx. 225 MiB/s or 235929600 B/s, so let's go with 236 B/us.
+	int delayUs = size / 236;
+
+	// VRAM stays here, since the framebuffer manager may have just copied it for us.
+	if (!skip && !vram && size >= DMAC_THREAD_MIN_SIZE && dmacThreadState == DmacThreadState::READY && dmacCopyEvent != -1 && __KernelIsDispatchEnabled()) {
+		u8 *dstp = Memory::GetPointer(dst);
+		const u8 *srcp = Memory::GetPointer(src);
+		if (dstp && srcp) {
+			currentMIPS->InvalidateICache(dst, size);
+#ifndef MOBILE_DEVICE
+			CBreakPoints::ExecMemCheck(dst, true, size, currentMIPS->pc);
+#endif
+			__DmacEnqueueCopy(dstp, srcp, size);
+
+			// Other threads run meanwhile, and the caller wakes once the copy is done.
+			dmacMemcpyDeadline = CoreTiming::GetTicks() + usToCycles(delayUs);
+			CoreTiming::ScheduleEvent(usToCycles(delayUs), dmacCopyEvent, __KernelGetCurThread());
+			__KernelWaitCurThread(WAITTYPE_HLEDELAY, 1, 0, 0, false, "dmac copy");
+			return 0;
+		}
+	}
+
 	if (!skip) {
 		Memory::Memcpy(dst, Memory::GetPointer(src), size);
 		currentMIPS->InvalidateICache(dst, size);
 	}
 
-	// This number seems strangely reproducible.
 	if (size >= 272) {
-		// Approx. 225 MiB/s or 235929600 B/s, so let's go with 236 B/us.
-		int delayUs = size / 236;
 		dmacMemcpyDeadline = CoreTiming::GetTicks() + usToCycles(delayUs);
 		return hleDelayResult(0, "dmac copy", delayUs);
 	}
@@ -21,5 +21,8 @@ class PointerWrap;
 
 void __DmacInit();
 void __DmacDoState(PointerWrap &p);
+void __DmacShutdown();
+// Waits for any copy still running on the DMAC thread, before something else reads it.
+void __DmacSync();
 
 void Register_sceDmac();
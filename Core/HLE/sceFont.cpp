@@ -5,9 +5,11 @@
 #include <cmath>
 #include <vector>
 #include <map>
+#include <memory>
 #include <algorithm>
 
 #include "Common/ChunkFile.h"
+#include "Common/ThreadPools.h"
 #include "Core/HLE/HLE.h"
 #include "Core/HLE/FunctionWrappers.h"
 #include "Core/HLE/sceFont.h"
@@ -117,6 +119,15 @@ int GetInternalFontIndex(Font *font);
 
 // These should not need to be state saved.
 static std::vector<Font *> internalFonts;
+// Internal fonts from flash0 or ms0 are kept parsed across game boots, since they rarely change.
+struct CachedInternalFont {
+	s64 size;
+	tm mtime;
+	std::unique_ptr<Font> font;
+};
+static std::map<std::string, CachedInternalFont> internalFontCache;
+// Parsing the internal fonts runs in the background from __FontInit, while the game loads.
+static TaskGroup internalFontsLoading;
 // However, these we must save - but we could take a shortcut
 // for LoadedFonts that point to internal fonts.
 static std::map<u32, LoadedFont *> fontMap;
@@ -635,6 +646,29 @@ static LoadedFont *GetLoadedFont(u32 handle, bool allowClosed) {
 	}
 }
 
+static bool SameModifiedTime(const tm &a, const tm &b) {
+	return a.tm_year == b.tm_year && a.tm_mon == b.tm_mon && a.tm_mday == b.tm_mday &&
+		a.tm_hour == b.tm_hour && a.tm_min == b.tm_min && a.tm_sec == b.tm_sec;
+}
+
+static Font *FindCachedInternalFont(const std::string &filename, const PSPFileInfo &info) {
+	auto it = internalFontCache.find(filename);
+	if (it == internalFontCache.end())
+		return nullptr;
+	const CachedInternalFont &cache = it->second;
+	if (cache.size != info.size || !SameModifiedTime(cache.mtime, info.mtime))
+		return nullptr;
+	return cache.font.get();
+}
+
+static bool IsCachedInternalFont(const Font *font) {
+	for (auto &it : internalFontCache) {
+		if (it.second.font.get() == font)
+			return true;
+	}
+	return false;
+}
+
 static void __LoadInternalFonts() {
 	if (internalFonts.size()) {
 		// Fonts already loaded.
@@ -682,14 +716,30 @@ static void __LoadInternalFonts() {
 		}
 
 		if (info.exists) {
+			// User fonts differ per game, so only the others are cached.
+			bool cacheable = fontFilename.compare(0, userfontPath.size(), userfontPath) != 0;
+			Font *cached = cacheable ? FindCachedInternalFont(fontFilename, info) : nullptr;
+			if (cached) {
+				DEBUG_LOG(SCEFONT, "Using cached internal font %s", fontFilename.c_str());
+				internalFonts.push_back(cached);
+				continue;
+			}
+
 			DEBUG_LOG(SCEFONT, "Loading internal font %s (%i bytes)", fontFilename.c_str(), (int)info.size);
 			std::vector<u8> buffer;
 			if (pspFileSystem.ReadEntireFile(fontFilename, buffer) < 0) {
 				ERROR_LOG(SCEFONT, "Failed opening font");
 				continue;
 			}
-			
-			internalFonts.push_back(new Font(buffer, entry));
+
+			Font *font = new Font(buffer, entry);
+			if (cacheable) {
+				CachedInternalFont &cache = internalFontCache[fontFilename];
+				cache.size = info.size;
+				cache.mtime = info.mtime;
+				cache.font.reset(font);
+			}
+			internalFonts.push_back(font);
 
 			DEBUG_LOG(SCEFONT, "Loaded font %s", fontFilename.c_str());
 		} else if (!entry.ignoreIfMissing) {
@@ -698,6 +748,12 @@ static void __LoadInternalFonts() {
 	}
 }
 
+// Anything touching internalFonts must go through this, in case the preload is still running.
+static void __WaitInternalFonts() {
+	GlobalThreadPool::Wait(internalFontsLoading);
+	__LoadInternalFonts();
+}
+
 int GetInternalFontIndex(Font *font) {
 	for (size_t i = 0; i < internalFonts.size(); i++) {
 		if (internalFonts[i] == font)
@@ -709,9 +765,16 @@ int GetInternalFontIndex(Font *font) {
 void __FontInit() {
 	actionPostAllocCallback = __KernelRegisterActionType(PostAllocCallback::Create);
 	actionPostOpenCallback = __KernelRegisterActionType(PostOpenCallback::Create);
+
+	// The filesystems are mounted by now.  Most games open the font library during boot, and
+	// parsing every PGF takes a while, so get it out of the way while the executable loads.
+	GlobalThreadPool::Run(internalFontsLoading, [] {
+		__LoadInternalFonts();
+	});
 }
 
 void __FontShutdown() {
+	GlobalThreadPool::Wait(internalFontsLoading);
 	for (auto iter = fontMap.begin(); iter != fontMap.end(); iter++) {
 		FontLib *fontLib = iter->second->GetFontLib();
 		if (fontLib)
@@ -725,7 +788,9 @@ void __FontShutdown() {
 	fontLibList.clear();
 	fontLibMap.clear();
 	for (auto iter = internalFonts.begin(); iter != internalFonts.end(); ++iter) {
-		delete *iter;
+		// Cached ones stay parsed for the next game.
+		if (!IsCachedInternalFont(*iter))
+			delete *iter;
 	}
 	internalFonts.clear();
 }
@@ -735,7 +800,7 @@ void __FontDoState(PointerWrap &p) {
 	if (!s)
 		return;
 
-	__LoadInternalFonts();
+	__WaitInternalFonts();
 
 	p.Do(fontLibList);
 	p.Do(fontLibMap);
@@ -748,8 +813,8 @@ void __FontDoState(PointerWrap &p) {
 }
 
 static u32 sceFontNewLib(u32 paramPtr, u32 errorCodePtr) {
-	// Lazy load internal fonts, only when font library first inited.
-	__LoadInternalFonts();
+	// Internal fonts are preloaded from __FontInit, but may not be done yet.
+	__WaitInternalFonts();
 
 	auto params = PSPPointer<FontNewLibParams>::Create(paramPtr);
 	auto errorCode = PSPPointer<u32>::Create(errorCodePtr);
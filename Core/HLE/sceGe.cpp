@@ -29,6 +29,7 @@
 #include "Core/MemMapHelpers.h"
 #include "Core/Reporting.h"
 #include "Core/System.h"
+#include "Core/HLE/sceDmac.h"
 #include "Core/HLE/sceGe.h"
 #include "Core/HLE/sceKernelMemory.h"
 #include "Core/HLE/sceKernelThread.h"
@@ -336,6 +337,8 @@ u32 sceGeListEnQueue(u32 listAddress, u32 stallAddress, int callbackId, u32 optP
 			listAddress, stallAddress, callbackId, optParamAddr);
 	auto optParam = PSPPointer<PspGeListArgs>::Create(optParamAddr);
 
+	// The list may draw from memory a DMA copy is still filling.
+	__DmacSync();
 	u32 listID = gpu->EnqueueList(listAddress, stallAddress, __GeSubIntrBase(callbackId), optParam, false);
 	if ((int)listID >= 0)
 		listID = LIST_ID_MAGIC ^ listID;
@@ -352,6 +355,8 @@ u32 sceGeListEnQueueHead(u32 listAddress, u32 stallAddress, int callbackId, u32
 			listAddress, stallAddress, callbackId, optParamAddr);
 	auto optParam = PSPPointer<PspGeListArgs>::Create(optParamAddr);
 
+	// The list may draw from memory a DMA copy is still filling.
+	__DmacSync();
 	u32 listID = gpu->EnqueueList(listAddress, stallAddress, __GeSubIntrBase(callbackId), optParam, true);
 	if ((int)listID >= 0)
 		listID = LIST_ID_MAGIC ^ listID;
@@ -376,6 +381,7 @@ static int sceGeListUpdateStallAddr(u32 displayListID, u32 stallAddress) {
 	CoreTiming::ForceCheck();
 
 	DEBUG_LOG(SCEGE, "sceGeListUpdateStallAddr(dlid=%i, stalladdr=%08x)", displayListID, stallAddress);
+	__DmacSync();
 	return gpu->UpdateStall(LIST_ID_MAGIC ^ displayListID, stallAddress);
 }
 
@@ -529,6 +535,7 @@ static int sceGeGetMtx(int type, u32 matrixPtr) {
 	}
 
 	INFO_LOG(SCEGE, "sceGeGetMtx(%d, %08x)", type, matrixPtr);
+	gpu->SyncThread();
 	switch (type) {
 	case GE_MTX_BONE0:
 	case GE_MTX_BONE1:
@@ -563,6 +570,7 @@ static int sceGeGetMtx(int type, u32 matrixPtr) {
 
 static u32 sceGeGetCmd(int cmd) {
 	INFO_LOG(SCEGE, "sceGeGetCmd(%i)", cmd);
+	gpu->SyncThread();
 	if (cmd >= 0 && cmd < (int)ARRAY_SIZE(gstate.cmdmem)) {
 		return gstate.cmdmem[cmd];  // Does not mask away the high bits.
 	} else {
@@ -34,6 +34,10 @@
 
 #include <algorithm>
 
+#ifdef _M_SSE
+#include <emmintrin.h>
+#endif
+
 static int mjpegWidth, mjpegHeight;
 
 void __JpegInit() {
@@ -70,6 +74,62 @@ static u32 convertYCbCrToABGR (int y, int cb, int cr) {
 	return 0xFF000000 | (b << 16) | (g << 8) | (r << 0);
 }
 
+#ifdef _M_SSE
+// Same math as convertYCbCrToABGR() on 16 pixels, which share 4 Cb and Cr samples.
+static inline void __JpegCsc16SSE2(u32 *dest, const u8 *Y, const u8 *Cb, const u8 *Cr) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i c128 = _mm_set1_epi16(128);
+	const __m128i alpha = _mm_set1_epi8((char)0xFF);
+
+	// Each chroma sample covers 4 pixels.
+	__m128i cb8 = _mm_cvtsi32_si128(*(const u32_le *)Cb);
+	__m128i cr8 = _mm_cvtsi32_si128(*(const u32_le *)Cr);
+	cb8 = _mm_unpacklo_epi16(_mm_unpacklo_epi8(cb8, cb8), _mm_unpacklo_epi8(cb8, cb8));
+	cr8 = _mm_unpacklo_epi16(_mm_unpacklo_epi8(cr8, cr8), _mm_unpacklo_epi8(cr8, cr8));
+	const __m128i y8 = _mm_loadu_si128((const __m128i *)Y);
+
+	__m128i rgb8[3];
+	for (int half = 0; half < 2; ++half) {
+		__m128i y, cb, cr;
+		if (half == 0) {
+			y = _mm_unpacklo_epi8(y8, zero);
+			cb = _mm_sub_epi16(_mm_unpacklo_epi8(cb8, zero), c128);
+			cr = _mm_sub_epi16(_mm_unpacklo_epi8(cr8, zero), c128);
+		} else {
+			y = _mm_unpackhi_epi8(y8, zero);
+			cb = _mm_sub_epi16(_mm_unpackhi_epi8(cb8, zero), c128);
+			cr = _mm_sub_epi16(_mm_unpackhi_epi8(cr8, zero), c128);
+		}
+
+		__m128i r = _mm_add_epi16(_mm_add_epi16(y, cr), _mm_add_epi16(_mm_add_epi16(_mm_srai_epi16(cr, 2), _mm_srai_epi16(cr, 3)), _mm_srai_epi16(cr, 5)));
+		__m128i gcb = _mm_add_epi16(_mm_add_epi16(_mm_srai_epi16(cb, 2), _mm_srai_epi16(cb, 4)), _mm_srai_epi16(cb, 5));
+		__m128i gcr = _mm_add_epi16(_mm_add_epi16(_mm_srai_epi16(cr, 1), _mm_srai_epi16(cr, 3)), _mm_add_epi16(_mm_srai_epi16(cr, 4), _mm_srai_epi16(cr, 5)));
+		__m128i g = _mm_sub_epi16(_mm_sub_epi16(y, gcb), gcr);
+		__m128i b = _mm_add_epi16(_mm_add_epi16(y, cb), _mm_add_epi16(_mm_add_epi16(_mm_srai_epi16(cb, 1), _mm_srai_epi16(cb, 2)), _mm_srai_epi16(cb, 6)));
+
+		// The saturating pack does the clamping to 0-255.
+		if (half == 0) {
+			rgb8[0] = r;
+			rgb8[1] = g;
+			rgb8[2] = b;
+		} else {
+			rgb8[0] = _mm_packus_epi16(rgb8[0], r);
+			rgb8[1] = _mm_packus_epi16(rgb8[1], g);
+			rgb8[2] = _mm_packus_epi16(rgb8[2], b);
+		}
+	}
+
+	const __m128i rgLo = _mm_unpacklo_epi8(rgb8[0], rgb8[1]);
+	const __m128i rgHi = _mm_unpackhi_epi8(rgb8[0], rgb8[1]);
+	const __m128i baLo = _mm_unpacklo_epi8(rgb8[2], alpha);
+	const __m128i baHi = _mm_unpackhi_epi8(rgb8[2], alpha);
+	_mm_storeu_si128((__m128i *)dest + 0, _mm_unpacklo_epi16(rgLo, baLo));
+	_mm_storeu_si128((__m128i *)dest + 1, _mm_unpackhi_epi16(rgLo, baLo));
+	_mm_storeu_si128((__m128i *)dest + 2, _mm_unpacklo_epi16(rgHi, baHi));
+	_mm_storeu_si128((__m128i *)dest + 3, _mm_unpackhi_epi16(rgHi, baHi));
+}
+#endif
+
 static void __JpegCsc(u32 imageAddr, u32 yCbCrAddr, int widthHeight, int bufferWidth) {
 	int height = widthHeight & 0xFFF;
 	int width = (widthHeight >> 16) & 0xFFF;
@@ -83,7 +143,15 @@ static void __JpegCsc(u32 imageAddr, u32 yCbCrAddr, int widthHeight, int bufferW
 	u8 *Cr = Cb + sizeCb;
 
 	for (int y = 0; y < height; ++y) {
-		for (int x = 0; x < width; x += 4) {
+		int x = 0;
+#ifdef _M_SSE
+		for (; x + 16 <= width; x += 16) {
+			__JpegCsc16SSE2(imageBuffer + x, Y + x, Cb, Cr);
+			Cb += 4;
+			Cr += 4;
+		}
+#endif
+		for (; x < width; x += 4) {
 			u8 y0 =  Y[x + 0];
 			u8 y1 =  Y[x + 1];
 			u8 y2 =  Y[x + 2];
@@ -120,17 +188,31 @@ static u32 convertARGBtoABGR(u32 argb) {
 	return ((argb & 0xFF00FF00)) | ((argb & 0x000000FF) << 16) | ((argb & 0x00FF0000) >> 16);
 }
 
-static int __DecodeJpeg(u32 jpegAddr, int jpegSize, u32 imageAddr) {
-	u8 *buf = Memory::GetPointer(jpegAddr);
-	int width, height, actual_components;
-	unsigned char *jpegBuf = jpgd::decompress_jpeg_image_from_memory(buf, jpegSize, &width, &height, &actual_components, 3);
+// Reads just the header, without decoding the image.
+static bool __JpegGetInfo(u32 jpegAddr, int jpegSize, int *width, int *height, int *components) {
+	jpgd::jpeg_decoder_mem_stream stream(Memory::GetPointer(jpegAddr), jpegSize);
+	jpgd::jpeg_decoder decoder(&stream);
+	if (decoder.get_error_code() != jpgd::JPGD_SUCCESS) {
+		return false;
+	}
+	*width = decoder.get_width();
+	*height = decoder.get_height();
+	*components = decoder.get_num_components();
+	return true;
+}
 
-	if (actual_components != 3) {
-		// The assumption that the image was RGB was wrong...
-		// Try again.
-		int components = actual_components;
-		jpegBuf = jpgd::decompress_jpeg_image_from_memory(buf, jpegSize, &width, &height, &actual_components, components);
+// Decodes to the image's own component count, which used to take two decodes to find out.
+static unsigned char *__JpegDecompress(u32 jpegAddr, int jpegSize, int *width, int *height, int *actual_components) {
+	int components;
+	if (!__JpegGetInfo(jpegAddr, jpegSize, width, height, &components)) {
+		components = 3;
 	}
+	return jpgd::decompress_jpeg_image_from_memory(Memory::GetPointer(jpegAddr), jpegSize, width, height, actual_components, components);
+}
+
+static int __DecodeJpeg(u32 jpegAddr, int jpegSize, u32 imageAddr) {
+	int width, height, actual_components;
+	unsigned char *jpegBuf = __JpegDecompress(jpegAddr, jpegSize, &width, &height, &actual_components);
 
 	if (jpegBuf == NULL) {
 		return getWidthHeight(0, 0);
@@ -207,23 +289,12 @@ static int getYCbCrBufferSize(int w, int h) {
 }
 
 static int __JpegGetOutputInfo(u32 jpegAddr, int jpegSize, u32 colourInfoAddr) {
-	u8 *buf = Memory::GetPointer(jpegAddr);
+	// Only the size is needed, no reason to decode the whole thing.
 	int width, height, actual_components;
-	unsigned char *jpegBuf = jpgd::decompress_jpeg_image_from_memory(buf, jpegSize, &width, &height, &actual_components, 3);
-
-	if (actual_components != 3) {
-	// The assumption that the image was RGB was wrong...
-	// Try again.
-		int components = actual_components;
-		jpegBuf = jpgd::decompress_jpeg_image_from_memory(buf, jpegSize, &width, &height, &actual_components, components);
-	}
-
-	if (jpegBuf == NULL) {
+	if (!__JpegGetInfo(jpegAddr, jpegSize, &width, &height, &actual_components)) {
 		ERROR_LOG(ME, "sceJpegGetOutputInfo: Bad JPEG data");
 		return getYCbCrBufferSize(0, 0);
 	}
-
-	free(jpegBuf);
 	
 	// Buffer to store info about the color space in use.
 	// - Bits 24 to 32 (Always empty): 0x00
@@ -313,16 +384,8 @@ static int __JpegConvertRGBToYCbCr (const void *data, u32 bufferOutputAddr, int
 }
 
 static int __JpegDecodeMJpegYCbCr(u32 jpegAddr, int jpegSize, u32 yCbCrAddr) {
-	u8 *buf = Memory::GetPointer(jpegAddr);
 	int width, height, actual_components;
-	unsigned char *jpegBuf = jpgd::decompress_jpeg_image_from_memory(buf, jpegSize, &width, &height, &actual_components, 3);
-
-	if (actual_components != 3) {
-		// The assumption that the image was RGB was wrong...
-		// Try again.
-		int components = actual_components;
-		jpegBuf = jpgd::decompress_jpeg_image_from_memory(buf, jpegSize, &width, &height, &actual_components, components);
-	}
+	unsigned char *jpegBuf = __JpegDecompress(jpegAddr, jpegSize, &width, &height, &actual_components);
 
 	if (jpegBuf == NULL) {
 		return getWidthHeight(0, 0);
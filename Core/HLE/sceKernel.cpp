@@ -18,6 +18,7 @@
 #include "Core/Core.h"
 #include "Core/Config.h"
 #include "Core/CwCheat.h"
+#include "Core/Debugger/SamplingProfiler.h"
 #include "Core/MemMapHelpers.h"
 #include "Core/HLE/HLE.h"
 #include "Core/HLE/FunctionWrappers.h"
@@ -80,6 +81,7 @@
 #include "sceVaudio.h"
 #include "sceHeap.h"
 #include "sceDmac.h"
+#include "sceDeflt.h"
 #include "sceMp4.h"
 
 #include "../Util/PPGeDraw.h"
@@ -138,8 +140,10 @@ void __KernelInit()
 	__NetAdhocInit();
 	__VaudioInit();
 	__CheatInit();
+	SamplingProfiler::Init();
 	__HeapInit();
 	__DmacInit();
+	__DefltInit();
 	__AudioCodecInit();
 	__VideoPmpInit();
 	__UsbGpsInit();
@@ -182,6 +186,8 @@ void __KernelShutdown()
 	__UtilityShutdown();
 	__GeShutdown();
 	__SasShutdown();
+	__DmacShutdown();
+	__DefltShutdown();
 	__DisplayShutdown();
 	__AtracShutdown();
 	__AudioShutdown();
@@ -191,6 +197,7 @@ void __KernelShutdown()
 	__KernelMemoryShutdown();
 	__InterruptsShutdown();
 	__CheatShutdown();
+	SamplingProfiler::Shutdown();
 	__KernelModuleShutdown();
 
 	CoreTiming::ClearPendingEvents();
@@ -272,6 +279,7 @@ void __KernelDoState(PointerWrap &p)
 		__VideoPmpDoState(p);
 		__AACDoState(p);
 		__UsbGpsDoState(p);
+		__DefltDoState(p);
 
 		// IMPORTANT! Add new sections last!
 	}
@@ -456,6 +464,7 @@ void KernelObject::GetQuickInfo(char *ptr, int size)
 
 KernelObjectPool::KernelObjectPool() {
 	memset(occupied, 0, sizeof(bool)*maxCount);
+	memset(idTypes, 0, sizeof(idTypes));
 	nextID = initialNextID;
 }
 
@@ -470,6 +479,7 @@ SceUID KernelObjectPool::Create(KernelObject *obj, int rangeBottom, int rangeTop
 			occupied[i] = true;
 			pool[i] = obj;
 			pool[i]->uid = i + handleOffset;
+			idTypes[i] = obj->GetIDType();
 			return i + handleOffset;
 		}
 	}
@@ -493,6 +503,7 @@ void KernelObjectPool::Clear() {
 			delete pool[i];
 		pool[i] = nullptr;
 		occupied[i] = false;
+		idTypes[i] = 0;
 	}
 	nextID = initialNextID;
 }
@@ -555,6 +566,7 @@ void KernelObjectPool::DoState(PointerWrap &p) {
 				return;
 
 			pool[i]->uid = i + handleOffset;
+			idTypes[i] = pool[i]->GetIDType();
 		} else {
 			type = pool[i]->GetIDType();
 			p.Do(type);
@@ -439,6 +439,7 @@ class KernelObjectPool {
 		u32 error;
 		if (Get<T>(handle, error)) {
 			occupied[handle-handleOffset] = false;
+			idTypes[handle-handleOffset] = 0;
 			delete pool[handle-handleOffset];
 			// Why weren't we zeroing before?
 			pool[handle-handleOffset] = nullptr;
@@ -450,6 +451,13 @@ class KernelObjectPool {
 
 	template <class T>
 	T* Get(SceUID handle, u32 &outError) {
+		// Fast path: the type of each slot is cached, so one compare checks both the handle and type.
+		const u32 index = (u32)(handle - handleOffset);
+		if (index < (u32)maxCount && idTypes[index] == T::GetStaticIDType()) {
+			outError = SCE_KERNEL_ERROR_OK;
+			return static_cast<T *>(pool[index]);
+		}
+
 		if (handle < handleOffset || handle >= handleOffset+maxCount || !occupied[handle-handleOffset]) {
 			// Tekken 6 spams 0x80020001 gets wrong with no ill effects, also on the real PSP
 			if (handle != 0 && (u32)handle != 0x80020001) {
@@ -484,10 +492,8 @@ class KernelObjectPool {
 	void Iterate(bool func(T *, ArgT), ArgT arg) {
 		int type = T::GetStaticIDType();
 		for (int i = 0; i < maxCount; i++) {
-			if (!occupied[i])
-				continue;
-			T *t = static_cast<T *>(pool[i]);
-			if (t->GetIDType() == type) {
+			if (idTypes[i] == type) {
+				T *t = static_cast<T *>(pool[i]);
 				if (!func(t, arg))
 					break;
 			}
@@ -497,10 +503,7 @@ class KernelObjectPool {
 	int ListIDType(int type, SceUID *uids, int count) const {
 		int total = 0;
 		for (int i = 0; i < maxCount; i++) {
-			if (!occupied[i]) {
-				continue;
-			}
-			if (pool[i]->GetIDType() == type) {
+			if (idTypes[i] == type) {
 				if (total < count) {
 					*uids++ = pool[i]->GetUID();
 				}
@@ -515,8 +518,7 @@ class KernelObjectPool {
 			ERROR_LOG(SCEKERNEL, "Kernel: Bad object handle %i (%08x)", handle, handle);
 			return false;
 		}
-		KernelObject *t = pool[handle - handleOffset];
-		*type = t->GetIDType();
+		*type = idTypes[handle - handleOffset];
 		return true;
 	}
 
@@ -532,6 +534,8 @@ class KernelObjectPool {
 	};
 	KernelObject *pool[maxCount];
 	bool occupied[maxCount];
+	// GetIDType() of each object, cached so lookups don't need a virtual call.  0 when free.
+	int idTypes[maxCount];
 	int nextID;
 };
 
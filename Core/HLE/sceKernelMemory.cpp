@@ -20,6 +20,7 @@
 #include <vector>
 #include <map>
 
+#include "Common/BitSet.h"
 #include "Common/ChunkFile.h"
 #include "Core/HLE/HLE.h"
 #include "Core/HLE/FunctionWrappers.h"
@@ -86,7 +87,7 @@ struct NativeFPL
 //FPL - Fixed Length Dynamic Memory Pool - every item has the same length
 struct FPL : public KernelObject
 {
-	FPL() : blocks(NULL), nextBlock(0) {}
+	FPL() : blocks(NULL), nextBlock(0), freeCount(0) {}
 	~FPL() {
 		if (blocks != NULL) {
 			delete [] blocks;
@@ -98,26 +99,60 @@ struct FPL : public KernelObject
 	static int GetStaticIDType() { return SCE_KERNEL_TMID_Fpl; }
 	int GetIDType() const override { return SCE_KERNEL_TMID_Fpl; }
 
-	int findFreeBlock() {
+	// Call after changing blocks directly.
+	void rebuildFreeMask() {
+		freeMask.assign((nf.numBlocks + 63) / 64, 0);
+		freeCount = 0;
 		for (int i = 0; i < nf.numBlocks; i++) {
-			int b = nextBlock++ % nf.numBlocks;
-			if (!blocks[b]) {
-				return b;
+			if (!blocks[i]) {
+				freeMask[i >> 6] |= 1ULL << (i & 63);
+				++freeCount;
+			}
+		}
+	}
+
+	int findFreeInRange(int from, int end) const {
+		while (from < end) {
+			u64 bits = freeMask[from >> 6] >> (from & 63);
+			if (bits != 0) {
+				int b = from + LeastSignificantSetBit(bits);
+				return b < end ? b : -1;
 			}
+			from = (from | 63) + 1;
 		}
 		return -1;
 	}
 
+	int findFreeBlock() {
+		// Checks blocks in turn starting at nextBlock, like the PSP, but a word at a time.
+		if (freeCount == 0) {
+			nextBlock += nf.numBlocks;
+			return -1;
+		}
+		int start = nextBlock % nf.numBlocks;
+		int b = findFreeInRange(start, nf.numBlocks);
+		if (b < 0)
+			b = findFreeInRange(0, start);
+		// nextBlock moves past every block that was checked.
+		nextBlock += (b - start + nf.numBlocks) % nf.numBlocks + 1;
+		return b;
+	}
+
 	int allocateBlock() {
 		int block = findFreeBlock();
-		if (block >= 0)
+		if (block >= 0) {
 			blocks[block] = true;
+			freeMask[block >> 6] &= ~(1ULL << (block & 63));
+			--freeCount;
+		}
 		return block;
 	}
 	
 	bool freeBlock(int b) {
 		if (blocks[b]) {
 			blocks[b] = false;
+			freeMask[b >> 6] |= 1ULL << (b & 63);
+			++freeCount;
 			return true;
 		}
 		return false;
@@ -139,6 +174,9 @@ struct FPL : public KernelObject
 		FplWaitingThread dv = {0};
 		p.Do(waitingThreads, dv);
 		p.Do(pausedWaits);
+
+		if (p.mode == p.MODE_READ)
+			rebuildFreeMask();
 	}
 
 	NativeFPL nf;
@@ -146,6 +184,9 @@ struct FPL : public KernelObject
 	u32 address;
 	int alignedSize;
 	int nextBlock;
+	// Not saved, derived from blocks.  Bit set means free.
+	std::vector<u64> freeMask;
+	int freeCount;
 	std::vector<FplWaitingThread> waitingThreads;
 	// Key is the callback id it was for, or if no callback, the thread id.
 	std::map<SceUID, FplWaitingThread> pausedWaits;
@@ -653,6 +694,7 @@ int sceKernelCreateFpl(const char *name, u32 mpid, u32 attr, u32 blockSize, u32
 
 	fpl->blocks = new bool[fpl->nf.numBlocks];
 	memset(fpl->blocks, 0, fpl->nf.numBlocks * sizeof(bool));
+	fpl->rebuildFreeMask();
 	fpl->address = address;
 	fpl->alignedSize = alignedSize;
 
@@ -878,12 +920,7 @@ int sceKernelReferFplStatus(SceUID uid, u32 statusPtr)
 		// Refresh waiting threads and free block count.
 		__KernelSortFplThreads(fpl);
 		fpl->nf.numWaitThreads = (int) fpl->waitingThreads.size();
-		fpl->nf.numFreeBlocks = 0;
-		for (int i = 0; i < (int)fpl->nf.numBlocks; ++i)
-		{
-			if (!fpl->blocks[i])
-				++fpl->nf.numFreeBlocks;
-		}
+		fpl->nf.numFreeBlocks = fpl->freeCount;
 		if (Memory::Read_U32(statusPtr) != 0)
 			Memory::WriteStruct(statusPtr, &fpl->nf);
 		return 0;
@@ -18,6 +18,9 @@
 #include <fstream>
 #include <algorithm>
 #include <set>
+#include <unordered_map>
+
+#include "ext/xxhash.h"
 
 #include "base/stringutil.h"
 #include "Common/ChunkFile.h"
@@ -35,6 +38,7 @@
 #include "Core/MIPS/MIPS.h"
 #include "Core/MIPS/MIPSAnalyst.h"
 #include "Core/MIPS/MIPSCodeUtils.h"
+#include "Core/MIPS/JitCommon/JitCommon.h"
 #include "Core/ELF/ElfReader.h"
 #include "Core/ELF/PBPReader.h"
 #include "Core/ELF/PrxDecrypter.h"
@@ -152,6 +156,41 @@ void UnexportFuncSymbol(const FuncSymbolExport &func);
 class Module;
 static bool KernelImportModuleFuncs(Module *module, u32 *firstImportStubAddr, bool reimporting = false);
 
+// Where each (module name, nid) is imported and exported, so linking doesn't scan every module.
+struct SymbolKey {
+	bool operator ==(const SymbolKey &other) const {
+		return nid == other.nid && moduleName == other.moduleName;
+	}
+
+	std::string moduleName;
+	u32 nid;
+};
+
+struct SymbolKeyHash {
+	size_t operator ()(const SymbolKey &key) const {
+		return std::hash<std::string>()(key.moduleName) ^ (key.nid * 0x9E3779B9U);
+	}
+};
+
+struct SymbolRef {
+	SceUID module;
+	// The stub for imports, the symbol for exports.
+	u32 addr;
+	// Only for var imports.
+	u8 type;
+};
+
+typedef std::unordered_map<SymbolKey, std::vector<SymbolRef>, SymbolKeyHash> SymbolIndex;
+
+// Not saved, rebuilt from the modules on load state.
+static SymbolIndex funcImportIndex;
+static SymbolIndex funcExportIndex;
+static SymbolIndex varImportIndex;
+static SymbolIndex varExportIndex;
+
+static void IndexSymbol(SymbolIndex &index, const char *moduleName, u32 nid, SceUID module, u32 addr, u8 type = 0);
+static void UnindexModuleSymbols(Module *module);
+
 struct NativeModule {
 	u32_le next;
 	u16_le attribute;
@@ -226,6 +265,7 @@ class Module : public KernelObject {
 public:
 	Module() : textStart(0), textEnd(0), libstub(0), libstubend(0), memoryBlockAddr(0), isFake(false) {}
 	~Module() {
+		UnindexModuleSymbols(this);
 		if (memoryBlockAddr) {
 			// If it's either below user memory, or using a high kernel bit, it's in kernel.
 			if (memoryBlockAddr < PSP_GetUserMemoryBase() || memoryBlockAddr > PSP_GetUserMemoryEnd()) {
@@ -343,6 +383,7 @@ class Module : public KernelObject {
 		// Keep track and actually hook it up if possible.
 		importedFuncs.push_back(func);
 		impExpModuleNames.insert(func.moduleName);
+		IndexSymbol(funcImportIndex, func.moduleName, func.nid, GetUID(), func.stubAddr);
 		ImportFuncSymbol(func, reimporting);
 	}
 
@@ -350,6 +391,7 @@ class Module : public KernelObject {
 		// Keep track and actually hook it up if possible.
 		importedVars.push_back(var);
 		impExpModuleNames.insert(var.moduleName);
+		IndexSymbol(varImportIndex, var.moduleName, var.nid, GetUID(), var.stubAddr, var.type);
 		ImportVarSymbol(var);
 	}
 
@@ -359,6 +401,7 @@ class Module : public KernelObject {
 		}
 		exportedFuncs.push_back(func);
 		impExpModuleNames.insert(func.moduleName);
+		IndexSymbol(funcExportIndex, func.moduleName, func.nid, GetUID(), func.symAddr);
 		ExportFuncSymbol(func);
 	}
 
@@ -368,6 +411,7 @@ class Module : public KernelObject {
 		}
 		exportedVars.push_back(var);
 		impExpModuleNames.insert(var.moduleName);
+		IndexSymbol(varExportIndex, var.moduleName, var.nid, GetUID(), var.symAddr);
 		ExportVarSymbol(var);
 	}
 
@@ -390,6 +434,17 @@ class Module : public KernelObject {
 		return impExpModuleNames.find(moduleName) != impExpModuleNames.end();
 	}
 
+	void IndexSymbols() {
+		for (const auto &func : importedFuncs)
+			IndexSymbol(funcImportIndex, func.moduleName, func.nid, GetUID(), func.stubAddr);
+		for (const auto &var : importedVars)
+			IndexSymbol(varImportIndex, var.moduleName, var.nid, GetUID(), var.stubAddr, var.type);
+		for (const auto &func : exportedFuncs)
+			IndexSymbol(funcExportIndex, func.moduleName, func.nid, GetUID(), func.symAddr);
+		for (const auto &var : exportedVars)
+			IndexSymbol(varExportIndex, var.moduleName, var.nid, GetUID(), var.symAddr);
+	}
+
 	NativeModule nm;
 	std::vector<ModuleWaitingThread> waitingThreads;
 
@@ -479,6 +534,64 @@ static std::set<SceUID> loadedModules;
 // STATE END
 //////////////////////////////////////////////////////////////////////////
 
+static SymbolKey MakeSymbolKey(const char *moduleName, u32 nid) {
+	return SymbolKey{ std::string(moduleName, strnlen(moduleName, KERNELOBJECT_MAX_NAME_LENGTH)), nid };
+}
+
+static void IndexSymbol(SymbolIndex &index, const char *moduleName, u32 nid, SceUID module, u32 addr, u8 type) {
+	SymbolRef ref = { module, addr, type };
+	index[MakeSymbolKey(moduleName, nid)].push_back(ref);
+}
+
+template <typename T>
+static void UnindexSymbols(SymbolIndex &index, const std::vector<T> &list, SceUID module) {
+	for (const T &sym : list) {
+		auto it = index.find(MakeSymbolKey(sym.moduleName, sym.nid));
+		if (it == index.end())
+			continue;
+		auto &refs = it->second;
+		refs.erase(std::remove_if(refs.begin(), refs.end(), [&](const SymbolRef &ref) {
+			return ref.module == module;
+		}), refs.end());
+		if (refs.empty())
+			index.erase(it);
+	}
+}
+
+static void UnindexModuleSymbols(Module *module) {
+	const SceUID uid = module->GetUID();
+	UnindexSymbols(funcImportIndex, module->importedFuncs, uid);
+	UnindexSymbols(varImportIndex, module->importedVars, uid);
+	UnindexSymbols(funcExportIndex, module->exportedFuncs, uid);
+	UnindexSymbols(varExportIndex, module->exportedVars, uid);
+}
+
+static void ClearSymbolIndex() {
+	funcImportIndex.clear();
+	funcExportIndex.clear();
+	varImportIndex.clear();
+	varExportIndex.clear();
+}
+
+// Same as going through loadedModules in order: the lowest loaded module id wins, then the first export.
+static const SymbolRef *FindSymbolExport(const SymbolIndex &index, const char *moduleName, u32 nid) {
+	auto it = index.find(MakeSymbolKey(moduleName, nid));
+	if (it == index.end())
+		return nullptr;
+
+	const SymbolRef *found = nullptr;
+	for (const SymbolRef &ref : it->second) {
+		if ((!found || ref.module < found->module) && loadedModules.find(ref.module) != loadedModules.end())
+			found = &ref;
+	}
+	return found;
+}
+
+static const std::vector<SymbolRef> *FindSymbolImports(const SymbolIndex &index, const char *moduleName, u32 nid) {
+	auto it = index.find(MakeSymbolKey(moduleName, nid));
+	return it == index.end() ? nullptr : &it->second;
+}
+
 static void __KernelModuleInit()
 {
 	actionAfterModule = __KernelRegisterActionType(AfterModuleEntryCall::Create);
@@ -499,6 +612,13 @@ void __KernelModuleDoState(PointerWrap &p)
 
 	if (p.mode == p.MODE_READ) {
 		u32 error;
+		ClearSymbolIndex();
+		for (SceUID moduleId : loadedModules) {
+			Module *module = kernelObjects.Get<Module>(moduleId, error);
+			if (module)
+				module->IndexSymbols();
+		}
+
 		// We process these late, since they depend on loadedModules for interlinking.
 		for (SceUID moduleId : loadedModules) {
 			Module *module = kernelObjects.Get<Module>(moduleId, error);
@@ -517,7 +637,17 @@ void __KernelModuleDoState(PointerWrap &p)
 
 void __KernelModuleShutdown()
 {
+	if (MIPSComp::jit) {
+		u32 error;
+		for (SceUID moduleId : loadedModules) {
+			Module *module = kernelObjects.Get<Module>(moduleId, error);
+			if (module && !module->isFake)
+				MIPSComp::jit->SaveCodeCache(module->textStart, module->textEnd);
+		}
+	}
 	loadedModules.clear();
+	ClearSymbolIndex();
+	ElfReader::ClearRelocatedImages();
 	MIPSAnalyst::Reset();
 }
 
@@ -647,20 +777,11 @@ void ImportVarSymbol(const VarSymbolImport &var) {
 		return;
 	}
 
-	u32 error;
-	for (SceUID moduleId : loadedModules) {
-		Module *module = kernelObjects.Get<Module>(moduleId, error);
-		if (!module || !module->ImportsOrExportsModuleName(var.moduleName)) {
-			continue;
-		}
-
-		// Look for exports currently loaded modules already have.  Maybe it's available?
-		for (auto it = module->exportedVars.begin(), end = module->exportedVars.end(); it != end; ++it) {
-			if (it->Matches(var)) {
-				WriteVarSymbol(it->symAddr, var.stubAddr, var.type);
-				return;
-			}
-		}
+	// Look for exports currently loaded modules already have.  Maybe it's available?
+	const SymbolRef *exported = FindSymbolExport(varExportIndex, var.moduleName, var.nid);
+	if (exported) {
+		WriteVarSymbol(exported->addr, var.stubAddr, var.type);
+		return;
 	}
 
 	// It hasn't been exported yet, but hopefully it will later.
@@ -668,37 +789,29 @@ void ImportVarSymbol(const VarSymbolImport &var) {
 }
 
 void ExportVarSymbol(const VarSymbolExport &var) {
-	u32 error;
-	for (SceUID moduleId : loadedModules) {
-		Module *module = kernelObjects.Get<Module>(moduleId, error);
-		if (!module || !module->ImportsOrExportsModuleName(var.moduleName)) {
-			continue;
-		}
+	const std::vector<SymbolRef> *imports = FindSymbolImports(varImportIndex, var.moduleName, var.nid);
+	if (!imports)
+		return;
 
-		// Look for imports currently loaded modules already have, hook it up right away.
-		for (auto it = module->importedVars.begin(), end = module->importedVars.end(); it != end; ++it) {
-			if (var.Matches(*it)) {
-				INFO_LOG(LOADER, "Resolving var %s/%08x", var.moduleName, var.nid);
-				WriteVarSymbol(var.symAddr, it->stubAddr, it->type);
-			}
+	// Look for imports currently loaded modules already have, hook it up right away.
+	for (const SymbolRef &ref : *imports) {
+		if (loadedModules.find(ref.module) != loadedModules.end()) {
+			INFO_LOG(LOADER, "Resolving var %s/%08x", var.moduleName, var.nid);
+			WriteVarSymbol(var.symAddr, ref.addr, ref.type);
 		}
 	}
 }
 
 void UnexportVarSymbol(const VarSymbolExport &var) {
-	u32 error;
-	for (SceUID moduleId : loadedModules) {
-		Module *module = kernelObjects.Get<Module>(moduleId, error);
-		if (!module || !module->ImportsOrExportsModuleName(var.moduleName)) {
-			continue;
-		}
+	const std::vector<SymbolRef> *imports = FindSymbolImports(varImportIndex, var.moduleName, var.nid);
+	if (!imports)
+		return;
 
-		// Look for imports modules that are *still* loaded have, and reverse them.
-		for (auto it = module->importedVars.begin(), end = module->importedVars.end(); it != end; ++it) {
-			if (var.Matches(*it)) {
-				INFO_LOG(LOADER, "Unresolving var %s/%08x", var.moduleName, var.nid);
-				WriteVarSymbol(var.symAddr, it->stubAddr, it->type, true);
-			}
+	// Look for imports modules that are *still* loaded have, and reverse them.
+	for (const SymbolRef &ref : *imports) {
+		if (loadedModules.find(ref.module) != loadedModules.end()) {
+			INFO_LOG(LOADER, "Unresolving var %s/%08x", var.moduleName, var.nid);
+			WriteVarSymbol(var.symAddr, ref.addr, ref.type, true);
 		}
 	}
 }
@@ -716,25 +829,16 @@ void ImportFuncSymbol(const FuncSymbolImport &func, bool reimporting) {
 		return;
 	}
 
-	u32 error;
-	for (SceUID moduleId : loadedModules) {
-		Module *module = kernelObjects.Get<Module>(moduleId, error);
-		if (!module || !module->ImportsOrExportsModuleName(func.moduleName)) {
-			continue;
-		}
-
-		// Look for exports currently loaded modules already have.  Maybe it's available?
-		for (auto it = module->exportedFuncs.begin(), end = module->exportedFuncs.end(); it != end; ++it) {
-			if (it->Matches(func)) {
-				if (reimporting && Memory::Read_Instruction(func.stubAddr) != MIPS_MAKE_J(it->symAddr)) {
-					WARN_LOG_REPORT(LOADER, "Reimporting: func import %s/%08x changed", func.moduleName, func.nid);
-				}
-				WriteFuncStub(func.stubAddr, it->symAddr);
-				currentMIPS->InvalidateICache(func.stubAddr, 8);
-				MIPSAnalyst::PrecompileFunction(func.stubAddr, 8);
-				return;
-			}
+	// Look for exports currently loaded modules already have.  Maybe it's available?
+	const SymbolRef *exported = FindSymbolExport(funcExportIndex, func.moduleName, func.nid);
+	if (exported) {
+		if (reimporting && Memory::Read_Instruction(func.stubAddr) != MIPS_MAKE_J(exported->addr)) {
+			WARN_LOG_REPORT(LOADER, "Reimporting: func import %s/%08x changed", func.moduleName, func.nid);
 		}
+		WriteFuncStub(func.stubAddr, exported->addr);
+		currentMIPS->InvalidateICache(func.stubAddr, 8);
+		MIPSAnalyst::PrecompileFunction(func.stubAddr, 8);
+		return;
 	}
 
 	// It hasn't been exported yet, but hopefully it will later.
@@ -757,21 +861,17 @@ void ExportFuncSymbol(const FuncSymbolExport &func) {
 		return;
 	}
 
-	u32 error;
-	for (SceUID moduleId : loadedModules) {
-		Module *module = kernelObjects.Get<Module>(moduleId, error);
-		if (!module || !module->ImportsOrExportsModuleName(func.moduleName)) {
-			continue;
-		}
+	const std::vector<SymbolRef> *imports = FindSymbolImports(funcImportIndex, func.moduleName, func.nid);
+	if (!imports)
+		return;
 
-		// Look for imports currently loaded modules already have, hook it up right away.
-		for (auto it = module->importedFuncs.begin(), end = module->importedFuncs.end(); it != end; ++it) {
-			if (func.Matches(*it)) {
-				INFO_LOG(LOADER, "Resolving function %s/%08x", func.moduleName, func.nid);
-				WriteFuncStub(it->stubAddr, func.symAddr);
-				currentMIPS->InvalidateICache(it->stubAddr, 8);
-				MIPSAnalyst::PrecompileFunction(it->stubAddr, 8);
-			}
+	// Look for imports currently loaded modules already have, hook it up right away.
+	for (const SymbolRef &ref : *imports) {
+		if (loadedModules.find(ref.module) != loadedModules.end()) {
+			INFO_LOG(LOADER, "Resolving function %s/%08x", func.moduleName, func.nid);
+			WriteFuncStub(ref.addr, func.symAddr);
+			currentMIPS->InvalidateICache(ref.addr, 8);
+			MIPSAnalyst::PrecompileFunction(ref.addr, 8);
 		}
 	}
 }
@@ -782,25 +882,23 @@ void UnexportFuncSymbol(const FuncSymbolExport &func) {
 		return;
 	}
 
-	u32 error;
-	for (SceUID moduleId : loadedModules) {
-		Module *module = kernelObjects.Get<Module>(moduleId, error);
-		if (!module || !module->ImportsOrExportsModuleName(func.moduleName)) {
-			continue;
-		}
+	const std::vector<SymbolRef> *imports = FindSymbolImports(funcImportIndex, func.moduleName, func.nid);
+	if (!imports)
+		return;
 
-		// Look for imports modules that are *still* loaded have, and write back stubs.
-		for (auto it = module->importedFuncs.begin(), end = module->importedFuncs.end(); it != end; ++it) {
-			if (func.Matches(*it)) {
-				INFO_LOG(LOADER, "Unresolving function %s/%08x", func.moduleName, func.nid);
-				WriteFuncMissingStub(it->stubAddr, it->nid);
-				currentMIPS->InvalidateICache(it->stubAddr, 8);
-			}
+	// Look for imports modules that are *still* loaded have, and write back stubs.
+	for (const SymbolRef &ref : *imports) {
+		if (loadedModules.find(ref.module) != loadedModules.end()) {
+			INFO_LOG(LOADER, "Unresolving function %s/%08x", func.moduleName, func.nid);
+			WriteFuncMissingStub(ref.addr, func.nid);
+			currentMIPS->InvalidateICache(ref.addr, 8);
 		}
 	}
 }
 
 void Module::Cleanup() {
+	if (MIPSComp::jit && !isFake)
+		MIPSComp::jit->SaveCodeCache(textStart, textEnd);
 	MIPSAnalyst::ForgetFunctions(textStart, textEnd);
 
 	loadedModules.erase(GetUID());
@@ -866,6 +964,64 @@ static void __SaveDecryptedEbootToStorageMedia(const u8 *decryptedEbootDataPtr,
 	INFO_LOG(SCEMODULE, "Successfully wrote decrypted EBOOT to %s", fullPath.c_str());
 }
 
+struct DecryptedModuleHeader {
+	u32_le magic;
+	u32_le version;
+	u32_le size;
+	u32_le reserved;
+	u64_le dataHash;
+};
+
+static const u32 DECRYPTED_MODULE_MAGIC = 0x43585250;  // PRXC
+static const u32 DECRYPTED_MODULE_VERSION = 1;
+
+static std::string DecryptedModuleCachePath(u64 encryptedHash) {
+	return GetSysDirectory(DIRECTORY_APP_CACHE) + StringFromFormat("/prx/%016llx.prx", (unsigned long long)encryptedHash);
+}
+
+// Returns the decrypted size like pspDecryptPRX, or 0 if it's not cached (or is damaged.)
+static int LoadDecryptedModule(u64 encryptedHash, u8 *dest, u32 maxSize) {
+	FILE *f = File::OpenCFile(DecryptedModuleCachePath(encryptedHash), "rb");
+	if (!f)
+		return 0;
+
+	DecryptedModuleHeader header;
+	int result = 0;
+	if (fread(&header, sizeof(header), 1, f) == 1 && header.magic == DECRYPTED_MODULE_MAGIC && header.version == DECRYPTED_MODULE_VERSION) {
+		if (header.size != 0 && header.size <= maxSize && fread(dest, 1, header.size, f) == header.size) {
+			if (XXH64(dest, header.size, 0) == header.dataHash)
+				result = (int)header.size;
+		}
+	}
+	fclose(f);
+
+	if (result == 0)
+		WARN_LOG(SCEMODULE, "Ignoring damaged decrypted module cache entry %016llx", (unsigned long long)encryptedHash);
+	return result;
+}
+
+static void SaveDecryptedModule(u64 encryptedHash, const u8 *data, u32 size) {
+	const std::string path = DecryptedModuleCachePath(encryptedHash);
+	File::CreateFullPath(GetSysDirectory(DIRECTORY_APP_CACHE) + "/prx");
+	FILE *f = File::OpenCFile(path, "wb");
+	if (!f) {
+		WARN_LOG(SCEMODULE, "Unable to write decrypted module cache to %s", path.c_str());
+		return;
+	}
+
+	DecryptedModuleHeader header{};
+	header.magic = DECRYPTED_MODULE_MAGIC;
+	header.version = DECRYPTED_MODULE_VERSION;
+	header.size = size;
+	header.dataHash = XXH64(data, size, 0);
+	bool success = fwrite(&header, sizeof(header), 1, f) == 1 && fwrite(data, 1, size, f) == size;
+	fclose(f);
+	if (!success) {
+		// Don't leave a partial one around, it'd just fail the hash check every boot.
+		File::Delete(path);
+	}
+}
+
 static bool IsHLEVersionedModule(const char *name) {
 	// TODO: Only some of these are currently known to be versioned.
 	// Potentially only sceMpeg_library matters.
@@ -1104,10 +1260,25 @@ static Module *__KernelLoadELFFromPtr(const u8 *ptr, size_t elfSize, u32 loadAdd
 			kernelObjects.Destroy<Module>(module->GetUID());
 			return nullptr;
 		}
-		newptr = new u8[std::max(head->elf_size, head->psp_size)];
+		const u32 decryptedMaxSize = std::max(head->elf_size, head->psp_size);
+		newptr = new u8[decryptedMaxSize];
 		ptr = newptr;
 		magicPtr = (u32_le *)ptr;
-		int ret = pspDecryptPRX(in, (u8*)ptr, head->psp_size);
+
+		// Keyed by the encrypted data, so there's no need to decrypt to find it.
+		int ret = 0;
+		u64 encryptedHash = 0;
+		if (g_Config.bCacheDecryptedModules) {
+			encryptedHash = XXH64(in, head->psp_size, 0);
+			ret = LoadDecryptedModule(encryptedHash, newptr, decryptedMaxSize);
+			if (ret > 0)
+				INFO_LOG(SCEMODULE, "Using cached decrypted module %s", head->modname);
+		}
+		if (ret <= 0) {
+			ret = pspDecryptPRX(in, (u8*)ptr, head->psp_size);
+			if (ret > 0 && g_Config.bCacheDecryptedModules)
+				SaveDecryptedModule(encryptedHash, ptr, ret);
+		}
 		if (ret == MISSING_KEY) {
 			// This should happen for all "kernel" modules.
 			*error_string = "Missing key";
@@ -1460,6 +1631,8 @@ static Module *__KernelLoadELFFromPtr(const u8 *ptr, size_t elfSize, u32 loadAdd
 		if (module->nm.entry_addr == 0)
 			module->nm.entry_addr = module->nm.module_start_func;
 
+		if (MIPSComp::jit)
+			MIPSComp::jit->LoadCodeCache(module->textStart, module->textEnd);
 		MIPSAnalyst::PrecompileFunctions();
 
 	} else {
@@ -1531,6 +1704,29 @@ static Module *__KernelLoadModule(u8 *fileptr, size_t fileSize, SceKernelLMOptio
 	return module;
 }
 
+// Reads what __KernelLoadModule() needs.  For a PBP that's only the header and the ELF, left at
+// their offsets - the icons, sounds and PSAR around them are never looked at.
+static u8 *__KernelReadExecutable(u32 handle, size_t fileSize) {
+	// The padding is only for broken ELFs that read past their end.
+	u8 *temp = new u8[fileSize + 0x01000000];
+
+	const size_t PBP_HEADER_SIZE = 0x28;
+	size_t headerSize = pspFileSystem.ReadFile(handle, temp, std::min(fileSize, PBP_HEADER_SIZE));
+	if (headerSize == PBP_HEADER_SIZE && memcmp(temp, "\0PBP", 4) == 0) {
+		u32_le elfStart, elfEnd;
+		memcpy(&elfStart, temp + 0x20, 4);
+		memcpy(&elfEnd, temp + 0x24, 4);
+		if (elfStart >= PBP_HEADER_SIZE && elfStart <= elfEnd && elfEnd <= fileSize) {
+			pspFileSystem.SeekFile(handle, (s32)elfStart, FILEMOVE_BEGIN);
+			pspFileSystem.ReadFile(handle, temp + elfStart, elfEnd - elfStart);
+			return temp;
+		}
+	}
+
+	pspFileSystem.ReadFile(handle, temp + headerSize, fileSize - headerSize);
+	return temp;
+}
+
 static void __KernelStartModule(Module *m, int args, const char *argp, SceKernelSMOption *options)
 {
 	m->nm.status = MODULE_STATUS_STARTED;
@@ -1628,14 +1824,22 @@ bool __KernelLoadExec(const char *filename, u32 paramPtr, std::string *error_str
 		return false;
 	}
 
-	u32 handle = pspFileSystem.OpenFile(filename, FILEACCESS_READ);
-
-	u8 *temp = new u8[(int)info.size + 0x01000000];
-
-	pspFileSystem.ReadFile(handle, temp, (size_t)info.size);
+	// Host files are mapped, so only the pages the loader actually touches get read.
+	File::MappedFile mappedFile;
+	std::string hostPath;
+	u32 handle = 0;
+	u8 *temp = nullptr;
+	u8 *fileData;
+	if (pspFileSystem.GetHostPath(filename, hostPath) && mappedFile.Open(hostPath, false) && mappedFile.Size() == info.size) {
+		fileData = mappedFile.Data();
+	} else {
+		handle = pspFileSystem.OpenFile(filename, FILEACCESS_READ);
+		temp = __KernelReadExecutable(handle, (size_t)info.size);
+		fileData = temp;
+	}
 
 	PSP_SetLoading("Loading modules...");
-	Module *module = __KernelLoadModule(temp, (size_t)info.size, 0, error_string);
+	Module *module = __KernelLoadModule(fileData, (size_t)info.size, 0, error_string);
 
 	if (!module || module->isFake) {
 		if (module) {
@@ -1645,6 +1849,8 @@ bool __KernelLoadExec(const char *filename, u32 paramPtr, std::string *error_str
 		ERROR_LOG(LOADER, "Failed to load module %s", filename);
 		*error_string = "Failed to load executable: " + *error_string;
 		delete [] temp;
+		if (handle)
+			pspFileSystem.CloseFile(handle);
 		if (paramPtr) {
 			if (param_argp) delete[] param_argp;
 			if (param_key) delete[] param_key;
@@ -1658,7 +1864,8 @@ bool __KernelLoadExec(const char *filename, u32 paramPtr, std::string *error_str
 
 	delete [] temp;
 
-	pspFileSystem.CloseFile(handle);
+	if (handle)
+		pspFileSystem.CloseFile(handle);
 
 	SceKernelSMOption option;
 	option.size = sizeof(SceKernelSMOption);
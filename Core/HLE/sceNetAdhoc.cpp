@@ -612,8 +612,10 @@ static int sceNetAdhocPdpRecv(int id, void *addr, void * port, void *buf, void *
 
 				// Receive Data
 				changeBlockingMode(socket->id, flag);
+				Memory::PrepareHostWrite(buf, *len);
 				int received = recvfrom(socket->id, (char *)buf, *len,0,(sockaddr *)&sin, &sinlen);
 				int error = errno;
+				Memory::FinishHostWrite(buf, *len);
 				if (received == SOCKET_ERROR) {
 					VERBOSE_LOG(SCENET, "Socket Error (%i) on sceNetAdhocPdpRecv [size=%i]", error, *len);
 				}
@@ -1797,8 +1799,8 @@ static int sceNetAdhocPtpAccept(int id, u32 peerMacAddrPtr, u32 peerPortPtr, int
 							// Accept Connection
 							newsocket = accept(socket->id, (sockaddr *)&peeraddr, &peeraddrlen);
 							
-							// Wait a bit...
-							sleep_ms(1);
+							// Wait for an incoming Connection (wakes up as soon as one arrives)
+							if (newsocket == -1) waitForSocket(socket->id, false, 10000);
 						}
 					}
 
@@ -2339,8 +2341,10 @@ static int sceNetAdhocPtpRecv(int id, u32 dataAddr, u32 dataSizeAddr, int timeou
 				
 				// Receive Data
 				changeBlockingMode(socket->id, flag);
+				Memory::PrepareHostWrite(buf, *len);
 				int received = recv(socket->id, (char *)buf, *len, 0);
 				int error = errno;
+				Memory::FinishHostWrite(buf, *len);
 				changeBlockingMode(socket->id, 0);
 				
 				// Free Network Lock
@@ -5033,8 +5037,9 @@ int matchingInputThread(int matchingId)
 			// Handle Peer Timeouts
 			handleTimeout(context);
 
-			// Share CPU Time
-			sleep_ms(1); //10 //sceKernelDelayThread(10000);
+			// Share CPU Time, but wake up as soon as the next Datagram arrives
+			if (recvresult != 0 && context->socket > 0 && context->socket <= 255 && pdp[context->socket - 1] != NULL) waitForSocket(pdp[context->socket - 1]->id, false, 1000);
+			else sleep_ms(1); //10 //sceKernelDelayThread(10000);
 
 			// Don't do anything if it's paused, otherwise the log will be flooded
 			while (Core_IsStepping() && context->inputRunning) sleep_ms(1);
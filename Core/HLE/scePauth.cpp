@@ -50,7 +50,9 @@ static int scePauth_F7AA47F6(u32 srcPtr, int srcLength, u32 destLengthPtr, u32 w
 		fseek(fp, 0, SEEK_END);
 		size = ftell(fp);
 		fseek(fp, 0, SEEK_SET);
+		Memory::PrepareHostWrite(src, size);
 		fread(src, 1, size, fp);
+		Memory::FinishHostWrite(src, size);
 		fclose(fp);
 		Memory::Write_U32(size, destLengthPtr);
 		INFO_LOG(HLE, "Read from decrypted file %s", name);
@@ -100,7 +102,9 @@ static int scePauth_98B83B5D(u32 srcPtr, int srcLength, u32 destLengthPtr, u32 w
 		fseek(fp, 0, SEEK_END);
 		size = ftell(fp);
 		fseek(fp, 0, SEEK_SET);
+		Memory::PrepareHostWrite(src, size);
 		fread(src, 1, size, fp);
+		Memory::FinishHostWrite(src, size);
 		fclose(fp);
 		Memory::Write_U32(size, destLengthPtr);
 		INFO_LOG(HLE, "Read from decrypted file %s", name);
@@ -18,6 +18,7 @@
 #include <condition_variable>
 #include <mutex>
 
+#include "thread/threadutil.h"
 #include "Common/ChunkFile.h"
 #include "Core/MIPS/MIPS.h"
 #include "Core/Reporting.h"
@@ -46,11 +47,49 @@ void AsyncIOManager::ScheduleOperation(AsyncIOEvent ev) {
 }
 
 void AsyncIOManager::Shutdown() {
+	{
+		std::unique_lock<std::mutex> guard(devicesLock_);
+		devicesExit_ = true;
+		devicesWait_.notify_all();
+		guard.unlock();
+
+		// Nothing else adds devices anymore, so it's safe to look without the lock.
+		for (auto &device : devices_) {
+			device.second->thread->join();
+			delete device.second->thread;
+			delete device.second;
+		}
+
+		guard.lock();
+		devices_.clear();
+		devicesExit_ = false;
+	}
+
 	std::lock_guard<std::mutex> guard(resultsLock_);
 	resultsPending_.clear();
+	resultsDispatched_.clear();
 	results_.clear();
 }
 
+void AsyncIOManager::SyncThread(bool force) {
+	IOThreadEventQueue::SyncThread(force);
+
+	std::unique_lock<std::mutex> guard(devicesLock_);
+	while (true) {
+		bool idle = true;
+		for (const auto &device : devices_) {
+			if (device.second->busy || !device.second->events.empty()) {
+				idle = false;
+				break;
+			}
+		}
+		if (idle) {
+			break;
+		}
+		devicesWait_.wait(guard);
+	}
+}
+
 bool AsyncIOManager::HasResult(u32 handle) {
 	std::lock_guard<std::mutex> guard(resultsLock_);
 	return results_.find(handle) != results_.end();
@@ -83,7 +122,7 @@ bool AsyncIOManager::ReadResult(u32 handle, AsyncIOResult &result) {
 bool AsyncIOManager::WaitResult(u32 handle, AsyncIOResult &result) {
 	std::unique_lock<std::mutex> guard(resultsLock_);
 	ScheduleEvent(IO_EVENT_SYNC);
-	while (HasEvents() && ThreadEnabled() && resultsPending_.find(handle) != resultsPending_.end()) {
+	while ((HasEvents() || resultsDispatched_.count(handle) != 0) && ThreadEnabled() && resultsPending_.find(handle) != resultsPending_.end()) {
 		if (PopResult(handle, result)) {
 			return true;
 		}
@@ -97,7 +136,7 @@ u64 AsyncIOManager::ResultFinishTicks(u32 handle) {
 
 	std::unique_lock<std::mutex> guard(resultsLock_);
 	ScheduleEvent(IO_EVENT_SYNC);
-	while (HasEvents() && ThreadEnabled() && resultsPending_.find(handle) != resultsPending_.end()) {
+	while ((HasEvents() || resultsDispatched_.count(handle) != 0) && ThreadEnabled() && resultsPending_.find(handle) != resultsPending_.end()) {
 		if (ReadResult(handle, result)) {
 			return result.finishTicks;
 		}
@@ -113,11 +152,12 @@ u64 AsyncIOManager::ResultFinishTicks(u32 handle) {
 void AsyncIOManager::ProcessEvent(AsyncIOEvent ev) {
 	switch (ev.type) {
 	case IO_EVENT_READ:
-		Read(ev.handle, ev.buf, ev.bytes, ev.invalidateAddr);
-		break;
-
 	case IO_EVENT_WRITE:
-		Write(ev.handle, ev.buf, ev.bytes);
+		if (ThreadEnabled()) {
+			DispatchOperation(ev);
+		} else {
+			RunOperation(ev);
+		}
 		break;
 
 	default:
@@ -125,6 +165,64 @@ void AsyncIOManager::ProcessEvent(AsyncIOEvent ev) {
 	}
 }
 
+void AsyncIOManager::DispatchOperation(const AsyncIOEvent &ev) {
+	IFileSystem *sys = pspFileSystem.GetHandleOwner(ev.handle);
+	IFileSystem *device = sys ? sys->GetDevice() : nullptr;
+
+	std::unique_lock<std::mutex> guard(devicesLock_);
+	auto it = devices_.find(device);
+	if (it == devices_.end()) {
+		if (!device || devices_.size() >= MAX_DEVICE_THREADS) {
+			guard.unlock();
+			RunOperation(ev);
+			return;
+		}
+
+		DeviceQueue *queue = new DeviceQueue();
+		it = devices_.insert(std::make_pair(device, queue)).first;
+		queue->thread = new std::thread(&AsyncIOManager::DeviceThread, this, queue);
+	}
+
+	{
+		std::lock_guard<std::mutex> resultsGuard(resultsLock_);
+		resultsDispatched_.insert(ev.handle);
+	}
+	it->second->events.push_back(ev);
+	devicesWait_.notify_all();
+}
+
+void AsyncIOManager::RunOperation(const AsyncIOEvent &ev) {
+	if (ev.type == IO_EVENT_READ) {
+		Read(ev.handle, ev.buf, ev.bytes, ev.invalidateAddr);
+	} else {
+		Write(ev.handle, ev.buf, ev.bytes);
+	}
+}
+
+void AsyncIOManager::DeviceThread(DeviceQueue *queue) {
+	setCurrentThreadName("IODevice");
+
+	std::unique_lock<std::mutex> guard(devicesLock_);
+	while (!devicesExit_) {
+		if (queue->events.empty()) {
+			devicesWait_.wait(guard);
+			continue;
+		}
+
+		AsyncIOEvent ev = queue->events.front();
+		queue->events.pop_front();
+		queue->busy = true;
+
+		guard.unlock();
+		// Results still go through EventResult, so completion timing is figured the same way.
+		RunOperation(ev);
+		guard.lock();
+
+		queue->busy = false;
+		devicesWait_.notify_all();
+	}
+}
+
 void AsyncIOManager::Read(u32 handle, u8 *buf, size_t bytes, u32 invalidateAddr) {
 	int usec = 0;
 	s64 result = pspFileSystem.ReadFile(handle, buf, bytes, usec);
@@ -143,7 +241,9 @@ void AsyncIOManager::EventResult(u32 handle, AsyncIOResult result) {
 		ERROR_LOG_REPORT(SCEIO, "Overwriting previous result for file action on handle %d", handle);
 	}
 	results_[handle] = result;
-	resultsWait_.notify_one();
+	resultsDispatched_.erase(handle);
+	// There may be waiters for other handles, too.
+	resultsWait_.notify_all();
 }
 
 void AsyncIOManager::DoState(PointerWrap &p) {
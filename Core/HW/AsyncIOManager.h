@@ -15,12 +15,16 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#include <deque>
 #include <map>
 #include <set>
 #include <mutex>
+#include <thread>
 
 #include "Core/ThreadEventQueue.h"
 
+class IFileSystem;
+
 class NoBase {
 };
 
@@ -83,6 +87,8 @@ class AsyncIOManager : public IOThreadEventQueue {
 	bool HasOperation(u32 handle);
 	void ScheduleOperation(AsyncIOEvent ev);
 	void Shutdown();
+	// Also waits for operations already handed to device threads.
+	void SyncThread(bool force = false);
 
 	bool HasResult(u32 handle);
 	bool WaitResult(u32 handle, AsyncIOResult &result);
@@ -95,15 +101,39 @@ class AsyncIOManager : public IOThreadEventQueue {
 	}
 
 private:
+	// Operations for each device run in order on its own thread, so a slow memory stick
+	// write doesn't hold up a UMD read (or the other way around.)
+	struct DeviceQueue {
+		std::deque<AsyncIOEvent> events;
+		std::thread *thread = nullptr;
+		bool busy = false;
+	};
+
 	bool PopResult(u32 handle, AsyncIOResult &result);
 	bool ReadResult(u32 handle, AsyncIOResult &result);
+	void DispatchOperation(const AsyncIOEvent &ev);
+	void RunOperation(const AsyncIOEvent &ev);
+	void DeviceThread(DeviceQueue *queue);
 	void Read(u32 handle, u8 *buf, size_t bytes, u32 invalidateAddr);
 	void Write(u32 handle, u8 *buf, size_t bytes);
 
 	void EventResult(u32 handle, AsyncIOResult result);
 
+	enum {
+		// Further devices just run on the IO thread itself.
+		MAX_DEVICE_THREADS = 4,
+	};
+
 	std::mutex resultsLock_;
 	std::condition_variable resultsWait_;
 	std::set<u32> resultsPending_;
+	// Handed to a device thread, but no result yet.
+	std::set<u32> resultsDispatched_;
 	std::map<u32, AsyncIOResult> results_;
+
+	// Always taken before resultsLock_, if both.
+	std::mutex devicesLock_;
+	std::condition_variable devicesWait_;
+	std::map<IFileSystem *, DeviceQueue *> devices_;
+	bool devicesExit_ = false;
 };
\ No newline at end of file
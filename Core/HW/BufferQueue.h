@@ -108,17 +108,23 @@ struct BufferQueue {
 		return bytesgot;
 	}
 
-	int get_front(unsigned char *buf, int wantedsize) {
+	// Copies without popping, skipping the first offset bytes.
+	int get_front(unsigned char *buf, int wantedsize, int offset = 0) {
 		if (wantedsize <= 0)
 			return 0;
-		int bytesgot = getQueueSize();
+		int bytesgot = getQueueSize() - offset;
+		if (bytesgot <= 0)
+			return 0;
 		if (wantedsize < bytesgot)
 			bytesgot = wantedsize;
-		if (start + bytesgot <= bufQueueSize) {
-			memcpy(buf, bufQueue + start, bytesgot);
+		int from = start + offset;
+		if (from >= bufQueueSize)
+			from -= bufQueueSize;
+		if (from + bytesgot <= bufQueueSize) {
+			memcpy(buf, bufQueue + from, bytesgot);
 		} else {
-			int size = bufQueueSize - start;
-			memcpy(buf, bufQueue + start, size);
+			int size = bufQueueSize - from;
+			memcpy(buf, bufQueue + from, size);
 			memcpy(buf + size, bufQueue, bytesgot - size);
 		}
 		return bytesgot;
@@ -25,9 +25,17 @@
 #include "GPU/Common/TextureDecoder.h"
 #include "GPU/GPUInterface.h"
 #include "Core/HW/SimpleAudioDec.h"
+#include "thread/threadutil.h"
 
 #include <algorithm>
 
+#ifdef _M_SSE
+#include <emmintrin.h>
+#endif
+#if PPSSPP_ARCH(ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 #ifdef USE_FFMPEG
 
 extern "C" {
@@ -37,6 +45,15 @@ extern "C" {
 #include "libavutil/imgutils.h"
 #include "libswscale/swscale.h"
 
+// The generic hwaccel API (avcodec_get_hw_config) arrived with FFmpeg 4.0.
+#if LIBAVCODEC_VERSION_MAJOR >= 58
+#define USE_FFMPEG_HWACCEL
+#include "libavutil/hwcontext.h"
+#ifdef __ANDROID__
+#include "libavcodec/jni.h"
+#endif
+#endif
+
 }
 #endif // USE_FFMPEG
 
@@ -97,6 +114,42 @@ bool InitFFmpeg() {
 
 	return true;
 }
+
+#ifdef __ANDROID__
+void InitFFmpegJavaVM(void *vm) {
+#ifdef USE_FFMPEG_HWACCEL
+	av_jni_set_java_vm(vm, nullptr);
+#endif
+}
+#endif
+
+// Android isn't here, MediaCodec is a separate decoder rather than a hwaccel.
+#if defined(USE_FFMPEG_HWACCEL) && !defined(__ANDROID__)
+// In order of preference.
+static const AVHWDeviceType hwDeviceTypes[] = {
+#if defined(_WIN32)
+	AV_HWDEVICE_TYPE_D3D11VA,
+	AV_HWDEVICE_TYPE_DXVA2,
+#elif defined(__APPLE__)
+	AV_HWDEVICE_TYPE_VIDEOTOOLBOX,
+#elif defined(__linux__)
+	AV_HWDEVICE_TYPE_VAAPI,
+	AV_HWDEVICE_TYPE_VDPAU,
+#endif
+	AV_HWDEVICE_TYPE_NONE,
+};
+
+static AVPixelFormat getHardwareFormat(AVCodecContext *codecCtx, const AVPixelFormat *formats) {
+	const MediaEngine *engine = (const MediaEngine *)codecCtx->opaque;
+	for (const AVPixelFormat *p = formats; *p != AV_PIX_FMT_NONE; ++p) {
+		if (*p == engine->m_hwPixFmt)
+			return *p;
+	}
+	// The hardware can't do this stream (profile, size...), so let FFmpeg pick a software format.
+	WARN_LOG(ME, "Hardware video decoding not available for this stream, using software");
+	return avcodec_default_get_format(codecCtx, formats);
+}
+#endif
 #endif
 
 static int getPixelFormatBytes(int pspFormat)
@@ -124,6 +177,22 @@ MediaEngine::MediaEngine(): m_pdata(0) {
 	m_pFrameRGB = 0;
 	m_pIOContext = 0;
 	m_sws_ctx = 0;
+	m_pFrameSW = 0;
+	m_hwDeviceCtx = 0;
+	m_hwPixFmt = AV_PIX_FMT_NONE;
+	m_pFrameYUV = 0;
+	m_frameYUVCurrent = false;
+	m_frameRGBMode = GE_CMODE_32BIT_ABGR8888;
+
+	m_decodeAhead = false;
+	m_aheadThread = nullptr;
+	m_aheadStop = false;
+	m_aheadReadPos = 0;
+	m_aheadFrameBytes = 0;
+	m_aheadLastRead = 0;
+	m_aheadMaxFrameBytes = 0;
+	m_aheadPixelMode = GE_CMODE_32BIT_ABGR8888;
+	m_aheadPts = 0;
 #endif
 	m_sws_fmt = 0;
 	m_buffer = 0;
@@ -234,6 +303,16 @@ static int MpegReadbuffer(void *opaque, uint8_t *buf, int buf_size) {
 		size = std::min(buf_size, mpeg->m_mpegheaderSize - mpeg->m_mpegheaderReadPos);
 		memcpy(buf, mpeg->m_mpegheader + mpeg->m_mpegheaderReadPos, size);
 		mpeg->m_mpegheaderReadPos += size;
+#ifdef USE_FFMPEG
+	} else if (mpeg->m_decodeAhead) {
+		// Only peek, the bytes are popped when the frame they were for is handed to the game.
+		std::lock_guard<std::mutex> guard(mpeg->m_aheadLock);
+		size = mpeg->m_pdata->get_front(buf, buf_size, mpeg->m_aheadReadPos);
+		mpeg->m_aheadReadPos += size;
+		mpeg->m_aheadFrameBytes += size;
+		if (size > 0)
+			mpeg->m_aheadLastRead = size;
+#endif
 	} else {
 		size = mpeg->m_pdata->pop_front(buf, buf_size);
 		if (size > 0)
@@ -290,6 +369,7 @@ bool MediaEngine::openContext(bool keepReadPos) {
 	m_bufSize = std::max(m_bufSize, m_mpegheaderSize);
 	u8 *tempbuf = (u8*)av_malloc(m_bufSize);
 
+	m_aheadPts = m_videopts;
 	m_pFormatCtx = avformat_alloc_context();
 	m_pIOContext = avio_alloc_context(tempbuf, m_bufSize, 0, (void*)this, &MpegReadbuffer, nullptr, nullptr);
 	m_pFormatCtx->pb = m_pIOContext;
@@ -341,12 +421,26 @@ bool MediaEngine::openContext(bool keepReadPos) {
 void MediaEngine::closeContext()
 {
 #ifdef USE_FFMPEG
+	stopDecodeAhead();
+	for (AheadFrame &entry : m_aheadFrames) {
+		if (entry.frame)
+			av_frame_free(&entry.frame);
+	}
+	m_aheadFrames.clear();
+	m_aheadReadPos = 0;
+	m_aheadMaxFrameBytes = 0;
+
 	if (m_buffer)
 		av_free(m_buffer);
 	if (m_pFrameRGB)
 		av_frame_free(&m_pFrameRGB);
 	if (m_pFrame)
 		av_frame_free(&m_pFrame);
+	if (m_pFrameSW)
+		av_frame_free(&m_pFrameSW);
+	if (m_pFrameYUV)
+		av_frame_free(&m_pFrameYUV);
+	m_frameYUVCurrent = false;
 	if (m_pIOContext && m_pIOContext->buffer)
 		av_free(m_pIOContext->buffer);
 	if (m_pIOContext)
@@ -359,6 +453,9 @@ void MediaEngine::closeContext()
 	sws_freeContext(m_sws_ctx);
 	m_sws_ctx = NULL;
 	m_pIOContext = 0;
+	if (m_hwDeviceCtx)
+		av_buffer_unref(&m_hwDeviceCtx);
+	m_hwPixFmt = AV_PIX_FMT_NONE;
 #endif
 	m_buffer = 0;
 }
@@ -370,6 +467,9 @@ bool MediaEngine::loadStream(const u8 *buffer, int readSize, int RingbufferSize)
 	m_videopts = 0;
 	m_audiopts = 0;
 	m_ringbuffersize = RingbufferSize;
+#ifdef USE_FFMPEG
+	m_decodeAhead = g_Config.iVideoDecodeAhead > 0;
+#endif
 	m_pdata = new BufferQueue(RingbufferSize + 2048);
 	m_pdata->push(buffer, readSize);
 	m_firstTimeStamp = getMpegTimeStamp(buffer + PSMF_FIRST_TIMESTAMP_OFFSET);
@@ -388,8 +488,13 @@ bool MediaEngine::reloadStream()
 int MediaEngine::addStreamData(const u8 *buffer, int addSize) {
 	int size = addSize;
 	if (size > 0 && m_pdata) {
-		if (!m_pdata->push(buffer, size)) 
-			size  = 0;
+		bool pushed;
+		{
+			std::lock_guard<std::mutex> guard(m_aheadLock);
+			pushed = m_pdata->push(buffer, size);
+		}
+		if (!pushed)
+			size = 0;
 		if (m_demux) {
 			m_demux->addStreamData(buffer, addSize);
 		}
@@ -407,6 +512,10 @@ int MediaEngine::addStreamData(const u8 *buffer, int addSize) {
 
 		// We added data, so... not the end anymore?
 		m_isVideoEnd = false;
+#ifdef USE_FFMPEG
+		if (m_decodeAhead)
+			m_aheadCond.notify_one();
+#endif
 	}
 	return size;
 }
@@ -449,6 +558,10 @@ bool MediaEngine::setVideoStream(int streamNum, bool force) {
 	}
 
 #ifdef USE_FFMPEG
+	// The thread decodes m_videoStream, so stop it while that changes.  Frames it already
+	// decoded from the old stream are still handed out first.
+	stopDecodeAhead();
+
 	if (m_pFormatCtx && m_pCodecCtxs.find(streamNum) == m_pCodecCtxs.end()) {
 		// Get a pointer to the codec context for the video stream
 		if ((u32)streamNum >= m_pFormatCtx->nb_streams) {
@@ -462,11 +575,30 @@ bool MediaEngine::setVideoStream(int streamNum, bool force) {
 			return false;
 		}
 
+		bool hardware = false;
+		if (g_Config.bHardwareVideoDecode)
+			hardware = setupHardwareDecoder(m_pCodecCtx, &pCodec);
+
+		// Lets us hold on to the current picture cheaply, see keepFrameYUV().
+		m_pCodecCtx->refcounted_frames = 1;
+
 		AVDictionary *opt = nullptr;
 		// Allow ffmpeg to use any number of threads it wants.  Without this, it doesn't use threads.
-		av_dict_set(&opt, "threads", "0", 0);
+		// Hardware decoders don't need them, and some don't like frame threading.
+		av_dict_set(&opt, "threads", hardware ? "1" : "0", 0);
 		int openResult = avcodec_open2(m_pCodecCtx, pCodec, &opt);
 		av_dict_free(&opt);
+#ifdef USE_FFMPEG_HWACCEL
+		if (openResult < 0 && hardware) {
+			WARN_LOG(ME, "Hardware video decoder failed to open, using software");
+			av_buffer_unref(&m_pCodecCtx->hw_device_ctx);
+			m_pCodecCtx->get_format = avcodec_default_get_format;
+			pCodec = avcodec_find_decoder(m_pCodecCtx->codec_id);
+			av_dict_set(&opt, "threads", "0", 0);
+			openResult = pCodec ? avcodec_open2(m_pCodecCtx, pCodec, &opt) : -1;
+			av_dict_free(&opt);
+		}
+#endif
 		if (openResult < 0) {
 			return false;
 		}
@@ -479,6 +611,43 @@ bool MediaEngine::setVideoStream(int streamNum, bool force) {
 	return true;
 }
 
+#ifdef USE_FFMPEG
+bool MediaEngine::setupHardwareDecoder(AVCodecContext *codecCtx, AVCodec **codec) {
+#if defined(USE_FFMPEG_HWACCEL) && defined(__ANDROID__)
+	// Outputs plain NV12 buffers, so the rest works as with the software decoder.
+	AVCodec *mediaCodec = codecCtx->codec_id == AV_CODEC_ID_H264 ? avcodec_find_decoder_by_name("h264_mediacodec") : nullptr;
+	if (mediaCodec) {
+		INFO_LOG(ME, "Decoding video with MediaCodec");
+		*codec = mediaCodec;
+		return true;
+	}
+#elif defined(USE_FFMPEG_HWACCEL)
+	for (const AVHWDeviceType *type = hwDeviceTypes; *type != AV_HWDEVICE_TYPE_NONE; ++type) {
+		// All streams share the one device.
+		if (m_hwDeviceCtx && ((AVHWDeviceContext *)m_hwDeviceCtx->data)->type != *type)
+			continue;
+
+		for (int i = 0; const AVCodecHWConfig *config = avcodec_get_hw_config(*codec, i); ++i) {
+			if ((config->methods & AV_CODEC_HW_CONFIG_METHOD_HW_DEVICE_CTX) == 0 || config->device_type != *type)
+				continue;
+			if (!m_hwDeviceCtx && av_hwdevice_ctx_create(&m_hwDeviceCtx, *type, nullptr, nullptr, 0) < 0) {
+				m_hwDeviceCtx = nullptr;
+				break;
+			}
+
+			INFO_LOG(ME, "Decoding video with %s", av_hwdevice_get_type_name(*type));
+			codecCtx->hw_device_ctx = av_buffer_ref(m_hwDeviceCtx);
+			codecCtx->opaque = this;
+			codecCtx->get_format = &getHardwareFormat;
+			m_hwPixFmt = config->pix_fmt;
+			return true;
+		}
+	}
+#endif
+	return false;
+}
+#endif
+
 bool MediaEngine::setVideoDim(int width, int height)
 {
 #ifdef USE_FFMPEG
@@ -507,6 +676,7 @@ bool MediaEngine::setVideoDim(int width, int height)
 	sws_freeContext(m_sws_ctx);
 	m_sws_ctx = NULL;
 	m_sws_fmt = -1;
+	m_frameYUVCurrent = false;
 
 	if (m_desWidth == 0 || m_desHeight == 0) {
 		// Can't setup SWS yet, so stop for now.
@@ -541,13 +711,19 @@ void MediaEngine::updateSwsFormat(int videoPixelMode) {
 
 	AVPixelFormat swsDesired = getSwsFormat(videoPixelMode);
 	if (swsDesired != m_sws_fmt && m_pCodecCtx != 0) {
+		// Hardware frames get copied out in the decoder's software format.
+		AVPixelFormat srcFormat = m_pCodecCtx->pix_fmt;
+#ifdef USE_FFMPEG_HWACCEL
+		if (srcFormat == m_hwPixFmt)
+			srcFormat = m_pCodecCtx->sw_pix_fmt;
+#endif
 		m_sws_fmt = swsDesired;
 		m_sws_ctx = sws_getCachedContext
 			(
 				m_sws_ctx,
 				m_pCodecCtx->width,
 				m_pCodecCtx->height,
-				m_pCodecCtx->pix_fmt,
+				srcFormat,
 				m_desWidth,
 				m_desHeight,
 				(AVPixelFormat)m_sws_fmt,
@@ -571,18 +747,10 @@ void MediaEngine::updateSwsFormat(int videoPixelMode) {
 #endif
 }
 
-bool MediaEngine::stepVideo(int videoPixelMode, bool skipFrame) {
 #ifdef USE_FFMPEG
-	auto codecIter = m_pCodecCtxs.find(m_videoStream);
-	AVCodecContext *m_pCodecCtx = codecIter == m_pCodecCtxs.end() ? 0 : codecIter->second;
-
-	if (!m_pFormatCtx)
-		return false;
-	if (!m_pCodecCtx)
-		return false;
-	if (!m_pFrame)
-		return false;
-
+// Feeds packets to the decoder until a frame comes out in m_pFrame, and moves pts past it.
+// Returns false if the data ran out first.
+bool MediaEngine::decodeVideoFrame(AVCodecContext *codecCtx, s64 &pts) {
 	AVPacket packet;
 	av_init_packet(&packet);
 	int frameFinished;
@@ -601,35 +769,18 @@ bool MediaEngine::stepVideo(int videoPixelMode, bool skipFrame) {
 				av_free_packet(&packet);
 #endif
 
-			int result = avcodec_decode_video2(m_pCodecCtx, m_pFrame, &frameFinished, &packet);
+			// The frames are reference counted, so let go of the last one first.
+			av_frame_unref(m_pFrame);
+			int result = avcodec_decode_video2(codecCtx, m_pFrame, &frameFinished, &packet);
 			if (frameFinished) {
-				if (!m_pFrameRGB) {
-					setVideoDim();
-				}
-				if (m_pFrameRGB && !skipFrame) {
-					updateSwsFormat(videoPixelMode);
-					// TODO: Technically we could set this to frameWidth instead of m_desWidth for better perf.
-					// Update the linesize for the new format too.  We started with the largest size, so it should fit.
-					m_pFrameRGB->linesize[0] = getPixelFormatBytes(videoPixelMode) * m_desWidth;
-
-					sws_scale(m_sws_ctx, m_pFrame->data, m_pFrame->linesize, 0,
-						m_pCodecCtx->height, m_pFrameRGB->data, m_pFrameRGB->linesize);
-				}
-
 				if (av_frame_get_best_effort_timestamp(m_pFrame) != AV_NOPTS_VALUE)
-					m_videopts = av_frame_get_best_effort_timestamp(m_pFrame) + av_frame_get_pkt_duration(m_pFrame) - m_firstTimeStamp;
+					pts = av_frame_get_best_effort_timestamp(m_pFrame) + av_frame_get_pkt_duration(m_pFrame) - m_firstTimeStamp;
 				else
-					m_videopts += av_frame_get_pkt_duration(m_pFrame);
+					pts += av_frame_get_pkt_duration(m_pFrame);
 				bGetFrame = true;
 			}
-			if (result <= 0 && dataEnd) {
-				// Sometimes, m_readSize is less than m_streamSize at the end, but not by much.
-				// This is kinda a hack, but the ringbuffer would have to be prematurely empty too.
-				m_isVideoEnd = !bGetFrame && (m_pdata->getQueueSize() == 0);
-				if (m_isVideoEnd)
-					m_decodingsize = 0;
+			if (result <= 0 && dataEnd)
 				break;
-			}
 		}
 #if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57, 12, 100)
 		av_packet_unref(&packet);
@@ -638,6 +789,265 @@ bool MediaEngine::stepVideo(int videoPixelMode, bool skipFrame) {
 #endif
 	}
 	return bGetFrame;
+}
+
+// Returns m_pFrame, or a copy in main memory if the decoder is hardware.  Null if that fails.
+AVFrame *MediaEngine::softwareVideoFrame() {
+#ifdef USE_FFMPEG_HWACCEL
+	if (m_pFrame->format == m_hwPixFmt) {
+		if (!m_pFrameSW)
+			m_pFrameSW = av_frame_alloc();
+		av_frame_unref(m_pFrameSW);
+		if (av_hwframe_transfer_data(m_pFrameSW, m_pFrame, 0) < 0) {
+			ERROR_LOG(ME, "Unable to read back hardware video frame");
+			return nullptr;
+		}
+		return m_pFrameSW;
+	}
+#endif
+	return m_pFrame;
+}
+
+void MediaEngine::convertVideoFrame(const AVFrame *frame, int videoPixelMode, u8 *dest) {
+	updateSwsFormat(videoPixelMode);
+	// TODO: Technically we could set this to frameWidth instead of m_desWidth for better perf.
+	u8 *destData[4] = { dest, nullptr, nullptr, nullptr };
+	int destLinesize[4] = { getPixelFormatBytes(videoPixelMode) * m_desWidth, 0, 0, 0 };
+	sws_scale(m_sws_ctx, frame->data, frame->linesize, 0, frame->height, destData, destLinesize);
+}
+
+bool MediaEngine::canWriteDirect(const AVFrame *frame) const {
+	if (frame->width != m_desWidth || frame->height != m_desHeight)
+		return false;
+	// What the PSP's decoder outputs, and about everything H.264 decoders give us in practice.
+	return frame->format == AV_PIX_FMT_YUV420P || frame->format == AV_PIX_FMT_YUVJ420P || frame->format == AV_PIX_FMT_NV12;
+}
+
+// Makes frame the current picture, without converting it until it's written or read.
+void MediaEngine::keepFrameYUV(AVFrame *frame, int videoPixelMode, bool move) {
+	if (!m_pFrameYUV)
+		m_pFrameYUV = av_frame_alloc();
+	av_frame_unref(m_pFrameYUV);
+	if (move)
+		av_frame_move_ref(m_pFrameYUV, frame);
+	else if (av_frame_ref(m_pFrameYUV, frame) < 0) {
+		m_frameYUVCurrent = false;
+		return;
+	}
+	m_frameYUVCurrent = true;
+	m_frameRGBMode = videoPixelMode;
+}
+
+// Converts a kept YUV picture into m_pFrameRGB, for anything that reads it there.
+void MediaEngine::flushFrameRGB() {
+	if (!m_frameYUVCurrent || !m_pFrameRGB)
+		return;
+
+	std::lock_guard<std::mutex> decodeGuard(m_decodeLock);
+	m_pFrameRGB->linesize[0] = getPixelFormatBytes(m_frameRGBMode) * m_desWidth;
+	convertVideoFrame(m_pFrameYUV, m_frameRGBMode, m_pFrameRGB->data[0]);
+	av_frame_unref(m_pFrameYUV);
+	m_frameYUVCurrent = false;
+}
+
+// Call with m_decodeLock held.
+MediaEngine::AheadFrame MediaEngine::decodeAheadFrame(AVCodecContext *codecCtx, int videoPixelMode, bool convert) {
+	AheadFrame entry;
+	entry.frame = nullptr;
+	entry.pixelMode = videoPixelMode;
+	{
+		std::lock_guard<std::mutex> guard(m_aheadLock);
+		m_aheadFrameBytes = 0;
+		m_aheadLastRead = 0;
+	}
+
+	entry.got = decodeVideoFrame(codecCtx, m_aheadPts);
+	entry.pts = m_aheadPts;
+	if (entry.got && convert) {
+		AVFrame *frame = softwareVideoFrame();
+		if (!m_pFrameRGB) {
+			setVideoDim();
+		}
+		if (m_pFrameRGB && frame) {
+			entry.frame = av_frame_clone(frame);
+			// Otherwise, it's converted when it's written.
+			if (!canWriteDirect(frame)) {
+				entry.pixels.resize(getPixelFormatBytes(videoPixelMode) * m_desWidth * m_desHeight);
+				convertVideoFrame(frame, videoPixelMode, &entry.pixels[0]);
+			}
+		}
+	}
+
+	std::lock_guard<std::mutex> guard(m_aheadLock);
+	entry.bytesRead = m_aheadFrameBytes;
+	entry.lastReadSize = m_aheadLastRead;
+	entry.bytesLeft = m_pdata->getQueueSize() - m_aheadReadPos;
+	m_aheadMaxFrameBytes = std::max(m_aheadMaxFrameBytes, entry.bytesRead);
+	return entry;
+}
+
+void MediaEngine::deliverAheadFrame(AheadFrame &entry, int videoPixelMode, bool skipFrame) {
+	{
+		std::lock_guard<std::mutex> guard(m_aheadLock);
+		m_pdata->pop_front(nullptr, entry.bytesRead);
+		m_aheadReadPos -= entry.bytesRead;
+	}
+	if (entry.lastReadSize > 0)
+		m_decodingsize = entry.lastReadSize;
+
+	if (entry.got) {
+		m_videopts = entry.pts;
+		if (m_pFrameRGB && !skipFrame) {
+			// Update the linesize for the new format too.  We started with the largest size, so it should fit.
+			m_pFrameRGB->linesize[0] = getPixelFormatBytes(videoPixelMode) * m_desWidth;
+			if (entry.pixelMode == videoPixelMode && !entry.pixels.empty()) {
+				m_frameYUVCurrent = false;
+				memcpy(m_pFrameRGB->data[0], &entry.pixels[0], entry.pixels.size());
+			} else if (entry.frame && canWriteDirect(entry.frame)) {
+				keepFrameYUV(entry.frame, videoPixelMode, true);
+			} else if (entry.frame) {
+				m_frameYUVCurrent = false;
+				std::lock_guard<std::mutex> decodeGuard(m_decodeLock);
+				convertVideoFrame(entry.frame, videoPixelMode, m_pFrameRGB->data[0]);
+			}
+		}
+	} else {
+		// Same as stepVideo() without decoding ahead.
+		m_isVideoEnd = entry.bytesLeft == 0;
+		if (m_isVideoEnd)
+			m_decodingsize = 0;
+	}
+
+	if (entry.frame)
+		av_frame_free(&entry.frame);
+}
+
+bool MediaEngine::stepVideoAhead(int videoPixelMode, bool skipFrame) {
+	AheadFrame entry;
+	bool have = false;
+	{
+		std::lock_guard<std::mutex> guard(m_aheadLock);
+		m_aheadPixelMode = videoPixelMode;
+		if (!m_aheadThread) {
+			m_aheadStop = false;
+			m_aheadThread = new std::thread(&MediaEngine::decodeAheadThread, this);
+		}
+		if (!m_aheadFrames.empty()) {
+			entry = std::move(m_aheadFrames.front());
+			m_aheadFrames.pop_front();
+			have = true;
+		}
+	}
+
+	if (!have) {
+		// Either the thread is on this very frame, or there isn't enough data for it to go ahead.
+		std::lock_guard<std::mutex> decodeGuard(m_decodeLock);
+		{
+			std::lock_guard<std::mutex> guard(m_aheadLock);
+			if (!m_aheadFrames.empty()) {
+				entry = std::move(m_aheadFrames.front());
+				m_aheadFrames.pop_front();
+				have = true;
+			}
+		}
+		if (!have) {
+			entry = decodeAheadFrame(m_pCodecCtxs[m_videoStream], videoPixelMode, !skipFrame);
+		}
+	}
+
+	deliverAheadFrame(entry, videoPixelMode, skipFrame);
+	m_aheadCond.notify_one();
+	return entry.got;
+}
+
+void MediaEngine::decodeAheadThread() {
+	setCurrentThreadName("MediaDecode");
+
+	// Plenty of margin, so the demuxer doesn't run dry mid frame here.  When the data really
+	// runs out, stepVideoAhead() decodes on the emu thread as without this.
+	const int MIN_AHEAD_BYTES = 0x10000;
+
+	std::unique_lock<std::mutex> guard(m_aheadLock);
+	while (!m_aheadStop) {
+		int wanted = std::max(MIN_AHEAD_BYTES, m_aheadMaxFrameBytes * 2 + m_bufSize);
+		int unread = m_pdata->getQueueSize() - m_aheadReadPos;
+		if ((int)m_aheadFrames.size() >= g_Config.iVideoDecodeAhead || unread < wanted) {
+			m_aheadCond.wait(guard);
+			continue;
+		}
+
+		// setVideoStream() stops us before changing these.
+		auto codecIter = m_pCodecCtxs.find(m_videoStream);
+		if (codecIter == m_pCodecCtxs.end()) {
+			m_aheadCond.wait(guard);
+			continue;
+		}
+
+		int pixelMode = m_aheadPixelMode;
+		guard.unlock();
+		{
+			std::lock_guard<std::mutex> decodeGuard(m_decodeLock);
+			AheadFrame entry = decodeAheadFrame(codecIter->second, pixelMode, true);
+			// Queue it before letting go of m_decodeLock, so stepVideoAhead() sees it.
+			std::lock_guard<std::mutex> queueGuard(m_aheadLock);
+			m_aheadFrames.push_back(std::move(entry));
+		}
+		guard.lock();
+	}
+}
+
+void MediaEngine::stopDecodeAhead() {
+	if (!m_aheadThread)
+		return;
+
+	{
+		std::lock_guard<std::mutex> guard(m_aheadLock);
+		m_aheadStop = true;
+	}
+	m_aheadCond.notify_one();
+	m_aheadThread->join();
+	delete m_aheadThread;
+	m_aheadThread = nullptr;
+}
+#endif
+
+bool MediaEngine::stepVideo(int videoPixelMode, bool skipFrame) {
+#ifdef USE_FFMPEG
+	auto codecIter = m_pCodecCtxs.find(m_videoStream);
+	AVCodecContext *m_pCodecCtx = codecIter == m_pCodecCtxs.end() ? 0 : codecIter->second;
+
+	if (!m_pFormatCtx)
+		return false;
+	if (!m_pCodecCtx)
+		return false;
+	if (!m_pFrame)
+		return false;
+
+	if (m_decodeAhead)
+		return stepVideoAhead(videoPixelMode, skipFrame);
+
+	bool bGetFrame = decodeVideoFrame(m_pCodecCtx, m_videopts);
+	if (bGetFrame) {
+		AVFrame *frame = skipFrame ? nullptr : softwareVideoFrame();
+		if (!m_pFrameRGB) {
+			setVideoDim();
+		}
+		if (m_pFrameRGB && frame && canWriteDirect(frame)) {
+			keepFrameYUV(frame, videoPixelMode, false);
+		} else if (m_pFrameRGB && frame) {
+			// Update the linesize for the new format too.  We started with the largest size, so it should fit.
+			m_pFrameRGB->linesize[0] = getPixelFormatBytes(videoPixelMode) * m_desWidth;
+			convertVideoFrame(frame, videoPixelMode, m_pFrameRGB->data[0]);
+			m_frameYUVCurrent = false;
+		}
+	} else {
+		// Sometimes, m_readSize is less than m_streamSize at the end, but not by much.
+		// This is kinda a hack, but the ringbuffer would have to be prematurely empty too.
+		m_isVideoEnd = m_pdata->getQueueSize() == 0;
+		if (m_isVideoEnd)
+			m_decodingsize = 0;
+	}
+	return bGetFrame;
 #else
 	// If video engine is not available, just add to the timestamp at least.
 	m_videopts += 3003;
@@ -684,6 +1094,222 @@ inline void writeVideoLineABGR4444(void *destp, const void *srcp, int width) {
 	}
 }
 
+// Fused 4:2:0 YUV to PSP pixel format conversion, straight into the game's buffer.
+// BT.601 limited range like the sws_scale setup, in 6 bit fixed point, with alpha cleared.
+static inline int ClampColor(int c) {
+	return c < 0 ? 0 : (c > 255 ? 255 : c);
+}
+
+template <int mode>
+static inline void StoreVideoPixel(u8 *dest, int y, int u, int v) {
+	int yy = (y - 16) * 74;
+	u -= 128;
+	v -= 128;
+	int r = ClampColor((yy + 102 * v + 32) >> 6);
+	int g = ClampColor((yy - 25 * u - 52 * v + 32) >> 6);
+	int b = ClampColor((yy + 129 * u + 32) >> 6);
+	switch (mode) {
+	case GE_CMODE_32BIT_ABGR8888:
+		*(u32_le *)dest = r | (g << 8) | (b << 16);
+		break;
+	case GE_CMODE_16BIT_BGR5650:
+		*(u16_le *)dest = (r >> 3) | ((g >> 2) << 5) | ((b >> 3) << 11);
+		break;
+	case GE_CMODE_16BIT_ABGR5551:
+		*(u16_le *)dest = (r >> 3) | ((g >> 3) << 5) | ((b >> 3) << 10);
+		break;
+	case GE_CMODE_16BIT_ABGR4444:
+		*(u16_le *)dest = (r >> 4) | ((g >> 4) << 4) | ((b >> 4) << 8);
+		break;
+	}
+}
+
+#ifdef _M_SSE
+// Takes 8 pixels of y, u, v as 16 bit lanes, u and v already less 128.
+template <int mode>
+static inline void StoreVideoPixelsSSE2(u8 *dest, __m128i y, __m128i u, __m128i v) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i maxColor = _mm_set1_epi16(255);
+	const __m128i round = _mm_set1_epi16(32);
+	// Where these saturate, the result clamps to 255 either way.
+	__m128i yy = _mm_mullo_epi16(_mm_sub_epi16(y, _mm_set1_epi16(16)), _mm_set1_epi16(74));
+	__m128i r = _mm_adds_epi16(_mm_adds_epi16(yy, _mm_mullo_epi16(v, _mm_set1_epi16(102))), round);
+	__m128i g = _mm_subs_epi16(yy, _mm_mullo_epi16(u, _mm_set1_epi16(25)));
+	g = _mm_adds_epi16(_mm_subs_epi16(g, _mm_mullo_epi16(v, _mm_set1_epi16(52))), round);
+	__m128i b = _mm_adds_epi16(_mm_adds_epi16(yy, _mm_mullo_epi16(u, _mm_set1_epi16(129))), round);
+	r = _mm_min_epi16(_mm_max_epi16(_mm_srai_epi16(r, 6), zero), maxColor);
+	g = _mm_min_epi16(_mm_max_epi16(_mm_srai_epi16(g, 6), zero), maxColor);
+	b = _mm_min_epi16(_mm_max_epi16(_mm_srai_epi16(b, 6), zero), maxColor);
+
+	switch (mode) {
+	case GE_CMODE_32BIT_ABGR8888:
+	{
+		__m128i rg = _mm_or_si128(r, _mm_slli_epi16(g, 8));
+		_mm_storeu_si128((__m128i *)dest, _mm_unpacklo_epi16(rg, b));
+		_mm_storeu_si128((__m128i *)(dest + 16), _mm_unpackhi_epi16(rg, b));
+		break;
+	}
+	case GE_CMODE_16BIT_BGR5650:
+		r = _mm_srli_epi16(r, 3);
+		g = _mm_slli_epi16(_mm_srli_epi16(g, 2), 5);
+		b = _mm_slli_epi16(_mm_srli_epi16(b, 3), 11);
+		_mm_storeu_si128((__m128i *)dest, _mm_or_si128(_mm_or_si128(r, g), b));
+		break;
+	case GE_CMODE_16BIT_ABGR5551:
+		r = _mm_srli_epi16(r, 3);
+		g = _mm_slli_epi16(_mm_srli_epi16(g, 3), 5);
+		b = _mm_slli_epi16(_mm_srli_epi16(b, 3), 10);
+		_mm_storeu_si128((__m128i *)dest, _mm_or_si128(_mm_or_si128(r, g), b));
+		break;
+	case GE_CMODE_16BIT_ABGR4444:
+		r = _mm_srli_epi16(r, 4);
+		g = _mm_slli_epi16(_mm_srli_epi16(g, 4), 4);
+		b = _mm_slli_epi16(_mm_srli_epi16(b, 4), 8);
+		_mm_storeu_si128((__m128i *)dest, _mm_or_si128(_mm_or_si128(r, g), b));
+		break;
+	}
+}
+#elif PPSSPP_ARCH(ARM_NEON)
+template <int mode>
+static inline void StoreVideoPixelsNEON(u8 *dest, int16x8_t y, int16x8_t u, int16x8_t v) {
+	const int16x8_t round = vdupq_n_s16(32);
+	int16x8_t yy = vmulq_n_s16(vsubq_s16(y, vdupq_n_s16(16)), 74);
+	int16x8_t r = vqaddq_s16(vqaddq_s16(yy, vmulq_n_s16(v, 102)), round);
+	int16x8_t g = vqsubq_s16(yy, vmulq_n_s16(u, 25));
+	g = vqaddq_s16(vqsubq_s16(g, vmulq_n_s16(v, 52)), round);
+	int16x8_t b = vqaddq_s16(vqaddq_s16(yy, vmulq_n_s16(u, 129)), round);
+	uint8x8_t r8 = vqmovun_s16(vshrq_n_s16(r, 6));
+	uint8x8_t g8 = vqmovun_s16(vshrq_n_s16(g, 6));
+	uint8x8_t b8 = vqmovun_s16(vshrq_n_s16(b, 6));
+
+	if (mode == GE_CMODE_32BIT_ABGR8888) {
+		uint8x8x4_t pixels;
+		pixels.val[0] = r8;
+		pixels.val[1] = g8;
+		pixels.val[2] = b8;
+		pixels.val[3] = vdup_n_u8(0);
+		vst4_u8(dest, pixels);
+		return;
+	}
+
+	uint16x8_t r16 = vmovl_u8(r8);
+	uint16x8_t g16 = vmovl_u8(g8);
+	uint16x8_t b16 = vmovl_u8(b8);
+	uint16x8_t packed;
+	switch (mode) {
+	case GE_CMODE_16BIT_BGR5650:
+		packed = vorrq_u16(vorrq_u16(vshrq_n_u16(r16, 3), vshlq_n_u16(vshrq_n_u16(g16, 2), 5)), vshlq_n_u16(vshrq_n_u16(b16, 3), 11));
+		break;
+	case GE_CMODE_16BIT_ABGR5551:
+		packed = vorrq_u16(vorrq_u16(vshrq_n_u16(r16, 3), vshlq_n_u16(vshrq_n_u16(g16, 3), 5)), vshlq_n_u16(vshrq_n_u16(b16, 3), 10));
+		break;
+	default:
+		packed = vorrq_u16(vorrq_u16(vshrq_n_u16(r16, 4), vshlq_n_u16(vshrq_n_u16(g16, 4), 4)), vshlq_n_u16(vshrq_n_u16(b16, 4), 8));
+		break;
+	}
+	vst1q_u16((uint16_t *)dest, packed);
+}
+#endif
+
+// Writes source pixels x to x + width of a row.  For NV12, uSrc is the interleaved UV row.
+template <int mode, bool nv12>
+static void ConvertVideoRow(u8 *dest, const u8 *ySrc, const u8 *uSrc, const u8 *vSrc, int x, int width) {
+	const int bpp = mode == GE_CMODE_32BIT_ABGR8888 ? 4 : 2;
+	int i = 0;
+	// The vector path wants to start on a pair of pixels sharing chroma.
+	if ((x & 1) != 0 && width > 0) {
+		int c = x >> 1;
+		StoreVideoPixel<mode>(dest, ySrc[x], nv12 ? uSrc[c * 2] : uSrc[c], nv12 ? uSrc[c * 2 + 1] : vSrc[c]);
+		i = 1;
+	}
+
+#if defined(_M_SSE) || PPSSPP_ARCH(ARM_NEON)
+	for (; i + 16 <= width; i += 16) {
+		const int sx = x + i;
+#ifdef _M_SSE
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i bias = _mm_set1_epi16(128);
+		__m128i y8 = _mm_loadu_si128((const __m128i *)(ySrc + sx));
+		__m128i u, v;
+		if (nv12) {
+			__m128i uv = _mm_loadu_si128((const __m128i *)(uSrc + sx));
+			u = _mm_and_si128(uv, _mm_set1_epi16(0x00FF));
+			v = _mm_srli_epi16(uv, 8);
+		} else {
+			u = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(uSrc + sx / 2)), zero);
+			v = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(vSrc + sx / 2)), zero);
+		}
+		u = _mm_sub_epi16(u, bias);
+		v = _mm_sub_epi16(v, bias);
+		StoreVideoPixelsSSE2<mode>(dest + i * bpp, _mm_unpacklo_epi8(y8, zero), _mm_unpacklo_epi16(u, u), _mm_unpacklo_epi16(v, v));
+		StoreVideoPixelsSSE2<mode>(dest + (i + 8) * bpp, _mm_unpackhi_epi8(y8, zero), _mm_unpackhi_epi16(u, u), _mm_unpackhi_epi16(v, v));
+#else
+		const int16x8_t bias = vdupq_n_s16(128);
+		uint8x16_t y8 = vld1q_u8(ySrc + sx);
+		int16x8_t u, v;
+		if (nv12) {
+			uint8x8x2_t uv = vld2_u8(uSrc + sx);
+			u = vreinterpretq_s16_u16(vmovl_u8(uv.val[0]));
+			v = vreinterpretq_s16_u16(vmovl_u8(uv.val[1]));
+		} else {
+			u = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(uSrc + sx / 2)));
+			v = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(vSrc + sx / 2)));
+		}
+		int16x8x2_t u2 = vzipq_s16(vsubq_s16(u, bias), vsubq_s16(u, bias));
+		int16x8x2_t v2 = vzipq_s16(vsubq_s16(v, bias), vsubq_s16(v, bias));
+		StoreVideoPixelsNEON<mode>(dest + i * bpp, vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(y8))), u2.val[0], v2.val[0]);
+		StoreVideoPixelsNEON<mode>(dest + (i + 8) * bpp, vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(y8))), u2.val[1], v2.val[1]);
+#endif
+	}
+#endif
+
+	for (; i < width; ++i) {
+		const int sx = x + i;
+		const int c = sx >> 1;
+		StoreVideoPixel<mode>(dest + i * bpp, ySrc[sx], nv12 ? uSrc[c * 2] : uSrc[c], nv12 ? uSrc[c * 2 + 1] : vSrc[c]);
+	}
+}
+
+#ifdef USE_FFMPEG
+// Writes the range of m_pFrameYUV to dest, with lines frameWidth pixels apart.
+void MediaEngine::writeFrameYUV(u8 *dest, int frameWidth, int videoPixelMode, int xpos, int ypos, int width, int height) {
+	typedef void (*ConvertRowFunc)(u8 *dest, const u8 *ySrc, const u8 *uSrc, const u8 *vSrc, int x, int width);
+	const AVFrame *frame = m_pFrameYUV;
+	const bool nv12 = frame->format == AV_PIX_FMT_NV12;
+
+	ConvertRowFunc convertRow;
+	switch (videoPixelMode) {
+	case GE_CMODE_32BIT_ABGR8888:
+		convertRow = nv12 ? &ConvertVideoRow<GE_CMODE_32BIT_ABGR8888, true> : &ConvertVideoRow<GE_CMODE_32BIT_ABGR8888, false>;
+		break;
+	case GE_CMODE_16BIT_BGR5650:
+		convertRow = nv12 ? &ConvertVideoRow<GE_CMODE_16BIT_BGR5650, true> : &ConvertVideoRow<GE_CMODE_16BIT_BGR5650, false>;
+		break;
+	case GE_CMODE_16BIT_ABGR5551:
+		convertRow = nv12 ? &ConvertVideoRow<GE_CMODE_16BIT_ABGR5551, true> : &ConvertVideoRow<GE_CMODE_16BIT_ABGR5551, false>;
+		break;
+	case GE_CMODE_16BIT_ABGR4444:
+		convertRow = nv12 ? &ConvertVideoRow<GE_CMODE_16BIT_ABGR4444, true> : &ConvertVideoRow<GE_CMODE_16BIT_ABGR4444, false>;
+		break;
+	default:
+		ERROR_LOG_REPORT(ME, "Unsupported video pixel format %d", videoPixelMode);
+		return;
+	}
+
+	if (xpos < 0 || ypos < 0 || width <= 0 || height <= 0)
+		return;
+
+	const int lineSize = frameWidth * getPixelFormatBytes(videoPixelMode);
+	for (int y = 0; y < height; y++) {
+		const int sy = ypos + y;
+		const u8 *ySrc = frame->data[0] + sy * frame->linesize[0];
+		const u8 *uSrc = frame->data[1] + (sy >> 1) * frame->linesize[1];
+		const u8 *vSrc = nv12 ? nullptr : frame->data[2] + (sy >> 1) * frame->linesize[2];
+		convertRow(dest + y * lineSize, ySrc, uSrc, vSrc, xpos, width);
+	}
+}
+#endif
+
 int MediaEngine::writeVideoImage(u32 bufferPtr, int frameWidth, int videoPixelMode) {
 	if (!Memory::IsValidAddress(bufferPtr) || frameWidth > 2048) {
 		// Clearly invalid values.  Let's just not.
@@ -722,38 +1348,42 @@ int MediaEngine::writeVideoImage(u32 bufferPtr, int frameWidth, int videoPixelMo
 		imgbuf = new u8[videoImageSize];
 	}
 
-	switch (videoPixelMode) {
-	case GE_CMODE_32BIT_ABGR8888:
-		for (int y = 0; y < height; y++) {
-			writeVideoLineRGBA(imgbuf + videoLineSize * y, data, width);
-			data += width * sizeof(u32);
-		}
-		break;
+	if (m_frameYUVCurrent) {
+		writeFrameYUV(imgbuf, frameWidth, videoPixelMode, 0, 0, width, height);
+	} else {
+		switch (videoPixelMode) {
+		case GE_CMODE_32BIT_ABGR8888:
+			for (int y = 0; y < height; y++) {
+				writeVideoLineRGBA(imgbuf + videoLineSize * y, data, width);
+				data += width * sizeof(u32);
+			}
+			break;
 
-	case GE_CMODE_16BIT_BGR5650:
-		for (int y = 0; y < height; y++) {
-			writeVideoLineABGR5650(imgbuf + videoLineSize * y, data, width);
-			data += width * sizeof(u16);
-		}
-		break;
+		case GE_CMODE_16BIT_BGR5650:
+			for (int y = 0; y < height; y++) {
+				writeVideoLineABGR5650(imgbuf + videoLineSize * y, data, width);
+				data += width * sizeof(u16);
+			}
+			break;
 
-	case GE_CMODE_16BIT_ABGR5551:
-		for (int y = 0; y < height; y++) {
-			writeVideoLineABGR5551(imgbuf + videoLineSize * y, data, width);
-			data += width * sizeof(u16);
-		}
-		break;
+		case GE_CMODE_16BIT_ABGR5551:
+			for (int y = 0; y < height; y++) {
+				writeVideoLineABGR5551(imgbuf + videoLineSize * y, data, width);
+				data += width * sizeof(u16);
+			}
+			break;
 
-	case GE_CMODE_16BIT_ABGR4444:
-		for (int y = 0; y < height; y++) {
-			writeVideoLineABGR4444(imgbuf + videoLineSize * y, data, width);
-			data += width * sizeof(u16);
-		}
-		break;
+		case GE_CMODE_16BIT_ABGR4444:
+			for (int y = 0; y < height; y++) {
+				writeVideoLineABGR4444(imgbuf + videoLineSize * y, data, width);
+				data += width * sizeof(u16);
+			}
+			break;
 
-	default:
-		ERROR_LOG_REPORT(ME, "Unsupported video pixel format %d", videoPixelMode);
-		break;
+		default:
+			ERROR_LOG_REPORT(ME, "Unsupported video pixel format %d", videoPixelMode);
+			break;
+		}
 	}
 
 	if (swizzle) {
@@ -815,58 +1445,67 @@ int MediaEngine::writeVideoImageWithRange(u32 bufferPtr, int frameWidth, int vid
 	if (height > m_desHeight - ypos)
 		height = m_desHeight - ypos;
 
-	switch (videoPixelMode) {
-	case GE_CMODE_32BIT_ABGR8888:
-		data += (ypos * m_desWidth + xpos) * sizeof(u32);
+	if (m_frameYUVCurrent) {
+		writeFrameYUV(imgbuf, frameWidth, videoPixelMode, xpos, ypos, width, height);
+#ifndef MOBILE_DEVICE
 		for (int y = 0; y < height; y++) {
-			writeVideoLineRGBA(imgbuf, data, width);
-			data += m_desWidth * sizeof(u32);
-			imgbuf += videoLineSize;
+			CBreakPoints::ExecMemCheck(bufferPtr + y * videoLineSize, true, width * getPixelFormatBytes(videoPixelMode), currentMIPS->pc);
+		}
+#endif
+	} else {
+		switch (videoPixelMode) {
+		case GE_CMODE_32BIT_ABGR8888:
+			data += (ypos * m_desWidth + xpos) * sizeof(u32);
+			for (int y = 0; y < height; y++) {
+				writeVideoLineRGBA(imgbuf, data, width);
+				data += m_desWidth * sizeof(u32);
+				imgbuf += videoLineSize;
 #ifndef MOBILE_DEVICE
-			CBreakPoints::ExecMemCheck(bufferPtr + y * frameWidth * sizeof(u32), true, width * sizeof(u32), currentMIPS->pc);
+				CBreakPoints::ExecMemCheck(bufferPtr + y * frameWidth * sizeof(u32), true, width * sizeof(u32), currentMIPS->pc);
 #endif
-		}
-		break;
-
-	case GE_CMODE_16BIT_BGR5650:
-		data += (ypos * m_desWidth + xpos) * sizeof(u16);
-		for (int y = 0; y < height; y++) {
-			writeVideoLineABGR5650(imgbuf, data, width);
-			data += m_desWidth * sizeof(u16);
-			imgbuf += videoLineSize;
+			}
+			break;
+
+		case GE_CMODE_16BIT_BGR5650:
+			data += (ypos * m_desWidth + xpos) * sizeof(u16);
+			for (int y = 0; y < height; y++) {
+				writeVideoLineABGR5650(imgbuf, data, width);
+				data += m_desWidth * sizeof(u16);
+				imgbuf += videoLineSize;
 #ifndef MOBILE_DEVICE
-			CBreakPoints::ExecMemCheck(bufferPtr + y * frameWidth * sizeof(u16), true, width * sizeof(u16), currentMIPS->pc);
+				CBreakPoints::ExecMemCheck(bufferPtr + y * frameWidth * sizeof(u16), true, width * sizeof(u16), currentMIPS->pc);
 #endif
-		}
-		break;
-
-	case GE_CMODE_16BIT_ABGR5551:
-		data += (ypos * m_desWidth + xpos) * sizeof(u16);
-		for (int y = 0; y < height; y++) {
-			writeVideoLineABGR5551(imgbuf, data, width);
-			data += m_desWidth * sizeof(u16);
-			imgbuf += videoLineSize;
+			}
+			break;
+
+		case GE_CMODE_16BIT_ABGR5551:
+			data += (ypos * m_desWidth + xpos) * sizeof(u16);
+			for (int y = 0; y < height; y++) {
+				writeVideoLineABGR5551(imgbuf, data, width);
+				data += m_desWidth * sizeof(u16);
+				imgbuf += videoLineSize;
 #ifndef MOBILE_DEVICE
-			CBreakPoints::ExecMemCheck(bufferPtr + y * frameWidth * sizeof(u16), true, width * sizeof(u16), currentMIPS->pc);
+				CBreakPoints::ExecMemCheck(bufferPtr + y * frameWidth * sizeof(u16), true, width * sizeof(u16), currentMIPS->pc);
 #endif
-		}
-		break;
-
-	case GE_CMODE_16BIT_ABGR4444:
-		data += (ypos * m_desWidth + xpos) * sizeof(u16);
-		for (int y = 0; y < height; y++) {
-			writeVideoLineABGR4444(imgbuf, data, width);
-			data += m_desWidth * sizeof(u16);
-			imgbuf += videoLineSize;
+			}
+			break;
+
+		case GE_CMODE_16BIT_ABGR4444:
+			data += (ypos * m_desWidth + xpos) * sizeof(u16);
+			for (int y = 0; y < height; y++) {
+				writeVideoLineABGR4444(imgbuf, data, width);
+				data += m_desWidth * sizeof(u16);
+				imgbuf += videoLineSize;
 #ifndef MOBILE_DEVICE
-			CBreakPoints::ExecMemCheck(bufferPtr + y * frameWidth * sizeof(u16), true, width * sizeof(u16), currentMIPS->pc);
+				CBreakPoints::ExecMemCheck(bufferPtr + y * frameWidth * sizeof(u16), true, width * sizeof(u16), currentMIPS->pc);
 #endif
-		}
-		break;
+			}
+			break;
 
-	default:
-		ERROR_LOG_REPORT(ME, "Unsupported video pixel format %d", videoPixelMode);
-		break;
+		default:
+			ERROR_LOG_REPORT(ME, "Unsupported video pixel format %d", videoPixelMode);
+			break;
+		}
 	}
 
 	if (swizzle) {
@@ -889,6 +1528,7 @@ int MediaEngine::writeVideoImageWithRange(u32 bufferPtr, int frameWidth, int vid
 
 u8 *MediaEngine::getFrameImage() {
 #ifdef USE_FFMPEG
+	flushFrameRGB();
 	return m_pFrameRGB->data[0];
 #else
 	return NULL;
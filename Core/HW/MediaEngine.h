@@ -24,7 +24,13 @@
 
 // An approximation of what the interface will look like. Similar to JPCSP's.
 
+#include <condition_variable>
+#include <deque>
 #include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 #include "Common/CommonTypes.h"
 #include "Core/HLE/sceMpeg.h"
 #include "Core/HW/MpegDemux.h"
@@ -39,6 +45,8 @@ struct AVFrame;
 struct AVIOContext;
 struct AVFormatContext;
 struct AVCodecContext;
+struct AVCodec;
+struct AVBufferRef;
 #endif
 
 inline s64 getMpegTimeStamp(const u8 *buf) {
@@ -48,6 +56,10 @@ inline s64 getMpegTimeStamp(const u8 *buf) {
 
 #ifdef USE_FFMPEG
 bool InitFFmpeg();
+#ifdef __ANDROID__
+// The MediaCodec decoder needs the JavaVM for bHardwareVideoDecode.
+void InitFFmpegJavaVM(void *vm);
+#endif
 #endif
 
 class MediaEngine
@@ -96,6 +108,36 @@ class MediaEngine
 	bool SetupStreams();
 	bool setVideoDim(int width = 0, int height = 0);
 	void updateSwsFormat(int videoPixelMode);
+#ifdef USE_FFMPEG
+	bool setupHardwareDecoder(AVCodecContext *codecCtx, AVCodec **codec);
+	bool decodeVideoFrame(AVCodecContext *codecCtx, s64 &pts);
+	AVFrame *softwareVideoFrame();
+	void convertVideoFrame(const AVFrame *frame, int videoPixelMode, u8 *dest);
+	// Whether frame can skip m_pFrameRGB and be converted straight into the game's buffer.
+	bool canWriteDirect(const AVFrame *frame) const;
+	void keepFrameYUV(AVFrame *frame, int videoPixelMode, bool move);
+	void flushFrameRGB();
+	void writeFrameYUV(u8 *dest, int frameWidth, int videoPixelMode, int xpos, int ypos, int width, int height);
+
+	// Decoding ahead, for iVideoDecodeAhead.
+	struct AheadFrame {
+		std::vector<u8> pixels;
+		// What the pixels came from, in case the game changes the pixel mode.
+		AVFrame *frame;
+		int pixelMode;
+		bool got;
+		s64 pts;
+		// How much of m_pdata the decoder read for this frame, popped when it's handed out.
+		int bytesRead;
+		int lastReadSize;
+		int bytesLeft;
+	};
+	bool stepVideoAhead(int videoPixelMode, bool skipFrame);
+	AheadFrame decodeAheadFrame(AVCodecContext *codecCtx, int videoPixelMode, bool convert);
+	void deliverAheadFrame(AheadFrame &entry, int videoPixelMode, bool skipFrame);
+	void decodeAheadThread();
+	void stopDecodeAhead();
+#endif
 	int getNextAudioFrame(u8 **buf, int *headerCode1, int *headerCode2);
 
 public:  // TODO: Very little of this below should be public.
@@ -108,6 +150,29 @@ class MediaEngine
 	AVFrame *m_pFrameRGB;
 	AVIOContext *m_pIOContext;
 	SwsContext *m_sws_ctx;
+	// Frames from a hardware decoder are copied here before scaling.
+	AVFrame *m_pFrameSW;
+	AVBufferRef *m_hwDeviceCtx;
+	int m_hwPixFmt;
+	// When set, the current picture is still YUV, and m_pFrameRGB is stale until flushFrameRGB().
+	AVFrame *m_pFrameYUV;
+	bool m_frameYUVCurrent;
+	int m_frameRGBMode;
+
+	bool m_decodeAhead;
+	std::thread *m_aheadThread;
+	std::condition_variable m_aheadCond;
+	// Held while the FFmpeg contexts are in use, by the emu thread or the decode ahead thread.
+	std::mutex m_decodeLock;
+	std::deque<AheadFrame> m_aheadFrames;
+	bool m_aheadStop;
+	// With m_decodeAhead, the demuxer reads m_pdata without popping, this far in.
+	int m_aheadReadPos;
+	int m_aheadFrameBytes;
+	int m_aheadLastRead;
+	int m_aheadMaxFrameBytes;
+	int m_aheadPixelMode;
+	s64 m_aheadPts;
 #endif
 
 	int m_sws_fmt;
@@ -123,6 +188,8 @@ class MediaEngine
 	int m_bufSize;
 	s64 m_videopts;
 	BufferQueue *m_pdata;
+	// Guards m_pdata (pushed here, read by the decode ahead thread) and the m_aheadFrames queue.
+	std::mutex m_aheadLock;
 
 	MpegDemux *m_demux;
 	SimpleAudio *m_audioContext;
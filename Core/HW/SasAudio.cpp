@@ -16,8 +16,11 @@
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
 #include <algorithm>
+#include <climits>
+#include <mutex>
 
 #include "base/basictypes.h"
+#include "base/timeutil.h"
 #include "profiler/profiler.h"
 
 #include "Core/MemMapHelpers.h"
@@ -25,6 +28,7 @@
 #include "Core/Config.h"
 #include "Core/Reporting.h"
 #include "Core/Util/AudioFormat.h"
+#include "Common/ThreadPools.h"
 #include "SasAudio.h"
 
 // #define AUDIO_TO_FILE
@@ -91,16 +95,23 @@ void VagDecoder::DecodeBlock(u8 *&read_pointer) {
 	int coef1 = f[predict_nr][0];
 	int coef2 = -f[predict_nr][1];
 
-	// TODO: Unroll once more and interleave the unpacking with the decoding more?
-	for (int i = 0; i < 28; i += 2) {
-		u8 d = *readp++;
-		int sample1 = (short)((d & 0xf) << 12) >> shift_factor;
-		int sample2 = (short)((d & 0xf0) << 8) >> shift_factor;
-		s2 = clamp_s16(sample1 + ((s1 * coef1 + s2 * coef2) >> 6));
-		s1 = clamp_s16(sample2 + ((s2 * coef1 + s1 * coef2) >> 6));
-		samples[i] = s2;
-		samples[i + 1] = s1;
+	// The unpacking is vectorized, but the filter depends on the previous two outputs.
+	if (coef1 == 0 && coef2 == 0) {
+		// Nothing to predict, so the unpacked samples are already the output.
+		UnpackVagSamples(readp, shift_factor, samples);
+		s2 = samples[26];
+		s1 = samples[27];
+	} else {
+		s16 unpacked[28];
+		UnpackVagSamples(readp, shift_factor, unpacked);
+		for (int i = 0; i < 28; i += 2) {
+			s2 = clamp_s16(unpacked[i] + ((s1 * coef1 + s2 * coef2) >> 6));
+			s1 = clamp_s16(unpacked[i + 1] + ((s2 * coef1 + s1 * coef2) >> 6));
+			samples[i] = s2;
+			samples[i + 1] = s1;
+		}
 	}
+	readp += 14;
 
 	s_1 = s1;
 	s_2 = s2;
@@ -362,9 +373,11 @@ void SasInstance::GetDebugText(char *text, size_t bufsize) {
 
 	snprintf(text, bufsize,
 		"SR: %d Mode: %s Grain: %d\n"
+		"Mix: %d us (estimated %d us)\n"
 		"Effect: Type: %d Dry: %d Wet: %d L: %d R: %d Delay: %d Feedback: %d\n"
 		"\n%s\n",
 		sampleRate, outputMode == PSP_SAS_OUTPUTMODE_RAW ? "Raw" : "Mixed", grainSize,
+		lastMixUs_, EstimateMixUs(),
 		waveformEffect.type, waveformEffect.isDryOn, waveformEffect.isWetOn, waveformEffect.leftVol, waveformEffect.rightVol, waveformEffect.delay, waveformEffect.feedback,
 		voiceBuf);
 
@@ -472,7 +485,7 @@ bool SasVoice::HaveSamplesEnded() const {
 	}
 }
 
-void SasInstance::MixVoice(SasVoice &voice) {
+void SasInstance::MixVoice(SasVoice &voice, s32 *mixBuf, s32 *sendBuf, int16_t *mixTemp) {
 	switch (voice.type) {
 	case VOICETYPE_VAG:
 		if (voice.type == VOICETYPE_VAG && !voice.vagAddr)
@@ -498,48 +511,71 @@ void SasInstance::MixVoice(SasVoice &voice) {
 		// TODO: Special case no-resample case (and 2x and 0.5x) for speed, it's not uncommon
 
 		// Two passes: First read, then resample.
-		mixTemp_[0] = voice.resampleHist[0];
-		mixTemp_[1] = voice.resampleHist[1];
+		mixTemp[0] = voice.resampleHist[0];
+		mixTemp[1] = voice.resampleHist[1];
 
 		int voicePitch = voice.pitch;
 		u32 sampleFrac = voice.sampleFrac;
 		int samplesToRead = (sampleFrac + voicePitch * std::max(0, grainSize - delay)) >> PSP_SAS_PITCH_BASE_SHIFT;
-		if (samplesToRead > ARRAY_SIZE(mixTemp_) - 2) {
+		if (samplesToRead > PSP_SAS_MIX_TEMP_SIZE - 2) {
 			ERROR_LOG(SCESAS, "Too many samples to read (%d)! This shouldn't happen.", samplesToRead);
-			samplesToRead = ARRAY_SIZE(mixTemp_) - 2;
+			samplesToRead = PSP_SAS_MIX_TEMP_SIZE - 2;
 		}
-		voice.ReadSamples(&mixTemp_[2], samplesToRead);
+		voice.ReadSamples(&mixTemp[2], samplesToRead);
 		int tempPos = 2 + samplesToRead;
 
-		for (int i = delay; i < grainSize; i++) {
-			const int16_t *s = mixTemp_ + (sampleFrac >> PSP_SAS_PITCH_BASE_SHIFT);
+		// Resample, step the envelope, then scale and mix, each over the whole grain.
+		// The last two passes have no branches, so they vectorize.
+		const int count = grainSize - delay;
+		int resampled[PSP_SAS_MAX_GRAIN];
+		int envelope[PSP_SAS_MAX_GRAIN];
+
+		// Linear interpolation. Good enough. Need to make resampleHist bigger if we want more.
+		if (voicePitch == PSP_SAS_PITCH_BASE) {
+			// The fraction never changes, so this is just a weighted sum of neighbors.
+			const int16_t *s = mixTemp + (sampleFrac >> PSP_SAS_PITCH_BASE_SHIFT);
+			const int f = sampleFrac & PSP_SAS_PITCH_MASK;
+			for (int i = 0; i < count; i++) {
+				resampled[i] = (s[i] * (PSP_SAS_PITCH_MASK - f) + s[i + 1] * f) >> PSP_SAS_PITCH_BASE_SHIFT;
+			}
+			sampleFrac += voicePitch * std::max(0, count);
+		} else {
+			for (int i = 0; i < count; i++) {
+				const int16_t *s = mixTemp + (sampleFrac >> PSP_SAS_PITCH_BASE_SHIFT);
+				int f = sampleFrac & PSP_SAS_PITCH_MASK;
+				resampled[i] = (s[0] * (PSP_SAS_PITCH_MASK - f) + s[1] * f) >> PSP_SAS_PITCH_BASE_SHIFT;
+				sampleFrac += voicePitch;
+			}
+		}
 
-			// Linear interpolation. Good enough. Need to make resampleHist bigger if we want more.
-			int f = sampleFrac & PSP_SAS_PITCH_MASK;
-			int sample = (s[0] * (PSP_SAS_PITCH_MASK - f) + s[1] * f) >> PSP_SAS_PITCH_BASE_SHIFT;
-			sampleFrac += voicePitch;
+		voice.envelope.StepBlock(envelope, count);
 
+		const int volumeLeft = voice.volumeLeft;
+		const int volumeRight = voice.volumeRight;
+		const int effectLeft = voice.effectLeft;
+		const int effectRight = voice.effectRight;
+		s32 *mixOut = mixBuf + delay * 2;
+		s32 *sendOut = sendBuf + delay * 2;
+		for (int i = 0; i < count; i++) {
 			// The maximum envelope height (PSP_SAS_ENVELOPE_HEIGHT_MAX) is (1 << 30) - 1.
 			// Reduce it to 14 bits, by shifting off 15.  Round up by adding (1 << 14) first.
-			int envelopeValue = voice.envelope.GetHeight();
-			voice.envelope.Step();
-			envelopeValue = (envelopeValue + (1 << 14)) >> 15;
+			int envelopeValue = (envelope[i] + (1 << 14)) >> 15;
 
 			// We just scale by the envelope before we scale by volumes.
 			// Again, we round up by adding (1 << 14) first (*after* multiplying.)
-			sample = ((sample * envelopeValue) + (1 << 14)) >> 15;
+			int sample = ((resampled[i] * envelopeValue) + (1 << 14)) >> 15;
 
 			// We mix into this 32-bit temp buffer and clip in a second loop
 			// Ideally, the shift right should be there too but for now I'm concerned about
 			// not overflowing.
-			mixBuffer[i * 2] += (sample * voice.volumeLeft) >> 12;
-			mixBuffer[i * 2 + 1] += (sample * voice.volumeRight) >> 12;
-			sendBuffer[i * 2] += sample * voice.effectLeft >> 12;
-			sendBuffer[i * 2 + 1] += sample * voice.effectRight >> 12;
+			mixOut[i * 2] += (sample * volumeLeft) >> 12;
+			mixOut[i * 2 + 1] += (sample * volumeRight) >> 12;
+			sendOut[i * 2] += sample * effectLeft >> 12;
+			sendOut[i * 2 + 1] += sample * effectRight >> 12;
 		}
 
-		voice.resampleHist[0] = mixTemp_[tempPos - 2];
-		voice.resampleHist[1] = mixTemp_[tempPos - 1];
+		voice.resampleHist[0] = mixTemp[tempPos - 2];
+		voice.resampleHist[1] = mixTemp[tempPos - 1];
 
 		voice.sampleFrac = sampleFrac - (tempPos - 2) * PSP_SAS_PITCH_BASE;;
 
@@ -553,15 +589,52 @@ void SasInstance::MixVoice(SasVoice &voice) {
 	}
 }
 
+// Each slice clears and sums a whole grain of mix buffers, so don't bother splitting finer than this.
+static const int MIN_PARALLEL_VOICES = 4;
+
+void SasInstance::MixVoicesParallel(const int *voiceIndices, int count) {
+	std::mutex sumLock;
+	GlobalThreadPool::Loop([&](int lower, int upper) {
+		// Each slice mixes into its own buffers and then adds them in.  These are plain integer
+		// sums, so the order doesn't matter and the result is exactly the serial one.
+		s32 sliceMix[PSP_SAS_MAX_GRAIN * 2];
+		s32 sliceSend[PSP_SAS_MAX_GRAIN * 2];
+		int16_t sliceTemp[PSP_SAS_MIX_TEMP_SIZE];
+		memset(sliceMix, 0, grainSize * sizeof(s32) * 2);
+		memset(sliceSend, 0, grainSize * sizeof(s32) * 2);
+
+		for (int i = lower; i < upper; ++i) {
+			MixVoice(voices[voiceIndices[i]], sliceMix, sliceSend, sliceTemp);
+		}
+
+		std::lock_guard<std::mutex> guard(sumLock);
+		for (int i = 0; i < grainSize * 2; ++i) {
+			mixBuffer[i] += sliceMix[i];
+			sendBuffer[i] += sliceSend[i];
+		}
+	}, 0, count, MIN_PARALLEL_VOICES);
+}
+
 void SasInstance::Mix(u32 outAddr, u32 inAddr, int leftVol, int rightVol) {
+	double startTime = real_time_now();
 	int voicesPlayingCount = 0;
+	int parallelVoices[PSP_SAS_VOICES_MAX];
+	int parallelCount = 0;
+	const bool parallel = g_Config.bParallelSASMix && g_Config.iNumWorkerThreads > 1;
 
 	for (int v = 0; v < PSP_SAS_VOICES_MAX; v++) {
 		SasVoice &voice = voices[v];
 		if (!voice.playing || voice.paused)
 			continue;
 		voicesPlayingCount++;
-		MixVoice(voice);
+		// Atrac voices decode through sceAtrac's shared state, so they're always mixed here.
+		if (parallel && voice.type != VOICETYPE_ATRAC3)
+			parallelVoices[parallelCount++] = v;
+		else
+			MixVoice(voice, mixBuffer, sendBuffer, mixTemp_);
+	}
+	if (parallelCount > 0) {
+		MixVoicesParallel(parallelVoices, parallelCount);
 	}
 
 	// Then mix the send buffer in with the rest.
@@ -591,6 +664,8 @@ void SasInstance::Mix(u32 outAddr, u32 inAddr, int leftVol, int rightVol) {
 #ifdef AUDIO_TO_FILE
 	fwrite(Memory::GetPointer(outAddr), 1, grainSize * 2 * 2, audioDump);
 #endif
+
+	lastMixUs_ = (int)((real_time_now() - startTime) * 1000000.0);
 }
 
 void SasInstance::WriteMixedOutput(s16 *outp, const s16 *inp, int leftVol, int rightVol) {
@@ -665,7 +740,7 @@ void SasInstance::ApplyWaveformEffect() {
 	}
 
 	// Volume max is 0x1000, while our factor is up to 0x8000. Shifting right by 3 fixes that.
-	reverb_.ProcessReverb(sendBufferProcessed, sendBufferDownsampled, grainSize / 2, waveformEffect.leftVol << 3, waveformEffect.rightVol << 3);
+	reverb_.ProcessReverb(sendBufferProcessed, sendBufferDownsampled, grainSize / 2, waveformEffect.leftVol << 3, waveformEffect.rightVol << 3, g_Config.bHalfRateReverb);
 }
 
 void SasInstance::DoState(PointerWrap &p) {
@@ -910,6 +985,83 @@ inline void ADSREnvelope::Step() {
 	}
 }
 
+// First step j >= 1 where height + j * delta >= threshold, or INT_MAX if never.
+static s64 FirstStepAtLeast(s64 height, s64 delta, s64 threshold) {
+	if (height + delta >= threshold)
+		return 1;
+	if (delta <= 0)
+		return INT_MAX;
+	return (threshold - height + delta - 1) / delta;
+}
+
+// First step j >= 1 where height + j * delta < threshold, or INT_MAX if never.
+static s64 FirstStepBelow(s64 height, s64 delta, s64 threshold) {
+	if (height + delta < threshold)
+		return 1;
+	if (delta >= 0)
+		return INT_MAX;
+	return (height - threshold) / -delta + 1;
+}
+
+// How many of the next steps just add delta to the height, without changing state.
+int ADSREnvelope::LinearSteps(int maxSteps, s64 &delta) const {
+	int type, rate;
+	switch (state_) {
+	case STATE_ATTACK: type = attackType; rate = attackRate; break;
+	case STATE_DECAY: type = decayType; rate = decayRate; break;
+	case STATE_SUSTAIN: type = sustainType; rate = sustainRate; break;
+	case STATE_RELEASE: type = releaseType; rate = releaseRate; break;
+	case STATE_OFF:
+		delta = 0;
+		return maxSteps;
+	default:
+		return 0;
+	}
+
+	if (type == PSP_SAS_ADSR_CURVE_MODE_LINEAR_INCREASE)
+		delta = rate;
+	else if (type == PSP_SAS_ADSR_CURVE_MODE_LINEAR_DECREASE)
+		delta = -(s64)rate;
+	else
+		return 0;
+
+	// The checks from Step(), solved for the first step that would trigger them.
+	s64 trigger;
+	switch (state_) {
+	case STATE_ATTACK:
+		trigger = std::min(FirstStepAtLeast(height_, delta, PSP_SAS_ENVELOPE_HEIGHT_MAX), FirstStepBelow(height_, delta, 0));
+		break;
+	case STATE_DECAY:
+		trigger = FirstStepBelow(height_, delta, sustainLevel);
+		break;
+	default:
+		trigger = FirstStepBelow(height_, delta, 1);
+		break;
+	}
+	return (int)std::min(trigger - 1, (s64)maxSteps);
+}
+
+void ADSREnvelope::StepBlock(int *heights, int count) {
+	int i = 0;
+	while (i < count) {
+		s64 delta;
+		int steps = LinearSteps(count - i, delta);
+		if (steps > 0) {
+			s64 height = height_;
+			for (int j = 0; j < steps; ++j) {
+				heights[i + j] = height > (s64)PSP_SAS_ENVELOPE_HEIGHT_MAX ? PSP_SAS_ENVELOPE_HEIGHT_MAX : height;
+				height += delta;
+			}
+			height_ = height;
+			i += steps;
+		} else {
+			// Curved, or about to change state: one at a time.
+			heights[i++] = GetHeight();
+			Step();
+		}
+	}
+}
+
 void ADSREnvelope::KeyOn() {
 	SetState(STATE_KEYON);
 }
@@ -159,6 +159,8 @@ class ADSREnvelope {
 	void End();
 
 	inline void Step();
+	// Same as calling GetHeight() and Step() count times, but linear stretches are filled as a ramp.
+	void StepBlock(int *heights, int count);
 
 	int GetHeight() const {
 		return height_ > (s64)PSP_SAS_ENVELOPE_HEIGHT_MAX ? PSP_SAS_ENVELOPE_HEIGHT_MAX : height_;
@@ -196,6 +198,7 @@ class ADSREnvelope {
 		STATE_RELEASE = 3,
 	};
 	void SetState(ADSRState state);
+	int LinearSteps(int maxSteps, s64 &delta) const;
 
 	ADSRState state_;
 	s64 height_;  // s64 to avoid having to care about overflow when calculating. TODO: this should be fine as s32
@@ -272,6 +275,9 @@ struct SasVoice {
 	SasAtrac3 atrac3;
 };
 
+// Room to read a grain at the max pitch, plus the resample history and some extra margin.
+static const int PSP_SAS_MIX_TEMP_SIZE = PSP_SAS_MAX_GRAIN * 4 + 2 + 8;
+
 class SasInstance {
 public:
 	SasInstance();
@@ -294,7 +300,8 @@ class SasInstance {
 	FILE *audioDump;
 
 	void Mix(u32 outAddr, u32 inAddr = 0, int leftVol = 0, int rightVol = 0);
-	void MixVoice(SasVoice &voice);
+	void MixVoice(SasVoice &voice, s32 *mixBuf, s32 *sendBuf, int16_t *mixTemp);
+	void MixVoicesParallel(const int *voiceIndices, int count);
 
 	// Applies reverb to send buffer, according to waveformEffect.
 	void ApplyWaveformEffect();
@@ -311,5 +318,7 @@ class SasInstance {
 private:
 	SasReverb reverb_;
 	int grainSize;
-	int16_t mixTemp_[PSP_SAS_MAX_GRAIN * 4 + 2 + 8];  // some extra margin for very high pitches.
+	int16_t mixTemp_[PSP_SAS_MIX_TEMP_SIZE];
+	// Wall time of the last Mix(), to compare against EstimateMixUs() in the debug text.
+	int lastMixUs_ = 0;
 };
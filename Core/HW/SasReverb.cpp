@@ -15,6 +15,7 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#include <algorithm>
 #include <cstdint>
 #include <cstring>
 
@@ -167,11 +168,33 @@ const char *SasReverb::GetPresetName(int preset) {
 	return presets[preset].name;
 }
 
+// The same preset with every delay halved, for running at half the rate.
+static SasReverbData HalfRatePreset(const SasReverbData &d) {
+	SasReverbData h = d;
+	h.size = d.size / 2;
+	// These are subtracted from the APF taps, and must stay in the past.
+	h.dAPF1 = std::max(1, d.dAPF1 / 2);
+	h.dAPF2 = std::max(1, d.dAPF2 / 2);
+	int16_t *taps[] = {
+		&h.mLSAME, &h.mRSAME, &h.mLCOMB1, &h.mRCOMB1, &h.mLCOMB2, &h.mRCOMB2,
+		&h.dLSAME, &h.dRSAME, &h.mLDIFF, &h.mRDIFF, &h.mLCOMB3, &h.mRCOMB3, &h.mLCOMB4, &h.mRCOMB4,
+		&h.dLDIFF, &h.dRDIFF, &h.mLAPF1, &h.mRAPF1, &h.mLAPF2, &h.mRAPF2,
+	};
+	for (int16_t *tap : taps) {
+		*tap /= 2;
+	}
+	return h;
+}
+
 void SasReverb::SetPreset(int preset) {
 	if (preset < (int)ARRAY_SIZE(presets))
 		preset_ = preset;
+	Reset();
+}
+
+void SasReverb::Reset() {
 	if (preset_ != -1) {
-		pos_ = BUFSIZE - presets[preset_].size;
+		pos_ = BUFSIZE - (halfRate_ ? HalfRatePreset(presets[preset_]) : presets[preset_]).size;
 		memset(workspace_, 0, sizeof(int16_t) * BUFSIZE);
 	} else {
 		pos_ = 0;
@@ -206,7 +229,125 @@ class BufferWrapper {
 	int size_;
 };
 
-void SasReverb::ProcessReverb(int16_t *output, const int16_t *input, size_t inputSize, uint16_t volLeft, uint16_t volRight) {
+// For a run of frames where no tap wraps, so they're just offsets from a pointer.
+class DirectBuffer {
+public:
+	DirectBuffer(int16_t *buffer, int position) : p_(buffer + position) {}
+	int16_t &operator [](int index) {
+		return p_[index];
+	}
+	void Next() {
+		p_++;
+	}
+
+private:
+	int16_t *p_;
+};
+
+// One 22khz frame, the same math as ProcessReverbReference().
+template <typename Buffer>
+static inline void ReverbFrame(Buffer &b, const SasReverbData &d, int16_t LeftInput, int16_t RightInput, int16_t *out, uint16_t volLeft, uint16_t volRight) {
+	int16_t Lin = LeftInput;
+	int16_t Rin = RightInput;
+
+	b[d.mLSAME] = clamp_s16(Lin + (b[d.dLSAME] * d.vWALL >> 15) - (b[d.mLSAME - 1]*d.vIIR >> 15) + b[d.mLSAME - 1]);
+	b[d.mRSAME] = clamp_s16(Rin + (b[d.dRSAME] * d.vWALL >> 15) - (b[d.mRSAME - 1]*d.vIIR >> 15) + b[d.mRSAME - 1]);
+	b[d.mLDIFF] = clamp_s16(Lin + (b[d.dRDIFF] * d.vWALL >> 15) - (b[d.mLDIFF - 1]*d.vIIR >> 15) + b[d.mLDIFF - 1]);
+	b[d.mRDIFF] = clamp_s16(Rin + (b[d.dLDIFF] * d.vWALL >> 15) - (b[d.mRDIFF - 1]*d.vIIR >> 15) + b[d.mRDIFF - 1]);
+	int32_t Lout = ((d.vCOMB1*b[d.mLCOMB1] + d.vCOMB2*b[d.mLCOMB2] + d.vCOMB3*b[d.mLCOMB3] + d.vCOMB4*b[d.mLCOMB4]) >> 15);
+	int32_t Rout = ((d.vCOMB1*b[d.mRCOMB1] + d.vCOMB2*b[d.mRCOMB2] + d.vCOMB3*b[d.mRCOMB3] + d.vCOMB4*b[d.mRCOMB4]) >> 15);
+	b[d.mLAPF1] = clamp_s16(Lout - (d.vAPF1*b[(d.mLAPF1 - d.dAPF1)] >> 15));
+	Lout = b[(d.mLAPF1 - d.dAPF1)] + (b[d.mLAPF1] * d.vAPF1 >> 15);
+	b[d.mRAPF1] = clamp_s16(Rout - (d.vAPF1*b[(d.mRAPF1 - d.dAPF1)] >> 15));
+	Rout = b[(d.mRAPF1 - d.dAPF1)] + (b[d.mRAPF1] * d.vAPF1 >> 15);
+	b[d.mLAPF2] = clamp_s16(Lout - (d.vAPF2*b[(d.mLAPF2 - d.dAPF2)] >> 15));
+	Lout = b[(d.mLAPF2 - d.dAPF2)] + (b[d.mLAPF2] * d.vAPF2 >> 15);
+	b[d.mRAPF2] = clamp_s16(Rout - (d.vAPF2*b[(d.mRAPF2 - d.dAPF2)] >> 15));
+	Rout = b[(d.mRAPF2 - d.dAPF2)] + (b[d.mRAPF2] * d.vAPF2 >> 15);
+	out[0] = clamp_s16(Lout * volLeft >> 15);
+	out[1] = clamp_s16(Rout * volRight >> 15);
+	out[2] = 0;
+	out[3] = 0;
+}
+
+void SasReverb::ProcessReverb(int16_t *output, const int16_t *input, size_t inputSize, uint16_t volLeft, uint16_t volRight, bool halfRate) {
+	if (preset_ == -1) {
+		ProcessReverbReference(output, input, inputSize, volLeft, volRight);
+		return;
+	}
+	if (halfRate != halfRate_) {
+		// The delays are different, so what's in the buffer is no use.
+		halfRate_ = halfRate;
+		Reset();
+	}
+
+	if (!halfRate) {
+		ProcessFrames(presets[preset_], output, input, inputSize, volLeft, volRight);
+		return;
+	}
+
+	// Average each pair of frames (the last one may be alone), reverb that, and output each result twice.
+	const size_t halfSize = (inputSize + 1) / 2;
+	halfRateInput_.resize(halfSize * 2);
+	halfRateOutput_.resize(halfSize * 4);
+	for (size_t i = 0; i < halfSize; ++i) {
+		const int16_t *frame1 = input + i * 4;
+		const int16_t *frame2 = i * 2 + 1 < inputSize ? frame1 + 2 : frame1;
+		halfRateInput_[i * 2 + 0] = (frame1[0] + frame2[0]) >> 1;
+		halfRateInput_[i * 2 + 1] = (frame1[1] + frame2[1]) >> 1;
+	}
+	ProcessFrames(HalfRatePreset(presets[preset_]), &halfRateOutput_[0], &halfRateInput_[0], halfSize, volLeft, volRight);
+	for (size_t i = 0; i < inputSize; ++i) {
+		memcpy(output + i * 4, &halfRateOutput_[(i / 2) * 4], sizeof(int16_t) * 4);
+	}
+}
+
+void SasReverb::ProcessFrames(const SasReverbData &preset, int16_t *output, const int16_t *input, size_t inputSize, uint16_t volLeft, uint16_t volRight) {
+	// A local copy, so the compiler knows the buffer writes can't change it.
+	const SasReverbData d = preset;
+
+	// Every offset that gets read or written.  While pos_ plus all of these stays inside the used
+	// part of the buffer, nothing wraps.
+	const int taps[] = {
+		d.mLSAME, d.mRSAME, d.mLSAME - 1, d.mRSAME - 1, d.mLDIFF, d.mRDIFF, d.mLDIFF - 1, d.mRDIFF - 1,
+		d.dLSAME, d.dRSAME, d.dLDIFF, d.dRDIFF,
+		d.mLCOMB1, d.mLCOMB2, d.mLCOMB3, d.mLCOMB4, d.mRCOMB1, d.mRCOMB2, d.mRCOMB3, d.mRCOMB4,
+		d.mLAPF1, d.mRAPF1, d.mLAPF1 - d.dAPF1, d.mRAPF1 - d.dAPF1,
+		d.mLAPF2, d.mRAPF2, d.mLAPF2 - d.dAPF2, d.mRAPF2 - d.dAPF2,
+	};
+	const int minTap = *std::min_element(taps, taps + ARRAY_SIZE(taps));
+	const int maxTap = *std::max_element(taps, taps + ARRAY_SIZE(taps));
+	const int base = BUFSIZE - d.size;
+
+	size_t i = 0;
+	while (i < inputSize) {
+		int run = 0;
+		if (pos_ + minTap >= base)
+			run = std::max(0, BUFSIZE - (pos_ + maxTap));
+		run = (int)std::min((size_t)run, inputSize - i);
+
+		if (run > 0) {
+			DirectBuffer b(workspace_, pos_);
+			for (int j = 0; j < run; ++j, ++i) {
+				// Dividing by two here is an incorrect hack, see ProcessReverbReference().
+				ReverbFrame(b, d, input[i * 2] >> 1, input[i * 2 + 1] >> 1, output + i * 4, volLeft, volRight);
+				b.Next();
+			}
+			pos_ += run;
+			if (pos_ >= BUFSIZE)
+				pos_ -= d.size;
+		} else {
+			// Something wraps this frame, so go through the wrapper.
+			BufferWrapper<BUFSIZE> b(workspace_, pos_, d.size);
+			ReverbFrame(b, d, input[i * 2] >> 1, input[i * 2 + 1] >> 1, output + i * 4, volLeft, volRight);
+			b.Next();
+			pos_ = b.GetPosition();
+			++i;
+		}
+	}
+}
+
+void SasReverb::ProcessReverbReference(int16_t *output, const int16_t *input, size_t inputSize, uint16_t volLeft, uint16_t volRight) {
 	// This means replicate the input signal in the processed buffer.
 	// Can also be used to verify that the error is in here...
 	if (preset_ == -1) {
@@ -17,6 +17,9 @@
 
 #pragma once
 
+#include <cstdint>
+#include <vector>
+
 struct SasReverbData;
 
 class SasReverb {
@@ -31,14 +34,23 @@ class SasReverb {
 
 	// Input should be a mixdown of all the channels that have reverb enabled, at 22khz.
 	// Output is written back at 44khz.
-	void ProcessReverb(int16_t *output, const int16_t *input, size_t inputSize, uint16_t volLeft, uint16_t volRight);
+	// With halfRate, the reverb itself runs at 11khz, which is cheaper but duller.
+	void ProcessReverb(int16_t *output, const int16_t *input, size_t inputSize, uint16_t volLeft, uint16_t volRight, bool halfRate = false);
+	// Straight from the description, to check ProcessReverb() against.  Full rate only.
+	void ProcessReverbReference(int16_t *output, const int16_t *input, size_t inputSize, uint16_t volLeft, uint16_t volRight);
 
 private:
 	enum {
 		BUFSIZE = 0x20000,
 	};
 
+	void Reset();
+	void ProcessFrames(const SasReverbData &d, int16_t *output, const int16_t *input, size_t inputSize, uint16_t volLeft, uint16_t volRight);
+
 	int16_t *workspace_;
 	int preset_;
 	int pos_;
+	bool halfRate_ = false;
+	std::vector<int16_t> halfRateInput_;
+	std::vector<int16_t> halfRateOutput_;
 };
\ No newline at end of file
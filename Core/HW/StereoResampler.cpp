@@ -29,13 +29,29 @@
 #define CONTROL_FACTOR  0.2f // in freq_shift per fifo size offset
 #define CONTROL_AVG     32
 
+// The ring is always allocated for the largest setting, so the mask never changes under Mix.
+#define RING_SIZE (MAX_SAMPLES_EXTRA * 2)
+#define RING_MASK (RING_SIZE - 1)
+
+// With AdaptiveAudioLatency, how many clean host callbacks before lowering the target fill.
+#define ADAPTIVE_STABLE_MIXES 128
+
+// PushSamples leaves this much behind m_indexR alone, since the sinc filter reads back into it.
+#define RING_HISTORY (PolyphaseFilterBank::TAPS * 2)
+
+// Fraction of the lower input/output rate that the sinc filter passes, the rest is transition band.
+#define HQ_CUTOFF 0.455f
+#define HQ_KAISER_BETA 7.0
+
+#include <algorithm>
+#include <cmath>
 #include <cstring>
 
+
 #include "base/logging.h"
 #include "base/NativeApp.h"
 #include "Common/ChunkFile.h"
 #include "Common/MathUtil.h"
-#include "Common/Atomics.h"
 #include "Core/Config.h"
 #include "Core/HW/StereoResampler.h"
 #include "Core/HLE/__sceAudio.h"
@@ -60,9 +76,11 @@ StereoResampler::StereoResampler()
 		, underrunCount_(0)
 		, overrunCount_(0)
 		, sample_rate_(0.0f)
-		, lastBufSize_(0) {
+		, lastBufSize_(0)
+		, lastPushSize_(0)
+		, targetFill_(LOW_WATERMARK_DEFAULT) {
 	// Need to have space for the worst case in case it changes.
-	m_buffer = new int16_t[MAX_SAMPLES_EXTRA * 2]();
+	m_buffer = new int16_t[RING_SIZE]();
 
 	// Some Android devices are v-synced to non-60Hz framerates. We simply timestretch audio to fit.
 	// TODO: should only do this if auto frameskip is off?
@@ -141,8 +159,117 @@ inline void ClampBufferToS16WithVolume(s16 *out, const s32 *in, size_t size) {
 	}
 }
 
+// Zeroth order modified Bessel function of the first kind, for the Kaiser window.
+static double BesselI0(double x) {
+	double sum = 1.0;
+	double term = 1.0;
+	for (int k = 1; k < 32; ++k) {
+		double t = x / (2.0 * k);
+		term *= t * t;
+		sum += term;
+		if (term < sum * 1e-12)
+			break;
+	}
+	return sum;
+}
+
+void PolyphaseFilterBank::Design(float cutoff) {
+	if (cutoff == cutoff_)
+		return;
+	cutoff_ = cutoff;
+
+	const int center = TAPS / 2 - 1;
+	const double halfWidth = TAPS / 2;
+	const double norm = BesselI0(HQ_KAISER_BETA);
+	// SSE pairs the coefficients up for _mm_madd_epi16 on frames shuffled to LLRR.
+#ifdef _M_SSE
+	coefs_.resize(PHASES * TAPS * 2);
+#else
+	coefs_.resize(PHASES * TAPS);
+#endif
+	for (int phase = 0; phase < PHASES; ++phase) {
+		double taps[TAPS];
+		double sum = 0.0;
+		for (int k = 0; k < TAPS; ++k) {
+			double x = (k - center) - (double)phase / PHASES;
+			double w = x / halfWidth;
+			double window = w * w < 1.0 ? BesselI0(HQ_KAISER_BETA * sqrt(1.0 - w * w)) / norm : 0.0;
+			double arg = 2.0 * M_PI * cutoff * x;
+			taps[k] = (arg == 0.0 ? 1.0 : sin(arg) / arg) * window;
+			sum += taps[k];
+		}
+
+		// Unity gain at DC, putting the rounding error on the biggest tap.
+		s16 fixed[TAPS];
+		int total = 0;
+		int biggest = 0;
+		for (int k = 0; k < TAPS; ++k) {
+			fixed[k] = (s16)floor(taps[k] / sum * (1 << COEF_SHIFT) + 0.5);
+			total += fixed[k];
+			if (fixed[k] > fixed[biggest])
+				biggest = k;
+		}
+		fixed[biggest] += (1 << COEF_SHIFT) - total;
+
+#ifdef _M_SSE
+		s16 *dest = &coefs_[phase * TAPS * 2];
+		for (int k = 0; k < TAPS; k += 2) {
+			dest[k * 2 + 0] = fixed[k];
+			dest[k * 2 + 1] = fixed[k + 1];
+			dest[k * 2 + 2] = fixed[k];
+			dest[k * 2 + 3] = fixed[k + 1];
+		}
+#else
+		memcpy(&coefs_[phase * TAPS], fixed, sizeof(fixed));
+#endif
+	}
+}
+
+void PolyphaseFilterBank::Filter(const s16 *window, u32 frac, s16 *out) const {
+	const int phase = (frac & 0xFFFF) >> (16 - PHASE_BITS);
+#ifdef _M_SSE
+	const s16 *coefs = &coefs_[phase * TAPS * 2];
+	__m128i acc = _mm_setzero_si128();
+	for (int k = 0; k < TAPS * 2; k += 8) {
+		__m128i frames = _mm_loadu_si128((const __m128i *)(window + k));
+		frames = _mm_shufflehi_epi16(_mm_shufflelo_epi16(frames, _MM_SHUFFLE(3, 1, 2, 0)), _MM_SHUFFLE(3, 1, 2, 0));
+		acc = _mm_add_epi32(acc, _mm_madd_epi16(frames, _mm_loadu_si128((const __m128i *)(coefs + k))));
+	}
+	// Now L, R, L, R.
+	acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+	acc = _mm_srai_epi32(_mm_add_epi32(acc, _mm_set1_epi32(1 << (COEF_SHIFT - 1))), COEF_SHIFT);
+	int packed = _mm_cvtsi128_si32(_mm_packs_epi32(acc, acc));
+	memcpy(out, &packed, sizeof(packed));
+#elif PPSSPP_ARCH(ARM_NEON)
+	const s16 *coefs = &coefs_[phase * TAPS];
+	int32x4_t accL = vdupq_n_s32(0);
+	int32x4_t accR = vdupq_n_s32(0);
+	for (int k = 0; k < TAPS; k += 8) {
+		int16x8x2_t frames = vld2q_s16(window + k * 2);
+		int16x8_t c = vld1q_s16(coefs + k);
+		accL = vmlal_s16(accL, vget_low_s16(frames.val[0]), vget_low_s16(c));
+		accL = vmlal_s16(accL, vget_high_s16(frames.val[0]), vget_high_s16(c));
+		accR = vmlal_s16(accR, vget_low_s16(frames.val[1]), vget_low_s16(c));
+		accR = vmlal_s16(accR, vget_high_s16(frames.val[1]), vget_high_s16(c));
+	}
+	int32x2_t lr = vpadd_s32(vpadd_s32(vget_low_s32(accL), vget_high_s32(accL)), vpadd_s32(vget_low_s32(accR), vget_high_s32(accR)));
+	int16x4_t packed = vqrshrn_n_s32(vcombine_s32(lr, lr), COEF_SHIFT);
+	vst1_lane_s32((int32_t *)out, vreinterpret_s32_s16(packed), 0);
+#else
+	const s16 *coefs = &coefs_[phase * TAPS];
+	int l = 0;
+	int r = 0;
+	for (int k = 0; k < TAPS; ++k) {
+		l += window[k * 2 + 0] * coefs[k];
+		r += window[k * 2 + 1] * coefs[k];
+	}
+	out[0] = clamp_s16((l + (1 << (COEF_SHIFT - 1))) >> COEF_SHIFT);
+	out[1] = clamp_s16((r + (1 << (COEF_SHIFT - 1))) >> COEF_SHIFT);
+#endif
+}
+
 void StereoResampler::Clear() {
-	memset(m_buffer, 0, m_bufsize * 2 * sizeof(int16_t));
+	memset(m_buffer, 0, RING_SIZE * sizeof(int16_t));
 }
 
 // Executed from sound stream thread
@@ -159,10 +286,11 @@ unsigned int StereoResampler::Mix(short* samples, unsigned int numSamples, bool
 	// so we will just ignore new written data while interpolating.
 	// Without this cache, the compiler wouldn't be allowed to optimize the
 	// interpolation loop.
-	u32 indexR = Common::AtomicLoad(m_indexR);
-	u32 indexW = Common::AtomicLoad(m_indexW);
+	// The acquire pairs with the release in PushSamples, so the samples up to indexW are visible.
+	u32 indexR = m_indexR.load(std::memory_order_relaxed);
+	u32 indexW = m_indexW.load(std::memory_order_acquire);
 
-	const int INDEX_MASK = (m_bufsize * 2 - 1);
+	const u32 INDEX_MASK = RING_MASK;
 
 	// We force on the audio resampler if the output sample rate doesn't match the input.
 	if (!g_Config.bAudioResampler && sample_rate == (int)m_input_sample_rate) {
@@ -178,33 +306,56 @@ unsigned int StereoResampler::Mix(short* samples, unsigned int numSamples, bool
 		// Drift prevention mechanism
 		float numLeft = (float)(((indexW - indexR) & INDEX_MASK) / 2);
 		m_numLeftI = (numLeft + m_numLeftI*(CONTROL_AVG - 1)) / CONTROL_AVG;
-		float offset = (m_numLeftI - m_lowwatermark) * CONTROL_FACTOR;
+		float offset = (m_numLeftI - targetFill_.load(std::memory_order_relaxed)) * CONTROL_FACTOR;
 		if (offset > MAX_FREQ_SHIFT) offset = MAX_FREQ_SHIFT;
 		if (offset < -MAX_FREQ_SHIFT) offset = -MAX_FREQ_SHIFT;
 
 		sample_rate_ = (float)(m_input_sample_rate + offset);
 		const u32 ratio = (u32)(65536.0 * sample_rate_ / (double)sample_rate);
 
-		// TODO: consider a higher-quality resampling algorithm.
-		// TODO: Add a fast path for 1:1.
-		for (; currentSample < numSamples * 2 && ((indexW - indexR) & INDEX_MASK) > 2; currentSample += 2) {
-			u32 indexR2 = indexR + 2; //next sample
-			s16 l1 = m_buffer[indexR & INDEX_MASK]; //current
-			s16 r1 = m_buffer[(indexR + 1) & INDEX_MASK]; //current
-			s16 l2 = m_buffer[indexR2 & INDEX_MASK]; //next
-			s16 r2 = m_buffer[(indexR2 + 1) & INDEX_MASK]; //next
-			int sampleL = ((l1 << 16) + (l2 - l1) * (u16)m_frac) >> 16;
-			int sampleR = ((r1 << 16) + (r2 - r1) * (u16)m_frac) >> 16;
-			samples[currentSample] = sampleL;
-			samples[currentSample + 1] = sampleR;
-			m_frac += ratio;
-			indexR += 2 * (u16)(m_frac >> 16);
-			m_frac &= 0xffff;
+		if (g_Config.bHighQualityResampler) {
+			// Only redesigns when the rates change, not for the drift control.
+			float outputRatio = (float)sample_rate / (float)m_input_sample_rate;
+			hqFilter_.Design(HQ_CUTOFF * std::min(1.0f, outputRatio));
+
+			const u32 WINDOW_SIZE = PolyphaseFilterBank::TAPS * 2;
+			const u32 HISTORY = (PolyphaseFilterBank::TAPS / 2 - 1) * 2;
+			s16 wrapped[WINDOW_SIZE];
+			for (; currentSample < numSamples * 2 && ((indexW - indexR) & INDEX_MASK) > WINDOW_SIZE - HISTORY; currentSample += 2) {
+				u32 start = (indexR - HISTORY) & INDEX_MASK;
+				const s16 *window = &m_buffer[start];
+				if (start + WINDOW_SIZE > RING_SIZE) {
+					for (u32 i = 0; i < WINDOW_SIZE; ++i)
+						wrapped[i] = m_buffer[(start + i) & INDEX_MASK];
+					window = wrapped;
+				}
+				hqFilter_.Filter(window, m_frac, &samples[currentSample]);
+				m_frac += ratio;
+				indexR += 2 * (u16)(m_frac >> 16);
+				m_frac &= 0xffff;
+			}
+		} else {
+			// TODO: Add a fast path for 1:1.
+			for (; currentSample < numSamples * 2 && ((indexW - indexR) & INDEX_MASK) > 2; currentSample += 2) {
+				u32 indexR2 = indexR + 2; //next sample
+				s16 l1 = m_buffer[indexR & INDEX_MASK]; //current
+				s16 r1 = m_buffer[(indexR + 1) & INDEX_MASK]; //current
+				s16 l2 = m_buffer[indexR2 & INDEX_MASK]; //next
+				s16 r2 = m_buffer[(indexR2 + 1) & INDEX_MASK]; //next
+				int sampleL = ((l1 << 16) + (l2 - l1) * (u16)m_frac) >> 16;
+				int sampleR = ((r1 << 16) + (r2 - r1) * (u16)m_frac) >> 16;
+				samples[currentSample] = sampleL;
+				samples[currentSample + 1] = sampleR;
+				m_frac += ratio;
+				indexR += 2 * (u16)(m_frac >> 16);
+				m_frac &= 0xffff;
+			}
 		}
 	}
 
 	int realSamples = currentSample;
-	if (currentSample < numSamples * 2)
+	bool underrun = currentSample < numSamples * 2;
+	if (underrun)
 		underrunCount_++;
 
 	// Padding with the last value to reduce clicking
@@ -216,40 +367,63 @@ unsigned int StereoResampler::Mix(short* samples, unsigned int numSamples, bool
 		samples[currentSample + 1] = s[1];
 	}
 
-	// Flush cached variable
-	Common::AtomicStore(m_indexR, indexR);
+	// Flush cached variable.  The release lets PushSamples reuse the space we just read.
+	m_indexR.store(indexR, std::memory_order_release);
 
 	//if (realSamples != numSamples * 2) {
 	//	ILOG("Underrun! %i / %i", realSamples / 2, numSamples);
 	//}
-	lastBufSize_ = (m_indexW - m_indexR) & INDEX_MASK;
+	lastBufSize_ = (indexW - indexR) & INDEX_MASK;
+	UpdateTargetFill(numSamples, underrun);
 
 	return realSamples / 2;
 }
 
+// Executed from sound stream thread.  Starts low and grows by a host period per underrun, then
+// slowly gives it back while the callbacks keep being satisfied.
+void StereoResampler::UpdateTargetFill(unsigned int numSamples, bool underrun) {
+	const int lowWatermark = m_lowwatermark;
+	if (!g_Config.bAdaptiveAudioLatency) {
+		targetFill_.store(lowWatermark, std::memory_order_relaxed);
+		stableMixes_ = 0;
+		return;
+	}
+
+	const int period = std::min((int)numSamples, lowWatermark);
+	int target = targetFill_.load(std::memory_order_relaxed);
+	if (underrun) {
+		target += period;
+		stableMixes_ = 0;
+	} else if (++stableMixes_ >= ADAPTIVE_STABLE_MIXES) {
+		target -= std::max(period / 8, 1);
+		stableMixes_ = 0;
+	}
+	targetFill_.store(std::max(period, std::min(target, lowWatermark)), std::memory_order_relaxed);
+}
+
 void StereoResampler::PushSamples(const s32 *samples, unsigned int num_samples) {
 	UpdateBufferSize();
-	const int INDEX_MASK = (m_bufsize * 2 - 1);
-	// Cache access in non-volatile variable
-	// indexR isn't allowed to cache in the audio throttling loop as it
-	// needs to get updates to not deadlock.
-	u32 indexW = Common::AtomicLoad(m_indexW);
+	const u32 INDEX_MASK = RING_MASK;
+	// Only this function writes m_indexW.  The acquire on m_indexR pairs with the release in Mix,
+	// so we never overwrite samples it's still reading.
+	u32 indexW = m_indexW.load(std::memory_order_relaxed);
+	u32 indexR = m_indexR.load(std::memory_order_acquire);
 
-	u32 cap = m_bufsize * 2;
+	u32 cap = std::min(m_bufsize * 2, RING_SIZE - RING_HISTORY);
 	// If unthottling, no need to fill up the entire buffer, just screws up timing after releasing unthrottle.
 	if (PSP_CoreParameter().unthrottle)
-		cap = m_lowwatermark * 2;
+		cap = targetFill_.load(std::memory_order_relaxed) * 2;
 
 	// Check if we have enough free space
 	// indexW == m_indexR results in empty buffer, so indexR must always be smaller than indexW
-	if (num_samples * 2 + ((indexW - Common::AtomicLoad(m_indexR)) & INDEX_MASK) >= cap) {
+	if (num_samples * 2 + ((indexW - indexR) & INDEX_MASK) >= cap) {
 		if (!PSP_CoreParameter().unthrottle)
 			overrunCount_++;
 		// TODO: "Timestretch" by doing a windowed overlap with existing buffer content?
 		return;
 	}
 
-	int over_bytes = num_samples * 4 - (m_bufsize * 2 - (indexW & INDEX_MASK)) * sizeof(short);
+	int over_bytes = num_samples * 4 - (RING_SIZE - (indexW & INDEX_MASK)) * sizeof(short);
 	if (over_bytes > 0) {
 		ClampBufferToS16WithVolume(&m_buffer[indexW & INDEX_MASK], samples, (num_samples * 4 - over_bytes) / 2);
 		ClampBufferToS16WithVolume(&m_buffer[0], samples + (num_samples * 4 - over_bytes) / sizeof(short), over_bytes / 2);
@@ -257,17 +431,16 @@ void StereoResampler::PushSamples(const s32 *samples, unsigned int num_samples)
 		ClampBufferToS16WithVolume(&m_buffer[indexW & INDEX_MASK], samples, num_samples * 2);
 	}
 
-	Common::AtomicAdd(m_indexW, num_samples * 2);
+	// Publish the samples to Mix.
+	m_indexW.store(indexW + num_samples * 2, std::memory_order_release);
 	lastPushSize_ = num_samples;
 }
 
 void StereoResampler::GetAudioDebugStats(AudioDebugStats *stats) {
 	stats->buffered = lastBufSize_;
-	stats->underrunCount += underrunCount_;
-	underrunCount_ = 0;
-	stats->overrunCount += overrunCount_;
-	overrunCount_ = 0;
-	stats->watermark = m_lowwatermark;
+	stats->underrunCount += underrunCount_.exchange(0);
+	stats->overrunCount += overrunCount_.exchange(0);
+	stats->watermark = targetFill_;
 	stats->bufsize = m_bufsize * 2;
 	stats->instantSampleRate = (int)sample_rate_;
 	stats->lastPushSize = lastPushSize_;
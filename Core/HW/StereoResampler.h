@@ -19,13 +19,36 @@
 
 #pragma once
 
+#include <atomic>
 #include <string>
+#include <vector>
 
 #include "Common/ChunkFile.h"
 #include "Common/CommonTypes.h"
 
 struct AudioDebugStats;
 
+// Kaiser windowed sinc filters, one per output phase between two input frames.
+class PolyphaseFilterBank {
+public:
+	enum {
+		TAPS = 16,
+		PHASE_BITS = 10,
+		PHASES = 1 << PHASE_BITS,
+		COEF_SHIFT = 14,
+	};
+
+	// Cutoff is a fraction of the input rate, so 0.5 is the input's Nyquist.
+	void Design(float cutoff);
+	// Window is TAPS interleaved stereo frames, the output is between frame TAPS / 2 - 1 and the
+	// next one, frac (16 bits) of the way.  Writes one stereo frame.
+	void Filter(const s16 *window, u32 frac, s16 *out) const;
+
+private:
+	std::vector<s16> coefs_;
+	float cutoff_ = 0.0f;
+};
+
 class StereoResampler {
 public:
 	StereoResampler();
@@ -47,18 +70,30 @@ class StereoResampler {
 protected:
 	void UpdateBufferSize();
 	void SetInputSampleRate(unsigned int rate);
+	void UpdateTargetFill(unsigned int numSamples, bool underrun);
 
-	int m_bufsize;
-	int m_lowwatermark;
+	// m_buffer is a single producer (PushSamples), single consumer (Mix) ring, without locks.
+	// Only PushSamples writes m_indexW and only Mix writes m_indexR.  The ring is always sized
+	// for the largest buffer, so changing m_bufsize only changes how full it's allowed to get.
+	std::atomic<int> m_bufsize;
+	std::atomic<int> m_lowwatermark;
 	unsigned int m_input_sample_rate;
 	int16_t *m_buffer;
-	volatile u32 m_indexW;
-	volatile u32 m_indexR;
+	std::atomic<u32> m_indexW;
+	std::atomic<u32> m_indexR;
 	float m_numLeftI;
 	u32 m_frac;
-	int underrunCount_;
-	int overrunCount_;
+	std::atomic<int> underrunCount_;
+	std::atomic<int> overrunCount_;
 	float sample_rate_;
-	int lastBufSize_;
+	std::atomic<int> lastBufSize_;
 	int lastPushSize_;
+
+	// The fill level the drift control aims for, in samples.  Equal to m_lowwatermark unless
+	// bAdaptiveAudioLatency is on, then between one host period and m_lowwatermark.
+	std::atomic<int> targetFill_;
+	// Only used by Mix.
+	int stableMixes_ = 0;
+
+	PolyphaseFilterBank hqFilter_;
 };
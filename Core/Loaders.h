@@ -90,6 +90,10 @@ class FileLoader {
 		return ReadAt(absolutePos, 1, bytes, data, flags);
 	}
 
+	// Hint that this range will probably be read soon, so it can be fetched in the background.
+	virtual void Prefetch(s64 absolutePos, size_t bytes) {
+	}
+
 	// Cancel any operations that might block, if possible.
 	virtual void Cancel() {
 	}
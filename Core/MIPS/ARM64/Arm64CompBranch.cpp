@@ -644,6 +644,14 @@ void Arm64Jit::Comp_Syscall(MIPSOpcode op)
 	// Skip the CallSyscall where possible.
 	void *quickFunc = GetQuickSyscallFunc(op);
 	if (quickFunc) {
+		// CallSyscall() counts calls itself, but we're skipping it.  Already flushed, so W0/X1 are safe.
+		u32 *counter = GetSyscallCallCounter(op);
+		if (counter) {
+			MOVP2R(X1, counter);
+			LDR(INDEX_UNSIGNED, W0, X1, 0);
+			ADDI2R(W0, W0, 1);
+			STR(INDEX_UNSIGNED, W0, X1, 0);
+		}
 		MOVI2R(X0, (uintptr_t)GetSyscallFuncPointer(op));
 		// Already flushed, so X1 is safe.
 		QuickCallFunction(X1, quickFunc);
@@ -182,11 +182,12 @@ namespace MIPSComp {
 		ARM64Reg LR_SCRATCH3 = gpr.GetAndLockTempR();
 		ARM64Reg LR_SCRATCH4 = o == 42 || o == 46 ? gpr.GetAndLockTempR() : INVALID_REG;
 
-		if (!g_Config.bFastMemory && rs != MIPS_REG_SP) {
+		if ((!g_Config.bFastMemory && rs != MIPS_REG_SP) || IsSlowMemSite(GetCompilerPC())) {
 			skips = SetScratch1ForSafeAddress(rs, offset, SCRATCH2);
 		} else {
 			SetScratch1ToEffectiveAddress(rs, offset);
 		}
+		const bool unchecked = skips.empty();
 
 		// Here's our shift amount.
 		ANDI2R(SCRATCH2, SCRATCH1, 3);
@@ -198,6 +199,8 @@ namespace MIPSComp {
 		switch (o) {
 		case 34: // lwl
 			MOVI2R(LR_SCRATCH3, 0x00ffffff);
+			if (unchecked)
+				RecordFastmemSite();
 			LDR(SCRATCH1, MEMBASEREG, ArithOption(SCRATCH1));
 			LSRV(LR_SCRATCH3, LR_SCRATCH3, SCRATCH2);
 			AND(gpr.R(rt), gpr.R(rt), LR_SCRATCH3);
@@ -209,6 +212,8 @@ namespace MIPSComp {
 
 		case 38: // lwr
 			MOVI2R(LR_SCRATCH3, 0xffffff00);
+			if (unchecked)
+				RecordFastmemSite();
 			LDR(SCRATCH1, MEMBASEREG, ArithOption(SCRATCH1));
 			LSRV(SCRATCH1, SCRATCH1, SCRATCH2);
 			NEG(SCRATCH2, SCRATCH2);
@@ -220,6 +225,8 @@ namespace MIPSComp {
 
 		case 42: // swl
 			MOVI2R(LR_SCRATCH3, 0xffffff00);
+			if (unchecked)
+				RecordFastmemSite();
 			LDR(LR_SCRATCH4, MEMBASEREG, ArithOption(SCRATCH1));
 			LSLV(LR_SCRATCH3, LR_SCRATCH3, SCRATCH2);
 			AND(LR_SCRATCH4, LR_SCRATCH4, LR_SCRATCH3);
@@ -228,11 +235,15 @@ namespace MIPSComp {
 
 			LSRV(LR_SCRATCH3, gpr.R(rt), SCRATCH2);
 			ORR(LR_SCRATCH4, LR_SCRATCH4, LR_SCRATCH3);
+			if (unchecked)
+				RecordFastmemSite();
 			STR(LR_SCRATCH4, MEMBASEREG, ArithOption(SCRATCH1));
 			break;
 
 		case 46: // swr
 			MOVI2R(LR_SCRATCH3, 0x00ffffff);
+			if (unchecked)
+				RecordFastmemSite();
 			LDR(LR_SCRATCH4, MEMBASEREG, ArithOption(SCRATCH1));
 			NEG(SCRATCH2, SCRATCH2);
 			ADDI2R(SCRATCH2, SCRATCH2, 24);
@@ -242,6 +253,8 @@ namespace MIPSComp {
 			ADDI2R(SCRATCH2, SCRATCH2, 24);
 			LSLV(LR_SCRATCH3, gpr.R(rt), SCRATCH2);
 			ORR(LR_SCRATCH4, LR_SCRATCH4, LR_SCRATCH3);
+			if (unchecked)
+				RecordFastmemSite();
 			STR(LR_SCRATCH4, MEMBASEREG, ArithOption(SCRATCH1));
 			break;
 		}
@@ -300,7 +313,7 @@ namespace MIPSComp {
 		case 40: //sb
 		case 41: //sh
 		case 43: //sw
-			if (jo.cachePointers && g_Config.bFastMemory) {
+			if (jo.cachePointers && g_Config.bFastMemory && !IsSlowMemSite(GetCompilerPC())) {
 				// ARM has smaller load/store immediate displacements than MIPS, 12 bits - and some memory ops only have 8 bits.
 				int offsetRange = 0x3ff;
 				if (o == 41 || o == 33 || o == 37 || o == 32)
@@ -316,6 +329,7 @@ namespace MIPSComp {
 						gpr.MapReg(rt, load ? MAP_NOINIT : 0);
 						targetReg = gpr.R(rt);
 					}
+					RecordFastmemSite();
 					switch (o) {
 					case 35: LDR(INDEX_UNSIGNED, targetReg, gpr.RPtr(rs), offset); break;
 					case 37: LDRH(INDEX_UNSIGNED, targetReg, gpr.RPtr(rs), offset); break;
@@ -371,12 +385,14 @@ namespace MIPSComp {
 					targetReg = gpr.R(rt);
 				}
 
-				if (!g_Config.bFastMemory && rs != MIPS_REG_SP) {
+				if ((!g_Config.bFastMemory && rs != MIPS_REG_SP) || IsSlowMemSite(GetCompilerPC())) {
 					skips = SetScratch1ForSafeAddress(rs, offset, SCRATCH2);
 				} else {
 					SetScratch1ToEffectiveAddress(rs, offset);
 				}
 				addrReg = SCRATCH1;
+				if (skips.empty())
+					RecordFastmemSite();
 			}
 
 			switch (o) {
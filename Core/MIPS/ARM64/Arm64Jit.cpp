@@ -18,6 +18,12 @@
 #include "ppsspp_config.h"
 #if PPSSPP_ARCH(ARM64)
 
+#include <cstring>
+#if PPSSPP_PLATFORM(LINUX) || PPSSPP_PLATFORM(MAC) || PPSSPP_PLATFORM(IOS)
+#include <signal.h>
+#include <sys/ucontext.h>
+#endif
+
 #include "base/logging.h"
 #include "profiler/profiler.h"
 #include "Common/ChunkFile.h"
@@ -65,6 +71,68 @@ namespace MIPSComp
 using namespace Arm64Gen;
 using namespace Arm64JitConstants;
 
+#if PPSSPP_PLATFORM(LINUX) || PPSSPP_PLATFORM(MAC) || PPSSPP_PLATFORM(IOS)
+// With fastmem, memory ops are emitted without range checks.  A bad address faults instead,
+// and we skip the access (same as the range checked path does) and recompile it with a check.
+static Arm64Jit *faultJit = nullptr;
+static struct sigaction prevSegvAction;
+static struct sigaction prevBusAction;
+
+static void FastmemFaultHandler(int sig, siginfo_t *info, void *context) {
+	ucontext_t *uc = (ucontext_t *)context;
+#if PPSSPP_PLATFORM(MAC) || PPSSPP_PLATFORM(IOS)
+	uint64_t *pc = (uint64_t *)&uc->uc_mcontext->__ss.__pc;
+#else
+	uint64_t *pc = (uint64_t *)&uc->uc_mcontext.pc;
+#endif
+
+	// Rewind's write tracking protects valid memory, so that's not a bad access.
+	if (Memory::HandleWriteTrackingFault((uintptr_t)info->si_addr))
+		return;
+
+	// Memory::base has 4GB of address space behind it, which covers any 32-bit index.
+	uintptr_t offset = (uintptr_t)info->si_addr - (uintptr_t)Memory::base;
+	if (faultJit && offset < 0x100000000ULL && faultJit->HandleFastmemFault((const u8 *)(uintptr_t)*pc)) {
+		*pc += 4;
+		return;
+	}
+
+	const struct sigaction &prev = sig == SIGBUS ? prevBusAction : prevSegvAction;
+	if (prev.sa_flags & SA_SIGINFO) {
+		prev.sa_sigaction(sig, info, context);
+	} else if (prev.sa_handler == SIG_DFL || prev.sa_handler == SIG_IGN) {
+		// Not ours.  Returning will fault again, and crash as it should.
+		signal(sig, SIG_DFL);
+	} else {
+		prev.sa_handler(sig);
+	}
+}
+
+static void InstallFastmemFaultHandler(Arm64Jit *jit) {
+	// Installed once and left in place, so other handlers can chain to or from it safely.
+	static bool installed = false;
+	if (!installed) {
+		struct sigaction action;
+		memset(&action, 0, sizeof(action));
+		action.sa_sigaction = &FastmemFaultHandler;
+		action.sa_flags = SA_SIGINFO;
+		sigemptyset(&action.sa_mask);
+		sigaction(SIGSEGV, &action, &prevSegvAction);
+		sigaction(SIGBUS, &action, &prevBusAction);
+		installed = true;
+	}
+	faultJit = jit;
+}
+
+static void UninstallFastmemFaultHandler(Arm64Jit *jit) {
+	if (faultJit == jit)
+		faultJit = nullptr;
+}
+#else
+static void InstallFastmemFaultHandler(Arm64Jit *jit) {}
+static void UninstallFastmemFaultHandler(Arm64Jit *jit) {}
+#endif
+
 Arm64Jit::Arm64Jit(MIPSState *mips) : blocks(mips, this), gpr(mips, &js, &jo), fpr(mips, &js, &jo), mips_(mips), fp(this) { 
 	// Automatically disable incompatible options.
 	if (((intptr_t)Memory::base & 0x00000000FFFFFFFFUL) != 0) {
@@ -80,9 +148,14 @@ Arm64Jit::Arm64Jit(MIPSState *mips) : blocks(mips, this), gpr(mips, &js, &jo), f
 	GenerateFixedCode(jo);
 	js.startDefaultPrefix = mips_->HasDefaultPrefix();
 	js.currentRoundingFunc = convertS0ToSCRATCH1[0];
+	InstallFastmemFaultHandler(this);
 }
 
 Arm64Jit::~Arm64Jit() {
+	UninstallFastmemFaultHandler(this);
+	if (!slowMemSites_.empty()) {
+		NOTICE_LOG(JIT, "Fastmem: %d memory access sites fell back to safe memory", (int)slowMemSites_.size());
+	}
 }
 
 void Arm64Jit::DoState(PointerWrap &p) {
@@ -133,6 +206,7 @@ void Arm64Jit::FlushPrefixV() {
 void Arm64Jit::ClearCache() {
 	ILOG("ARM64Jit: Clearing the cache!");
 	blocks.Clear();
+	fastmemSites_.clear();
 	ClearCodeSpace(jitStartOffset);
 	FlushIcacheSection(region + jitStartOffset, region + region_size - jitStartOffset);
 }
@@ -141,6 +215,20 @@ void Arm64Jit::InvalidateCacheAt(u32 em_address, int length) {
 	blocks.InvalidateICache(em_address, length);
 }
 
+bool Arm64Jit::HandleFastmemFault(const u8 *hostPC) {
+	auto iter = fastmemSites_.find(hostPC);
+	if (iter == fastmemSites_.end())
+		return false;
+
+	const u32 guestPC = iter->second;
+	if (slowMemSites_.insert(guestPC).second) {
+		WARN_LOG(JIT, "Bad memory access at %08x, using safe memory there (%d sites so far)", guestPC, (int)slowMemSites_.size());
+	}
+	// The rest of this block still runs, but it'll be recompiled with a range check next time.
+	blocks.InvalidateICache(guestPC, 4);
+	return true;
+}
+
 void Arm64Jit::EatInstruction(MIPSOpcode op) {
 	MIPSInfo info = MIPSGetInfo(op);
 	if (info & DELAYSLOT) {
@@ -185,9 +273,15 @@ void Arm64Jit::Compile(u32 em_address) {
 
 	int block_num = blocks.AllocateBlock(em_address);
 	JitBlock *b = blocks.GetBlock(block_num);
+	const u8 *codeStart = GetCodePtr();
+	pendingFastmemSites_.clear();
 	DoJit(em_address, b);
 	blocks.FinalizeBlock(block_num, jo.enableBlocklink);
 
+	// Forget any sites from old code that used to live here, then remember the new ones.
+	fastmemSites_.erase(fastmemSites_.lower_bound(codeStart), fastmemSites_.lower_bound(GetCodePtr()));
+	fastmemSites_.insert(pendingFastmemSites_.begin(), pendingFastmemSites_.end());
+
 	EndWrite();
 
 	// Don't forget to zap the newly written instructions in the instruction cache!
@@ -610,6 +704,13 @@ void Arm64Jit::UpdateRoundingMode() {
 // though, as we need to have the SUBS flag set in the end. So with block linking in the mix,
 // I don't think this gives us that much benefit.
 void Arm64Jit::WriteExit(u32 destination, int exit_num) {
+	if (jo.skipIdleLoops && destination == js.blockStart && MIPSAnalyst::IsIdleLoop(destination, GetCompilerPC())) {
+		// Only an event can end this loop, so jump ahead to it.  The downcount check runs it.
+		SaveStaticRegisters();
+		MOVI2R(W0, 0);
+		QuickCallFunction(X1, (void *)&CoreTiming::Idle);
+		LoadStaticRegisters();
+	}
 	WriteDownCount(); 
 	//If nobody has taken care of this yet (this can be removed when all branches are done)
 	JitBlock *b = js.curBlock;
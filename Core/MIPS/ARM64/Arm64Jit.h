@@ -17,6 +17,10 @@
 
 #pragma once
 
+#include <map>
+#include <unordered_set>
+#include <vector>
+
 #include "Common/CPUDetect.h"
 #include "Common/ArmCommon.h"
 #include "Common/Arm64Emitter.h"
@@ -186,6 +190,10 @@ class Arm64Jit : public Arm64Gen::ARM64CodeBlock, public JitInterface, public MI
 	void LinkBlock(u8 *exitPoint, const u8 *checkedEntry) override;
 	void UnlinkBlock(u8 *checkedEntry, u32 originalAddress) override;
 
+	// Called from the fault handler when an unchecked memory access faults.
+	// Returns true if hostPC was a known access site, which will use a range check from now on.
+	bool HandleFastmemFault(const u8 *hostPC);
+
 private:
 	void GenerateFixedCode(const JitOptions &jo);
 	void FlushAll();
@@ -245,6 +253,13 @@ class Arm64Jit : public Arm64Gen::ARM64CodeBlock, public JitInterface, public MI
 	void SetScratch1ToEffectiveAddress(MIPSGPReg rs, s16 offset);
 	std::vector<Arm64Gen::FixupBranch> SetScratch1ForSafeAddress(MIPSGPReg rs, s16 offset, Arm64Gen::ARM64Reg tempReg);
 	void Comp_ITypeMemLR(MIPSOpcode op, bool load);
+	bool IsSlowMemSite(u32 pc) const {
+		return slowMemSites_.find(pc) != slowMemSites_.end();
+	}
+	// Call right before emitting an access that isn't range checked.
+	void RecordFastmemSite() {
+		pendingFastmemSites_.push_back(std::make_pair(GetCodePtr(), GetCompilerPC()));
+	}
 
 	JitBlockCache blocks;
 	JitOptions jo;
@@ -260,6 +275,12 @@ class Arm64Jit : public Arm64Gen::ARM64CodeBlock, public JitInterface, public MI
 	int dontLogBlocks;
 	int logBlocks;
 
+	// Host address of each unchecked memory access -> MIPS address of the op.
+	std::map<const u8 *, u32> fastmemSites_;
+	std::vector<std::pair<const u8 *, u32>> pendingFastmemSites_;
+	// MIPS ops that faulted once, and are compiled with a range check from then on.
+	std::unordered_set<u32> slowMemSites_;
+
 public:
 	// Code pointers
 	const u8 *enterDispatcher;
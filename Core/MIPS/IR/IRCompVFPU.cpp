@@ -70,6 +70,27 @@ namespace MIPSComp {
 			     regs[3] == regs[2] + 1;
 	}
 
+	// A full 4x4 matrix laid out as four consecutive columns.
+	static bool IsConsecutive16(const u8 regs[16]) {
+		for (int j = 0; j < 4; j++) {
+			for (int i = 0; i < 4; i++) {
+				if (regs[j * 4 + i] != regs[0] + j * 4 + i)
+					return false;
+			}
+		}
+		return true;
+	}
+
+	static bool IsTransposed16(const u8 regs[16]) {
+		for (int j = 0; j < 4; j++) {
+			for (int i = 0; i < 4; i++) {
+				if (regs[j * 4 + i] != regs[0] + i * 4 + j)
+					return false;
+			}
+		}
+		return true;
+	}
+
 	// Vector regs can overlap in all sorts of swizzled ways.
 	// This does allow a single overlap in sregs[i].
 	static bool IsOverlapSafeAllowS(int dreg, int di, int sn, u8 sregs[], int tn = 0, u8 tregs[] = NULL) {
@@ -1208,8 +1229,13 @@ namespace MIPSComp {
 		// dregs are always consecutive, thanks to our transpose trick.
 		// However, not sure this is always worth it.
 		if (sz == M_4x4 && IsConsecutive4(dregs)) {
-			// TODO: The interpreter would like proper matrix ops better. Can generate those, and
-			// expand them like this as needed on "real" architectures.
+			// The interpreter runs a whole matrix op much faster than the expansion below.
+			// A native backend can still expand it the same way as METHOD 1.
+			if (IsTransposed16(sregs) && IsConsecutive16(tregs) && IsConsecutive16(dregs)) {
+				ir.Write(IROp::Mat4Mul, dregs[0], sregs[0], tregs[0]);
+				return;
+			}
+
 			int s0 = IRVTEMP_0;
 			int s1 = IRVTEMP_PFX_T;
 			if (!IsConsecutive4(sregs)) {
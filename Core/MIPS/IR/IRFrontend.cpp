@@ -219,7 +219,31 @@ MIPSOpcode IRFrontend::GetOffsetInstruction(int offset) {
 	return Memory::Read_Instruction(GetCompilerPC() + 4 * offset);
 }
 
-void IRFrontend::DoJit(u32 em_address, std::vector<IRInst> &instructions, u32 &mipsBytes, bool preload) {
+bool IRFrontend::ApplyPasses(const IRWriter &in, IRWriter &out) const {
+	static const IRPassFunc passes[] = {
+		&RemoveLoadStoreLeftRight,
+		&OptimizeFPMoves,
+		&PropagateConstants,
+		&PurgeTemps,
+		&RemoveDeadStores,
+		// &ReorderLoadStore,
+		// &MergeLoadStore,
+		// &ThreeOpToTwoOp,
+	};
+	return IRApplyPasses(passes, ARRAY_SIZE(passes), in, out, opts);
+}
+
+bool IRFrontend::OptimizeBlock(const std::vector<IRInst> &instructions, std::vector<IRInst> &optimized) const {
+	IRWriter in, out;
+	for (const IRInst &inst : instructions) {
+		in.Write(inst);
+	}
+	bool logBlock = ApplyPasses(in, out);
+	optimized = out.GetInstructions();
+	return logBlock;
+}
+
+void IRFrontend::DoJit(u32 em_address, std::vector<IRInst> &instructions, u32 &mipsBytes, bool preload, bool optimize) {
 	js.cancel = false;
 	js.preloading = preload;
 	js.blockStart = em_address;
@@ -256,17 +280,8 @@ void IRFrontend::DoJit(u32 em_address, std::vector<IRInst> &instructions, u32 &m
 
 	IRWriter simplified;
 	IRWriter *code = &ir;
-	if (!js.hadBreakpoints) {
-		static const IRPassFunc passes[] = {
-			&RemoveLoadStoreLeftRight,
-			&OptimizeFPMoves,
-			&PropagateConstants,
-			&PurgeTemps,
-			// &ReorderLoadStore,
-			// &MergeLoadStore,
-			// &ThreeOpToTwoOp,
-		};
-		if (IRApplyPasses(passes, ARRAY_SIZE(passes), ir, simplified, opts))
+	if (!js.hadBreakpoints && optimize) {
+		if (ApplyPasses(ir, simplified))
 			logBlocks = 1;
 		code = &simplified;
 		//if (ir.GetInstructions().size() >= 24)
@@ -87,8 +87,15 @@ class IRFrontend : public MIPSFrontendInterface {
 	int Replace_fabsf() override;
 	void DoState(PointerWrap &p);
 	bool CheckRounding(u32 blockAddress);  // returns true if we need a do-over
+	// Assumptions that compiled blocks depend on, so cached blocks can be rejected.
+	u32 GetCompileFlags() const {
+		return (js.startDefaultPrefix ? 1 : 0) | (js.hasSetRounding ? 2 : 0);
+	}
 
-	void DoJit(u32 em_address, std::vector<IRInst> &instructions, u32 &mipsBytes, bool preload);
+	// If optimize is false, the block is left unoptimized and can be passed to OptimizeBlock() later.
+	void DoJit(u32 em_address, std::vector<IRInst> &instructions, u32 &mipsBytes, bool preload, bool optimize = true);
+	// Only reads options, so this is safe to call from another thread.
+	bool OptimizeBlock(const std::vector<IRInst> &instructions, std::vector<IRInst> &optimized) const;
 
 	void EatPrefix() override {
 		js.EatPrefix();
@@ -103,6 +110,8 @@ class IRFrontend : public MIPSFrontendInterface {
 	void ApplyRoundingMode(bool force = false);
 	void UpdateRoundingMode();
 
+	bool ApplyPasses(const IRWriter &in, IRWriter &out) const;
+
 	void FlushAll();
 	void FlushPrefixV();
 
@@ -130,6 +130,7 @@ static const IRMeta irMeta[] = {
 	{ IROp::Vec4Dot, "Vec4Dot", "FVV" },
 	{ IROp::Vec4Neg, "Vec4Neg", "VV" },
 	{ IROp::Vec4Abs, "Vec4Abs", "VV" },
+	{ IROp::Mat4Mul, "Mat4Mul", "MMM" },
 
 		// Pack/Unpack
 	{ IROp::Vec2Unpack16To31, "Vec2Unpack16To31", "2F" },  // Note that the result is shifted down by 1, hence 31
@@ -266,6 +267,13 @@ void DisassembleParam(char *buf, int bufSize, u8 param, char type, u32 constant)
 			snprintf(buf, bufSize, "f%d..f%d", param, param + 3);
 		}
 		break;
+	case 'M':
+		if (param >= 32) {
+			snprintf(buf, bufSize, "v%d..v%d", param - 32, param - 32 + 15);
+		} else {
+			snprintf(buf, bufSize, "f%d..f%d", param, param + 15);
+		}
+		break;
 	case '2':
 		if (param >= 32) {
 			snprintf(buf, bufSize, "v%d,v%d", param - 32, param - 32 + 1);
@@ -167,6 +167,8 @@ enum class IROp : u8 {
 	Vec4Dot,
 	Vec4Neg,
 	Vec4Abs,
+	// Full 4x4 matrices (16 consecutive regs, one column per 4.)
+	Mat4Mul,
 
 	// vx2i
 	Vec2Unpack16To31,  // Note that the result is shifted down by 1, hence 31
@@ -341,6 +341,52 @@ u32 IRInterpret(MIPSState *mips, const IRInst *inst, int count) {
 			break;
 		}
 
+		case IROp::Mat4Mul:
+		{
+			// dest column j = sum over i of src1 column i * src2[j][i].  Matches the Vec4Scale/Vec4Add expansion.
+			const float *s = &mips->f[inst->src1];
+			const float *t = &mips->f[inst->src2];
+#if defined(_M_SSE)
+			__m128 scol[4];
+			for (int i = 0; i < 4; i++)
+				scol[i] = _mm_load_ps(s + i * 4);
+			__m128 dcol[4];
+			for (int j = 0; j < 4; j++) {
+				__m128 sum = _mm_mul_ps(scol[0], _mm_set1_ps(t[j * 4]));
+				for (int i = 1; i < 4; i++)
+					sum = _mm_add_ps(sum, _mm_mul_ps(scol[i], _mm_set1_ps(t[j * 4 + i])));
+				dcol[j] = sum;
+			}
+			for (int j = 0; j < 4; j++)
+				_mm_store_ps(&mips->f[inst->dest + j * 4], dcol[j]);
+#elif PPSSPP_ARCH(ARM64)
+			float32x4_t scol[4];
+			for (int i = 0; i < 4; i++)
+				scol[i] = vld1q_f32(s + i * 4);
+			float32x4_t dcol[4];
+			for (int j = 0; j < 4; j++) {
+				float32x4_t sum = vmulq_n_f32(scol[0], t[j * 4]);
+				for (int i = 1; i < 4; i++)
+					sum = vaddq_f32(sum, vmulq_n_f32(scol[i], t[j * 4 + i]));
+				dcol[j] = sum;
+			}
+			for (int j = 0; j < 4; j++)
+				vst1q_f32(&mips->f[inst->dest + j * 4], dcol[j]);
+#else
+			float d[16];
+			for (int j = 0; j < 4; j++) {
+				for (int k = 0; k < 4; k++) {
+					float sum = s[k] * t[j * 4];
+					for (int i = 1; i < 4; i++)
+						sum += s[i * 4 + k] * t[j * 4 + i];
+					d[j * 4 + k] = sum;
+				}
+			}
+			memcpy(&mips->f[inst->dest], d, sizeof(d));
+#endif
+			break;
+		}
+
 		case IROp::Vec2Unpack16To31:
 		{
 			mips->fi[inst->dest] = (mips->fi[inst->src1] << 16) >> 1;
@@ -500,10 +546,19 @@ u32 IRInterpret(MIPSState *mips, const IRInst *inst, int count) {
 		// Not quickly implementable on all platforms, unfortunately.
 		case IROp::Vec4Dot:
 		{
+#if defined(_M_SSE)
+			// Sum in the same order as the scalar path, so results don't depend on the host.
+			__m128 prod = _mm_mul_ps(_mm_load_ps(&mips->f[inst->src1]), _mm_load_ps(&mips->f[inst->src2]));
+			__m128 dot = _mm_add_ss(prod, _mm_shuffle_ps(prod, prod, _MM_SHUFFLE(1, 1, 1, 1)));
+			dot = _mm_add_ss(dot, _mm_movehl_ps(prod, prod));
+			dot = _mm_add_ss(dot, _mm_shuffle_ps(prod, prod, _MM_SHUFFLE(3, 3, 3, 3)));
+			_mm_store_ss(&mips->f[inst->dest], dot);
+#else
 			float dot = mips->f[inst->src1] * mips->f[inst->src2];
 			for (int i = 1; i < 4; i++)
 				dot += mips->f[inst->src1 + i] * mips->f[inst->src2 + i];
 			mips->f[inst->dest] = dot;
+#endif
 			break;
 		}
 
@@ -939,6 +994,7 @@ u32 IRInterpret(MIPSState *mips, const IRInst *inst, int count) {
 		{
 			int funcIndex = inst->constant;
 			const ReplacementTableEntry *f = GetReplacementFunc(funcIndex);
+			(*GetReplacementHitCounter(funcIndex))++;
 			int cycles = f->replaceFunc();
 			mips->downcount -= cycles;
 			break;
@@ -15,12 +15,18 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#include <algorithm>
+
 #include "base/logging.h"
+#include "base/timeutil.h"
 #include "ext/xxhash.h"
 #include "profiler/profiler.h"
 #include "Common/ChunkFile.h"
+#include "Common/FileUtil.h"
 #include "Common/StringUtils.h"
+#include "thread/threadutil.h"
 
+#include "Core/Config.h"
 #include "Core/Core.h"
 #include "Core/CoreTiming.h"
 #include "Core/HLE/sceKernelMemory.h"
@@ -35,6 +41,7 @@
 #include "Core/MIPS/IR/IRInterpreter.h"
 #include "Core/MIPS/JitCommon/JitCommon.h"
 #include "Core/Reporting.h"
+#include "Core/System.h"
 
 namespace MIPSComp {
 
@@ -42,6 +49,7 @@ IRJit::IRJit(MIPSState *mips) : frontend_(mips->HasDefaultPrefix()), mips_(mips)
 	u32 size = 128 * 1024;
 	// blTrampolines_ = kernelMemory.Alloc(size, true, "trampoline");
 	InitIR();
+	IRResetPassStats();
 
 	IROptions opts{};
 	opts.unalignedLoadStore = true;
@@ -49,6 +57,7 @@ IRJit::IRJit(MIPSState *mips) : frontend_(mips->HasDefaultPrefix()), mips_(mips)
 }
 
 IRJit::~IRJit() {
+	StopOptimizeThread();
 }
 
 void IRJit::DoState(PointerWrap &p) {
@@ -58,6 +67,12 @@ void IRJit::DoState(PointerWrap &p) {
 void IRJit::ClearCache() {
 	ILOG("IRJit: Clearing the cache!");
 	blocks_.Clear();
+
+	std::lock_guard<std::mutex> guard(optimizeLock_);
+	blocksGeneration_++;
+	optimizeQueue_.clear();
+	optimizeResults_.clear();
+	hasOptimizeResults_ = false;
 }
 
 void IRJit::InvalidateCacheAt(u32 em_address, int length) {
@@ -67,8 +82,8 @@ void IRJit::InvalidateCacheAt(u32 em_address, int length) {
 void IRJit::Compile(u32 em_address) {
 	PROFILE_THIS_SCOPE("jitc");
 
-	if (g_Config.bPreloadFunctions) {
-		// Look to see if we've preloaded this block.
+	if (g_Config.bPreloadFunctions || g_Config.bPersistentIRCache) {
+		// Look to see if we've preloaded (or loaded from the cache) this block.
 		int block_num = blocks_.FindPreloadBlock(em_address);
 		if (block_num != -1) {
 			IRBlock *b = blocks_.GetBlock(block_num);
@@ -98,7 +113,9 @@ void IRJit::Compile(u32 em_address) {
 }
 
 bool IRJit::CompileBlock(u32 em_address, std::vector<IRInst> &instructions, u32 &mipsBytes, bool preload) {
-	frontend_.DoJit(em_address, instructions, mipsBytes, preload);
+	// When preloading, we're not blocking anything, so might as well optimize right away.
+	bool optimizeLater = (g_Config.bIRBackgroundOptimize || g_Config.iIRTierUpThreshold > 0) && !preload;
+	frontend_.DoJit(em_address, instructions, mipsBytes, preload, !optimizeLater);
 	if (instructions.empty()) {
 		_dbg_assert_(JIT, preload);
 		// We return true when preloading so it doesn't abort.
@@ -119,11 +136,24 @@ bool IRJit::CompileBlock(u32 em_address, std::vector<IRInst> &instructions, u32
 		b->UpdateHash();
 		blocks_.FinalizeBlock(block_num, true);
 	} else {
+		// The persistent cache validates blocks by hash when saving, so hash before emuhacking.
+		if (g_Config.bPersistentIRCache)
+			b->UpdateHash();
 		// Overwrites the first instruction, and also updates stats.
 		// TODO: Should we always hash?  Then we can reuse blocks.
 		blocks_.FinalizeBlock(block_num);
 	}
 
+	if (optimizeLater) {
+		b->SetOptimized(false);
+		if (g_Config.iIRTierUpThreshold > 0) {
+			// Cold blocks (like run-once init code) just keep running unoptimized.
+			b->SetTierUpCountdown(g_Config.iIRTierUpThreshold);
+		} else {
+			QueueOptimize(block_num, em_address, instructions);
+		}
+	}
+
 	return true;
 }
 
@@ -200,6 +230,206 @@ void IRJit::CompileFunction(u32 start_address, u32 length) {
 	}
 }
 
+// The cache stores optimized IR for the blocks of a module, so a later boot only needs to
+// verify block hashes rather than recompile.  Bump the version when IR semantics change.
+#define IR_CACHE_HEADER_MAGIC 0x4b425249
+#define IR_CACHE_VERSION 2
+struct IRCacheHeader {
+	u32 magic;
+	u32 version;
+	u32 instSize;
+	u32 compileFlags;
+	u32 textStart;
+	u32 textEnd;
+	u64 textHash;
+	int numBlocks;
+	u32 reserved;
+};
+
+enum IRCacheBlockFlags {
+	IR_CACHE_BLOCK_OPTIMIZED = 1,
+};
+
+struct IRCacheBlockHeader {
+	u32 origAddr;
+	u32 origSize;
+	u64 hash;
+	u32 numInstructions;
+	u32 flags;
+};
+
+static bool HasDebugOps(const IRInst *inst, int count) {
+	for (int i = 0; i < count; ++i) {
+		if (inst[i].op == IROp::Breakpoint || inst[i].op == IROp::MemoryCheck)
+			return true;
+	}
+	return false;
+}
+
+static u64 HashModuleText(u32 start, u32 end) {
+	// Like block hashes, this uses the original instructions rather than any emuhacks.
+	std::vector<u32> buffer;
+	buffer.reserve((end - start) / 4 + 1);
+	for (u32 addr = start; addr <= end; addr += 4) {
+		buffer.push_back(Memory::ReadUnchecked_Instruction(addr, false).encoding);
+	}
+	return XXH64(&buffer[0], buffer.size() * sizeof(u32), 0x9A5C33B8);
+}
+
+void IRJit::LoadCodeCache(u32 start_address, u32 end_address) {
+	if (!g_Config.bPersistentIRCache || end_address <= start_address || !Memory::IsValidRange(start_address, end_address - start_address + 4)) {
+		return;
+	}
+
+	u64 textHash = HashModuleText(start_address, end_address);
+	File::CreateFullPath(GetSysDirectory(DIRECTORY_APP_CACHE));
+	std::string filename = GetSysDirectory(DIRECTORY_APP_CACHE) + "/" + StringFromFormat("%08x_%016llx.ircache", start_address, textHash);
+	codeCacheFiles_[start_address] = filename;
+
+	FILE *f = File::OpenCFile(filename, "rb");
+	if (!f)
+		return;
+
+	IRCacheHeader header{};
+	bool result = fread(&header, sizeof(header), 1, f) == 1;
+	if (result) {
+		result = header.magic == IR_CACHE_HEADER_MAGIC && header.version == IR_CACHE_VERSION && header.instSize == sizeof(IRInst);
+		result = result && header.compileFlags == frontend_.GetCompileFlags();
+		result = result && header.textStart == start_address && header.textEnd == end_address && header.textHash == textHash;
+	}
+	if (result) {
+		result = blocks_.LoadCache(f, start_address, end_address);
+	}
+	fclose(f);
+
+	if (!result) {
+		WARN_LOG(JIT, "Bad IR cache %s", filename.c_str());
+		// Written by a different version, or for different compile assumptions.  It'll be rebuilt.
+		File::Delete(filename);
+	}
+}
+
+void IRJit::SaveCodeCache(u32 start_address, u32 end_address) {
+	auto it = codeCacheFiles_.find(start_address);
+	if (it == codeCacheFiles_.end())
+		return;
+	std::string filename = it->second;
+	codeCacheFiles_.erase(it);
+
+	FILE *f = File::OpenCFile(filename, "wb");
+	if (!f)
+		return;
+
+	IRCacheHeader header{};
+	header.magic = IR_CACHE_HEADER_MAGIC;
+	header.version = IR_CACHE_VERSION;
+	header.instSize = sizeof(IRInst);
+	header.compileFlags = frontend_.GetCompileFlags();
+	header.textStart = start_address;
+	header.textEnd = end_address;
+	// The filename already has this, but it lets us reject renamed or stale files.
+	header.textHash = HashModuleText(start_address, end_address);
+	fwrite(&header, sizeof(header), 1, f);
+	blocks_.SaveCache(f, start_address, end_address);
+	fclose(f);
+}
+
+void IRJit::TierUp(int block_num) {
+	IRBlock *b = blocks_.GetBlock(block_num);
+	u32 start, size;
+	b->GetRange(start, size);
+	std::vector<IRInst> instructions(b->GetInstructions(), b->GetInstructions() + b->GetNumInstructions());
+
+	if (g_Config.bIRBackgroundOptimize) {
+		QueueOptimize(block_num, start, instructions);
+	} else if (!instructions.empty() && !HasDebugOps(&instructions[0], (int)instructions.size())) {
+		std::vector<IRInst> optimized;
+		frontend_.OptimizeBlock(instructions, optimized);
+		b->SetInstructions(optimized);
+		b->SetOptimized(true);
+	}
+}
+
+void IRJit::QueueOptimize(int block_num, u32 em_address, const std::vector<IRInst> &instructions) {
+	// Like compiling with breakpoints, these are left as is.
+	if (instructions.empty() || HasDebugOps(&instructions[0], (int)instructions.size()))
+		return;
+
+	std::lock_guard<std::mutex> guard(optimizeLock_);
+	if (!optimizeThread_) {
+		optimizeThreadExit_ = false;
+		optimizeThread_ = new std::thread([this] {
+			OptimizeThread();
+		});
+	}
+	optimizeQueue_.push_back(OptimizeRequest{ block_num, em_address, blocksGeneration_, instructions });
+	optimizeCond_.notify_one();
+}
+
+void IRJit::OptimizeThread() {
+	setCurrentThreadName("IROptimize");
+
+	std::unique_lock<std::mutex> guard(optimizeLock_);
+	while (!optimizeThreadExit_) {
+		if (optimizeQueue_.empty()) {
+			optimizeCond_.wait(guard);
+			continue;
+		}
+
+		OptimizeRequest req = std::move(optimizeQueue_.front());
+		optimizeQueue_.pop_front();
+
+		guard.unlock();
+		std::vector<IRInst> optimized;
+		frontend_.OptimizeBlock(req.instructions, optimized);
+		req.instructions = std::move(optimized);
+		guard.lock();
+
+		// If the cache was cleared meanwhile, the block number might be reused.
+		if (req.generation == blocksGeneration_) {
+			optimizeResults_.push_back(std::move(req));
+			hasOptimizeResults_ = true;
+		}
+	}
+}
+
+void IRJit::StopOptimizeThread() {
+	if (!optimizeThread_)
+		return;
+
+	{
+		std::lock_guard<std::mutex> guard(optimizeLock_);
+		optimizeThreadExit_ = true;
+		optimizeCond_.notify_one();
+	}
+	optimizeThread_->join();
+	delete optimizeThread_;
+	optimizeThread_ = nullptr;
+}
+
+void IRJit::ApplyOptimizedBlocks() {
+	std::vector<OptimizeRequest> results;
+	{
+		std::lock_guard<std::mutex> guard(optimizeLock_);
+		results.swap(optimizeResults_);
+		hasOptimizeResults_ = false;
+	}
+
+	// This is only called between blocks, so nothing is executing the old instructions.
+	for (const OptimizeRequest &req : results) {
+		IRBlock *b = blocks_.GetBlock(req.block_num);
+		u32 start, size;
+		if (!b || req.instructions.empty())
+			continue;
+		b->GetRange(start, size);
+		// Might have been invalidated since.
+		if (start == req.em_address) {
+			b->SetInstructions(req.instructions);
+			b->SetOptimized(true);
+		}
+	}
+}
+
 void IRJit::RunLoopUntil(u64 globalticks) {
 	PROFILE_THIS_SCOPE("jit");
 
@@ -213,12 +443,18 @@ void IRJit::RunLoopUntil(u64 globalticks) {
 		if (coreState != 0) {
 			break;
 		}
+		if (hasOptimizeResults_) {
+			ApplyOptimizedBlocks();
+		}
 		while (mips_->downcount >= 0) {
 			u32 inst = Memory::ReadUnchecked_U32(mips_->pc);
 			u32 opcode = inst & 0xFF000000;
 			if (opcode == MIPS_EMUHACK_OPCODE) {
 				u32 data = inst & 0xFFFFFF;
 				IRBlock *block = blocks_.GetBlock(data);
+				if (block->CountEntry()) {
+					TierUp(data);
+				}
 				mips_->pc = IRInterpret(mips_, block->GetInstructions(), block->GetNumInstructions());
 			} else {
 				// RestoreRoundingMode(true);
@@ -257,7 +493,12 @@ void IRBlockCache::Clear() {
 	byPage_.clear();
 }
 
+IRBlockCache::IRBlockCache() {
+	statsStartTime_ = time_now_d();
+}
+
 void IRBlockCache::InvalidateICache(u32 address, u32 length) {
+	numInvalidations_++;
 	u32 startPage = AddressToPage(address);
 	u32 endPage = AddressToPage(address + length);
 
@@ -271,6 +512,7 @@ void IRBlockCache::InvalidateICache(u32 address, u32 length) {
 			if (blocks_[i].OverlapsRange(address, length)) {
 				// Not removing from the page, hopefully doesn't build up with small recompiles.
 				blocks_[i].Destroy(i);
+				numInvalidatedBlocks_++;
 			}
 		}
 	}
@@ -318,6 +560,83 @@ int IRBlockCache::FindPreloadBlock(u32 em_address) {
 	return -1;
 }
 
+bool IRBlockCache::LoadCache(FILE *f, u32 start, u32 end) {
+	// Blocks are loaded like preloaded blocks: not linked until the first time they're run.
+	int numLoaded = 0;
+	int numStale = 0;
+	IRCacheBlockHeader header;
+	std::vector<IRInst> instructions;
+	while (fread(&header, sizeof(header), 1, f) == 1) {
+		if (header.origAddr < start || header.origAddr + header.origSize > end + 4 || header.numInstructions == 0 || header.numInstructions > 0xFFFF) {
+			return false;
+		}
+		instructions.resize(header.numInstructions);
+		if (fread(&instructions[0], sizeof(IRInst), header.numInstructions, f) != header.numInstructions) {
+			return false;
+		}
+
+		int block_num = AllocateBlock(header.origAddr);
+		if ((block_num & ~MIPS_EMUHACK_VALUE_MASK) != 0) {
+			// Out of block numbers, no point continuing.
+			blocks_.pop_back();
+			break;
+		}
+
+		IRBlock &b = blocks_[block_num];
+		b.SetInstructions(instructions);
+		b.SetOriginalSize(header.origSize);
+		b.UpdateHash();
+		if (b.GetHash() != header.hash) {
+			// The code has changed since, so this block must be recompiled.
+			b.Destroy(block_num);
+			numStale++;
+			continue;
+		}
+		if ((header.flags & IR_CACHE_BLOCK_OPTIMIZED) == 0) {
+			// Was still cold, so keep counting from scratch.
+			b.SetOptimized(false);
+			b.SetTierUpCountdown(std::max(g_Config.iIRTierUpThreshold, 1));
+		}
+		FinalizeBlock(block_num, true);
+		numLoaded++;
+	}
+
+	NOTICE_LOG(JIT, "Loaded %d IR blocks from cache (%d stale)", numLoaded, numStale);
+	return true;
+}
+
+void IRBlockCache::SaveCache(FILE *f, u32 start, u32 end) const {
+	int numSaved = 0;
+	for (const IRBlock &b : blocks_) {
+		u32 origAddr, origSize;
+		b.GetRange(origAddr, origSize);
+		if (origAddr < start || origAddr + origSize > end + 4 || b.GetNumInstructions() == 0) {
+			continue;
+		}
+		// Only save blocks that still match the code in memory.
+		if (b.GetHash() == 0 || !b.HashMatches()) {
+			continue;
+		}
+
+		// Breakpoints may not be there next time.
+		const IRInst *inst = b.GetInstructions();
+		if (HasDebugOps(inst, b.GetNumInstructions()))
+			continue;
+
+		IRCacheBlockHeader header{};
+		header.origAddr = origAddr;
+		header.origSize = origSize;
+		header.hash = b.GetHash();
+		header.numInstructions = b.GetNumInstructions();
+		header.flags = b.IsOptimized() ? IR_CACHE_BLOCK_OPTIMIZED : 0;
+		fwrite(&header, sizeof(header), 1, f);
+		fwrite(inst, sizeof(IRInst), header.numInstructions, f);
+		numSaved++;
+	}
+
+	NOTICE_LOG(JIT, "Saved %d IR blocks to cache", numSaved);
+}
+
 std::vector<u32> IRBlockCache::SaveAndClearEmuHackOps() {
 	std::vector<u32> result;
 	result.resize(blocks_.size());
@@ -400,6 +719,12 @@ void IRBlockCache::ComputeStats(BlockCacheStats &bcStats) const {
 	bcStats.minBloat = minBloat;
 	bcStats.maxBloat = maxBloat;
 	bcStats.avgBloat = totalBloat / (double)blocks_.size();
+	IRGetPassStats(bcStats.passStats);
+
+	double elapsed = time_now_d() - statsStartTime_;
+	bcStats.numInvalidations = numInvalidations_;
+	bcStats.numInvalidatedBlocks = numInvalidatedBlocks_;
+	bcStats.invalidationsPerSec = elapsed > 0.0 ? (float)(numInvalidations_ / elapsed) : 0.0f;
 }
 
 int IRBlockCache::GetBlockNumberFromStartAddress(u32 em_address, bool realBlocksOnly) const {
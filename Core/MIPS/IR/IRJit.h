@@ -17,7 +17,11 @@
 
 #pragma once
 
+#include <condition_variable>
 #include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
 #include <unordered_map>
 
 #include "Common/Common.h"
@@ -47,6 +51,8 @@ class IRBlock {
 		origSize_ = b.origSize_;
 		origFirstOpcode_ = b.origFirstOpcode_;
 		hash_ = b.hash_;
+		optimized_ = b.optimized_;
+		tierUpCountdown_ = b.tierUpCountdown_;
 		b.instr_ = nullptr;
 	}
 
@@ -55,6 +61,7 @@ class IRBlock {
 	}
 
 	void SetInstructions(const std::vector<IRInst> &inst) {
+		delete[] instr_;
 		instr_ = new IRInst[inst.size()];
 		numInstructions_ = (u16)inst.size();
 		if (!inst.empty()) {
@@ -64,6 +71,19 @@ class IRBlock {
 
 	const IRInst *GetInstructions() const { return instr_; }
 	int GetNumInstructions() const { return numInstructions_; }
+	// False while running the unoptimized IR (cold, or waiting for the optimize thread.)
+	bool IsOptimized() const { return optimized_; }
+	void SetOptimized(bool optimized) {
+		optimized_ = optimized;
+	}
+	// After this many entries, the block should be optimized.
+	void SetTierUpCountdown(int count) {
+		tierUpCountdown_ = count;
+	}
+	// Returns true once, when the block gets hot.
+	bool CountEntry() {
+		return tierUpCountdown_ != 0 && --tierUpCountdown_ == 0;
+	}
 	MIPSOpcode GetOriginalFirstOp() const { return origFirstOpcode_; }
 	bool HasOriginalFirstOp() const;
 	bool RestoreOriginalFirstOp(int number);
@@ -77,6 +97,9 @@ class IRBlock {
 	bool HashMatches() const {
 		return origAddr_ && hash_ == CalculateHash();
 	}
+	u64 GetHash() const {
+		return hash_;
+	}
 	bool OverlapsRange(u32 addr, u32 size) const;
 
 	void GetRange(u32 &start, u32 &size) const {
@@ -96,11 +119,13 @@ class IRBlock {
 	u32 origSize_;
 	u64 hash_ = 0;
 	MIPSOpcode origFirstOpcode_ = MIPSOpcode(0x68FFFFFF);
+	bool optimized_ = true;
+	int tierUpCountdown_ = 0;
 };
 
 class IRBlockCache : public JitBlockCacheDebugInterface {
 public:
-	IRBlockCache() {}
+	IRBlockCache();
 	void Clear();
 	void InvalidateICache(u32 address, u32 length);
 	void FinalizeBlock(int i, bool preload = false);
@@ -119,6 +144,9 @@ class IRBlockCache : public JitBlockCacheDebugInterface {
 
 	int FindPreloadBlock(u32 em_address);
 
+	bool LoadCache(FILE *f, u32 start, u32 end);
+	void SaveCache(FILE *f, u32 start, u32 end) const;
+
 	std::vector<u32> SaveAndClearEmuHackOps();
 	void RestoreSavedEmuHackOps(std::vector<u32> saved);
 
@@ -131,6 +159,9 @@ class IRBlockCache : public JitBlockCacheDebugInterface {
 
 	std::vector<IRBlock> blocks_;
 	std::unordered_map<u32, std::vector<int>> byPage_;
+	int numInvalidations_ = 0;
+	int numInvalidatedBlocks_ = 0;
+	double statsStartTime_;
 };
 
 class IRJit : public JitInterface {
@@ -146,6 +177,8 @@ class IRJit : public JitInterface {
 
 	void Compile(u32 em_address) override;	// Compiles a block at current MIPS PC
 	void CompileFunction(u32 start_address, u32 length) override;
+	void LoadCodeCache(u32 start_address, u32 end_address) override;
+	void SaveCodeCache(u32 start_address, u32 end_address) override;
 
 	bool DescribeCodePtr(const u8 *ptr, std::string &name) override;
 	// Not using a regular block cache.
@@ -168,11 +201,38 @@ class IRJit : public JitInterface {
 	bool CompileBlock(u32 em_address, std::vector<IRInst> &instructions, u32 &mipsBytes, bool preload);
 	bool ReplaceJalTo(u32 dest);
 
+	struct OptimizeRequest {
+		int block_num;
+		u32 em_address;
+		int generation;
+		std::vector<IRInst> instructions;
+	};
+
+	void TierUp(int block_num);
+	void QueueOptimize(int block_num, u32 em_address, const std::vector<IRInst> &instructions);
+	void ApplyOptimizedBlocks();
+	void StopOptimizeThread();
+	void OptimizeThread();
+
 	JitOptions jo;
 
 	IRFrontend frontend_;
 	IRBlockCache blocks_;
 
+	// Cache files for loaded modules, by text start address.
+	std::unordered_map<u32, std::string> codeCacheFiles_;
+
+	// Blocks first run unoptimized, and are optimized on this thread and swapped in later.
+	std::thread *optimizeThread_ = nullptr;
+	std::mutex optimizeLock_;
+	std::condition_variable optimizeCond_;
+	std::deque<OptimizeRequest> optimizeQueue_;
+	std::vector<OptimizeRequest> optimizeResults_;
+	volatile bool hasOptimizeResults_ = false;
+	bool optimizeThreadExit_ = false;
+	// Incremented on clear, so stale results are dropped.
+	int blocksGeneration_ = 0;
+
 	MIPSState *mips_;
 
 	// where to write branch-likely trampolines. not used atm
@@ -1,7 +1,9 @@
 #include <algorithm>
+#include <atomic>
 #include <cstring>
 #include <utility>
 
+#include "Common/CommonFuncs.h"
 #include "Common/Log.h"
 #include "Core/MIPS/IR/IRInterpreter.h"
 #include "Core/MIPS/IR/IRPassSimplify.h"
@@ -73,9 +75,39 @@ IROp ShiftToShiftImm(IROp op) {
 	}
 }
 
+static const struct {
+	IRPassFunc func;
+	const char *name;
+} passNames[] = {
+	{ &RemoveLoadStoreLeftRight, "RemoveLoadStoreLeftRight" },
+	{ &OptimizeFPMoves, "OptimizeFPMoves" },
+	{ &PropagateConstants, "PropagateConstants" },
+	{ &PurgeTemps, "PurgeTemps" },
+	{ &RemoveDeadStores, "RemoveDeadStores" },
+	{ &ReduceLoads, "ReduceLoads" },
+	{ &ThreeOpToTwoOp, "ThreeOpToTwoOp" },
+	{ &ReorderLoadStore, "ReorderLoadStore" },
+	{ &MergeLoadStore, "MergeLoadStore" },
+};
+// Passes may run on the background optimize thread too.
+static std::atomic<int64_t> passRemoved[ARRAY_SIZE(passNames)];
+
+static bool ApplyCountedPass(IRPassFunc pass, const IRWriter &in, IRWriter &out, const IROptions &opts) {
+	size_t before = in.GetInstructions().size();
+	bool logBlocks = pass(in, out, opts);
+	int64_t removed = (int64_t)before - (int64_t)out.GetInstructions().size();
+	for (size_t i = 0; i < ARRAY_SIZE(passNames); ++i) {
+		if (passNames[i].func == pass) {
+			passRemoved[i] += removed;
+			break;
+		}
+	}
+	return logBlocks;
+}
+
 bool IRApplyPasses(const IRPassFunc *passes, size_t c, const IRWriter &in, IRWriter &out, const IROptions &opts) {
 	if (c == 1) {
-		return passes[0](in, out, opts);
+		return ApplyCountedPass(passes[0], in, out, opts);
 	}
 
 	bool logBlocks = false;
@@ -84,7 +116,7 @@ bool IRApplyPasses(const IRPassFunc *passes, size_t c, const IRWriter &in, IRWri
 	const IRWriter *nextIn = &in;
 	IRWriter *nextOut = &temp[1];
 	for (size_t i = 0; i < c - 1; ++i) {
-		if (passes[i](*nextIn, *nextOut, opts)) {
+		if (ApplyCountedPass(passes[i], *nextIn, *nextOut, opts)) {
 			logBlocks = true;
 		}
 
@@ -92,13 +124,25 @@ bool IRApplyPasses(const IRPassFunc *passes, size_t c, const IRWriter &in, IRWri
 		nextIn = &temp[0];
 	}
 
-	if (passes[c - 1](*nextIn, out, opts)) {
+	if (ApplyCountedPass(passes[c - 1], *nextIn, out, opts)) {
 		logBlocks = true;
 	}
 
 	return logBlocks;
 }
 
+void IRGetPassStats(std::vector<std::pair<std::string, int64_t>> &stats) {
+	for (size_t i = 0; i < ARRAY_SIZE(passNames); ++i) {
+		stats.push_back(std::make_pair(std::string(passNames[i].name), (int64_t)passRemoved[i]));
+	}
+}
+
+void IRResetPassStats() {
+	for (size_t i = 0; i < ARRAY_SIZE(passNames); ++i) {
+		passRemoved[i] = 0;
+	}
+}
+
 bool OptimizeFPMoves(const IRWriter &in, IRWriter &out, const IROptions &opts) {
 	bool logBlocks = false;
 	IRInst prev{ IROp::Nop };
@@ -671,6 +715,7 @@ bool PropagateConstants(const IRWriter &in, IRWriter &out, const IROptions &opts
 		case IROp::Vec4Shuffle:
 		case IROp::Vec4Neg:
 		case IROp::Vec4Abs:
+		case IROp::Mat4Mul:
 		case IROp::Vec4Pack31To8:
 		case IROp::Vec4Pack32To8:
 		case IROp::Vec2Pack32To16:
@@ -782,6 +827,213 @@ bool IRMutatesDestGPR(const IRInst &inst, int reg) {
 	return (m->flags & IRFLAG_SRC3DST) != 0 && m->types[0] == 'G' && inst.src3 == reg;
 }
 
+static bool IRAccessesContext(const IRInst &inst) {
+	switch (inst.op) {
+	case IROp::Interpret:
+	case IROp::CallReplacement:
+	case IROp::Syscall:
+	case IROp::Break:
+	case IROp::Breakpoint:
+	case IROp::MemoryCheck:
+		return true;
+	default:
+		return false;
+	}
+}
+
+std::vector<IRLiveRange> IRComputeLiveRanges(const std::vector<IRInst> &insts) {
+	std::vector<IRLiveRange> ranges;
+	int openRange[256];
+	memset(openRange, -1, sizeof(openRange));
+
+	auto access = [&](int reg, int i, bool write) {
+		// Higher regs might sometimes be implicitly read/written by other instructions.
+		if (reg <= 0 || reg > IRTEMP_LR_SHIFT) {
+			return;
+		}
+		if (openRange[reg] == -1) {
+			openRange[reg] = (int)ranges.size();
+			ranges.push_back(IRLiveRange{ (u8)reg, !write, write, i, i, -1 });
+		} else {
+			IRLiveRange &range = ranges[openRange[reg]];
+			range.end = i;
+			range.dirty = range.dirty || write;
+		}
+	};
+
+	for (int i = 0, n = (int)insts.size(); i < n; i++) {
+		const IRInst &inst = insts[i];
+		const IRMeta *m = GetIRMeta(inst.op);
+		if (!m || IRAccessesContext(inst)) {
+			// Dirty regs must be stored here, and everything reloaded after.
+			for (int reg = 0; reg < 256; ++reg) {
+				if (openRange[reg] != -1) {
+					if (ranges[openRange[reg]].dirty)
+						ranges[openRange[reg]].end = i;
+					openRange[reg] = -1;
+				}
+			}
+			continue;
+		}
+
+		if (m->types[1] == 'G')
+			access(inst.src1, i, false);
+		if (m->types[2] == 'G')
+			access(inst.src2, i, false);
+		if ((m->flags & (IRFLAG_SRC3 | IRFLAG_SRC3DST)) != 0 && m->types[0] == 'G')
+			access(inst.src3, i, false);
+		access(IRDestGPR(inst), i, true);
+	}
+
+	return ranges;
+}
+
+int IRAllocateHostRegs(std::vector<IRLiveRange> &ranges, int numHostRegs) {
+	// Indexes of ranges currently assigned a host reg, sorted by end.
+	std::vector<int> active;
+	std::vector<int> freeRegs;
+	for (int hostReg = numHostRegs - 1; hostReg >= 0; --hostReg) {
+		freeRegs.push_back(hostReg);
+	}
+
+	auto activate = [&](int index) {
+		auto pos = std::upper_bound(active.begin(), active.end(), index, [&](int a, int b) {
+			return ranges[a].end < ranges[b].end;
+		});
+		active.insert(pos, index);
+	};
+
+	int spills = 0;
+	for (int i = 0, n = (int)ranges.size(); i < n; i++) {
+		IRLiveRange &cur = ranges[i];
+
+		// Expire ranges that ended before this one started.
+		while (!active.empty() && ranges[active.front()].end < cur.start) {
+			freeRegs.push_back(ranges[active.front()].hostReg);
+			active.erase(active.begin());
+		}
+
+		if (!freeRegs.empty()) {
+			cur.hostReg = freeRegs.back();
+			freeRegs.pop_back();
+			activate(i);
+			continue;
+		}
+
+		// Spill whichever lives longest, which might be this one.
+		spills++;
+		if (!active.empty() && ranges[active.back()].end > cur.end) {
+			IRLiveRange &victim = ranges[active.back()];
+			cur.hostReg = victim.hostReg;
+			victim.hostReg = -1;
+			active.pop_back();
+			activate(i);
+		} else {
+			cur.hostReg = -1;
+		}
+	}
+
+	return spills;
+}
+
+// Handles the FPU compare flag too, since it's often compared again before being read.
+bool RemoveDeadStores(const IRWriter &in, IRWriter &out, const IROptions &opts) {
+	const std::vector<IRInst> &insts = in.GetInstructions();
+	std::vector<bool> keep(insts.size(), true);
+	bool gprLive[256];
+	bool fprLive[256];
+
+	auto allLive = [&](bool includeTemps) {
+		for (int r = 0; r < 256; ++r) {
+			bool temp = r >= IRTEMP_0 && r <= IRTEMP_LR_SHIFT;
+			// Temps don't persist between blocks, so are dead at exits.
+			gprLive[r] = includeTemps || !temp;
+			fprLive[r] = true;
+		}
+	};
+	auto markGPR = [&](int reg) {
+		gprLive[reg] = true;
+	};
+	auto markFPR = [&](char type, int reg, bool live) {
+		int count = type == 'M' ? 16 : (type == 'V' ? 4 : (type == '2' ? 2 : (type == 'F' ? 1 : 0)));
+		for (int i = 0; i < count && reg + i < 256; ++i) {
+			fprLive[reg + i] = live;
+		}
+	};
+
+	// The block always ends in an exit, which will set everything live.
+	allLive(false);
+
+	bool logBlocks = false;
+	for (int i = (int)insts.size() - 1; i >= 0; --i) {
+		const IRInst &inst = insts[i];
+		const IRMeta *m = GetIRMeta(inst.op);
+		if (!m || IRAccessesContext(inst)) {
+			allLive(true);
+			continue;
+		}
+		if ((m->flags & IRFLAG_EXIT) != 0) {
+			// Conditional exits still fall through, so everything live below stays live.
+			bool fallthroughGPR[256];
+			memcpy(fallthroughGPR, gprLive, sizeof(gprLive));
+			allLive(false);
+			for (int r = IRTEMP_0; r <= IRTEMP_LR_SHIFT; ++r) {
+				gprLive[r] = fallthroughGPR[r];
+			}
+		}
+
+		bool writesFPCond = inst.op == IROp::FCmp || inst.op == IROp::ZeroFpCond;
+		int gprDest = writesFPCond ? (int)IRREG_FPCOND : IRDestGPR(inst);
+		// FCmovVfpuCC is conditional, so it doesn't always overwrite.  And writing r0 would be a bug anyway.
+		bool fprDest = (m->flags & (IRFLAG_SRC3 | IRFLAG_EXIT)) == 0 && m->types[0] == 'F' && inst.op != IROp::FCmovVfpuCC;
+		bool removable = false;
+		if (gprDest > 0 && (gprDest <= IRTEMP_LR_SHIFT || gprDest == IRREG_FPCOND)) {
+			removable = !gprLive[gprDest];
+		} else if (fprDest) {
+			removable = !fprLive[inst.dest];
+		}
+		if (removable) {
+			keep[i] = false;
+			continue;
+		}
+
+		// Kill what this writes, then mark what it reads.
+		if (gprDest > 0 && (m->flags & IRFLAG_SRC3DST) == 0) {
+			gprLive[gprDest] = false;
+		}
+		// Some Vec2 ops only write one reg, so don't assume anything about those.
+		bool fullFPRWrite = m->types[0] == 'F' || m->types[0] == 'V' || m->types[0] == 'M';
+		if ((m->flags & (IRFLAG_SRC3 | IRFLAG_EXIT)) == 0 && fullFPRWrite && inst.op != IROp::FCmovVfpuCC) {
+			markFPR(m->types[0], inst.dest, false);
+		}
+
+		if (m->types[1] == 'G')
+			markGPR(inst.src1);
+		else
+			markFPR(m->types[1], inst.src1, true);
+		if (m->types[2] == 'G')
+			markGPR(inst.src2);
+		else
+			markFPR(m->types[2], inst.src2, true);
+		if ((m->flags & (IRFLAG_SRC3 | IRFLAG_SRC3DST)) != 0 || inst.op == IROp::FCmovVfpuCC) {
+			if (m->types[0] == 'G')
+				markGPR(inst.src3);
+			else
+				markFPR(m->types[0], inst.src3, true);
+		}
+		if (inst.op == IROp::FpCondToReg) {
+			markGPR(IRREG_FPCOND);
+		}
+	}
+
+	for (size_t i = 0; i < insts.size(); ++i) {
+		if (keep[i]) {
+			out.Write(insts[i]);
+		}
+	}
+	return logBlocks;
+}
+
 bool PurgeTemps(const IRWriter &in, IRWriter &out, const IROptions &opts) {
 	std::vector<IRInst> insts;
 	insts.reserve(in.GetInstructions().size());
@@ -1,16 +1,43 @@
 #pragma once
 
+#include <string>
+#include <utility>
+#include <vector>
+
 #include "Core/MIPS/IR/IRInst.h"
 
 typedef bool (*IRPassFunc)(const IRWriter &in, IRWriter &out, const IROptions &opts);
 bool IRApplyPasses(const IRPassFunc *passes, size_t c, const IRWriter &in, IRWriter &out, const IROptions &opts);
+// Instructions removed by each pass (negative if it added some) since the last reset.
+void IRGetPassStats(std::vector<std::pair<std::string, int64_t>> &stats);
+void IRResetPassStats();
 
 // Block optimizer passes of varying usefulness.
 bool RemoveLoadStoreLeftRight(const IRWriter &in, IRWriter &out, const IROptions &opts);
 bool PropagateConstants(const IRWriter &in, IRWriter &out, const IROptions &opts);
 bool PurgeTemps(const IRWriter &in, IRWriter &out, const IROptions &opts);
+bool RemoveDeadStores(const IRWriter &in, IRWriter &out, const IROptions &opts);
 bool ReduceLoads(const IRWriter &in, IRWriter &out, const IROptions &opts);
 bool ThreeOpToTwoOp(const IRWriter &in, IRWriter &out, const IROptions &opts);
 bool OptimizeFPMoves(const IRWriter &in, IRWriter &out, const IROptions &opts);
 bool ReorderLoadStore(const IRWriter &in, IRWriter &out, const IROptions &opts);
 bool MergeLoadStore(const IRWriter &in, IRWriter &out, const IROptions &opts);
+
+// A GPR live range within a block, for backends that allocate host registers.
+struct IRLiveRange {
+	u8 reg;
+	// First access is a read, so it must be loaded from the context.
+	bool loadOnStart;
+	// Written to, so must be stored before exits and at the end.
+	bool dirty;
+	// Inclusive instruction indexes.
+	int start;
+	int end;
+	// Assigned by IRAllocateHostRegs(), -1 if spilled (stays in the context.)
+	int hostReg;
+};
+
+// Ranges are returned in order of start.  Ops that access the context directly end all ranges.
+std::vector<IRLiveRange> IRComputeLiveRanges(const std::vector<IRInst> &insts);
+// Linear scan allocation of host registers 0 to numHostRegs - 1.  Returns the number of spilled ranges.
+int IRAllocateHostRegs(std::vector<IRLiveRange> &ranges, int numHostRegs);
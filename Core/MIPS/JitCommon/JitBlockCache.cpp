@@ -23,8 +23,10 @@
 // locating performance issues.
 
 #include <cstddef>
+#include <cstdlib>
 #include <algorithm>
 
+#include "base/timeutil.h"
 #include "Common.h"
 
 #ifdef _WIN32
@@ -59,12 +61,17 @@ op_agent_t agent;
 
 const u32 INVALID_EXIT = 0xFFFFFFFF;
 
+// Pages are kept small, since most blocks are.
+static const int CODE_PAGE_SHIFT = 10;
+static const u32 NUM_CODE_PAGES = 0x20000000 >> CODE_PAGE_SHIFT;
+
 JitBlockCache::JitBlockCache(MIPSState *mips, CodeBlockCommon *codeBlock) :
-	codeBlock_(codeBlock), blocks_(nullptr), num_blocks_(0) {
+	codeBlock_(codeBlock), blocks_(nullptr), num_blocks_(0), hostBlockTable_(nullptr), numInvalidations_(0), numInvalidatedBlocks_(0), statsStartTime_(0.0) {
 }
 
 JitBlockCache::~JitBlockCache() {
 	Shutdown();
+	free(hostBlockTable_);
 }
 
 bool JitBlock::ContainsAddress(u32 em_address) {
@@ -82,6 +89,10 @@ void JitBlockCache::Init() {
 	agent = op_open_agent();
 #endif
 	blocks_ = new JitBlock[MAX_NUM_BLOCKS];
+	codePages_.resize(NUM_CODE_PAGES / 32);
+	numInvalidations_ = 0;
+	numInvalidatedBlocks_ = 0;
+	statsStartTime_ = time_now_d();
 	Clear();
 }
 
@@ -102,11 +113,13 @@ void JitBlockCache::Shutdown() {
 // This clears the JIT cache. It's called from JitCache.cpp when the JIT cache
 // is full and when saving and loading states.
 void JitBlockCache::Clear() {
-	block_map_.clear();
+	byPage_.clear();
+	std::fill(codePages_.begin(), codePages_.end(), 0);
 	proxyBlockMap_.clear();
 	for (int i = 0; i < num_blocks_; i++)
 		DestroyBlock(i, DestroyType::CLEAR);
 	links_to_.clear();
+	blockNumByEntry_.clear();
 	num_blocks_ = 0;
 
 	blockMemRanges_[JITBLOCK_RANGE_SCRATCH] = std::make_pair(0xFFFFFFFF, 0x00000000);
@@ -114,6 +127,99 @@ void JitBlockCache::Clear() {
 	blockMemRanges_[JITBLOCK_RANGE_RAMTOP] = std::make_pair(0xFFFFFFFF, 0x00000000);
 }
 
+void JitBlockCache::EnableHostBlockTable() {
+	if (!hostBlockTable_) {
+		// calloc so that pages of RAM without code are never touched.
+		hostBlockTable_ = (u32 *)calloc(HOST_TABLE_SIZE / 4, sizeof(u32));
+	}
+}
+
+u32 *JitBlockCache::GetHostBlockTableEntry(u32 em_address) const {
+	if (!hostBlockTable_)
+		return nullptr;
+	// Ignores the mirror and kernel bits, just like the emuhacks in memory would.
+	const u32 offset = (em_address & 0x3FFFFFFF) - HOST_TABLE_BASE;
+	if (offset >= HOST_TABLE_SIZE)
+		return nullptr;
+	return &hostBlockTable_[offset >> 2];
+}
+
+bool JitBlockCache::BlockStartChanged(int block_num) const {
+	const JitBlock &b = blocks_[block_num];
+	const u32 *entry = GetHostBlockTableEntry(b.originalAddress);
+	if (entry) {
+		// Memory is never modified, so all we can check is the original op.
+		return Memory::ReadUnchecked_U32(b.originalAddress) != b.originalFirstOpcode.encoding;
+	}
+	return Memory::ReadUnchecked_U32(b.originalAddress) != GetEmuHackOpForBlock(block_num).encoding;
+}
+
+void JitBlockCache::EvictBlocksInRange(const u8 *start, const u8 *end) {
+	for (int i = 0; i < num_blocks_; i++) {
+		const JitBlock &b = blocks_[i];
+		if (!b.invalid && b.normalEntry >= start && b.normalEntry < end) {
+			// This may also destroy blocks outside the range that inlined this one.
+			DestroyBlock(i, DestroyType::DESTROY);
+		}
+	}
+
+	// Now compact, dropping all invalid blocks.  Their code is either about to be
+	// overwritten or unreachable except through stale (unlinked) exits.
+	std::vector<int> remap(num_blocks_, -1);
+	int count = 0;
+	for (int i = 0; i < num_blocks_; i++) {
+		if (blocks_[i].invalid) {
+			// Already cleaned up by DestroyBlock, but a taken-over pure proxy may still have this.
+			delete blocks_[i].proxyFor;
+			blocks_[i].proxyFor = nullptr;
+			continue;
+		}
+		if (count != i) {
+			blocks_[count] = blocks_[i];
+			blocks_[i].proxyFor = nullptr;
+		}
+		blocks_[count].blockNum = count;
+		remap[i] = count++;
+	}
+	num_blocks_ = count;
+
+	std::unordered_multimap<u32, int> links;
+	for (auto it : links_to_) {
+		if (remap[it.second] != -1)
+			links.insert(std::make_pair(it.first, remap[it.second]));
+	}
+	links_to_.swap(links);
+
+	std::unordered_multimap<u32, int> proxies;
+	for (auto it : proxyBlockMap_) {
+		if (remap[it.second] != -1)
+			proxies.insert(std::make_pair(it.first, remap[it.second]));
+	}
+	proxyBlockMap_.swap(proxies);
+
+	for (auto it = byPage_.begin(); it != byPage_.end(); ) {
+		std::vector<int> &blocksInPage = it->second;
+		size_t n = 0;
+		for (int block_num : blocksInPage) {
+			if (remap[block_num] != -1)
+				blocksInPage[n++] = remap[block_num];
+		}
+		blocksInPage.resize(n);
+		if (blocksInPage.empty()) {
+			codePages_[it->first >> 5] &= ~(1 << (it->first & 31));
+			it = byPage_.erase(it);
+		} else {
+			++it;
+		}
+	}
+
+	blockNumByEntry_.clear();
+	for (int i = 0; i < num_blocks_; i++) {
+		if (!blocks_[i].IsPureProxy())
+			blockNumByEntry_[GetEmuHackOpForBlock(i).encoding & MIPS_EMUHACK_VALUE_MASK] = i;
+	}
+}
+
 void JitBlockCache::Reset() {
 	Shutdown();
 	Init();
@@ -197,8 +303,13 @@ void JitBlockCache::AddBlockMap(int block_num) {
 	const JitBlock &b = blocks_[block_num];
 	// Convert the logical address to a physical address for the block map
 	// Yeah, this'll work fine for PSP too I think.
-	u32 pAddr = b.originalAddress & 0x1FFFFFFF;
-	block_map_[std::make_pair(pAddr + 4 * b.originalSize, pAddr)] = block_num;
+	const u32 pAddr = b.originalAddress & 0x1FFFFFFF;
+	const u32 startPage = AddressToPage(pAddr);
+	const u32 endPage = AddressToPage(pAddr + 4 * b.originalSize);
+	for (u32 page = startPage; page <= endPage; ++page) {
+		byPage_[page].push_back(block_num);
+		codePages_[page >> 5] |= 1 << (page & 31);
+	}
 }
 
 void JitBlockCache::RemoveBlockMap(int block_num) {
@@ -208,20 +319,28 @@ void JitBlockCache::RemoveBlockMap(int block_num) {
 	}
 
 	const u32 pAddr = b.originalAddress & 0x1FFFFFFF;
-	auto it = block_map_.find(std::make_pair(pAddr + 4 * b.originalSize, pAddr));
-	if (it != block_map_.end() && it->second == (u32)block_num) {
-		block_map_.erase(it);
-	} else {
-		// It wasn't in there, or it has the wrong key.  Let's search...
-		for (auto it = block_map_.begin(); it != block_map_.end(); ++it) {
-			if (it->second == (u32)block_num) {
-				block_map_.erase(it);
-				break;
-			}
+	const u32 startPage = AddressToPage(pAddr);
+	const u32 endPage = AddressToPage(pAddr + 4 * b.originalSize);
+	for (u32 page = startPage; page <= endPage; ++page) {
+		auto iter = byPage_.find(page);
+		if (iter == byPage_.end())
+			continue;
+
+		std::vector<int> &blocksInPage = iter->second;
+		auto it = std::find(blocksInPage.begin(), blocksInPage.end(), block_num);
+		if (it != blocksInPage.end())
+			blocksInPage.erase(it);
+		if (blocksInPage.empty()) {
+			byPage_.erase(iter);
+			codePages_[page >> 5] &= ~(1 << (page & 31));
 		}
 	}
 }
 
+u32 JitBlockCache::AddressToPage(u32 pAddr) const {
+	return (pAddr & 0x1FFFFFFF) >> CODE_PAGE_SHIFT;
+}
+
 static void ExpandRange(std::pair<u32, u32> &range, u32 newStart, u32 newEnd) {
 	range.first = std::min(range.first, newStart);
 	range.second = std::max(range.second, newEnd);
@@ -232,7 +351,13 @@ void JitBlockCache::FinalizeBlock(int block_num, bool block_link) {
 
 	b.originalFirstOpcode = Memory::Read_Opcode_JIT(b.originalAddress);
 	MIPSOpcode opcode = GetEmuHackOpForBlock(block_num);
-	Memory::Write_Opcode_JIT(b.originalAddress, opcode);
+	blockNumByEntry_[opcode.encoding & MIPS_EMUHACK_VALUE_MASK] = block_num;
+	u32 *entry = GetHostBlockTableEntry(b.originalAddress);
+	if (entry) {
+		*entry = opcode.encoding & MIPS_EMUHACK_VALUE_MASK;
+	} else {
+		Memory::Write_Opcode_JIT(b.originalAddress, opcode);
+	}
 
 	AddBlockMap(block_num);
 
@@ -290,34 +415,22 @@ bool JitBlockCache::RangeMayHaveEmuHacks(u32 start, u32 end) const {
 	return false;
 }
 
-static int binary_search(JitBlock blocks_[], const u8 *baseoff, int imin, int imax) {
-	while (imin < imax) {
-		int imid = (imin + imax) / 2;
-		if (blocks_[imid].normalEntry < baseoff)
-			imin = imid + 1;
-		else
-			imax = imid;
-	}
-	if ((imax == imin) && (blocks_[imin].normalEntry == baseoff))
-		return imin;
-	else
-		return -1;
-}
-
 int JitBlockCache::GetBlockNumberFromEmuHackOp(MIPSOpcode inst, bool ignoreBad) const {
 	if (!num_blocks_ || !MIPS_IS_EMUHACK(inst)) // definitely not a JIT block
 		return -1;
 	int off = (inst & MIPS_EMUHACK_VALUE_MASK);
 
 	const u8 *baseoff = codeBlock_->GetBasePtr() + off;
-	if (baseoff < codeBlock_->GetBasePtr() || baseoff >= codeBlock_->GetCodePtr()) {
+	// Blocks are no longer in code order once old ones have been evicted, so look it up.
+	auto iter = blockNumByEntry_.find(off);
+	if (!codeBlock_->IsInSpace(baseoff) || iter == blockNumByEntry_.end()) {
 		if (!ignoreBad) {
 			ERROR_LOG(JIT, "JitBlockCache: Invalid Emuhack Op %08x", inst.encoding);
 		}
 		return -1;
 	}
 
-	int bl = binary_search(blocks_, baseoff, 0, num_blocks_ - 1);
+	int bl = iter->second;
 	if (bl >= 0 && blocks_[bl].invalid) {
 		return -1;
 	} else {
@@ -334,7 +447,8 @@ int JitBlockCache::GetBlockNumberFromStartAddress(u32 addr, bool realBlocksOnly)
 	if (!blocks_ || !Memory::IsValidAddress(addr))
 		return -1;
 
-	MIPSOpcode inst = MIPSOpcode(Memory::Read_U32(addr));
+	const u32 *entry = GetHostBlockTableEntry(addr);
+	MIPSOpcode inst = entry ? MIPSOpcode(*entry != 0 ? (MIPS_EMUHACK_OPCODE | *entry) : 0) : MIPSOpcode(Memory::Read_U32(addr));
 	int bl = GetBlockNumberFromEmuHackOp(inst);
 	if (bl < 0) {
 		if (!realBlocksOnly) {
@@ -448,8 +562,9 @@ std::vector<u32> JitBlockCache::SaveAndClearEmuHackOps() {
 		if (b.invalid)
 			continue;
 
+		// Nothing to clear if the block is in the host table, memory is already clean.
 		const u32 emuhack = GetEmuHackOpForBlock(block_num).encoding;
-		if (Memory::ReadUnchecked_U32(b.originalAddress) == emuhack)
+		if (!GetHostBlockTableEntry(b.originalAddress) && Memory::ReadUnchecked_U32(b.originalAddress) == emuhack)
 		{
 			result[block_num] = emuhack;
 			Memory::Write_Opcode_JIT(b.originalAddress, b.originalFirstOpcode);
@@ -524,8 +639,14 @@ void JitBlockCache::DestroyBlock(int block_num, DestroyType type) {
 
 	b->invalid = true;
 	if (!b->IsPureProxy()) {
-		if (Memory::ReadUnchecked_U32(b->originalAddress) == GetEmuHackOpForBlock(block_num).encoding)
+		const u32 emuhack = GetEmuHackOpForBlock(block_num).encoding;
+		u32 *entry = GetHostBlockTableEntry(b->originalAddress);
+		if (entry) {
+			if (*entry == (emuhack & MIPS_EMUHACK_VALUE_MASK))
+				*entry = 0;
+		} else if (Memory::ReadUnchecked_U32(b->originalAddress) == emuhack) {
 			Memory::Write_Opcode_JIT(b->originalAddress, b->originalFirstOpcode);
+		}
 	}
 
 	// It's not safe to set normalEntry to 0 here, since we use a binary search
@@ -558,30 +679,35 @@ void JitBlockCache::InvalidateICache(u32 address, const u32 length) {
 		return;
 	}
 
+	numInvalidations_++;
 	if (pAddr == 0 && pEnd >= 0x1FFFFFFF) {
 		InvalidateChangedBlocks();
 		return;
 	}
 
-	// Blocks may start and end in overlapping ways, and destroying one invalidates iterators.
-	// So after destroying one, we start over.
-	do {
-	restart:
-		auto next = block_map_.lower_bound(std::make_pair(pAddr, 0));
-		auto last = block_map_.upper_bound(std::make_pair(pEnd + MAX_BLOCK_INSTRUCTIONS, 0));
-		// Note that if next is end(), last will be end() too (equal.)
-		for (; next != last; ++next) {
-			const u32 blockStart = next->first.second;
-			const u32 blockEnd = next->first.first;
+	const u32 startPage = AddressToPage(pAddr);
+	const u32 endPage = AddressToPage(std::min(pEnd, (u32)0x1FFFFFFF));
+	for (u32 page = startPage; page <= endPage; ++page) {
+		if (!PageHasCode(page))
+			continue;
+		const auto iter = byPage_.find(page);
+		if (iter == byPage_.end())
+			continue;
+
+		// Destroying a block removes it (and maybe others) from the page, so walk a copy.
+		const std::vector<int> blocksInPage = iter->second;
+		for (int block_num : blocksInPage) {
+			const JitBlock &b = blocks_[block_num];
+			if (b.invalid)
+				continue;
+			const u32 blockStart = b.originalAddress & 0x1FFFFFFF;
+			const u32 blockEnd = blockStart + 4 * b.originalSize;
 			if (blockStart < pEnd && blockEnd > pAddr) {
-				DestroyBlock(next->second, DestroyType::INVALIDATE);
-				// Our iterator is now invalid.  Break and search again.
-				// Most of the time there shouldn't be a bunch of matching blocks.
-				goto restart;
+				DestroyBlock(block_num, DestroyType::INVALIDATE);
+				numInvalidatedBlocks_++;
 			}
 		}
-		// We got here - it wasn't in the map at all (or anymore.)
-	} while (false);
+	}
 }
 
 void JitBlockCache::InvalidateChangedBlocks() {
@@ -591,8 +717,7 @@ void JitBlockCache::InvalidateChangedBlocks() {
 		if (b.invalid || b.IsPureProxy())
 			continue;
 
-		const u32 emuhack = GetEmuHackOpForBlock(block_num).encoding;
-		if (Memory::ReadUnchecked_U32(b.originalAddress) != emuhack) {
+		if (BlockStartChanged(block_num)) {
 			DEBUG_LOG(JIT, "Invalidating changed block at %08x", b.originalAddress);
 			DestroyBlock(block_num, DestroyType::INVALIDATE);
 		}
@@ -640,6 +765,11 @@ void JitBlockCache::ComputeStats(BlockCacheStats &bcStats) const {
 	bcStats.minBloat = minBloat;
 	bcStats.maxBloat = maxBloat;
 	bcStats.avgBloat = totalBloat / (double)num_blocks_;
+
+	double elapsed = time_now_d() - statsStartTime_;
+	bcStats.numInvalidations = numInvalidations_;
+	bcStats.numInvalidatedBlocks = numInvalidatedBlocks_;
+	bcStats.invalidationsPerSec = elapsed > 0.0 ? (float)(numInvalidations_ / elapsed) : 0.0f;
 }
 
 JitBlockDebugInfo JitBlockCache::GetBlockDebugInfo(int blockNum) const {
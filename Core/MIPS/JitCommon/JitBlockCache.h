@@ -41,6 +41,12 @@ struct BlockCacheStats {
 	float maxBloat;
 	u32 maxBloatBlock;
 	std::map<float, u32> bloatMap;
+	// Instructions removed by each optimizer pass, if the backend has any.
+	std::vector<std::pair<std::string, int64_t>> passStats;
+	// InvalidateICache calls and the blocks they destroyed, since the jit started.
+	int numInvalidations;
+	int numInvalidatedBlocks;
+	float invalidationsPerSec;
 };
 
 enum class DestroyType {
@@ -150,6 +156,9 @@ class JitBlockCache : public JitBlockCacheDebugInterface {
 
 	// DOES NOT WORK CORRECTLY WITH JIT INLINING
 	void InvalidateICache(u32 address, const u32 length);
+	// Destroys all blocks with code in [start, end), so it can be reused, and renumbers the rest.
+	// The jit must make sure nothing outside still jumps into the range.
+	void EvictBlocksInRange(const u8 *start, const u8 *end);
 	void InvalidateChangedBlocks();
 	void DestroyBlock(int block_num, DestroyType type);
 
@@ -168,6 +177,16 @@ class JitBlockCache : public JitBlockCacheDebugInterface {
 		MAX_BLOCK_INSTRUCTIONS = 0x4000,
 	};
 
+	// Instead of writing emuhacks into RAM, blocks there can be found via a table of
+	// entry offsets (like the emuhack value), one u32 per MIPS word.  Zero means no block.
+	// Only valid for jits whose dispatcher knows how to read it.
+	enum {
+		HOST_TABLE_BASE = 0x08000000,
+		HOST_TABLE_SIZE = 0x02000000,
+	};
+	void EnableHostBlockTable();
+	const u32 *GetHostBlockTable() const { return hostBlockTable_; }
+
 private:
 	void LinkBlockExits(int i);
 	void LinkBlock(int i);
@@ -176,7 +195,14 @@ class JitBlockCache : public JitBlockCacheDebugInterface {
 	void AddBlockMap(int block_num);
 	void RemoveBlockMap(int block_num);
 
+	u32 AddressToPage(u32 pAddr) const;
+	bool PageHasCode(u32 page) const {
+		return (codePages_[page >> 5] & (1 << (page & 31))) != 0;
+	}
+
 	MIPSOpcode GetEmuHackOpForBlock(int block_num) const;
+	u32 *GetHostBlockTableEntry(u32 em_address) const;
+	bool BlockStartChanged(int block_num) const;
 
 	CodeBlockCommon *codeBlock_;
 	JitBlock *blocks_;
@@ -184,7 +210,16 @@ class JitBlockCache : public JitBlockCacheDebugInterface {
 
 	int num_blocks_;
 	std::unordered_multimap<u32, int> links_to_;
-	std::map<std::pair<u32,u32>, u32> block_map_; // (end_addr, start_addr) -> number
+	// Entry offset (the emuhack value) -> block number.
+	std::unordered_map<u32, int> blockNumByEntry_;
+	// Physical page -> blocks overlapping it, and a bit per page for a quick no-code check.
+	std::unordered_map<u32, std::vector<int>> byPage_;
+	std::vector<u32> codePages_;
+	u32 *hostBlockTable_;
+
+	int numInvalidations_;
+	int numInvalidatedBlocks_;
+	double statsStartTime_;
 
 	enum {
 		JITBLOCK_RANGE_SCRATCH = 0,
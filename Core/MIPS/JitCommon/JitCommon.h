@@ -122,6 +122,8 @@ namespace MIPSComp {
 		virtual ~JitInterface() {}
 
 		virtual bool DescribeCodePtr(const u8 *ptr, std::string &name) = 0;
+		// For memchecks caught by watched pages: the PSP pc of the memory access at host code ptr.
+		virtual bool GetMemCheckSite(const u8 *ptr, u32 *pc) { return false; }
 		virtual const u8 *GetDispatcher() const = 0;
 		virtual JitBlockCache *GetBlockCache() = 0;
 		virtual JitBlockCacheDebugInterface *GetBlockCacheDebugInterface() = 0;
@@ -130,6 +132,9 @@ namespace MIPSComp {
 		virtual void RunLoopUntil(u64 globalticks) = 0;
 		virtual void Compile(u32 em_address) = 0;
 		virtual void CompileFunction(u32 start_address, u32 length) { }
+		// Optional persistent cache of compiled code, keyed by module text contents.
+		virtual void LoadCodeCache(u32 start_address, u32 end_address) { }
+		virtual void SaveCodeCache(u32 start_address, u32 end_address) { }
 		virtual void ClearCache() = 0;
 		virtual MIPSOpcode GetOriginalOp(MIPSOpcode op) = 0;
 
@@ -16,6 +16,7 @@
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
 #include "Common/CPUDetect.h"
+#include "Core/Config.h"
 #include "Core/MIPS/JitCommon/JitState.h"
 #include "Common/MemoryUtil.h"
 
@@ -25,6 +26,13 @@ namespace MIPSComp {
 		enableVFPUSIMD = true;
 		// Set by Asm if needed.
 		reserveR15ForAsm = false;
+#if PPSSPP_ARCH(X86) || PPSSPP_ARCH(AMD64)
+		useHostBlockTable = g_Config.bJitHostBlockTable;
+		evictOldBlocks = g_Config.bJitEvictOldBlocks;
+#else
+		useHostBlockTable = false;
+		evictOldBlocks = false;
+#endif
 
 		// ARM/ARM64
 		useBackJump = false;
@@ -46,9 +54,14 @@ namespace MIPSComp {
 		// enableBlocklink = !PlatformIsWXExclusive();  // Revert to this line if block linking is slow in W^X mode
 		enableBlocklink = true;
 		immBranches = false;
-		continueBranches = false;
-		continueJumps = false;
+		// Compile past branches and jumps into larger blocks, keeping regs cached across them.
+		// Only x86 continues past conditional branches so far.
+		continueBranches = g_Config.bJitContinueBranches;
+		continueJumps = g_Config.bJitContinueBranches;
 		continueMaxInstructions = 300;
+		// Fast forward to the next event when a block just spins waiting on memory.
+		// Only x86 and ARM64 so far.
+		skipIdleLoops = g_Config.bJitSkipIdleLoops;
 
 		useStaticAlloc = false;
 		enablePointerify = false;
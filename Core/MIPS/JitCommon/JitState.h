@@ -179,6 +179,10 @@ namespace MIPSComp {
 		// x86
 		bool enableVFPUSIMD;
 		bool reserveR15ForAsm;
+		// Find blocks in RAM via JitBlockCache's host table, leaving guest memory alone.
+		bool useHostBlockTable;
+		// When the code space fills, evict the older half of the blocks instead of all of them.
+		bool evictOldBlocks;
 
 		// ARM/ARM64
 		bool useBackJump;
@@ -198,6 +202,7 @@ namespace MIPSComp {
 		bool continueBranches;
 		bool continueJumps;
 		int continueMaxInstructions;
+		bool skipIdleLoops;
 	};
 
 }
@@ -256,10 +256,11 @@ void MIPSState::DoState(PointerWrap &p) {
 	if (!s)
 		return;
 
-	// Reset the jit if we're loading.
-	if (p.mode == p.MODE_READ)
+	// Reset the jit if we're loading.  A run-ahead rollback keeps it, and invalidates what it restores.
+	const bool keepJit = p.mode == p.MODE_READ && PSP_CoreParameter().runningAhead;
+	if (p.mode == p.MODE_READ && !keepJit)
 		Reset();
-	if (MIPSComp::jit)
+	if (MIPSComp::jit && !keepJit)
 		MIPSComp::jit->DoState(p);
 	else
 		MIPSComp::DoDummyJitState(p);
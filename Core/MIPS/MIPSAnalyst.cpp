@@ -15,6 +15,7 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#include <algorithm>
 #include <map>
 #include <set>
 #include <unordered_map>
@@ -24,6 +25,8 @@
 #include "base/timeutil.h"
 #include "ext/cityhash/city.h"
 #include "Common/FileUtil.h"
+#include "Common/StringUtils.h"
+#include "Common/ThreadPools.h"
 #include "Core/Config.h"
 #include "Core/MemMap.h"
 #include "Core/System.h"
@@ -48,6 +51,12 @@ std::recursive_mutex functions_lock;
 // the same hash and should all be replaced if possible.
 static std::unordered_multimap<u64, MIPSAnalyst::AnalyzedFunction *> hashToFunction;
 
+// Start and length of functions not yet precompiled, the next one last.
+static std::vector<std::pair<u32, u32>> pendingPrecompile;
+static double precompileTime;
+// How long module load may spend precompiling.  The rest is compiled a little each frame.
+static const double PRECOMPILE_LOAD_SECONDS = 0.050;
+
 struct HashMapFunc {
 	char name[64];
 	u64 hash;
@@ -569,6 +578,66 @@ namespace MIPSAnalyst {
 		return (op >> 26) == 0 && (op & 0x3f) == 12;
 	}
 
+	bool BranchLeavesFunction(u32 branchAddr, u32 targetAddr) {
+		// Scanned functions are in the symbol map, which is faster to search.
+		if (!g_symbolMap)
+			return false;
+		u32 start = g_symbolMap->GetFunctionStart(branchAddr);
+		if (start == SymbolMap::INVALID_ADDRESS)
+			return false;
+		u32 size = g_symbolMap->GetFunctionSize(start);
+		return targetAddr < start || targetAddr >= start + size;
+	}
+
+	bool IsIdleLoop(u32 loopStart, u32 branchAddr) {
+		// Only tight loops, anything longer is likely doing real work.
+		if (loopStart > branchAddr || branchAddr - loopStart > 8 * 4)
+			return false;
+		if (!Memory::IsValidRange(loopStart, branchAddr + 8 - loopStart))
+			return false;
+
+		const u64 rejectFlags = BAD_INSTRUCTION | IS_CONDMOVE | OUT_MEM | IN_OTHER | OUT_OTHER | IN_FPUFLAG | OUT_FPUFLAG |
+			IN_VFPU_CC | OUT_VFPU_CC | IS_FPU | IS_VFPU | IN_LO | IN_HI | OUT_LO | OUT_HI | OUT_RA;
+		MIPSOpcode branchOp = Memory::Read_Instruction(branchAddr, true);
+		MIPSInfo branchInfo = MIPSGetInfo(branchOp);
+		if ((branchInfo & IS_CONDBRANCH) == 0 || (branchInfo & rejectFlags) != 0)
+			return false;
+		if (GetBranchTarget(branchAddr) != loopStart)
+			return false;
+
+		// Everything the loop reads before writing it must come from memory, or stay the same
+		// each time around.  Otherwise it's a counter or similar, which will finish by itself.
+		u64 writtenAnywhere = 0;
+		for (u32 addr = loopStart; addr <= branchAddr + 4; addr += 4) {
+			MIPSOpcode op = Memory::Read_Instruction(addr, true);
+			for (MIPSGPReg reg : GetOutputRegs(op))
+				writtenAnywhere |= 1ULL << reg;
+		}
+
+		u64 writtenSoFar = 0;
+		bool readsMemory = false;
+		for (u32 addr = loopStart; addr <= branchAddr + 4; addr += 4) {
+			MIPSOpcode op = Memory::Read_Instruction(addr, true);
+			MIPSInfo info = MIPSGetInfo(op);
+			if (MIPS_IS_EMUHACK(op) || IsSyscall(op) || (info & rejectFlags) != 0)
+				return false;
+			if (addr != branchAddr && (info & (IS_CONDBRANCH | IS_JUMP)) != 0)
+				return false;
+			if (info & IN_MEM)
+				readsMemory = true;
+
+			for (MIPSGPReg reg : GetInputRegs(op)) {
+				u64 bit = 1ULL << reg;
+				if (reg != MIPS_REG_ZERO && (writtenAnywhere & bit) != 0 && (writtenSoFar & bit) == 0)
+					return false;
+			}
+			for (MIPSGPReg reg : GetOutputRegs(op))
+				writtenSoFar |= 1ULL << reg;
+		}
+
+		return readsMemory;
+	}
+
 	static bool IsSWInstr(MIPSOpcode op) {
 		return (op & MIPSTABLE_IMM_MASK) == 0xAC000000;
 	}
@@ -748,6 +817,7 @@ namespace MIPSAnalyst {
 		std::lock_guard<std::recursive_mutex> guard(functions_lock);
 		functions.clear();
 		hashToFunction.clear();
+		pendingPrecompile.clear();
 	}
 
 	void UpdateHashToFunctionMap() {
@@ -872,40 +942,44 @@ namespace MIPSAnalyst {
 		return DetermineRegisterUsage(reg, addr, instrs) == USAGE_CLOBBERED;
 	}
 
-	void HashFunctions() {
-		std::lock_guard<std::recursive_mutex> guard(functions_lock);
-		std::vector<u32> buffer;
+	static void HashFunction(AnalyzedFunction &f, std::vector<u32> &buffer) {
+		if (!Memory::IsValidRange(f.start, f.end - f.start + 4)) {
+			return;
+		}
 
-		for (auto iter = functions.begin(), end = functions.end(); iter != end; iter++) {
-			AnalyzedFunction &f = *iter;
-			if (Memory::IsValidRange(f.start, f.end - f.start + 4)) {
-				continue;
+		// This is unfortunate.  In case of emuhacks or relocs, we have to make a copy.
+		buffer.resize((f.end - f.start + 4) / 4);
+		size_t pos = 0;
+		for (u32 addr = f.start; addr <= f.end; addr += 4) {
+			u32 validbits = 0xFFFFFFFF;
+			MIPSOpcode instr = Memory::ReadUnchecked_Instruction(addr, true);
+			if (MIPS_IS_EMUHACK(instr)) {
+				f.hasHash = false;
+				return;
 			}
 
-			// This is unfortunate.  In case of emuhacks or relocs, we have to make a copy.
-			buffer.resize((f.end - f.start + 4) / 4);
-			size_t pos = 0;
-			for (u32 addr = f.start; addr <= f.end; addr += 4) {
-				u32 validbits = 0xFFFFFFFF;
-				MIPSOpcode instr = Memory::ReadUnchecked_Instruction(addr, true);
-				if (MIPS_IS_EMUHACK(instr)) {
-					f.hasHash = false;
-					goto skip;
-				}
+			MIPSInfo flags = MIPSGetInfo(instr);
+			if (flags & IN_IMM16)
+				validbits &= ~0xFFFF;
+			if (flags & IN_IMM26)
+				validbits &= ~0x03FFFFFF;
+			buffer[pos++] = instr & validbits;
+		}
 
-				MIPSInfo flags = MIPSGetInfo(instr);
-				if (flags & IN_IMM16)
-					validbits &= ~0xFFFF;
-				if (flags & IN_IMM26)
-					validbits &= ~0x03FFFFFF;
-				buffer[pos++] = instr & validbits;
-			}
+		f.hash = CityHash64((const char *) &buffer[0], buffer.size() * sizeof(u32));
+		f.hasHash = true;
+	}
 
-			f.hash = CityHash64((const char *) &buffer[0], buffer.size() * sizeof(u32));
-			f.hasHash = true;
-skip:
-			;
-		}
+	void HashFunctions() {
+		std::lock_guard<std::recursive_mutex> guard(functions_lock);
+
+		// Functions only read memory, so they can be hashed in any order.
+		GlobalThreadPool::Loop([&](int l, int h) {
+			std::vector<u32> buffer;
+			for (int i = l; i < h; ++i) {
+				HashFunction(functions[i], buffer);
+			}
+		}, 0, (int)functions.size(), 64);
 	}
 
 	void PrecompileFunction(u32 startAddr, u32 length) {
@@ -921,17 +995,37 @@ namespace MIPSAnalyst {
 		}
 		std::lock_guard<std::recursive_mutex> guard(functions_lock);
 
-		// TODO: Load from cache file if available instead.
+		pendingPrecompile.clear();
+		pendingPrecompile.reserve(functions.size());
+		// Compiled from the back, so queue them in reverse to start with the lowest addresses.
+		for (auto iter = functions.rbegin(), end = functions.rend(); iter != end; iter++) {
+			pendingPrecompile.push_back(std::make_pair(iter->start, iter->end - iter->start + 4));
+		}
+		precompileTime = 0.0;
+
+		// Only some of them at load, the boot shouldn't wait on functions it may never call.
+		PrecompilePendingFunctions(PRECOMPILE_LOAD_SECONDS);
+	}
 
-		double st = real_time_now();
-		for (auto iter = functions.begin(), end = functions.end(); iter != end; iter++) {
-			const AnalyzedFunction &f = *iter;
+	void PrecompilePendingFunctions(double seconds) {
+		std::lock_guard<std::recursive_mutex> guard(functions_lock);
+		if (pendingPrecompile.empty()) {
+			return;
+		}
 
-			PrecompileFunction(f.start, f.end - f.start + 4);
+		double st = real_time_now();
+		double et = st;
+		while (!pendingPrecompile.empty() && et - st < seconds) {
+			auto func = pendingPrecompile.back();
+			pendingPrecompile.pop_back();
+			PrecompileFunction(func.first, func.second);
+			et = real_time_now();
 		}
-		double et = real_time_now();
+		precompileTime += et - st;
 
-		NOTICE_LOG(JIT, "Precompiled %d MIPS functions in %0.2f milliseconds", (int)functions.size(), (et - st) * 1000.0);
+		if (pendingPrecompile.empty()) {
+			NOTICE_LOG(JIT, "Precompiled %d MIPS functions in %0.2f milliseconds", (int)functions.size(), precompileTime * 1000.0);
+		}
 	}
 
 	static const char *DefaultFunctionName(char buffer[256], u32 startAddr) {
@@ -1018,9 +1112,134 @@ namespace MIPSAnalyst {
 		return furthestJumpbackAddr;
 	}
 
-	bool ScanForFunctions(u32 startAddr, u32 endAddr, bool insertSymbols) {
-		std::lock_guard<std::recursive_mutex> guard(functions_lock);
+	static const u32 FUNC_SCAN_CACHE_MAGIC = 0x53464650;  // PPFS
+	static const u32 FUNC_SCAN_CACHE_VERSION = 1;
+
+	struct FuncScanCacheHeader {
+		u32 magic;
+		u32 version;
+		u32 startAddr;
+		u32 endAddr;
+		u64 textHash;
+		u32 count;
+		u32 reserved;
+	};
+
+	struct FuncScanCacheEntry {
+		u32 start;
+		u32 end;
+		u8 isStraightLeaf;
+		// The scan checks the symbol map for all but a trailing unfinished function.
+		u8 checkSymbols;
+		u8 pad[2];
+	};
 
+	static u64 HashScanRange(u32 startAddr, u32 endAddr) {
+		// Same view of the code as the scan itself, so replaced functions don't change the hash.
+		std::vector<u32> buffer;
+		buffer.reserve((endAddr - startAddr) / 4 + 1);
+		for (u32 addr = startAddr; addr <= endAddr; addr += 4) {
+			buffer.push_back(Memory::Read_Instruction(addr, true).encoding);
+		}
+		return XXH64(&buffer[0], buffer.size() * sizeof(u32), 0x3E5B21C7);
+	}
+
+	static bool LoadScanCache(const std::string &filename, u32 startAddr, u32 endAddr, u64 textHash, std::vector<FuncScanCacheEntry> &entries) {
+		FILE *f = File::OpenCFile(filename, "rb");
+		if (!f)
+			return false;
+
+		FuncScanCacheHeader header{};
+		bool result = fread(&header, sizeof(header), 1, f) == 1;
+		result = result && header.magic == FUNC_SCAN_CACHE_MAGIC && header.version == FUNC_SCAN_CACHE_VERSION;
+		result = result && header.startAddr == startAddr && header.endAddr == endAddr && header.textHash == textHash;
+		result = result && header.count <= (endAddr - startAddr) / 4 + 1;
+		if (result && header.count != 0) {
+			entries.resize(header.count);
+			result = fread(&entries[0], sizeof(FuncScanCacheEntry), header.count, f) == header.count;
+		}
+		fclose(f);
+
+		if (!result) {
+			WARN_LOG(LOADER, "Bad function scan cache %s", filename.c_str());
+			entries.clear();
+			File::Delete(filename);
+		}
+		return result;
+	}
+
+	static void SaveScanCache(const std::string &filename, u32 startAddr, u32 endAddr, u64 textHash, size_t first, size_t trailing) {
+		FILE *f = File::OpenCFile(filename, "wb");
+		if (!f)
+			return;
+
+		FuncScanCacheHeader header{};
+		header.magic = FUNC_SCAN_CACHE_MAGIC;
+		header.version = FUNC_SCAN_CACHE_VERSION;
+		header.startAddr = startAddr;
+		header.endAddr = endAddr;
+		header.textHash = textHash;
+		header.count = (u32)(functions.size() - first);
+		fwrite(&header, sizeof(header), 1, f);
+		for (size_t i = first; i < functions.size(); ++i) {
+			FuncScanCacheEntry entry{};
+			entry.start = functions[i].start;
+			entry.end = functions[i].end;
+			entry.isStraightLeaf = functions[i].isStraightLeaf ? 1 : 0;
+			entry.checkSymbols = i != trailing ? 1 : 0;
+			fwrite(&entry, sizeof(entry), 1, f);
+		}
+		fclose(f);
+	}
+
+	// Returns false if the symbol map already has a function here, but with a different size.
+	static bool CheckSymbolMapFunction(AnalyzedFunction &f) {
+		// Check if we already have symbol info starting here.  If so, skip insertion.
+		// We used to use the symbols to find the functions, but sometimes we'd find
+		// wrong ones due to two modules with the same name.
+		u32 existingSize = g_symbolMap->GetFunctionSize(f.start);
+		if (existingSize != SymbolMap::INVALID_ADDRESS) {
+			f.foundInSymbolMap = true;
+
+			// If we run into a func with a different size, skip updating the hash map.
+			// This will prevent us saving incorrectly named funcs with wrong hashes.
+			u32 detectedSize = f.end - f.start + 4;
+			if (existingSize != detectedSize) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	static bool FinishScan(size_t first, bool insertSymbols) {
+		for (auto iter = functions.begin(); iter != functions.end(); iter++) {
+			iter->size = iter->end - iter->start + 4;
+		}
+		// Only this scan's functions, earlier ones were already added (or deliberately not.)
+		for (size_t i = first; i < functions.size(); ++i) {
+			const AnalyzedFunction &f = functions[i];
+			if (insertSymbols && !f.foundInSymbolMap) {
+				char temp[256];
+				g_symbolMap->AddFunction(DefaultFunctionName(temp, f.start), f.start, f.end - f.start + 4);
+			}
+		}
+
+		return insertSymbols;
+	}
+
+	struct FuncScanRun {
+		std::vector<AnalyzedFunction> found;
+		// Where the function after the last found one starts, unless the run reached the end.
+		u32 resume = 0;
+		bool reachedEnd = false;
+		// Index of an unfinished function at the end, which doesn't get checked against symbols.
+		size_t trailing = (size_t)-1;
+	};
+
+	// Scans from startAddr, not inside any function, and stops once a function ends beyond stopAddr.
+	// Functions don't carry any scan state past their end, so a run started at any function's end
+	// finds exactly what a scan from the start does from there on.
+	static void ScanFunctionsFrom(u32 startAddr, u32 endAddr, u32 stopAddr, FuncScanRun &run) {
 		AnalyzedFunction currentFunction = {startAddr};
 
 		u32 furthestBranch = 0;
@@ -1125,23 +1344,7 @@ namespace MIPSAnalyst {
 			if (end) {
 				currentFunction.end = addr + 4;
 				currentFunction.isStraightLeaf = isStraightLeaf;
-
-				// Check if we already have symbol info starting here.  If so, skip insertion.
-				// We used to use the symbols to find the functions, but sometimes we'd find
-				// wrong ones due to two modules with the same name.
-				u32 existingSize = g_symbolMap->GetFunctionSize(currentFunction.start);
-				if (existingSize != SymbolMap::INVALID_ADDRESS) {
-					currentFunction.foundInSymbolMap = true;
-
-					// If we run into a func with a different size, skip updating the hash map.
-					// This will prevent us saving incorrectly named funcs with wrong hashes.
-					u32 detectedSize = currentFunction.end - currentFunction.start + 4;
-					if (existingSize != detectedSize) {
-						insertSymbols = false;
-					}
-				}
-
-				functions.push_back(currentFunction);
+				run.found.push_back(currentFunction);
 
 				furthestBranch = 0;
 				addr += 4;
@@ -1150,24 +1353,118 @@ namespace MIPSAnalyst {
 				isStraightLeaf = true;
 				decreasedSp = false;
 				currentFunction.start = addr + 4;
-				currentFunction.foundInSymbolMap = false;
+
+				if (currentFunction.start > stopAddr) {
+					run.resume = currentFunction.start;
+					return;
+				}
 			}
 		}
 
+		run.reachedEnd = true;
 		if (addr <= endAddr) {
 			currentFunction.end = addr + 4;
-			functions.push_back(currentFunction);
+			run.trailing = run.found.size();
+			run.found.push_back(currentFunction);
 		}
 
-		for (auto iter = functions.begin(); iter != functions.end(); iter++) {
-			iter->size = iter->end - iter->start + 4;
-			if (insertSymbols && !iter->foundInSymbolMap) {
-				char temp[256];
-				g_symbolMap->AddFunction(DefaultFunctionName(temp, iter->start), iter->start, iter->end - iter->start + 4);
+	}
+
+	// Big modules are scanned in chunks in parallel.  Each chunk's scan starts guessing that no
+	// function crosses into it, and is used from the first function end it shares with the scan
+	// before it.  Otherwise, that part is scanned again, so the result matches a single scan.
+	static const u32 FUNC_SCAN_CHUNK_BYTES = 0x10000;
+
+	static void ScanFunctionsParallel(u32 startAddr, u32 endAddr, FuncScanRun &result) {
+		const int chunks = (int)((endAddr - startAddr) / FUNC_SCAN_CHUNK_BYTES) + 1;
+		auto chunkStop = [&](int i) {
+			return i + 1 < chunks ? startAddr + (i + 1) * FUNC_SCAN_CHUNK_BYTES - 4 : 0xFFFFFFFF;
+		};
+		if (chunks == 1) {
+			ScanFunctionsFrom(startAddr, endAddr, chunkStop(0), result);
+			return;
+		}
+
+		std::vector<FuncScanRun> runs(chunks);
+		GlobalThreadPool::Loop([&](int l, int h) {
+			for (int i = l; i < h; ++i) {
+				ScanFunctionsFrom(startAddr + i * FUNC_SCAN_CHUNK_BYTES, endAddr, chunkStop(i), runs[i]);
+			}
+		}, 0, chunks);
+
+		result = std::move(runs[0]);
+		for (int i = 1; i < chunks && !result.reachedEnd; ++i) {
+			const FuncScanRun &run = runs[i];
+			size_t next = result.resume == startAddr + i * FUNC_SCAN_CHUNK_BYTES ? 0 : (size_t)-1;
+			for (size_t j = 0; next == (size_t)-1 && j < run.found.size() && j != run.trailing; ++j) {
+				if (run.found[j].end + 4 == result.resume) {
+					next = j + 1;
+					break;
+				}
+			}
+
+			if (next != (size_t)-1) {
+				if (run.trailing != (size_t)-1) {
+					result.trailing = result.found.size() + run.trailing - next;
+				}
+				result.found.insert(result.found.end(), run.found.begin() + next, run.found.end());
+				result.resume = run.resume;
+				result.reachedEnd = run.reachedEnd;
+			} else {
+				FuncScanRun redo;
+				ScanFunctionsFrom(result.resume, endAddr, chunkStop(i), redo);
+				if (redo.trailing != (size_t)-1) {
+					result.trailing = result.found.size() + redo.trailing;
+				}
+				result.found.insert(result.found.end(), redo.found.begin(), redo.found.end());
+				result.resume = redo.resume;
+				result.reachedEnd = redo.reachedEnd;
 			}
 		}
+	}
 
-		return insertSymbols;
+	bool ScanForFunctions(u32 startAddr, u32 endAddr, bool insertSymbols) {
+		std::lock_guard<std::recursive_mutex> guard(functions_lock);
+		const size_t firstNew = functions.size();
+
+		// The scan is slow for big games, so the results are kept by a hash of the code.
+		std::string cacheFilename;
+		u64 textHash = 0;
+		if (g_Config.bFuncScanCache && endAddr > startAddr && Memory::IsValidRange(startAddr, endAddr - startAddr + 4)) {
+			textHash = HashScanRange(startAddr, endAddr);
+			File::CreateFullPath(GetSysDirectory(DIRECTORY_APP_CACHE));
+			cacheFilename = GetSysDirectory(DIRECTORY_APP_CACHE) + "/" + StringFromFormat("%08x_%016llx.funcscan", startAddr, textHash);
+
+			std::vector<FuncScanCacheEntry> cached;
+			if (LoadScanCache(cacheFilename, startAddr, endAddr, textHash, cached)) {
+				for (const FuncScanCacheEntry &entry : cached) {
+					AnalyzedFunction f = {entry.start};
+					f.end = entry.end;
+					f.isStraightLeaf = entry.isStraightLeaf != 0;
+					if (entry.checkSymbols && !CheckSymbolMapFunction(f)) {
+						insertSymbols = false;
+					}
+					functions.push_back(f);
+				}
+				return FinishScan(firstNew, insertSymbols);
+			}
+		}
+
+		FuncScanRun scan;
+		ScanFunctionsParallel(startAddr, endAddr, scan);
+		for (size_t i = 0; i < scan.found.size(); ++i) {
+			AnalyzedFunction &f = scan.found[i];
+			if (i != scan.trailing && !CheckSymbolMapFunction(f)) {
+				insertSymbols = false;
+			}
+			functions.push_back(f);
+		}
+		size_t trailing = scan.trailing == (size_t)-1 ? scan.trailing : firstNew + scan.trailing;
+
+		if (!cacheFilename.empty()) {
+			SaveScanCache(cacheFilename, startAddr, endAddr, textHash, firstNew, trailing);
+		}
+		return FinishScan(firstNew, insertSymbols);
 	}
 
 	void FinalizeScan(bool insertSymbols) {
@@ -1250,6 +1547,11 @@ namespace MIPSAnalyst {
 			functions.erase(prevMatch, functions.end());
 		}
 
+		auto pendingEnd = std::remove_if(pendingPrecompile.begin(), pendingPrecompile.end(), [&](const std::pair<u32, u32> &func) {
+			return func.first >= startAddr && func.first <= endAddr;
+		});
+		pendingPrecompile.erase(pendingEnd, pendingPrecompile.end());
+
 		RestoreReplacedInstructions(startAddr, endAddr);
 
 		if (functions.empty()) {
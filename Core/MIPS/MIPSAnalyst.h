@@ -109,7 +109,10 @@ namespace MIPSAnalyst
 	bool ScanForFunctions(u32 startAddr, u32 endAddr, bool insertSymbols);
 	void FinalizeScan(bool insertSymbols);
 	void ForgetFunctions(u32 startAddr, u32 endAddr);
+	// Queues all functions for precompiling, and compiles what fits in a short time.
 	void PrecompileFunctions();
+	// Continues queued precompiling for up to this long.  Call from the emu thread, outside the jit.
+	void PrecompilePendingFunctions(double seconds);
 	void PrecompileFunction(u32 startAddr, u32 length);
 
 	void SetHashMapFilename(const std::string& filename = "");
@@ -132,6 +135,11 @@ namespace MIPSAnalyst
 	bool IsDelaySlotNiceVFPU(MIPSOpcode branchOp, MIPSOpcode op);
 	bool IsDelaySlotNiceFPU(MIPSOpcode branchOp, MIPSOpcode op);
 	bool IsSyscall(MIPSOpcode op);
+	// Only true if branchAddr is inside a known function, and targetAddr is not.
+	bool BranchLeavesFunction(u32 branchAddr, u32 targetAddr);
+	// True if the loop from loopStart to the branch at branchAddr only polls memory, so that
+	// nothing but an interrupt, event or thread switch could ever make it exit.
+	bool IsIdleLoop(u32 loopStart, u32 branchAddr);
 
 	bool OpWouldChangeMemory(u32 pc, u32 addr, u32 size);
 	int OpMemoryAccessSize(u32 pc);
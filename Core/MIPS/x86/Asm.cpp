@@ -174,6 +174,28 @@ void Jit::GenerateFixedCode(JitOptions &jo) {
 			AND(32, R(EAX), Imm32(Memory::MEMVIEW32_MASK));
 #endif
 
+			const u32 *hostBlockTable = blocks.GetHostBlockTable();
+			FixupBranch notInTable, noTableBlock, foundInTable;
+			if (hostBlockTable) {
+				// RAM blocks are in the table as entry offsets, and never have emuhacks.
+				MOV(32, R(EDX), R(EAX));
+				AND(32, R(EDX), Imm32(0x3FFFFFFF));
+				SUB(32, R(EDX), Imm32(JitBlockCache::HOST_TABLE_BASE));
+				CMP(32, R(EDX), Imm32(JitBlockCache::HOST_TABLE_SIZE));
+				notInTable = J_CC(CC_AE, true);
+				// One u32 per MIPS word, so the byte offset is the same.
+#ifdef _M_IX86
+				MOV(32, R(EAX), MDisp(EDX, (u32)(uintptr_t)hostBlockTable));
+#elif _M_X64
+				MOV(PTRBITS, R(RCX), ImmPtr(hostBlockTable));
+				MOV(32, R(EAX), MComplex(RCX, RDX, SCALE_1, 0));
+#endif
+				TEST(32, R(EAX), R(EAX));
+				noTableBlock = J_CC(CC_Z, true);
+				foundInTable = J();
+				SetJumpTarget(notInTable);
+			}
+
 #ifdef _M_IX86
 			_assert_msg_(CPU, Memory::base != 0, "Memory base bogus");
 			MOV(32, R(EAX), MDisp(EAX, (u32)Memory::base));
@@ -185,6 +207,9 @@ void Jit::GenerateFixedCode(JitOptions &jo) {
 			SHR(32, R(EDX), Imm8(24));
 			CMP(32, R(EDX), Imm8(MIPS_EMUHACK_OPCODE >> 24));
 			FixupBranch notfound = J_CC(CC_NE);
+				if (hostBlockTable) {
+					SetJumpTarget(foundInTable);
+				}
 				if (enableDebug) {
 					ADD(32, MIPSSTATE_VAR(debugCount), Imm8(1));
 				}
@@ -200,6 +225,9 @@ void Jit::GenerateFixedCode(JitOptions &jo) {
 #endif
 				JMPptr(R(EAX));
 			SetJumpTarget(notfound);
+			if (hostBlockTable) {
+				SetJumpTarget(noTableBlock);
+			}
 
 			//Ok, no block, let's jit
 			RestoreRoundingMode(true);
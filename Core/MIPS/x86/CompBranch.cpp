@@ -188,6 +188,10 @@ bool Jit::PredictTakeBranch(u32 targetAddr, bool likely) {
 	if (likely)
 		return true;
 
+	// Leaving the function is usually a tail call or error path, so keep the trace inside.
+	if (MIPSAnalyst::BranchLeavesFunction(GetCompilerPC(), targetAddr))
+		return false;
+
 	// TODO: Normal branch prediction would be to take branches going upward to lower addresses.
 	// However, this results in worse performance as of this comment's writing.
 	// The reverse check generally gives better or same performance.
@@ -790,9 +794,13 @@ void Jit::Comp_Syscall(MIPSOpcode op)
 #else
 	// Skip the CallSyscall where possible.
 	void *quickFunc = GetQuickSyscallFunc(op);
-	if (quickFunc)
+	if (quickFunc) {
+		// CallSyscall() counts calls itself, but we're skipping it.
+		u32 *counter = GetSyscallCallCounter(op);
+		if (counter)
+			IncrementCounter(counter);
 		ABI_CallFunctionP(quickFunc, (void *)GetSyscallFuncPointer(op));
-	else
+	} else
 		ABI_CallFunctionC(&CallSyscall, op.encoding);
 #endif
 
@@ -107,10 +107,14 @@ static void JitLogMiss(MIPSOpcode op)
 Jit::Jit(MIPSState *mips)
 		: blocks(mips, this), mips_(mips) {
 	blocks.Init();
+	if (jo.useHostBlockTable)
+		blocks.EnableHostBlockTable();
 	gpr.SetEmitter(this);
 	fpr.SetEmitter(this);
 	AllocCodeSpace(1024 * 1024 * 16);
 	GenerateFixedCode(jo);
+	blockSpaceStart_ = GetWritableCodePtr();
+	codeHalf_ = 0;
 
 	safeMemFuncs.Init(&thunks);
 
@@ -204,6 +208,68 @@ void Jit::ClearCache()
 	blocks.Clear();
 	ClearCodeSpace(0);
 	GenerateFixedCode(jo);
+	blockSpaceStart_ = GetWritableCodePtr();
+	codeHalf_ = 0;
+	memCheckSites.clear();
+}
+
+size_t Jit::GetBlockSpaceLeft() const {
+	if (jo.evictOldBlocks && codeHalf_ == 0) {
+		// The second half may still hold older blocks, so stop at the middle.
+		const u8 *end = GetCodePtr() + GetSpaceLeft();
+		const u8 *mid = blockSpaceStart_ + (end - blockSpaceStart_) / 2;
+		return GetCodePtr() < mid ? mid - GetCodePtr() : 0;
+	}
+	return GetSpaceLeft();
+}
+
+void Jit::EvictOldCode() {
+	u8 *end = GetWritableCodePtr() + GetSpaceLeft();
+	u8 *mid = blockSpaceStart_ + (end - blockSpaceStart_) / 2;
+	// Throw away the older half, and keep going there.  The newer half's blocks stay.
+	u8 *reuseStart = codeHalf_ == 0 ? mid : blockSpaceStart_;
+	u8 *reuseEnd = codeHalf_ == 0 ? end : mid;
+
+	INFO_LOG(JIT, "Jit code space full, evicting the oldest %d KB of blocks", (int)((reuseEnd - reuseStart) / 1024));
+	blocks.EvictBlocksInRange(reuseStart, reuseEnd);
+	UnlinkExitsInto(reuseStart, reuseEnd);
+	memCheckSites.erase(memCheckSites.lower_bound(reuseStart), memCheckSites.lower_bound(reuseEnd));
+	SetCodePtr(reuseStart);
+	codeHalf_ ^= 1;
+}
+
+void Jit::UnlinkExitsInto(const u8 *start, const u8 *end) {
+	// Invalid blocks are only reached through their (patched) checked entry, so only live blocks matter.
+	// Their exits might jump right into the range even if linkStatus was cleared when a block died.
+	const u8 *dispatcherPtr = dispatcher;
+	for (int i = 0; i < blocks.GetNumBlocks(); ++i) {
+		JitBlock *b = blocks.GetBlock(i);
+		if (b->invalid || b->IsPureProxy())
+			continue;
+
+		for (int e = 0; e < MAX_JIT_BLOCK_EXITS; ++e) {
+			u8 *exitPtr = b->exitPtrs[e];
+			if (b->exitAddress[e] == 0xFFFFFFFF || !exitPtr || *exitPtr != 0xE9)
+				continue;
+			// A linked exit is a JMP rel32.
+			s32 rel;
+			memcpy(&rel, exitPtr + 1, sizeof(rel));
+			const u8 *target = exitPtr + 5 + rel;
+			if (target < start || target >= end)
+				continue;
+
+			if (PlatformIsWXExclusive()) {
+				ProtectMemoryPages(exitPtr, 32, MEM_PROT_READ | MEM_PROT_WRITE);
+			}
+			XEmitter emit(exitPtr);
+			emit.MOV(32, MIPSSTATE_VAR(pc), Imm32(b->exitAddress[e]));
+			emit.JMP(dispatcherPtr, true);
+			if (PlatformIsWXExclusive()) {
+				ProtectMemoryPages(exitPtr, 32, MEM_PROT_READ | MEM_PROT_EXEC);
+			}
+			b->linkStatus[e] = false;
+		}
+	}
 }
 
 void Jit::SaveFlags() {
@@ -262,8 +328,13 @@ void Jit::EatInstruction(MIPSOpcode op) {
 
 void Jit::Compile(u32 em_address) {
 	PROFILE_THIS_SCOPE("jitc");
-	if (GetSpaceLeft() < 0x10000 || blocks.IsFull()) {
+	if (blocks.IsFull()) {
 		ClearCache();
+	} else if (GetBlockSpaceLeft() < 0x10000) {
+		if (jo.evictOldBlocks)
+			EvictOldCode();
+		else
+			ClearCache();
 	}
 
 	BeginWrite();
@@ -383,7 +454,7 @@ const u8 *Jit::DoJit(u32 em_address, JitBlock *b) {
 		js.numInstructions++;
 
 		// Safety check, in case we get a bunch of really large jit ops without a lot of branching.
-		if (GetSpaceLeft() < 0x800 || js.numInstructions >= JitBlockCache::MAX_BLOCK_INSTRUCTIONS) {
+		if (GetBlockSpaceLeft() < 0x800 || js.numInstructions >= JitBlockCache::MAX_BLOCK_INSTRUCTIONS) {
 			FlushAll();
 			WriteExit(GetCompilerPC(), js.nextExit++);
 			js.compiling = false;
@@ -412,6 +483,23 @@ void Jit::AddContinuedBlock(u32 dest) {
 	js.lastContinuedPC = dest;
 }
 
+bool Jit::GetMemCheckSite(const u8 *ptr, u32 *pc) {
+	// Slow accesses happen in the shared funcs, but always store the pc first in this mode.
+	if (safeMemFuncs.IsInSpace(ptr)) {
+		*pc = mips_->pc;
+		return true;
+	}
+
+	auto it = memCheckSites.upper_bound(ptr);
+	if (it == memCheckSites.begin())
+		return false;
+	--it;
+	if (ptr >= it->second.end)
+		return false;
+	*pc = it->second.pc;
+	return true;
+}
+
 bool Jit::DescribeCodePtr(const u8 *ptr, std::string &name) {
 	if (ptr == applyRoundingMode)
 		name = "applyRoundingMode";
@@ -525,6 +613,7 @@ bool Jit::ReplaceJalTo(u32 dest) {
 		CompileDelaySlot(DELAYSLOT_NICE);
 		FlushAll();
 		MOV(32, MIPSSTATE_VAR(pc), Imm32(GetCompilerPC()));
+		CountReplacementHit((int)(entry - GetReplacementFunc(0)));
 		RestoreRoundingMode();
 		ABI_CallFunction(entry->replaceFunc);
 		SUB(32, MIPSSTATE_VAR(downcount), R(EAX));
@@ -594,6 +683,7 @@ void Jit::Comp_ReplacementFunc(MIPSOpcode op) {
 		// Standard function call, nothing fancy.
 		// The function returns the number of cycles it took in EAX.
 		MOV(32, MIPSSTATE_VAR(pc), Imm32(GetCompilerPC()));
+		CountReplacementHit(index);
 		RestoreRoundingMode();
 		ABI_CallFunction(entry->replaceFunc);
 
@@ -615,6 +705,16 @@ void Jit::Comp_ReplacementFunc(MIPSOpcode op) {
 	}
 }
 
+void Jit::CountReplacementHit(int index) {
+	IncrementCounter(GetReplacementHitCounter(index));
+}
+
+void Jit::IncrementCounter(u32 *counter) {
+	// Everything's flushed, so EAX is free.
+	MOV(PTRBITS, R(EAX), ImmPtr(counter));
+	ADD(32, MatR(EAX), Imm8(1));
+}
+
 void Jit::Comp_Generic(MIPSOpcode op) {
 	FlushAll();
 	MIPSInterpretFunc func = MIPSGetInterpretFunc(op);
@@ -664,6 +764,11 @@ void Jit::WriteExit(u32 destination, int exit_num) {
 		SetJumpTarget(skipCheck);
 	}
 
+	if (jo.skipIdleLoops && destination == js.blockStart && MIPSAnalyst::IsIdleLoop(destination, GetCompilerPC())) {
+		// Only an event can end this loop, so jump ahead to it.  The downcount check runs it.
+		ABI_CallFunctionC(&CoreTiming::Idle, 0);
+	}
+
 	WriteDowncount();
 
 	//If nobody has taken care of this yet (this can be removed when all branches are done)
@@ -677,6 +782,14 @@ void Jit::WriteExit(u32 destination, int exit_num) {
 		// It exists! Joy of joy!
 		JMP(blocks.GetBlock(block)->checkedEntry, true);
 		b->linkStatus[exit_num] = true;
+		if (jo.evictOldBlocks) {
+			// Leave room to unlink it again, if the target gets evicted.
+			ptrdiff_t actualSize = GetWritableCodePtr() - b->exitPtrs[exit_num];
+			int pad = JitBlockCache::GetBlockExitSize() - (int)actualSize;
+			for (int i = 0; i < pad; ++i) {
+				INT3();
+			}
+		}
 	} else {
 		// No blocklinking.
 		MOV(32, MIPSSTATE_VAR(pc), Imm32(destination));
@@ -762,6 +875,17 @@ bool Jit::CheckJitBreakpoint(u32 addr, int downcountOffset) {
 	if (CBreakPoints::IsAddressBreakPoint(addr)) {
 		SaveFlags();
 		FlushAll();
+
+		// Simple conditions are checked inline, so a miss costs just a compare and branch.
+		BreakPointFastCond fastCond;
+		bool hasFastCond = CBreakPoints::GetBreakPointFastCond(addr, &fastCond);
+		FixupBranch condMiss;
+		if (hasFastCond) {
+			static const CCFlags missFlags[] = { CC_NE, CC_E, CC_AE, CC_A, CC_BE, CC_B };
+			CMP(32, gpr.GetDefaultLocation((MIPSGPReg)fastCond.reg), Imm32(fastCond.value));
+			condMiss = J_CC(missFlags[fastCond.op], true);
+		}
+
 		MOV(32, MIPSSTATE_VAR(pc), Imm32(GetCompilerPC()));
 		RestoreRoundingMode();
 		ABI_CallFunction(&JitBreakpoint);
@@ -777,6 +901,8 @@ bool Jit::CheckJitBreakpoint(u32 addr, int downcountOffset) {
 		SetJumpTarget(skip);
 
 		ApplyRoundingMode();
+		if (hasFastCond)
+			SetJumpTarget(condMiss);
 		LoadFlags();
 		return true;
 	}
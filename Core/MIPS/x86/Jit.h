@@ -20,6 +20,8 @@
 
 #pragma once
 
+#include <map>
+
 #include "Common/CommonTypes.h"
 #include "Common/Thunk.h"
 #include "Common/x64Emitter.h"
@@ -64,6 +66,7 @@ class Jit : public Gen::XCodeBlock, public JitInterface, public MIPSFrontendInte
 	const u8 *DoJit(u32 em_address, JitBlock *b);
 
 	bool DescribeCodePtr(const u8 *ptr, std::string &name) override;
+	bool GetMemCheckSite(const u8 *ptr, u32 *pc) override;
 
 	void Comp_RunBlock(MIPSOpcode op) override;
 	void Comp_ReplacementFunc(MIPSOpcode op) override;
@@ -278,6 +281,10 @@ class Jit : public Gen::XCodeBlock, public JitInterface, public MIPSFrontendInte
 		if (!targetAddr) {
 			return false;
 		}
+		// Idle loops need to exit back to themselves, so WriteExit() can skip ahead.
+		if (jo.skipIdleLoops && targetAddr == js.blockStart && MIPSAnalyst::IsIdleLoop(targetAddr, GetCompilerPC())) {
+			return false;
+		}
 		return true;
 	}
 	bool CanContinueJump(u32 targetAddr) {
@@ -298,6 +305,13 @@ class Jit : public Gen::XCodeBlock, public JitInterface, public MIPSFrontendInte
 	void SaveFlags();
 	void LoadFlags();
 
+	void CountReplacementHit(int index);
+	void IncrementCounter(u32 *counter);
+
+	size_t GetBlockSpaceLeft() const;
+	void EvictOldCode();
+	void UnlinkExitsInto(const u8 *start, const u8 *end);
+
 	JitBlockCache blocks;
 	JitOptions jo;
 	JitState js;
@@ -308,6 +322,17 @@ class Jit : public Gen::XCodeBlock, public JitInterface, public MIPSFrontendInte
 	ThunkManager thunks;
 	JitSafeMemFuncs safeMemFuncs;
 
+	// Host code of each memory access, only while memchecks are caught by watching pages.
+	struct MemCheckSite {
+		const u8 *end;
+		u32 pc;
+	};
+	std::map<const u8 *, MemCheckSite> memCheckSites;
+
+	// Blocks go after the fixed code.  When evicting, the rest is used as two halves.
+	u8 *blockSpaceStart_;
+	int codeHalf_;
+
 	MIPSState *mips_;
 
 
@@ -60,6 +60,8 @@ JitSafeMem::JitSafeMem(Jit *jit, MIPSGPReg raddr, s32 offset, u32 alignMask)
 		iaddr_ = (u32) -1;
 
 	fast_ = g_Config.bFastMemory || raddr == MIPS_REG_SP;
+	pageChecks_ = CBreakPoints::MemChecksUsePages();
+	siteStart_ = jit_->GetCodePtr();
 
 	// If raddr_ is going to get loaded soon, load it now for more optimal code.
 	// We assume that it was already locked.
@@ -259,7 +261,7 @@ void JitSafeMem::DoSlowWrite(const void *safeFunc, const OpArg& src, int suboffs
 	if (!src.IsSimpleReg(EDX)) {
 		jit_->MOV(32, R(EDX), src);
 	}
-	if (!g_Config.bIgnoreBadMemAccess) {
+	if (!g_Config.bIgnoreBadMemAccess || pageChecks_) {
 		jit_->MOV(32, MIPSSTATE_VAR(pc), Imm32(jit_->GetCompilerPC()));
 	}
 	// This is a special jit-ABI'd function.
@@ -289,7 +291,7 @@ bool JitSafeMem::PrepareSlowRead(const void *safeFunc)
 				jit_->AND(32, R(EAX), Imm32(alignMask_));
 		}
 
-		if (!g_Config.bIgnoreBadMemAccess) {
+		if (!g_Config.bIgnoreBadMemAccess || pageChecks_) {
 			jit_->MOV(32, MIPSSTATE_VAR(pc), Imm32(jit_->GetCompilerPC()));
 		}
 		// This is a special jit-ABI'd function.
@@ -323,7 +325,7 @@ void JitSafeMem::NextSlowRead(const void *safeFunc, int suboffset)
 			jit_->AND(32, R(EAX), Imm32(alignMask_));
 	}
 
-	if (!g_Config.bIgnoreBadMemAccess) {
+	if (!g_Config.bIgnoreBadMemAccess || pageChecks_) {
 		jit_->MOV(32, MIPSSTATE_VAR(pc), Imm32(jit_->GetCompilerPC()));
 	}
 	// This is a special jit-ABI'd function.
@@ -344,10 +346,15 @@ void JitSafeMem::Finish()
 		jit_->SetJumpTarget(skip_);
 	for (auto it = skipChecks_.begin(), end = skipChecks_.end(); it != end; ++it)
 		jit_->SetJumpTarget(*it);
+	if (pageChecks_)
+		jit_->memCheckSites[siteStart_] = { jit_->GetCodePtr(), jit_->GetCompilerPC() };
 }
 
 void JitSafeMem::MemCheckImm(MemoryOpType type)
 {
+	if (pageChecks_)
+		return;
+
 	MemCheck *check = CBreakPoints::GetMemCheck(iaddr_, size_);
 	if (check)
 	{
@@ -376,6 +383,9 @@ void JitSafeMem::MemCheckImm(MemoryOpType type)
 
 void JitSafeMem::MemCheckAsm(MemoryOpType type)
 {
+	if (pageChecks_)
+		return;
+
 	const auto memchecks = CBreakPoints::GetMemCheckRanges();
 	bool possible = false;
 	for (auto it = memchecks.begin(), end = memchecks.end(); it != end; ++it)
@@ -80,6 +80,9 @@ class JitSafeMem {
 	bool needsCheck_;
 	bool needsSkip_;
 	bool fast_;
+	// Memchecks are caught by watched pages, so only the site is recorded.
+	bool pageChecks_;
+	const u8 *siteStart_;
 	u32 alignMask_;
 	u32 iaddr_;
 	Gen::X64Reg xaddr_;
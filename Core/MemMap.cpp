@@ -17,14 +17,26 @@
 
 #include "ppsspp_config.h"
 
-#if PPSSPP_PLATFORM(UWP)
+#ifdef _WIN32
 #include "Common/CommonWindows.h"
+#else
+#include <signal.h>
+#include <ucontext.h>
 #endif
 
 #include <algorithm>
+#include <atomic>
 #include <mutex>
+#include <vector>
 
+#include "base/basictypes.h"
 #include "Common/Common.h"
+#ifdef _M_SSE
+#include <emmintrin.h>
+#endif
+#if PPSSPP_ARCH(ARM_NEON)
+#include <arm_neon.h>
+#endif
 #include "Common/MemoryUtil.h"
 #include "Common/MemArena.h"
 #include "Common/ChunkFile.h"
@@ -336,6 +348,8 @@ void DoState(PointerWrap &p) {
 
 void Shutdown() {
 	std::lock_guard<std::recursive_mutex> guard(g_shutdownLock);
+	StopWriteTracking();
+	ClearWatchedRanges();
 	u32 flags = 0;
 	MemoryMap_Shutdown(flags);
 	base = nullptr;
@@ -355,6 +369,573 @@ bool IsActive() {
 	return base != nullptr;
 }
 
+struct TrackedView {
+	u8 *ptr;
+	u32 size;
+	// Tracked page number of the view's first page.
+	u32 firstPage;
+	u32 address;
+};
+
+static std::vector<TrackedView> trackedViews;
+static std::vector<u8> writtenPages;
+// Whether each page is write protected right now, which rewind and arms from caches both ask for.
+static std::vector<u8> armedPages;
+// Bumped on each fault.  Pages keep the stamp of their last fault.
+static std::vector<u32> pageWriteStamps;
+static std::atomic<u32> writeStamp(1);
+// All pages count as written as of this stamp, since writes went untracked before it.
+static u32 bulkWriteStamp = 1;
+static u32 trackedPageSize;
+static u32 trackedScratchPages;
+static u32 trackedVRAMPages;
+static volatile bool trackingWrites = false;
+static bool trackingSuspended = false;
+
+// Faults, host writes, and arming from the GPU thread all change protection, so they take turns.
+static std::atomic_flag trackingLock = ATOMIC_FLAG_INIT;
+
+class TrackingLockGuard {
+public:
+	TrackingLockGuard() {
+		while (trackingLock.test_and_set(std::memory_order_acquire))
+			continue;
+	}
+	~TrackingLockGuard() {
+		trackingLock.clear(std::memory_order_release);
+	}
+};
+
+enum : u8 {
+	WATCH_NONE = 0,
+	WATCH_WRITES = 1,
+	WATCH_ACCESS = 2,
+};
+
+// Watches use the same page numbering as write tracking, with their own copy of the views.
+static std::vector<TrackedView> watchedViews;
+static std::vector<u8> watchedPages;
+static std::vector<u32> watchedPageList;
+static volatile bool watchingPages = false;
+static WatchHitFunc watchHitFunc = nullptr;
+
+static void SetTrackedPageWritable(u32 page, bool writable) {
+	const u32 prot = writable ? MEM_PROT_READ | MEM_PROT_WRITE : MEM_PROT_READ;
+	for (const TrackedView &view : trackedViews) {
+		if (page >= view.firstPage && page < view.firstPage + view.size / trackedPageSize) {
+			ProtectMemoryPages(view.ptr + (page - view.firstPage) * trackedPageSize, trackedPageSize, prot);
+		}
+	}
+}
+
+static bool BuildTrackedViews(std::vector<TrackedView> &out) {
+	trackedPageSize = GetMemoryProtectPageSize();
+	if ((SCRATCHPAD_SIZE % trackedPageSize) != 0 || (g_MemorySize % trackedPageSize) != 0)
+		return false;
+	trackedScratchPages = SCRATCHPAD_SIZE / trackedPageSize;
+	trackedVRAMPages = VRAM_SIZE / trackedPageSize;
+
+	out.clear();
+	for (int i = 0; i < num_views; i++) {
+		const MemoryView &view = views[i];
+		if (view.size == 0 || !*view.out_ptr)
+			continue;
+		// 32-bit may share one view between several addresses.
+		u8 *ptr = *view.out_ptr;
+		if (std::find_if(out.begin(), out.end(), [ptr](const TrackedView &v) { return v.ptr == ptr; }) != out.end())
+			continue;
+
+		const u32 physAddress = view.virtual_address & 0x3FFFFFFF;
+		u32 firstPage;
+		if (physAddress < PSP_GetVidMemBase()) {
+			firstPage = (physAddress - PSP_GetScratchpadMemoryBase()) / trackedPageSize;
+		} else if (physAddress < PSP_GetKernelMemoryBase()) {
+			// Each VRAM mirror maps all of it.
+			firstPage = trackedScratchPages;
+		} else {
+			firstPage = trackedScratchPages + trackedVRAMPages + (physAddress - PSP_GetKernelMemoryBase()) / trackedPageSize;
+		}
+		out.push_back({ ptr, view.size, firstPage, view.virtual_address });
+	}
+	return true;
+}
+
+static bool TrackedPageFromAddress(u32 address, u32 *page) {
+	const u32 physAddress = address & 0x3FFFFFFF;
+	if (physAddress >= PSP_GetScratchpadMemoryBase() && physAddress < PSP_GetScratchpadMemoryEnd()) {
+		*page = (physAddress - PSP_GetScratchpadMemoryBase()) / trackedPageSize;
+	} else if (physAddress >= PSP_GetVidMemBase() && physAddress < PSP_GetVidMemEnd()) {
+		*page = trackedScratchPages + ((physAddress - PSP_GetVidMemBase()) % VRAM_SIZE) / trackedPageSize;
+	} else if (physAddress >= PSP_GetKernelMemoryBase() && physAddress < PSP_GetKernelMemoryBase() + g_MemorySize) {
+		*page = trackedScratchPages + trackedVRAMPages + (physAddress - PSP_GetKernelMemoryBase()) / trackedPageSize;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+static void MarkTrackedPageWritten(u32 page) {
+	writtenPages[page] = 1;
+	pageWriteStamps[page] = ++writeStamp;
+	if (armedPages[page]) {
+		armedPages[page] = 0;
+		SetTrackedPageWritable(page, true);
+	}
+}
+
+bool HandleWriteTrackingFault(uintptr_t hostAddress) {
+	if (!trackingWrites)
+		return false;
+
+	TrackingLockGuard guard;
+	if (!trackingWrites)
+		return false;
+	for (const TrackedView &view : trackedViews) {
+		uintptr_t offset = hostAddress - (uintptr_t)view.ptr;
+		if (offset < view.size) {
+			u32 page = view.firstPage + (u32)(offset / trackedPageSize);
+			// Another thread may have opened the page already, then this just retries the write.
+			MarkTrackedPageWritten(page);
+			return true;
+		}
+	}
+	return false;
+}
+
+static void SetWatchedPageArmed(u32 page, bool armed) {
+	u32 prot = MEM_PROT_READ | MEM_PROT_WRITE;
+	if (armed)
+		prot = watchedPages[page] == WATCH_ACCESS ? 0 : MEM_PROT_READ;
+	for (const TrackedView &view : watchedViews) {
+		if (page >= view.firstPage && page < view.firstPage + view.size / trackedPageSize) {
+			ProtectMemoryPages(view.ptr + (page - view.firstPage) * trackedPageSize, trackedPageSize, prot);
+		}
+	}
+}
+
+static void SetWatchesArmed(bool armed) {
+	for (u32 page : watchedPageList)
+		SetWatchedPageArmed(page, armed);
+}
+
+#if (PPSSPP_ARCH(X86) || PPSSPP_ARCH(AMD64)) && ((defined(_WIN32) && !PPSSPP_PLATFORM(UWP)) || (defined(__linux__) && !PPSSPP_PLATFORM(ANDROID)))
+#define MEMMAP_WATCH_PAGES
+// EFLAGS.TF, which traps after the next instruction.
+static const uint32_t TRAP_FLAG = 0x100;
+
+// Per thread, in case something else (like the GPU thread) touches a watched page at the same time.
+static __THREAD bool watchStepping = false;
+static __THREAD bool watchNotifyStep = false;
+
+// Returns true if the access should be single stepped with the page open.
+static bool HandleWatchFault(uintptr_t hostAddress, const u8 *hostPC) {
+	if (!watchingPages)
+		return false;
+
+	for (const TrackedView &view : watchedViews) {
+		uintptr_t offset = hostAddress - (uintptr_t)view.ptr;
+		if (offset >= view.size)
+			continue;
+		const u32 index = (u32)(offset / trackedPageSize);
+		if (watchedPages[view.firstPage + index] == WATCH_NONE)
+			return false;
+
+		// An unaligned access may fault again on the next page, that's still the same access.
+		if (!watchStepping) {
+			watchNotifyStep = false;
+			if (watchHitFunc) {
+				// The callback may need to read watched memory itself.
+				SetWatchesArmed(false);
+				watchNotifyStep = watchHitFunc(view.address + (u32)offset, hostPC, false);
+				SetWatchesArmed(true);
+			}
+			watchStepping = true;
+		}
+		// Only this view, so other threads still fault on the mirrors meanwhile.
+		ProtectMemoryPages(view.ptr + index * trackedPageSize, trackedPageSize, MEM_PROT_READ | MEM_PROT_WRITE);
+		return true;
+	}
+	return false;
+}
+
+static bool HandleWatchStep() {
+	if (!watchStepping)
+		return false;
+	watchStepping = false;
+	if (watchNotifyStep && watchHitFunc) {
+		SetWatchesArmed(false);
+		watchHitFunc(0, nullptr, true);
+	}
+	if (watchingPages)
+		SetWatchesArmed(true);
+	return true;
+}
+#endif
+
+#if PPSSPP_PLATFORM(UWP)
+static bool InstallFaultHandler() {
+	return false;
+}
+#elif defined(_WIN32)
+static LONG NTAPI MemoryFaultExceptionHandler(PEXCEPTION_POINTERS info) {
+	const EXCEPTION_RECORD *record = info->ExceptionRecord;
+	// ExceptionInformation[0] is 1 for a write, and [1] is the address.
+	if (record->ExceptionCode == EXCEPTION_ACCESS_VIOLATION && record->NumberParameters >= 2) {
+		if (record->ExceptionInformation[0] == 1 && HandleWriteTrackingFault((uintptr_t)record->ExceptionInformation[1]))
+			return EXCEPTION_CONTINUE_EXECUTION;
+#ifdef MEMMAP_WATCH_PAGES
+#if PPSSPP_ARCH(AMD64)
+		const u8 *hostPC = (const u8 *)info->ContextRecord->Rip;
+#else
+		const u8 *hostPC = (const u8 *)info->ContextRecord->Eip;
+#endif
+		if (HandleWatchFault((uintptr_t)record->ExceptionInformation[1], hostPC)) {
+			info->ContextRecord->EFlags |= TRAP_FLAG;
+			return EXCEPTION_CONTINUE_EXECUTION;
+		}
+#endif
+	}
+#ifdef MEMMAP_WATCH_PAGES
+	if (record->ExceptionCode == EXCEPTION_SINGLE_STEP && HandleWatchStep()) {
+		info->ContextRecord->EFlags &= ~TRAP_FLAG;
+		return EXCEPTION_CONTINUE_EXECUTION;
+	}
+#endif
+	return EXCEPTION_CONTINUE_SEARCH;
+}
+
+static bool InstallFaultHandler() {
+	static bool installed = false;
+	if (!installed)
+		installed = AddVectoredExceptionHandler(1, &MemoryFaultExceptionHandler) != nullptr;
+	return installed;
+}
+#else
+static struct sigaction prevSegvAction;
+static struct sigaction prevBusAction;
+#ifdef MEMMAP_WATCH_PAGES
+static struct sigaction prevTrapAction;
+#if PPSSPP_ARCH(AMD64)
+#define CONTEXT_PC REG_RIP
+#else
+#define CONTEXT_PC REG_EIP
+#endif
+#endif
+
+static void ChainSignal(const struct sigaction &prev, int sig, siginfo_t *info, void *context) {
+	if (prev.sa_flags & SA_SIGINFO) {
+		prev.sa_sigaction(sig, info, context);
+	} else if (prev.sa_handler == SIG_DFL || prev.sa_handler == SIG_IGN) {
+		// Not ours.  Returning will fault again, and crash as it should.
+		signal(sig, SIG_DFL);
+	} else {
+		prev.sa_handler(sig);
+	}
+}
+
+static void MemoryFaultSignalHandler(int sig, siginfo_t *info, void *context) {
+	if (HandleWriteTrackingFault((uintptr_t)info->si_addr))
+		return;
+#ifdef MEMMAP_WATCH_PAGES
+	ucontext_t *uc = (ucontext_t *)context;
+	if (HandleWatchFault((uintptr_t)info->si_addr, (const u8 *)uc->uc_mcontext.gregs[CONTEXT_PC])) {
+		uc->uc_mcontext.gregs[REG_EFL] |= TRAP_FLAG;
+		return;
+	}
+#endif
+
+	ChainSignal(sig == SIGBUS ? prevBusAction : prevSegvAction, sig, info, context);
+}
+
+#ifdef MEMMAP_WATCH_PAGES
+static void WatchStepSignalHandler(int sig, siginfo_t *info, void *context) {
+	if (HandleWatchStep()) {
+		ucontext_t *uc = (ucontext_t *)context;
+		uc->uc_mcontext.gregs[REG_EFL] &= ~TRAP_FLAG;
+		return;
+	}
+	ChainSignal(prevTrapAction, sig, info, context);
+}
+#endif
+
+static bool InstallFaultHandler() {
+	// Installed once and left in place, so other handlers can chain to or from it safely.
+	static bool installed = false;
+	if (!installed) {
+		struct sigaction action;
+		memset(&action, 0, sizeof(action));
+		action.sa_sigaction = &MemoryFaultSignalHandler;
+		action.sa_flags = SA_SIGINFO;
+		sigemptyset(&action.sa_mask);
+		installed = sigaction(SIGSEGV, &action, &prevSegvAction) == 0 && sigaction(SIGBUS, &action, &prevBusAction) == 0;
+#ifdef MEMMAP_WATCH_PAGES
+		action.sa_sigaction = &WatchStepSignalHandler;
+		installed = installed && sigaction(SIGTRAP, &action, &prevTrapAction) == 0;
+#endif
+	}
+	return installed;
+}
+#endif
+
+bool StartWriteTracking() {
+	if (trackingWrites)
+		return true;
+	// Both want the same pages protected differently.
+	if (watchingPages || !base || !InstallFaultHandler())
+		return false;
+	if (!BuildTrackedViews(trackedViews))
+		return false;
+
+	{
+		TrackingLockGuard guard;
+		writtenPages.assign(WriteTrackingPageCount(), 1);
+		armedPages.assign(WriteTrackingPageCount(), 0);
+		pageWriteStamps.assign(WriteTrackingPageCount(), 0);
+		trackingSuspended = true;
+		trackingWrites = true;
+	}
+	ResumeWriteTracking();
+	return true;
+}
+
+void StopWriteTracking() {
+	if (!trackingWrites)
+		return;
+	SuspendWriteTracking();
+	TrackingLockGuard guard;
+	trackingWrites = false;
+	trackingSuspended = false;
+	trackedViews.clear();
+	writtenPages.clear();
+	armedPages.clear();
+	pageWriteStamps.clear();
+}
+
+bool IsTrackingWrites() {
+	return trackingWrites;
+}
+
+void SuspendWriteTracking() {
+	TrackingLockGuard guard;
+	if (!trackingWrites || trackingSuspended)
+		return;
+	trackingSuspended = true;
+	for (const TrackedView &view : trackedViews) {
+		ProtectMemoryPages(view.ptr, view.size, MEM_PROT_READ | MEM_PROT_WRITE);
+	}
+	std::fill(armedPages.begin(), armedPages.end(), 0);
+}
+
+void ResumeWriteTracking() {
+	TrackingLockGuard guard;
+	if (!trackingWrites || !trackingSuspended)
+		return;
+	trackingSuspended = false;
+	// Nothing was tracked while suspended.
+	bulkWriteStamp = ++writeStamp;
+	// Protect each run of unwritten pages with one call, usually that's most of the view.
+	for (const TrackedView &view : trackedViews) {
+		const u32 count = view.size / trackedPageSize;
+		u32 runStart = 0;
+		for (u32 i = 0; i <= count; ++i) {
+			if (i < count && !writtenPages[view.firstPage + i])
+				continue;
+			if (i > runStart)
+				ProtectMemoryPages(view.ptr + runStart * trackedPageSize, (i - runStart) * trackedPageSize, MEM_PROT_READ);
+			runStart = i + 1;
+		}
+	}
+	for (size_t page = 0; page < writtenPages.size(); ++page) {
+		armedPages[page] = writtenPages[page] ? 0 : 1;
+	}
+}
+
+u32 WriteTrackingPageSize() {
+	return trackedPageSize;
+}
+
+u32 WriteTrackingPageCount() {
+	return trackedScratchPages + trackedVRAMPages + g_MemorySize / trackedPageSize;
+}
+
+u8 *WriteTrackingPagePointer(u32 page) {
+	if (page < trackedScratchPages)
+		return m_pPhysicalScratchPad + page * trackedPageSize;
+	page -= trackedScratchPages;
+	if (page < trackedVRAMPages)
+		return m_pPhysicalVRAM1 + page * trackedPageSize;
+	page -= trackedVRAMPages;
+	return GetPointerUnchecked(PSP_GetKernelMemoryBase()) + page * trackedPageSize;
+}
+
+u32 WriteTrackingPageAddress(u32 page) {
+	if (page < trackedScratchPages)
+		return PSP_GetScratchpadMemoryBase() + page * trackedPageSize;
+	page -= trackedScratchPages;
+	if (page < trackedVRAMPages)
+		return PSP_GetVidMemBase() + page * trackedPageSize;
+	page -= trackedVRAMPages;
+	return PSP_GetKernelMemoryBase() + page * trackedPageSize;
+}
+
+void GetWrittenPages(std::vector<u32> &pages) {
+	pages.clear();
+	for (u32 i = 0; i < (u32)writtenPages.size(); ++i) {
+		if (writtenPages[i])
+			pages.push_back(i);
+	}
+}
+
+void ClearWrittenPages() {
+	_dbg_assert_msg_(MEMMAP, trackingSuspended, "Clearing written pages while tracking is active");
+	std::fill(writtenPages.begin(), writtenPages.end(), 0);
+}
+
+void MarkPageWritten(u32 page) {
+	if (page < writtenPages.size())
+		writtenPages[page] = 1;
+}
+
+// Both ends must land in the same run of pages, or the range isn't tracked.
+static bool TrackedPagesFromRange(u32 address, u32 size, u32 *first, u32 *last) {
+	if (size == 0 || !TrackedPageFromAddress(address, first) || !TrackedPageFromAddress(address + size - 1, last))
+		return false;
+	const u32 physAddress = address & 0x3FFFFFFF;
+	return *last >= *first && *last - *first == (physAddress + size - 1) / trackedPageSize - physAddress / trackedPageSize;
+}
+
+u32 ArmWriteTrackingRange(u32 address, u32 size) {
+	if (!trackingWrites)
+		return 0;
+
+	TrackingLockGuard guard;
+	u32 first, last;
+	if (!trackingWrites || trackingSuspended || !TrackedPagesFromRange(address, size, &first, &last))
+		return 0;
+	// Any write after this either faults with a newer stamp, or lands before the caller reads the memory.
+	const u32 stamp = writeStamp;
+	for (u32 page = first; page <= last; ++page) {
+		if (!armedPages[page]) {
+			armedPages[page] = 1;
+			SetTrackedPageWritable(page, false);
+		}
+	}
+	return stamp;
+}
+
+bool RangeWrittenSince(u32 address, u32 size, u32 stamp) {
+	if (stamp == 0 || !trackingWrites)
+		return true;
+
+	TrackingLockGuard guard;
+	u32 first, last;
+	if (!trackingWrites || trackingSuspended || stamp < bulkWriteStamp || !TrackedPagesFromRange(address, size, &first, &last))
+		return true;
+	for (u32 page = first; page <= last; ++page) {
+		if (pageWriteStamps[page] > stamp || !armedPages[page])
+			return true;
+	}
+	return false;
+}
+
+// Calls func(page) for every watched page that the host range touches.
+template <typename F>
+static void ForEachWatchedHostPage(const void *ptr, size_t size, F func) {
+	for (const TrackedView &view : watchedViews) {
+		uintptr_t start = (uintptr_t)ptr - (uintptr_t)view.ptr;
+		if (start >= view.size)
+			continue;
+		uintptr_t end = std::min(start + size, (uintptr_t)view.size);
+		for (u32 i = (u32)(start / trackedPageSize); i < (end + trackedPageSize - 1) / trackedPageSize; ++i) {
+			if (watchedPages[view.firstPage + i] != WATCH_NONE)
+				func(view.firstPage + i);
+		}
+	}
+}
+
+void PrepareHostWrite(const void *ptr, size_t size) {
+	if (watchingPages && size != 0) {
+		// HLE reports its own memchecks, so just let these through.
+		ForEachWatchedHostPage(ptr, size, [](u32 page) { SetWatchedPageArmed(page, false); });
+	}
+	if (!trackingWrites || trackingSuspended || size == 0)
+		return;
+
+	TrackingLockGuard guard;
+	if (!trackingWrites || trackingSuspended)
+		return;
+	for (const TrackedView &view : trackedViews) {
+		uintptr_t start = (uintptr_t)ptr - (uintptr_t)view.ptr;
+		if (start >= view.size)
+			continue;
+		uintptr_t end = std::min(start + size, (uintptr_t)view.size);
+		for (u32 i = (u32)(start / trackedPageSize); i < (end + trackedPageSize - 1) / trackedPageSize; ++i) {
+			MarkTrackedPageWritten(view.firstPage + i);
+		}
+	}
+}
+
+void FinishHostWrite(const void *ptr, size_t size) {
+	if (watchingPages && size != 0) {
+		ForEachWatchedHostPage(ptr, size, [](u32 page) { SetWatchedPageArmed(page, true); });
+	}
+}
+
+bool SetWatchedRanges(const std::vector<WatchRange> &ranges) {
+	ClearWatchedRanges();
+	if (ranges.empty())
+		return true;
+#ifdef MEMMAP_WATCH_PAGES
+	if (!base || !InstallFaultHandler())
+		return false;
+	// Rewind would take the faults for itself, and re-protect pages behind our back.
+	StopWriteTracking();
+	if (!BuildTrackedViews(watchedViews))
+		return false;
+
+	watchedPages.assign(WriteTrackingPageCount(), WATCH_NONE);
+	for (const WatchRange &range : ranges) {
+		// The range is inclusive of start, and exclusive of end.
+		const u32 last = range.end > range.start ? range.end - 1 : range.start;
+		for (u32 address = range.start & ~(trackedPageSize - 1); address <= last; address += trackedPageSize) {
+			u32 page;
+			if (TrackedPageFromAddress(address, &page))
+				watchedPages[page] = std::max(watchedPages[page], range.reads ? (u8)WATCH_ACCESS : (u8)WATCH_WRITES);
+			if (address + trackedPageSize < address)
+				break;
+		}
+	}
+	for (u32 page = 0; page < (u32)watchedPages.size(); ++page) {
+		if (watchedPages[page] != WATCH_NONE)
+			watchedPageList.push_back(page);
+	}
+
+	watchingPages = true;
+	SetWatchesArmed(true);
+	return true;
+#else
+	return false;
+#endif
+}
+
+void ClearWatchedRanges() {
+	if (!watchingPages)
+		return;
+	SetWatchesArmed(false);
+	watchingPages = false;
+	watchedViews.clear();
+	watchedPages.clear();
+	watchedPageList.clear();
+}
+
+bool IsWatchingPages() {
+	return watchingPages;
+}
+
+void SetWatchHitFunc(WatchHitFunc func) {
+	watchHitFunc = func;
+}
+
 // Wanting to avoid include pollution, MemMap.h is included a lot.
 MemoryInitedLock::MemoryInitedLock()
 {
@@ -451,4 +1032,51 @@ void Memset(const u32 _Address, const u8 _iValue, const u32 _iLength) {
 #endif
 }
 
+void CopyBlocks16(u8 *dst, const u8 *src, u32 bytes) {
+	const u32 blocks = bytes & ~0x0f;
+	// Each block must be fully read before it's written, and no sooner, or overlaps change.
+	for (u32 offset = 0; offset < blocks; offset += 0x10) {
+#if defined(_M_SSE)
+		_mm_storeu_si128((__m128i *)(dst + offset), _mm_loadu_si128((const __m128i *)(src + offset)));
+#elif PPSSPP_ARCH(ARM_NEON)
+		vst1q_u8(dst + offset, vld1q_u8(src + offset));
+#else
+		u8 temp[16];
+		memcpy(temp, src + offset, 16);
+		memcpy(dst + offset, temp, 16);
+#endif
+	}
+	for (u32 offset = blocks; offset < bytes; ++offset) {
+		dst[offset] = src[offset];
+	}
+}
+
+void CopySwizzled(u8 *dst, const u8 *src, u32 pitch, u32 height) {
+	// Each tile is 8 rows of one 16 byte column.  Load all 8 rows, then store them together.
+	for (u32 y = 0; y < height; y += 8) {
+		const u8 *xsrc = src;
+		for (u32 x = 0; x < pitch; x += 16) {
+#if defined(_M_SSE)
+			__m128i rows[8];
+			for (int n = 0; n < 8; ++n)
+				rows[n] = _mm_loadu_si128((const __m128i *)(xsrc + n * pitch));
+			for (int n = 0; n < 8; ++n)
+				_mm_storeu_si128((__m128i *)(dst + n * 16), rows[n]);
+#elif PPSSPP_ARCH(ARM_NEON)
+			uint8x16_t rows[8];
+			for (int n = 0; n < 8; ++n)
+				rows[n] = vld1q_u8(xsrc + n * pitch);
+			for (int n = 0; n < 8; ++n)
+				vst1q_u8(dst + n * 16, rows[n]);
+#else
+			for (int n = 0; n < 8; ++n)
+				memcpy(dst + n * 16, xsrc + n * pitch, 16);
+#endif
+			dst += 128;
+			xsrc += 16;
+		}
+		src += 8 * pitch;
+	}
+}
+
 } // namespace
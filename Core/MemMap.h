@@ -19,7 +19,9 @@
 
 #include "ppsspp_config.h"
 
+#include <cstdint>
 #include <cstring>
+#include <vector>
 #ifndef offsetof
 #include <stddef.h>
 #endif
@@ -133,6 +135,58 @@ void Clear();
 // False when shutdown has already been called.
 bool IsActive();
 
+// Write tracking, so rewind can save only the pages written since its last snapshot,
+// and caches can skip rehashing memory that hasn't been written.
+// Scratchpad, VRAM, and RAM are numbered as one run of pages, in that order.
+// Writes fault once per page (on every mirror) and then run at full speed until re-armed.
+// Tracking starts with every page counted as written, so whoever didn't start it stays correct.
+bool StartWriteTracking();
+void StopWriteTracking();
+bool IsTrackingWrites();
+// Makes all pages writable (without counting anything as written) until resumed.
+// The emuhack dance for savestates would otherwise dirty every page with code.
+void SuspendWriteTracking();
+// Write protects every page not marked as written.
+void ResumeWriteTracking();
+u32 WriteTrackingPageSize();
+u32 WriteTrackingPageCount();
+u8 *WriteTrackingPagePointer(u32 page);
+u32 WriteTrackingPageAddress(u32 page);
+void GetWrittenPages(std::vector<u32> &pages);
+// Only while suspended, so the new state applies on resume.
+void ClearWrittenPages();
+void MarkPageWritten(u32 page);
+// Protects the pages of a range again, and returns a stamp to pass to RangeWrittenSince() later.
+// Returns 0 (always written) if the range can't be tracked.
+u32 ArmWriteTrackingRange(u32 address, u32 size);
+// Also true if tracking was stopped or suspended since, which misses writes.
+bool RangeWrittenSince(u32 address, u32 size, u32 stamp);
+// The host kernel won't fault on our behalf (read() just fails), so file and socket reads directly
+// into PSP memory must call this first.
+void PrepareHostWrite(const void *ptr, size_t size);
+// Re-arms watched pages after PrepareHostWrite(), once the host write is done.
+void FinishHostWrite(const void *ptr, size_t size);
+// For other fault handlers that share the signal.  True if the fault was handled.
+bool HandleWriteTrackingFault(uintptr_t hostAddress);
+
+// Watched pages, so the debugger can catch memchecks without the jit checking every access.
+// Accesses to a watched page fault, are reported, then single stepped with the page open.
+// Only on x86/x64 Windows and Linux, and never at the same time as write tracking.
+struct WatchRange {
+	u32 start;
+	u32 end;
+	// Otherwise only writes fault.
+	bool reads;
+};
+// Called on the faulting thread: first before the access, then (only if that returned true)
+// with completed = true after it.  Everything watched is readable during the call.
+typedef bool (*WatchHitFunc)(u32 address, const u8 *hostPC, bool completed);
+// False if pages can't be watched here (and nothing is.)  Stops write tracking.
+bool SetWatchedRanges(const std::vector<WatchRange> &ranges);
+void ClearWatchedRanges();
+bool IsWatchingPages();
+void SetWatchHitFunc(WatchHitFunc func);
+
 class MemoryInitedLock {
 public:
 	MemoryInitedLock();
@@ -62,6 +62,12 @@ inline void Memcpy(const u32 to_address, const u32 from_address, const u32 len)
 
 void Memset(const u32 _Address, const u8 _Data, const u32 _iLength);
 
+// Bulk copies for HLE replacements, on host pointers the caller already checked.
+// Copies forward 16 bytes at a time, so overlapping copies come out like the PSP's block copy loops.
+void CopyBlocks16(u8 *dst, const u8 *src, u32 bytes);
+// Rearranges a linear image (pitch bytes per row) into 16x8 byte tiles, like memcpy_swizzled.
+void CopySwizzled(u8 *dst, const u8 *src, u32 pitch, u32 height);
+
 template<class T>
 void ReadStruct(u32 address, T *ptr)
 {
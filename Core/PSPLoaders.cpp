@@ -91,6 +91,10 @@ void InitMemoryForGameISO(FileLoader *fileLoader) {
 			return;
 
 		ISOFileSystem *iso = new ISOFileSystem(&pspFileSystem, bd);
+		if (g_Config.bLearnedReadAhead)
+			iso->EnableReadAheadHistory();
+		if (g_Config.bCacheISODirectories)
+			iso->EnableDirectoryCache();
 		fileSystem = iso;
 		blockSystem = new ISOBlockSystem(iso);
 	}
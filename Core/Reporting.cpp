@@ -22,6 +22,7 @@
 #include "Core/Reporting.h"
 
 #include "Common/CPUDetect.h"
+#include "Common/FileUtil.h"
 #include "Core/Core.h"
 #include "Core/CoreTiming.h"
 #include "Core/Config.h"
@@ -92,11 +93,81 @@ namespace Reporting
 	static std::string crcFilename;
 	static std::map<std::string, u32> crcResults;
 
+	// Hashing a whole disc takes a while, so results are kept on disk and reused
+	// as long as the file's size and modification time haven't changed.
+	struct CRCCacheEntry {
+		u64 size;
+		u64 mtime;
+		u32 crc;
+	};
+	static std::map<std::string, CRCCacheEntry> crcDiskCache;
+	static bool crcDiskCacheLoaded = false;
+
+	static std::string CRCCacheFilename() {
+		return GetSysDirectory(DIRECTORY_SYSTEM) + "crc_cache.txt";
+	}
+
+	// Call with crcLock held.
+	static void LoadCRCCache() {
+		if (crcDiskCacheLoaded)
+			return;
+		crcDiskCacheLoaded = true;
+
+		FILE *f = File::OpenCFile(CRCCacheFilename(), "rb");
+		if (!f)
+			return;
+		char line[2048];
+		while (fgets(line, sizeof(line), f)) {
+			CRCCacheEntry entry;
+			unsigned long long size, mtime;
+			int pathOffset = 0;
+			if (sscanf(line, "%08x %llu %llu %n", &entry.crc, &size, &mtime, &pathOffset) < 3 || pathOffset == 0)
+				continue;
+			std::string path = line + pathOffset;
+			while (!path.empty() && (path.back() == '\n' || path.back() == '\r'))
+				path.pop_back();
+			entry.size = size;
+			entry.mtime = mtime;
+			if (!path.empty())
+				crcDiskCache[path] = entry;
+		}
+		fclose(f);
+	}
+
+	// Call with crcLock held.
+	static void SaveCRCCache() {
+		FILE *f = File::OpenCFile(CRCCacheFilename(), "wb");
+		if (!f)
+			return;
+		for (const auto &it : crcDiskCache) {
+			fprintf(f, "%08x %llu %llu %s\n", it.second.crc, (unsigned long long)it.second.size, (unsigned long long)it.second.mtime, it.first.c_str());
+		}
+		fclose(f);
+	}
+
 	static int CalculateCRCThread() {
 		setCurrentThreadName("ReportCRC");
+		// This reads the entire disc, try not to slow down the game's own reads.
+		setCurrentThreadBackgroundIO();
+
+		std::string filename;
+		File::FileDetails details{};
+		bool cacheable;
+		{
+			std::lock_guard<std::mutex> guard(crcLock);
+			filename = crcFilename;
+			LoadCRCCache();
+			cacheable = File::GetFileDetails(filename, &details) && !details.isDirectory;
+			auto cached = crcDiskCache.find(filename);
+			if (cacheable && cached != crcDiskCache.end() && cached->second.size == details.size && cached->second.mtime == details.mtime) {
+				crcResults[filename] = cached->second.crc;
+				crcCond.notify_all();
+				return 0;
+			}
+		}
 
 		// TODO: Use the blockDevice from pspFileSystem?
-		FileLoader *fileLoader = ConstructFileLoader(crcFilename);
+		FileLoader *fileLoader = ConstructFileLoader(filename);
 		BlockDevice *blockDevice = constructBlockDevice(fileLoader);
 
 		u32 crc = 0;
@@ -108,16 +179,19 @@ namespace Reporting
 		delete fileLoader;
 
 		std::lock_guard<std::mutex> guard(crcLock);
-		crcResults[crcFilename] = crc;
-		crcCond.notify_one();
+		crcResults[filename] = crc;
+		if (cacheable && crc != 0) {
+			crcDiskCache[filename] = CRCCacheEntry{ details.size, details.mtime, crc };
+			SaveCRCCache();
+		}
+		crcCond.notify_all();
 
 		return 0;
 	}
 
-	void QueueCRC() {
+	void QueueCRC(const std::string &gamePath) {
 		std::lock_guard<std::mutex> guard(crcLock);
 
-		const std::string &gamePath = PSP_CoreParameter().fileToStart;
 		auto it = crcResults.find(gamePath);
 		if (it != crcResults.end()) {
 			// Nothing to do, we've already calculated it.
@@ -135,9 +209,8 @@ namespace Reporting
 		th.detach();
 	}
 
-	u32 RetrieveCRC() {
-		const std::string &gamePath = PSP_CoreParameter().fileToStart;
-		QueueCRC();
+	u32 RetrieveCRC(const std::string &gamePath) {
+		QueueCRC(gamePath);
 
 		std::unique_lock<std::mutex> guard(crcLock);
 		auto it = crcResults.find(gamePath);
@@ -422,7 +495,7 @@ namespace Reporting
 			postdata.Add("graphics", StringFromFormat("%d", payload.int1));
 			postdata.Add("speed", StringFromFormat("%d", payload.int2));
 			postdata.Add("gameplay", StringFromFormat("%d", payload.int3));
-			postdata.Add("crc", StringFromFormat("%08x", Core_GetPowerSaving() ? 0 : RetrieveCRC()));
+			postdata.Add("crc", StringFromFormat("%08x", Core_GetPowerSaving() ? 0 : RetrieveCRC(PSP_CoreParameter().fileToStart)));
 			AddScreenshotData(postdata, payload.string2);
 			payload.string1.clear();
 			payload.string2.clear();
@@ -91,4 +91,10 @@ namespace Reporting
 
 	// Return the current game id.
 	std::string CurrentGameID();
+
+	// Starts hashing a disc image in the background, unless it's already known or in progress.
+	void QueueCRC(const std::string &gamePath);
+	// Waits for and returns the CRC32 of a disc image, using the on-disk cache when the file is unchanged.
+	// Can be used to identify a game by its contents, not just by its disc ID.
+	u32 RetrieveCRC(const std::string &gamePath);
 }
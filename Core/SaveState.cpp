@@ -16,6 +16,8 @@
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
 #include <algorithm>
+#include <condition_variable>
+#include <deque>
 #include <vector>
 #include <thread>
 #include <mutex>
@@ -26,6 +28,7 @@
 
 #include "Common/FileUtil.h"
 #include "Common/ChunkFile.h"
+#include "Common/ThreadPools.h"
 
 #include "Core/SaveState.h"
 #include "Core/Config.h"
@@ -38,6 +41,8 @@
 #include "Core/ELF/ParamSFO.h"
 #include "Core/HLE/HLE.h"
 #include "Core/HLE/sceDisplay.h"
+#include "Core/HLE/sceDmac.h"
+#include "Core/HLE/sceDeflt.h"
 #include "Core/HLE/ReplaceTables.h"
 #include "Core/HLE/sceKernel.h"
 #include "Core/MemMap.h"
@@ -56,6 +61,9 @@ namespace SaveState
 	struct SaveStart
 	{
 		void DoState(PointerWrap &p);
+
+		// Write tracked rewind states keep memory contents separately.
+		bool includeMemory = true;
 	};
 
 	enum OperationType
@@ -80,31 +88,50 @@ namespace SaveState
 		void *cbUserData;
 	};
 
-	CChunkFileReader::Error SaveToRam(std::vector<u8> &data) {
+	static CChunkFileReader::Error SaveToRam(std::vector<u8> &data, bool includeMemory) {
 		SaveStart state;
+		state.includeMemory = includeMemory;
 		size_t sz = CChunkFileReader::MeasurePtr(state);
 		if (data.size() < sz)
 			data.resize(sz);
 		return CChunkFileReader::SavePtr(&data[0], state);
 	}
 
-	CChunkFileReader::Error LoadFromRam(std::vector<u8> &data) {
+	static CChunkFileReader::Error LoadFromRam(std::vector<u8> &data, bool includeMemory) {
 		SaveStart state;
+		state.includeMemory = includeMemory;
 		return CChunkFileReader::LoadPtr(&data[0], state);
 	}
 
+	CChunkFileReader::Error SaveToRam(std::vector<u8> &data) {
+		return SaveToRam(data, true);
+	}
+
+	CChunkFileReader::Error LoadFromRam(std::vector<u8> &data) {
+		return LoadFromRam(data, true);
+	}
+
+	// Run-ahead owns memory write tracking while it's on, so tracked rewind states step aside.
+	static bool runAheadActive = false;
+
 	struct StateRingbuffer
 	{
-		StateRingbuffer(int size) : first_(0), next_(0), size_(size), base_(-1)
+		StateRingbuffer(int size) : first_(0), next_(0), size_(size), base_(-1), tracked_(false)
 		{
 			states_.resize(size);
 			baseMapping_.resize(size);
+			undo_.resize(size);
 		}
 
 		CChunkFileReader::Error Save()
 		{
 			std::lock_guard<std::mutex> guard(lock_);
 
+			if (g_Config.bRewindWriteTracking && !runAheadActive && ((tracked_ && Memory::IsTrackingWrites()) || LockedStartTracking()))
+				return LockedSaveTracked();
+			if (tracked_)
+				LockedStopTracking();
+
 			int n = next_++ % size_;
 			if ((next_ % size_) == first_)
 				++first_;
@@ -136,6 +163,9 @@ namespace SaveState
 		{
 			std::lock_guard<std::mutex> guard(lock_);
 
+			if (tracked_)
+				return LockedRestoreTracked();
+
 			// No valid states left.
 			if (Empty())
 				return CChunkFileReader::ERROR_BAD_FILE;
@@ -149,6 +179,131 @@ namespace SaveState
 			return LoadFromRam(buffer);
 		}
 
+		bool LockedStartTracking()
+		{
+			// Any states we have don't fit the new scheme, start over.
+			first_ = 0;
+			next_ = 0;
+			if (!Memory::StartWriteTracking()) {
+				tracked_ = false;
+				return false;
+			}
+
+			// The shadow starts out empty, so count everything as written.
+			Memory::SuspendWriteTracking();
+			LockedMarkAllWritten();
+			Memory::ResumeWriteTracking();
+			shadow_.resize(Memory::WriteTrackingPageCount() * Memory::WriteTrackingPageSize());
+			tracked_ = true;
+			return true;
+		}
+
+		void LockedStopTracking()
+		{
+			first_ = 0;
+			next_ = 0;
+			tracked_ = false;
+			Memory::StopWriteTracking();
+			StateBuffer().swap(shadow_);
+		}
+
+		void LockedMarkAllWritten()
+		{
+			const u32 count = Memory::WriteTrackingPageCount();
+			for (u32 page = 0; page < count; ++page)
+				Memory::MarkPageWritten(page);
+		}
+
+		// The shadow holds memory as of the newest state, so only written pages need copying.
+		// Each state keeps the shadow's previous contents of those pages, to step back on restore.
+		CChunkFileReader::Error LockedSaveTracked()
+		{
+			// The oldest state never needs to step back further.
+			const bool needUndo = !Empty();
+			int n = next_++ % size_;
+			if ((next_ % size_) == first_)
+				++first_;
+
+			CChunkFileReader::Error err = SaveToRam(states_[n], false);
+			if (err != CChunkFileReader::ERROR_NONE)
+				states_[n].clear();
+
+			const u32 pageSize = Memory::WriteTrackingPageSize();
+			PageUndo &undo = undo_[n];
+			undo.pages.clear();
+			undo.data.clear();
+
+			// Memory must be clean of emuhacks, same as a regular savestate.
+			Memory::SuspendWriteTracking();
+			auto savedReplacements = SaveAndClearReplacements();
+			std::vector<u32> savedBlocks;
+			if (MIPSComp::jit)
+				savedBlocks = MIPSComp::jit->SaveAndClearEmuHackOps();
+
+			Memory::GetWrittenPages(written_);
+			if (needUndo) {
+				undo.pages = written_;
+				undo.data.resize(written_.size() * pageSize);
+			}
+			for (size_t i = 0; i < written_.size(); ++i) {
+				u8 *shadowPage = &shadow_[written_[i] * pageSize];
+				if (needUndo)
+					memcpy(&undo.data[i * pageSize], shadowPage, pageSize);
+				memcpy(shadowPage, Memory::WriteTrackingPagePointer(written_[i]), pageSize);
+			}
+
+			if (MIPSComp::jit)
+				MIPSComp::jit->RestoreSavedEmuHackOps(savedBlocks);
+			RestoreSavedReplacements(savedReplacements);
+			Memory::ClearWrittenPages();
+			Memory::ResumeWriteTracking();
+			return err;
+		}
+
+		CChunkFileReader::Error LockedRestoreTracked()
+		{
+			// Memory was reset under us (e.g. by loading a state with a different RAM size.)
+			if (!Memory::IsTrackingWrites()) {
+				LockedStopTracking();
+				return CChunkFileReader::ERROR_BAD_FILE;
+			}
+			if (Empty())
+				return CChunkFileReader::ERROR_BAD_FILE;
+
+			int n = (--next_ + size_) % size_;
+			const u32 pageSize = Memory::WriteTrackingPageSize();
+			CChunkFileReader::Error err = CChunkFileReader::ERROR_BAD_FILE;
+
+			Memory::SuspendWriteTracking();
+			if (!states_[n].empty()) {
+				// Like a regular load, leave memory clean of emuhacks.  The jit is cleared by the load.
+				auto savedReplacements = SaveAndClearReplacements();
+				if (MIPSComp::jit)
+					MIPSComp::jit->SaveAndClearEmuHackOps();
+
+				Memory::GetWrittenPages(written_);
+				for (u32 page : written_)
+					memcpy(Memory::WriteTrackingPagePointer(page), &shadow_[page * pageSize], pageSize);
+				err = LoadFromRam(states_[n], false);
+				RestoreSavedReplacements(savedReplacements);
+				// Memory now matches the shadow.
+				Memory::ClearWrittenPages();
+			}
+
+			// Step the shadow back to the previous state.
+			if (Empty()) {
+				LockedMarkAllWritten();
+			} else {
+				const PageUndo &undo = undo_[n];
+				for (size_t i = 0; i < undo.pages.size(); ++i) {
+					memcpy(&shadow_[undo.pages[i] * pageSize], &undo.data[i * pageSize], pageSize);
+					Memory::MarkPageWritten(undo.pages[i]);
+				}
+			}
+			Memory::ResumeWriteTracking();
+			return err;
+		}
+
 		void ScheduleCompress(std::vector<u8> *result, const std::vector<u8> *state, const std::vector<u8> *base)
 		{
 			auto th = new std::thread([=]{
@@ -165,11 +320,24 @@ namespace SaveState
 			if (first_ == 0 && next_ == 0)
 				return;
 
+			// Comparing is most of the work, so spread that over the thread pool.
+			int blocks = (int)((state.size() + BLOCK_SIZE - 1) / BLOCK_SIZE);
+			std::vector<u8> changed(blocks);
+			GlobalThreadPool::Loop([&](int lower, int upper) {
+				for (int b = lower; b < upper; ++b)
+				{
+					size_t i = (size_t)b * BLOCK_SIZE;
+					int blockSize = std::min(BLOCK_SIZE, (int)(state.size() - i));
+					changed[b] = i + blockSize > base.size() || memcmp(&state[i], &base[i], blockSize) != 0;
+				}
+			}, 0, blocks);
+
 			result.clear();
-			for (size_t i = 0; i < state.size(); i += BLOCK_SIZE)
+			for (int b = 0; b < blocks; ++b)
 			{
+				size_t i = (size_t)b * BLOCK_SIZE;
 				int blockSize = std::min(BLOCK_SIZE, (int)(state.size() - i));
-				if (i + blockSize > base.size() || memcmp(&state[i], &base[i], blockSize) != 0)
+				if (changed[b])
 				{
 					result.push_back(1);
 					result.insert(result.end(), state.begin() + i, state.begin() +i + blockSize);
@@ -210,6 +378,8 @@ namespace SaveState
 			std::lock_guard<std::mutex> guard(lock_);
 			first_ = 0;
 			next_ = 0;
+			if (tracked_)
+				LockedStopTracking();
 		}
 
 		bool Empty() const
@@ -234,6 +404,17 @@ namespace SaveState
 
 		int base_;
 		int baseUsage_;
+
+		struct PageUndo {
+			std::vector<u32> pages;
+			StateBuffer data;
+		};
+
+		// Only used with write tracking.
+		bool tracked_;
+		StateBuffer shadow_;
+		std::vector<PageUndo> undo_;
+		std::vector<u32> written_;
 	};
 
 	static bool needsProcess = false;
@@ -241,6 +422,31 @@ namespace SaveState
 	static std::mutex mutex;
 	static bool hasLoadedState = false;
 
+	// Saves are serialized on the emu thread, then compressed and written out on a worker.
+	struct PendingWrite
+	{
+		PendingWrite(const Operation &o) : op(o), size(0), result(CChunkFileReader::ERROR_NONE)
+		{
+		}
+
+		Operation op;
+		std::string title;
+		std::vector<u8> buffer;
+		size_t size;
+		CChunkFileReader::Error result;
+	};
+
+	static std::mutex writeMutex;
+	static std::condition_variable writeCond;
+	static std::condition_variable writeDoneCond;
+	static std::deque<PendingWrite *> writeQueue;
+	static std::vector<PendingWrite *> finishedWrites;
+	// A state is tens of MB, so keep the last buffer around for the next save.
+	static std::vector<u8> writeBufferPool;
+	static std::thread writeThread;
+	static bool writeThreadStop = false;
+	static bool writing = false;
+
 	// TODO: Should this be configurable?
 	static const int REWIND_NUM_STATES = 20;
 	static StateRingbuffer rewindStates(REWIND_NUM_STATES);
@@ -250,27 +456,167 @@ namespace SaveState
 	const int StateRingbuffer::BLOCK_SIZE = 8192;
 	const int StateRingbuffer::BASE_USAGE_INTERVAL = 15;
 
+	// Run-ahead saves and restores one snapshot every frame.  Like tracked rewind states, memory is
+	// kept in a shadow copy, and only pages written since the last save or restore get copied.
+	struct RunAheadSnapshot
+	{
+		std::vector<u8> state;
+		std::vector<u8> shadow;
+		std::vector<u32> written;
+
+		double saveTime = 0.0;
+		double loadTime = 0.0;
+		int savedPages = 0;
+		int loadedPages = 0;
+	};
+	static RunAheadSnapshot runAhead;
+
+	static void WriteThreadFunc()
+	{
+		setCurrentThreadName("SaveStateWrite");
+
+		std::unique_lock<std::mutex> guard(writeMutex);
+		while (true)
+		{
+			writeCond.wait(guard, [] { return !writeQueue.empty() || writeThreadStop; });
+			// Stopping still drains the queue first.
+			if (writeQueue.empty())
+				break;
+
+			PendingWrite *w = writeQueue.front();
+			writeQueue.pop_front();
+			writing = true;
+			guard.unlock();
+
+			w->result = CChunkFileReader::SaveFile(w->op.filename, w->title, PPSSPP_GIT_VERSION, &w->buffer[0], w->size);
+
+			guard.lock();
+			writing = false;
+			finishedWrites.push_back(w);
+			writeDoneCond.notify_all();
+
+			// Callbacks are run from Process(), on the emu thread.
+			{
+				std::lock_guard<std::mutex> processGuard(mutex);
+				needsProcess = true;
+			}
+			Core_UpdateSingleStep();
+		}
+	}
+
+	static CChunkFileReader::Error QueueWrite(const Operation &op, const std::string &title, SaveStart &state)
+	{
+		PendingWrite *w = new PendingWrite(op);
+		w->title = title;
+		{
+			std::lock_guard<std::mutex> guard(writeMutex);
+			w->buffer.swap(writeBufferPool);
+		}
+
+		w->size = CChunkFileReader::MeasurePtr(state);
+		if (w->buffer.size() < w->size)
+			w->buffer.resize(w->size);
+		CChunkFileReader::Error err = CChunkFileReader::SavePtr(&w->buffer[0], state);
+
+		std::lock_guard<std::mutex> guard(writeMutex);
+		if (err != CChunkFileReader::ERROR_NONE) {
+			writeBufferPool.swap(w->buffer);
+			delete w;
+			return err;
+		}
+
+		if (!writeThread.joinable()) {
+			writeThreadStop = false;
+			writeThread = std::thread(&WriteThreadFunc);
+		}
+		writeQueue.push_back(w);
+		writeCond.notify_one();
+		return CChunkFileReader::ERROR_NONE;
+	}
+
+	static void WaitForPendingWrites()
+	{
+		std::unique_lock<std::mutex> guard(writeMutex);
+		writeDoneCond.wait(guard, [] { return writeQueue.empty() && !writing; });
+	}
+
+	static const char *SaveFailureMessage(I18NCategory *sc)
+	{
+		const char *message = sc->T("Save State Failed", "");
+		if (strlen(message) == 0)
+			message = sc->T("Failed to save state");
+		return message;
+	}
+
+	// Reports finished writes through their callbacks, which also moves slot files into place.
+	static void FinishWrites()
+	{
+		std::vector<PendingWrite *> done;
+		{
+			std::lock_guard<std::mutex> guard(writeMutex);
+			done.swap(finishedWrites);
+		}
+
+		I18NCategory *sc = GetI18NCategory("Screen");
+		for (PendingWrite *w : done)
+		{
+			bool success = w->result == CChunkFileReader::ERROR_NONE;
+			std::string message;
+			if (success) {
+				message = sc->T("Saved State");
+#ifndef MOBILE_DEVICE
+				if (g_Config.bSaveLoadResetsAVdumping) {
+					if (g_Config.bDumpFrames) {
+						AVIDump::Stop();
+						AVIDump::Start(PSP_CoreParameter().renderWidth, PSP_CoreParameter().renderHeight);
+					}
+					if (g_Config.bDumpAudio) {
+						WAVDump::Reset();
+					}
+				}
+#endif
+			} else {
+				ERROR_LOG(SAVESTATE, "Failed to write save state to %s", w->op.filename.c_str());
+				message = SaveFailureMessage(sc);
+			}
+
+			if (w->op.callback)
+				w->op.callback(success, message, w->op.cbUserData);
+
+			std::lock_guard<std::mutex> guard(writeMutex);
+			writeBufferPool.swap(w->buffer);
+			delete w;
+		}
+	}
+
 	void SaveStart::DoState(PointerWrap &p)
 	{
 		auto s = p.Section("SaveStart", 1);
 		if (!s)
 			return;
 
+		// A DMA copy or inflate on its thread has to land before memory is saved or loaded over.
+		__DmacSync();
+		__DefltSync();
+
 		// Gotta do CoreTiming first since we'll restore into it.
 		CoreTiming::DoState(p);
 
 		// Memory is a bit tricky when jit is enabled, since there's emuhacks in it.
-		auto savedReplacements = SaveAndClearReplacements();
-		if (MIPSComp::jit && p.mode == p.MODE_WRITE)
+		if (includeMemory)
 		{
-			std::vector<u32> savedBlocks;
-			savedBlocks = MIPSComp::jit->SaveAndClearEmuHackOps();
-			Memory::DoState(p);
-			MIPSComp::jit->RestoreSavedEmuHackOps(savedBlocks);
+			auto savedReplacements = SaveAndClearReplacements();
+			if (MIPSComp::jit && p.mode == p.MODE_WRITE)
+			{
+				std::vector<u32> savedBlocks;
+				savedBlocks = MIPSComp::jit->SaveAndClearEmuHackOps();
+				Memory::DoState(p);
+				MIPSComp::jit->RestoreSavedEmuHackOps(savedBlocks);
+			}
+			else
+				Memory::DoState(p);
+			RestoreSavedReplacements(savedReplacements);
 		}
-		else
-			Memory::DoState(p);
-		RestoreSavedReplacements(savedReplacements);
 
 		MemoryStick_DoState(p);
 		currentMIPS->DoState(p);
@@ -593,7 +939,8 @@ namespace SaveState
 		// For fast-forwarding, otherwise they may be useless and too close.
 		time_update();
 		float diff = time_now() - rewindLastTime;
-		if (diff < rewindMaxWallFrequency)
+		// Tracked states are cheap enough to take every frame.
+		if (diff < rewindMaxWallFrequency && !g_Config.bRewindWriteTracking)
 			return;
 
 		rewindLastTime = time_now();
@@ -602,6 +949,119 @@ namespace SaveState
 	}
 #endif
 
+	bool SaveRunAhead()
+	{
+		time_update();
+		const double start = time_now_d();
+
+		// Memory may have been reset under us (e.g. by loading a state with a different RAM size.)
+		if (!runAheadActive || !Memory::IsTrackingWrites())
+		{
+			rewindStates.Clear();
+			if (!Memory::StartWriteTracking())
+				return false;
+			runAheadActive = true;
+			runAhead.shadow.resize(Memory::WriteTrackingPageCount() * Memory::WriteTrackingPageSize());
+			// The shadow starts out empty, so count everything as written.
+			Memory::SuspendWriteTracking();
+			const u32 count = Memory::WriteTrackingPageCount();
+			for (u32 page = 0; page < count; ++page)
+				Memory::MarkPageWritten(page);
+		}
+		else
+			Memory::SuspendWriteTracking();
+
+		// The shadow must be clean of emuhacks, restoring it throws out the jit blocks in those pages.
+		const u32 pageSize = Memory::WriteTrackingPageSize();
+		auto savedReplacements = SaveAndClearReplacements();
+		std::vector<u32> savedBlocks;
+		if (MIPSComp::jit)
+			savedBlocks = MIPSComp::jit->SaveAndClearEmuHackOps();
+
+		Memory::GetWrittenPages(runAhead.written);
+		for (u32 page : runAhead.written)
+			memcpy(&runAhead.shadow[page * pageSize], Memory::WriteTrackingPagePointer(page), pageSize);
+
+		if (MIPSComp::jit)
+			MIPSComp::jit->RestoreSavedEmuHackOps(savedBlocks);
+		RestoreSavedReplacements(savedReplacements);
+		Memory::ClearWrittenPages();
+		Memory::ResumeWriteTracking();
+
+		CChunkFileReader::Error err = SaveToRam(runAhead.state, false);
+		if (err != CChunkFileReader::ERROR_NONE)
+		{
+			StopRunAhead();
+			return false;
+		}
+
+		time_update();
+		runAhead.saveTime = time_now_d() - start;
+		runAhead.savedPages = (int)runAhead.written.size();
+		return true;
+	}
+
+	bool LoadRunAhead()
+	{
+		if (!runAheadActive)
+			return false;
+		if (!Memory::IsTrackingWrites())
+		{
+			StopRunAhead();
+			return false;
+		}
+
+		time_update();
+		const double start = time_now_d();
+		const u32 pageSize = Memory::WriteTrackingPageSize();
+
+		Memory::SuspendWriteTracking();
+		Memory::GetWrittenPages(runAhead.written);
+		// The jit stays, so get rid of any blocks (and their emuhacks) in pages we're about to restore.
+		if (MIPSComp::jit)
+		{
+			for (u32 page : runAhead.written)
+				MIPSComp::jit->InvalidateCacheAt(Memory::WriteTrackingPageAddress(page), pageSize);
+		}
+
+		auto savedReplacements = SaveAndClearReplacements();
+		for (u32 page : runAhead.written)
+			memcpy(Memory::WriteTrackingPagePointer(page), &runAhead.shadow[page * pageSize], pageSize);
+		CChunkFileReader::Error err = LoadFromRam(runAhead.state, false);
+		RestoreSavedReplacements(savedReplacements);
+		// Memory now matches the shadow.
+		Memory::ClearWrittenPages();
+		Memory::ResumeWriteTracking();
+
+		time_update();
+		runAhead.loadTime = time_now_d() - start;
+		runAhead.loadedPages = (int)runAhead.written.size();
+		return err == CChunkFileReader::ERROR_NONE;
+	}
+
+	void StopRunAhead()
+	{
+		if (!runAheadActive)
+			return;
+		runAheadActive = false;
+		Memory::StopWriteTracking();
+		std::vector<u8>().swap(runAhead.state);
+		std::vector<u8>().swap(runAhead.shadow);
+	}
+
+	bool IsRunningAhead()
+	{
+		return runAheadActive;
+	}
+
+	void GetRunAheadStats(double *saveTime, double *loadTime, int *savedPages, int *loadedPages)
+	{
+		*saveTime = runAhead.saveTime;
+		*loadTime = runAhead.loadTime;
+		*savedPages = runAhead.savedPages;
+		*loadedPages = runAhead.loadedPages;
+	}
+
 	bool HasLoadedState()
 	{
 		return hasLoadedState;
@@ -609,6 +1069,10 @@ namespace SaveState
 
 	void Process()
 	{
+		// Anything we did now would be rolled back, it can wait for the real frame.
+		if (PSP_CoreParameter().runningAhead)
+			return;
+
 #ifndef MOBILE_DEVICE
 		if (g_Config.iRewindFlipFrequency != 0 && gpuStats.numFlips != 0)
 			CheckRewindState();
@@ -624,6 +1088,8 @@ namespace SaveState
 			return;
 		}
 
+		FinishWrites();
+
 		std::vector<Operation> operations = Flush();
 		SaveStart state;
 
@@ -638,16 +1104,17 @@ namespace SaveState
 
 			I18NCategory *sc = GetI18NCategory("Screen");
 			const char *i18nLoadFailure = sc->T("Load savestate failed", "");
-			const char *i18nSaveFailure = sc->T("Save State Failed", "");
+			const char *i18nSaveFailure = SaveFailureMessage(sc);
 			if (strlen(i18nLoadFailure) == 0)
 				i18nLoadFailure = sc->T("Failed to load state");
-			if (strlen(i18nSaveFailure) == 0)
-				i18nSaveFailure = sc->T("Failed to save state");
 
 			switch (op.type)
 			{
 			case SAVESTATE_LOAD:
 				INFO_LOG(SAVESTATE, "Loading state from %s", op.filename.c_str());
+				// It might be a slot we're still writing (or renaming into place.)
+				WaitForPendingWrites();
+				FinishWrites();
 				result = CChunkFileReader::Load(op.filename, PPSSPP_GIT_VERSION, state, &reason);
 				if (result == CChunkFileReader::ERROR_NONE) {
 					callbackMessage = sc->T("Loaded State");
@@ -684,21 +1151,10 @@ namespace SaveState
 					std::size_t lslash = title.find_last_of("/");
 					title = title.substr(lslash + 1);
 				}
-				result = CChunkFileReader::Save(op.filename, title, PPSSPP_GIT_VERSION, state);
+				result = QueueWrite(op, title, state);
 				if (result == CChunkFileReader::ERROR_NONE) {
-					callbackMessage = sc->T("Saved State");
-					callbackResult = true;
-#ifndef MOBILE_DEVICE
-					if (g_Config.bSaveLoadResetsAVdumping) {
-						if (g_Config.bDumpFrames) {
-							AVIDump::Stop();
-							AVIDump::Start(PSP_CoreParameter().renderWidth, PSP_CoreParameter().renderHeight);
-						}
-						if (g_Config.bDumpAudio) {
-							WAVDump::Reset();
-						}
-					}
-#endif
+					// FinishWrites() calls back once it's on disk.
+					continue;
 				} else if (result == CChunkFileReader::ERROR_BROKEN_STATE) {
 					HandleFailure();
 					callbackMessage = i18nSaveFailure;
@@ -744,7 +1200,8 @@ namespace SaveState
 				break;
 
 			case SAVESTATE_SAVE_SCREENSHOT:
-				callbackResult = TakeGameScreenshot(op.filename.c_str(), ScreenshotFormat::JPG, SCREENSHOT_DISPLAY);
+				// Only a thumbnail, so let the GPU scale it down before reading back, and encode it off thread.
+				callbackResult = QueueGameScreenshot(op.filename.c_str(), ScreenshotFormat::JPG, SCREENSHOT_DISPLAY, 2);
 				if (!callbackResult) {
 					ERROR_LOG(SAVESTATE, "Failed to take a screenshot for the savestate! %s", op.filename.c_str());
 				}
@@ -772,13 +1229,26 @@ namespace SaveState
 
 		std::lock_guard<std::mutex> guard(mutex);
 		rewindStates.Clear();
+		StopRunAhead();
 
 		hasLoadedState = false;
 	}
 
 	void Shutdown()
 	{
+		// Let queued saves finish, so they still get moved into place.
+		{
+			std::lock_guard<std::mutex> guard(writeMutex);
+			writeThreadStop = true;
+			writeCond.notify_one();
+		}
+		if (writeThread.joinable())
+			writeThread.join();
+		FinishWrites();
+		std::vector<u8>().swap(writeBufferPool);
+
 		std::lock_guard<std::mutex> guard(mutex);
 		rewindStates.Clear();
+		StopRunAhead();
 	}
 }
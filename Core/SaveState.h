@@ -76,6 +76,17 @@ namespace SaveState
 	// Returns true if there are rewind snapshots available.
 	bool CanRewind();
 
+	// Run-ahead keeps a single snapshot in RAM, saved after every real frame and loaded once the
+	// frames ahead are done.  Only meant to be called between frames by PSP_RunAheadFrame().
+	// Loading keeps the jit and GPU caches, so it must be done with PSP_CoreParameter().runningAhead set.
+	bool SaveRunAhead();
+	bool LoadRunAhead();
+	// Drops the snapshot, and stops tracking memory writes for it.
+	void StopRunAhead();
+	bool IsRunningAhead();
+	// Times are in seconds, for the last save and load.
+	void GetRunAheadStats(double *saveTime, double *loadTime, int *savedPages, int *loadedPages);
+
 	// Returns true if a savestate has been used during this session.
 	bool HasLoadedState();
 
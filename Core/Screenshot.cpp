@@ -18,6 +18,11 @@
 #include "ppsspp_config.h"
 
 #include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
 #ifdef USING_QT_UI
 #include <QtGui/QImage>
 #else
@@ -25,6 +30,7 @@
 #include "ext/jpge/jpge.h"
 #endif
 
+#include "thread/threadutil.h"
 #include "Common/ColorConv.h"
 #include "Common/FileUtil.h"
 #include "Core/Config.h"
@@ -307,15 +313,28 @@ const u8 *ConvertBufferToScreenshot(const GPUDebugBuffer &buf, bool alpha, u8 *&
 	return temp ? temp : buffer;
 }
 
-bool TakeGameScreenshot(const char *filename, ScreenshotFormat fmt, ScreenshotType type, int *width, int *height, int maxRes) {
+struct PendingScreenshot {
+	std::string filename;
+	ScreenshotFormat fmt;
+	GPUDebugBuffer buf;
+	u32 w;
+	u32 h;
+};
+
+static std::thread screenshotThread;
+static std::mutex screenshotLock;
+static std::condition_variable screenshotCond;
+static std::deque<PendingScreenshot> pendingScreenshots;
+static bool screenshotThreadActive = false;
+
+static bool ReadbackScreenshot(GPUDebugBuffer &buf, ScreenshotType type, int maxRes, u32 &w, u32 &h) {
 	if (!gpuDebug) {
 		ERROR_LOG(SYSTEM, "Can't take screenshots when GPU not running");
 		return false;
 	}
-	GPUDebugBuffer buf;
 	bool success = false;
-	u32 w = (u32)-1;
-	u32 h = (u32)-1;
+	w = (u32)-1;
+	h = (u32)-1;
 
 	if (type == SCREENSHOT_DISPLAY || type == SCREENSHOT_RENDER) {
 		success = gpuDebug->GetCurrentFramebuffer(buf, type == SCREENSHOT_RENDER ? GPU_DBG_FRAMEBUF_RENDER : GPU_DBG_FRAMEBUF_DISPLAY, maxRes);
@@ -331,19 +350,26 @@ bool TakeGameScreenshot(const char *filename, ScreenshotFormat fmt, ScreenshotTy
 		ERROR_LOG(G3D, "Failed to obtain screenshot data.");
 		return false;
 	}
+	return true;
+}
+
+bool TakeGameScreenshot(const char *filename, ScreenshotFormat fmt, ScreenshotType type, int *width, int *height, int maxRes) {
+	GPUDebugBuffer buf;
+	u32 w, h;
+	if (!ReadbackScreenshot(buf, type, maxRes, w, h)) {
+		return false;
+	}
 
 	u8 *flipbuffer = nullptr;
+	const u8 *buffer = ConvertBufferToScreenshot(buf, false, flipbuffer, w, h);
+	bool success = buffer != nullptr;
 	if (success) {
-		const u8 *buffer = ConvertBufferToScreenshot(buf, false, flipbuffer, w, h);
-		success = buffer != nullptr;
-		if (success) {
-			if (width)
-				*width = w;
-			if (height)
-				*height = h;
-
-			success = Save888RGBScreenshot(filename, fmt, buffer, w, h);
-		}
+		if (width)
+			*width = w;
+		if (height)
+			*height = h;
+
+		success = Save888RGBScreenshot(filename, fmt, buffer, w, h);
 	}
 	delete [] flipbuffer;
 
@@ -353,6 +379,58 @@ bool TakeGameScreenshot(const char *filename, ScreenshotFormat fmt, ScreenshotTy
 	return success;
 }
 
+static void ScreenshotThreadFunc() {
+	setCurrentThreadName("Screenshot");
+
+	std::unique_lock<std::mutex> guard(screenshotLock);
+	while (!pendingScreenshots.empty()) {
+		PendingScreenshot shot = std::move(pendingScreenshots.front());
+		pendingScreenshots.pop_front();
+		guard.unlock();
+
+		u8 *flipbuffer = nullptr;
+		const u8 *buffer = ConvertBufferToScreenshot(shot.buf, false, flipbuffer, shot.w, shot.h);
+		if (!buffer || !Save888RGBScreenshot(shot.filename.c_str(), shot.fmt, buffer, shot.w, shot.h)) {
+			ERROR_LOG(SYSTEM, "Failed to write screenshot %s.", shot.filename.c_str());
+		}
+		delete [] flipbuffer;
+
+		guard.lock();
+	}
+	screenshotThreadActive = false;
+	screenshotCond.notify_all();
+}
+
+bool QueueGameScreenshot(const char *filename, ScreenshotFormat fmt, ScreenshotType type, int maxRes) {
+	PendingScreenshot shot;
+	if (!ReadbackScreenshot(shot.buf, type, maxRes, shot.w, shot.h)) {
+		return false;
+	}
+	// Without an FBO, this can point straight at PSP RAM, which will have moved on by the time we get to it.
+	shot.buf.TakeOwnership();
+	shot.filename = filename;
+	shot.fmt = fmt;
+
+	std::lock_guard<std::mutex> guard(screenshotLock);
+	pendingScreenshots.push_back(std::move(shot));
+	if (!screenshotThreadActive) {
+		// The previous thread is done with the lock once it clears the flag, so this won't block long.
+		if (screenshotThread.joinable())
+			screenshotThread.join();
+		screenshotThreadActive = true;
+		screenshotThread = std::thread(&ScreenshotThreadFunc);
+	}
+	return true;
+}
+
+void WaitForPendingScreenshots() {
+	std::unique_lock<std::mutex> guard(screenshotLock);
+	while (screenshotThreadActive)
+		screenshotCond.wait(guard);
+	if (screenshotThread.joinable())
+		screenshotThread.join();
+}
+
 bool Save888RGBScreenshot(const char *filename, ScreenshotFormat fmt, const u8 *bufferRGB888, int w, int h) {
 #ifdef USING_QT_UI
 	QImage image(bufferRGB888, w, h, QImage::Format_RGB888);
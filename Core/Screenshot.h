@@ -37,5 +37,9 @@ const u8 *ConvertBufferToScreenshot(const GPUDebugBuffer &buf, bool alpha, u8 *&
 
 // Can only be used while in game.
 bool TakeGameScreenshot(const char *filename, ScreenshotFormat fmt, ScreenshotType type, int *width = nullptr, int *height = nullptr, int maxRes = -1);
+// Like TakeGameScreenshot, but only the readback happens now. Converting, encoding and writing the file
+// happen on a worker thread, so the file may not exist yet when this returns.
+bool QueueGameScreenshot(const char *filename, ScreenshotFormat fmt, ScreenshotType type, int maxRes = -1);
+void WaitForPendingScreenshots();
 bool Save888RGBScreenshot(const char *filename, ScreenshotFormat fmt, const u8 *bufferRGB888, int w, int h);
 bool Save8888RGBAScreenshot(const char *filename, const u8 *bufferRGBA8888, int w, int h);
@@ -30,7 +30,9 @@
 #include <condition_variable>
 
 #include "base/timeutil.h"
+#include "base/stringutil.h"
 #include "math/math_util.h"
+#include "profiler/profiler.h"
 #include "thread/threadutil.h"
 #include "util/text/utf8.h"
 
@@ -52,13 +54,16 @@
 #include "Core/Core.h"
 #include "Core/CoreTiming.h"
 #include "Core/CoreParameter.h"
+#include "Core/Debugger/StatsServer.h"
 #include "Core/FileLoaders/RamCachingFileLoader.h"
 #include "Core/FileSystems/MetaFileSystem.h"
 #include "Core/Loaders.h"
 #include "Core/PSPLoaders.h"
 #include "Core/ELF/ParamSFO.h"
 #include "Core/SaveState.h"
+#include "Core/Screenshot.h"
 #include "Common/LogManager.h"
+#include "Common/ThreadPools.h"
 #include "Core/HLE/sceAudiocodec.h"
 
 #include "GPU/GPUState.h"
@@ -155,7 +160,31 @@ bool CPU_HasPendingAction() {
 
 void CPU_Shutdown();
 
+// Collects how long each step of boot took, so slow starts can be diagnosed from the log.
+class BootTimings {
+public:
+	BootTimings() : start_(real_time_now()), last_(start_) {}
+
+	void Step(const char *name) {
+		double now = real_time_now();
+		summary_ += StringFromFormat(" %s=%0.1fms", name, (now - last_) * 1000.0);
+		last_ = now;
+	}
+
+	void Log() {
+		INFO_LOG(BOOT, "Boot took %0.1fms:%s", (real_time_now() - start_) * 1000.0, summary_.c_str());
+	}
+
+private:
+	double start_;
+	double last_;
+	std::string summary_;
+};
+
 void CPU_Init() {
+	PROFILE_THIS_SCOPE("cpu_init");
+	BootTimings timings;
+
 	coreState = CORE_POWERUP;
 	currentMIPS = &mipsr4k;
 
@@ -177,6 +206,7 @@ void CPU_Init() {
 	}
 #endif
 	IdentifiedFileType type = Identify_File(loadedFile);
+	timings.Step("identify");
 
 	// TODO: Put this somewhere better?
 	if (coreParameter.mountIso != "") {
@@ -201,6 +231,7 @@ void CPU_Init() {
 	default:
 		break;
 	}
+	timings.Step("mount");
 
 	// Here we have read the PARAM.SFO, let's see if we need any compatibility overrides.
 	// Homebrew usually has an empty discID, and even if they do have a disc id, it's not
@@ -208,25 +239,47 @@ void CPU_Init() {
 	std::string discID = g_paramSFO.GetDiscID();
 	coreParameter.compat.Load(discID);
 
-	Memory::Init();
-	mipsr4k.Reset();
+	// The symbol map is only file parsing, so it can load while we set up memory and HLE.
+	// It has to be done before LoadFile, which adds the module's own symbols.
+	TaskGroup symbolsLoaded;
+	GlobalThreadPool::Run(symbolsLoaded, [] {
+		PROFILE_THIS_SCOPE("boot_symbols");
+		host->AttemptLoadSymbolMap();
+	});
+
+	{
+		PROFILE_THIS_SCOPE("boot_hle");
+		Memory::Init();
+		mipsr4k.Reset();
+
+		// Audio stays on this thread, some backends want to be created where they're used.
+		if (coreParameter.enableSound) {
+			Audio_Init();
+		}
 
-	host->AttemptLoadSymbolMap();
+		CoreTiming::Init();
 
-	if (coreParameter.enableSound) {
-		Audio_Init();
+		// Init all the HLE modules
+		HLEInit();
 	}
+	timings.Step("hle");
 
-	CoreTiming::Init();
-
-	// Init all the HLE modules
-	HLEInit();
+	GlobalThreadPool::Wait(symbolsLoaded);
+	timings.Step("symbols");
 
 	// TODO: Check Game INI here for settings, patches and cheats, and modify coreParameter accordingly
 
 	// If they shut down early, we'll catch it when load completes.
 	// Note: this may return before init is complete, which is checked if CPU_IsReady().
-	if (!LoadFile(&loadedFile, &coreParameter.errorString)) {
+	bool loaded;
+	{
+		PROFILE_THIS_SCOPE("boot_load");
+		loaded = LoadFile(&loadedFile, &coreParameter.errorString);
+	}
+	timings.Step("load");
+	timings.Log();
+
+	if (!loaded) {
 		CPU_Shutdown();
 		coreParameter.fileToStart = "";
 		return;
@@ -315,6 +368,10 @@ bool PSP_InitStart(const CoreParameter &coreParam, std::string *error_string) {
 	pspIsIniting = true;
 	PSP_SetLoading("Loading game...");
 
+	if (g_Config.bStatsServer && !IsStatsServerRunning()) {
+		StartStatsServer();
+	}
+
 	CPU_Init();
 
 	*error_string = coreParameter.errorString;
@@ -382,7 +439,10 @@ void PSP_Shutdown() {
 	if (coreState == CORE_RUNNING)
 		Core_UpdateState(CORE_ERROR);
 	Core_NotifyShutdown();
+	StatsServer_NotifyShutdown();
 	CPU_Shutdown();
+	// Screenshots from this game may still be encoding, let them finish writing.
+	WaitForPendingScreenshots();
 	GPU_Shutdown();
 	g_paramSFO.Clear();
 	host->SetWindowTitle(0);
@@ -396,12 +456,14 @@ void PSP_Shutdown() {
 void PSP_BeginHostFrame() {
 	// Reapply the graphics state of the PSP
 	if (gpu) {
+		gpu->SyncThread();
 		gpu->BeginHostFrame();
 	}
 }
 
 void PSP_EndHostFrame() {
 	if (gpu) {
+		gpu->SyncThread();
 		gpu->EndHostFrame();
 	}
 }
@@ -413,6 +475,12 @@ void PSP_RunLoopUntil(u64 globalticks) {
 	}
 
 	mipsr4k.RunLoopUntil(globalticks);
+	if (coreState == CORE_NEXTFRAME) {
+		// A couple of milliseconds a frame until the functions found at load are all compiled.
+		MIPSAnalyst::PrecompilePendingFunctions(0.002);
+	}
+	// Don't leave the GE thread drawing while the UI takes over the render manager.
+	gpu->SyncThread();
 	gpu->CleanupBeforeUI();
 }
 
@@ -420,6 +488,57 @@ void PSP_RunLoopFor(int cycles) {
 	PSP_RunLoopUntil(CoreTiming::GetTicks() + cycles);
 }
 
+// Returns false if something other than the end of the frame stopped the core.
+static bool RunUntilNextFrame(int blockTicks) {
+	while (coreState == CORE_RUNNING) {
+		PSP_RunLoopFor(blockTicks);
+	}
+	if (coreState != CORE_NEXTFRAME)
+		return false;
+	coreState = CORE_RUNNING;
+	return true;
+}
+
+static void SetFrameDrawn(bool drawn) {
+	if (drawn)
+		gstate_c.skipDrawReason &= ~SKIPDRAW_SKIPFRAME;
+	else
+		gstate_c.skipDrawReason |= SKIPDRAW_SKIPFRAME;
+}
+
+bool PSP_RunAheadFrame(int aheadFrames, int blockTicks) {
+	// The real frame isn't drawn, we show the last frame ahead instead.  The GPU only ever sees
+	// consecutive frames that way, so render-to-texture effects still line up.
+	SetFrameDrawn(false);
+	if (!RunUntilNextFrame(blockTicks))
+		return true;
+	if (!SaveState::SaveRunAhead()) {
+		coreState = CORE_NEXTFRAME;
+		return false;
+	}
+
+	coreParameter.runningAhead = true;
+	for (int i = 0; i < aheadFrames; ++i) {
+		SetFrameDrawn(i == aheadFrames - 1);
+		if (!RunUntilNextFrame(blockTicks))
+			break;
+	}
+
+	// The real frames will get to a shutdown too, no need to roll back first.
+	if (coreState != CORE_POWERDOWN && coreState != CORE_ERROR) {
+		if (!SaveState::LoadRunAhead()) {
+			ERROR_LOG(SAVESTATE, "Failed to roll back run-ahead frames");
+			SaveState::StopRunAhead();
+		}
+		// A breakpoint ahead stays stepping, the real frames will hit it again once resumed.
+		if (coreState == CORE_RUNNING) {
+			coreState = CORE_NEXTFRAME;
+		}
+	}
+	coreParameter.runningAhead = false;
+	return true;
+}
+
 void PSP_SetLoading(const std::string &reason) {
 	std::lock_guard<std::mutex> guard(loadingReasonLock);
 	loadingReason = reason;
@@ -72,6 +72,10 @@ void PSP_BeginHostFrame();
 void PSP_EndHostFrame();
 void PSP_RunLoopUntil(u64 globalticks);
 void PSP_RunLoopFor(int cycles);
+// Runs the frame with current input, then runs ahead (not throttled, no audio) and shows the last
+// frame ahead before rolling back, so input shows up aheadFrames sooner.  Ends with CORE_NEXTFRAME
+// like a normal frame.  Returns false if run-ahead can't snapshot (e.g. memory watches are set.)
+bool PSP_RunAheadFrame(int aheadFrames, int blockTicks);
 
 void PSP_SetLoading(const std::string &reason);
 std::string PSP_GetLoading();
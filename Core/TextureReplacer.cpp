@@ -20,8 +20,12 @@
 #endif
 
 #include <algorithm>
+#include <sstream>
+#include "base/timeutil.h"
 #include "ext/xxhash.h"
+#include "file/file_util.h"
 #include "file/ini_file.h"
+#include "thread/threadutil.h"
 #include "Common/ColorConv.h"
 #include "Common/FileUtil.h"
 #include "Core/Config.h"
@@ -31,15 +35,35 @@
 #include "GPU/Common/TextureDecoder.h"
 
 static const std::string INI_FILENAME = "textures.ini";
+static const std::string ARCHIVE_FILENAME = "textures.zip";
 static const std::string NEW_TEXTURE_DIR = "new/";
 static const int VERSION = 1;
 static const int MAX_MIP_LEVELS = 12;  // 12 should be plenty, 8 is the max mip levels supported by the PSP.
+static const int MAX_LOAD_THREADS = 4;
+// Loaded data not used for this long gets dropped, and is loaded again if needed.
+static const double REPLACEMENT_DATA_KEEP_SECONDS = 30.0;
+
+static std::string NormalizePackPath(std::string path) {
+	std::replace(path.begin(), path.end(), '\\', '/');
+#ifdef _WIN32
+	// The filesystem doesn't care, so the ini might not either.
+	std::transform(path.begin(), path.end(), path.begin(), ::tolower);
+#endif
+	return path;
+}
+
+static bool EndsWithNoCase(const std::string &str, const char *suffix) {
+	size_t len = strlen(suffix);
+	return str.size() >= len && strcasecmp(str.c_str() + str.size() - len, suffix) == 0;
+}
 
 TextureReplacer::TextureReplacer() {
 	none_.alphaStatus_ = ReplacedTextureAlpha::UNKNOWN;
+	none_.state_ = ReplacedTexture::STATE_READY;
 }
 
 TextureReplacer::~TextureReplacer() {
+	StopLoadThreads();
 }
 
 void TextureReplacer::Init() {
@@ -47,6 +71,10 @@ void TextureReplacer::Init() {
 }
 
 void TextureReplacer::NotifyConfigChanged() {
+	// The pack might have changed, so start over.
+	StopLoadThreads();
+	cache_.clear();
+
 	gameID_ = g_paramSFO.GetDiscID();
 
 	enabled_ = g_Config.bReplaceTextures || g_Config.bSaveNewTextures;
@@ -71,11 +99,31 @@ bool TextureReplacer::LoadIni() {
 	hash_ = ReplacedTextureHash::QUICK;
 	aliases_.clear();
 	hashranges_.clear();
+	packFiles_.clear();
+	hashFiles_.clear();
+	archive_.reset();
+
+	// Thousands of loose files are slow to scan and open, so a pack can also be one archive.
+	// Loose files are indexed afterward and win, which makes it easy to try out changes.
+	if (File::Exists(basePath_ + ARCHIVE_FILENAME)) {
+		OpenArchive(basePath_ + ARCHIVE_FILENAME);
+	}
+	BuildPackIndex(basePath_, "");
+	BuildHashFileIndex();
 
+	IniFile ini;
+	bool hasIni = false;
 	if (File::Exists(basePath_ + INI_FILENAME)) {
-		IniFile ini;
-		ini.LoadFromVFS(basePath_ + INI_FILENAME);
+		hasIni = ini.LoadFromVFS(basePath_ + INI_FILENAME);
+	} else {
+		auto archived = packFiles_.find(INI_FILENAME);
+		if (archived != packFiles_.end() && archived->second.data) {
+			std::stringstream sstream(std::string((const char *)archived->second.data, archived->second.size));
+			hasIni = ini.Load(sstream);
+		}
+	}
 
+	if (hasIni) {
 		auto options = ini.GetOrCreateSection("options");
 		std::string hash;
 		options->Get("hash", &hash, "");
@@ -116,7 +164,10 @@ bool TextureReplacer::LoadIni() {
 			for (std::string hashName : hashNames) {
 				ReplacementAliasKey key(0, 0, 0);
 				if (sscanf(hashName.c_str(), "%16llx%8x_%d", &key.cachekey, &key.hash, &key.level) >= 1) {
-					hashes->Get(hashName.c_str(), &aliases_[key], "");
+					std::string &alias = aliases_[key];
+					hashes->Get(hashName.c_str(), &alias, "");
+					// Once here, rather than on every lookup.
+					alias = NormalizePackPath(alias);
 				} else {
 					ERROR_LOG(G3D, "Unsupported syntax under [hashes]: %s", hashName.c_str());
 				}
@@ -140,6 +191,195 @@ bool TextureReplacer::LoadIni() {
 	return true;
 }
 
+static u16 ReadLE16(const u8 *p) {
+	return p[0] | (p[1] << 8);
+}
+
+static u32 ReadLE32(const u8 *p) {
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((u32)p[3] << 24);
+}
+
+// Only stored (uncompressed) zip entries are used, so they can be read straight from the mapping.
+// PNG and DDS data wouldn't shrink much anyway.
+bool TextureReplacer::OpenArchive(const std::string &filename) {
+	static const u32 EOCD_SIGNATURE = 0x06054b50;
+	static const u32 CENTRAL_SIGNATURE = 0x02014b50;
+	static const u32 LOCAL_SIGNATURE = 0x04034b50;
+	static const size_t EOCD_SIZE = 22;
+	static const size_t CENTRAL_SIZE = 46;
+	static const size_t LOCAL_SIZE = 30;
+
+	std::unique_ptr<File::MappedFile> archive(new File::MappedFile());
+	// Reading a big pack into memory would be worse than loose files.
+	if (!archive->Open(filename, false)) {
+		ERROR_LOG(G3D, "Could not map texture replacement archive: %s", filename.c_str());
+		return false;
+	}
+
+	const u8 *data = archive->Data();
+	const size_t size = archive->Size();
+
+	// The end record is last, followed only by a comment of up to 64KB.
+	const u8 *eocd = nullptr;
+	if (size >= EOCD_SIZE) {
+		size_t minPos = size > EOCD_SIZE + 0xFFFF ? size - EOCD_SIZE - 0xFFFF : 0;
+		for (size_t pos = size - EOCD_SIZE + 1; pos-- > minPos; ) {
+			if (ReadLE32(data + pos) == EOCD_SIGNATURE) {
+				eocd = data + pos;
+				break;
+			}
+		}
+	}
+	if (!eocd) {
+		ERROR_LOG(G3D, "Texture replacement archive is not a zip: %s", filename.c_str());
+		return false;
+	}
+
+	u32 count = ReadLE16(eocd + 10);
+	u32 dirSize = ReadLE32(eocd + 12);
+	u32 dirOffset = ReadLE32(eocd + 16);
+	if ((u64)dirOffset + dirSize > size) {
+		ERROR_LOG(G3D, "Texture replacement archive is truncated or zip64, which isn't supported: %s", filename.c_str());
+		return false;
+	}
+
+	int skipped = 0;
+	const u8 *entry = data + dirOffset;
+	const u8 *dirEnd = entry + dirSize;
+	for (u32 i = 0; i < count; ++i) {
+		if (entry + CENTRAL_SIZE > dirEnd || ReadLE32(entry) != CENTRAL_SIGNATURE) {
+			ERROR_LOG(G3D, "Texture replacement archive has a bad directory: %s", filename.c_str());
+			break;
+		}
+
+		u16 method = ReadLE16(entry + 10);
+		u32 compressedSize = ReadLE32(entry + 20);
+		u32 uncompressedSize = ReadLE32(entry + 24);
+		u16 nameLen = ReadLE16(entry + 28);
+		u16 extraLen = ReadLE16(entry + 30);
+		u16 commentLen = ReadLE16(entry + 32);
+		u32 localOffset = ReadLE32(entry + 42);
+		if (entry + CENTRAL_SIZE + nameLen > dirEnd) {
+			break;
+		}
+		std::string name((const char *)entry + CENTRAL_SIZE, nameLen);
+		entry += CENTRAL_SIZE + nameLen + extraLen + commentLen;
+
+		if (name.empty() || name.back() == '/') {
+			// Directory.
+			continue;
+		}
+		if (method != 0 || compressedSize != uncompressedSize) {
+			skipped++;
+			continue;
+		}
+
+		// The local header can have a different extra field, so the data offset comes from there.
+		if ((u64)localOffset + LOCAL_SIZE > size || ReadLE32(data + localOffset) != LOCAL_SIGNATURE) {
+			skipped++;
+			continue;
+		}
+		u64 dataOffset = (u64)localOffset + LOCAL_SIZE + ReadLE16(data + localOffset + 26) + ReadLE16(data + localOffset + 28);
+		if (dataOffset + uncompressedSize > size) {
+			skipped++;
+			continue;
+		}
+
+		ReplacementPackFile &file = packFiles_[NormalizePackPath(name)];
+		file.data = data + dataOffset;
+		file.size = uncompressedSize;
+	}
+
+	if (skipped != 0) {
+		WARN_LOG(G3D, "Skipped %d compressed or broken files in texture replacement archive, store them uncompressed: %s", skipped, filename.c_str());
+	}
+
+	archive_ = std::move(archive);
+	return true;
+}
+
+void TextureReplacer::BuildPackIndex(const std::string &dir, const std::string &prefix) {
+	std::vector<FileInfo> files;
+	getFilesInDir(dir.c_str(), &files);
+	for (const FileInfo &info : files) {
+		if (info.isDirectory) {
+			// Textures we've saved aren't used until they're moved into the pack.
+			if (prefix.empty() && info.name + "/" == NEW_TEXTURE_DIR) {
+				continue;
+			}
+			BuildPackIndex(info.fullName, prefix + info.name + "/");
+		} else {
+			ReplacementPackFile &file = packFiles_[NormalizePackPath(prefix + info.name)];
+			file.data = nullptr;
+			file.size = (u32)info.size;
+		}
+	}
+}
+
+void TextureReplacer::BuildHashFileIndex() {
+	for (const auto &item : packFiles_) {
+		const std::string &name = item.first;
+		// Must look exactly like HashName() plus an extension, without a directory.
+		if (name.size() < 24 + 4 || name.find('/') != name.npos) {
+			continue;
+		}
+		const bool isDDS = EndsWithNoCase(name, ".dds");
+		if (!isDDS && !EndsWithNoCase(name, ".png")) {
+			continue;
+		}
+
+		ReplacementAliasKey key(0, 0, 0);
+		char suffix[16] = {};
+		int level = 0;
+		std::string base = name.substr(0, name.size() - 4);
+		if (base.size() > 24 + 1 && base[24] == '_') {
+			if (sscanf(base.c_str() + 25, "%d%15s", &level, suffix) != 1 || level <= 0) {
+				continue;
+			}
+		} else if (base.size() != 24) {
+			continue;
+		}
+		if (strspn(base.c_str(), "0123456789abcdefABCDEF") < 24 || sscanf(base.c_str(), "%16llx%8x", &key.cachekey, &key.hash) != 2) {
+			continue;
+		}
+		key.level = level;
+
+		// A DDS wins, since it skips the decode.
+		auto existing = hashFiles_.find(key);
+		if (existing == hashFiles_.end() || isDDS) {
+			hashFiles_[key] = name;
+		}
+	}
+}
+
+bool TextureReplacer::PackFileExists(const std::string &hashfile) {
+	return !hashfile.empty() && packFiles_.find(hashfile) != packFiles_.end();
+}
+
+bool TextureReplacer::ReadPackFile(const std::string &name, std::vector<u8> &buffer, const u8 **data, size_t *size) {
+	auto it = packFiles_.find(name);
+	if (it == packFiles_.end()) {
+		return false;
+	}
+	if (it->second.data) {
+		*data = it->second.data;
+		*size = it->second.size;
+		return true;
+	}
+
+	File::IOFile file(basePath_ + name, "rb");
+	if (!file) {
+		return false;
+	}
+	buffer.resize((size_t)file.GetSize());
+	if (buffer.empty() || !file.ReadBytes(&buffer[0], buffer.size())) {
+		return false;
+	}
+	*data = &buffer[0];
+	*size = buffer.size();
+	return true;
+}
+
 void TextureReplacer::ParseHashRange(const std::string &key, const std::string &value) {
 	std::vector<std::string> keyParts;
 	SplitString(key, ',', keyParts);
@@ -252,12 +492,19 @@ ReplacedTexture &TextureReplacer::FindReplacement(u64 cachekey, u32 hash, int w,
 	ReplacementCacheKey replacementKey(cachekey, hash);
 	auto it = cache_.find(replacementKey);
 	if (it != cache_.end()) {
-		return it->second;
+		ReplacedTexture &result = it->second;
+		result.lastUsed_ = time_now_d();
+		if (result.state_ == ReplacedTexture::STATE_NONE) {
+			// The data was decimated, but the files are still known.
+			QueueLoad(&result);
+		}
+		return result;
 	}
 
 	// Okay, let's construct the result.
 	ReplacedTexture &result = cache_[replacementKey];
 	result.alphaStatus_ = ReplacedTextureAlpha::UNKNOWN;
+	result.lastUsed_ = time_now_d();
 	PopulateReplacement(&result, cachekey, hash, w, h);
 	return result;
 }
@@ -266,55 +513,383 @@ void TextureReplacer::PopulateReplacement(ReplacedTexture *result, u64 cachekey,
 	int newW = w;
 	int newH = h;
 	LookupHashRange(cachekey >> 32, newW, newH);
+	result->hashW_ = w;
+	result->hashH_ = h;
+	result->rangeW_ = newW;
+	result->rangeH_ = newH;
 
 	if (ignoreAddress_) {
 		cachekey = cachekey & 0xFFFFFFFFULL;
 	}
 
+	// Only the index is consulted here, the files are opened by the loader.
 	for (int i = 0; i < MAX_MIP_LEVELS; ++i) {
-		const std::string hashfile = LookupHashFile(cachekey, hash, i);
-		const std::string filename = basePath_ + hashfile;
-		if (hashfile.empty() || !File::Exists(filename)) {
+		const std::string *hashfile = LookupAlias(cachekey, hash, i);
+		if (!hashfile) {
+			// Without an alias, it can only be named after the hash.  Most textures aren't replaced,
+			// so this avoids building any names for them.
+			auto hashFile = hashFiles_.find(ReplacementAliasKey(cachekey, hash, i));
+			hashfile = hashFile != hashFiles_.end() ? &hashFile->second : nullptr;
+		}
+		if (!hashfile || !PackFileExists(*hashfile)) {
 			// Out of valid mip levels.  Bail out.
 			break;
 		}
+		result->files_.push_back(*hashfile);
+	}
+
+	if (result->files_.empty()) {
+		result->state_ = ReplacedTexture::STATE_READY;
+	} else {
+		QueueLoad(result);
+	}
+}
+
+void TextureReplacer::QueueLoad(ReplacedTexture *texture) {
+	if (!g_Config.bReplaceTexturesAsync) {
+		PrepareData(texture);
+		texture->state_.store(ReplacedTexture::STATE_READY, std::memory_order_release);
+		return;
+	}
+
+	texture->state_ = ReplacedTexture::STATE_QUEUED;
+
+	std::lock_guard<std::mutex> guard(loadLock_);
+	if (loadThreads_.empty()) {
+		int count = std::max(1, std::min(MAX_LOAD_THREADS, (int)std::thread::hardware_concurrency() / 2));
+		loadStop_ = false;
+		for (int i = 0; i < count; ++i) {
+			loadThreads_.push_back(std::thread(&TextureReplacer::LoadThreadFunc, this));
+		}
+	}
+	loadQueue_.push_back(texture);
+	loadCond_.notify_one();
+}
+
+void TextureReplacer::LoadThreadFunc() {
+	setCurrentThreadName("TexReplace");
+
+	std::unique_lock<std::mutex> guard(loadLock_);
+	while (true) {
+		while (loadQueue_.empty() && !loadStop_) {
+			loadCond_.wait(guard);
+		}
+		if (loadStop_) {
+			break;
+		}
 
-		ReplacedTextureLevel level;
-		level.fmt = ReplacedTextureFormat::F_8888;
-		level.file = filename;
+		ReplacedTexture *texture = loadQueue_.front();
+		loadQueue_.pop_front();
+		guard.unlock();
+		PrepareData(texture);
+		texture->state_.store(ReplacedTexture::STATE_READY, std::memory_order_release);
+		guard.lock();
+	}
+}
+
+void TextureReplacer::StopLoadThreads() {
+	{
+		std::lock_guard<std::mutex> guard(loadLock_);
+		loadStop_ = true;
+		loadCond_.notify_all();
+	}
+	for (std::thread &thread : loadThreads_) {
+		thread.join();
+	}
+	loadThreads_.clear();
+
+	// Anything that didn't get its turn can be queued again later.
+	for (ReplacedTexture *texture : loadQueue_) {
+		texture->state_ = ReplacedTexture::STATE_NONE;
+	}
+	loadQueue_.clear();
+	loadStop_ = false;
+}
 
+void TextureReplacer::Decimate() {
+	double now = time_now_d();
+	for (auto &item : cache_) {
+		ReplacedTexture &texture = item.second;
+		// Only touch the ones the loader is done with.
+		if (texture.IsReady() && !texture.levels_.empty() && texture.lastUsed_ + REPLACEMENT_DATA_KEEP_SECONDS < now) {
+			texture.levels_.clear();
+			texture.levelData_.clear();
+			texture.state_ = ReplacedTexture::STATE_NONE;
+		}
+	}
+}
+
+void TextureReplacer::PrepareData(ReplacedTexture *texture) {
+	texture->levels_.clear();
+	texture->levelData_.clear();
+	texture->alphaStatus_ = ReplacedTextureAlpha::UNKNOWN;
+
+	std::vector<u8> buffer;
+	for (size_t i = 0; i < texture->files_.size(); ++i) {
+		const std::string &name = texture->files_[i];
+		const u8 *data = nullptr;
+		size_t size = 0;
+		if (!ReadPackFile(name, buffer, &data, &size)) {
+			ERROR_LOG(G3D, "Could not open texture replacement: %s", name.c_str());
+			break;
+		}
+
+		if (EndsWithNoCase(name, ".dds")) {
+			// These carry their own mips, so the rest of the files aren't used.
+			if (i == 0) {
+				PrepareLevelsDDS(texture, name, data, size);
+			} else {
+				WARN_LOG(G3D, "Replacement mipmap can't be a DDS: %s", name.c_str());
+			}
+			break;
+		}
+
+		if (!PrepareLevelPNG(texture, (int)i, name, data, size)) {
+			// Don't try to load any more mips.
+			break;
+		}
+	}
+}
+
+bool TextureReplacer::PrepareLevelPNG(ReplacedTexture *texture, int i, const std::string &filename, const u8 *fileData, size_t fileSize) {
 #ifdef USING_QT_UI
-		ERROR_LOG(G3D, "Replacement texture loading not implemented for Qt");
+	ERROR_LOG(G3D, "Replacement texture loading not implemented for Qt");
+	return false;
 #else
-		png_image png = {};
-		png.version = PNG_IMAGE_VERSION;
-		FILE *fp = File::OpenCFile(filename, "rb");
-		bool bad = false;
-		if (png_image_begin_read_from_stdio(&png, fp)) {
-			// We pad files that have been hashrange'd so they are the same texture size.
-			level.w = (png.width * w) / newW;
-			level.h = (png.height * h) / newH;
-			if (i != 0) {
-				// Check that the mipmap size is correct. Can't load mips of the wrong size.
-				if (level.w != (result->levels_[0].w >> i) || level.h != (result->levels_[0].h >> i)) {
-					WARN_LOG(G3D, "Replacement mipmap invalid: size=%dx%d, expected=%dx%d (level %d, '%s')", level.w, level.h, result->levels_[0].w >> i, result->levels_[0].h >> i, i, filename.c_str());
-					bad = true;
+	ReplacedTextureLevel level;
+	level.fmt = ReplacedTextureFormat::F_8888;
+	level.file = filename;
+	level.fileOffset = 0;
+
+	png_image png = {};
+	png.version = PNG_IMAGE_VERSION;
+
+	bool good = false;
+	if (png_image_begin_read_from_memory(&png, fileData, fileSize)) {
+		// We pad files that have been hashrange'd so they are the same texture size.
+		level.w = (png.width * texture->hashW_) / texture->rangeW_;
+		level.h = (png.height * texture->hashH_) / texture->rangeH_;
+		good = true;
+		if (i != 0) {
+			// Check that the mipmap size is correct. Can't load mips of the wrong size.
+			const ReplacedTextureLevel &base = texture->levels_[0];
+			if (level.w != (base.w >> i) || level.h != (base.h >> i)) {
+				WARN_LOG(G3D, "Replacement mipmap invalid: size=%dx%d, expected=%dx%d (level %d, '%s')", level.w, level.h, base.w >> i, base.h >> i, i, filename.c_str());
+				good = false;
+			}
+		}
+	} else {
+		ERROR_LOG(G3D, "Could not load texture replacement info: %s - %s", filename.c_str(), png.message);
+	}
+
+	std::vector<u8> data;
+	if (good) {
+		bool checkedAlpha = false;
+		if ((png.format & PNG_FORMAT_FLAG_ALPHA) == 0) {
+			// Well, we know for sure it doesn't have alpha.
+			if (i == 0) {
+				texture->alphaStatus_ = ReplacedTextureAlpha::FULL;
+			}
+			checkedAlpha = true;
+		}
+		png.format = PNG_FORMAT_RGBA;
+
+		// Zero filled, for the padding.
+		int rowPitch = level.w * 4;
+		data.resize(rowPitch * level.h);
+		if (png_image_finish_read(&png, nullptr, &data[0], rowPitch, nullptr)) {
+			if (!checkedAlpha) {
+				// This will only check the hashed bits.
+				CheckAlphaResult res = CheckAlphaRGBA8888Basic((const u32 *)&data[0], level.w, png.width, png.height);
+				if (res == CHECKALPHA_ANY || i == 0) {
+					texture->alphaStatus_ = ReplacedTextureAlpha(res);
 				}
 			}
-			if (!bad)
-				result->levels_.push_back(level);
 		} else {
-			ERROR_LOG(G3D, "Could not load texture replacement info: %s - %s", filename.c_str(), png.message);
+			ERROR_LOG(G3D, "Could not load texture replacement: %s - %s", filename.c_str(), png.message);
+			good = false;
 		}
-		fclose(fp);
+	}
 
-		png_image_free(&png);
-		if (bad)
-			break;  // Don't try to load any more mips.
+	png_image_free(&png);
+
+	if (good) {
+		texture->levels_.push_back(level);
+		texture->levelData_.push_back(std::move(data));
+	}
+	return good;
 #endif
+}
+
+namespace {
+
+struct DDSPixelFormat {
+	u32_le size;
+	u32_le flags;
+	u32_le fourCC;
+	u32_le rgbBitCount;
+	u32_le masks[4];
+};
+
+struct DDSHeader {
+	u32_le magic;
+	u32_le size;
+	u32_le flags;
+	u32_le height;
+	u32_le width;
+	u32_le pitchOrLinearSize;
+	u32_le depth;
+	u32_le mipMapCount;
+	u32_le reserved1[11];
+	DDSPixelFormat pixelFormat;
+	u32_le caps[4];
+	u32_le reserved2;
+};
+
+}
+
+static const u32 DDS_MAGIC = 0x20534444;  // "DDS "
+static const u32 DDSD_MIPMAPCOUNT = 0x20000;
+static const u32 DDPF_FOURCC = 0x4;
+
+static u32 MakeFourCC(char a, char b, char c, char d) {
+	return (u32)(u8)a | ((u32)(u8)b << 8) | ((u32)(u8)c << 16) | ((u32)(u8)d << 24);
+}
+
+// The reverse of ConvertDXT*ToBC*, so we can reuse the PSP decoders when the GPU can't take BC.
+static void BCColorToDXT1(DXT1Block *dst, const u8 *src) {
+	dst->color1 = src[0] | (src[1] << 8);
+	dst->color2 = src[2] | (src[3] << 8);
+	memcpy(dst->lines, src + 4, 4);
+}
+
+static void DecodeBCBlock(u32 *dst, ReplacedTextureFormat fmt, const u8 *src) {
+	switch (fmt) {
+	case ReplacedTextureFormat::F_BC1:
+	{
+		DXT1Block block;
+		BCColorToDXT1(&block, src);
+		DecodeDXT1Block(dst, &block, 4, 4, false);
+		break;
+	}
+	case ReplacedTextureFormat::F_BC2:
+	{
+		DXT3Block block;
+		BCColorToDXT1(&block.color, src + 8);
+		for (int y = 0; y < 4; ++y) {
+			block.alphaLines[y] = src[y * 2] | (src[y * 2 + 1] << 8);
+		}
+		DecodeDXT3Block(dst, &block, 4, 4);
+		break;
+	}
+	case ReplacedTextureFormat::F_BC3:
+	{
+		DXT5Block block;
+		BCColorToDXT1(&block.color, src + 8);
+		block.alpha1 = src[0];
+		block.alpha2 = src[1];
+		u64 data = 0;
+		for (int b = 0; b < 6; ++b) {
+			data |= (u64)src[2 + b] << (b * 8);
+		}
+		block.alphadata1 = (u16)(data >> 32);
+		block.alphadata2 = (u32)data;
+		DecodeDXT5Block(dst, &block, 4, 4);
+		break;
 	}
+	default:
+		break;
+	}
+}
 
-	result->alphaStatus_ = ReplacedTextureAlpha::UNKNOWN;
+bool TextureReplacer::PrepareLevelsDDS(ReplacedTexture *texture, const std::string &filename, const u8 *fileData, size_t fileSize) {
+	DDSHeader header;
+	if (fileSize < sizeof(header)) {
+		ERROR_LOG(G3D, "Could not load texture replacement info: %s - not a DDS", filename.c_str());
+		return false;
+	}
+	memcpy(&header, fileData, sizeof(header));
+	if (header.magic != DDS_MAGIC || header.size != sizeof(header) - 4) {
+		ERROR_LOG(G3D, "Could not load texture replacement info: %s - not a DDS", filename.c_str());
+		return false;
+	}
+
+	ReplacedTextureFormat fmt;
+	u32 fourCC = (header.pixelFormat.flags & DDPF_FOURCC) ? (u32)header.pixelFormat.fourCC : 0;
+	if (fourCC == MakeFourCC('D', 'X', 'T', '1')) {
+		fmt = ReplacedTextureFormat::F_BC1;
+	} else if (fourCC == MakeFourCC('D', 'X', 'T', '3')) {
+		fmt = ReplacedTextureFormat::F_BC2;
+	} else if (fourCC == MakeFourCC('D', 'X', 'T', '5')) {
+		fmt = ReplacedTextureFormat::F_BC3;
+	} else {
+		ERROR_LOG(G3D, "Unsupported texture replacement DDS format (only DXT1/3/5): %s", filename.c_str());
+		return false;
+	}
+
+	if (texture->rangeW_ != texture->hashW_ || texture->rangeH_ != texture->hashH_) {
+		// Would need padding in whole blocks, save it as a PNG instead.
+		ERROR_LOG(G3D, "Texture replacement DDS can't be used with a hashrange: %s", filename.c_str());
+		return false;
+	}
+
+	const int blockSize = fmt == ReplacedTextureFormat::F_BC1 ? 8 : 16;
+	int mipCount = (header.flags & DDSD_MIPMAPCOUNT) ? std::max(1, (int)header.mipMapCount) : 1;
+	mipCount = std::min(mipCount, MAX_MIP_LEVELS);
+
+	u32 offset = sizeof(header);
+	for (int i = 0; i < mipCount; ++i) {
+		ReplacedTextureLevel level;
+		level.w = std::max(1, (int)header.width >> i);
+		level.h = std::max(1, (int)header.height >> i);
+		level.fmt = compressedSupported_ ? fmt : ReplacedTextureFormat::F_8888;
+		level.file = filename;
+		level.fileOffset = offset;
+		if (i != 0 && (level.w != (texture->levels_[0].w >> i) || level.h != (texture->levels_[0].h >> i))) {
+			// Below 1x1 in one direction, we can't use those.
+			break;
+		}
+
+		const int blocksW = (level.w + 3) / 4;
+		const int blocksH = (level.h + 3) / 4;
+		const size_t levelSize = blocksW * blocksH * blockSize;
+		if (offset + levelSize > fileSize) {
+			ERROR_LOG(G3D, "Could not load texture replacement: %s - level %d truncated", filename.c_str(), i);
+			break;
+		}
+		const u8 *blocks = fileData + offset;
+		offset += (u32)levelSize;
+
+		if (compressedSupported_) {
+			texture->levels_.push_back(level);
+			texture->levelData_.push_back(std::vector<u8>(blocks, blocks + levelSize));
+			continue;
+		}
+
+		std::vector<u8> data(level.w * level.h * 4);
+		u32 *dst = (u32 *)&data[0];
+		u32 decoded[16];
+		for (int by = 0; by < blocksH; ++by) {
+			for (int bx = 0; bx < blocksW; ++bx) {
+				DecodeBCBlock(decoded, fmt, blocks + (by * blocksW + bx) * blockSize);
+				// Levels smaller than a block only keep part of it.
+				int rows = std::min(4, level.h - by * 4);
+				int cols = std::min(4, level.w - bx * 4);
+				for (int y = 0; y < rows; ++y) {
+					memcpy(dst + (by * 4 + y) * level.w + bx * 4, decoded + y * 4, cols * sizeof(u32));
+				}
+			}
+		}
+
+		CheckAlphaResult res = CheckAlphaRGBA8888Basic(dst, level.w, level.w, level.h);
+		if (res == CHECKALPHA_ANY || i == 0) {
+			texture->alphaStatus_ = ReplacedTextureAlpha(res);
+		}
+		texture->levels_.push_back(level);
+		texture->levelData_.push_back(std::move(data));
+	}
+
+	return !texture->levels_.empty();
 }
 
 #ifndef USING_QT_UI
@@ -363,7 +938,7 @@ void TextureReplacer::NotifyTextureDecoded(const ReplacedTextureDecodeInfo &repl
 	const std::string saveFilename = basePath_ + NEW_TEXTURE_DIR + hashfile;
 
 	// If it's empty, it's an ignored hash, we intentionally don't save.
-	if (hashfile.empty() || File::Exists(filename)) {
+	if (hashfile.empty() || PackFileExists(hashfile)) {
 		// If it exists, must've been decoded and saved as a new texture already.
 		return;
 	}
@@ -426,6 +1001,9 @@ void TextureReplacer::NotifyTextureDecoded(const ReplacedTextureDecodeInfo &repl
 			ConvertBGRA8888ToRGBA8888(saveBuf.data(), (const u32 *)data, (pitch * h) / sizeof(u32));
 			break;
 		case ReplacedTextureFormat::F_8888:
+		case ReplacedTextureFormat::F_BC1:
+		case ReplacedTextureFormat::F_BC2:
+		case ReplacedTextureFormat::F_BC3:
 			// Impossible.  Just so we can get warnings on other missed formats.
 			break;
 		}
@@ -457,12 +1035,17 @@ void TextureReplacer::NotifyTextureDecoded(const ReplacedTextureDecodeInfo &repl
 	ReplacedTextureLevel saved;
 	saved.fmt = ReplacedTextureFormat::F_8888;
 	saved.file = filename;
+	saved.fileOffset = 0;
 	saved.w = w;
 	saved.h = h;
 	savedCache_[replacementKey] = saved;
 }
 
-std::string TextureReplacer::LookupHashFile(u64 cachekey, u32 hash, int level) {
+const std::string *TextureReplacer::LookupAlias(u64 cachekey, u32 hash, int level) {
+	if (aliases_.empty()) {
+		return nullptr;
+	}
+
 	ReplacementAliasKey key(cachekey, hash, level);
 	auto alias = aliases_.find(key);
 	if (alias == aliases_.end()) {
@@ -503,9 +1086,21 @@ std::string TextureReplacer::LookupHashFile(u64 cachekey, u32 hash, int level) {
 
 	if (alias != aliases_.end()) {
 		// Note: this will be blank if explicitly ignored.
-		return alias->second;
+		return &alias->second;
 	}
+	return nullptr;
+}
 
+std::string TextureReplacer::LookupHashFile(u64 cachekey, u32 hash, int level) {
+	const std::string *alias = LookupAlias(cachekey, hash, level);
+	if (alias) {
+		return *alias;
+	}
+
+	auto hashFile = hashFiles_.find(ReplacementAliasKey(cachekey, hash, level));
+	if (hashFile != hashFiles_.end()) {
+		return hashFile->second;
+	}
 	return HashName(cachekey, hash, level) + ".png";
 }
 
@@ -538,43 +1133,29 @@ void ReplacedTexture::Load(int level, void *out, int rowPitch) {
 	_assert_msg_(G3D, out != nullptr && rowPitch > 0, "Invalid out/pitch");
 
 	const ReplacedTextureLevel &info = levels_[level];
-
-#ifdef USING_QT_UI
-	ERROR_LOG(G3D, "Replacement texture loading not implemented for Qt");
-#else
-	png_image png = {};
-	png.version = PNG_IMAGE_VERSION;
-
-	FILE *fp = File::OpenCFile(info.file, "rb");
-	if (!png_image_begin_read_from_stdio(&png, fp)) {
-		ERROR_LOG(G3D, "Could not load texture replacement info: %s - %s", info.file.c_str(), png.message);
-		return;
+	const std::vector<u8> &data = levelData_[level];
+
+	int rowSize;
+	int rows;
+	switch (info.fmt) {
+	case ReplacedTextureFormat::F_BC1:
+		rowSize = ((info.w + 3) / 4) * 8;
+		rows = (info.h + 3) / 4;
+		break;
+	case ReplacedTextureFormat::F_BC2:
+	case ReplacedTextureFormat::F_BC3:
+		rowSize = ((info.w + 3) / 4) * 16;
+		rows = (info.h + 3) / 4;
+		break;
+	default:
+		rowSize = info.w * 4;
+		rows = info.h;
+		break;
 	}
 
-	bool checkedAlpha = false;
-	if ((png.format & PNG_FORMAT_FLAG_ALPHA) == 0) {
-		// Well, we know for sure it doesn't have alpha.
-		if (level == 0) {
-			alphaStatus_ = ReplacedTextureAlpha::FULL;
-		}
-		checkedAlpha = true;
-	}
-	png.format = PNG_FORMAT_RGBA;
-
-	if (!png_image_finish_read(&png, nullptr, out, rowPitch, nullptr)) {
-		ERROR_LOG(G3D, "Could not load texture replacement: %s - %s", info.file.c_str(), png.message);
-		return;
+	_assert_msg_(G3D, rowSize <= rowPitch && data.size() >= (size_t)(rowSize * rows), "Replacement level too small");
+	u8 *dst = (u8 *)out;
+	for (int y = 0; y < rows; ++y) {
+		memcpy(dst + y * rowPitch, &data[y * rowSize], rowSize);
 	}
-
-	if (!checkedAlpha) {
-		// This will only check the hashed bits.
-		CheckAlphaResult res = CheckAlphaRGBA8888Basic((u32 *)out, rowPitch / sizeof(u32), png.width, png.height);
-		if (res == CHECKALPHA_ANY || level == 0) {
-			alphaStatus_ = ReplacedTextureAlpha(res);
-		}
-	}
-
-	fclose(fp);
-	png_image_free(&png);
-#endif
 }
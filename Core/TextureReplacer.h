@@ -17,11 +17,18 @@
 
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 #include "Common/Common.h"
+#include "Common/FileUtil.h"
 #include "Common/MemoryUtil.h"
 #include "GPU/ge_constants.h"
 
@@ -37,6 +44,10 @@ enum class ReplacedTextureFormat {
 	F_1555_ABGR,
 	F_4444_ABGR,
 	F_8888_BGRA,
+	// Block compressed, straight from a DDS.  Only used if the backend asked for them.
+	F_BC1,
+	F_BC2,
+	F_BC3,
 };
 
 // These must match the constants in TextureCacheCommon.
@@ -59,6 +70,8 @@ struct ReplacedTextureLevel {
 	int h;
 	ReplacedTextureFormat fmt;
 	std::string file;
+	// Where the level starts, for files that hold several levels.
+	u32 fileOffset;
 };
 
 struct ReplacementCacheKey {
@@ -105,6 +118,13 @@ struct ReplacementAliasKey {
 	}
 };
 
+// Where a file of the pack can be found.
+struct ReplacementPackFile {
+	// Points into the mapped archive, or null for loose files, which are read from disk.
+	const u8 *data;
+	u32 size;
+};
+
 namespace std {
 	template <>
 	struct hash<ReplacementCacheKey> {
@@ -122,12 +142,25 @@ namespace std {
 }
 
 struct ReplacedTexture {
+	ReplacedTexture() : state_(STATE_NONE) {
+	}
+
+	// Until the level data has been loaded, this acts like there's no replacement.
 	inline bool Valid() {
-		return !levels_.empty();
+		return IsReady() && !levels_.empty();
+	}
+
+	inline bool IsReady() {
+		return state_.load(std::memory_order_acquire) == STATE_READY;
+	}
+
+	// Still loading in the background, so worth checking back for later.
+	inline bool IsPending() {
+		return state_.load(std::memory_order_acquire) == STATE_QUEUED;
 	}
 
 	bool GetSize(int level, int &w, int &h) {
-		if ((size_t)level < levels_.size()) {
+		if (Valid() && (size_t)level < levels_.size()) {
 			w = levels_[level].w;
 			h = levels_[level].h;
 			return true;
@@ -146,16 +179,40 @@ struct ReplacedTexture {
 		return ReplacedTextureFormat::F_8888;
 	}
 
+	bool IsCompressed(int level) {
+		ReplacedTextureFormat fmt = Format(level);
+		return fmt == ReplacedTextureFormat::F_BC1 || fmt == ReplacedTextureFormat::F_BC2 || fmt == ReplacedTextureFormat::F_BC3;
+	}
+
 	u8 AlphaStatus() {
 		return (u8)alphaStatus_;
 	}
 
+	// For the BC formats, rowPitch is per row of blocks.
 	void Load(int level, void *out, int rowPitch);
 
 protected:
+	enum {
+		STATE_NONE,
+		STATE_QUEUED,
+		STATE_READY,
+	};
+
+	// Written by the loader while queued, only read by the GPU thread once ready.
 	std::vector<ReplacedTextureLevel> levels_;
+	std::vector<std::vector<u8>> levelData_;
 	ReplacedTextureAlpha alphaStatus_;
 
+	// Set up on the GPU thread before queueing, the candidate files for each level, relative to the pack.
+	std::vector<std::string> files_;
+	int hashW_ = 0;
+	int hashH_ = 0;
+	int rangeW_ = 0;
+	int rangeH_ = 0;
+
+	std::atomic<int> state_;
+	double lastUsed_ = 0.0;
+
 	friend TextureReplacer;
 };
 
@@ -184,6 +241,13 @@ class TextureReplacer {
 	u32 ComputeHash(u32 addr, int bufw, int w, int h, GETextureFormat fmt, u16 maxSeenV);
 
 	ReplacedTexture &FindReplacement(u64 cachekey, u32 hash, int w, int h);
+	// Drops the loaded data of replacements that haven't been used in a while.
+	void Decimate();
+
+	// BC1-3 DDS levels are passed through as blocks instead of decoded, if supported.
+	void SetCompressedFormatsSupported(bool supported) {
+		compressedSupported_ = supported;
+	}
 
 	void NotifyTextureDecoded(const ReplacedTextureDecodeInfo &replacedInfo, const void *data, int pitch, int level, int w, int h);
 
@@ -191,9 +255,22 @@ class TextureReplacer {
 	bool LoadIni();
 	void ParseHashRange(const std::string &key, const std::string &value);
 	bool LookupHashRange(u32 addr, int &w, int &h);
+	const std::string *LookupAlias(u64 cachekey, u32 hash, int level);
 	std::string LookupHashFile(u64 cachekey, u32 hash, int level);
 	std::string HashName(u64 cachekey, u32 hash, int level);
 	void PopulateReplacement(ReplacedTexture *result, u64 cachekey, u32 hash, int w, int h);
+	bool OpenArchive(const std::string &filename);
+	void BuildPackIndex(const std::string &dir, const std::string &prefix);
+	void BuildHashFileIndex();
+	bool PackFileExists(const std::string &hashfile);
+	bool ReadPackFile(const std::string &name, std::vector<u8> &buffer, const u8 **data, size_t *size);
+	void PrepareData(ReplacedTexture *texture);
+	bool PrepareLevelPNG(ReplacedTexture *texture, int level, const std::string &name, const u8 *data, size_t size);
+	bool PrepareLevelsDDS(ReplacedTexture *texture, const std::string &name, const u8 *data, size_t size);
+
+	void QueueLoad(ReplacedTexture *texture);
+	void LoadThreadFunc();
+	void StopLoadThreads();
 
 	SimpleBuf<u32> saveBuf;
 	bool enabled_ = false;
@@ -206,8 +283,20 @@ class TextureReplacer {
 	typedef std::pair<int, int> WidthHeightPair;
 	std::unordered_map<u64, WidthHeightPair> hashranges_;
 	std::unordered_map<ReplacementAliasKey, std::string> aliases_;
+	// Every file in the pack at load time, normalized by NormalizePackPath(), so lookups don't touch the disk.
+	std::unordered_map<std::string, ReplacementPackFile> packFiles_;
+	// The files in the root of the pack named after their hash, so misses don't need to build names.
+	std::unordered_map<ReplacementAliasKey, std::string> hashFiles_;
+	std::unique_ptr<File::MappedFile> archive_;
+	bool compressedSupported_ = false;
 
 	ReplacedTexture none_;
 	std::unordered_map<ReplacementCacheKey, ReplacedTexture> cache_;
 	std::unordered_map<ReplacementCacheKey, ReplacedTextureLevel> savedCache_;
+
+	std::vector<std::thread> loadThreads_;
+	std::mutex loadLock_;
+	std::condition_variable loadCond_;
+	std::deque<ReplacedTexture *> loadQueue_;
+	bool loadStop_ = false;
 };
@@ -23,6 +23,9 @@
 #ifdef _M_SSE
 #include <emmintrin.h>
 #endif
+#ifdef HAVE_AVX2_DISPATCH
+#include <immintrin.h>
+#endif
 
 void AdjustVolumeBlockStandard(s16 *out, s16 *in, size_t size, int leftVol, int rightVol) {
 #ifdef _M_SSE
@@ -110,18 +113,91 @@ void ConvertS16ToF32(float *out, const s16 *in, size_t size) {
 	}
 }
 
-#ifndef _M_SSE
+void UnpackVagSamplesStandard(const u8 *data, int shift, s16 *out) {
+	for (int i = 0; i < 28; i += 2) {
+		u8 d = *data++;
+		out[i] = (short)((d & 0xf) << 12) >> shift;
+		out[i + 1] = (short)((d & 0xf0) << 8) >> shift;
+	}
+}
+
+#ifdef _M_SSE
+void UnpackVagSamplesSSE2(const u8 *data, int shift, s16 *out) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i highMask = _mm_set1_epi16(0x00f0);
+	const __m128i shiftCount = _mm_cvtsi32_si128(shift);
+
+	// Exactly 14 bytes: 0-7, then 6-13 moved down to get 8-13 (and zeros.)
+	__m128i bytes1 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)data), zero);
+	__m128i bytes2 = _mm_unpacklo_epi8(_mm_srli_si128(_mm_loadl_epi64((const __m128i *)(data + 6)), 2), zero);
+
+	// The low nibble is the first sample, and shifting to the top of the lane sign extends both.
+	__m128i lo1 = _mm_slli_epi16(bytes1, 12);
+	__m128i hi1 = _mm_slli_epi16(_mm_and_si128(bytes1, highMask), 8);
+	__m128i lo2 = _mm_slli_epi16(bytes2, 12);
+	__m128i hi2 = _mm_slli_epi16(_mm_and_si128(bytes2, highMask), 8);
+
+	_mm_storeu_si128((__m128i *)(out + 0), _mm_sra_epi16(_mm_unpacklo_epi16(lo1, hi1), shiftCount));
+	_mm_storeu_si128((__m128i *)(out + 8), _mm_sra_epi16(_mm_unpackhi_epi16(lo1, hi1), shiftCount));
+	_mm_storeu_si128((__m128i *)(out + 16), _mm_sra_epi16(_mm_unpacklo_epi16(lo2, hi2), shiftCount));
+	_mm_storel_epi64((__m128i *)(out + 24), _mm_sra_epi16(_mm_unpackhi_epi16(lo2, hi2), shiftCount));
+}
+
+UnpackVagSamplesFunc UnpackVagSamples = &UnpackVagSamplesSSE2;
+#else
+UnpackVagSamplesFunc UnpackVagSamples = &UnpackVagSamplesStandard;
+#endif
+
+#ifdef HAVE_AVX2_DISPATCH
+// Same lane layout as the SSE2 path, so the output is identical. Leftovers go through it too.
+TARGET_AVX2
+static void AdjustVolumeBlockAVX2(s16 *out, s16 *in, size_t size, int leftVol, int rightVol) {
+	if (leftVol <= 0x7fff && -leftVol <= 0x8000 && rightVol <= 0x7fff && -rightVol <= 0x8000) {
+		const __m256i volume = _mm256_set_epi16(leftVol, rightVol, leftVol, rightVol, leftVol, rightVol, leftVol, rightVol,
+			leftVol, rightVol, leftVol, rightVol, leftVol, rightVol, leftVol, rightVol);
+		while (size >= 32) {
+			__m256i indata1 = _mm256_loadu_si256((__m256i *)in);
+			__m256i indata2 = _mm256_loadu_si256((__m256i *)(in + 16));
+			_mm256_storeu_si256((__m256i *)out, _mm256_mulhi_epi16(indata1, volume));
+			_mm256_storeu_si256((__m256i *)(out + 16), _mm256_mulhi_epi16(indata2, volume));
+			in += 32;
+			out += 32;
+			size -= 32;
+		}
+	}
+	AdjustVolumeBlockStandard(out, in, size, leftVol, rightVol);
+}
+#endif
+
 AdjustVolumeBlockFunc AdjustVolumeBlock = &AdjustVolumeBlockStandard;
 
+#if defined(_M_SSE)
+static const char *audioFormatVariant = "SSE2";
+#else
+static const char *audioFormatVariant = "Generic";
+#endif
+
 // This has to be done after CPUDetect has done its magic.
 void SetupAudioFormats() {
+#ifdef HAVE_AVX2_DISPATCH
+	if (cpu_info.bAVX2) {
+		AdjustVolumeBlock = &AdjustVolumeBlockAVX2;
+		audioFormatVariant = "AVX2";
+	}
+#endif
 #if PPSSPP_ARCH(ARMV7) && PPSSPP_ARCH(ARM_NEON)
 	if (cpu_info.bNEON) {
 		AdjustVolumeBlock = &AdjustVolumeBlockNEON;
 	}
 #endif
+#if PPSSPP_ARCH(ARM_NEON)
+	if (cpu_info.bNEON) {
+		UnpackVagSamples = &UnpackVagSamplesNEON;
+		audioFormatVariant = "NEON";
+	}
+#endif
 }
-#else
-void SetupAudioFormats() {
+
+const char *GetAudioFormatVariant() {
+	return audioFormatVariant;
 }
-#endif
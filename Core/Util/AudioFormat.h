@@ -66,12 +66,19 @@ static inline s16 ApplySampleVolume20Bit(s16 sample, int vol20) {
 }
 
 void SetupAudioFormats();
+// Which SIMD implementation SetupAudioFormats picked, for display.
+const char *GetAudioFormatVariant();
 void AdjustVolumeBlockStandard(s16 *out, s16 *in, size_t size, int leftVol, int rightVol);
 void ConvertS16ToF32(float *ou, const s16 *in, size_t size);
 
-#ifdef _M_SSE
-#define AdjustVolumeBlock AdjustVolumeBlockStandard
-#else
 typedef void (*AdjustVolumeBlockFunc)(s16 *out, s16 *in, size_t size, int leftVol, int rightVol);
 extern AdjustVolumeBlockFunc AdjustVolumeBlock;
+
+// Unpacks the 28 4-bit samples of a VAG block (data is just past its two header bytes) into out,
+// sign extended and shifted, ready for the prediction filter.
+void UnpackVagSamplesStandard(const u8 *data, int shift, s16 *out);
+#ifdef _M_SSE
+void UnpackVagSamplesSSE2(const u8 *data, int shift, s16 *out);
 #endif
+typedef void (*UnpackVagSamplesFunc)(const u8 *data, int shift, s16 *out);
+extern UnpackVagSamplesFunc UnpackVagSamples;
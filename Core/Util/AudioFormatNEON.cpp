@@ -71,4 +71,22 @@ void AdjustVolumeBlockNEON(s16 *out, s16 *in, size_t size, int leftVol, int righ
 	}
 }
 
+void UnpackVagSamplesNEON(const u8 *data, int shift, s16 *out) {
+	const int16x8_t shiftRight = vdupq_n_s16(-shift);
+	const uint16x8_t highMask = vdupq_n_u16(0x00f0);
+
+	// Exactly 14 bytes: 0-7, then 6-13 moved down to get 8-13 (and zeros.)
+	uint16x8_t bytes1 = vmovl_u8(vld1_u8(data));
+	uint16x8_t bytes2 = vmovl_u8(vext_u8(vld1_u8(data + 6), vdup_n_u8(0), 2));
+
+	// The low nibble is the first sample, and shifting to the top of the lane sign extends both.
+	uint16x8x2_t samples1 = vzipq_u16(vshlq_n_u16(bytes1, 12), vshlq_n_u16(vandq_u16(bytes1, highMask), 8));
+	uint16x8x2_t samples2 = vzipq_u16(vshlq_n_u16(bytes2, 12), vshlq_n_u16(vandq_u16(bytes2, highMask), 8));
+
+	vst1q_s16(out + 0, vshlq_s16(vreinterpretq_s16_u16(samples1.val[0]), shiftRight));
+	vst1q_s16(out + 8, vshlq_s16(vreinterpretq_s16_u16(samples1.val[1]), shiftRight));
+	vst1q_s16(out + 16, vshlq_s16(vreinterpretq_s16_u16(samples2.val[0]), shiftRight));
+	vst1_s16(out + 24, vget_low_s16(vshlq_s16(vreinterpretq_s16_u16(samples2.val[1]), shiftRight)));
+}
+
 #endif // PPSSPP_ARCH(ARM_NEON)
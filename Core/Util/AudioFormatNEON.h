@@ -20,3 +20,4 @@
 #include "Common/CommonTypes.h"
 
 void AdjustVolumeBlockNEON(s16 *out, s16 *in, size_t size, int leftVol, int rightVol);
+void UnpackVagSamplesNEON(const u8 *data, int shift, s16 *out);
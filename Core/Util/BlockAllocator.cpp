@@ -16,6 +16,7 @@
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
 #include <cstring>
+#include <new>
 
 #include "Common/Log.h"
 #include "Common/ChunkFile.h"
@@ -23,15 +24,31 @@
 #include "Core/Util/BlockAllocator.h"
 #include "Core/Reporting.h"
 
-// Slow freaking thing but works (eventually) :)
+// The blocks are a linked list in address order, which is also the savestate format.
+// Lookups by address go through blocks_, and allocations search freeBins_, picking the same
+// block a first fit scan of the list would.
 
-BlockAllocator::BlockAllocator(int grain) : bottom_(NULL), top_(NULL), grain_(grain)
+static inline int SizeBin(u32 size)
+{
+	int bin = 0;
+	while (size >>= 1)
+		++bin;
+	return bin;
+}
+
+BlockAllocator::BlockAllocator(int grain) : bottom_(NULL), top_(NULL), grain_(grain), spare_(NULL)
 {
 }
 
 BlockAllocator::~BlockAllocator()
 {
 	Shutdown();
+	while (spare_ != NULL)
+	{
+		Block *next = spare_->next;
+		delete spare_;
+		spare_ = next;
+	}
 }
 
 void BlockAllocator::Init(u32 rangeStart, u32 rangeSize)
@@ -40,8 +57,10 @@ void BlockAllocator::Init(u32 rangeStart, u32 rangeSize)
 	rangeStart_ = rangeStart;
 	rangeSize_ = rangeSize;
 	//Initial block, covering everything
-	top_ = new Block(rangeStart_, rangeSize_, false, NULL, NULL);
+	top_ = NewBlock(rangeStart_, rangeSize_, false, NULL, NULL);
 	bottom_ = top_;
+	AddBlock(top_);
+	AddFree(top_);
 }
 
 void BlockAllocator::Shutdown()
@@ -49,10 +68,120 @@ void BlockAllocator::Shutdown()
 	while (bottom_ != NULL)
 	{
 		Block *next = bottom_->next;
-		delete bottom_;
+		DeleteBlock(bottom_);
 		bottom_ = next;
 	}
 	top_ = NULL;
+	blocks_.clear();
+	for (auto &bin : freeBins_)
+		bin.clear();
+}
+
+BlockAllocator::Block *BlockAllocator::NewBlock(u32 start, u32 size, bool taken, Block *prev, Block *next)
+{
+	if (spare_ == NULL)
+		return new Block(start, size, taken, prev, next);
+	Block *b = spare_;
+	spare_ = spare_->next;
+	return new (b) Block(start, size, taken, prev, next);
+}
+
+void BlockAllocator::DeleteBlock(Block *b)
+{
+	b->next = spare_;
+	spare_ = b;
+}
+
+void BlockAllocator::AddBlock(Block *b)
+{
+	// Empty blocks can share a start with the next one, and never contain anything anyway.
+	if (b->size != 0)
+		blocks_[b->start] = b;
+}
+
+void BlockAllocator::RemoveBlock(Block *b)
+{
+	auto it = blocks_.find(b->start);
+	if (it != blocks_.end() && it->second == b)
+		blocks_.erase(it);
+}
+
+void BlockAllocator::AddFree(Block *b)
+{
+	freeBins_[SizeBin(b->size)][b->start] = b;
+}
+
+void BlockAllocator::RemoveFree(Block *b)
+{
+	freeBins_[SizeBin(b->size)].erase(b->start);
+}
+
+void BlockAllocator::RebuildIndex()
+{
+	blocks_.clear();
+	for (auto &bin : freeBins_)
+		bin.clear();
+	for (Block *bp = bottom_; bp != NULL; bp = bp->next)
+	{
+		AddBlock(bp);
+		if (!bp->taken)
+			AddFree(bp);
+	}
+}
+
+static inline u32 AlignOffset(u32 start, u32 size, u32 blockSize, u32 grain, bool fromTop)
+{
+	if (fromTop)
+		return (start + blockSize - size) % grain;
+	u32 offset = start % grain;
+	if (offset != 0)
+		offset = grain - offset;
+	return offset;
+}
+
+BlockAllocator::Block *BlockAllocator::FindFreeBlock(u32 size, u32 grain, bool fromTop) const
+{
+	// Any block of at least this size fits no matter how it's aligned.
+	const u64 alwaysFits = (u64)size + grain - 1;
+
+	Block *best = NULL;
+	for (int bin = SizeBin(size); bin < FREE_BINS; ++bin)
+	{
+		const auto &blocks = freeBins_[bin];
+		if (blocks.empty())
+			continue;
+
+		const bool allFit = ((u64)1 << bin) >= alwaysFits;
+		if (!fromTop)
+		{
+			for (auto it = blocks.begin(); it != blocks.end(); ++it)
+			{
+				const Block &b = *it->second;
+				if (best != NULL && b.start > best->start)
+					break;
+				if (allFit || b.size >= AlignOffset(b.start, size, b.size, grain, false) + size)
+				{
+					best = it->second;
+					break;
+				}
+			}
+		}
+		else
+		{
+			for (auto it = blocks.rbegin(); it != blocks.rend(); ++it)
+			{
+				const Block &b = *it->second;
+				if (best != NULL && b.start < best->start)
+					break;
+				if (allFit || b.size >= AlignOffset(b.start, size, b.size, grain, true) + size)
+				{
+					best = it->second;
+					break;
+				}
+			}
+		}
+	}
+	return best;
 }
 
 u32 BlockAllocator::AllocAligned(u32 &size, u32 sizeGrain, u32 grain, bool fromTop, const char *tag)
@@ -72,67 +201,32 @@ u32 BlockAllocator::AllocAligned(u32 &size, u32 sizeGrain, u32 grain, bool fromT
 	// upalign size to grain
 	size = (size + sizeGrain - 1) & ~(sizeGrain - 1);
 
-	if (!fromTop)
+	Block *bp = FindFreeBlock(size, grain, fromTop);
+	if (bp != NULL)
 	{
-		//Allocate from bottom of mem
-		for (Block *bp = bottom_; bp != NULL; bp = bp->next)
+		Block &b = *bp;
+		u32 offset = AlignOffset(b.start, size, b.size, grain, fromTop);
+		u32 needed = offset + size;
+		RemoveFree(&b);
+		if (!fromTop)
 		{
-			Block &b = *bp;
-			u32 offset = b.start % grain;
-			if (offset != 0)
-				offset = grain - offset;
-			u32 needed = offset + size;
-			if (b.taken == false && b.size >= needed)
-			{
-				if (b.size == needed)
-				{
-					if (offset >= grain_)
-						InsertFreeBefore(&b, offset);
-					b.taken = true;
-					b.SetTag(tag);
-					return b.start;
-				}
-				else
-				{
-					InsertFreeAfter(&b, b.size - needed);
-					if (offset >= grain_)
-						InsertFreeBefore(&b, offset);
-					b.taken = true;
-					b.SetTag(tag);
-					return b.start;
-				}
-			}
+			//Allocate from bottom of mem
+			if (b.size != needed)
+				InsertFreeAfter(&b, b.size - needed);
+			if (offset >= grain_)
+				InsertFreeBefore(&b, offset);
 		}
-	}
-	else
-	{
-		// Allocate from top of mem.
-		for (Block *bp = top_; bp != NULL; bp = bp->prev)
+		else
 		{
-			Block &b = *bp;
-			u32 offset = (b.start + b.size - size) % grain;
-			u32 needed = offset + size;
-			if (b.taken == false && b.size >= needed)
-			{
-				if (b.size == needed)
-				{
-					if (offset >= grain_)
-						InsertFreeAfter(&b, offset);
-					b.taken = true;
-					b.SetTag(tag);
-					return b.start;
-				}
-				else
-				{
-					InsertFreeBefore(&b, b.size - needed);
-					if (offset >= grain_)
-						InsertFreeAfter(&b, offset);
-					b.taken = true;
-					b.SetTag(tag);
-					return b.start;
-				}
-			}
+			// Allocate from top of mem.
+			if (b.size != needed)
+				InsertFreeBefore(&b, b.size - needed);
+			if (offset >= grain_)
+				InsertFreeAfter(&b, offset);
 		}
+		b.taken = true;
+		b.SetTag(tag);
+		return b.start;
 	}
 
 	//Out of memory :(
@@ -191,6 +285,7 @@ u32 BlockAllocator::AllocAt(u32 position, u32 size, const char *tag)
 			//good to go
 			else if (b.start == alignedPosition)
 			{
+				RemoveFree(&b);
 				if (b.size != alignedSize)
 					InsertFreeAfter(&b, b.size - alignedSize);
 				b.taken = true;
@@ -200,6 +295,7 @@ u32 BlockAllocator::AllocAt(u32 position, u32 size, const char *tag)
 			}
 			else
 			{
+				RemoveFree(&b);
 				InsertFreeBefore(&b, alignedPosition - b.start);
 				if (b.size > alignedSize)
 					InsertFreeAfter(&b, b.size - alignedSize);
@@ -230,13 +326,16 @@ void BlockAllocator::MergeFreeBlocks(Block *fromBlock)
 	while (prev != NULL && prev->taken == false)
 	{
 		DEBUG_LOG(SCEKERNEL, "Block Alloc found adjacent free blocks - merging");
+		RemoveFree(prev);
+		RemoveBlock(fromBlock);
 		prev->size += fromBlock->size;
+		AddBlock(prev);
 		if (fromBlock->next == NULL)
 			top_ = prev;
 		else
 			fromBlock->next->prev = prev;
 		prev->next = fromBlock->next;
-		delete fromBlock;
+		DeleteBlock(fromBlock);
 		fromBlock = prev;
 		prev = fromBlock->prev;
 	}
@@ -250,9 +349,12 @@ void BlockAllocator::MergeFreeBlocks(Block *fromBlock)
 	while (next != NULL && next->taken == false)
 	{
 		DEBUG_LOG(SCEKERNEL, "Block Alloc found adjacent free blocks - merging");
+		RemoveFree(next);
+		RemoveBlock(next);
 		fromBlock->size += next->size;
+		AddBlock(fromBlock);
 		fromBlock->next = next->next;
-		delete next;
+		DeleteBlock(next);
 		next = fromBlock->next;
 	}
 
@@ -260,6 +362,7 @@ void BlockAllocator::MergeFreeBlocks(Block *fromBlock)
 		top_ = fromBlock;
 	else
 		next->prev = fromBlock;
+	AddFree(fromBlock);
 }
 
 bool BlockAllocator::Free(u32 position)
@@ -294,30 +397,39 @@ bool BlockAllocator::FreeExact(u32 position)
 	}
 }
 
+// Both expect b to not be in freeBins_, since its size changes.
 BlockAllocator::Block *BlockAllocator::InsertFreeBefore(Block *b, u32 size)
 {
-	Block *inserted = new Block(b->start, size, false, b->prev, b);
+	Block *inserted = NewBlock(b->start, size, false, b->prev, b);
 	b->prev = inserted;
 	if (inserted->prev == NULL)
 		bottom_ = inserted;
 	else
 		inserted->prev->next = inserted;
 
+	RemoveBlock(b);
 	b->start += size;
 	b->size -= size;
+	AddBlock(b);
+	AddBlock(inserted);
+	AddFree(inserted);
 	return inserted;
 }
 
 BlockAllocator::Block *BlockAllocator::InsertFreeAfter(Block *b, u32 size)
 {
-	Block *inserted = new Block(b->start + b->size - size, size, false, b, b->next);
+	Block *inserted = NewBlock(b->start + b->size - size, size, false, b, b->next);
 	b->next = inserted;
 	if (inserted->next == NULL)
 		top_ = inserted;
 	else
 		inserted->next->prev = inserted;
 
+	RemoveBlock(b);
 	b->size -= size;
+	AddBlock(b);
+	AddBlock(inserted);
+	AddFree(inserted);
 	return inserted;
 }
 
@@ -343,28 +455,20 @@ const char *BlockAllocator::GetBlockTag(u32 addr) const {
 
 inline BlockAllocator::Block *BlockAllocator::GetBlockFromAddress(u32 addr)
 {
-	for (Block *bp = bottom_; bp != NULL; bp = bp->next)
-	{
-		Block &b = *bp;
-		if (b.start <= addr && b.start + b.size > addr)
-		{
-			// Got one!
-			return bp;
-		}
-	}
-	return NULL;
+	return const_cast<Block *>(static_cast<const BlockAllocator *>(this)->GetBlockFromAddress(addr));
 }
 
 const BlockAllocator::Block *BlockAllocator::GetBlockFromAddress(u32 addr) const
 {
-	for (const Block *bp = bottom_; bp != NULL; bp = bp->next)
+	auto it = blocks_.upper_bound(addr);
+	if (it == blocks_.begin())
+		return NULL;
+	--it;
+	const Block &b = *it->second;
+	if (b.start <= addr && b.start + b.size > addr)
 	{
-		const Block &b = *bp;
-		if (b.start <= addr && b.start + b.size > addr)
-		{
-			// Got one!
-			return bp;
-		}
+		// Got one!
+		return it->second;
 	}
 	return NULL;
 }
@@ -401,13 +505,12 @@ void BlockAllocator::ListBlocks() const
 u32 BlockAllocator::GetLargestFreeBlockSize() const
 {
 	u32 maxFreeBlock = 0;
-	for (const Block *bp = bottom_; bp != NULL; bp = bp->next)
+	for (int bin = FREE_BINS - 1; bin >= 0 && maxFreeBlock == 0; --bin)
 	{
-		const Block &b = *bp;
-		if (!b.taken)
+		for (auto it : freeBins_[bin])
 		{
-			if (b.size > maxFreeBlock)
-				maxFreeBlock = b.size;
+			if (it.second->size > maxFreeBlock)
+				maxFreeBlock = it.second->size;
 		}
 	}
 	if (maxFreeBlock & (grain_ - 1))
@@ -418,13 +521,10 @@ u32 BlockAllocator::GetLargestFreeBlockSize() const
 u32 BlockAllocator::GetTotalFreeBytes() const
 {
 	u32 sum = 0;
-	for (const Block *bp = bottom_; bp != NULL; bp = bp->next)
+	for (const auto &bin : freeBins_)
 	{
-		const Block &b = *bp;
-		if (!b.taken)
-		{
-			sum += b.size;
-		}
+		for (auto it : bin)
+			sum += it.second->size;
 	}
 	if (sum & (grain_ - 1))
 		WARN_LOG_REPORT(HLE, "GetTotalFreeBytes: free size %08x does not align to grain %08x.", sum, grain_);
@@ -444,14 +544,14 @@ void BlockAllocator::DoState(PointerWrap &p)
 		Shutdown();
 		p.Do(count);
 
-		bottom_ = new Block(0, 0, false, NULL, NULL);
+		bottom_ = NewBlock(0, 0, false, NULL, NULL);
 		bottom_->DoState(p);
 		--count;
 
 		top_ = bottom_;
 		for (int i = 0; i < count; ++i)
 		{
-			top_->next = new Block(0, 0, false, top_, NULL);
+			top_->next = NewBlock(0, 0, false, top_, NULL);
 			top_->next->DoState(p);
 			top_ = top_->next;
 		}
@@ -476,6 +576,9 @@ void BlockAllocator::DoState(PointerWrap &p)
 	p.Do(rangeStart_);
 	p.Do(rangeSize_);
 	p.Do(grain_);
+
+	if (p.mode == p.MODE_READ)
+		RebuildIndex();
 }
 
 BlockAllocator::Block::Block(u32 _start, u32 _size, bool _taken, Block *_prev, Block *_next)
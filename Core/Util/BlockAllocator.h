@@ -19,6 +19,8 @@
 
 class PointerWrap;
 
+#include <map>
+
 #include "Common/CommonTypes.h"
 
 class BlockAllocator
@@ -72,6 +74,8 @@ class BlockAllocator
 		Block *next;
 	};
 
+	enum { FREE_BINS = 32 };
+
 	Block *bottom_;
 	Block *top_;
 	u32 rangeStart_;
@@ -79,9 +83,25 @@ class BlockAllocator
 
 	u32 grain_;
 
+	// Every non-empty block by start address, for lookups.
+	std::map<u32, Block *> blocks_;
+	// Free blocks by start address, binned by floor(log2(size)).
+	std::map<u32, Block *> freeBins_[FREE_BINS];
+	// Deleted blocks, reused through next.
+	Block *spare_;
+
 	void MergeFreeBlocks(Block *fromBlock);
 	Block *GetBlockFromAddress(u32 addr);
 	const Block *GetBlockFromAddress(u32 addr) const;
 	Block *InsertFreeBefore(Block *b, u32 size);
 	Block *InsertFreeAfter(Block *b, u32 size);
+	Block *FindFreeBlock(u32 size, u32 grain, bool fromTop) const;
+
+	Block *NewBlock(u32 start, u32 size, bool taken, Block *prev, Block *next);
+	void DeleteBlock(Block *b);
+	void AddBlock(Block *b);
+	void RemoveBlock(Block *b);
+	void AddFree(Block *b);
+	void RemoveFree(Block *b);
+	void RebuildIndex();
 };
@@ -16,6 +16,7 @@
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
 #include <algorithm>
+#include <map>
 
 #include "image/zim_load.h"
 #include "image/png_load.h"
@@ -68,10 +69,19 @@ static u32 dataSize = 0x10000; // should be enough for a frame of gui...
 static PSPPointer<u16_le> palette;
 static u32 paletteSize = sizeof(u16) * 16;
 
-// Vertex collector
+// Vertex collector.  PPGe only draws rectangles, and back to back draws are merged into
+// one PRIM, which is written out before the next state change.
 static u32 vertexStart;
 static u32 vertexCount;
 
+// Texture state already in the list, so repeated binds can be skipped.
+static u32 boundTexture;
+static int boundTextureWidth;
+static int boundTextureHeight;
+static bool textureEnabled;
+// Whether callers last asked for a texture.  Rects turn texturing off without changing this.
+static bool textureWanted;
+
 // Used for formating text
 struct AtlasCharVertex
 {
@@ -97,16 +107,54 @@ typedef std::vector<AtlasCharLine> AtlasLineArray;
 static AtlasCharLine char_one_line;
 static AtlasLineArray char_lines;
 static AtlasTextMetrics char_lines_metrics;
+// What PPGeDrawCurrentText draws, either char_lines or a cached layout.
+static const AtlasLineArray *current_lines = &char_lines;
+
+// Dialogs draw the same strings every frame, so line breaking is cached for a few frames.
+struct PPGeTextLayoutKey {
+	std::string text;
+	float x, y, scale;
+	int align, wrapType, wrapWidth;
+
+	bool operator <(const PPGeTextLayoutKey &other) const {
+		if (text != other.text)
+			return text < other.text;
+		if (x != other.x)
+			return x < other.x;
+		if (y != other.y)
+			return y < other.y;
+		if (scale != other.scale)
+			return scale < other.scale;
+		if (align != other.align)
+			return align < other.align;
+		if (wrapType != other.wrapType)
+			return wrapType < other.wrapType;
+		return wrapWidth < other.wrapWidth;
+	}
+};
 
-//only 0xFFFFFF of data is used
-static void WriteCmd(u8 cmd, u32 data) {
+struct PPGeTextLayout {
+	AtlasLineArray lines;
+	AtlasTextMetrics metrics;
+	int lastFrame;
+};
+
+static std::map<PPGeTextLayoutKey, PPGeTextLayout> textLayoutCache;
+static int textLayoutFrame;
+static const int TEXT_LAYOUT_MAX_AGE = 10;
+
+static void FlushVertexData();
+
+static void WriteCmdNoFlush(u8 cmd, u32 data) {
 	Memory::Write_U32((cmd << 24) | (data & 0xFFFFFF), dlWritePtr);
 	dlWritePtr += 4;
 }
 
-static void WriteCmdAddrWithBase(u8 cmd, u32 addr) {
-	WriteCmd(GE_CMD_BASE, (addr >> 8) & 0xFF0000);
-	WriteCmd(cmd, addr & 0xFFFFFF);
+//only 0xFFFFFF of data is used
+static void WriteCmd(u8 cmd, u32 data) {
+	// State changes have to come after the rectangles queued before them.
+	FlushVertexData();
+	WriteCmdNoFlush(cmd, data);
 }
 
 /*
@@ -120,8 +168,10 @@ static void WriteCmdFloat(u8 cmd, float f) {
 }*/
 
 static void BeginVertexData() {
-	vertexCount = 0;
-	vertexStart = dataWritePtr;
+	// Vertices are only ever appended, so a pending batch just keeps growing.
+	if (vertexCount == 0) {
+		vertexStart = dataWritePtr;
+	}
 }
 
 static void Vertex(float x, float y, float u, float v, int tw, int th, u32 color = 0xFFFFFFFF) {
@@ -144,8 +194,24 @@ static void Vertex(float x, float y, float u, float v, int tw, int th, u32 color
 }
 
 static void EndVertexDataAndDraw(int prim) {
-	WriteCmdAddrWithBase(GE_CMD_VADDR, vertexStart);
-	WriteCmd(GE_CMD_PRIM, (prim << 16) | vertexCount);
+	_dbg_assert_msg_(SCEGE, prim == GE_PRIM_RECTANGLES, "PPGe only batches rectangles");
+	// Drawn by FlushVertexData, once something else is written.
+}
+
+static void FlushVertexData() {
+	if (vertexCount == 0)
+		return;
+	WriteCmdNoFlush(GE_CMD_BASE, (vertexStart >> 8) & 0xFF0000);
+	WriteCmdNoFlush(GE_CMD_VADDR, vertexStart & 0xFFFFFF);
+	WriteCmdNoFlush(GE_CMD_PRIM, (GE_PRIM_RECTANGLES << 16) | vertexCount);
+	vertexCount = 0;
+}
+
+static void SetTextureEnabled(bool enabled) {
+	if (textureEnabled != enabled) {
+		WriteCmd(GE_CMD_TEXTUREMAPENABLE, enabled ? 1 : 0);
+		textureEnabled = enabled;
+	}
 }
 
 static u32 __PPGeDoAlloc(u32 &size, bool fromTop, const char *name) {
@@ -257,6 +323,8 @@ void __PPGeDoState(PointerWrap &p)
 
 	p.Do(char_lines);
 	p.Do(char_lines_metrics);
+	current_lines = &char_lines;
+	textLayoutCache.clear();
 }
 
 void __PPGeShutdown()
@@ -279,6 +347,9 @@ void __PPGeShutdown()
 	dlPtr = 0;
 	savedContextPtr = 0;
 	listArgs = 0;
+
+	textLayoutCache.clear();
+	current_lines = &char_lines;
 }
 
 void PPGeBegin()
@@ -289,6 +360,17 @@ void PPGeBegin()
 	// Reset write pointers to start of command and data buffers.
 	dlWritePtr = dlPtr;
 	dataWritePtr = dataPtr;
+	vertexCount = 0;
+
+	// Drop text layouts that haven't been drawn for a while.
+	textLayoutFrame++;
+	for (auto it = textLayoutCache.begin(); it != textLayoutCache.end(); ) {
+		if (it->second.lastFrame < textLayoutFrame - TEXT_LAYOUT_MAX_AGE) {
+			textLayoutCache.erase(it++);
+		} else {
+			++it;
+		}
+	}
 
 	// Set up the correct states for UI drawing
 	WriteCmd(GE_CMD_OFFSETADDR, 0);
@@ -305,6 +387,9 @@ void PPGeBegin()
 	WriteCmd(GE_CMD_MASKRGB, 0);
 	WriteCmd(GE_CMD_MASKALPHA, 0);
 
+	WriteCmd(GE_CMD_TEXTUREMAPENABLE, 1);
+	textureEnabled = true;
+	boundTexture = 0;
 	PPGeSetDefaultTexture();
 
 	WriteCmd(GE_CMD_SCISSOR1, (0 << 10) | 0);
@@ -327,6 +412,7 @@ void PPGeEnd()
 
 	WriteCmd(GE_CMD_FINISH, 0);
 	WriteCmd(GE_CMD_END, 0);
+	current_lines = &char_lines;
 
 	// Might've come from an old savestate.
 	__PPGeSetupListArgs();
@@ -625,8 +711,24 @@ void PPGeMeasureText(float *w, float *h, int *n,
 
 void PPGePrepareText(const char *text, float x, float y, int align, float scale, int WrapType, int wrapWidth)
 {
+	PPGeTextLayoutKey key = { text, x, y, scale, align, WrapType, wrapWidth };
+	auto it = textLayoutCache.find(key);
+	if (it != textLayoutCache.end()) {
+		it->second.lastFrame = textLayoutFrame;
+		char_lines_metrics = it->second.metrics;
+		current_lines = &it->second.lines;
+		return;
+	}
+
 	const AtlasFont &atlasfont = *ppge_atlas.fonts[0];
+	char_lines.clear();
 	char_lines_metrics = BreakLines(text, atlasfont, x, y, align, scale, WrapType, wrapWidth, false);
+
+	PPGeTextLayout &layout = textLayoutCache[key];
+	layout.lines.swap(char_lines);
+	layout.metrics = char_lines_metrics;
+	layout.lastFrame = textLayoutFrame;
+	current_lines = &layout.lines;
 }
 
 void PPGeMeasureCurrentText(float *x, float *y, float *w, float *h, int *n)
@@ -645,8 +747,9 @@ void PPGeDrawCurrentText(u32 color)
 	if (dlPtr)
 	{
 		float scale = char_lines_metrics.scale;
+		SetTextureEnabled(textureWanted);
 		BeginVertexData();
-		for (auto i = char_lines.begin(); i != char_lines.end(); ++i)
+		for (auto i = current_lines->begin(); i != current_lines->end(); ++i)
 		{
 			for (auto j = i->begin(); j != i->end(); ++j)
 			{
@@ -663,6 +766,7 @@ void PPGeDrawCurrentText(u32 color)
 	}
 	char_one_line.clear();
 	char_lines.clear();
+	current_lines = &char_lines;
 	AtlasTextMetrics zeroBox = { 0 };
 	char_lines_metrics = zeroBox;
 }
@@ -695,6 +799,7 @@ void PPGeDraw4Patch(int atlasImage, float x, float y, float w, float h, u32 colo
 	float ymid2 = y + h - bordery;
 	float x2 = x + w;
 	float y2 = y + h;
+	SetTextureEnabled(textureWanted);
 	BeginVertexData();
 	// Top row
 	Vertex(x, y, u1, v1, atlasWidth, atlasHeight, color);
@@ -725,14 +830,13 @@ void PPGeDrawRect(float x1, float y1, float x2, float y2, u32 color)
 	if (!dlPtr)
 		return;
 
-	WriteCmd(GE_CMD_TEXTUREMAPENABLE, 0);
+	// Texturing is turned back on lazily by the next textured draw, so rects batch together.
+	SetTextureEnabled(false);
 
 	BeginVertexData();
 	Vertex(x1, y1, 0, 0, 0, 0, color);
 	Vertex(x2, y2, 0, 0, 0, 0, color);
 	EndVertexDataAndDraw(GE_PRIM_RECTANGLES);
-
-	WriteCmd(GE_CMD_TEXTUREMAPENABLE, 1);
 }
 
 // Just blits an image to the screen, multiplied with the color.
@@ -744,6 +848,7 @@ void PPGeDrawImage(int atlasImage, float x, float y, int align, u32 color)
 	const AtlasImage &img = ppge_atlas.images[atlasImage];
 	float w = img.w;
 	float h = img.h;
+	SetTextureEnabled(textureWanted);
 	BeginVertexData();
 	Vertex(x, y, img.u1, img.v1, atlasWidth, atlasHeight, color);
 	Vertex(x + w, y + h, img.u2, img.v2, atlasWidth, atlasHeight, color);
@@ -756,6 +861,7 @@ void PPGeDrawImage(int atlasImage, float x, float y, float w, float h, int align
 		return;
 
 	const AtlasImage &img = ppge_atlas.images[atlasImage];
+	SetTextureEnabled(textureWanted);
 	BeginVertexData();
 	Vertex(x, y, img.u1, img.v1, atlasWidth, atlasHeight, color);
 	Vertex(x + w, y + h, img.u2, img.v2, atlasWidth, atlasHeight, color);
@@ -766,6 +872,7 @@ void PPGeDrawImage(float x, float y, float w, float h, float u1, float v1, float
 {
 	if (!dlPtr)
 		return;
+	SetTextureEnabled(textureWanted);
 	BeginVertexData();
 	Vertex(x, y, u1, v1, tw, th, color);
 	Vertex(x + w, y + h, u2, v2, tw, th, color);
@@ -788,7 +895,13 @@ int GetPow2(int x)
 
 void PPGeSetDefaultTexture()
 {
-	WriteCmd(GE_CMD_TEXTUREMAPENABLE, 1);
+	textureWanted = true;
+	if (boundTexture == atlasPtr && boundTextureWidth == atlasWidth && boundTextureHeight == atlasHeight)
+		return;
+	boundTexture = atlasPtr;
+	boundTextureWidth = atlasWidth;
+	boundTextureHeight = atlasHeight;
+
 	int wp2 = GetPow2(atlasWidth);
 	int hp2 = GetPow2(atlasHeight);
 	WriteCmd(GE_CMD_CLUTADDR, palette.ptr & 0xFFFFF0);
@@ -809,7 +922,13 @@ void PPGeSetDefaultTexture()
 
 void PPGeSetTexture(u32 dataAddr, int width, int height)
 {
-	WriteCmd(GE_CMD_TEXTUREMAPENABLE, 1);
+	textureWanted = true;
+	if (boundTexture == dataAddr && boundTextureWidth == width && boundTextureHeight == height)
+		return;
+	boundTexture = dataAddr;
+	boundTextureWidth = width;
+	boundTextureHeight = height;
+
 	int wp2 = GetPow2(width);
 	int hp2 = GetPow2(height);
 	WriteCmd(GE_CMD_TEXSIZE0, wp2 | (hp2 << 8));
@@ -826,7 +945,7 @@ void PPGeSetTexture(u32 dataAddr, int width, int height)
 
 void PPGeDisableTexture()
 {
-	WriteCmd(GE_CMD_TEXTUREMAPENABLE, 0);
+	textureWanted = false;
 }
 
 std::vector<PPGeImage *> PPGeImage::loadedTextures_;
@@ -878,6 +997,8 @@ bool PPGeImage::Load() {
 
 	Memory::Memcpy(texture_, textureData, texSize);
 	free(textureData);
+	// The address may have been another image earlier in this list.
+	boundTexture = 0;
 
 	lastFrame_ = gpuStats.numFlips;
 	loadedTextures_.push_back(this);
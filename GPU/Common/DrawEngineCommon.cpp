@@ -16,10 +16,12 @@
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
 #include <algorithm>
+#include <cstdint>
 
 #include "profiler/profiler.h"
 #include "Common/ColorConv.h"
 #include "Core/Config.h"
+#include "Core/MemMap.h"
 #include "GPU/Common/DrawEngineCommon.h"
 #include "GPU/Common/SplineCommon.h"
 #include "GPU/Common/VertexDecoderCommon.h"
@@ -27,6 +29,13 @@
 #include "GPU/ge_constants.h"
 #include "GPU/GPUState.h"
 
+#if defined(_M_SSE)
+#include <emmintrin.h>
+#endif
+#if PPSSPP_ARCH(ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 #define QUAD_INDICES_MAX 65536
 
 enum {
@@ -50,6 +59,65 @@ DrawEngineCommon::~DrawEngineCommon() {
 	});
 }
 
+void BufferSubAllocator::Reset(u32 size) {
+	size_ = size;
+	freeRanges_.clear();
+	if (size)
+		freeRanges_[0] = size;
+}
+
+bool BufferSubAllocator::Alloc(u32 size, u32 align, u32 *offset) {
+	if (size == 0)
+		return false;
+	auto best = freeRanges_.end();
+	u32 bestWaste = 0xFFFFFFFF;
+	for (auto it = freeRanges_.begin(); it != freeRanges_.end(); ++it) {
+		u32 start = (it->first + align - 1) & ~(align - 1);
+		u32 pad = start - it->first;
+		if (it->second < pad + size)
+			continue;
+		u32 waste = it->second - size;
+		if (waste < bestWaste) {
+			best = it;
+			bestWaste = waste;
+			if (waste == pad)
+				break;
+		}
+	}
+	if (best == freeRanges_.end())
+		return false;
+
+	u32 rangeStart = best->first;
+	u32 rangeEnd = best->first + best->second;
+	u32 start = (rangeStart + align - 1) & ~(align - 1);
+	freeRanges_.erase(best);
+	// Keep the alignment padding and the tail around as free ranges.
+	if (start > rangeStart)
+		freeRanges_[rangeStart] = start - rangeStart;
+	if (start + size < rangeEnd)
+		freeRanges_[start + size] = rangeEnd - (start + size);
+	*offset = start;
+	return true;
+}
+
+void BufferSubAllocator::Free(u32 offset, u32 size) {
+	if (size == 0)
+		return;
+	auto next = freeRanges_.lower_bound(offset);
+	if (next != freeRanges_.end() && offset + size == next->first) {
+		size += next->second;
+		next = freeRanges_.erase(next);
+	}
+	if (next != freeRanges_.begin()) {
+		auto prev = std::prev(next);
+		if (prev->first + prev->second == offset) {
+			prev->second += size;
+			return;
+		}
+	}
+	freeRanges_[offset] = size;
+}
+
 VertexDecoder *DrawEngineCommon::GetVertexDecoder(u32 vtype) {
 	VertexDecoder *dec = decoderMap_.Get(vtype);
 	if (dec)
@@ -127,7 +195,7 @@ std::string DrawEngineCommon::DebugGetVertexLoaderString(std::string id, DebugSh
 struct Plane {
 	float x, y, z, w;
 	void Set(float _x, float _y, float _z, float _w) { x = _x; y = _y; z = _z; w = _w; }
-	float Test(float f[3]) const { return x * f[0] + y * f[1] + z * f[2] + w; }
+	float Test(const float f[3]) const { return x * f[0] + y * f[1] + z * f[2] + w; }
 };
 
 static void PlanesFromMatrix(float mtx[16], Plane planes[6]) {
@@ -182,16 +250,97 @@ u32 DrawEngineCommon::NormalizeVertices(u8 *outPtr, u8 *bufPtr, const u8 *inPtr,
 	return DrawEngineCommon::NormalizeVertices(outPtr, bufPtr, inPtr, dec, lowerBound, upperBound, vertType);
 }
 
-// This code has plenty of potential for optimization.
-//
+// Returns true if every one of the six planes has at least one of the positions on its inside.
+// Positions are three floats each, stride bytes apart. Exits as soon as that's settled, which for
+// visible boxes usually happens within the first couple of corners.
+static bool AnyInsideAllPlanes(const Plane planes[6], const float *pos, int stride, int count) {
+	const u8 *ptr = (const u8 *)pos;
+#if defined(_M_SSE)
+	// Planes 0-3 in one set of registers, 4-5 (twice) in the other, one plane per lane.
+	const __m128 ax = _mm_setr_ps(planes[0].x, planes[1].x, planes[2].x, planes[3].x);
+	const __m128 ay = _mm_setr_ps(planes[0].y, planes[1].y, planes[2].y, planes[3].y);
+	const __m128 az = _mm_setr_ps(planes[0].z, planes[1].z, planes[2].z, planes[3].z);
+	const __m128 aw = _mm_setr_ps(planes[0].w, planes[1].w, planes[2].w, planes[3].w);
+	const __m128 bx = _mm_setr_ps(planes[4].x, planes[5].x, planes[4].x, planes[5].x);
+	const __m128 by = _mm_setr_ps(planes[4].y, planes[5].y, planes[4].y, planes[5].y);
+	const __m128 bz = _mm_setr_ps(planes[4].z, planes[5].z, planes[4].z, planes[5].z);
+	const __m128 bw = _mm_setr_ps(planes[4].w, planes[5].w, planes[4].w, planes[5].w);
+	const __m128 zero = _mm_setzero_ps();
+	int inside = 0;
+	for (int i = 0; i < count; i++, ptr += stride) {
+		const float *v = (const float *)ptr;
+		const __m128 x = _mm_set1_ps(v[0]);
+		const __m128 y = _mm_set1_ps(v[1]);
+		const __m128 z = _mm_set1_ps(v[2]);
+		__m128 a = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, x), _mm_mul_ps(ay, y)), _mm_mul_ps(az, z)), aw);
+		__m128 b = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(bx, x), _mm_mul_ps(by, y)), _mm_mul_ps(bz, z)), bw);
+		// "Not less than" rather than >= so that NaN counts as inside, like the scalar test.
+		inside |= _mm_movemask_ps(_mm_cmpnlt_ps(a, zero)) | (_mm_movemask_ps(_mm_cmpnlt_ps(b, zero)) << 4);
+		if ((inside & 0x3F) == 0x3F)
+			return true;
+	}
+	return false;
+#elif PPSSPP_ARCH(ARM_NEON)
+	// Planes 0-3 and 4-5 (twice) split by component, same layout as the SSE path.
+	float soa[8][4];
+	for (int i = 0; i < 4; i++) {
+		const Plane &a = planes[i];
+		const Plane &b = planes[4 + (i & 1)];
+		soa[0][i] = a.x; soa[1][i] = a.y; soa[2][i] = a.z; soa[3][i] = a.w;
+		soa[4][i] = b.x; soa[5][i] = b.y; soa[6][i] = b.z; soa[7][i] = b.w;
+	}
+	const float32x4_t ax = vld1q_f32(soa[0]);
+	const float32x4_t ay = vld1q_f32(soa[1]);
+	const float32x4_t az = vld1q_f32(soa[2]);
+	const float32x4_t aw = vld1q_f32(soa[3]);
+	const float32x4_t bx = vld1q_f32(soa[4]);
+	const float32x4_t by = vld1q_f32(soa[5]);
+	const float32x4_t bz = vld1q_f32(soa[6]);
+	const float32x4_t bw = vld1q_f32(soa[7]);
+	const float32x4_t zero = vdupq_n_f32(0.0f);
+	// Lanes are all ones for planes that have something outside so far.
+	uint32x4_t outA = vdupq_n_u32(0xFFFFFFFF);
+	uint32x4_t outB = vdupq_n_u32(0xFFFFFFFF);
+	for (int i = 0; i < count; i++, ptr += stride) {
+		const float *v = (const float *)ptr;
+		float32x4_t a = vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(aw, ax, v[0]), ay, v[1]), az, v[2]);
+		float32x4_t b = vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(bw, bx, v[0]), by, v[1]), bz, v[2]);
+		outA = vandq_u32(outA, vcltq_f32(a, zero));
+		outB = vandq_u32(outB, vcltq_f32(b, zero));
+		// Checking every vertex costs more than it saves, the cross-lane reduction is slow here.
+		if ((i & 3) == 3) {
+			uint32x2_t any = vorr_u32(vget_low_u32(outA), vget_high_u32(outA));
+			any = vorr_u32(any, vget_low_u32(outB));
+			if ((vget_lane_u32(any, 0) | vget_lane_u32(any, 1)) == 0)
+				return true;
+		}
+	}
+	uint32x2_t any = vorr_u32(vget_low_u32(outA), vget_high_u32(outA));
+	any = vorr_u32(any, vget_low_u32(outB));
+	return (vget_lane_u32(any, 0) | vget_lane_u32(any, 1)) == 0;
+#else
+	int inside = 0;
+	for (int i = 0; i < count; i++, ptr += stride) {
+		const float *v = (const float *)ptr;
+		for (int plane = 0; plane < 6; plane++) {
+			if (!(planes[plane].Test(v) < 0.0f))
+				inside |= 1 << plane;
+		}
+		if (inside == 0x3F)
+			return true;
+	}
+	return false;
+#endif
+}
+
 // It does the simplest and safest test possible: If all points of a bbox is outside a single of
 // our clipping planes, we reject the box. Tighter bounds would be desirable but would take more calculations.
 bool DrawEngineCommon::TestBoundingBox(void* control_points, int vertexCount, u32 vertType, int *bytesRead) {
 	SimpleVertex *corners = (SimpleVertex *)(decoded + 65536 * 12);
 	float *verts = (float *)(decoded + 65536 * 18);
+	int stride = 3 * sizeof(float);
 
-	// Try to skip NormalizeVertices if it's pure positions. No need to bother with a vertex decoder
-	// and a large vertex format.
+	// Try to skip the vertex decoder if it's pure positions. No need to bother with a large vertex format.
 	if ((vertType & 0xFFFFFF) == GE_VTYPE_POS_FLOAT) {
 		verts = (float *)control_points;
 		*bytesRead = 3 * sizeof(float) * vertexCount;
@@ -207,8 +356,20 @@ bool DrawEngineCommon::TestBoundingBox(void* control_points, int vertexCount, u3
 			verts[i] = vtx[i] * (1.0f / 32768.0f);
 		}
 		*bytesRead = 3 * sizeof(s16) * vertexCount;
+	} else if ((vertType & GE_VTYPE_THROUGH_MASK) == 0) {
+		// Let the (usually jitted) decoder do the work, it already handles morph and always outputs
+		// float positions outside through mode. Then test those in place instead of going via SimpleVertex.
+		const u32 vertTypeID = (vertType & 0xFFFFFF) | (gstate.getUVGenMode() << 24);
+		VertexDecoder *dec = GetVertexDecoder(vertTypeID);
+		u8 *temp_buffer = decoded + 65536 * 24;
+		dec->DecodeVerts(temp_buffer, control_points, 0, vertexCount - 1);
+		const DecVtxFormat &decFmt = dec->GetDecVtxFmt();
+		_dbg_assert_(G3D, decFmt.posfmt == DEC_FLOAT_3);
+		verts = (float *)(temp_buffer + decFmt.posoff);
+		stride = decFmt.stride;
+		*bytesRead = dec->VertexSize() * vertexCount;
 	} else {
-		// Simplify away bones and morph before proceeding
+		// Through mode positions need converting, leave that to NormalizeVertices.
 		u8 *temp_buffer = decoded + 65536 * 24;
 		int vertexSize = 0;
 		NormalizeVertices((u8 *)corners, temp_buffer, (u8 *)control_points, 0, vertexCount, vertType, &vertexSize);
@@ -220,36 +381,30 @@ bool DrawEngineCommon::TestBoundingBox(void* control_points, int vertexCount, u3
 		*bytesRead = vertexSize * vertexCount;
 	}
 
-	Plane planes[6];
-
-	float world[16];
-	float view[16];
-	float worldview[16];
-	float worldviewproj[16];
-	ConvertMatrix4x3To4x4(world, gstate.worldMatrix);
-	ConvertMatrix4x3To4x4(view, gstate.viewMatrix);
-	Matrix4ByMatrix4(worldview, world, view);
-	Matrix4ByMatrix4(worldviewproj, worldview, gstate.projMatrix);
-	PlanesFromMatrix(worldviewproj, planes);
-	for (int plane = 0; plane < 6; plane++) {
-		int inside = 0;
-		int out = 0;
-		for (int i = 0; i < vertexCount; i++) {
-			// Here we can test against the frustum planes!
-			float value = planes[plane].Test(verts + i * 3);
-			if (value < 0)
-				out++;
-			else
-				inside++;
-		}
-
-		if (inside == 0) {
-			// All out
-			return false;
-		}
+	// Boxes usually come in runs under the same matrices, so only rebuild the planes when they change.
+	float *lastWorld = bboxMatrices_;
+	float *lastView = bboxMatrices_ + 12;
+	float *lastProj = bboxMatrices_ + 24;
+	if (!bboxPlanesValid_ || memcmp(lastWorld, gstate.worldMatrix, 12 * sizeof(float)) != 0 || memcmp(lastView, gstate.viewMatrix, 12 * sizeof(float)) != 0 || memcmp(lastProj, gstate.projMatrix, 16 * sizeof(float)) != 0) {
+		memcpy(lastWorld, gstate.worldMatrix, 12 * sizeof(float));
+		memcpy(lastView, gstate.viewMatrix, 12 * sizeof(float));
+		memcpy(lastProj, gstate.projMatrix, 16 * sizeof(float));
+		float world[16];
+		float view[16];
+		float worldview[16];
+		float worldviewproj[16];
+		ConvertMatrix4x3To4x4(world, gstate.worldMatrix);
+		ConvertMatrix4x3To4x4(view, gstate.viewMatrix);
+		Matrix4ByMatrix4(worldview, world, view);
+		Matrix4ByMatrix4(worldviewproj, worldview, gstate.projMatrix);
+		PlanesFromMatrix(worldviewproj, (Plane *)bboxPlanes_);
+		bboxPlanesValid_ = true;
+	}
 
-		// Any out. For testing that the planes are in the right locations.
-		// if (out != 0) return false;
+	gpuStats.numBBoxTests++;
+	if (!AnyInsideAllPlanes((const Plane *)bboxPlanes_, verts, stride, vertexCount)) {
+		gpuStats.numBBoxCulled++;
+		return false;
 	}
 	return true;
 }
@@ -605,10 +760,120 @@ ReliableHashType DrawEngineCommon::ComputeHash() {
 	return fullhash;
 }
 
+void DrawEngineCommon::NotifyMemWrite(u32 addr, int size) {
+	MemWrite &w = memWrites_[memWriteSeq_ % MAX_TRACKED_MEM_WRITES];
+	if (size <= 0) {
+		w.start = 0;
+		w.end = 0xFFFFFFFF;
+	} else {
+		w.start = addr & 0x3FFFFFFF;
+		w.end = w.start + size;
+	}
+	memWriteSeq_++;
+}
+
+bool DrawEngineCommon::VertexArrayWritten(const VertexArrayInfoCommon *vai) const {
+	const u32 pending = memWriteSeq_ - vai->writeSeq;
+	if (pending == 0)
+		return false;
+	// Too many to know, assume the worst.
+	if (pending > MAX_TRACKED_MEM_WRITES)
+		return true;
+	for (u32 seq = vai->writeSeq; seq != memWriteSeq_; ++seq) {
+		const MemWrite &w = memWrites_[seq % MAX_TRACKED_MEM_WRITES];
+		if (w.start < vai->endAddr && vai->startAddr < w.end)
+			return true;
+	}
+	return false;
+}
+
+void DrawEngineCommon::SetupNewVertexArray(VertexArrayInfoCommon *vai) {
+	vai->hash = ComputeHash();
+	vai->minihash = ComputeMiniHash();
+	vai->status = VertexArrayInfoCommon::VAI_HASHING;
+	vai->drawsUntilNextFullHash = 0;
+	gpuStats.numVertexCacheMisses++;
+
+	// Remember which memory this came from. Splines and such decode from our own buffers, those are never written.
+	const int vertexSize = dec_->VertexSize();
+	const int indexSize = IndexSize(dec_->VertexType());
+	uintptr_t lo = UINTPTR_MAX;
+	uintptr_t hi = 0;
+	for (int i = 0; i < numDrawCalls; i++) {
+		const DeferredDrawCall &dc = drawCalls[i];
+		uintptr_t start = (uintptr_t)dc.verts + vertexSize * dc.indexLowerBound;
+		lo = std::min(lo, start);
+		hi = std::max(hi, start + vertexSize * (dc.indexUpperBound - dc.indexLowerBound + 1));
+		if (dc.inds) {
+			lo = std::min(lo, (uintptr_t)dc.inds);
+			hi = std::max(hi, (uintptr_t)dc.inds + indexSize * dc.vertexCount);
+		}
+	}
+	const uintptr_t base = (uintptr_t)Memory::base;
+	if (lo >= base && lo < hi && (u64)(hi - base) <= 0xFFFFFFFFULL) {
+		vai->startAddr = (u32)(lo - base) & 0x3FFFFFFF;
+		vai->endAddr = vai->startAddr + (u32)(hi - lo);
+	} else {
+		vai->startAddr = 0;
+		vai->endAddr = 0;
+	}
+	vai->writeSeq = memWriteSeq_;
+}
+
+bool DrawEngineCommon::CheckVertexArray(VertexArrayInfoCommon *vai, int maxDrawsBetweenFullHash) {
+	vai->numDraws++;
+	if (vai->lastFrame != gpuStats.numFlips) {
+		vai->numFrames++;
+	}
+	// A known write over the data means we can't trust the backoff.
+	if (vai->drawsUntilNextFullHash != 0 && VertexArrayWritten(vai)) {
+		vai->drawsUntilNextFullHash = 0;
+	}
+	vai->writeSeq = memWriteSeq_;
+
+	if (vai->drawsUntilNextFullHash == 0) {
+		// Let's try to skip a full hash if mini would fail.
+		const u32 newMiniHash = ComputeMiniHash();
+		ReliableHashType newHash = vai->hash;
+		if (newMiniHash == vai->minihash) {
+			newHash = ComputeHash();
+		}
+		if (newMiniHash != vai->minihash || newHash != vai->hash) {
+			gpuStats.numVertexCacheMisses++;
+			return false;
+		}
+		if (vai->numVerts > 64) {
+			// exponential backoff up to the max, then every maxDrawsBetweenFullHash
+			vai->drawsUntilNextFullHash = std::min(maxDrawsBetweenFullHash, vai->numFrames);
+		} else {
+			// Lower numbers seem much more likely to change.
+			vai->drawsUntilNextFullHash = 0;
+		}
+		// TODO: tweak
+		//if (vai->numFrames > 1000) {
+		//	vai->status = VertexArrayInfo::VAI_RELIABLE;
+		//}
+	} else {
+		vai->drawsUntilNextFullHash--;
+		u32 newMiniHash = ComputeMiniHash();
+		if (newMiniHash != vai->minihash) {
+			gpuStats.numVertexCacheMisses++;
+			return false;
+		}
+	}
+	return true;
+}
+
 // vertTypeID is the vertex type but with the UVGen mode smashed into the top bits.
 void DrawEngineCommon::SubmitPrim(void *verts, void *inds, GEPrimitiveType prim, int vertexCount, u32 vertTypeID, int *bytesRead) {
-	if (!indexGen.PrimCompatible(prevPrim_, prim) || numDrawCalls >= MAX_DEFERRED_DRAW_CALLS || vertexCountInDrawCalls_ + vertexCount > VERTEX_BUFFER_MAX) {
-		DispatchFlush();
+	if (numDrawCalls) {
+		if (!indexGen.PrimCompatible(prevPrim_, prim)) {
+			gpuStats.numPrimFlushes++;
+			DispatchFlush();
+		} else if (numDrawCalls >= MAX_DEFERRED_DRAW_CALLS || vertexCountInDrawCalls_ + vertexCount > VERTEX_BUFFER_MAX) {
+			gpuStats.numFullFlushes++;
+			DispatchFlush();
+		}
 	}
 
 	// TODO: Is this the right thing to do?
@@ -656,8 +921,11 @@ void DrawEngineCommon::SubmitPrim(void *verts, void *inds, GEPrimitiveType prim,
 	vertexCountInDrawCalls_ += vertexCount;
 
 	if (vertTypeID & GE_VTYPE_WEIGHT_MASK) {
+		// Decoded now with the current bones, so bone changes never need to flush.
 		DecodeVertsStep(decoded, decodeCounter_, decodedVerts_);
 		decodeCounter_++;
+		gpuStats.numSkinnedDrawCalls++;
+		gpuStats.numSkinnedVerts += dc.indexUpperBound - dc.indexLowerBound + 1;
 	}
 
 	if (prim == GE_PRIM_RECTANGLES && (gstate.getTextureAddress(0) & 0x3FFFFFFF) == (gstate.getFrameBufAddress() & 0x3FFFFFFF)) {
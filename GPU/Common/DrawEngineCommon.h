@@ -17,12 +17,14 @@
 
 #pragma once
 
+#include <map>
 #include <vector>
 #include <unordered_map>
 
 #include "Common/CommonTypes.h"
 #include "Common/Hashmaps.h"
 
+#include "GPU/GPU.h"
 #include "GPU/GPUState.h"
 #include "GPU/Common/GPUDebugInterface.h"
 #include "GPU/Common/IndexGenerator.h"
@@ -50,6 +52,70 @@ inline uint32_t GetVertTypeID(uint32_t vertType, int uvGenMode) {
 	return (vertType & 0xFFFFFF) | (uvGenMode << 24);
 }
 
+// The parts of a cached vertex array that don't depend on the backend. Each backend's
+// VertexArrayInfo derives from this and adds its buffers.
+// Try to keep this POD.
+class VertexArrayInfoCommon {
+public:
+	VertexArrayInfoCommon() {
+		lastFrame = gpuStats.numFlips;
+	}
+
+	enum Status : uint8_t {
+		VAI_NEW,
+		VAI_HASHING,
+		VAI_RELIABLE,  // cache, don't hash
+		VAI_UNRELIABLE,  // never cache
+	};
+
+	ReliableHashType hash = 0;
+	u32 minihash = 0;
+
+	// PSP memory the draws read from, checked against notified writes.
+	u32 startAddr = 0;
+	u32 endAddr = 0;
+	u32 writeSeq = 0;
+
+	// Precalculated parameter for drawRangeElements
+	u16 numVerts = 0;
+	u16 maxIndex = 0;
+	s8 prim = GE_PRIM_INVALID;
+	Status status = VAI_NEW;
+
+	// ID information
+	int numDraws = 0;
+	int numFrames = 0;
+	int lastFrame;  // So that we can forget.
+	u16 drawsUntilNextFullHash = 0;
+	u8 flags = 0;
+};
+
+// Hands out ranges of one fixed size GPU buffer, so the vertex cache can pack many small
+// cached arrays into a few big buffers instead of creating a buffer object per array.
+// Best fit, and neighbouring free ranges are merged back together on Free.
+class BufferSubAllocator {
+public:
+	explicit BufferSubAllocator(u32 size = 0) {
+		Reset(size);
+	}
+
+	void Reset(u32 size);
+	bool Alloc(u32 size, u32 align, u32 *offset);
+	void Free(u32 offset, u32 size);
+
+	bool IsEmpty() const {
+		return freeRanges_.size() == 1 && freeRanges_.begin()->second == size_;
+	}
+	u32 Size() const {
+		return size_;
+	}
+
+private:
+	u32 size_ = 0;
+	// offset -> size, never touching each other.
+	std::map<u32, u32> freeRanges_;
+};
+
 class DrawEngineCommon {
 public:
 	DrawEngineCommon();
@@ -90,6 +156,10 @@ class DrawEngineCommon {
 
 	VertexDecoder *GetVertexDecoder(u32 vtype);
 
+	// Called when something other than the CPU's own stores (memcpy, DMA, ...) writes to PSP memory,
+	// so cached vertex arrays in that range get rehashed on their next draw. size <= 0 means everything.
+	void NotifyMemWrite(u32 addr, int size);
+
 protected:
 	virtual void ClearTrackedVertexArrays() {}
 
@@ -103,6 +173,12 @@ class DrawEngineCommon {
 	u32 ComputeMiniHash();
 	ReliableHashType ComputeHash();
 
+	// Shared vertex cache logic. SetupNewVertexArray hashes a never seen draw, CheckVertexArray
+	// decides whether a hashing one still matches (false means mark it unreliable and decode.)
+	void SetupNewVertexArray(VertexArrayInfoCommon *vai);
+	bool CheckVertexArray(VertexArrayInfoCommon *vai, int maxDrawsBetweenFullHash);
+	bool VertexArrayWritten(const VertexArrayInfoCommon *vai) const;
+
 	// Vertex decoding
 	void DecodeVertsStep(u8 *dest, int &i, int &decodedVerts);
 
@@ -162,12 +238,29 @@ class DrawEngineCommon {
 	// Fixed index buffer for easy quad generation from spline/bezier
 	u16 *quadIndices_ = nullptr;
 
+	// Recent memory writes, for the vertex cache.
+	enum { MAX_TRACKED_MEM_WRITES = 64 };
+	struct MemWrite {
+		u32 start;
+		u32 end;
+	};
+	MemWrite memWrites_[MAX_TRACKED_MEM_WRITES];
+	u32 memWriteSeq_ = 0;
+
+	// Frustum planes for TestBoundingBox, and the world, view and proj matrices they were made from.
+	float bboxMatrices_[12 + 12 + 16];
+	float bboxPlanes_[6 * 4];
+	bool bboxPlanesValid_ = false;
+
 	// Shader blending state
 	bool fboTexNeedBind_ = false;
 	bool fboTexBound_ = false;
 
 	// Hardware tessellation
 	int numPatches;
+	// What the instanced mesh in splineBuffer/quadIndices_ was last built for, 0 if they hold something else.
+	u32 tessGridKey_ = 0;
+	int tessGridCount_ = 0;
 	class TessellationDataTransfer {
 	protected:
 		// TODO: These aren't used by all backends.
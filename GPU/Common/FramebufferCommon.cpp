@@ -23,6 +23,7 @@
 #include "ext/native/thin3d/thin3d.h"
 #include "base/timeutil.h"
 #include "gfx_es2/gpu_features.h"
+#include "math/math_util.h"
 
 #include "i18n/i18n.h"
 #include "Common/ColorConv.h"
@@ -116,6 +117,7 @@ void CenterDisplayOutputRect(float *x, float *y, float *w, float *h, float origW
 FramebufferManagerCommon::FramebufferManagerCommon(Draw::DrawContext *draw)
 	: draw_(draw),
 		displayFormat_(GE_FORMAT_565) {
+	std::fill(postShaderScale_, postShaderScale_ + MAX_POST_SHADER_PASSES, 1.0f);
 	UpdateSize();
 }
 
@@ -138,6 +140,7 @@ FramebufferManagerCommon::~FramebufferManagerCommon() {
 	bvfbs_.clear();
 
 	SetNumExtraFBOs(0);
+	ClearFramebufferPool();
 }
 
 void FramebufferManagerCommon::Init() {
@@ -161,9 +164,64 @@ bool FramebufferManagerCommon::UpdateSize() {
 
 void FramebufferManagerCommon::BeginFrame() {
 	DecimateFBOs();
+	UpdateDynamicResolution();
 	currentRenderVfb_ = nullptr;
 }
 
+// GPU time we try to stay under, leaving some headroom in a 60 Hz frame.
+static const float DYNAMIC_RESOLUTION_TARGET_MS = 1000.0f / 60.0f * 0.85f;
+// Scales move in steps of this, and wait a bit between changes so timings can settle.
+static const float DYNAMIC_RESOLUTION_STEP = 0.125f;
+static const int DYNAMIC_RESOLUTION_HOLD_FRAMES = 30;
+
+void FramebufferManagerCommon::UpdateDynamicResolution() {
+	float gpuMs = draw_->GetGPUFrameTime();
+	if (!g_Config.bDynamicResolution || !useBufferedRendering_ || gpuMs <= 0.0f) {
+		// Backends without timestamp queries report 0, and simply stay at full resolution.
+		if (dynamicScale_ != 1.0f)
+			SetDynamicScale(1.0f);
+		dynamicFrameTime_ = 0.0f;
+		return;
+	}
+
+	dynamicFrameTime_ = dynamicFrameTime_ == 0.0f ? gpuMs : dynamicFrameTime_ * 0.8f + gpuMs * 0.2f;
+	if (gpuStats.numFlips - dynamicScaleChangeFrame_ < DYNAMIC_RESOLUTION_HOLD_FRAMES)
+		return;
+
+	float minScale = clamp_value(g_Config.iDynamicResolutionMinScale, 25, 100) / 100.0f;
+	float scale = dynamicScale_;
+	if (dynamicFrameTime_ > DYNAMIC_RESOLUTION_TARGET_MS) {
+		scale = std::max(minScale, scale - DYNAMIC_RESOLUTION_STEP);
+	} else if (scale < 1.0f) {
+		// Pixel cost goes with the area. Only step up if the estimate still leaves some room.
+		float up = std::min(1.0f, scale + DYNAMIC_RESOLUTION_STEP);
+		float estimate = dynamicFrameTime_ * (up * up) / (scale * scale);
+		if (estimate < DYNAMIC_RESOLUTION_TARGET_MS * 0.9f)
+			scale = up;
+	}
+	if (scale != dynamicScale_) {
+		SetDynamicScale(scale);
+	}
+}
+
+void FramebufferManagerCommon::SetDynamicScale(float scale) {
+	INFO_LOG(FRAMEBUF, "Dynamic resolution: %0.3f -> %0.3f (%0.2f ms GPU)", dynamicScale_, scale, dynamicFrameTime_);
+	dynamicScale_ = scale;
+	dynamicScaleChangeFrame_ = gpuStats.numFlips;
+
+	// ResizeFramebufFBO scales the old contents into the new FBO, so games reading back the previous
+	// frame keep working.
+	for (VirtualFramebuffer *vfb : vfbs_) {
+		if (!vfb->fbo)
+			continue;
+		VirtualFramebuffer sized = *vfb;
+		SetRenderSize(&sized);
+		if (sized.renderWidth != vfb->renderWidth || sized.renderHeight != vfb->renderHeight) {
+			ResizeFramebufFBO(vfb, vfb->bufferWidth, vfb->bufferHeight, true);
+		}
+	}
+}
+
 void FramebufferManagerCommon::SetDisplayFramebuffer(u32 framebuf, u32 stride, GEBufferFormat format) {
 	displayFramebufPtr_ = framebuf;
 	displayStride_ = stride;
@@ -199,7 +257,8 @@ bool FramebufferManagerCommon::ShouldDownloadFramebuffer(const VirtualFramebuffe
 
 void FramebufferManagerCommon::SetNumExtraFBOs(int num) {
 	for (size_t i = 0; i < extraFBOs_.size(); i++) {
-		extraFBOs_[i]->ReleaseAssertLast();
+		if (extraFBOs_[i])
+			extraFBOs_[i]->ReleaseAssertLast();
 	}
 	extraFBOs_.clear();
 	for (int i = 0; i < num; i++) {
@@ -210,6 +269,22 @@ void FramebufferManagerCommon::SetNumExtraFBOs(int num) {
 	currentRenderVfb_ = 0;
 }
 
+Draw::Framebuffer *FramebufferManagerCommon::GetPostShaderFBO(int pass, int w, int h) {
+	if ((int)extraFBOs_.size() <= pass)
+		extraFBOs_.resize(pass + 1, nullptr);
+	Draw::Framebuffer *&fbo = extraFBOs_[pass];
+	if (fbo) {
+		int fbo_w, fbo_h;
+		draw_->GetFramebufferDimensions(fbo, &fbo_w, &fbo_h);
+		if (fbo_w == w && fbo_h == h)
+			return fbo;
+		fbo->Release();
+	}
+	// No depth/stencil for post processing
+	fbo = draw_->CreateFramebuffer({ w, h, 1, 1, false, Draw::FBO_8888 });
+	return fbo;
+}
+
 // Heuristics to figure out the size of FBO to create.
 void FramebufferManagerCommon::EstimateDrawingSize(u32 fb_address, GEBufferFormat fb_format, int viewport_width, int viewport_height, int region_width, int region_height, int scissor_width, int scissor_height, int fb_stride, int &drawing_width, int &drawing_height) {
 	static const int MAX_FRAMEBUF_HEIGHT = 512;
@@ -407,8 +482,8 @@ VirtualFramebuffer *FramebufferManagerCommon::DoSetRenderFrameBuffer(const Frame
 		}
 	}
 
-	float renderWidthFactor = renderWidth_ / 480.0f;
-	float renderHeightFactor = renderHeight_ / 272.0f;
+	float renderWidthFactor = renderWidth_ * dynamicScale_ / 480.0f;
+	float renderHeightFactor = renderHeight_ * dynamicScale_ / 272.0f;
 
 	if (PSP_CoreParameter().compat.flags().Force04154000Download && params.fb_address == 0x00154000) {
 		renderWidthFactor = 1.0;
@@ -520,7 +595,7 @@ VirtualFramebuffer *FramebufferManagerCommon::DoSetRenderFrameBuffer(const Frame
 void FramebufferManagerCommon::DestroyFramebuf(VirtualFramebuffer *v) {
 	textureCache_->NotifyFramebuffer(v->fb_address, v, NOTIFY_FB_DESTROYED);
 	if (v->fbo) {
-		v->fbo->Release();
+		ReleaseFramebuffer(v->fbo);
 		v->fbo = nullptr;
 	}
 
@@ -622,7 +697,7 @@ void FramebufferManagerCommon::NotifyRenderFramebufferSwitched(VirtualFramebuffe
 		if (vfb->fbo) {
 			// This should only happen very briefly when toggling useBufferedRendering_.
 			textureCache_->NotifyFramebuffer(vfb->fb_address, vfb, NOTIFY_FB_DESTROYED);
-			vfb->fbo->Release();
+			ReleaseFramebuffer(vfb->fbo);
 			vfb->fbo = nullptr;
 		}
 
@@ -965,7 +1040,8 @@ void FramebufferManagerCommon::CopyDisplayToOutput() {
 			draw_->BindFramebufferAsRenderTarget(nullptr, { Draw::RPAction::CLEAR, Draw::RPAction::CLEAR, Draw::RPAction::CLEAR });
 			draw_->BindFramebufferAsTexture(vfb->fbo, 0, Draw::FB_COLOR_BIT, 0);
 			draw_->SetScissorRect(0, 0, pixelWidth_, pixelHeight_);
-			DrawTextureFlags flags = g_Config.iBufFilter == SCALE_LINEAR ? DRAWTEX_LINEAR : DRAWTEX_NEAREST;
+			// When dynamically scaled down, always filter so the upscale doesn't shimmer as the scale moves.
+			DrawTextureFlags flags = (g_Config.iBufFilter == SCALE_LINEAR || dynamicScale_ < 1.0f) ? DRAWTEX_LINEAR : DRAWTEX_NEAREST;
 			// We are doing the DrawActiveTexture call directly to the backbuffer here. Hence, we must
 			// flip V.
 			Bind2DShader();
@@ -984,37 +1060,65 @@ void FramebufferManagerCommon::CopyDisplayToOutput() {
 				SetViewport2D(0, 0, pixelWidth_, pixelHeight_);
 				DrawActiveTexture(x, y, w, h, (float)pixelWidth_, (float)pixelHeight_, u0, v0, u1, v1, uvRotation, flags);
 			}
-		} else if (usePostShader_ && extraFBOs_.size() == 1 && !postShaderAtOutputResolution_) {
-			// An additional pass, post-processing shader to the extra FBO.
-			draw_->BindFramebufferAsRenderTarget(extraFBOs_[0], { Draw::RPAction::DONT_CARE, Draw::RPAction::DONT_CARE, Draw::RPAction::DONT_CARE });
-			draw_->BindFramebufferAsTexture(vfb->fbo, 0, Draw::FB_COLOR_BIT, 0);
-			int fbo_w, fbo_h;
-			draw_->GetFramebufferDimensions(extraFBOs_[0], &fbo_w, &fbo_h);
-			SetViewport2D(0, 0, fbo_w, fbo_h);
-			draw_->SetScissorRect(0, 0, fbo_w, fbo_h);
-			shaderManager_->DirtyLastShader();  // dirty lastShader_
-			PostShaderUniforms uniforms{};
-			CalculatePostShaderUniforms(vfb->bufferWidth, vfb->bufferHeight, renderWidth_, renderHeight_, &uniforms);
-			BindPostShader(uniforms);
-			DrawTextureFlags flags = g_Config.iBufFilter == SCALE_LINEAR ? DRAWTEX_LINEAR : DRAWTEX_NEAREST;
-			DrawActiveTexture(0, 0, fbo_w, fbo_h, fbo_w, fbo_h, 0.0f, 0.0f, 1.0f, 1.0f, ROTATION_LOCKED_HORIZONTAL, flags);
+		} else if (usePostShader_ && extraFBOs_.size() >= 1 && (!postShaderAtOutputResolution_ || postShaderPasses_ > 1)) {
+			// Run the chain through the extra FBOs, each pass sampling the previous one. If the last pass
+			// is at output resolution, it draws straight to the backbuffer instead.
+			int fboPasses = postShaderAtOutputResolution_ ? postShaderPasses_ - 1 : postShaderPasses_;
+			Draw::Framebuffer *src = vfb->fbo;
+			// Pass targets are sized from the full render resolution, so dynamic resolution doesn't
+			// recreate them. The first pass then also does the upscale.
+			int src_w = (int)renderWidth_;
+			int src_h = (int)renderHeight_;
+			int tex_w = vfb->renderWidth * 480 / std::max((int)vfb->bufferWidth, 1);
+			int tex_h = vfb->renderHeight * 272 / std::max((int)vfb->bufferHeight, 1);
+			DrawTextureFlags flags = (g_Config.iBufFilter == SCALE_LINEAR || dynamicScale_ < 1.0f) ? DRAWTEX_LINEAR : DRAWTEX_NEAREST;
+			// The pass drawing to the backbuffer isn't included, that one also has the UI in it.
+			draw_->BeginGPUTimer("postshader");
+			for (int pass = 0; pass < fboPasses; ++pass) {
+				int fbo_w = std::max(1, (int)(src_w * postShaderScale_[pass]));
+				int fbo_h = std::max(1, (int)(src_h * postShaderScale_[pass]));
+				Draw::Framebuffer *dst = GetPostShaderFBO(pass, fbo_w, fbo_h);
+				draw_->BindFramebufferAsRenderTarget(dst, { Draw::RPAction::DONT_CARE, Draw::RPAction::DONT_CARE, Draw::RPAction::DONT_CARE });
+				draw_->BindFramebufferAsTexture(src, 0, Draw::FB_COLOR_BIT, 0);
+				SetViewport2D(0, 0, fbo_w, fbo_h);
+				draw_->SetScissorRect(0, 0, fbo_w, fbo_h);
+				shaderManager_->DirtyLastShader();  // dirty lastShader_
+				PostShaderUniforms uniforms{};
+				CalculatePostShaderUniforms(vfb->bufferWidth, vfb->bufferHeight, tex_w, tex_h, &uniforms);
+				uniforms.pixelDelta[0] = 1.0f / fbo_w;
+				uniforms.pixelDelta[1] = 1.0f / fbo_h;
+				BindPostShaderPass(pass, uniforms);
+				DrawActiveTexture(0, 0, fbo_w, fbo_h, fbo_w, fbo_h, 0.0f, 0.0f, 1.0f, 1.0f, ROTATION_LOCKED_HORIZONTAL, flags);
+				src = dst;
+				src_w = fbo_w;
+				src_h = fbo_h;
+				tex_w = fbo_w;
+				tex_h = fbo_h;
+			}
+			draw_->EndGPUTimer();
 
 			draw_->SetScissorRect(0, 0, pixelWidth_, pixelHeight_);
 			draw_->BindFramebufferAsRenderTarget(nullptr, { Draw::RPAction::CLEAR, Draw::RPAction::CLEAR, Draw::RPAction::CLEAR });
 
-			// Use the extra FBO, with applied post-processing shader, as a texture.
-			// fbo_bind_as_texture(extraFBOs_[0], FB_COLOR_BIT, 0);
-			if (extraFBOs_.size() == 0) {
+			// Use the last extra FBO, with applied post-processing shaders, as a texture.
+			if (!src) {
 				ERROR_LOG(FRAMEBUF, "Unexpected: No extra FBOs?");
 				return;
 			}
-			draw_->BindFramebufferAsTexture(extraFBOs_[0], 0, Draw::FB_COLOR_BIT, 0);
+			draw_->BindFramebufferAsTexture(src, 0, Draw::FB_COLOR_BIT, 0);
 
 			// We are doing the DrawActiveTexture call directly to the backbuffer after here. Hence, we must
 			// flip V.
 			if (needBackBufferYSwap_)
 				std::swap(v0, v1);
-			Bind2DShader();
+			if (postShaderAtOutputResolution_) {
+				shaderManager_->DirtyLastShader();
+				PostShaderUniforms uniforms{};
+				CalculatePostShaderUniforms(vfb->bufferWidth, vfb->bufferHeight, src_w, src_h, &uniforms);
+				BindPostShaderPass(postShaderPasses_ - 1, uniforms);
+			} else {
+				Bind2DShader();
+			}
 			flags = (!postShaderIsUpscalingFilter_ && g_Config.iBufFilter == SCALE_LINEAR) ? DRAWTEX_LINEAR : DRAWTEX_NEAREST;
 			if (g_Config.bEnableCardboard) {
 				// Left Eye Image
@@ -1070,7 +1174,7 @@ void FramebufferManagerCommon::DecimateFBOs() {
 	currentRenderVfb_ = 0;
 
 	for (auto iter : fbosToDelete_) {
-		iter->Release();
+		ReleaseFramebuffer(iter);
 	}
 	fbosToDelete_.clear();
 
@@ -1099,13 +1203,23 @@ void FramebufferManagerCommon::DecimateFBOs() {
 	for (auto it = tempFBOs_.begin(); it != tempFBOs_.end(); ) {
 		int age = frameLastFramebufUsed_ - it->second.last_frame_used;
 		if (age > FBO_OLD_AGE) {
-			it->second.fbo->Release();
+			ReleaseFramebuffer(it->second.fbo);
 			tempFBOs_.erase(it++);
 		} else {
 			++it;
 		}
 	}
 
+	for (auto it = fboPool_.begin(); it != fboPool_.end(); ) {
+		int age = gpuStats.numFlips - it->second.last_frame_released;
+		if (age > FBO_POOL_AGE) {
+			it->second.fbo->Release();
+			fboPool_.erase(it++);
+		} else {
+			++it;
+		}
+	}
+
 	// Do the same for ReadFramebuffersToMemory's VFBs
 	for (size_t i = 0; i < bvfbs_.size(); ++i) {
 		VirtualFramebuffer *vfb = bvfbs_[i];
@@ -1170,7 +1284,7 @@ void FramebufferManagerCommon::ResizeFramebufFBO(VirtualFramebuffer *vfb, int w,
 
 	if (!useBufferedRendering_) {
 		if (vfb->fbo) {
-			vfb->fbo->Release();
+			ReleaseFramebuffer(vfb->fbo);
 			vfb->fbo = nullptr;
 		}
 		return;
@@ -1180,7 +1294,7 @@ void FramebufferManagerCommon::ResizeFramebufFBO(VirtualFramebuffer *vfb, int w,
 		return;
 	}
 
-	vfb->fbo = draw_->CreateFramebuffer({ vfb->renderWidth, vfb->renderHeight, 1, 1, true, (Draw::FBColorDepth)vfb->colorDepth });
+	vfb->fbo = AllocFramebuffer({ vfb->renderWidth, vfb->renderHeight, 1, 1, true, (Draw::FBColorDepth)vfb->colorDepth });
 	if (old.fbo) {
 		INFO_LOG(FRAMEBUF, "Resizing FBO for %08x : %d x %d x %d", vfb->fb_address, w, h, vfb->format);
 		if (vfb->fbo) {
@@ -1415,6 +1529,100 @@ void FramebufferManagerCommon::FindTransferFramebuffers(VirtualFramebuffer *&dst
 	}
 }
 
+// Finds a framebuffer of the given bpp that the whole byte range lies inside, preferring the most recently rendered.
+VirtualFramebuffer *FramebufferManagerCommon::FindTransferRangeFramebuffer(u32 addr, u32 size, int bpp) const {
+	addr &= 0x3FFFFFFF;
+	VirtualFramebuffer *found = nullptr;
+	for (size_t i = 0; i < vfbs_.size(); ++i) {
+		VirtualFramebuffer *vfb = vfbs_[i];
+		const u32 vfb_address = (0x04000000 | vfb->fb_address) & 0x3FFFFFFF;
+		const int vfb_bpp = vfb->format == GE_FORMAT_8888 ? 4 : 2;
+		if (vfb_bpp != bpp || vfb->fb_stride == 0 || ((addr - vfb_address) % bpp) != 0)
+			continue;
+		if (vfb_address <= addr && addr + size <= vfb_address + FramebufferByteSize(vfb)) {
+			if (!found || found->last_frame_render < vfb->last_frame_render)
+				found = vfb;
+		}
+	}
+	return found;
+}
+
+// Transfers between two framebuffers with strides that don't match them, so the rows don't form a rectangle.
+// Each row, split where it wraps in either buffer, gets its own blit. Returns false to leave it to RAM.
+bool FramebufferManagerCommon::BlockTransferRows(u32 dstBasePtr, int dstStride, int dstX, int dstY, u32 srcBasePtr, int srcStride, int srcX, int srcY, int width, int height, int bpp, u32 skipDrawReason) {
+	// Beyond this it's likely not image data, and the blits get expensive anyway.
+	const size_t MAX_ROW_BLITS = 1024;
+	if (width <= 0 || height <= 0) {
+		return false;
+	}
+
+	const u32 srcStart = (srcBasePtr & 0x3FFFFFFF) + (srcY * srcStride + srcX) * bpp;
+	const u32 dstStart = (dstBasePtr & 0x3FFFFFFF) + (dstY * dstStride + dstX) * bpp;
+	const u32 srcSize = ((height - 1) * srcStride + width) * bpp;
+	const u32 dstSize = ((height - 1) * dstStride + width) * bpp;
+	VirtualFramebuffer *srcVfb = FindTransferRangeFramebuffer(srcStart, srcSize, bpp);
+	VirtualFramebuffer *dstVfb = FindTransferRangeFramebuffer(dstStart, dstSize, bpp);
+	// Within one buffer the row order would matter, not worth it.
+	if (!srcVfb || !dstVfb || srcVfb == dstVfb || !srcVfb->fbo || !dstVfb->fbo) {
+		return false;
+	}
+
+	struct RowBlit {
+		int srcX, srcY;
+		int dstX, dstY;
+		int w;
+	};
+	std::vector<RowBlit> blits;
+	const u32 srcVfbStart = ((0x04000000 | srcVfb->fb_address) & 0x3FFFFFFF);
+	const u32 dstVfbStart = ((0x04000000 | dstVfb->fb_address) & 0x3FFFFFFF);
+	for (int y = 0; y < height; ++y) {
+		u32 srcOffset = (srcStart - srcVfbStart) / bpp + y * srcStride;
+		u32 dstOffset = (dstStart - dstVfbStart) / bpp + y * dstStride;
+		int left = width;
+		while (left > 0) {
+			const int sx = srcOffset % srcVfb->fb_stride, sy = srcOffset / srcVfb->fb_stride;
+			const int dx = dstOffset % dstVfb->fb_stride, dy = dstOffset / dstVfb->fb_stride;
+			const int w = std::min(left, std::min(srcVfb->fb_stride - sx, dstVfb->fb_stride - dx));
+			// Pixels in the stride padding past the buffer aren't on the GPU.
+			if (sx + w > srcVfb->bufferWidth || dx + w > dstVfb->bufferWidth || sy >= srcVfb->bufferHeight || dy >= dstVfb->bufferHeight) {
+				return false;
+			}
+			if (blits.size() >= MAX_ROW_BLITS) {
+				return false;
+			}
+			blits.push_back({ sx, sy, dx, dy, w });
+			srcOffset += w;
+			dstOffset += w;
+			left -= w;
+		}
+	}
+
+	WARN_LOG_ONCE(btrows, G3D, "Row by row block transfer %08x -> %08x, strides %d -> %d", srcBasePtr, dstBasePtr, srcStride, dstStride);
+	FlushBeforeCopy();
+	for (const RowBlit &blit : blits) {
+		BlitFramebuffer(dstVfb, blit.dstX, blit.dstY, srcVfb, blit.srcX, blit.srcY, blit.w, 1, bpp);
+	}
+	RebindFramebuffer();
+	SetColorUpdated(dstVfb, skipDrawReason);
+	gpuStats.numBlockTransfersGPU++;
+	return true;
+}
+
+// Blitting a buffer onto itself isn't defined when the rectangles overlap, so that goes through a temp copy.
+void FramebufferManagerCommon::BlitWithinFramebuffer(VirtualFramebuffer *vfb, int dstX, int dstY, int srcX, int srcY, int w, int h, int bpp) {
+	const bool overlap = srcX < dstX + w && dstX < srcX + w && srcY < dstY + h && dstY < srcY + h;
+	Draw::Framebuffer *tempFBO = overlap ? GetTempFBO(vfb->renderWidth, vfb->renderHeight, (Draw::FBColorDepth)vfb->colorDepth) : nullptr;
+	if (!tempFBO) {
+		BlitFramebuffer(vfb, dstX, dstY, vfb, srcX, srcY, w, h, bpp);
+		return;
+	}
+
+	VirtualFramebuffer tempVfb = *vfb;
+	tempVfb.fbo = tempFBO;
+	BlitFramebuffer(&tempVfb, srcX, srcY, vfb, srcX, srcY, w, h, bpp);
+	BlitFramebuffer(vfb, dstX, dstY, &tempVfb, srcX, srcY, w, h, bpp);
+}
+
 // 1:1 pixel sides buffers, we resize buffers to these before we read them back.
 VirtualFramebuffer *FramebufferManagerCommon::FindDownloadTempBuffer(VirtualFramebuffer *vfb) {
 	// For now we'll keep these on the same struct as the ones that can get displayed
@@ -1597,6 +1805,8 @@ bool FramebufferManagerCommon::NotifyBlockTransferBefore(u32 dstBasePtr, int dst
 	int srcHeight = height;
 	int dstWidth = width;
 	int dstHeight = height;
+	const int origDstX = dstX, origDstY = dstY;
+	const int origSrcX = srcX, origSrcY = srcY;
 	FindTransferFramebuffers(dstBuffer, srcBuffer, dstBasePtr, dstStride, dstX, dstY, srcBasePtr, srcStride, srcX, srcY, srcWidth, srcHeight, dstWidth, dstHeight, bpp);
 
 	if (dstBuffer && srcBuffer) {
@@ -1605,9 +1815,10 @@ bool FramebufferManagerCommon::NotifyBlockTransferBefore(u32 dstBasePtr, int dst
 				WARN_LOG_ONCE(dstsrc, G3D, "Intra-buffer block transfer %08x -> %08x", srcBasePtr, dstBasePtr);
 				if (g_Config.bBlockTransferGPU) {
 					FlushBeforeCopy();
-					BlitFramebuffer(dstBuffer, dstX, dstY, srcBuffer, srcX, srcY, dstWidth, dstHeight, bpp);
+					BlitWithinFramebuffer(dstBuffer, dstX, dstY, srcX, srcY, dstWidth, dstHeight, bpp);
 					RebindFramebuffer();
 					SetColorUpdated(dstBuffer, skipDrawReason);
+					gpuStats.numBlockTransfersGPU++;
 					return true;
 				}
 			} else {
@@ -1624,11 +1835,19 @@ bool FramebufferManagerCommon::NotifyBlockTransferBefore(u32 dstBasePtr, int dst
 				BlitFramebuffer(dstBuffer, dstX, dstY, srcBuffer, srcX, srcY, dstWidth, dstHeight, bpp);
 				RebindFramebuffer();
 				SetColorUpdated(dstBuffer, skipDrawReason);
+				gpuStats.numBlockTransfersGPU++;
 				return true;  // No need to actually do the memory copy behind, probably.
 			}
 		}
 		return false;
-	} else if (dstBuffer) {
+	}
+
+	// One side might still be in a framebuffer at a stride the lookup above refused to match.
+	if (g_Config.bBlockTransferGPU && BlockTransferRows(dstBasePtr, dstStride, origDstX, origDstY, srcBasePtr, srcStride, origSrcX, origSrcY, width, height, bpp, skipDrawReason)) {
+		return true;
+	}
+
+	if (dstBuffer) {
 		// Here we should just draw the pixels into the buffer.  Copy first.
 		return false;
 	} else if (srcBuffer) {
@@ -1645,6 +1864,7 @@ bool FramebufferManagerCommon::NotifyBlockTransferBefore(u32 dstBasePtr, int dst
 					WARN_LOG_ONCE(btdheight, G3D, "Block transfer download %08x -> %08x dangerous, %d+%d is taller than %d", srcBasePtr, dstBasePtr, srcY, srcHeight, srcBuffer->bufferHeight);
 				ReadFramebufferToMemory(srcBuffer, true, static_cast<int>(srcX * srcXFactor), srcY, static_cast<int>(srcWidth * srcXFactor), srcHeight);
 				srcBuffer->usageFlags = (srcBuffer->usageFlags | FB_USAGE_DOWNLOAD) & ~FB_USAGE_DOWNLOAD_CLEAR;
+				gpuStats.numBlockTransferDownloads++;
 			}
 		}
 		return false;  // Let the bit copy happen
@@ -1702,14 +1922,15 @@ void FramebufferManagerCommon::NotifyBlockTransferAfter(u32 dstBasePtr, int dstS
 				DrawPixels(dstBuffer, static_cast<int>(dstX * dstXFactor), dstY, srcBase, dstBuffer->format, static_cast<int>(srcStride * dstXFactor), static_cast<int>(dstWidth * dstXFactor), dstHeight);
 				SetColorUpdated(dstBuffer, skipDrawReason);
 				RebindFramebuffer();
+				gpuStats.numBlockTransferUploads++;
 			}
 		}
 	}
 }
 
 void FramebufferManagerCommon::SetRenderSize(VirtualFramebuffer *vfb) {
-	float renderWidthFactor = renderWidth_ / 480.0f;
-	float renderHeightFactor = renderHeight_ / 272.0f;
+	float renderWidthFactor = renderWidth_ * dynamicScale_ / 480.0f;
+	float renderHeightFactor = renderHeight_ * dynamicScale_ / 272.0f;
 	bool force1x = false;
 	switch (bloomHack_) {
 	case 1:
@@ -1838,7 +2059,7 @@ Draw::Framebuffer *FramebufferManagerCommon::GetTempFBO(u16 w, u16 h, Draw::FBCo
 	}
 
 	textureCache_->ForgetLastTexture();
-	Draw::Framebuffer *fbo = draw_->CreateFramebuffer({ w, h, 1, 1, false, depth });
+	Draw::Framebuffer *fbo = AllocFramebuffer({ w, h, 1, 1, false, depth });
 	if (!fbo)
 		return fbo;
 
@@ -1847,6 +2068,61 @@ Draw::Framebuffer *FramebufferManagerCommon::GetTempFBO(u16 w, u16 h, Draw::FBCo
 	return fbo;
 }
 
+static u64 FramebufferPoolKey(const Draw::FramebufferDesc &desc) {
+	return ((u64)desc.colorDepth << 34) | ((u64)desc.z_stencil << 32) | ((u32)(desc.width & 0xFFFF) << 16) | (desc.height & 0xFFFF);
+}
+
+Draw::Framebuffer *FramebufferManagerCommon::AllocFramebuffer(const Draw::FramebufferDesc &desc) {
+	const u64 key = FramebufferPoolKey(desc);
+	auto it = fboPool_.find(key);
+	if (it != fboPool_.end()) {
+		Draw::Framebuffer *fbo = it->second.fbo;
+		fboPool_.erase(it);
+		fboKeys_[fbo] = key;
+		gpuStats.numPooledFBOsReused++;
+		return fbo;
+	}
+
+	Draw::Framebuffer *fbo = draw_->CreateFramebuffer(desc);
+	if (fbo) {
+		fboKeys_[fbo] = key;
+		gpuStats.numFBOsCreated++;
+	}
+	return fbo;
+}
+
+void FramebufferManagerCommon::ReleaseFramebuffer(Draw::Framebuffer *fbo) {
+	auto it = fboKeys_.find(fbo);
+	if (it == fboKeys_.end()) {
+		// Not one of ours.
+		fbo->Release();
+		return;
+	}
+
+	const u64 key = it->second;
+	fboKeys_.erase(it);
+	if (fboPool_.size() >= FBO_POOL_MAX) {
+		// Make room by dropping the one that's been sitting there the longest.
+		auto oldest = fboPool_.begin();
+		for (auto jt = fboPool_.begin(); jt != fboPool_.end(); ++jt) {
+			if (jt->second.last_frame_released < oldest->second.last_frame_released)
+				oldest = jt;
+		}
+		oldest->second.fbo->Release();
+		fboPool_.erase(oldest);
+	}
+	fboPool_.insert(std::make_pair(key, PooledFBO{ fbo, gpuStats.numFlips }));
+}
+
+void FramebufferManagerCommon::ClearFramebufferPool() {
+	for (auto &pooled : fboPool_) {
+		pooled.second.fbo->Release();
+	}
+	fboPool_.clear();
+	// Anything still alive at this point is being released directly by the caller.
+	fboKeys_.clear();
+}
+
 void FramebufferManagerCommon::UpdateFramebufUsage(VirtualFramebuffer *vfb) {
 	auto checkFlag = [&](u16 flag, int last_frame) {
 		if (vfb->usageFlags & flag) {
@@ -2041,7 +2317,9 @@ void FramebufferManagerCommon::PackFramebufferSync_(VirtualFramebuffer *vfb, int
 	// Right now that's always 8888.
 	DEBUG_LOG(G3D, "Reading framebuffer to mem, fb_address = %08x", fb_address);
 
+	draw_->BeginGPUTimer("readback");
 	draw_->CopyFramebufferToMemorySync(vfb->fbo, Draw::FB_COLOR_BIT, x, y, w, h, destFormat, destPtr, vfb->fb_stride);
+	draw_->EndGPUTimer();
 
 	// A new command buffer will begin after CopyFrameBufferToMemorySync, so we need to trigger
 	// updates of any dynamic command buffer state by dirtying some stuff.
@@ -2049,6 +2327,34 @@ void FramebufferManagerCommon::PackFramebufferSync_(VirtualFramebuffer *vfb, int
 	gpuStats.numReadbacks++;
 }
 
+// Same as above, except the memory is written once the GPU gets to it, a few frames from now.
+// No need to dirty state since nothing gets flushed.
+bool FramebufferManagerCommon::PackFramebufferAsync_(VirtualFramebuffer *vfb, int x, int y, int w, int h) {
+	if (!vfb->fbo) {
+		return false;
+	}
+
+	const u32 fb_address = (0x04000000) | vfb->fb_address;
+
+	Draw::DataFormat destFormat = GEFormatToThin3D(vfb->format);
+	const int dstBpp = (int)DataFormatSizeInBytes(destFormat);
+
+	const int dstByteOffset = (y * vfb->fb_stride + x) * dstBpp;
+	u8 *destPtr = Memory::GetPointer(fb_address + dstByteOffset);
+
+	draw_->BeginGPUTimer("readback_async");
+	bool queued = draw_->CopyFramebufferToMemoryAsync(vfb->fbo, Draw::FB_COLOR_BIT, x, y, w, h, destFormat, destPtr, vfb->fb_stride);
+	draw_->EndGPUTimer();
+	if (!queued) {
+		return false;
+	}
+
+	DEBUG_LOG(G3D, "Queued async framebuffer read to mem, fb_address = %08x", fb_address);
+	gpuStats.numReadbacks++;
+	gpuStats.numAsyncReadbacks++;
+	return true;
+}
+
 void FramebufferManagerCommon::ReadFramebufferToMemory(VirtualFramebuffer *vfb, bool sync, int x, int y, int w, int h) {
 	// Clamp to bufferWidth. Sometimes block transfers can cause this to hit.
 	if (x + w >= vfb->bufferWidth) {
@@ -2057,13 +2363,19 @@ void FramebufferManagerCommon::ReadFramebufferToMemory(VirtualFramebuffer *vfb,
 	if (vfb && vfb->fbo) {
 		// We'll pseudo-blit framebuffers here to get a resized version of vfb.
 		OptimizeDownloadRange(vfb, x, y, w, h);
-		if (vfb->renderWidth == vfb->width && vfb->renderHeight == vfb->height) {
-			// No need to blit
-			PackFramebufferSync_(vfb, x, y, w, h);
-		} else {
-			VirtualFramebuffer *nvfb = FindDownloadTempBuffer(vfb);
-			BlitFramebuffer(nvfb, x, y, vfb, x, y, w, h, 0);
-			PackFramebufferSync_(nvfb, x, y, w, h);
+		VirtualFramebuffer *packVfb = vfb;
+		if (vfb->renderWidth != vfb->width || vfb->renderHeight != vfb->height) {
+			packVfb = FindDownloadTempBuffer(vfb);
+			BlitFramebuffer(packVfb, x, y, vfb, x, y, w, h, 0);
+		}
+
+		// Games that are fine with seeing the result a few frames late don't have to wait for it,
+		// when the caller doesn't need it right away.
+		bool async = !sync && PSP_CoreParameter().compat.flags().DelayedReadbacks;
+		if (!async || !PackFramebufferAsync_(packVfb, x, y, w, h)) {
+			double start = time_now_d();
+			PackFramebufferSync_(packVfb, x, y, w, h);
+			gpuStats.msReadbackStall += (time_now_d() - start) * 1000.0;
 		}
 
 		textureCache_->ForgetLastTexture();
@@ -63,6 +63,10 @@ struct PostShaderUniforms {
 	float video;
 };
 
+enum {
+	MAX_POST_SHADER_PASSES = 8,
+};
+
 struct VirtualFramebuffer {
 	int last_frame_used;
 	int last_frame_attached;
@@ -231,6 +235,7 @@ class FramebufferManagerCommon {
 	void DrawPixels(VirtualFramebuffer *vfb, int dstX, int dstY, const u8 *srcPixels, GEBufferFormat srcPixelFormat, int srcStride, int width, int height);
 
 	size_t NumVFBs() const { return vfbs_.size(); }
+	int GetPostShaderPasses() const { return usePostShader_ ? postShaderPasses_ : 0; }
 
 	u32 PrevDisplayFramebufAddr() {
 		return prevDisplayFramebuf_ ? (0x04000000 | prevDisplayFramebuf_->fb_address) : 0;
@@ -291,6 +296,12 @@ class FramebufferManagerCommon {
 	virtual void Resized();
 
 	Draw::Framebuffer *GetTempFBO(u16 w, u16 h, Draw::FBColorDepth colorDepth = Draw::FBO_8888);
+	// Render targets are pooled by size and format, creating them is slow on some (mostly mobile) drivers.
+	// Released ones come back with undefined contents, so clear or overwrite them.
+	Draw::Framebuffer *AllocFramebuffer(const Draw::FramebufferDesc &desc);
+	void ReleaseFramebuffer(Draw::Framebuffer *fbo);
+	// Actually releases everything in the pool. Call wherever all FBOs get destroyed.
+	void ClearFramebufferPool();
 
 	// Debug features
 	virtual bool GetFramebuffer(u32 fb_address, int fb_stride, GEBufferFormat format, GPUDebugBuffer &buffer, int maxRes);
@@ -300,21 +311,32 @@ class FramebufferManagerCommon {
 
 protected:
 	virtual void PackFramebufferSync_(VirtualFramebuffer *vfb, int x, int y, int w, int h);
+	// Returns false if the backend can't do it, then the sync version has to be used.
+	bool PackFramebufferAsync_(VirtualFramebuffer *vfb, int x, int y, int w, int h);
 	virtual void SetViewport2D(int x, int y, int w, int h);
 	void CalculatePostShaderUniforms(int bufferWidth, int bufferHeight, int renderWidth, int renderHeight, PostShaderUniforms *uniforms);
 	virtual void MakePixelTexture(const u8 *srcPixels, GEBufferFormat srcPixelFormat, int srcStride, int width, int height, float &u1, float &v1) = 0;
 	virtual void DrawActiveTexture(float x, float y, float w, float h, float destW, float destH, float u0, float v0, float u1, float v1, int uvRotation, int flags) = 0;
 	virtual void Bind2DShader() = 0;
 	virtual void BindPostShader(const PostShaderUniforms &uniforms) = 0;
+	// Backends that compile a whole chain (postShaderPasses_ > 1) bind the right pass here.
+	virtual void BindPostShaderPass(int pass, const PostShaderUniforms &uniforms) {
+		BindPostShader(uniforms);
+	}
 
 	// Cardboard Settings Calculator
 	void GetCardboardSettings(CardboardSettings *cardboardSettings);
 
 	bool UpdateSize();
 	void SetNumExtraFBOs(int num);
+	// Pooled render target for a post shader pass, only recreated when the size changes.
+	Draw::Framebuffer *GetPostShaderFBO(int pass, int w, int h);
 
 	void FlushBeforeCopy();
 	virtual void DecimateFBOs();  // keeping it virtual to let D3D do a little extra
+	// Dynamic resolution. Picks a new scale from the GPU frame time, and resizes the FBOs to match.
+	void UpdateDynamicResolution();
+	void SetDynamicScale(float scale);
 
 	// Used by ReadFramebufferToMemory and later framebuffer block copies
 	virtual void BlitFramebuffer(VirtualFramebuffer *dst, int dstX, int dstY, VirtualFramebuffer *src, int srcX, int srcY, int w, int h, int bpp) = 0;
@@ -337,6 +359,9 @@ class FramebufferManagerCommon {
 	bool ShouldDownloadFramebuffer(const VirtualFramebuffer *vfb) const;
 	void DownloadFramebufferOnSwitch(VirtualFramebuffer *vfb);
 	void FindTransferFramebuffers(VirtualFramebuffer *&dstBuffer, VirtualFramebuffer *&srcBuffer, u32 dstBasePtr, int dstStride, int &dstX, int &dstY, u32 srcBasePtr, int srcStride, int &srcX, int &srcY, int &srcWidth, int &srcHeight, int &dstWidth, int &dstHeight, int bpp) const;
+	VirtualFramebuffer *FindTransferRangeFramebuffer(u32 addr, u32 size, int bpp) const;
+	bool BlockTransferRows(u32 dstBasePtr, int dstStride, int dstX, int dstY, u32 srcBasePtr, int srcStride, int srcX, int srcY, int width, int height, int bpp, u32 skipDrawReason);
+	void BlitWithinFramebuffer(VirtualFramebuffer *vfb, int dstX, int dstY, int srcX, int srcY, int w, int h, int bpp);
 	VirtualFramebuffer *FindDownloadTempBuffer(VirtualFramebuffer *vfb);
 	virtual bool CreateDownloadTempBuffer(VirtualFramebuffer *nvfb) = 0;
 	virtual void UpdateDownloadTempBuffer(VirtualFramebuffer *nvfb) = 0;
@@ -379,6 +404,9 @@ class FramebufferManagerCommon {
 	bool usePostShader_ = false;
 	bool postShaderAtOutputResolution_ = false;
 	bool postShaderIsUpscalingFilter_ = false;
+	// Number of chained passes, see ShaderInfo::next. All but the last render into extraFBOs_.
+	int postShaderPasses_ = 1;
+	float postShaderScale_[MAX_POST_SHADER_PASSES];
 
 	std::vector<VirtualFramebuffer *> vfbs_;
 	std::vector<VirtualFramebuffer *> bvfbs_; // blitting framebuffers (for download)
@@ -389,6 +417,10 @@ class FramebufferManagerCommon {
 	// Sampled in BeginFrame for safety.
 	float renderWidth_ = 0.0f;
 	float renderHeight_ = 0.0f;
+	// Fraction of renderWidth_/renderHeight_ the game's framebuffers currently render at.
+	float dynamicScale_ = 1.0f;
+	float dynamicFrameTime_ = 0.0f;
+	int dynamicScaleChangeFrame_ = 0;
 	int pixelWidth_;
 	int pixelHeight_;
 	int bloomHack_ = 0;
@@ -408,10 +440,22 @@ class FramebufferManagerCommon {
 
 	std::vector<Draw::Framebuffer *> fbosToDelete_;
 
+	struct PooledFBO {
+		Draw::Framebuffer *fbo;
+		int last_frame_released;
+	};
+	// Released render targets, by the key of the desc they were created with.
+	std::multimap<u64, PooledFBO> fboPool_;
+	// Keys of the FBOs handed out by AllocFramebuffer.
+	std::map<Draw::Framebuffer *, u64> fboKeys_;
+
 	// Aggressively delete unused FBOs to save gpu memory.
 	enum {
 		FBO_OLD_AGE = 5,
 		FBO_OLD_USAGE_FLAG = 15,
+		// Pooled ones are kept a bit longer, games tend to recreate targets of the same sizes.
+		FBO_POOL_AGE = 60,
+		FBO_POOL_MAX = 16,
 	};
 };
 
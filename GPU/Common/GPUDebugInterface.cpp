@@ -15,6 +15,8 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#include <cstring>
+
 #include "GPUDebugInterface.h"
 
 void GPUDebugBuffer::Allocate(u32 stride, u32 height, GEBufferFormat fmt, bool flipped, bool reversed) {
@@ -50,6 +52,18 @@ void GPUDebugBuffer::Free() {
 	data_ = NULL;
 }
 
+void GPUDebugBuffer::TakeOwnership() {
+	if (alloc_ || data_ == NULL) {
+		return;
+	}
+
+	u32 size = PixelSize(fmt_) * stride_ * height_;
+	u8 *data = new u8[size];
+	memcpy(data, data_, size);
+	data_ = data;
+	alloc_ = true;
+}
+
 u32 GPUDebugBuffer::PixelSize(GPUDebugBufferFormat fmt) const {	
 	switch (fmt) {
 	case GPU_DBG_FORMAT_8888:
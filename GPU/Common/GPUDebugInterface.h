@@ -134,6 +134,8 @@ struct GPUDebugBuffer {
 	void Allocate(u32 stride, u32 height, GEBufferFormat fmt, bool flipped = false, bool reversed = false);
 	void Allocate(u32 stride, u32 height, GPUDebugBufferFormat fmt, bool flipped = false);
 	void Free();
+	// Copies the data if it only points at memory owned by someone else, like PSP RAM.
+	void TakeOwnership();
 
 	u8 *GetData() {
 		return data_;
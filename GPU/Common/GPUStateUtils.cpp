@@ -16,6 +16,7 @@
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
 #include <algorithm>
+#include <cstring>
 #include <limits>
 
 #include "base/display.h"
@@ -545,7 +546,7 @@ float FromScaledDepth(float z) {
 	return (z - offset) * depthSliceFactor * 65535.0f;
 }
 
-void ConvertViewportAndScissor(bool useBufferedRendering, float renderWidth, float renderHeight, int bufferWidth, int bufferHeight, ViewportAndScissor &out) {
+static void ComputeViewportAndScissor(bool useBufferedRendering, float renderWidth, float renderHeight, int bufferWidth, int bufferHeight, ViewportAndScissor &out) {
 	bool throughmode = gstate.isModeThrough();
 	out.dirtyProj = false;
 	out.dirtyDepth = false;
@@ -730,6 +731,107 @@ void ConvertViewportAndScissor(bool useBufferedRendering, float renderWidth, flo
 	}
 }
 
+// Everything ComputeViewportAndScissor() reads, in buffered mode.
+struct ViewportInputs {
+	float renderWidth;
+	float renderHeight;
+	int bufferWidth;
+	int bufferHeight;
+	u32 throughmode;
+	u32 scissor1;
+	u32 scissor2;
+	u32 offsetx;
+	u32 offsety;
+	u32 viewport[6];
+	u32 minz;
+	u32 maxz;
+	u32 clipEnable;
+	u32 curRTOffsetX;
+	u32 curRTWidth;
+	u32 curRTHeight;
+	u32 featureFlags;
+};
+
+// And what it leaves in gstate_c, which must still be there to reuse the result.
+struct ViewportOutputs {
+	float vpWidth;
+	float vpHeight;
+	float vpXOffset;
+	float vpYOffset;
+	float vpZOffset;
+	float vpWidthScale;
+	float vpHeightScale;
+	float vpDepthScale;
+};
+
+static void GetViewportOutputs(ViewportOutputs &outputs) {
+	outputs.vpWidth = gstate_c.vpWidth;
+	outputs.vpHeight = gstate_c.vpHeight;
+	outputs.vpXOffset = gstate_c.vpXOffset;
+	outputs.vpYOffset = gstate_c.vpYOffset;
+	outputs.vpZOffset = gstate_c.vpZOffset;
+	outputs.vpWidthScale = gstate_c.vpWidthScale;
+	outputs.vpHeightScale = gstate_c.vpHeightScale;
+	outputs.vpDepthScale = gstate_c.vpDepthScale;
+}
+
+static bool lastViewportValid = false;
+static ViewportInputs lastViewportInputs;
+static ViewportOutputs lastViewportOutputs;
+static ViewportAndScissor lastViewport;
+
+// DIRTY_VIEWPORTSCISSOR_STATE is set by many commands that often end up not changing anything
+// here, like framebuffer and clear mode changes, so remember the last result.
+void ConvertViewportAndScissor(bool useBufferedRendering, float renderWidth, float renderHeight, int bufferWidth, int bufferHeight, ViewportAndScissor &out) {
+	if (!useBufferedRendering) {
+		// Depends on the display layout too, and is rare enough anyway.
+		lastViewportValid = false;
+		ComputeViewportAndScissor(useBufferedRendering, renderWidth, renderHeight, bufferWidth, bufferHeight, out);
+		return;
+	}
+
+	ViewportInputs inputs;
+	memset(&inputs, 0, sizeof(inputs));
+	inputs.renderWidth = renderWidth;
+	inputs.renderHeight = renderHeight;
+	inputs.bufferWidth = bufferWidth;
+	inputs.bufferHeight = bufferHeight;
+	inputs.throughmode = gstate.isModeThrough() ? 1 : 0;
+	inputs.scissor1 = gstate.scissor1;
+	inputs.scissor2 = gstate.scissor2;
+	inputs.offsetx = gstate.offsetx;
+	inputs.offsety = gstate.offsety;
+	inputs.viewport[0] = gstate.viewportxscale;
+	inputs.viewport[1] = gstate.viewportyscale;
+	inputs.viewport[2] = gstate.viewportzscale;
+	inputs.viewport[3] = gstate.viewportxcenter;
+	inputs.viewport[4] = gstate.viewportycenter;
+	inputs.viewport[5] = gstate.viewportzcenter;
+	inputs.minz = gstate.minz;
+	inputs.maxz = gstate.maxz;
+	inputs.clipEnable = gstate.clipEnable;
+	inputs.curRTOffsetX = gstate_c.curRTOffsetX;
+	inputs.curRTWidth = gstate_c.curRTWidth;
+	inputs.curRTHeight = gstate_c.curRTHeight;
+	inputs.featureFlags = gstate_c.featureFlags;
+
+	ViewportOutputs outputs;
+	GetViewportOutputs(outputs);
+	if (lastViewportValid && !memcmp(&inputs, &lastViewportInputs, sizeof(inputs)) && !memcmp(&outputs, &lastViewportOutputs, sizeof(outputs))) {
+		// Nothing changed, so neither did the projection.
+		out = lastViewport;
+		out.dirtyProj = false;
+		out.dirtyDepth = false;
+		return;
+	}
+
+	ComputeViewportAndScissor(useBufferedRendering, renderWidth, renderHeight, bufferWidth, bufferHeight, out);
+	lastViewportInputs = inputs;
+	GetViewportOutputs(lastViewportOutputs);
+	lastViewport = out;
+	lastViewportValid = true;
+}
+
 static const BlendFactor genericALookup[11] = {
 	BlendFactor::DST_COLOR,
 	BlendFactor::ONE_MINUS_DST_COLOR,
@@ -16,10 +16,19 @@
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
 #include <cstring>
+
+#include "ppsspp_config.h"
 #include "IndexGenerator.h"
 
 #include "Common/Common.h"
 
+#if defined(_M_SSE)
+#include <emmintrin.h>
+#endif
+#if PPSSPP_ARCH(ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 // Points don't need indexing...
 const u8 IndexGenerator::indexedPrimitiveType[7] = {
 	GE_PRIM_POINTS,
@@ -31,6 +40,135 @@ const u8 IndexGenerator::indexedPrimitiveType[7] = {
 	GE_PRIM_RECTANGLES,
 };
 
+// Index patterns for the generated primitives, relative to the first vertex. Every period
+// (one to three vectors of eight), each index moves forward by the matching step.
+alignas(16) static const u16 seqPattern[8] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+alignas(16) static const u16 seqStep[8] = { 8, 8, 8, 8, 8, 8, 8, 8 };
+alignas(16) static const u16 lineStripPattern[8] = { 0, 1, 1, 2, 2, 3, 3, 4 };
+alignas(16) static const u16 lineStripStep[8] = { 4, 4, 4, 4, 4, 4, 4, 4 };
+// Eight triangles, winding flips every other one.
+alignas(16) static const u16 stripPattern[24] = {
+	0, 1, 2, 1, 3, 2, 2, 3,
+	4, 3, 5, 4, 4, 5, 6, 5,
+	7, 6, 6, 7, 8, 7, 9, 8,
+};
+alignas(16) static const u16 stripStep[24] = {
+	8, 8, 8, 8, 8, 8, 8, 8,
+	8, 8, 8, 8, 8, 8, 8, 8,
+	8, 8, 8, 8, 8, 8, 8, 8,
+};
+// Eight triangles around the first vertex, which doesn't move.
+alignas(16) static const u16 fanPattern[24] = {
+	0, 1, 2, 0, 2, 3, 0, 3,
+	4, 0, 4, 5, 0, 5, 6, 0,
+	6, 7, 0, 7, 8, 0, 8, 9,
+};
+alignas(16) static const u16 fanStep[24] = {
+	0, 8, 8, 0, 8, 8, 0, 8,
+	8, 0, 8, 8, 0, 8, 8, 0,
+	8, 8, 0, 8, 8, 0, 8, 8,
+};
+
+// Writes count indices of base + pattern, advancing by step every vecs * 8 indices.
+static u16 *GeneratePattern(u16 *out, int count, int base, const u16 *pattern, const u16 *step, int vecs) {
+	if (count <= 0)
+		return out;
+	const int period = vecs * 8;
+	alignas(16) u16 temp[24];
+#if defined(_M_SSE)
+	__m128i cur[3], inc[3];
+	const __m128i vbase = _mm_set1_epi16((s16)base);
+	for (int v = 0; v < vecs; v++) {
+		cur[v] = _mm_add_epi16(_mm_load_si128((const __m128i *)(pattern + v * 8)), vbase);
+		inc[v] = _mm_load_si128((const __m128i *)(step + v * 8));
+	}
+	for (; count >= period; count -= period, out += period) {
+		for (int v = 0; v < vecs; v++) {
+			_mm_storeu_si128((__m128i *)(out + v * 8), cur[v]);
+			cur[v] = _mm_add_epi16(cur[v], inc[v]);
+		}
+	}
+	for (int v = 0; v < vecs; v++)
+		_mm_store_si128((__m128i *)(temp + v * 8), cur[v]);
+#elif PPSSPP_ARCH(ARM_NEON)
+	uint16x8_t cur[3], inc[3];
+	const uint16x8_t vbase = vdupq_n_u16((u16)base);
+	for (int v = 0; v < vecs; v++) {
+		cur[v] = vaddq_u16(vld1q_u16(pattern + v * 8), vbase);
+		inc[v] = vld1q_u16(step + v * 8);
+	}
+	for (; count >= period; count -= period, out += period) {
+		for (int v = 0; v < vecs; v++) {
+			vst1q_u16(out + v * 8, cur[v]);
+			cur[v] = vaddq_u16(cur[v], inc[v]);
+		}
+	}
+	for (int v = 0; v < vecs; v++)
+		vst1q_u16(temp + v * 8, cur[v]);
+#else
+	for (int j = 0; j < period; j++)
+		temp[j] = base + pattern[j];
+	for (; count >= period; count -= period, out += period) {
+		for (int j = 0; j < period; j++) {
+			out[j] = temp[j];
+			temp[j] += step[j];
+		}
+	}
+#endif
+	// Leftovers come from the next period.
+	memcpy(out, temp, count * sizeof(u16));
+	return out + count;
+}
+
+#if defined(_M_SSE)
+static inline __m128i LoadIndices8(const u8 *inds) {
+	return _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)inds), _mm_setzero_si128());
+}
+
+static inline __m128i LoadIndices8(const u16_le *inds) {
+	return _mm_loadu_si128((const __m128i *)inds);
+}
+
+static inline __m128i LoadIndices8(const u32_le *inds) {
+	// Keep the low 16 bits (like the scalar truncation), sign extended so the saturating pack is exact.
+	__m128i lo = _mm_loadu_si128((const __m128i *)inds);
+	__m128i hi = _mm_loadu_si128((const __m128i *)(inds + 4));
+	lo = _mm_srai_epi32(_mm_slli_epi32(lo, 16), 16);
+	hi = _mm_srai_epi32(_mm_slli_epi32(hi, 16), 16);
+	return _mm_packs_epi32(lo, hi);
+}
+#elif PPSSPP_ARCH(ARM_NEON)
+static inline uint16x8_t LoadIndices8(const u8 *inds) {
+	return vmovl_u8(vld1_u8(inds));
+}
+
+static inline uint16x8_t LoadIndices8(const u16_le *inds) {
+	return vld1q_u16((const u16 *)inds);
+}
+
+static inline uint16x8_t LoadIndices8(const u32_le *inds) {
+	return vcombine_u16(vmovn_u32(vld1q_u32((const u32 *)inds)), vmovn_u32(vld1q_u32((const u32 *)inds + 4)));
+}
+#endif
+
+// out[i] = indexOffset + inds[i], the common part of most of the Translate functions.
+template <class ITypeLE>
+static u16 *TranslateIndices(u16 *out, const ITypeLE *inds, int count, int indexOffset) {
+	int i = 0;
+#if defined(_M_SSE)
+	const __m128i voffset = _mm_set1_epi16((s16)indexOffset);
+	for (; i + 8 <= count; i += 8)
+		_mm_storeu_si128((__m128i *)(out + i), _mm_add_epi16(LoadIndices8(inds + i), voffset));
+#elif PPSSPP_ARCH(ARM_NEON)
+	const uint16x8_t voffset = vdupq_n_u16((u16)indexOffset);
+	for (; i + 8 <= count; i += 8)
+		vst1q_u16(out + i, vaddq_u16(LoadIndices8(inds + i), voffset));
+#endif
+	for (; i < count; i++)
+		out[i] = indexOffset + inds[i];
+	return out + count;
+}
+
 void IndexGenerator::Setup(u16 *inds) {
 	this->indsBase_ = inds;
 	Reset();
@@ -49,11 +187,7 @@ void IndexGenerator::AddPrim(int prim, int vertexCount) {
 }
 
 void IndexGenerator::AddPoints(int numVerts) {
-	u16 *outInds = inds_;
-	const int startIndex = index_;
-	for (int i = 0; i < numVerts; i++)
-		*outInds++ = startIndex + i;
-	inds_ = outInds;
+	inds_ = GeneratePattern(inds_, numVerts, index_, seqPattern, seqStep, 1);
 	// ignore overflow verts
 	index_ += numVerts;
 	count_ += numVerts;
@@ -62,14 +196,9 @@ void IndexGenerator::AddPoints(int numVerts) {
 }
 
 void IndexGenerator::AddList(int numVerts) {
-	u16 *outInds = inds_;
-	const int startIndex = index_;
-	for (int i = 0; i < numVerts; i += 3) {
-		*outInds++ = startIndex + i;
-		*outInds++ = startIndex + i + 1;
-		*outInds++ = startIndex + i + 2;
-	}
-	inds_ = outInds;
+	// Partial triangles still get all three indices written.
+	const int numTris = (numVerts + 2) / 3;
+	inds_ = GeneratePattern(inds_, numTris * 3, index_, seqPattern, seqStep, 1);
 	// ignore overflow verts
 	index_ += numVerts;
 	count_ += numVerts;
@@ -78,18 +207,8 @@ void IndexGenerator::AddList(int numVerts) {
 }
 
 void IndexGenerator::AddStrip(int numVerts) {
-	int wind = 1;
 	const int numTris = numVerts - 2;
-	u16 *outInds = inds_;
-	int ibase = index_;
-	for (int i = 0; i < numTris; i++) {
-		*outInds++ = ibase;
-		*outInds++ = ibase + wind;
-		wind ^= 3;  // toggle between 1 and 2
-		*outInds++ = ibase + wind;
-		ibase++;
-	}
-	inds_ = outInds;
+	inds_ = GeneratePattern(inds_, numTris * 3, index_, stripPattern, stripStep, 3);
 	index_ += numVerts;
 	if (numTris > 0)
 		count_ += numTris * 3;
@@ -107,14 +226,7 @@ void IndexGenerator::AddStrip(int numVerts) {
 
 void IndexGenerator::AddFan(int numVerts) {
 	const int numTris = numVerts - 2;
-	u16 *outInds = inds_;
-	const int startIndex = index_;
-	for (int i = 0; i < numTris; i++) {
-		*outInds++ = startIndex;
-		*outInds++ = startIndex + i + 1;
-		*outInds++ = startIndex + i + 2;
-	}
-	inds_ = outInds;
+	inds_ = GeneratePattern(inds_, numTris * 3, index_, fanPattern, fanStep, 3);
 	index_ += numVerts;
 	count_ += numTris * 3;
 	prim_ = GE_PRIM_TRIANGLES;
@@ -123,13 +235,8 @@ void IndexGenerator::AddFan(int numVerts) {
 
 //Lines
 void IndexGenerator::AddLineList(int numVerts) {
-	u16 *outInds = inds_;
-	const int startIndex = index_;
-	for (int i = 0; i < numVerts; i += 2) {
-		*outInds++ = startIndex + i;
-		*outInds++ = startIndex + i + 1;
-	}
-	inds_ = outInds;
+	const int numLines = (numVerts + 1) / 2;
+	inds_ = GeneratePattern(inds_, numLines * 2, index_, seqPattern, seqStep, 1);
 	index_ += numVerts;
 	count_ += numVerts;
 	prim_ = GE_PRIM_LINES;
@@ -138,13 +245,7 @@ void IndexGenerator::AddLineList(int numVerts) {
 
 void IndexGenerator::AddLineStrip(int numVerts) {
 	const int numLines = numVerts - 1;
-	u16 *outInds = inds_;
-	const int startIndex = index_;
-	for (int i = 0; i < numLines; i++) {
-		*outInds++ = startIndex + i;
-		*outInds++ = startIndex + i + 1;
-	}
-	inds_ = outInds;
+	inds_ = GeneratePattern(inds_, numLines * 2, index_, lineStripPattern, lineStripStep, 1);
 	index_ += numVerts;
 	count_ += numLines * 2;
 	prim_ = GE_PRIM_LINES;
@@ -152,15 +253,9 @@ void IndexGenerator::AddLineStrip(int numVerts) {
 }
 
 void IndexGenerator::AddRectangles(int numVerts) {
-	u16 *outInds = inds_;
-	const int startIndex = index_;
 	//rectangles always need 2 vertices, disregard the last one if there's an odd number
 	numVerts = numVerts & ~1;
-	for (int i = 0; i < numVerts; i += 2) {
-		*outInds++ = startIndex + i;
-		*outInds++ = startIndex + i + 1;
-	}
-	inds_ = outInds;
+	inds_ = GeneratePattern(inds_, numVerts, index_, seqPattern, seqStep, 1);
 	index_ += numVerts;
 	count_ += numVerts;
 	prim_ = GE_PRIM_RECTANGLES;
@@ -170,10 +265,7 @@ void IndexGenerator::AddRectangles(int numVerts) {
 template <class ITypeLE, int flag>
 void IndexGenerator::TranslatePoints(int numInds, const ITypeLE *inds, int indexOffset) {
 	indexOffset = index_ - indexOffset;
-	u16 *outInds = inds_;
-	for (int i = 0; i < numInds; i++)
-		*outInds++ = indexOffset + inds[i];
-	inds_ = outInds;
+	inds_ = TranslateIndices(inds_, inds, numInds, indexOffset);
 	count_ += numInds;
 	prim_ = GE_PRIM_POINTS;
 	seenPrims_ |= (1 << GE_PRIM_POINTS) | flag;
@@ -182,13 +274,8 @@ void IndexGenerator::TranslatePoints(int numInds, const ITypeLE *inds, int index
 template <class ITypeLE, int flag>
 void IndexGenerator::TranslateLineList(int numInds, const ITypeLE *inds, int indexOffset) {
 	indexOffset = index_ - indexOffset;
-	u16 *outInds = inds_;
 	numInds = numInds & ~1;
-	for (int i = 0; i < numInds; i += 2) {
-		*outInds++ = indexOffset + inds[i];
-		*outInds++ = indexOffset + inds[i + 1];
-	}
-	inds_ = outInds;
+	inds_ = TranslateIndices(inds_, inds, numInds, indexOffset);
 	count_ += numInds;
 	prim_ = GE_PRIM_LINES;
 	seenPrims_ |= (1 << GE_PRIM_LINES) | flag;
@@ -199,7 +286,25 @@ void IndexGenerator::TranslateLineStrip(int numInds, const ITypeLE *inds, int in
 	indexOffset = index_ - indexOffset;
 	int numLines = numInds - 1;
 	u16 *outInds = inds_;
-	for (int i = 0; i < numLines; i++) {
+	int i = 0;
+#if defined(_M_SSE)
+	const __m128i voffset = _mm_set1_epi16((s16)indexOffset);
+	for (; i + 9 <= numInds; i += 8, outInds += 16) {
+		__m128i a = _mm_add_epi16(LoadIndices8(inds + i), voffset);
+		__m128i b = _mm_add_epi16(LoadIndices8(inds + i + 1), voffset);
+		_mm_storeu_si128((__m128i *)outInds, _mm_unpacklo_epi16(a, b));
+		_mm_storeu_si128((__m128i *)(outInds + 8), _mm_unpackhi_epi16(a, b));
+	}
+#elif PPSSPP_ARCH(ARM_NEON)
+	const uint16x8_t voffset = vdupq_n_u16((u16)indexOffset);
+	for (; i + 9 <= numInds; i += 8, outInds += 16) {
+		uint16x8x2_t lines;
+		lines.val[0] = vaddq_u16(LoadIndices8(inds + i), voffset);
+		lines.val[1] = vaddq_u16(LoadIndices8(inds + i + 1), voffset);
+		vst2q_u16(outInds, lines);
+	}
+#endif
+	for (; i < numLines; i++) {
 		*outInds++ = indexOffset + inds[i];
 		*outInds++ = indexOffset + inds[i + 1];
 	}
@@ -219,15 +324,9 @@ void IndexGenerator::TranslateList(int numInds, const ITypeLE *inds, int indexOf
 		inds_ += numInds;
 		count_ += numInds;
 	} else {
-		u16 *outInds = inds_;
 		int numTris = numInds / 3;  // Round to whole triangles
 		numInds = numTris * 3;
-		for (int i = 0; i < numInds; i += 3) {
-			*outInds++ = indexOffset + inds[i];
-			*outInds++ = indexOffset + inds[i + 1];
-			*outInds++ = indexOffset + inds[i + 2];
-		}
-		inds_ = outInds;
+		inds_ = TranslateIndices(inds_, inds, numInds, indexOffset);
 		count_ += numInds;
 	}
 	prim_ = GE_PRIM_TRIANGLES;
@@ -240,7 +339,33 @@ void IndexGenerator::TranslateStrip(int numInds, const ITypeLE *inds, int indexO
 	indexOffset = index_ - indexOffset;
 	int numTris = numInds - 2;
 	u16 *outInds = inds_;
-	for (int i = 0; i < numTris; i++) {
+	int i = 0;
+#if defined(_M_SSE)
+	// Four triangles at a time, from eight loaded indices: 0 1 2, 1 3 2, 2 3 4, 3 5 4.
+	const __m128i voffset = _mm_set1_epi16((s16)indexOffset);
+	for (; i + 8 <= numInds; i += 4, outInds += 12) {
+		__m128i v = _mm_add_epi16(LoadIndices8(inds + i), voffset);
+		__m128i first = _mm_shufflelo_epi16(v, _MM_SHUFFLE(1, 2, 1, 0));
+		__m128i second = _mm_shufflelo_epi16(v, _MM_SHUFFLE(3, 2, 2, 3));
+		_mm_storeu_si128((__m128i *)outInds, _mm_unpacklo_epi64(first, second));
+		__m128i third = _mm_shufflelo_epi16(_mm_srli_si128(v, 6), _MM_SHUFFLE(1, 2, 0, 1));
+		_mm_storel_epi64((__m128i *)(outInds + 8), third);
+	}
+#elif PPSSPP_ARCH(ARM_NEON)
+	// Eight triangles at a time, swapping the last two of every odd one.
+	const uint16x8_t voffset = vdupq_n_u16((u16)indexOffset);
+	const uint16x8_t oddMask = vreinterpretq_u16_u32(vdupq_n_u32(0xFFFF0000));
+	for (; i + 10 <= numInds; i += 8, outInds += 24) {
+		uint16x8_t b = vaddq_u16(LoadIndices8(inds + i + 1), voffset);
+		uint16x8_t c = vaddq_u16(LoadIndices8(inds + i + 2), voffset);
+		uint16x8x3_t tris;
+		tris.val[0] = vaddq_u16(LoadIndices8(inds + i), voffset);
+		tris.val[1] = vbslq_u16(oddMask, c, b);
+		tris.val[2] = vbslq_u16(oddMask, b, c);
+		vst3q_u16(outInds, tris);
+	}
+#endif
+	for (; i < numTris; i++) {
 		*outInds++ = indexOffset + inds[i];
 		*outInds++ = indexOffset + inds[i + wind];
 		wind ^= 3;  // Toggle between 1 and 2
@@ -258,7 +383,31 @@ void IndexGenerator::TranslateFan(int numInds, const ITypeLE *inds, int indexOff
 	indexOffset = index_ - indexOffset;
 	int numTris = numInds - 2;
 	u16 *outInds = inds_;
-	for (int i = 0; i < numTris; i++) {
+	int i = 0;
+#if defined(_M_SSE)
+	// Four triangles at a time: c 0 1, c 1 2, c 2 3, c 3 4, with c the first index.
+	const __m128i voffset = _mm_set1_epi16((s16)indexOffset);
+	const int center = (u16)(indexOffset + inds[0]);
+	for (; i + 9 <= numInds; i += 4, outInds += 12) {
+		__m128i v = _mm_add_epi16(LoadIndices8(inds + i + 1), voffset);
+		__m128i first = _mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 0, 0));
+		first = _mm_insert_epi16(_mm_insert_epi16(first, center, 0), center, 3);
+		__m128i second = _mm_insert_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 0, 2, 1)), center, 2);
+		_mm_storeu_si128((__m128i *)outInds, _mm_unpacklo_epi64(first, second));
+		__m128i third = _mm_shufflelo_epi16(_mm_srli_si128(v, 6), _MM_SHUFFLE(1, 0, 0, 0));
+		_mm_storel_epi64((__m128i *)(outInds + 8), _mm_insert_epi16(third, center, 1));
+	}
+#elif PPSSPP_ARCH(ARM_NEON)
+	const uint16x8_t voffset = vdupq_n_u16((u16)indexOffset);
+	for (; i + 10 <= numInds; i += 8, outInds += 24) {
+		uint16x8x3_t tris;
+		tris.val[0] = vdupq_n_u16((u16)(indexOffset + inds[0]));
+		tris.val[1] = vaddq_u16(LoadIndices8(inds + i + 1), voffset);
+		tris.val[2] = vaddq_u16(LoadIndices8(inds + i + 2), voffset);
+		vst3q_u16(outInds, tris);
+	}
+#endif
+	for (; i < numTris; i++) {
 		*outInds++ = indexOffset + inds[0];
 		*outInds++ = indexOffset + inds[i + 1];
 		*outInds++ = indexOffset + inds[i + 2];
@@ -272,14 +421,9 @@ void IndexGenerator::TranslateFan(int numInds, const ITypeLE *inds, int indexOff
 template <class ITypeLE, int flag>
 inline void IndexGenerator::TranslateRectangles(int numInds, const ITypeLE *inds, int indexOffset) {
 	indexOffset = index_ - indexOffset;
-	u16 *outInds = inds_;
 	//rectangles always need 2 vertices, disregard the last one if there's an odd number
 	numInds = numInds & ~1;
-	for (int i = 0; i < numInds; i += 2) {
-		*outInds++ = indexOffset + inds[i];
-		*outInds++ = indexOffset + inds[i+1];
-	}
-	inds_ = outInds;
+	inds_ = TranslateIndices(inds_, inds, numInds, indexOffset);
 	count_ += numInds;
 	prim_ = GE_PRIM_RECTANGLES;
 	seenPrims_ |= (1 << GE_PRIM_RECTANGLES) | flag;
@@ -43,6 +43,7 @@ void LoadPostShaderInfo(std::vector<std::string> directories) {
 	off.outputResolution = false;
 	off.isUpscalingFilter = false;
 	off.requires60fps = false;
+	off.scale = 1.0f;
 	shaderInfo.push_back(off);
 
 	for (size_t d = 0; d < directories.size(); d++) {
@@ -88,6 +89,10 @@ void LoadPostShaderInfo(std::vector<std::string> directories) {
 					section.Get("OutputResolution", &info.outputResolution, false);
 					section.Get("Upscaling", &info.isUpscalingFilter, false);
 					section.Get("60fps", &info.requires60fps, false);
+					section.Get("Next", &info.next, "");
+					section.Get("Scale", &info.scale, 1.0f);
+					if (info.scale <= 0.0f || info.scale > 4.0f)
+						info.scale = 1.0f;
 
 					// Let's ignore shaders we can't support. TODO: Not a very good check
 					if (gl_extensions.IsGLES && !gl_extensions.GLES3) {
@@ -124,6 +129,19 @@ const ShaderInfo *GetPostShaderInfo(std::string name) {
 	return nullptr;
 }
 
+std::vector<const ShaderInfo *> GetPostShaderChain(const std::string &name, size_t maxPasses) {
+	std::vector<const ShaderInfo *> chain;
+	const ShaderInfo *info = GetPostShaderInfo(name);
+	while (info && chain.size() < maxPasses) {
+		// Don't loop forever on a chain that refers back to itself.
+		if (std::find(chain.begin(), chain.end(), info) != chain.end())
+			break;
+		chain.push_back(info);
+		info = info->next.empty() ? nullptr : GetPostShaderInfo(info->next);
+	}
+	return chain;
+}
+
 const std::vector<ShaderInfo> &GetAllPostShaderInfo() {
 	return shaderInfo;
 }
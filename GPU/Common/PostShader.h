@@ -38,9 +38,14 @@ struct ShaderInfo {
 	bool isUpscalingFilter;
 	// Force constant/max refresh for animated filters
 	bool requires60fps;
+	// Section of the shader to run on this one's output, for multi-pass chains. Empty if last.
+	std::string next;
+	// Size of this pass' render target relative to its input, like 0.25 for a bloom pass.
+	// Ignored for a final pass at output resolution.
+	float scale;
 
 	// TODO: Add support for all kinds of fun options like mapping the depth buffer,
-	// SRGB texture reads, multiple shaders chained, etc.
+	// SRGB texture reads, etc.
 
 	bool operator == (const std::string &other) {
 		return name == other;
@@ -53,4 +58,6 @@ struct ShaderInfo {
 void ReloadAllPostShaderInfo();
 
 const ShaderInfo *GetPostShaderInfo(std::string name);
+// The shader and everything chained after it with Next, in order. Empty if not found.
+std::vector<const ShaderInfo *> GetPostShaderChain(const std::string &name, size_t maxPasses);
 const std::vector<ShaderInfo> &GetAllPostShaderInfo();
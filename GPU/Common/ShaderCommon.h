@@ -72,6 +72,7 @@ enum : uint64_t {
 
 	DIRTY_UVSCALEOFFSET = 1ULL << 18,
 	DIRTY_DEPTHRANGE = 1ULL << 19,
+	DIRTY_FRAGMENTTEST_COORD = 1ULL << 20,  // GLES only, row in the fragment test atlas.
 
 	DIRTY_WORLDMATRIX = 1ULL << 21,
 	DIRTY_VIEWMATRIX = 1ULL << 22,
@@ -15,7 +15,7 @@ enum {
 	VS_BIT_DO_TEXTURE = 4,
 	// 5 is free.
 	VS_BIT_DO_TEXTURE_TRANSFORM = 6,
-	// 7 is free.
+	VS_BIT_RECT_INSTANCED = 7,  // conditioned on !hw transform, one instance per through mode rectangle
 	VS_BIT_USE_HW_TRANSFORM = 8,
 	VS_BIT_HAS_NORMAL = 9,  // conditioned on hw transform
 	VS_BIT_NORM_REVERSE = 10,
@@ -57,7 +57,7 @@ enum {
 	FS_BIT_DO_TEXTURE = 1,
 	FS_BIT_TEXFUNC = 2,  // 3 bits
 	FS_BIT_TEXALPHA = 5,
-	// 6 is free.
+	FS_BIT_SHADER_CLUT_LOOKUP = 6,
 	FS_BIT_SHADER_TEX_CLAMP = 7,
 	FS_BIT_CLAMP_S = 8,
 	FS_BIT_CLAMP_T = 9,
@@ -141,6 +141,10 @@ struct ShaderID {
 			d[bit >> 5] |= (value & mask) << (bit & 31);
 		}
 	}
+	void ClearBits(int bit, int count) {
+		const int mask = (1 << count) - 1;
+		d[bit >> 5] &= ~(mask << (bit & 31));
+	}
 
 	void ToString(std::string *dest) const {
 		dest->resize(sizeof(d));
@@ -15,6 +15,8 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#include <algorithm>
+
 #include "math/math_util.h"
 #include "gfx_es2/gpu_features.h"
 
@@ -125,6 +127,141 @@ static bool IsReallyAClear(const TransformedVertex *transformed, int numVerts, f
 	return true;
 }
 
+#if defined(_M_SSE)
+// The loop in SoftwareTransform handles every format, this handles the common case four verts
+// at a time: float positions, plain texcoords, and 8888 or no color.  Results are identical.
+static bool CanTransformVertsSSE(const DecVtxFormat &decVtxFormat) {
+	if (decVtxFormat.posfmt != DEC_FLOAT_3)
+		return false;
+	if (decVtxFormat.uvfmt != DEC_NONE && decVtxFormat.uvfmt != DEC_FLOAT_2)
+		return false;
+	if (decVtxFormat.c0fmt != DEC_NONE && decVtxFormat.c0fmt != DEC_U8_4)
+		return false;
+	switch (gstate.getUVGenMode()) {
+	case GE_TEXMAP_TEXTURE_COORDS:
+	case GE_TEXMAP_UNKNOWN:
+		return true;
+	default:
+		return false;
+	}
+}
+
+// Computes m * v (with translation if m is a full 4x3) for four verts in SoA form.
+static inline void Vec3ByMatrix43SSE(__m128 out[3], const __m128 v[3], const float m[12], bool translate) {
+	for (int i = 0; i < 3; i++) {
+		__m128 r = _mm_add_ps(_mm_mul_ps(v[0], _mm_set1_ps(m[i])), _mm_mul_ps(v[1], _mm_set1_ps(m[3 + i])));
+		r = _mm_add_ps(r, _mm_mul_ps(v[2], _mm_set1_ps(m[6 + i])));
+		out[i] = translate ? _mm_add_ps(r, _mm_set1_ps(m[9 + i])) : r;
+	}
+}
+
+static void TransformVertsSSE(const u8 *decoded, const DecVtxFormat &decVtxFormat, int vertType, int maxIndex, TransformedVertex *transformed,
+	Lighter &lighter, bool lmode, float widthFactor, float heightFactor, float fog_end, float fog_slope) {
+	VertexReader reader((u8 *)decoded, decVtxFormat, vertType);
+	const int stride = decVtxFormat.stride;
+	const bool hasColor = decVtxFormat.c0fmt != DEC_NONE;
+	const bool hasUV = decVtxFormat.uvfmt != DEC_NONE;
+	const bool lighting = gstate.isLightingEnabled();
+	const bool hasNormal = lighting && decVtxFormat.nrmfmt != DEC_NONE;
+	const bool reverseNormals = gstate.areNormalsReversed();
+	const u32 materialAmbient = gstate.getMaterialAmbientRGBA();
+
+	alignas(16) float world[3][4];
+	alignas(16) float view[3][4];
+	alignas(16) float worldNormal[3][4];
+
+	for (int base = 0; base < maxIndex; base += 4) {
+		const int count = std::min(4, maxIndex - base);
+
+		// The last group repeats the final vert rather than reading past the end.
+		const u8 *p0 = decoded + base * stride + decVtxFormat.posoff;
+		const float *p[4];
+		for (int i = 0; i < 4; i++)
+			p[i] = (const float *)(p0 + std::min(i, count - 1) * stride);
+
+		__m128 pos[3];
+		for (int c = 0; c < 3; c++)
+			pos[c] = _mm_set_ps(p[3][c], p[2][c], p[1][c], p[0][c]);
+
+		__m128 out[3];
+		Vec3ByMatrix43SSE(out, pos, gstate.worldMatrix, true);
+		__m128 v[3];
+		Vec3ByMatrix43SSE(v, out, gstate.viewMatrix, true);
+		for (int c = 0; c < 3; c++) {
+			_mm_store_ps(world[c], out[c]);
+			_mm_store_ps(view[c], v[c]);
+		}
+
+		if (hasNormal) {
+			alignas(16) float n[3][4];
+			for (int i = 0; i < 4; i++) {
+				float normal[3];
+				reader.Goto(base + std::min(i, count - 1));
+				reader.ReadNrm(normal);
+				for (int c = 0; c < 3; c++)
+					n[c][i] = reverseNormals ? -normal[c] : normal[c];
+			}
+			__m128 nrm[3];
+			for (int c = 0; c < 3; c++)
+				nrm[c] = _mm_load_ps(n[c]);
+
+			__m128 wn[3];
+			Vec3ByMatrix43SSE(wn, nrm, gstate.worldMatrix, false);
+			// Same operation order as Vec3f::Length(), so the normalized result matches.
+			__m128 len2 = _mm_add_ps(_mm_mul_ps(wn[0], wn[0]), _mm_add_ps(_mm_mul_ps(wn[1], wn[1]), _mm_mul_ps(wn[2], wn[2])));
+			__m128 len = _mm_sqrt_ps(len2);
+			for (int c = 0; c < 3; c++)
+				_mm_store_ps(worldNormal[c], _mm_div_ps(wn[c], len));
+		}
+
+		for (int i = 0; i < count; i++) {
+			const int index = base + i;
+			const u8 *vert = decoded + index * stride;
+			TransformedVertex &tv = transformed[index];
+
+			u32 color0 = materialAmbient;
+			if (hasColor)
+				memcpy(&color0, vert + decVtxFormat.c0off, 4);
+
+			if (lighting) {
+				Vec3f worldnormal(0, 0, 1);
+				if (hasNormal)
+					worldnormal = Vec3f(worldNormal[0][i], worldNormal[1][i], worldNormal[2][i]);
+				Vec3f worldpos(world[0][i], world[1][i], world[2][i]);
+
+				Vec4f unlitColor = Vec4f::FromRGBA(color0);
+				Vec4f litColor0;
+				Vec4f litColor1;
+				lighter.Light(litColor0.AsArray(), litColor1.AsArray(), unlitColor.AsArray(), worldpos, worldnormal);
+				if (lmode) {
+					tv.color0_32 = litColor0.ToRGBA();
+					tv.color1_32 = litColor1.ToRGBA();
+				} else {
+					tv.color0_32 = (litColor0 + litColor1).ToRGBA();
+					tv.color1_32 = 0;
+				}
+			} else {
+				// The float round trip in the scalar path is exact, so just copy.
+				tv.color0_32 = color0;
+				tv.color1_32 = 0;
+			}
+
+			float ruv[2] = { 0.0f, 0.0f };
+			if (hasUV)
+				memcpy(ruv, vert + decVtxFormat.uvoff, sizeof(ruv));
+			tv.u = ruv[0] * widthFactor;
+			tv.v = ruv[1] * heightFactor;
+			tv.w = 1.0f;
+
+			tv.x = view[0][i];
+			tv.y = view[1][i];
+			tv.z = view[2][i];
+			tv.fog = (view[2][i] + fog_end) * fog_slope;
+		}
+	}
+}
+#endif
+
 void SoftwareTransform(
 	int prim, int vertexCount, u32 vertType, u16 *&inds, int indexType,
 	const DecVtxFormat &decVtxFormat, int &maxIndex, TransformedVertex *&drawBuffer, int &numTrans, bool &drawIndexed, const SoftwareTransformParams *params, SoftwareTransformResult *result) {
@@ -194,6 +331,10 @@ void SoftwareTransform(
 			// Ignore color1 and fog, never used in throughmode anyway.
 			// The w of uv is also never used (hardcoded to 1.0.)
 		}
+#if defined(_M_SSE)
+	} else if (CanTransformVertsSSE(decVtxFormat)) {
+		TransformVertsSSE(decoded, decVtxFormat, vertType, maxIndex, transformed, lighter, lmode, widthFactor, heightFactor, fog_end, fog_slope);
+#endif
 	} else {
 		// Okay, need to actually perform the full transform.
 		for (int index = 0; index < maxIndex; index++) {
@@ -427,6 +568,24 @@ void SoftwareTransform(
 		// We can simply draw the unexpanded buffer.
 		numTrans = vertexCount;
 		drawIndexed = true;
+	} else if (params->allowRectInstances) {
+		// Just pair up the corners, the vertex shader does the expansion and UV rotation.
+		vertexCount = vertexCount & ~1;
+		RectInstance *rects = (RectInstance *)transformedExpanded;
+		const u16 *indsIn = (const u16 *)inds;
+		for (int i = 0; i < vertexCount; i += 2) {
+			const TransformedVertex &transVtxTL = transformed[indsIn[i + 0]];
+			RectInstance &rect = rects[i / 2];
+			rect.br = transformed[indsIn[i + 1]];
+			rect.tlX = transVtxTL.x;
+			rect.tlY = transVtxTL.y;
+			rect.tlU = transVtxTL.u;
+			rect.tlV = transVtxTL.v;
+		}
+		drawBuffer = transformedExpanded;
+		numTrans = vertexCount / 2;
+		result->action = SW_DRAW_RECT_INSTANCES;
+		return;
 	} else {
 		bool useBufferedRendering = g_Config.iRenderingMode != FB_NON_BUFFERED_MODE;
 		if (useBufferedRendering)
@@ -27,6 +27,14 @@ class TextureCacheCommon;
 enum SoftwareTransformAction {
 	SW_DRAW_PRIMITIVES,
 	SW_CLEAR,
+	SW_DRAW_RECT_INSTANCES,
+};
+
+// One through mode rectangle, for backends that expand it into a quad in the vertex shader.
+// The bottom right vertex supplies z and the colors for the whole rectangle.
+struct RectInstance {
+	TransformedVertex br;
+	float tlX, tlY, tlU, tlV;
 };
 
 struct SoftwareTransformResult {
@@ -46,6 +54,8 @@ struct SoftwareTransformParams {
 	TextureCacheCommon *texCache;
 	bool allowClear;
 	bool allowSeparateAlphaClear;
+	// Only set for through mode, non-clear rectangles. Then drawBuffer receives numTrans RectInstances.
+	bool allowRectInstances;
 };
 
 void SoftwareTransform(int prim, int vertexCount, u32 vertexType, u16 *&inds, int indexType, const DecVtxFormat &decVtxFormat, int &maxIndex, TransformedVertex *&drawBuffer,
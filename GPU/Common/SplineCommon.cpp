@@ -17,11 +17,14 @@
 
 #include <string.h>
 #include <algorithm>
+#include <unordered_map>
+#include <vector>
 
 #include "profiler/profiler.h"
 
 #include "Common/CPUDetect.h"
 #include "Common/MemoryUtil.h"
+#include "Common/ThreadPools.h"
 #include "Core/Config.h"
 
 #include "GPU/Common/SplineCommon.h"
@@ -123,31 +126,35 @@ inline float bern1deriv(float x) { return 9 * x * x - 12 * x + 3; }
 inline float bern2deriv(float x) { return 3 * (2 - 3 * x) * x; }
 inline float bern3deriv(float x) { return 3 * x * x; }
 
-// http://en.wikipedia.org/wiki/Bernstein_polynomial
-static Math3D::Vec2f Bernstein3D(const Math3D::Vec2f& p0, const Math3D::Vec2f& p1, const Math3D::Vec2f& p2, const Math3D::Vec2f& p3, float x) {
-	if (x == 0) return p0;
-	else if (x == 1) return p3;
-	return p0 * bern0(x) + p1 * bern1(x) + p2 * bern2(x) + p3 * bern3(x);
+// Sums of four points with the same four weights, the bulk of the work in evaluating a patch.
+static inline Math3D::Vec2f WeightedSum(const Math3D::Vec2f &p0, const Math3D::Vec2f &p1, const Math3D::Vec2f &p2, const Math3D::Vec2f &p3, const float w[4]) {
+	return p0 * w[0] + p1 * w[1] + p2 * w[2] + p3 * w[3];
 }
 
-static Vec3f Bernstein3D(const Vec3f& p0, const Vec3f& p1, const Vec3f& p2, const Vec3f& p3, float x) {
-	if (x == 0) return p0;
-	else if (x == 1) return p3;
-	return p0 * bern0(x) + p1 * bern1(x) + p2 * bern2(x) + p3 * bern3(x);
-}
-
-static Vec4f Bernstein3D(const Vec4f& p0, const Vec4f& p1, const Vec4f& p2, const Vec4f& p3, float x) {
-	if (x == 0) return p0;
-	else if (x == 1) return p3;
-	return p0 * bern0(x) + p1 * bern1(x) + p2 * bern2(x) + p3 * bern3(x);
-}
-
-static Vec4f Bernstein3D(const u32& p0, const u32& p1, const u32& p2, const u32& p3, float x) {
-	return Bernstein3D(Vec4f::FromRGBA(p0), Vec4f::FromRGBA(p1), Vec4f::FromRGBA(p2), Vec4f::FromRGBA(p3), x);
+static inline Vec3f WeightedSum(const Vec3f &p0, const Vec3f &p1, const Vec3f &p2, const Vec3f &p3, const float w[4]) {
+#ifdef _M_SSE
+	const __m128 wv = _mm_loadu_ps(w);
+	__m128 res = _mm_mul_ps(p0.vec, _mm_shuffle_ps(wv, wv, _MM_SHUFFLE(0, 0, 0, 0)));
+	res = _mm_add_ps(res, _mm_mul_ps(p1.vec, _mm_shuffle_ps(wv, wv, _MM_SHUFFLE(1, 1, 1, 1))));
+	res = _mm_add_ps(res, _mm_mul_ps(p2.vec, _mm_shuffle_ps(wv, wv, _MM_SHUFFLE(2, 2, 2, 2))));
+	res = _mm_add_ps(res, _mm_mul_ps(p3.vec, _mm_shuffle_ps(wv, wv, _MM_SHUFFLE(3, 3, 3, 3))));
+	return Vec3f(res);
+#else
+	return p0 * w[0] + p1 * w[1] + p2 * w[2] + p3 * w[3];
+#endif
 }
 
-static Vec3f Bernstein3DDerivative(const Vec3f& p0, const Vec3f& p1, const Vec3f& p2, const Vec3f& p3, float x) {
-	return p0 * bern0deriv(x) + p1 * bern1deriv(x) + p2 * bern2deriv(x) + p3 * bern3deriv(x);
+static inline Vec4f WeightedSum(const Vec4f &p0, const Vec4f &p1, const Vec4f &p2, const Vec4f &p3, const float w[4]) {
+#ifdef _M_SSE
+	const __m128 wv = _mm_loadu_ps(w);
+	__m128 res = _mm_mul_ps(p0.vec, _mm_shuffle_ps(wv, wv, _MM_SHUFFLE(0, 0, 0, 0)));
+	res = _mm_add_ps(res, _mm_mul_ps(p1.vec, _mm_shuffle_ps(wv, wv, _MM_SHUFFLE(1, 1, 1, 1))));
+	res = _mm_add_ps(res, _mm_mul_ps(p2.vec, _mm_shuffle_ps(wv, wv, _MM_SHUFFLE(2, 2, 2, 2))));
+	res = _mm_add_ps(res, _mm_mul_ps(p3.vec, _mm_shuffle_ps(wv, wv, _MM_SHUFFLE(3, 3, 3, 3))));
+	return Vec4f(res);
+#else
+	return p0 * w[0] + p1 * w[1] + p2 * w[2] + p3 * w[3];
+#endif
 }
 
 static void spline_n_4(int i, float t, float *knot, float *splineVal) {
@@ -223,6 +230,90 @@ static void spline_knot(int n, int type, float *knot) {
 	}
 }
 
+// The instanced mesh only depends on these, the control points are all read in the shader.
+// Zero is never a valid key.
+static u32 HardwareTessGridKey(bool spline, int tess_u, int tess_v, GEPatchPrimType primType) {
+	return 0x80000000 | ((spline ? 1 : 0) << 24) | ((u32)primType << 16) | ((tess_v & 0xFF) << 8) | (tess_u & 0xFF);
+}
+
+// The basis weights only depend on the tessellation (and the knots, for splines), not the
+// control points, so they're kept around for the next patch.
+struct SplineWeight {
+	// First control point the weights apply to, splines only.
+	int index;
+	float basis[4];
+	// Beziers only.
+	float deriv[4];
+};
+
+enum {
+	WEIGHT_CACHE_MAX = 64,
+	// Below this, the thread pool costs more than it saves.
+	PARALLEL_MIN_VERTICES = 2048,
+};
+
+static std::unordered_map<u64, std::vector<SplineWeight>> weightCache;
+
+// Call before looking up weights, the pointers stay valid until the next call.
+static void TrimWeightCache() {
+	if (weightCache.size() >= WEIGHT_CACHE_MAX)
+		weightCache.clear();
+}
+
+static const SplineWeight *GetBezierWeights(int tess) {
+	const u64 key = (u64)tess;
+	auto it = weightCache.find(key);
+	if (it != weightCache.end())
+		return it->second.data();
+
+	std::vector<SplineWeight> &weights = weightCache[key];
+	weights.resize(tess + 1);
+	for (int i = 0; i < tess + 1; i++) {
+		const float t = (float)i / (float)tess;
+		SplineWeight &w = weights[i];
+		w.index = 0;
+		w.basis[0] = bern0(t);
+		w.basis[1] = bern1(t);
+		w.basis[2] = bern2(t);
+		w.basis[3] = bern3(t);
+		w.deriv[0] = bern0deriv(t);
+		w.deriv[1] = bern1deriv(t);
+		w.deriv[2] = bern2deriv(t);
+		w.deriv[3] = bern3deriv(t);
+	}
+	return weights.data();
+}
+
+static const SplineWeight *GetSplineWeights(int count, int type, int div) {
+	const u64 key = (1ULL << 63) | ((u64)count << 32) | ((u64)type << 24) | (u64)div;
+	auto it = weightCache.find(key);
+	if (it != weightCache.end())
+		return it->second.data();
+
+	std::vector<float> knot(count + 4);
+	spline_knot(count - 1, type, knot.data());
+
+	std::vector<SplineWeight> &weights = weightCache[key];
+	weights.resize(div + 1);
+	const float one_over_div = 1.0f / (float)div;
+	for (int i = 0; i < div + 1; i++) {
+		float t = (float)i * (float)(count - 3) * one_over_div;
+		if (t < 0.0f)
+			t = 0.0f;
+		int index = (int)t;
+		// TODO: Would really like to fix the surrounding logic somehow to get rid of these but I can't quite get it right..
+		// Without the previous epsilons and with large count_u, we will end up doing an out of bounds access later without these.
+		if (index >= count - 3)
+			index = count - 4;
+
+		SplineWeight &w = weights[i];
+		w.index = index;
+		spline_n_4(index, t, knot.data(), w.basis);
+		memset(w.deriv, 0, sizeof(w.deriv));
+	}
+	return weights.data();
+}
+
 // Prepare mesh of one patch for "Instanced Tessellation".
 static void TessellateSplinePatchHardware(u8 *&dest, u16 *indices, int &count, const SplinePatchLocal &spatch) {
 	SimpleVertex *&vertices = (SimpleVertex*&)dest;
@@ -347,12 +438,6 @@ static inline void AccumulateWeighted(Vec4f &out, const Vec4f &in, const Vec4f &
 template <bool origNrm, bool origCol, bool origTc, bool useSSE4>
 static void SplinePatchFullQuality(u8 *&dest, u16 *indices, int &count, const SplinePatchLocal &spatch, u32 origVertType, int quality, int maxVertices) {
 	// Full (mostly) correct tessellation of spline patches.
-	// Not very fast.
-
-	float *knot_u = new float[spatch.count_u + 4];
-	float *knot_v = new float[spatch.count_v + 4];
-	spline_knot(spatch.count_u - 1, spatch.type_u, knot_u);
-	spline_knot(spatch.count_v - 1, spatch.type_v, knot_v);
 
 	// Increase tessellation based on the size. Should be approximately right?
 	int patch_div_s = (spatch.count_u - 3) * spatch.tess_u;
@@ -389,112 +474,106 @@ static void SplinePatchFullQuality(u8 *&dest, u16 *indices, int &count, const Sp
 	float one_over_patch_div_s = 1.0f / (float)(patch_div_s);
 	float one_over_patch_div_t = 1.0f / (float)(patch_div_t);
 
-	for (int tile_v = 0; tile_v < patch_div_t + 1; tile_v++) {
-		float v = (float)tile_v * (float)(spatch.count_v - 3) * one_over_patch_div_t;
-		if (v < 0.0f)
-			v = 0.0f;
-		for (int tile_u = 0; tile_u < patch_div_s + 1; tile_u++) {
-			float u = (float)tile_u * (float)(spatch.count_u - 3) * one_over_patch_div_s;
-			if (u < 0.0f)
-				u = 0.0f;
-			SimpleVertex *vert = &vertices[tile_v * (patch_div_s + 1) + tile_u];
-			Vec4f vert_color(0, 0, 0, 0);
-			Vec3f vert_pos;
-			vert_pos.SetZero();
-			Vec3f vert_nrm;
-			if (origNrm) {
-				vert_nrm.SetZero();
-			}
-			if (origCol) {
-				vert_color.SetZero();
-			} else {
-				memcpy(vert->color, spatch.points[0]->color, 4);
-			}
-			if (origTc) {
-				vert->uv[0] = 0.0f;
-				vert->uv[1] = 0.0f;
-			} else {
-				vert->uv[0] = tu_width * ((float)tile_u * one_over_patch_div_s);
-				vert->uv[1] = tv_height * ((float)tile_v * one_over_patch_div_t);
-			}
-
-
-			// Collect influences from surrounding control points.
-			float u_weights[4];
-			float v_weights[4];
-
-			int iu = (int)u;
-			int iv = (int)v;
-
-			// TODO: Would really like to fix the surrounding logic somehow to get rid of these but I can't quite get it right..
-			// Without the previous epsilons and with large count_u, we will end up doing an out of bounds access later without these.
-			if (iu >= spatch.count_u - 3) iu = spatch.count_u - 4;
-			if (iv >= spatch.count_v - 3) iv = spatch.count_v - 4;
-
-			spline_n_4(iu, u, knot_u, u_weights);
-			spline_n_4(iv, v, knot_v, v_weights);
-
-			// Handle degenerate patches. without this, spatch.points[] may read outside the number of initialized points.
-			int patch_w = std::min(spatch.count_u - iu, 4);
-			int patch_h = std::min(spatch.count_v - iv, 4);
+	TrimWeightCache();
+	const SplineWeight *weights_u = GetSplineWeights(spatch.count_u, spatch.type_u, patch_div_s);
+	const SplineWeight *weights_v = GetSplineWeights(spatch.count_v, spatch.type_v, patch_div_t);
+
+	// Rows are independent, so big patches are split over the thread pool.
+	auto evaluateRows = [&](int lower, int upper) {
+		for (int tile_v = lower; tile_v < upper; tile_v++) {
+			const int iv = weights_v[tile_v].index;
+			const float *v_weights = weights_v[tile_v].basis;
+			for (int tile_u = 0; tile_u < patch_div_s + 1; tile_u++) {
+				const int iu = weights_u[tile_u].index;
+				const float *u_weights = weights_u[tile_u].basis;
+				SimpleVertex *vert = &vertices[tile_v * (patch_div_s + 1) + tile_u];
+				Vec4f vert_color(0, 0, 0, 0);
+				Vec3f vert_pos;
+				vert_pos.SetZero();
+				Vec3f vert_nrm;
+				if (origNrm) {
+					vert_nrm.SetZero();
+				}
+				if (origCol) {
+					vert_color.SetZero();
+				} else {
+					memcpy(vert->color, spatch.points[0]->color, 4);
+				}
+				if (origTc) {
+					vert->uv[0] = 0.0f;
+					vert->uv[1] = 0.0f;
+				} else {
+					vert->uv[0] = tu_width * ((float)tile_u * one_over_patch_div_s);
+					vert->uv[1] = tv_height * ((float)tile_v * one_over_patch_div_t);
+				}
 
-			for (int ii = 0; ii < patch_w; ++ii) {
-				for (int jj = 0; jj < patch_h; ++jj) {
-					float u_spline = u_weights[ii];
-					float v_spline = v_weights[jj];
-					float f = u_spline * v_spline;
 
-					if (f > 0.0f) {
-#ifdef _M_SSE
-						Vec4f fv(_mm_set_ps1(f));
-#else
-						Vec4f fv = Vec4f::AssignToAll(f);
-#endif
-						int idx = spatch.count_u * (iv + jj) + (iu + ii);
-						/*
-						if (idx >= max_idx) {
-							char temp[512];
-							snprintf(temp, sizeof(temp), "count_u: %d count_v: %d patch_w: %d patch_h: %d  ii: %d  jj: %d  iu: %d  iv: %d  patch_div_s: %d  patch_div_t: %d\n", spatch.count_u, spatch.count_v, patch_w, patch_h, ii, jj, iu, iv, patch_div_s, patch_div_t);
-							OutputDebugStringA(temp);
-							Crash();
-						}*/
-						SimpleVertex *a = spatch.points[idx];
-						AccumulateWeighted(vert_pos, a->pos, fv);
-						if (origTc) {
-							vert->uv[0] += a->uv[0] * f;
-							vert->uv[1] += a->uv[1] * f;
-						}
-						if (origCol) {
-							Vec4f a_color = Vec4f::FromRGBA(a->color_32);
-							AccumulateWeighted(vert_color, a_color, fv);
-						}
-						if (origNrm) {
-							AccumulateWeighted(vert_nrm, a->nrm, fv);
+				// Collect influences from surrounding control points.
+				// Handle degenerate patches. without this, spatch.points[] may read outside the number of initialized points.
+				int patch_w = std::min(spatch.count_u - iu, 4);
+				int patch_h = std::min(spatch.count_v - iv, 4);
+
+				for (int ii = 0; ii < patch_w; ++ii) {
+					for (int jj = 0; jj < patch_h; ++jj) {
+						float u_spline = u_weights[ii];
+						float v_spline = v_weights[jj];
+						float f = u_spline * v_spline;
+
+						if (f > 0.0f) {
+	#ifdef _M_SSE
+							Vec4f fv(_mm_set_ps1(f));
+	#else
+							Vec4f fv = Vec4f::AssignToAll(f);
+	#endif
+							int idx = spatch.count_u * (iv + jj) + (iu + ii);
+							/*
+							if (idx >= max_idx) {
+								char temp[512];
+								snprintf(temp, sizeof(temp), "count_u: %d count_v: %d patch_w: %d patch_h: %d  ii: %d  jj: %d  iu: %d  iv: %d  patch_div_s: %d  patch_div_t: %d\n", spatch.count_u, spatch.count_v, patch_w, patch_h, ii, jj, iu, iv, patch_div_s, patch_div_t);
+								OutputDebugStringA(temp);
+								Crash();
+							}*/
+							SimpleVertex *a = spatch.points[idx];
+							AccumulateWeighted(vert_pos, a->pos, fv);
+							if (origTc) {
+								vert->uv[0] += a->uv[0] * f;
+								vert->uv[1] += a->uv[1] * f;
+							}
+							if (origCol) {
+								Vec4f a_color = Vec4f::FromRGBA(a->color_32);
+								AccumulateWeighted(vert_color, a_color, fv);
+							}
+							if (origNrm) {
+								AccumulateWeighted(vert_nrm, a->nrm, fv);
+							}
 						}
 					}
 				}
-			}
-			vert->pos = vert_pos;
-			if (origNrm) {
-#ifdef _M_SSE
-				const __m128 normalize = SSENormalizeMultiplier(useSSE4, vert_nrm.vec);
-				vert_nrm.vec = _mm_mul_ps(vert_nrm.vec, normalize);
-#else
-				vert_nrm.Normalize();
-#endif
-				vert->nrm = vert_nrm;
-			} else {
-				vert->nrm.SetZero();
-				vert->nrm.z = 1.0f;
-			}
-			if (origCol) {
-				vert->color_32 = vert_color.ToRGBA();
+				vert->pos = vert_pos;
+				if (origNrm) {
+	#ifdef _M_SSE
+					const __m128 normalize = SSENormalizeMultiplier(useSSE4, vert_nrm.vec);
+					vert_nrm.vec = _mm_mul_ps(vert_nrm.vec, normalize);
+	#else
+					vert_nrm.Normalize();
+	#endif
+					vert->nrm = vert_nrm;
+				} else {
+					vert->nrm.SetZero();
+					vert->nrm.z = 1.0f;
+				}
+				if (origCol) {
+					vert->color_32 = vert_color.ToRGBA();
+				}
 			}
 		}
-	}
+	};
 
-	delete[] knot_u;
-	delete[] knot_v;
+	if ((patch_div_s + 1) * (patch_div_t + 1) >= PARALLEL_MIN_VERTICES) {
+		GlobalThreadPool::Loop(evaluateRows, 0, patch_div_t + 1);
+	} else {
+		evaluateRows(0, patch_div_t + 1);
+	}
 
 	// Hacky normal generation through central difference.
 	if (computeNormals && !origNrm) {
@@ -671,30 +750,24 @@ static void _BezierPatchLowQuality(u8 *&dest, u16 *&indices, int &count, int tes
 template <typename T>
 struct PrecomputedCurves {
 	PrecomputedCurves(int count) {
-		horiz1 = (T *)AllocateAlignedMemory(count * 4 * sizeof(T), 16);
-		horiz2 = horiz1 + count * 1;
-		horiz3 = horiz1 + count * 2;
-		horiz4 = horiz1 + count * 3;
+		horiz[0] = (T *)AllocateAlignedMemory(count * 4 * sizeof(T), 16);
+		horiz[1] = horiz[0] + count * 1;
+		horiz[2] = horiz[0] + count * 2;
+		horiz[3] = horiz[0] + count * 3;
 	}
 	~PrecomputedCurves() {
-		FreeAlignedMemory(horiz1);
-	}
-
-	T Bernstein3D(int u, float bv) {
-		return ::Bernstein3D(horiz1[u], horiz2[u], horiz3[u], horiz4[u], bv);
+		FreeAlignedMemory(horiz[0]);
 	}
 
-	T Bernstein3DDerivative(int u, float bv) {
-		return ::Bernstein3DDerivative(horiz1[u], horiz2[u], horiz3[u], horiz4[u], bv);
+	T Evaluate(int u, const float w[4]) {
+		return WeightedSum(horiz[0][u], horiz[1][u], horiz[2][u], horiz[3][u], w);
 	}
 
-	T *horiz1;
-	T *horiz2;
-	T *horiz3;
-	T *horiz4;
+	// One curve per row of control points.
+	T *horiz[4];
 };
 
-static void _BezierPatchHighQuality(u8 *&dest, u16 *&indices, int &count, int tess_u, int tess_v, const BezierPatch &patch, u32 origVertType) {
+static void _BezierPatchHighQuality(u8 *&dest, u16 *&indices, int &count, int tess_u, int tess_v, const BezierPatch &patch, u32 origVertType, const SplineWeight *weights_u, const SplineWeight *weights_v) {
 	const float third = 1.0f / 3.0f;
 
 	// First compute all the vertices and put them in an array
@@ -711,45 +784,35 @@ static void _BezierPatchHighQuality(u8 *&dest, u16 *&indices, int &count, int te
 
 	// Precompute the horizontal curves to we only have to evaluate the vertical ones.
 	for (int i = 0; i < tess_u + 1; i++) {
-		float u = ((float)i / (float)tess_u);
-		prepos.horiz1[i] = Bernstein3D(patch.points[0]->pos, patch.points[1]->pos, patch.points[2]->pos, patch.points[3]->pos, u);
-		prepos.horiz2[i] = Bernstein3D(patch.points[4]->pos, patch.points[5]->pos, patch.points[6]->pos, patch.points[7]->pos, u);
-		prepos.horiz3[i] = Bernstein3D(patch.points[8]->pos, patch.points[9]->pos, patch.points[10]->pos, patch.points[11]->pos, u);
-		prepos.horiz4[i] = Bernstein3D(patch.points[12]->pos, patch.points[13]->pos, patch.points[14]->pos, patch.points[15]->pos, u);
-
-		if (sampleColors) {
-			precol.horiz1[i] = Bernstein3D(patch.points[0]->color_32, patch.points[1]->color_32, patch.points[2]->color_32, patch.points[3]->color_32, u);
-			precol.horiz2[i] = Bernstein3D(patch.points[4]->color_32, patch.points[5]->color_32, patch.points[6]->color_32, patch.points[7]->color_32, u);
-			precol.horiz3[i] = Bernstein3D(patch.points[8]->color_32, patch.points[9]->color_32, patch.points[10]->color_32, patch.points[11]->color_32, u);
-			precol.horiz4[i] = Bernstein3D(patch.points[12]->color_32, patch.points[13]->color_32, patch.points[14]->color_32, patch.points[15]->color_32, u);
-		}
-		if (sampleTexcoords) {
-			pretex.horiz1[i] = Bernstein3D(Math3D::Vec2f(patch.points[0]->uv), Math3D::Vec2f(patch.points[1]->uv), Math3D::Vec2f(patch.points[2]->uv), Math3D::Vec2f(patch.points[3]->uv), u);
-			pretex.horiz2[i] = Bernstein3D(Math3D::Vec2f(patch.points[4]->uv), Math3D::Vec2f(patch.points[5]->uv), Math3D::Vec2f(patch.points[6]->uv), Math3D::Vec2f(patch.points[7]->uv), u);
-			pretex.horiz3[i] = Bernstein3D(Math3D::Vec2f(patch.points[8]->uv), Math3D::Vec2f(patch.points[9]->uv), Math3D::Vec2f(patch.points[10]->uv), Math3D::Vec2f(patch.points[11]->uv), u);
-			pretex.horiz4[i] = Bernstein3D(Math3D::Vec2f(patch.points[12]->uv), Math3D::Vec2f(patch.points[13]->uv), Math3D::Vec2f(patch.points[14]->uv), Math3D::Vec2f(patch.points[15]->uv), u);
-		}
+		const float *wu = weights_u[i].basis;
+		for (int row = 0; row < 4; row++) {
+			const SimpleVertex *const *p = &patch.points[row * 4];
+			prepos.horiz[row][i] = WeightedSum(Vec3f(p[0]->pos), Vec3f(p[1]->pos), Vec3f(p[2]->pos), Vec3f(p[3]->pos), wu);
 
-		if (computeNormals) {
-			prederivU.horiz1[i] = Bernstein3DDerivative(patch.points[0]->pos, patch.points[1]->pos, patch.points[2]->pos, patch.points[3]->pos, u);
-			prederivU.horiz2[i] = Bernstein3DDerivative(patch.points[4]->pos, patch.points[5]->pos, patch.points[6]->pos, patch.points[7]->pos, u);
-			prederivU.horiz3[i] = Bernstein3DDerivative(patch.points[8]->pos, patch.points[9]->pos, patch.points[10]->pos, patch.points[11]->pos, u);
-			prederivU.horiz4[i] = Bernstein3DDerivative(patch.points[12]->pos, patch.points[13]->pos, patch.points[14]->pos, patch.points[15]->pos, u);
+			if (sampleColors) {
+				precol.horiz[row][i] = WeightedSum(Vec4f::FromRGBA(p[0]->color_32), Vec4f::FromRGBA(p[1]->color_32), Vec4f::FromRGBA(p[2]->color_32), Vec4f::FromRGBA(p[3]->color_32), wu);
+			}
+			if (sampleTexcoords) {
+				pretex.horiz[row][i] = WeightedSum(Math3D::Vec2f(p[0]->uv), Math3D::Vec2f(p[1]->uv), Math3D::Vec2f(p[2]->uv), Math3D::Vec2f(p[3]->uv), wu);
+			}
+			if (computeNormals) {
+				prederivU.horiz[row][i] = WeightedSum(Vec3f(p[0]->pos), Vec3f(p[1]->pos), Vec3f(p[2]->pos), Vec3f(p[3]->pos), weights_u[i].deriv);
+			}
 		}
 	}
 
-
 	for (int tile_v = 0; tile_v < tess_v + 1; ++tile_v) {
+		const float *wv = weights_v[tile_v].basis;
+		const float *wvDeriv = weights_v[tile_v].deriv;
 		for (int tile_u = 0; tile_u < tess_u + 1; ++tile_u) {
 			float u = ((float)tile_u / (float)tess_u);
 			float v = ((float)tile_v / (float)tess_v);
-			float bv = v;
 
 			SimpleVertex &vert = vertices[tile_v * (tess_u + 1) + tile_u];
 
 			if (computeNormals) {
-				const Vec3f derivU = prederivU.Bernstein3D(tile_u, bv);
-				const Vec3f derivV = prepos.Bernstein3DDerivative(tile_u, bv);
+				const Vec3f derivU = prederivU.Evaluate(tile_u, wv);
+				const Vec3f derivV = prepos.Evaluate(tile_u, wvDeriv);
 
 				vert.nrm = Cross(derivU, derivV).Normalized();
 				if (patch.patchFacing)
@@ -758,7 +821,7 @@ static void _BezierPatchHighQuality(u8 *&dest, u16 *&indices, int &count, int te
 				vert.nrm.SetZero();
 			}
 
-			vert.pos = prepos.Bernstein3D(tile_u, bv);
+			vert.pos = prepos.Evaluate(tile_u, wv);
 
 			if (!sampleTexcoords) {
 				// Generate texcoord
@@ -766,13 +829,13 @@ static void _BezierPatchHighQuality(u8 *&dest, u16 *&indices, int &count, int te
 				vert.uv[1] = v + patch.v_index * third;
 			} else {
 				// Sample UV from control points
-				const Math3D::Vec2f res = pretex.Bernstein3D(tile_u, bv);
+				const Math3D::Vec2f res = pretex.Evaluate(tile_u, wv);
 				vert.uv[0] = res.x;
 				vert.uv[1] = res.y;
-			} 
+			}
 
 			if (sampleColors) {
-				vert.color_32 = precol.Bernstein3D(tile_u, bv).ToRGBA();
+				vert.color_32 = precol.Evaluate(tile_u, wv).ToRGBA();
 			} else {
 				memcpy(vert.color, patch.points[0]->color, 4);
 			}
@@ -827,18 +890,53 @@ static void TessellateBezierPatchHardware(u8 *&dest, u16 *indices, int &count, i
 	}
 }
 
-void TessellateBezierPatch(u8 *&dest, u16 *&indices, int &count, int tess_u, int tess_v, const BezierPatch &patch, u32 origVertType) {
-	switch (g_Config.iSplineBezierQuality) {
-	case LOW_QUALITY:
-		_BezierPatchLowQuality(dest, indices, count, tess_u, tess_v, patch, origVertType);
-		break;
-	case MEDIUM_QUALITY:
-		_BezierPatchHighQuality(dest, indices, count, tess_u / 2, tess_v / 2, patch, origVertType);
-		break;
-	case HIGH_QUALITY:
-		_BezierPatchHighQuality(dest, indices, count, tess_u, tess_v, patch, origVertType);
-		break;
+void TessellateBezierPatches(u8 *&dest, u16 *&indices, int &count, int tess_u, int tess_v, const BezierPatch *patches, int numPatches, u32 origVertType) {
+	const int quality = g_Config.iSplineBezierQuality;
+	if (quality == MEDIUM_QUALITY) {
+		tess_u = std::max(tess_u / 2, 1);
+		tess_v = std::max(tess_v / 2, 1);
+	}
+
+	// Every patch fills the same size block of vertices and indices, so they can go in any order.
+	int patchVerts;
+	int patchInds;
+	const SplineWeight *weights_u = nullptr;
+	const SplineWeight *weights_v = nullptr;
+	if (quality == LOW_QUALITY) {
+		patchVerts = 3 * 3 * 4;
+		patchInds = 3 * 3 * 6;
+	} else {
+		patchVerts = (tess_u + 1) * (tess_v + 1);
+		patchInds = tess_u * tess_v * 6;
+		// The workers only read the cache, look up the weights here.
+		TrimWeightCache();
+		weights_u = GetBezierWeights(tess_u);
+		weights_v = GetBezierWeights(tess_v);
 	}
+
+	auto tessellate = [&](int lower, int upper) {
+		for (int i = lower; i < upper; i++) {
+			const BezierPatch &patch = patches[i];
+			u8 *patchDest = dest + patch.index * patchVerts * sizeof(SimpleVertex);
+			u16 *patchIndices = indices + patch.index * patchInds;
+			int patchCount = 0;
+			if (quality == LOW_QUALITY) {
+				_BezierPatchLowQuality(patchDest, patchIndices, patchCount, tess_u, tess_v, patch, origVertType);
+			} else {
+				_BezierPatchHighQuality(patchDest, patchIndices, patchCount, tess_u, tess_v, patch, origVertType, weights_u, weights_v);
+			}
+		}
+	};
+
+	if (numPatches > 1 && numPatches * patchVerts >= PARALLEL_MIN_VERTICES) {
+		GlobalThreadPool::Loop(tessellate, 0, numPatches);
+	} else {
+		tessellate(0, numPatches);
+	}
+
+	dest += numPatches * patchVerts * sizeof(SimpleVertex);
+	indices += numPatches * patchInds;
+	count += numPatches * patchInds;
 }
 
 // This maps GEPatchPrimType to GEPrimitiveType.
@@ -929,11 +1027,18 @@ void DrawEngineCommon::SubmitSpline(const void *control_points, const void *indi
 			memcpy(col, Vec4f::FromRGBA(points[0]->color_32).AsArray(), 4 * sizeof(float));
 
 		tessDataTransfer->SendDataToShader(pos, tex, col, count_u * count_v, hasColor, hasTexCoords);
-		TessellateSplinePatchHardware(dest, quadIndices_, count, patch);
+		const u32 gridKey = HardwareTessGridKey(true, tess_u, tess_v, prim_type);
+		if (gridKey != tessGridKey_) {
+			TessellateSplinePatchHardware(dest, quadIndices_, count, patch);
+			tessGridKey_ = gridKey;
+			tessGridCount_ = count;
+		}
+		count = tessGridCount_;
 		numPatches = (count_u - 3) * (count_v - 3);
 	} else {
 		int maxVertexCount = SPLINE_BUFFER_SIZE / vertexSize;
 		TessellateSplinePatch(dest, quadIndices_, count, patch, origVertType, maxVertexCount);
+		tessGridKey_ = 0;
 	}
 	delete[] points;
 
@@ -1065,7 +1170,13 @@ void DrawEngineCommon::SubmitBezier(const void *control_points, const void *indi
 	u16 *inds = quadIndices_;
 	if (g_Config.bHardwareTessellation && g_Config.bHardwareTransform && !g_Config.bSoftwareRendering) {
 		tessDataTransfer->SendDataToShader(pos, tex, col, count_u * count_v, hasColor, hasTexCoords);
-		TessellateBezierPatchHardware(dest, inds, count, tess_u, tess_v, prim_type);
+		const u32 gridKey = HardwareTessGridKey(false, tess_u, tess_v, prim_type);
+		if (gridKey != tessGridKey_) {
+			TessellateBezierPatchHardware(dest, inds, count, tess_u, tess_v, prim_type);
+			tessGridKey_ = gridKey;
+			tessGridCount_ = count;
+		}
+		count = tessGridCount_;
 		numPatches = num_patches_u * num_patches_v;
 	} else {
 		int maxVertices = SPLINE_BUFFER_SIZE / vertexSize;
@@ -1074,11 +1185,9 @@ void DrawEngineCommon::SubmitBezier(const void *control_points, const void *indi
 			tess_u /= 2;
 			tess_v /= 2;
 		}
-		for (int patch_idx = 0; patch_idx < num_patches_u*num_patches_v; ++patch_idx) {
-			const BezierPatch &patch = patches[patch_idx];
-			TessellateBezierPatch(dest, inds, count, tess_u, tess_v, patch, origVertType);
-		}
+		TessellateBezierPatches(dest, inds, count, tess_u, tess_v, patches, num_patches_u * num_patches_v, origVertType);
 		delete[] patches;
+		tessGridKey_ = 0;
 	}
 
 	u32 vertTypeWithIndex16 = (vertType & ~GE_VTYPE_IDX_MASK) | GE_VTYPE_IDX_16BIT;
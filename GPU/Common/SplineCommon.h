@@ -67,4 +67,4 @@ enum SplineQuality {
 };
 
 void TessellateSplinePatch(u8 *&dest, u16 *indices, int &count, const SplinePatchLocal &spatch, u32 origVertType, int maxVertices);
-void TessellateBezierPatch(u8 *&dest, u16 *&indices, int &count, int tess_u, int tess_v, const BezierPatch &patch, u32 origVertType, int maxVertices);
+void TessellateBezierPatches(u8 *&dest, u16 *&indices, int &count, int tess_u, int tess_v, const BezierPatch *patches, int numPatches, u32 origVertType);
@@ -17,6 +17,7 @@
 
 #include <algorithm>
 #include "profiler/profiler.h"
+#include "thread/threadutil.h"
 #include "Common/ColorConv.h"
 #include "Common/MemoryUtil.h"
 #include "Core/Config.h"
@@ -57,6 +58,12 @@
 #define TEXCACHE_MIN_PRESSURE 16 * 1024 * 1024  // Total in VRAM
 #define TEXCACHE_SECOND_MIN_PRESSURE 4 * 1024 * 1024
 
+// They could invalidate inside the texture, let's just give a bit of leeway.
+#define LARGEST_TEXTURE_SIZE (512 * 512 * 4)
+
+// Hint invalidations merged before walking the cache anyway.
+#define MAX_PENDING_INVALIDATIONS 64
+
 // Just for reference
 
 // PSP Color formats:
@@ -85,7 +92,7 @@
 TextureCacheCommon::TextureCacheCommon(Draw::DrawContext *draw)
 	: draw_(draw),
 		clearCacheNextFrame_(false),
-		lowMemoryMode_(false),
+		lowMemoryMode_(g_Config.bLowMemoryMode),
 		texelsScaledThisFrame_(0),
 		cacheSizeEstimate_(0),
 		secondCacheSizeEstimate_(0),
@@ -116,6 +123,7 @@ TextureCacheCommon::TextureCacheCommon(Draw::DrawContext *draw)
 }
 
 TextureCacheCommon::~TextureCacheCommon() {
+	StopAsyncDecodes();
 	FreeAlignedMemory(clutBufConverted_);
 	FreeAlignedMemory(clutBufRaw_);
 }
@@ -200,6 +208,26 @@ void TextureCacheCommon::GetSamplingParams(int &minFilt, int &magFilt, bool &sCl
 	}
 }
 
+bool TextureCacheCommon::CanLookupClutInShader(GETextureFormat format, u8 maxLevel, u32 texaddr) {
+	if (!g_Config.bClutLookupInShader || !SupportsClutLookupInShader())
+		return false;
+	if (format != GE_TFMT_CLUT4 && format != GE_TFMT_CLUT8)
+		return false;
+	// Mipmaps, scaling, and replacements all work on the colors, and a rendered CLUT goes through the depal pass.
+	if (maxLevel != 0 || IsFakeMipmapChange() || standardScaleFactor_ != 1 || replacer_.Enabled() || clutRenderAddress_ != 0xFFFFFFFF)
+		return false;
+
+	// Filtering the indices would blend unrelated palette entries, so only nearest sampling can match.
+	int minFilt;
+	int magFilt;
+	bool sClamp;
+	bool tClamp;
+	float lodBias;
+	GETexLevelMode mode;
+	GetSamplingParams(minFilt, magFilt, sClamp, tClamp, lodBias, 0, texaddr, mode);
+	return (minFilt & 1) == 0 && (magFilt & 1) == 0;
+}
+
 void TextureCacheCommon::UpdateSamplingParams(TexCacheEntry &entry, SamplerCacheKey &key) {
 	// TODO: Make GetSamplingParams write SamplerCacheKey directly
 	int minFilt;
@@ -279,6 +307,8 @@ void TextureCacheCommon::UpdateMaxSeenV(TexCacheEntry *entry, bool throughMode)
 
 
 void TextureCacheCommon::SetTexture(bool force) {
+	FlushInvalidations();
+
 #ifdef DEBUG_TEXTURES
 	if (SetDebugTexture()) {
 		// A different texture was bound, let's rebind next time.
@@ -312,22 +342,25 @@ void TextureCacheCommon::SetTexture(bool force) {
 		format = GE_TFMT_5650;
 	}
 	bool hasClut = gstate.isTextureFormatIndexed();
+	u8 maxLevel = gstate.getTextureMaxLevel();
 
 	// Ignore uncached/kernel when caching.
 	u32 cluthash;
+	bool shaderClutLookup = false;
 	if (hasClut) {
 		if (clutLastFormat_ != gstate.clutformat) {
 			// We update here because the clut format can be specified after the load.
 			UpdateCurrentClut(gstate.getClutPaletteFormat(), gstate.getClutIndexStartPos(), gstate.isClutIndexSimple());
 		}
-		cluthash = clutHash_ ^ gstate.clutformat;
+		// When the palette is looked up in the shader, the indices are all we cache, so any CLUT can share them.
+		shaderClutLookup = CanLookupClutInShader(format, maxLevel, texaddr);
+		cluthash = shaderClutLookup ? 0 : clutHash_ ^ gstate.clutformat;
 	} else {
 		cluthash = 0;
 	}
 	u64 cachekey = TexCacheEntry::CacheKey(texaddr, format, dim, cluthash);
 
 	int bufw = GetTextureBufw(0, texaddr, format);
-	u8 maxLevel = gstate.getTextureMaxLevel();
 
 	u32 texhash = MiniHash((const u32 *)Memory::GetPointerUnchecked(texaddr));
 
@@ -342,12 +375,20 @@ void TextureCacheCommon::SetTexture(bool force) {
 		gstate_c.Dirty(DIRTY_FRAGMENTSHADER_STATE);
 	}
 	gstate_c.bgraTexture = isBgraBackend_;
+	if (gstate_c.shaderClutLookup != shaderClutLookup) {
+		gstate_c.Dirty(DIRTY_FRAGMENTSHADER_STATE);
+	}
+	gstate_c.shaderClutLookup = shaderClutLookup;
 
 	if (iter != cache_.end()) {
 		entry = iter->second.get();
 		// Validate the texture still matches the cache entry.
 		bool match = entry->Matches(dim, format, maxLevel);
 		const char *reason = "different params";
+		if (match && ((entry->status & TexCacheEntry::STATUS_SHADER_CLUT) != 0) != shaderClutLookup) {
+			match = false;
+			reason = "clut lookup";
+		}
 
 		// Check for FBO - slow!
 		if (entry->framebuffer) {
@@ -418,6 +459,15 @@ void TextureCacheCommon::SetTexture(bool force) {
 			}
 		}
 
+		if (match && (entry->status & TexCacheEntry::STATUS_TO_REPLACE) != 0) {
+			ReplacedTexture &replaced = replacer_.FindReplacement(entry->CacheKey(), entry->fullhash, gstate.getTextureWidth(0), gstate.getTextureHeight(0));
+			if (!replaced.IsPending()) {
+				// Done loading, swap it in.
+				match = false;
+				reason = "replacing";
+			}
+		}
+
 		if (match) {
 			// TODO: Mark the entry reliable if it's been safe for long enough?
 			//got one!
@@ -492,6 +542,11 @@ void TextureCacheCommon::SetTexture(bool force) {
 	entry->bufw = bufw;
 
 	entry->cluthash = cluthash;
+	if (shaderClutLookup) {
+		entry->status |= TexCacheEntry::STATUS_SHADER_CLUT;
+	} else {
+		entry->status &= ~TexCacheEntry::STATUS_SHADER_CLUT;
+	}
 
 	gstate_c.curTextureWidth = w;
 	gstate_c.curTextureHeight = h;
@@ -517,12 +572,23 @@ void TextureCacheCommon::SetTexture(bool force) {
 
 // Removes old textures.
 void TextureCacheCommon::Decimate() {
+	gpuStats.textureCacheBytes = MemoryUsage();
+
+	// Checked every time, since a few scaled textures can go over quickly.
+	u32 budget = MemoryBudget();
+	if (budget != 0 && MemoryUsage() > budget) {
+		// Leave some room, so we aren't back here for every new texture.
+		EvictToBudget(budget - budget / 8);
+	}
+
 	if (--decimationCounter_ <= 0) {
 		decimationCounter_ = TEXCACHE_DECIMATION_INTERVAL;
 	} else {
 		return;
 	}
 
+	replacer_.Decimate();
+
 	if (cacheSizeEstimate_ >= TEXCACHE_MIN_PRESSURE) {
 		const u32 had = cacheSizeEstimate_;
 
@@ -562,6 +628,73 @@ void TextureCacheCommon::Decimate() {
 	DecimateVideos();
 }
 
+u32 TextureCacheCommon::MemoryBudget() const {
+	if (g_Config.iTextureMemoryBudget <= 0)
+		return 0;
+	return (u32)std::min(g_Config.iTextureMemoryBudget, 4000) * 1024 * 1024;
+}
+
+void TextureCacheCommon::EvictToBudget(u32 budget) {
+	struct Candidate {
+		bool secondary;
+		u64 key;
+		double score;
+	};
+
+	// Least recently used goes first, but weighted by how much we get back and how hard it is to make again.
+	std::vector<Candidate> candidates;
+	auto addCandidates = [&](TexCache &cache, bool secondary) {
+		for (const auto &item : cache) {
+			const TexCacheEntry *entry = item.second.get();
+			int age = gpuStats.numFlips - entry->lastFrame;
+			// Anything from the last frame might still be in flight or needed again right away.
+			if (age < 2 || entry->framebuffer || (entry->status & TexCacheEntry::STATUS_ASYNC_PENDING) != 0)
+				continue;
+
+			double cost = 1.0;
+			if (entry->status & TexCacheEntry::STATUS_IS_SCALED) {
+				// Scaled or replaced, which means scaling or loading a file all over again.
+				cost = 4.0;
+			} else if (entry->status & TexCacheEntry::STATUS_CHANGE_FREQUENT) {
+				// Will likely be rebuilt anyway.
+				cost = 0.5;
+			}
+			if (secondary) {
+				// Only kept on the chance the old contents come back.
+				cost *= 0.5;
+			}
+
+			candidates.push_back({ secondary, item.first, (double)age * (double)EstimateTexMemoryUsage(entry) / cost });
+		}
+	};
+	addCandidates(cache_, false);
+	addCandidates(secondCache_, true);
+	std::sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b) {
+		return a.score > b.score;
+	});
+
+	const u32 had = MemoryUsage();
+	ForgetLastTexture();
+	for (const Candidate &candidate : candidates) {
+		if (MemoryUsage() <= budget)
+			break;
+		if (candidate.secondary) {
+			auto iter = secondCache_.find(candidate.key);
+			ReleaseTexture(iter->second.get(), true);
+			secondCacheSizeEstimate_ -= EstimateTexMemoryUsage(iter->second.get());
+			secondCache_.erase(iter);
+		} else {
+			DeleteTexture(cache_.find(candidate.key));
+		}
+	}
+
+	if (MemoryUsage() > budget) {
+		VERBOSE_LOG(G3D, "Texture memory over budget (%d > %d bytes), but everything left is in use", MemoryUsage(), budget);
+	} else {
+		VERBOSE_LOG(G3D, "Evicted textures to fit the memory budget, saved %d bytes - now %d bytes", had - MemoryUsage(), MemoryUsage());
+	}
+}
+
 void TextureCacheCommon::DecimateVideos() {
 	if (!videos_.empty()) {
 		for (auto iter = videos_.begin(); iter != videos_.end(); ) {
@@ -842,12 +975,13 @@ void TextureCacheCommon::SetTextureFramebuffer(TexCacheEntry *entry, VirtualFram
 		// We need to force it, since we may have set it on a texture before attaching.
 		gstate_c.curTextureWidth = framebuffer->bufferWidth;
 		gstate_c.curTextureHeight = framebuffer->bufferHeight;
-		if (gstate_c.bgraTexture) {
+		if (gstate_c.bgraTexture || gstate_c.shaderClutLookup) {
 			gstate_c.Dirty(DIRTY_FRAGMENTSHADER_STATE);
 		} else if ((gstate_c.curTextureXOffset == 0) != (fbInfo.xOffset == 0) || (gstate_c.curTextureYOffset == 0) != (fbInfo.yOffset == 0)) {
 			gstate_c.Dirty(DIRTY_FRAGMENTSHADER_STATE);
 		}
 		gstate_c.bgraTexture = false;
+		gstate_c.shaderClutLookup = false;
 		gstate_c.curTextureXOffset = fbInfo.xOffset;
 		gstate_c.curTextureYOffset = fbInfo.yOffset;
 		u32 texW = (u32)gstate.getTextureWidth(0);
@@ -860,7 +994,7 @@ void TextureCacheCommon::SetTextureFramebuffer(TexCacheEntry *entry, VirtualFram
 		nextTexture_ = entry;
 	} else {
 		if (framebuffer->fbo) {
-			framebuffer->fbo->Release();
+			framebufferManager_->ReleaseFramebuffer(framebuffer->fbo);
 			framebuffer->fbo = nullptr;
 		}
 		Unbind();
@@ -1071,6 +1205,10 @@ bool TextureCacheCommon::GetCurrentClutBuffer(GPUDebugBuffer &buffer) {
 
 // Host memory usage, not PSP memory usage.
 u32 TextureCacheCommon::EstimateTexMemoryUsage(const TexCacheEntry *entry) {
+	if (entry->memoryUsage != 0) {
+		return entry->memoryUsage;
+	}
+
 	const u16 dim = entry->dim;
 	// TODO: This does not take into account the HD remaster's larger textures.
 	const u8 dimW = ((dim >> 0) & 0xf);
@@ -1103,6 +1241,22 @@ u32 TextureCacheCommon::EstimateTexMemoryUsage(const TexCacheEntry *entry) {
 	return pixelSize << (dimW + dimH);
 }
 
+void TextureCacheCommon::SetTexMemoryUsage(TexCacheEntry *entry, int w, int h, int levels, int bitsPerPixel) {
+	u64 bytes = 0;
+	for (int i = 0; i < levels; ++i) {
+		int mipW = std::max(1, w >> i);
+		int mipH = std::max(1, h >> i);
+		bytes += ((u64)mipW * mipH * bitsPerPixel + 7) / 8;
+		if (mipW == 1 && mipH == 1)
+			break;
+	}
+
+	// Swap out whatever estimate was counted for it so far.
+	cacheSizeEstimate_ -= EstimateTexMemoryUsage(entry);
+	entry->memoryUsage = (u32)std::max((u64)1, std::min(bytes, (u64)0x7FFFFFFF));
+	cacheSizeEstimate_ += entry->memoryUsage;
+}
+
 static void ReverseColors(void *dstBuf, const void *srcBuf, GETextureFormat fmt, int numPixels, bool useBGRA) {
 	switch (fmt) {
 	case GE_TFMT_4444:
@@ -1149,6 +1303,95 @@ static inline void ConvertFormatToRGBA8888(GEPaletteFormat format, u32 *dst, con
 	ConvertFormatToRGBA8888(GETextureFormat(format), dst, src, numPixels);
 }
 
+CheckAlphaResult TextureCacheCommon::ConvertDXTLevelToBC(u8 *out, int outPitch, GETextureFormat format, uint32_t texaddr, int level, int bufw) {
+	int w = gstate.getTextureWidth(level);
+	int h = gstate.getTextureHeight(level);
+	const u8 *texptr = Memory::GetPointer(texaddr);
+
+	// Like the decoder, only the blocks inside bufw are read.
+	int blocksW = (w + 3) / 4;
+	int srcBlocksW = (std::min(bufw, w) + 3) / 4;
+	int blockSize = format == GE_TFMT_DXT1 ? 8 : 16;
+	bool hasAlpha = false;
+	for (int y = 0; y < h; y += 4) {
+		u32 blockIndex = (y / 4) * (bufw / 4);
+		u8 *dst = out + outPitch * (y / 4);
+		switch (format) {
+		case GE_TFMT_DXT1:
+			hasAlpha = ConvertDXT1ToBC1(dst, (const DXT1Block *)texptr + blockIndex, srcBlocksW) || hasAlpha;
+			break;
+		case GE_TFMT_DXT3:
+			hasAlpha = ConvertDXT3ToBC2(dst, (const DXT3Block *)texptr + blockIndex, srcBlocksW) || hasAlpha;
+			break;
+		case GE_TFMT_DXT5:
+			hasAlpha = ConvertDXT5ToBC3(dst, (const DXT5Block *)texptr + blockIndex, srcBlocksW) || hasAlpha;
+			break;
+		default:
+			_dbg_assert_msg_(G3D, false, "Not a DXT format");
+			break;
+		}
+		if (srcBlocksW < blocksW) {
+			memset(dst + srcBlocksW * blockSize, 0, (blocksW - srcBlocksW) * blockSize);
+		}
+	}
+	return hasAlpha ? CHECKALPHA_ANY : CHECKALPHA_FULL;
+}
+
+void TextureCacheCommon::DecodeIndexLevel(u8 *out, int outPitch, GETextureFormat format, uint32_t texaddr, int level, int bufw) {
+	int w = gstate.getTextureWidth(level);
+	int h = gstate.getTextureHeight(level);
+	const u8 *texptr = Memory::GetPointer(texaddr);
+
+	bool swizzled = gstate.isTextureSwizzled();
+	if ((texaddr & 0x00200000) == 0x00200000 && Memory::IsVRAMAddress(texaddr)) {
+		// Swizzled mirror, see DecodeTextureLevel.
+		swizzled = !swizzled;
+	}
+
+	if (format == GE_TFMT_CLUT4) {
+		if (swizzled) {
+			tmpTexBuf32_.resize(bufw * ((h + 7) & ~7));
+			UnswizzleFromMem(tmpTexBuf32_.data(), bufw / 2, texptr, bufw, h, 0);
+			texptr = (const u8 *)tmpTexBuf32_.data();
+		}
+		for (int y = 0; y < h; ++y) {
+			const u8 *src = texptr + (bufw * y) / 2;
+			u8 *dst = out + outPitch * y;
+			for (int x = 0; x < w; x += 2) {
+				u8 index = *src++;
+				dst[x + 0] = index & 0xF;
+				dst[x + 1] = index >> 4;
+			}
+		}
+	} else if (format == GE_TFMT_CLUT8) {
+		if (swizzled) {
+			tmpTexBuf32_.resize(bufw * ((h + 7) & ~7));
+			UnswizzleFromMem(tmpTexBuf32_.data(), bufw, texptr, bufw, h, 1);
+			texptr = (const u8 *)tmpTexBuf32_.data();
+		}
+		for (int y = 0; y < h; ++y) {
+			memcpy(out + outPitch * y, texptr + bufw * y, w);
+		}
+	} else {
+		_dbg_assert_msg_(G3D, false, "Not a CLUT4/CLUT8 format");
+	}
+}
+
+void TextureCacheCommon::BuildLookupClut(u32 *colors) {
+	const GEPaletteFormat clutFormat = gstate.getClutPaletteFormat();
+	// 16-bit CLUTs can be indexed up to 512 entries by the start position.
+	u32 expanded[512];
+	const u32 *clut32 = clutBufRaw_;
+	if (clutFormat != GE_CMODE_32BIT_ABGR8888) {
+		ConvertFormatToRGBA8888(clutFormat, expanded, (const u16 *)clutBufRaw_, 512);
+		clut32 = expanded;
+	}
+
+	for (int i = 0; i < 256; ++i) {
+		colors[i] = clut32[gstate.transformClutIndex(i)];
+	}
+}
+
 void TextureCacheCommon::DecodeTextureLevel(u8 *out, int outPitch, GETextureFormat format, GEPaletteFormat clutformat, uint32_t texaddr, int level, int bufw, bool reverseColors, bool useBGRA, bool expandTo32bit) {
 	bool swizzled = gstate.isTextureSwizzled();
 	if ((texaddr & 0x00600000) != 0 && Memory::IsVRAMAddress(texaddr)) {
@@ -1238,6 +1481,24 @@ void TextureCacheCommon::DecodeTextureLevel(u8 *out, int outPitch, GETextureForm
 		ReadIndexedTex(out, outPitch, level, texptr, 4, bufw, expandTo32bit);
 		break;
 
+	case GE_TFMT_4444:
+	case GE_TFMT_5551:
+	case GE_TFMT_5650:
+	case GE_TFMT_8888:
+	case GE_TFMT_DXT1:
+	case GE_TFMT_DXT3:
+	case GE_TFMT_DXT5:
+		DecodeDirectTextureLevel(out, outPitch, format, texptr, w, h, bufw, swizzled, reverseColors, useBGRA, expandTo32bit, tmpTexBuf32_);
+		break;
+
+	default:
+		ERROR_LOG_REPORT(G3D, "Unknown Texture Format %d!!!", format);
+		break;
+	}
+}
+
+void TextureCacheCommon::DecodeDirectTextureLevel(u8 *out, int outPitch, GETextureFormat format, const u8 *texptr, int w, int h, int bufw, bool swizzled, bool reverseColors, bool useBGRA, bool expandTo32bit, SimpleBuf<u32> &tmp) {
+	switch (format) {
 	case GE_TFMT_4444:
 	case GE_TFMT_5551:
 	case GE_TFMT_5650:
@@ -1264,9 +1525,9 @@ void TextureCacheCommon::DecodeTextureLevel(u8 *out, int outPitch, GETextureForm
 			}
 		} else {
 			// We don't have enough space for all rows in out, so use a temp buffer.
-			tmpTexBuf32_.resize(bufw * ((h + 7) & ~7));
-			UnswizzleFromMem(tmpTexBuf32_.data(), bufw * 2, texptr, bufw, h, 2);
-			const u8 *unswizzled = (u8 *)tmpTexBuf32_.data();
+			tmp.resize(bufw * ((h + 7) & ~7));
+			UnswizzleFromMem(tmp.data(), bufw * 2, texptr, bufw, h, 2);
+			const u8 *unswizzled = (u8 *)tmp.data();
 
 			if (reverseColors) {
 				for (int y = 0; y < h; ++y) {
@@ -1302,9 +1563,9 @@ void TextureCacheCommon::DecodeTextureLevel(u8 *out, int outPitch, GETextureForm
 			}
 		} else {
 			// We don't have enough space for all rows in out, so use a temp buffer.
-			tmpTexBuf32_.resize(bufw * ((h + 7) & ~7));
-			UnswizzleFromMem(tmpTexBuf32_.data(), bufw * 4, texptr, bufw, h, 4);
-			const u8 *unswizzled = (u8 *)tmpTexBuf32_.data();
+			tmp.resize(bufw * ((h + 7) & ~7));
+			UnswizzleFromMem(tmp.data(), bufw * 4, texptr, bufw, h, 4);
+			const u8 *unswizzled = (u8 *)tmp.data();
 
 			if (reverseColors) {
 				for (int y = 0; y < h; ++y) {
@@ -1385,7 +1646,7 @@ void TextureCacheCommon::DecodeTextureLevel(u8 *out, int outPitch, GETextureForm
 	}
 
 	default:
-		ERROR_LOG_REPORT(G3D, "Unknown Texture Format %d!!!", format);
+		ERROR_LOG_REPORT(G3D, "Unknown direct texture format %d!!!", format);
 		break;
 	}
 }
@@ -1490,7 +1751,9 @@ void TextureCacheCommon::ApplyTexture() {
 			// Update the hash on the texture.
 			int w = gstate.getTextureWidth(0);
 			int h = gstate.getTextureHeight(0);
+			entry->writeStamp = ArmTextureWriteTracking(entry);
 			entry->fullhash = QuickTexHash(replacer_, entry->addr, entry->bufw, w, h, GETextureFormat(entry->format), entry);
+			entry->hashMode = TexCacheEntry::HASH_FULL;
 
 			// TODO: Here we could check the secondary cache; maybe the texture is in there?
 			// We would need to abort the build if so.
@@ -1532,6 +1795,7 @@ void TextureCacheCommon::ApplyTexture() {
 
 void TextureCacheCommon::Clear(bool delete_them) {
 	ForgetLastTexture();
+	pendingInvalidations_.clear();
 	for (TexCache::iterator iter = cache_.begin(); iter != cache_.end(); ++iter) {
 		ReleaseTexture(iter->second.get(), delete_them);
 	}
@@ -1560,16 +1824,59 @@ void TextureCacheCommon::DeleteTexture(TexCache::iterator it) {
 	cache_.erase(it);
 }
 
+u32 TextureCacheCommon::ArmTextureWriteTracking(const TexCacheEntry *entry) {
+	if (!g_Config.bTextureWriteTracking)
+		return 0;
+	if (!Memory::IsTrackingWrites()) {
+		// Rewind or memory watches may have stopped it, try again at most once a frame.
+		if (writeTrackingFailedFrame_ == gpuStats.numFlips)
+			return 0;
+		if (!Memory::StartWriteTracking()) {
+			writeTrackingFailedFrame_ = gpuStats.numFlips;
+			return 0;
+		}
+	}
+
+	// All of level 0, which is all the full hash covers.
+	const u32 bytes = (textureBitsPerPixel[entry->format] * entry->bufw * gstate.getTextureHeight(0)) / 8;
+	return Memory::ArmWriteTrackingRange(entry->addr, bytes);
+}
+
 bool TextureCacheCommon::CheckFullHash(TexCacheEntry *entry, bool &doDelete) {
 	int w = gstate.getTextureWidth(0);
 	int h = gstate.getTextureHeight(0);
+
+	// If none of its pages were written, the texture can't have changed.
+	if (entry->writeStamp != 0) {
+		const u32 bytes = (textureBitsPerPixel[entry->format] * entry->bufw * h) / 8;
+		if (!Memory::RangeWrittenSince(entry->addr, bytes, entry->writeStamp)) {
+			gpuStats.numTextureHashesSkipped++;
+			return true;
+		}
+	}
+
+	if (entry->hashMode == TexCacheEntry::HASH_SAMPLED) {
+		u32 sampledhash;
+		if (entry->sampledChecks < TEXCACHE_SAMPLED_HASH_VERIFY_EVERY && SampledTexHash(entry, h, sampledhash) && sampledhash == entry->sampledhash) {
+			// Leaves the status alone, only full hashes regain trust.
+			entry->sampledChecks++;
+			gpuStats.numTextureHashesSampled++;
+			return true;
+		}
+		// Either time for a full check, or the stripes changed and we need the new full hash.
+		entry->hashMode = TexCacheEntry::HASH_FULL;
+	}
+
 	u32 fullhash;
+	u32 writeStamp = ArmTextureWriteTracking(entry);
 	{
 		PROFILE_THIS_SCOPE("texhash");
 		fullhash = QuickTexHash(replacer_, entry->addr, entry->bufw, w, h, GETextureFormat(entry->format), entry);
 	}
 
 	if (fullhash == entry->fullhash) {
+		entry->writeStamp = writeStamp;
+		UpdateHashMode(entry, h);
 		if (g_Config.bTextureBackoffCache) {
 			if (entry->GetHashStatus() != TexCacheEntry::STATUS_HASHING && entry->numFrames > TexCacheEntry::FRAMES_REGAIN_TRUST) {
 				// Reset to STATUS_HASHING.
@@ -1583,6 +1890,9 @@ bool TextureCacheCommon::CheckFullHash(TexCacheEntry *entry, bool &doDelete) {
 		return true;
 	}
 
+	// It changed, so it's not one to sample (this also goes for a copy in the secondary cache.)
+	entry->hashMode = TexCacheEntry::HASH_FULL;
+
 	// Don't give up just yet.  Let's try the secondary cache if it's been invalidated before.
 	if (g_Config.bTextureSecondaryCache) {
 		// Don't forget this one was unreliable (in case we match a secondary entry.)
@@ -1604,6 +1914,7 @@ bool TextureCacheCommon::CheckFullHash(TexCacheEntry *entry, bool &doDelete) {
 					}
 
 					// Now just use our archived texture, instead of entry.
+					secondEntry->writeStamp = writeStamp;
 					nextTexture_ = secondEntry;
 					return true;
 				}
@@ -1632,13 +1943,45 @@ bool TextureCacheCommon::CheckFullHash(TexCacheEntry *entry, bool &doDelete) {
 
 	// We know it failed, so update the full hash right away.
 	entry->fullhash = fullhash;
+	entry->writeStamp = writeStamp;
 	return false;
 }
 
-void TextureCacheCommon::Invalidate(u32 addr, int size, GPUInvalidationType type) {
-	// They could invalidate inside the texture, let's just give a bit of leeway.
-	const int LARGEST_TEXTURE_SIZE = 512 * 512 * 4;
+bool TextureCacheCommon::SampledTexHash(const TexCacheEntry *entry, int h, u32 &hash) const {
+	// Same area as QuickTexHash.
+	if (h == 512 && entry->maxSeenV < 512 && entry->maxSeenV != 0) {
+		h = (int)entry->maxSeenV;
+	}
+	const u32 sizeInRAM = (textureBitsPerPixel[entry->format] * entry->bufw * h) / 8;
+	if (sizeInRAM < TEXCACHE_SAMPLED_HASH_MIN_BYTES || !Memory::IsValidAddress(entry->addr + sizeInRAM)) {
+		return false;
+	}
 
+	// Keep the stripes 64 byte aligned so they take the SIMD path.
+	const u8 *checkp = Memory::GetPointer(entry->addr);
+	const u32 spacing = (sizeInRAM / TEXCACHE_SAMPLED_HASH_STRIPES) & ~63;
+	hash = 0;
+	for (int i = 0; i < TEXCACHE_SAMPLED_HASH_STRIPES; ++i) {
+		hash = ((hash << 5) | (hash >> 27)) ^ DoQuickTexHash(checkp + i * spacing, TEXCACHE_SAMPLED_HASH_STRIPE_BYTES);
+	}
+	return true;
+}
+
+void TextureCacheCommon::UpdateHashMode(TexCacheEntry *entry, int h) {
+	entry->hashMode = TexCacheEntry::HASH_FULL;
+	entry->sampledChecks = 0;
+	if (!g_Config.bTextureSampledHash || entry->numInvalidated != 0 || entry->numFrames < TEXCACHE_SAMPLED_HASH_MIN_FRAMES) {
+		return;
+	}
+	if ((entry->status & TexCacheEntry::STATUS_CHANGE_FREQUENT) != 0) {
+		return;
+	}
+	if (SampledTexHash(entry, h, entry->sampledhash)) {
+		entry->hashMode = TexCacheEntry::HASH_SAMPLED;
+	}
+}
+
+void TextureCacheCommon::Invalidate(u32 addr, int size, GPUInvalidationType type) {
 	addr &= 0x3FFFFFFF;
 	const u32 addr_end = addr + size;
 
@@ -1658,8 +2001,54 @@ void TextureCacheCommon::Invalidate(u32 addr, int size, GPUInvalidationType type
 		return;
 	}
 
+	if (type != GPU_INVALIDATE_HINT) {
+		// Keep the order, SAFE changes the frame counts differently.
+		FlushInvalidations();
+		InvalidateRange(addr, addr_end, type);
+		return;
+	}
+
+	// Games often memcpy or dcache flush a texture in many small pieces.  Hints are idempotent,
+	// so touching ranges can simply merge until the next SetTexture().
+	if (!pendingInvalidations_.empty()) {
+		PendingInvalidation &last = pendingInvalidations_.back();
+		if (addr <= last.end && addr_end >= last.start) {
+			last.start = std::min(last.start, addr);
+			last.end = std::max(last.end, addr_end);
+			return;
+		}
+	}
+	pendingInvalidations_.push_back({ addr, addr_end });
+	if (pendingInvalidations_.size() >= MAX_PENDING_INVALIDATIONS) {
+		FlushInvalidations();
+	}
+}
+
+void TextureCacheCommon::FlushInvalidations() {
+	if (pendingInvalidations_.empty()) {
+		return;
+	}
+
+	std::sort(pendingInvalidations_.begin(), pendingInvalidations_.end(), [](const PendingInvalidation &a, const PendingInvalidation &b) {
+		return a.start < b.start;
+	});
+	PendingInvalidation range = pendingInvalidations_[0];
+	for (size_t i = 1; i < pendingInvalidations_.size(); ++i) {
+		const PendingInvalidation &next = pendingInvalidations_[i];
+		if (next.start <= range.end) {
+			range.end = std::max(range.end, next.end);
+		} else {
+			InvalidateRange(range.start, range.end, GPU_INVALIDATE_HINT);
+			range = next;
+		}
+	}
+	InvalidateRange(range.start, range.end, GPU_INVALIDATE_HINT);
+	pendingInvalidations_.clear();
+}
+
+void TextureCacheCommon::InvalidateRange(u32 addr, u32 addr_end, GPUInvalidationType type) {
 	const u64 startKey = (u64)(addr - LARGEST_TEXTURE_SIZE) << 32;
-	u64 endKey = (u64)(addr + size + LARGEST_TEXTURE_SIZE) << 32;
+	u64 endKey = (u64)(addr_end + LARGEST_TEXTURE_SIZE) << 32;
 	if (endKey < startKey) {
 		endKey = (u64)-1;
 	}
@@ -1684,6 +2073,7 @@ void TextureCacheCommon::Invalidate(u32 addr, int size, GPUInvalidationType type
 					}
 				}
 				iter->second->framesUntilNextFullHash = 0;
+				iter->second->hashMode = TexCacheEntry::HASH_FULL;
 			} else if (!iter->second->framebuffer) {
 				iter->second->invalidHint++;
 			}
@@ -1696,6 +2086,7 @@ void TextureCacheCommon::InvalidateAll(GPUInvalidationType /*unused*/) {
 	if (!g_Config.bTextureBackoffCache) {
 		return;
 	}
+	FlushInvalidations();
 
 	if (timesInvalidatedAllThisFrame_ > 5) {
 		return;
@@ -1715,3 +2106,111 @@ void TextureCacheCommon::InvalidateAll(GPUInvalidationType /*unused*/) {
 void TextureCacheCommon::ClearNextFrame() {
 	clearCacheNextFrame_ = true;
 }
+
+ReplacedTexture &TextureCacheCommon::FindReplacement(TexCacheEntry *entry, int w, int h) {
+	u64 cachekey = replacer_.Enabled() ? entry->CacheKey() : 0;
+	ReplacedTexture &replaced = replacer_.FindReplacement(cachekey, entry->fullhash, w, h);
+	if (replaced.IsPending()) {
+		entry->status |= TexCacheEntry::STATUS_TO_REPLACE;
+	} else {
+		entry->status &= ~TexCacheEntry::STATUS_TO_REPLACE;
+	}
+	return replaced;
+}
+
+bool TextureCacheCommon::AsyncDecodeEnabled() const {
+	return PSP_CoreParameter().compat.flags().AsyncTextureDecode;
+}
+
+void TextureCacheCommon::QueueAsyncDecode(TexCacheEntry *entry, std::function<void()> work, std::function<void(TexCacheEntry *)> finish) {
+	AsyncDecodeJob job;
+	job.cachekey = entry->CacheKey();
+	// In case it gets archived into the secondary cache before the decode finishes.
+	job.secondKey = entry->fullhash | ((u64)entry->cluthash << 32);
+	job.fullhash = entry->fullhash;
+	job.texturePtr = entry->texturePtr;
+	job.work = std::move(work);
+	job.finish = std::move(finish);
+	entry->status |= TexCacheEntry::STATUS_ASYNC_PENDING;
+
+	std::lock_guard<std::mutex> guard(asyncDecodeLock_);
+	if (!asyncDecodeThread_.joinable()) {
+		asyncDecodeStop_ = false;
+		asyncDecodeThread_ = std::thread(&TextureCacheCommon::AsyncDecodeThreadFunc, this);
+	}
+	asyncDecodeQueue_.push_back(std::move(job));
+	asyncDecodeCond_.notify_one();
+}
+
+void TextureCacheCommon::AsyncDecodeThreadFunc() {
+	setCurrentThreadName("TexDecode");
+
+	std::unique_lock<std::mutex> guard(asyncDecodeLock_);
+	while (true) {
+		while (asyncDecodeQueue_.empty() && !asyncDecodeStop_) {
+			asyncDecodeCond_.wait(guard);
+		}
+		if (asyncDecodeStop_) {
+			break;
+		}
+
+		AsyncDecodeJob job = std::move(asyncDecodeQueue_.front());
+		asyncDecodeQueue_.pop_front();
+		guard.unlock();
+		job.work();
+		guard.lock();
+		asyncDecodeDone_.push_back(std::move(job));
+	}
+}
+
+void TextureCacheCommon::FinishAsyncDecodes() {
+	std::vector<AsyncDecodeJob> done;
+	{
+		std::lock_guard<std::mutex> guard(asyncDecodeLock_);
+		done.swap(asyncDecodeDone_);
+	}
+
+	auto findPending = [](TexCache &cache, u64 key, const AsyncDecodeJob &job) -> TexCacheEntry * {
+		auto iter = cache.find(key);
+		if (iter == cache.end()) {
+			return nullptr;
+		}
+		TexCacheEntry *entry = iter->second.get();
+		if ((entry->status & TexCacheEntry::STATUS_ASYNC_PENDING) == 0 || entry->texturePtr != job.texturePtr || entry->fullhash != job.fullhash) {
+			return nullptr;
+		}
+		return entry;
+	};
+
+	for (AsyncDecodeJob &job : done) {
+		TexCacheEntry *entry = findPending(cache_, job.cachekey, job);
+		if (!entry) {
+			entry = findPending(secondCache_, job.secondKey, job);
+		}
+		if (entry) {
+			entry->status &= ~TexCacheEntry::STATUS_ASYNC_PENDING;
+		}
+		job.finish(entry);
+	}
+}
+
+void TextureCacheCommon::StopAsyncDecodes() {
+	{
+		std::lock_guard<std::mutex> guard(asyncDecodeLock_);
+		asyncDecodeStop_ = true;
+		asyncDecodeCond_.notify_one();
+	}
+	if (asyncDecodeThread_.joinable()) {
+		asyncDecodeThread_.join();
+	}
+
+	// Nothing gets uploaded, this just lets the jobs free their memory.
+	for (AsyncDecodeJob &job : asyncDecodeQueue_) {
+		job.finish(nullptr);
+	}
+	for (AsyncDecodeJob &job : asyncDecodeDone_) {
+		job.finish(nullptr);
+	}
+	asyncDecodeQueue_.clear();
+	asyncDecodeDone_.clear();
+}
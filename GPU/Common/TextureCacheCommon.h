@@ -17,9 +17,14 @@
 
 #pragma once
 
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include <map>
-#include <vector>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #include "Common/CommonTypes.h"
 #include "Common/MemoryUtil.h"
@@ -48,6 +53,14 @@ enum FramebufferNotification {
 
 #define TEXCACHE_MAX_TEXELS_SCALED (256*256)  // Per frame
 
+// Sampled hashing, see TexCacheEntry::HASH_SAMPLED.
+#define TEXCACHE_SAMPLED_HASH_MIN_BYTES (64 * 1024)
+#define TEXCACHE_SAMPLED_HASH_MIN_FRAMES 120
+#define TEXCACHE_SAMPLED_HASH_STRIPES 16
+#define TEXCACHE_SAMPLED_HASH_STRIPE_BYTES 256
+// Sampled checks between full ones.
+#define TEXCACHE_SAMPLED_HASH_VERIFY_EVERY 7
+
 struct VirtualFramebuffer;
 
 class CachedTextureVulkan;
@@ -120,6 +133,17 @@ struct TexCacheEntry {
 		STATUS_FREE_CHANGE = 0x200,    // Allow one change before marking "frequent".
 
 		STATUS_BAD_MIPS = 0x400,       // Has bad or unusable mipmap levels.
+		STATUS_ASYNC_PENDING = 0x800,  // A placeholder is bound while the real texture decodes on a worker.
+		STATUS_SHADER_CLUT = 0x1000,   // Holds the raw indices, the shader looks up the palette.
+		STATUS_TO_REPLACE = 0x2000,    // The replacement was still loading, rebuild once it's ready.
+	};
+
+	// How CheckFullHash verifies the texture.  Only big textures that have never changed get
+	// HASH_SAMPLED, which checks a few stripes and only does the full hash every few checks, or
+	// when the stripes change.  Sampled checks don't count towards regaining trust.
+	enum HashMode {
+		HASH_FULL = 0,
+		HASH_SAMPLED = 1,
 	};
 
 	// Status, but int so we can zero initialize.
@@ -147,7 +171,16 @@ struct TexCacheEntry {
 	u32 framesUntilNextFullHash;
 	u32 fullhash;
 	u32 cluthash;
+	// Write tracking stamp from when fullhash was taken, 0 if the memory isn't tracked.
+	u32 writeStamp;
+	// Host memory the built texture takes, with all levels and scaling.  0 until built.
+	u32 memoryUsage;
 	u16 maxSeenV;
+	// HashMode, and sampled checks done since the last full hash.
+	u8 hashMode;
+	u8 sampledChecks;
+	// Matches the fullhash contents, only valid with HASH_SAMPLED.
+	u32 sampledhash;
 
 	TexStatus GetHashStatus() {
 		return TexStatus(status & STATUS_MASK);
@@ -170,6 +203,10 @@ struct TexCacheEntry {
 
 	bool Matches(u16 dim2, u8 format2, u8 maxLevel2) const;
 	u64 CacheKey() const;
+	// Identifies the contents rather than the location, used for the scaled texture cache.
+	u64 ContentKey() const {
+		return ((u64)cluthash << 32) | fullhash;
+	}
 	static u64 CacheKey(u32 addr, u8 format, u16 dim, u32 cluthash);
 };
 
@@ -191,6 +228,8 @@ class TextureCacheCommon {
 	bool SetOffsetTexture(u32 offset);
 	void Invalidate(u32 addr, int size, GPUInvalidationType type);
 	void InvalidateAll(GPUInvalidationType type);
+	// Hint invalidations are merged and only walk the cache once a texture is next set.
+	void FlushInvalidations();
 	void ClearNextFrame();
 
 	virtual void ForgetLastTexture() = 0;
@@ -207,6 +246,11 @@ class TextureCacheCommon {
 	size_t NumLoadedTextures() const {
 		return cache_.size();
 	}
+	// Both caches, in bytes.  The budget is 0 when there isn't one.
+	u32 MemoryUsage() const {
+		return cacheSizeEstimate_ + secondCacheSizeEstimate_;
+	}
+	u32 MemoryBudget() const;
 
 	bool IsFakeMipmapChange() {
 		return PSP_CoreParameter().compat.flags().FakeMipmapChange && gstate.getTexLevelMode() == GE_TEXLEVEL_MODE_CONST;
@@ -222,12 +266,25 @@ class TextureCacheCommon {
 	virtual void ReleaseTexture(TexCacheEntry *entry, bool delete_them) = 0;
 	void DeleteTexture(TexCache::iterator it);
 	void Decimate();
+	void InvalidateRange(u32 addr, u32 addr_end, GPUInvalidationType type);
 
 	virtual void ApplyTextureFramebuffer(TexCacheEntry *entry, VirtualFramebuffer *framebuffer) = 0;
 	void HandleTextureChange(TexCacheEntry *const entry, const char *reason, bool initialMatch, bool doDelete);
 	virtual void BuildTexture(TexCacheEntry *const entry) = 0;
 	virtual void UpdateCurrentClut(GEPaletteFormat clutFormat, u32 clutBase, bool clutIndexIsSimple) = 0;
 	bool CheckFullHash(TexCacheEntry *entry, bool &doDelete);
+	// Hashes a few evenly spaced stripes, false if the texture is too small to bother.
+	bool SampledTexHash(const TexCacheEntry *entry, int h, u32 &hash) const;
+	// After a full hash matched, picks the HashMode for the next checks.
+	void UpdateHashMode(TexCacheEntry *entry, int h);
+	// Call right before hashing the texture, returns the stamp to keep with the hash.
+	u32 ArmTextureWriteTracking(const TexCacheEntry *entry);
+	// Backends that generate the palette lookup in their fragment shaders override this.
+	virtual bool SupportsClutLookupInShader() const { return false; }
+	bool CanLookupClutInShader(GETextureFormat format, u8 maxLevel, u32 texaddr);
+
+	// Like replacer_.FindReplacement(), but remembers on the entry if the replacement is still loading.
+	ReplacedTexture &FindReplacement(TexCacheEntry *entry, int w, int h);
 
 	// Separate to keep main texture cache size down.
 	struct AttachedFramebufferInfo {
@@ -236,7 +293,15 @@ class TextureCacheCommon {
 	};
 
 	void DecodeTextureLevel(u8 *out, int outPitch, GETextureFormat format, GEPaletteFormat clutformat, uint32_t texaddr, int level, int bufw, bool reverseColors, bool useBGRA, bool expandTo32Bit);
-	void UnswizzleFromMem(u32 *dest, u32 destPitch, const u8 *texptr, u32 bufw, u32 height, u32 bytesPerPixel);
+	// Decodes the formats that don't use the CLUT. Only uses its parameters, so it's safe to call from a worker.
+	static void DecodeDirectTextureLevel(u8 *out, int outPitch, GETextureFormat format, const u8 *texptr, int w, int h, int bufw, bool swizzled, bool reverseColors, bool useBGRA, bool expandTo32bit, SimpleBuf<u32> &tmp);
+	static void UnswizzleFromMem(u32 *dest, u32 destPitch, const u8 *texptr, u32 bufw, u32 height, u32 bytesPerPixel);
+	// Copies a DXT level as BC1/BC2/BC3 blocks for backends that can sample those, outPitch is per row of blocks.
+	CheckAlphaResult ConvertDXTLevelToBC(u8 *out, int outPitch, GETextureFormat format, uint32_t texaddr, int level, int bufw);
+	// Copies the indices of a CLUT4/CLUT8 level out as one byte per texel.
+	void DecodeIndexLevel(u8 *out, int outPitch, GETextureFormat format, uint32_t texaddr, int level, int bufw);
+	// Fills the 256 RGBA8888 colors indices are looked up in, with the CLUT shift, mask, and offset already applied.
+	void BuildLookupClut(u32 *colors);
 	void ReadIndexedTex(u8 *out, int outPitch, int level, const u8 *texptr, int bytesPerIndex, int bufw, bool expandTo32Bit);
 
 	template <typename T>
@@ -245,6 +310,9 @@ class TextureCacheCommon {
 	}
 
 	u32 EstimateTexMemoryUsage(const TexCacheEntry *entry);
+	// Backends call this once they know the real size of what they built.
+	void SetTexMemoryUsage(TexCacheEntry *entry, int w, int h, int levels, int bitsPerPixel);
+	void EvictToBudget(u32 budget);
 	void GetSamplingParams(int &minFilt, int &magFilt, bool &sClamp, bool &tClamp, float &lodBias, int maxLevel, u32 addr, GETexLevelMode &mode);
 	void UpdateSamplingParams(TexCacheEntry &entry, SamplerCacheKey &key);  // Used by D3D11 and Vulkan.
 	void UpdateMaxSeenV(TexCacheEntry *entry, bool throughMode);
@@ -258,6 +326,14 @@ class TextureCacheCommon {
 
 	void DecimateVideos();
 
+	// Async texture decoding, opt-in per game through the AsyncTextureDecode compat flag.
+	// work runs on the decode thread, finish later runs on the GPU thread from FinishAsyncDecodes(),
+	// with the entry if it's still the one that was queued, or null if it was changed or deleted meanwhile.
+	bool AsyncDecodeEnabled() const;
+	void QueueAsyncDecode(TexCacheEntry *entry, std::function<void()> work, std::function<void(TexCacheEntry *)> finish);
+	void FinishAsyncDecodes();
+	void StopAsyncDecodes();
+
 	inline u32 QuickTexHash(TextureReplacer &replacer, u32 addr, int bufw, int w, int h, GETextureFormat format, TexCacheEntry *entry) const {
 		if (replacer.Enabled()) {
 			return replacer.ComputeHash(addr, bufw, w, h, format, entry->maxSeenV);
@@ -303,6 +379,29 @@ class TextureCacheCommon {
 
 	std::map<u32, int> videos_;
 
+	struct PendingInvalidation {
+		u32 start;
+		u32 end;
+	};
+	std::vector<PendingInvalidation> pendingInvalidations_;
+
+	struct AsyncDecodeJob {
+		u64 cachekey;
+		u64 secondKey;
+		u32 fullhash;
+		void *texturePtr;
+		std::function<void()> work;
+		std::function<void(TexCacheEntry *)> finish;
+	};
+	void AsyncDecodeThreadFunc();
+
+	std::thread asyncDecodeThread_;
+	std::mutex asyncDecodeLock_;
+	std::condition_variable asyncDecodeCond_;
+	std::deque<AsyncDecodeJob> asyncDecodeQueue_;
+	std::vector<AsyncDecodeJob> asyncDecodeDone_;
+	bool asyncDecodeStop_ = false;
+
 	SimpleBuf<u32> tmpTexBuf32_;
 	SimpleBuf<u16> tmpTexBuf16_;
 	SimpleBuf<u32> tmpTexBufRearrange_;
@@ -333,6 +432,8 @@ class TextureCacheCommon {
 	bool nextNeedsRebuild_;
 
 	bool isBgraBackend_;
+	// Frame write tracking last failed to start, so we don't keep retrying.
+	int writeTrackingFailedFrame_ = -1;
 
 	u32 expandClut_[256];
 };
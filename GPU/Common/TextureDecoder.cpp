@@ -29,9 +29,15 @@
 
 #ifdef _M_SSE
 #include <emmintrin.h>
+#if _M_SSE >= 0x301
+#include <tmmintrin.h>
+#endif
 #if _M_SSE >= 0x401
 #include <smmintrin.h>
 #endif
+#ifdef HAVE_AVX2_DISPATCH
+#include <immintrin.h>
+#endif
 
 u32 QuickTexHashSSE2(const void *checkp, u32 size) {
 	u32 check = 0;
@@ -312,10 +318,24 @@ ReliableHash32Func DoReliableHash32 = &XXH32;
 ReliableHash64Func DoReliableHash64 = &XXH64;
 #endif
 
+static const char *textureDecoderVariant = "Generic";
+
 // This has to be done after CPUDetect has done its magic.
 void SetupTextureDecoder() {
+#if PPSSPP_ARCH(ARM64)
+	textureDecoderVariant = "NEON";
+#elif defined(_M_SSE)
+	// The quick hash stays SSE2 even with AVX2, it has to match across platforms.
+	textureDecoderVariant = "SSE2";
+#endif
+#ifdef HAVE_AVX2_DISPATCH
+	// Only the alpha checks have AVX2 versions. They check cpu_info themselves.
+	if (cpu_info.bAVX2)
+		textureDecoderVariant = "AVX2";
+#endif
 #if PPSSPP_ARCH(ARM_NEON) && !PPSSPP_ARCH(ARM64)
 	if (cpu_info.bNEON) {
+		textureDecoderVariant = "NEON";
 		DoQuickTexHash = &QuickTexHashNEON;
 		StableQuickTexHash = &QuickTexHashNEON;
 		DoUnswizzleTex16 = &DoUnswizzleTex16NEON;
@@ -327,6 +347,110 @@ void SetupTextureDecoder() {
 #endif
 }
 
+const char *GetTextureDecoderVariant() {
+	return textureDecoderVariant;
+}
+
+#if _M_SSE >= 0x301
+// Each pshufb looks up one byte plane of the 16-entry CLUT for 16 indices at once.
+static inline void SplitIndices4SSSE3(const u8 *indexed, __m128i &first, __m128i &second) {
+	const __m128i mask4 = _mm_set1_epi8(0x0F);
+	const __m128i in = _mm_loadu_si128((const __m128i *)indexed);
+	const __m128i lo = _mm_and_si128(in, mask4);
+	const __m128i hi = _mm_and_si128(_mm_srli_epi16(in, 4), mask4);
+	// The low nibble is the first pixel of each pair.
+	first = _mm_unpacklo_epi8(lo, hi);
+	second = _mm_unpackhi_epi8(lo, hi);
+}
+
+static int DeIndexTexture4SimpleSSSE3(u16 *dest, const u8 *indexed, int length, const u16 *clut) {
+	alignas(16) u8 planes[2][16];
+	for (int i = 0; i < 16; ++i) {
+		planes[0][i] = clut[i] & 0xFF;
+		planes[1][i] = clut[i] >> 8;
+	}
+	const __m128i plane0 = _mm_load_si128((const __m128i *)planes[0]);
+	const __m128i plane1 = _mm_load_si128((const __m128i *)planes[1]);
+
+	int i = 0;
+	for (; i + 32 <= length; i += 32) {
+		__m128i idx[2];
+		SplitIndices4SSSE3(indexed + i / 2, idx[0], idx[1]);
+		for (int j = 0; j < 2; ++j) {
+			const __m128i b0 = _mm_shuffle_epi8(plane0, idx[j]);
+			const __m128i b1 = _mm_shuffle_epi8(plane1, idx[j]);
+			_mm_storeu_si128((__m128i *)(dest + i + j * 16), _mm_unpacklo_epi8(b0, b1));
+			_mm_storeu_si128((__m128i *)(dest + i + j * 16 + 8), _mm_unpackhi_epi8(b0, b1));
+		}
+	}
+	return i;
+}
+
+static int DeIndexTexture4SimpleSSSE3(u32 *dest, const u8 *indexed, int length, const u32 *clut) {
+	alignas(16) u8 planes[4][16];
+	for (int i = 0; i < 16; ++i) {
+		for (int p = 0; p < 4; ++p) {
+			planes[p][i] = (clut[i] >> (p * 8)) & 0xFF;
+		}
+	}
+	const __m128i plane0 = _mm_load_si128((const __m128i *)planes[0]);
+	const __m128i plane1 = _mm_load_si128((const __m128i *)planes[1]);
+	const __m128i plane2 = _mm_load_si128((const __m128i *)planes[2]);
+	const __m128i plane3 = _mm_load_si128((const __m128i *)planes[3]);
+
+	int i = 0;
+	for (; i + 32 <= length; i += 32) {
+		__m128i idx[2];
+		SplitIndices4SSSE3(indexed + i / 2, idx[0], idx[1]);
+		for (int j = 0; j < 2; ++j) {
+			const __m128i b0 = _mm_shuffle_epi8(plane0, idx[j]);
+			const __m128i b1 = _mm_shuffle_epi8(plane1, idx[j]);
+			const __m128i b2 = _mm_shuffle_epi8(plane2, idx[j]);
+			const __m128i b3 = _mm_shuffle_epi8(plane3, idx[j]);
+			const __m128i b01lo = _mm_unpacklo_epi8(b0, b1);
+			const __m128i b01hi = _mm_unpackhi_epi8(b0, b1);
+			const __m128i b23lo = _mm_unpacklo_epi8(b2, b3);
+			const __m128i b23hi = _mm_unpackhi_epi8(b2, b3);
+			u32 *d = dest + i + j * 16;
+			_mm_storeu_si128((__m128i *)(d + 0), _mm_unpacklo_epi16(b01lo, b23lo));
+			_mm_storeu_si128((__m128i *)(d + 4), _mm_unpackhi_epi16(b01lo, b23lo));
+			_mm_storeu_si128((__m128i *)(d + 8), _mm_unpacklo_epi16(b01hi, b23hi));
+			_mm_storeu_si128((__m128i *)(d + 12), _mm_unpackhi_epi16(b01hi, b23hi));
+		}
+	}
+	return i;
+}
+#endif
+
+template <typename ClutT>
+static inline void DeIndexTexture4SimpleT(ClutT *dest, const u8 *indexed, int length, const ClutT *clut) {
+	int i = 0;
+#if _M_SSE >= 0x301
+	i = DeIndexTexture4SimpleSSSE3(dest, indexed, length, clut);
+#elif PPSSPP_ARCH(ARM64)
+	i = DeIndexTexture4SimpleNEON(dest, indexed, length, clut);
+#elif PPSSPP_ARCH(ARM_NEON)
+	if (cpu_info.bNEON) {
+		i = DeIndexTexture4SimpleNEON(dest, indexed, length, clut);
+	}
+#endif
+
+	indexed += i / 2;
+	for (; i < length; i += 2) {
+		u8 index = *indexed++;
+		dest[i + 0] = clut[(index >> 0) & 0xf];
+		dest[i + 1] = clut[(index >> 4) & 0xf];
+	}
+}
+
+void DeIndexTexture4Simple(u16 *dest, const u8 *indexed, int length, const u16 *clut) {
+	DeIndexTexture4SimpleT(dest, indexed, length, clut);
+}
+
+void DeIndexTexture4Simple(u32 *dest, const u8 *indexed, int length, const u32 *clut) {
+	DeIndexTexture4SimpleT(dest, indexed, length, clut);
+}
+
 static inline u32 makecol(int r, int g, int b, int a) {
 	return (a << 24) | (r << 16) | (g << 8) | b;
 }
@@ -429,6 +553,86 @@ void DecodeDXT5Block(u32 *dst, const DXT5Block *src, int pitch, int height) {
 	}
 }
 
+// The color part is the same as BC1, only the endpoints and indices are the other way around.
+static inline void WriteBCColorBlock(u8 *dst, const DXT1Block *src, bool forceFourColors, bool *hasAlpha) {
+	u16 c1 = src->color1;
+	u16 c2 = src->color2;
+	if (!forceFourColors && c1 <= c2) {
+		// Index 3 is transparent black in three color mode.
+		for (int y = 0; y < 4; y++) {
+			u8 val = src->lines[y];
+			if ((val & 0x03) == 0x03 || (val & 0x0C) == 0x0C || (val & 0x30) == 0x30 || (val & 0xC0) == 0xC0)
+				*hasAlpha = true;
+		}
+	}
+
+	dst[0] = c1 & 0xFF;
+	dst[1] = c1 >> 8;
+	dst[2] = c2 & 0xFF;
+	dst[3] = c2 >> 8;
+	memcpy(dst + 4, src->lines, 4);
+}
+
+bool ConvertDXT1ToBC1(u8 *dst, const DXT1Block *src, int blocks) {
+	bool hasAlpha = false;
+	for (int i = 0; i < blocks; ++i) {
+		WriteBCColorBlock(dst, src + i, false, &hasAlpha);
+		dst += 8;
+	}
+	return hasAlpha;
+}
+
+bool ConvertDXT3ToBC2(u8 *dst, const DXT3Block *src, int blocks) {
+	bool hasAlpha = false;
+	for (int i = 0; i < blocks; ++i) {
+		// Same 4 bits per texel, row by row, but BC2 puts the alpha first.
+		for (int y = 0; y < 4; y++) {
+			u16 line = src[i].alphaLines[y];
+			if (line != 0xFFFF)
+				hasAlpha = true;
+			dst[y * 2 + 0] = line & 0xFF;
+			dst[y * 2 + 1] = line >> 8;
+		}
+		WriteBCColorBlock(dst + 8, &src[i].color, true, &hasAlpha);
+		dst += 16;
+	}
+	return hasAlpha;
+}
+
+bool ConvertDXT5ToBC3(u8 *dst, const DXT5Block *src, int blocks) {
+	bool hasAlpha = false;
+	for (int i = 0; i < blocks; ++i) {
+		const DXT5Block &block = src[i];
+		dst[0] = block.alpha1;
+		dst[1] = block.alpha2;
+		u64 data = ((u64)(u16)block.alphadata1 << 32) | (u32)block.alphadata2;
+		for (int b = 0; b < 6; ++b) {
+			dst[2 + b] = (u8)(data >> (b * 8));
+		}
+
+		if (!hasAlpha) {
+			// Only opaque if every index used resolves to 255.  Interpolated values only do that
+			// when both ends are 255, and in six alpha mode index 6 is 0 and 7 is 255.
+			bool eightAlphas = block.alpha1 > block.alpha2;
+			bool bothOpaque = block.alpha1 == 255 && block.alpha2 == 255;
+			u8 opaque = (block.alpha1 == 255 ? 0x01 : 0) | (block.alpha2 == 255 ? 0x02 : 0);
+			if (!eightAlphas)
+				opaque |= (bothOpaque ? 0x3C : 0) | 0x80;
+			for (int p = 0; p < 16; ++p) {
+				int index = (data >> (p * 3)) & 7;
+				if ((opaque & (1 << index)) == 0) {
+					hasAlpha = true;
+					break;
+				}
+			}
+		}
+
+		WriteBCColorBlock(dst + 8, &block.color, true, &hasAlpha);
+		dst += 16;
+	}
+	return hasAlpha;
+}
+
 #ifdef _M_SSE
 static inline u32 CombineSSEBitsToDWORD(const __m128i &v) {
 	__m128i temp;
@@ -563,9 +767,46 @@ CheckAlphaResult CheckAlphaRGBA5551SSE2(const u32 *pixelData, int stride, int w,
 }
 #endif
 
+#ifdef HAVE_AVX2_DISPATCH
+// Works for all the formats, since the alpha bits repeat in every 32 bits. Rows are multiples of
+// 16 bytes, so a trailing half vector is filled out with the mask.
+TARGET_AVX2
+static CheckAlphaResult CheckAlphaAVX2(const u32 *pixelData, int strideBytes, int rowBytes, int h, u32 alphaMask) {
+	const __m256i mask = _mm256_set1_epi32(alphaMask);
+	const int w32 = rowBytes / 32;
+	const bool halfVector = (rowBytes & 16) != 0;
+
+	const u8 *row = (const u8 *)pixelData;
+	__m256i bits = mask;
+	for (int y = 0; y < h; ++y) {
+		const __m256i *p = (const __m256i *)row;
+		for (int i = 0; i < w32; ++i) {
+			bits = _mm256_and_si256(bits, _mm256_loadu_si256(&p[i]));
+		}
+		if (halfVector) {
+			const __m128i last = _mm_loadu_si128((const __m128i *)&p[w32]);
+			bits = _mm256_and_si256(bits, _mm256_inserti128_si256(mask, last, 0));
+		}
+
+		if (!_mm256_testc_si256(bits, mask)) {
+			return CHECKALPHA_ANY;
+		}
+
+		row += strideBytes;
+	}
+
+	return CHECKALPHA_FULL;
+}
+#endif
+
 CheckAlphaResult CheckAlphaRGBA8888Basic(const u32 *pixelData, int stride, int w, int h) {
 	// Use SIMD if aligned to 16 bytes / 4 pixels (almost always the case.)
 	if ((w & 3) == 0 && (stride & 3) == 0) {
+#ifdef HAVE_AVX2_DISPATCH
+		if (cpu_info.bAVX2) {
+			return CheckAlphaAVX2(pixelData, stride * 4, w * 4, h, 0xFF000000);
+		}
+#endif
 #ifdef _M_SSE
 		return CheckAlphaRGBA8888SSE2(pixelData, stride, w, h);
 #elif PPSSPP_ARCH(ARMV7) || PPSSPP_ARCH(ARM64)
@@ -596,6 +837,11 @@ CheckAlphaResult CheckAlphaRGBA8888Basic(const u32 *pixelData, int stride, int w
 CheckAlphaResult CheckAlphaABGR4444Basic(const u32 *pixelData, int stride, int w, int h) {
 	// Use SIMD if aligned to 16 bytes / 8 pixels (usually the case.)
 	if ((w & 7) == 0 && (stride & 7) == 0) {
+#ifdef HAVE_AVX2_DISPATCH
+		if (cpu_info.bAVX2) {
+			return CheckAlphaAVX2(pixelData, stride * 2, w * 2, h, 0x000F000F);
+		}
+#endif
 #ifdef _M_SSE
 		return CheckAlphaABGR4444SSE2(pixelData, stride, w, h);
 #elif PPSSPP_ARCH(ARMV7) || PPSSPP_ARCH(ARM64)
@@ -629,6 +875,11 @@ CheckAlphaResult CheckAlphaABGR4444Basic(const u32 *pixelData, int stride, int w
 CheckAlphaResult CheckAlphaABGR1555Basic(const u32 *pixelData, int stride, int w, int h) {
 	// Use SIMD if aligned to 16 bytes / 8 pixels (usually the case.)
 	if ((w & 7) == 0 && (stride & 7) == 0) {
+#ifdef HAVE_AVX2_DISPATCH
+		if (cpu_info.bAVX2) {
+			return CheckAlphaAVX2(pixelData, stride * 2, w * 2, h, 0x00010001);
+		}
+#endif
 #ifdef _M_SSE
 		return CheckAlphaABGR1555SSE2(pixelData, stride, w, h);
 #elif PPSSPP_ARCH(ARMV7) || PPSSPP_ARCH(ARM64)
@@ -661,6 +912,11 @@ CheckAlphaResult CheckAlphaABGR1555Basic(const u32 *pixelData, int stride, int w
 CheckAlphaResult CheckAlphaRGBA4444Basic(const u32 *pixelData, int stride, int w, int h) {
 	// Use SSE if aligned to 16 bytes / 8 pixels (usually the case.)
 	if ((w & 7) == 0 && (stride & 7) == 0) {
+#ifdef HAVE_AVX2_DISPATCH
+		if (cpu_info.bAVX2) {
+			return CheckAlphaAVX2(pixelData, stride * 2, w * 2, h, 0xF000F000);
+		}
+#endif
 #ifdef _M_SSE
 		return CheckAlphaRGBA4444SSE2(pixelData, stride, w, h);
 #elif PPSSPP_ARCH(ARMV7) || PPSSPP_ARCH(ARM64)
@@ -694,6 +950,11 @@ CheckAlphaResult CheckAlphaRGBA4444Basic(const u32 *pixelData, int stride, int w
 CheckAlphaResult CheckAlphaRGBA5551Basic(const u32 *pixelData, int stride, int w, int h) {
 	// Use SSE if aligned to 16 bytes / 8 pixels (usually the case.)
 	if ((w & 7) == 0 && (stride & 7) == 0) {
+#ifdef HAVE_AVX2_DISPATCH
+		if (cpu_info.bAVX2) {
+			return CheckAlphaAVX2(pixelData, stride * 2, w * 2, h, 0x80008000);
+		}
+#endif
 #ifdef _M_SSE
 		return CheckAlphaRGBA5551SSE2(pixelData, stride, w, h);
 #elif PPSSPP_ARCH(ARMV7) || PPSSPP_ARCH(ARM64)
@@ -31,6 +31,8 @@ enum CheckAlphaResult {
 #include "GPU/GPUState.h"
 
 void SetupTextureDecoder();
+// Which SIMD implementation SetupTextureDecoder picked, for display.
+const char *GetTextureDecoderVariant();
 
 // Pitch must be aligned to 16 bits (as is the case on a PSP)
 void DoSwizzleTex16(const u32 *ysrcp, u8 *texptr, int bxc, int byc, u32 pitch);
@@ -119,6 +121,12 @@ void DecodeDXT1Block(u32 *dst, const DXT1Block *src, int pitch, int height, bool
 void DecodeDXT3Block(u32 *dst, const DXT3Block *src, int pitch, int height);
 void DecodeDXT5Block(u32 *dst, const DXT5Block *src, int pitch, int height);
 
+// Reorders PSP DXT blocks into the BC1/BC2/BC3 layout that PC GPUs can sample directly.
+// Writes 8 bytes per block for BC1, and 16 for BC2/BC3.  Returns whether any texel has alpha < 255.
+bool ConvertDXT1ToBC1(u8 *dst, const DXT1Block *src, int blocks);
+bool ConvertDXT3ToBC2(u8 *dst, const DXT3Block *src, int blocks);
+bool ConvertDXT5ToBC3(u8 *dst, const DXT5Block *src, int blocks);
+
 static const u8 textureBitsPerPixel[16] = {
 	16,  //GE_TFMT_5650,
 	16,  //GE_TFMT_5551,
@@ -168,17 +176,17 @@ inline void DeIndexTexture(ClutT *dest, const u32 texaddr, int length, const Clu
 	DeIndexTexture(dest, indexed, length, clut);
 }
 
+// 4-bit indices straight into the first 16 CLUT entries, using SIMD table lookups where possible.
+void DeIndexTexture4Simple(u16 *dest, const u8 *indexed, int length, const u16 *clut);
+void DeIndexTexture4Simple(u32 *dest, const u8 *indexed, int length, const u32 *clut);
+
 template <typename ClutT>
 inline void DeIndexTexture4(ClutT *dest, const u8 *indexed, int length, const ClutT *clut) {
 	// Usually, there is no special offset, mask, or shift.
 	const bool nakedIndex = gstate.isClutIndexSimple();
 
 	if (nakedIndex) {
-		for (int i = 0; i < length; i += 2) {
-			u8 index = *indexed++;
-			dest[i + 0] = clut[(index >> 0) & 0xf];
-			dest[i + 1] = clut[(index >> 4) & 0xf];
-		}
+		DeIndexTexture4Simple(dest, indexed, length, clut);
 	} else {
 		for (int i = 0; i < length; i += 2) {
 			u8 index = *indexed++;
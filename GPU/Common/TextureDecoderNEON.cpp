@@ -259,6 +259,61 @@ u32 ReliableHash32NEON(const void *input, size_t len, u32 seed) {
 	return h32;
 }
 
+// Looks up 16 indices at a time, one byte plane of the CLUT per table.
+static inline uint8x8x2_t SplitIndices4NEON(const u8 *indexed) {
+	const uint8x8_t in = vld1_u8(indexed);
+	// The low nibble is the first pixel of each pair.
+	return vzip_u8(vand_u8(in, vdup_n_u8(0x0F)), vshr_n_u8(in, 4));
+}
+
+int DeIndexTexture4SimpleNEON(u16 *dest, const u8 *indexed, int length, const u16 *clut) {
+	// Deinterleave the 16 entries into two planes of 16 bytes each.
+	const uint8x8x2_t first = vld2_u8((const u8 *)clut);
+	const uint8x8x2_t second = vld2_u8((const u8 *)(clut + 8));
+	uint8x8x2_t planes[2];
+	for (int p = 0; p < 2; ++p) {
+		planes[p].val[0] = first.val[p];
+		planes[p].val[1] = second.val[p];
+	}
+
+	int i = 0;
+	for (; i + 16 <= length; i += 16) {
+		const uint8x8x2_t idx = SplitIndices4NEON(indexed + i / 2);
+		for (int j = 0; j < 2; ++j) {
+			uint8x8x2_t result;
+			result.val[0] = vtbl2_u8(planes[0], idx.val[j]);
+			result.val[1] = vtbl2_u8(planes[1], idx.val[j]);
+			vst2_u8((u8 *)(dest + i + j * 8), result);
+		}
+	}
+	return i;
+}
+
+int DeIndexTexture4SimpleNEON(u32 *dest, const u8 *indexed, int length, const u32 *clut) {
+	// Deinterleave the 16 entries into four planes of 16 bytes each.
+	const uint8x8x4_t first = vld4_u8((const u8 *)clut);
+	const uint8x8x4_t second = vld4_u8((const u8 *)(clut + 8));
+	uint8x8x2_t planes[4];
+	for (int p = 0; p < 4; ++p) {
+		planes[p].val[0] = first.val[p];
+		planes[p].val[1] = second.val[p];
+	}
+
+	int i = 0;
+	for (; i + 16 <= length; i += 16) {
+		const uint8x8x2_t idx = SplitIndices4NEON(indexed + i / 2);
+		for (int j = 0; j < 2; ++j) {
+			uint8x8x4_t result;
+			result.val[0] = vtbl2_u8(planes[0], idx.val[j]);
+			result.val[1] = vtbl2_u8(planes[1], idx.val[j]);
+			result.val[2] = vtbl2_u8(planes[2], idx.val[j]);
+			result.val[3] = vtbl2_u8(planes[3], idx.val[j]);
+			vst4_u8((u8 *)(dest + i + j * 8), result);
+		}
+	}
+	return i;
+}
+
 static inline bool VectorIsNonZeroNEON(const uint32x4_t &v) {
 	u64 low = vgetq_lane_u64(vreinterpretq_u64_u32(v), 0);
 	u64 high = vgetq_lane_u64(vreinterpretq_u64_u32(v), 1);
@@ -25,17 +25,24 @@
 #include <cstdlib>
 #include <cstring>
 #include <cmath>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 
 #include "GPU/Common/TextureScalerCommon.h"
 
 #include "Core/Config.h"
+#include "Core/System.h"
 #include "Common/Common.h"
+#include "Common/FileUtil.h"
 #include "Common/Log.h"
 #include "Common/MsgHandler.h"
 #include "Common/CommonFuncs.h"
 #include "Common/ThreadPools.h"
 #include "Common/CPUDetect.h"
 #include "ext/xbrz/xbrz.h"
+#include "ext/xxhash.h"
 
 #if _M_SSE >= 0x401
 #include <smmintrin.h>
@@ -485,6 +492,152 @@ void dbgPGM(int w, int h, u32* pixels, const char* prefix = "dbg") { // 1 compon
 }
 }
 
+/////////////////////////////////////// Scaled texture cache
+
+// Keeps recently scaled textures, so textures that get evicted and come back (like when revisiting
+// an area) don't have to be scaled again. Shared by all scalers, so it's locked.
+// Optionally, what falls out of RAM is written to disk for the rest of the session.
+class ScaledTextureCache {
+public:
+	bool Contains(u64 key);
+	bool Find(u64 key, u32 *out, size_t pixels);
+	void Store(u64 key, const u32 *data, size_t pixels);
+
+private:
+	enum {
+		MAX_RAM_BYTES = 64 * 1024 * 1024,
+		MAX_DISK_BYTES = 256 * 1024 * 1024,
+	};
+	struct Entry {
+		std::vector<u32> data;
+		std::list<u64>::iterator lru;
+	};
+
+	void Insert(u64 key, std::vector<u32> &&data);
+	void Spill(u64 key, const std::vector<u32> &data);
+	bool LoadSpilled(u64 key, std::vector<u32> &data, size_t pixels);
+	std::string SpillPath(u64 key) const;
+
+	std::mutex lock_;
+	std::unordered_map<u64, Entry> entries_;
+	// Most recently used first.
+	std::list<u64> lru_;
+	size_t bytes_ = 0;
+
+	std::string spillDir_;
+	std::unordered_map<u64, size_t> spilled_;
+	// Oldest first.
+	std::list<u64> spillOrder_;
+	size_t spilledBytes_ = 0;
+};
+
+static ScaledTextureCache scaledCache;
+
+bool ScaledTextureCache::Contains(u64 key) {
+	std::lock_guard<std::mutex> guard(lock_);
+	return entries_.find(key) != entries_.end() || spilled_.find(key) != spilled_.end();
+}
+
+bool ScaledTextureCache::Find(u64 key, u32 *out, size_t pixels) {
+	std::lock_guard<std::mutex> guard(lock_);
+	auto iter = entries_.find(key);
+	if (iter != entries_.end()) {
+		if (iter->second.data.size() != pixels)
+			return false;
+		memcpy(out, iter->second.data.data(), pixels * sizeof(u32));
+		lru_.splice(lru_.begin(), lru_, iter->second.lru);
+		return true;
+	}
+
+	std::vector<u32> data;
+	if (LoadSpilled(key, data, pixels)) {
+		memcpy(out, data.data(), pixels * sizeof(u32));
+		Insert(key, std::move(data));
+		return true;
+	}
+	return false;
+}
+
+void ScaledTextureCache::Store(u64 key, const u32 *data, size_t pixels) {
+	std::lock_guard<std::mutex> guard(lock_);
+	if (pixels * sizeof(u32) > MAX_RAM_BYTES / 4 || entries_.find(key) != entries_.end())
+		return;
+	Insert(key, std::vector<u32>(data, data + pixels));
+}
+
+void ScaledTextureCache::Insert(u64 key, std::vector<u32> &&data) {
+	bytes_ += data.size() * sizeof(u32);
+	lru_.push_front(key);
+	Entry &entry = entries_[key];
+	entry.data = std::move(data);
+	entry.lru = lru_.begin();
+
+	while (bytes_ > MAX_RAM_BYTES && !lru_.empty()) {
+		u64 oldest = lru_.back();
+		auto iter = entries_.find(oldest);
+		if (g_Config.bTexScalingDiskCache) {
+			Spill(oldest, iter->second.data);
+		}
+		bytes_ -= iter->second.data.size() * sizeof(u32);
+		entries_.erase(iter);
+		lru_.pop_back();
+	}
+}
+
+std::string ScaledTextureCache::SpillPath(u64 key) const {
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+	return spillDir_ + name;
+}
+
+void ScaledTextureCache::Spill(u64 key, const std::vector<u32> &data) {
+	if (spilled_.find(key) != spilled_.end())
+		return;
+
+	if (spillDir_.empty()) {
+		// Only for this session, so start from nothing.
+		spillDir_ = GetSysDirectory(DIRECTORY_APP_CACHE) + "/texscale/";
+		File::DeleteDirRecursively(spillDir_);
+		File::CreateFullPath(spillDir_);
+	}
+
+	const size_t size = data.size() * sizeof(u32);
+	FILE *f = File::OpenCFile(SpillPath(key), "wb");
+	if (!f)
+		return;
+	bool success = fwrite(data.data(), 1, size, f) == size;
+	fclose(f);
+	if (!success) {
+		File::Delete(SpillPath(key));
+		return;
+	}
+
+	spilled_[key] = size;
+	spillOrder_.push_back(key);
+	spilledBytes_ += size;
+	while (spilledBytes_ > MAX_DISK_BYTES && !spillOrder_.empty()) {
+		u64 oldest = spillOrder_.front();
+		spillOrder_.pop_front();
+		File::Delete(SpillPath(oldest));
+		spilledBytes_ -= spilled_[oldest];
+		spilled_.erase(oldest);
+	}
+}
+
+bool ScaledTextureCache::LoadSpilled(u64 key, std::vector<u32> &data, size_t pixels) {
+	auto iter = spilled_.find(key);
+	if (iter == spilled_.end() || iter->second != pixels * sizeof(u32))
+		return false;
+
+	FILE *f = File::OpenCFile(SpillPath(key), "rb");
+	if (!f)
+		return false;
+	data.resize(pixels);
+	bool success = fread(data.data(), 1, pixels * sizeof(u32), f) == pixels * sizeof(u32);
+	fclose(f);
+	return success;
+}
+
 /////////////////////////////////////// Texture Scaler
 
 TextureScalerCommon::TextureScalerCommon() {
@@ -506,7 +659,31 @@ bool TextureScalerCommon::IsEmptyOrFlat(u32* data, int pixels, int fmt) {
 	return true;
 }
 
-void TextureScalerCommon::ScaleAlways(u32 *out, u32 *src, u32 &dstFmt, int &width, int &height, int factor) {
+u64 TextureScalerCommon::ScaledCacheKey(u64 cacheKey, u32 dstFmt, int width, int height, int factor) {
+	// Everything the result depends on besides the source pixels.
+	const u32 params[8] = {
+		(u32)cacheKey, (u32)(cacheKey >> 32), dstFmt, Get8888Format(),
+		(u32)width | ((u32)height << 16), (u32)factor, (u32)g_Config.iTexScalingType, g_Config.bTexDeposterize ? 1U : 0U,
+	};
+	return XXH64(params, sizeof(params), 0);
+}
+
+bool TextureScalerCommon::IsScaleCached(u64 cacheKey, u32 dstFmt, int width, int height, int factor) {
+	return cacheKey != 0 && scaledCache.Contains(ScaledCacheKey(cacheKey, dstFmt, width, height, factor));
+}
+
+void TextureScalerCommon::ScaleAlways(u32 *out, u32 *src, u32 &dstFmt, int &width, int &height, int factor, u64 cacheKey) {
+	u64 key = 0;
+	if (cacheKey != 0) {
+		key = ScaledCacheKey(cacheKey, dstFmt, width, height, factor);
+		if (scaledCache.Find(key, out, (size_t)width * height * factor * factor)) {
+			dstFmt = Get8888Format();
+			width *= factor;
+			height *= factor;
+			return;
+		}
+	}
+
 	if (IsEmptyOrFlat(src, width*height, dstFmt)) {
 		// This means it was a flat texture.  Vulkan wants the size up front, so we need to make it happen.
 		u32 pixel;
@@ -532,6 +709,10 @@ void TextureScalerCommon::ScaleAlways(u32 *out, u32 *src, u32 &dstFmt, int &widt
 		}
 	} else {
 		ScaleInto(out, src, dstFmt, width, height, factor);
+		// Flat ones are quicker to redo than to keep around.
+		if (key != 0) {
+			scaledCache.Store(key, out, (size_t)width * height);
+		}
 	}
 }
 
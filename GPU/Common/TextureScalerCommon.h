@@ -27,13 +27,19 @@ class TextureScalerCommon {
 	TextureScalerCommon();
 	~TextureScalerCommon();
 
-	void ScaleAlways(u32 *out, u32 *src, u32 &dstFmt, int &width, int &height, int factor);
+	// If cacheKey is non-zero (normally from the texture's full hash and CLUT hash), recently scaled
+	// results are reused from the scaled texture cache instead of scaling again.
+	void ScaleAlways(u32 *out, u32 *src, u32 &dstFmt, int &width, int &height, int factor, u64 cacheKey = 0);
+	bool IsScaleCached(u64 cacheKey, u32 dstFmt, int width, int height, int factor);
 	bool Scale(u32 *&data, u32 &dstfmt, int &width, int &height, int factor);
 	bool ScaleInto(u32 *out, u32 *src, u32 &dstfmt, int &width, int &height, int factor);
 
 	enum { XBRZ = 0, HYBRID = 1, BICUBIC = 2, HYBRID_BICUBIC = 3 };
 
 protected:
+	// Converting a row is cheap, so each slice of ConvertTo8888 should do at least this many.
+	enum { MIN_CONVERT_ROWS = 16 };
+
 	virtual void ConvertTo8888(u32 format, u32 *source, u32 *&dest, int width, int height) = 0;
 	virtual int BytesPerPixel(u32 format) = 0;
 	virtual u32 Get8888Format() = 0;
@@ -47,6 +53,7 @@ class TextureScalerCommon {
 	void DePosterize(u32* source, u32* dest, int width, int height);
 
 	bool IsEmptyOrFlat(u32* data, int pixels, int fmt);
+	u64 ScaledCacheKey(u64 cacheKey, u32 dstFmt, int width, int height, int factor);
 
 	// depending on the factor and texture sizes, these can get pretty large 
 	// maximum is (100 MB total for a 512 by 512 texture with scaling factor 5 and hybrid scaling)
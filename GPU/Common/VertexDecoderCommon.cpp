@@ -30,6 +30,7 @@
 #include "Core/MIPS/JitCommon/JitCommon.h"
 #include "Core/Util/AudioFormat.h"  // for clamp_u8
 #include "GPU/Common/ShaderCommon.h"
+#include "GPU/GPU.h"
 #include "GPU/GPUState.h"
 #include "GPU/ge_constants.h"
 #include "GPU/Math3D.h"
@@ -163,7 +164,7 @@ void PrintDecodedVertex(VertexReader &vtx) {
 	printf("P: %f %f %f\n", pos[0], pos[1], pos[2]);
 }
 
-VertexDecoder::VertexDecoder() : decoded_(nullptr), ptr_(nullptr), jitted_(0), jittedSize_(0) {
+VertexDecoder::VertexDecoder() : decoded_(nullptr), ptr_(nullptr), jitted_(0), jittedSize_(0), jitFallback_(false) {
 }
 
 void VertexDecoder::ComputeSkinMatrix(const float weights[8]) const {
@@ -627,7 +628,7 @@ void VertexDecoder::Step_NormalS8MorphSkin() const {
 		const s8 *bv = (const s8*)(ptr_ + onesize_ * n + nrmoff);
 		const float multiplier = gstate_c.morphWeights[n] * (1.0f / 128.0f);
 		for (int j = 0; j < 3; j++)
-			normal[j] += bv[j] * multiplier;
+			nrm[j] += bv[j] * multiplier;
 	}
 	Norm3ByMatrix43(normal, nrm, skinMatrix);
 }
@@ -1150,6 +1151,8 @@ void VertexDecoder::SetVertexType(u32 fmt, const VertexDecoderOptions &options,
 	if (jitCache && g_Config.bVertexDecoderJit && g_Config.iCpuCore == (int)CPUCore::JIT) {
 		jitted_ = jitCache->Compile(*this, &jittedSize_);
 		if (!jitted_) {
+			jitFallback_ = true;
+			gpuStats.numJitFallbackDecoders++;
 			WARN_LOG(G3D, "Vertex decoder JIT failed! fmt = %08x (%s)", fmt_, GetString(SHADER_STRING_SHORT_DESC).c_str());
 		}
 	}
@@ -1175,6 +1178,10 @@ void VertexDecoder::DecodeVerts(u8 *decodedptr, const void *verts, int indexLowe
 		// We've compiled the steps into optimized machine code, so just jump!
 		jitted_(ptr_, decoded_, count);
 	} else {
+		if (jitFallback_)
+			gpuStats.numVertsDecodedByFallback += count;
+		if (weighttype)
+			gpuStats.numSkinnedVertsByFallback += count;
 		// Interpret the decode steps
 		for (; count; count--) {
 			for (int i = 0; i < numSteps_; i++) {
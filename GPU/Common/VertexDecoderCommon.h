@@ -489,6 +489,8 @@ class VertexDecoder {
 
 	JittedVertexDecoder jitted_;
 	int32_t jittedSize_;
+	// Set when the JIT was attempted but couldn't compile this format, so we count interpreted verts.
+	bool jitFallback_;
 
 	// "Immutable" state, set at startup
 
@@ -559,27 +561,33 @@ class VertexDecoderJitCache : public FakeGen::FakeXCodeBlock {
 
 	void Jit_TcU8ToFloat();
 	void Jit_TcU16ToFloat();
+	void Jit_TcU16DoubleToFloat();
 	void Jit_TcFloat();
 
 	void Jit_TcU8Prescale();
 	void Jit_TcU16Prescale();
+	void Jit_TcU16DoublePrescale();
 	void Jit_TcFloatPrescale();
 
 	void Jit_TcAnyMorph(int bits);
 	void Jit_TcU8MorphToFloat();
 	void Jit_TcU16MorphToFloat();
+	void Jit_TcU16DoubleMorphToFloat();
 	void Jit_TcFloatMorph();
 	void Jit_TcU8PrescaleMorph();
 	void Jit_TcU16PrescaleMorph();
+	void Jit_TcU16DoublePrescaleMorph();
 	void Jit_TcFloatPrescaleMorph();
 
 	void Jit_TcU16ThroughToFloat();
+	void Jit_TcU16ThroughDoubleToFloat();
 	void Jit_TcFloatThrough();
 
 	void Jit_Color8888();
 	void Jit_Color4444();
 	void Jit_Color565();
 	void Jit_Color5551();
+	void Jit_ColorInvalid();
 
 	void Jit_NormalS8();
 	void Jit_NormalS8ToFloat();
@@ -609,6 +617,14 @@ class VertexDecoderJitCache : public FakeGen::FakeXCodeBlock {
 	void Jit_PosS16Morph();
 	void Jit_PosFloatMorph();
 
+	void Jit_NormalS8MorphSkin();
+	void Jit_NormalS16MorphSkin();
+	void Jit_NormalFloatMorphSkin();
+
+	void Jit_PosS8MorphSkin();
+	void Jit_PosS16MorphSkin();
+	void Jit_PosFloatMorphSkin();
+
 	void Jit_Color8888Morph();
 	void Jit_Color4444Morph();
 	void Jit_Color565Morph();
@@ -618,6 +634,8 @@ class VertexDecoderJitCache : public FakeGen::FakeXCodeBlock {
 	bool CompileStep(const VertexDecoder &dec, int i);
 	void Jit_ApplyWeights();
 	void Jit_WriteMatrixMul(int outOff, bool pos);
+	void Jit_StoreSkinMatrix();
+	void Jit_WriteMorphSkin(int outOff, bool pos);
 	void Jit_WriteMorphColor(int outOff, bool checkAlpha = true);
 	void Jit_AnyS8ToFloat(int srcoff);
 	void Jit_AnyS16ToFloat(int srcoff);
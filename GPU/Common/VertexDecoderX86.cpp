@@ -29,6 +29,8 @@
 // We start out by converting the active matrices into 4x4 which are easier to multiply with
 // using SSE / NEON and store them here.
 alignas(16) static float bones[16 * 8];
+// The morph steps need XMM4-XMM7, so with morph and skinning the matrix gets parked here.
+alignas(16) static float morphSkinMatrix[16];
 
 using namespace Gen;
 
@@ -101,19 +103,24 @@ static const JitLookup jitLookup[] = {
 	{&VertexDecoder::Step_TcFloat, &VertexDecoderJitCache::Jit_TcFloat},
 	{&VertexDecoder::Step_TcU8ToFloat, &VertexDecoderJitCache::Jit_TcU8ToFloat},
 	{&VertexDecoder::Step_TcU16ToFloat, &VertexDecoderJitCache::Jit_TcU16ToFloat},
+	{&VertexDecoder::Step_TcU16DoubleToFloat, &VertexDecoderJitCache::Jit_TcU16DoubleToFloat},
 
 	{&VertexDecoder::Step_TcU8Prescale, &VertexDecoderJitCache::Jit_TcU8Prescale},
 	{&VertexDecoder::Step_TcU16Prescale, &VertexDecoderJitCache::Jit_TcU16Prescale},
+	{&VertexDecoder::Step_TcU16DoublePrescale, &VertexDecoderJitCache::Jit_TcU16DoublePrescale},
 	{&VertexDecoder::Step_TcFloatPrescale, &VertexDecoderJitCache::Jit_TcFloatPrescale},
 
 	{&VertexDecoder::Step_TcU16ThroughToFloat, &VertexDecoderJitCache::Jit_TcU16ThroughToFloat},
+	{&VertexDecoder::Step_TcU16ThroughDoubleToFloat, &VertexDecoderJitCache::Jit_TcU16ThroughDoubleToFloat},
 	{&VertexDecoder::Step_TcFloatThrough, &VertexDecoderJitCache::Jit_TcFloatThrough},
 
 	{&VertexDecoder::Step_TcU8MorphToFloat, &VertexDecoderJitCache::Jit_TcU8MorphToFloat},
 	{&VertexDecoder::Step_TcU16MorphToFloat, &VertexDecoderJitCache::Jit_TcU16MorphToFloat},
+	{&VertexDecoder::Step_TcU16DoubleMorphToFloat, &VertexDecoderJitCache::Jit_TcU16DoubleMorphToFloat},
 	{&VertexDecoder::Step_TcFloatMorph, &VertexDecoderJitCache::Jit_TcFloatMorph},
 	{&VertexDecoder::Step_TcU8PrescaleMorph, &VertexDecoderJitCache::Jit_TcU8PrescaleMorph},
 	{&VertexDecoder::Step_TcU16PrescaleMorph, &VertexDecoderJitCache::Jit_TcU16PrescaleMorph},
+	{&VertexDecoder::Step_TcU16DoublePrescaleMorph, &VertexDecoderJitCache::Jit_TcU16DoublePrescaleMorph},
 	{&VertexDecoder::Step_TcFloatPrescaleMorph, &VertexDecoderJitCache::Jit_TcFloatPrescaleMorph},
 
 	{&VertexDecoder::Step_NormalS8, &VertexDecoderJitCache::Jit_NormalS8},
@@ -129,6 +136,7 @@ static const JitLookup jitLookup[] = {
 	{&VertexDecoder::Step_Color4444, &VertexDecoderJitCache::Jit_Color4444},
 	{&VertexDecoder::Step_Color565, &VertexDecoderJitCache::Jit_Color565},
 	{&VertexDecoder::Step_Color5551, &VertexDecoderJitCache::Jit_Color5551},
+	{&VertexDecoder::Step_ColorInvalid, &VertexDecoderJitCache::Jit_ColorInvalid},
 
 	{&VertexDecoder::Step_PosS8Through, &VertexDecoderJitCache::Jit_PosS8Through},
 	{&VertexDecoder::Step_PosS16Through, &VertexDecoderJitCache::Jit_PosS16Through},
@@ -150,6 +158,14 @@ static const JitLookup jitLookup[] = {
 	{&VertexDecoder::Step_PosS16Morph, &VertexDecoderJitCache::Jit_PosS16Morph},
 	{&VertexDecoder::Step_PosFloatMorph, &VertexDecoderJitCache::Jit_PosFloatMorph},
 
+	{&VertexDecoder::Step_NormalS8MorphSkin, &VertexDecoderJitCache::Jit_NormalS8MorphSkin},
+	{&VertexDecoder::Step_NormalS16MorphSkin, &VertexDecoderJitCache::Jit_NormalS16MorphSkin},
+	{&VertexDecoder::Step_NormalFloatMorphSkin, &VertexDecoderJitCache::Jit_NormalFloatMorphSkin},
+
+	{&VertexDecoder::Step_PosS8MorphSkin, &VertexDecoderJitCache::Jit_PosS8MorphSkin},
+	{&VertexDecoder::Step_PosS16MorphSkin, &VertexDecoderJitCache::Jit_PosS16MorphSkin},
+	{&VertexDecoder::Step_PosFloatMorphSkin, &VertexDecoderJitCache::Jit_PosFloatMorphSkin},
+
 	{&VertexDecoder::Step_Color8888Morph, &VertexDecoderJitCache::Jit_Color8888Morph},
 	{&VertexDecoder::Step_Color4444Morph, &VertexDecoderJitCache::Jit_Color4444Morph},
 	{&VertexDecoder::Step_Color565Morph, &VertexDecoderJitCache::Jit_Color565Morph},
@@ -189,11 +205,13 @@ JittedVertexDecoder VertexDecoderJitCache::Compile(const VertexDecoder &dec, int
 	for (int i = 0; i < dec.numSteps_; i++) {
 		if (dec.steps_[i] == &VertexDecoder::Step_TcU8Prescale ||
 			dec.steps_[i] == &VertexDecoder::Step_TcU16Prescale ||
+			dec.steps_[i] == &VertexDecoder::Step_TcU16DoublePrescale ||
 			dec.steps_[i] == &VertexDecoder::Step_TcFloatPrescale) {
 			prescaleStep = true;
 		}
 		if (dec.steps_[i] == &VertexDecoder::Step_TcU8PrescaleMorph ||
 			dec.steps_[i] == &VertexDecoder::Step_TcU16PrescaleMorph ||
+			dec.steps_[i] == &VertexDecoder::Step_TcU16DoublePrescaleMorph ||
 			dec.steps_[i] == &VertexDecoder::Step_TcFloatPrescaleMorph) {
 			prescaleStep = true;
 		}
@@ -384,6 +402,7 @@ void VertexDecoderJitCache::Jit_WeightsU8Skin() {
 		}
 		ADD(PTRBITS, R(tempReg2), Imm8(4 * 16));
 	}
+	Jit_StoreSkinMatrix();
 }
 
 void VertexDecoderJitCache::Jit_WeightsU16Skin() {
@@ -498,6 +517,7 @@ void VertexDecoderJitCache::Jit_WeightsU16Skin() {
 		}
 		ADD(PTRBITS, R(tempReg2), Imm8(4 * 16));
 	}
+	Jit_StoreSkinMatrix();
 }
 
 void VertexDecoderJitCache::Jit_WeightsFloatSkin() {
@@ -530,6 +550,17 @@ void VertexDecoderJitCache::Jit_WeightsFloatSkin() {
 		}
 		ADD(PTRBITS, R(tempReg2), Imm8(4 * 16));
 	}
+	Jit_StoreSkinMatrix();
+}
+
+void VertexDecoderJitCache::Jit_StoreSkinMatrix() {
+	if (dec_->morphcount <= 1)
+		return;
+	MOV(PTRBITS, R(tempReg1), ImmPtr(&morphSkinMatrix));
+	MOVAPS(MDisp(tempReg1, 0), XMM4);
+	MOVAPS(MDisp(tempReg1, 16), XMM5);
+	MOVAPS(MDisp(tempReg1, 32), XMM6);
+	MOVAPS(MDisp(tempReg1, 48), XMM7);
 }
 
 void VertexDecoderJitCache::Jit_TcU8ToFloat() {
@@ -542,6 +573,13 @@ void VertexDecoderJitCache::Jit_TcU16ToFloat() {
 	MOVQ_xmm(MDisp(dstReg, dec_->decFmt.uvoff), XMM3);
 }
 
+void VertexDecoderJitCache::Jit_TcU16DoubleToFloat() {
+	Jit_AnyU16ToFloat(dec_->tcoff, 32);
+	// Doubling is exact, so this is the same as scaling by 1/16384.
+	ADDPS(XMM3, R(XMM3));
+	MOVQ_xmm(MDisp(dstReg, dec_->decFmt.uvoff), XMM3);
+}
+
 void VertexDecoderJitCache::Jit_TcFloat() {
 #ifdef _M_X64
 	MOV(64, R(tempReg1), MDisp(srcReg, dec_->tcoff));
@@ -580,6 +618,20 @@ void VertexDecoderJitCache::Jit_TcU16Prescale() {
 	MOVQ_xmm(MDisp(dstReg, dec_->decFmt.uvoff), fpScratchReg);
 }
 
+void VertexDecoderJitCache::Jit_TcU16DoublePrescale() {
+	PXOR(fpScratchReg2, R(fpScratchReg2));
+	MOVD_xmm(fpScratchReg, MDisp(srcReg, dec_->tcoff));
+	PUNPCKLWD(fpScratchReg, R(fpScratchReg2));
+	CVTDQ2PS(fpScratchReg, R(fpScratchReg));
+	// The scale only takes the u16 normalization into account.
+	ADDPS(fpScratchReg, R(fpScratchReg));
+	MULPS(fpScratchReg, R(fpScaleOffsetReg));
+	SHUFPS(fpScaleOffsetReg, R(fpScaleOffsetReg), _MM_SHUFFLE(1, 0, 3, 2));
+	ADDPS(fpScratchReg, R(fpScaleOffsetReg));
+	SHUFPS(fpScaleOffsetReg, R(fpScaleOffsetReg), _MM_SHUFFLE(1, 0, 3, 2));
+	MOVQ_xmm(MDisp(dstReg, dec_->decFmt.uvoff), fpScratchReg);
+}
+
 void VertexDecoderJitCache::Jit_TcFloatPrescale() {
 	MOVQ_xmm(fpScratchReg, MDisp(srcReg, dec_->tcoff));
 	MULPS(fpScratchReg, R(fpScaleOffsetReg));
@@ -664,6 +716,17 @@ void VertexDecoderJitCache::Jit_TcU16MorphToFloat() {
 	MOVQ_xmm(MDisp(dstReg, dec_->decFmt.uvoff), fpScratchReg);
 }
 
+void VertexDecoderJitCache::Jit_TcU16DoubleMorphToFloat() {
+	Jit_TcAnyMorph(16);
+	if (RipAccessible(&by16384)) {
+		MULPS(fpScratchReg, M(&by16384));  // rip accessible
+	} else {
+		MOV(PTRBITS, R(tempReg1), ImmPtr(&by16384));
+		MULPS(fpScratchReg, MatR(tempReg1));
+	}
+	MOVQ_xmm(MDisp(dstReg, dec_->decFmt.uvoff), fpScratchReg);
+}
+
 void VertexDecoderJitCache::Jit_TcFloatMorph() {
 	Jit_TcAnyMorph(32);
 	MOVQ_xmm(MDisp(dstReg, dec_->decFmt.uvoff), fpScratchReg);
@@ -689,6 +752,17 @@ void VertexDecoderJitCache::Jit_TcU16PrescaleMorph() {
 	MOVQ_xmm(MDisp(dstReg, dec_->decFmt.uvoff), fpScratchReg);
 }
 
+void VertexDecoderJitCache::Jit_TcU16DoublePrescaleMorph() {
+	Jit_TcAnyMorph(16);
+	// The scale only takes the u16 normalization into account.
+	ADDPS(fpScratchReg, R(fpScratchReg));
+	MULPS(fpScratchReg, R(fpScaleOffsetReg));
+	SHUFPS(fpScaleOffsetReg, R(fpScaleOffsetReg), _MM_SHUFFLE(1, 0, 3, 2));
+	ADDPS(fpScratchReg, R(fpScaleOffsetReg));
+	SHUFPS(fpScaleOffsetReg, R(fpScaleOffsetReg), _MM_SHUFFLE(1, 0, 3, 2));
+	MOVQ_xmm(MDisp(dstReg, dec_->decFmt.uvoff), fpScratchReg);
+}
+
 void VertexDecoderJitCache::Jit_TcFloatPrescaleMorph() {
 	Jit_TcAnyMorph(32);
 	MULPS(fpScratchReg, R(fpScaleOffsetReg));
@@ -723,6 +797,16 @@ void VertexDecoderJitCache::Jit_TcU16ThroughToFloat() {
 	updateSide(tempReg2, CC_LE, offsetof(KnownVertexBounds, maxV));
 }
 
+// Unlike the regular through mode step, this one doesn't track the bounds.
+void VertexDecoderJitCache::Jit_TcU16ThroughDoubleToFloat() {
+	PXOR(fpScratchReg2, R(fpScratchReg2));
+	MOVD_xmm(fpScratchReg, MDisp(srcReg, dec_->tcoff));
+	PUNPCKLWD(fpScratchReg, R(fpScratchReg2));
+	CVTDQ2PS(fpScratchReg, R(fpScratchReg));
+	ADDPS(fpScratchReg, R(fpScratchReg));
+	MOVQ_xmm(MDisp(dstReg, dec_->decFmt.uvoff), fpScratchReg);
+}
+
 void VertexDecoderJitCache::Jit_TcFloatThrough() {
 #ifdef _M_X64
 	MOV(64, R(tempReg1), MDisp(srcReg, dec_->tcoff));
@@ -867,6 +951,10 @@ void VertexDecoderJitCache::Jit_Color5551() {
 	SetJumpTarget(skip);
 }
 
+void VertexDecoderJitCache::Jit_ColorInvalid() {
+	// Nothing to write, same as the interpreter.
+}
+
 void VertexDecoderJitCache::Jit_Color8888Morph() {
 	MOV(PTRBITS, R(tempReg1), ImmPtr(&gstate_c.morphWeights[0]));
 	if (!cpu_info.bSSE4_1) {
@@ -1348,8 +1436,9 @@ void VertexDecoderJitCache::Jit_AnyS8Morph(int srcoff, int dstoff) {
 	if (RipAccessible(&by128)) {
 		MOVAPS(XMM5, M(&by128));  // rip accessible
 	} else {
-		MOV(PTRBITS, R(tempReg1), ImmPtr(&by128));
-		MOVAPS(XMM5, MatR(tempReg1));
+		// tempReg1 holds the morph weights.
+		MOV(PTRBITS, R(tempReg2), ImmPtr(&by128));
+		MOVAPS(XMM5, MatR(tempReg2));
 	}
 
 	// Sum into fpScratchReg.
@@ -1392,8 +1481,9 @@ void VertexDecoderJitCache::Jit_AnyS16Morph(int srcoff, int dstoff) {
 	if (RipAccessible(&by32768)) {
 		MOVAPS(XMM5, M(&by32768));  // rip accessible
 	} else {
-		MOV(PTRBITS, R(tempReg1), ImmPtr(&by32768));
-		MOVAPS(XMM5, MatR(tempReg1));
+		// tempReg1 holds the morph weights.
+		MOV(PTRBITS, R(tempReg2), ImmPtr(&by32768));
+		MOVAPS(XMM5, MatR(tempReg2));
 	}
 
 	// Sum into fpScratchReg.
@@ -1472,6 +1562,47 @@ void VertexDecoderJitCache::Jit_NormalFloatMorph() {
 	Jit_AnyFloatMorph(dec_->nrmoff, dec_->decFmt.nrmoff);
 }
 
+// The morph steps used XMM4-XMM7 as scratch, so get the skin matrix back first.
+void VertexDecoderJitCache::Jit_WriteMorphSkin(int outOff, bool pos) {
+	MOVUPS(XMM3, MDisp(dstReg, outOff));
+	MOV(PTRBITS, R(tempReg1), ImmPtr(&morphSkinMatrix));
+	MOVAPS(XMM4, MDisp(tempReg1, 0));
+	MOVAPS(XMM5, MDisp(tempReg1, 16));
+	MOVAPS(XMM6, MDisp(tempReg1, 32));
+	MOVAPS(XMM7, MDisp(tempReg1, 48));
+	Jit_WriteMatrixMul(outOff, pos);
+}
+
+void VertexDecoderJitCache::Jit_NormalS8MorphSkin() {
+	Jit_AnyS8Morph(dec_->nrmoff, dec_->decFmt.nrmoff);
+	Jit_WriteMorphSkin(dec_->decFmt.nrmoff, false);
+}
+
+void VertexDecoderJitCache::Jit_NormalS16MorphSkin() {
+	Jit_AnyS16Morph(dec_->nrmoff, dec_->decFmt.nrmoff);
+	Jit_WriteMorphSkin(dec_->decFmt.nrmoff, false);
+}
+
+void VertexDecoderJitCache::Jit_NormalFloatMorphSkin() {
+	Jit_AnyFloatMorph(dec_->nrmoff, dec_->decFmt.nrmoff);
+	Jit_WriteMorphSkin(dec_->decFmt.nrmoff, false);
+}
+
+void VertexDecoderJitCache::Jit_PosS8MorphSkin() {
+	Jit_AnyS8Morph(dec_->posoff, dec_->decFmt.posoff);
+	Jit_WriteMorphSkin(dec_->decFmt.posoff, true);
+}
+
+void VertexDecoderJitCache::Jit_PosS16MorphSkin() {
+	Jit_AnyS16Morph(dec_->posoff, dec_->decFmt.posoff);
+	Jit_WriteMorphSkin(dec_->decFmt.posoff, true);
+}
+
+void VertexDecoderJitCache::Jit_PosFloatMorphSkin() {
+	Jit_AnyFloatMorph(dec_->posoff, dec_->decFmt.posoff);
+	Jit_WriteMorphSkin(dec_->decFmt.posoff, true);
+}
+
 bool VertexDecoderJitCache::CompileStep(const VertexDecoder &dec, int step) {
 	// See if we find a matching JIT function
 	for (size_t i = 0; i < ARRAY_SIZE(jitLookup); i++) {
@@ -51,7 +51,7 @@ ID3D11VertexShader *CreateVertexShaderD3D11(ID3D11Device *device, const char *co
 	return vs;
 }
 
-ID3D11PixelShader *CreatePixelShaderD3D11(ID3D11Device *device, const char *code, size_t codeSize, D3D_FEATURE_LEVEL featureLevel, UINT flags) {
+ID3D11PixelShader *CreatePixelShaderD3D11(ID3D11Device *device, const char *code, size_t codeSize, D3D_FEATURE_LEVEL featureLevel, UINT flags, std::vector<uint8_t> *byteCodeOut) {
 	const char *profile = featureLevel <= D3D_FEATURE_LEVEL_9_3 ? "ps_4_0_level_9_1" : "ps_4_0";
 	std::vector<uint8_t> byteCode = CompileShaderToBytecode(code, codeSize, profile, flags);
 	if (byteCode.empty())
@@ -59,6 +59,8 @@ ID3D11PixelShader *CreatePixelShaderD3D11(ID3D11Device *device, const char *code
 
 	ID3D11PixelShader *ps;
 	device->CreatePixelShader(byteCode.data(), byteCode.size(), nullptr, &ps);
+	if (byteCodeOut)
+		*byteCodeOut = byteCode;
 	return ps;
 }
 
@@ -60,6 +60,8 @@ enum { VAI_KILL_AGE = 120, VAI_UNRELIABLE_KILL_AGE = 240, VAI_UNRELIABLE_KILL_MA
 enum {
 	VERTEX_PUSH_SIZE = 1024 * 1024 * 16,
 	INDEX_PUSH_SIZE = 1024 * 1024 * 4,
+	VERTEX_CACHE_CHUNK_SIZE = 1024 * 1024 * 4,
+	INDEX_CACHE_CHUNK_SIZE = 1024 * 1024 * 1,
 };
 
 static const D3D11_INPUT_ELEMENT_DESC TransformedVertexElements[] = {
@@ -117,11 +119,76 @@ void DrawEngineD3D11::InitDeviceObjects() {
 
 void DrawEngineD3D11::ClearTrackedVertexArrays() {
 	vai_.Iterate([&](uint32_t hash, VertexArrayInfoD3D11 *vai){
+		FreeVertexArray(vai);
 		delete vai;
 	});
 	vai_.Clear();
 }
 
+ID3D11Buffer *DrawEngineD3D11::AllocCachedBuffer(std::vector<CachedBufferChunk> &chunks, D3D11_BIND_FLAG bind, const void *data, u32 size, u32 *offset) {
+	CachedBufferChunk *chunk = nullptr;
+	for (auto &c : chunks) {
+		if (c.alloc.Alloc(size, 16, offset)) {
+			chunk = &c;
+			break;
+		}
+	}
+	if (!chunk) {
+		u32 chunkSize = bind == D3D11_BIND_VERTEX_BUFFER ? VERTEX_CACHE_CHUNK_SIZE : INDEX_CACHE_CHUNK_SIZE;
+		// Oversized arrays get a chunk of their own.
+		chunkSize = std::max(chunkSize, (size + 15) & ~15);
+		D3D11_BUFFER_DESC desc{ chunkSize, D3D11_USAGE_DEFAULT, (UINT)bind, 0 };
+		ID3D11Buffer *buffer = nullptr;
+		if (FAILED(device_->CreateBuffer(&desc, nullptr, &buffer)))
+			return nullptr;
+		chunks.push_back(CachedBufferChunk{ buffer, BufferSubAllocator(chunkSize) });
+		chunk = &chunks.back();
+		chunk->alloc.Alloc(size, 16, offset);
+	}
+	D3D11_BOX box{ *offset, 0, 0, *offset + size, 1, 1 };
+	context_->UpdateSubresource(chunk->buffer, 0, &box, data, 0, 0);
+	return chunk->buffer;
+}
+
+void DrawEngineD3D11::FreeCachedBuffer(std::vector<CachedBufferChunk> &chunks, ID3D11Buffer *buffer, u32 offset, u32 size) {
+	for (auto &c : chunks) {
+		if (c.buffer == buffer) {
+			c.alloc.Free(offset, size);
+			return;
+		}
+	}
+}
+
+void DrawEngineD3D11::DecimateCachedBuffers(std::vector<CachedBufferChunk> &chunks) {
+	// Keep the first chunk around even if empty, it'll be needed again soon.
+	for (size_t i = 1; i < chunks.size(); ) {
+		if (chunks[i].alloc.IsEmpty()) {
+			chunks[i].buffer->Release();
+			chunks.erase(chunks.begin() + i);
+		} else {
+			++i;
+		}
+	}
+}
+
+void DrawEngineD3D11::DestroyCachedBuffers(std::vector<CachedBufferChunk> &chunks) {
+	for (auto &c : chunks) {
+		c.buffer->Release();
+	}
+	chunks.clear();
+}
+
+void DrawEngineD3D11::FreeVertexArray(VertexArrayInfoD3D11 *vai) {
+	if (vai->vbo) {
+		FreeCachedBuffer(cachedVerts_, vai->vbo, vai->vboOffset, vai->vboSize);
+		vai->vbo = nullptr;
+	}
+	if (vai->ebo) {
+		FreeCachedBuffer(cachedInds_, vai->ebo, vai->eboOffset, vai->eboSize);
+		vai->ebo = nullptr;
+	}
+}
+
 void DrawEngineD3D11::ClearInputLayoutMap() {
 	inputLayoutMap_.Iterate([&](const InputLayoutKey &key, ID3D11InputLayout *il) {
 		if (il)
@@ -137,6 +204,8 @@ void DrawEngineD3D11::Resized() {
 
 void DrawEngineD3D11::DestroyDeviceObjects() {
 	ClearTrackedVertexArrays();
+	DestroyCachedBuffers(cachedVerts_);
+	DestroyCachedBuffers(cachedInds_);
 	ClearInputLayoutMap();
 	delete tessDataTransfer;
 	delete pushVerts_;
@@ -247,14 +316,7 @@ ID3D11InputLayout *DrawEngineD3D11::SetupDecFmtForDraw(D3D11VertexShader *vshade
 
 void DrawEngineD3D11::MarkUnreliable(VertexArrayInfoD3D11 *vai) {
 	vai->status = VertexArrayInfoD3D11::VAI_UNRELIABLE;
-	if (vai->vbo) {
-		vai->vbo->Release();
-		vai->vbo = nullptr;
-	}
-	if (vai->ebo) {
-		vai->ebo->Release();
-		vai->ebo = nullptr;
-	}
+	FreeVertexArray(vai);
 }
 
 void DrawEngineD3D11::BeginFrame() {
@@ -279,11 +341,14 @@ void DrawEngineD3D11::BeginFrame() {
 			kill = vai->lastFrame < threshold;
 		}
 		if (kill) {
+			FreeVertexArray(vai);
 			delete vai;
 			vai_.Remove(hash);
 		}
 	});
 	vai_.Maintain();
+	DecimateCachedBuffers(cachedVerts_);
+	DecimateCachedBuffers(cachedInds_);
 
 	// Enable if you want to see vertex decoders in the log output. Need a better way.
 #if 0
@@ -297,13 +362,6 @@ void DrawEngineD3D11::BeginFrame() {
 #endif
 }
 
-VertexArrayInfoD3D11::~VertexArrayInfoD3D11() {
-	if (vbo)
-		vbo->Release();
-	if (ebo)
-		ebo->Release();
-}
-
 static uint32_t SwapRB(uint32_t c) {
 	return (c & 0xFF00FF00) | ((c >> 16) & 0xFF) | ((c << 16) & 0xFF0000);
 }
@@ -316,6 +374,15 @@ void DrawEngineD3D11::DoFlush() {
 	// This is not done on every drawcall, we should collect vertex data
 	// until critical state changes. That's when we draw (flush).
 
+	// With deferred submission, a readback may have closed the command list since the last flush.
+	uint32_t serial = (uint32_t)draw_->GetNativeObject(Draw::NativeObject::COMMAND_LIST_SERIAL);
+	if (serial != lastCommandListSerial_) {
+		pushVerts_->ForceDiscard();
+		pushInds_->ForceDiscard();
+		shaderManager_->RestartUniformRing();
+		lastCommandListSerial_ = serial;
+	}
+
 	GEPrimitiveType prim = prevPrim_;
 	ApplyDrawState(prim);
 
@@ -324,6 +391,8 @@ void DrawEngineD3D11::DoFlush() {
 	if (useHWTransform) {
 		ID3D11Buffer *vb_ = nullptr;
 		ID3D11Buffer *ib_ = nullptr;
+		UINT vbOffset = 0;
+		UINT ibOffset = 0;
 
 		int vertexCount = 0;
 		int maxIndex = 0;
@@ -348,11 +417,7 @@ void DrawEngineD3D11::DoFlush() {
 			case VertexArrayInfoD3D11::VAI_NEW:
 				{
 					// Haven't seen this one before.
-					ReliableHashType dataHash = ComputeHash();
-					vai->hash = dataHash;
-					vai->minihash = ComputeMiniHash();
-					vai->status = VertexArrayInfoD3D11::VAI_HASHING;
-					vai->drawsUntilNextFullHash = 0;
+					SetupNewVertexArray(vai);
 					DecodeVerts(decoded); // writes to indexGen
 					vai->numVerts = indexGen.VertexCount();
 					vai->prim = indexGen.Prim();
@@ -365,41 +430,10 @@ void DrawEngineD3D11::DoFlush() {
 				// But if we get this far it's likely to be worth creating a vertex buffer.
 			case VertexArrayInfoD3D11::VAI_HASHING:
 				{
-					vai->numDraws++;
-					if (vai->lastFrame != gpuStats.numFlips) {
-						vai->numFrames++;
-					}
-					if (vai->drawsUntilNextFullHash == 0) {
-						// Let's try to skip a full hash if mini would fail.
-						const u32 newMiniHash = ComputeMiniHash();
-						ReliableHashType newHash = vai->hash;
-						if (newMiniHash == vai->minihash) {
-							newHash = ComputeHash();
-						}
-						if (newMiniHash != vai->minihash || newHash != vai->hash) {
-							MarkUnreliable(vai);
-							DecodeVerts(decoded);
-							goto rotateVBO;
-						}
-						if (vai->numVerts > 64) {
-							// exponential backoff up to 16 draws, then every 24
-							vai->drawsUntilNextFullHash = std::min(24, vai->numFrames);
-						} else {
-							// Lower numbers seem much more likely to change.
-							vai->drawsUntilNextFullHash = 0;
-						}
-						// TODO: tweak
-						//if (vai->numFrames > 1000) {
-						//	vai->status = VertexArrayInfo::VAI_RELIABLE;
-						//}
-					} else {
-						vai->drawsUntilNextFullHash--;
-						u32 newMiniHash = ComputeMiniHash();
-						if (newMiniHash != vai->minihash) {
-							MarkUnreliable(vai);
-							DecodeVerts(decoded);
-							goto rotateVBO;
-						}
+					if (!CheckVertexArray(vai, 24)) {
+						MarkUnreliable(vai);
+						DecodeVerts(decoded);
+						goto rotateVBO;
 					}
 
 					if (vai->vbo == 0) {
@@ -415,16 +449,19 @@ void DrawEngineD3D11::DoFlush() {
 
 						_dbg_assert_msg_(G3D, gstate_c.vertBounds.minV >= gstate_c.vertBounds.maxV, "Should not have checked UVs when caching.");
 
-						// TODO: Combine these two into one buffer?
-						u32 size = dec_->GetDecVtxFmt().stride * indexGen.MaxIndex();
-						D3D11_BUFFER_DESC desc{ size, D3D11_USAGE_IMMUTABLE, D3D11_BIND_VERTEX_BUFFER, 0 };
-						D3D11_SUBRESOURCE_DATA data{ decoded };
-						ASSERT_SUCCESS(device_->CreateBuffer(&desc, &data, &vai->vbo));
-						if (useElements) {
+						u32 size = dec_->GetDecVtxFmt().stride * (indexGen.MaxIndex() + 1);
+						vai->vbo = AllocCachedBuffer(cachedVerts_, D3D11_BIND_VERTEX_BUFFER, decoded, size, &vai->vboOffset);
+						vai->vboSize = size;
+						gpuStats.numVertexCacheUploadBytes += size;
+						if (useElements && vai->vbo) {
 							u32 size = sizeof(short) * indexGen.VertexCount();
-							D3D11_BUFFER_DESC desc{ size, D3D11_USAGE_IMMUTABLE, D3D11_BIND_INDEX_BUFFER, 0 };
-							D3D11_SUBRESOURCE_DATA data{ decIndex };
-							ASSERT_SUCCESS(device_->CreateBuffer(&desc, &data, &vai->ebo));
+							vai->ebo = AllocCachedBuffer(cachedInds_, D3D11_BIND_INDEX_BUFFER, decIndex, size, &vai->eboOffset);
+							vai->eboSize = size;
+							gpuStats.numVertexCacheUploadBytes += size;
+							if (!vai->ebo) {
+								// Out of memory, just push this one.
+								FreeVertexArray(vai);
+							}
 						} else {
 							vai->ebo = 0;
 						}
@@ -436,6 +473,8 @@ void DrawEngineD3D11::DoFlush() {
 					}
 					vb_ = vai->vbo;
 					ib_ = vai->ebo;
+					vbOffset = vai->vboOffset;
+					ibOffset = vai->eboOffset;
 					vertexCount = vai->numVerts;
 					maxIndex = vai->maxIndex;
 					prim = static_cast<GEPrimitiveType>(vai->prim);
@@ -453,6 +492,8 @@ void DrawEngineD3D11::DoFlush() {
 					gpuStats.numCachedVertsDrawn += vai->numVerts;
 					vb_ = vai->vbo;
 					ib_ = vai->ebo;
+					vbOffset = vai->vboOffset;
+					ibOffset = vai->eboOffset;
 
 					vertexCount = vai->numVerts;
 
@@ -469,6 +510,7 @@ void DrawEngineD3D11::DoFlush() {
 					if (vai->lastFrame != gpuStats.numFlips) {
 						vai->numFrames++;
 					}
+					gpuStats.numVertexCacheMisses++;
 					DecodeVerts(decoded);
 					goto rotateVBO;
 				}
@@ -534,10 +576,9 @@ void DrawEngineD3D11::DoFlush() {
 				context_->Draw(vertexCount, 0);
 			}
 		} else {
-			UINT offset = 0;
-			context_->IASetVertexBuffers(0, 1, &vb_, &stride, &offset);
+			context_->IASetVertexBuffers(0, 1, &vb_, &stride, &vbOffset);
 			if (useElements) {
-				context_->IASetIndexBuffer(ib_, DXGI_FORMAT_R16_UINT, 0);
+				context_->IASetIndexBuffer(ib_, DXGI_FORMAT_R16_UINT, ibOffset);
 				if (gstate_c.bezier || gstate_c.spline)
 					context_->DrawIndexedInstanced(vertexCount, numPatches, 0, 0, 0);
 				else
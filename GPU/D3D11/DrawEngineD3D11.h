@@ -56,47 +56,20 @@ enum {
 };
 
 // Try to keep this POD.
-class VertexArrayInfoD3D11 {
+class VertexArrayInfoD3D11 : public VertexArrayInfoCommon {
 public:
 	VertexArrayInfoD3D11() {
-		status = VAI_NEW;
 		vbo = 0;
 		ebo = 0;
-		prim = GE_PRIM_INVALID;
-		numDraws = 0;
-		numFrames = 0;
-		lastFrame = gpuStats.numFlips;
-		numVerts = 0;
-		drawsUntilNextFullHash = 0;
-		flags = 0;
 	}
-	~VertexArrayInfoD3D11();
-
-	enum Status : uint8_t {
-		VAI_NEW,
-		VAI_HASHING,
-		VAI_RELIABLE,  // cache, don't hash
-		VAI_UNRELIABLE,  // never cache
-	};
-
-	ReliableHashType hash;
-	u32 minihash;
 
+	// Not owned, these point into the draw engine's cached buffer chunks.
 	ID3D11Buffer *vbo;
 	ID3D11Buffer *ebo;
-
-	// Precalculated parameter for drawRangeElements
-	u16 numVerts;
-	u16 maxIndex;
-	s8 prim;
-	Status status;
-
-	// ID information
-	int numDraws;
-	int numFrames;
-	int lastFrame;  // So that we can forget.
-	u16 drawsUntilNextFullHash;
-	u8 flags;
+	u32 vboOffset = 0;
+	u32 vboSize = 0;
+	u32 eboOffset = 0;
+	u32 eboSize = 0;
 };
 
 // Handles transform, lighting and drawing.
@@ -150,6 +123,17 @@ class DrawEngineD3D11 : public DrawEngineCommon {
 	ID3D11InputLayout *SetupDecFmtForDraw(D3D11VertexShader *vshader, const DecVtxFormat &decFmt, u32 pspFmt);
 
 	void MarkUnreliable(VertexArrayInfoD3D11 *vai);
+	void FreeVertexArray(VertexArrayInfoD3D11 *vai);
+
+	// Cached vertex arrays are sub-allocated from a few big buffers rather than one buffer each.
+	struct CachedBufferChunk {
+		ID3D11Buffer *buffer;
+		BufferSubAllocator alloc;
+	};
+	ID3D11Buffer *AllocCachedBuffer(std::vector<CachedBufferChunk> &chunks, D3D11_BIND_FLAG bind, const void *data, u32 size, u32 *offset);
+	void FreeCachedBuffer(std::vector<CachedBufferChunk> &chunks, ID3D11Buffer *buffer, u32 offset, u32 size);
+	void DecimateCachedBuffers(std::vector<CachedBufferChunk> &chunks);
+	void DestroyCachedBuffers(std::vector<CachedBufferChunk> &chunks);
 
 	Draw::DrawContext *draw_;  // Used for framebuffer related things exclusively.
 	ID3D11Device *device_;
@@ -158,6 +142,8 @@ class DrawEngineD3D11 : public DrawEngineCommon {
 	ID3D11DeviceContext1 *context1_;
 
 	PrehashMap<VertexArrayInfoD3D11 *, nullptr> vai_;
+	std::vector<CachedBufferChunk> cachedVerts_;
+	std::vector<CachedBufferChunk> cachedInds_;
 
 	struct InputLayoutKey {
 		D3D11VertexShader *vshader;
@@ -181,6 +167,8 @@ class DrawEngineD3D11 : public DrawEngineCommon {
 	// Pushbuffers
 	PushBufferD3D11 *pushVerts_;
 	PushBufferD3D11 *pushInds_;
+	// Draw context submission serial the pushbuffers were last mapped in, see COMMAND_LIST_SERIAL.
+	uint32_t lastCommandListSerial_ = 0;
 
 	// D3D11 state object caches.
 	DenseHashMap<uint64_t, ID3D11BlendState *, nullptr> blendCache_;
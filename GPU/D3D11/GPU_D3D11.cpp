@@ -37,6 +37,7 @@
 #include <set>
 
 #include "Common/ChunkFile.h"
+#include "Common/FileUtil.h"
 #include "Common/GraphicsContext.h"
 #include "base/NativeApp.h"
 #include "base/logging.h"
@@ -47,6 +48,7 @@
 #include "Core/MIPS/MIPS.h"
 #include "Core/Host.h"
 #include "Core/Config.h"
+#include "Core/ELF/ParamSFO.h"
 #include "Core/Reporting.h"
 #include "Core/System.h"
 
@@ -77,7 +79,8 @@ GPU_D3D11::GPU_D3D11(GraphicsContext *gfxCtx, Draw::DrawContext *draw)
 
 	stockD3D11.Create(device_);
 
-	shaderManagerD3D11_ = new ShaderManagerD3D11(device_, context_, featureLevel);
+	ID3D11DeviceContext1 *context1 = (ID3D11DeviceContext1 *)draw->GetNativeObject(Draw::NativeObject::CONTEXT_EX);
+	shaderManagerD3D11_ = new ShaderManagerD3D11(device_, context_, context1, featureLevel);
 	framebufferManagerD3D11_ = new FramebufferManagerD3D11(draw);
 	framebufferManager_ = framebufferManagerD3D11_;
 	textureCacheD3D11_ = new TextureCacheD3D11(draw);
@@ -110,9 +113,20 @@ GPU_D3D11::GPU_D3D11(GraphicsContext *gfxCtx, Draw::DrawContext *draw)
 	// Some of our defaults are different from hw defaults, let's assert them.
 	// We restore each frame anyway, but here is convenient for tests.
 	textureCache_->NotifyConfigChanged();
+
+	// Load shader cache. Has to be after CheckGPUFeatures(), the feature flags are part of the key.
+	std::string discID = g_paramSFO.GetDiscID();
+	if (discID.size()) {
+		File::CreateFullPath(GetSysDirectory(DIRECTORY_APP_CACHE));
+		shaderCachePath_ = GetSysDirectory(DIRECTORY_APP_CACHE) + "/" + discID + ".d3d11shadercache";
+		shaderManagerD3D11_->LoadCache(shaderCachePath_);
+	}
 }
 
 GPU_D3D11::~GPU_D3D11() {
+	if (!shaderCachePath_.empty()) {
+		shaderManagerD3D11_->SaveCache(shaderCachePath_);
+	}
 	delete depalShaderCache_;
 	framebufferManagerD3D11_->DestroyAllFBOs();
 	delete framebufferManagerD3D11_;
@@ -245,6 +259,11 @@ void GPU_D3D11::BeginFrame() {
 
 	shaderManagerD3D11_->DirtyLastShader();
 
+	// Save the cache from time to time, in case we don't get to exit cleanly.
+	if (!shaderCachePath_.empty() && (gpuStats.numFlips & 4095) == 0) {
+		shaderManagerD3D11_->SaveCache(shaderCachePath_);
+	}
+
 	framebufferManagerD3D11_->BeginFrame();
 	gstate_c.Dirty(DIRTY_PROJTHROUGHMATRIX);
 }
@@ -282,7 +301,11 @@ inline void GPU_D3D11::CheckFlushOp(int cmd, u32 diff) {
 		if (dumpThisFrame_) {
 			NOTICE_LOG(G3D, "================ FLUSH ================");
 		}
-		drawEngine_.Flush();
+		if (cmdFlags & FLAG_FLUSHBEFORE) {
+			drawEngine_.Flush();
+		} else {
+			FlushBeforeStateChange(cmd);
+		}
 	}
 }
 
@@ -314,9 +337,16 @@ void GPU_D3D11::GetStats(char *buffer, size_t bufsize) {
 		"Commands per call level: %i %i %i %i\n"
 		"Vertices submitted: %i\n"
 		"Cached, Uncached Vertices Drawn: %i, %i\n"
-		"FBOs active: %i\n"
-		"Textures active: %i, decoded: %i  invalidated: %i\n"
-		"Readbacks: %d, uploads: %d\n"
+		"Vertex cache hits: %i, misses: %i, uploaded: %i KB\n"
+		"Vertex decoder JIT fallbacks: %i formats, %i verts\n"
+		"Skinned draws: %i, verts: %i (%i by fallback)\n"
+		"Flushes for state: %i, prim: %i, full: %i, merged state changes: %i\n"
+		"Bounding box tests: %i, culled: %i\n"
+		"FBOs active: %i, created: %i, reused from pool: %i\n"
+		"Textures active: %i, decoded: %i  invalidated: %i  unwritten: %i  sampled: %i\n"
+		"Texture memory: %0.1f MB, budget: %i MB\n"
+		"Readbacks: %d (%d async, %0.2f ms stalled), uploads: %d\n"
+		"Block transfers: %d GPU, %d CPU (%d downloads, %d uploads)\n"
 		"Vertex, Fragment shaders loaded: %i, %i\n",
 		gpuStats.msProcessingDisplayLists * 1000.0f,
 		gpuStats.numDrawCalls,
@@ -330,12 +360,38 @@ void GPU_D3D11::GetStats(char *buffer, size_t bufsize) {
 		gpuStats.numVertsSubmitted,
 		gpuStats.numCachedVertsDrawn,
 		gpuStats.numUncachedVertsDrawn,
+		gpuStats.numCachedDrawCalls,
+		gpuStats.numVertexCacheMisses,
+		gpuStats.numVertexCacheUploadBytes / 1024,
+		gpuStats.numJitFallbackDecoders,
+		gpuStats.numVertsDecodedByFallback,
+		gpuStats.numSkinnedDrawCalls,
+		gpuStats.numSkinnedVerts,
+		gpuStats.numSkinnedVertsByFallback,
+		gpuStats.numStateFlushes,
+		gpuStats.numPrimFlushes,
+		gpuStats.numFullFlushes,
+		gpuStats.numMergedStateChanges,
+		gpuStats.numBBoxTests,
+		gpuStats.numBBoxCulled,
 		(int)framebufferManagerD3D11_->NumVFBs(),
+		gpuStats.numFBOsCreated,
+		gpuStats.numPooledFBOsReused,
 		(int)textureCacheD3D11_->NumLoadedTextures(),
 		gpuStats.numTexturesDecoded,
 		gpuStats.numTextureInvalidations,
+		gpuStats.numTextureHashesSkipped,
+		gpuStats.numTextureHashesSampled,
+		textureCacheD3D11_->MemoryUsage() / (1024.0f * 1024.0f),
+		(int)(textureCacheD3D11_->MemoryBudget() / (1024 * 1024)),
 		gpuStats.numReadbacks,
+		gpuStats.numAsyncReadbacks,
+		gpuStats.msReadbackStall,
 		gpuStats.numUploads,
+		gpuStats.numBlockTransfersGPU,
+		gpuStats.numBlockTransfersCPU,
+		gpuStats.numBlockTransferDownloads,
+		gpuStats.numBlockTransferUploads,
 		shaderManagerD3D11_->GetNumVertexShaders(),
 		shaderManagerD3D11_->GetNumFragmentShaders()
 	);
@@ -355,7 +411,7 @@ void GPU_D3D11::DoState(PointerWrap &p) {
 
 	// TODO: Some of these things may not be necessary.
 	// None of these are necessary when saving.
-	if (p.mode == p.MODE_READ && !PSP_CoreParameter().frozen) {
+	if (p.mode == p.MODE_READ && !PSP_CoreParameter().frozen && !PSP_CoreParameter().runningAhead) {
 		textureCacheD3D11_->Clear(true);
 		drawEngine_.ClearTrackedVertexArrays();
 
@@ -19,6 +19,7 @@
 
 #include <list>
 #include <deque>
+#include <string>
 #include <d3d11.h>
 
 #include "GPU/GPUCommon.h"
@@ -84,4 +85,6 @@ class GPU_D3D11 : public GPUCommon {
 
 	int lastVsync_;
 	int vertexCost_ = 0;
+
+	std::string shaderCachePath_;
 };
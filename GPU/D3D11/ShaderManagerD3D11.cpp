@@ -20,7 +20,9 @@
 #include <d3d11.h>
 #include <d3dcompiler.h>
 
+#include <algorithm>
 #include <map>
+#include <thread>
 
 #include "base/logging.h"
 #include "math/lin/matrix4x4.h"
@@ -28,6 +30,7 @@
 #include "math/dataconv.h"
 #include "util/text/utf8.h"
 #include "Common/Common.h"
+#include "Common/FileUtil.h"
 #include "Core/Config.h"
 #include "Core/Reporting.h"
 #include "GPU/Math3D.h"
@@ -42,11 +45,22 @@ D3D11FragmentShader::D3D11FragmentShader(ID3D11Device *device, D3D_FEATURE_LEVEL
 	: device_(device), id_(id), failed_(false), useHWTransform_(useHWTransform), module_(0) {
 	source_ = code;
 
-	module_ = CreatePixelShaderD3D11(device, code, strlen(code), featureLevel);
+	module_ = CreatePixelShaderD3D11(device, code, strlen(code), featureLevel, 0, &bytecode_);
 	if (!module_)
 		failed_ = true;
 }
 
+D3D11FragmentShader::D3D11FragmentShader(ID3D11Device *device, FShaderID id, const char *code, const std::vector<uint8_t> &bytecode, bool useHWTransform)
+	: device_(device), id_(id), failed_(false), useHWTransform_(useHWTransform), module_(0) {
+	source_ = code;
+	bytecode_ = bytecode;
+
+	if (FAILED(device->CreatePixelShader(bytecode_.data(), bytecode_.size(), nullptr, &module_))) {
+		module_ = nullptr;
+		failed_ = true;
+	}
+}
+
 D3D11FragmentShader::~D3D11FragmentShader() {
 	if (module_)
 		module_->Release();
@@ -72,6 +86,17 @@ D3D11VertexShader::D3D11VertexShader(ID3D11Device *device, D3D_FEATURE_LEVEL fea
 		failed_ = true;
 }
 
+D3D11VertexShader::D3D11VertexShader(ID3D11Device *device, VShaderID id, const char *code, const std::vector<uint8_t> &bytecode, bool useHWTransform)
+	: device_(device), id_(id), failed_(false), useHWTransform_(useHWTransform), module_(nullptr) {
+	source_ = code;
+	bytecode_ = bytecode;
+
+	if (FAILED(device->CreateVertexShader(bytecode_.data(), bytecode_.size(), nullptr, &module_))) {
+		module_ = nullptr;
+		failed_ = true;
+	}
+}
+
 D3D11VertexShader::~D3D11VertexShader() {
 	if (module_)
 		module_->Release();
@@ -88,11 +113,21 @@ std::string D3D11VertexShader::GetShaderString(DebugShaderStringType type) const
 	}
 }
 
-ShaderManagerD3D11::ShaderManagerD3D11(ID3D11Device *device, ID3D11DeviceContext *context, D3D_FEATURE_LEVEL featureLevel)
-	: device_(device), context_(context), featureLevel_(featureLevel), lastVShader_(nullptr), lastFShader_(nullptr) {
+// Constant buffer offsets and sizes are in units of 16 constants (256 bytes).
+static const UINT UNIFORM_RING_ALIGN = 256;
+static const UINT UNIFORM_RING_SIZE = 1024 * 1024;
+
+static inline UINT AlignUniformSize(size_t size) {
+	return (UINT)((size + UNIFORM_RING_ALIGN - 1) & ~(size_t)(UNIFORM_RING_ALIGN - 1));
+}
+
+ShaderManagerD3D11::ShaderManagerD3D11(ID3D11Device *device, ID3D11DeviceContext *context, ID3D11DeviceContext1 *context1, D3D_FEATURE_LEVEL featureLevel)
+	: device_(device), context_(context), context1_(context1), featureLevel_(featureLevel), lastVShader_(nullptr), lastFShader_(nullptr) {
 	codeBuffer_ = new char[16384];
 	memset(&ub_base, 0, sizeof(ub_base));
 	memset(&ub_lights, 0, sizeof(ub_lights));
+	memset(&ub_baseUploaded_, 0, sizeof(ub_baseUploaded_));
+	memset(&ub_lightsUploaded_, 0, sizeof(ub_lightsUploaded_));
 
 	INFO_LOG(G3D, "sizeof(ub_base): %d", (int)sizeof(ub_base));
 	INFO_LOG(G3D, "sizeof(ub_lights): %d", (int)sizeof(ub_lights));
@@ -101,11 +136,26 @@ ShaderManagerD3D11::ShaderManagerD3D11(ID3D11Device *device, ID3D11DeviceContext
 	ASSERT_SUCCESS(device_->CreateBuffer(&desc, nullptr, &push_base));
 	desc.ByteWidth = sizeof(ub_lights);
 	ASSERT_SUCCESS(device_->CreateBuffer(&desc, nullptr, &push_lights));
+
+	if (context1_) {
+		D3D11_FEATURE_DATA_D3D11_OPTIONS options{};
+		HRESULT result = device_->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options));
+		if (SUCCEEDED(result) && options.ConstantBufferOffsetting && options.MapNoOverwriteOnDynamicConstantBuffer) {
+			desc.ByteWidth = UNIFORM_RING_SIZE;
+			if (SUCCEEDED(device_->CreateBuffer(&desc, nullptr, &uniformRing_))) {
+				// Makes the first upload discard.
+				ringPos_ = UNIFORM_RING_SIZE;
+				INFO_LOG(G3D, "Using a %d KB uniform ring buffer", UNIFORM_RING_SIZE / 1024);
+			}
+		}
+	}
 }
 
 ShaderManagerD3D11::~ShaderManagerD3D11() {
 	push_base->Release();
 	push_lights->Release();
+	if (uniformRing_)
+		uniformRing_->Release();
 	ClearShaders();
 	delete[] codeBuffer_;
 }
@@ -141,25 +191,85 @@ void ShaderManagerD3D11::DirtyLastShader() {
 uint64_t ShaderManagerD3D11::UpdateUniforms() {
 	uint64_t dirty = gstate_c.GetDirtyUniforms();
 	if (dirty != 0) {
-		D3D11_MAPPED_SUBRESOURCE map;
+		// The dirty flags are conservative, so compare against what's on the GPU before uploading.
+		bool base = !uniformsUploaded_;
+		bool lights = !uniformsUploaded_;
 		if (dirty & DIRTY_BASE_UNIFORMS) {
 			BaseUpdateUniforms(&ub_base, dirty, true);
+			base = base || memcmp(&ub_base, &ub_baseUploaded_, sizeof(ub_base)) != 0;
+		}
+		if (dirty & DIRTY_LIGHT_UNIFORMS) {
+			LightUpdateUniforms(&ub_lights, dirty);
+			lights = lights || memcmp(&ub_lights, &ub_lightsUploaded_, sizeof(ub_lights)) != 0;
+		}
+		if (base || lights) {
+			UploadUniforms(base, lights);
+		}
+	}
+	gstate_c.CleanUniforms();
+	return dirty;
+}
+
+void ShaderManagerD3D11::UploadUniforms(bool base, bool lights) {
+	D3D11_MAPPED_SUBRESOURCE map;
+	if (uniformRing_) {
+		UINT needed = (base ? AlignUniformSize(sizeof(ub_base)) : 0) + (lights ? AlignUniformSize(sizeof(ub_lights)) : 0);
+		D3D11_MAP mapType = D3D11_MAP_WRITE_NO_OVERWRITE;
+		if (ringPos_ + needed > UNIFORM_RING_SIZE) {
+			// Discarding loses everything already in the ring, so both blocks need to go in again.
+			mapType = D3D11_MAP_WRITE_DISCARD;
+			ringPos_ = 0;
+			base = true;
+			lights = true;
+		}
+		if (FAILED(context_->Map(uniformRing_, 0, mapType, 0, &map))) {
+			return;
+		}
+		if (base) {
+			memcpy((uint8_t *)map.pData + ringPos_, &ub_base, sizeof(ub_base));
+			baseOffset_ = ringPos_;
+			ringPos_ += AlignUniformSize(sizeof(ub_base));
+		}
+		if (lights) {
+			memcpy((uint8_t *)map.pData + ringPos_, &ub_lights, sizeof(ub_lights));
+			lightsOffset_ = ringPos_;
+			ringPos_ += AlignUniformSize(sizeof(ub_lights));
+		}
+		context_->Unmap(uniformRing_, 0);
+	} else {
+		if (base) {
 			context_->Map(push_base, 0, D3D11_MAP_WRITE_DISCARD, 0, &map);
 			memcpy(map.pData, &ub_base, sizeof(ub_base));
 			context_->Unmap(push_base, 0);
 		}
-		if (dirty & DIRTY_LIGHT_UNIFORMS) {
-			LightUpdateUniforms(&ub_lights, dirty);
+		if (lights) {
 			context_->Map(push_lights, 0, D3D11_MAP_WRITE_DISCARD, 0, &map);
 			memcpy(map.pData, &ub_lights, sizeof(ub_lights));
 			context_->Unmap(push_lights, 0);
 		}
 	}
-	gstate_c.CleanUniforms();
-	return dirty;
+	if (base)
+		memcpy(&ub_baseUploaded_, &ub_base, sizeof(ub_base));
+	if (lights)
+		memcpy(&ub_lightsUploaded_, &ub_lights, sizeof(ub_lights));
+	uniformsUploaded_ = true;
+}
+
+void ShaderManagerD3D11::RestartUniformRing() {
+	if (uniformRing_) {
+		ringPos_ = UNIFORM_RING_SIZE;
+	}
 }
 
 void ShaderManagerD3D11::BindUniforms() {
+	if (uniformRing_) {
+		ID3D11Buffer *cbs[2] = { uniformRing_, uniformRing_ };
+		UINT firstConstant[2] = { baseOffset_ / 16, lightsOffset_ / 16 };
+		UINT numConstants[2] = { AlignUniformSize(sizeof(ub_base)) / 16, AlignUniformSize(sizeof(ub_lights)) / 16 };
+		context1_->VSSetConstantBuffers1(0, 2, cbs, firstConstant, numConstants);
+		context1_->PSSetConstantBuffers1(0, 1, cbs, firstConstant, numConstants);
+		return;
+	}
 	ID3D11Buffer *vs_cbs[2] = { push_base, push_lights };
 	ID3D11Buffer *ps_cbs[1] = { push_base };
 	context_->VSSetConstantBuffers(0, 2, vs_cbs);
@@ -199,6 +309,7 @@ void ShaderManagerD3D11::GetShaders(int prim, u32 vertType, D3D11VertexShader **
 		GenerateVertexShaderD3D11(VSID, codeBuffer_, featureLevel_ <= D3D_FEATURE_LEVEL_9_3 ? HLSL_D3D11_LEVEL9 : HLSL_D3D11);
 		vs = new D3D11VertexShader(device_, featureLevel_, VSID, codeBuffer_, vertType, useHWTransform);
 		vsCache_[VSID] = vs;
+		diskCacheDirty_ = true;
 	} else {
 		vs = vsIter->second;
 	}
@@ -211,6 +322,7 @@ void ShaderManagerD3D11::GetShaders(int prim, u32 vertType, D3D11VertexShader **
 		GenerateFragmentShaderD3D11(FSID, codeBuffer_, featureLevel_ <= D3D_FEATURE_LEVEL_9_3 ? HLSL_D3D11_LEVEL9 : HLSL_D3D11);
 		fs = new D3D11FragmentShader(device_, featureLevel_, FSID, codeBuffer_, useHWTransform);
 		fsCache_[FSID] = fs;
+		diskCacheDirty_ = true;
 	} else {
 		fs = fsIter->second;
 	}
@@ -275,3 +387,171 @@ std::string ShaderManagerD3D11::DebugGetShaderString(std::string id, DebugShader
 		return "N/A";
 	}
 }
+
+#define CACHE_HEADER_MAGIC 0x11d3d5ca
+#define CACHE_VERSION 1
+struct D3D11CacheHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t compilerVersion;
+	uint32_t featureLevel;
+	uint32_t featureFlags;
+	int numVertexShaders;
+	int numFragmentShaders;
+};
+
+struct D3D11CacheEntryHeader {
+	uint32_t flags;  // 1 = useHWTransform
+	uint32_t size;
+};
+
+struct D3D11CachedShader {
+	ShaderID id;
+	bool useHWTransform;
+	std::vector<uint8_t> bytecode;
+	void *shader;
+};
+
+void ShaderManagerD3D11::LoadCache(const std::string &filename) {
+	FILE *f = File::OpenCFile(filename, "rb");
+	if (!f)
+		return;
+
+	D3D11CacheHeader header{};
+	bool valid = fread(&header, sizeof(header), 1, f) == 1;
+	if (!valid || header.magic != CACHE_HEADER_MAGIC || header.version != CACHE_VERSION || header.compilerVersion != D3D_COMPILER_VERSION) {
+		fclose(f);
+		return;
+	}
+	if (header.featureLevel != (uint32_t)featureLevel_ || header.featureFlags != gstate_c.featureFlags) {
+		fclose(f);
+		return;
+	}
+	if (header.numVertexShaders < 0 || header.numFragmentShaders < 0 || header.numVertexShaders > 4096 || header.numFragmentShaders > 4096) {
+		ERROR_LOG(G3D, "Corrupt shader cache file header, aborting.");
+		fclose(f);
+		return;
+	}
+
+	std::vector<D3D11CachedShader> shaders(header.numVertexShaders + header.numFragmentShaders);
+	for (auto &shader : shaders) {
+		D3D11CacheEntryHeader entry;
+		if (fread(&shader.id, sizeof(shader.id), 1, f) != 1 || fread(&entry, sizeof(entry), 1, f) != 1 || entry.size == 0 || entry.size > 0x100000) {
+			valid = false;
+			break;
+		}
+		shader.useHWTransform = (entry.flags & 1) != 0;
+		shader.bytecode.resize(entry.size);
+		if (fread(&shader.bytecode[0], 1, entry.size, f) != entry.size) {
+			valid = false;
+			break;
+		}
+		shader.shader = nullptr;
+	}
+	fclose(f);
+	if (!valid) {
+		ERROR_LOG(G3D, "Shader cache file is truncated, ignoring it.");
+		return;
+	}
+
+	// The device is free threaded, so split the work up. Most of it is generating the source,
+	// which we keep around for the shader viewer.
+	int numVS = header.numVertexShaders;
+	int numThreads = std::max(1, std::min((int)std::thread::hardware_concurrency(), (int)shaders.size() / 16));
+	auto work = [&](int start, int end) {
+		char *codeBuffer = new char[16384];
+		ShaderLanguage lang = featureLevel_ <= D3D_FEATURE_LEVEL_9_3 ? HLSL_D3D11_LEVEL9 : HLSL_D3D11;
+		for (int i = start; i < end; i++) {
+			D3D11CachedShader &shader = shaders[i];
+			if (i < numVS) {
+				VShaderID id(shader.id);
+				GenerateVertexShaderD3D11(id, codeBuffer, lang);
+				shader.shader = new D3D11VertexShader(device_, id, codeBuffer, shader.bytecode, shader.useHWTransform);
+			} else {
+				FShaderID id(shader.id);
+				GenerateFragmentShaderD3D11(id, codeBuffer, lang);
+				shader.shader = new D3D11FragmentShader(device_, id, codeBuffer, shader.bytecode, shader.useHWTransform);
+			}
+		}
+		delete[] codeBuffer;
+	};
+
+	std::vector<std::thread> threads;
+	int perThread = ((int)shaders.size() + numThreads - 1) / numThreads;
+	for (int i = 1; i < numThreads; i++) {
+		threads.push_back(std::thread(work, i * perThread, std::min((i + 1) * perThread, (int)shaders.size())));
+	}
+	work(0, std::min(perThread, (int)shaders.size()));
+	for (std::thread &th : threads) {
+		th.join();
+	}
+
+	for (int i = 0; i < (int)shaders.size(); i++) {
+		if (i < numVS) {
+			VShaderID id(shaders[i].id);
+			D3D11VertexShader *vs = (D3D11VertexShader *)shaders[i].shader;
+			if (vs->Failed() || vsCache_.find(id) != vsCache_.end()) {
+				delete vs;
+				continue;
+			}
+			vsCache_[id] = vs;
+		} else {
+			FShaderID id(shaders[i].id);
+			D3D11FragmentShader *fs = (D3D11FragmentShader *)shaders[i].shader;
+			if (fs->Failed() || fsCache_.find(id) != fsCache_.end()) {
+				delete fs;
+				continue;
+			}
+			fsCache_[id] = fs;
+		}
+	}
+	NOTICE_LOG(G3D, "Loaded %d vertex and %d fragment shaders from the cache", header.numVertexShaders, header.numFragmentShaders);
+}
+
+void ShaderManagerD3D11::SaveCache(const std::string &filename) {
+	if (!diskCacheDirty_) {
+		return;
+	}
+	FILE *f = File::OpenCFile(filename, "wb");
+	if (!f) {
+		// Can't save, give up for now.
+		diskCacheDirty_ = false;
+		return;
+	}
+
+	auto writeEntry = [&](const ShaderID &id, bool useHWTransform, const std::vector<uint8_t> &bytecode) {
+		D3D11CacheEntryHeader entry;
+		entry.flags = useHWTransform ? 1 : 0;
+		entry.size = (uint32_t)bytecode.size();
+		fwrite(&id, sizeof(id), 1, f);
+		fwrite(&entry, sizeof(entry), 1, f);
+		fwrite(bytecode.data(), 1, bytecode.size(), f);
+	};
+
+	D3D11CacheHeader header{};
+	header.magic = CACHE_HEADER_MAGIC;
+	header.version = CACHE_VERSION;
+	header.compilerVersion = D3D_COMPILER_VERSION;
+	header.featureLevel = (uint32_t)featureLevel_;
+	header.featureFlags = gstate_c.featureFlags;
+	for (auto iter : vsCache_) {
+		if (!iter.second->Failed())
+			header.numVertexShaders++;
+	}
+	for (auto iter : fsCache_) {
+		if (!iter.second->Failed())
+			header.numFragmentShaders++;
+	}
+	fwrite(&header, sizeof(header), 1, f);
+	for (auto iter : vsCache_) {
+		if (!iter.second->Failed())
+			writeEntry(iter.first, iter.second->UseHWTransform(), iter.second->bytecode());
+	}
+	for (auto iter : fsCache_) {
+		if (!iter.second->Failed())
+			writeEntry(iter.first, iter.second->UseHWTransform(), iter.second->bytecode());
+	}
+	fclose(f);
+	diskCacheDirty_ = false;
+	NOTICE_LOG(G3D, "Saved %d vertex and %d fragment shaders", header.numVertexShaders, header.numFragmentShaders);
+}
@@ -18,8 +18,11 @@
 #pragma once
 
 #include <map>
+#include <string>
+#include <vector>
 
 #include <d3d11.h>
+#include <d3d11_1.h>
 
 #include "base/basictypes.h"
 #include "GPU/Common/ShaderCommon.h"
@@ -32,9 +35,12 @@ class D3D11PushBuffer;
 class D3D11FragmentShader {
 public:
 	D3D11FragmentShader(ID3D11Device *device, D3D_FEATURE_LEVEL featureLevel, FShaderID id, const char *code, bool useHWTransform);
+	// From the disk cache, skips the HLSL compiler.
+	D3D11FragmentShader(ID3D11Device *device, FShaderID id, const char *code, const std::vector<uint8_t> &bytecode, bool useHWTransform);
 	~D3D11FragmentShader();
 
 	const std::string &source() const { return source_; }
+	const std::vector<uint8_t> &bytecode() const { return bytecode_; }
 
 	bool Failed() const { return failed_; }
 	bool UseHWTransform() const { return useHWTransform_; }
@@ -47,6 +53,7 @@ class D3D11FragmentShader {
 
 	ID3D11Device *device_;
 	std::string source_;
+	std::vector<uint8_t> bytecode_;
 	bool failed_;
 	bool useHWTransform_;
 	FShaderID id_;
@@ -55,6 +62,8 @@ class D3D11FragmentShader {
 class D3D11VertexShader {
 public:
 	D3D11VertexShader(ID3D11Device *device, D3D_FEATURE_LEVEL featureLevel, VShaderID id, const char *code, int vertType, bool useHWTransform);
+	// From the disk cache, skips the HLSL compiler.
+	D3D11VertexShader(ID3D11Device *device, VShaderID id, const char *code, const std::vector<uint8_t> &bytecode, bool useHWTransform);
 	~D3D11VertexShader();
 
 	const std::string &source() const { return source_; }
@@ -81,7 +90,7 @@ class D3D11PushBuffer;
 
 class ShaderManagerD3D11 : public ShaderManagerCommon {
 public:
-	ShaderManagerD3D11(ID3D11Device *device, ID3D11DeviceContext *context, D3D_FEATURE_LEVEL featureLevel);
+	ShaderManagerD3D11(ID3D11Device *device, ID3D11DeviceContext *context, ID3D11DeviceContext1 *context1, D3D_FEATURE_LEVEL featureLevel);
 	~ShaderManagerD3D11();
 
 	void GetShaders(int prim, u32 vertType, D3D11VertexShader **vshader, D3D11FragmentShader **fshader, bool useHWTransform);
@@ -94,19 +103,22 @@ class ShaderManagerD3D11 : public ShaderManagerCommon {
 	std::vector<std::string> DebugGetShaderIDs(DebugShaderType type);
 	std::string DebugGetShaderString(std::string id, DebugShaderType type, DebugShaderStringType stringType);
 
+	// Compiled bytecode cache, only valid for the same compiler, feature level and feature flags.
+	void LoadCache(const std::string &filename);
+	void SaveCache(const std::string &filename);
+
 	uint64_t UpdateUniforms();
 	void BindUniforms();
-
-	// TODO: Avoid copying these buffers if same as last draw, can still point to it assuming we're still in the same pushbuffer.
-	// Applies dirty changes and copies the buffer.
-	bool IsBaseDirty() { return true; }
-	bool IsLightDirty() { return true; }
+	// After the draw context submits a command list, the next ring map must DISCARD.
+	void RestartUniformRing();
 
 private:
 	void Clear();
+	void UploadUniforms(bool base, bool lights);
 
 	ID3D11Device *device_;
 	ID3D11DeviceContext *context_;
+	ID3D11DeviceContext1 *context1_;
 	D3D_FEATURE_LEVEL featureLevel_;
 
 	typedef std::map<FShaderID, D3D11FragmentShader *> FSCache;
@@ -120,14 +132,26 @@ class ShaderManagerD3D11 : public ShaderManagerCommon {
 	// Uniform block scratchpad. These (the relevant ones) are copied to the current pushbuffer at draw time.
 	UB_VS_FS_Base ub_base;
 	UB_VS_Lights ub_lights;
+	// What's currently on the GPU, to skip uploads when the dirty flags were too pessimistic.
+	UB_VS_FS_Base ub_baseUploaded_;
+	UB_VS_Lights ub_lightsUploaded_;
+	bool uniformsUploaded_ = false;
 
-	// Not actual pushbuffers, requires D3D11.1, let's try to live without that first.
+	// Used when constant buffer offsetting (D3D11.1) isn't available.
 	ID3D11Buffer *push_base;
 	ID3D11Buffer *push_lights;
 
+	// With D3D11.1, uniforms are instead appended to a ring with NO_OVERWRITE and bound by offset.
+	ID3D11Buffer *uniformRing_ = nullptr;
+	UINT ringPos_ = 0;
+	UINT baseOffset_ = 0;
+	UINT lightsOffset_ = 0;
+
 	D3D11FragmentShader *lastFShader_;
 	D3D11VertexShader *lastVShader_;
 
 	FShaderID lastFSID_;
 	VShaderID lastVSID_;
+
+	bool diskCacheDirty_ = false;
 };
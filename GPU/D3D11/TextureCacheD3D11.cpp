@@ -398,8 +398,10 @@ void TextureCacheD3D11::ApplyTextureFramebuffer(TexCacheEntry *entry, VirtualFra
 		context_->PSSetShaderResources(1, 1, &clutTexture);
 		framebufferManagerD3D11_->BindFramebufferAsColorTexture(0, framebuffer, BINDFBCOLOR_SKIP_COPY);
 		context_->PSSetSamplers(0, 1, &stockD3D11.samplerPoint2DWrap);
+		draw_->BeginGPUTimer("depal");
 		draw_->BindFramebufferAsRenderTarget(depalFBO, { Draw::RPAction::DONT_CARE, Draw::RPAction::DONT_CARE, Draw::RPAction::DONT_CARE });
 		shaderApply.Shade();
+		draw_->EndGPUTimer();
 
 		framebufferManagerD3D11_->RebindFramebuffer();
 		draw_->BindFramebufferAsTexture(depalFBO, 0, Draw::FB_COLOR_BIT, 0);
@@ -482,10 +484,9 @@ void TextureCacheD3D11::BuildTexture(TexCacheEntry *const entry) {
 		scaleFactor = scaleFactor > 4 ? 4 : (scaleFactor > 2 ? 2 : 1);
 	}
 
-	u64 cachekey = replacer_.Enabled() ? entry->CacheKey() : 0;
 	int w = gstate.getTextureWidth(0);
 	int h = gstate.getTextureHeight(0);
-	ReplacedTexture &replaced = replacer_.FindReplacement(cachekey, entry->fullhash, w, h);
+	ReplacedTexture &replaced = FindReplacement(entry, w, h);
 	if (replaced.GetSize(0, w, h)) {
 		// We're replacing, so we won't scale.
 		scaleFactor = 1;
@@ -549,6 +550,10 @@ void TextureCacheD3D11::BuildTexture(TexCacheEntry *const entry) {
 	if (replaced.Valid()) {
 		entry->SetAlphaStatus(TexCacheEntry::TexStatus(replaced.AlphaStatus()));
 	}
+
+	// Scaled and replaced textures are always 8888.
+	int bitsPerPixel = scaleFactor > 1 || replaced.Valid() || dstFmt == DXGI_FORMAT_B8G8R8A8_UNORM ? 32 : 16;
+	SetTexMemoryUsage(entry, w * scaleFactor, h * scaleFactor, scaleFactor == 1 ? maxLevel + 1 : 1, bitsPerPixel);
 }
 
 DXGI_FORMAT GetClutDestFormatD3D11(GEPaletteFormat format) {
@@ -719,7 +724,7 @@ void TextureCacheD3D11::LoadTextureLevel(TexCacheEntry &entry, ReplacedTexture &
 
 		if (scaleFactor > 1) {
 			u32 scaleFmt = (u32)dstFmt;
-			scaler.ScaleAlways((u32 *)mapData, pixelData, scaleFmt, w, h, scaleFactor);
+			scaler.ScaleAlways((u32 *)mapData, pixelData, scaleFmt, w, h, scaleFactor, entry.ContentKey());
 			pixelData = (u32 *)mapData;
 
 			// We always end up at 8888.  Other parts assume this.
@@ -16,10 +16,17 @@
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
 #include <algorithm>
+#include <condition_variable>
 #include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 #include <snappy-c.h>
+#include "ext/xxhash.h"
 #include "base/stringutil.h"
+#include "base/timeutil.h"
 #include "Common/Common.h"
 #include "Common/FileUtil.h"
 #include "Common/Log.h"
@@ -42,11 +49,18 @@
 namespace GPURecord {
 
 static const char *HEADER = "PPSSPPGE";
-static const int VERSION = 2;
+// Version 3 compresses the pushbuf in separate chunks, so it can be compressed while recording.
+static const int VERSION = 3;
+static const int MIN_VERSION = 2;
+static const u32 PUSHBUF_CHUNK_SIZE = 1024 * 1024;
 
 static bool active = false;
 static bool nextFrame = false;
 static bool writePending = false;
+// Frames still to record, and whether a frame just ended and the display buffer is needed.
+static int framesRemaining = 0;
+static bool framePending = false;
+static int nextFrameCount = 1;
 
 enum class CommandType : u8 {
 	INIT = 0,
@@ -83,7 +97,21 @@ struct Command {
 static std::vector<u8> pushbuf;
 static std::vector<Command> commands;
 static std::vector<u32> lastRegisters;
-static std::vector<u32> lastTextures;
+// Hash of each block emitted to pushbuf, so repeated data (across commands and frames) is only stored once.
+static std::unordered_map<u64, u32> pushbufBlocks;
+
+// Completed pushbuf chunks are compressed on a separate thread while recording.
+// That thread also writes the file at the end, so the game doesn't stall on it.
+static std::mutex compressLock;
+static std::condition_variable compressCond;
+static std::deque<std::vector<u8>> compressQueue;
+static std::vector<std::vector<u8>> compressedChunks;
+static u32 queuedPushbufSize = 0;
+static bool compressFinish = false;
+static bool compressRunning = false;
+static std::vector<Command> finishCommands;
+static u32 finishPushbufSize = 0;
+static std::string finishFilename;
 
 // TODO: Maybe move execute to another file?
 static u32 execMemcpyDest;
@@ -92,6 +120,21 @@ static u32 execListPos;
 static u32 execListID;
 static const int LIST_BUF_SIZE = 256 * 1024;
 static std::vector<u32> execListQueue;
+// Multi-frame dumps are replayed one frame per call, this is where the next frame starts.
+static size_t execCommandPos = 0;
+
+// Host time spent on each submitted block of commands with draws in it, when enabled.
+struct DrawTiming {
+	int frame;
+	u32 command;
+	u32 op;
+	int prims;
+	u32 vertType;
+	double seconds;
+};
+static bool replayTiming = false;
+static int replayFrame = 0;
+static std::vector<DrawTiming> drawTimings;
 
 // This class maps pushbuffer (dump data) sections to PSP memory.
 // Dumps can be larger than available PSP memory, because they include generated data too.
@@ -365,16 +408,95 @@ static void BeginRecording() {
 	commands.push_back({CommandType::INIT, sz, ptr});
 }
 
-static void WriteCompressed(FILE *fp, const void *p, size_t sz) {
+static std::vector<u8> Compress(const void *p, size_t sz) {
 	size_t compressed_size = snappy_max_compressed_length(sz);
-	u8 *compressed = new u8[compressed_size];
-	snappy_compress((const char *)p, sz, (char *)compressed, &compressed_size);
+	std::vector<u8> compressed(compressed_size);
+	snappy_compress((const char *)p, sz, (char *)compressed.data(), &compressed_size);
+	compressed.resize(compressed_size);
+	return compressed;
+}
 
-	u32 write_size = (u32)compressed_size;
+static void WriteCompressed(FILE *fp, const std::vector<u8> &compressed) {
+	u32 write_size = (u32)compressed.size();
 	fwrite(&write_size, sizeof(write_size), 1, fp);
-	fwrite(compressed, compressed_size, 1, fp);
+	fwrite(compressed.data(), compressed.size(), 1, fp);
+}
 
-	delete [] compressed;
+static void WriteRecordingFile(const std::string &filename, const std::vector<Command> &cmds, u32 bufsz, const std::vector<std::vector<u8>> &chunks) {
+	FILE *fp = File::OpenCFile(filename, "wb");
+	if (!fp) {
+		ERROR_LOG(G3D, "Unable to write recording: %s", filename.c_str());
+		return;
+	}
+	fwrite(HEADER, 8, 1, fp);
+	fwrite(&VERSION, sizeof(VERSION), 1, fp);
+
+	u32 sz = (u32)cmds.size();
+	fwrite(&sz, sizeof(sz), 1, fp);
+	fwrite(&bufsz, sizeof(bufsz), 1, fp);
+
+	WriteCompressed(fp, Compress(cmds.data(), cmds.size() * sizeof(Command)));
+	for (const std::vector<u8> &chunk : chunks) {
+		WriteCompressed(fp, chunk);
+	}
+
+	fclose(fp);
+	NOTICE_LOG(G3D, "Recording written: %s", filename.c_str());
+}
+
+static void CompressThread() {
+	std::unique_lock<std::mutex> guard(compressLock);
+	while (true) {
+		compressCond.wait(guard, [] { return !compressQueue.empty() || compressFinish; });
+		if (compressQueue.empty())
+			break;
+
+		// The queue is FIFO and there's only one of these threads, so chunks stay in order.
+		std::vector<u8> chunk = std::move(compressQueue.front());
+		compressQueue.pop_front();
+		guard.unlock();
+		std::vector<u8> compressed = Compress(chunk.data(), chunk.size());
+		guard.lock();
+		compressedChunks.push_back(std::move(compressed));
+	}
+
+	std::vector<Command> cmds = std::move(finishCommands);
+	std::vector<std::vector<u8>> chunks = std::move(compressedChunks);
+	std::string filename = finishFilename;
+	u32 bufsz = finishPushbufSize;
+	guard.unlock();
+
+	WriteRecordingFile(filename, cmds, bufsz, chunks);
+
+	guard.lock();
+	compressRunning = false;
+	compressCond.notify_all();
+}
+
+// Hands any complete pushbuf chunks (or all remaining data, if final) to the compress thread.
+static void QueuePushbufChunks(bool final) {
+	while (pushbuf.size() - queuedPushbufSize >= PUSHBUF_CHUNK_SIZE || (final && pushbuf.size() > queuedPushbufSize)) {
+		u32 sz = std::min((u32)pushbuf.size() - queuedPushbufSize, PUSHBUF_CHUNK_SIZE);
+		std::vector<u8> chunk(pushbuf.begin() + queuedPushbufSize, pushbuf.begin() + queuedPushbufSize + sz);
+		queuedPushbufSize += sz;
+
+		std::lock_guard<std::mutex> guard(compressLock);
+		compressQueue.push_back(std::move(chunk));
+		compressCond.notify_one();
+	}
+}
+
+static void StartCompressThread() {
+	std::unique_lock<std::mutex> guard(compressLock);
+	// If the last recording is still being written, let it finish first.
+	compressCond.wait(guard, [] { return !compressRunning; });
+	compressQueue.clear();
+	compressedChunks.clear();
+	compressFinish = false;
+	compressRunning = true;
+	queuedPushbufSize = 0;
+	// Detached, since it may still be writing when we shut down.
+	std::thread(&CompressThread).detach();
 }
 
 static void WriteRecording() {
@@ -385,19 +507,14 @@ static void WriteRecording() {
 
 	NOTICE_LOG(G3D, "Recording filename: %s", filename.c_str());
 
-	FILE *fp = File::OpenCFile(filename, "wb");
-	fwrite(HEADER, 8, 1, fp);
-	fwrite(&VERSION, sizeof(VERSION), 1, fp);
-
-	u32 sz = (u32)commands.size();
-	fwrite(&sz, sizeof(sz), 1, fp);
-	u32 bufsz = (u32)pushbuf.size();
-	fwrite(&bufsz, sizeof(bufsz), 1, fp);
+	QueuePushbufChunks(true);
 
-	WriteCompressed(fp, commands.data(), commands.size() * sizeof(Command));
-	WriteCompressed(fp, pushbuf.data(), bufsz);
-
-	fclose(fp);
+	std::lock_guard<std::mutex> guard(compressLock);
+	finishCommands = std::move(commands);
+	finishPushbufSize = (u32)pushbuf.size();
+	finishFilename = filename;
+	compressFinish = true;
+	compressCond.notify_one();
 }
 
 static void GetVertDataSizes(int vcount, const void *indices, u32 &vbytes, u32 &ibytes) {
@@ -455,12 +572,20 @@ static Command EmitCommandWithRAM(CommandType t, const void *p, u32 sz) {
 	if (sz) {
 		// If at all possible, try to find it already in the buffer.
 		const u8 *prev = nullptr;
+		// Whole blocks that were emitted before (same texture, same verts, etc.) are found by hash.
+		// The size is part of the seed, so a prefix of a block doesn't collide with it.
+		const u64 hash = XXH64(p, sz, sz);
+		auto it = pushbufBlocks.find(hash);
+		if (it != pushbufBlocks.end() && it->second + sz <= pushbuf.size() && memcmp(pushbuf.data() + it->second, p, sz) == 0) {
+			prev = pushbuf.data() + it->second;
+		}
+
+		// Otherwise, try nearby... partial overlaps (like index ranges) will often be nearby.
+		// Searching the whole buffer gets too slow on long recordings.
 		const size_t NEAR_WINDOW = std::max((int)sz * 2, 1024 * 10);
-		// Let's try nearby first... it will often be nearby.
-		if (pushbuf.size() > NEAR_WINDOW) {
+		if (!prev && pushbuf.size() > NEAR_WINDOW) {
 			prev = mymemmem(pushbuf.data() + pushbuf.size() - NEAR_WINDOW, NEAR_WINDOW, (const u8 *)p, sz);
-		}
-		if (!prev) {
+		} else if (!prev) {
 			prev = mymemmem(pushbuf.data(), pushbuf.size(), (const u8 *)p, sz);
 		}
 
@@ -478,6 +603,8 @@ static Command EmitCommandWithRAM(CommandType t, const void *p, u32 sz) {
 				memset(pushbuf.data() + cmd.ptr - pad, 0, pad);
 			}
 			memcpy(pushbuf.data() + cmd.ptr, p, sz);
+			pushbufBlocks[hash] = cmd.ptr;
+			QueuePushbufChunks(false);
 		}
 	}
 
@@ -501,22 +628,8 @@ static void EmitTextureData(int level, u32 texaddr) {
 		CommandType type = CommandType((int)CommandType::TEXTURE0 + level);
 		const u8 *p = Memory::GetPointerUnchecked(texaddr);
 
-		// Dumps are huge - let's try to find this already emitted.
-		for (u32 prevptr : lastTextures) {
-			if (pushbuf.size() < prevptr + bytes) {
-				continue;
-			}
-
-			if (memcmp(pushbuf.data() + prevptr, p, bytes) == 0) {
-				commands.push_back({type, bytes, prevptr});
-				// Okay, that was easy.  Bail out.
-				return;
-			}
-		}
-
-		// Not there, gotta emit anew.
-		Command cmd = EmitCommandWithRAM(type, p, bytes);
-		lastTextures.push_back(cmd.ptr);
+		// Dumps are huge, but this reuses the data if it was already emitted.
+		EmitCommandWithRAM(type, p, bytes);
 	}
 }
 
@@ -605,8 +718,9 @@ bool IsActive() {
 	return active;
 }
 
-void Activate() {
+void Activate(int frames) {
 	nextFrame = true;
+	nextFrameCount = std::max(frames, 1);
 }
 
 void NotifyCommand(u32 pc) {
@@ -617,6 +731,7 @@ void NotifyCommand(u32 pc) {
 		WriteRecording();
 		commands.clear();
 		pushbuf.clear();
+		pushbufBlocks.clear();
 
 		writePending = false;
 		// We're done - this was just to write the result out.
@@ -624,6 +739,13 @@ void NotifyCommand(u32 pc) {
 		active = false;
 		return;
 	}
+	if (framePending) {
+		// Like the end of the recording, the display buf is only right by the next frame's first command.
+		// During replay, this also marks where each frame ends.
+		FlushRegisters();
+		EmitDisplayBuf();
+		framePending = false;
+	}
 
 	const u32 op = Memory::Read_U32(pc);
 	const GECommand cmd = GECommand(op >> 24);
@@ -717,16 +839,21 @@ void NotifyUpload(u32 dest, u32 sz) {
 }
 
 void NotifyFrame() {
-	if (active && !writePending) {
+	if (active && !writePending && --framesRemaining > 0) {
+		framePending = true;
+	} else if (active && !writePending) {
 		// Delay write until the first command of the next frame, so we get the right display buf.
 		NOTICE_LOG(SYSTEM, "Recording complete - waiting to get display buffer");
 		writePending = true;
 	}
-	if (nextFrame) {
+	if (nextFrame && !active) {
 		NOTICE_LOG(SYSTEM, "Recording starting...");
+		StartCompressThread();
 		active = true;
 		nextFrame = false;
-		lastTextures.clear();
+		framesRemaining = nextFrameCount;
+		framePending = false;
+		pushbufBlocks.clear();
 		BeginRecording();
 	}
 }
@@ -806,7 +933,36 @@ static void ExecuteInit(u32 ptr, u32 sz) {
 }
 
 static void ExecuteRegisters(u32 ptr, u32 sz) {
+	if (!replayTiming) {
+		ExecuteSubmitCmds(pushbuf.data() + ptr, sz);
+		return;
+	}
+
+	DrawTiming timing{ replayFrame, (u32)execCommandPos - 1, 0, 0, gstate.vertType };
+	const u32_le *ops = (const u32_le *)(pushbuf.data() + ptr);
+	for (u32 i = 0; i < sz / 4; ++i) {
+		const u32 op = ops[i];
+		switch (op >> 24) {
+		case GE_CMD_VERTEXTYPE:
+			if (timing.prims == 0)
+				timing.vertType = op & 0x00FFFFFF;
+			break;
+		case GE_CMD_PRIM:
+		case GE_CMD_BEZIER:
+		case GE_CMD_SPLINE:
+			if (timing.prims++ == 0)
+				timing.op = op;
+			break;
+		}
+	}
+
+	// The GPU runs the list as soon as the stall is updated, so this includes its (CPU side) work.
+	double start = time_now_d();
 	ExecuteSubmitCmds(pushbuf.data() + ptr, sz);
+	timing.seconds = time_now_d() - start;
+
+	if (timing.prims != 0)
+		drawTimings.push_back(timing);
 }
 
 static void ExecuteVertices(u32 ptr, u32 sz) {
@@ -901,7 +1057,7 @@ static void ExecuteDisplay(u32 ptr, u32 sz) {
 	__DisplaySetFramebuf(disp->topaddr.ptr, disp->linesize, disp->pixelFormat, 0);
 }
 
-static void ExecuteFree() {
+static void ExecuteFreeList() {
 	execMemcpyDest = 0;
 	if (execListBuf) {
 		userMemory.Free(execListBuf);
@@ -909,13 +1065,21 @@ static void ExecuteFree() {
 	}
 	execListPos = 0;
 	execMapping.Reset();
+}
+
+static void ExecuteFree() {
+	ExecuteFreeList();
 
 	commands.clear();
 	pushbuf.clear();
+	execCommandPos = 0;
 }
 
+// Executes commands up to the end of the next frame (a DISPLAY command), or the end of the dump.
 static bool ExecuteCommands() {
-	for (const Command &cmd : commands) {
+	bool frameDone = false;
+	while (execCommandPos < commands.size() && !frameDone) {
+		const Command &cmd = commands[execCommandPos++];
 		switch (cmd.type) {
 		case CommandType::INIT:
 			ExecuteInit(cmd.ptr, cmd.sz);
@@ -966,6 +1130,7 @@ static bool ExecuteCommands() {
 
 		case CommandType::DISPLAY:
 			ExecuteDisplay(cmd.ptr, cmd.sz);
+			frameDone = true;
 			break;
 
 		default:
@@ -1006,9 +1171,10 @@ bool RunMountedReplay(const std::string &filename) {
 	pspFileSystem.ReadFile(fp, header, sizeof(header));
 	pspFileSystem.ReadFile(fp, (u8 *)&version, sizeof(version));
 
-	if (memcmp(header, HEADER, sizeof(header)) != 0 || version != VERSION) {
+	if (memcmp(header, HEADER, sizeof(header)) != 0 || version < MIN_VERSION || version > VERSION) {
 		ERROR_LOG(SYSTEM, "Invalid GE dump or unsupported version");
 		pspFileSystem.CloseFile(fp);
+		ExecuteFree();
 		return false;
 	}
 
@@ -1017,24 +1183,90 @@ bool RunMountedReplay(const std::string &filename) {
 	u32 bufsz = 0;
 	pspFileSystem.ReadFile(fp, (u8 *)&bufsz, sizeof(bufsz));
 
-	commands.resize(sz);
-	pushbuf.resize(bufsz);
+	// If we're partway through this dump, keep going from the next frame without rereading it.
+	bool resume = execCommandPos != 0 && sz == commands.size() && bufsz == pushbuf.size();
+	if (!resume) {
+		commands.resize(sz);
+		pushbuf.resize(bufsz);
+		execCommandPos = 0;
+
+		bool truncated = false;
+		truncated = truncated || !ReadCompressed(fp, commands.data(), sizeof(Command) * sz);
+		if (version >= 3) {
+			for (u32 pos = 0; pos < bufsz && !truncated; pos += PUSHBUF_CHUNK_SIZE) {
+				truncated = !ReadCompressed(fp, pushbuf.data() + pos, std::min(bufsz - pos, PUSHBUF_CHUNK_SIZE));
+			}
+		} else {
+			truncated = truncated || !ReadCompressed(fp, pushbuf.data(), bufsz);
+		}
 
-	bool truncated = false;
-	truncated = truncated || !ReadCompressed(fp, commands.data(), sizeof(Command) * sz);
-	truncated = truncated || !ReadCompressed(fp, pushbuf.data(), bufsz);
+		if (truncated) {
+			ERROR_LOG(SYSTEM, "Truncated GE dump");
+			pspFileSystem.CloseFile(fp);
+			ExecuteFree();
+			return false;
+		}
+	}
 
 	pspFileSystem.CloseFile(fp);
 
-	if (truncated) {
-		ERROR_LOG(SYSTEM, "Truncated GE dump");
+	bool success = ExecuteCommands();
+	replayFrame++;
+	if (!success || execCommandPos >= commands.size()) {
+		// Start over from the first frame next time.
 		ExecuteFree();
+	} else {
+		ExecuteFreeList();
+	}
+	return success;
+}
+
+void SetReplayTiming(bool enable) {
+	replayTiming = enable;
+	replayFrame = 0;
+	drawTimings.clear();
+}
+
+bool WriteReplayTimingReport(const std::string &filename, const std::string &title, int maxDraws) {
+	FILE *f = File::OpenCFile(filename, "a");
+	if (!f) {
+		ERROR_LOG(G3D, "Unable to write draw timings to %s", filename.c_str());
 		return false;
 	}
 
-	bool success = ExecuteCommands();
-	ExecuteFree();
-	return success;
+	static const char *const primNames[] = { "points", "lines", "linestrip", "tris", "tristrip", "trifan", "rects", "keep" };
+
+	double total = 0.0;
+	for (const DrawTiming &timing : drawTimings)
+		total += timing.seconds;
+
+	fprintf(f, "== %s ==\n", title.c_str());
+	fprintf(f, "%d frames, %d draw blocks, %0.3f ms in draw blocks\n", replayFrame, (int)drawTimings.size(), total * 1000.0);
+	fprintf(f, "\n%6s %8s %-10s %6s %6s %8s %10s\n", "frame", "command", "first", "count", "prims", "vtype", "host us");
+
+	// Slowest first.  Note that backends batch draws, so some cost can land on a later block.
+	std::sort(drawTimings.begin(), drawTimings.end(), [](const DrawTiming &a, const DrawTiming &b) {
+		return a.seconds > b.seconds;
+	});
+	for (int i = 0; i < (int)drawTimings.size() && i < maxDraws; ++i) {
+		const DrawTiming &timing = drawTimings[i];
+		const char *name;
+		int count;
+		if ((timing.op >> 24) == GE_CMD_PRIM) {
+			name = primNames[(timing.op >> 16) & 7];
+			count = timing.op & 0xFFFF;
+		} else {
+			name = (timing.op >> 24) == GE_CMD_BEZIER ? "bezier" : "spline";
+			count = (timing.op & 0xFF) * ((timing.op >> 8) & 0xFF);
+		}
+		fprintf(f, "%6d %8u %-10s %6d %6d %08x %10.1f\n", timing.frame, timing.command, name, count, timing.prims, timing.vertType, timing.seconds * 1000000.0);
+	}
+	fprintf(f, "\n");
+	fclose(f);
+
+	replayFrame = 0;
+	drawTimings.clear();
+	return true;
 }
 
 };
@@ -23,7 +23,8 @@
 namespace GPURecord {
 
 bool IsActive();
-void Activate();
+// Starts recording at the next frame, for the given number of frames.
+void Activate(int frames = 1);
 
 void NotifyCommand(u32 pc);
 void NotifyMemcpy(u32 dest, u32 src, u32 sz);
@@ -33,4 +34,9 @@ void NotifyFrame();
 
 bool RunMountedReplay(const std::string &filename);
 
+// Times each block of draws during replay, to find the expensive ones.
+void SetReplayTiming(bool enable);
+// Appends the slowest timed draws to filename, and resets the timings.
+bool WriteReplayTimingReport(const std::string &filename, const std::string &title, int maxDraws);
+
 };
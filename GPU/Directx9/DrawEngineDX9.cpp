@@ -15,6 +15,8 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#include <algorithm>
+
 #include "base/logging.h"
 #include "base/timeutil.h"
 
@@ -69,7 +71,11 @@ inline int D3DPrimCount(D3DPRIMITIVETYPE prim, int size) {
 }
 
 enum {
-	TRANSFORMED_VERTEX_BUFFER_SIZE = VERTEX_BUFFER_MAX * sizeof(TransformedVertex)
+	TRANSFORMED_VERTEX_BUFFER_SIZE = VERTEX_BUFFER_MAX * sizeof(TransformedVertex),
+	VERTEX_PUSH_SIZE = 1024 * 1024 * 8,
+	INDEX_PUSH_SIZE = 1024 * 1024 * 2,
+	VERTEX_CACHE_CHUNK_SIZE = 1024 * 1024 * 4,
+	INDEX_CACHE_CHUNK_SIZE = 1024 * 1024 * 1,
 };
 
 #define VERTEXCACHE_DECIMATION_INTERVAL 17
@@ -125,11 +131,171 @@ DrawEngineDX9::~DrawEngineDX9() {
 }
 
 void DrawEngineDX9::InitDeviceObjects() {
-
+	if (FAILED(device_->CreateVertexBuffer(VERTEX_PUSH_SIZE, D3DUSAGE_DYNAMIC | D3DUSAGE_WRITEONLY, 0, D3DPOOL_DEFAULT, &pushVerts_, NULL))) {
+		ERROR_LOG(G3D, "Failed to create dynamic vertex buffer, falling back to user pointer draws");
+		pushVerts_ = nullptr;
+	}
+	if (FAILED(device_->CreateIndexBuffer(INDEX_PUSH_SIZE, D3DUSAGE_DYNAMIC | D3DUSAGE_WRITEONLY, D3DFMT_INDEX16, D3DPOOL_DEFAULT, &pushInds_, NULL))) {
+		ERROR_LOG(G3D, "Failed to create dynamic index buffer, falling back to user pointer draws");
+		pushInds_ = nullptr;
+	}
+	// Start with a DISCARD.
+	pushVertsPos_ = VERTEX_PUSH_SIZE;
+	pushIndsPos_ = INDEX_PUSH_SIZE;
 }
 
 void DrawEngineDX9::DestroyDeviceObjects() {
 	ClearTrackedVertexArrays();
+	for (auto &c : cachedVerts_)
+		c.buffer->Release();
+	cachedVerts_.clear();
+	for (auto &c : cachedInds_)
+		c.buffer->Release();
+	cachedInds_.clear();
+	if (pushVerts_) {
+		pushVerts_->Release();
+		pushVerts_ = nullptr;
+	}
+	if (pushInds_) {
+		pushInds_->Release();
+		pushInds_ = nullptr;
+	}
+}
+
+int DrawEngineDX9::PushVerts(const void *data, u32 size, u32 stride) {
+	if (!pushVerts_ || size > VERTEX_PUSH_SIZE)
+		return -1;
+	// Keep the start on a whole vertex so it can be passed as a base vertex.
+	u32 pos = ((pushVertsPos_ + stride - 1) / stride) * stride;
+	DWORD flags = D3DLOCK_NOOVERWRITE;
+	if (pos + size > VERTEX_PUSH_SIZE) {
+		pos = 0;
+		flags = D3DLOCK_DISCARD;
+	}
+	void *dest;
+	if (FAILED(pushVerts_->Lock(pos, size, &dest, flags)))
+		return -1;
+	memcpy(dest, data, size);
+	pushVerts_->Unlock();
+	pushVertsPos_ = pos + size;
+	return pos / stride;
+}
+
+int DrawEngineDX9::PushInds(const u16 *data, u32 count) {
+	u32 size = count * sizeof(u16);
+	if (!pushInds_ || size > INDEX_PUSH_SIZE)
+		return -1;
+	u32 pos = pushIndsPos_;
+	DWORD flags = D3DLOCK_NOOVERWRITE;
+	if (pos + size > INDEX_PUSH_SIZE) {
+		pos = 0;
+		flags = D3DLOCK_DISCARD;
+	}
+	void *dest;
+	if (FAILED(pushInds_->Lock(pos, size, &dest, flags)))
+		return -1;
+	memcpy(dest, data, size);
+	pushInds_->Unlock();
+	pushIndsPos_ = pos + size;
+	return pos / sizeof(u16);
+}
+
+bool DrawEngineDX9::AllocCachedVerts(VertexArrayInfoDX9 *vai, const void *data, u32 size, u32 stride) {
+	// Sub-allocations are only 16-byte aligned, so pad by a vertex and start on the first whole one.
+	// That way the draw can use a base vertex rather than needing stream offset support.
+	u32 allocSize = size + stride;
+	u32 offset;
+	CachedBufferChunk<IDirect3DVertexBuffer9> *chunk = nullptr;
+	for (auto &c : cachedVerts_) {
+		if (c.alloc.Alloc(allocSize, 16, &offset)) {
+			chunk = &c;
+			break;
+		}
+	}
+	if (!chunk) {
+		// Oversized arrays get a chunk of their own.
+		u32 chunkSize = std::max((u32)VERTEX_CACHE_CHUNK_SIZE, (allocSize + 15) & ~15);
+		LPDIRECT3DVERTEXBUFFER9 buffer;
+		if (FAILED(device_->CreateVertexBuffer(chunkSize, D3DUSAGE_WRITEONLY, 0, D3DPOOL_DEFAULT, &buffer, NULL)))
+			return false;
+		cachedVerts_.push_back({ buffer, BufferSubAllocator(chunkSize) });
+		chunk = &cachedVerts_.back();
+		chunk->alloc.Alloc(allocSize, 16, &offset);
+	}
+	u32 baseVertex = (offset + stride - 1) / stride;
+	void *dest;
+	if (FAILED(chunk->buffer->Lock(baseVertex * stride, size, &dest, 0))) {
+		chunk->alloc.Free(offset, allocSize);
+		return false;
+	}
+	memcpy(dest, data, size);
+	chunk->buffer->Unlock();
+	vai->vbo = chunk->buffer;
+	vai->vboOffset = offset;
+	vai->vboSize = allocSize;
+	vai->baseVertex = baseVertex;
+	return true;
+}
+
+LPDIRECT3DINDEXBUFFER9 DrawEngineDX9::AllocCachedInds(const void *data, u32 size, u32 *offset) {
+	CachedBufferChunk<IDirect3DIndexBuffer9> *chunk = nullptr;
+	for (auto &c : cachedInds_) {
+		if (c.alloc.Alloc(size, 16, offset)) {
+			chunk = &c;
+			break;
+		}
+	}
+	if (!chunk) {
+		u32 chunkSize = std::max((u32)INDEX_CACHE_CHUNK_SIZE, (size + 15) & ~15);
+		LPDIRECT3DINDEXBUFFER9 buffer;
+		if (FAILED(device_->CreateIndexBuffer(chunkSize, D3DUSAGE_WRITEONLY, D3DFMT_INDEX16, D3DPOOL_DEFAULT, &buffer, NULL)))
+			return nullptr;
+		cachedInds_.push_back({ buffer, BufferSubAllocator(chunkSize) });
+		chunk = &cachedInds_.back();
+		chunk->alloc.Alloc(size, 16, offset);
+	}
+	void *dest;
+	if (FAILED(chunk->buffer->Lock(*offset, size, &dest, 0))) {
+		chunk->alloc.Free(*offset, size);
+		return nullptr;
+	}
+	memcpy(dest, data, size);
+	chunk->buffer->Unlock();
+	return chunk->buffer;
+}
+
+template <class T>
+void DrawEngineDX9::FreeCachedBuffer(std::vector<CachedBufferChunk<T>> &chunks, T *buffer, u32 offset, u32 size) {
+	for (auto &c : chunks) {
+		if (c.buffer == buffer) {
+			c.alloc.Free(offset, size);
+			return;
+		}
+	}
+}
+
+template <class T>
+void DrawEngineDX9::DecimateCachedBuffers(std::vector<CachedBufferChunk<T>> &chunks) {
+	// Keep the first chunk around even if empty, it'll be needed again soon.
+	for (size_t i = 1; i < chunks.size(); ) {
+		if (chunks[i].alloc.IsEmpty()) {
+			chunks[i].buffer->Release();
+			chunks.erase(chunks.begin() + i);
+		} else {
+			++i;
+		}
+	}
+}
+
+void DrawEngineDX9::FreeVertexArray(VertexArrayInfoDX9 *vai) {
+	if (vai->vbo) {
+		FreeCachedBuffer(cachedVerts_, vai->vbo, vai->vboOffset, vai->vboSize);
+		vai->vbo = nullptr;
+	}
+	if (vai->ebo) {
+		FreeCachedBuffer(cachedInds_, vai->ebo, vai->eboOffset, vai->eboSize);
+		vai->ebo = nullptr;
+	}
 }
 
 struct DeclTypeInfo {
@@ -224,18 +390,12 @@ IDirect3DVertexDeclaration9 *DrawEngineDX9::SetupDecFmtForDraw(VSShader *vshader
 
 void DrawEngineDX9::MarkUnreliable(VertexArrayInfoDX9 *vai) {
 	vai->status = VertexArrayInfoDX9::VAI_UNRELIABLE;
-	if (vai->vbo) {
-		vai->vbo->Release();
-		vai->vbo = nullptr;
-	}
-	if (vai->ebo) {
-		vai->ebo->Release();
-		vai->ebo = nullptr;
-	}
+	FreeVertexArray(vai);
 }
 
 void DrawEngineDX9::ClearTrackedVertexArrays() {
 	vai_.Iterate([&](uint32_t hash, DX9::VertexArrayInfoDX9 *vai) {
+		FreeVertexArray(vai);
 		delete vai;
 	});
 	vai_.Clear();
@@ -260,11 +420,14 @@ void DrawEngineDX9::DecimateTrackedVertexArrays() {
 			kill = vai->lastFrame < threshold;
 		}
 		if (kill) {
+			FreeVertexArray(vai);
 			delete vai;
 			vai_.Remove(hash);
 		}
 	});
 	vai_.Maintain();
+	DecimateCachedBuffers(cachedVerts_);
+	DecimateCachedBuffers(cachedInds_);
 
 	// Enable if you want to see vertex decoders in the log output. Need a better way.
 #if 0
@@ -278,15 +441,6 @@ void DrawEngineDX9::DecimateTrackedVertexArrays() {
 #endif
 }
 
-VertexArrayInfoDX9::~VertexArrayInfoDX9() {
-	if (vbo) {
-		vbo->Release();
-	}
-	if (ebo) {
-		ebo->Release();
-	}
-}
-
 static uint32_t SwapRB(uint32_t c) {
 	return (c & 0xFF00FF00) | ((c >> 16) & 0xFF) | ((c << 16) & 0xFF0000);
 }
@@ -307,6 +461,8 @@ void DrawEngineDX9::DoFlush() {
 	if (vshader->UseHWTransform()) {
 		LPDIRECT3DVERTEXBUFFER9 vb_ = NULL;
 		LPDIRECT3DINDEXBUFFER9 ib_ = NULL;
+		u32 baseVertex = 0;
+		u32 startIndex = 0;
 
 		int vertexCount = 0;
 		int maxIndex = 0;
@@ -330,11 +486,7 @@ void DrawEngineDX9::DoFlush() {
 			case VertexArrayInfoDX9::VAI_NEW:
 				{
 					// Haven't seen this one before.
-					ReliableHashType dataHash = ComputeHash();
-					vai->hash = dataHash;
-					vai->minihash = ComputeMiniHash();
-					vai->status = VertexArrayInfoDX9::VAI_HASHING;
-					vai->drawsUntilNextFullHash = 0;
+					SetupNewVertexArray(vai);
 					DecodeVerts(decoded); // writes to indexGen
 					vai->numVerts = indexGen.VertexCount();
 					vai->prim = indexGen.Prim();
@@ -348,41 +500,10 @@ void DrawEngineDX9::DoFlush() {
 				// But if we get this far it's likely to be worth creating a vertex buffer.
 			case VertexArrayInfoDX9::VAI_HASHING:
 				{
-					vai->numDraws++;
-					if (vai->lastFrame != gpuStats.numFlips) {
-						vai->numFrames++;
-					}
-					if (vai->drawsUntilNextFullHash == 0) {
-						// Let's try to skip a full hash if mini would fail.
-						const u32 newMiniHash = ComputeMiniHash();
-						ReliableHashType newHash = vai->hash;
-						if (newMiniHash == vai->minihash) {
-							newHash = ComputeHash();
-						}
-						if (newMiniHash != vai->minihash || newHash != vai->hash) {
-							MarkUnreliable(vai);
-							DecodeVerts(decoded);
-							goto rotateVBO;
-						}
-						if (vai->numVerts > 64) {
-							// exponential backoff up to 16 draws, then every 24
-							vai->drawsUntilNextFullHash = std::min(24, vai->numFrames);
-						} else {
-							// Lower numbers seem much more likely to change.
-							vai->drawsUntilNextFullHash = 0;
-						}
-						// TODO: tweak
-						//if (vai->numFrames > 1000) {
-						//	vai->status = VertexArrayInfo::VAI_RELIABLE;
-						//}
-					} else {
-						vai->drawsUntilNextFullHash--;
-						u32 newMiniHash = ComputeMiniHash();
-						if (newMiniHash != vai->minihash) {
-							MarkUnreliable(vai);
-							DecodeVerts(decoded);
-							goto rotateVBO;
-						}
+					if (!CheckVertexArray(vai, 24)) {
+						MarkUnreliable(vai);
+						DecodeVerts(decoded);
+						goto rotateVBO;
 					}
 
 					if (vai->vbo == 0) {
@@ -398,19 +519,18 @@ void DrawEngineDX9::DoFlush() {
 
 						_dbg_assert_msg_(G3D, gstate_c.vertBounds.minV >= gstate_c.vertBounds.maxV, "Should not have checked UVs when caching.");
 
-						void * pVb;
-						u32 size = dec_->GetDecVtxFmt().stride * indexGen.MaxIndex();
-						device_->CreateVertexBuffer(size, D3DUSAGE_WRITEONLY, 0, D3DPOOL_DEFAULT, &vai->vbo, NULL);
-						vai->vbo->Lock(0, size, &pVb, 0);
-						memcpy(pVb, decoded, size);
-						vai->vbo->Unlock();
-						if (useElements) {
-							void * pIb;
+						u32 size = dec_->GetDecVtxFmt().stride * (indexGen.MaxIndex() + 1);
+						AllocCachedVerts(vai, decoded, size, dec_->GetDecVtxFmt().stride);
+						gpuStats.numVertexCacheUploadBytes += size;
+						if (useElements && vai->vbo) {
 							u32 size = sizeof(short) * indexGen.VertexCount();
-							device_->CreateIndexBuffer(size, D3DUSAGE_WRITEONLY, D3DFMT_INDEX16, D3DPOOL_DEFAULT, &vai->ebo, NULL);
-							vai->ebo->Lock(0, size, &pIb, 0);
-							memcpy(pIb, decIndex, size);
-							vai->ebo->Unlock();
+							vai->ebo = AllocCachedInds(decIndex, size, &vai->eboOffset);
+							vai->eboSize = size;
+							gpuStats.numVertexCacheUploadBytes += size;
+							if (!vai->ebo) {
+								// Out of memory, just push this one.
+								FreeVertexArray(vai);
+							}
 						} else {
 							vai->ebo = 0;
 						}
@@ -422,6 +542,8 @@ void DrawEngineDX9::DoFlush() {
 					}
 					vb_ = vai->vbo;
 					ib_ = vai->ebo;
+					baseVertex = vai->baseVertex;
+					startIndex = vai->eboOffset / sizeof(u16);
 					vertexCount = vai->numVerts;
 					maxIndex = vai->maxIndex;
 					prim = static_cast<GEPrimitiveType>(vai->prim);
@@ -439,6 +561,8 @@ void DrawEngineDX9::DoFlush() {
 					gpuStats.numCachedVertsDrawn += vai->numVerts;
 					vb_ = vai->vbo;
 					ib_ = vai->ebo;
+					baseVertex = vai->baseVertex;
+					startIndex = vai->eboOffset / sizeof(u16);
 
 					vertexCount = vai->numVerts;
 
@@ -455,6 +579,7 @@ void DrawEngineDX9::DoFlush() {
 					if (vai->lastFrame != gpuStats.numFlips) {
 						vai->numFrames++;
 					}
+					gpuStats.numVertexCacheMisses++;
 					DecodeVerts(decoded);
 					goto rotateVBO;
 				}
@@ -488,21 +613,34 @@ void DrawEngineDX9::DoFlush() {
 
 		if (pHardwareVertexDecl) {
 			device_->SetVertexDeclaration(pHardwareVertexDecl);
+			int stride = dec_->GetDecVtxFmt().stride;
 			if (vb_ == NULL) {
-				if (useElements) {
-					device_->DrawIndexedPrimitiveUP(glprim[prim], 0, maxIndex + 1, D3DPrimCount(glprim[prim], vertexCount), decIndex, D3DFMT_INDEX16, decoded, dec_->GetDecVtxFmt().stride);
+				int firstVertex = PushVerts(decoded, (maxIndex + 1) * stride, stride);
+				int firstIndex = useElements && firstVertex >= 0 ? PushInds(decIndex, vertexCount) : 0;
+				if (firstVertex < 0 || firstIndex < 0) {
+					if (useElements) {
+						device_->DrawIndexedPrimitiveUP(glprim[prim], 0, maxIndex + 1, D3DPrimCount(glprim[prim], vertexCount), decIndex, D3DFMT_INDEX16, decoded, stride);
+					} else {
+						device_->DrawPrimitiveUP(glprim[prim], D3DPrimCount(glprim[prim], vertexCount), decoded, stride);
+					}
 				} else {
-					device_->DrawPrimitiveUP(glprim[prim], D3DPrimCount(glprim[prim], vertexCount), decoded, dec_->GetDecVtxFmt().stride);
+					device_->SetStreamSource(0, pushVerts_, 0, stride);
+					if (useElements) {
+						device_->SetIndices(pushInds_);
+						device_->DrawIndexedPrimitive(glprim[prim], firstVertex, 0, maxIndex + 1, firstIndex, D3DPrimCount(glprim[prim], vertexCount));
+					} else {
+						device_->DrawPrimitive(glprim[prim], firstVertex, D3DPrimCount(glprim[prim], vertexCount));
+					}
 				}
 			} else {
-				device_->SetStreamSource(0, vb_, 0, dec_->GetDecVtxFmt().stride);
+				device_->SetStreamSource(0, vb_, 0, stride);
 
 				if (useElements) {
 					device_->SetIndices(ib_);
 
-					device_->DrawIndexedPrimitive(glprim[prim], 0, 0, maxIndex + 1, 0, D3DPrimCount(glprim[prim], vertexCount));
+					device_->DrawIndexedPrimitive(glprim[prim], baseVertex, 0, maxIndex + 1, startIndex, D3DPrimCount(glprim[prim], vertexCount));
 				} else {
-					device_->DrawPrimitive(glprim[prim], 0, D3DPrimCount(glprim[prim], vertexCount));
+					device_->DrawPrimitive(glprim[prim], baseVertex, D3DPrimCount(glprim[prim], vertexCount));
 				}
 			}
 		}
@@ -557,10 +695,22 @@ void DrawEngineDX9::DoFlush() {
 			const int vertexSize = sizeof(transformed[0]);
 
 			device_->SetVertexDeclaration(transformedVertexDecl_);
-			if (drawIndexed) {
-				device_->DrawIndexedPrimitiveUP(glprim[prim], 0, maxIndex, D3DPrimCount(glprim[prim], numTrans), inds, D3DFMT_INDEX16, drawBuffer, sizeof(TransformedVertex));
+			int firstVertex = PushVerts(drawBuffer, (drawIndexed ? maxIndex : numTrans) * vertexSize, vertexSize);
+			int firstIndex = drawIndexed && firstVertex >= 0 ? PushInds(inds, numTrans) : 0;
+			if (firstVertex < 0 || firstIndex < 0) {
+				if (drawIndexed) {
+					device_->DrawIndexedPrimitiveUP(glprim[prim], 0, maxIndex, D3DPrimCount(glprim[prim], numTrans), inds, D3DFMT_INDEX16, drawBuffer, sizeof(TransformedVertex));
+				} else {
+					device_->DrawPrimitiveUP(glprim[prim], D3DPrimCount(glprim[prim], numTrans), drawBuffer, sizeof(TransformedVertex));
+				}
 			} else {
-				device_->DrawPrimitiveUP(glprim[prim], D3DPrimCount(glprim[prim], numTrans), drawBuffer, sizeof(TransformedVertex));
+				device_->SetStreamSource(0, pushVerts_, 0, vertexSize);
+				if (drawIndexed) {
+					device_->SetIndices(pushInds_);
+					device_->DrawIndexedPrimitive(glprim[prim], firstVertex, 0, maxIndex, firstIndex, D3DPrimCount(glprim[prim], numTrans));
+				} else {
+					device_->DrawPrimitive(glprim[prim], firstVertex, D3DPrimCount(glprim[prim], numTrans));
+				}
 			}
 		} else if (result.action == SW_CLEAR) {
 			u32 clearColor = result.color;
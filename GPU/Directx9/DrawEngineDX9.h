@@ -54,47 +54,22 @@ enum {
 };
 
 // Try to keep this POD.
-class VertexArrayInfoDX9 {
+class VertexArrayInfoDX9 : public VertexArrayInfoCommon {
 public:
 	VertexArrayInfoDX9() {
-		status = VAI_NEW;
 		vbo = 0;
 		ebo = 0;
-		prim = GE_PRIM_INVALID;
-		numDraws = 0;
-		numFrames = 0;
-		lastFrame = gpuStats.numFlips;
-		numVerts = 0;
-		drawsUntilNextFullHash = 0;
-		flags = 0;
 	}
-	~VertexArrayInfoDX9();
-
-	enum Status : uint8_t {
-		VAI_NEW,
-		VAI_HASHING,
-		VAI_RELIABLE,  // cache, don't hash
-		VAI_UNRELIABLE,  // never cache
-	};
-
-	ReliableHashType hash;
-	u32 minihash;
 
+	// Not owned, these point into the draw engine's cached buffer chunks.
 	LPDIRECT3DVERTEXBUFFER9 vbo;
 	LPDIRECT3DINDEXBUFFER9 ebo;
-
-	// Precalculated parameter for drawRangeElements
-	u16 numVerts;
-	u16 maxIndex;
-	s8 prim;
-	Status status;
-
-	// ID information
-	int numDraws;
-	int numFrames;
-	int lastFrame;  // So that we can forget.
-	u16 drawsUntilNextFullHash;
-	u8 flags;
+	u32 vboOffset = 0;
+	u32 vboSize = 0;
+	u32 eboOffset = 0;
+	u32 eboSize = 0;
+	// First vertex of the data within vbo, the offset isn't necessarily a multiple of the stride.
+	u32 baseVertex = 0;
 };
 
 // Handles transform, lighting and drawing.
@@ -143,10 +118,36 @@ class DrawEngineDX9 : public DrawEngineCommon {
 	IDirect3DVertexDeclaration9 *SetupDecFmtForDraw(VSShader *vshader, const DecVtxFormat &decFmt, u32 pspFmt);
 
 	void MarkUnreliable(VertexArrayInfoDX9 *vai);
+	void FreeVertexArray(VertexArrayInfoDX9 *vai);
+
+	// Cached vertex arrays are sub-allocated from a few big WRITEONLY buffers rather than one buffer each.
+	template <class T>
+	struct CachedBufferChunk {
+		T *buffer;
+		BufferSubAllocator alloc;
+	};
+	bool AllocCachedVerts(VertexArrayInfoDX9 *vai, const void *data, u32 size, u32 stride);
+	LPDIRECT3DINDEXBUFFER9 AllocCachedInds(const void *data, u32 size, u32 *offset);
+	template <class T>
+	void FreeCachedBuffer(std::vector<CachedBufferChunk<T>> &chunks, T *buffer, u32 offset, u32 size);
+	template <class T>
+	void DecimateCachedBuffers(std::vector<CachedBufferChunk<T>> &chunks);
+
+	// Uncached data goes through a DYNAMIC ring, appended with NOOVERWRITE and DISCARDed on wrap.
+	// These return the first vertex / index written, or -1 if it doesn't fit.
+	int PushVerts(const void *data, u32 size, u32 stride);
+	int PushInds(const u16 *data, u32 count);
 
 	LPDIRECT3DDEVICE9 device_ = nullptr;
 
 	PrehashMap<VertexArrayInfoDX9 *, nullptr> vai_;
+	std::vector<CachedBufferChunk<IDirect3DVertexBuffer9>> cachedVerts_;
+	std::vector<CachedBufferChunk<IDirect3DIndexBuffer9>> cachedInds_;
+
+	LPDIRECT3DVERTEXBUFFER9 pushVerts_ = nullptr;
+	LPDIRECT3DINDEXBUFFER9 pushInds_ = nullptr;
+	u32 pushVertsPos_ = 0;
+	u32 pushIndsPos_ = 0;
 	DenseHashMap<u32, IDirect3DVertexDeclaration9 *, nullptr> vertexDeclMap_;
 
 	// SimpleVertex
@@ -467,7 +467,7 @@ static const D3DVERTEXELEMENT9 g_FramebufferVertexElements[] = {
 	bool FramebufferManagerDX9::CreateDownloadTempBuffer(VirtualFramebuffer *nvfb) {
 		nvfb->colorDepth = Draw::FBO_8888;
 
-		nvfb->fbo = draw_->CreateFramebuffer({ nvfb->width, nvfb->height, 1, 1, true, (Draw::FBColorDepth)nvfb->colorDepth });
+		nvfb->fbo = AllocFramebuffer({ nvfb->width, nvfb->height, 1, 1, true, (Draw::FBColorDepth)nvfb->colorDepth });
 		if (!(nvfb->fbo)) {
 			ERROR_LOG(FRAMEBUF, "Error creating FBO! %i x %i", nvfb->renderWidth, nvfb->renderHeight);
 			return false;
@@ -720,6 +720,7 @@ static const D3DVERTEXELEMENT9 g_FramebufferVertexElements[] = {
 		offscreenSurfaces_.clear();
 
 		SetNumExtraFBOs(0);
+		ClearFramebufferPool();
 	}
 
 	void FramebufferManagerDX9::Resized() {
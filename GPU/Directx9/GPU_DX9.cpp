@@ -18,6 +18,7 @@
 #include <set>
 
 #include "Common/ChunkFile.h"
+#include "Common/FileUtil.h"
 #include "Common/GraphicsContext.h"
 #include "base/NativeApp.h"
 #include "base/logging.h"
@@ -28,6 +29,7 @@
 #include "Core/MIPS/MIPS.h"
 #include "Core/Host.h"
 #include "Core/Config.h"
+#include "Core/ELF/ParamSFO.h"
 #include "Core/Reporting.h"
 #include "Core/System.h"
 
@@ -92,6 +94,14 @@ GPU_DX9::GPU_DX9(GraphicsContext *gfxCtx, Draw::DrawContext *draw)
 	dxstate.Restore();
 	textureCache_->NotifyConfigChanged();
 
+	// Load shader cache. Has to be after CheckGPUFeatures(), the feature flags are part of the key.
+	std::string discID = g_paramSFO.GetDiscID();
+	if (discID.size()) {
+		File::CreateFullPath(GetSysDirectory(DIRECTORY_APP_CACHE));
+		shaderCachePath_ = GetSysDirectory(DIRECTORY_APP_CACHE) + "/" + discID + ".dx9shadercache";
+		shaderManagerDX9_->LoadCache(shaderCachePath_);
+	}
+
 	if (g_Config.bHardwareTessellation) {
 		// Disable hardware tessellation bacause DX9 is still unsupported.
 		g_Config.bHardwareTessellation = false;
@@ -149,6 +159,9 @@ void GPU_DX9::CheckGPUFeatures() {
 }
 
 GPU_DX9::~GPU_DX9() {
+	if (!shaderCachePath_.empty()) {
+		shaderManagerDX9_->SaveCache(shaderCachePath_);
+	}
 	framebufferManagerDX9_->DestroyAllFBOs();
 	delete framebufferManagerDX9_;
 	delete textureCache_;
@@ -221,6 +234,11 @@ void GPU_DX9::BeginFrame() {
 	GPUCommon::BeginFrame();
 	shaderManagerDX9_->DirtyShader();
 
+	// Save the cache from time to time, in case we don't get to exit cleanly.
+	if (!shaderCachePath_.empty() && (gpuStats.numFlips & 4095) == 0) {
+		shaderManagerDX9_->SaveCache(shaderCachePath_);
+	}
+
 	framebufferManager_->BeginFrame();
 }
 
@@ -255,7 +273,7 @@ inline void GPU_DX9::CheckFlushOp(int cmd, u32 diff) {
 		if (dumpThisFrame_) {
 			NOTICE_LOG(G3D, "================ FLUSH ================");
 		}
-		drawEngine_.Flush();
+		FlushBeforeStateChange(cmd);
 	}
 }
 
@@ -287,9 +305,16 @@ void GPU_DX9::GetStats(char *buffer, size_t bufsize) {
 		"Commands per call level: %i %i %i %i\n"
 		"Vertices submitted: %i\n"
 		"Cached, Uncached Vertices Drawn: %i, %i\n"
-		"FBOs active: %i\n"
-		"Textures active: %i, decoded: %i  invalidated: %i\n"
-		"Readbacks: %d, uploads: %d\n"
+		"Vertex cache hits: %i, misses: %i, uploaded: %i KB\n"
+		"Vertex decoder JIT fallbacks: %i formats, %i verts\n"
+		"Skinned draws: %i, verts: %i (%i by fallback)\n"
+		"Flushes for state: %i, prim: %i, full: %i, merged state changes: %i\n"
+		"Bounding box tests: %i, culled: %i\n"
+		"FBOs active: %i, created: %i, reused from pool: %i\n"
+		"Textures active: %i, decoded: %i  invalidated: %i  unwritten: %i  sampled: %i\n"
+		"Texture memory: %0.1f MB, budget: %i MB\n"
+		"Readbacks: %d (%d async, %0.2f ms stalled), uploads: %d\n"
+		"Block transfers: %d GPU, %d CPU (%d downloads, %d uploads)\n"
 		"Vertex, Fragment shaders loaded: %i, %i\n",
 		gpuStats.msProcessingDisplayLists * 1000.0f,
 		gpuStats.numDrawCalls,
@@ -303,12 +328,38 @@ void GPU_DX9::GetStats(char *buffer, size_t bufsize) {
 		gpuStats.numVertsSubmitted,
 		gpuStats.numCachedVertsDrawn,
 		gpuStats.numUncachedVertsDrawn,
+		gpuStats.numCachedDrawCalls,
+		gpuStats.numVertexCacheMisses,
+		gpuStats.numVertexCacheUploadBytes / 1024,
+		gpuStats.numJitFallbackDecoders,
+		gpuStats.numVertsDecodedByFallback,
+		gpuStats.numSkinnedDrawCalls,
+		gpuStats.numSkinnedVerts,
+		gpuStats.numSkinnedVertsByFallback,
+		gpuStats.numStateFlushes,
+		gpuStats.numPrimFlushes,
+		gpuStats.numFullFlushes,
+		gpuStats.numMergedStateChanges,
+		gpuStats.numBBoxTests,
+		gpuStats.numBBoxCulled,
 		(int)framebufferManagerDX9_->NumVFBs(),
+		gpuStats.numFBOsCreated,
+		gpuStats.numPooledFBOsReused,
 		(int)textureCacheDX9_->NumLoadedTextures(),
 		gpuStats.numTexturesDecoded,
 		gpuStats.numTextureInvalidations,
+		gpuStats.numTextureHashesSkipped,
+		gpuStats.numTextureHashesSampled,
+		textureCacheDX9_->MemoryUsage() / (1024.0f * 1024.0f),
+		(int)(textureCacheDX9_->MemoryBudget() / (1024 * 1024)),
 		gpuStats.numReadbacks,
+		gpuStats.numAsyncReadbacks,
+		gpuStats.msReadbackStall,
 		gpuStats.numUploads,
+		gpuStats.numBlockTransfersGPU,
+		gpuStats.numBlockTransfersCPU,
+		gpuStats.numBlockTransferDownloads,
+		gpuStats.numBlockTransferUploads,
 		shaderManagerDX9_->GetNumVertexShaders(),
 		shaderManagerDX9_->GetNumFragmentShaders()
 	);
@@ -327,7 +378,7 @@ void GPU_DX9::DoState(PointerWrap &p) {
 
 	// TODO: Some of these things may not be necessary.
 	// None of these are necessary when saving.
-	if (p.mode == p.MODE_READ && !PSP_CoreParameter().frozen) {
+	if (p.mode == p.MODE_READ && !PSP_CoreParameter().frozen && !PSP_CoreParameter().runningAhead) {
 		textureCacheDX9_->Clear(true);
 		drawEngine_.ClearTrackedVertexArrays();
 
@@ -19,6 +19,7 @@
 
 #include <list>
 #include <deque>
+#include <string>
 
 #include "GPU/GPUCommon.h"
 #include "GPU/Directx9/FramebufferDX9.h"
@@ -83,6 +84,8 @@ class GPU_DX9 : public GPUCommon {
 
 	int lastVsync_;
 	int vertexCost_ = 0;
+
+	std::string shaderCachePath_;
 };
 
 }  // namespace DX9
@@ -29,6 +29,7 @@
 #include "util/text/utf8.h"
 
 #include "Common/Common.h"
+#include "Common/FileUtil.h"
 #include "Core/Config.h"
 #include "Core/Host.h"
 #include "Core/Reporting.h"
@@ -49,7 +50,7 @@ PSShader::PSShader(LPDIRECT3DDEVICE9 device, FShaderID id, const char *code) : i
 	bool success;
 	std::string errorMessage;
 
-	success = CompilePixelShader(device, code, &shader, NULL, errorMessage);
+	success = CompilePixelShader(device, code, &shader, NULL, errorMessage, &bytecode_);
 
 	if (!errorMessage.empty()) {
 		if (success) {
@@ -75,6 +76,15 @@ PSShader::PSShader(LPDIRECT3DDEVICE9 device, FShaderID id, const char *code) : i
 	}
 }
 
+PSShader::PSShader(LPDIRECT3DDEVICE9 device, FShaderID id, const char *code, const std::vector<uint8_t> &bytecode) : id_(id), shader(nullptr), failed_(false) {
+	source_ = code;
+	bytecode_ = bytecode;
+	if (FAILED(device->CreatePixelShader((const DWORD *)bytecode_.data(), &shader))) {
+		shader = nullptr;
+		failed_ = true;
+	}
+}
+
 PSShader::~PSShader() {
 	if (shader)
 		shader->Release();
@@ -99,7 +109,7 @@ VSShader::VSShader(LPDIRECT3DDEVICE9 device, VShaderID id, const char *code, boo
 	bool success;
 	std::string errorMessage;
 
-	success = CompileVertexShader(device, code, &shader, NULL, errorMessage);
+	success = CompileVertexShader(device, code, &shader, NULL, errorMessage, &bytecode_);
 	if (!errorMessage.empty()) {
 		if (success) {
 			ERROR_LOG(G3D, "Warnings in shader compilation!");
@@ -124,6 +134,15 @@ VSShader::VSShader(LPDIRECT3DDEVICE9 device, VShaderID id, const char *code, boo
 	}
 }
 
+VSShader::VSShader(LPDIRECT3DDEVICE9 device, VShaderID id, const char *code, const std::vector<uint8_t> &bytecode, bool useHWTransform) : id_(id), shader(nullptr), failed_(false), useHWTransform_(useHWTransform) {
+	source_ = code;
+	bytecode_ = bytecode;
+	if (FAILED(device->CreateVertexShader((const DWORD *)bytecode_.data(), &shader))) {
+		shader = nullptr;
+		failed_ = true;
+	}
+}
+
 VSShader::~VSShader() {
 	if (shader)
 		shader->Release();
@@ -563,6 +582,7 @@ VSShader *ShaderManagerDX9::ApplyShader(int prim, u32 vertType) {
 		}
 
 		vsCache_[VSID] = vs;
+		diskCacheDirty_ = true;
 	} else {
 		vs = vsIter->second;
 	}
@@ -575,6 +595,7 @@ VSShader *ShaderManagerDX9::ApplyShader(int prim, u32 vertType) {
 		GenerateFragmentShaderHLSL(FSID, codeBuffer_);
 		fs = new PSShader(device_, FSID, codeBuffer_);
 		fsCache_[FSID] = fs;
+		diskCacheDirty_ = true;
 	} else {
 		fs = fsIter->second;
 	}
@@ -648,4 +669,131 @@ std::string ShaderManagerDX9::DebugGetShaderString(std::string id, DebugShaderTy
 	}
 }
 
+#define CACHE_HEADER_MAGIC 0xd39d5ca0
+#define CACHE_VERSION 1
+struct DX9CacheHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t compilerVersion;
+	uint32_t featureFlags;
+	int numVertexShaders;
+	int numFragmentShaders;
+};
+
+struct DX9CacheEntryHeader {
+	uint32_t flags;  // 1 = useHWTransform
+	uint32_t size;
+};
+
+void ShaderManagerDX9::LoadCache(const std::string &filename) {
+	FILE *f = File::OpenCFile(filename, "rb");
+	if (!f)
+		return;
+
+	DX9CacheHeader header{};
+	if (fread(&header, sizeof(header), 1, f) != 1 || header.magic != CACHE_HEADER_MAGIC || header.version != CACHE_VERSION) {
+		fclose(f);
+		return;
+	}
+	if (header.compilerVersion != (uint32_t)GetD3DXVersion() || header.featureFlags != gstate_c.featureFlags) {
+		fclose(f);
+		return;
+	}
+	if (header.numVertexShaders < 0 || header.numFragmentShaders < 0 || header.numVertexShaders > 4096 || header.numFragmentShaders > 4096) {
+		ERROR_LOG(G3D, "Corrupt shader cache file header, aborting.");
+		fclose(f);
+		return;
+	}
+
+	// The device isn't created multithreaded, but creating from bytecode is quick anyway.
+	// It's the compiler that's slow.
+	std::vector<uint8_t> bytecode;
+	int numLoaded = 0;
+	for (int i = 0; i < header.numVertexShaders + header.numFragmentShaders; i++) {
+		ShaderID id;
+		DX9CacheEntryHeader entry;
+		if (fread(&id, sizeof(id), 1, f) != 1 || fread(&entry, sizeof(entry), 1, f) != 1 || entry.size == 0 || entry.size > 0x100000) {
+			break;
+		}
+		bytecode.resize(entry.size);
+		if (fread(&bytecode[0], 1, entry.size, f) != entry.size) {
+			break;
+		}
+
+		if (i < header.numVertexShaders) {
+			VShaderID vsid(id);
+			if (vsCache_.find(vsid) != vsCache_.end())
+				continue;
+			GenerateVertexShaderHLSL(vsid, codeBuffer_);
+			VSShader *vs = new VSShader(device_, vsid, codeBuffer_, bytecode, (entry.flags & 1) != 0);
+			if (vs->Failed()) {
+				delete vs;
+				continue;
+			}
+			vsCache_[vsid] = vs;
+		} else {
+			FShaderID fsid(id);
+			if (fsCache_.find(fsid) != fsCache_.end())
+				continue;
+			GenerateFragmentShaderHLSL(fsid, codeBuffer_);
+			PSShader *fs = new PSShader(device_, fsid, codeBuffer_, bytecode);
+			if (fs->Failed()) {
+				delete fs;
+				continue;
+			}
+			fsCache_[fsid] = fs;
+		}
+		numLoaded++;
+	}
+	fclose(f);
+	NOTICE_LOG(G3D, "Loaded %d shaders from the cache", numLoaded);
+}
+
+void ShaderManagerDX9::SaveCache(const std::string &filename) {
+	if (!diskCacheDirty_) {
+		return;
+	}
+	FILE *f = File::OpenCFile(filename, "wb");
+	if (!f) {
+		// Can't save, give up for now.
+		diskCacheDirty_ = false;
+		return;
+	}
+
+	auto writeEntry = [&](const ShaderID &id, bool useHWTransform, const std::vector<uint8_t> &bytecode) {
+		DX9CacheEntryHeader entry;
+		entry.flags = useHWTransform ? 1 : 0;
+		entry.size = (uint32_t)bytecode.size();
+		fwrite(&id, sizeof(id), 1, f);
+		fwrite(&entry, sizeof(entry), 1, f);
+		fwrite(bytecode.data(), 1, bytecode.size(), f);
+	};
+
+	DX9CacheHeader header{};
+	header.magic = CACHE_HEADER_MAGIC;
+	header.version = CACHE_VERSION;
+	header.compilerVersion = (uint32_t)GetD3DXVersion();
+	header.featureFlags = gstate_c.featureFlags;
+	for (auto iter : vsCache_) {
+		if (!iter.second->Failed())
+			header.numVertexShaders++;
+	}
+	for (auto iter : fsCache_) {
+		if (!iter.second->Failed())
+			header.numFragmentShaders++;
+	}
+	fwrite(&header, sizeof(header), 1, f);
+	for (auto iter : vsCache_) {
+		if (!iter.second->Failed())
+			writeEntry(iter.first, iter.second->UseHWTransform(), iter.second->bytecode());
+	}
+	for (auto iter : fsCache_) {
+		if (!iter.second->Failed())
+			writeEntry(iter.first, false, iter.second->bytecode());
+	}
+	fclose(f);
+	diskCacheDirty_ = false;
+	NOTICE_LOG(G3D, "Saved %d vertex and %d fragment shaders", header.numVertexShaders, header.numFragmentShaders);
+}
+
 }  // namespace
@@ -19,6 +19,8 @@
 
 #include <map>
 #include <cstdint>
+#include <string>
+#include <vector>
 
 #include "base/basictypes.h"
 #include "GPU/Directx9/VertexShaderGeneratorDX9.h"
@@ -38,9 +40,12 @@ class VSShader;
 class PSShader {
 public:
 	PSShader(LPDIRECT3DDEVICE9 device, FShaderID id, const char *code);
+	// From the disk cache, skips the HLSL compiler.
+	PSShader(LPDIRECT3DDEVICE9 device, FShaderID id, const char *code, const std::vector<uint8_t> &bytecode);
 	~PSShader();
 
 	const std::string &source() const { return source_; }
+	const std::vector<uint8_t> &bytecode() const { return bytecode_; }
 
 	bool Failed() const { return failed_; }
 
@@ -50,6 +55,7 @@ class PSShader {
 
 protected:	
 	std::string source_;
+	std::vector<uint8_t> bytecode_;
 	bool failed_;
 	FShaderID id_;
 };
@@ -57,9 +63,12 @@ class PSShader {
 class VSShader {
 public:
 	VSShader(LPDIRECT3DDEVICE9 device, VShaderID id, const char *code, bool useHWTransform);
+	// From the disk cache, skips the HLSL compiler.
+	VSShader(LPDIRECT3DDEVICE9 device, VShaderID id, const char *code, const std::vector<uint8_t> &bytecode, bool useHWTransform);
 	~VSShader();
 
 	const std::string &source() const { return source_; }
+	const std::vector<uint8_t> &bytecode() const { return bytecode_; }
 
 	bool Failed() const { return failed_; }
 	bool UseHWTransform() const { return useHWTransform_; }
@@ -70,6 +79,7 @@ class VSShader {
 
 protected:	
 	std::string source_;
+	std::vector<uint8_t> bytecode_;
 	bool failed_;
 	bool useHWTransform_;
 	VShaderID id_;
@@ -91,6 +101,10 @@ class ShaderManagerDX9 : public ShaderManagerCommon {
 	std::vector<std::string> DebugGetShaderIDs(DebugShaderType type);
 	std::string DebugGetShaderString(std::string id, DebugShaderType type, DebugShaderStringType stringType);
 
+	// Compiled bytecode cache, only valid for the same D3DX version and feature flags.
+	void LoadCache(const std::string &filename);
+	void SaveCache(const std::string &filename);
+
 private:
 	void PSUpdateUniforms(u64 dirtyUniforms);
 	void VSUpdateUniforms(u64 dirtyUniforms);
@@ -127,6 +141,8 @@ class ShaderManagerDX9 : public ShaderManagerCommon {
 
 	typedef std::map<VShaderID, VSShader *> VSCache;
 	VSCache vsCache_;
+
+	bool diskCacheDirty_ = false;
 };
 
 };
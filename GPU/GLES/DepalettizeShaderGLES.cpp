@@ -102,6 +102,25 @@ GLRTexture *DepalShaderCacheGLES::GetClutTexture(GEPaletteFormat clutFormat, con
 	return tex->texture;
 }
 
+GLRTexture *DepalShaderCacheGLES::GetLookupClutTexture(u32 lookupId, const u32 *colors) {
+	auto oldtex = lookupTexCache_.find(lookupId);
+	if (oldtex != lookupTexCache_.end()) {
+		oldtex->second->lastFrame = gpuStats.numFlips;
+		return oldtex->second->texture;
+	}
+
+	DepalTexture *tex = new DepalTexture();
+	tex->texture = render_->CreateTexture(GL_TEXTURE_2D);
+
+	uint8_t *clutCopy = new uint8_t[1024];
+	memcpy(clutCopy, colors, 1024);
+	render_->TextureImage(tex->texture, 0, 256, 1, GL_RGBA, GL_RGBA, GL_UNSIGNED_BYTE, clutCopy, GLRAllocType::NEW, false);
+
+	tex->lastFrame = gpuStats.numFlips;
+	lookupTexCache_[lookupId] = tex;
+	return tex->texture;
+}
+
 void DepalShaderCacheGLES::Clear() {
 	for (auto shader = cache_.begin(); shader != cache_.end(); ++shader) {
 		render_->DeleteShader(shader->second->fragShader);
@@ -116,6 +135,11 @@ void DepalShaderCacheGLES::Clear() {
 		delete tex->second;
 	}
 	texCache_.clear();
+	for (auto tex = lookupTexCache_.begin(); tex != lookupTexCache_.end(); ++tex) {
+		render_->DeleteTexture(tex->second->texture);
+		delete tex->second;
+	}
+	lookupTexCache_.clear();
 	if (vertexShader_) {
 		render_->DeleteShader(vertexShader_);
 		vertexShader_ = 0;
@@ -123,11 +147,16 @@ void DepalShaderCacheGLES::Clear() {
 }
 
 void DepalShaderCacheGLES::Decimate() {
-	for (auto tex = texCache_.begin(); tex != texCache_.end(); ) {
+	DecimateTextures(texCache_);
+	DecimateTextures(lookupTexCache_);
+}
+
+void DepalShaderCacheGLES::DecimateTextures(std::map<u32, DepalTexture *> &texCache) {
+	for (auto tex = texCache.begin(); tex != texCache.end(); ) {
 		if (tex->second->lastFrame + DEPAL_TEXTURE_OLD_AGE < gpuStats.numFlips) {
 			render_->DeleteTexture(tex->second->texture);
 			delete tex->second;
-			texCache_.erase(tex++);
+			texCache.erase(tex++);
 		} else {
 			++tex;
 		}
@@ -49,6 +49,8 @@ class DepalShaderCacheGLES : public DepalShaderCacheCommon {
 	// This also uploads the palette and binds the correct texture.
 	DepalShader *GetDepalettizeShader(uint32_t clutMode, GEBufferFormat pixelFormat);
 	GLRTexture *GetClutTexture(GEPaletteFormat clutFormat, const u32 clutHash, u32 *rawClut);
+	// 256 RGBA8888 colors for the fragment shader to look up indices in, uploaded only if not already cached.
+	GLRTexture *GetLookupClutTexture(u32 lookupId, const u32 *colors);
 	void Clear();
 	void Decimate();
 	std::vector<std::string> DebugGetShaderIDs(DebugShaderType type);
@@ -56,6 +58,7 @@ class DepalShaderCacheGLES : public DepalShaderCacheCommon {
 
 private:
 	bool CreateVertexShader();
+	void DecimateTextures(std::map<u32, DepalTexture *> &texCache);
 
 	GLRenderManager *render_;
 	bool useGL3_;
@@ -63,5 +66,6 @@ class DepalShaderCacheGLES : public DepalShaderCacheCommon {
 	GLRShader *vertexShader_;
 	std::map<u32, DepalShader *> cache_;
 	std::map<u32, DepalTexture *> texCache_;
+	std::map<u32, DepalTexture *> lookupTexCache_;
 };
 
@@ -123,6 +123,16 @@ void DrawEngineGLES::InitDeviceObjects() {
 	entries.push_back({ ATTR_COLOR0, 4, GL_UNSIGNED_BYTE, GL_TRUE, vertexSize, offsetof(TransformedVertex, color0) });
 	entries.push_back({ ATTR_COLOR1, 3, GL_UNSIGNED_BYTE, GL_TRUE, vertexSize, offsetof(TransformedVertex, color1) });
 	softwareInputLayout_ = render_->CreateInputLayout(entries);
+
+	// One RectInstance per rectangle, see VS_BIT_RECT_INSTANCED. The top left corner goes in normal.
+	int rectSize = sizeof(RectInstance);
+	entries.clear();
+	entries.push_back({ ATTR_POSITION, 4, GL_FLOAT, GL_FALSE, rectSize, offsetof(RectInstance, br.x), 1 });
+	entries.push_back({ ATTR_TEXCOORD, 3, GL_FLOAT, GL_FALSE, rectSize, offsetof(RectInstance, br.u), 1 });
+	entries.push_back({ ATTR_NORMAL, 4, GL_FLOAT, GL_FALSE, rectSize, offsetof(RectInstance, tlX), 1 });
+	entries.push_back({ ATTR_COLOR0, 4, GL_UNSIGNED_BYTE, GL_TRUE, rectSize, offsetof(RectInstance, br.color0), 1 });
+	entries.push_back({ ATTR_COLOR1, 3, GL_UNSIGNED_BYTE, GL_TRUE, rectSize, offsetof(RectInstance, br.color1), 1 });
+	rectInstanceInputLayout_ = render_->CreateInputLayout(entries);
 }
 
 void DrawEngineGLES::DestroyDeviceObjects() {
@@ -146,6 +156,9 @@ void DrawEngineGLES::DestroyDeviceObjects() {
 	if (softwareInputLayout_)
 		render_->DeleteInputLayout(softwareInputLayout_);
 	softwareInputLayout_ = nullptr;
+	if (rectInstanceInputLayout_)
+		render_->DeleteInputLayout(rectInstanceInputLayout_);
+	rectInstanceInputLayout_ = nullptr;
 
 	ClearInputLayoutMap();
 }
@@ -199,6 +212,7 @@ static inline void VertexAttribSetup(int attrib, int fmt, int stride, int offset
 		const GlTypeInfo &type = GLComp[fmt];
 		GLRInputLayout::Entry entry;
 		entry.offset = offset;
+		entry.divisor = 0;
 		entry.location = attrib;
 		entry.normalized = type.normalized;
 		entry.type = type.type;
@@ -332,9 +346,6 @@ void DrawEngineGLES::DoFlush() {
 		if (lastVType_ & GE_VTYPE_WEIGHT_MASK)
 			useCache = false;
 
-		// TEMPORARY
-		useCache = false;
-
 		if (useCache) {
 			u32 id = dcid_ ^ gstate.getUVGenMode();  // This can have an effect on which UV decoder we need to use! And hence what the decoded data will look like. See #9263
 			VertexArrayInfo *vai = vai_.Get(id);
@@ -347,11 +358,7 @@ void DrawEngineGLES::DoFlush() {
 			case VertexArrayInfo::VAI_NEW:
 				{
 					// Haven't seen this one before.
-					ReliableHashType dataHash = ComputeHash();
-					vai->hash = dataHash;
-					vai->minihash = ComputeMiniHash();
-					vai->status = VertexArrayInfo::VAI_HASHING;
-					vai->drawsUntilNextFullHash = 0;
+					SetupNewVertexArray(vai);
 					DecodeVerts(decoded); // writes to indexGen
 					vai->numVerts = indexGen.VertexCount();
 					vai->prim = indexGen.Prim();
@@ -365,41 +372,10 @@ void DrawEngineGLES::DoFlush() {
 				// But if we get this far it's likely to be worth creating a vertex buffer.
 			case VertexArrayInfo::VAI_HASHING:
 				{
-					vai->numDraws++;
-					if (vai->lastFrame != gpuStats.numFlips) {
-						vai->numFrames++;
-					}
-					if (vai->drawsUntilNextFullHash == 0) {
-						// Let's try to skip a full hash if mini would fail.
-						const u32 newMiniHash = ComputeMiniHash();
-						ReliableHashType newHash = vai->hash;
-						if (newMiniHash == vai->minihash) {
-							newHash = ComputeHash();
-						}
-						if (newMiniHash != vai->minihash || newHash != vai->hash) {
-							MarkUnreliable(vai);
-							DecodeVerts(decoded);
-							goto rotateVBO;
-						}
-						if (vai->numVerts > 64) {
-							// exponential backoff up to 16 draws, then every 32
-							vai->drawsUntilNextFullHash = std::min(32, vai->numFrames);
-						} else {
-							// Lower numbers seem much more likely to change.
-							vai->drawsUntilNextFullHash = 0;
-						}
-						// TODO: tweak
-						//if (vai->numFrames > 1000) {
-						//	vai->status = VertexArrayInfo::VAI_RELIABLE;
-						//}
-					} else {
-						vai->drawsUntilNextFullHash--;
-						u32 newMiniHash = ComputeMiniHash();
-						if (newMiniHash != vai->minihash) {
-							MarkUnreliable(vai);
-							DecodeVerts(decoded);
-							goto rotateVBO;
-						}
+					if (!CheckVertexArray(vai, 32)) {
+						MarkUnreliable(vai);
+						DecodeVerts(decoded);
+						goto rotateVBO;
 					}
 
 					if (vai->vbo == 0) {
@@ -418,6 +394,7 @@ void DrawEngineGLES::DoFlush() {
 						size_t vsz = dec_->GetDecVtxFmt().stride * indexGen.MaxIndex();
 						vai->vbo = render_->CreateBuffer(GL_ARRAY_BUFFER, vsz, GL_STATIC_DRAW);
 						render_->BufferSubdata(vai->vbo, 0, vsz, decoded);
+						gpuStats.numVertexCacheUploadBytes += (int)vsz;
 						// If there's only been one primitive type, and it's either TRIANGLES, LINES or POINTS,
 						// there is no need for the index buffer we built. We can then use glDrawArrays instead
 						// for a very minor speed boost.
@@ -425,6 +402,7 @@ void DrawEngineGLES::DoFlush() {
 							size_t esz = sizeof(short) * indexGen.VertexCount();
 							vai->ebo = render_->CreateBuffer(GL_ARRAY_BUFFER, esz, GL_STATIC_DRAW);
 							render_->BufferSubdata(vai->ebo, 0, esz, (uint8_t *)decIndex, false);
+							gpuStats.numVertexCacheUploadBytes += (int)esz;
 						} else {
 							vai->ebo = 0;
 							render_->BindIndexBuffer(vai->ebo);
@@ -466,6 +444,7 @@ void DrawEngineGLES::DoFlush() {
 					if (vai->lastFrame != gpuStats.numFlips) {
 						vai->numFrames++;
 					}
+					gpuStats.numVertexCacheMisses++;
 					DecodeVerts(decoded);
 					goto rotateVBO;
 				}
@@ -552,6 +531,7 @@ void DrawEngineGLES::DoFlush() {
 		params.texCache = textureCache_;
 		params.allowClear = true;
 		params.allowSeparateAlphaClear = true;
+		params.allowRectInstances = vsid.Bit(VS_BIT_RECT_INSTANCED);
 
 		int maxIndex = indexGen.MaxIndex();
 		int vertexCount = indexGen.VertexCount();
@@ -590,6 +570,14 @@ void DrawEngineGLES::DoFlush() {
 				render_->BindVertexBuffer(softwareInputLayout_, vertexBuffer, vertexBufferOffset);
 				render_->Draw(glprim[prim], 0, numTrans);
 			}
+		} else if (result.action == SW_DRAW_RECT_INSTANCES) {
+			// Two triangles per instance, corner indices as in SoftwareTransform's expansion.
+			static const uint16_t rectInds[6] = { 0, 1, 2, 3, 0, 2 };
+			vertexBufferOffset = (uint32_t)frameData.pushVertex->Push(drawBuffer, numTrans * sizeof(RectInstance), &vertexBuffer);
+			indexBufferOffset = (uint32_t)frameData.pushIndex->Push(rectInds, sizeof(rectInds), &indexBuffer);
+			render_->BindVertexBuffer(rectInstanceInputLayout_, vertexBuffer, vertexBufferOffset);
+			render_->BindIndexBuffer(indexBuffer);
+			render_->DrawIndexed(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, (void *)(intptr_t)indexBufferOffset, numTrans);
 		} else if (result.action == SW_CLEAR) {
 			u32 clearColor = result.color;
 			float clearDepth = result.depth;
@@ -674,7 +662,7 @@ void DrawEngineGLES::TessellationDataTransferGLES::SendDataToShader(const float
 		if (data_tex[1])
 			renderManager_->DeleteTexture(data_tex[1]);
 		uint8_t *tex_data = new uint8_t[size * sizeof(float) * 4];
-		memcpy(tex_data, pos, size * sizeof(float) * 4);
+		memcpy(tex_data, tex, size * sizeof(float) * 4);
 		data_tex[1] = renderManager_->CreateTexture(GL_TEXTURE_2D);
 		renderManager_->TextureImage(data_tex[1], 0, size, 1, GL_RGBA32F, GL_RGBA, GL_FLOAT, tex_data, GLRAllocType::NEW, false);
 		renderManager_->FinalizeTexture(data_tex[1], 0, false);
@@ -57,46 +57,15 @@ enum {
 };
 
 // Try to keep this POD.
-class VertexArrayInfo {
+class VertexArrayInfo : public VertexArrayInfoCommon {
 public:
 	VertexArrayInfo() {
-		status = VAI_NEW;
 		vbo = nullptr;
 		ebo = nullptr;
-		prim = GE_PRIM_INVALID;
-		numDraws = 0;
-		numFrames = 0;
-		lastFrame = gpuStats.numFlips;
-		numVerts = 0;
-		drawsUntilNextFullHash = 0;
-		flags = 0;
 	}
 
-	enum Status : uint8_t {
-		VAI_NEW,
-		VAI_HASHING,
-		VAI_RELIABLE,  // cache, don't hash
-		VAI_UNRELIABLE,  // never cache
-	};
-
-	ReliableHashType hash;
-	u32 minihash;
-
 	GLRBuffer *vbo;
 	GLRBuffer *ebo;
-
-	// Precalculated parameter for drawRangeElements
-	u16 numVerts;
-	u16 maxIndex;
-	s8 prim;
-	Status status;
-
-	// ID information
-	int numDraws;
-	int numFrames;
-	int lastFrame;  // So that we can forget.
-	u16 drawsUntilNextFullHash;
-	u8 flags;
 };
 
 // Handles transform, lighting and drawing.
@@ -182,6 +151,7 @@ class DrawEngineGLES : public DrawEngineCommon {
 	DenseHashMap<uint32_t, GLRInputLayout *, nullptr> inputLayoutMap_;
 
 	GLRInputLayout *softwareInputLayout_ = nullptr;
+	GLRInputLayout *rectInstanceInputLayout_ = nullptr;
 	GLRenderManager *render_;
 
 	// Other
@@ -26,6 +26,7 @@
 #include "GPU/Common/GPUStateUtils.h"
 #include "GPU/Common/ShaderId.h"
 #include "GPU/GLES/FragmentShaderGeneratorGLES.h"
+#include "GPU/GLES/FragmentTestCacheGLES.h"
 #include "GPU/GLES/FramebufferManagerGLES.h"
 #include "GPU/GLES/ShaderManagerGLES.h"
 #include "GPU/ge_constants.h"
@@ -161,6 +162,7 @@ bool GenerateFragmentShader(const FShaderID &id, char *buffer, uint64_t *uniform
 	GEComparison alphaTestFunc = (GEComparison)id.Bits(FS_BIT_ALPHA_TEST_FUNC, 3);
 	GEComparison colorTestFunc = (GEComparison)id.Bits(FS_BIT_COLOR_TEST_FUNC, 2);
 	bool needShaderTexClamp = id.Bit(FS_BIT_SHADER_TEX_CLAMP);
+	bool shaderClutLookup = id.Bit(FS_BIT_SHADER_CLUT_LOOKUP);
 
 	GETexFunc texFunc = (GETexFunc)id.Bits(FS_BIT_TEXFUNC, 3);
 	bool textureAtOffset = id.Bit(FS_BIT_TEXTURE_AT_OFFSET);
@@ -172,13 +174,17 @@ bool GenerateFragmentShader(const FShaderID &id, char *buffer, uint64_t *uniform
 	GEBlendMode replaceBlendEq = (GEBlendMode)id.Bits(FS_BIT_BLENDEQ, 3);
 
 	bool isModeClear = id.Bit(FS_BIT_CLEARMODE);
+	bool useTestTexture = UseFragmentTestTexture();
 
 	const char *shading = "";
 	if (glslES30)
 		shading = doFlatShading ? "flat" : "";
 
-	if (doTexture)
+	if (doTexture) {
 		WRITE(p, "uniform sampler2D tex;\n");
+		if (shaderClutLookup)
+			WRITE(p, "uniform sampler2D pal;\n");
+	}
 
 	if (!isModeClear && replaceBlend > REPLACE_BLEND_STANDARD) {
 		*uniformMask |= DIRTY_SHADERBLEND;
@@ -205,8 +211,10 @@ bool GenerateFragmentShader(const FShaderID &id, char *buffer, uint64_t *uniform
 	}
 
 	if (enableAlphaTest || enableColorTest) {
-		if (g_Config.bFragmentTestCache) {
+		if (useTestTexture) {
+			*uniformMask |= DIRTY_FRAGMENTTEST_COORD;
 			WRITE(p, "uniform sampler2D testtex;\n");
+			WRITE(p, "uniform mediump float u_testtexcoord;\n");
 		} else {
 			*uniformMask |= DIRTY_ALPHACOLORREF;
 			WRITE(p, "uniform vec4 u_alphacolorref;\n");
@@ -239,7 +247,7 @@ bool GenerateFragmentShader(const FShaderID &id, char *buffer, uint64_t *uniform
 		WRITE(p, "%s %s vec3 v_texcoord;\n", varying, highpTexcoord ? "highp" : "mediump");
 	}
 
-	if (!g_Config.bFragmentTestCache) {
+	if (!useTestTexture) {
 		if (enableAlphaTest && !alphaTestAgainstZero) {
 			if (bitwiseOps) {
 				WRITE(p, "int roundAndScaleTo255i(in float x) { return int(floor(x * 255.0 + 0.5)); }\n");
@@ -339,6 +347,10 @@ bool GenerateFragmentShader(const FShaderID &id, char *buffer, uint64_t *uniform
 			} else {
 				WRITE(p, "  vec4 t = %s(tex, %s.xy);\n", texture, texcoord);
 			}
+			if (shaderClutLookup) {
+				// The index is normalized [0, 255], the palette is sampled at half texels like the test texture.
+				WRITE(p, "  t = %s(pal, vec2(t.r * %f + %f, 0.0));\n", texture, 255.0 / 256.0, 0.5 / 256.0);
+			}
 			WRITE(p, "  vec4 p = v_color0;\n");
 
 			if (doTextureAlpha) { // texfmt == RGBA
@@ -403,7 +415,7 @@ bool GenerateFragmentShader(const FShaderID &id, char *buffer, uint64_t *uniform
 		// Texture access is at half texels [0.5/256, 255.5/256], but colors are normalized [0, 255].
 		// So we have to scale to account for the difference.
 		std::string alphaTestXCoord = "0";
-		if (g_Config.bFragmentTestCache) {
+		if (useTestTexture) {
 			if (enableColorTest && !colorTestAgainstZero) {
 				WRITE(p, "  vec4 vScale256 = v * %f + %f;\n", 255.0 / 256.0, 0.5 / 256.0);
 				alphaTestXCoord = "vScale256.a";
@@ -428,8 +440,8 @@ bool GenerateFragmentShader(const FShaderID &id, char *buffer, uint64_t *uniform
 					// Maybe we could discard the drawcall, but it's pretty rare.  Let's just statically discard here.
 					WRITE(p, "  discard;\n");
 				}
-			} else if (g_Config.bFragmentTestCache) {
-				WRITE(p, "  float aResult = %s(testtex, vec2(%s, 0)).a;\n", texture, alphaTestXCoord.c_str());
+			} else if (useTestTexture) {
+				WRITE(p, "  float aResult = %s(testtex, vec2(%s, u_testtexcoord)).a;\n", texture, alphaTestXCoord.c_str());
 				WRITE(p, "  if (aResult < 0.5) discard;\n");
 			} else {
 				const char *alphaTestFuncs[] = { "#", "#", " != ", " == ", " >= ", " > ", " <= ", " < " };
@@ -465,10 +477,10 @@ bool GenerateFragmentShader(const FShaderID &id, char *buffer, uint64_t *uniform
 					// Maybe we could discard the drawcall, but it's pretty rare.  Let's just statically discard here.
 					WRITE(p, "  discard;\n");
 				}
-			} else if (g_Config.bFragmentTestCache) {
-				WRITE(p, "  float rResult = %s(testtex, vec2(vScale256.r, 0)).r;\n", texture);
-				WRITE(p, "  float gResult = %s(testtex, vec2(vScale256.g, 0)).g;\n", texture);
-				WRITE(p, "  float bResult = %s(testtex, vec2(vScale256.b, 0)).b;\n", texture);
+			} else if (useTestTexture) {
+				WRITE(p, "  float rResult = %s(testtex, vec2(vScale256.r, u_testtexcoord)).r;\n", texture);
+				WRITE(p, "  float gResult = %s(testtex, vec2(vScale256.g, u_testtexcoord)).g;\n", texture);
+				WRITE(p, "  float bResult = %s(testtex, vec2(vScale256.b, u_testtexcoord)).b;\n", texture);
 				if (colorTestFunc == GE_COMP_EQUAL) {
 					// Equal means all parts must be equal.
 					WRITE(p, "  if (rResult < 0.5 || gResult < 0.5 || bResult < 0.5) discard;\n");
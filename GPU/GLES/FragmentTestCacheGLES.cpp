@@ -17,6 +17,7 @@
 
 #include "thin3d/thin3d.h"
 #include "gfx/gl_debug_log.h"
+#include "gfx_es2/gpu_features.h"
 #include "Core/Config.h"
 #include "GPU/GLES/FragmentTestCacheGLES.h"
 #include "GPU/GPUState.h"
@@ -26,6 +27,17 @@
 // These are small, let's give them plenty of frames.
 static const int FRAGTEST_TEXTURE_OLD_AGE = 307;
 static const int FRAGTEST_DECIMATION_INTERVAL = 113;
+// The atlas starts out small and doubles, few games use more than a handful of tests.
+static const int FRAGTEST_ATLAS_MIN_ROWS = 16;
+static const int FRAGTEST_ATLAS_MAX_ROWS = 256;
+
+bool UseFragmentTestTexture() {
+	if (!g_Config.bFragmentTestCache) {
+		return false;
+	}
+	bool modernShaders = gstate_c.Supports(GPU_SUPPORTS_GLSL_ES_300) || (gstate_c.Supports(GPU_SUPPORTS_GLSL_330) && (!gl_extensions.ForceGL2 || gl_extensions.IsCoreContext));
+	return !modernShaders;
+}
 
 FragmentTestCacheGLES::FragmentTestCacheGLES(Draw::DrawContext *draw) {
 	render_ = (GLRenderManager *)draw->GetNativeObject(Draw::NativeObject::RENDER_MANAGER);
@@ -36,7 +48,7 @@ FragmentTestCacheGLES::~FragmentTestCacheGLES() {
 }
 
 void FragmentTestCacheGLES::BindTestTexture(int slot) {
-	if (!g_Config.bFragmentTestCache) {
+	if (!UseFragmentTestTexture()) {
 		return;
 	}
 
@@ -51,13 +63,11 @@ void FragmentTestCacheGLES::BindTestTexture(int slot) {
 	const auto cached = cache_.find(id);
 	if (cached != cache_.end()) {
 		cached->second.lastFrame = gpuStats.numFlips;
-		GLRTexture *tex = cached->second.texture;
-		if (tex == lastTexture_) {
-			// Already bound, hurray.
-			return;
+		if (atlas_ != lastTexture_) {
+			render_->BindTexture(slot, atlas_);
+			lastTexture_ = atlas_;
 		}
-		render_->BindTexture(slot, tex);
-		lastTexture_ = tex;
+		SetRowCoord(cached->second.row);
 		return;
 	}
 
@@ -74,15 +84,31 @@ void FragmentTestCacheGLES::BindTestTexture(int slot) {
 	const GEComparison funcs[4] = {gstate.getColorTestFunction(), gstate.getColorTestFunction(), gstate.getColorTestFunction(), gstate.getAlphaTestFunction()};
 	const bool valid[4] = {gstate.isColorTestEnabled(), gstate.isColorTestEnabled(), gstate.isColorTestEnabled(), gstate.isAlphaTestEnabled()};
 
-	GLRTexture *tex = CreateTestTexture(funcs, refs, masks, valid);
-	lastTexture_ = tex;
-	render_->BindTexture(slot, tex);
-	FragmentTestTexture item;
+	int row = AllocateRow();
+	FillTestRow(row, funcs, refs, masks, valid);
+	// Uploads happen before the frame's draws, which is fine since a reused row hasn't been drawn with
+	// this frame unless all FRAGTEST_ATLAS_MAX_ROWS were.
+	UploadAtlas();
+
+	render_->BindTexture(slot, atlas_);
+	lastTexture_ = atlas_;
+	SetRowCoord(row);
+
+	FragmentTestRow item;
 	item.lastFrame = gpuStats.numFlips;
-	item.texture = tex;
+	item.row = row;
 	cache_[id] = item;
 }
 
+void FragmentTestCacheGLES::SetRowCoord(int row) {
+	// Sample the center of the row.
+	float coord = (row + 0.5f) / (float)atlasRows_;
+	if (coord != gstate_c.fragmentTestCoord) {
+		gstate_c.fragmentTestCoord = coord;
+		gstate_c.Dirty(DIRTY_FRAGMENTTEST_COORD);
+	}
+}
+
 FragmentTestID FragmentTestCacheGLES::GenerateTestID() const {
 	FragmentTestID id;
 	// Let's just keep it simple, it's all in here.
@@ -97,8 +123,61 @@ FragmentTestID FragmentTestCacheGLES::GenerateTestID() const {
 	return id;
 }
 
-GLRTexture *FragmentTestCacheGLES::CreateTestTexture(const GEComparison funcs[4], const u8 refs[4], const u8 masks[4], const bool valid[4]) {
-	u8 *data = new u8[256 * 4];
+int FragmentTestCacheGLES::AllocateRow() {
+	if (freeRows_.empty() && atlasRows_ < FRAGTEST_ATLAS_MAX_ROWS) {
+		GrowAtlas();
+	}
+
+	if (freeRows_.empty()) {
+		// Full, evict whichever test was used least recently.
+		auto oldest = cache_.begin();
+		for (auto it = cache_.begin(); it != cache_.end(); ++it) {
+			if (it->second.lastFrame < oldest->second.lastFrame)
+				oldest = it;
+		}
+		int row = oldest->second.row;
+		cache_.erase(oldest);
+		return row;
+	}
+
+	int row = freeRows_.back();
+	freeRows_.pop_back();
+	return row;
+}
+
+void FragmentTestCacheGLES::GrowAtlas() {
+	int newRows = atlasRows_ == 0 ? FRAGTEST_ATLAS_MIN_ROWS : atlasRows_ * 2;
+	u8 *newData = new u8[256 * 4 * newRows];
+	// Unused rows pass everything, doesn't matter but keeps it deterministic.
+	memset(newData, 0xFF, 256 * 4 * newRows);
+	if (atlasData_) {
+		memcpy(newData, atlasData_, 256 * 4 * atlasRows_);
+		delete [] atlasData_;
+	}
+	atlasData_ = newData;
+
+	// Draws already queued keep using the old texture, the deletion is deferred.
+	if (atlas_) {
+		render_->DeleteTexture(atlas_);
+	}
+	atlas_ = render_->CreateTexture(GL_TEXTURE_2D);
+
+	for (int row = newRows - 1; row >= atlasRows_; --row) {
+		freeRows_.push_back(row);
+	}
+	atlasRows_ = newRows;
+	lastTexture_ = nullptr;
+}
+
+void FragmentTestCacheGLES::UploadAtlas() {
+	// TextureImage takes ownership, so give it a copy.
+	u8 *data = new u8[256 * 4 * atlasRows_];
+	memcpy(data, atlasData_, 256 * 4 * atlasRows_);
+	render_->TextureImage(atlas_, 0, 256, atlasRows_, GL_RGBA, GL_RGBA, GL_UNSIGNED_BYTE, data);
+}
+
+void FragmentTestCacheGLES::FillTestRow(int row, const GEComparison funcs[4], const u8 refs[4], const u8 masks[4], const bool valid[4]) {
+	u8 *data = atlasData_ + row * 256 * 4;
 	// TODO: Might it be better to use GL_ALPHA for simple textures?
 	// TODO: Experiment with 4-bit/etc. textures.
 
@@ -137,18 +216,17 @@ GLRTexture *FragmentTestCacheGLES::CreateTestTexture(const GEComparison funcs[4]
 			data[color * 4 + i] = res ? 0xFF : 0;
 		}
 	}
-
-	GLRTexture *tex = render_->CreateTexture(GL_TEXTURE_2D);
-	render_->TextureImage(tex, 0, 256, 1, GL_RGBA, GL_RGBA, GL_UNSIGNED_BYTE, data);
-	return tex;
 }
 
 void FragmentTestCacheGLES::Clear(bool deleteThem) {
-	if (deleteThem) {
-		for (auto tex = cache_.begin(); tex != cache_.end(); ++tex) {
-			render_->DeleteTexture(tex->second.texture);
-		}
+	if (deleteThem && atlas_) {
+		render_->DeleteTexture(atlas_);
 	}
+	atlas_ = nullptr;
+	delete [] atlasData_;
+	atlasData_ = nullptr;
+	atlasRows_ = 0;
+	freeRows_.clear();
 	cache_.clear();
 	lastTexture_ = 0;
 }
@@ -157,7 +235,7 @@ void FragmentTestCacheGLES::Decimate() {
 	if (--decimationCounter_ <= 0) {
 		for (auto tex = cache_.begin(); tex != cache_.end(); ) {
 			if (tex->second.lastFrame + FRAGTEST_TEXTURE_OLD_AGE < gpuStats.numFlips) {
-				render_->DeleteTexture(tex->second.texture);
+				freeRows_.push_back(tex->second.row);
 				cache_.erase(tex++);
 			} else {
 				++tex;
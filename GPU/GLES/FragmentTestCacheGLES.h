@@ -18,6 +18,7 @@
 #pragma once
 
 #include <map>
+#include <vector>
 #include "Common/CommonTypes.h"
 #include "GPU/GLES/TextureCacheGLES.h"
 
@@ -51,11 +52,15 @@ struct FragmentTestID {
 	}
 };
 
-struct FragmentTestTexture {
-	GLRTexture *texture;
+// Each cached test is one 256x1 row in a shared atlas, so switching tests doesn't rebind.
+struct FragmentTestRow {
+	int row;
 	int lastFrame;
 };
 
+// GLES3 and GL3+ do the tests exactly with integer math, only older GLSL needs the lookup texture.
+bool UseFragmentTestTexture();
+
 class FragmentTestCacheGLES {
 public:
 	FragmentTestCacheGLES(Draw::DrawContext *draw);
@@ -72,13 +77,21 @@ class FragmentTestCacheGLES {
 
 private:
 
-	GLRTexture *CreateTestTexture(const GEComparison funcs[4], const u8 refs[4], const u8 masks[4], const bool valid[4]);
+	void FillTestRow(int row, const GEComparison funcs[4], const u8 refs[4], const u8 masks[4], const bool valid[4]);
+	int AllocateRow();
+	void GrowAtlas();
+	void UploadAtlas();
+	void SetRowCoord(int row);
 	FragmentTestID GenerateTestID() const;
 
 	GLRenderManager *render_;
 	TextureCacheGLES *textureCache_;
 
-	std::map<FragmentTestID, FragmentTestTexture> cache_;
+	std::map<FragmentTestID, FragmentTestRow> cache_;
+	GLRTexture *atlas_ = nullptr;
+	u8 *atlasData_ = nullptr;
+	int atlasRows_ = 0;
+	std::vector<int> freeRows_;
 	GLRTexture *lastTexture_ = nullptr;
 	int decimationCounter_ = 0;
 };
@@ -106,109 +106,133 @@ void FramebufferManagerGLES::CompileDraw2DProgram() {
 
 void FramebufferManagerGLES::CompilePostShader() {
 	SetNumExtraFBOs(0);
-	const ShaderInfo *shaderInfo = 0;
+	DestroyPostShaderPrograms();
+	std::vector<const ShaderInfo *> chain;
 	if (g_Config.sPostShaderName != "Off") {
 		ReloadAllPostShaderInfo();
-		shaderInfo = GetPostShaderInfo(g_Config.sPostShaderName);
+		chain = GetPostShaderChain(g_Config.sPostShaderName, MAX_POST_SHADER_PASSES);
 	}
 
-	if (shaderInfo) {
-		std::string errorString;
-		postShaderAtOutputResolution_ = shaderInfo->outputResolution;
+	usePostShader_ = false;
+	postShaderPasses_ = 1;
+	if (chain.empty())
+		return;
 
-		size_t sz;
-		char *vs = (char *)VFSReadFile(shaderInfo->vertexShaderFile.c_str(), &sz);
-		if (!vs)
-			return;
-		char *fs = (char *)VFSReadFile(shaderInfo->fragmentShaderFile.c_str(), &sz);
-		if (!fs) {
-			free(vs);
-			return;
+	std::string errorString;
+	const ShaderInfo *failedInfo = nullptr;
+	for (size_t i = 0; i < chain.size(); i++) {
+		if (!CompilePostShaderPass(chain[i], (int)i, &errorString)) {
+			failedInfo = chain[i];
+			break;
 		}
+		postShaderScale_[i] = chain[i]->scale;
+	}
+	if (!failedInfo) {
+		postShaderPasses_ = (int)chain.size();
+		postShaderAtOutputResolution_ = chain.back()->outputResolution;
+		SetNumExtraFBOs(1);
+		usePostShader_ = true;
+		return;
+	}
 
-		std::string vshader;
-		std::string fshader;
-		bool translationFailed = false;
-		if (gl_extensions.IsCoreContext) {
-			// Gonna have to upconvert the shaders.
-			std::string errorMessage;
-			if (!TranslateShader(&vshader, GLSL_300, nullptr, vs, GLSL_140, Draw::ShaderStage::VERTEX, &errorMessage)) {
-				translationFailed = true;
-				ELOG("Failed to translate post-vshader: %s", errorMessage.c_str());
-			}
-			if (!TranslateShader(&fshader, GLSL_300, nullptr, fs, GLSL_140, Draw::ShaderStage::FRAGMENT, &errorMessage)) {
-				translationFailed = true;
-				ELOG("Failed to translate post-fshader: %s", errorMessage.c_str());
+	DestroyPostShaderPrograms();
+	// DO NOT turn this into a report, as it will pollute our logs with all kinds of
+	// user shader experiments.
+	ERROR_LOG(FRAMEBUF, "Failed to build post-processing program from %s and %s!\n%s", failedInfo->vertexShaderFile.c_str(), failedInfo->fragmentShaderFile.c_str(), errorString.c_str());
+	// let's show the first line of the error string as an OSM.
+	std::set<std::string> blacklistedLines;
+	// These aren't useful to show, skip to the first interesting line.
+	blacklistedLines.insert("Fragment shader failed to compile with the following errors:");
+	blacklistedLines.insert("Vertex shader failed to compile with the following errors:");
+	blacklistedLines.insert("Compile failed.");
+	blacklistedLines.insert("");
+
+	std::string firstLine;
+	size_t start = 0;
+	for (size_t i = 0; i < errorString.size(); i++) {
+		if (errorString[i] == '\n') {
+			firstLine = errorString.substr(start, i - start);
+			if (blacklistedLines.find(firstLine) == blacklistedLines.end()) {
+				break;
 			}
-		} else {
-			vshader = vs;
-			fshader = fs;
+			start = i + 1;
+			firstLine.clear();
 		}
+	}
+	if (!firstLine.empty()) {
+		host->NotifyUserMessage("Post-shader error: " + firstLine + "...", 10.0f, 0xFF3090FF);
+	} else {
+		host->NotifyUserMessage("Post-shader error, see log for details", 10.0f, 0xFF3090FF);
+	}
+}
 
-		if (!translationFailed) {
-			SetNumExtraFBOs(1);
-
-			std::vector<GLRShader *> shaders;
-			shaders.push_back(render_->CreateShader(GL_VERTEX_SHADER, vshader, "postshader"));
-			shaders.push_back(render_->CreateShader(GL_FRAGMENT_SHADER, fshader, "postshader"));
-			std::vector<GLRProgram::UniformLocQuery> queries;
-			queries.push_back({ &u_postShaderTex, "tex" });
-			queries.push_back({ &deltaLoc_, "u_texelDelta" });
-			queries.push_back({ &pixelDeltaLoc_, "u_pixelDelta" });
-			queries.push_back({ &timeLoc_, "u_time" });
-			queries.push_back({ &videoLoc_, "u_video" });
-
-			std::vector<GLRProgram::Initializer> inits;
-			inits.push_back({ &u_postShaderTex, 0, 0 });
-			std::vector<GLRProgram::Semantic> semantics;
-			semantics.push_back({ 0, "a_position" });
-			semantics.push_back({ 1, "a_texcoord0" });
-			postShaderProgram_ = render_->CreateProgram(shaders, semantics, queries, inits, false);
-			for (auto iter : shaders) {
-				render_->DeleteShader(iter);
-			}
-		} else {
-			ERROR_LOG(FRAMEBUF, "Failed to translate post shader!");
-		}
+GLRProgram *FramebufferManagerGLES::CompilePostShaderPass(const ShaderInfo *shaderInfo, int pass, std::string *errorString) {
+	size_t sz;
+	char *vs = (char *)VFSReadFile(shaderInfo->vertexShaderFile.c_str(), &sz);
+	if (!vs)
+		return nullptr;
+	char *fs = (char *)VFSReadFile(shaderInfo->fragmentShaderFile.c_str(), &sz);
+	if (!fs) {
 		free(vs);
-		free(fs);
-
-		if (!postShaderProgram_) {
-			// DO NOT turn this into a report, as it will pollute our logs with all kinds of
-			// user shader experiments.
-			ERROR_LOG(FRAMEBUF, "Failed to build post-processing program from %s and %s!\n%s", shaderInfo->vertexShaderFile.c_str(), shaderInfo->fragmentShaderFile.c_str(), errorString.c_str());
-			// let's show the first line of the error string as an OSM.
-			std::set<std::string> blacklistedLines;
-			// These aren't useful to show, skip to the first interesting line.
-			blacklistedLines.insert("Fragment shader failed to compile with the following errors:");
-			blacklistedLines.insert("Vertex shader failed to compile with the following errors:");
-			blacklistedLines.insert("Compile failed.");
-			blacklistedLines.insert("");
-
-			std::string firstLine;
-			size_t start = 0;
-			for (size_t i = 0; i < errorString.size(); i++) {
-				if (errorString[i] == '\n') {
-					firstLine = errorString.substr(start, i - start);
-					if (blacklistedLines.find(firstLine) == blacklistedLines.end()) {
-						break;
-					}
-					start = i + 1;
-					firstLine.clear();
-				}
-			}
-			if (!firstLine.empty()) {
-				host->NotifyUserMessage("Post-shader error: " + firstLine + "...", 10.0f, 0xFF3090FF);
-			} else {
-				host->NotifyUserMessage("Post-shader error, see log for details", 10.0f, 0xFF3090FF);
-			}
-			usePostShader_ = false;
-		} else {
-			usePostShader_ = true;
+		return nullptr;
+	}
+
+	std::string vshader;
+	std::string fshader;
+	bool translationFailed = false;
+	if (gl_extensions.IsCoreContext) {
+		// Gonna have to upconvert the shaders.
+		std::string errorMessage;
+		if (!TranslateShader(&vshader, GLSL_300, nullptr, vs, GLSL_140, Draw::ShaderStage::VERTEX, &errorMessage)) {
+			translationFailed = true;
+			ELOG("Failed to translate post-vshader: %s", errorMessage.c_str());
+		}
+		if (!TranslateShader(&fshader, GLSL_300, nullptr, fs, GLSL_140, Draw::ShaderStage::FRAGMENT, &errorMessage)) {
+			translationFailed = true;
+			ELOG("Failed to translate post-fshader: %s", errorMessage.c_str());
 		}
 	} else {
-		postShaderProgram_ = nullptr;
-		usePostShader_ = false;
+		vshader = vs;
+		fshader = fs;
+	}
+	free(vs);
+	free(fs);
+
+	if (translationFailed) {
+		ERROR_LOG(FRAMEBUF, "Failed to translate post shader!");
+		return nullptr;
+	}
+
+	PostShaderPass &p = postShaderPass_[pass];
+	std::vector<GLRShader *> shaders;
+	shaders.push_back(render_->CreateShader(GL_VERTEX_SHADER, vshader, "postshader"));
+	shaders.push_back(render_->CreateShader(GL_FRAGMENT_SHADER, fshader, "postshader"));
+	std::vector<GLRProgram::UniformLocQuery> queries;
+	queries.push_back({ &p.texLoc, "tex" });
+	queries.push_back({ &p.deltaLoc, "u_texelDelta" });
+	queries.push_back({ &p.pixelDeltaLoc, "u_pixelDelta" });
+	queries.push_back({ &p.timeLoc, "u_time" });
+	queries.push_back({ &p.videoLoc, "u_video" });
+
+	std::vector<GLRProgram::Initializer> inits;
+	inits.push_back({ &p.texLoc, 0, 0 });
+	std::vector<GLRProgram::Semantic> semantics;
+	semantics.push_back({ 0, "a_position" });
+	semantics.push_back({ 1, "a_texcoord0" });
+	p.program = render_->CreateProgram(shaders, semantics, queries, inits, false);
+	for (auto iter : shaders) {
+		render_->DeleteShader(iter);
+	}
+	return p.program;
+}
+
+void FramebufferManagerGLES::DestroyPostShaderPrograms() {
+	for (int i = 0; i < MAX_POST_SHADER_PASSES; i++) {
+		if (postShaderPass_[i].program) {
+			render_->DeleteProgram(postShaderPass_[i].program);
+			postShaderPass_[i].program = nullptr;
+		}
+		postShaderScale_[i] = 1.0f;
 	}
 }
 
@@ -217,19 +241,26 @@ void FramebufferManagerGLES::Bind2DShader() {
 }
 
 void FramebufferManagerGLES::BindPostShader(const PostShaderUniforms &uniforms) {
+	BindPostShaderPass(0, uniforms);
+}
+
+void FramebufferManagerGLES::BindPostShaderPass(int pass, const PostShaderUniforms &uniforms) {
 	// Make sure we've compiled the shader.
-	if (!postShaderProgram_) {
+	if (!postShaderPass_[0].program) {
 		CompileDraw2DProgram();
 	}
-	render_->BindProgram(postShaderProgram_);
-	if (deltaLoc_ != -1)
-		render_->SetUniformF(&deltaLoc_, 2, uniforms.texelDelta);
-	if (pixelDeltaLoc_ != -1)
-		render_->SetUniformF(&pixelDeltaLoc_, 2, uniforms.pixelDelta);
-	if (timeLoc_ != -1)
-		render_->SetUniformF(&timeLoc_, 4, uniforms.time);
-	if (videoLoc_ != -1)
-		render_->SetUniformF(&videoLoc_, 1, &uniforms.video);
+	PostShaderPass &p = postShaderPass_[pass];
+	render_->BindProgram(p.program);
+	// Measured per pass, the dev HUD shows these from GPU_GLES::GetStats.
+	render_->SetStepTimer(pass);
+	if (p.deltaLoc != -1)
+		render_->SetUniformF(&p.deltaLoc, 2, uniforms.texelDelta);
+	if (p.pixelDeltaLoc != -1)
+		render_->SetUniformF(&p.pixelDeltaLoc, 2, uniforms.pixelDelta);
+	if (p.timeLoc != -1)
+		render_->SetUniformF(&p.timeLoc, 4, uniforms.time);
+	if (p.videoLoc != -1)
+		render_->SetUniformF(&p.videoLoc, 1, &uniforms.video);
 }
 
 FramebufferManagerGLES::FramebufferManagerGLES(Draw::DrawContext *draw, GLRenderManager *render) :
@@ -283,10 +314,7 @@ void FramebufferManagerGLES::DestroyDeviceObjects() {
 		render_->DeleteProgram(draw2dprogram_);
 		draw2dprogram_ = nullptr;
 	}
-	if (postShaderProgram_) {
-		render_->DeleteProgram(postShaderProgram_);
-		postShaderProgram_ = nullptr;
-	}
+	DestroyPostShaderPrograms();
 	if (drawPixelsTex_) {
 		render_->DeleteTexture(drawPixelsTex_);
 		drawPixelsTex_ = 0;
@@ -547,7 +575,7 @@ bool FramebufferManagerGLES::CreateDownloadTempBuffer(VirtualFramebuffer *nvfb)
 		}
 	}
 
-	nvfb->fbo = draw_->CreateFramebuffer({ nvfb->width, nvfb->height, 1, 1, false, (Draw::FBColorDepth)nvfb->colorDepth });
+	nvfb->fbo = AllocFramebuffer({ nvfb->width, nvfb->height, 1, 1, false, (Draw::FBColorDepth)nvfb->colorDepth });
 	if (!nvfb->fbo) {
 		ERROR_LOG(FRAMEBUF, "Error creating GL FBO! %i x %i", nvfb->renderWidth, nvfb->renderHeight);
 		return false;
@@ -783,6 +811,7 @@ void FramebufferManagerGLES::DestroyAllFBOs() {
 	tempFBOs_.clear();
 
 	SetNumExtraFBOs(0);
+	ClearFramebufferPool();
 }
 
 void FramebufferManagerGLES::Resized() {
@@ -31,6 +31,8 @@
 #include "GPU/Common/FramebufferCommon.h"
 #include "thin3d/GLRenderManager.h"
 
+struct ShaderInfo;
+
 struct GLSLProgram;
 class TextureCacheGLES;
 class DrawEngineGLES;
@@ -83,8 +85,11 @@ class FramebufferManagerGLES : public FramebufferManagerCommon {
 	void MakePixelTexture(const u8 *srcPixels, GEBufferFormat srcPixelFormat, int srcStride, int width, int height, float &u1, float &v1) override;
 	void Bind2DShader() override;
 	void BindPostShader(const PostShaderUniforms &uniforms) override;
+	void BindPostShaderPass(int pass, const PostShaderUniforms &uniforms) override;
 	void CompileDraw2DProgram();
 	void CompilePostShader();
+	GLRProgram *CompilePostShaderPass(const ShaderInfo *shaderInfo, int pass, std::string *errorString);
+	void DestroyPostShaderPrograms();
 
 	void PackDepthbuffer(VirtualFramebuffer *vfb, int x, int y, int w, int h);
 
@@ -99,21 +104,26 @@ class FramebufferManagerGLES : public FramebufferManagerCommon {
 	u8 *convBuf_ = nullptr;
 	u32 convBufSize_ = 0;
 	GLRProgram *draw2dprogram_ = nullptr;
-	GLRProgram *postShaderProgram_ = nullptr;
+
+	// One per chained pass. The uniform locations are filled in asynchronously, so these can't move.
+	struct PostShaderPass {
+		GLRProgram *program = nullptr;
+		int texLoc = -1;
+		int deltaLoc = -1;
+		int pixelDeltaLoc = -1;
+		int timeLoc = -1;
+		int videoLoc = -1;
+	};
+	PostShaderPass postShaderPass_[MAX_POST_SHADER_PASSES];
 
 	GLRProgram *stencilUploadProgram_ = nullptr;
 	int u_stencilUploadTex = -1;
 	int u_stencilValue = -1;
-	int u_postShaderTex = -1;
 	
 	// Cached uniform locs
 	int u_draw2d_tex = -1;
 
 	int plainColorLoc_ = -1;
-	int videoLoc_ = -1;
-	int timeLoc_ = -1;
-	int pixelDeltaLoc_ = -1;
-	int deltaLoc_ = -1;
 
 	TextureCacheGLES *textureCacheGL_ = nullptr;
 	ShaderManagerGLES *shaderManagerGL_ = nullptr;
@@ -102,6 +102,9 @@ GPU_GLES::GPU_GLES(GraphicsContext *gfxCtx, Draw::DrawContext *draw)
 		shaderCachePath_ = GetSysDirectory(DIRECTORY_APP_CACHE) + "/" + discID + ".glshadercache";
 		// Actually precompiled by IsReady() since we're single-threaded.
 		shaderManagerGL_->Load(shaderCachePath_);
+		// Driver program binaries, if available, let us skip most of the link time for cached programs.
+		programCachePath_ = GetSysDirectory(DIRECTORY_APP_CACHE) + "/" + discID + ".glprogramcache";
+		shaderManagerGL_->LoadProgramBinaries(programCachePath_);
 	}
 
 	if (g_Config.bHardwareTessellation) {
@@ -115,9 +118,12 @@ GPU_GLES::GPU_GLES(GraphicsContext *gfxCtx, Draw::DrawContext *draw)
 			host->NotifyUserMessage(gr->T("Turn off Hardware Tessellation - unsupported"), 2.5f, 0xFF3030FF);
 		}
 	}
+
+	StartThread();
 }
 
 GPU_GLES::~GPU_GLES() {
+	StopThread();
 	GLRenderManager *render = (GLRenderManager *)draw_->GetNativeObject(Draw::NativeObject::RENDER_MANAGER);
 	render->Wipe();
 
@@ -131,6 +137,9 @@ GPU_GLES::~GPU_GLES() {
 	if (!shaderCachePath_.empty()) {
 		shaderManagerGL_->Save(shaderCachePath_);
 	}
+	if (!programCachePath_.empty()) {
+		shaderManagerGL_->SaveProgramBinaries(programCachePath_);
+	}
 	delete shaderManagerGL_;
 	shaderManagerGL_ = nullptr;
 	delete framebufferManagerGL_;
@@ -204,6 +213,10 @@ void GPU_GLES::CheckGPUFeatures() {
 	if (gl_extensions.ARB_framebuffer_object || gl_extensions.EXT_framebuffer_object || gl_extensions.IsGLES) {
 		features |= GPU_SUPPORTS_FBO;
 	}
+
+	if (gl_extensions.ARB_shader_stencil_export && !gl_extensions.IsGLES) {
+		features |= GPU_SUPPORTS_SHADER_STENCIL_EXPORT;
+	}
 	if (gl_extensions.ARB_framebuffer_object || gl_extensions.GLES3) {
 		features |= GPU_SUPPORTS_ARB_FRAMEBUFFER_BLIT;
 	}
@@ -255,6 +268,10 @@ void GPU_GLES::CheckGPUFeatures() {
 	bool instanceRendering = gl_extensions.GLES3 || (canUseInstanceID && canDefInstanceID);
 	if (instanceRendering)
 		features |= GPU_SUPPORTS_INSTANCE_RENDERING;
+	// Expanding rectangles in the vertex shader needs gl_VertexID and attribute divisors.
+	bool modernShaders = (features & GPU_SUPPORTS_GLSL_ES_300) || ((features & GPU_SUPPORTS_GLSL_330) && (!gl_extensions.ForceGL2 || gl_extensions.IsCoreContext));
+	if (instanceRendering && modernShaders)
+		features |= GPU_SUPPORTS_INSTANCED_RECTS;
 
 	int maxVertexTextureImageUnits = gl_extensions.maxVertexTextureUnits;
 	if (maxVertexTextureImageUnits >= 3) // At least 3 for hardware tessellation
@@ -326,6 +343,7 @@ void GPU_GLES::BuildReportingInfo() {
 
 void GPU_GLES::DeviceLost() {
 	ILOG("GPU_GLES: DeviceLost");
+	SyncThread();
 
 	// Simply drop all caches and textures.
 	// FBOs appear to survive? Or no?
@@ -370,6 +388,9 @@ void GPU_GLES::BeginHostFrame() {
 		textureCacheGL_->NotifyConfigChanged();
 	}
 
+	GLRenderManager *render = (GLRenderManager *)draw_->GetNativeObject(Draw::NativeObject::RENDER_MANAGER);
+	render->SetInflightFrames(g_Config.iInflightFrames);
+
 	drawEngine_.BeginFrame();
 }
 
@@ -422,6 +443,7 @@ void GPU_GLES::BeginFrame() {
 	// Save the cache from time to time. TODO: How often? We save on exit, so shouldn't need to do this all that often.
 	if (!shaderCachePath_.empty() && (gpuStats.numFlips & 4095) == 0) {
 		shaderManagerGL_->Save(shaderCachePath_);
+		shaderManagerGL_->SaveProgramBinaries(programCachePath_);
 	}
 
 	shaderManagerGL_->DirtyShader();
@@ -469,7 +491,7 @@ inline void GPU_GLES::CheckFlushOp(int cmd, u32 diff) {
 		if (dumpThisFrame_) {
 			NOTICE_LOG(G3D, "================ FLUSH ================");
 		}
-		drawEngine_.Flush();
+		FlushBeforeStateChange(cmd);
 	}
 }
 
@@ -491,8 +513,12 @@ void GPU_GLES::ExecuteOp(u32 op, u32 diff) {
 }
 
 void GPU_GLES::GetStats(char *buffer, size_t bufsize) {
+	GLRenderManager *render = (GLRenderManager *)draw_->GetNativeObject(Draw::NativeObject::RENDER_MANAGER);
+	int stateCallsIssued = 0;
+	int stateCallsElided = 0;
+	render->GetStateCallStats(&stateCallsIssued, &stateCallsElided);
 	float vertexAverageCycles = gpuStats.numVertsSubmitted > 0 ? (float)gpuStats.vertexGPUCycles / (float)gpuStats.numVertsSubmitted : 0.0f;
-	snprintf(buffer, bufsize - 1,
+	int len = snprintf(buffer, bufsize - 1,
 		"DL processing time: %0.2f ms\n"
 		"Draw calls: %i, flushes %i, clears %i\n"
 		"Cached Draw calls: %i\n"
@@ -501,10 +527,18 @@ void GPU_GLES::GetStats(char *buffer, size_t bufsize) {
 		"Commands per call level: %i %i %i %i\n"
 		"Vertices submitted: %i\n"
 		"Cached, Uncached Vertices Drawn: %i, %i\n"
-		"FBOs active: %i\n"
-		"Textures active: %i, decoded: %i  invalidated: %i\n"
-		"Readbacks: %d, uploads: %d\n"
-		"Vertex, Fragment, Programs loaded: %i, %i, %i\n",
+		"Vertex cache hits: %i, misses: %i, uploaded: %i KB\n"
+		"Vertex decoder JIT fallbacks: %i formats, %i verts\n"
+		"Skinned draws: %i, verts: %i (%i by fallback)\n"
+		"Flushes for state: %i, prim: %i, full: %i, merged state changes: %i\n"
+		"Bounding box tests: %i, culled: %i\n"
+		"FBOs active: %i, created: %i, reused from pool: %i\n"
+		"Textures active: %i, decoded: %i  invalidated: %i  unwritten: %i  sampled: %i\n"
+		"Texture memory: %0.1f MB, budget: %i MB\n"
+		"Readbacks: %d (%d async, %0.2f ms stalled), uploads: %d\n"
+		"Block transfers: %d GPU, %d CPU (%d downloads, %d uploads)\n"
+		"Vertex, Fragment, Programs loaded: %i, %i, %i\n"
+		"GL state calls: %i issued, %i elided\n",
 		gpuStats.msProcessingDisplayLists * 1000.0f,
 		gpuStats.numDrawCalls,
 		gpuStats.numFlushes,
@@ -517,15 +551,49 @@ void GPU_GLES::GetStats(char *buffer, size_t bufsize) {
 		gpuStats.numVertsSubmitted,
 		gpuStats.numCachedVertsDrawn,
 		gpuStats.numUncachedVertsDrawn,
+		gpuStats.numCachedDrawCalls,
+		gpuStats.numVertexCacheMisses,
+		gpuStats.numVertexCacheUploadBytes / 1024,
+		gpuStats.numJitFallbackDecoders,
+		gpuStats.numVertsDecodedByFallback,
+		gpuStats.numSkinnedDrawCalls,
+		gpuStats.numSkinnedVerts,
+		gpuStats.numSkinnedVertsByFallback,
+		gpuStats.numStateFlushes,
+		gpuStats.numPrimFlushes,
+		gpuStats.numFullFlushes,
+		gpuStats.numMergedStateChanges,
+		gpuStats.numBBoxTests,
+		gpuStats.numBBoxCulled,
 		(int)framebufferManagerGL_->NumVFBs(),
+		gpuStats.numFBOsCreated,
+		gpuStats.numPooledFBOsReused,
 		(int)textureCacheGL_->NumLoadedTextures(),
 		gpuStats.numTexturesDecoded,
 		gpuStats.numTextureInvalidations,
+		gpuStats.numTextureHashesSkipped,
+		gpuStats.numTextureHashesSampled,
+		textureCacheGL_->MemoryUsage() / (1024.0f * 1024.0f),
+		(int)(textureCacheGL_->MemoryBudget() / (1024 * 1024)),
 		gpuStats.numReadbacks,
+		gpuStats.numAsyncReadbacks,
+		gpuStats.msReadbackStall,
 		gpuStats.numUploads,
+		gpuStats.numBlockTransfersGPU,
+		gpuStats.numBlockTransfersCPU,
+		gpuStats.numBlockTransferDownloads,
+		gpuStats.numBlockTransferUploads,
 		shaderManagerGL_->GetNumVertexShaders(),
 		shaderManagerGL_->GetNumFragmentShaders(),
-		shaderManagerGL_->GetNumPrograms());
+		shaderManagerGL_->GetNumPrograms(),
+		stateCallsIssued,
+		stateCallsElided);
+
+	// GPU timestamps for each post shader pass, zero where timer queries aren't available.
+	int passes = framebufferManagerGL_->GetPostShaderPasses();
+	for (int i = 0; i < passes && len > 0 && len < (int)bufsize - 1; i++) {
+		len += snprintf(buffer + len, bufsize - 1 - len, "Post pass %d: %0.2f ms\n", i, render->GetStepTime(i));
+	}
 }
 
 void GPU_GLES::ClearCacheNextFrame() {
@@ -546,8 +614,8 @@ void GPU_GLES::DoState(PointerWrap &p) {
 
 	// TODO: Some of these things may not be necessary.
 	// None of these are necessary when saving.
-	// In Freeze-Frame mode, we don't want to do any of this.
-	if (p.mode == p.MODE_READ && !PSP_CoreParameter().frozen) {
+	// In Freeze-Frame mode or a run-ahead rollback, we don't want to do any of this.
+	if (p.mode == p.MODE_READ && !PSP_CoreParameter().frozen && !PSP_CoreParameter().runningAhead) {
 		textureCacheGL_->Clear(true);
 		drawEngine_.ClearTrackedVertexArrays();
 
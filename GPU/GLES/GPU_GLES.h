@@ -88,6 +88,7 @@ class GPU_GLES : public GPUCommon {
 	ShaderManagerGLES *shaderManagerGL_;
 
 	std::string shaderCachePath_;
+	std::string programCachePath_;
 
 #ifdef _WIN32
 	int lastVsync_;
@@ -64,8 +64,12 @@ Shader::~Shader() {
 	render_->DeleteShader(shader);
 }
 
-LinkedShader::LinkedShader(GLRenderManager *render, VShaderID VSID, Shader *vs, FShaderID FSID, Shader *fs, bool useHWTransform, bool preloading)
-		: render_(render), useHWTransform_(useHWTransform) {
+static bool SupportsProgramBinaries() {
+	return gl_extensions.GLES3 || gl_extensions.ARB_get_program_binary;
+}
+
+LinkedShader::LinkedShader(GLRenderManager *render, VShaderID VSID, Shader *vs, FShaderID FSID, Shader *fs, bool useHWTransform, bool preloading, const GLProgramBinary *binary)
+		: render_(render), VSID_(VSID), FSID_(FSID), useHWTransform_(useHWTransform) {
 	PROFILE_THIS_SCOPE("shaderlink");
 
 	vs_ = vs;
@@ -84,6 +88,7 @@ LinkedShader::LinkedShader(GLRenderManager *render, VShaderID VSID, Shader *vs,
 
 	std::vector<GLRProgram::UniformLocQuery> queries;
 	queries.push_back({ &u_tex, "tex" });
+	queries.push_back({ &u_pal, "pal" });
 	queries.push_back({ &u_proj, "u_proj" });
 	queries.push_back({ &u_proj_through, "u_proj_through" });
 
@@ -96,6 +101,7 @@ LinkedShader::LinkedShader(GLRenderManager *render, VShaderID VSID, Shader *vs,
 	queries.push_back({ &u_alphacolormask, "u_alphacolormask" });
 	queries.push_back({ &u_stencilReplaceValue, "u_stencilReplaceValue" });
 	queries.push_back({ &u_testtex, "testtex" });
+	queries.push_back({ &u_testtexcoord, "u_testtexcoord" });
 
 	queries.push_back({ &u_fbotex, "fbotex" });
 	queries.push_back({ &u_blendFixA, "u_blendFixA" });
@@ -154,11 +160,15 @@ LinkedShader::LinkedShader(GLRenderManager *render, VShaderID VSID, Shader *vs,
 	initialize.push_back({ &u_tex,          0, 0 });
 	initialize.push_back({ &u_fbotex,       0, 1 });
 	initialize.push_back({ &u_testtex,      0, 2 });
+	initialize.push_back({ &u_pal,          0, 3 });
 	initialize.push_back({ &u_tess_pos_tex, 0, 4 }); // Texture unit 4
 	initialize.push_back({ &u_tess_tex_tex, 0, 5 }); // Texture unit 5
 	initialize.push_back({ &u_tess_col_tex, 0, 6 }); // Texture unit 6
 
-	program = render->CreateProgram(shaders, semantics, queries, initialize, gstate_c.featureFlags & GPU_SUPPORTS_DUALSOURCE_BLEND);
+	// Even with a cached binary, ask for a fresh one in case the driver rejects it.
+	bool retrieveBinary = SupportsProgramBinaries();
+	program = render->CreateProgram(shaders, semantics, queries, initialize, gstate_c.featureFlags & GPU_SUPPORTS_DUALSOURCE_BLEND,
+		retrieveBinary, binary ? binary->format : 0, binary ? &binary->data : nullptr);
 
 	// The rest, use the "dirty" mechanism.
 	dirtyUniforms = DIRTY_ALL_UNIFORMS;
@@ -346,6 +356,9 @@ void LinkedShader::UpdateUniforms(u32 vertType, const ShaderID &vsid) {
 	if (dirty & DIRTY_ALPHACOLORMASK) {
 		SetColorUniform3iAlpha(render_, &u_alphacolormask, gstate.colortestmask, gstate.getAlphaTestMask());
 	}
+	if (dirty & DIRTY_FRAGMENTTEST_COORD) {
+		render_->SetUniformF1(&u_testtexcoord, gstate_c.fragmentTestCoord);
+	}
 	if (dirty & DIRTY_FOGCOLOR) {
 		SetColorUniform3(render_, &u_fogcolor, gstate.fogcolor);
 	}
@@ -551,6 +564,8 @@ ShaderManagerGLES::~ShaderManagerGLES() {
 
 void ShaderManagerGLES::Clear() {
 	DirtyLastShader();
+	// Grab any binaries the driver has given us before the programs go away.
+	CollectProgramBinaries();
 	for (auto iter = linkedShaderCache_.begin(); iter != linkedShaderCache_.end(); ++iter) {
 		delete iter->ls;
 	}
@@ -619,6 +634,9 @@ Shader *ShaderManagerGLES::ApplyVertexShader(int prim, u32 vertType, VShaderID *
 	} else {
 		*VSID = lastVSID_;
 	}
+	// This depends on the prim, which doesn't dirty the shader state.
+	bool rectInstanced = prim == GE_PRIM_RECTANGLES && !VSID->Bit(VS_BIT_USE_HW_TRANSFORM) && VSID->Bit(VS_BIT_IS_THROUGH) && !gstate.isModeClear();
+	VSID->SetBit(VS_BIT_RECT_INSTANCED, rectInstanced && gstate_c.Supports(GPU_SUPPORTS_INSTANCED_RECTS));
 
 	if (lastShader_ != 0 && *VSID == lastVSID_) {
 		lastVShaderSame_ = true;
@@ -704,7 +722,7 @@ LinkedShader *ShaderManagerGLES::ApplyFragmentShader(VShaderID VSID, Shader *vs,
 		_dbg_assert_(G3D, FSID.Bit(FS_BIT_FLATSHADE) == VSID.Bit(VS_BIT_FLATSHADE));
 
 		// Check if we can link these.
-		ls = new LinkedShader(render_, VSID, vs, FSID, fs, vs->UseHWTransform());
+		ls = new LinkedShader(render_, VSID, vs, FSID, fs, vs->UseHWTransform(), false, FindProgramBinary(VSID, FSID));
 		ls->use(VSID);
 		const LinkedShaderCacheEntry entry(vs, fs, ls);
 		linkedShaderCache_.push_back(entry);
@@ -929,7 +947,7 @@ bool ShaderManagerGLES::ContinuePrecompile(float sliceTime) {
 		Shader *vs = vsCache_.Get(vsid);
 		Shader *fs = fsCache_.Get(fsid);
 		if (vs && fs) {
-			LinkedShader *ls = new LinkedShader(render_, vsid, vs, fsid, fs, vs->UseHWTransform(), true);
+			LinkedShader *ls = new LinkedShader(render_, vsid, vs, fsid, fs, vs->UseHWTransform(), true, FindProgramBinary(vsid, fsid));
 			LinkedShaderCacheEntry entry(vs, fs, ls);
 			linkedShaderCache_.push_back(entry);
 		}
@@ -990,3 +1008,119 @@ void ShaderManagerGLES::Save(const std::string &filename) {
 	fclose(f);
 	diskCacheDirty_ = false;
 }
+
+#define PROGRAM_CACHE_HEADER_MAGIC 0x83277593
+#define PROGRAM_CACHE_VERSION 1
+// Anything bigger than this is surely a corrupt file.
+#define PROGRAM_CACHE_MAX_BINARY_SIZE (16 * 1024 * 1024)
+struct ProgramCacheHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t featureFlags;
+	uint32_t driverHash;
+	int numPrograms;
+};
+
+struct ProgramCacheEntryHeader {
+	VShaderID vsid;
+	FShaderID fsid;
+	uint32_t format;
+	uint32_t size;
+};
+
+const GLProgramBinary *ShaderManagerGLES::FindProgramBinary(const VShaderID &VSID, const FShaderID &FSID) const {
+	auto iter = programBinaries_.find(std::make_pair(VSID, FSID));
+	if (iter == programBinaries_.end())
+		return nullptr;
+	return &iter->second;
+}
+
+void ShaderManagerGLES::CollectProgramBinaries() {
+	for (auto iter : linkedShaderCache_) {
+		GLRProgram *program = iter.ls->program;
+		// Programs loaded from a binary are already in the map.
+		if (!program->binaryReady_ || program->linkedFromBinary_)
+			continue;
+		auto key = std::make_pair(iter.ls->VSID_, iter.ls->FSID_);
+		auto existing = programBinaries_.find(key);
+		if (existing != programBinaries_.end() && existing->second.format == program->binaryFormat_ && existing->second.data == program->binary_)
+			continue;
+		// The render thread is done with it once binaryReady_ is set.
+		GLProgramBinary &binary = programBinaries_[key];
+		binary.format = program->binaryFormat_;
+		binary.data = program->binary_;
+		programBinariesDirty_ = true;
+	}
+}
+
+void ShaderManagerGLES::LoadProgramBinaries(const std::string &filename) {
+	if (!SupportsProgramBinaries()) {
+		return;
+	}
+	File::IOFile f(filename, "rb");
+	if (!f.IsOpen()) {
+		return;
+	}
+	ProgramCacheHeader header;
+	if (!f.ReadArray(&header, 1)) {
+		return;
+	}
+	if (header.magic != PROGRAM_CACHE_HEADER_MAGIC || header.version != PROGRAM_CACHE_VERSION || header.featureFlags != gstate_c.featureFlags) {
+		return;
+	}
+	if (header.driverHash != gl_extensions.driverHash) {
+		NOTICE_LOG(G3D, "Driver changed, ignoring program binaries in '%s'", filename.c_str());
+		return;
+	}
+
+	std::map<std::pair<VShaderID, FShaderID>, GLProgramBinary> binaries;
+	for (int i = 0; i < header.numPrograms; i++) {
+		ProgramCacheEntryHeader entry;
+		if (!f.ReadArray(&entry, 1) || entry.size == 0 || entry.size > PROGRAM_CACHE_MAX_BINARY_SIZE) {
+			ERROR_LOG(G3D, "Corrupt program binary cache '%s', ignoring", filename.c_str());
+			return;
+		}
+		GLProgramBinary &binary = binaries[std::make_pair(entry.vsid, entry.fsid)];
+		binary.format = entry.format;
+		binary.data.resize(entry.size);
+		if (!f.ReadArray(&binary.data[0], entry.size)) {
+			ERROR_LOG(G3D, "Corrupt program binary cache '%s', ignoring", filename.c_str());
+			return;
+		}
+	}
+
+	programBinaries_.swap(binaries);
+	programBinariesDirty_ = false;
+	NOTICE_LOG(G3D, "Loaded %d program binaries from '%s'", (int)programBinaries_.size(), filename.c_str());
+}
+
+void ShaderManagerGLES::SaveProgramBinaries(const std::string &filename) {
+	CollectProgramBinaries();
+	if (!programBinariesDirty_ || programBinaries_.empty()) {
+		return;
+	}
+	INFO_LOG(G3D, "Saving %d program binaries to '%s'", (int)programBinaries_.size(), filename.c_str());
+	FILE *f = File::OpenCFile(filename, "wb");
+	if (!f) {
+		programBinariesDirty_ = false;
+		return;
+	}
+	ProgramCacheHeader header;
+	header.magic = PROGRAM_CACHE_HEADER_MAGIC;
+	header.version = PROGRAM_CACHE_VERSION;
+	header.featureFlags = gstate_c.featureFlags;
+	header.driverHash = gl_extensions.driverHash;
+	header.numPrograms = (int)programBinaries_.size();
+	fwrite(&header, 1, sizeof(header), f);
+	for (auto &iter : programBinaries_) {
+		ProgramCacheEntryHeader entry;
+		entry.vsid = iter.first.first;
+		entry.fsid = iter.first.second;
+		entry.format = iter.second.format;
+		entry.size = (uint32_t)iter.second.data.size();
+		fwrite(&entry, 1, sizeof(entry), f);
+		fwrite(iter.second.data.data(), 1, iter.second.data.size(), f);
+	}
+	fclose(f);
+	programBinariesDirty_ = false;
+}
@@ -17,6 +17,7 @@
 
 #pragma once
 
+#include <map>
 #include <vector>
 
 #include "base/basictypes.h"
@@ -40,15 +41,23 @@ enum {
 	ATTR_COUNT,
 };
 
+// A driver-specific linked program, as returned by glGetProgramBinary.
+struct GLProgramBinary {
+	GLenum format;
+	std::vector<uint8_t> data;
+};
+
 class LinkedShader {
 public:
-	LinkedShader(GLRenderManager *render, VShaderID VSID, Shader *vs, FShaderID FSID, Shader *fs, bool useHWTransform, bool preloading = false);
+	LinkedShader(GLRenderManager *render, VShaderID VSID, Shader *vs, FShaderID FSID, Shader *fs, bool useHWTransform, bool preloading = false, const GLProgramBinary *binary = nullptr);
 	~LinkedShader();
 
 	void use(const ShaderID &VSID);
 	void UpdateUniforms(u32 vertType, const ShaderID &VSID);
 
 	GLRenderManager *render_;
+	VShaderID VSID_;
+	FShaderID FSID_;
 	Shader *vs_;
 	// Set to false if the VS failed, happens on Mali-400 a lot for complex shaders.
 	bool useHWTransform_;
@@ -80,10 +89,12 @@ class LinkedShader {
 	int u_alphacolorref;
 	int u_alphacolormask;
 	int u_testtex;
+	int u_testtexcoord;
 	int u_fogcolor;
 	int u_fogcoef;
 
 	// Texturing
+	int u_pal;
 	int u_uvscaleoffset;
 	int u_texclamp;
 	int u_texclampoff;
@@ -163,8 +174,14 @@ class ShaderManagerGLES : public ShaderManagerCommon {
 	bool ContinuePrecompile(float sliceTime = 1.0f / 60.0f);
 	void Save(const std::string &filename);
 
+	// Program binaries are kept in a separate file, since they're only valid for the same driver.
+	void LoadProgramBinaries(const std::string &filename);
+	void SaveProgramBinaries(const std::string &filename);
+
 private:
 	void Clear();
+	const GLProgramBinary *FindProgramBinary(const VShaderID &VSID, const FShaderID &FSID) const;
+	void CollectProgramBinaries();
 	Shader *CompileFragmentShader(FShaderID id);
 	Shader *CompileVertexShader(VShaderID id);
 
@@ -197,6 +214,10 @@ class ShaderManagerGLES : public ShaderManagerCommon {
 	VSCache vsCache_;
 
 	bool diskCacheDirty_;
+
+	std::map<std::pair<VShaderID, FShaderID>, GLProgramBinary> programBinaries_;
+	bool programBinariesDirty_ = false;
+
 	struct {
 		std::vector<VShaderID> vert;
 		std::vector<FShaderID> frag;
@@ -43,6 +43,23 @@ static const char *stencil_fs =
 "  if (mod(floor(shifted), 2.0) < 0.99) discard;\n"
 "}\n";
 
+// With shader stencil export, all the bits are written in one pass.
+static const char *stencil_export_fs =
+"#extension GL_ARB_shader_stencil_export : require\n"
+"#if __VERSION__ >= 130\n"
+"#define varying in\n"
+"#define texture2D texture\n"
+"#define gl_FragColor fragColor0\n"
+"out vec4 fragColor0;\n"
+"#endif\n"
+"varying vec2 v_texcoord0;\n"
+"uniform sampler2D tex;\n"
+"void main() {\n"
+"  vec4 index = texture2D(tex, v_texcoord0);\n"
+"  gl_FragColor = vec4(index.a);\n"
+"  gl_FragStencilRefARB = int(floor(index.a * 255.99));\n"
+"}\n";
+
 static const char *stencil_vs =
 "#ifdef GL_ES\n"
 "precision highp float;\n"
@@ -118,11 +135,13 @@ bool FramebufferManagerGLES::NotifyStencilUpload(u32 addr, int size, bool skipZe
 		return true;
 	}
 
+	// Writes every bit in one pass, instead of one pass per bit.
+	bool useExport = gstate_c.Supports(GPU_SUPPORTS_SHADER_STENCIL_EXPORT);
 	if (!stencilUploadProgram_) {
 		std::string errorString;
 		static std::string vs_code, fs_code;
 		vs_code = ApplyGLSLPrelude(stencil_vs, GL_VERTEX_SHADER);
-		fs_code = ApplyGLSLPrelude(stencil_fs, GL_FRAGMENT_SHADER);
+		fs_code = ApplyGLSLPrelude(useExport ? stencil_export_fs : stencil_fs, GL_FRAGMENT_SHADER);
 		std::vector<GLRShader *> shaders;
 		shaders.push_back(render_->CreateShader(GL_VERTEX_SHADER, vs_code, "stencil"));
 		shaders.push_back(render_->CreateShader(GL_FRAGMENT_SHADER, fs_code, "stencil"));
@@ -174,22 +193,28 @@ bool FramebufferManagerGLES::NotifyStencilUpload(u32 addr, int size, bool skipZe
 	render_->BindProgram(stencilUploadProgram_);
 	render_->SetNoBlendAndMask(0x8);
 
-	for (int i = 1; i < values; i += i) {
-		if (!(usedBits & i)) {
-			// It's already zero, let's skip it.
-			continue;
-		}
-		if (dstBuffer->format == GE_FORMAT_4444) {
-			render_->SetStencilOp((i << 4) | i, GL_REPLACE, GL_REPLACE, GL_REPLACE);
-			render_->SetUniformF1(&u_stencilValue, i * (16.0f / 255.0f));
-		} else if (dstBuffer->format == GE_FORMAT_5551) {
-			render_->SetStencilOp(0xFF, GL_REPLACE, GL_REPLACE, GL_REPLACE);
-			render_->SetUniformF1(&u_stencilValue, i * (128.0f / 255.0f));
-		} else {
-			render_->SetStencilOp(i, GL_REPLACE, GL_REPLACE, GL_REPLACE);
-			render_->SetUniformF1(&u_stencilValue, i * (1.0f / 255.0f));
-		}
+	if (useExport) {
+		// Stencil REPLACE takes the reference from the shader.
+		render_->SetStencilOp(0xFF, GL_REPLACE, GL_REPLACE, GL_REPLACE);
 		DrawActiveTexture(0, 0, dstBuffer->width, dstBuffer->height, dstBuffer->bufferWidth, dstBuffer->bufferHeight, 0.0f, 0.0f, u1, v1, ROTATION_LOCKED_HORIZONTAL, DRAWTEX_NEAREST | DRAWTEX_KEEP_STENCIL_ALPHA);
+	} else {
+		for (int i = 1; i < values; i += i) {
+			if (!(usedBits & i)) {
+				// It's already zero, let's skip it.
+				continue;
+			}
+			if (dstBuffer->format == GE_FORMAT_4444) {
+				render_->SetStencilOp((i << 4) | i, GL_REPLACE, GL_REPLACE, GL_REPLACE);
+				render_->SetUniformF1(&u_stencilValue, i * (16.0f / 255.0f));
+			} else if (dstBuffer->format == GE_FORMAT_5551) {
+				render_->SetStencilOp(0xFF, GL_REPLACE, GL_REPLACE, GL_REPLACE);
+				render_->SetUniformF1(&u_stencilValue, i * (128.0f / 255.0f));
+			} else {
+				render_->SetStencilOp(i, GL_REPLACE, GL_REPLACE, GL_REPLACE);
+				render_->SetUniformF1(&u_stencilValue, i * (1.0f / 255.0f));
+			}
+			DrawActiveTexture(0, 0, dstBuffer->width, dstBuffer->height, dstBuffer->bufferWidth, dstBuffer->bufferHeight, 0.0f, 0.0f, u1, v1, ROTATION_LOCKED_HORIZONTAL, DRAWTEX_NEAREST | DRAWTEX_KEEP_STENCIL_ALPHA);
+		}
 	}
 
 	if (useBlit) {
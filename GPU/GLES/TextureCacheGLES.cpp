@@ -60,6 +60,7 @@ TextureCacheGLES::TextureCacheGLES(Draw::DrawContext *draw)
 }
 
 TextureCacheGLES::~TextureCacheGLES() {
+	StopAsyncDecodes();
 	render_->DeleteInputLayout(shadeInputLayout_);
 	Clear(true);
 }
@@ -123,6 +124,11 @@ void TextureCacheGLES::UpdateSamplingParams(TexCacheEntry &entry, bool force) {
 	u8 maxLevel = (entry.status & TexCacheEntry::STATUS_BAD_MIPS) ? 0 : entry.maxLevel;
 	GETexLevelMode mode;
 	GetSamplingParams(minFilt, magFilt, sClamp, tClamp, lodBias, maxLevel, entry.addr, mode);
+	if (entry.status & TexCacheEntry::STATUS_SHADER_CLUT) {
+		// Filtering state can change without a new texture being set, but indices must never be filtered.
+		minFilt &= ~1;
+		magFilt &= ~1;
+	}
 
 	if (gstate_c.Supports(GPU_SUPPORTS_TEXTURE_LOD_CONTROL)) {
 		float minLod = 0.0f;
@@ -205,6 +211,8 @@ static void ConvertColors(void *dstBuf, const void *srcBuf, GLuint dstFmt, int n
 
 void TextureCacheGLES::StartFrame() {
 	InvalidateLastTexture();
+	// Whatever decoded since last frame gets uploaded before this frame's draws.
+	FinishAsyncDecodes();
 	timesInvalidatedAllThisFrame_ = 0;
 
 	GLRenderManager *renderManager = (GLRenderManager *)draw_->GetNativeObject(Draw::NativeObject::RENDER_MANAGER);
@@ -321,6 +329,33 @@ void TextureCacheGLES::BindTexture(TexCacheEntry *entry) {
 		lastBoundTexture = entry->textureName;
 	}
 	UpdateSamplingParams(*entry, false);
+	if (entry->status & TexCacheEntry::STATUS_SHADER_CLUT) {
+		BindLookupClut(entry);
+	}
+}
+
+void TextureCacheGLES::BindLookupClut(TexCacheEntry *entry) {
+	const u32 lookupId = clutHash_ ^ gstate.clutformat;
+	if (!lookupClutValid_ || lookupId != lookupClutId_) {
+		BuildLookupClut(lookupClut_);
+		// CLUT4 can only reach the first 16 entries.
+		u32 alphaSum = 0xFFFFFFFF;
+		for (int i = 0; i < 16; ++i) {
+			alphaSum &= lookupClut_[i];
+		}
+		lookupClutFullAlpha4_ = (alphaSum & 0xFF000000) == 0xFF000000;
+		for (int i = 16; i < 256; ++i) {
+			alphaSum &= lookupClut_[i];
+		}
+		lookupClutFullAlpha8_ = (alphaSum & 0xFF000000) == 0xFF000000;
+		lookupClutId_ = lookupId;
+		lookupClutValid_ = true;
+	}
+
+	render_->BindTexture(3, depalShaderCache_->GetLookupClutTexture(lookupClutId_, lookupClut_));
+	// The decoded colors are never seen, so the alpha status follows the palette.
+	bool fullAlpha = entry->format == GE_TFMT_CLUT4 ? lookupClutFullAlpha4_ : lookupClutFullAlpha8_;
+	entry->SetAlphaStatus(fullAlpha ? TexCacheEntry::STATUS_ALPHA_FULL : TexCacheEntry::STATUS_ALPHA_UNKNOWN);
 }
 
 void TextureCacheGLES::Unbind() {
@@ -438,6 +473,7 @@ void TextureCacheGLES::ApplyTextureFramebuffer(TexCacheEntry *entry, VirtualFram
 		const GEPaletteFormat clutFormat = gstate.getClutPaletteFormat();
 		GLRTexture *clutTexture = depalShaderCache_->GetClutTexture(clutFormat, clutHash_, clutBuf_);
 		Draw::Framebuffer *depalFBO = framebufferManagerGL_->GetTempFBO(framebuffer->renderWidth, framebuffer->renderHeight, Draw::FBO_8888);
+		draw_->BeginGPUTimer("depal");
 		draw_->BindFramebufferAsRenderTarget(depalFBO, { Draw::RPAction::DONT_CARE, Draw::RPAction::DONT_CARE, Draw::RPAction::DONT_CARE });
 		shaderManager_->DirtyLastShader();
 
@@ -452,6 +488,7 @@ void TextureCacheGLES::ApplyTextureFramebuffer(TexCacheEntry *entry, VirtualFram
 		render_->SetTextureSampler(3, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_NEAREST, GL_NEAREST, 0.0f);
 
 		shaderApply.Shade(render_);
+		draw_->EndGPUTimer();
 
 		draw_->BindFramebufferAsTexture(depalFBO, 0, Draw::FB_COLOR_BIT, 0);
 
@@ -496,8 +533,55 @@ GLenum ToGLESFormat(ReplacedTextureFormat fmt) {
 	}
 }
 
+// Smaller textures decode quickly enough that a placeholder isn't worth it.
+#define ASYNC_DECODE_MIN_TEXELS (128 * 128)
+
+// A texture being built on the async decode thread. Shared between BuildTexture, the decode thread
+// and FinishAsyncBuild, but only the decode thread touches it while the decode is queued.
+struct AsyncTexBuild {
+	struct Level {
+		int w;
+		int h;
+		int bufw;
+		bool swizzled;
+		// A copy of the texture from RAM, or for CLUT formats the already decoded pixels.
+		u8 *src;
+		bool decoded;
+		// The result, owned by the render manager once uploaded.
+		u8 *pixels;
+		GLenum dstFmt;
+		TexCacheEntry::TexStatus alphaStatus;
+	};
+
+	~AsyncTexBuild() {
+		for (Level &level : levels) {
+			FreeAlignedMemory(level.src);
+			FreeAlignedMemory(level.pixels);
+		}
+	}
+
+	GETextureFormat format;
+	int scaleFactor;
+	u64 contentKey;
+	int texMaxLevel;
+	bool genMips;
+	bool badMips;
+	std::vector<Level> levels;
+};
+
+static bool IsClutFormat(GETextureFormat format) {
+	return format >= GE_TFMT_CLUT4 && format <= GE_TFMT_CLUT32;
+}
+
+// How much DecodeDirectTextureLevel may read for a level: whole swizzle blocks or DXT blocks, and rows of at least w.
+static u32 AsyncLevelSourceSize(GETextureFormat format, int w, int h, int bufw, bool swizzled) {
+	int alignedH = swizzled ? ((h + 7) & ~7) : ((h + 3) & ~3);
+	return (textureBitsPerPixel[format] * std::max(bufw, w) * alignedH) / 8;
+}
+
 void TextureCacheGLES::BuildTexture(TexCacheEntry *const entry) {
-	entry->status &= ~TexCacheEntry::STATUS_ALPHA_MASK;
+	// Any decode still in flight for this entry is outdated now.
+	entry->status &= ~(TexCacheEntry::STATUS_ALPHA_MASK | TexCacheEntry::STATUS_ASYNC_PENDING);
 
 	// For the estimate, we assume cluts always point to 8888 for simplicity.
 	cacheSizeEstimate_ += EstimateTexMemoryUsage(entry);
@@ -518,6 +602,19 @@ void TextureCacheGLES::BuildTexture(TexCacheEntry *const entry) {
 		return;
 	}
 
+	if (entry->status & TexCacheEntry::STATUS_SHADER_CLUT) {
+		// Only the indices are uploaded, so palette changes don't need a new texture.
+		LoadIndexTexture(*entry);
+		render_->FinalizeTexture(entry->textureName, 0, false);
+		entry->status |= TexCacheEntry::STATUS_BAD_MIPS;
+		SetTexMemoryUsage(entry, gstate.getTextureWidth(0), gstate.getTextureHeight(0), 1, 8);
+
+		lastBoundTexture = entry->textureName;
+		render_->BindTexture(0, entry->textureName);
+		UpdateSamplingParams(*entry, true);
+		return;
+	}
+
 	// Adjust maxLevel to actually present levels..
 	bool badMipSizes = false;
 	bool canAutoGen = false;
@@ -565,10 +662,9 @@ void TextureCacheGLES::BuildTexture(TexCacheEntry *const entry) {
 		scaleFactor = scaleFactor > 4 ? 4 : (scaleFactor > 2 ? 2 : 1);
 	}
 
-	u64 cachekey = replacer_.Enabled() ? entry->CacheKey() : 0;
 	int w = gstate.getTextureWidth(0);
 	int h = gstate.getTextureHeight(0);
-	ReplacedTexture &replaced = replacer_.FindReplacement(cachekey, entry->fullhash, w, h);
+	ReplacedTexture &replaced = FindReplacement(entry, w, h);
 	if (replaced.GetSize(0, w, h)) {
 		// We're replacing, so we won't scale.
 		scaleFactor = 1;
@@ -588,7 +684,8 @@ void TextureCacheGLES::BuildTexture(TexCacheEntry *const entry) {
 	}
 
 	if (scaleFactor != 1) {
-		if (texelsScaledThisFrame_ >= TEXCACHE_MAX_TEXELS_SCALED) {
+		// Ones we've scaled before are just a copy, so don't count those.
+		if (texelsScaledThisFrame_ >= TEXCACHE_MAX_TEXELS_SCALED && !scaler.IsScaleCached(entry->ContentKey(), dstFmt, w, h, scaleFactor)) {
 			entry->status |= TexCacheEntry::STATUS_TO_SCALE;
 			scaleFactor = 1;
 		} else {
@@ -606,13 +703,24 @@ void TextureCacheGLES::BuildTexture(TexCacheEntry *const entry) {
 	// the bottom few levels or rely on OpenGL's autogen mipmaps instead, which might not
 	// be as good quality as the game's own (might even be better in some cases though).
 
+	std::shared_ptr<AsyncTexBuild> asyncBuild;
+	if (CanBuildAsync(*entry, maxLevel, scaleFactor, dstFmt)) {
+		asyncBuild = std::make_shared<AsyncTexBuild>();
+		asyncBuild->format = GETextureFormat(entry->format);
+		asyncBuild->scaleFactor = scaleFactor;
+		asyncBuild->contentKey = entry->ContentKey();
+	}
+
 	// Always load base level texture here 
 	if (IsFakeMipmapChange()) {
 		// NOTE: Since the level is not part of the cache key, we assume it never changes.
 		u8 level = std::max(0, gstate.getTexLevelOffset16() / 16);
 		LoadTextureLevel(*entry, replaced, level, scaleFactor, dstFmt);
-	} else
+	} else if (asyncBuild) {
+		PrepareAsyncLevel(*entry, *asyncBuild, 0, dstFmt);
+	} else {
 		LoadTextureLevel(*entry, replaced, 0, scaleFactor, dstFmt);
+	}
 
 	// Mipmapping only enable when texture scaling disable
 	int texMaxLevel = 0;
@@ -629,7 +737,10 @@ void TextureCacheGLES::BuildTexture(TexCacheEntry *const entry) {
 				}
 			} else {
 				for (int i = 1; i <= maxLevel; i++) {
-					LoadTextureLevel(*entry, replaced, i, scaleFactor, dstFmt);
+					if (asyncBuild)
+						PrepareAsyncLevel(*entry, *asyncBuild, i, dstFmt);
+					else
+						LoadTextureLevel(*entry, replaced, i, scaleFactor, dstFmt);
 				}
 				texMaxLevel = maxLevel;
 			}
@@ -655,7 +766,25 @@ void TextureCacheGLES::BuildTexture(TexCacheEntry *const entry) {
 		entry->SetAlphaStatus(TexCacheEntry::TexStatus(replaced.AlphaStatus()));
 	}
 
-	render_->FinalizeTexture(entry->textureName, texMaxLevel, genMips);
+	// Scaled and replaced textures are always 8888, and generated mips go all the way down to 1x1.
+	int bitsPerPixel = scaleFactor > 1 || replaced.Valid() || dstFmt == GL_UNSIGNED_BYTE ? 32 : 16;
+	SetTexMemoryUsage(entry, w * scaleFactor, h * scaleFactor, genMips ? 16 : texMaxLevel + 1, bitsPerPixel);
+
+	if (asyncBuild) {
+		asyncBuild->texMaxLevel = texMaxLevel;
+		asyncBuild->genMips = genMips;
+		asyncBuild->badMips = (entry->status & TexCacheEntry::STATUS_BAD_MIPS) != 0;
+		LoadAsyncPlaceholder(*entry, *asyncBuild);
+
+		QueueAsyncDecode(entry, [this, asyncBuild]() {
+			DecodeAsyncBuild(*asyncBuild);
+		}, [this, asyncBuild](TexCacheEntry *entry) {
+			if (entry)
+				FinishAsyncBuild(entry, *asyncBuild);
+		});
+	} else {
+		render_->FinalizeTexture(entry->textureName, texMaxLevel, genMips);
+	}
 
 	// This will rebind it, but that's okay.
 	// Need to actually bind it now - it might only have gotten bound in the init phase.
@@ -751,7 +880,7 @@ void TextureCacheGLES::LoadTextureLevel(TexCacheEntry &entry, ReplacedTexture &r
 
 		if (scaleFactor > 1) {
 			uint8_t *rearrange = (uint8_t *)AllocateAlignedMemory(w * scaleFactor * h * scaleFactor * 4, 16);
-			scaler.ScaleAlways((u32 *)rearrange, (u32 *)pixelData, dstFmt, w, h, scaleFactor);
+			scaler.ScaleAlways((u32 *)rearrange, (u32 *)pixelData, dstFmt, w, h, scaleFactor, entry.ContentKey());
 			FreeAlignedMemory(pixelData);
 			pixelData = rearrange;
 		}
@@ -785,6 +914,181 @@ void TextureCacheGLES::LoadTextureLevel(TexCacheEntry &entry, ReplacedTexture &r
 		render_->TextureImage(entry.textureName, level, w, h, components, components2, dstFmt, pixelData, GLRAllocType::ALIGNED);
 }
 
+void TextureCacheGLES::LoadIndexTexture(TexCacheEntry &entry) {
+	int w = gstate.getTextureWidth(0);
+	int h = gstate.getTextureHeight(0);
+	u32 texaddr = gstate.getTextureAddress(0);
+	int bufw = GetTextureBufw(0, texaddr, GETextureFormat(entry.format));
+
+	gpuStats.numTexturesDecoded++;
+
+	PROFILE_THIS_SCOPE("decodetex");
+	// Pad rows to the default unpack alignment of 4.
+	int pitch = (w + 3) & ~3;
+	uint8_t *pixelData = (uint8_t *)AllocateAlignedMemory(pitch * h, 16);
+	DecodeIndexLevel(pixelData, pitch, GETextureFormat(entry.format), texaddr, 0, bufw);
+
+	// Either way, the index ends up in .r when sampled.
+	bool useR8 = gl_extensions.IsGLES ? gl_extensions.GLES3 : gl_extensions.VersionGEThan(3, 0);
+	GLenum components = useR8 ? GL_RED : GL_LUMINANCE;
+	GLenum internalFormat = useR8 ? GL_R8 : GL_LUMINANCE;
+
+	PROFILE_THIS_SCOPE("loadtex");
+	render_->TextureImage(entry.textureName, 0, w, h, internalFormat, components, GL_UNSIGNED_BYTE, pixelData, GLRAllocType::ALIGNED);
+}
+
+bool TextureCacheGLES::CanBuildAsync(const TexCacheEntry &entry, int maxLevel, int scaleFactor, GLenum dstFmt) {
+	if (replacer_.Enabled() || IsFakeMipmapChange())
+		return false;
+	// Videos and such would just show the placeholder all the time.
+	if ((entry.status & TexCacheEntry::STATUS_CHANGE_FREQUENT) != 0)
+		return false;
+
+	int w = gstate.getTextureWidth(0);
+	int h = gstate.getTextureHeight(0);
+	// Scaling is slow enough to always do on the thread, showing the unscaled texture meanwhile.
+	// Unless it's been scaled recently, then it's just a copy.
+	if (scaleFactor > 1 && g_Config.bTexScalingAsync && !scaler.IsScaleCached(entry.ContentKey(), dstFmt, w, h, scaleFactor))
+		return true;
+
+	if (!AsyncDecodeEnabled() || w * h < ASYNC_DECODE_MIN_TEXELS)
+		return false;
+
+	GETextureFormat format = GETextureFormat(entry.format);
+	if (IsClutFormat(format)) {
+		// These are decoded here since they depend on the CLUT state, only scaling is left for the thread.
+		return scaleFactor > 1;
+	}
+
+	for (int i = 0; i <= maxLevel; i++) {
+		u32 texaddr = gstate.getTextureAddress(i);
+		// Leave VRAM mirrors (and their swizzle quirks) to the regular path.
+		if ((texaddr & 0x00600000) != 0 && Memory::IsVRAMAddress(texaddr))
+			return false;
+		int w = gstate.getTextureWidth(i);
+		int h = gstate.getTextureHeight(i);
+		int bufw = GetTextureBufw(i, texaddr, format);
+		if (!Memory::IsValidRange(texaddr, AsyncLevelSourceSize(format, w, h, bufw, gstate.isTextureSwizzled())))
+			return false;
+	}
+	return true;
+}
+
+void TextureCacheGLES::PrepareAsyncLevel(TexCacheEntry &entry, AsyncTexBuild &build, int level, GLenum dstFmt) {
+	AsyncTexBuild::Level lv{};
+	lv.w = gstate.getTextureWidth(level);
+	lv.h = gstate.getTextureHeight(level);
+	u32 texaddr = gstate.getTextureAddress(level);
+	lv.bufw = GetTextureBufw(level, texaddr, build.format);
+	lv.swizzled = gstate.isTextureSwizzled();
+	lv.dstFmt = dstFmt;
+
+	gpuStats.numTexturesDecoded++;
+
+	// When scaling, decode right away so the placeholder can be the unscaled texture.
+	if (IsClutFormat(build.format) || build.scaleFactor > 1) {
+		PROFILE_THIS_SCOPE("decodetex");
+		int pixelSize = dstFmt == GL_UNSIGNED_BYTE ? 4 : 2;
+		int decPitch = lv.w * pixelSize;
+		lv.src = (u8 *)AllocateAlignedMemory(decPitch * lv.h * pixelSize, 16);
+		DecodeTextureLevel(lv.src, decPitch, build.format, gstate.getClutPaletteFormat(), texaddr, level, lv.bufw, true, false, false);
+		lv.decoded = true;
+	} else {
+		// The game may overwrite the texture before the thread gets to it, so take a copy.
+		u32 size = AsyncLevelSourceSize(build.format, lv.w, lv.h, lv.bufw, lv.swizzled);
+		lv.src = (u8 *)AllocateAlignedMemory(size, 16);
+		memcpy(lv.src, Memory::GetPointer(texaddr), size);
+	}
+	build.levels.push_back(lv);
+}
+
+void TextureCacheGLES::LoadAsyncPlaceholder(TexCacheEntry &entry, AsyncTexBuild &build) {
+	const AsyncTexBuild::Level &base = build.levels[0];
+	int w = 1;
+	int h = 1;
+	GLenum dstFmt = GL_UNSIGNED_BYTE;
+	u8 *pixels = nullptr;
+
+	if (base.decoded) {
+		// Only scaling is left, so show it unscaled meanwhile.
+		int pixelSize = base.dstFmt == GL_UNSIGNED_BYTE ? 4 : 2;
+		w = base.w;
+		h = base.h;
+		dstFmt = base.dstFmt;
+		pixels = (u8 *)AllocateAlignedMemory(w * h * pixelSize, 16);
+		memcpy(pixels, base.src, w * h * pixelSize);
+	} else if (build.texMaxLevel > 0) {
+		// The smallest mip is cheap to decode right away.
+		const AsyncTexBuild::Level &last = build.levels[build.texMaxLevel];
+		int pixelSize = last.dstFmt == GL_UNSIGNED_BYTE ? 4 : 2;
+		w = last.w;
+		h = last.h;
+		dstFmt = last.dstFmt;
+		pixels = (u8 *)AllocateAlignedMemory(w * h * pixelSize * pixelSize, 16);
+		SimpleBuf<u32> tmp;
+		DecodeDirectTextureLevel(pixels, w * pixelSize, build.format, last.src, w, h, last.bufw, last.swizzled, true, false, false, tmp);
+	} else {
+		// Nothing cheap to show, so transparent until it's ready.
+		pixels = (u8 *)AllocateAlignedMemory(4, 16);
+		memset(pixels, 0, 4);
+	}
+
+	GLuint components = dstFmt == GL_UNSIGNED_SHORT_5_6_5 ? GL_RGB : GL_RGBA;
+	render_->TextureImage(entry.textureName, 0, w, h, components, components, dstFmt, pixels, GLRAllocType::ALIGNED);
+	render_->FinalizeTexture(entry.textureName, 0, false);
+
+	// Only the one level for now, and we don't know about alpha yet.
+	entry.status |= TexCacheEntry::STATUS_BAD_MIPS;
+	entry.SetAlphaStatus(TexCacheEntry::STATUS_ALPHA_UNKNOWN);
+}
+
+void TextureCacheGLES::DecodeAsyncBuild(AsyncTexBuild &build) {
+	SimpleBuf<u32> tmp;
+	for (size_t i = 0; i < build.levels.size(); i++) {
+		AsyncTexBuild::Level &lv = build.levels[i];
+		u8 *pixels = lv.src;
+		lv.src = nullptr;
+		if (!lv.decoded) {
+			int pixelSize = lv.dstFmt == GL_UNSIGNED_BYTE ? 4 : 2;
+			int decPitch = lv.w * pixelSize;
+			u8 *decoded = (u8 *)AllocateAlignedMemory(decPitch * lv.h * pixelSize, 16);
+			DecodeDirectTextureLevel(decoded, decPitch, build.format, pixels, lv.w, lv.h, lv.bufw, lv.swizzled, true, false, false, tmp);
+			FreeAlignedMemory(pixels);
+			pixels = decoded;
+		}
+
+		// We check before scaling since scaling shouldn't invent alpha from a full alpha texture.
+		lv.alphaStatus = CheckAlpha(pixels, lv.dstFmt, lv.w, lv.w, lv.h);
+
+		if (build.scaleFactor > 1) {
+			u8 *rearrange = (u8 *)AllocateAlignedMemory(lv.w * build.scaleFactor * lv.h * build.scaleFactor * 4, 16);
+			asyncScaler_.ScaleAlways((u32 *)rearrange, (u32 *)pixels, lv.dstFmt, lv.w, lv.h, build.scaleFactor, build.contentKey);
+			FreeAlignedMemory(pixels);
+			pixels = rearrange;
+		}
+		lv.pixels = pixels;
+	}
+}
+
+void TextureCacheGLES::FinishAsyncBuild(TexCacheEntry *entry, AsyncTexBuild &build) {
+	for (size_t i = 0; i < build.levels.size(); i++) {
+		AsyncTexBuild::Level &lv = build.levels[i];
+		GLuint components = lv.dstFmt == GL_UNSIGNED_SHORT_5_6_5 ? GL_RGB : GL_RGBA;
+		render_->TextureImage(entry->textureName, (int)i, lv.w, lv.h, components, components, lv.dstFmt, lv.pixels, GLRAllocType::ALIGNED);
+		lv.pixels = nullptr;
+		entry->SetAlphaStatus(lv.alphaStatus, (int)i);
+	}
+	render_->FinalizeTexture(entry->textureName, build.texMaxLevel, build.genMips);
+
+	if (build.badMips)
+		entry->status |= TexCacheEntry::STATUS_BAD_MIPS;
+	else
+		entry->status &= ~TexCacheEntry::STATUS_BAD_MIPS;
+
+	// Sampling params depend on the levels, and this might be the bound texture.
+	ForgetLastTexture();
+}
+
 bool TextureCacheGLES::GetCurrentTextureDebug(GPUDebugBuffer &buffer, int level) {
 #ifndef USING_GLES2
 	GPUgstate saved;
@@ -829,7 +1133,24 @@ bool TextureCacheGLES::GetCurrentTextureDebug(GPUDebugBuffer &buffer, int level)
 	}
 
 	buffer.Allocate(w, h, GE_FORMAT_8888, false);
-	renderManager->CopyImageToMemorySync(entry->textureName, level, 0, 0, w, h, Draw::DataFormat::R8G8B8A8_UNORM, (uint8_t *)buffer.GetData(), w);
+	if (entry->status & TexCacheEntry::STATUS_SHADER_CLUT) {
+		// The texture only holds indices, so look them up on the CPU instead.
+		u32 texaddr = gstate.getTextureAddress(level);
+		int bufw = GetTextureBufw(level, texaddr, GETextureFormat(entry->format));
+		int pitch = (w + 3) & ~3;
+		std::vector<u8> indices(pitch * h);
+		DecodeIndexLevel(indices.data(), pitch, GETextureFormat(entry->format), texaddr, level, bufw);
+		u32 colors[256];
+		BuildLookupClut(colors);
+		u32 *dst = (u32 *)buffer.GetData();
+		for (int y = 0; y < h; ++y) {
+			for (int x = 0; x < w; ++x) {
+				dst[y * w + x] = colors[indices[y * pitch + x]];
+			}
+		}
+	} else {
+		renderManager->CopyImageToMemorySync(entry->textureName, level, 0, 0, w, h, Draw::DataFormat::R8G8B8A8_UNORM, (uint8_t *)buffer.GetData(), w);
+	}
 	gstate_c.Dirty(DIRTY_TEXTURE_IMAGE | DIRTY_TEXTURE_PARAMS);
 	framebufferManager_->RebindFramebuffer();
 
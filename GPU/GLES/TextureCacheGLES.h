@@ -33,6 +33,7 @@ class DepalShaderCacheGLES;
 class ShaderManagerGLES;
 class DrawEngineGLES;
 class GLRTexture;
+struct AsyncTexBuild;
 
 class TextureCacheGLES : public TextureCacheCommon {
 public:
@@ -72,10 +73,13 @@ class TextureCacheGLES : public TextureCacheCommon {
 	void BindTexture(TexCacheEntry *entry) override;
 	void Unbind() override;
 	void ReleaseTexture(TexCacheEntry *entry, bool delete_them) override;
+	bool SupportsClutLookupInShader() const override { return true; }
 
 private:
 	void UpdateSamplingParams(TexCacheEntry &entry, bool force);
 	void LoadTextureLevel(TexCacheEntry &entry, ReplacedTexture &replaced, int level, int scaleFactor, GLenum dstFmt);
+	void LoadIndexTexture(TexCacheEntry &entry);
+	void BindLookupClut(TexCacheEntry *entry);
 	GLenum GetDestFormat(GETextureFormat format, GEPaletteFormat clutFormat) const;
 
 	TexCacheEntry::TexStatus CheckAlpha(const uint8_t *pixelData, GLenum dstFmt, int stride, int w, int h);
@@ -84,9 +88,17 @@ class TextureCacheGLES : public TextureCacheCommon {
 
 	void BuildTexture(TexCacheEntry *const entry) override;
 
+	bool CanBuildAsync(const TexCacheEntry &entry, int maxLevel, int scaleFactor, GLenum dstFmt);
+	void PrepareAsyncLevel(TexCacheEntry &entry, AsyncTexBuild &build, int level, GLenum dstFmt);
+	void LoadAsyncPlaceholder(TexCacheEntry &entry, AsyncTexBuild &build);
+	void DecodeAsyncBuild(AsyncTexBuild &build);
+	void FinishAsyncBuild(TexCacheEntry *entry, AsyncTexBuild &build);
+
 	GLRenderManager *render_;
 
 	TextureScalerGLES scaler;
+	// Only used from the async decode thread.
+	TextureScalerGLES asyncScaler_;
 
 	GLRTexture *lastBoundTexture;
 
@@ -97,6 +109,13 @@ class TextureCacheGLES : public TextureCacheCommon {
 
 	GLRInputLayout *shadeInputLayout_;
 
+	// The palette last built for shader lookups, rebuilt when the CLUT or its format changes.
+	u32 lookupClut_[256];
+	u32 lookupClutId_ = 0;
+	bool lookupClutValid_ = false;
+	bool lookupClutFullAlpha4_ = false;
+	bool lookupClutFullAlpha8_ = false;
+
 	enum { INVALID_TEX = -1 };
 };
 
@@ -148,6 +148,7 @@ void GenerateVertexShader(const VShaderID &id, char *buffer, uint32_t *attrMask,
 	bool doFlatShading = id.Bit(VS_BIT_FLATSHADE);
 
 	bool useHWTransform = id.Bit(VS_BIT_USE_HW_TRANSFORM);
+	bool rectInstanced = id.Bit(VS_BIT_RECT_INSTANCED) && !useHWTransform;
 	bool hasColor = id.Bit(VS_BIT_HAS_COLOR) || !useHWTransform;
 	bool hasNormal = id.Bit(VS_BIT_HAS_NORMAL) && useHWTransform;
 	bool hasTexcoord = id.Bit(VS_BIT_HAS_TEXCOORD) || !useHWTransform;
@@ -191,6 +192,11 @@ void GenerateVertexShader(const VShaderID &id, char *buffer, uint32_t *attrMask,
 		WRITE(p, "%s mediump vec3 normal;\n", attribute);
 		*attrMask |= 1 << ATTR_NORMAL;
 	}
+	if (rectInstanced) {
+		// The top left corner's x, y, u, v. Everything else comes from the bottom right.
+		WRITE(p, "%s vec4 normal;\n", attribute);
+		*attrMask |= 1 << ATTR_NORMAL;
+	}
 
 	bool texcoordVec3In = false;
 	if (doTexture && hasTexcoord) {
@@ -403,7 +409,28 @@ void GenerateVertexShader(const VShaderID &id, char *buffer, uint32_t *attrMask,
 
 	WRITE(p, "void main() {\n");
 
-	if (!useHWTransform) {
+	if (rectInstanced) {
+		// Expand the rectangle instance into corner gl_VertexID. Corners 0-3 are BR, TR, TL, BL,
+		// same as SoftwareTransform, including swapping the TR and BL UVs if the rect is rotated.
+		WRITE(p, "  int corner = gl_VertexID;\n");
+		WRITE(p, "  vec2 rectpos = vec2(corner >= 2 ? normal.x : position.x, (corner == 1 || corner == 2) ? normal.y : position.y);\n");
+		if (doTexture) {
+			WRITE(p, "  bool rectrot = (normal.x < position.x && normal.y > position.y) || (normal.x > position.x && normal.y < position.y);\n");
+			WRITE(p, "  int uvcorner = rectrot && (corner == 1 || corner == 3) ? 4 - corner : corner;\n");
+			WRITE(p, "  v_texcoord = vec3(uvcorner >= 2 ? normal.z : texcoord.x, (uvcorner == 1 || uvcorner == 2) ? normal.w : texcoord.y, 1.0);\n");
+		}
+		if (hasColor) {
+			WRITE(p, "  v_color0 = color0;\n");
+			if (lmode)
+				WRITE(p, "  v_color1 = color1;\n");
+		} else {
+			WRITE(p, "  v_color0 = u_matambientalpha;\n");
+			if (lmode)
+				WRITE(p, "  v_color1 = vec3(0.0);\n");
+		}
+		// Only through mode, so no fog.
+		WRITE(p, "  gl_Position = u_proj_through * vec4(rectpos, position.z, 1.0);\n");
+	} else if (!useHWTransform) {
 		// Simple pass-through of vertex data to fragment shader
 		if (doTexture) {
 			if (texcoordVec3In) {
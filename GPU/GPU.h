@@ -67,9 +67,32 @@ struct GPUStatistics {
 		numShaderSwitches = 0;
 		numFlushes = 0;
 		numTexturesDecoded = 0;
+		numTextureHashesSkipped = 0;
+		numTextureHashesSampled = 0;
 		numReadbacks = 0;
+		numAsyncReadbacks = 0;
+		msReadbackStall = 0;
 		numUploads = 0;
 		numClears = 0;
+		numVertsDecodedByFallback = 0;
+		numSkinnedDrawCalls = 0;
+		numSkinnedVerts = 0;
+		numSkinnedVertsByFallback = 0;
+		numVertexCacheMisses = 0;
+		numVertexCacheUploadBytes = 0;
+		numStateFlushes = 0;
+		numPrimFlushes = 0;
+		numFullFlushes = 0;
+		numMergedStateChanges = 0;
+		numBBoxTests = 0;
+		numBBoxCulled = 0;
+		numFBOsCreated = 0;
+		numPooledFBOsReused = 0;
+		numBlockTransfersGPU = 0;
+		numBlockTransfersCPU = 0;
+		numBlockTransferDownloads = 0;
+		numBlockTransferUploads = 0;
+		numPipelineFallbacks = 0;
 		msProcessingDisplayLists = 0;
 		vertexGPUCycles = 0;
 		otherGPUCycles = 0;
@@ -88,9 +111,41 @@ struct GPUStatistics {
 	int numTextureSwitches;
 	int numShaderSwitches;
 	int numTexturesDecoded;
+	// Full hashes skipped since write tracking saw no writes to the texture.
+	int numTextureHashesSkipped;
+	// Full hashes replaced by a sampled check, for textures that stayed the same a long time.
+	int numTextureHashesSampled;
 	int numReadbacks;
+	// Readbacks that didn't wait for the GPU, and time spent waiting on the rest.
+	int numAsyncReadbacks;
+	double msReadbackStall;
 	int numUploads;
 	int numClears;
+	int numVertsDecodedByFallback;
+	// Skinning is done while decoding, at submit.  Fallback verts went through the interpreter.
+	int numSkinnedDrawCalls;
+	int numSkinnedVerts;
+	int numSkinnedVertsByFallback;
+	int numVertexCacheMisses;
+	int numVertexCacheUploadBytes;
+	// Flushes by reason, the rest of numFlushes are for readbacks, block transfers, list ends, etc.
+	int numStateFlushes;
+	int numPrimFlushes;
+	int numFullFlushes;
+	// State changes that didn't flush since the pending draws don't use that state.
+	int numMergedStateChanges;
+	// Bounding box tests (BBOX), and how many of them rejected the draws that follow.
+	int numBBoxTests;
+	int numBBoxCulled;
+	int numFBOsCreated;
+	int numPooledFBOsReused;
+	// Block transfers done with blits, and ones done in RAM, some of which needed a framebuffer download or upload.
+	int numBlockTransfersGPU;
+	int numBlockTransfersCPU;
+	int numBlockTransferDownloads;
+	int numBlockTransferUploads;
+	// Draws that used a stand-in pipeline while the real one was still being created.
+	int numPipelineFallbacks;
 	double msProcessingDisplayLists;
 	int vertexGPUCycles;
 	int otherGPUCycles;
@@ -98,6 +153,12 @@ struct GPUStatistics {
 
 	// Flip count. Doesn't really belong here.
 	int numFlips;
+	// Vertex formats the vertex decoder JIT couldn't handle, since startup.
+	int numJitFallbackDecoders;
+	// Like msProcessingDisplayLists (which is actually in seconds), but never reset per frame.
+	double secondsProcessingDisplayListsTotal;
+	// Both texture caches, as of the last decimation.
+	u32 textureCacheBytes;
 };
 
 extern GPUStatistics gpuStats;
@@ -1,9 +1,11 @@
 #include <algorithm>
 #include <type_traits>
 #include <mutex>
+#include <thread>
 
 #include "base/timeutil.h"
 #include "profiler/profiler.h"
+#include "thread/threadutil.h"
 
 #include "Common/ColorConv.h"
 #include "Core/Reporting.h"
@@ -355,6 +357,67 @@ size_t commonCommandTableSize = ARRAY_SIZE(commonCommandTable);
 // TODO: Make class member?
 GPUCommon::CommandInfo GPUCommon::cmdInfo_[256];
 
+// State that's only read while some feature is on.  Since the feature's enable flushes on change,
+// the pending draws all have it off if it's off now, and changes to the gated state can't reach them.
+enum StateGate : u8 {
+	GATE_NONE,
+	GATE_FOG,
+	GATE_LIGHTING,
+	GATE_TEXTURE,
+	GATE_ALPHATEST,
+	GATE_COLORTEST,
+	GATE_LOGICOP,
+	GATE_DEPTHTEST,
+};
+
+static const struct {
+	u8 cmd;
+	StateGate gate;
+} stateGateTable[] = {
+	{ GE_CMD_FOGCOLOR, GATE_FOG },
+	{ GE_CMD_FOG1, GATE_FOG },
+	{ GE_CMD_FOG2, GATE_FOG },
+
+	{ GE_CMD_LIGHTMODE, GATE_LIGHTING },
+	{ GE_CMD_MATERIALUPDATE, GATE_LIGHTING },
+	{ GE_CMD_AMBIENTCOLOR, GATE_LIGHTING },
+	{ GE_CMD_AMBIENTALPHA, GATE_LIGHTING },
+	{ GE_CMD_MATERIALDIFFUSE, GATE_LIGHTING },
+	{ GE_CMD_MATERIALEMISSIVE, GATE_LIGHTING },
+	{ GE_CMD_MATERIALSPECULAR, GATE_LIGHTING },
+	{ GE_CMD_MATERIALSPECULARCOEF, GATE_LIGHTING },
+	// Not the material ambient, that's the vertex color when there is none.
+
+	{ GE_CMD_TEXENVCOLOR, GATE_TEXTURE },
+	{ GE_CMD_TEXFILTER, GATE_TEXTURE },
+	{ GE_CMD_TEXWRAP, GATE_TEXTURE },
+	{ GE_CMD_TEXLODSLOPE, GATE_TEXTURE },
+	// Not TEXFUNC, whether texture alpha is used feeds into the trivial alpha test check.
+
+	{ GE_CMD_ALPHATEST, GATE_ALPHATEST },
+	{ GE_CMD_COLORTEST, GATE_COLORTEST },
+	{ GE_CMD_COLORREF, GATE_COLORTEST },
+	{ GE_CMD_COLORTESTMASK, GATE_COLORTEST },
+	{ GE_CMD_LOGICOP, GATE_LOGICOP },
+	{ GE_CMD_ZTEST, GATE_DEPTHTEST },
+};
+
+static StateGate stateGates[256];
+
+static bool IsGatedStateUnused(StateGate gate) {
+	switch (gate) {
+	case GATE_FOG: return !gstate.isFogEnabled();
+	// Environment mapping reads the light positions even with lighting off.
+	case GATE_LIGHTING: return !gstate.isLightingEnabled() && gstate.getUVGenMode() != GE_TEXMAP_ENVIRONMENT_MAP;
+	case GATE_TEXTURE: return !gstate.isTextureMapEnabled();
+	case GATE_ALPHATEST: return !gstate.isAlphaTestEnabled();
+	case GATE_COLORTEST: return !gstate.isColorTestEnabled();
+	case GATE_LOGICOP: return !gstate.isLogicOpEnabled();
+	case GATE_DEPTHTEST: return !gstate.isDepthTestEnabled();
+	default: return false;
+	}
+}
+
 void GPUCommon::Flush() {
 	drawEngineCommon_->DispatchFlush();
 }
@@ -403,12 +466,38 @@ GPUCommon::GPUCommon(GraphicsContext *gfxCtx, Draw::DrawContext *draw) :
 			ERROR_LOG(G3D, "Command missing from table: %02x (%i)", i, i);
 		}
 	}
+
+	memset(stateGates, 0, sizeof(stateGates));
+	for (const auto &entry : stateGateTable) {
+		stateGates[entry.cmd] = entry.gate;
+	}
+	// All the light parameters, including the per light enables and types.
+	for (int cmd = GE_CMD_LIGHTENABLE0; cmd <= GE_CMD_LIGHTENABLE3; cmd++) {
+		stateGates[cmd] = GATE_LIGHTING;
+	}
+	for (int cmd = GE_CMD_LIGHTTYPE0; cmd <= GE_CMD_LSC3; cmd++) {
+		stateGates[cmd] = GATE_LIGHTING;
+	}
+}
+
+void GPUCommon::FlushBeforeStateChange(u8 cmd) {
+	if (!drawEngineCommon_->GetNumDrawCalls())
+		return;
+	if (IsGatedStateUnused(stateGates[cmd])) {
+		// Keep merging, the dirty flags will still pick up the new value at the next flush.
+		gpuStats.numMergedStateChanges++;
+		return;
+	}
+	gpuStats.numStateFlushes++;
+	drawEngineCommon_->DispatchFlush();
 }
 
 GPUCommon::~GPUCommon() {
+	StopThread();
 }
 
 void GPUCommon::BeginHostFrame() {
+	SyncThread();
 	ReapplyGfxState();
 
 	// TODO: Assume config may have changed - maybe move to resize.
@@ -416,10 +505,12 @@ void GPUCommon::BeginHostFrame() {
 }
 
 void GPUCommon::EndHostFrame() {
-
+	SyncThread();
 }
 
 void GPUCommon::Reinitialize() {
+	SyncThread();
+	commandRuns_.clear();
 	memset(dls, 0, sizeof(dls));
 	for (int i = 0; i < DisplayListMaxCount; ++i) {
 		dls[i].state = PSP_GE_DL_STATE_NONE;
@@ -479,6 +570,7 @@ void GPUCommon::PopDLQueue() {
 }
 
 bool GPUCommon::BusyDrawing() {
+	SyncThread();
 	u32 state = DrawSync(1);
 	if (state == PSP_GE_LIST_DRAWING || state == PSP_GE_LIST_STALLING) {
 		if (currentList && currentList->state != PSP_GE_DL_STATE_PAUSED) {
@@ -497,6 +589,7 @@ void GPUCommon::DumpNextFrame() {
 }
 
 u32 GPUCommon::DrawSync(int mode) {
+	SyncThread();
 	if (mode < 0 || mode > 1)
 		return SCE_KERNEL_ERROR_INVALID_MODE;
 
@@ -545,6 +638,7 @@ void GPUCommon::CheckDrawSync() {
 }
 
 int GPUCommon::ListSync(int listid, int mode) {
+	SyncThread();
 	if (listid < 0 || listid >= DisplayListMaxCount)
 		return SCE_KERNEL_ERROR_INVALID_ID;
 
@@ -589,6 +683,7 @@ int GPUCommon::ListSync(int listid, int mode) {
 }
 
 int GPUCommon::GetStack(int index, u32 stackPtr) {
+	SyncThread();
 	if (!currentList) {
 		// Seems like it doesn't return an error code?
 		return 0;
@@ -614,6 +709,7 @@ int GPUCommon::GetStack(int index, u32 stackPtr) {
 }
 
 u32 GPUCommon::EnqueueList(u32 listpc, u32 stall, int subIntrBase, PSPPointer<PspGeListArgs> args, bool head) {
+	SyncThread();
 	// TODO Check the stack values in missing arg and ajust the stack depth
 
 	// Check alignment
@@ -719,6 +815,7 @@ u32 GPUCommon::EnqueueList(u32 listpc, u32 stall, int subIntrBase, PSPPointer<Ps
 }
 
 u32 GPUCommon::DequeueList(int listid) {
+	SyncThread();
 	if (listid < 0 || listid >= DisplayListMaxCount || dls[listid].state == PSP_GE_DL_STATE_NONE)
 		return SCE_KERNEL_ERROR_INVALID_ID;
 
@@ -742,6 +839,7 @@ u32 GPUCommon::DequeueList(int listid) {
 }
 
 u32 GPUCommon::UpdateStall(int listid, u32 newstall) {
+	SyncThread();
 	if (listid < 0 || listid >= DisplayListMaxCount || dls[listid].state == PSP_GE_DL_STATE_NONE)
 		return SCE_KERNEL_ERROR_INVALID_ID;
 	auto &dl = dls[listid];
@@ -756,6 +854,7 @@ u32 GPUCommon::UpdateStall(int listid, u32 newstall) {
 }
 
 u32 GPUCommon::Continue() {
+	SyncThread();
 	if (!currentList)
 		return 0;
 
@@ -796,6 +895,7 @@ u32 GPUCommon::Continue() {
 }
 
 u32 GPUCommon::Break(int mode) {
+	SyncThread();
 	if (mode < 0 || mode > 1)
 		return SCE_KERNEL_ERROR_INVALID_MODE;
 
@@ -878,8 +978,10 @@ void GPUCommon::NotifySteppingExit() {
 
 bool GPUCommon::InterpretList(DisplayList &list) {
 	// Initialized to avoid a race condition with bShowDebugStats changing.
+	// Auto frameskip needs the list time too, to tell render cost from emulation cost.
+	const bool collectTime = coreCollectDebugStats || g_Config.bAutoFrameSkip;
 	double start = 0.0;
-	if (coreCollectDebugStats) {
+	if (collectTime) {
 		time_update();
 		start = time_now_d();
 	}
@@ -944,12 +1046,13 @@ bool GPUCommon::InterpretList(DisplayList &list) {
 
 	list.offsetAddr = gstate_c.offsetAddr;
 
-	if (coreCollectDebugStats) {
+	if (collectTime) {
 		time_update();
 		double total = time_now_d() - start - timeSpentStepping_;
 		hleSetSteppingTime(timeSpentStepping_);
 		timeSpentStepping_ = 0.0;
 		gpuStats.msProcessingDisplayLists += total;
+		gpuStats.secondsProcessingDisplayListsTotal += total;
 	}
 	return gpuState == GPUSTATE_DONE || gpuState == GPUSTATE_ERROR;
 }
@@ -957,6 +1060,14 @@ bool GPUCommon::InterpretList(DisplayList &list) {
 // Maybe should write this in ASM...
 void GPUCommon::FastRunLoop(DisplayList &list) {
 	PROFILE_THIS_SCOPE("gpuloop");
+	if (g_Config.bGECommandCache)
+		FastRunLoopFor<true>(list);
+	else
+		FastRunLoopFor<false>(list);
+}
+
+template <bool useCommandCache>
+void GPUCommon::FastRunLoopFor(DisplayList &list) {
 	const CommandInfo *cmdInfo = cmdInfo_;
 	int dc = downcount;
 	for (; dc > 0; --dc) {
@@ -964,19 +1075,26 @@ void GPUCommon::FastRunLoop(DisplayList &list) {
 		const u32 op = *(const u32 *)(Memory::base + list.pc);
 		const u32 cmd = op >> 24;
 		const CommandInfo &info = cmdInfo[cmd];
+		const uint64_t flags = info.flags;
+		if (useCommandCache && (flags & (FLAG_EXECUTE | FLAG_EXECUTEONCHANGE)) == 0) {
+			const int replayed = ReplayCommandRun(list.pc, dc);
+			if (replayed != 0) {
+				list.pc += replayed * 4;
+				// The loop counts the last one.
+				dc -= replayed - 1;
+				continue;
+			}
+		}
 		const u32 diff = op ^ gstate.cmdmem[cmd];
 		if (diff == 0) {
-			if (info.flags & FLAG_EXECUTE) {
+			if (flags & FLAG_EXECUTE) {
 				downcount = dc;
 				(this->*info.func)(op, diff);
 				dc = downcount;
 			}
 		} else {
-			uint64_t flags = info.flags;
 			if (flags & FLAG_FLUSHBEFOREONCHANGE) {
-				if (drawEngineCommon_->GetNumDrawCalls()) {
-					drawEngineCommon_->DispatchFlush();
-				}
+				FlushBeforeStateChange(cmd);
 			}
 			gstate.cmdmem[cmd] = op;
 			if (flags & (FLAG_EXECUTE | FLAG_EXECUTEONCHANGE)) {
@@ -994,6 +1112,81 @@ void GPUCommon::FastRunLoop(DisplayList &list) {
 	downcount = 0;
 }
 
+enum {
+	// Shorter runs aren't worth the lookup.
+	COMMAND_RUN_MIN = 4,
+	COMMAND_RUN_MAX = 256,
+	COMMAND_RUN_CACHE_SIZE = 4096,
+};
+
+void GPUCommon::BuildCommandRun(u32 pc, int maxCount, CommandRun &run) {
+	run.ops.clear();
+	run.writes.clear();
+
+	const int limit = std::min(maxCount, (int)COMMAND_RUN_MAX);
+	for (int i = 0; i < limit && Memory::IsValidAddress(pc); ++i, pc += 4) {
+		const u32 op = Memory::ReadUnchecked_U32(pc);
+		const CommandInfo &info = cmdInfo_[op >> 24];
+		if (info.flags & (FLAG_EXECUTE | FLAG_EXECUTEONCHANGE))
+			break;
+		run.ops.push_back(op);
+	}
+	if (run.ops.size() < COMMAND_RUN_MIN)
+		return;
+
+	// Keep the first position of each command, but its last value.
+	int slot[256];
+	memset(slot, -1, sizeof(slot));
+	for (u32 op : run.ops) {
+		const u32 cmd = op >> 24;
+		if (slot[cmd] == -1) {
+			slot[cmd] = (int)run.writes.size();
+			const uint64_t flags = cmdInfo_[cmd].flags;
+			run.writes.push_back({ op, (flags & FLAG_FLUSHBEFOREONCHANGE) != 0, flags >> 8 });
+		} else {
+			run.writes[slot[cmd]].op = op;
+		}
+	}
+}
+
+int GPUCommon::ReplayCommandRun(u32 pc, int maxCount) {
+	auto it = commandRuns_.find(pc);
+	if (it == commandRuns_.end()) {
+		if (commandRuns_.size() >= COMMAND_RUN_CACHE_SIZE)
+			commandRuns_.clear();
+		it = commandRuns_.insert(std::make_pair(pc, CommandRun())).first;
+		BuildCommandRun(pc, maxCount, it->second);
+	} else {
+		// Short runs are kept too, so we don't rebuild them every time.  Check the memory is unchanged.
+		const CommandRun &cached = it->second;
+		const size_t size = cached.ops.size();
+		if (size == 0 || (int)size > maxCount || memcmp(Memory::GetPointerUnchecked(pc), cached.ops.data(), size * 4) != 0) {
+			BuildCommandRun(pc, maxCount, it->second);
+		}
+	}
+
+	const CommandRun &run = it->second;
+	const int count = (int)run.ops.size();
+	if (count < COMMAND_RUN_MIN || count > maxCount)
+		return 0;
+
+	// Nothing in the run draws, so one flush before the first relevant change covers all of them.
+	bool flushed = false;
+	for (const CommandRunWrite &write : run.writes) {
+		const u32 cmd = write.op >> 24;
+		if (gstate.cmdmem[cmd] == write.op)
+			continue;
+		if (write.flushOnChange && !flushed) {
+			FlushBeforeStateChange(cmd);
+			flushed = drawEngineCommon_->GetNumDrawCalls() == 0;
+		}
+		gstate.cmdmem[cmd] = write.op;
+		if (write.dirty)
+			gstate_c.Dirty(write.dirty);
+	}
+	return count;
+}
+
 void GPUCommon::BeginFrame() {
 	immCount_ = 0;
 	if (dumpNextFrame_) {
@@ -1098,7 +1291,24 @@ int GPUCommon::GetNextListIndex() {
 }
 
 void GPUCommon::ProcessDLQueue() {
-	startingTicks = CoreTiming::GetTicks();
+	// CoreTiming belongs to the CPU thread, so take the start time here either way.
+	u64 ticks = CoreTiming::GetTicks();
+
+	// The debugger steps on the thread running the list, so keep that on the CPU thread.
+	if (threadEnabled_ && !host->GPUDebuggingActive() && !GPURecord::IsActive()) {
+		std::lock_guard<std::mutex> guard(threadLock_);
+		threadQueuedTicks_ = ticks;
+		threadQueued_ = true;
+		threadCond_.notify_one();
+		return;
+	}
+
+	SyncThread();
+	RunDLQueue(ticks);
+}
+
+void GPUCommon::RunDLQueue(u64 ticks) {
+	startingTicks = ticks;
 	cyclesExecuted = 0;
 
 	// Seems to be correct behaviour to process the list anyway?
@@ -1125,10 +1335,99 @@ void GPUCommon::ProcessDLQueue() {
 
 	drawCompleteTicks = startingTicks + cyclesExecuted;
 	busyTicks = std::max(busyTicks, drawCompleteTicks);
-	__GeTriggerSync(GPU_SYNC_DRAW, 1, drawCompleteTicks);
+	TriggerSync(GPU_SYNC_DRAW, 1, drawCompleteTicks);
 	// Since the event is in CoreTiming, we're in sync.  Just set 0 now.
 }
 
+void GPUCommon::StartThread() {
+	if (!g_Config.bSeparateGPUThread || threadEnabled_)
+		return;
+
+	threadRunning_ = true;
+	threadEnabled_ = true;
+	thread_ = std::thread(&GPUCommon::ThreadFunc, this);
+}
+
+void GPUCommon::StopThread() {
+	if (!threadEnabled_)
+		return;
+
+	{
+		std::unique_lock<std::mutex> guard(threadLock_);
+		while (threadQueued_ || threadBusy_)
+			threadDoneCond_.wait(guard);
+		// Nothing is left to wake up at this point.
+		pendingTriggers_.clear();
+		threadRunning_ = false;
+		threadCond_.notify_one();
+	}
+	thread_.join();
+	threadEnabled_ = false;
+}
+
+void GPUCommon::ThreadFunc() {
+	setCurrentThreadName("GPU");
+
+	std::unique_lock<std::mutex> guard(threadLock_);
+	while (threadRunning_) {
+		if (!threadQueued_) {
+			threadCond_.wait(guard);
+			continue;
+		}
+
+		u64 ticks = threadQueuedTicks_;
+		threadQueued_ = false;
+		threadBusy_ = true;
+		guard.unlock();
+
+		RunDLQueue(ticks);
+
+		guard.lock();
+		threadBusy_ = false;
+		threadDoneCond_.notify_all();
+	}
+}
+
+void GPUCommon::SyncThread() {
+	if (!threadEnabled_ || std::this_thread::get_id() == thread_.get_id())
+		return;
+
+	std::vector<PendingTrigger> triggers;
+	{
+		std::unique_lock<std::mutex> guard(threadLock_);
+		while (threadQueued_ || threadBusy_)
+			threadDoneCond_.wait(guard);
+		triggers.swap(pendingTriggers_);
+	}
+
+	// These land in CoreTiming in the same order the list raised them.
+	for (const PendingTrigger &trigger : triggers) {
+		if (trigger.interrupt)
+			__GeTriggerInterrupt(trigger.id, trigger.pc, trigger.atTicks);
+		else
+			__GeTriggerSync(trigger.type, trigger.id, trigger.atTicks);
+	}
+}
+
+void GPUCommon::TriggerSync(GPUSyncType type, int id, u64 atTicks) {
+	if (threadEnabled_ && std::this_thread::get_id() == thread_.get_id()) {
+		std::lock_guard<std::mutex> guard(threadLock_);
+		pendingTriggers_.push_back({ false, type, id, 0, atTicks });
+		return;
+	}
+	__GeTriggerSync(type, id, atTicks);
+}
+
+bool GPUCommon::TriggerInterrupt(int listid, u32 pc, u64 atTicks) {
+	if (threadEnabled_ && std::this_thread::get_id() == thread_.get_id()) {
+		// __GeTriggerInterrupt() always queues it, so the list can pause for it right away.
+		std::lock_guard<std::mutex> guard(threadLock_);
+		pendingTriggers_.push_back({ true, GPU_SYNC_LIST, listid, pc, atTicks });
+		return true;
+	}
+	return __GeTriggerInterrupt(listid, pc, atTicks);
+}
+
 void GPUCommon::PreExecuteOp(u32 op, u32 diff) {
 	// Nothing to do
 }
@@ -1342,7 +1641,7 @@ void GPUCommon::Execute_End(u32 op, u32 diff) {
 			}
 			// TODO: Technically, jump/call/ret should generate an interrupt, but before the pc change maybe?
 			if (currentList->interruptsEnabled && trigger) {
-				if (__GeTriggerInterrupt(currentList->id, currentList->pc, startingTicks + cyclesExecuted)) {
+				if (TriggerInterrupt(currentList->id, currentList->pc, startingTicks + cyclesExecuted)) {
 					currentList->pendingInterrupt = true;
 					UpdateState(GPUSTATE_INTERRUPT);
 				}
@@ -1354,7 +1653,7 @@ void GPUCommon::Execute_End(u32 op, u32 diff) {
 		case PSP_GE_SIGNAL_HANDLER_PAUSE:
 			currentList->state = PSP_GE_DL_STATE_PAUSED;
 			if (currentList->interruptsEnabled) {
-				if (__GeTriggerInterrupt(currentList->id, currentList->pc, startingTicks + cyclesExecuted)) {
+				if (TriggerInterrupt(currentList->id, currentList->pc, startingTicks + cyclesExecuted)) {
 					currentList->pendingInterrupt = true;
 					UpdateState(GPUSTATE_INTERRUPT);
 				}
@@ -1369,13 +1668,13 @@ void GPUCommon::Execute_End(u32 op, u32 diff) {
 		default:
 			currentList->subIntrToken = prev & 0xFFFF;
 			UpdateState(GPUSTATE_DONE);
-			if (currentList->interruptsEnabled && __GeTriggerInterrupt(currentList->id, currentList->pc, startingTicks + cyclesExecuted)) {
+			if (currentList->interruptsEnabled && TriggerInterrupt(currentList->id, currentList->pc, startingTicks + cyclesExecuted)) {
 				currentList->pendingInterrupt = true;
 			} else {
 				currentList->state = PSP_GE_DL_STATE_COMPLETED;
 				currentList->waitTicks = startingTicks + cyclesExecuted;
 				busyTicks = std::max(busyTicks, currentList->waitTicks);
-				__GeTriggerSync(GPU_SYNC_LIST, currentList->id, currentList->waitTicks);
+				TriggerSync(GPU_SYNC_LIST, currentList->id, currentList->waitTicks);
 				if (currentList->started && currentList->context.IsValid()) {
 					gstate.Restore(currentList->context);
 					ReapplyGfxState();
@@ -2200,6 +2499,7 @@ struct DisplayList_v2 {
 };
 
 void GPUCommon::DoState(PointerWrap &p) {
+	SyncThread();
 	auto s = p.Section("GPUCommon", 1, 4);
 	if (!s)
 		return;
@@ -2275,9 +2575,11 @@ void GPUCommon::DoState(PointerWrap &p) {
 }
 
 void GPUCommon::InterruptStart(int listid) {
+	SyncThread();
 	interruptRunning = true;
 }
 void GPUCommon::InterruptEnd(int listid) {
+	SyncThread();
 	interruptRunning = false;
 	isbreak = false;
 
@@ -2298,6 +2600,7 @@ void GPUCommon::InterruptEnd(int listid) {
 
 // TODO: Maybe cleaner to keep this in GE and trigger the clear directly?
 void GPUCommon::SyncEnd(GPUSyncType waitType, int listid, bool wokeThreads) {
+	SyncThread();
 	if (waitType == GPU_SYNC_DRAW && wokeThreads)
 	{
 		for (int i = 0; i < DisplayListMaxCount; ++i) {
@@ -2309,6 +2612,7 @@ void GPUCommon::SyncEnd(GPUSyncType waitType, int listid, bool wokeThreads) {
 }
 
 bool GPUCommon::GetCurrentDisplayList(DisplayList &list) {
+	SyncThread();
 	if (!currentList) {
 		return false;
 	}
@@ -2317,6 +2621,7 @@ bool GPUCommon::GetCurrentDisplayList(DisplayList &list) {
 }
 
 std::vector<DisplayList> GPUCommon::ActiveDisplayLists() {
+	SyncThread();
 	std::vector<DisplayList> result;
 
 	for (auto it = dlQueue.begin(), end = dlQueue.end(); it != end; ++it) {
@@ -2327,6 +2632,7 @@ std::vector<DisplayList> GPUCommon::ActiveDisplayLists() {
 }
 
 void GPUCommon::ResetListPC(int listID, u32 pc) {
+	SyncThread();
 	if (listID < 0 || listID >= DisplayListMaxCount) {
 		_dbg_assert_msg_(G3D, false, "listID out of range: %d", listID);
 		return;
@@ -2336,6 +2642,7 @@ void GPUCommon::ResetListPC(int listID, u32 pc) {
 }
 
 void GPUCommon::ResetListStall(int listID, u32 stall) {
+	SyncThread();
 	if (listID < 0 || listID >= DisplayListMaxCount) {
 		_dbg_assert_msg_(G3D, false, "listID out of range: %d", listID);
 		return;
@@ -2345,6 +2652,7 @@ void GPUCommon::ResetListStall(int listID, u32 stall) {
 }
 
 void GPUCommon::ResetListState(int listID, DisplayListState state) {
+	SyncThread();
 	if (listID < 0 || listID >= DisplayListMaxCount) {
 		_dbg_assert_msg_(G3D, false, "listID out of range: %d", listID);
 		return;
@@ -2399,10 +2707,12 @@ u32 GPUCommon::GetIndexAddress() {
 }
 
 GPUgstate GPUCommon::GetGState() {
+	SyncThread();
 	return gstate;
 }
 
 void GPUCommon::SetCmdValue(u32 op) {
+	SyncThread();
 	u32 cmd = op >> 24;
 	u32 diff = op ^ gstate.cmdmem[cmd];
 
@@ -2466,6 +2776,7 @@ void GPUCommon::DoBlockTransfer(u32 skipDrawReason) {
 
 	// Tell the framebuffer manager to take action if possible. If it does the entire thing, let's just return.
 	if (!framebufferManager_->NotifyBlockTransferBefore(dstBasePtr, dstStride, dstX, dstY, srcBasePtr, srcStride, srcX, srcY, width, height, bpp, skipDrawReason)) {
+		gpuStats.numBlockTransfersCPU++;
 		// Do the copy! (Hm, if we detect a drawn video frame (see below) then we could maybe skip this?)
 		// Can use GetPointerUnchecked because we checked the addresses above. We could also avoid them
 		// entirely by walking a couple of pointers...
@@ -2502,6 +2813,7 @@ void GPUCommon::DoBlockTransfer(u32 skipDrawReason) {
 }
 
 bool GPUCommon::PerformMemoryCopy(u32 dest, u32 src, int size) {
+	SyncThread();
 	// Track stray copies of a framebuffer in RAM. MotoGP does this.
 	if (framebufferManager_->MayIntersectFramebuffer(src) || framebufferManager_->MayIntersectFramebuffer(dest)) {
 		if (!framebufferManager_->NotifyFramebufferCopy(src, dest, size, false, gstate_c.skipDrawReason)) {
@@ -2521,6 +2833,7 @@ bool GPUCommon::PerformMemoryCopy(u32 dest, u32 src, int size) {
 }
 
 bool GPUCommon::PerformMemorySet(u32 dest, u8 v, int size) {
+	SyncThread();
 	// This may indicate a memset, usually to 0, of a framebuffer.
 	if (framebufferManager_->MayIntersectFramebuffer(dest)) {
 		Memory::Memset(dest, v, size);
@@ -2537,6 +2850,7 @@ bool GPUCommon::PerformMemorySet(u32 dest, u8 v, int size) {
 }
 
 bool GPUCommon::PerformMemoryDownload(u32 dest, int size) {
+	SyncThread();
 	// Cheat a bit to force a download of the framebuffer.
 	// VRAM + 0x00400000 is simply a VRAM mirror.
 	if (Memory::IsVRAMAddress(dest)) {
@@ -2546,6 +2860,7 @@ bool GPUCommon::PerformMemoryDownload(u32 dest, int size) {
 }
 
 bool GPUCommon::PerformMemoryUpload(u32 dest, int size) {
+	SyncThread();
 	// Cheat a bit to force an upload of the framebuffer.
 	// VRAM + 0x00400000 is simply a VRAM mirror.
 	if (Memory::IsVRAMAddress(dest)) {
@@ -2556,10 +2871,12 @@ bool GPUCommon::PerformMemoryUpload(u32 dest, int size) {
 }
 
 void GPUCommon::InvalidateCache(u32 addr, int size, GPUInvalidationType type) {
+	SyncThread();
 	if (size > 0)
 		textureCache_->Invalidate(addr, size, type);
 	else
 		textureCache_->InvalidateAll(type);
+	drawEngineCommon_->NotifyMemWrite(addr, size);
 
 	if (type != GPU_INVALIDATE_ALL && framebufferManager_->MayIntersectFramebuffer(addr)) {
 		// If we're doing block transfers, we shouldn't need this, and it'll only confuse us.
@@ -2571,6 +2888,7 @@ void GPUCommon::InvalidateCache(u32 addr, int size, GPUInvalidationType type) {
 }
 
 void GPUCommon::NotifyVideoUpload(u32 addr, int size, int width, int format) {
+	SyncThread();
 	if (Memory::IsVRAMAddress(addr)) {
 		framebufferManager_->NotifyVideoUpload(addr, size, width, (GEBufferFormat)format);
 	}
@@ -2579,6 +2897,7 @@ void GPUCommon::NotifyVideoUpload(u32 addr, int size, int width, int format) {
 }
 
 bool GPUCommon::PerformStencilUpload(u32 dest, int size) {
+	SyncThread();
 	if (framebufferManager_->MayIntersectFramebuffer(dest)) {
 		framebufferManager_->NotifyStencilUpload(dest, size);
 		return true;
@@ -2587,6 +2906,7 @@ bool GPUCommon::PerformStencilUpload(u32 dest, int size) {
 }
 
 bool GPUCommon::GetCurrentFramebuffer(GPUDebugBuffer &buffer, GPUDebugFramebufferType type, int maxRes) {
+	SyncThread();
 	u32 fb_address = type == GPU_DBG_FRAMEBUF_RENDER ? gstate.getFrameBufRawAddress() : framebufferManager_->DisplayFramebufAddr();
 	int fb_stride = type == GPU_DBG_FRAMEBUF_RENDER ? gstate.FrameBufStride() : framebufferManager_->DisplayFramebufStride();
 	GEBufferFormat format = type == GPU_DBG_FRAMEBUF_RENDER ? gstate.FrameBufFormat() : framebufferManager_->DisplayFramebufFormat();
@@ -2594,6 +2914,7 @@ bool GPUCommon::GetCurrentFramebuffer(GPUDebugBuffer &buffer, GPUDebugFramebuffe
 }
 
 bool GPUCommon::GetCurrentDepthbuffer(GPUDebugBuffer &buffer) {
+	SyncThread();
 	u32 fb_address = gstate.getFrameBufRawAddress();
 	int fb_stride = gstate.FrameBufStride();
 
@@ -2604,6 +2925,7 @@ bool GPUCommon::GetCurrentDepthbuffer(GPUDebugBuffer &buffer) {
 }
 
 bool GPUCommon::GetCurrentStencilbuffer(GPUDebugBuffer &buffer) {
+	SyncThread();
 	u32 fb_address = gstate.getFrameBufRawAddress();
 	int fb_stride = gstate.FrameBufStride();
 
@@ -2611,24 +2933,29 @@ bool GPUCommon::GetCurrentStencilbuffer(GPUDebugBuffer &buffer) {
 }
 
 bool GPUCommon::GetOutputFramebuffer(GPUDebugBuffer &buffer) {
+	SyncThread();
 	// framebufferManager_ can be null here when taking screens in software rendering mode.
 	// TODO: Actually grab the framebuffer anyway.
 	return framebufferManager_ ? framebufferManager_->GetOutputFramebuffer(buffer) : false;
 }
 
 std::vector<FramebufferInfo> GPUCommon::GetFramebufferList() {
+	SyncThread();
 	return framebufferManager_->GetFramebufferList();
 }
 
 bool GPUCommon::GetCurrentSimpleVertices(int count, std::vector<GPUDebugVertex> &vertices, std::vector<u16> &indices) {
+	SyncThread();
 	return drawEngineCommon_->GetCurrentSimpleVertices(count, vertices, indices);
 }
 
 bool GPUCommon::GetCurrentClut(GPUDebugBuffer &buffer) {
+	SyncThread();
 	return textureCache_->GetCurrentClutBuffer(buffer);
 }
 
 bool GPUCommon::GetCurrentTexture(GPUDebugBuffer &buffer, int level) {
+	SyncThread();
 	if (!gstate.isTextureMapEnabled()) {
 		return false;
 	}
@@ -2644,6 +2971,7 @@ bool GPUCommon::DescribeCodePtr(const u8 *ptr, std::string &name) {
 }
 
 bool GPUCommon::FramebufferDirty() {
+	SyncThread();
 	VirtualFramebuffer *vfb = framebufferManager_->GetDisplayVFB();
 	if (vfb) {
 		bool dirty = vfb->dirtyAfterDisplay;
@@ -2654,6 +2982,7 @@ bool GPUCommon::FramebufferDirty() {
 }
 
 bool GPUCommon::FramebufferReallyDirty() {
+	SyncThread();
 	VirtualFramebuffer *vfb = framebufferManager_->GetDisplayVFB();
 	if (vfb) {
 		bool dirty = vfb->reallyDirtyAfterDisplay;
@@ -6,6 +6,12 @@
 #include "GPU/GPUState.h"
 #include "GPU/Common/GPUDebugInterface.h"
 
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
 #if defined(__ANDROID__)
 #include <atomic>
 #endif
@@ -79,6 +85,7 @@ class GPUCommon : public GPUInterface, public GPUDebugInterface {
 
 	void BeginHostFrame() override;
 	void EndHostFrame() override;
+	void SyncThread() override;
 
 	void InterruptStart(int listid) override;
 	void InterruptEnd(int listid) override;
@@ -225,10 +232,12 @@ class GPUCommon : public GPUInterface, public GPUDebugInterface {
 	}
 
 	DisplayList* getList(int listid) override {
+		SyncThread();
 		return &dls[listid];
 	}
 
 	const std::list<int>& GetDisplayLists() override {
+		SyncThread();
 		return dlQueue;
 	}
 	std::vector<FramebufferInfo> GetFramebufferList() override;
@@ -236,6 +245,7 @@ class GPUCommon : public GPUInterface, public GPUDebugInterface {
 	void CleanupBeforeUI() override {}
 
 	s64 GetListTicks(int listid) override {
+		SyncThread();
 		if (listid >= 0 && listid < DisplayListMaxCount) {
 			return dls[listid].waitTicks;
 		}
@@ -271,6 +281,9 @@ class GPUCommon : public GPUInterface, public GPUDebugInterface {
 	void BeginFrame() override;
 
 	virtual void FastRunLoop(DisplayList &list);
+	// The loop itself, with the config checks folded out of it.
+	template <bool useCommandCache>
+	void FastRunLoopFor(DisplayList &list);
 
 	void SlowRunLoop(DisplayList &list);
 	void UpdatePC(u32 currentPC, u32 newPC);
@@ -278,7 +291,19 @@ class GPUCommon : public GPUInterface, public GPUDebugInterface {
 	void PopDLQueue();
 	void CheckDrawSync();
 	int  GetNextListIndex();
+	// Does the actual work of ProcessDLQueue(), which may hand it off to the GE thread.
+	void RunDLQueue(u64 ticks);
+
+	// Backends that only record into a render manager can run lists on a separate thread.
+	// Call StartThread() at the end of the constructor and StopThread() first in the destructor.
+	void StartThread();
+	void StopThread();
 	virtual void FastLoadBoneMatrix(u32 target);
+	// Applies a cached run of state-only commands at pc, returns how many it covered or 0.
+	int ReplayCommandRun(u32 pc, int maxCount);
+	// Call before writing a changed FLAG_FLUSHBEFOREONCHANGE command. Only flushes if the
+	// pending draws could actually see the change.
+	void FlushBeforeStateChange(u8 cmd);
 
 	// TODO: Unify this.
 	virtual void FinishDeferred() {}
@@ -351,6 +376,48 @@ class GPUCommon : public GPUInterface, public GPUDebugInterface {
 
 private:
 	void FlushImm();
+
+	struct PendingTrigger {
+		bool interrupt;
+		GPUSyncType type;
+		int id;
+		u32 pc;
+		u64 atTicks;
+	};
+
+	// Only the last write to each command in a run matters, since nothing in it executes.
+	struct CommandRunWrite {
+		u32 op;
+		bool flushOnChange;
+		u64 dirty;
+	};
+	struct CommandRun {
+		// The raw words, to check the list memory still holds the same run.
+		std::vector<u32> ops;
+		std::vector<CommandRunWrite> writes;
+	};
+
+	void BuildCommandRun(u32 pc, int maxCount, CommandRun &run);
+
+	std::unordered_map<u32, CommandRun> commandRuns_;
+
+	void TriggerSync(GPUSyncType type, int id, u64 atTicks);
+	bool TriggerInterrupt(int listid, u32 pc, u64 atTicks);
+	void ThreadFunc();
+
+	// GE thread state, all guarded by threadLock_ except threadEnabled_.
+	std::thread thread_;
+	std::mutex threadLock_;
+	std::condition_variable threadCond_;
+	std::condition_variable threadDoneCond_;
+	bool threadEnabled_ = false;
+	bool threadRunning_ = false;
+	bool threadQueued_ = false;
+	bool threadBusy_ = false;
+	u64 threadQueuedTicks_ = 0;
+	// Syncs and interrupts raised on the GE thread, scheduled from the CPU thread in SyncThread().
+	std::vector<PendingTrigger> pendingTriggers_;
+
 	// Debug stats.
 	double timeSteppingStarted_;
 	double timeSpentStepping_;
@@ -176,6 +176,10 @@ class GPUInterface {
 	virtual void BeginHostFrame() = 0;
 	virtual void EndHostFrame() = 0;
 
+	// Waits for display lists running on the GE thread (if any) to finish.
+	// Must be called before the CPU side looks at GE state or its output.
+	virtual void SyncThread() {}
+
 	// Draw queue management
 	virtual DisplayList* getList(int listid) = 0;
 	// TODO: Much of this should probably be shared between the different GPU implementations.
@@ -472,6 +472,7 @@ enum {
 	GPU_SUPPORTS_TEXTURE_FLOAT = FLAG_BIT(12),
 	GPU_SUPPORTS_16BIT_FORMATS = FLAG_BIT(13),
 	GPU_SUPPORTS_DEPTH_CLAMP = FLAG_BIT(14),
+	GPU_SUPPORTS_INSTANCED_RECTS = FLAG_BIT(15),
 	GPU_SUPPORTS_LARGE_VIEWPORTS = FLAG_BIT(16),
 	GPU_SUPPORTS_ACCURATE_DEPTH = FLAG_BIT(17),
 	GPU_SUPPORTS_VAO = FLAG_BIT(18),
@@ -485,6 +486,7 @@ enum {
 	GPU_SUPPORTS_ARB_FRAMEBUFFER_BLIT = FLAG_BIT(26),
 	GPU_SUPPORTS_NV_FRAMEBUFFER_BLIT = FLAG_BIT(27),
 	GPU_SUPPORTS_OES_TEXTURE_NPOT = FLAG_BIT(28),
+	GPU_SUPPORTS_SHADER_STENCIL_EXPORT = FLAG_BIT(29),
 	GPU_PREFER_CPU_DOWNLOAD = FLAG_BIT(30),
 	GPU_PREFER_REVERSE_COLOR_ORDER = FLAG_BIT(31),
 };
@@ -549,8 +551,12 @@ struct GPUStateCache {
 	UVScale uv;
 
 	bool bgraTexture;
+	// The bound texture holds CLUT indices, looked up in the palette texture by the fragment shader.
+	bool shaderClutLookup;
 	bool needShaderTexClamp;
 	bool allowShaderBlend;
+	// V coordinate of the current test in the fragment test atlas (GLES.)
+	float fragmentTestCoord;
 
 	float morphWeights[8];
 
@@ -16,7 +16,9 @@
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
 #include <algorithm>
+#include <vector>
 
+#include "Common/ThreadPools.h"
 #include "GPU/GPUState.h"
 
 #include "GPU/Software/Clipper.h"
@@ -180,6 +182,7 @@ void ProcessRect(const VertexData& v0, const VertexData& v1)
 		ProcessTriangle(*bottomright, *bottomleft, *topleft);
 		ProcessTriangle(*topleft, *bottomleft, *bottomright);
 	} else {
+		FlushTriangles();
 		// through mode handling
 		VertexData buf[4];
 		buf[0].screenpos = ScreenCoords(v0.screenpos.x, v0.screenpos.y, v1.screenpos.z);
@@ -232,12 +235,14 @@ void ProcessRect(const VertexData& v0, const VertexData& v1)
 
 void ProcessPoint(VertexData& v0)
 {
+	FlushTriangles();
 	// Points need no clipping. Will be bounds checked in the rasterizer (which seems backwards?)
 	Rasterizer::DrawPoint(v0);
 }
 
 void ProcessLine(VertexData& v0, VertexData& v1)
 {
+	FlushTriangles();
 	if (gstate.isModeThrough()) {
 		// Actually, should clip this one too so we don't need to do bounds checks in the rasterizer.
 		Rasterizer::DrawLine(v0, v1);
@@ -274,13 +279,27 @@ void ProcessLine(VertexData& v0, VertexData& v1)
 	Rasterizer::DrawLine(data[0], data[1]);
 }
 
-void ProcessTriangle(VertexData& v0, VertexData& v1, VertexData& v2)
-{
-	if (gstate.isModeThrough()) {
-		Rasterizer::DrawTriangle(v0, v1, v2);
-		return;
-	}
+enum {
+	// Six planes can add at most six vertices to a triangle, giving a 9-gon, or 7 triangles.
+	MAX_CLIPPED_TRIANGLE_VERTICES = 7 * 3,
+	// Triangles are clipped in chunks of this many, each chunk with its own output buffer.
+	CLIP_CHUNK_SIZE = 16,
+	MAX_QUEUED_TRIANGLES = 1024,
+};
 
+struct QueuedTriangle {
+	VertexData v[3];
+};
+
+static std::vector<QueuedTriangle> queuedTriangles;
+// Kept around between batches so clipping doesn't allocate per primitive.
+static std::vector<std::vector<VertexData>> chunkOutput;
+
+// Clips a triangle against the frustum, and writes the resulting triangles (with screen
+// coordinates) to out.  Returns the number of vertices written, always a multiple of 3.
+// Only reads gstate, so it's safe to call from several threads at once.
+static int ClipTriangle(const VertexData& v0, const VertexData& v1, const VertexData& v2, VertexData *out)
+{
 	enum { NUM_CLIPPED_VERTICES = 33, NUM_INDICES = NUM_CLIPPED_VERTICES + 3 };
 
 	VertexData* Vertices[NUM_INDICES];
@@ -289,9 +308,10 @@ void ProcessTriangle(VertexData& v0, VertexData& v1, VertexData& v2)
 		Vertices[i+3] = &ClippedVertices[i];
 
 	// TODO: Change logic when it's a backface (why? In what way?)
-	Vertices[0] = &v0;
-	Vertices[1] = &v1;
-	Vertices[2] = &v2;
+	// Only the clipped vertices are ever written through Vertices.
+	Vertices[0] = const_cast<VertexData *>(&v0);
+	Vertices[1] = const_cast<VertexData *>(&v1);
+	Vertices[2] = const_cast<VertexData *>(&v2);
 
 	int indices[NUM_INDICES] = { 0, 1, 2, SKIP_FLAG, SKIP_FLAG, SKIP_FLAG, SKIP_FLAG, SKIP_FLAG, SKIP_FLAG,
 									SKIP_FLAG, SKIP_FLAG, SKIP_FLAG, SKIP_FLAG, SKIP_FLAG, SKIP_FLAG,
@@ -306,7 +326,7 @@ void ProcessTriangle(VertexData& v0, VertexData& v1, VertexData& v2)
 	if (mask && gstate.isClippingEnabled()) {
 		// discard if any vertex is outside the near clipping plane
 		if (mask & CLIP_NEG_Z_BIT)
-			return;
+			return 0;
 
 		for (int i = 0; i < 3; i += 3) {
 			int vlist[2][2*6+1];
@@ -343,20 +363,71 @@ void ProcessTriangle(VertexData& v0, VertexData& v1, VertexData& v2)
 	} else if (CalcClipMask(v0.clippos) & CalcClipMask(v1.clippos) & CalcClipMask(v2.clippos))  {
 		// If clipping is disabled, only discard the current primitive
 		// if all three vertices lie outside one of the clipping planes
-		return;
+		return 0;
 	}
 
+	int count = 0;
 	for (int i = 0; i+3 <= numIndices; i+=3)
 	{
 		if(indices[i] != SKIP_FLAG)
 		{
-			VertexData data[3] = { *Vertices[indices[i]], *Vertices[indices[i+1]], *Vertices[indices[i+2]] };
-			data[0].screenpos = TransformUnit::ClipToScreen(data[0].clippos);
-			data[1].screenpos = TransformUnit::ClipToScreen(data[1].clippos);
-			data[2].screenpos = TransformUnit::ClipToScreen(data[2].clippos);
-			Rasterizer::DrawTriangle(data[0], data[1], data[2]);
+			for (int j = 0; j < 3; ++j) {
+				out[count] = *Vertices[indices[i + j]];
+				out[count].screenpos = TransformUnit::ClipToScreen(out[count].clippos);
+				count++;
+			}
 		}
 	}
+	return count;
+}
+
+void ProcessTriangle(VertexData& v0, VertexData& v1, VertexData& v2)
+{
+	if (gstate.isModeThrough()) {
+		FlushTriangles();
+		Rasterizer::DrawTriangle(v0, v1, v2);
+		return;
+	}
+
+	queuedTriangles.push_back({ { v0, v1, v2 } });
+	if (queuedTriangles.size() >= MAX_QUEUED_TRIANGLES)
+		FlushTriangles();
+}
+
+void FlushTriangles()
+{
+	if (queuedTriangles.empty())
+		return;
+
+	const int count = (int)queuedTriangles.size();
+	const int numChunks = (count + CLIP_CHUNK_SIZE - 1) / CLIP_CHUNK_SIZE;
+	if ((int)chunkOutput.size() < numChunks)
+		chunkOutput.resize(numChunks);
+
+	auto clipChunks = [&](int a, int b) -> void {
+		for (int c = a; c < b; ++c) {
+			std::vector<VertexData> &out = chunkOutput[c];
+			const int first = c * CLIP_CHUNK_SIZE;
+			const int last = std::min(first + CLIP_CHUNK_SIZE, count);
+			out.resize((last - first) * MAX_CLIPPED_TRIANGLE_VERTICES);
+			int written = 0;
+			for (int i = first; i < last; ++i) {
+				const QueuedTriangle &tri = queuedTriangles[i];
+				written += ClipTriangle(tri.v[0], tri.v[1], tri.v[2], &out[written]);
+			}
+			out.resize(written);
+		}
+	};
+	GlobalThreadPool::Loop(clipChunks, 0, numChunks);
+
+	// Hand the triangles on in chunk order, so the result is the same as clipping serially.
+	for (int c = 0; c < numChunks; ++c) {
+		const std::vector<VertexData> &out = chunkOutput[c];
+		for (size_t i = 0; i + 3 <= out.size(); i += 3)
+			Rasterizer::DrawTriangle(out[i], out[i + 1], out[i + 2]);
+	}
+
+	queuedTriangles.clear();
 }
 
 } // namespace
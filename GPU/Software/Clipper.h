@@ -23,7 +23,11 @@ namespace Clipper {
 
 void ProcessPoint(VertexData& v0);
 void ProcessLine(VertexData& v0, VertexData& v1);
+// Triangles that need clipping are queued, and clipped in parallel batches by FlushTriangles().
 void ProcessTriangle(VertexData& v0, VertexData& v1, VertexData& v2);
 void ProcessRect(const VertexData& v0, const VertexData& v1);
 
+// Clips any queued triangles and passes them on to the rasterizer, in submission order.
+void FlushTriangles();
+
 }
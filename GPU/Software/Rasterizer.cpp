@@ -16,7 +16,9 @@
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
 #include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <vector>
 
 #include "base/basictypes.h"
 #include "profiler/profiler.h"
@@ -608,6 +610,20 @@ static inline u32 ApplyLogicOp(GELogicOp op, u32 old_color, u32 new_color)
 	return new_color;
 }
 
+#if defined(_M_SSE)
+// Takes rgb from the first and alpha from the second.
+static inline __m128i MergeRGBAlpha(const __m128i &rgb, const __m128i &a) {
+	const __m128i alphaMask = _mm_set_epi32(-1, 0, 0, 0);
+	return _mm_or_si128(_mm_andnot_si128(alphaMask, rgb), _mm_and_si128(alphaMask, a));
+}
+
+// Same result as integer division by 255 for non-negative values below 2^24.
+// The division is correctly rounded, so exact multiples never truncate down.
+static inline __m128i DivideBy255(const __m128 &v) {
+	return _mm_cvttps_epi32(_mm_div_ps(v, _mm_set_ps1(255.0f)));
+}
+#endif
+
 static inline Vec4<int> GetTextureFunctionOutput(const Vec4<int>& prim_color, const Vec4<int>& texcolor)
 {
 	Vec3<int> out_rgb;
@@ -627,7 +643,7 @@ static inline Vec4<int> GetTextureFunctionOutput(const Vec4<int>& prim_color, co
 		if (rgba) {
 			return Vec4<int>(out_rgb.ivec);
 		} else {
-			out_a = prim_color.a();
+			return Vec4<int>(MergeRGBAlpha(out_rgb.ivec, prim_color.ivec));
 		}
 #else
 		out_rgb = prim_color.rgb() * texcolor.rgb() / 255;
@@ -640,32 +656,65 @@ static inline Vec4<int> GetTextureFunctionOutput(const Vec4<int>& prim_color, co
 	{
 		int t = (rgba) ? texcolor.a() : 255;
 		int invt = (rgba) ? 255 - t : 0;
+#if defined(_M_SSE)
+		const __m128 p = _mm_mul_ps(_mm_cvtepi32_ps(prim_color.ivec), _mm_set_ps1((float)invt));
+		const __m128 tex = _mm_mul_ps(_mm_cvtepi32_ps(texcolor.ivec), _mm_set_ps1((float)t));
+		return Vec4<int>(MergeRGBAlpha(DivideBy255(_mm_add_ps(p, tex)), prim_color.ivec));
+#else
 		out_rgb = (prim_color.rgb() * invt + texcolor.rgb() * t) / 255;
 		out_a = prim_color.a();
+#endif
 		break;
 	}
 
 	case GE_TEXFUNC_BLEND:
 	{
+#if defined(_M_SSE)
+		// The alpha lane works out to prim.a * ta + 0.
+		const __m128i ta = _mm_set1_epi32(rgba ? texcolor.a() : 255);
+		const __m128i invtex = MergeRGBAlpha(_mm_sub_epi32(_mm_set1_epi32(255), texcolor.ivec), ta);
+		const __m128 texenv = _mm_set_ps(0.0f, (float)gstate.getTextureEnvColB(), (float)gstate.getTextureEnvColG(), (float)gstate.getTextureEnvColR());
+		const __m128 p = _mm_mul_ps(_mm_cvtepi32_ps(invtex), _mm_cvtepi32_ps(prim_color.ivec));
+		const __m128 tex = _mm_mul_ps(_mm_cvtepi32_ps(texcolor.ivec), texenv);
+		return Vec4<int>(DivideBy255(_mm_add_ps(p, tex)));
+#else
 		const Vec3<int> const255(255, 255, 255);
 		const Vec3<int> texenv(gstate.getTextureEnvColR(), gstate.getTextureEnvColG(), gstate.getTextureEnvColB());
 		out_rgb = ((const255 - texcolor.rgb()) * prim_color.rgb() + texcolor.rgb() * texenv) / 255;
 		out_a = prim_color.a() * ((rgba) ? texcolor.a() : 255) / 255;
+#endif
 		break;
 	}
 
 	case GE_TEXFUNC_REPLACE:
+#if defined(_M_SSE)
+		if (rgba) {
+			return texcolor;
+		}
+		return Vec4<int>(MergeRGBAlpha(texcolor.ivec, prim_color.ivec));
+#else
 		out_rgb = texcolor.rgb();
 		out_a = (rgba) ? texcolor.a() : prim_color.a();
+#endif
 		break;
 
 	case GE_TEXFUNC_ADD:
+	{
+		out_a = prim_color.a() * ((rgba) ? texcolor.a() : 255) / 255;
+#if defined(_M_SSE)
+		const __m128i const255 = _mm_set1_epi32(255);
+		const __m128i sum = _mm_add_epi32(prim_color.ivec, texcolor.ivec);
+		const __m128i over = _mm_cmpgt_epi32(sum, const255);
+		const __m128i clamped = _mm_or_si128(_mm_and_si128(over, const255), _mm_andnot_si128(over, sum));
+		return Vec4<int>(MergeRGBAlpha(clamped, _mm_set1_epi32(out_a)));
+#else
 		out_rgb = prim_color.rgb() + texcolor.rgb();
 		if (out_rgb.r() > 255) out_rgb.r() = 255;
 		if (out_rgb.g() > 255) out_rgb.g() = 255;
 		if (out_rgb.b() > 255) out_rgb.b() = 255;
-		out_a = prim_color.a() * ((rgba) ? texcolor.a() : 255) / 255;
+#endif
 		break;
+	}
 
 	default:
 		ERROR_LOG_REPORT(G3D, "Software: Unknown texture function %x", gstate.getTextureFunction());
@@ -872,19 +921,41 @@ static inline Vec3<int> AlphaBlendingResult(const Vec4<int> &source, const Vec4<
 	}
 
 	case GE_BLENDMODE_MIN:
+#if defined(_M_SSE)
+	{
+		const __m128i gt = _mm_cmpgt_epi32(source.ivec, dst.ivec);
+		return Vec3<int>(_mm_or_si128(_mm_and_si128(gt, dst.ivec), _mm_andnot_si128(gt, source.ivec)));
+	}
+#else
 		return Vec3<int>(std::min(source.r(), dst.r()),
 						std::min(source.g(), dst.g()),
 						std::min(source.b(), dst.b()));
+#endif
 
 	case GE_BLENDMODE_MAX:
+#if defined(_M_SSE)
+	{
+		const __m128i gt = _mm_cmpgt_epi32(source.ivec, dst.ivec);
+		return Vec3<int>(_mm_or_si128(_mm_and_si128(gt, source.ivec), _mm_andnot_si128(gt, dst.ivec)));
+	}
+#else
 		return Vec3<int>(std::max(source.r(), dst.r()),
 						std::max(source.g(), dst.g()),
 						std::max(source.b(), dst.b()));
+#endif
 
 	case GE_BLENDMODE_ABSDIFF:
+#if defined(_M_SSE)
+	{
+		const __m128i diff = _mm_sub_epi32(source.ivec, dst.ivec);
+		const __m128i sign = _mm_srai_epi32(diff, 31);
+		return Vec3<int>(_mm_sub_epi32(_mm_xor_si128(diff, sign), sign));
+	}
+#else
 		return Vec3<int>(::abs(source.r() - dst.r()),
 						::abs(source.g() - dst.g()),
 						::abs(source.b() - dst.b()));
+#endif
 
 	default:
 		ERROR_LOG_REPORT(G3D, "Software: Unknown blend function %x", gstate.getBlendEq());
@@ -892,28 +963,44 @@ static inline Vec3<int> AlphaBlendingResult(const Vec4<int> &source, const Vec4<
 	}
 }
 
-template <bool clearMode>
-inline void DrawSinglePixel(const DrawingCoords &p, u16 z, u8 fog, const Vec4<int> &color_in) {
+// Parts of the pixel pipeline a pixel function may need.  When a bit is clear, the
+// function was specialized knowing that part is disabled and skips it entirely.
+// When set, the state is still checked per pixel like before.
+enum PixelFuncFlags {
+	PIXEL_DEPTH_RANGE = 0x01,
+	PIXEL_COLOR_ALPHA_TEST = 0x02,
+	PIXEL_DEPTH_STENCIL = 0x04,
+	PIXEL_FOG = 0x08,
+	PIXEL_BLEND = 0x10,
+	PIXEL_LOGIC_OP = 0x20,
+
+	PIXEL_ALL = 0x3F,
+};
+
+template <bool clearMode, u32 flags>
+void DrawSinglePixel(const DrawingCoords &p, u16 z, u8 fog, const Vec4<int> &color_in) {
 	Vec4<int> prim_color = color_in;
 	// Depth range test
 	// TODO: Clear mode?
-	if (!gstate.isModeThrough())
+	if ((flags & PIXEL_DEPTH_RANGE) && !gstate.isModeThrough())
 		if (z < gstate.getDepthRangeMin() || z > gstate.getDepthRangeMax())
 			return;
 
-	if (gstate.isColorTestEnabled() && !clearMode)
-		if (!ColorTestPassed(prim_color.rgb()))
-			return;
+	if ((flags & PIXEL_COLOR_ALPHA_TEST) && !clearMode) {
+		if (gstate.isColorTestEnabled())
+			if (!ColorTestPassed(prim_color.rgb()))
+				return;
 
-	// TODO: Does a need to be clamped?
-	if (gstate.isAlphaTestEnabled() && !clearMode)
-		if (!AlphaTestPassed(prim_color.a()))
-			return;
+		// TODO: Does a need to be clamped?
+		if (gstate.isAlphaTestEnabled())
+			if (!AlphaTestPassed(prim_color.a()))
+				return;
+	}
 
 	// In clear mode, it uses the alpha color as stencil.
 	u8 stencil = clearMode ? prim_color.a() : GetPixelStencil(p.x, p.y);
 	// TODO: Is it safe to ignore gstate.isDepthTestEnabled() when clear mode is enabled? Probably yes
-	if (!clearMode && (gstate.isStencilTestEnabled() || gstate.isDepthTestEnabled())) {
+	if (!clearMode && (flags & PIXEL_DEPTH_STENCIL) && (gstate.isStencilTestEnabled() || gstate.isDepthTestEnabled())) {
 		if (gstate.isStencilTestEnabled() && !StencilTestPassed(stencil)) {
 			stencil = ApplyStencilOp(gstate.getStencilOpSFail(), p.x, p.y);
 			SetPixelStencil(p.x, p.y, stencil);
@@ -941,23 +1028,33 @@ inline void DrawSinglePixel(const DrawingCoords &p, u16 z, u8 fog, const Vec4<in
 	// Doubling happens only when texturing is enabled, and after tests.
 	if (gstate.isTextureMapEnabled() && gstate.isColorDoublingEnabled() && !clearMode) {
 		// TODO: Does this need to be clamped before blending?
+#if defined(_M_SSE)
+		prim_color.ivec = _mm_add_epi32(prim_color.ivec, _mm_and_si128(prim_color.ivec, _mm_set_epi32(0, -1, -1, -1)));
+#else
 		prim_color.r() <<= 1;
 		prim_color.g() <<= 1;
 		prim_color.b() <<= 1;
+#endif
 	}
 
-	if (gstate.isFogEnabled() && !gstate.isModeThrough() && !clearMode) {
+	if ((flags & PIXEL_FOG) && gstate.isFogEnabled() && !gstate.isModeThrough() && !clearMode) {
 		Vec3<int> fogColor = Vec3<int>::FromRGB(gstate.fogcolor);
+#if defined(_M_SSE)
+		const __m128 p = _mm_mul_ps(_mm_cvtepi32_ps(prim_color.ivec), _mm_set_ps1((float)fog));
+		const __m128 f = _mm_mul_ps(_mm_cvtepi32_ps(fogColor.ivec), _mm_set_ps1((float)(255 - (int)fog)));
+		prim_color.ivec = MergeRGBAlpha(DivideBy255(_mm_add_ps(p, f)), prim_color.ivec);
+#else
 		fogColor = (prim_color.rgb() * (int)fog + fogColor * (255 - (int)fog)) / 255;
 		prim_color.r() = fogColor.r();
 		prim_color.g() = fogColor.g();
 		prim_color.b() = fogColor.b();
+#endif
 	}
 
 	const u32 old_color = GetPixelColor(p.x, p.y);
 	u32 new_color;
 
-	if (gstate.isAlphaBlendEnabled() && !clearMode) {
+	if ((flags & PIXEL_BLEND) && gstate.isAlphaBlendEnabled() && !clearMode) {
 		const Vec4<int> dst = Vec4<int>::FromRGBA(old_color);
 		// ToRGBA() always automatically clamps.
 		new_color = AlphaBlendingResult(prim_color, dst).ToRGB();
@@ -972,7 +1069,7 @@ inline void DrawSinglePixel(const DrawingCoords &p, u16 z, u8 fog, const Vec4<in
 	}
 
 	// TODO: Is alpha blending still performed if logic ops are enabled?
-	if (gstate.isLogicOpEnabled() && !clearMode) {
+	if ((flags & PIXEL_LOGIC_OP) && gstate.isLogicOpEnabled() && !clearMode) {
 		// Logic ops don't affect stencil.
 		new_color = (stencil << 24) | (ApplyLogicOp(gstate.getLogicOp(), old_color, new_color) & 0x00FFFFFF);
 	}
@@ -987,6 +1084,45 @@ inline void DrawSinglePixel(const DrawingCoords &p, u16 z, u8 fog, const Vec4<in
 	SetPixelColor(p.x, p.y, new_color);
 }
 
+typedef void (*PixelFunc)(const DrawingCoords &p, u16 z, u8 fog, const Vec4<int> &color_in);
+
+#define PIXEL_FUNC(n) &DrawSinglePixel<false, n>
+#define PIXEL_FUNCS_8(n) PIXEL_FUNC(n), PIXEL_FUNC(n + 1), PIXEL_FUNC(n + 2), PIXEL_FUNC(n + 3), \
+	PIXEL_FUNC(n + 4), PIXEL_FUNC(n + 5), PIXEL_FUNC(n + 6), PIXEL_FUNC(n + 7)
+
+// Every specialization, indexed by PixelFuncFlags.
+static const PixelFunc pixelFuncs[PIXEL_ALL + 1] = {
+	PIXEL_FUNCS_8(0x00), PIXEL_FUNCS_8(0x08), PIXEL_FUNCS_8(0x10), PIXEL_FUNCS_8(0x18),
+	PIXEL_FUNCS_8(0x20), PIXEL_FUNCS_8(0x28), PIXEL_FUNCS_8(0x30), PIXEL_FUNCS_8(0x38),
+};
+
+#undef PIXEL_FUNCS_8
+#undef PIXEL_FUNC
+
+static u32 ComputePixelFuncFlags() {
+	u32 flags = 0;
+	if (!gstate.isModeThrough())
+		flags |= PIXEL_DEPTH_RANGE;
+	if (gstate.isColorTestEnabled() || gstate.isAlphaTestEnabled())
+		flags |= PIXEL_COLOR_ALPHA_TEST;
+	if (gstate.isStencilTestEnabled() || gstate.isDepthTestEnabled())
+		flags |= PIXEL_DEPTH_STENCIL;
+	if (gstate.isFogEnabled() && !gstate.isModeThrough())
+		flags |= PIXEL_FOG;
+	if (gstate.isAlphaBlendEnabled())
+		flags |= PIXEL_BLEND;
+	if (gstate.isLogicOpEnabled())
+		flags |= PIXEL_LOGIC_OP;
+	return flags;
+}
+
+// Picks the pixel function for the current state.  Only call when the state could have changed.
+static PixelFunc GetPixelFunc() {
+	if (gstate.isModeClear())
+		return &DrawSinglePixel<true, PIXEL_ALL>;
+	return pixelFuncs[ComputePixelFuncFlags()];
+}
+
 static inline void ApplyTexturing(Sampler::Funcs sampler, Vec4<int> &prim_color, float s, float t, int texlevel, int frac_texlevel, bool bilinear, u8 *texptr[], int texbufw[]) {
 	int u[8] = {0}, v[8] = {0};   // 1.23.8 fixed point
 	int frac_u[2], frac_v[2];
@@ -1179,51 +1315,88 @@ static inline Vec4<float> EdgeRecip(const Vec4<int> &w0, const Vec4<int> &w1, co
 #endif
 }
 
-template <bool clearMode>
-void DrawTriangleSlice(
-	const VertexData& v0, const VertexData& v1, const VertexData& v2,
-	int minX, int minY, int maxX, int maxY,
-	bool byY, int h1, int h2)
-{
-	Vec4<int> bias0 = Vec4<int>::AssignToAll(IsRightSideOrFlatBottomLine(v0.screenpos.xy(), v1.screenpos.xy(), v2.screenpos.xy()) ? -1 : 0);
-	Vec4<int> bias1 = Vec4<int>::AssignToAll(IsRightSideOrFlatBottomLine(v1.screenpos.xy(), v2.screenpos.xy(), v0.screenpos.xy()) ? -1 : 0);
-	Vec4<int> bias2 = Vec4<int>::AssignToAll(IsRightSideOrFlatBottomLine(v2.screenpos.xy(), v0.screenpos.xy(), v1.screenpos.xy()) ? -1 : 0);
-
-	int texbufw[8] = {0};
+// Texture level pointers and the pixel function only depend on state, so they're looked up once per batch.
+struct RasterState {
+	u8 *texptr[8];
+	int texbufw[8];
+	int maxTexLevel;
+	Sampler::Funcs sampler;
+	PixelFunc drawPixel;
+	bool earlyDepthTest;
+};
 
-	int maxTexLevel = gstate.getTextureMaxLevel();
-	u8 *texptr[8] = {NULL};
+static std::atomic<int> earlyDepthRejected;
 
-	if (!gstate.isMipmapEnabled()) {
-		// No mipmapping enabled
-		maxTexLevel = 0;
-	}
+static void GetRasterState(RasterState &levels) {
+	memset(&levels, 0, sizeof(levels));
+	levels.sampler = Sampler::GetFuncs();
+	levels.drawPixel = GetPixelFunc();
+	// Stencil ops would still need to run for pixels that fail depth.
+	levels.earlyDepthTest = !gstate.isModeClear() && gstate.isDepthTestEnabled() && !gstate.isStencilTestEnabled();
+	levels.maxTexLevel = gstate.isMipmapEnabled() ? gstate.getTextureMaxLevel() : 0;
 
-	if (gstate.isTextureMapEnabled() && !clearMode) {
+	if (gstate.isTextureMapEnabled() && !gstate.isModeClear()) {
 		GETextureFormat texfmt = gstate.getTextureFormat();
-		for (int i = 0; i <= maxTexLevel; i++) {
+		for (int i = 0; i <= levels.maxTexLevel; i++) {
 			u32 texaddr = gstate.getTextureAddress(i);
-			texbufw[i] = GetTextureBufw(i, texaddr, texfmt);
+			levels.texbufw[i] = GetTextureBufw(i, texaddr, texfmt);
 			if (Memory::IsValidAddress(texaddr))
-				texptr[i] = Memory::GetPointerUnchecked(texaddr);
+				levels.texptr[i] = Memory::GetPointerUnchecked(texaddr);
 			else
-				texptr[i] = 0;
+				levels.texptr[i] = 0;
+		}
+
+		// Use cached decoded copies, but only if every level has one since they share a sampler.
+		const u8 *decoded[8];
+		bool allDecoded = true;
+		for (int i = 0; i <= levels.maxTexLevel && allDecoded; i++) {
+			decoded[i] = Sampler::GetDecodedTexture(i, gstate.getTextureAddress(i), levels.texptr[i], levels.texbufw[i], levels.sampler.nearest);
+			allDecoded = decoded[i] != nullptr;
+		}
+		if (allDecoded) {
+			for (int i = 0; i <= levels.maxTexLevel; i++) {
+				levels.texptr[i] = (u8 *)decoded[i];
+				levels.texbufw[i] = gstate.getTextureWidth(i);
+			}
+			levels.sampler = Sampler::GetDecodedFuncs();
 		}
 	}
+}
+
+// Rasterizes the part of a triangle (bounds minX-maxX, minY-maxY) whose pixels fall inside the
+// tile tileTL-tileBR (screen coords, BR exclusive.)  Sample positions stay on the same grid as
+// a full triangle draw, so splitting a triangle into tiles doesn't change which pixels it covers.
+template <bool clearMode>
+void DrawTriangleSlice(
+	const VertexData& v0, const VertexData& v1, const VertexData& v2,
+	int minX, int minY, int maxX, int maxY,
+	const ScreenCoords &tileTL, const ScreenCoords &tileBR, const RasterState &levels)
+{
+	Vec4<int> bias0 = Vec4<int>::AssignToAll(IsRightSideOrFlatBottomLine(v0.screenpos.xy(), v1.screenpos.xy(), v2.screenpos.xy()) ? -1 : 0);
+	Vec4<int> bias1 = Vec4<int>::AssignToAll(IsRightSideOrFlatBottomLine(v1.screenpos.xy(), v2.screenpos.xy(), v0.screenpos.xy()) ? -1 : 0);
+	Vec4<int> bias2 = Vec4<int>::AssignToAll(IsRightSideOrFlatBottomLine(v2.screenpos.xy(), v0.screenpos.xy(), v1.screenpos.xy()) ? -1 : 0);
+
+	u8 *texptr[8];
+	int texbufw[8];
+	memcpy(texptr, levels.texptr, sizeof(texptr));
+	memcpy(texbufw, levels.texbufw, sizeof(texbufw));
+	const int maxTexLevel = levels.maxTexLevel;
+	const Sampler::Funcs sampler = levels.sampler;
+	const PixelFunc drawPixel = levels.drawPixel;
+	const bool earlyDepthTest = levels.earlyDepthTest;
+	int earlyRejected = 0;
 
 	TriangleEdge e0;
 	TriangleEdge e1;
 	TriangleEdge e2;
 
-	if (byY) {
-		maxY = std::min(maxY, minY + h2 * 16 * 2);
-		minY += h1 * 16 * 2;
-	} else {
-		maxX = std::min(maxX, minX + h2 * 16 * 2);
-		minX += h1 * 16 * 2;
-	}
+	// Skip whole 2x2 blocks before the tile, we step 32 at a time.
+	const int startX = minX + std::max(0, (tileTL.x - minX) / 32) * 32;
+	const int startY = minY + std::max(0, (tileTL.y - minY) / 32) * 32;
+	const int endX = std::min(maxX + 1, (int)tileBR.x);
+	const int endY = std::min(maxY, (int)tileBR.y);
 
-	ScreenCoords pprime(minX, minY, 0);
+	ScreenCoords pprime(startX, startY, 0);
 	Vec4<int> w0_base = e0.Start(v1.screenpos, v2.screenpos, pprime);
 	Vec4<int> w1_base = e1.Start(v2.screenpos, v0.screenpos, pprime);
 	Vec4<int> w2_base = e2.Start(v0.screenpos, v1.screenpos, pprime);
@@ -1232,9 +1405,7 @@ void DrawTriangleSlice(
 	// This is common, and when we interpolate, we lose accuracy.
 	const bool flatZ = v0.screenpos.z == v1.screenpos.z && v0.screenpos.z == v2.screenpos.z;
 
-	Sampler::Funcs sampler = Sampler::GetFuncs();
-
-	for (pprime.y = minY; pprime.y < maxY; pprime.y += 32,
+	for (pprime.y = startY; pprime.y < endY; pprime.y += 32,
 										w0_base = e0.StepY(w0_base),
 										w1_base = e1.StepY(w1_base),
 										w2_base = e2.StepY(w2_base)) {
@@ -1244,24 +1415,53 @@ void DrawTriangleSlice(
 
 		// TODO: Maybe we can clip the edges instead?
 		int scissorYPlus1 = pprime.y + 16 > maxY ? -1 : 0;
-		Vec4<int> scissor_mask = Vec4<int>(0, maxX - minX - 1, scissorYPlus1, (maxX - minX - 1) | scissorYPlus1);
+		Vec4<int> scissor_mask = Vec4<int>(0, maxX - startX - 1, scissorYPlus1, (maxX - startX - 1) | scissorYPlus1);
 		Vec4<int> scissor_step = Vec4<int>(0, -32, 0, -32);
 
-		pprime.x = minX;
+		// Rows outside the tile belong to a neighbour.
+		const int tileRow0 = pprime.y >= tileTL.y ? 0 : -1;
+		const int tileRow1 = pprime.y + 16 >= tileTL.y && pprime.y + 16 < tileBR.y ? 0 : -1;
+
+		pprime.x = startX;
 		DrawingCoords p = TransformUnit::ScreenToDrawing(pprime);
 
-		for (; pprime.x <= maxX; pprime.x += 32,
+		for (; pprime.x < endX; pprime.x += 32,
 			w0 = e0.StepX(w0),
 			w1 = e1.StepX(w1),
 			w2 = e2.StepX(w2),
 			scissor_mask = scissor_mask + scissor_step,
 			p.x = (p.x + 2) & 0x3FF) {
 
+			const int tileCol0 = pprime.x >= tileTL.x ? 0 : -1;
+			const int tileCol1 = pprime.x + 16 >= tileTL.x && pprime.x + 16 < tileBR.x ? 0 : -1;
+			Vec4<int> tile_mask = Vec4<int>(tileCol0 | tileRow0, tileCol1 | tileRow0, tileCol0 | tileRow1, tileCol1 | tileRow1);
+
 			// If p is on or inside all edges, render pixel
-			Vec4<int> mask = MakeMask(w0, w1, w2, bias0, bias1, bias2, scissor_mask);
+			Vec4<int> mask = MakeMask(w0, w1, w2, bias0, bias1, bias2, scissor_mask | tile_mask);
 			if (AnyMask(mask)) {
 				Vec4<float> wsum_recip = EdgeRecip(w0, w1, w2);
 
+				Vec4<int> z;
+				if (flatZ) {
+					z = Vec4<int>::AssignToAll(v2.screenpos.z);
+				} else {
+					// TODO: Is that the correct way to interpolate?
+					Vec4<float> zfloats = w0.Cast<float>() * v0.screenpos.z + w1.Cast<float>() * v1.screenpos.z + w2.Cast<float>() * v2.screenpos.z;
+					z = (zfloats * wsum_recip).Cast<int>();
+				}
+
+				if (earlyDepthTest) {
+					// Nothing before the depth test has side effects, so skip shading what would fail.
+					for (int i = 0; i < 4; ++i) {
+						if (mask[i] >= 0 && !DepthTestPassed((p.x + (i & 1)) & 0x3FF, p.y + (i / 2), (u16)z[i])) {
+							mask[i] = -1;
+							earlyRejected++;
+						}
+					}
+					if (!AnyMask(mask))
+						continue;
+				}
+
 				Vec4<int> prim_color[4];
 				Vec3<int> sec_color[4];
 				if (gstate.getShadeMode() == GE_SHADE_GOURAUD && !clearMode) {
@@ -1315,15 +1515,6 @@ void DrawTriangleSlice(
 					}
 				}
 
-				Vec4<int> z;
-				if (flatZ) {
-					z = Vec4<int>::AssignToAll(v2.screenpos.z);
-				} else {
-					// TODO: Is that the correct way to interpolate?
-					Vec4<float> zfloats = w0.Cast<float>() * v0.screenpos.z + w1.Cast<float>() * v1.screenpos.z + w2.Cast<float>() * v2.screenpos.z;
-					z = (zfloats * wsum_recip).Cast<int>();
-				}
-
 				DrawingCoords subp = p;
 				for (int i = 0; i < 4; ++i) {
 					if (mask[i] < 0) {
@@ -1332,18 +1523,141 @@ void DrawTriangleSlice(
 					subp.x = p.x + (i & 1);
 					subp.y = p.y + (i / 2);
 
-					DrawSinglePixel<clearMode>(subp, (u16)z[i], fog[i], prim_color[i]);
+					drawPixel(subp, (u16)z[i], fog[i], prim_color[i]);
 				}
 			}
 		}
 	}
+
+	if (earlyRejected != 0)
+		earlyDepthRejected += earlyRejected;
 }
 
-// Draws triangle, vertices specified in counter-clockwise direction
-void DrawTriangle(const VertexData& v0, const VertexData& v1, const VertexData& v2)
-{
+// Triangles are queued up while state stays the same, binned into tiles of the framebuffer,
+// and then each tile is rasterized on its own.  Tiles only ever touch their own pixels, so
+// they can run in parallel while still drawing their triangles in submission order.
+enum {
+	TILE_SIZE_SHIFT = 6,
+	TILES_PER_AXIS = 1024 >> TILE_SIZE_SHIFT,
+	MAX_QUEUED_TRIANGLES = 4096,
+};
+
+// Far enough out that the edge tiles cover everything, without overflowing when offset.
+static const int TILE_UNBOUNDED = 0x40000000;
+
+struct QueuedTriangle {
+	VertexData v[3];
+	int minX, minY, maxX, maxY;
+};
+
+static std::vector<QueuedTriangle> queuedTriangles;
+static std::vector<int> tileBins[TILES_PER_AXIS * TILES_PER_AXIS];
+static std::vector<int> activeTiles;
+
+static inline int ScreenToTileX(int x) {
+	int drawX = (x - gstate.getOffsetX16()) >> (4 + TILE_SIZE_SHIFT);
+	return std::min(std::max(drawX, 0), (int)TILES_PER_AXIS - 1);
+}
+
+static inline int ScreenToTileY(int y) {
+	int drawY = (y - gstate.getOffsetY16()) >> (4 + TILE_SIZE_SHIFT);
+	return std::min(std::max(drawY, 0), (int)TILES_PER_AXIS - 1);
+}
+
+static inline int TileToScreenX(int tx) {
+	if (tx <= 0)
+		return -TILE_UNBOUNDED;
+	if (tx >= TILES_PER_AXIS)
+		return TILE_UNBOUNDED;
+	return (tx << (4 + TILE_SIZE_SHIFT)) + gstate.getOffsetX16();
+}
+
+static inline int TileToScreenY(int ty) {
+	if (ty <= 0)
+		return -TILE_UNBOUNDED;
+	if (ty >= TILES_PER_AXIS)
+		return TILE_UNBOUNDED;
+	return (ty << (4 + TILE_SIZE_SHIFT)) + gstate.getOffsetY16();
+}
+
+template <bool clearMode>
+static void DrawTileTriangles(int tile, const RasterState &levels) {
+	const int tx = tile % TILES_PER_AXIS;
+	const int ty = tile / TILES_PER_AXIS;
+	const ScreenCoords tileTL(TileToScreenX(tx), TileToScreenY(ty), 0);
+	const ScreenCoords tileBR(TileToScreenX(tx + 1), TileToScreenY(ty + 1), 0);
+
+	for (int index : tileBins[tile]) {
+		const QueuedTriangle &tri = queuedTriangles[index];
+		DrawTriangleSlice<clearMode>(tri.v[0], tri.v[1], tri.v[2], tri.minX, tri.minY, tri.maxX, tri.maxY, tileTL, tileBR, levels);
+	}
+}
+
+// Set when points, lines or clears wrote to the buffers outside of Flush().
+static bool buffersWritten = false;
+
+// Our own rendering can feed later draws as a texture, so decoded copies of it must go.
+static void InvalidateDrawnBuffers() {
+	const int rows = gstate.getScissorY2() + 1;
+	const int bpp = gstate.FrameBufFormat() == GE_FORMAT_8888 ? 4 : 2;
+	Sampler::InvalidateDecodedTextures(gstate.getFrameBufAddress(), gstate.FrameBufStride() * rows * bpp);
+	Sampler::InvalidateDecodedTextures(gstate.getDepthBufAddress(), gstate.DepthBufStride() * rows * 2);
+	buffersWritten = false;
+}
+
+void Flush() {
+	if (buffersWritten)
+		InvalidateDrawnBuffers();
+	if (queuedTriangles.empty())
+		return;
+
 	PROFILE_THIS_SCOPE("draw_tri");
 
+	for (int i = 0; i < (int)queuedTriangles.size(); ++i) {
+		const QueuedTriangle &tri = queuedTriangles[i];
+		const int tx1 = ScreenToTileX(tri.minX);
+		const int ty1 = ScreenToTileY(tri.minY);
+		// The second pixel of the last block can land just past maxX.
+		const int tx2 = ScreenToTileX(tri.maxX + 15);
+		const int ty2 = ScreenToTileY(tri.maxY);
+		for (int ty = ty1; ty <= ty2; ++ty) {
+			for (int tx = tx1; tx <= tx2; ++tx) {
+				std::vector<int> &bin = tileBins[ty * TILES_PER_AXIS + tx];
+				if (bin.empty())
+					activeTiles.push_back(ty * TILES_PER_AXIS + tx);
+				bin.push_back(i);
+			}
+		}
+	}
+
+	RasterState levels;
+	GetRasterState(levels);
+
+	if (gstate.isModeClear()) {
+		auto bound = [&](int a, int b) -> void {
+			for (int i = a; i < b; ++i)
+				DrawTileTriangles<true>(activeTiles[i], levels);
+		};
+		GlobalThreadPool::Loop(bound, 0, (int)activeTiles.size());
+	} else {
+		auto bound = [&](int a, int b) -> void {
+			for (int i = a; i < b; ++i)
+				DrawTileTriangles<false>(activeTiles[i], levels);
+		};
+		GlobalThreadPool::Loop(bound, 0, (int)activeTiles.size());
+	}
+
+	for (int tile : activeTiles)
+		tileBins[tile].clear();
+	activeTiles.clear();
+	queuedTriangles.clear();
+
+	InvalidateDrawnBuffers();
+}
+
+// Queues triangle, vertices specified in counter-clockwise direction
+void DrawTriangle(const VertexData& v0, const VertexData& v1, const VertexData& v2)
+{
 	Vec2<int> d01((int)v0.screenpos.x - (int)v1.screenpos.x, (int)v0.screenpos.y - (int)v1.screenpos.y);
 	Vec2<int> d02((int)v0.screenpos.x - (int)v2.screenpos.x, (int)v0.screenpos.y - (int)v2.screenpos.y);
 	Vec2<int> d12((int)v1.screenpos.x - (int)v2.screenpos.x, (int)v1.screenpos.y - (int)v2.screenpos.y);
@@ -1364,44 +1678,28 @@ void DrawTriangle(const VertexData& v0, const VertexData& v1, const VertexData&
 	minY = std::max(minY, (int)TransformUnit::DrawingToScreen(scissorTL).y);
 	maxY = std::min(maxY, (int)TransformUnit::DrawingToScreen(scissorBR).y);
 
-	// 32 because we do two pixels at once, and we don't want overlap.
-	int rangeY = (maxY - minY) / 32 + 1;
-	int rangeX = (maxX - minX) / 32 + 1;
-	if (rangeY >= 12 && rangeX >= rangeY * 4) {
-		if (gstate.isModeClear()) {
-			auto bound = [&](int a, int b) -> void {
-				DrawTriangleSlice<true>(v0, v1, v2, minX, minY, maxX, maxY, false, a, b);
-			};
-			GlobalThreadPool::Loop(bound, 0, rangeX);
-		} else {
-			auto bound = [&](int a, int b) -> void {
-				DrawTriangleSlice<false>(v0, v1, v2, minX, minY, maxX, maxY, false, a, b);
-			};
-			GlobalThreadPool::Loop(bound, 0, rangeX);
-		}
-	} else if (rangeY >= 12 && rangeX >= 12) {
-		if (gstate.isModeClear()) {
-			auto bound = [&](int a, int b) -> void {
-				DrawTriangleSlice<true>(v0, v1, v2, minX, minY, maxX, maxY, true, a, b);
-			};
-			GlobalThreadPool::Loop(bound, 0, rangeY);
-		} else {
-			auto bound = [&](int a, int b) -> void {
-				DrawTriangleSlice<false>(v0, v1, v2, minX, minY, maxX, maxY, true, a, b);
-			};
-			GlobalThreadPool::Loop(bound, 0, rangeY);
-		}
-	} else {
-		if (gstate.isModeClear()) {
-			DrawTriangleSlice<true>(v0, v1, v2, minX, minY, maxX, maxY, true, 0, rangeY);
-		} else {
-			DrawTriangleSlice<false>(v0, v1, v2, minX, minY, maxX, maxY, true, 0, rangeY);
-		}
-	}
+	if (minX > maxX || minY >= maxY)
+		return;
+
+	if (queuedTriangles.size() >= MAX_QUEUED_TRIANGLES)
+		Flush();
+
+	queuedTriangles.push_back(QueuedTriangle());
+	QueuedTriangle &tri = queuedTriangles.back();
+	tri.v[0] = v0;
+	tri.v[1] = v1;
+	tri.v[2] = v2;
+	tri.minX = minX;
+	tri.minY = minY;
+	tri.maxX = maxX;
+	tri.maxY = maxY;
 }
 
 void DrawPoint(const VertexData &v0)
 {
+	Flush();
+	buffersWritten = true;
+
 	ScreenCoords pos = v0.screenpos;
 	Vec4<int> prim_color = v0.color0;
 	Vec3<int> sec_color = v0.color1;
@@ -1469,15 +1767,14 @@ void DrawPoint(const VertexData &v0)
 		fog = ClampFogDepth(v0.fogdepth);
 	}
 
-	if (clearMode) {
-		DrawSinglePixel<true>(p, z, fog, prim_color);
-	} else {
-		DrawSinglePixel<false>(p, z, fog, prim_color);
-	}
+	GetPixelFunc()(p, z, fog, prim_color);
 }
 
 void ClearRectangle(const VertexData &v0, const VertexData &v1)
 {
+	Flush();
+	buffersWritten = true;
+
 	int minX = std::min(v0.screenpos.x, v1.screenpos.x) & ~0xF;
 	int minY = std::min(v0.screenpos.y, v1.screenpos.y) & ~0xF;
 	int maxX = (std::max(v0.screenpos.x, v1.screenpos.x) + 0xF) & ~0xF;
@@ -1610,6 +1907,9 @@ void ClearRectangle(const VertexData &v0, const VertexData &v1)
 
 void DrawLine(const VertexData &v0, const VertexData &v1)
 {
+	Flush();
+	buffersWritten = true;
+
 	// TODO: Use a proper line drawing algorithm that handles fractional endpoints correctly.
 	Vec3<int> a(v0.screenpos.x, v0.screenpos.y, v0.screenpos.z);
 	Vec3<int> b(v1.screenpos.x, v1.screenpos.y, v0.screenpos.z);
@@ -1652,6 +1952,7 @@ void DrawLine(const VertexData &v0, const VertexData &v1)
 	}
 
 	Sampler::Funcs sampler = Sampler::GetFuncs();
+	PixelFunc drawPixel = GetPixelFunc();
 
 	float x = a.x > b.x ? a.x - 1 : a.x;
 	float y = a.y > b.y ? a.y - 1 : a.y;
@@ -1726,11 +2027,7 @@ void DrawLine(const VertexData &v0, const VertexData &v1)
 			ScreenCoords pprime = ScreenCoords((int)x, (int)y, (int)z);
 
 			DrawingCoords p = TransformUnit::ScreenToDrawing(pprime);
-			if (clearMode) {
-				DrawSinglePixel<true>(p, z, fog, prim_color);
-			} else {
-				DrawSinglePixel<false>(p, z, fog, prim_color);
-			}
+			drawPixel(p, z, fog, prim_color);
 		}
 
 		x += xinc;
@@ -1739,6 +2036,10 @@ void DrawLine(const VertexData &v0, const VertexData &v1)
 	}
 }
 
+int GetAndResetEarlyDepthRejected() {
+	return earlyDepthRejected.exchange(0);
+}
+
 bool GetCurrentStencilbuffer(GPUDebugBuffer &buffer)
 {
 	int w = gstate.getRegionX2() - gstate.getRegionX1() + 1;
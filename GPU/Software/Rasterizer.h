@@ -23,12 +23,17 @@ struct GPUDebugBuffer;
 
 namespace Rasterizer {
 
-// Draws a triangle if its vertices are specified in counter-clockwise order
+// Queues a triangle if its vertices are specified in counter-clockwise order.
+// Queued triangles are drawn on Flush(), which must happen before state or memory they use changes.
 void DrawTriangle(const VertexData& v0, const VertexData& v1, const VertexData& v2);
+void Flush();
 void DrawPoint(const VertexData &v0);
 void DrawLine(const VertexData &v0, const VertexData &v1);
 void ClearRectangle(const VertexData &v0, const VertexData &v1);
 
+// Pixels skipped before shading because they would fail the depth test.
+int GetAndResetEarlyDepthRejected();
+
 bool GetCurrentStencilbuffer(GPUDebugBuffer &buffer);
 bool GetCurrentTexture(GPUDebugBuffer &buffer, int level);
 
@@ -17,9 +17,12 @@
 
 #include <unordered_map>
 #include <mutex>
+#include <vector>
 #include "Common/ColorConv.h"
+#include "Core/MemMap.h"
 #include "Core/Reporting.h"
 #include "GPU/Common/TextureDecoder.h"
+#include "GPU/GPU.h"
 #include "GPU/GPUState.h"
 #include "GPU/Software/Sampler.h"
 
@@ -33,8 +36,8 @@ extern u32 clut[4096];
 
 namespace Sampler {
 
-static u32 SampleNearest(int u, int v, const u8 *tptr, int bufw, int level);
-static u32 SampleLinear(int u[4], int v[4], int frac_u, int frac_v, const u8 *tptr, int bufw, int level);
+static NearestFunc GetSpecializedNearest(const SamplerID &id);
+static LinearFunc GetSpecializedLinear(const SamplerID &id);
 
 std::mutex jitCacheLock;
 SamplerJitCache *jitCache = nullptr;
@@ -46,6 +49,7 @@ void Init() {
 void Shutdown() {
 	delete jitCache;
 	jitCache = nullptr;
+	ClearDecodedTextures();
 }
 
 bool DescribeCodePtr(const u8 *ptr, std::string &name) {
@@ -65,7 +69,7 @@ NearestFunc GetNearestFunc() {
 		return jitted;
 	}
 
-	return &SampleNearest;
+	return GetSpecializedNearest(id);
 }
 
 LinearFunc GetLinearFunc() {
@@ -76,7 +80,132 @@ LinearFunc GetLinearFunc() {
 		return jitted;
 	}
 
-	return &SampleLinear;
+	return GetSpecializedLinear(id);
+}
+
+Funcs GetDecodedFuncs() {
+	// Decoded textures are always plain, unswizzled 8888.
+	SamplerID id;
+	id.texfmt = GE_TFMT_8888;
+
+	Funcs f;
+	id.linear = false;
+	f.nearest = jitCache->GetNearest(id);
+	if (!f.nearest)
+		f.nearest = GetSpecializedNearest(id);
+	id.linear = true;
+	f.linear = jitCache->GetLinear(id);
+	if (!f.linear)
+		f.linear = GetSpecializedLinear(id);
+	return f;
+}
+
+// Decoded texture cache.  Swizzled, CLUT and DXT textures are expensive to sample directly,
+// so hot ones are decoded to linear 8888 once.  Entries are dropped on invalidation (memory
+// writes we know about, including our own rendering), and rehashed once per frame otherwise.
+enum {
+	MIN_DECODED_TEXELS = 16 * 16,
+	MAX_DECODED_TEXELS_TOTAL = 4 * 1024 * 1024,
+};
+
+struct DecodedTexture {
+	u32 addr;
+	u32 bytes;
+	u32 srcHash;
+	u32 clutHash;
+	int lastVerifiedFrame;
+	std::vector<u32> data;
+};
+
+static std::unordered_map<u64, DecodedTexture *> decodedTextures;
+static size_t decodedTexelsTotal = 0;
+
+static bool ShouldDecodeTexture(GETextureFormat texfmt, bool swizzled) {
+	// Plain 8888 is already as fast as it gets, and the 16-bit formats are cheap enough.
+	return swizzled || texfmt >= GE_TFMT_CLUT4;
+}
+
+static u32 ComputeClutHash(GETextureFormat texfmt) {
+	if (texfmt < GE_TFMT_CLUT4 || texfmt > GE_TFMT_CLUT32)
+		return 0;
+	// Covers the largest index reachable with the offset, plus separate CLUT4 mip palettes.
+	// The seed folds in the index transform and the mip sharing flag.
+	return DoReliableHash32((const u8 *)clut, 1024 * sizeof(u32), gstate.clutformat ^ (gstate.texmode << 1));
+}
+
+void ClearDecodedTextures() {
+	for (auto &it : decodedTextures)
+		delete it.second;
+	decodedTextures.clear();
+	decodedTexelsTotal = 0;
+}
+
+void InvalidateDecodedTextures(u32 addr, int size) {
+	addr &= 0x0FFFFFFF;
+	const u32 end = addr + size;
+	for (auto it = decodedTextures.begin(); it != decodedTextures.end(); ) {
+		DecodedTexture *entry = it->second;
+		if (entry->addr < end && addr < entry->addr + entry->bytes) {
+			decodedTexelsTotal -= entry->data.size();
+			delete entry;
+			it = decodedTextures.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
+const u8 *GetDecodedTexture(int level, u32 texaddr, const u8 *tptr, int bufw, NearestFunc nearest) {
+	const GETextureFormat texfmt = gstate.getTextureFormat();
+	const bool swizzled = gstate.isTextureSwizzled();
+	const int w = gstate.getTextureWidth(level);
+	const int h = gstate.getTextureHeight(level);
+	if (!tptr || !ShouldDecodeTexture(texfmt, swizzled) || w * h < MIN_DECODED_TEXELS)
+		return nullptr;
+
+	// Swizzled textures are stored in blocks of 8 rows.
+	const u32 rows = (h + 7) & ~7;
+	const u32 bytes = Memory::ValidSize(texaddr, (bufw * rows * textureBitsPerPixel[texfmt]) / 8);
+
+	const u64 key = ((u64)(texaddr & 0x0FFFFFFF) << 32) | ((u64)bufw << 20) | ((gstate.texsize[level] & 0x0F0F) << 5) | (texfmt << 1) | (swizzled ? 1 : 0);
+	const u32 clutHash = ComputeClutHash(texfmt);
+
+	DecodedTexture *entry = nullptr;
+	auto it = decodedTextures.find(key);
+	if (it != decodedTextures.end()) {
+		entry = it->second;
+		if (entry->clutHash == clutHash) {
+			if (entry->lastVerifiedFrame == gpuStats.numFlips)
+				return (const u8 *)entry->data.data();
+			// Catch writes we weren't told about, at most once a frame.
+			if (entry->srcHash == DoQuickTexHash(tptr, bytes)) {
+				entry->lastVerifiedFrame = gpuStats.numFlips;
+				return (const u8 *)entry->data.data();
+			}
+		}
+		decodedTexelsTotal -= entry->data.size();
+	} else {
+		if (decodedTexelsTotal + w * h > MAX_DECODED_TEXELS_TOTAL)
+			ClearDecodedTextures();
+		entry = new DecodedTexture();
+		decodedTextures[key] = entry;
+	}
+
+	entry->addr = texaddr & 0x0FFFFFFF;
+	entry->bytes = bytes;
+	entry->srcHash = DoQuickTexHash(tptr, bytes);
+	entry->clutHash = clutHash;
+	entry->lastVerifiedFrame = gpuStats.numFlips;
+	entry->data.resize(w * h);
+	decodedTexelsTotal += entry->data.size();
+
+	u32 *dst = entry->data.data();
+	for (int v = 0; v < h; ++v) {
+		for (int u = 0; u < w; ++u) {
+			*dst++ = nearest(u, v, tptr, bufw, level);
+		}
+	}
+	return (const u8 *)entry->data.data();
 }
 
 SamplerJitCache::SamplerJitCache()
@@ -249,10 +378,10 @@ LinearFunc SamplerJitCache::GetLinear(const SamplerID &id) {
 #endif
 }
 
-template <unsigned int texel_size_bits>
+template <unsigned int texel_size_bits, bool swizzled>
 static inline int GetPixelDataOffset(unsigned int row_pitch_pixels, unsigned int u, unsigned int v)
 {
-	if (!gstate.isTextureSwizzled())
+	if (!swizzled)
 		return (v * (row_pitch_pixels * texel_size_bits >> 3)) + (u * texel_size_bits >> 3);
 
 	const int tile_size_bits = 32;
@@ -302,8 +431,8 @@ struct Nearest4 {
 	}
 };
 
-template <int N>
-inline static Nearest4 SampleNearest(int u[N], int v[N], const u8 *srcptr, int texbufw, int level)
+template <int N, int texfmt, bool swizzled>
+inline static Nearest4 SampleNearestFormat(int u[N], int v[N], const u8 *srcptr, int texbufw, int level)
 {
 	Nearest4 res;
 	if (!srcptr) {
@@ -311,42 +440,40 @@ inline static Nearest4 SampleNearest(int u[N], int v[N], const u8 *srcptr, int t
 		return res;
 	}
 
-	GETextureFormat texfmt = gstate.getTextureFormat();
-
 	// TODO: Should probably check if textures are aligned properly...
 
-	switch (texfmt) {
+	switch ((GETextureFormat)texfmt) {
 	case GE_TFMT_4444:
 		for (int i = 0; i < N; ++i) {
-			const u8 *src = srcptr + GetPixelDataOffset<16>(texbufw, u[i], v[i]);
+			const u8 *src = srcptr + GetPixelDataOffset<16, swizzled>(texbufw, u[i], v[i]);
 			res.v[i] = RGBA4444ToRGBA8888(*(const u16 *)src);
 		}
 		return res;
 	
 	case GE_TFMT_5551:
 		for (int i = 0; i < N; ++i) {
-			const u8 *src = srcptr + GetPixelDataOffset<16>(texbufw, u[i], v[i]);
+			const u8 *src = srcptr + GetPixelDataOffset<16, swizzled>(texbufw, u[i], v[i]);
 			res.v[i] = RGBA5551ToRGBA8888(*(const u16 *)src);
 		}
 		return res;
 
 	case GE_TFMT_5650:
 		for (int i = 0; i < N; ++i) {
-			const u8 *src = srcptr + GetPixelDataOffset<16>(texbufw, u[i], v[i]);
+			const u8 *src = srcptr + GetPixelDataOffset<16, swizzled>(texbufw, u[i], v[i]);
 			res.v[i] = RGB565ToRGBA8888(*(const u16 *)src);
 		}
 		return res;
 
 	case GE_TFMT_8888:
 		for (int i = 0; i < N; ++i) {
-			const u8 *src = srcptr + GetPixelDataOffset<32>(texbufw, u[i], v[i]);
+			const u8 *src = srcptr + GetPixelDataOffset<32, swizzled>(texbufw, u[i], v[i]);
 			res.v[i] = *(const u32 *)src;
 		}
 		return res;
 
 	case GE_TFMT_CLUT32:
 		for (int i = 0; i < N; ++i) {
-			const u8 *src = srcptr + GetPixelDataOffset<32>(texbufw, u[i], v[i]);
+			const u8 *src = srcptr + GetPixelDataOffset<32, swizzled>(texbufw, u[i], v[i]);
 			u32 val = src[0] + (src[1] << 8) + (src[2] << 16) + (src[3] << 24);
 			res.v[i] = LookupColor(gstate.transformClutIndex(val), 0);
 		}
@@ -354,7 +481,7 @@ inline static Nearest4 SampleNearest(int u[N], int v[N], const u8 *srcptr, int t
 
 	case GE_TFMT_CLUT16:
 		for (int i = 0; i < N; ++i) {
-			const u8 *src = srcptr + GetPixelDataOffset<16>(texbufw, u[i], v[i]);
+			const u8 *src = srcptr + GetPixelDataOffset<16, swizzled>(texbufw, u[i], v[i]);
 			u16 val = src[0] + (src[1] << 8);
 			res.v[i] = LookupColor(gstate.transformClutIndex(val), 0);
 		}
@@ -362,7 +489,7 @@ inline static Nearest4 SampleNearest(int u[N], int v[N], const u8 *srcptr, int t
 
 	case GE_TFMT_CLUT8:
 		for (int i = 0; i < N; ++i) {
-			const u8 *src = srcptr + GetPixelDataOffset<8>(texbufw, u[i], v[i]);
+			const u8 *src = srcptr + GetPixelDataOffset<8, swizzled>(texbufw, u[i], v[i]);
 			u8 val = *src;
 			res.v[i] = LookupColor(gstate.transformClutIndex(val), 0);
 		}
@@ -370,7 +497,7 @@ inline static Nearest4 SampleNearest(int u[N], int v[N], const u8 *srcptr, int t
 
 	case GE_TFMT_CLUT4:
 		for (int i = 0; i < N; ++i) {
-			const u8 *src = srcptr + GetPixelDataOffset<4>(texbufw, u[i], v[i]);
+			const u8 *src = srcptr + GetPixelDataOffset<4, swizzled>(texbufw, u[i], v[i]);
 			u8 val = (u[i] & 1) ? (src[0] >> 4) : (src[0] & 0xF);
 			// Only CLUT4 uses separate mipmap palettes.
 			res.v[i] = LookupColor(gstate.transformClutIndex(val), level);
@@ -411,12 +538,14 @@ inline static Nearest4 SampleNearest(int u[N], int v[N], const u8 *srcptr, int t
 	}
 }
 
-static u32 SampleNearest(int u, int v, const u8 *tptr, int bufw, int level) {
-	return SampleNearest<1>(&u, &v, tptr, bufw, level);
+template <int texfmt, bool swizzled>
+static u32 SampleNearestSpecialized(int u, int v, const u8 *tptr, int bufw, int level) {
+	return SampleNearestFormat<1, texfmt, swizzled>(&u, &v, tptr, bufw, level);
 }
 
-static u32 SampleLinear(int u[4], int v[4], int frac_u, int frac_v, const u8 *tptr, int bufw, int texlevel) {
-	Nearest4 c = SampleNearest<4>(u, v, tptr, bufw, texlevel);
+template <int texfmt, bool swizzled>
+static u32 SampleLinearSpecialized(int u[4], int v[4], int frac_u, int frac_v, const u8 *tptr, int bufw, int texlevel) {
+	Nearest4 c = SampleNearestFormat<4, texfmt, swizzled>(u, v, tptr, bufw, texlevel);
 
 	Vec4<int> texcolor_tl = Vec4<int>::FromRGBA(c.v[0]);
 	Vec4<int> texcolor_tr = Vec4<int>::FromRGBA(c.v[1]);
@@ -427,4 +556,33 @@ static u32 SampleLinear(int u[4], int v[4], int frac_u, int frac_v, const u8 *tp
 	return ((t * (0x100 - frac_v) + b * frac_v) / (256 * 256)).ToRGBA();
 }
 
+#define SAMPLER_FUNCS(name, fmt) { &name<fmt, false>, &name<fmt, true> }
+#define SAMPLER_FUNC_TABLE(name) { \
+	SAMPLER_FUNCS(name, GE_TFMT_5650), SAMPLER_FUNCS(name, GE_TFMT_5551), SAMPLER_FUNCS(name, GE_TFMT_4444), \
+	SAMPLER_FUNCS(name, GE_TFMT_8888), SAMPLER_FUNCS(name, GE_TFMT_CLUT4), SAMPLER_FUNCS(name, GE_TFMT_CLUT8), \
+	SAMPLER_FUNCS(name, GE_TFMT_CLUT16), SAMPLER_FUNCS(name, GE_TFMT_CLUT32), SAMPLER_FUNCS(name, GE_TFMT_DXT1), \
+	SAMPLER_FUNCS(name, GE_TFMT_DXT3), SAMPLER_FUNCS(name, GE_TFMT_DXT5), \
+}
+
+// Without a jit, these are the next best thing: the format and swizzle are fixed per function,
+// which saves a switch and a few state reads per texel.  Indexed by [texfmt][swizzle].
+static const NearestFunc nearestFuncs[][2] = SAMPLER_FUNC_TABLE(SampleNearestSpecialized);
+static const LinearFunc linearFuncs[][2] = SAMPLER_FUNC_TABLE(SampleLinearSpecialized);
+
+#undef SAMPLER_FUNC_TABLE
+#undef SAMPLER_FUNCS
+
+static NearestFunc GetSpecializedNearest(const SamplerID &id) {
+	// Unknown formats go through the default case, which reports them.
+	if (id.texfmt >= ARRAY_SIZE(nearestFuncs))
+		return &SampleNearestSpecialized<GE_TFMT_DXT5 + 1, false>;
+	return nearestFuncs[id.texfmt][id.swizzle ? 1 : 0];
+}
+
+static LinearFunc GetSpecializedLinear(const SamplerID &id) {
+	if (id.texfmt >= ARRAY_SIZE(linearFuncs))
+		return &SampleLinearSpecialized<GE_TFMT_DXT5 + 1, false>;
+	return linearFuncs[id.texfmt][id.swizzle ? 1 : 0];
+}
+
 };
@@ -88,6 +88,13 @@ static inline Funcs GetFuncs() {
 	return f;
 }
 
+// Returns the texture level decoded to linear 8888 (to be sampled with GetDecodedFuncs() and
+// a bufw of the texture width), or nullptr if it's not worth decoding.
+const u8 *GetDecodedTexture(int level, u32 texaddr, const u8 *tptr, int bufw, NearestFunc nearest);
+Funcs GetDecodedFuncs();
+void InvalidateDecodedTextures(u32 addr, int size);
+void ClearDecodedTextures();
+
 void Init();
 void Shutdown();
 
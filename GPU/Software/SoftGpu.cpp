@@ -143,6 +143,46 @@ void SoftGPU::SetDisplayFramebuffer(u32 framebuf, u32 stride, GEBufferFormat for
 	host->GPUNotifyDisplay(framebuf, stride, format);
 }
 
+// Hashes each visible row of the display framebuffer and flags the rows that differ from the
+// last upload.  Returns false if nothing changed and the current fbTex can be drawn as is.
+bool SoftGPU::CheckDisplayRowsChanged(int srcwidth, int srcheight) {
+	const int bpp = displayFormat_ == GE_FORMAT_8888 ? 4 : 2;
+	const u32 rowBytes = srcwidth * bpp;
+	const u32 strideBytes = displayStride_ * bpp;
+	if (!Memory::IsValidRange(displayFramebuf_, strideBytes * (srcheight - 1) + rowBytes)) {
+		// Can't safely hash, just treat everything as changed.
+		fbRowHashes_.clear();
+		fbRowChanged_.assign(srcheight, true);
+		return true;
+	}
+
+	bool sameLayout = fbTex != nullptr && fbTexAddr_ == displayFramebuf_ && fbTexStride_ == displayStride_;
+	sameLayout = sameLayout && fbTexFormat_ == displayFormat_ && (int)fbRowHashes_.size() == srcheight;
+	sameLayout = sameLayout && fbTexBuffer.size() == (size_t)(srcwidth * srcheight);
+	// The 8888 path never fills fbTexBuffer, so it must be sized before any partial conversion.
+	if (displayFormat_ == GE_FORMAT_8888)
+		sameLayout = sameLayout && fbTexBuffer.empty();
+
+	fbRowHashes_.resize(srcheight);
+	fbRowChanged_.resize(srcheight);
+	const u8 *src = Memory::GetPointerUnchecked(displayFramebuf_);
+	bool anyChanged = !sameLayout;
+	for (int y = 0; y < srcheight; ++y) {
+		u32 hash = DoQuickTexHash(src + y * strideBytes, rowBytes);
+		bool changed = !sameLayout || fbRowHashes_[y] != hash;
+		fbRowHashes_[y] = hash;
+		fbRowChanged_[y] = changed;
+		anyChanged = anyChanged || changed;
+	}
+
+	fbTexAddr_ = displayFramebuf_;
+	fbTexStride_ = displayStride_;
+	fbTexFormat_ = displayFormat_;
+	if (displayFormat_ == GE_FORMAT_8888)
+		fbTexBuffer.clear();
+	return anyChanged;
+}
+
 // Copies RGBA8 data from RAM to the currently bound render target.
 void SoftGPU::CopyToCurrentFboFromDisplayRam(int srcwidth, int srcheight) {
 	if (!draw_)
@@ -150,11 +190,6 @@ void SoftGPU::CopyToCurrentFboFromDisplayRam(int srcwidth, int srcheight) {
 	float u0 = 0.0f;
 	float u1;
 
-	if (fbTex) {
-		fbTex->Release();
-		fbTex = nullptr;
-	}
-
 	// For accuracy, try to handle 0 stride - sometimes used.
 	if (displayStride_ == 0) {
 		srcheight = 1;
@@ -166,9 +201,20 @@ void SoftGPU::CopyToCurrentFboFromDisplayRam(int srcwidth, int srcheight) {
 	desc.depth = 1;
 	desc.mipLevels = 1;
 	bool hasImage = true;
+	bool displayChanged = true;
 	if (!Memory::IsValidAddress(displayFramebuf_) || srcwidth == 0 || srcheight == 0) {
 		hasImage = false;
 		u1 = 1.0f;
+	} else {
+		displayChanged = CheckDisplayRowsChanged(srcwidth, srcheight);
+	}
+
+	if (!hasImage) {
+		// Nothing to keep, so a later valid framebuffer is uploaded in full.
+		fbRowHashes_.clear();
+	} else if (!displayChanged) {
+		// Nothing in the visible area changed, reuse the last uploaded texture.
+		u1 = displayFormat_ == GE_FORMAT_8888 && displayStride_ != 0 ? (float)srcwidth / displayStride_ : 1.0f;
 	} else if (displayFormat_ == GE_FORMAT_8888) {
 		u8 *data = Memory::GetPointer(displayFramebuf_);
 		desc.width = displayStride_ == 0 ? srcwidth : displayStride_;
@@ -186,6 +232,9 @@ void SoftGPU::CopyToCurrentFboFromDisplayRam(int srcwidth, int srcheight) {
 		FormatBuffer displayBuffer;
 		displayBuffer.data = Memory::GetPointer(displayFramebuf_);
 		for (int y = 0; y < srcheight; ++y) {
+			// Rows that hashed the same last frame are already converted.
+			if (!fbRowChanged_[y])
+				continue;
 			u32 *buf_line = &fbTexBuffer[y * srcwidth];
 			const u16 *fb_line = &displayBuffer.as16[y * displayStride_];
 
@@ -217,7 +266,11 @@ void SoftGPU::CopyToCurrentFboFromDisplayRam(int srcwidth, int srcheight) {
 		return;
 	}
 
-	fbTex = draw_->CreateTexture(desc);
+	if (displayChanged || !fbTex) {
+		if (fbTex)
+			fbTex->Release();
+		fbTex = draw_->CreateTexture(desc);
+	}
 
 	float dstwidth = (float)PSP_CoreParameter().pixelWidth;
 	float dstheight = (float)PSP_CoreParameter().pixelHeight;
@@ -291,6 +344,7 @@ void SoftGPU::CopyToCurrentFboFromDisplayRam(int srcwidth, int srcheight) {
 }
 
 void SoftGPU::CopyDisplayToOutput() {
+	Rasterizer::Flush();
 	// The display always shows 480x272.
 	CopyToCurrentFboFromDisplayRam(FB_WIDTH, FB_HEIGHT);
 	framebufferDirty_ = false;
@@ -312,6 +366,7 @@ void SoftGPU::FastRunLoop(DisplayList &list) {
 		u32 cmd = op >> 24;
 
 		u32 diff = op ^ gstate.cmdmem[cmd];
+		PreExecuteOp(op, diff);
 		gstate.cmdmem[cmd] = op;
 		ExecuteOp(op, diff);
 
@@ -319,6 +374,68 @@ void SoftGPU::FastRunLoop(DisplayList &list) {
 	}
 }
 
+// Queued triangles read gstate, the framebuffers and textures when they're rasterized, so they
+// have to be drawn before any of that changes.  Commands that only affect vertex transform
+// (or don't touch state at all) can keep batching.
+void SoftGPU::PreExecuteOp(u32 op, u32 diff) {
+	u32 cmd = op >> 24;
+	switch (cmd) {
+	case GE_CMD_NOP:
+	case GE_CMD_BASE:
+	case GE_CMD_VADDR:
+	case GE_CMD_IADDR:
+	case GE_CMD_PRIM:
+	case GE_CMD_BEZIER:
+	case GE_CMD_SPLINE:
+	case GE_CMD_BOUNDINGBOX:
+	case GE_CMD_JUMP:
+	case GE_CMD_BJUMP:
+	case GE_CMD_CALL:
+	case GE_CMD_RET:
+	case GE_CMD_ORIGIN:
+	case GE_CMD_OFFSETADDR:
+	case GE_CMD_VERTEXTYPE:
+	case GE_CMD_MORPHWEIGHT0:
+	case GE_CMD_MORPHWEIGHT1:
+	case GE_CMD_MORPHWEIGHT2:
+	case GE_CMD_MORPHWEIGHT3:
+	case GE_CMD_MORPHWEIGHT4:
+	case GE_CMD_MORPHWEIGHT5:
+	case GE_CMD_MORPHWEIGHT6:
+	case GE_CMD_MORPHWEIGHT7:
+	case GE_CMD_PATCHDIVISION:
+	case GE_CMD_PATCHPRIMITIVE:
+	case GE_CMD_PATCHFACING:
+	case GE_CMD_WORLDMATRIXNUMBER:
+	case GE_CMD_WORLDMATRIXDATA:
+	case GE_CMD_VIEWMATRIXNUMBER:
+	case GE_CMD_VIEWMATRIXDATA:
+	case GE_CMD_PROJMATRIXNUMBER:
+	case GE_CMD_PROJMATRIXDATA:
+	case GE_CMD_TGENMATRIXNUMBER:
+	case GE_CMD_BONEMATRIXNUMBER:
+	case GE_CMD_BONEMATRIXDATA:
+		break;
+
+	// These change memory or state even when the value is the same.
+	case GE_CMD_TGENMATRIXDATA:
+	case GE_CMD_LOADCLUT:
+	case GE_CMD_TRANSFERSTART:
+		Rasterizer::Flush();
+		break;
+
+	default:
+		if (diff)
+			Rasterizer::Flush();
+		break;
+	}
+}
+
+void SoftGPU::FinishDeferred() {
+	// The CPU may look at anything we've drawn once the list returns.
+	Rasterizer::Flush();
+}
+
 void SoftGPU::ExecuteOp(u32 op, u32 diff) {
 	u32 cmd = op >> 24;
 	u32 data = op & 0xFFFFFF;
@@ -638,6 +755,7 @@ void SoftGPU::ExecuteOp(u32 op, u32 diff) {
 				u8 *dst = Memory::GetPointer(dstBasePtr + ((y + dstY) * dstStride + dstX) * bpp);
 				memcpy(dst, src, width * bpp);
 			}
+			Sampler::InvalidateDecodedTextures(dstBasePtr + (dstY * dstStride + dstX) * bpp, height * dstStride * bpp);
 
 #ifndef MOBILE_DEVICE
 			CBreakPoints::ExecMemCheck(srcBasePtr + (srcY * srcStride + srcX) * bpp, false, height * srcStride * bpp, currentMIPS->pc);
@@ -861,12 +979,17 @@ void SoftGPU::ExecuteOp(u32 op, u32 diff) {
 }
 
 void SoftGPU::GetStats(char *buffer, size_t bufsize) {
-	snprintf(buffer, bufsize, "SoftGPU: (N/A)");
+	snprintf(buffer, bufsize, "SoftGPU\nEarly depth rejected pixels: %d\n", Rasterizer::GetAndResetEarlyDepthRejected());
 }
 
 void SoftGPU::InvalidateCache(u32 addr, int size, GPUInvalidationType type)
 {
-	// Nothing to invalidate.
+	// Queued triangles may read or write this memory.
+	Rasterizer::Flush();
+	if (size > 0 && type != GPU_INVALIDATE_ALL)
+		Sampler::InvalidateDecodedTextures(addr, size);
+	else
+		Sampler::ClearDecodedTextures();
 }
 
 void SoftGPU::NotifyVideoUpload(u32 addr, int size, int width, int format)
@@ -924,6 +1047,7 @@ bool SoftGPU::FramebufferDirty() {
 }
 
 bool SoftGPU::GetCurrentFramebuffer(GPUDebugBuffer &buffer, GPUDebugFramebufferType type, int maxRes) {
+	Rasterizer::Flush();
 	int x1 = gstate.getRegionX1();
 	int y1 = gstate.getRegionY1();
 	int x2 = gstate.getRegionX2() + 1;
@@ -960,6 +1084,7 @@ bool SoftGPU::GetOutputFramebuffer(GPUDebugBuffer &buffer) {
 
 bool SoftGPU::GetCurrentDepthbuffer(GPUDebugBuffer &buffer)
 {
+	Rasterizer::Flush();
 	const int w = gstate.getRegionX2() - gstate.getRegionX1() + 1;
 	const int h = gstate.getRegionY2() - gstate.getRegionY1() + 1;
 	buffer.Allocate(w, h, GPU_DBG_FORMAT_16BIT);
@@ -977,6 +1102,7 @@ bool SoftGPU::GetCurrentDepthbuffer(GPUDebugBuffer &buffer)
 
 bool SoftGPU::GetCurrentStencilbuffer(GPUDebugBuffer &buffer)
 {
+	Rasterizer::Flush();
 	return Rasterizer::GetCurrentStencilbuffer(buffer);
 }
 
@@ -55,6 +55,7 @@ class SoftGPU : public GPUCommon {
 
 	void CheckGPUFeatures() override {}
 	void InitClear() override {}
+	void PreExecuteOp(u32 op, u32 diff) override;
 	void ExecuteOp(u32 op, u32 diff) override;
 
 	void SetDisplayFramebuffer(u32 framebuf, u32 stride, GEBufferFormat format) override;
@@ -96,7 +97,9 @@ class SoftGPU : public GPUCommon {
 
 protected:
 	void FastRunLoop(DisplayList &list) override;
+	void FinishDeferred() override;
 	void CopyToCurrentFboFromDisplayRam(int srcwidth, int srcheight);
+	bool CheckDisplayRowsChanged(int srcwidth, int srcheight);
 
 private:
 	bool framebufferDirty_;
@@ -109,6 +112,12 @@ class SoftGPU : public GPUCommon {
 	Draw::Texture *fbTex;
 	Draw::Pipeline *texColor;
 	std::vector<u32> fbTexBuffer;
+	// What fbTex currently holds, so unchanged frames and rows can skip conversion and upload.
+	std::vector<u32> fbRowHashes_;
+	std::vector<bool> fbRowChanged_;
+	u32 fbTexAddr_ = 0;
+	u32 fbTexStride_ = 0;
+	GEBufferFormat fbTexFormat_ = GE_FORMAT_INVALID;
 
 	Draw::SamplerState *samplerNearest = nullptr;
 	Draw::SamplerState *samplerLinear = nullptr;
@@ -272,8 +272,34 @@ void TransformUnit::SubmitPrimitive(void* vertices, void* indices, GEPrimitiveTy
 	default: vtcs_per_prim = 0; break;
 	}
 
-	// TODO: Do this in two passes - first process the vertices (before indexing/stripping),
-	// then resolve the indices. This lets us avoid transforming shared vertices twice.
+	// Indexed draws usually share vertices between prims, so when there are fewer unique
+	// vertices than indices, transform (and light) each of them just once up front.
+	const int unique_count = index_upper_bound - index_lower_bound + 1;
+	const bool pretransform = indices && unique_count <= vertex_count;
+	if (pretransform) {
+		// This may still be set from an incomplete prim in the previous call.
+		const bool prev_outside = outside_range_flag;
+		transformed_.resize(unique_count);
+		transformedOutside_.resize(unique_count);
+		for (int i = 0; i < unique_count; ++i) {
+			outside_range_flag = false;
+			vreader.Goto(i);
+			transformed_[i] = ReadVertex(vreader);
+			transformedOutside_[i] = outside_range_flag;
+		}
+		outside_range_flag = prev_outside;
+	}
+
+	auto readVertex = [&](int vtx) -> VertexData {
+		if (pretransform) {
+			const int i = idxConv.convert(vtx) - index_lower_bound;
+			if (transformedOutside_[i])
+				outside_range_flag = true;
+			return transformed_[i];
+		}
+		vreader.Goto(indices ? idxConv.convert(vtx) - index_lower_bound : vtx);
+		return ReadVertex(vreader);
+	};
 
 	switch (prim_type) {
 	case GE_PRIM_POINTS:
@@ -282,13 +308,7 @@ void TransformUnit::SubmitPrimitive(void* vertices, void* indices, GEPrimitiveTy
 	case GE_PRIM_RECTANGLES:
 		{
 			for (int vtx = 0; vtx < vertex_count; ++vtx) {
-				if (indices) {
-					vreader.Goto(idxConv.convert(vtx) - index_lower_bound);
-				} else {
-					vreader.Goto(vtx);
-				}
-
-				data[data_index++] = ReadVertex(vreader);
+				data[data_index++] = readVertex(vtx);
 				if (data_index < vtcs_per_prim) {
 					// Keep reading.  Note: an incomplete prim will stay read for GE_PRIM_KEEP_PREVIOUS.
 					continue;
@@ -341,13 +361,7 @@ void TransformUnit::SubmitPrimitive(void* vertices, void* indices, GEPrimitiveTy
 			// If data_index is 1 or 2, etc., it means we're continuing a line strip.
 			int skip_count = data_index == 0 ? 1 : 0;
 			for (int vtx = 0; vtx < vertex_count; ++vtx) {
-				if (indices) {
-					vreader.Goto(idxConv.convert(vtx) - index_lower_bound);
-				} else {
-					vreader.Goto(vtx);
-				}
-
-				data[(data_index++) & 1] = ReadVertex(vreader);
+				data[(data_index++) & 1] = readVertex(vtx);
 				if (outside_range_flag) {
 					// Drop all primitives containing the current vertex
 					skip_count = 2;
@@ -371,13 +385,7 @@ void TransformUnit::SubmitPrimitive(void* vertices, void* indices, GEPrimitiveTy
 			int skip_count = data_index >= 2 ? 0 : 2 - data_index;
 
 			for (int vtx = 0; vtx < vertex_count; ++vtx) {
-				if (indices) {
-					vreader.Goto(idxConv.convert(vtx) - index_lower_bound);
-				} else {
-					vreader.Goto(vtx);
-				}
-
-				data[(data_index++) % 3] = ReadVertex(vreader);
+				data[(data_index++) % 3] = readVertex(vtx);
 				if (outside_range_flag) {
 					// Drop all primitives containing the current vertex
 					skip_count = 2;
@@ -413,24 +421,13 @@ void TransformUnit::SubmitPrimitive(void* vertices, void* indices, GEPrimitiveTy
 
 			// Only read the central vertex if we're not continuing.
 			if (data_index == 0) {
-				if (indices) {
-					vreader.Goto(idxConv.convert(0) - index_lower_bound);
-				} else {
-					vreader.Goto(0);
-				}
-				data[0] = ReadVertex(vreader);
+				data[0] = readVertex(0);
 				data_index++;
 				start_vtx = 1;
 			}
 
 			for (int vtx = start_vtx; vtx < vertex_count; ++vtx) {
-				if (indices) {
-					vreader.Goto(idxConv.convert(vtx) - index_lower_bound);
-				} else {
-					vreader.Goto(vtx);
-				}
-
-				data[2 - ((data_index++) % 2)] = ReadVertex(vreader);
+				data[2 - ((data_index++) % 2)] = readVertex(vtx);
 				if (outside_range_flag) {
 					// Drop all primitives containing the current vertex
 					skip_count = 2;
@@ -462,6 +459,9 @@ void TransformUnit::SubmitPrimitive(void* vertices, void* indices, GEPrimitiveTy
 		break;
 	}
 
+	// Clipping depends on gstate, so don't let the batch outlive this draw.
+	Clipper::FlushTriangles();
+
 	host->GPUNotifyDraw();
 }
 
@@ -17,6 +17,8 @@
 
 #pragma once
 
+#include <vector>
+
 #include "CommonTypes.h"
 #include "GPU/Common/DrawEngineCommon.h"
 #include "GPU/Common/GPUDebugInterface.h"
@@ -136,6 +138,11 @@ class TransformUnit {
 
 	bool outside_range_flag = false;
 	u8 *buf;
+
+private:
+	// Pretransformed vertices for indexed draws, by index - index_lower_bound.
+	std::vector<VertexData> transformed_;
+	std::vector<bool> transformedOutside_;
 };
 
 class SoftwareDrawEngine : public DrawEngineCommon {
@@ -172,6 +172,7 @@ void DrawEngineVulkan::FrameData::Destroy(VulkanContext *vulkan) {
 	if (descPool != VK_NULL_HANDLE) {
 		vulkan->Delete().QueueDeleteDescriptorPool(descPool);
 	}
+	lastDescSet = VK_NULL_HANDLE;
 
 	if (pushUBO) {
 		pushUBO->Destroy(vulkan);
@@ -291,6 +292,7 @@ void DrawEngineVulkan::BeginFrame() {
 		if (frame->descPool != VK_NULL_HANDLE)
 			vkResetDescriptorPool(vulkan_->GetDevice(), frame->descPool, 0);
 		frame->descSets.Clear();
+		frame->lastDescSet = VK_NULL_HANDLE;
 		frame->descCount = 0;
 		descDecimationCounter_ = DESCRIPTORSET_DECIMATION_INTERVAL;
 	}
@@ -352,6 +354,7 @@ VkResult DrawEngineVulkan::RecreateDescriptorPool(FrameData &frame, int newSize)
 		DEBUG_LOG(G3D, "Reallocating desc pool from %d to %d", frame.descPoolSize, newSize);
 		vulkan_->Delete().QueueDeleteDescriptorPool(frame.descPool);
 		frame.descSets.Clear();
+		frame.lastDescSet = VK_NULL_HANDLE;
 		frame.descCount = 0;
 	}
 	frame.descPoolSize = newSize;
@@ -388,9 +391,14 @@ VkDescriptorSet DrawEngineVulkan::GetOrCreateDescriptorSet(VkImageView imageView
 	FrameData &frame = frame_[vulkan_->GetCurFrame()];
 	// See if we already have this descriptor set cached.
 	if (!tess) { // Don't cache descriptors for HW tessellation.
+		if (frame.lastDescSet != VK_NULL_HANDLE && !memcmp(&key, &frame.lastDescSetKey, sizeof(key)))
+			return frame.lastDescSet;
 		VkDescriptorSet d = frame.descSets.Get(key);
-		if (d != VK_NULL_HANDLE)
+		if (d != VK_NULL_HANDLE) {
+			frame.lastDescSetKey = key;
+			frame.lastDescSet = d;
 			return d;
+		}
 	}
 
 	if (!frame.descPool || frame.descPoolSize < frame.descCount + 1) {
@@ -515,8 +523,11 @@ VkDescriptorSet DrawEngineVulkan::GetOrCreateDescriptorSet(VkImageView imageView
 
 	vkUpdateDescriptorSets(vulkan_->GetDevice(), n, writes, 0, nullptr);
 
-	if (!tess) // Again, avoid caching when HW tessellation.
+	if (!tess) { // Again, avoid caching when HW tessellation.
 		frame.descSets.Insert(key, desc);
+		frame.lastDescSetKey = key;
+		frame.lastDescSet = desc;
+	}
 	frame.descCount++;
 	return desc;
 }
@@ -602,11 +613,7 @@ void DrawEngineVulkan::DoFlush() {
 			case VertexArrayInfoVulkan::VAI_NEW:
 			{
 				// Haven't seen this one before. We don't actually upload the vertex data yet.
-				ReliableHashType dataHash = ComputeHash();
-				vai->hash = dataHash;
-				vai->minihash = ComputeMiniHash();
-				vai->status = VertexArrayInfoVulkan::VAI_HASHING;
-				vai->drawsUntilNextFullHash = 0;
+				SetupNewVertexArray(vai);
 				DecodeVertsToPushBuffer(frame->pushVertex, &vbOffset, &vbuf);  // writes to indexGen
 				vai->numVerts = indexGen.VertexCount();
 				vai->prim = indexGen.Prim();
@@ -620,46 +627,16 @@ void DrawEngineVulkan::DoFlush() {
 			case VertexArrayInfoVulkan::VAI_HASHING:
 			{
 				PROFILE_THIS_SCOPE("vcachehash");
-				vai->numDraws++;
-				if (vai->lastFrame != gpuStats.numFlips) {
-					vai->numFrames++;
-				}
-				if (vai->drawsUntilNextFullHash == 0) {
-					// Let's try to skip a full hash if mini would fail.
-					const u32 newMiniHash = ComputeMiniHash();
-					ReliableHashType newHash = vai->hash;
-					if (newMiniHash == vai->minihash) {
-						newHash = ComputeHash();
-					}
-					if (newMiniHash != vai->minihash || newHash != vai->hash) {
-						MarkUnreliable(vai);
-						DecodeVertsToPushBuffer(frame->pushVertex, &vbOffset, &vbuf);
-						goto rotateVBO;
-					}
-					if (vai->numVerts > 64) {
-						// exponential backoff up to 16 draws, then every 24
-						vai->drawsUntilNextFullHash = std::min(24, vai->numFrames);
-					} else {
-						// Lower numbers seem much more likely to change.
-						vai->drawsUntilNextFullHash = 0;
-					}
-					// TODO: tweak
-					//if (vai->numFrames > 1000) {
-					//	vai->status = VertexArrayInfo::VAI_RELIABLE;
-					//}
-				} else {
-					vai->drawsUntilNextFullHash--;
-					u32 newMiniHash = ComputeMiniHash();
-					if (newMiniHash != vai->minihash) {
-						MarkUnreliable(vai);
-						DecodeVertsToPushBuffer(frame->pushVertex, &vbOffset, &vbuf);
-						goto rotateVBO;
-					}
+				if (!CheckVertexArray(vai, 24)) {
+					MarkUnreliable(vai);
+					DecodeVertsToPushBuffer(frame->pushVertex, &vbOffset, &vbuf);
+					goto rotateVBO;
 				}
 
 				if (!vai->vb) {
 					// Directly push to the vertex cache.
 					DecodeVertsToPushBuffer(vertexCache_, &vai->vbOffset, &vai->vb);
+					gpuStats.numVertexCacheUploadBytes += dec_->GetDecVtxFmt().stride * indexGen.MaxIndex();
 					_dbg_assert_msg_(G3D, gstate_c.vertBounds.minV >= gstate_c.vertBounds.maxV, "Should not have checked UVs when caching.");
 					vai->numVerts = indexGen.VertexCount();
 					vai->prim = indexGen.Prim();
@@ -673,6 +650,7 @@ void DrawEngineVulkan::DoFlush() {
 						u32 size = sizeof(uint16_t) * indexGen.VertexCount();
 						void *dest = vertexCache_->Push(size, &vai->ibOffset, &vai->ib);
 						memcpy(dest, decIndex, size);
+						gpuStats.numVertexCacheUploadBytes += size;
 					} else {
 						vai->ib = VK_NULL_HANDLE;
 						vai->ibOffset = 0;
@@ -720,6 +698,7 @@ void DrawEngineVulkan::DoFlush() {
 				if (vai->lastFrame != gpuStats.numFlips) {
 					vai->numFrames++;
 				}
+				gpuStats.numVertexCacheMisses++;
 				DecodeVertsToPushBuffer(frame->pushVertex, &vbOffset, &vbuf);
 				goto rotateVBO;
 			}
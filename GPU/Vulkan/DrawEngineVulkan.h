@@ -76,42 +76,16 @@ enum {
 };
 
 // Try to keep this POD.
-class VertexArrayInfoVulkan {
+class VertexArrayInfoVulkan : public VertexArrayInfoCommon {
 public:
-	VertexArrayInfoVulkan() {
-		lastFrame = gpuStats.numFlips;
-	}
 	// No destructor needed - we always fully wipe.
 
-	enum VAIStatus : uint8_t {
-		VAI_NEW,
-		VAI_HASHING,
-		VAI_RELIABLE,  // cache, don't hash
-		VAI_UNRELIABLE,  // never cache
-	};
-
-	ReliableHashType hash;
-	u32 minihash;
-
 	// These will probably always be the same, but whatever.
 	VkBuffer vb = VK_NULL_HANDLE;
 	VkBuffer ib = VK_NULL_HANDLE;
 	// Offsets into the cache buffer.
 	uint32_t vbOffset = 0;
 	uint32_t ibOffset = 0;
-
-	// Precalculated parameter for vkDrawIndexed
-	u16 numVerts = 0;
-	u16 maxIndex = 0;
-	s8 prim = GE_PRIM_INVALID;
-	VAIStatus status = VAI_NEW;
-
-	// ID information
-	int numDraws = 0;
-	int numFrames = 0;
-	int lastFrame;  // So that we can forget.
-	u16 drawsUntilNextFullHash = 0;
-	u8 flags = 0;
 };
 
 class VulkanRenderManager;
@@ -236,6 +210,10 @@ class DrawEngineVulkan : public DrawEngineCommon {
 		VulkanPushBuffer *pushIndex = nullptr;
 		// We do rolling allocation and reset instead of caching across frames. That we might do later.
 		DenseHashMap<DescriptorSetKey, VkDescriptorSet, (VkDescriptorSet)VK_NULL_HANDLE> descSets;
+		// Consecutive draws very often use the same textures and buffers, so check this before the hash lookup.
+		// Must be reset whenever descSets is cleared.
+		DescriptorSetKey lastDescSetKey{};
+		VkDescriptorSet lastDescSet = VK_NULL_HANDLE;
 
 		void Destroy(VulkanContext *vulkan);
 	};
@@ -40,6 +40,24 @@ static const char *vulkan_glsl_preamble =
 
 #define WRITE p+=sprintf
 
+FShaderID FragmentShaderShapeID(const FShaderID &id) {
+	FShaderID shape = id;
+	shape.ClearBits(FS_BIT_TEXFUNC, 3);
+	shape.ClearBits(FS_BIT_ALPHA_TEST_FUNC, 3);
+	shape.ClearBits(FS_BIT_COLOR_TEST_FUNC, 2);
+	return shape;
+}
+
+uint32_t FragmentShaderSpecKey(const FShaderID &id) {
+	return id.Bits(FS_BIT_TEXFUNC, 3) | (id.Bits(FS_BIT_ALPHA_TEST_FUNC, 3) << 3) | (id.Bits(FS_BIT_COLOR_TEST_FUNC, 2) << 6);
+}
+
+void FragmentShaderSpecValues(uint32_t specKey, int32_t values[FS_SPEC_COUNT]) {
+	values[FS_SPEC_TEXFUNC] = specKey & 7;
+	values[FS_SPEC_ALPHA_TEST_FUNC] = (specKey >> 3) & 7;
+	values[FS_SPEC_COLOR_TEST_FUNC] = (specKey >> 6) & 3;
+}
+
 // Missing: Z depth range
 bool GenerateVulkanGLSLFragmentShader(const FShaderID &id, char *buffer) {
 	char *p = buffer;
@@ -61,11 +79,8 @@ bool GenerateVulkanGLSLFragmentShader(const FShaderID &id, char *buffer) {
 	bool doTextureAlpha = id.Bit(FS_BIT_TEXALPHA);
 	bool doFlatShading = id.Bit(FS_BIT_FLATSHADE);
 
-	GEComparison alphaTestFunc = (GEComparison)id.Bits(FS_BIT_ALPHA_TEST_FUNC, 3);
-	GEComparison colorTestFunc = (GEComparison)id.Bits(FS_BIT_COLOR_TEST_FUNC, 2);
 	bool needShaderTexClamp = id.Bit(FS_BIT_SHADER_TEX_CLAMP);
 
-	GETexFunc texFunc = (GETexFunc)id.Bits(FS_BIT_TEXFUNC, 3);
 	bool textureAtOffset = id.Bit(FS_BIT_TEXTURE_AT_OFFSET);
 
 	ReplaceBlendType replaceBlend = static_cast<ReplaceBlendType>(id.Bits(FS_BIT_REPLACE_BLEND, 3));
@@ -80,6 +95,9 @@ bool GenerateVulkanGLSLFragmentShader(const FShaderID &id, char *buffer) {
 
 	const char *shading = doFlatShading ? "flat" : "";
 
+	WRITE(p, "layout (constant_id = %d) const int TEXFUNC = 0;\n", FS_SPEC_TEXFUNC);
+	WRITE(p, "layout (constant_id = %d) const int ALPHA_TEST_FUNC = 0;\n", FS_SPEC_ALPHA_TEST_FUNC);
+	WRITE(p, "layout (constant_id = %d) const int COLOR_TEST_FUNC = 0;\n", FS_SPEC_COLOR_TEST_FUNC);
 	WRITE(p, "layout (std140, set = 0, binding = 2) uniform baseUBO {\n%s} base;\n", ub_baseStr);
 	if (doTexture) {
 		WRITE(p, "layout (binding = 0) uniform sampler2D tex;\n");
@@ -177,60 +195,24 @@ bool GenerateVulkanGLSLFragmentShader(const FShaderID &id, char *buffer) {
 			}
 			WRITE(p, "  vec4 p = v_color0;\n");
 
+			// Switches on a specialization constant are resolved when the pipeline is created.
+			WRITE(p, "  vec4 v;\n");
+			WRITE(p, "  switch (TEXFUNC) {\n");
 			if (doTextureAlpha) { // texfmt == RGBA
-				switch (texFunc) {
-				case GE_TEXFUNC_MODULATE:
-					WRITE(p, "  vec4 v = p * t%s;\n", secondary);
-					break;
-
-				case GE_TEXFUNC_DECAL:
-					WRITE(p, "  vec4 v = vec4(mix(p.rgb, t.rgb, t.a), p.a)%s;\n", secondary);
-					break;
-
-				case GE_TEXFUNC_BLEND:
-					WRITE(p, "  vec4 v = vec4(mix(p.rgb, base.texenv.rgb, t.rgb), p.a * t.a)%s;\n", secondary);
-					break;
-
-				case GE_TEXFUNC_REPLACE:
-					WRITE(p, "  vec4 v = t%s;\n", secondary);
-					break;
-
-				case GE_TEXFUNC_ADD:
-				case GE_TEXFUNC_UNKNOWN1:
-				case GE_TEXFUNC_UNKNOWN2:
-				case GE_TEXFUNC_UNKNOWN3:
-					WRITE(p, "  vec4 v = vec4(p.rgb + t.rgb, p.a * t.a)%s;\n", secondary);
-					break;
-				default:
-					WRITE(p, "  vec4 v = p;\n"); break;
-				}
+				WRITE(p, "  case %d: v = p * t%s; break;\n", GE_TEXFUNC_MODULATE, secondary);
+				WRITE(p, "  case %d: v = vec4(mix(p.rgb, t.rgb, t.a), p.a)%s; break;\n", GE_TEXFUNC_DECAL, secondary);
+				WRITE(p, "  case %d: v = vec4(mix(p.rgb, base.texenv.rgb, t.rgb), p.a * t.a)%s; break;\n", GE_TEXFUNC_BLEND, secondary);
+				WRITE(p, "  case %d: v = t%s; break;\n", GE_TEXFUNC_REPLACE, secondary);
+				// ADD and the unknown ones.
+				WRITE(p, "  default: v = vec4(p.rgb + t.rgb, p.a * t.a)%s; break;\n", secondary);
 			} else { // texfmt == RGB
-				switch (texFunc) {
-				case GE_TEXFUNC_MODULATE:
-					WRITE(p, "  vec4 v = vec4(t.rgb * p.rgb, p.a)%s;\n", secondary);
-					break;
-
-				case GE_TEXFUNC_DECAL:
-					WRITE(p, "  vec4 v = vec4(t.rgb, p.a)%s;\n", secondary);
-					break;
-
-				case GE_TEXFUNC_BLEND:
-					WRITE(p, "  vec4 v = vec4(mix(p.rgb, base.texenv.rgb, t.rgb), p.a)%s;\n", secondary);
-					break;
-
-				case GE_TEXFUNC_REPLACE:
-					WRITE(p, "  vec4 v = vec4(t.rgb, p.a)%s;\n", secondary);
-					break;
-
-				case GE_TEXFUNC_ADD:
-				case GE_TEXFUNC_UNKNOWN1:
-				case GE_TEXFUNC_UNKNOWN2:
-				case GE_TEXFUNC_UNKNOWN3:
-					WRITE(p, "  vec4 v = vec4(p.rgb + t.rgb, p.a)%s;\n", secondary); break;
-				default:
-					WRITE(p, "  vec4 v = p;\n"); break;
-				}
+				WRITE(p, "  case %d: v = vec4(t.rgb * p.rgb, p.a)%s; break;\n", GE_TEXFUNC_MODULATE, secondary);
+				WRITE(p, "  case %d: v = vec4(t.rgb, p.a)%s; break;\n", GE_TEXFUNC_DECAL, secondary);
+				WRITE(p, "  case %d: v = vec4(mix(p.rgb, base.texenv.rgb, t.rgb), p.a)%s; break;\n", GE_TEXFUNC_BLEND, secondary);
+				WRITE(p, "  case %d: v = vec4(t.rgb, p.a)%s; break;\n", GE_TEXFUNC_REPLACE, secondary);
+				WRITE(p, "  default: v = vec4(p.rgb + t.rgb, p.a)%s; break;\n", secondary);
 			}
+			WRITE(p, "  }\n");
 		} else {
 			// No texture mapping
 			WRITE(p, "  vec4 v = v_color0 %s;\n", secondary);
@@ -244,24 +226,26 @@ bool GenerateVulkanGLSLFragmentShader(const FShaderID &id, char *buffer) {
 			if (alphaTestAgainstZero) {
 				// When testing against 0 (extremely common), we can avoid some math.
 				// 0.002 is approximately half of 1.0 / 255.0.
-				if (alphaTestFunc == GE_COMP_NOTEQUAL || alphaTestFunc == GE_COMP_GREATER) {
-					WRITE(p, "  if (v.a < 0.002) discard;\n");
-				} else if (alphaTestFunc != GE_COMP_NEVER) {
-					// Anything else is a test for == 0.  Happens sometimes, actually...
-					WRITE(p, "  if (v.a > 0.002) discard;\n");
-				} else {
-					// NEVER has been logged as used by games, although it makes little sense - statically failing.
-					// Maybe we could discard the drawcall, but it's pretty rare.  Let's just statically discard here.
-					WRITE(p, "  discard;\n");
-				}
+				WRITE(p, "  if (ALPHA_TEST_FUNC == %d || ALPHA_TEST_FUNC == %d) {\n", GE_COMP_NOTEQUAL, GE_COMP_GREATER);
+				WRITE(p, "    if (v.a < 0.002) discard;\n");
+				// Anything else is a test for == 0.  Happens sometimes, actually...
+				WRITE(p, "  } else if (ALPHA_TEST_FUNC != %d) {\n", GE_COMP_NEVER);
+				WRITE(p, "    if (v.a > 0.002) discard;\n");
+				WRITE(p, "  } else {\n");
+				// NEVER has been logged as used by games, although it makes little sense - statically failing.
+				// Maybe we could discard the drawcall, but it's pretty rare.  Let's just statically discard here.
+				WRITE(p, "    discard;\n");
+				WRITE(p, "  }\n");
 			} else {
 				const char *alphaTestFuncs[] = { "#", "#", " != ", " == ", " >= ", " > ", " <= ", " < " };
-				if (alphaTestFuncs[alphaTestFunc][0] != '#') {
-					WRITE(p, "  if ((roundAndScaleTo255i(v.a) & base.alphacolormask.a) %s base.alphacolorref.a) discard;\n", alphaTestFuncs[alphaTestFunc]);
-				} else {
-					// This means NEVER.  See above.
-					WRITE(p, "  discard;\n");
+				WRITE(p, "  int atest = roundAndScaleTo255i(v.a) & base.alphacolormask.a;\n");
+				WRITE(p, "  switch (ALPHA_TEST_FUNC) {\n");
+				for (int i = GE_COMP_EQUAL; i <= GE_COMP_GEQUAL; ++i) {
+					WRITE(p, "  case %d: if (atest %s base.alphacolorref.a) discard; break;\n", i, alphaTestFuncs[i]);
 				}
+				// This means NEVER.  See above.
+				WRITE(p, "  default: discard; break;\n");
+				WRITE(p, "  }\n");
 			}
 		}
 
@@ -270,24 +254,23 @@ bool GenerateVulkanGLSLFragmentShader(const FShaderID &id, char *buffer) {
 				// When testing against 0 (common), we can avoid some math.
 				// Have my doubts that this special case is actually worth it, but whatever.
 				// 0.002 is approximately half of 1.0 / 255.0.
-				if (colorTestFunc == GE_COMP_NOTEQUAL) {
-					WRITE(p, "  if (v.r + v.g + v.b < 0.002) discard;\n");
-				} else if (colorTestFunc != GE_COMP_NEVER) {
-					// Anything else is a test for == 0.
-					WRITE(p, "  if (v.r + v.g + v.b > 0.002) discard;\n");
-				} else {
-					// NEVER has been logged as used by games, although it makes little sense - statically failing.
-					// Maybe we could discard the drawcall, but it's pretty rare.  Let's just statically discard here.
-					WRITE(p, "  discard;\n");
-				}
+				WRITE(p, "  if (COLOR_TEST_FUNC == %d) {\n", GE_COMP_NOTEQUAL);
+				WRITE(p, "    if (v.r + v.g + v.b < 0.002) discard;\n");
+				// Anything else is a test for == 0.
+				WRITE(p, "  } else if (COLOR_TEST_FUNC != %d) {\n", GE_COMP_NEVER);
+				WRITE(p, "    if (v.r + v.g + v.b > 0.002) discard;\n");
+				WRITE(p, "  } else {\n");
+				// NEVER has been logged as used by games, although it makes little sense - statically failing.
+				WRITE(p, "    discard;\n");
+				WRITE(p, "  }\n");
 			} else {
-				const char *colorTestFuncs[] = { "#", "#", " != ", " == " };
-				if (colorTestFuncs[colorTestFunc][0] != '#') {
-					WRITE(p, "  ivec3 v_scaled = roundAndScaleTo255iv(v.rgb);\n");
-					WRITE(p, "  if ((v_scaled & base.alphacolormask.rgb) %s (base.alphacolorref.rgb & base.alphacolormask.rgb)) discard;\n", colorTestFuncs[colorTestFunc]);
-				} else {
-					WRITE(p, "  discard;\n");
-				}
+				WRITE(p, "  ivec3 v_scaled = roundAndScaleTo255iv(v.rgb) & base.alphacolormask.rgb;\n");
+				WRITE(p, "  ivec3 v_ref = base.alphacolorref.rgb & base.alphacolormask.rgb;\n");
+				WRITE(p, "  switch (COLOR_TEST_FUNC) {\n");
+				WRITE(p, "  case %d: if (v_scaled != v_ref) discard; break;\n", GE_COMP_EQUAL);
+				WRITE(p, "  case %d: if (v_scaled == v_ref) discard; break;\n", GE_COMP_NOTEQUAL);
+				WRITE(p, "  default: discard; break;\n");
+				WRITE(p, "  }\n");
 			}
 		}
 
@@ -18,6 +18,23 @@
 
 #pragma once
 
+#include <cstdint>
+
 struct FShaderID;
 
+// These parts of the ID are specialization constants instead of being generated into the code,
+// so all the IDs that only differ in them share one module (one "shape".)
+enum FragmentShaderSpecConstant {
+	FS_SPEC_TEXFUNC = 0,
+	FS_SPEC_ALPHA_TEST_FUNC = 1,
+	FS_SPEC_COLOR_TEST_FUNC = 2,
+	FS_SPEC_COUNT,
+};
+
+FShaderID FragmentShaderShapeID(const FShaderID &id);
+// The constants packed into a key, stored in the pipeline key.
+uint32_t FragmentShaderSpecKey(const FShaderID &id);
+void FragmentShaderSpecValues(uint32_t specKey, int32_t values[FS_SPEC_COUNT]);
+
+// Takes a shape ID, and reads the specialized parts from the constants.
 bool GenerateVulkanGLSLFragmentShader(const FShaderID &id, char *buffer);
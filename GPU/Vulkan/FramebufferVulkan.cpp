@@ -461,7 +461,7 @@ VkImageView FramebufferManagerVulkan::BindFramebufferAsColorTexture(int stage, V
 bool FramebufferManagerVulkan::CreateDownloadTempBuffer(VirtualFramebuffer *nvfb) {
 	nvfb->colorDepth = Draw::FBO_8888;
 
-	nvfb->fbo = draw_->CreateFramebuffer({ nvfb->bufferWidth, nvfb->height, 1, 1, true, (Draw::FBColorDepth)nvfb->colorDepth });
+	nvfb->fbo = AllocFramebuffer({ nvfb->bufferWidth, nvfb->height, 1, 1, true, (Draw::FBColorDepth)nvfb->colorDepth });
 	if (!(nvfb->fbo)) {
 		ERROR_LOG(FRAMEBUF, "Error creating FBO! %i x %i", nvfb->renderWidth, nvfb->renderHeight);
 		return false;
@@ -631,7 +631,11 @@ void FramebufferManagerVulkan::DestroyAllFBOs() {
 	}
 	tempFBOs_.clear();
 
+	// Pending async readbacks might land in memory that's about to be reloaded or freed.
+	draw_->DiscardAsyncReadbacks();
+
 	SetNumExtraFBOs(0);
+	ClearFramebufferPool();
 }
 
 void FramebufferManagerVulkan::Resized() {
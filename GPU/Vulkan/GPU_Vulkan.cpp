@@ -110,6 +110,8 @@ GPU_Vulkan::GPU_Vulkan(GraphicsContext *gfxCtx, Draw::DrawContext *draw)
 		});
 		th.detach();
 	}
+
+	StartThread();
 }
 
 bool GPU_Vulkan::IsReady() {
@@ -126,6 +128,8 @@ void GPU_Vulkan::LoadCache(std::string filename) {
 	// First compile shaders to SPIR-V, then load the pipeline cache and recreate the pipelines.
 	// It's when recreating the pipelines that the pipeline cache is useful - in the ideal case,
 	// it can just memcpy the finished shader binaries out of the pipeline cache file.
+	// The pipelines are only queued here, most used first. They finish on the pipeline manager's
+	// compile threads while the game is already running, anything needed before that is made on demand.
 	bool result = shaderManagerVulkan_->LoadCache(f);
 	if (result) {
 		VkRenderPass renderPass = g_Config.iRenderingMode == FB_BUFFERED_MODE ?
@@ -154,6 +158,7 @@ void GPU_Vulkan::SaveCache(std::string filename) {
 }
 
 GPU_Vulkan::~GPU_Vulkan() {
+	StopThread();
 	SaveCache(shaderCachePath_);
 	// Note: We save the cache in DeviceLost
 	DestroyDeviceObjects();
@@ -229,6 +234,9 @@ void GPU_Vulkan::CheckGPUFeatures() {
 	if (vulkan_->GetFeaturesEnabled().samplerAnisotropy) {
 		features |= GPU_SUPPORTS_ANISOTROPY;
 	}
+	if (vulkan_->DeviceExtensions().EXT_SHADER_STENCIL_EXPORT) {
+		features |= GPU_SUPPORTS_SHADER_STENCIL_EXPORT;
+	}
 
 	if (PSP_CoreParameter().compat.flags().ClearToRAM) {
 		features |= GPU_USE_CLEAR_RAM_HACK;
@@ -424,7 +432,11 @@ inline void GPU_Vulkan::CheckFlushOp(int cmd, u32 diff) {
 		if (dumpThisFrame_) {
 			NOTICE_LOG(G3D, "================ FLUSH ================");
 		}
-		drawEngine_.Flush();
+		if (cmdFlags & FLAG_FLUSHBEFORE) {
+			drawEngine_.Flush();
+		} else {
+			FlushBeforeStateChange(cmd);
+		}
 	}
 }
 
@@ -466,6 +478,7 @@ void GPU_Vulkan::DestroyDeviceObjects() {
 }
 
 void GPU_Vulkan::DeviceLost() {
+	SyncThread();
 	if (!shaderCachePath_.empty()) {
 		SaveCache(shaderCachePath_);
 	}
@@ -510,10 +523,18 @@ void GPU_Vulkan::GetStats(char *buffer, size_t bufsize) {
 		"Commands per call level: %i %i %i %i\n"
 		"Vertices submitted: %i\n"
 		"Cached, Uncached Vertices Drawn: %i, %i\n"
-		"FBOs active: %i\n"
-		"Textures active: %i, decoded: %i  invalidated: %i\n"
-		"Readbacks: %d, uploads: %d\n"
-		"Vertex, Fragment, Pipelines loaded: %i, %i, %i\n"
+		"Vertex cache hits: %i, misses: %i, uploaded: %i KB\n"
+		"Vertex decoder JIT fallbacks: %i formats, %i verts\n"
+		"Skinned draws: %i, verts: %i (%i by fallback)\n"
+		"Flushes for state: %i, prim: %i, full: %i, merged state changes: %i\n"
+		"Bounding box tests: %i, culled: %i\n"
+		"FBOs active: %i, created: %i, reused from pool: %i\n"
+		"Textures active: %i, decoded: %i  invalidated: %i  unwritten: %i  sampled: %i\n"
+		"Texture memory: %0.1f MB, budget: %i MB\n"
+		"Readbacks: %d (%d async, %0.2f ms stalled), uploads: %d\n"
+		"Block transfers: %d GPU, %d CPU (%d downloads, %d uploads)\n"
+		"Vertex, Fragment (modules), Pipelines loaded: %i, %i (%i), %i\n"
+		"Pipelines compiling: %i, compiled async: %i (%0.2f ms avg), fallback draws: %i\n"
 		"Pushbuffer space used: UBO %d, Vtx %d, Idx %d\n"
 		"%s\n",
 		gpuStats.msProcessingDisplayLists * 1000.0f,
@@ -528,15 +549,46 @@ void GPU_Vulkan::GetStats(char *buffer, size_t bufsize) {
 		gpuStats.numVertsSubmitted,
 		gpuStats.numCachedVertsDrawn,
 		gpuStats.numUncachedVertsDrawn,
+		gpuStats.numCachedDrawCalls,
+		gpuStats.numVertexCacheMisses,
+		gpuStats.numVertexCacheUploadBytes / 1024,
+		gpuStats.numJitFallbackDecoders,
+		gpuStats.numVertsDecodedByFallback,
+		gpuStats.numSkinnedDrawCalls,
+		gpuStats.numSkinnedVerts,
+		gpuStats.numSkinnedVertsByFallback,
+		gpuStats.numStateFlushes,
+		gpuStats.numPrimFlushes,
+		gpuStats.numFullFlushes,
+		gpuStats.numMergedStateChanges,
+		gpuStats.numBBoxTests,
+		gpuStats.numBBoxCulled,
 		(int)framebufferManager_->NumVFBs(),
+		gpuStats.numFBOsCreated,
+		gpuStats.numPooledFBOsReused,
 		(int)textureCacheVulkan_->NumLoadedTextures(),
 		gpuStats.numTexturesDecoded,
 		gpuStats.numTextureInvalidations,
+		gpuStats.numTextureHashesSkipped,
+		gpuStats.numTextureHashesSampled,
+		textureCacheVulkan_->MemoryUsage() / (1024.0f * 1024.0f),
+		(int)(textureCacheVulkan_->MemoryBudget() / (1024 * 1024)),
 		gpuStats.numReadbacks,
+		gpuStats.numAsyncReadbacks,
+		gpuStats.msReadbackStall,
 		gpuStats.numUploads,
+		gpuStats.numBlockTransfersGPU,
+		gpuStats.numBlockTransfersCPU,
+		gpuStats.numBlockTransferDownloads,
+		gpuStats.numBlockTransferUploads,
 		shaderManagerVulkan_->GetNumVertexShaders(),
 		shaderManagerVulkan_->GetNumFragmentShaders(),
+		shaderManagerVulkan_->GetNumFragmentShaderModules(),
 		pipelineManager_->GetNumPipelines(),
+		pipelineManager_->GetNumPendingPipelines(),
+		pipelineManager_->GetNumAsyncPipelines(),
+		pipelineManager_->GetAsyncCompileMs(),
+		gpuStats.numPipelineFallbacks,
 		drawStats.pushUBOSpaceUsed,
 		drawStats.pushVertexSpaceUsed,
 		drawStats.pushIndexSpaceUsed,
@@ -557,8 +609,8 @@ void GPU_Vulkan::DoState(PointerWrap &p) {
 
 	// TODO: Some of these things may not be necessary.
 	// None of these are necessary when saving.
-	// In Freeze-Frame mode, we don't want to do any of this.
-	if (p.mode == p.MODE_READ && !PSP_CoreParameter().frozen) {
+	// In Freeze-Frame mode or a run-ahead rollback, we don't want to do any of this.
+	if (p.mode == p.MODE_READ && !PSP_CoreParameter().frozen && !PSP_CoreParameter().runningAhead) {
 		textureCacheVulkan_->Clear(true);
 		depalShaderCache_.Clear();
 
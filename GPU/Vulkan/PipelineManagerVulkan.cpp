@@ -1,13 +1,19 @@
+#include <algorithm>
 #include <cstring>
+#include <map>
 #include <memory>
-#include <set>
 
+#include "base/timeutil.h"
 #include "profiler/profiler.h"
+#include "thread/threadutil.h"
 
 #include "Common/Log.h"
 #include "Common/StringUtils.h"
 #include "Common/Vulkan/VulkanContext.h"
+#include "Core/Config.h"
+#include "GPU/GPU.h"
 #include "GPU/Vulkan/VulkanUtil.h"
+#include "GPU/Vulkan/FragmentShaderGeneratorVulkan.h"
 #include "GPU/Vulkan/PipelineManagerVulkan.h"
 #include "GPU/Vulkan/ShaderManagerVulkan.h"
 #include "GPU/Common/DrawEngineCommon.h"
@@ -17,12 +23,16 @@ PipelineManagerVulkan::PipelineManagerVulkan(VulkanContext *vulkan) : vulkan_(vu
 }
 
 PipelineManagerVulkan::~PipelineManagerVulkan() {
+	StopCompileThreads();
 	Clear();
 	if (pipelineCache_ != VK_NULL_HANDLE)
 		vulkan_->Delete().QueueDeletePipelineCache(pipelineCache_);
 }
 
 void PipelineManagerVulkan::Clear() {
+	// The compile threads might still be writing into pipelines we're about to delete.
+	WaitForCompiles(true);
+
 	// This should kill off all the shaders at once.
 	// This could also be an opportunity to store the whole cache to disk. Will need to also
 	// store the keys.
@@ -116,7 +126,7 @@ static bool UsesBlendConstant(int factor) {
 
 static VulkanPipeline *CreateVulkanPipeline(VkDevice device, VkPipelineCache pipelineCache, 
 		VkPipelineLayout layout, VkRenderPass renderPass, const VulkanPipelineRasterStateKey &key,
-		const DecVtxFormat *decFmt, VulkanVertexShader *vs, VulkanFragmentShader *fs, bool useHwTransform, float lineWidth) {
+		const DecVtxFormat *decFmt, VkShaderModule vShader, VkShaderModule fShader, uint32_t fSpecKey, bool useHwTransform, float lineWidth) {
 	PROFILE_THIS_SCOPE("pipelinebuild");
 	bool useBlendConstant = false;
 
@@ -198,17 +208,32 @@ static VulkanPipeline *CreateVulkanPipeline(VkDevice device, VkPipelineCache pip
 	ss[0].pNext = nullptr;
 	ss[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
 	ss[0].pSpecializationInfo = nullptr;
-	ss[0].module = vs->GetModule();
+	ss[0].module = vShader;
 	ss[0].pName = "main";
 	ss[0].flags = 0;
 	ss[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 	ss[1].pNext = nullptr;
 	ss[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-	ss[1].pSpecializationInfo = nullptr;
-	ss[1].module = fs->GetModule();
+	ss[1].module = fShader;
 	ss[1].pName = "main";
 	ss[1].flags = 0;
 
+	// The texture function and alpha/color test funcs are picked here rather than in the module.
+	int32_t specValues[FS_SPEC_COUNT];
+	VkSpecializationMapEntry specEntries[FS_SPEC_COUNT];
+	FragmentShaderSpecValues(fSpecKey, specValues);
+	for (int i = 0; i < FS_SPEC_COUNT; i++) {
+		specEntries[i].constantID = i;
+		specEntries[i].offset = i * sizeof(int32_t);
+		specEntries[i].size = sizeof(int32_t);
+	}
+	VkSpecializationInfo specInfo;
+	specInfo.mapEntryCount = FS_SPEC_COUNT;
+	specInfo.pMapEntries = specEntries;
+	specInfo.dataSize = sizeof(specValues);
+	specInfo.pData = specValues;
+	ss[1].pSpecializationInfo = &specInfo;
+
 	if (!ss[0].module || !ss[1].module) {
 		ERROR_LOG(G3D, "Failed creating graphics pipeline - bad shaders");
 		// Create a placeholder to avoid creating over and over if shader compiler broken.
@@ -315,15 +340,54 @@ VulkanPipeline *PipelineManagerVulkan::GetOrCreatePipeline(VkPipelineLayout layo
 	key.useHWTransform = useHwTransform;
 	key.vShader = vs->GetModule();
 	key.fShader = fs->GetModule();
+	key.fSpecKey = fs->GetSpecKey();
 	key.vtxFmtId = useHwTransform ? decFmt->id : 0;
 
 	auto iter = pipelines_.Get(key);
-	if (iter)
-		return iter;
+	if (iter && iter->pending) {
+		if (iter->fallback) {
+			gpuStats.numPipelineFallbacks++;
+			return iter->fallback;
+		}
+		// Still warming up from the cache, get this one done right away.
+		WaitForPipeline(iter);
+	}
+	if (iter) {
+		iter->useCount++;
+		return iter->pipeline ? iter : nullptr;
+	}
+
+	// Only go async when there's something close enough to draw with in the meantime. Otherwise
+	// the draw would have to be dropped, which tends to look worse than a short stutter.
+	VulkanPipeline *fallback = g_Config.bAsyncPipelines ? FindFallbackPipeline(key) : nullptr;
+	if (fallback) {
+		VulkanPipeline *pipeline = new VulkanPipeline();
+		pipeline->pending = true;
+		pipeline->fallback = fallback;
+		pipelines_.Insert(key, pipeline);
+
+		CompileJob job;
+		job.pipeline = pipeline;
+		job.layout = layout;
+		job.renderPass = renderPass;
+		job.rasterKey = rasterKey;
+		if (useHwTransform)
+			job.decFmt = *decFmt;
+		job.vShader = key.vShader;
+		job.fShader = key.fShader;
+		job.fSpecKey = key.fSpecKey;
+		job.useHwTransform = useHwTransform;
+		job.lineWidth = lineWidth_;
+		QueueCompile(job, true);
+
+		gpuStats.numPipelineFallbacks++;
+		return fallback;
+	}
 
 	VulkanPipeline *pipeline = CreateVulkanPipeline(
 		vulkan_->GetDevice(), pipelineCache_, layout, renderPass, 
-		rasterKey, decFmt, vs, fs, useHwTransform, lineWidth_);
+		rasterKey, decFmt, key.vShader, key.fShader, key.fSpecKey, useHwTransform, lineWidth_);
+	pipeline->useCount = 1;
 	pipelines_.Insert(key, pipeline);
 
 	// Don't return placeholder null pipelines.
@@ -334,6 +398,168 @@ VulkanPipeline *PipelineManagerVulkan::GetOrCreatePipeline(VkPipelineLayout layo
 	}
 }
 
+VulkanPipeline *PipelineManagerVulkan::FindFallbackPipeline(const VulkanPipelineKey &key) {
+	// The vertex shader and input stay the same, so any fragment shader built for it links fine.
+	// That leaves things like the texture function or fog off for a few frames, but nothing waits.
+	VulkanPipeline *fallback = nullptr;
+	pipelines_.Iterate([&](const VulkanPipelineKey &other, VulkanPipeline *value) {
+		if (fallback || value->pending || !value->pipeline)
+			return;
+		if (other.renderPass == key.renderPass && other.vShader == key.vShader && other.vtxFmtId == key.vtxFmtId &&
+			other.useHWTransform == key.useHWTransform && !memcmp(&other.raster, &key.raster, sizeof(key.raster))) {
+			fallback = value;
+		}
+	});
+	return fallback;
+}
+
+void PipelineManagerVulkan::PrewarmPipeline(VkPipelineLayout layout, VkRenderPass renderPass, const VulkanPipelineRasterStateKey &rasterKey, const DecVtxFormat *decFmt, VulkanVertexShader *vs, VulkanFragmentShader *fs, bool useHwTransform) {
+	VulkanPipelineKey key{};
+	key.raster = rasterKey;
+	key.renderPass = renderPass;
+	key.useHWTransform = useHwTransform;
+	key.vShader = vs->GetModule();
+	key.fShader = fs->GetModule();
+	key.fSpecKey = fs->GetSpecKey();
+	key.vtxFmtId = useHwTransform ? decFmt->id : 0;
+	if (pipelines_.Get(key))
+		return;
+
+	// No fallback, if the game needs it before a thread gets to it, it's just created on demand.
+	VulkanPipeline *pipeline = new VulkanPipeline();
+	pipeline->pending = true;
+	pipelines_.Insert(key, pipeline);
+
+	CompileJob job;
+	job.pipeline = pipeline;
+	job.layout = layout;
+	job.renderPass = renderPass;
+	job.rasterKey = rasterKey;
+	if (useHwTransform)
+		job.decFmt = *decFmt;
+	job.vShader = key.vShader;
+	job.fShader = key.fShader;
+	job.fSpecKey = key.fSpecKey;
+	job.useHwTransform = useHwTransform;
+	job.lineWidth = lineWidth_;
+	QueueCompile(job, false);
+}
+
+void PipelineManagerVulkan::QueueCompile(const CompileJob &job, bool urgent) {
+	std::lock_guard<std::mutex> guard(compileLock_);
+	if (compileThreads_.empty()) {
+		// Mostly matters for warming up the cache at boot, the odd new pipeline later on is fine with any.
+		int numThreads = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+		compileStop_ = false;
+		for (int i = 0; i < numThreads; i++) {
+			compileThreads_.push_back(std::thread(&PipelineManagerVulkan::CompileThreadFunc, this));
+		}
+	}
+	if (urgent) {
+		compileQueue_.push_front(job);
+	} else {
+		compileQueue_.push_back(job);
+	}
+	compileCond_.notify_one();
+}
+
+double PipelineManagerVulkan::RunCompileJob(const CompileJob &job) {
+	// The pipeline cache is internally synchronized, so this is safe alongside the GPU thread.
+	double start = time_now_d();
+	VulkanPipeline *created = CreateVulkanPipeline(
+		vulkan_->GetDevice(), pipelineCache_, job.layout, job.renderPass,
+		job.rasterKey, &job.decFmt, job.vShader, job.fShader, job.fSpecKey, job.useHwTransform, job.lineWidth);
+	double elapsed = time_now_d() - start;
+	job.pipeline->pipeline = created->pipeline;
+	job.pipeline->flags = created->flags;
+	delete created;
+	job.pipeline->pending = false;
+	return elapsed;
+}
+
+void PipelineManagerVulkan::CompileThreadFunc() {
+	setCurrentThreadName("PipelineCompile");
+
+	std::unique_lock<std::mutex> guard(compileLock_);
+	while (true) {
+		while (compileQueue_.empty() && !compileStop_) {
+			compileCond_.wait(guard);
+		}
+		if (compileStop_) {
+			break;
+		}
+
+		CompileJob job = compileQueue_.front();
+		compileQueue_.pop_front();
+		compilesRunning_++;
+		guard.unlock();
+
+		double elapsed = RunCompileJob(job);
+
+		guard.lock();
+		compilesRunning_--;
+		asyncCompiled_++;
+		asyncCompileSeconds_ += elapsed;
+		compileDoneCond_.notify_all();
+	}
+}
+
+void PipelineManagerVulkan::WaitForPipeline(VulkanPipeline *pipeline) {
+	std::unique_lock<std::mutex> guard(compileLock_);
+	for (auto iter = compileQueue_.begin(); iter != compileQueue_.end(); ++iter) {
+		if (iter->pipeline == pipeline) {
+			// Not started yet, quicker to just do it right here than to wait for the rest of the queue.
+			CompileJob job = *iter;
+			compileQueue_.erase(iter);
+			guard.unlock();
+			RunCompileJob(job);
+			return;
+		}
+	}
+	while (pipeline->pending) {
+		compileDoneCond_.wait(guard);
+	}
+}
+
+void PipelineManagerVulkan::WaitForCompiles(bool cancelQueued) {
+	std::unique_lock<std::mutex> guard(compileLock_);
+	if (cancelQueued || compileThreads_.empty()) {
+		// The owner is about to delete these pipelines anyway.
+		compileQueue_.clear();
+	}
+	while (!compileQueue_.empty() || compilesRunning_ > 0) {
+		compileDoneCond_.wait(guard);
+	}
+}
+
+void PipelineManagerVulkan::StopCompileThreads() {
+	WaitForCompiles(true);
+	{
+		std::lock_guard<std::mutex> guard(compileLock_);
+		compileStop_ = true;
+		compileCond_.notify_all();
+	}
+	for (std::thread &th : compileThreads_) {
+		th.join();
+	}
+	compileThreads_.clear();
+}
+
+int PipelineManagerVulkan::GetNumPendingPipelines() {
+	std::lock_guard<std::mutex> guard(compileLock_);
+	return (int)compileQueue_.size() + compilesRunning_;
+}
+
+int PipelineManagerVulkan::GetNumAsyncPipelines() {
+	std::lock_guard<std::mutex> guard(compileLock_);
+	return asyncCompiled_;
+}
+
+double PipelineManagerVulkan::GetAsyncCompileMs() {
+	std::lock_guard<std::mutex> guard(compileLock_);
+	return asyncCompiled_ ? asyncCompileSeconds_ * 1000.0 / asyncCompiled_ : 0.0;
+}
+
 std::vector<std::string> PipelineManagerVulkan::DebugGetObjectIDs(DebugShaderType type) {
 	std::vector<std::string> ids;
 	switch (type) {
@@ -519,6 +745,7 @@ void PipelineManagerVulkan::SetLineWidth(float lineWidth) {
 	if (lineWidth_ == lineWidth)
 		return;
 	lineWidth_ = lineWidth;
+	WaitForCompiles(false);
 
 	// Wipe all line-drawing pipelines.
 	pipelines_.Iterate([&](const VulkanPipelineKey &key, VulkanPipeline *value) {
@@ -567,13 +794,13 @@ void PipelineManagerVulkan::SaveCache(FILE *file, bool saveRawPipelineCache, Sha
 	// Since we don't include the full pipeline key, there can be duplicates,
 	// caused by things like switching from buffered to non-buffered rendering.
 	// Make sure the set of pipelines we write is "unique".
-	std::set<StoredVulkanPipelineKey> keys;
+	std::map<StoredVulkanPipelineKey, uint32_t> keys;
 
 	pipelines_.Iterate([&](const VulkanPipelineKey &pkey, VulkanPipeline *value) {
 		if (failed)
 			return;
 		VulkanVertexShader *vshader = shaderManager->GetVertexShaderFromModule(pkey.vShader);
-		VulkanFragmentShader *fshader = shaderManager->GetFragmentShaderFromModule(pkey.fShader);
+		VulkanFragmentShader *fshader = shaderManager->GetFragmentShaderFromModule(pkey.fShader, pkey.fSpecKey);
 		if (!vshader || !fshader) {
 			failed = true;
 			return;
@@ -587,16 +814,22 @@ void PipelineManagerVulkan::SaveCache(FILE *file, bool saveRawPipelineCache, Sha
 			// NOTE: This is not a vtype, but a decoded vertex format.
 			key.vtxFmtId = pkey.vtxFmtId;
 		}
-		keys.insert(key);
+		keys[key] += value->useCount;
+	});
+
+	// Most used first, that's the order LoadCache warms them up in.
+	std::vector<std::pair<StoredVulkanPipelineKey, uint32_t>> sorted(keys.begin(), keys.end());
+	std::stable_sort(sorted.begin(), sorted.end(), [](const std::pair<StoredVulkanPipelineKey, uint32_t> &a, const std::pair<StoredVulkanPipelineKey, uint32_t> &b) {
+		return a.second > b.second;
 	});
 
 	// Write the number of pipelines.
-	size = (uint32_t)keys.size();
+	size = (uint32_t)sorted.size();
 	fwrite(&size, sizeof(size), 1, file);
 
 	// Write the pipelines.
-	for (auto &key : keys) {
-		fwrite(&key, sizeof(key), 1, file);
+	for (auto &key : sorted) {
+		fwrite(&key.first, sizeof(key.first), 1, file);
 	}
 
 	if (failed) {
@@ -675,10 +908,10 @@ bool PipelineManagerVulkan::LoadCache(FILE *file, bool loadRawPipelineCache, Sha
 		}
 		DecVtxFormat fmt;
 		fmt.InitializeFromID(key.vtxFmtId);
-		GetOrCreatePipeline(layout, renderPass, key.raster,
+		PrewarmPipeline(layout, renderPass, key.raster,
 			key.useHWTransform ? &fmt : 0,
 			vs, fs, key.useHWTransform);
 	}
-	NOTICE_LOG(G3D, "Recreated Vulkan pipeline cache (%d pipelines).", (int)size);
+	NOTICE_LOG(G3D, "Queued %d Vulkan pipelines from the cache for creation.", (int)size);
 	return true;
 }
@@ -17,7 +17,13 @@
 
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
 #include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include "Common/Hashmaps.h"
 
 #include "GPU/Common/VertexDecoderCommon.h"
@@ -44,6 +50,7 @@ struct VulkanPipelineKey {
 	VkShaderModule vShader;
 	VkShaderModule fShader;
 	uint32_t vtxFmtId;
+	uint32_t fSpecKey;  // Fragment shaders with the same module differ only in specialization constants.
 	bool useHWTransform;
 
 	void ToString(std::string *str) const {
@@ -76,8 +83,14 @@ enum PipelineFlags {
 
 // Simply wraps a Vulkan pipeline, providing some metadata.
 struct VulkanPipeline {
-	VkPipeline pipeline;
-	int flags;  // PipelineFlags enum above.
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	int flags = 0;  // PipelineFlags enum above.
+	// Set while a worker thread creates the pipeline, pipeline and flags can't be used until cleared.
+	std::atomic<bool> pending{ false };
+	// Used for drawing while pending. Differs only in the fragment shader.
+	VulkanPipeline *fallback = nullptr;
+	// Lookups this session, saved caches are ordered by it so the common ones get warmed up first.
+	uint32_t useCount = 0;
 
 	// Convenience.
 	bool UsesBlendConstant() const { return (flags & PIPELINE_FLAG_USES_BLEND_CONSTANT) != 0; }
@@ -97,6 +110,9 @@ class PipelineManagerVulkan {
 
 	VulkanPipeline *GetOrCreatePipeline(VkPipelineLayout layout, VkRenderPass renderPass, const VulkanPipelineRasterStateKey &rasterKey, const DecVtxFormat *decFmt, VulkanVertexShader *vs, VulkanFragmentShader *fs, bool useHwTransform);
 	int GetNumPipelines() const { return (int)pipelines_.size(); }
+	int GetNumPendingPipelines();
+	int GetNumAsyncPipelines();
+	double GetAsyncCompileMs();
 
 	void Clear();
 
@@ -113,8 +129,41 @@ class PipelineManagerVulkan {
 	bool LoadCache(FILE *file, bool loadRawPipelineCache, ShaderManagerVulkan *shaderManager, DrawEngineCommon *drawEngine, VkPipelineLayout layout, VkRenderPass renderPass);
 
 private:
+	struct CompileJob {
+		VulkanPipeline *pipeline;
+		VkPipelineLayout layout;
+		VkRenderPass renderPass;
+		VulkanPipelineRasterStateKey rasterKey;
+		DecVtxFormat decFmt;
+		VkShaderModule vShader;
+		VkShaderModule fShader;
+		uint32_t fSpecKey;
+		bool useHwTransform;
+		float lineWidth;
+	};
+
+	VulkanPipeline *FindFallbackPipeline(const VulkanPipelineKey &key);
+	void PrewarmPipeline(VkPipelineLayout layout, VkRenderPass renderPass, const VulkanPipelineRasterStateKey &rasterKey, const DecVtxFormat *decFmt, VulkanVertexShader *vs, VulkanFragmentShader *fs, bool useHwTransform);
+	// Urgent jobs are for pipelines that are drawn with right now, they skip ahead of the cache warmup.
+	void QueueCompile(const CompileJob &job, bool urgent);
+	double RunCompileJob(const CompileJob &job);
+	void CompileThreadFunc();
+	void WaitForPipeline(VulkanPipeline *pipeline);
+	void WaitForCompiles(bool cancelQueued);
+	void StopCompileThreads();
+
 	DenseHashMap<VulkanPipelineKey, VulkanPipeline *, nullptr> pipelines_;
 	VkPipelineCache pipelineCache_ = VK_NULL_HANDLE;
 	VulkanContext *vulkan_;
 	float lineWidth_ = 1.0f;
+
+	std::vector<std::thread> compileThreads_;
+	std::mutex compileLock_;
+	std::condition_variable compileCond_;
+	std::condition_variable compileDoneCond_;
+	std::deque<CompileJob> compileQueue_;
+	int compilesRunning_ = 0;
+	bool compileStop_ = false;
+	int asyncCompiled_ = 0;
+	double asyncCompileSeconds_ = 0.0;
 };
@@ -41,7 +41,7 @@
 #include "GPU/Vulkan/VertexShaderGeneratorVulkan.h"
 
 VulkanFragmentShader::VulkanFragmentShader(VulkanContext *vulkan, FShaderID id, const char *code)
-	: vulkan_(vulkan), id_(id), failed_(false), module_(0) {
+	: vulkan_(vulkan), id_(id), failed_(false), module_(0), ownsModule_(true), specKey_(FragmentShaderSpecKey(id)) {
 	PROFILE_THIS_SCOPE("shadercomp");
 	source_ = code;
 
@@ -81,8 +81,13 @@ VulkanFragmentShader::VulkanFragmentShader(VulkanContext *vulkan, FShaderID id,
 	}
 }
 
+VulkanFragmentShader::VulkanFragmentShader(VulkanContext *vulkan, FShaderID id, const VulkanFragmentShader *shape)
+	: vulkan_(vulkan), id_(id), failed_(shape->failed_), module_(shape->module_), ownsModule_(false), specKey_(FragmentShaderSpecKey(id)) {
+	source_ = shape->source_;
+}
+
 VulkanFragmentShader::~VulkanFragmentShader() {
-	if (module_ != VK_NULL_HANDLE) {
+	if (ownsModule_ && module_ != VK_NULL_HANDLE) {
 		vulkan_->Delete().QueueDeleteShaderModule(module_);
 	}
 }
@@ -153,11 +158,13 @@ std::string VulkanVertexShader::GetShaderString(DebugShaderStringType type) cons
 }
 
 ShaderManagerVulkan::ShaderManagerVulkan(VulkanContext *vulkan)
-	: vulkan_(vulkan), lastVShader_(nullptr), lastFShader_(nullptr), fsCache_(16), vsCache_(16) {
+	: vulkan_(vulkan), lastVShader_(nullptr), lastFShader_(nullptr), fsCache_(16), fsShapeCache_(16), vsCache_(16) {
 	codeBuffer_ = new char[16384];
 	uboAlignment_ = vulkan_->GetPhysicalDeviceProperties().limits.minUniformBufferOffsetAlignment;
 	memset(&ub_base, 0, sizeof(ub_base));
 	memset(&ub_lights, 0, sizeof(ub_lights));
+	memset(&ub_basePrev_, 0, sizeof(ub_basePrev_));
+	memset(&ub_lightsPrev_, 0, sizeof(ub_lightsPrev_));
 
 	ILOG("sizeof(ub_base): %d", (int)sizeof(ub_base));
 	ILOG("sizeof(ub_lights): %d", (int)sizeof(ub_lights));
@@ -181,6 +188,7 @@ void ShaderManagerVulkan::Clear() {
 		delete shader;
 	});
 	fsCache_.Clear();
+	fsShapeCache_.Clear();
 	vsCache_.Clear();
 	lastFSID_.set_invalid();
 	lastVSID_.set_invalid();
@@ -209,10 +217,23 @@ void ShaderManagerVulkan::DirtyLastShader() {
 uint64_t ShaderManagerVulkan::UpdateUniforms() {
 	uint64_t dirty = gstate_c.GetDirtyUniforms();
 	if (dirty != 0) {
-		if (dirty & DIRTY_BASE_UNIFORMS)
+		// The dirty flags are conservative, so often nothing actually changed. In that case we
+		// don't report the block as dirty and the draw keeps pointing at the last pushed copy.
+		// The draw engine pushes everything at the start of each frame regardless.
+		if (dirty & DIRTY_BASE_UNIFORMS) {
 			BaseUpdateUniforms(&ub_base, dirty, false);
-		if (dirty & DIRTY_LIGHT_UNIFORMS)
+			if (memcmp(&ub_base, &ub_basePrev_, sizeof(ub_base)) == 0)
+				dirty &= ~DIRTY_BASE_UNIFORMS;
+			else
+				memcpy(&ub_basePrev_, &ub_base, sizeof(ub_base));
+		}
+		if (dirty & DIRTY_LIGHT_UNIFORMS) {
 			LightUpdateUniforms(&ub_lights, dirty);
+			if (memcmp(&ub_lights, &ub_lightsPrev_, sizeof(ub_lights)) == 0)
+				dirty &= ~DIRTY_LIGHT_UNIFORMS;
+			else
+				memcpy(&ub_lightsPrev_, &ub_lights, sizeof(ub_lights));
+		}
 	}
 	gstate_c.CleanUniforms();
 	return dirty;
@@ -260,10 +281,7 @@ void ShaderManagerVulkan::GetShaders(int prim, u32 vertType, VulkanVertexShader
 
 	VulkanFragmentShader *fs = fsCache_.Get(FSID);
 	if (!fs) {
-		// Fragment shader not in cache. Let's compile it.
-		GenerateVulkanGLSLFragmentShader(FSID, codeBuffer_);
-		fs = new VulkanFragmentShader(vulkan_, FSID, codeBuffer_);
-		fsCache_.Insert(FSID, fs);
+		fs = CreateFragmentShader(FSID);
 	}
 
 	lastFSID_ = FSID;
@@ -276,6 +294,22 @@ void ShaderManagerVulkan::GetShaders(int prim, u32 vertType, VulkanVertexShader
 	_dbg_assert_msg_(G3D, (*vshader)->UseHWTransform() == useHWTransform, "Bad vshader was computed");
 }
 
+VulkanFragmentShader *ShaderManagerVulkan::CreateFragmentShader(const FShaderID &id) {
+	FShaderID shapeID = FragmentShaderShapeID(id);
+	VulkanFragmentShader *shape = fsShapeCache_.Get(shapeID);
+	VulkanFragmentShader *fs;
+	if (shape) {
+		fs = new VulkanFragmentShader(vulkan_, id, shape);
+	} else {
+		// No module for this shape yet. Let's compile it.
+		GenerateVulkanGLSLFragmentShader(shapeID, codeBuffer_);
+		fs = new VulkanFragmentShader(vulkan_, id, codeBuffer_);
+		fsShapeCache_.Insert(shapeID, fs);
+	}
+	fsCache_.Insert(id, fs);
+	return fs;
+}
+
 std::vector<std::string> ShaderManagerVulkan::DebugGetShaderIDs(DebugShaderType type) {
 	std::vector<std::string> ids;
 	switch (type) {
@@ -332,10 +366,10 @@ VulkanVertexShader *ShaderManagerVulkan::GetVertexShaderFromModule(VkShaderModul
 	return vs;
 }
 
-VulkanFragmentShader *ShaderManagerVulkan::GetFragmentShaderFromModule(VkShaderModule module) {
+VulkanFragmentShader *ShaderManagerVulkan::GetFragmentShaderFromModule(VkShaderModule module, uint32_t specKey) {
 	VulkanFragmentShader *fs = nullptr;
 	fsCache_.Iterate([&](const FShaderID &id, VulkanFragmentShader *shader) {
-		if (shader->GetModule() == module)
+		if (shader->GetModule() == module && shader->GetSpecKey() == specKey)
 			fs = shader;
 	});
 	return fs;
@@ -350,7 +384,7 @@ VulkanFragmentShader *ShaderManagerVulkan::GetFragmentShaderFromModule(VkShaderM
 // instantaneous.
 
 #define CACHE_HEADER_MAGIC 0xff51f420 
-#define CACHE_VERSION 6
+#define CACHE_VERSION 7
 struct VulkanCacheHeader {
 	uint32_t magic;
 	uint32_t version;
@@ -381,12 +415,11 @@ bool ShaderManagerVulkan::LoadCache(FILE *f) {
 	for (int i = 0; i < header.numFragmentShaders; i++) {
 		FShaderID id;
 		fread(&id, sizeof(id), 1, f);
-		GenerateVulkanGLSLFragmentShader(id, codeBuffer_);
-		VulkanFragmentShader *fs = new VulkanFragmentShader(vulkan_, id, codeBuffer_);
-		fsCache_.Insert(id, fs);
+		if (!fsCache_.Get(id))
+			CreateFragmentShader(id);
 	}
 
-	NOTICE_LOG(G3D, "Loaded %d vertex and %d fragment shaders", header.numVertexShaders, header.numFragmentShaders);
+	NOTICE_LOG(G3D, "Loaded %d vertex and %d fragment shaders (%d modules)", header.numVertexShaders, header.numFragmentShaders, (int)fsShapeCache_.size());
 	return true;
 }
 
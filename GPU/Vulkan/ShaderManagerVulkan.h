@@ -36,6 +36,8 @@ class VulkanPushBuffer;
 class VulkanFragmentShader {
 public:
 	VulkanFragmentShader(VulkanContext *vulkan, FShaderID id, const char *code);
+	// Shares the module of a shader with the same shape, only the specialization constants differ.
+	VulkanFragmentShader(VulkanContext *vulkan, FShaderID id, const VulkanFragmentShader *shape);
 	~VulkanFragmentShader();
 
 	const std::string &source() const { return source_; }
@@ -44,15 +46,18 @@ class VulkanFragmentShader {
 
 	std::string GetShaderString(DebugShaderStringType type) const;
 	VkShaderModule GetModule() const { return module_; }
+	uint32_t GetSpecKey() const { return specKey_; }
 	const FShaderID &GetID() { return id_; }
 
 protected:	
 	VkShaderModule module_;
+	bool ownsModule_;
 
 	VulkanContext *vulkan_;
 	std::string source_;
 	bool failed_;
 	FShaderID id_;
+	uint32_t specKey_;
 };
 
 class VulkanVertexShader {
@@ -95,12 +100,13 @@ class ShaderManagerVulkan : public ShaderManagerCommon {
 
 	int GetNumVertexShaders() const { return (int)vsCache_.size(); }
 	int GetNumFragmentShaders() const { return (int)fsCache_.size(); }
+	int GetNumFragmentShaderModules() const { return (int)fsShapeCache_.size(); }
 
 	// Used for saving/loading the cache. Don't need to be particularly fast.
 	VulkanVertexShader *GetVertexShaderFromID(VShaderID id) { return vsCache_.Get(id); }
 	VulkanFragmentShader *GetFragmentShaderFromID(FShaderID id) { return fsCache_.Get(id); }
 	VulkanVertexShader *GetVertexShaderFromModule(VkShaderModule module);
-	VulkanFragmentShader *GetFragmentShaderFromModule(VkShaderModule module);
+	VulkanFragmentShader *GetFragmentShaderFromModule(VkShaderModule module, uint32_t specKey);
 
 	std::vector<std::string> DebugGetShaderIDs(DebugShaderType type);
 	std::string DebugGetShaderString(std::string id, DebugShaderType type, DebugShaderStringType stringType);
@@ -124,11 +130,14 @@ class ShaderManagerVulkan : public ShaderManagerCommon {
 
 private:
 	void Clear();
+	VulkanFragmentShader *CreateFragmentShader(const FShaderID &id);
 
 	VulkanContext *vulkan_;
 
 	typedef DenseHashMap<FShaderID, VulkanFragmentShader *, nullptr> FSCache;
 	FSCache fsCache_;
+	// The shader that compiled each shape's module.
+	FSCache fsShapeCache_;
 
 	typedef DenseHashMap<VShaderID, VulkanVertexShader *, nullptr> VSCache;
 	VSCache vsCache_;
@@ -139,6 +148,9 @@ class ShaderManagerVulkan : public ShaderManagerCommon {
 	// Uniform block scratchpad. These (the relevant ones) are copied to the current pushbuffer at draw time.
 	UB_VS_FS_Base ub_base;
 	UB_VS_Lights ub_lights;
+	// What was last handed out to be pushed, to skip pushing identical blocks again.
+	UB_VS_FS_Base ub_basePrev_;
+	UB_VS_Lights ub_lightsPrev_;
 
 	VulkanFragmentShader *lastFShader_;
 	VulkanVertexShader *lastVShader_;
@@ -50,6 +50,22 @@ void main() {
 }
 )";
 
+// With VK_EXT_shader_stencil_export, all the bits are written in one pass.
+static const char *stencil_export_fs = R"(#version 400
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+#extension GL_ARB_shader_stencil_export : require
+layout (binding = 0) uniform sampler2D tex;
+layout (location = 0) in vec2 v_texcoord0;
+layout (location = 0) out vec4 fragColor0;
+
+void main() {
+	vec4 index = texture(tex, v_texcoord0);
+	gl_FragStencilRefARB = int(floor(index.a * 255.99)) & 0xFF;
+	fragColor0 = index.aaaa;
+}
+)";
+
 static const char stencil_vs[] = R"(#version 400
 #extension GL_ARB_separate_shader_objects : enable
 #extension GL_ARB_shading_language_420pack : enable
@@ -111,10 +127,11 @@ bool FramebufferManagerVulkan::NotifyStencilUpload(u32 addr, int size, bool skip
 		break;
 	}
 
+	bool useExport = gstate_c.Supports(GPU_SUPPORTS_SHADER_STENCIL_EXPORT);
 	std::string error;
 	if (!stencilVs_) {
 		stencilVs_ = CompileShaderModule(vulkan_, VK_SHADER_STAGE_VERTEX_BIT, stencil_vs, &error);
-		stencilFs_ = CompileShaderModule(vulkan_, VK_SHADER_STAGE_FRAGMENT_BIT, stencil_fs, &error);
+		stencilFs_ = CompileShaderModule(vulkan_, VK_SHADER_STAGE_FRAGMENT_BIT, useExport ? stencil_export_fs : stencil_fs, &error);
 	}
 	VkRenderPass rp = (VkRenderPass)draw_->GetNativeObject(Draw::NativeObject::FRAMEBUFFER_RENDERPASS);
 
@@ -142,6 +159,16 @@ bool FramebufferManagerVulkan::NotifyStencilUpload(u32 addr, int size, bool skip
 
 	VkDescriptorSet descSet = vulkan2D_->GetDescriptorSet(overrideImageView_, nearestSampler_, VK_NULL_HANDLE, VK_NULL_HANDLE);
 
+	if (useExport) {
+		// Stencil REPLACE takes the reference from the shader, so this covers the clear too.
+		renderManager->SetStencilParams(0xFF, 0xFF, 0x00);
+		renderManager->Draw(vulkan2D_->GetPipelineLayout(), descSet, 0, nullptr, VK_NULL_HANDLE, 0, 3);  // full screen triangle
+
+		overrideImageView_ = VK_NULL_HANDLE;
+		RebindFramebuffer();
+		return true;
+	}
+
 	// Note: Even with skipZero, we don't necessarily start framebuffers at 0 in Vulkan.  Clear anyway.
 	// Not an actual clear, because we need to draw to alpha only as well.
 	uint32_t value = 0;
@@ -147,7 +147,8 @@ std::vector<std::string> SamplerCache::DebugGetSamplerIDs() const {
 TextureCacheVulkan::TextureCacheVulkan(Draw::DrawContext *draw, VulkanContext *vulkan)
 	: TextureCacheCommon(draw),
 		vulkan_(vulkan),
-		samplerCache_(vulkan) {
+		samplerCache_(vulkan),
+		computeScaler_(vulkan) {
 	timesInvalidatedAllThisFrame_ = 0;
 	DeviceRestore(vulkan, draw);
 	SetupTextureDecoder();
@@ -182,6 +183,7 @@ void TextureCacheVulkan::DeviceLost() {
 	}
 
 	samplerCache_.DeviceLost();
+	computeScaler_.DeviceLost();
 
 	if (samplerNearest_)
 		vulkan_->Delete().QueueDeleteSampler(samplerNearest_);
@@ -197,6 +199,9 @@ void TextureCacheVulkan::DeviceRestore(VulkanContext *vulkan, Draw::DrawContext
 
 	allocator_ = new VulkanDeviceAllocator(vulkan_, TEXCACHE_MIN_SLAB_SIZE, TEXCACHE_MAX_SLAB_SIZE);
 	samplerCache_.DeviceRestore(vulkan);
+	computeScaler_.DeviceRestore(vulkan);
+	// DDS replacements can then skip the decode too.
+	replacer_.SetCompressedFormatsSupported(vulkan_->GetFeaturesEnabled().textureCompressionBC);
 
 	VkSamplerCreateInfo samp{ VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO };
 	samp.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
@@ -272,7 +277,16 @@ void TextureCacheVulkan::StartFrame() {
 		Decimate();
 	}
 
+	// If the texture slabs are eating most of the heap, shed some textures before the driver starts
+	// failing allocations. Freed ranges coalesce, and slabs that drain completely get released by Begin().
+	VkDeviceSize heapSize = allocator_->GetHeapSize();
+	if (heapSize != 0 && allocator_->GetTotalSlabBytes() > heapSize - heapSize / 4) {
+		u32 usage = MemoryUsage();
+		EvictToBudget(usage - usage / 8);
+	}
+
 	allocator_->Begin();
+	computeScaler_.BeginFrame();
 }
 
 void TextureCacheVulkan::EndFrame() {
@@ -348,6 +362,7 @@ void TextureCacheVulkan::ApplyTextureFramebuffer(TexCacheEntry *entry, VirtualFr
 
 		Draw::Framebuffer *depalFBO = framebufferManager_->GetTempFBO(
 			framebuffer->renderWidth, framebuffer->renderHeight, Draw::FBO_8888);
+		draw_->BeginGPUTimer("depal");
 		draw_->BindFramebufferAsRenderTarget(depalFBO, { Draw::RPAction::DONT_CARE, Draw::RPAction::DONT_CARE, Draw::RPAction::DONT_CARE });
 
 		Vulkan2D::Vertex verts[4] = {
@@ -412,6 +427,7 @@ void TextureCacheVulkan::ApplyTextureFramebuffer(TexCacheEntry *entry, VirtualFr
 		renderManager->SetViewport(VkViewport{ 0.f, 0.f, (float)framebuffer->renderWidth, (float)framebuffer->renderHeight, 0.f, 1.f });
 		renderManager->Draw(vulkan2D_->GetPipelineLayout(), descSet, 0, nullptr, pushed, offset, 4);
 		shaderManagerVulkan_->DirtyLastShader();
+		draw_->EndGPUTimer();
 
 		const u32 bytesPerColor = clutFormat == GE_CMODE_32BIT_ABGR8888 ? sizeof(u32) : sizeof(u16);
 		const u32 clutTotalColors = clutMaxBytes_ / bytesPerColor;
@@ -450,11 +466,28 @@ ReplacedTextureFormat FromVulkanFormat(VkFormat fmt) {
 	}
 }
 
+static int VulkanFormatBitsPerPixel(VkFormat fmt) {
+	switch (fmt) {
+	case VULKAN_8888_FORMAT:
+		return 32;
+	case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+		return 4;
+	case VK_FORMAT_BC2_UNORM_BLOCK:
+	case VK_FORMAT_BC3_UNORM_BLOCK:
+		return 8;
+	default:
+		return 16;
+	}
+}
+
 VkFormat ToVulkanFormat(ReplacedTextureFormat fmt) {
 	switch (fmt) {
 	case ReplacedTextureFormat::F_5650: return VULKAN_565_FORMAT;
 	case ReplacedTextureFormat::F_5551: return VULKAN_1555_FORMAT;
 	case ReplacedTextureFormat::F_4444: return VULKAN_4444_FORMAT;
+	case ReplacedTextureFormat::F_BC1: return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+	case ReplacedTextureFormat::F_BC2: return VK_FORMAT_BC2_UNORM_BLOCK;
+	case ReplacedTextureFormat::F_BC3: return VK_FORMAT_BC3_UNORM_BLOCK;
 	case ReplacedTextureFormat::F_8888: default: return VULKAN_8888_FORMAT;
 	}
 }
@@ -520,10 +553,9 @@ void TextureCacheVulkan::BuildTexture(TexCacheEntry *const entry) {
 		scaleFactor = scaleFactor > 4 ? 4 : (scaleFactor > 2 ? 2 : 1);
 	}
 
-	u64 cachekey = replacer_.Enabled() ? entry->CacheKey() : 0;
 	int w = gstate.getTextureWidth(0);
 	int h = gstate.getTextureHeight(0);
-	ReplacedTexture &replaced = replacer_.FindReplacement(cachekey, entry->fullhash, w, h);
+	ReplacedTexture &replaced = FindReplacement(entry, w, h);
 	if (replaced.GetSize(0, w, h)) {
 		// We're replacing, so we won't scale.
 		scaleFactor = 1;
@@ -541,8 +573,11 @@ void TextureCacheVulkan::BuildTexture(TexCacheEntry *const entry) {
 		scaleFactor = 1;
 	}
 
+	// Scaling on the GPU is cheap enough to skip the per-frame budget.  We can't save the
+	// scaled result for replacement from there, though.
+	bool scaleOnGPU = scaleFactor > 1 && !replaced.Valid() && !replacer_.Enabled() && computeScaler_.CanScale(scaleFactor);
 	if (scaleFactor != 1) {
-		if (texelsScaledThisFrame_ >= TEXCACHE_MAX_TEXELS_SCALED) {
+		if (texelsScaledThisFrame_ >= TEXCACHE_MAX_TEXELS_SCALED && !scaleOnGPU) {
 			entry->status |= TexCacheEntry::STATUS_TO_SCALE;
 			scaleFactor = 1;
 		} else {
@@ -562,6 +597,15 @@ void TextureCacheVulkan::BuildTexture(TexCacheEntry *const entry) {
 		actualFmt = ToVulkanFormat(replaced.Format(0));
 	}
 
+	// DXT can go to the GPU almost as is, when we don't need the decoded texels for anything.
+	bool fakeMipmap = IsFakeMipmapChange() && gstate.getTexLevelOffset16() >= 16;
+	VkFormat compressedFmt = VK_FORMAT_UNDEFINED;
+	if (scaleFactor == 1 && !replaced.Valid() && !replacer_.Enabled() && !fakeMipmap) {
+		compressedFmt = GetCompressedFormat(GETextureFormat(entry->format));
+		if (compressedFmt != VK_FORMAT_UNDEFINED)
+			actualFmt = compressedFmt;
+	}
+
 	{
 		delete entry->vkTex;
 		entry->vkTex = new CachedTextureVulkan();
@@ -587,7 +631,10 @@ void TextureCacheVulkan::BuildTexture(TexCacheEntry *const entry) {
 			break;
 		}
 
-		bool allocSuccess = image->CreateDirect(cmdInit, w * scaleFactor, h * scaleFactor, maxLevel + 1, actualFmt, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, mapping);
+		VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		if (scaleOnGPU)
+			usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+		bool allocSuccess = image->CreateDirect(cmdInit, w * scaleFactor, h * scaleFactor, maxLevel + 1, actualFmt, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, usage, mapping);
 		if (!allocSuccess && !lowMemoryMode_) {
 			WARN_LOG_REPORT(G3D, "Texture cache ran out of GPU memory; switching to low memory mode");
 			lowMemoryMode_ = true;
@@ -604,7 +651,8 @@ void TextureCacheVulkan::BuildTexture(TexCacheEntry *const entry) {
 			}
 
 			scaleFactor = 1;
-			actualFmt = dstFmt;
+			scaleOnGPU = false;
+			actualFmt = compressedFmt != VK_FORMAT_UNDEFINED ? compressedFmt : dstFmt;
 
 			allocSuccess = image->CreateDirect(cmdInit, w * scaleFactor, h * scaleFactor, maxLevel + 1, actualFmt, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, mapping);
 		}
@@ -619,7 +667,7 @@ void TextureCacheVulkan::BuildTexture(TexCacheEntry *const entry) {
 
 	ReplacedTextureDecodeInfo replacedInfo;
 	if (replacer_.Enabled() && !replaced.Valid()) {
-		replacedInfo.cachekey = cachekey;
+		replacedInfo.cachekey = entry->CacheKey();
 		replacedInfo.hash = entry->fullhash;
 		replacedInfo.addr = entry->addr;
 		replacedInfo.isVideo = videos_.find(entry->addr & 0x3FFFFFFF) != videos_.end();
@@ -631,9 +679,13 @@ void TextureCacheVulkan::BuildTexture(TexCacheEntry *const entry) {
 	if (entry->vkTex) {
 		// NOTE: Since the level is not part of the cache key, we assume it never changes.
 		u8 level = std::max(0, gstate.getTexLevelOffset16() / 16);
-		bool fakeMipmap = IsFakeMipmapChange() && level > 0;
+		// When scaling, maxLevel is 0, so this is the only level.
+		bool scaledOnGPU = scaleOnGPU && !fakeMipmap && ScaleTextureOnGPU(*entry, cmdInit, scaleFactor);
+		for (int i = 0; i <= maxLevel && compressedFmt != VK_FORMAT_UNDEFINED; i++) {
+			LoadCompressedLevel(*entry, cmdInit, i);
+		}
 		// Upload the texture data.
-		for (int i = 0; i <= maxLevel; i++) {
+		for (int i = 0; i <= maxLevel && !scaledOnGPU && compressedFmt == VK_FORMAT_UNDEFINED; i++) {
 			int mipWidth = gstate.getTextureWidth(i) * scaleFactor;
 			int mipHeight = gstate.getTextureHeight(i) * scaleFactor;
 			if (replaced.Valid()) {
@@ -642,6 +694,14 @@ void TextureCacheVulkan::BuildTexture(TexCacheEntry *const entry) {
 			int bpp = actualFmt == VULKAN_8888_FORMAT ? 4 : 2;
 			int stride = (mipWidth * bpp + 15) & ~15;
 			int size = stride * mipHeight;
+			int rowLength = stride / bpp;
+			if (replaced.Valid() && replaced.IsCompressed(i)) {
+				// Rows of 4x4 blocks, the row length is still in texels.
+				int blockSize = replaced.Format(i) == ReplacedTextureFormat::F_BC1 ? 8 : 16;
+				stride = ((mipWidth + 3) / 4) * blockSize;
+				size = stride * ((mipHeight + 3) / 4);
+				rowLength = ((mipWidth + 3) / 4) * 4;
+			}
 			uint32_t bufferOffset;
 			VkBuffer texBuf;
 			// nvidia returns 1 but that can't be healthy... let's align by 16 as a minimum.
@@ -652,7 +712,7 @@ void TextureCacheVulkan::BuildTexture(TexCacheEntry *const entry) {
 			} else {
 				if (fakeMipmap) {
 					LoadTextureLevel(*entry, (uint8_t *)data, stride, level, scaleFactor, dstFmt);
-					entry->vkTex->texture_->UploadMip(cmdInit, 0, mipWidth, mipHeight, texBuf, bufferOffset, stride / bpp);
+					entry->vkTex->texture_->UploadMip(cmdInit, 0, mipWidth, mipHeight, texBuf, bufferOffset, rowLength);
 					break;
 				} else {
 					LoadTextureLevel(*entry, (uint8_t *)data, stride, i, scaleFactor, dstFmt);
@@ -661,7 +721,7 @@ void TextureCacheVulkan::BuildTexture(TexCacheEntry *const entry) {
 					replacer_.NotifyTextureDecoded(replacedInfo, data, stride, i, mipWidth, mipHeight);
 				}
 			}
-			entry->vkTex->texture_->UploadMip(cmdInit, i, mipWidth, mipHeight, texBuf, bufferOffset, stride / bpp);
+			entry->vkTex->texture_->UploadMip(cmdInit, i, mipWidth, mipHeight, texBuf, bufferOffset, rowLength);
 		}
 
 		if (maxLevel == 0) {
@@ -672,12 +732,62 @@ void TextureCacheVulkan::BuildTexture(TexCacheEntry *const entry) {
 		if (replaced.Valid()) {
 			entry->SetAlphaStatus(TexCacheEntry::TexStatus(replaced.AlphaStatus()));
 		}
-		entry->vkTex->texture_->EndCreate(cmdInit);
+		SetTexMemoryUsage(entry, w * scaleFactor, h * scaleFactor, maxLevel + 1, VulkanFormatBitsPerPixel(actualFmt));
+		// The compute scaler already transitioned the image for sampling.
+		if (!scaledOnGPU) {
+			entry->vkTex->texture_->EndCreate(cmdInit);
+		}
 	}
 
 	gstate_c.SetTextureFullAlpha(entry->GetAlphaStatus() == TexCacheEntry::STATUS_ALPHA_FULL);
 }
 
+VkFormat TextureCacheVulkan::GetCompressedFormat(GETextureFormat format) const {
+	if (!vulkan_->GetFeaturesEnabled().textureCompressionBC)
+		return VK_FORMAT_UNDEFINED;
+	switch (format) {
+	case GE_TFMT_DXT1:
+		return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+	case GE_TFMT_DXT3:
+		return VK_FORMAT_BC2_UNORM_BLOCK;
+	case GE_TFMT_DXT5:
+		return VK_FORMAT_BC3_UNORM_BLOCK;
+	default:
+		return VK_FORMAT_UNDEFINED;
+	}
+}
+
+void TextureCacheVulkan::LoadCompressedLevel(TexCacheEntry &entry, VkCommandBuffer cmd, int level) {
+	int w = gstate.getTextureWidth(level);
+	int h = gstate.getTextureHeight(level);
+	GETextureFormat tfmt = (GETextureFormat)entry.format;
+	u32 texaddr = gstate.getTextureAddress(level);
+	int bufw = GetTextureBufw(level, texaddr, tfmt);
+
+	int blockSize = tfmt == GE_TFMT_DXT1 ? 8 : 16;
+	int blocksW = (w + 3) / 4;
+	int blocksH = (h + 3) / 4;
+	int stride = blocksW * blockSize;
+	uint32_t bufferOffset;
+	VkBuffer texBuf;
+	int pushAlignment = std::max(16, (int)vulkan_->GetPhysicalDeviceProperties().limits.optimalBufferCopyOffsetAlignment);
+	void *data = drawEngine_->GetPushBufferForTextureData()->PushAligned(stride * blocksH, &bufferOffset, &texBuf, pushAlignment);
+
+	{
+		PROFILE_THIS_SCOPE("decodetex");
+		CheckAlphaResult alpha = ConvertDXTLevelToBC((u8 *)data, stride, tfmt, texaddr, level, bufw);
+		gpuStats.numTexturesDecoded++;
+		if ((entry.status & TexCacheEntry::STATUS_CHANGE_FREQUENT) == 0) {
+			entry.SetAlphaStatus((TexCacheEntry::TexStatus)alpha, level);
+		} else {
+			entry.SetAlphaStatus(TexCacheEntry::STATUS_ALPHA_UNKNOWN);
+		}
+	}
+
+	// Row length is in texels, and has to be whole blocks.
+	entry.vkTex->texture_->UploadMip(cmd, level, w, h, texBuf, bufferOffset, blocksW * 4);
+}
+
 VkFormat TextureCacheVulkan::GetDestFormat(GETextureFormat format, GEPaletteFormat clutFormat) const {
 	switch (format) {
 	case GE_TFMT_CLUT4:
@@ -759,7 +869,7 @@ void TextureCacheVulkan::LoadTextureLevel(TexCacheEntry &entry, uint8_t *writePt
 
 		if (scaleFactor > 1) {
 			u32 fmt = dstFmt;
-			scaler.ScaleAlways((u32 *)writePtr, pixelData, fmt, w, h, scaleFactor);
+			scaler.ScaleAlways((u32 *)writePtr, pixelData, fmt, w, h, scaleFactor, entry.ContentKey());
 			pixelData = (u32 *)writePtr;
 			dstFmt = (VkFormat)fmt;
 
@@ -780,6 +890,36 @@ void TextureCacheVulkan::LoadTextureLevel(TexCacheEntry &entry, uint8_t *writePt
 	}
 }
 
+bool TextureCacheVulkan::ScaleTextureOnGPU(TexCacheEntry &entry, VkCommandBuffer cmd, int scaleFactor) {
+	int w = gstate.getTextureWidth(0);
+	int h = gstate.getTextureHeight(0);
+
+	// The compute shader reads the unscaled texels right out of the push buffer, so decode there as 8888.
+	uint32_t bufferOffset;
+	VkBuffer texBuf;
+	int alignment = std::max(computeScaler_.SourceAlignment(), (int)vulkan_->GetPhysicalDeviceProperties().limits.optimalBufferCopyOffsetAlignment);
+	u32 *pixelData = (u32 *)drawEngine_->GetPushBufferForTextureData()->PushAligned(w * h * sizeof(u32), &bufferOffset, &texBuf, alignment);
+
+	{
+		PROFILE_THIS_SCOPE("decodetex");
+
+		GETextureFormat tfmt = (GETextureFormat)entry.format;
+		u32 texaddr = gstate.getTextureAddress(0);
+		int bufw = GetTextureBufw(0, texaddr, tfmt);
+		DecodeTextureLevel((u8 *)pixelData, w * sizeof(u32), tfmt, gstate.getClutPaletteFormat(), texaddr, 0, bufw, false, false, true);
+		gpuStats.numTexturesDecoded++;
+	}
+
+	if ((entry.status & TexCacheEntry::STATUS_CHANGE_FREQUENT) == 0) {
+		entry.SetAlphaStatus(CheckAlpha(pixelData, VULKAN_8888_FORMAT, w, w, h), 0);
+	} else {
+		entry.SetAlphaStatus(TexCacheEntry::STATUS_ALPHA_UNKNOWN);
+	}
+
+	VulkanTexture *image = entry.vkTex->texture_;
+	return computeScaler_.Scale(cmd, texBuf, bufferOffset, w, h, image->GetImage(), image->GetImageView(), scaleFactor);
+}
+
 bool TextureCacheVulkan::GetCurrentTextureDebug(GPUDebugBuffer &buffer, int level) {
 	SetTexture(false);
 	if (!nextTexture_)
@@ -807,6 +947,19 @@ bool TextureCacheVulkan::GetCurrentTextureDebug(GPUDebugBuffer &buffer, int leve
 	VulkanTexture *texture = entry->vkTex->texture_;
 	VulkanRenderManager *renderManager = (VulkanRenderManager *)draw_->GetNativeObject(Draw::NativeObject::RENDER_MANAGER);
 
+	if (GetCompressedFormat(GETextureFormat(entry->format)) == texture->GetFormat()) {
+		// Can't read back BCn as pixels, so just decode it again.
+		int w = gstate.getTextureWidth(level);
+		int h = gstate.getTextureHeight(level);
+		GETextureFormat tfmt = (GETextureFormat)entry->format;
+		u32 texaddr = gstate.getTextureAddress(level);
+		int bufw = GetTextureBufw(level, texaddr, tfmt);
+		// DXT decodes in whole blocks, so pad the buffer to fit.
+		buffer.Allocate((w + 3) & ~3, (h + 3) & ~3, GPU_DBG_FORMAT_8888);
+		DecodeTextureLevel(buffer.GetData(), ((w + 3) & ~3) * sizeof(u32), tfmt, gstate.getClutPaletteFormat(), texaddr, level, bufw, false, false, false);
+		return true;
+	}
+
 	GPUDebugBufferFormat bufferFormat;
 	Draw::DataFormat drawFormat;
 	switch (texture->GetFormat()) {
@@ -124,7 +124,10 @@ class TextureCacheVulkan : public TextureCacheCommon {
 
 private:
 	void LoadTextureLevel(TexCacheEntry &entry, uint8_t *writePtr, int rowPitch,  int level, int scaleFactor, VkFormat dstFmt);
+	bool ScaleTextureOnGPU(TexCacheEntry &entry, VkCommandBuffer cmd, int scaleFactor);
 	VkFormat GetDestFormat(GETextureFormat format, GEPaletteFormat clutFormat) const;
+	VkFormat GetCompressedFormat(GETextureFormat format) const;
+	void LoadCompressedLevel(TexCacheEntry &entry, VkCommandBuffer cmd, int level);
 	TexCacheEntry::TexStatus CheckAlpha(const u32 *pixelData, VkFormat dstFmt, int stride, int w, int h);
 	void UpdateCurrentClut(GEPaletteFormat clutFormat, u32 clutBase, bool clutIndexIsSimple) override;
 
@@ -138,6 +141,7 @@ class TextureCacheVulkan : public TextureCacheCommon {
 	SamplerCache samplerCache_;
 
 	TextureScalerVulkan scaler;
+	TextureScalerVulkanCompute computeScaler_;
 
 	CachedTextureVulkan *lastBoundTexture = nullptr;
 
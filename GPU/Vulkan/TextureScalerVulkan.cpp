@@ -26,8 +26,10 @@
 #include "Common/ColorConv.h"
 #include "Common/Log.h"
 #include "Common/ThreadPools.h"
+#include "Core/Config.h"
 #include "GPU/Common/TextureScalerCommon.h"
 #include "GPU/Vulkan/TextureScalerVulkan.h"
+#include "GPU/Vulkan/VulkanUtil.h"
 
 // TODO: Share in TextureCacheVulkan.h?
 // Note: some drivers prefer B4G4R4A4_UNORM_PACK16 over R4G4B4A4_UNORM_PACK16.
@@ -51,15 +53,15 @@ void TextureScalerVulkan::ConvertTo8888(u32 format, u32* source, u32* &dest, int
 		break;
 
 	case VULKAN_4444_FORMAT:
-		GlobalThreadPool::Loop(std::bind(&convert4444_dx9, (u16*)source, dest, width, std::placeholders::_1, std::placeholders::_2), 0, height);
+		GlobalThreadPool::Loop(std::bind(&convert4444_dx9, (u16*)source, dest, width, std::placeholders::_1, std::placeholders::_2), 0, height, MIN_CONVERT_ROWS);
 		break;
 
 	case VULKAN_565_FORMAT:
-		GlobalThreadPool::Loop(std::bind(&convert565_dx9, (u16*)source, dest, width, std::placeholders::_1, std::placeholders::_2), 0, height);
+		GlobalThreadPool::Loop(std::bind(&convert565_dx9, (u16*)source, dest, width, std::placeholders::_1, std::placeholders::_2), 0, height, MIN_CONVERT_ROWS);
 		break;
 
 	case VULKAN_1555_FORMAT:
-		GlobalThreadPool::Loop(std::bind(&convert5551_dx9, (u16*)source, dest, width, std::placeholders::_1, std::placeholders::_2), 0, height);
+		GlobalThreadPool::Loop(std::bind(&convert5551_dx9, (u16*)source, dest, width, std::placeholders::_1, std::placeholders::_2), 0, height, MIN_CONVERT_ROWS);
 		break;
 
 	default:
@@ -67,3 +69,235 @@ void TextureScalerVulkan::ConvertTo8888(u32 format, u32* source, u32* &dest, int
 		ERROR_LOG(G3D, "iXBRZTexScaling: unsupported texture format");
 	}
 }
+
+// Same radial Mitchell-Netravali filter (B = C = 0.334) over a 5x5 footprint as the CPU
+// bicubic scaler in TextureScalerCommon, so the results match closely.
+static const char bicubic_cs[] = R"(#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+layout (local_size_x = 8, local_size_y = 8, local_size_z = 1) in;
+layout (std430, set = 0, binding = 0) readonly buffer Source { uint texels[]; } src;
+layout (rgba8, set = 0, binding = 1) uniform writeonly image2D dst;
+layout (push_constant) uniform Params { ivec4 size; } params;
+
+float mitchell(float x) {
+	const float B = 0.334;
+	const float C = 0.334;
+	if (x >= 2.0) return 0.0;
+	if (x >= 1.0) return ((-B - 6.0 * C) * (x * x * x) + (6.0 * B + 30.0 * C) * (x * x) + (-12.0 * B - 48.0 * C) * x + (8.0 * B + 24.0 * C)) / 6.0;
+	return ((12.0 - 9.0 * B - 6.0 * C) * (x * x * x) + (-18.0 + 12.0 * B + 6.0 * C) * (x * x) + (6.0 - 2.0 * B)) / 6.0;
+}
+
+void main() {
+	int width = params.size.x;
+	int height = params.size.y;
+	int factor = params.size.z;
+	ivec2 pos = ivec2(gl_GlobalInvocationID.xy);
+	if (pos.x >= width * factor || pos.y >= height * factor)
+		return;
+
+	ivec2 center = pos / factor;
+	vec2 sub = (vec2(pos - center * factor) + 0.5) / float(factor);
+	ivec2 maxPos = ivec2(width - 1, height - 1);
+	vec4 sum = vec4(0.0);
+	float weightSum = 0.0;
+	for (int sy = -2; sy <= 2; ++sy) {
+		for (int sx = -2; sx <= 2; ++sx) {
+			float weight = mitchell(length(sub - (vec2(sx, sy) + 0.5)));
+			ivec2 s = clamp(center + ivec2(sx, sy), ivec2(0), maxPos);
+			sum += weight * unpackUnorm4x8(src.texels[s.y * width + s.x]);
+			weightSum += weight;
+		}
+	}
+	// The CPU version rounds up. Allow a little slack so exact values (flat areas) don't creep up a step.
+	vec4 color = clamp(ceil(sum * (255.0 / weightSum) - 0.001), 0.0, 255.0) / 255.0;
+	imageStore(dst, pos, color);
+}
+)";
+
+TextureScalerVulkanCompute::~TextureScalerVulkanCompute() {
+	DestroyDeviceObjects();
+}
+
+void TextureScalerVulkanCompute::DeviceLost() {
+	DestroyDeviceObjects();
+}
+
+void TextureScalerVulkanCompute::DeviceRestore(VulkanContext *vulkan) {
+	vulkan_ = vulkan;
+	// Objects are created lazily, the first time we actually scale something.
+	failed_ = false;
+}
+
+bool TextureScalerVulkanCompute::InitDeviceObjects() {
+	VkDevice device = vulkan_->GetDevice();
+
+	// Note: R8G8B8A8_UNORM is required to support storage images, so no need to check the format.
+	VkDescriptorSetLayoutBinding bindings[2] = {};
+	bindings[0].descriptorCount = 1;
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	bindings[0].binding = 0;
+	bindings[1].descriptorCount = 1;
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	bindings[1].binding = 1;
+
+	VkDescriptorSetLayoutCreateInfo dsl = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
+	dsl.bindingCount = 2;
+	dsl.pBindings = bindings;
+	VkResult res = vkCreateDescriptorSetLayout(device, &dsl, nullptr, &descriptorSetLayout_);
+	if (res != VK_SUCCESS)
+		return false;
+
+	VkDescriptorPoolSize dpTypes[2];
+	dpTypes[0].descriptorCount = MAX_SETS_PER_FRAME;
+	dpTypes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	dpTypes[1].descriptorCount = MAX_SETS_PER_FRAME;
+	dpTypes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+
+	VkDescriptorPoolCreateInfo dp = { VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+	dp.maxSets = MAX_SETS_PER_FRAME;
+	dp.pPoolSizes = dpTypes;
+	dp.poolSizeCount = ARRAY_SIZE(dpTypes);
+	for (int i = 0; i < ARRAY_SIZE(descPool_); i++) {
+		res = vkCreateDescriptorPool(device, &dp, nullptr, &descPool_[i]);
+		if (res != VK_SUCCESS)
+			return false;
+	}
+
+	VkPushConstantRange push = {};
+	push.offset = 0;
+	push.size = 16;
+	push.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkPipelineLayoutCreateInfo pl = { VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
+	pl.pPushConstantRanges = &push;
+	pl.pushConstantRangeCount = 1;
+	pl.setLayoutCount = 1;
+	pl.pSetLayouts = &descriptorSetLayout_;
+	res = vkCreatePipelineLayout(device, &pl, nullptr, &pipelineLayout_);
+	if (res != VK_SUCCESS)
+		return false;
+
+	std::string error;
+	bicubicShader_ = CompileShaderModule(vulkan_, VK_SHADER_STAGE_COMPUTE_BIT, bicubic_cs, &error);
+	if (bicubicShader_ == VK_NULL_HANDLE)
+		return false;
+
+	VkComputePipelineCreateInfo pipe = { VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
+	pipe.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipe.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipe.stage.module = bicubicShader_;
+	pipe.stage.pName = "main";
+	pipe.layout = pipelineLayout_;
+	res = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipe, nullptr, &bicubicPipeline_);
+	if (res != VK_SUCCESS)
+		return false;
+
+	return true;
+}
+
+void TextureScalerVulkanCompute::DestroyDeviceObjects() {
+	VulkanDeleteList &del = vulkan_->Delete();
+	for (int i = 0; i < ARRAY_SIZE(descPool_); i++) {
+		if (descPool_[i] != VK_NULL_HANDLE)
+			del.QueueDeleteDescriptorPool(descPool_[i]);
+	}
+	if (bicubicPipeline_ != VK_NULL_HANDLE)
+		del.QueueDeletePipeline(bicubicPipeline_);
+	if (bicubicShader_ != VK_NULL_HANDLE)
+		del.QueueDeleteShaderModule(bicubicShader_);
+	if (pipelineLayout_ != VK_NULL_HANDLE)
+		del.QueueDeletePipelineLayout(pipelineLayout_);
+	if (descriptorSetLayout_ != VK_NULL_HANDLE)
+		del.QueueDeleteDescriptorSetLayout(descriptorSetLayout_);
+	initialized_ = false;
+}
+
+void TextureScalerVulkanCompute::BeginFrame() {
+	if (initialized_) {
+		vkResetDescriptorPool(vulkan_->GetDevice(), descPool_[vulkan_->GetCurFrame()], 0);
+	}
+}
+
+bool TextureScalerVulkanCompute::CanScale(int factor) {
+	if (!g_Config.bTexScalingGPU || failed_)
+		return false;
+	// Deposterize and the xBRZ variants are still only on the CPU.
+	if (g_Config.iTexScalingType != TextureScalerCommon::BICUBIC || g_Config.bTexDeposterize)
+		return false;
+	if (factor < 2 || factor > 5)
+		return false;
+
+	if (!initialized_) {
+		if (!InitDeviceObjects()) {
+			ERROR_LOG(G3D, "Failed to create compute texture scaler, falling back to CPU scaling");
+			DestroyDeviceObjects();
+			failed_ = true;
+			return false;
+		}
+		initialized_ = true;
+	}
+	return true;
+}
+
+int TextureScalerVulkanCompute::SourceAlignment() const {
+	return std::max(16, (int)vulkan_->GetPhysicalDeviceProperties().limits.minStorageBufferOffsetAlignment);
+}
+
+bool TextureScalerVulkanCompute::Scale(VkCommandBuffer cmd, VkBuffer srcBuf, uint32_t srcOffset, int w, int h, VkImage dstImage, VkImageView dstView, int factor) {
+	if (!initialized_)
+		return false;
+
+	VkDescriptorSet desc;
+	VkDescriptorSetAllocateInfo descAlloc = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+	descAlloc.descriptorPool = descPool_[vulkan_->GetCurFrame()];
+	descAlloc.descriptorSetCount = 1;
+	descAlloc.pSetLayouts = &descriptorSetLayout_;
+	if (vkAllocateDescriptorSets(vulkan_->GetDevice(), &descAlloc, &desc) != VK_SUCCESS) {
+		// Out of sets for this frame, let the CPU handle the rest.
+		return false;
+	}
+
+	VkDescriptorBufferInfo bufferInfo{};
+	bufferInfo.buffer = srcBuf;
+	bufferInfo.offset = srcOffset;
+	bufferInfo.range = (VkDeviceSize)w * h * sizeof(u32);
+
+	VkDescriptorImageInfo imageInfo{};
+	imageInfo.imageView = dstView;
+	imageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+	VkWriteDescriptorSet writes[2] = {};
+	writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	writes[0].dstSet = desc;
+	writes[0].dstBinding = 0;
+	writes[0].descriptorCount = 1;
+	writes[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	writes[0].pBufferInfo = &bufferInfo;
+	writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	writes[1].dstSet = desc;
+	writes[1].dstBinding = 1;
+	writes[1].descriptorCount = 1;
+	writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	writes[1].pImageInfo = &imageInfo;
+	vkUpdateDescriptorSets(vulkan_->GetDevice(), 2, writes, 0, nullptr);
+
+	TransitionImageLayout2(cmd, dstImage, 0, 1, VK_IMAGE_ASPECT_COLOR_BIT,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+
+	int32_t params[4] = { w, h, factor, 0 };
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, bicubicPipeline_);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout_, 0, 1, &desc, 0, nullptr);
+	vkCmdPushConstants(cmd, pipelineLayout_, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), params);
+	vkCmdDispatch(cmd, (w * factor + 7) / 8, (h * factor + 7) / 8, 1);
+
+	TransitionImageLayout2(cmd, dstImage, 0, 1, VK_IMAGE_ASPECT_COLOR_BIT,
+		VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+		VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+	return true;
+}
@@ -18,6 +18,7 @@
 #pragma once
 
 #include "Common/CommonTypes.h"
+#include "Common/Vulkan/VulkanContext.h"
 #include "GPU/Common/TextureScalerCommon.h"
 
 class TextureScalerVulkan : public TextureScalerCommon {
@@ -26,3 +27,43 @@ class TextureScalerVulkan : public TextureScalerCommon {
 	int BytesPerPixel(u32 format) override;
 	u32 Get8888Format() override;
 };
+
+// Upscales on the GPU using a compute shader, straight into the texture we're building.
+// Only bicubic is implemented, xBRZ and hybrid still go through TextureScalerVulkan.
+// The unscaled 8888 texels are read from a storage buffer (normally the texture push buffer.)
+class TextureScalerVulkanCompute {
+public:
+	TextureScalerVulkanCompute(VulkanContext *vulkan) : vulkan_(vulkan) {}
+	~TextureScalerVulkanCompute();
+
+	void DeviceLost();
+	void DeviceRestore(VulkanContext *vulkan);
+	void BeginFrame();
+
+	// Whether Scale() can handle this factor with the current settings.
+	bool CanScale(int factor);
+	// Alignment required for the source offset passed to Scale().
+	int SourceAlignment() const;
+
+	// dstImage must be an 8888 image created with STORAGE usage, currently in TRANSFER_DST_OPTIMAL.
+	// On success it's left in SHADER_READ_ONLY_OPTIMAL, ready to sample.  On failure nothing is recorded.
+	bool Scale(VkCommandBuffer cmd, VkBuffer srcBuf, uint32_t srcOffset, int w, int h, VkImage dstImage, VkImageView dstView, int factor);
+
+private:
+	bool InitDeviceObjects();
+	void DestroyDeviceObjects();
+
+	enum {
+		MAX_SETS_PER_FRAME = 128,
+	};
+
+	VulkanContext *vulkan_;
+	bool initialized_ = false;
+	bool failed_ = false;
+
+	VkDescriptorSetLayout descriptorSetLayout_ = VK_NULL_HANDLE;
+	VkPipelineLayout pipelineLayout_ = VK_NULL_HANDLE;
+	VkShaderModule bicubicShader_ = VK_NULL_HANDLE;
+	VkPipeline bicubicPipeline_ = VK_NULL_HANDLE;
+	VkDescriptorPool descPool_[VulkanContext::MAX_INFLIGHT_FRAMES]{};
+};
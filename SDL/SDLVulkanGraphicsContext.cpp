@@ -31,7 +31,8 @@ bool SDLVulkanGraphicsContext::Init(SDL_Window *&window, int x, int y, int mode,
 		return false;
 	}
 
-	int vulkanFlags = VULKAN_FLAG_PRESENT_MAILBOX;
+	int vulkanFlags = VulkanPresentModeFlags(g_Config.iVulkanPresentMode, VULKAN_FLAG_PRESENT_MAILBOX);
+	vulkan_->SetDesiredSwapchainImages(g_Config.iVulkanSwapchainImages);
 	// vulkanFlags |= VULKAN_FLAG_VALIDATE;
 	VulkanContext::CreateInfo info{};
 	info.app_name = "PPSSPP";
@@ -1,3 +1,4 @@
+#include <list>
 #include <string>
 #include <mutex>
 
@@ -6,6 +7,7 @@
 #include "file/chunk_file.h"
 
 #include "Common/CommonTypes.h"
+#include "Common/ThreadPools.h"
 #include "Core/HW/SimpleAudioDec.h"
 #include "Core/HLE/__sceAudio.h"
 #include "Common/FixedSizeQueue.h"
@@ -125,6 +127,11 @@ class AT3PlusReader {
 
 	bool IsOK() { return raw_data_ != 0; }
 
+	void Rewind() {
+		raw_offset_ = 0;
+		bgQueue.clear();
+	}
+
 	bool Read(int *buffer, int len) {
 		if (!raw_data_)
 			return false;
@@ -163,10 +170,27 @@ class AT3PlusReader {
 	SimpleAudio *decoder_;
 };
 
+// Parsing the file and setting up the decoder is done on a worker, and the last few
+// previews are kept around so going back and forth in the game list doesn't redo it.
+enum {
+	MAX_CACHED_PREVIEWS = 4,
+};
+
+struct CachedPreview {
+	std::string path;
+	AT3PlusReader *reader;
+};
+
 static std::mutex bgMutex;
 static std::string bgGamePath;
 static int playbackOffset;
 static AT3PlusReader *at3Reader;
+static std::string at3ReaderPath;
+static std::list<CachedPreview> previewCache;
+static TaskGroup previewLoading;
+static std::string previewLoadingPath;
+// Written by the worker, only read once previewLoading is done.
+static AT3PlusReader *previewLoaded;
 static double gameLastChanged;
 static double lastPlaybackTime;
 static int buffer[44100];
@@ -174,6 +198,35 @@ static bool fadingOut = true;
 static float volume;
 static float delta = -0.0001f;
 
+static void DeleteReader(AT3PlusReader *reader) {
+	reader->Shutdown();
+	delete reader;
+}
+
+static void CachePreview(const std::string &path, AT3PlusReader *reader) {
+	if (!reader->IsOK()) {
+		DeleteReader(reader);
+		return;
+	}
+	previewCache.push_front(CachedPreview{ path, reader });
+	if (previewCache.size() > MAX_CACHED_PREVIEWS) {
+		DeleteReader(previewCache.back().reader);
+		previewCache.pop_back();
+	}
+}
+
+static AT3PlusReader *TakeCachedPreview(const std::string &path) {
+	for (auto iter = previewCache.begin(); iter != previewCache.end(); ++iter) {
+		if (iter->path == path) {
+			AT3PlusReader *reader = iter->reader;
+			previewCache.erase(iter);
+			reader->Rewind();
+			return reader;
+		}
+	}
+	return nullptr;
+}
+
 static void ClearBackgroundAudio(bool hard) {
 	if (!hard) {
 		fadingOut = true;
@@ -181,13 +234,39 @@ static void ClearBackgroundAudio(bool hard) {
 		return;
 	}
 	if (at3Reader) {
-		at3Reader->Shutdown();
-		delete at3Reader;
+		CachePreview(at3ReaderPath, at3Reader);
 		at3Reader = nullptr;
+		at3ReaderPath.clear();
 	}
 	playbackOffset = 0;
 }
 
+// Called with bgMutex held. Returns true if a reader for the current game was picked up.
+static bool PollPreviewLoading() {
+	if (previewLoadingPath.empty() || !previewLoading.Done())
+		return false;
+
+	AT3PlusReader *reader = previewLoaded;
+	std::string path = previewLoadingPath;
+	previewLoaded = nullptr;
+	previewLoadingPath.clear();
+	if (path == bgGamePath && !at3Reader) {
+		at3Reader = reader;
+		at3ReaderPath = path;
+		return true;
+	}
+	CachePreview(path, reader);
+	return false;
+}
+
+static void StartPreviewLoading(std::shared_ptr<GameInfo> gameInfo, const std::string &path) {
+	previewLoadingPath = path;
+	GlobalThreadPool::Run(previewLoading, [gameInfo] {
+		std::lock_guard<std::mutex> guard(gameInfo->lock);
+		previewLoaded = new AT3PlusReader(gameInfo->sndFileData);
+	});
+}
+
 void SetBackgroundAudioGame(const std::string &path) {
 	time_update();
 
@@ -221,26 +300,33 @@ int PlayBackgroundAudio() {
 		return 0;
 	}
 
+	if (PollPreviewLoading())
+		lastPlaybackTime = 0.0;
+
 	// If there's a game, and some time has passed since the selected game
 	// last changed... (to prevent crazy amount of reads when skipping through a list)
 	if (!at3Reader && bgGamePath.size() && (time_now_d() - gameLastChanged > 0.5)) {
-		// Grab some audio from the current game and play it.
-		if (!g_gameInfoCache)
-			return 0;  // race condition?
-
-		std::shared_ptr<GameInfo> gameInfo = g_gameInfoCache->GetInfo(NULL, bgGamePath, GAMEINFO_WANTSND);
-		if (!gameInfo)
-			return 0;
-
-		if (gameInfo->pending) {
-			// Should try again shortly..
-			return 0;
-		}
-
-		if (gameInfo->sndFileData.size()) {
-			const std::string &data = gameInfo->sndFileData;
-			at3Reader = new AT3PlusReader(data);
+		at3Reader = TakeCachedPreview(bgGamePath);
+		if (at3Reader) {
+			at3ReaderPath = bgGamePath;
 			lastPlaybackTime = 0.0;
+		} else if (previewLoadingPath.empty()) {
+			// Grab some audio from the current game and play it.
+			if (!g_gameInfoCache)
+				return 0;  // race condition?
+
+			std::shared_ptr<GameInfo> gameInfo = g_gameInfoCache->GetInfo(NULL, bgGamePath, GAMEINFO_WANTSND);
+			if (!gameInfo)
+				return 0;
+
+			if (gameInfo->pending) {
+				// Should try again shortly..
+				return 0;
+			}
+
+			if (gameInfo->sndFileData.size()) {
+				StartPreviewLoading(gameInfo, bgGamePath);
+			}
 		}
 	}
 
@@ -25,18 +25,28 @@
 #include "ui/ui.h"
 #include "profiler/profiler.h"
 
+#include "Common/FileUtil.h"
 #include "Common/LogManager.h"
 #include "Common/CPUDetect.h"
+#include "Common/ColorConv.h"
+#include "Common/MemoryUtil.h"
 
 #include "Core/MemMap.h"
 #include "Core/Config.h"
 #include "Core/System.h"
 #include "Core/CoreParameter.h"
+#include "Core/Debugger/SamplingProfiler.h"
+#include "Core/ELF/ElfReader.h"
+#include "Core/FileLoaders/HTTPFileLoader.h"
 #include "Core/MIPS/MIPSTables.h"
 #include "Core/MIPS/JitCommon/JitBlockCache.h"
 #include "Core/MIPS/JitCommon/JitCommon.h"
+#include "Core/HLE/HLE.h"
+#include "Core/HLE/ReplaceTables.h"
+#include "Core/Util/AudioFormat.h"
 #include "GPU/GPUInterface.h"
 #include "GPU/GPUState.h"
+#include "GPU/Common/TextureDecoder.h"
 #include "UI/MiscScreens.h"
 #include "UI/DevScreens.h"
 #include "UI/GameSettingsScreen.h"
@@ -75,8 +85,10 @@ void DevMenu::CreatePopupContents(UI::ViewGroup *parent) {
 	items->Add(new Choice(dev->T("Toggle Freeze")))->OnClick.Handle(this, &DevMenu::OnFreezeFrame);
 	items->Add(new Choice(dev->T("Dump Frame GPU Commands")))->OnClick.Handle(this, &DevMenu::OnDumpFrame);
 	items->Add(new Choice(dev->T("Toggle Audio Debug")))->OnClick.Handle(this, &DevMenu::OnToggleAudioDebug);
+	items->Add(new Choice(dev->T("Toggle Guest Function Profiler")))->OnClick.Handle(this, &DevMenu::OnToggleGuestProfiler);
 #ifdef USE_PROFILER
 	items->Add(new CheckBox(&g_Config.bShowFrameProfiler, dev->T("Frame Profiler"), ""));
+	items->Add(new Choice(dev->T("Toggle Timeline Trace")))->OnClick.Handle(this, &DevMenu::OnToggleTrace);
 #endif
 
 	scroll->Add(items);
@@ -141,6 +153,35 @@ UI::EventReturn DevMenu::OnDumpFrame(UI::EventParams &e) {
 	return UI::EVENT_DONE;
 }
 
+UI::EventReturn DevMenu::OnToggleGuestProfiler(UI::EventParams &e) {
+	if (SamplingProfiler::IsRunning()) {
+		SamplingProfiler::Stop();
+		const std::string dumpDir = GetSysDirectory(DIRECTORY_DUMP);
+		File::CreateFullPath(dumpDir);
+		const std::string filename = dumpDir + "/guestprofile.txt";
+		if (SamplingProfiler::WriteReport(filename))
+			NOTICE_LOG(SYSTEM, "Guest function profile written to %s", filename.c_str());
+	} else {
+		SamplingProfiler::Start();
+	}
+	return UI::EVENT_DONE;
+}
+
+UI::EventReturn DevMenu::OnToggleTrace(UI::EventParams &e) {
+#ifdef USE_PROFILER
+	if (Profiler_IsTracing()) {
+		const std::string dumpDir = GetSysDirectory(DIRECTORY_DUMP);
+		File::CreateFullPath(dumpDir);
+		const std::string filename = dumpDir + "/trace.json";
+		if (Profiler_WriteTrace(filename.c_str()))
+			NOTICE_LOG(SYSTEM, "Timeline trace written to %s", filename.c_str());
+	} else {
+		Profiler_SetTracing(true);
+	}
+#endif
+	return UI::EVENT_DONE;
+}
+
 void DevMenu::dialogFinished(const Screen *dialog, DialogResult result) {
 	UpdateUIState(UISTATE_INGAME);
 	// Close when a subscreen got closed.
@@ -382,6 +423,9 @@ void SystemInfoScreen::CreateViews() {
 	std::string cores = StringFromFormat(si->T("%d (%d per core, %d cores)"), totalThreads, cpu_info.logical_cpu_count, cpu_info.num_cores);
 	deviceSpecs->Add(new InfoItem(si->T("Threads"), cores));
 #endif
+	deviceSpecs->Add(new InfoItem(si->T("Color conversion"), GetColorConvVariant()));
+	deviceSpecs->Add(new InfoItem(si->T("Texture decoding"), GetTextureDecoderVariant()));
+	deviceSpecs->Add(new InfoItem(si->T("Audio conversion"), GetAudioFormatVariant()));
 	deviceSpecs->Add(new ItemHeader(si->T("GPU Information")));
 
 	DrawContext *draw = screenManager()->getDrawContext();
@@ -457,6 +501,26 @@ void SystemInfoScreen::CreateViews() {
 	deviceSpecs->Add(new InfoItem("Moga", moga));
 #endif
 
+	deviceSpecs->Add(new ItemHeader(si->T("Memory")));
+	auto formatMB = [](uint64_t bytes) {
+		return bytes == 0 ? std::string("?") : StringFromFormat("%0.1f MB", bytes / (1024.0 * 1024.0));
+	};
+	deviceSpecs->Add(new InfoItem(si->T("Device RAM"), formatMB(GetPhysicalMemoryBytes())));
+	deviceSpecs->Add(new InfoItem(si->T("Resident"), formatMB(GetResidentMemoryBytes())));
+	deviceSpecs->Add(new InfoItem(si->T("Low memory mode"), g_Config.bLowMemoryMode ? si->T("On") : si->T("Off")));
+	deviceSpecs->Add(new InfoItem(si->T("Texture cache"), StringFromFormat("%0.1f MB", gpuStats.textureCacheBytes / (1024.0 * 1024.0))));
+	deviceSpecs->Add(new InfoItem(si->T("Relocated module cache"), StringFromFormat("%0.1f MB", ElfReader::RelocatedImagesBytes() / (1024.0 * 1024.0))));
+	deviceSpecs->Add(new InfoItem(si->T("Emulated RAM"), StringFromFormat("%d MB", (int)(Memory::g_MemorySize / (1024 * 1024)))));
+
+	HTTPFileLoader::Stats remoteStats = HTTPFileLoader::GetStats();
+	if (remoteStats.requests != 0) {
+		deviceSpecs->Add(new ItemHeader(si->T("Remote ISO")));
+		deviceSpecs->Add(new InfoItem(si->T("Requests"), StringFromFormat("%llu", (unsigned long long)remoteStats.requests)));
+		double throughput = remoteStats.busySeconds > 0.0 ? remoteStats.bytes / remoteStats.busySeconds : 0.0;
+		deviceSpecs->Add(new InfoItem(si->T("Throughput"), StringFromFormat("%0.1f KB/s", throughput / 1024.0)));
+		deviceSpecs->Add(new InfoItem(si->T("Average latency"), StringFromFormat("%0.1f ms", remoteStats.latencySeconds * 1000.0 / remoteStats.requests)));
+	}
+
 	ViewGroup *buildConfigScroll = new ScrollView(ORIENT_VERTICAL, new LinearLayoutParams(FILL_PARENT, FILL_PARENT));
 	buildConfigScroll->SetTag("DevSystemInfoBuildConfig");
 	LinearLayout *buildConfig = new LinearLayout(ORIENT_VERTICAL);
@@ -791,6 +855,17 @@ UI::EventReturn JitCompareScreen::OnShowStats(UI::EventParams &e) {
 		}
 		ctr++;
 	}
+	NOTICE_LOG(JIT, "Invalidations: %d (%0.1f/sec), %d blocks destroyed", bcStats.numInvalidations, bcStats.invalidationsPerSec, bcStats.numInvalidatedBlocks);
+	for (auto iter : bcStats.passStats) {
+		NOTICE_LOG(JIT, "%s: %lld instructions removed", iter.first.c_str(), (long long)iter.second);
+	}
+	for (int i = 0; i < GetNumReplacementFuncs(); ++i) {
+		u32 hits = *GetReplacementHitCounter(i);
+		if (hits != 0) {
+			NOTICE_LOG(JIT, "Replacement %s: %u hits", GetReplacementFunc(i)->name, hits);
+		}
+	}
+	hleLogSyscallStats();
 	return UI::EVENT_DONE;
 }
 
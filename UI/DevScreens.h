@@ -45,6 +45,8 @@ class DevMenu : public PopupScreen {
 	UI::EventReturn OnDumpFrame(UI::EventParams &e);
 	UI::EventReturn OnDeveloperTools(UI::EventParams &e);
 	UI::EventReturn OnToggleAudioDebug(UI::EventParams &e);
+	UI::EventReturn OnToggleTrace(UI::EventParams &e);
+	UI::EventReturn OnToggleGuestProfiler(UI::EventParams &e);
 };
 
 class LogConfigScreen : public UIDialogScreenWithBackground {
@@ -56,6 +56,7 @@
 #include "Core/HLE/sceCtrl.h"
 #include "Core/HLE/sceDisplay.h"
 #include "Core/HLE/sceSas.h"
+#include "Core/Debugger/StatsServer.h"
 #include "Core/Debugger/SymbolMap.h"
 #include "Core/SaveState.h"
 #include "Core/MIPS/MIPS.h"
@@ -1025,7 +1026,7 @@ static void DrawAudioDebugStats(DrawBuffer *draw2d) {
 	char statbuf[1024] = { 0 };
 	const AudioDebugStats *stats = __AudioGetDebugStats();
 	snprintf(statbuf, sizeof(statbuf),
-		"Audio buffer: %d/%d (low watermark: %d)\n"
+		"Audio buffer: %d/%d (target fill: %d)\n"
 		"Underruns: %d\n"
 		"Overruns: %d\n"
 		"Sample rate: %d\n"
@@ -1132,7 +1133,7 @@ void EmuScreen::render() {
 		}
 	}
 
-	Core_UpdateDebugStats(g_Config.bShowDebugStats || g_Config.bLogFrameDrops);
+	Core_UpdateDebugStats(g_Config.bShowDebugStats || g_Config.bLogFrameDrops || StatsServerHasClients());
 
 	PSP_BeginHostFrame();
 
@@ -1140,9 +1141,20 @@ void EmuScreen::render() {
 	// The actual number of cycles doesn't matter so much here as we will break due to CORE_NEXTFRAME, most of the time hopefully...
 	int blockTicks = usToCycles(1000000 / 10);
 
-	// Run until CORE_NEXTFRAME
-	while (coreState == CORE_RUNNING) {
-		PSP_RunLoopFor(blockTicks);
+	if (g_Config.iRunAheadFrames > 0 && !runAheadFailed_ && !PSP_CoreParameter().frozen && coreState == CORE_RUNNING) {
+		if (!PSP_RunAheadFrame(g_Config.iRunAheadFrames, blockTicks)) {
+			WARN_LOG(SAVESTATE, "Run-ahead unavailable, can't snapshot state");
+			runAheadFailed_ = true;
+		}
+	} else {
+		if (SaveState::IsRunningAhead()) {
+			SaveState::StopRunAhead();
+		}
+
+		// Run until CORE_NEXTFRAME
+		while (coreState == CORE_RUNNING) {
+			PSP_RunLoopFor(blockTicks);
+		}
 	}
 
 	// Hopefully coreState is now CORE_NEXTFRAME
@@ -1191,6 +1203,7 @@ void EmuScreen::render() {
 void EmuScreen::renderUI() {
 	using namespace Draw;
 
+	double startTime = real_time_now();
 	DrawContext *thin3d = screenManager()->getDrawContext();
 	UIContext *ctx = screenManager()->getUIContext();
 	ctx->BeginFrame();
@@ -1237,6 +1250,7 @@ void EmuScreen::renderUI() {
 #endif
 
 	ctx->End();
+	ctx->AddRenderTime(real_time_now() - startTime);
 }
 
 void EmuScreen::autoLoad() {
@@ -88,6 +88,8 @@ class EmuScreen : public UIScreen {
 
 	// In-memory save state used for freezeFrame, which is useful for debugging.
 	std::vector<u8> freezeState_;
+	// Set once snapshots fail (e.g. with memory watches), so we stop trying until the next game.
+	bool runAheadFailed_ = false;
 
 	std::string tag_;
 
@@ -344,28 +344,286 @@ static bool ReadVFSToString(const char *filename, std::string *contents, std::mu
 	return data != nullptr;
 }
 
+// Loading is mostly waiting on storage, so a few in parallel helps a lot, especially on network shares.
+static const int GAMEINFO_WORKERS = 4;
+// Seconds since an on screen item was last drawn before its load is dropped.
+static const double GAMEINFO_CANCEL_AFTER = 0.5;
+
+static const u32 GAMEINFO_CACHE_MAGIC = 0x43475050;  // PPGC
+static const u32 GAMEINFO_CACHE_VERSION = 1;
+// Icons are normally a few KB, anything much bigger is probably garbage.
+static const u32 GAMEINFO_CACHE_MAX_ICON = 512 * 1024;
+
+// The part of a GameInfo the game list needs, kept between runs so it doesn't have to open every
+// ISO again.  Entries are keyed by path, size and modification time, so a changed file is just a miss.
+struct CachedGameInfo {
+	u64 size = 0;
+	u64 mtime = 0;
+	IdentifiedFileType fileType = IdentifiedFileType::UNKNOWN;
+	int region = -1;
+	int disc_total = 0;
+	int disc_number = 0;
+	std::string id;
+	std::string id_version;
+	std::string title;
+	std::string paramSFO;
+	// Empty when the game had no icon of its own, since screenshots used instead may change.
+	std::string icon;
+	// Where the icon is in the cache file, until it's read.
+	u32 iconOffset = 0;
+	u32 iconSize = 0;
+};
+
+// One file with an index of all entries up front, and icon data after it, read on demand.
+class GameInfoDiskCache {
+public:
+	bool Lookup(const std::string &path, const File::FileDetails &details, CachedGameInfo *out);
+	void Store(const std::string &path, const CachedGameInfo &entry);
+	void Save();
+
+private:
+	void Load();
+	bool ReadIcon(FILE *f, CachedGameInfo &entry);
+
+	std::mutex lock_;
+	std::map<std::string, CachedGameInfo> entries_;
+	std::string filename_;
+	bool loaded_ = false;
+	bool dirty_ = false;
+};
+
+static bool ReadCacheString(FILE *f, std::string *str) {
+	u32 len;
+	if (fread(&len, sizeof(len), 1, f) != 1 || len > GAMEINFO_CACHE_MAX_ICON) {
+		return false;
+	}
+	str->resize(len);
+	return len == 0 || fread(&(*str)[0], 1, len, f) == len;
+}
+
+static void WriteCacheString(FILE *f, const std::string &str) {
+	u32 len = (u32)str.size();
+	fwrite(&len, sizeof(len), 1, f);
+	fwrite(str.data(), 1, len, f);
+}
+
+void GameInfoDiskCache::Load() {
+	loaded_ = true;
+	filename_ = GetSysDirectory(DIRECTORY_APP_CACHE) + "/gameinfo.ppgc";
+
+	FILE *f = File::OpenCFile(filename_, "rb");
+	if (!f) {
+		return;
+	}
+
+	u32 header[3];
+	if (fread(header, sizeof(u32), 3, f) != 3 || header[0] != GAMEINFO_CACHE_MAGIC || header[1] != GAMEINFO_CACHE_VERSION) {
+		WARN_LOG(LOADER, "Ignoring invalid game info cache %s", filename_.c_str());
+		fclose(f);
+		return;
+	}
+
+	for (u32 i = 0; i < header[2]; ++i) {
+		std::string path;
+		CachedGameInfo entry;
+		u64 key[2];
+		s32 fields[4];
+		u32 iconPos[2];
+		bool success = ReadCacheString(f, &path) && fread(key, sizeof(u64), 2, f) == 2 && fread(fields, sizeof(s32), 4, f) == 4;
+		success = success && ReadCacheString(f, &entry.id) && ReadCacheString(f, &entry.id_version) && ReadCacheString(f, &entry.title);
+		success = success && ReadCacheString(f, &entry.paramSFO) && fread(iconPos, sizeof(u32), 2, f) == 2;
+		if (!success) {
+			// Keep what we got, the rest will just be loaded again.
+			WARN_LOG(LOADER, "Game info cache %s was truncated", filename_.c_str());
+			dirty_ = true;
+			break;
+		}
+
+		entry.size = key[0];
+		entry.mtime = key[1];
+		entry.fileType = (IdentifiedFileType)fields[0];
+		entry.region = fields[1];
+		entry.disc_total = fields[2];
+		entry.disc_number = fields[3];
+		entry.iconOffset = iconPos[0];
+		entry.iconSize = std::min(iconPos[1], GAMEINFO_CACHE_MAX_ICON);
+		entries_[path] = std::move(entry);
+	}
+	fclose(f);
+	INFO_LOG(LOADER, "Loaded %d cached game infos", (int)entries_.size());
+}
+
+bool GameInfoDiskCache::ReadIcon(FILE *f, CachedGameInfo &entry) {
+	if (entry.iconSize == 0) {
+		return true;
+	}
+	if (!f || fseek(f, entry.iconOffset, SEEK_SET) != 0) {
+		return false;
+	}
+	entry.icon.resize(entry.iconSize);
+	if (fread(&entry.icon[0], 1, entry.iconSize, f) != entry.iconSize) {
+		entry.icon.clear();
+		return false;
+	}
+	entry.iconSize = 0;
+	return true;
+}
+
+bool GameInfoDiskCache::Lookup(const std::string &path, const File::FileDetails &details, CachedGameInfo *out) {
+	std::lock_guard<std::mutex> guard(lock_);
+	if (!loaded_) {
+		Load();
+	}
+
+	auto it = entries_.find(path);
+	if (it == entries_.end()) {
+		return false;
+	}
+	CachedGameInfo &entry = it->second;
+	if (entry.size != details.size || entry.mtime != details.mtime) {
+		return false;
+	}
+
+	if (entry.iconSize != 0) {
+		FILE *f = File::OpenCFile(filename_, "rb");
+		bool success = ReadIcon(f, entry);
+		if (f) {
+			fclose(f);
+		}
+		if (!success) {
+			entries_.erase(it);
+			dirty_ = true;
+			return false;
+		}
+	}
+
+	*out = entry;
+	return true;
+}
+
+void GameInfoDiskCache::Store(const std::string &path, const CachedGameInfo &entry) {
+	std::lock_guard<std::mutex> guard(lock_);
+	if (!loaded_) {
+		Load();
+	}
+	entries_[path] = entry;
+	entries_[path].iconSize = 0;
+	dirty_ = true;
+}
+
+void GameInfoDiskCache::Save() {
+	std::lock_guard<std::mutex> guard(lock_);
+	if (!dirty_) {
+		return;
+	}
+
+	// Icons we haven't needed yet are still only in the old file, since we're about to overwrite it.
+	FILE *f = File::OpenCFile(filename_, "rb");
+	for (auto it = entries_.begin(); it != entries_.end(); ) {
+		if (!ReadIcon(f, it->second)) {
+			it = entries_.erase(it);
+		} else {
+			++it;
+		}
+	}
+	if (f) {
+		fclose(f);
+	}
+
+	File::CreateFullPath(GetSysDirectory(DIRECTORY_APP_CACHE));
+	f = File::OpenCFile(filename_, "wb");
+	if (!f) {
+		WARN_LOG(LOADER, "Unable to save game info cache %s", filename_.c_str());
+		return;
+	}
+
+	// All icons go after the index, so work out where it ends first.
+	size_t pos = sizeof(u32) * 3;
+	for (const auto &it : entries_) {
+		const CachedGameInfo &entry = it.second;
+		pos += sizeof(u32) * 5 + it.first.size() + entry.id.size() + entry.id_version.size() + entry.title.size() + entry.paramSFO.size();
+		pos += sizeof(u64) * 2 + sizeof(s32) * 4 + sizeof(u32) * 2;
+	}
+
+	const u32 header[3] = { GAMEINFO_CACHE_MAGIC, GAMEINFO_CACHE_VERSION, (u32)entries_.size() };
+	fwrite(header, sizeof(u32), 3, f);
+	for (const auto &it : entries_) {
+		const CachedGameInfo &entry = it.second;
+		const u64 key[2] = { entry.size, entry.mtime };
+		const s32 fields[4] = { (s32)entry.fileType, entry.region, entry.disc_total, entry.disc_number };
+		const u32 iconPos[2] = { (u32)pos, (u32)entry.icon.size() };
+		WriteCacheString(f, it.first);
+		fwrite(key, sizeof(u64), 2, f);
+		fwrite(fields, sizeof(s32), 4, f);
+		WriteCacheString(f, entry.id);
+		WriteCacheString(f, entry.id_version);
+		WriteCacheString(f, entry.title);
+		WriteCacheString(f, entry.paramSFO);
+		fwrite(iconPos, sizeof(u32), 2, f);
+		pos += entry.icon.size();
+	}
+	for (const auto &it : entries_) {
+		fwrite(it.second.icon.data(), 1, it.second.icon.size(), f);
+	}
+	fclose(f);
+	dirty_ = false;
+}
+
+static void ReadFallbackIcon(std::shared_ptr<GameInfo> &info) {
+	std::string screenshot_jpg = GetSysDirectory(DIRECTORY_SCREENSHOT) + info->id + "_00000.jpg";
+	std::string screenshot_png = GetSysDirectory(DIRECTORY_SCREENSHOT) + info->id + "_00000.png";
+	// Try using png/jpg screenshots first
+	if (File::Exists(screenshot_png))
+		readFileToString(false, screenshot_png.c_str(), info->icon.data);
+	else if (File::Exists(screenshot_jpg))
+		readFileToString(false, screenshot_jpg.c_str(), info->icon.data);
+	else
+		ReadVFSToString("unknown.png", &info->icon.data, &info->lock);
+}
 
 class GameInfoWorkItem : public PrioritizedWorkQueueItem {
 public:
-	GameInfoWorkItem(const std::string &gamePath, std::shared_ptr<GameInfo> &info)
-		: gamePath_(gamePath), info_(info) {
+	GameInfoWorkItem(const std::string &gamePath, std::shared_ptr<GameInfo> &info, GameInfoDiskCache *diskCache)
+		: gamePath_(gamePath), info_(info), diskCache_(diskCache) {
+		remote_ = startsWith(gamePath, "http://") || startsWith(gamePath, "https://");
 	}
 
 	~GameInfoWorkItem() override {
-		info_->DisposeFileLoader();
+		// Only close the file if we opened it, a canceled item never did.
+		if (ran_) {
+			info_->DisposeFileLoader();
+		}
 	}
 
 	void run() override {
-		if (!info_->LoadFromPath(gamePath_))
+		// An older item for the same game may still be running on another worker, wait it out.
+		// Marked working before it's no longer queued, so GetInfo always sees one or the other.
+		while (info_->working.exchange(true)) {
+			sleep_ms(1);
+		}
+		info_->queued = false;
+		ran_ = true;
+
+		if (!info_->LoadFromPath(gamePath_)) {
+			info_->working = false;
 			return;
+		}
 		// In case of a remote file, check if it actually exists before locking.
 		if (!info_->GetFileLoader()->Exists()) {
 			info_->pending = false;
+			info_->working = false;
+			return;
+		}
+
+		if (LoadFromDiskCache()) {
+			info_->hasConfig = g_Config.hasGameConfig(info_->id);
+			info_->pending = false;
+			info_->working = false;
 			return;
 		}
 
-		info_->working = true;
 		info_->fileType = Identify_File(info_->GetFileLoader().get());
+		bool iconFromGame = false;
 		switch (info_->fileType) {
 		case IdentifiedFileType::PSP_PBP:
 		case IdentifiedFileType::PSP_PBP_DIRECTORY:
@@ -409,6 +667,7 @@ class GameInfoWorkItem : public PrioritizedWorkQueueItem {
 				if (pbp.GetSubFileSize(PBP_ICON0_PNG) > 0) {
 					std::lock_guard<std::mutex> lock(info_->lock);
 					pbp.GetSubFileAsString(PBP_ICON0_PNG, &info_->icon.data);
+					iconFromGame = true;
 				} else {
 					std::string screenshot_jpg = GetSysDirectory(DIRECTORY_SCREENSHOT) + info_->id + "_00000.jpg";
 					std::string screenshot_png = GetSysDirectory(DIRECTORY_SCREENSHOT) + info_->id + "_00000.png";
@@ -592,6 +851,8 @@ class GameInfoWorkItem : public PrioritizedWorkQueueItem {
 						DEBUG_LOG(LOADER, "Loading unknown.png because no icon was found");
 						ReadVFSToString("unknown.png", &info_->icon.data, &info_->lock);
 					}
+				} else {
+					iconFromGame = true;
 				}
 				info_->icon.dataLoaded = true;
 				break;
@@ -636,38 +897,137 @@ class GameInfoWorkItem : public PrioritizedWorkQueueItem {
 			info_->installDataSize = info_->GetInstallDataSizeInBytes();
 		}
 
+		StoreToDiskCache(iconFromGame);
+
 		info_->pending = false;
 		info_->working = false;
 		// ILOG("Completed writing info for %s", info_->GetTitle().c_str());
 	}
 
 	float priority() override {
-		auto fl = info_->GetFileLoader();
-		if (fl && fl->IsRemote()) {
+		// Most recently drawn first.  Don't open the file here, this is called for every queued item.
+		if (remote_) {
 			// Increase the value so remote info loads after non-remote.
-			return info_->lastAccessedTime + 1000.0f;
+			return -info_->lastAccessedTime + 1000.0f;
+		}
+		return -info_->lastAccessedTime;
+	}
+
+	bool canceled() override {
+		// Game list buttons ask every frame while visible, so one that hasn't in a while scrolled away.
+		// GetInfo queues it again if it comes back.
+		if (info_->cancelable && time_now_d() - info_->lastAccessedTime > GAMEINFO_CANCEL_AFTER) {
+			info_->queued = false;
+			info_->loadCanceled = true;
+			return true;
 		}
-		return info_->lastAccessedTime;
+		return false;
 	}
 
 private:
+	// Only plain local game files are worth it, directories may change without their mtime changing.
+	bool UseDiskCache(File::FileDetails *details) {
+		if (!diskCache_ || !g_Config.bCacheGameInfo || info_->GetFileLoader()->IsRemote()) {
+			return false;
+		}
+		// These need the file itself, or other directories.
+		if (info_->wantFlags & (GAMEINFO_WANTBG | GAMEINFO_WANTSND | GAMEINFO_WANTSIZE)) {
+			return false;
+		}
+		return File::GetFileDetails(gamePath_, details) && !details->isDirectory;
+	}
+
+	bool LoadFromDiskCache() {
+		File::FileDetails details;
+		CachedGameInfo cached;
+		if (!UseDiskCache(&details) || !diskCache_->Lookup(gamePath_, details, &cached)) {
+			return false;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(info_->lock);
+			info_->fileType = cached.fileType;
+			if (!cached.paramSFO.empty()) {
+				info_->paramSFO.ReadSFO((const u8 *)cached.paramSFO.data(), cached.paramSFO.size());
+			}
+			info_->paramSFOLoaded = true;
+			info_->id = cached.id;
+			info_->id_version = cached.id_version;
+			info_->region = cached.region;
+			info_->disc_total = cached.disc_total;
+			info_->disc_number = cached.disc_number;
+			info_->icon.data = cached.icon;
+		}
+		info_->SetTitle(cached.title);
+		if (cached.icon.empty()) {
+			ReadFallbackIcon(info_);
+		}
+		info_->icon.dataLoaded = true;
+		return true;
+	}
+
+	void StoreToDiskCache(bool iconFromGame) {
+		switch (info_->fileType) {
+		case IdentifiedFileType::PSP_ISO:
+		case IdentifiedFileType::PSP_PBP:
+		case IdentifiedFileType::PSP_ELF:
+			break;
+		default:
+			return;
+		}
+
+		File::FileDetails details;
+		if (!UseDiskCache(&details)) {
+			return;
+		}
+
+		CachedGameInfo cached;
+		cached.size = details.size;
+		cached.mtime = details.mtime;
+		cached.title = info_->GetTitle();
+		{
+			std::lock_guard<std::mutex> lock(info_->lock);
+			cached.fileType = info_->fileType;
+			cached.region = info_->region;
+			cached.disc_total = info_->disc_total;
+			cached.disc_number = info_->disc_number;
+			cached.id = info_->id;
+			cached.id_version = info_->id_version;
+			u8 *sfoData = nullptr;
+			size_t sfoSize = 0;
+			if (info_->paramSFOLoaded && info_->fileType != IdentifiedFileType::PSP_ELF && info_->paramSFO.WriteSFO(&sfoData, &sfoSize)) {
+				cached.paramSFO.assign((const char *)sfoData, sfoSize);
+			}
+			delete [] sfoData;
+			if (iconFromGame && info_->icon.data.size() <= GAMEINFO_CACHE_MAX_ICON) {
+				cached.icon = info_->icon.data;
+			}
+		}
+		diskCache_->Store(gamePath_, cached);
+	}
+
 	std::string gamePath_;
 	std::shared_ptr<GameInfo> info_;
+	GameInfoDiskCache *diskCache_;
+	bool remote_;
+	bool ran_ = false;
 	DISALLOW_COPY_AND_ASSIGN(GameInfoWorkItem);
 };
 
-GameInfoCache::GameInfoCache() : gameInfoWQ_(nullptr) {
+GameInfoCache::GameInfoCache() : gameInfoWQ_(nullptr), diskCache_(new GameInfoDiskCache()) {
 	Init();
 }
 
 GameInfoCache::~GameInfoCache() {
 	Clear();
 	Shutdown();
+	delete diskCache_;
 }
 
 void GameInfoCache::Init() {
 	gameInfoWQ_ = new PrioritizedWorkQueue();
-	ProcessWorkQueueOnThreadWhile(gameInfoWQ_);
+	// Also the most files open at once for game info.
+	ProcessWorkQueueOnThreadWhile(gameInfoWQ_, GAMEINFO_WORKERS);
 }
 
 void GameInfoCache::Shutdown() {
@@ -688,6 +1048,7 @@ void GameInfoCache::Clear() {
 		gameInfoWQ_->WaitUntilDone();
 	}
 	info_.clear();
+	diskCache_->Save();
 }
 
 void GameInfoCache::CancelAll() {
@@ -741,11 +1102,17 @@ void GameInfoCache::WaitUntilDone(std::shared_ptr<GameInfo> &info) {
 // Runs on the main thread.
 std::shared_ptr<GameInfo> GameInfoCache::GetInfo(Draw::DrawContext *draw, const std::string &gamePath, int wantFlags) {
 	std::shared_ptr<GameInfo> info;
+	const bool onScreen = (wantFlags & GAMEINFO_ONSCREEN) != 0;
+	wantFlags &= ~GAMEINFO_ONSCREEN;
 
 	auto iter = info_.find(gamePath);
 	if (iter != info_.end()) {
 		info = iter->second;
 	}
+	if (info && !onScreen) {
+		// Someone might be waiting on this without asking again, so never cancel it.
+		info->cancelable = false;
+	}
 
 	// If wantFlags don't match, we need to start over.  We'll just queue the work item again.
 	if (info && (info->wantFlags & wantFlags) == wantFlags) {
@@ -759,12 +1126,20 @@ std::shared_ptr<GameInfo> GameInfoCache::GetInfo(Draw::DrawContext *draw, const
 			SetupTexture(info, draw, info->pic1);
 		}
 		info->lastAccessedTime = time_now_d();
+		if (info->loadCanceled && !info->queued && !info->working) {
+			// It was dropped when it scrolled away, but it's back now.
+			info->loadCanceled = false;
+			info->queued = true;
+			gameInfoWQ_->Add(new GameInfoWorkItem(gamePath, info, diskCache_));
+		}
 		return info;
 	}
 
 	if (!info) {
 		info = std::make_shared<GameInfo>();
+		info->cancelable = onScreen;
 	}
+	info->lastAccessedTime = time_now_d();
 
 	if (info->working) {
 		// Uh oh, it's currently in process.  It could mark pending = false with the wrong wantFlags.
@@ -779,8 +1154,13 @@ std::shared_ptr<GameInfo> GameInfoCache::GetInfo(Draw::DrawContext *draw, const
 		info->pending = true;
 	}
 
-	GameInfoWorkItem *item = new GameInfoWorkItem(gamePath, info);
-	gameInfoWQ_->Add(item);
+	// A queued item reads wantFlags when it runs, so it'll pick up the new ones.
+	if (!info->queued) {
+		info->loadCanceled = false;
+		info->queued = true;
+		GameInfoWorkItem *item = new GameInfoWorkItem(gamePath, info, diskCache_);
+		gameInfoWQ_->Add(item);
+	}
 
 	// Don't re-insert if we already have it.
 	if (info_.find(gamePath) == info_.end())
@@ -792,10 +1172,22 @@ void GameInfoCache::SetupTexture(std::shared_ptr<GameInfo> &info, Draw::DrawCont
 	using namespace Draw;
 	if (tex.data.size()) {
 		if (!tex.texture) {
-			tex.texture = CreateTextureFromFileData(thin3d, (const uint8_t *)tex.data.data(), (int)tex.data.size(), ImageFileType::DETECT);
-			if (tex.texture) {
-				tex.timeLoaded = time_now_d();
+			// Decode off the UI thread, we'll be called again every frame until it's uploaded.
+			if (!tex.loading) {
+				tex.loading.reset(new ManagedTexture(thin3d));
+				tex.loading->StartLoadFromFileData(tex.data, ImageFileType::DETECT);
+				return;
+			}
+			if (!tex.loading->GetTexture()) {
+				if (tex.loading->Failed()) {
+					tex.loading.reset(nullptr);
+					tex.data.clear();
+					tex.dataLoaded = false;
+				}
+				return;
 			}
+			tex.texture = std::move(tex.loading);
+			tex.timeLoaded = time_now_d();
 		}
 		if ((info->wantFlags & GAMEINFO_WANTBGDATA) == 0) {
 			tex.data.clear();
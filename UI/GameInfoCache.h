@@ -32,6 +32,7 @@ namespace Draw {
 	class Texture;
 }
 class PrioritizedWorkQueue;
+class GameInfoDiskCache;
 
 // A GameInfo holds information about a game, and also lets you do things that the VSH
 // does on the PSP, namely checking for and deleting savedata, and similar things.
@@ -55,6 +56,8 @@ enum GameInfoWantFlags {
 	GAMEINFO_WANTSIZE = 0x02,
 	GAMEINFO_WANTSND = 0x04,
 	GAMEINFO_WANTBGDATA = 0x08, // Use with WANTBG.
+	// The caller asks again every frame while it's shown, so loading can be dropped once it isn't.
+	GAMEINFO_ONSCREEN = 0x10,
 };
 
 class FileLoader;
@@ -69,6 +72,8 @@ struct GameInfoTex {
 	}
 	std::string data;
 	std::unique_ptr<ManagedTexture> texture;
+	// Decoding in the background, moved to texture once it's uploaded.
+	std::unique_ptr<ManagedTexture> loading;
 	// The time at which the Icon and the BG were loaded.
 	// Can be useful to fade them in smoothly once they appear.
 	double timeLoaded = 0.0;
@@ -80,6 +85,7 @@ struct GameInfoTex {
 			dataLoaded = false;
 		}
 		texture.reset(nullptr);
+		loading.reset(nullptr);
 	}
 private:
 	DISALLOW_COPY_AND_ASSIGN(GameInfoTex);
@@ -141,6 +147,11 @@ class GameInfo {
 	u64 installDataSize = 0;
 	std::atomic<bool> pending{};
 	std::atomic<bool> working{};
+	// A work item is waiting in the queue.
+	std::atomic<bool> queued{};
+	// The queued item was dropped, see GAMEINFO_ONSCREEN.
+	std::atomic<bool> loadCanceled{};
+	std::atomic<bool> cancelable{};
 
 protected:
 	// Note: this can change while loading, use GetTitle().
@@ -185,6 +196,8 @@ class GameInfoCache {
 
 	// Work queue and management
 	PrioritizedWorkQueue *gameInfoWQ_;
+	// Saved metadata and icons of games seen in previous runs.
+	GameInfoDiskCache *diskCache_;
 };
 
 // This one can be global, no good reason not to.
@@ -66,12 +66,14 @@
 #include "util/text/utf8.h"
 
 #include "Common/CPUDetect.h"
+#include "Common/ColorConv.h"
 #include "Common/FileUtil.h"
 #include "Common/LogManager.h"
 #include "Common/MemArena.h"
 #include "Common/GraphicsContext.h"
 #include "Core/Config.h"
 #include "Core/Core.h"
+#include "Core/ELF/ElfReader.h"
 #include "Core/FileLoaders/DiskCachingFileLoader.h"
 #include "Core/Host.h"
 #include "Core/Reporting.h"
@@ -85,6 +87,7 @@
 #include "Core/Util/GameManager.h"
 #include "Core/Util/AudioFormat.h"
 #include "GPU/GPUInterface.h"
+#include "GPU/Common/TextureDecoder.h"
 
 #include "ui_atlas.h"
 #include "UI/EmuScreen.h"
@@ -303,6 +306,9 @@ void NativeInit(int argc, const char *argv[], const char *savegame_dir, const ch
 
 	InitFastMath(cpu_info.bNEON);
 	SetupAudioFormats();
+	// The GPU does these again, but we want the system info screen right before that.
+	SetupColorConv();
+	SetupTextureDecoder();
 
 	// Make sure UI state is MENU.
 	ResetUIState();
@@ -699,6 +705,12 @@ bool NativeInitGraphics(GraphicsContext *graphicsContext) {
 
 	g_graphicsInited = true;
 	ILOG("NativeInitGraphics completed");
+
+	int assetCount;
+	uint64_t assetBytes;
+	double assetSeconds;
+	VFSGetReadStats(&assetCount, &assetBytes, &assetSeconds);
+	ILOG("Read %d assets (%d KB) in %0.1fms so far", assetCount, (int)(assetBytes / 1024), assetSeconds * 1000.0);
 	return true;
 }
 
@@ -768,7 +780,7 @@ void TakeScreenshot() {
 		i++;
 	}
 
-	bool success = TakeGameScreenshot(filename, g_Config.bScreenshotsAsPNG ? ScreenshotFormat::PNG : ScreenshotFormat::JPG, SCREENSHOT_OUTPUT);
+	bool success = QueueGameScreenshot(filename, g_Config.bScreenshotsAsPNG ? ScreenshotFormat::PNG : ScreenshotFormat::JPG, SCREENSHOT_OUTPUT);
 	if (success) {
 		osm.Show(filename);
 	} else {
@@ -801,6 +813,19 @@ void RenderOverlays(UIContext *dc, void *userdata) {
 		dc->Flush();
 	}
 
+	if (g_Config.bShowDebugStats) {
+		// Cost of the previous frame's UI, the current one is still being drawn.
+		char statbuf[64];
+		snprintf(statbuf, sizeof(statbuf), "UI: %0.2f ms, %d draws", dc->LastRenderTime() * 1000.0, dc->LastDrawCalls());
+		const Bounds &bounds = dc->GetBounds();
+		dc->Begin();
+		dc->Draw()->SetFontScale(0.7f, 0.7f);
+		dc->Draw()->DrawText(UBUNTU24, statbuf, bounds.x2() - 10, bounds.y2() - 10, 0xc0ffffff, ALIGN_BOTTOMRIGHT | FLAG_DYNAMIC_ASCII);
+		dc->Draw()->SetFontScale(1.0f, 1.0f);
+		dc->End();
+		dc->Flush();
+	}
+
 	if (g_TakeScreenshot) {
 		TakeScreenshot();
 	}
@@ -843,6 +868,7 @@ void NativeRender(GraphicsContext *graphicsContext) {
 
 	// All actual rendering happen in here.
 	screenManager->render();
+	screenManager->getUIContext()->EndFrameStats();
 	if (screenManager->getUIContext()->Text()) {
 		screenManager->getUIContext()->Text()->OncePerFrame();
 	}
@@ -930,6 +956,13 @@ void HandleGlobalMessage(const std::string &msg, const std::string &value) {
 		}
 		Reporting::UpdateConfig();
 	}
+	if (msg == "trim_memory") {
+		// The system is running low, drop what we can rebuild.
+		ILOG("Trimming memory use (level %s)", value.c_str());
+		if (gpu)
+			gpu->ClearCacheNextFrame();
+		ElfReader::ClearRelocatedImages();
+	}
 	if (msg == "core_powerSaving") {
 		if (value != "false") {
 			I18NCategory *sy = GetI18NCategory("System");
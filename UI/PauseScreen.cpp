@@ -90,9 +90,13 @@ void AsyncImageFileView::DeviceRestored(Draw::DrawContext *draw) {
 void AsyncImageFileView::Draw(UIContext &dc) {
 	using namespace Draw;
 	if (!texture_ && !textureFailed_ && !filename_.empty()) {
-		texture_ = CreateTextureFromFile(dc.GetDrawContext(), filename_.c_str(), DETECT, true);
-		if (!texture_.get())
-			textureFailed_ = true;
+		// Screenshots can be large, so they're decoded in the background and show up when ready.
+		texture_.reset(new ManagedTexture(dc.GetDrawContext()));
+		texture_->StartLoadFromFile(filename_, DETECT, true);
+	}
+	if (texture_ && !texture_->GetTexture() && texture_->Failed()) {
+		texture_.reset(nullptr);
+		textureFailed_ = true;
 	}
 
 	if (HasFocus()) {
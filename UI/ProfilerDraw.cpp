@@ -17,6 +17,7 @@
 
 #include <algorithm>
 #include <inttypes.h>
+#include <string>
 
 #include "gfx_es2/draw_buffer.h"
 #include "ui/ui_context.h"
@@ -51,6 +52,13 @@ enum ProfileCatStatus {
 	PROFILE_CAT_NOLEGEND = 2,
 };
 
+#ifdef USE_PROFILER
+static std::string LegendName(int category) {
+	const char *name = Profiler_GetCategoryName(category);
+	return Profiler_IsGPUCategory(category) ? std::string("GPU ") + name : std::string(name);
+}
+#endif
+
 void DrawProfile(UIContext &ui) {
 #ifdef USE_PROFILER
 	PROFILE_THIS_SCOPE("timing");
@@ -79,7 +87,10 @@ void DrawProfile(UIContext &ui) {
 			continue;
 		}
 
-		Profiler_GetSlowestHistory(i, &slowestThread[0], &history[0], historyLength);
+		if (Profiler_IsGPUCategory(i))
+			Profiler_GetGPUHistory(i, &history[0], historyLength);
+		else
+			Profiler_GetSlowestHistory(i, &slowestThread[0], &history[0], historyLength);
 		catStatus[i] = PROFILE_CAT_NOLEGEND;
 		for (int j = 0; j < historyLength; ++j) {
 			if (history[j] > legendMinVal) {
@@ -90,7 +101,7 @@ void DrawProfile(UIContext &ui) {
 
 		// So they don't move horizontally, we always measure.
 		float w = 0.0f, h = 0.0f;
-		ui.MeasureText(ui.GetFontStyle(), 1.0f, 1.0f, name, &w, &h);
+		ui.MeasureText(ui.GetFontStyle(), 1.0f, 1.0f, LegendName(i).c_str(), &w, &h);
 		if (w > legendWidth) {
 			legendWidth = w;
 		}
@@ -109,13 +120,12 @@ void DrawProfile(UIContext &ui) {
 
 	int legendNum = 0;
 	for (int i = 0; i < numCategories; i++) {
-		const char *name = Profiler_GetCategoryName(i);
 		uint32_t color = nice_colors[i % ARRAY_SIZE(nice_colors)];
 
 		if (catStatus[i] == PROFILE_CAT_VISIBLE) {
 			float y = legendStartY + legendNum++ * rowH;
 			ui.FillRect(UI::Drawable(opacity | color), Bounds(legendStartX, y, rowH - 2, rowH - 2));
-			ui.DrawTextShadow(name, legendStartX + rowH + 2, y, 0xFFFFFFFF, ALIGN_VBASELINE);
+			ui.DrawTextShadow(LegendName(i).c_str(), legendStartX + rowH + 2, y, 0xFFFFFFFF, ALIGN_VBASELINE);
 		}
 	}
 
@@ -154,7 +164,7 @@ void DrawProfile(UIContext &ui) {
 	maxVal = 0.0f;
 	float maxTotal = 0.0f;
 	for (int i = 0; i < numCategories; i++) {
-		if (catStatus[i] == PROFILE_CAT_IGNORE) {
+		if (catStatus[i] == PROFILE_CAT_IGNORE || Profiler_IsGPUCategory(i)) {
 			continue;
 		}
 		Profiler_GetSlowestHistory(i, &slowestThread[0], &history[0], historyLength);
@@ -194,6 +204,26 @@ void DrawProfile(UIContext &ui) {
 			maxTotal = total[n];
 	}
 
+	// GPU times overlap the CPU ones and each other, so they're drawn as lines on top, on the same scale.
+	for (int i = 0; i < numCategories; i++) {
+		if (catStatus[i] == PROFILE_CAT_IGNORE || !Profiler_IsGPUCategory(i)) {
+			continue;
+		}
+		Profiler_GetGPUHistory(i, &history[0], historyLength);
+
+		float x = 10;
+		UI::Drawable color(0xFF000000 | nice_colors[i % ARRAY_SIZE(nice_colors)]);
+		float bottom = ui.GetBounds().y2();
+		for (int n = 0; n < historyLength; n++) {
+			float val = history[n];
+			if (val > maxTotal)
+				maxTotal = val;
+			float valY = bottom - 10 - val * scale;
+			ui.FillRect(color, Bounds(x, valY - 1.0f, dx, 3.0f));
+			x += dx;
+		}
+	}
+
 	if (area) {
 		maxVal = maxTotal;
 	}
@@ -51,13 +51,34 @@ static ServerStatus serverStatus;
 static std::mutex serverStatusLock;
 static std::condition_variable serverStatusCond;
 
+static int activeConnections = 0;
+
 static bool scanCancelled = false;
 static bool scanAborted = false;
 
+// Each connection gets its own thread, so several devices can stream at once.
+class ConnectionThreadExecutor : public threading::Executor {
+public:
+	void Run(std::function<void()> func) override {
+		{
+			std::lock_guard<std::mutex> guard(serverStatusLock);
+			activeConnections++;
+		}
+		std::thread([func] {
+			setCurrentThreadName("HTTPConnection");
+			func();
+
+			std::lock_guard<std::mutex> guard(serverStatusLock);
+			activeConnections--;
+			serverStatusCond.notify_all();
+		}).detach();
+	}
+};
+
 static void UpdateStatus(ServerStatus s) {
 	std::lock_guard<std::mutex> guard(serverStatusLock);
 	serverStatus = s;
-	serverStatusCond.notify_one();
+	serverStatusCond.notify_all();
 }
 
 static ServerStatus RetrieveStatus() {
@@ -86,8 +107,9 @@ static void RegisterServer(int port) {
 static void ExecuteServer() {
 	setCurrentThreadName("HTTPServer");
 
-	auto http = new http::Server(new threading::SameThreadExecutor());
+	auto http = new http::Server(new ConnectionThreadExecutor());
 
+	// Read-only once the server is running, connections share it.
 	std::map<std::string, std::string> paths;
 	for (std::string filename : g_Config.recentIsos) {
 #ifdef _WIN32
@@ -100,13 +122,18 @@ static void ExecuteServer() {
 
 		// Let's not serve directories, since they won't work.  Only single files.
 		// Maybe can do PBPs and other files later.  Would be neat to stream virtual disc filesystems.
-		if (endsWithNoCase(basename, ".cso") || endsWithNoCase(basename, ".iso")) {
+		if (endsWithNoCase(basename, ".cso") || endsWithNoCase(basename, ".zso") || endsWithNoCase(basename, ".iso")) {
 			paths[ReplaceAll(basename, " ", "%20")] = filename;
 		}
 	}
 
 	auto handler = [&](const http::Request &request) {
-		std::string filename = paths[request.resource()];
+		auto path = paths.find(request.resource());
+		if (path == paths.end()) {
+			request.WriteHttpResponseHeader(404, -1, "text/plain");
+			return;
+		}
+		const std::string &filename = path->second;
 		s64 sz = File::GetFileSize(filename);
 
 		std::string range;
@@ -114,7 +141,13 @@ static void ExecuteServer() {
 			request.WriteHttpResponseHeader(200, sz, "application/octet-stream", "Accept-Ranges: bytes\r\n");
 		} else if (request.GetHeader("range", &range)) {
 			s64 begin = 0, last = 0;
-			if (sscanf(range.c_str(), "bytes=%lld-%lld", &begin, &last) != 2) {
+			int parsed = sscanf(range.c_str(), "bytes=%lld-%lld", &begin, &last);
+			if (parsed == 1 && range.back() == '-') {
+				// Open ended, until the end of the file.
+				last = sz - 1;
+				parsed = 2;
+			}
+			if (parsed != 2) {
 				request.WriteHttpResponseHeader(400, -1, "text/plain");
 				request.Out()->Push("Could not understand range request.");
 				return;
@@ -127,12 +160,9 @@ static void ExecuteServer() {
 			}
 
 			FILE *fp = File::OpenCFile(filename, "rb");
-			if (!fp || fseek(fp, begin, SEEK_SET) != 0) {
+			if (!fp) {
 				request.WriteHttpResponseHeader(500, -1, "text/plain");
 				request.Out()->Push("File access failed.");
-				if (fp) {
-					fclose(fp);
-				}
 				return;
 			}
 
@@ -141,16 +171,10 @@ static void ExecuteServer() {
 			sprintf(contentRange, "Content-Range: bytes %lld-%lld/%lld\r\n", begin, last, sz);
 			request.WriteHttpResponseHeader(206, len, "application/octet-stream", contentRange);
 
-			const size_t CHUNK_SIZE = 16 * 1024;
-			char *buf = new char[CHUNK_SIZE];
-			for (s64 pos = 0; pos < len; pos += CHUNK_SIZE) {
-				s64 chunklen = std::min(len - pos, (s64)CHUNK_SIZE);
-				fread(buf, chunklen, 1, fp);
-				request.Out()->Push(buf, chunklen);
+			if (!request.WriteFileRange(fp, begin, len)) {
+				WARN_LOG(FILESYS, "Failed to send range %lld-%lld of %s", begin, last, filename.c_str());
 			}
 			fclose(fp);
-			delete [] buf;
-			request.Out()->Flush();
 		} else {
 			request.WriteHttpResponseHeader(418, -1, "text/plain");
 			request.Out()->Push("This server only supports range requests.");
@@ -185,7 +209,13 @@ static void ExecuteServer() {
 
 	http->Stop();
 
-	UpdateStatus(ServerStatus::STOPPED);
+	// Kept-alive connections notice the stop within a second, active transfers when they finish.
+	std::unique_lock<std::mutex> guard(serverStatusLock);
+	serverStatusCond.wait(guard, [] { return activeConnections == 0; });
+	delete http;
+
+	serverStatus = ServerStatus::STOPPED;
+	serverStatusCond.notify_all();
 }
 
 bool StartRemoteISOSharing() {
@@ -330,7 +360,7 @@ static bool LoadGameList(const std::string &host, int port, std::vector<std::str
 		//ppsspp server
 		SplitString(listing, '\n', items);
 		for (const std::string &item : items) {
-			if (!endsWithNoCase(item, ".cso") && !endsWithNoCase(item, ".iso") && !endsWithNoCase(item, ".pbp")) {
+			if (!endsWithNoCase(item, ".cso") && !endsWithNoCase(item, ".zso") && !endsWithNoCase(item, ".iso") && !endsWithNoCase(item, ".pbp")) {
 				continue;
 			}
 
@@ -343,7 +373,7 @@ static bool LoadGameList(const std::string &host, int port, std::vector<std::str
 		GetQuotedStrings(listing, items);
 		for (const std::string &item : items) {
 			
-			if (!endsWithNoCase(item, ".cso") && !endsWithNoCase(item, ".iso") && !endsWithNoCase(item, ".pbp")) {
+			if (!endsWithNoCase(item, ".cso") && !endsWithNoCase(item, ".zso") && !endsWithNoCase(item, ".iso") && !endsWithNoCase(item, ".pbp")) {
 				continue;
 			}
 
@@ -8,6 +8,7 @@
 #include "ext/jpge/jpgd.h"
 #include "UI/TextureUtil.h"
 #include "Common/Log.h"
+#include "Common/ThreadPools.h"
 
 static Draw::DataFormat ZimToT3DFormat(int zim) {
 	switch (zim) {
@@ -33,31 +34,32 @@ static ImageFileType DetectImageFileType(const uint8_t *data, size_t size) {
 	}
 }
 
-static bool LoadTextureLevels(const uint8_t *data, size_t size, ImageFileType type, int width[16], int height[16], int *num_levels, Draw::DataFormat *fmt, uint8_t *image[16], int *zim_flags) {
-	if (type == DETECT) {
-		type = DetectImageFileType(data, size);
+bool TempImage::LoadTextureLevels(const uint8_t *data, size_t size, ImageFileType typeSuggestion) {
+	if (typeSuggestion == DETECT) {
+		typeSuggestion = DetectImageFileType(data, size);
 	}
-	if (type == TYPE_UNKNOWN) {
+	if (typeSuggestion == TYPE_UNKNOWN) {
 		ELOG("File (size: %d) has unknown format", (int)size);
 		return false;
 	}
 
-	*num_levels = 0;
-	*zim_flags = 0;
+	type = typeSuggestion;
+	numLevels = 0;
 
 	switch (type) {
 	case ZIM:
 	{
-		*num_levels = LoadZIMPtr((const uint8_t *)data, size, width, height, zim_flags, image);
-		*fmt = ZimToT3DFormat(*zim_flags & ZIM_FORMAT_MASK);
+		int zim_flags = 0;
+		numLevels = LoadZIMPtr((const uint8_t *)data, size, width, height, &zim_flags, levels);
+		fmt = ZimToT3DFormat(zim_flags & ZIM_FORMAT_MASK);
 	}
 	break;
 
 	case PNG:
-		if (1 == pngLoadPtr((const unsigned char *)data, size, &width[0], &height[0], &image[0], false)) {
-			*num_levels = 1;
-			*fmt = Draw::DataFormat::R8G8B8A8_UNORM;
-			if (!image[0]) {
+		if (1 == pngLoadPtr((const unsigned char *)data, size, &width[0], &height[0], &levels[0], false)) {
+			numLevels = 1;
+			fmt = Draw::DataFormat::R8G8B8A8_UNORM;
+			if (!levels[0]) {
 				ELOG("WTF");
 				return false;
 			}
@@ -72,9 +74,9 @@ static bool LoadTextureLevels(const uint8_t *data, size_t size, ImageFileType ty
 		int actual_components = 0;
 		unsigned char *jpegBuf = jpgd::decompress_jpeg_image_from_memory(data, (int)size, &width[0], &height[0], &actual_components, 4);
 		if (jpegBuf) {
-			*num_levels = 1;
-			*fmt = Draw::DataFormat::R8G8B8A8_UNORM;
-			image[0] = (uint8_t *)jpegBuf;
+			numLevels = 1;
+			fmt = Draw::DataFormat::R8G8B8A8_UNORM;
+			levels[0] = (uint8_t *)jpegBuf;
 		}
 	}
 	break;
@@ -84,58 +86,70 @@ static bool LoadTextureLevels(const uint8_t *data, size_t size, ImageFileType ty
 		return false;
 	}
 
-	return *num_levels > 0;
-}
-
-bool ManagedTexture::LoadFromFileData(const uint8_t *data, size_t dataSize, ImageFileType type, bool generateMips) {
-	generateMips_ = generateMips;
-	using namespace Draw;
+	if (numLevels < 0 || numLevels >= 16) {
+		ELOG("Invalid num_levels: %d. Falling back to one. Image: %dx%d", numLevels, width[0], height[0]);
+		numLevels = 1;
+	}
 
-	int width[16]{}, height[16]{};
-	uint8_t *image[16]{};
+	return numLevels > 0 && levels[0] != nullptr;
+}
 
-	int num_levels = 0;
-	int zim_flags = 0;
-	DataFormat fmt;
-	if (!LoadTextureLevels(data, dataSize, type, width, height, &num_levels, &fmt, image, &zim_flags)) {
-		return false;
+void TempImage::Free() {
+	for (int i = 0; i < (int)ARRAY_SIZE(levels); i++) {
+		free(levels[i]);
+		levels[i] = nullptr;
 	}
+	numLevels = 0;
+}
 
-	if (!image[0]) {
-		Crash();
-	}
+TempImage::~TempImage() {
+	Free();
+}
 
-	if (num_levels < 0 || num_levels >= 16) {
-		ELOG("Invalid num_levels: %d. Falling back to one. Image: %dx%d", num_levels, width[0], height[0]);
-		num_levels = 1;
-	}
+ManagedTexture::~ManagedTexture() {
+	// The decode has a pointer to us.
+	GlobalThreadPool::Wait(decoding_);
+	if (texture_)
+		texture_->Release();
+}
+
+bool ManagedTexture::CreateTextureFromImage(TempImage &image) {
+	using namespace Draw;
 
 	if (texture_) {
 		delete texture_;
 		texture_ = nullptr;
 	}
 
-	int potentialLevels = std::min(log2i(width[0]), log2i(height[0]));
+	int potentialLevels = std::min(log2i(image.width[0]), log2i(image.height[0]));
 
 	TextureDesc desc{};
 	desc.type = TextureType::LINEAR2D;
-	desc.format = fmt;
-	desc.width = width[0];
-	desc.height = height[0];
+	desc.format = image.fmt;
+	desc.width = image.width[0];
+	desc.height = image.height[0];
 	desc.depth = 1;
-	desc.mipLevels = generateMips ? potentialLevels : num_levels;
-	desc.generateMips = generateMips && potentialLevels > num_levels;
-	for (int i = 0; i < num_levels; i++) {
-		desc.initData.push_back(image[i]);
+	desc.mipLevels = generateMips_ ? potentialLevels : image.numLevels;
+	desc.generateMips = generateMips_ && potentialLevels > image.numLevels;
+	// The decoded levels are uploaded as is, without another copy.
+	for (int i = 0; i < image.numLevels; i++) {
+		desc.initData.push_back(image.levels[i]);
 	}
 	texture_ = draw_->CreateTexture(desc);
-	for (int i = 0; i < num_levels; i++) {
-		if (image[i])
-			free(image[i]);
-	}
+	image.Free();
 	return texture_ != nullptr;
 }
 
+bool ManagedTexture::LoadFromFileData(const uint8_t *data, size_t dataSize, ImageFileType type, bool generateMips) {
+	generateMips_ = generateMips;
+
+	TempImage image;
+	if (!image.LoadTextureLevels(data, dataSize, type)) {
+		return false;
+	}
+	return CreateTextureFromImage(image);
+}
+
 bool ManagedTexture::LoadFromFile(const std::string &filename, ImageFileType type, bool generateMips) {
 	generateMips_ = generateMips;
 	size_t fileSize;
@@ -156,6 +170,56 @@ bool ManagedTexture::LoadFromFile(const std::string &filename, ImageFileType typ
 	return retval;
 }
 
+void ManagedTexture::StartLoadFromFile(const std::string &filename, ImageFileType type, bool generateMips) {
+	GlobalThreadPool::Wait(decoding_);
+	generateMips_ = generateMips;
+	filename_ = filename;
+	failed_ = false;
+	pendingImage_.reset(new TempImage());
+
+	TempImage *image = pendingImage_.get();
+	GlobalThreadPool::Run(decoding_, [image, filename, type] {
+		size_t fileSize;
+		uint8_t *buffer = VFSReadFile(filename.c_str(), &fileSize);
+		if (!buffer) {
+			ELOG("Failed to read file '%s'", filename.c_str());
+			return;
+		}
+		if (!image->LoadTextureLevels(buffer, fileSize, type)) {
+			ELOG("Failed to load texture '%s'", filename.c_str());
+			image->Free();
+		}
+		delete[] buffer;
+	});
+}
+
+void ManagedTexture::StartLoadFromFileData(const std::string &data, ImageFileType type, bool generateMips) {
+	GlobalThreadPool::Wait(decoding_);
+	generateMips_ = generateMips;
+	failed_ = false;
+	pendingImage_.reset(new TempImage());
+
+	// The copy keeps the decode independent of whoever owns data.
+	TempImage *image = pendingImage_.get();
+	GlobalThreadPool::Run(decoding_, [image, data, type] {
+		if (!image->LoadTextureLevels((const uint8_t *)data.data(), data.size(), type)) {
+			image->Free();
+		}
+	});
+}
+
+void ManagedTexture::FinishDecode() {
+	if (pendingImage_->numLevels > 0) {
+		failed_ = !CreateTextureFromImage(*pendingImage_);
+	} else {
+		failed_ = true;
+	}
+	if (failed_) {
+		filename_ = "";
+	}
+	pendingImage_.reset();
+}
+
 std::unique_ptr<ManagedTexture> CreateTextureFromFile(Draw::DrawContext *draw, const char *filename, ImageFileType type, bool generateMips) {
 	if (!draw)
 		return std::unique_ptr<ManagedTexture>();
@@ -179,12 +243,19 @@ void ManagedTexture::DeviceRestored(Draw::DrawContext *draw) {
 	ILOG("ManagedTexture::DeviceRestored(%s)", filename_.c_str());
 	_assert_(!texture_);
 	draw_ = draw;
+	if (pendingImage_) {
+		// Still decoding, it'll be uploaded to the new device.
+		return;
+	}
 	// Vulkan: Can't load textures before the first frame has started.
 	// Should probably try to lift that restriction again someday..
 	loadPending_ = true;
 }
 
 Draw::Texture *ManagedTexture::GetTexture() {
+	if (pendingImage_ && decoding_.Done()) {
+		FinishDecode();
+	}
 	if (loadPending_) {
 		if (!LoadFromFile(filename_, ImageFileType::DETECT, generateMips_)) {
 			ELOG("ManagedTexture failed: '%s'", filename_.c_str());
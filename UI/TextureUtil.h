@@ -1,8 +1,10 @@
 #pragma once
 
 #include <memory>
+#include <string>
 
 #include "thin3d/thin3d.h"
+#include "thread/threadpool.h"
 
 enum ImageFileType {
 	PNG,
@@ -12,17 +14,34 @@ enum ImageFileType {
 	TYPE_UNKNOWN,
 };
 
+// Decoded image levels, ready to upload.  Decoding is safe on any thread, uploading isn't.
+struct TempImage {
+	~TempImage();
+
+	bool LoadTextureLevels(const uint8_t *data, size_t size, ImageFileType typeSuggestion = DETECT);
+	void Free();
+
+	Draw::DataFormat fmt = Draw::DataFormat::UNDEFINED;
+	ImageFileType type = TYPE_UNKNOWN;
+	uint8_t *levels[16]{};
+	int width[16]{};
+	int height[16]{};
+	int numLevels = 0;
+};
+
 class ManagedTexture {
 public:
 	ManagedTexture(Draw::DrawContext *draw) : draw_(draw) {
 	}
-	~ManagedTexture() {
-		if (texture_)
-			texture_->Release();
-	}
+	~ManagedTexture();
 
 	bool LoadFromFile(const std::string &filename, ImageFileType type = ImageFileType::DETECT, bool generateMips = false);
 	bool LoadFromFileData(const uint8_t *data, size_t dataSize, ImageFileType type = ImageFileType::DETECT, bool generateMips = false);
+	// These read and decode on the global thread pool.  GetTexture() returns null until the
+	// decode is done, and then uploads it, so keep calling it from the render thread.
+	void StartLoadFromFile(const std::string &filename, ImageFileType type = ImageFileType::DETECT, bool generateMips = false);
+	void StartLoadFromFileData(const std::string &data, ImageFileType type = ImageFileType::DETECT, bool generateMips = false);
+	bool Failed() const { return failed_; }
 	Draw::Texture *GetTexture();  // For immediate use, don't store.
 	int Width() const { return texture_->Width(); }
 	int Height() const { return texture_->Height(); }
@@ -31,11 +50,19 @@ class ManagedTexture {
 	void DeviceRestored(Draw::DrawContext *draw);
 
 private:
+	bool CreateTextureFromImage(TempImage &image);
+	void FinishDecode();
+
 	Draw::Texture *texture_ = nullptr;
 	Draw::DrawContext *draw_;
 	std::string filename_;  // Textures that are loaded from files can reload themselves automatically.
 	bool generateMips_ = false;
 	bool loadPending_ = false;
+	bool failed_ = false;
+
+	// Set while a Start* decode is running or waiting for upload.
+	std::unique_ptr<TempImage> pendingImage_;
+	TaskGroup decoding_;
 };
 
 std::unique_ptr<ManagedTexture> CreateTextureFromFile(Draw::DrawContext *draw, const char *filename, ImageFileType fileType, bool generateMips = false);
@@ -781,7 +781,7 @@ BOOL CGEDebugger::DlgProc(UINT message, WPARAM wParam, LPARAM lParam) {
 			break;
 
 		case IDC_GEDBG_RECORD:
-			GPURecord::Activate();
+			GPURecord::Activate(g_Config.iGERecordFrames);
 			break;
 
 		case IDC_GEDBG_FORCEOPAQUE:
@@ -33,7 +33,8 @@ D3D11Context::~D3D11Context() {
 }
 
 void D3D11Context::SwapBuffers() {
-	swapChain_->Present(0, 0);
+	// The draw context presents for us, possibly on its submission thread.
+	draw_->HandleEvent(Draw::Event::PRESENT_REQUESTED, 0, 0, nullptr, nullptr);
 	draw_->HandleEvent(Draw::Event::PRESENTED, 0, 0, nullptr, nullptr);
 }
 
@@ -146,7 +147,9 @@ bool D3D11Context::Init(HINSTANCE hInst, HWND wnd, std::string *error_message) {
 	}
 #endif
 
-	draw_ = Draw::T3DCreateD3D11Context(device_, context_, device1_, context1_, featureLevel_, hWnd_);
+	draw_ = Draw::T3DCreateD3D11Context(device_, context_, device1_, context1_, featureLevel_, hWnd_, g_Config.bD3D11DeferredContext, [this]() {
+		swapChain_->Present(0, 0);
+	});
 	SetGPUBackend(GPUBackend::DIRECT3D11);
 	bool success = draw_->CreatePresets();  // If we can run D3D11, there's a compiler installed. I think.
 	assert(success);
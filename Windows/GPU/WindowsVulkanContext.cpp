@@ -99,7 +99,8 @@ bool WindowsVulkanContext::Init(HINSTANCE hInst, HWND hWnd, std::string *error_m
 	VulkanContext::CreateInfo info{};
 	info.app_name = "PPSSPP";
 	info.app_ver = gitVer.ToInteger();
-	info.flags = VULKAN_FLAG_PRESENT_MAILBOX;
+	info.flags = VulkanPresentModeFlags(g_Config.iVulkanPresentMode, VULKAN_FLAG_PRESENT_MAILBOX);
+	g_Vulkan->SetDesiredSwapchainImages(g_Config.iVulkanSwapchainImages);
 	if (g_validate_) {
 		info.flags |= VULKAN_FLAG_VALIDATE;
 	}
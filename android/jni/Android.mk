@@ -197,6 +197,7 @@ EXEC_AND_LIB_FILES := \
   $(SRC)/ext/udis86/udis86.c \
   $(SRC)/ext/xbrz/xbrz.cpp \
   $(SRC)/ext/xxhash.c \
+  $(SRC)/Common/Crypto/crc32.cpp \
   $(SRC)/Common/Crypto/md5.cpp \
   $(SRC)/Common/Crypto/sha1.cpp \
   $(SRC)/Common/Crypto/sha256.cpp \
@@ -297,6 +298,8 @@ EXEC_AND_LIB_FILES := \
   $(SRC)/Core/TextureReplacer.cpp \
   $(SRC)/Core/Debugger/Breakpoints.cpp \
   $(SRC)/Core/Debugger/SymbolMap.cpp \
+  $(SRC)/Core/Debugger/SamplingProfiler.cpp \
+  $(SRC)/Core/Debugger/StatsServer.cpp \
   $(SRC)/Core/Dialog/PSPDialog.cpp \
   $(SRC)/Core/Dialog/PSPGamedataInstallDialog.cpp \
   $(SRC)/Core/Dialog/PSPMsgDialog.cpp \
@@ -540,6 +543,7 @@ ifeq ($(UNITTEST),1)
   LOCAL_SRC_FILES := \
     $(LIBARMIPS_FILES) \
     $(SRC)/Core/MIPS/MIPSAsm.cpp \
+    $(SRC)/unittest/Benchmarks.cpp \
     $(SRC)/unittest/JitHarness.cpp \
     $(SRC)/unittest/TestVertexJit.cpp \
     $(TESTARMEMITTER_FILE) \
@@ -97,7 +97,9 @@ bool AndroidVulkanContext::InitAPI() {
 	VulkanContext::CreateInfo info{};
 	info.app_name = "PPSSPP";
 	info.app_ver = gitVer.ToInteger();
-	info.flags = VULKAN_FLAG_PRESENT_MAILBOX | VULKAN_FLAG_PRESENT_FIFO_RELAXED;
+	// FIFO by default, MAILBOX has caused trouble on some drivers.
+	info.flags = VulkanPresentModeFlags(g_Config.iVulkanPresentMode, VULKAN_FLAG_PRESENT_FIFO);
+	g_Vulkan->SetDesiredSwapchainImages(g_Config.iVulkanSwapchainImages);
 	VkResult res = g_Vulkan->CreateInstance(info);
 	if (res != VK_SUCCESS) {
 		ELOG("Failed to create vulkan context: %s", g_Vulkan->InitError().c_str());
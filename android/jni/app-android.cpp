@@ -43,6 +43,7 @@
 #include "AndroidJavaGLContext.h"
 
 #include "Core/Config.h"
+#include "Core/HW/MediaEngine.h"
 #include "Core/Loaders.h"
 #include "Core/System.h"
 #include "Common/CPUDetect.h"
@@ -153,6 +154,9 @@ jclass findClass(const char* name) {
 JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM *pjvm, void *reserved) {
 	ILOG("JNI_OnLoad");
 	gJvm = pjvm;  // cache the JavaVM pointer
+#ifdef USE_FFMPEG
+	InitFFmpegJavaVM(pjvm);
+#endif
 	auto env = getEnv();
 	//replace with one of your classes in the line below
 	auto randomClass = env->FindClass("org/ppsspp/ppsspp/NativeActivity");
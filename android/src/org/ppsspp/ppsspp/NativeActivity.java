@@ -692,6 +692,16 @@ protected void onPause() {
 		Log.i(TAG, "onPause completed");
 	}
 
+	@Override
+	public void onTrimMemory(int level) {
+		super.onTrimMemory(level);
+		// Only when it's getting serious, caches are expensive to rebuild.
+		if (initialized && level >= TRIM_MEMORY_RUNNING_LOW) {
+			Log.i(TAG, "onTrimMemory: " + level);
+			NativeApp.sendMessage("trim_memory", Integer.toString(level));
+		}
+	}
+
     private boolean detectOpenGLES20() {
         ActivityManager am = (ActivityManager) getSystemService(Context.ACTIVITY_SERVICE);
         ConfigurationInfo info = am.getDeviceConfigurationInfo();
@@ -32,6 +32,24 @@
 
 #include "AES.h"
 
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define AES_ACCEL_X86
+#include <emmintrin.h>
+#include <wmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define AES_ACCEL_TARGET
+#else
+#include <cpuid.h>
+#define AES_ACCEL_TARGET __attribute__((target("aes,sse2")))
+#endif
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRYPTO)
+// Only when built with the crypto extensions enabled, there's no runtime check here.
+#define AES_ACCEL_ARMV8
+#include <arm_neon.h>
+#define AES_ACCEL_TARGET
+#endif
+
 #undef FULL_UNROLL
 
 
@@ -1303,12 +1321,171 @@ void xor_128(const unsigned char *a, const unsigned char *b, unsigned char *out)
 	}
 }
 
+#if defined(AES_ACCEL_X86) || defined(AES_ACCEL_ARMV8)
+
+// The schedules are kept as big endian words, the instructions want the bytes in order.
+// The decrypt schedule is already reversed and inverse mixed, which is what both want.
+static void aes_accel_round_keys(const u32 *rk, int Nr, u8 keys[AES_MAXROUNDS + 1][16])
+{
+	int r, c;
+	for (r = 0; r <= Nr; r++)
+	{
+		for (c = 0; c < 4; c++)
+		{
+			u32 w = rk[r * 4 + c];
+			keys[r][c * 4 + 0] = (u8)(w >> 24);
+			keys[r][c * 4 + 1] = (u8)(w >> 16);
+			keys[r][c * 4 + 2] = (u8)(w >> 8);
+			keys[r][c * 4 + 3] = (u8)w;
+		}
+	}
+}
+
+#ifdef AES_ACCEL_X86
+
+static int aes_accel_available(void)
+{
+	static int available = -1;
+	if (available < 0)
+	{
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 1);
+		available = (info[2] >> 25) & 1;
+#else
+		unsigned int a, b, c, d;
+		available = __get_cpuid(1, &a, &b, &c, &d) && (c & (1 << 25)) ? 1 : 0;
+#endif
+	}
+	return available;
+}
+
+AES_ACCEL_TARGET static void aes_accel_cbc_decrypt(const AES_ctx *ctx, const u8 *src, u8 *dst, int size)
+{
+	u8 keys[AES_MAXROUNDS + 1][16];
+	__m128i k[AES_MAXROUNDS + 1];
+	__m128i prev = _mm_setzero_si128();
+	int i, r;
+	const int Nr = ctx->Nr;
+
+	aes_accel_round_keys(ctx->dk, Nr, keys);
+	for (r = 0; r <= Nr; r++)
+		k[r] = _mm_loadu_si128((const __m128i *)keys[r]);
+
+	for (i = 0; i < size; i += 16)
+	{
+		// Read before writing, this might be in place.
+		__m128i c = _mm_loadu_si128((const __m128i *)(src + i));
+		__m128i x = _mm_xor_si128(c, k[0]);
+		for (r = 1; r < Nr; r++)
+			x = _mm_aesdec_si128(x, k[r]);
+		x = _mm_aesdeclast_si128(x, k[Nr]);
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_xor_si128(x, prev));
+		prev = c;
+	}
+}
+
+// Chains from state and leaves the last block there.  Also writes each block out, if dst is set.
+AES_ACCEL_TARGET static void aes_accel_cbc_encrypt(const AES_ctx *ctx, const u8 *input, int blocks, u8 *state, u8 *dst)
+{
+	u8 keys[AES_MAXROUNDS + 1][16];
+	__m128i k[AES_MAXROUNDS + 1];
+	__m128i x = _mm_loadu_si128((const __m128i *)state);
+	int i, r;
+	const int Nr = ctx->Nr;
+
+	aes_accel_round_keys(ctx->ek, Nr, keys);
+	for (r = 0; r <= Nr; r++)
+		k[r] = _mm_loadu_si128((const __m128i *)keys[r]);
+
+	for (i = 0; i < blocks; i++)
+	{
+		x = _mm_xor_si128(x, _mm_loadu_si128((const __m128i *)(input + i * 16)));
+		x = _mm_xor_si128(x, k[0]);
+		for (r = 1; r < Nr; r++)
+			x = _mm_aesenc_si128(x, k[r]);
+		x = _mm_aesenclast_si128(x, k[Nr]);
+		if (dst)
+			_mm_storeu_si128((__m128i *)(dst + i * 16), x);
+	}
+	_mm_storeu_si128((__m128i *)state, x);
+}
+
+#else
+
+static int aes_accel_available(void)
+{
+	return 1;
+}
+
+static void aes_accel_cbc_decrypt(const AES_ctx *ctx, const u8 *src, u8 *dst, int size)
+{
+	u8 keys[AES_MAXROUNDS + 1][16];
+	uint8x16_t k[AES_MAXROUNDS + 1];
+	uint8x16_t prev = vdupq_n_u8(0);
+	int i, r;
+	const int Nr = ctx->Nr;
+
+	aes_accel_round_keys(ctx->dk, Nr, keys);
+	for (r = 0; r <= Nr; r++)
+		k[r] = vld1q_u8(keys[r]);
+
+	for (i = 0; i < size; i += 16)
+	{
+		// Read before writing, this might be in place.
+		uint8x16_t c = vld1q_u8(src + i);
+		uint8x16_t x = c;
+		for (r = 0; r < Nr - 1; r++)
+			x = vaesimcq_u8(vaesdq_u8(x, k[r]));
+		x = veorq_u8(vaesdq_u8(x, k[Nr - 1]), k[Nr]);
+		vst1q_u8(dst + i, veorq_u8(x, prev));
+		prev = c;
+	}
+}
+
+static void aes_accel_cbc_encrypt(const AES_ctx *ctx, const u8 *input, int blocks, u8 *state, u8 *dst)
+{
+	u8 keys[AES_MAXROUNDS + 1][16];
+	uint8x16_t k[AES_MAXROUNDS + 1];
+	uint8x16_t x = vld1q_u8(state);
+	int i, r;
+	const int Nr = ctx->Nr;
+
+	aes_accel_round_keys(ctx->ek, Nr, keys);
+	for (r = 0; r <= Nr; r++)
+		k[r] = vld1q_u8(keys[r]);
+
+	for (i = 0; i < blocks; i++)
+	{
+		x = veorq_u8(x, vld1q_u8(input + i * 16));
+		for (r = 0; r < Nr - 1; r++)
+			x = vaesmcq_u8(vaeseq_u8(x, k[r]));
+		x = veorq_u8(vaeseq_u8(x, k[Nr - 1]), k[Nr]);
+		if (dst)
+			vst1q_u8(dst + i * 16, x);
+	}
+	vst1q_u8(state, x);
+}
+
+#endif
+
+#endif
+
 //No IV support!
 void AES_cbc_encrypt(AES_ctx *ctx, u8 *src, u8 *dst, int size)
 {
 	u8 block_buff[16];
 	
 	int i;
+
+#if defined(AES_ACCEL_X86) || defined(AES_ACCEL_ARMV8)
+	if (aes_accel_available())
+	{
+		memset(block_buff, 0, sizeof(block_buff));
+		aes_accel_cbc_encrypt(ctx, src, (size + 15) / 16, block_buff, dst);
+		return;
+	}
+#endif
 	for(i = 0; i < size; i+=16)
 	{
 		//step 1: copy block to dst
@@ -1330,6 +1507,14 @@ void AES_cbc_decrypt(AES_ctx *ctx, u8 *src, u8 *dst, int size)
 	u8 block_buff[16];
 	u8 block_buff_previous[16];
 	int i;
+
+#if defined(AES_ACCEL_X86) || defined(AES_ACCEL_ARMV8)
+	if (!ctx->enc_only && aes_accel_available())
+	{
+		aes_accel_cbc_decrypt(ctx, src, dst, size);
+		return;
+	}
+#endif
 	
 	memcpy(block_buff, src, 16);
 	memcpy(block_buff_previous, src, 16);
@@ -1449,6 +1634,13 @@ void AES_CMAC (AES_ctx *ctx, unsigned char *input, int length, unsigned char *ma
     }
 
     for ( i=0; i<16; i++ ) X[i] = 0;
+#if defined(AES_ACCEL_X86) || defined(AES_ACCEL_ARMV8)
+    if (aes_accel_available())
+    {
+        aes_accel_cbc_encrypt(ctx, input, n-1, X, NULL);
+    }
+    else
+#endif
     for ( i=0; i<n-1; i++ ) 
     {
         xor_128(X,&input[16*i],Y); /* Y := Mi (+) X  */
@@ -104,6 +104,15 @@ int Buffer::OffsetToAfterNextCRLF() {
   return -1;
 }
 
+int Buffer::OffsetToAfterDoubleCRLF() {
+  for (int i = 0; i < (int)data_.size() - 3; i++) {
+    if (data_[i] == '\r' && data_[i + 1] == '\n' && data_[i + 2] == '\r' && data_[i + 3] == '\n') {
+      return i + 4;
+    }
+  }
+  return -1;
+}
+
 void Buffer::Printf(const char *fmt, ...) {
   char buffer[2048];
   va_list vl;
@@ -142,8 +151,14 @@ bool Buffer::FlushToFile(const char *filename) {
 }
 
 bool Buffer::FlushSocket(uintptr_t sock) {
+	// A reused connection may have been closed by the other side, report that instead of raising SIGPIPE.
+#ifdef MSG_NOSIGNAL
+	const int flags = MSG_NOSIGNAL;
+#else
+	const int flags = 0;
+#endif
 	for (size_t pos = 0, end = data_.size(); pos < end; ) {
-		int sent = send(sock, &data_[pos], (int)(end - pos), 0);
+		int sent = send(sock, &data_[pos], (int)(end - pos), flags);
 		if (sent < 0) {
 			ELOG("FlushSocket failed");
 			return false;
@@ -230,6 +245,16 @@ int Buffer::Read(int fd, size_t sz) {
 	return (int)received;
 }
 
+int Buffer::ReadSome(int fd, size_t sz) {
+	char buf[4096];
+	int retval = recv(fd, buf, (int)std::min(sz, sizeof(buf)), 0);
+	if (retval > 0) {
+		char *p = Append((size_t)retval);
+		memcpy(p, buf, retval);
+	}
+	return retval;
+}
+
 void Buffer::PeekAll(std::string *dest) {
 	dest->resize(data_.size());
 	memcpy(&(*dest)[0], &data_[0], data_.size());
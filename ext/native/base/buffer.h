@@ -34,6 +34,8 @@ class Buffer {
   // If parsing HTML headers, this indicates that you should probably buffer up
   // more data.
   int OffsetToAfterNextCRLF();
+  // Same, but for an empty line (CRLF CRLF), which ends a block of HTTP headers.
+  int OffsetToAfterDoubleCRLF();
 
   // Takers
 
@@ -72,6 +74,9 @@ class Buffer {
 	// < 0: error
 	// >= 0: number of bytes read
   int Read(int fd, size_t sz);
+	// Like Read, but returns after the first recv instead of waiting for all sz bytes.
+	// 0 means the connection was closed.
+  int ReadSome(int fd, size_t sz);
 
   // Utilities. Try to avoid checking for size.
   size_t size() const { return data_.size(); }
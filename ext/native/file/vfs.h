@@ -17,3 +17,6 @@ void VFSShutdown();
 uint8_t *VFSReadFile(const char *filename, size_t *size);
 bool VFSGetFileListing(const char *path, std::vector<FileInfo> *listing, const char *filter = 0);
 bool VFSGetFileInfo(const char *filename, FileInfo *fileInfo);
+
+// Totals over all VFSReadFile calls so far, to see how long asset loading takes at startup.
+void VFSGetReadStats(int *count, uint64_t *bytes, double *seconds);
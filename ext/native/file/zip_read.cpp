@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <atomic>
 #include <ctype.h>
 #include <set>
 #include <stdio.h>
@@ -9,11 +10,17 @@
 #endif
 
 #ifdef __ANDROID__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <zip.h>
+#include <zlib.h>
 #endif
 
 #include "base/basictypes.h"
 #include "base/logging.h"
+#include "base/timeutil.h"
 #include "file/zip_read.h"
 
 #ifdef __ANDROID__
@@ -120,13 +127,33 @@ bool AssetsAssetReader::GetFileInfo(const char *path, FileInfo *info) {
 
 #ifdef __ANDROID__
 
-ZipAssetReader::ZipAssetReader(const char *zip_file, const char *in_zip_path) {
+static inline uint16_t ReadLE16(const uint8_t *p) {
+	return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t ReadLE32(const uint8_t *p) {
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static std::string ZipLowerCase(const char *str) {
+	std::string lower = str;
+	std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+	return lower;
+}
+
+ZipAssetReader::ZipAssetReader(const char *zip_file, const char *in_zip_path) : map_(nullptr), mapSize_(0) {
 	zip_file_ = zip_open(zip_file, 0, NULL);
 	strcpy(in_zip_path_, in_zip_path);
 	if (!zip_file_) {
 		ELOG("Failed to open %s as a zip file", zip_file);
 	}
 
+	double start = real_time_now();
+	if (MapArchive(zip_file)) {
+		BuildIndex();
+	}
+	ILOG("Indexed %d entries of %s in %0.1fms", (int)index_.size(), zip_file, (real_time_now() - start) * 1000.0);
+
 	std::vector<FileInfo> info;
 	GetFileListing("assets", &info, 0);
 	for (size_t i = 0; i < info.size(); i++) {
@@ -140,12 +167,167 @@ ZipAssetReader::ZipAssetReader(const char *zip_file, const char *in_zip_path) {
 
 ZipAssetReader::~ZipAssetReader() {
 	zip_close(zip_file_);
+	if (map_) {
+		munmap((void *)map_, mapSize_);
+	}
+}
+
+bool ZipAssetReader::MapArchive(const char *zip_file) {
+	int fd = open(zip_file, O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+		close(fd);
+		return false;
+	}
+	void *map = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	// The mapping stays valid after closing.
+	close(fd);
+	if (map == MAP_FAILED) {
+		ELOG("Failed to map %s, falling back to libzip", zip_file);
+		return false;
+	}
+	map_ = (const uint8_t *)map;
+	mapSize_ = (size_t)st.st_size;
+	return true;
+}
+
+void ZipAssetReader::BuildIndex() {
+	const size_t EOCD_SIZE = 22;
+	if (mapSize_ < EOCD_SIZE) {
+		return;
+	}
+
+	// The end of central directory record is last, followed by a comment of up to 64KB.
+	const size_t searchStart = mapSize_ - EOCD_SIZE;
+	const size_t searchEnd = searchStart > 0xFFFF ? searchStart - 0xFFFF : 0;
+	const uint8_t *eocd = nullptr;
+	for (size_t pos = searchStart; ; --pos) {
+		if (ReadLE32(map_ + pos) == 0x06054b50) {
+			eocd = map_ + pos;
+			break;
+		}
+		if (pos == searchEnd)
+			break;
+	}
+	if (!eocd) {
+		ELOG("No central directory found in zip, falling back to libzip");
+		return;
+	}
+
+	int count = ReadLE16(eocd + 10);
+	uint32_t dirSize = ReadLE32(eocd + 12);
+	uint32_t dirOffset = ReadLE32(eocd + 16);
+	if ((uint64_t)dirOffset + dirSize > mapSize_) {
+		return;
+	}
+
+	const uint8_t *p = map_ + dirOffset;
+	const uint8_t *end = p + dirSize;
+	for (int i = 0; i < count; i++) {
+		if (p + 46 > end || ReadLE32(p) != 0x02014b50) {
+			// Zip64 or damaged, let libzip deal with it.
+			ELOG("Bad central directory entry %d in zip, falling back to libzip", i);
+			index_.clear();
+			return;
+		}
+		uint16_t flags = ReadLE16(p + 8);
+		uint16_t nameLen = ReadLE16(p + 28);
+		uint16_t extraLen = ReadLE16(p + 30);
+		uint16_t commentLen = ReadLE16(p + 32);
+		uint32_t localOffset = ReadLE32(p + 42);
+		if (p + 46 + nameLen > end) {
+			index_.clear();
+			return;
+		}
+
+		IndexEntry entry;
+		entry.name.assign((const char *)p + 46, nameLen);
+		entry.method = ReadLE16(p + 10);
+		entry.compressedSize = ReadLE32(p + 20);
+		entry.size = ReadLE32(p + 24);
+		entry.dataOffset = 0;
+
+		// The local header's extra field can differ from the central one (zipalign pads it.)
+		bool encrypted = (flags & 1) != 0;
+		if (!encrypted && (uint64_t)localOffset + 30 <= mapSize_ && ReadLE32(map_ + localOffset) == 0x04034b50) {
+			uint64_t dataOffset = (uint64_t)localOffset + 30 + ReadLE16(map_ + localOffset + 26) + ReadLE16(map_ + localOffset + 28);
+			if (dataOffset + entry.compressedSize <= mapSize_) {
+				entry.dataOffset = (uint32_t)dataOffset;
+			}
+		}
+
+		// Like zip_name_locate, the first entry with a name wins.
+		index_.emplace(ZipLowerCase(entry.name.c_str()), entry);
+		p += 46 + nameLen + extraLen + commentLen;
+	}
+}
+
+const ZipAssetReader::IndexEntry *ZipAssetReader::FindEntry(const char *path) const {
+	auto it = index_.find(ZipLowerCase(path));
+	if (it == index_.end())
+		return nullptr;
+	return &it->second;
+}
+
+uint8_t *ZipAssetReader::ReadMapped(const IndexEntry &entry, size_t *size) const {
+	const uint8_t *src = map_ + entry.dataOffset;
+	uint8_t *contents = new uint8_t[entry.size + 1];
+	bool success = false;
+	if (entry.method == ZIP_CM_STORE) {
+		if (entry.compressedSize == entry.size) {
+			memcpy(contents, src, entry.size);
+			success = true;
+		}
+	} else if (entry.method == ZIP_CM_DEFLATE) {
+		if (entry.size == 0) {
+			success = true;
+		} else {
+			z_stream zs;
+			memset(&zs, 0, sizeof(zs));
+			// Raw deflate, zip entries have no zlib header.
+			if (inflateInit2(&zs, -MAX_WBITS) == Z_OK) {
+				zs.next_in = (Bytef *)src;
+				zs.avail_in = entry.compressedSize;
+				zs.next_out = contents;
+				zs.avail_out = entry.size;
+				int result = inflate(&zs, Z_FINISH);
+				success = result == Z_STREAM_END && zs.total_out == entry.size;
+				inflateEnd(&zs);
+			}
+		}
+	}
+
+	if (!success) {
+		delete [] contents;
+		return nullptr;
+	}
+	contents[entry.size] = 0;
+	*size = entry.size;
+	return contents;
 }
 
 uint8_t *ZipAssetReader::ReadAsset(const char *path, size_t *size) {
 	char temp_path[1024];
 	strcpy(temp_path, in_zip_path_);
 	strcat(temp_path, path);
+
+	if (!index_.empty()) {
+		const IndexEntry *entry = FindEntry(temp_path);
+		if (!entry) {
+			// Not in the archive, no need to ask libzip.
+			return nullptr;
+		}
+		if (entry->dataOffset != 0) {
+			uint8_t *data = ReadMapped(*entry, size);
+			if (data)
+				return data;
+		}
+	}
+
+	std::lock_guard<std::mutex> guard(lock_);
 	return ReadFromZip(zip_file_, temp_path, size);
 }
 
@@ -153,6 +335,7 @@ bool ZipAssetReader::GetFileListing(const char *orig_path, std::vector<FileInfo>
 	char path[1024];
 	strcpy(path, in_zip_path_);
 	strcat(path, orig_path);
+	std::lock_guard<std::mutex> guard(lock_);
 
 	std::set<std::string> filters;
 	std::string tmp;
@@ -173,15 +356,22 @@ bool ZipAssetReader::GetFileListing(const char *orig_path, std::vector<FileInfo>
 	// We just loop through the whole ZIP file and deduce what files are in this directory, and what subdirectories there are.
 	std::set<std::string> files;
 	std::set<std::string> directories;
-	int numFiles = zip_get_num_files(zip_file_);
+	int numFiles = index_.empty() ? zip_get_num_files(zip_file_) : 0;
 	size_t pathlen = strlen(path);
 	if (path[pathlen-1] == '/')
 		pathlen--;
-	for (int i = 0; i < numFiles; i++) {
-		const char* name = zip_get_name(zip_file_, i, 0);
+	auto indexIter = index_.begin();
+	for (int i = 0; i < numFiles || indexIter != index_.end(); i++) {
+		const char *name;
+		if (indexIter != index_.end()) {
+			name = indexIter->second.name.c_str();
+			++indexIter;
+		} else {
+			name = zip_get_name(zip_file_, i, 0);
+		}
 		if (!name)
 			continue;
-		if (!memcmp(name, path, pathlen)) {
+		if (!strncmp(name, path, pathlen)) {
 			// The prefix is right. Let's see if this is a file or path.
 			const char *slashPos = strchr(name + pathlen + 1, '/');
 			if (slashPos != 0) {
@@ -239,6 +429,24 @@ bool ZipAssetReader::GetFileInfo(const char *path, FileInfo *info) {
 	char temp_path[1024];
 	strcpy(temp_path, in_zip_path_);
 	strcat(temp_path, path);
+
+	if (!index_.empty()) {
+		const IndexEntry *entry = FindEntry(temp_path);
+		if (!entry) {
+			// ZIP files do not have real directories, see below.
+			info->exists = false;
+			info->size = 0;
+			return false;
+		}
+		info->fullName = path;
+		info->exists = true;
+		info->isWritable = false;
+		info->isDirectory = false;
+		info->size = entry->size;
+		return true;
+	}
+
+	std::lock_guard<std::mutex> guard(lock_);
 	if (0 != zip_stat(zip_file_, temp_path, ZIP_FL_NOCASE|ZIP_FL_UNCHANGED, &zstat)) {
 		// ZIP files do not have real directories, so we'll end up here if we
 		// try to stat one. For now that's fine.
@@ -342,7 +550,29 @@ static bool IsLocalPath(const char *path) {
 	return isUnixLocal || isWindowsLocal;
 }
 
+static std::atomic<int> readCount;
+static std::atomic<uint64_t> readBytes;
+static std::atomic<uint64_t> readMicros;
+
+static uint8_t *VFSReadFileUntimed(const char *filename, size_t *size);
+
 uint8_t *VFSReadFile(const char *filename, size_t *size) {
+	double start = real_time_now();
+	uint8_t *data = VFSReadFileUntimed(filename, size);
+	readMicros += (uint64_t)((real_time_now() - start) * 1000000.0);
+	readCount++;
+	if (data)
+		readBytes += *size;
+	return data;
+}
+
+void VFSGetReadStats(int *count, uint64_t *bytes, double *seconds) {
+	*count = readCount;
+	*bytes = readBytes;
+	*seconds = readMicros / 1000000.0;
+}
+
+static uint8_t *VFSReadFileUntimed(const char *filename, size_t *size) {
 	if (IsLocalPath(filename)) {
 		// Local path, not VFS.
 		// ILOG("Not a VFS path: %s . Reading local file.", filename);
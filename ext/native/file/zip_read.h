@@ -6,7 +6,9 @@
 #endif
 
 #include <string.h>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 
 #include "base/basictypes.h"
 #include "file/vfs.h"
@@ -56,8 +58,30 @@ class ZipAssetReader : public AssetReader {
 	}
 
 private:
+	struct IndexEntry {
+		std::string name;
+		int method;
+		uint32_t compressedSize;
+		uint32_t size;
+		// Where the entry's data starts in map_, or 0 if it can't be read from the map.
+		uint32_t dataOffset;
+	};
+
+	bool MapArchive(const char *zip_file);
+	void BuildIndex();
+	const IndexEntry *FindEntry(const char *path) const;
+	uint8_t *ReadMapped(const IndexEntry &entry, size_t *size) const;
+
 	zip *zip_file_;
+	// libzip handles aren't thread safe, and assets are read from the UI and loader threads.
+	std::mutex lock_;
 	char in_zip_path_[256];
+
+	// The archive mapped read only, and its central directory by lowercased name.  Entries
+	// are read straight from the map without the lock, libzip is only a fallback.
+	const uint8_t *map_;
+	size_t mapSize_;
+	std::unordered_map<std::string, IndexEntry> index_;
 };
 #endif
 
@@ -6,7 +6,7 @@
 
 namespace DX9 {
 
-bool CompilePixelShader(LPDIRECT3DDEVICE9 device, const char *code, LPDIRECT3DPIXELSHADER9 *pShader, LPD3DXCONSTANTTABLE *pShaderTable, std::string &errorMessage) {
+bool CompilePixelShader(LPDIRECT3DDEVICE9 device, const char *code, LPDIRECT3DPIXELSHADER9 *pShader, LPD3DXCONSTANTTABLE *pShaderTable, std::string &errorMessage, std::vector<uint8_t> *byteCodeOut) {
 	ID3DXBuffer *pShaderCode = nullptr;
 	ID3DXBuffer *pErrorMsg = nullptr;
 
@@ -41,12 +41,16 @@ bool CompilePixelShader(LPDIRECT3DDEVICE9 device, const char *code, LPDIRECT3DPI
 	device->CreatePixelShader( (DWORD*)pShaderCode->GetBufferPointer(), 
 		pShader );
 
+	if (byteCodeOut) {
+		const uint8_t *buf = (const uint8_t *)pShaderCode->GetBufferPointer();
+		byteCodeOut->assign(buf, buf + pShaderCode->GetBufferSize());
+	}
 	pShaderCode->Release();
 
 	return true;
 }
 
-bool CompileVertexShader(LPDIRECT3DDEVICE9 device, const char *code, LPDIRECT3DVERTEXSHADER9 *pShader, LPD3DXCONSTANTTABLE *pShaderTable, std::string &errorMessage) {
+bool CompileVertexShader(LPDIRECT3DDEVICE9 device, const char *code, LPDIRECT3DVERTEXSHADER9 *pShader, LPD3DXCONSTANTTABLE *pShaderTable, std::string &errorMessage, std::vector<uint8_t> *byteCodeOut) {
 	ID3DXBuffer *pShaderCode = nullptr;
 	ID3DXBuffer *pErrorMsg = nullptr;
 
@@ -81,6 +85,10 @@ bool CompileVertexShader(LPDIRECT3DDEVICE9 device, const char *code, LPDIRECT3DV
 	device->CreateVertexShader( (DWORD*)pShaderCode->GetBufferPointer(), 
 		pShader );
 
+	if (byteCodeOut) {
+		const uint8_t *buf = (const uint8_t *)pShaderCode->GetBufferPointer();
+		byteCodeOut->assign(buf, buf + pShaderCode->GetBufferSize());
+	}
 	pShaderCode->Release();
 
 	return true;
@@ -2,14 +2,16 @@
 
 #include "Common/CommonWindows.h"
 #include <initguid.h>
+#include <cstdint>
 #include <string>
+#include <vector>
 #include <d3d9.h>
 
 struct ID3DXConstantTable;
 
 namespace DX9 {
 
-bool CompilePixelShader(LPDIRECT3DDEVICE9 device, const char *code, LPDIRECT3DPIXELSHADER9 *pShader, ID3DXConstantTable **pShaderTable, std::string &errorMessage);
-bool CompileVertexShader(LPDIRECT3DDEVICE9 device, const char *code, LPDIRECT3DVERTEXSHADER9 *pShader, ID3DXConstantTable **pShaderTable, std::string &errorMessage);
+bool CompilePixelShader(LPDIRECT3DDEVICE9 device, const char *code, LPDIRECT3DPIXELSHADER9 *pShader, ID3DXConstantTable **pShaderTable, std::string &errorMessage, std::vector<uint8_t> *byteCodeOut = nullptr);
+bool CompileVertexShader(LPDIRECT3DDEVICE9 device, const char *code, LPDIRECT3DVERTEXSHADER9 *pShader, ID3DXConstantTable **pShaderTable, std::string &errorMessage, std::vector<uint8_t> *byteCodeOut = nullptr);
 
 }  // namespace
@@ -73,6 +73,7 @@ void DrawBuffer::Shutdown() {
 	pipeline_ = nullptr;
 	draw_ = nullptr;
 	count_ = 0;
+	drawCalls_ = 0;
 }
 
 void DrawBuffer::Begin(Draw::Pipeline *program) {
@@ -106,6 +107,7 @@ void DrawBuffer::Flush(bool set_blend_state) {
 	} else {
 		draw_->DrawUP((const void *)verts_, count_);
 	}
+	drawCalls_++;
 	count_ = 0;
 }
 
@@ -74,6 +74,10 @@ class DrawBuffer {
 
 	int Count() const { return count_; }
 
+	// Number of draw calls issued by Flush, for UI profiling.
+	int DrawCallCount() const { return drawCalls_; }
+	void ResetDrawCallCount() { drawCalls_ = 0; }
+
 	void Flush(bool set_blend_state = true);
 
 	void Rect(float x, float y, float w, float h, uint32_t color, int align = ALIGN_TOPLEFT);
@@ -187,6 +191,7 @@ class DrawBuffer {
 
 	Vertex *verts_;
 	int count_;
+	int drawCalls_ = 0;
 	DrawBufferPrimitiveMode mode_;
 	const Atlas *atlas;
 
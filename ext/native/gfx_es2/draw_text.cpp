@@ -33,6 +33,19 @@ void TextDrawer::SetFontScale(float xscale, float yscale) {
 	fontScaleY_ = yscale;
 }
 
+void TextDrawer::BindStringTexture(DrawBuffer &target, Draw::Texture *texture) {
+	if (texture != boundTexture_) {
+		target.Flush(true);
+		draw_->BindTexture(0, texture);
+		boundTexture_ = texture;
+	}
+}
+
+void TextDrawer::FlushStrings(DrawBuffer &target) {
+	target.Flush(true);
+	boundTexture_ = nullptr;
+}
+
 float TextDrawer::CalculateDPIScale() {
 	float scale = g_dpi_scale_y;
 	if (scale >= 1.0f) {
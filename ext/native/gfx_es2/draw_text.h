@@ -62,6 +62,10 @@ class TextDrawer {
 	// Use for housekeeping like throwing out old strings.
 	virtual void OncePerFrame() = 0;
 
+	// DrawString leaves its quad queued with the string texture bound, so consecutive
+	// strings sharing a texture go out in a single draw. Call this before binding anything else.
+	void FlushStrings(DrawBuffer &target);
+
 	float CalculateDPIScale();
 
 	// Factory function that selects implementation.
@@ -73,6 +77,8 @@ class TextDrawer {
 	Draw::DrawContext *draw_;
 	virtual void ClearCache() = 0;
 	void WrapString(std::string &out, const char *str, float maxWidth);
+	// Flushes the target only if it has to switch textures.
+	void BindStringTexture(DrawBuffer &target, Draw::Texture *texture);
 
 	struct CacheKey {
 		bool operator < (const CacheKey &other) const {
@@ -87,6 +93,7 @@ class TextDrawer {
 	};
 
 	int frameCount_;
+	Draw::Texture *boundTexture_ = nullptr;
 	float fontScaleX_;
 	float fontScaleY_;
 	float dpiScale_;
@@ -164,7 +164,6 @@ void TextDrawerAndroid::DrawString(DrawBuffer &target, const char *str, float x,
 		return;
 
 	CacheKey key{ std::string(str), fontHash_ };
-	target.Flush(true);
 
 	TextStringEntry *entry;
 
@@ -172,7 +171,6 @@ void TextDrawerAndroid::DrawString(DrawBuffer &target, const char *str, float x,
 	if (iter != cache_.end()) {
 		entry = iter->second.get();
 		entry->lastUsedFrame = frameCount_;
-		draw_->BindTexture(0, entry->texture);
 	} else {
 		double size = 0.0;
 		auto iter = fontMap_.find(fontHash_);
@@ -223,13 +221,12 @@ void TextDrawerAndroid::DrawString(DrawBuffer &target, const char *str, float x,
 		entry->texture = draw_->CreateTexture(desc);
 		delete[] bitmapData;
 		cache_[key] = std::unique_ptr<TextStringEntry>(entry);
-		draw_->BindTexture(0, entry->texture);
 	}
+	BindStringTexture(target, entry->texture);
 	float w = entry->bmWidth * fontScaleX_ * dpiScale_;
 	float h = entry->bmHeight * fontScaleY_ * dpiScale_;
 	DrawBuffer::DoAlign(align, &x, &y, &w, &h);
 	target.DrawTexRect(x, y, x + w, y + h, 0.0f, 0.0f, 1.0f, 1.0f, color);
-	target.Flush(true);
 }
 
 void TextDrawerAndroid::ClearCache() {
@@ -239,6 +236,7 @@ void TextDrawerAndroid::ClearCache() {
 	}
 	cache_.clear();
 	sizeCache_.clear();
+	boundTexture_ = nullptr;
 }
 
 void TextDrawerAndroid::DrawStringRect(DrawBuffer &target, const char *str, const Bounds &bounds, uint32_t color, int align) {
@@ -280,6 +278,8 @@ void TextDrawerAndroid::OncePerFrame() {
 	if (frameCount_ % 23 == 0) {
 		for (auto iter = cache_.begin(); iter != cache_.end();) {
 			if (frameCount_ - iter->second->lastUsedFrame > 100) {
+				if (iter->second->texture == boundTexture_)
+					boundTexture_ = nullptr;
 				if (iter->second->texture)
 					iter->second->texture->Release();
 				cache_.erase(iter++);
@@ -75,15 +75,12 @@ void TextDrawerQt::DrawString(DrawBuffer &target, const char *str, float x, floa
 	uint32_t stringHash = hash::Adler32((const uint8_t *)str, strlen(str));
 	uint32_t entryHash = stringHash ^ fontHash_ ^ (align << 24);
 
-	target.Flush(true);
-
 	TextStringEntry *entry;
 
 	auto iter = cache_.find(entryHash);
 	if (iter != cache_.end()) {
 		entry = iter->second.get();
 		entry->lastUsedFrame = frameCount_;
-		draw_->BindTexture(0, entry->texture);
 	} else {
 		QFont *font = fontMap_.find(fontHash_)->second;
 		QFontMetrics fm(*font);
@@ -126,11 +123,11 @@ void TextDrawerQt::DrawString(DrawBuffer &target, const char *str, float x, floa
 		delete[] bitmapData;
 		cache_[entryHash] = std::unique_ptr<TextStringEntry>(entry);
 	}
+	BindStringTexture(target, entry->texture);
 	float w = entry->bmWidth * fontScaleX_;
 	float h = entry->bmHeight * fontScaleY_;
 	DrawBuffer::DoAlign(align, &x, &y, &w, &h);
 	target.DrawTexRect(x, y, x + w, y + h, 0.0f, 0.0f, 1.0f, 1.0f, color);
-	target.Flush(true);
 }
 
 void TextDrawerQt::ClearCache() {
@@ -140,6 +137,7 @@ void TextDrawerQt::ClearCache() {
 	}
 	cache_.clear();
 	sizeCache_.clear();
+	boundTexture_ = nullptr;
 	// Also wipe the font map.
 	for (auto iter : fontMap_) {
 		delete iter.second;
@@ -184,6 +182,8 @@ void TextDrawerQt::OncePerFrame() {
 	if (frameCount_ % 23 == 0) {
 		for (auto iter = cache_.begin(); iter != cache_.end();) {
 			if (frameCount_ - iter->second->lastUsedFrame > 100) {
+				if (iter->second->texture == boundTexture_)
+					boundTexture_ = nullptr;
 				if (iter->second->texture)
 					iter->second->texture->Release();
 				cache_.erase(iter++);
@@ -197,8 +197,6 @@ void TextDrawerWin32::DrawString(DrawBuffer &target, const char *str, float x, f
 
 	CacheKey key{ std::string(str), fontHash_ };
 
-	target.Flush(true);
-
 	TextStringEntry *entry;
 
 	auto iter = cache_.find(key);
@@ -309,7 +307,7 @@ void TextDrawerWin32::DrawString(DrawBuffer &target, const char *str, float x, f
 		cache_[key] = std::unique_ptr<TextStringEntry>(entry);
 	}
 
-	draw_->BindTexture(0, entry->texture);
+	BindStringTexture(target, entry->texture);
 
 	// Okay, the texture is bound, let's draw.
 	float w = entry->width * fontScaleX_ * dpiScale_;
@@ -318,7 +316,6 @@ void TextDrawerWin32::DrawString(DrawBuffer &target, const char *str, float x, f
 	float v = entry->height / (float)entry->bmHeight;
 	DrawBuffer::DoAlign(align, &x, &y, &w, &h);
 	target.DrawTexRect(x, y, x + w, y + h, 0.0f, 0.0f, u, v, color);
-	target.Flush(true);
 }
 
 void TextDrawerWin32::RecreateFonts() {
@@ -335,6 +332,7 @@ void TextDrawerWin32::ClearCache() {
 	}
 	cache_.clear();
 	sizeCache_.clear();
+	boundTexture_ = nullptr;
 }
 
 void TextDrawerWin32::DrawStringRect(DrawBuffer &target, const char *str, const Bounds &bounds, uint32_t color, int align) {
@@ -374,6 +372,8 @@ void TextDrawerWin32::OncePerFrame() {
 	if (frameCount_ % 23 == 0) {
 		for (auto iter = cache_.begin(); iter != cache_.end();) {
 			if (frameCount_ - iter->second->lastUsedFrame > 100) {
+				if (iter->second->texture == boundTexture_)
+					boundTexture_ = nullptr;
 				if (iter->second->texture)
 					iter->second->texture->Release();
 				cache_.erase(iter++);
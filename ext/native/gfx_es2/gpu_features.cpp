@@ -4,6 +4,7 @@
 
 #include "base/logging.h"
 #include "base/stringutil.h"
+#include "util/hash/hash.h"
 
 #if !PPSSPP_PLATFORM(UWP)
 #include "gfx/gl_common.h"
@@ -145,6 +146,12 @@ void CheckGLExtensions() {
 		strncpy(gl_extensions.model, renderer, sizeof(gl_extensions.model));
 		gl_extensions.model[sizeof(gl_extensions.model) - 1] = 0;
 	}
+
+	{
+		// Program binaries are only valid for the exact driver that produced them.
+		std::string driverStr = std::string(cvendor ? cvendor : "") + "|" + (renderer ? renderer : "") + "|" + (versionStr ? versionStr : "");
+		gl_extensions.driverHash = hash::Adler32((const uint8_t *)driverStr.data(), driverStr.size());
+	}
 	
 	// Start by assuming we're at 2.0.
 	int parsed[2] = {2, 0};
@@ -304,6 +311,8 @@ void CheckGLExtensions() {
 	gl_extensions.EXT_copy_image = strstr(extString, "GL_EXT_copy_image") != 0;
 	gl_extensions.ARB_copy_image = strstr(extString, "GL_ARB_copy_image") != 0;
 	gl_extensions.ARB_buffer_storage = strstr(extString, "GL_ARB_buffer_storage") != 0;
+	gl_extensions.ARB_get_program_binary = strstr(extString, "GL_ARB_get_program_binary") != 0;
+	gl_extensions.ARB_shader_stencil_export = strstr(extString, "GL_ARB_shader_stencil_export") != 0;
 	gl_extensions.ARB_vertex_array_object = strstr(extString, "GL_ARB_vertex_array_object") != 0;
 	gl_extensions.ARB_texture_float = strstr(extString, "GL_ARB_texture_float") != 0;
 	gl_extensions.EXT_texture_filter_anisotropic = strstr(extString, "GL_EXT_texture_filter_anisotropic") != 0;
@@ -448,7 +457,7 @@ void CheckGLExtensions() {
 			// ARB_gpu_shader5 = true;
 		}
 		if (gl_extensions.VersionGEThan(4, 1)) {
-			// ARB_get_program_binary = true;
+			gl_extensions.ARB_get_program_binary = true;
 			// ARB_separate_shader_objects = true;
 			// ARB_shader_precision = true;
 			// ARB_viewport_array = true;
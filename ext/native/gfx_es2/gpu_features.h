@@ -35,6 +35,7 @@ struct GLExtensions {
 	int ver[3];
 	int gpuVendor;
 	char model[128];
+	uint32_t driverHash;  // Hash of the vendor, renderer and version strings, for keying driver-specific caches.
 
 	bool IsGLES;
 	bool IsCoreContext;
@@ -63,6 +64,8 @@ struct GLExtensions {
 	bool ARB_texture_float;
 	bool ARB_draw_instanced;
 	bool ARB_buffer_storage;
+	bool ARB_get_program_binary;
+	bool ARB_shader_stencil_export;
 
 	// EXT
 	bool EXT_swap_control_tear;
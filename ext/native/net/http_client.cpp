@@ -130,6 +130,11 @@ bool Connection::Connect(int maxTries, double timeout, bool *cancelConnect) {
 			for (int sock : sockets) {
 				if ((intptr_t)sock_ == -1 && FD_ISSET(sock, &fds)) {
 					fd_util::SetNonBlocking(sock, false);
+#ifdef SO_NOSIGPIPE
+					// No MSG_NOSIGNAL here, so don't die writing to a closed keepalive connection.
+					int noSigPipe = 1;
+					setsockopt(sock, SOL_SOCKET, SO_NOSIGPIPE, &noSigPipe, sizeof(noSigPipe));
+#endif
 					sock_ = sock;
 				} else {
 					closesocket(sock);
@@ -168,6 +173,7 @@ namespace http {
 Client::Client() {
 	httpVersion_ = "1.1";
 	userAgent_ = USERAGENT;
+	keepAlive_ = false;
 }
 
 Client::~Client() {
@@ -273,7 +279,7 @@ int Client::SendRequestWithData(const char *method, const char *resource, const
 		"%s %s HTTP/%s\r\n"
 		"Host: %s\r\n"
 		"User-Agent: %s\r\n"
-		"Connection: close\r\n"
+		"Connection: %s\r\n"
 		"%s"
 		"\r\n";
 
@@ -281,6 +287,7 @@ int Client::SendRequestWithData(const char *method, const char *resource, const
 		method, resource, httpVersion_,
 		host_.c_str(),
 		userAgent_,
+		keepAlive_ ? "keep-alive" : "close",
 		otherHeaders ? otherHeaders : "");
 	buffer.Append(data);
 	bool flushed = buffer.FlushSocket(sock());
@@ -291,8 +298,16 @@ int Client::SendRequestWithData(const char *method, const char *resource, const
 }
 
 int Client::ReadResponseHeaders(Buffer *readbuf, std::vector<std::string> &responseHeaders, float *progress) {
-	// Snarf all the data we can into RAM. A little unsafe but hey.
-	if (readbuf->Read(sock(), 4096) < 0) {
+	if (keepAlive_) {
+		// The connection won't close after this response, so read just until the headers end.
+		while (readbuf->OffsetToAfterDoubleCRLF() < 0) {
+			if (readbuf->ReadSome(sock(), 4096) <= 0) {
+				ELOG("Failed to read HTTP headers :(");
+				return -1;
+			}
+		}
+	} else if (readbuf->Read(sock(), 4096) < 0) {
+		// Snarf all the data we can into RAM. A little unsafe but hey.
 		ELOG("Failed to read HTTP headers :(");
 		return -1;
 	}
@@ -331,6 +346,7 @@ int Client::ReadResponseHeaders(Buffer *readbuf, std::vector<std::string> &respo
 int Client::ReadResponseEntity(Buffer *readbuf, const std::vector<std::string> &responseHeaders, Buffer *output, float *progress, bool *cancelled) {
 	bool gzip = false;
 	bool chunked = false;
+	bool hasContentLength = false;
 	int contentLength = 0;
 	for (std::string line : responseHeaders) {
 		if (startsWithNoCase(line, "Content-Length:")) {
@@ -340,6 +356,7 @@ int Client::ReadResponseEntity(Buffer *readbuf, const std::vector<std::string> &
 			}
 			if (size_pos != line.npos) {
 				contentLength = atoi(&line[size_pos]);
+				hasContentLength = true;
 				chunked = false;
 			}
 		} else if (startsWithNoCase(line, "Content-Encoding:")) {
@@ -361,6 +378,37 @@ int Client::ReadResponseEntity(Buffer *readbuf, const std::vector<std::string> &
 		*progress = 0.1f;
 	}
 
+	if (keepAlive_ && hasContentLength && !chunked) {
+		// Read only this response, the rest belongs to the next one (if pipelined.)
+		while (readbuf->size() < (size_t)contentLength) {
+			if (cancelled && *cancelled)
+				return -1;
+			if (readbuf->ReadSome(sock(), contentLength - readbuf->size()) <= 0)
+				return -1;
+			if (progress)
+				*progress = (float)readbuf->size() / (float)contentLength;
+		}
+		if (gzip) {
+			std::string compressed, decompressed;
+			readbuf->Take(contentLength, &compressed);
+			if (!decompress_string(compressed, &decompressed)) {
+				ELOG("Error decompressing using zlib");
+				if (progress)
+					*progress = 0.0f;
+				return -1;
+			}
+			output->Append(decompressed);
+		} else {
+			std::string data;
+			readbuf->Take(contentLength, &data);
+			output->Append(data);
+		}
+		if (progress) {
+			*progress = 1.0f;
+		}
+		return 0;
+	}
+
 	if (!contentLength || !progress) {
 		// No way to know how far along we are. Let's just not update the progress counter.
 		if (!readbuf->ReadAll(sock(), contentLength))
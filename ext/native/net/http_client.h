@@ -76,6 +76,9 @@ class Client : public net::Connection {
 
 	const char *userAgent_;
 	const char *httpVersion_;
+	// Ask the server to keep the connection open, so several requests (even pipelined ones) can use it.
+	// Responses are then read by their length, and any bytes past one stay in readbuf for the next.
+	bool keepAlive_;
 };
 
 // Not particularly efficient, but hey - it's a background download, that's pretty cool :P
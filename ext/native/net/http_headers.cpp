@@ -13,7 +13,7 @@ namespace http {
 
 RequestHeader::RequestHeader()
     : status(200), referer(0), user_agent(0),
-      resource(0), params(0), content_length(-1), first_header_(true) {
+      resource(0), params(0), content_length(-1), keep_alive(false), first_header_(true) {
 }
 
 RequestHeader::~RequestHeader() {
@@ -98,6 +98,7 @@ int RequestHeader::ParseHttpHeader(const char *buffer) {
       type = FULL;
     else
       type = SIMPLE;
+    keep_alive = strstr(buffer, "HTTP/1.1") != nullptr;
     return 0;
   }
 
@@ -156,6 +157,15 @@ void RequestHeader::ParseHeaders(net::InputSink *sink) {
 
 	ILOG("finished parsing request.");
 	ok = line_count > 1;
+
+	std::string connection;
+	if (GetOther("connection", &connection)) {
+		std::transform(connection.begin(), connection.end(), connection.begin(), tolower);
+		if (connection.find("close") != connection.npos)
+			keep_alive = false;
+		else if (connection.find("keep-alive") != connection.npos)
+			keep_alive = true;
+	}
 }
 
 }  // namespace http
@@ -37,6 +37,8 @@ class RequestHeader {
   };
   Method method;
   bool ok;
+  // Whether the client wants to send more requests on this connection (HTTP/1.1 default, or asked for.)
+  bool keep_alive;
   void ParseHeaders(net::InputSink *sink);
   bool GetParamValue(const char *param_name, std::string *value) const;
   bool GetOther(const char *name, std::string *value) const;
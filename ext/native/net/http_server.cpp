@@ -1,3 +1,4 @@
+#include "ppsspp_config.h"
 #include "base/timeutil.h"
 
 #ifdef _WIN32
@@ -8,6 +9,7 @@
 
 #include <winsock2.h>
 #include <ws2tcpip.h>
+#include <mswsock.h>
 #include <io.h>
 
 #else
@@ -18,6 +20,15 @@
 #include <netinet/in.h>       /*  struct sockaddr_in        */
 #include <arpa/inet.h>        /*  inet (3) funtions         */
 #include <unistd.h>           /*  misc. UNIX functions      */
+#include <errno.h>
+
+#if defined(__linux__)
+#include <sys/sendfile.h>
+#define HAVE_SENDFILE_LINUX
+#elif defined(__APPLE__)
+#include <sys/uio.h>
+#define HAVE_SENDFILE_BSD
+#endif
 
 #define closesocket close
 
@@ -41,20 +52,38 @@ namespace http {
 // Note: charset here helps prevent XSS.
 const char *const DEFAULT_MIME_TYPE = "text/html; charset=utf-8";
 
+// How long an idle kept-alive connection waits for the next request.
+static const double KEEPALIVE_TIMEOUT = 15.0;
+
 Request::Request(int fd)
-    : fd_(fd) {
+    : fd_(fd), ownsConnection_(true) {
 	in_ = new net::InputSink(fd);
 	out_ = new net::OutputSink(fd);
+	Init();
+}
+
+Request::Request(int fd, net::InputSink *in, net::OutputSink *out)
+	: in_(in), out_(out), fd_(fd), ownsConnection_(false) {
+	Init();
+}
+
+void Request::Init() {
 	header_.ParseHeaders(in_);
 
 	if (header_.ok) {
 		ILOG("The request carried with it %i bytes", (int)header_.content_length);
+		// We don't read request bodies back out for handlers, so only reuse connections without one.
+		keepAlive_ = header_.keep_alive && header_.content_length <= 0;
 	} else {
 	    Close();
 	}
 }
 
 Request::~Request() {
+	if (!ownsConnection_) {
+		// The next request on the connection may already be buffered in in_.
+		return;
+	}
 	Close();
 
 	CHECK(in_->Empty());
@@ -84,11 +113,15 @@ void Request::WriteHttpResponseHeader(int status, int64_t size, const char *mime
 	default: statusStr = "OK"; break;
 	}
 
+	// Without a length, the client can only find the end of the body by the connection closing.
+	if (size < 0)
+		keepAlive_ = false;
+
 	net::OutputSink *buffer = Out();
-	buffer->Printf("HTTP/1.0 %03d %s\r\n", status, statusStr);
+	buffer->Printf("HTTP/%s %03d %s\r\n", keepAlive_ ? "1.1" : "1.0", status, statusStr);
 	buffer->Push("Server: PPSSPPServer v0.1\r\n");
 	buffer->Printf("Content-Type: %s\r\n", mimeType ? mimeType : DEFAULT_MIME_TYPE);
-	buffer->Push("Connection: close\r\n");
+	buffer->Push(keepAlive_ ? "Connection: keep-alive\r\n" : "Connection: close\r\n");
 	if (size >= 0) {
 		buffer->Printf("Content-Length: %llu\r\n", size);
 	}
@@ -98,6 +131,102 @@ void Request::WriteHttpResponseHeader(int status, int64_t size, const char *mime
 	buffer->Push("\r\n");
 }
 
+#if defined(_WIN32) && !PPSSPP_PLATFORM(UWP)
+static LPFN_TRANSMITFILE GetTransmitFile(SOCKET sock) {
+	// Looked up through the socket rather than linked, to avoid depending on mswsock.lib.
+	GUID guid = WSAID_TRANSMITFILE;
+	LPFN_TRANSMITFILE func = nullptr;
+	DWORD bytes = 0;
+	if (WSAIoctl(sock, SIO_GET_EXTENSION_FUNCTION_POINTER, &guid, sizeof(guid), &func, sizeof(func), &bytes, nullptr, nullptr) != 0)
+		return nullptr;
+	return func;
+}
+#endif
+
+bool Request::WriteFileRange(FILE *fp, int64_t offset, int64_t length) const {
+	if (!out_->Flush())
+		return false;
+
+#if defined(_WIN32) && !PPSSPP_PLATFORM(UWP)
+	LPFN_TRANSMITFILE transmitFile = GetTransmitFile((SOCKET)fd_);
+	HANDLE file = (HANDLE)_get_osfhandle(_fileno(fp));
+	if (transmitFile && file != INVALID_HANDLE_VALUE) {
+		LARGE_INTEGER pos;
+		pos.QuadPart = offset;
+		if (SetFilePointerEx(file, pos, nullptr, FILE_BEGIN)) {
+			// TransmitFile wants a blocking socket when not overlapped.
+			fd_util::SetNonBlocking(fd_, false);
+			bool success = true;
+			while (success && length > 0) {
+				const DWORD chunk = (DWORD)std::min(length, (int64_t)0x40000000);
+				success = transmitFile((SOCKET)fd_, file, chunk, 0, nullptr, nullptr, 0) != FALSE;
+				length -= chunk;
+			}
+			fd_util::SetNonBlocking(fd_, true);
+			return success;
+		}
+	}
+#elif defined(HAVE_SENDFILE_LINUX) || defined(HAVE_SENDFILE_BSD)
+	const int fileFd = fileno(fp);
+	bool unsupported = false;
+	while (length > 0) {
+		const int64_t chunk = std::min(length, (int64_t)0x40000000);
+#if defined(HAVE_SENDFILE_LINUX)
+		off_t pos = (off_t)offset;
+		ssize_t result = sendfile(fd_, fileFd, &pos, (size_t)chunk);
+		int64_t sent = result > 0 ? result : 0;
+		if (result == 0) {
+			ELOG("Unexpected end of file while sending");
+			return false;
+		}
+#else
+		// On EAGAIN, this still gets set to what was partially sent.
+		off_t sentLen = (off_t)chunk;
+		int result = sendfile(fileFd, fd_, (off_t)offset, &sentLen, nullptr, 0);
+		int64_t sent = sentLen;
+		if (result == 0 && sentLen == 0) {
+			ELOG("Unexpected end of file while sending");
+			return false;
+		}
+#endif
+		if (result < 0 && errno != EAGAIN && errno != EINTR) {
+			// Some filesystems and sockets can't do this, those can take the plain path below.
+			unsupported = errno == EINVAL || errno == ENOSYS || errno == ENOTSUP;
+			if (!unsupported)
+				return false;
+			break;
+		}
+		offset += sent;
+		length -= sent;
+		if (length > 0 && sent == 0 && !fd_util::WaitUntilReady(fd_, KEEPALIVE_TIMEOUT, true)) {
+			ELOG("Timed out sending file to client");
+			return false;
+		}
+	}
+	if (!unsupported)
+		return true;
+#endif
+
+	// Fallback: read through a buffer and push it like any other data.
+#ifdef _WIN32
+	if (_fseeki64(fp, offset, SEEK_SET) != 0)
+		return false;
+#else
+	if (fseeko(fp, (off_t)offset, SEEK_SET) != 0)
+		return false;
+#endif
+	const size_t CHUNK_SIZE = 256 * 1024;
+	char *buf = new char[CHUNK_SIZE];
+	bool success = true;
+	while (success && length > 0) {
+		const size_t chunk = (size_t)std::min(length, (int64_t)CHUNK_SIZE);
+		success = fread(buf, chunk, 1, fp) == 1 && out_->Push(buf, chunk);
+		length -= chunk;
+	}
+	delete [] buf;
+	return success && out_->Flush();
+}
+
 void Request::WritePartial() const {
   CHECK(fd_);
   out_->Flush();
@@ -117,7 +246,7 @@ void Request::Close() {
 }
 
 Server::Server(threading::Executor *executor)
-  : port_(0), executor_(executor) {
+  : port_(0), stopping_(false), executor_(executor) {
   RegisterHandler("/", std::bind(&Server::HandleListing, this, std::placeholders::_1));
   SetFallbackHandler(std::bind(&Server::Handle404, this, std::placeholders::_1));
 }
@@ -204,22 +333,44 @@ bool Server::Run(int port) {
 }
 
 void Server::Stop() {
+	stopping_ = true;
 	closesocket(listener_);
 }
 
-void Server::HandleConnection(int conn_fd) {
-  Request request(conn_fd);
-  if (!request.IsOK()) {
-    WLOG("Bad request, ignoring.");
-    return;
-  }
-  HandleRequestDefault(request);
+bool Server::WaitForNextRequest(int conn_fd) {
+	// Wake up regularly so a stopping server doesn't wait out the whole idle timeout.
+	for (double waited = 0.0; waited < KEEPALIVE_TIMEOUT && !stopping_; waited += 1.0) {
+		if (fd_util::WaitUntilReady(conn_fd, 1.0, false))
+			return true;
+	}
+	return false;
+}
 
-  // TODO: Way to mark the content body as read, read it here if never read.
-  // This allows the handler to stream if need be.
+void Server::HandleConnection(int conn_fd) {
+	net::InputSink in(conn_fd);
+	net::OutputSink out(conn_fd);
+	bool first = true;
 
-  // TODO: Could handle keep alive here.
-  request.Write();
+	while (true) {
+		Request request(conn_fd, &in, &out);
+		if (!request.IsOK()) {
+			// A client closing its idle kept-alive connection looks just like this.
+			if (first)
+				WLOG("Bad request, ignoring.");
+			return;
+		}
+		first = false;
+		HandleRequestDefault(request);
+
+		// TODO: Way to mark the content body as read, read it here if never read.
+		// This allows the handler to stream if need be.
+
+		request.WritePartial();
+		if (!request.KeepAlive() || stopping_ || (in.Empty() && !WaitForNextRequest(conn_fd))) {
+			request.Close();
+			return;
+		}
+	}
 }
 
 void Server::HandleRequest(const Request &request) {
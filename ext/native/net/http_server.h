@@ -1,6 +1,8 @@
 #ifndef _HTTP_SERVER_H
 #define _HTTP_SERVER_H
 
+#include <atomic>
+#include <cstdio>
 #include <functional>
 #include <map>
 
@@ -18,6 +20,8 @@ namespace http {
 class Request {
  public:
   Request(int fd);
+  // For requests on a kept-alive connection.  The connection owns the socket and sinks.
+  Request(int fd, net::InputSink *in, net::OutputSink *out);
   ~Request();
 
   const char *resource() const {
@@ -47,15 +51,25 @@ class Request {
   void Close();
 
   bool IsOK() const { return fd_ > 0; }
+  // Whether another request can follow on this connection once the response is out.
+  bool KeepAlive() const { return keepAlive_; }
 
-  // If size is negative, no Content-Length: line is written.
+  // If size is negative, no Content-Length: line is written (and the connection won't be kept alive.)
   void WriteHttpResponseHeader(int status, int64_t size = -1, const char *mimeType = nullptr, const char *otherHeaders = nullptr) const;
 
+  // Sends length bytes of the file starting at offset, straight from the OS file cache
+  // (sendfile / TransmitFile) where possible.  Flushes anything already pushed first.
+  bool WriteFileRange(FILE *fp, int64_t offset, int64_t length) const;
+
 private:
+	void Init();
+
 	net::InputSink *in_;
 	net::OutputSink *out_;
 	RequestHeader header_;
 	int fd_;
+	bool ownsConnection_;
+	mutable bool keepAlive_ = false;
 };
 
 // Register handlers on this class to serve stuff.
@@ -74,6 +88,7 @@ class Server {
 	// for a new connection to handle.
 	bool RunSlice(double timeout);
 	bool Listen(int port);
+	// Closes the listener.  Idle kept-alive connections notice within a second and close too.
 	void Stop();
 
 	void RegisterHandler(const char *url_path, UrlHandlerFunc handler);
@@ -90,6 +105,7 @@ class Server {
 
 private:
 	void HandleConnection(int conn_fd);
+	bool WaitForNextRequest(int conn_fd);
 
 	// Things like default 404, etc.
 	void HandleRequestDefault(const Request &request);
@@ -100,6 +116,7 @@ class Server {
 
 	int listener_;
 	int port_;
+	std::atomic<bool> stopping_;
 
 	UrlHandlerMap handlers_;
 	UrlHandlerFunc fallback_;
@@ -1,15 +1,18 @@
 // Ultra-lightweight category profiler with history.
 
 #include <algorithm>
+#include <atomic>
 #include <mutex>
 #include <map>
 #include <string>
 #include <vector>
 
+#include <stdio.h>
 #include <string.h>
 
 #include "base/logging.h"
 #include "base/timeutil.h"
+#include "file/file_util.h"
 #include "gfx_es2/draw_buffer.h"
 #include "ppsspp_config.h"
 #include "profiler/profiler.h"
@@ -20,9 +23,11 @@
 // iOS did not support C++ thread_local before iOS 9
 #define MAX_THREADS 1     // Can be any number, represents concurrent threads calling the profiler.
 #else
-#define MAX_THREADS 4     // Can be any number, represents concurrent threads calling the profiler.
+#define MAX_THREADS 8     // Can be any number, represents concurrent threads calling the profiler.
 #endif
 #define HISTORY_SIZE 128 // Must be power of 2
+#define TRACE_SIZE 65536 // Must be power of 2, events kept per thread while tracing.
+#define TRACE_FRAME -2   // Category used to mark the end of a frame in the trace.
 
 #ifndef _DEBUG
 // If the compiler can collapse identical strings, we don't even need the strcmp.
@@ -31,6 +36,7 @@
 
 struct Category {
 	const char *name;
+	bool gpu;
 };
 
 struct CategoryFrame {
@@ -48,14 +54,33 @@ struct Profiler {
 	int parentCategory[MAX_THREADS][MAX_DEPTH];
 	double eventStart[MAX_THREADS][MAX_CATEGORIES];
 	double curFrameStart;
+	// Never reset, unlike history.
+	double totalTime[MAX_THREADS][MAX_CATEGORIES];
+	int64_t totalCount[MAX_THREADS][MAX_CATEGORIES];
+};
+
+struct TraceEvent {
+	double time;
+	int category;
+	bool begin;
+};
+
+struct TraceBuffer {
+	TraceEvent events[TRACE_SIZE];
+	// Total events written, wraps around the buffer.
+	uint32_t count;
 };
 
 static Profiler profiler;
 static Category categories[MAX_CATEGORIES];
+static TraceBuffer *traceBuffers;
+static std::atomic<bool> tracing;
+static double traceStart;
 static std::mutex categoriesLock;
 static int threadIdAfterLast = 0;
 static std::mutex threadsLock;
 static CategoryFrame *history;
+static CategoryFrame *gpuHistory;
 #if MAX_THREADS > 1
 thread_local int profilerThreadId = -1;
 #else
@@ -73,6 +98,7 @@ void internal_profiler_init() {
 		}
 	}
 	history = new CategoryFrame[HISTORY_SIZE * MAX_THREADS];
+	gpuHistory = new CategoryFrame[HISTORY_SIZE];
 }
 
 static int internal_profiler_find_thread() {
@@ -118,10 +144,20 @@ int internal_profiler_find_cat(const char *category_name, bool create_missing) {
 	return -1;
 }
 
+static inline void internal_profiler_trace(int thread_id, int category, bool begin, double now) {
+	TraceBuffer &buf = traceBuffers[thread_id];
+	TraceEvent &ev = buf.events[buf.count & (TRACE_SIZE - 1)];
+	ev.time = now;
+	ev.category = category;
+	ev.begin = begin;
+	buf.count++;
+}
+
 // Suspend, also used to prepare for leaving.
 static void internal_profiler_suspend(int thread_id, int category, double now) {
 	double diff = now - profiler.eventStart[thread_id][category];
 	history[MAX_THREADS * profiler.historyPos + thread_id].time_taken[category] += (float)diff;
+	profiler.totalTime[thread_id][category] += diff;
 	profiler.eventStart[thread_id][category] = 0.0;
 }
 
@@ -138,6 +174,9 @@ int internal_profiler_enter(const char *category_name, int *out_thread_id) {
 	}
 
 	int &depth = profiler.depth[thread_id];
+	if (tracing) {
+		internal_profiler_trace(thread_id, category, true, real_time_now());
+	}
 	if (profiler.eventStart[thread_id][category] == 0.0f) {
 		double now = real_time_now();
 		int parent = profiler.parentCategory[thread_id][depth];
@@ -170,6 +209,9 @@ void internal_profiler_leave(int thread_id, int category) {
 	}
 
 	double now = real_time_now();
+	if (tracing) {
+		internal_profiler_trace(thread_id, category, false, now);
+	}
 
 	depth--;
 	if (depth < 0) {
@@ -181,6 +223,7 @@ void internal_profiler_leave(int thread_id, int category) {
 	if (parent != category) {
 		internal_profiler_suspend(thread_id, category, now);
 		history[MAX_THREADS * profiler.historyPos + thread_id].count[category]++;
+		profiler.totalCount[thread_id][category]++;
 
 		if (parent != -1) {
 			// Resume tracking the parent.
@@ -196,9 +239,27 @@ void internal_profiler_end_frame() {
 		FLOG("Can't be inside a profiler scope at end of frame!");
 	}
 	profiler.curFrameStart = real_time_now();
+	if (tracing) {
+		internal_profiler_trace(thread_id, TRACE_FRAME, true, profiler.curFrameStart);
+	}
 	profiler.historyPos++;
 	profiler.historyPos &= (HISTORY_SIZE - 1);
 	memset(&history[MAX_THREADS * profiler.historyPos], 0, sizeof(CategoryFrame) * MAX_THREADS);
+	memset(&gpuHistory[profiler.historyPos], 0, sizeof(CategoryFrame));
+}
+
+void internal_profiler_add_gpu_time(const char *category_name, double seconds) {
+	int category = internal_profiler_find_cat(category_name, true);
+	if (category == -1 || !gpuHistory) {
+		return;
+	}
+	categories[category].gpu = true;
+	// Usually called from a render thread, a small race with the frame flip only misplaces one sample.
+	CategoryFrame &frame = gpuHistory[profiler.historyPos];
+	frame.time_taken[category] += (float)seconds;
+	frame.count[category]++;
+	profiler.totalTime[0][category] += seconds;
+	profiler.totalCount[0][category]++;
 }
 
 const char *Profiler_GetCategoryName(int i) {
@@ -258,6 +319,21 @@ void Profiler_GetSlowestHistory(int category, int *slowestThreads, float *data,
 	}
 }
 
+bool Profiler_IsGPUCategory(int category) {
+	return category >= 0 && category < MAX_CATEGORIES && categories[category].gpu;
+}
+
+void Profiler_GetGPUHistory(int category, float *data, int count) {
+	for (int i = 0; i < HISTORY_SIZE; i++) {
+		int x = i - count + profiler.historyPos + 1;
+		while (x < 0)
+			x += HISTORY_SIZE;
+		while (x >= HISTORY_SIZE)
+			x -= HISTORY_SIZE;
+		data[i] = gpuHistory[x].time_taken[category];
+	}
+}
+
 void Profiler_GetHistory(int category, int thread, float *data, int count) {
 	for (int i = 0; i < HISTORY_SIZE; i++) {
 		int x = i - count + profiler.historyPos + 1;
@@ -268,3 +344,74 @@ void Profiler_GetHistory(int category, int thread, float *data, int count) {
 		data[i] = history[MAX_THREADS * x + thread].time_taken[category];
 	}
 }
+
+void Profiler_GetTotal(int category, double *seconds, int64_t *count) {
+	*seconds = 0.0;
+	*count = 0;
+	for (int thread = 0; thread < threadIdAfterLast; ++thread) {
+		*seconds += profiler.totalTime[thread][category];
+		*count += profiler.totalCount[thread][category];
+	}
+}
+
+void Profiler_SetTracing(bool enable) {
+	if (enable && !traceBuffers) {
+		traceBuffers = new TraceBuffer[MAX_THREADS];
+	}
+	if (enable && !tracing) {
+		for (int i = 0; i < MAX_THREADS; i++) {
+			traceBuffers[i].count = 0;
+		}
+		traceStart = real_time_now();
+	}
+	tracing = enable;
+}
+
+bool Profiler_IsTracing() {
+	return tracing;
+}
+
+bool Profiler_WriteTrace(const char *filename) {
+	// Stop first, so the buffers don't change under us (much - a scope might just be ending.)
+	Profiler_SetTracing(false);
+	if (!traceBuffers) {
+		return false;
+	}
+
+	FILE *f = openCFile(filename, "wb");
+	if (!f) {
+		ELOG("Unable to write trace to %s", filename);
+		return false;
+	}
+
+	// Chrome trace event format, readable by chrome://tracing and Perfetto.
+	fprintf(f, "{\"traceEvents\":[\n");
+	bool first = true;
+	for (int thread = 0; thread < threadIdAfterLast; ++thread) {
+		const TraceBuffer &buf = traceBuffers[thread];
+		if (buf.count == 0)
+			continue;
+
+		fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"Thread %d\"}}", first ? "" : ",\n", thread, thread);
+		first = false;
+
+		uint32_t start = buf.count > TRACE_SIZE ? buf.count - TRACE_SIZE : 0;
+		int depth = 0;
+		for (uint32_t i = start; i < buf.count; ++i) {
+			const TraceEvent &ev = buf.events[i & (TRACE_SIZE - 1)];
+			double ts = (ev.time - traceStart) * 1000000.0;
+			if (ev.category == TRACE_FRAME) {
+				fprintf(f, ",\n{\"name\":\"frame\",\"ph\":\"i\",\"s\":\"g\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}", ts, thread);
+				continue;
+			}
+			// The start of this scope might have been overwritten.
+			if (!ev.begin && depth == 0)
+				continue;
+			depth += ev.begin ? 1 : -1;
+			fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"%s\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}", Profiler_GetCategoryName(ev.category), ev.begin ? "B" : "E", ts, thread);
+		}
+	}
+	fprintf(f, "\n]}\n");
+	fclose(f);
+	return true;
+}
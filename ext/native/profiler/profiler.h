@@ -21,6 +21,20 @@ int Profiler_GetNumThreads();
 void Profiler_GetSlowestThreads(int *data, int count);
 void Profiler_GetSlowestHistory(int category, int *slowestThreads, float *data, int count);
 void Profiler_GetHistory(int category, int thread, float *data, int count);
+// Time and number of calls since init, summed over all threads.
+void Profiler_GetTotal(int category, double *seconds, int64_t *count);
+
+// GPU times arrive from the backends' timestamp queries, a few frames late, and are kept
+// apart from the CPU threads. Categories are found by name just like the CPU ones.
+void internal_profiler_add_gpu_time(const char *category_name, double seconds);
+bool Profiler_IsGPUCategory(int category);
+void Profiler_GetGPUHistory(int category, float *data, int count);
+
+// While tracing, each scope's begin and end is also kept with a timestamp per thread, in a
+// ring buffer of the most recent events.  Writing saves them as Chrome trace JSON, and stops.
+void Profiler_SetTracing(bool enable);
+bool Profiler_IsTracing();
+bool Profiler_WriteTrace(const char *filename);
 
 class ProfileThis {
 public:
@@ -38,11 +52,13 @@ class ProfileThis {
 #define PROFILE_INIT() internal_profiler_init();
 #define PROFILE_THIS_SCOPE(cat) ProfileThis _profile_scoped(cat);
 #define PROFILE_END_FRAME() internal_profiler_end_frame();
+#define PROFILE_GPU_TIME(cat, seconds) internal_profiler_add_gpu_time(cat, seconds);
 
 #else
 
 #define PROFILE_INIT()
 #define PROFILE_THIS_SCOPE(cat)
 #define PROFILE_END_FRAME()
+#define PROFILE_GPU_TIME(cat, seconds)
 
 #endif
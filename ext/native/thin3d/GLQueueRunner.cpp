@@ -9,6 +9,7 @@
 #include "gfx_es2/gpu_features.h"
 #include "math/dataconv.h"
 #include "math/math_util.h"
+#include "profiler/profiler.h"
 
 #define TEXCACHE_NAME_CACHE_SIZE 16
 
@@ -65,6 +66,126 @@ void GLQueueRunner::DestroyDeviceObjects() {
 	readbackBufferSize_ = 0;
 	delete[] tempBuffer_;
 	tempBufferSize_ = 0;
+#ifndef USING_GLES2
+	if (stepTimersCreated_) {
+		glDeleteQueries(NUM_TIMER_SLOTS * STEP_TIMER_LATENCY * 2, &stepTimerQueries_[0][0][0]);
+		memset(stepTimerPending_, 0, sizeof(stepTimerPending_));
+		stepTimersCreated_ = false;
+	}
+	if (namedTimersCreated_) {
+		for (int i = 0; i < MAX_NAMED_TIMERS; i++) {
+			glDeleteQueries(2, namedTimers_[i].queries);
+			namedTimers_[i].name = nullptr;
+		}
+		namedTimersCreated_ = false;
+	}
+#endif
+}
+
+int GLQueueRunner::BeginNamedTimer(const char *name) {
+#ifndef USING_GLES2
+	if (!name || gl_extensions.IsGLES || !gl_extensions.VersionGEThan(3, 3))
+		return -1;
+	if (!namedTimersCreated_) {
+		for (int i = 0; i < MAX_NAMED_TIMERS; i++) {
+			glGenQueries(2, namedTimers_[i].queries);
+			namedTimers_[i].name = nullptr;
+		}
+		namedTimersCreated_ = true;
+	}
+	for (int i = 0; i < MAX_NAMED_TIMERS; i++) {
+		if (!namedTimers_[i].name) {
+			glQueryCounter(namedTimers_[i].queries[0], GL_TIMESTAMP);
+			namedTimers_[i].name = name;
+			return i;
+		}
+	}
+#endif
+	// All still in flight, skip this one.
+	return -1;
+}
+
+void GLQueueRunner::EndNamedTimer(int index) {
+#ifndef USING_GLES2
+	if (index >= 0)
+		glQueryCounter(namedTimers_[index].queries[1], GL_TIMESTAMP);
+#endif
+}
+
+void GLQueueRunner::BeginStepTimer(int slot) {
+#ifndef USING_GLES2
+	if (slot < 0 || slot >= NUM_TIMER_SLOTS)
+		return;
+	stepTimerCur_[slot] = -1;
+	if (gl_extensions.IsGLES || !gl_extensions.VersionGEThan(3, 3))
+		return;
+	if (!stepTimersCreated_) {
+		glGenQueries(NUM_TIMER_SLOTS * STEP_TIMER_LATENCY * 2, &stepTimerQueries_[0][0][0]);
+		stepTimersCreated_ = true;
+	}
+	int index = stepTimerNext_[slot];
+	if (stepTimerPending_[slot][index]) {
+		// The GPU is far behind, skip timing this one rather than waiting.
+		return;
+	}
+	glQueryCounter(stepTimerQueries_[slot][index][0], GL_TIMESTAMP);
+	stepTimerCur_[slot] = index;
+#endif
+}
+
+void GLQueueRunner::EndStepTimer(int slot) {
+#ifndef USING_GLES2
+	if (slot < 0 || slot >= NUM_TIMER_SLOTS || stepTimerCur_[slot] < 0)
+		return;
+	int index = stepTimerCur_[slot];
+	glQueryCounter(stepTimerQueries_[slot][index][1], GL_TIMESTAMP);
+	stepTimerPending_[slot][index] = true;
+	stepTimerNext_[slot] = (index + 1) % STEP_TIMER_LATENCY;
+	stepTimerCur_[slot] = -1;
+#endif
+}
+
+void GLQueueRunner::ResolveStepTimers() {
+#ifndef USING_GLES2
+	if (!stepTimersCreated_)
+		return;
+	for (int slot = 0; slot < NUM_TIMER_SLOTS; slot++) {
+		for (int i = 0; i < STEP_TIMER_LATENCY; i++) {
+			if (!stepTimerPending_[slot][i])
+				continue;
+			GLint available = 0;
+			glGetQueryObjectiv(stepTimerQueries_[slot][i][1], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available)
+				continue;
+			GLuint64 start = 0, end = 0;
+			glGetQueryObjectui64v(stepTimerQueries_[slot][i][0], GL_QUERY_RESULT, &start);
+			glGetQueryObjectui64v(stepTimerQueries_[slot][i][1], GL_QUERY_RESULT, &end);
+			lastStepTimes_[slot] = (float)((double)(end - start) / 1000000.0);
+			stepTimerPending_[slot][i] = false;
+		}
+	}
+#endif
+}
+
+void GLQueueRunner::ResolveNamedTimers() {
+#ifndef USING_GLES2
+	if (!namedTimersCreated_)
+		return;
+	for (int i = 0; i < MAX_NAMED_TIMERS; i++) {
+		NamedTimer &timer = namedTimers_[i];
+		if (!timer.name)
+			continue;
+		GLint available = 0;
+		glGetQueryObjectiv(timer.queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			continue;
+		GLuint64 start = 0, end = 0;
+		glGetQueryObjectui64v(timer.queries[0], GL_QUERY_RESULT, &start);
+		glGetQueryObjectui64v(timer.queries[1], GL_QUERY_RESULT, &end);
+		PROFILE_GPU_TIME(timer.name, (double)(end - start) / 1000000000.0);
+		timer.name = nullptr;
+	}
+#endif
 }
 
 void GLQueueRunner::RunInitSteps(const std::vector<GLRInitStep> &steps) {
@@ -103,66 +224,100 @@ void GLQueueRunner::RunInitSteps(const std::vector<GLRInitStep> &steps) {
 		case GLRInitStepType::CREATE_PROGRAM:
 		{
 			GLRProgram *program = step.create_program.program;
-			program->program = glCreateProgram();
-			_assert_msg_(G3D, step.create_program.num_shaders > 0, "Can't create a program with zero shaders");
-			for (int j = 0; j < step.create_program.num_shaders; j++) {
-				_dbg_assert_msg_(G3D, step.create_program.shaders[j]->shader, "Can't create a program with a null shader");
-				glAttachShader(program->program, step.create_program.shaders[j]->shader);
+			if (!program->binary_.empty()) {
+				program->program = glCreateProgram();
+				glProgramBinary(program->program, program->binaryFormat_, program->binary_.data(), (GLsizei)program->binary_.size());
+				GLint binaryStatus = GL_FALSE;
+				glGetProgramiv(program->program, GL_LINK_STATUS, &binaryStatus);
+				if (binaryStatus == GL_TRUE) {
+					program->linkedFromBinary_ = true;
+					program->binaryReady_ = true;
+				} else {
+					// Probably a driver update. Just compile and link it the normal way.
+					WARN_LOG(G3D, "Cached program binary was rejected by the driver, relinking");
+					glDeleteProgram(program->program);
+					program->program = 0;
+					program->binary_.clear();
+				}
 			}
 
-			for (auto iter : program->semantics_) {
-				glBindAttribLocation(program->program, iter.location, iter.attrib);
-			}
+			if (!program->linkedFromBinary_) {
+				program->program = glCreateProgram();
+				_assert_msg_(G3D, step.create_program.num_shaders > 0, "Can't create a program with zero shaders");
+				for (int j = 0; j < step.create_program.num_shaders; j++) {
+					_dbg_assert_msg_(G3D, step.create_program.shaders[j]->shader, "Can't create a program with a null shader");
+					glAttachShader(program->program, step.create_program.shaders[j]->shader);
+				}
+
+				for (auto iter : program->semantics_) {
+					glBindAttribLocation(program->program, iter.location, iter.attrib);
+				}
 
 #if !defined(USING_GLES2)
-			if (step.create_program.support_dual_source) {
-				// Dual source alpha
-				glBindFragDataLocationIndexed(program->program, 0, 0, "fragColor0");
-				glBindFragDataLocationIndexed(program->program, 0, 1, "fragColor1");
-			} else if (gl_extensions.VersionGEThan(3, 3, 0)) {
-				glBindFragDataLocation(program->program, 0, "fragColor0");
-			}
+				if (step.create_program.support_dual_source) {
+					// Dual source alpha
+					glBindFragDataLocationIndexed(program->program, 0, 0, "fragColor0");
+					glBindFragDataLocationIndexed(program->program, 0, 1, "fragColor1");
+				} else if (gl_extensions.VersionGEThan(3, 3, 0)) {
+					glBindFragDataLocation(program->program, 0, "fragColor0");
+				}
 #elif !defined(IOS)
-			if (gl_extensions.GLES3 && step.create_program.support_dual_source) {
-				glBindFragDataLocationIndexedEXT(program->program, 0, 0, "fragColor0");
-				glBindFragDataLocationIndexedEXT(program->program, 0, 1, "fragColor1");
-			}
+				if (gl_extensions.GLES3 && step.create_program.support_dual_source) {
+					glBindFragDataLocationIndexedEXT(program->program, 0, 0, "fragColor0");
+					glBindFragDataLocationIndexedEXT(program->program, 0, 1, "fragColor1");
+				}
 #endif
-			glLinkProgram(program->program);
-
-			GLint linkStatus = GL_FALSE;
-			glGetProgramiv(program->program, GL_LINK_STATUS, &linkStatus);
-			if (linkStatus != GL_TRUE) {
-				GLint bufLength = 0;
-				glGetProgramiv(program->program, GL_INFO_LOG_LENGTH, &bufLength);
-				if (bufLength) {
-					char *buf = new char[bufLength];
-					glGetProgramInfoLog(program->program, bufLength, nullptr, buf);
-
-					// TODO: Could be other than vs/fs.  Also, we're assuming order here...
-					const char *vsDesc = step.create_program.shaders[0]->desc.c_str();
-					const char *fsDesc = step.create_program.num_shaders > 1 ? step.create_program.shaders[1]->desc.c_str() : nullptr;
-					const char *vsCode = step.create_program.shaders[0]->code.c_str();
-					const char *fsCode = step.create_program.num_shaders > 1 ? step.create_program.shaders[1]->code.c_str() : nullptr;
-					Reporting::ReportMessage("Error in shader program link: info: %s\nfs: %s\n%s\nvs: %s\n%s", buf, fsDesc, fsCode, vsDesc, vsCode);
-
-					ELOG("Could not link program:\n %s", buf);
-					ERROR_LOG(G3D, "VS desc:\n%s", vsDesc);
-					ERROR_LOG(G3D, "FS desc:\n%s", fsDesc);
-					ERROR_LOG(G3D, "VS:\n%s\n", vsCode);
-					ERROR_LOG(G3D, "FS:\n%s\n", fsCode);
+				if (program->retrieveBinary_) {
+					glProgramParameteri(program->program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+				}
+				glLinkProgram(program->program);
+
+				GLint linkStatus = GL_FALSE;
+				glGetProgramiv(program->program, GL_LINK_STATUS, &linkStatus);
+				if (linkStatus != GL_TRUE) {
+					GLint bufLength = 0;
+					glGetProgramiv(program->program, GL_INFO_LOG_LENGTH, &bufLength);
+					if (bufLength) {
+						char *buf = new char[bufLength];
+						glGetProgramInfoLog(program->program, bufLength, nullptr, buf);
+
+						// TODO: Could be other than vs/fs.  Also, we're assuming order here...
+						const char *vsDesc = step.create_program.shaders[0]->desc.c_str();
+						const char *fsDesc = step.create_program.num_shaders > 1 ? step.create_program.shaders[1]->desc.c_str() : nullptr;
+						const char *vsCode = step.create_program.shaders[0]->code.c_str();
+						const char *fsCode = step.create_program.num_shaders > 1 ? step.create_program.shaders[1]->code.c_str() : nullptr;
+						Reporting::ReportMessage("Error in shader program link: info: %s\nfs: %s\n%s\nvs: %s\n%s", buf, fsDesc, fsCode, vsDesc, vsCode);
+
+						ELOG("Could not link program:\n %s", buf);
+						ERROR_LOG(G3D, "VS desc:\n%s", vsDesc);
+						ERROR_LOG(G3D, "FS desc:\n%s", fsDesc);
+						ERROR_LOG(G3D, "VS:\n%s\n", vsCode);
+						ERROR_LOG(G3D, "FS:\n%s\n", fsCode);
 
 #ifdef _WIN32
-					OutputDebugStringUTF8(buf);
-					OutputDebugStringUTF8(vsCode);
-					if (fsCode)
-						OutputDebugStringUTF8(fsCode);
+						OutputDebugStringUTF8(buf);
+						OutputDebugStringUTF8(vsCode);
+						if (fsCode)
+							OutputDebugStringUTF8(fsCode);
 #endif
-					delete[] buf;
-				} else {
-					ELOG("Could not link program with %d shaders for unknown reason:", step.create_program.num_shaders);
+						delete[] buf;
+					} else {
+						ELOG("Could not link program with %d shaders for unknown reason:", step.create_program.num_shaders);
+					}
+					break;
+				}
+
+				if (program->retrieveBinary_) {
+					GLint binaryLength = 0;
+					glGetProgramiv(program->program, GL_PROGRAM_BINARY_LENGTH, &binaryLength);
+					if (binaryLength > 0) {
+						program->binary_.resize(binaryLength);
+						GLsizei written = 0;
+						glGetProgramBinary(program->program, binaryLength, &written, &program->binaryFormat_, program->binary_.data());
+						program->binary_.resize(written);
+						program->binaryReady_ = !program->binary_.empty();
+					}
 				}
-				break;
 			}
 
 			glUseProgram(program->program);
@@ -412,11 +567,23 @@ void GLQueueRunner::InitCreateFramebuffer(const GLRInitStep &step) {
 }
 
 void GLQueueRunner::RunSteps(const std::vector<GLRStep *> &steps) {
+	// Init steps and push buffer flushes bind textures, buffers and programs freely.
+	InvalidateStateCache();
+	ResolveStepTimers();
+	ResolveNamedTimers();
+
 	for (size_t i = 0; i < steps.size(); i++) {
 		const GLRStep &step = *steps[i];
+		if (step.stepType != GLRStepType::RENDER) {
+			// The other steps expect the default state, and may bind textures.
+			ResetRenderState();
+		}
+		int namedTimer = BeginNamedTimer(step.timerName);
 		switch (step.stepType) {
 		case GLRStepType::RENDER:
+			BeginStepTimer(step.timerSlot);
 			PerformRenderPass(step);
+			EndStepTimer(step.timerSlot);
 			break;
 		case GLRStepType::COPY:
 			PerformCopy(step);
@@ -434,8 +601,93 @@ void GLQueueRunner::RunSteps(const std::vector<GLRStep *> &steps) {
 			Crash();
 			break;
 		}
+		EndNamedTimer(namedTimer);
+		if (step.stepType != GLRStepType::RENDER) {
+			InvalidateStateCache();
+		}
 		delete steps[i];
 	}
+
+	ResetRenderState();
+}
+
+void GLQueueRunner::InvalidateStateCache() {
+	for (int i = 0; i < CAP_COUNT; i++) {
+		capState_[i] = -1;
+	}
+	curProgram_ = nullptr;
+	for (int i = 0; i < ARRAY_SIZE(curTex_); i++) {
+		curTex_[i] = nullptr;
+	}
+	activeSlot_ = -1;
+	colorMask_ = -1;
+	depthMask_ = -1;
+	depthFunc_ = -1;
+	logicOp_ = -1;
+	blendEqColor_ = (GLuint)-1;
+	blendEqAlpha_ = (GLuint)-1;
+}
+
+void GLQueueRunner::SetCap(GLRCap cap, bool enable) {
+	static const GLenum capEnums[CAP_COUNT] = {
+		GL_DEPTH_TEST,
+		GL_STENCIL_TEST,
+		GL_BLEND,
+		GL_CULL_FACE,
+		GL_DITHER,
+		GL_SCISSOR_TEST,
+#ifndef USING_GLES2
+		GL_COLOR_LOGIC_OP,
+#else
+		0,
+#endif
+	};
+
+	if (capState_[cap] == (int8_t)enable) {
+		stateCallsElided_++;
+		return;
+	}
+	if (capEnums[cap] == 0) {
+		return;
+	}
+	if (enable) {
+		glEnable(capEnums[cap]);
+	} else {
+		glDisable(capEnums[cap]);
+	}
+	capState_[cap] = enable;
+	stateCallsIssued_++;
+}
+
+void GLQueueRunner::SetActiveSlot(int slot) {
+	if (slot == activeSlot_) {
+		stateCallsElided_++;
+		return;
+	}
+	glActiveTexture(GL_TEXTURE0 + slot);
+	activeSlot_ = slot;
+	stateCallsIssued_++;
+}
+
+void GLQueueRunner::SetColorMask(int mask) {
+	if (mask == colorMask_) {
+		stateCallsElided_++;
+		return;
+	}
+	glColorMask(mask & 1, (mask >> 1) & 1, (mask >> 2) & 1, (mask >> 3) & 1);
+	colorMask_ = mask;
+	stateCallsIssued_++;
+}
+
+void GLQueueRunner::ResetRenderState() {
+	SetActiveSlot(0);
+	SetCap(CAP_SCISSOR_TEST, false);
+	SetCap(CAP_DEPTH_TEST, false);
+	SetCap(CAP_STENCIL_TEST, false);
+	SetCap(CAP_BLEND, false);
+	SetCap(CAP_CULL_FACE, false);
+	SetCap(CAP_COLOR_LOGIC_OP, false);
+	SetColorMask(0xF);
 }
 
 void GLQueueRunner::LogSteps(const std::vector<GLRStep *> &steps) {
@@ -480,15 +732,15 @@ void GLQueueRunner::PerformRenderPass(const GLRStep &step) {
 
 	PerformBindFramebufferAsRenderTarget(step);
 
-	glDisable(GL_DEPTH_TEST);
-	glDisable(GL_STENCIL_TEST);
-	glDisable(GL_BLEND);
-	glDisable(GL_CULL_FACE);
-	glDisable(GL_DITHER);
-	glEnable(GL_SCISSOR_TEST);
-#ifndef USING_GLES2
-	glDisable(GL_COLOR_LOGIC_OP);
-#endif
+	// The commands only record changes, so start from a known baseline. Mostly elided
+	// when the previous pass ended up in the same state.
+	SetCap(CAP_DEPTH_TEST, false);
+	SetCap(CAP_STENCIL_TEST, false);
+	SetCap(CAP_BLEND, false);
+	SetCap(CAP_CULL_FACE, false);
+	SetCap(CAP_DITHER, false);
+	SetCap(CAP_SCISSOR_TEST, true);
+	SetCap(CAP_COLOR_LOGIC_OP, false);
 
 	/*
 #ifndef USING_GLES2
@@ -507,61 +759,33 @@ void GLQueueRunner::PerformRenderPass(const GLRStep &step) {
 	}
 
 	GLRFramebuffer *fb = step.render.framebuffer;
-	GLRProgram *curProgram = nullptr;
-	int activeSlot = 0;
-	glActiveTexture(GL_TEXTURE0 + activeSlot);
 
-	// State filtering tracking.
+	// State filtering tracking. The rest lives in the shadow state, see SetCap().
 	int attrMask = 0;
-	int colorMask = -1;
-	int depthMask = -1;
-	int depthFunc = -1;
-	int logicOp = -1;
+	int attrDivisorMask = 0;
 	GLuint curArrayBuffer = (GLuint)-1;
 	GLuint curElemArrayBuffer = (GLuint)-1;
-	bool depthEnabled = false;
-	bool stencilEnabled = false;
-	bool blendEnabled = false;
-	bool cullEnabled = false;
-	bool ditherEnabled = false;
-	bool logicEnabled = false;
-	GLuint blendEqColor = (GLuint)-1;
-	GLuint blendEqAlpha = (GLuint)-1;
-
-	GLRTexture *curTex[8]{};
 
 	auto &commands = step.commands;
 	for (const auto &c : commands) {
 		switch (c.cmd) {
 		case GLRRenderCommand::DEPTH:
+			SetCap(CAP_DEPTH_TEST, c.depth.enabled);
 			if (c.depth.enabled) {
-				if (!depthEnabled) {
-					glEnable(GL_DEPTH_TEST);
-					depthEnabled = true;
-				}
-				if (c.depth.write != depthMask) {
+				if (c.depth.write != depthMask_) {
 					glDepthMask(c.depth.write);
-					depthMask = c.depth.write;
+					depthMask_ = c.depth.write;
 				}
-				if (c.depth.func != depthFunc) {
+				if (c.depth.func != depthFunc_) {
 					glDepthFunc(c.depth.func);
-					depthFunc = c.depth.func;
+					depthFunc_ = c.depth.func;
 				}
-			} else if (!c.depth.enabled && depthEnabled) {
-				glDisable(GL_DEPTH_TEST);
-				depthEnabled = false;
 			}
 			break;
 		case GLRRenderCommand::STENCILFUNC:
+			SetCap(CAP_STENCIL_TEST, c.stencilFunc.enabled);
 			if (c.stencilFunc.enabled) {
-				if (!stencilEnabled) {
-					glEnable(GL_STENCIL_TEST);
-					stencilEnabled = true;
-				}
 				glStencilFunc(c.stencilFunc.func, c.stencilFunc.ref, c.stencilFunc.compareMask);
-			} else if (stencilEnabled) {
-				glDisable(GL_STENCIL_TEST);
-				stencilEnabled = false;
 			}
 			break;
 		case GLRRenderCommand::STENCILOP:
@@ -569,39 +793,23 @@ void GLQueueRunner::PerformRenderPass(const GLRStep &step) {
 			glStencilMask(c.stencilOp.writeMask);
 			break;
 		case GLRRenderCommand::BLEND:
+			SetCap(CAP_BLEND, c.blend.enabled);
 			if (c.blend.enabled) {
-				if (!blendEnabled) {
-					glEnable(GL_BLEND);
-					blendEnabled = true;
-				}
-				if (blendEqColor != c.blend.funcColor || blendEqAlpha != c.blend.funcAlpha) {
+				if (blendEqColor_ != c.blend.funcColor || blendEqAlpha_ != c.blend.funcAlpha) {
 					glBlendEquationSeparate(c.blend.funcColor, c.blend.funcAlpha);
-					blendEqColor = c.blend.funcColor;
-					blendEqAlpha = c.blend.funcAlpha;
+					blendEqColor_ = c.blend.funcColor;
+					blendEqAlpha_ = c.blend.funcAlpha;
 				}
 				glBlendFuncSeparate(c.blend.srcColor, c.blend.dstColor, c.blend.srcAlpha, c.blend.dstAlpha);
-			} else if (!c.blend.enabled && blendEnabled) {
-				glDisable(GL_BLEND);
-				blendEnabled = false;
-			}
-			if (c.blend.mask != colorMask) {
-				glColorMask(c.blend.mask & 1, (c.blend.mask >> 1) & 1, (c.blend.mask >> 2) & 1, (c.blend.mask >> 3) & 1);
-				colorMask = c.blend.mask;
 			}
+			SetColorMask(c.blend.mask);
 			break;
 		case GLRRenderCommand::LOGICOP:
 #ifndef USING_GLES2
-			if (c.logic.enabled) {
-				if (!logicEnabled) {
-					glEnable(GL_COLOR_LOGIC_OP);
-					logicEnabled = true;
-				}
-				if (logicOp != c.logic.logicOp) {
-					glLogicOp(c.logic.logicOp);
-				}
-			} else if (!c.logic.enabled && logicEnabled) {
-				glDisable(GL_COLOR_LOGIC_OP);
-				logicEnabled = false;
+			SetCap(CAP_COLOR_LOGIC_OP, c.logic.enabled);
+			if (c.logic.enabled && logicOp_ != c.logic.logicOp) {
+				glLogicOp(c.logic.logicOp);
+				logicOp_ = c.logic.logicOp;
 			}
 #endif
 			break;
@@ -609,14 +817,11 @@ void GLQueueRunner::PerformRenderPass(const GLRStep &step) {
 			// Scissor test is on, and should be on after leaving this case. If we disable it,
 			// we re-enable it at the end.
 			if (c.clear.scissorW == 0) {
-				glDisable(GL_SCISSOR_TEST);
+				SetCap(CAP_SCISSOR_TEST, false);
 			} else {
 				glScissor(c.clear.scissorX, c.clear.scissorY, c.clear.scissorW, c.clear.scissorH);
 			}
-			if (c.clear.colorMask != colorMask) {
-				glColorMask(c.clear.colorMask & 1, (c.clear.colorMask >> 1) & 1, (c.clear.colorMask >> 2) & 1, (c.clear.colorMask >> 3) & 1);
-				colorMask = c.clear.colorMask;
-			}
+			SetColorMask(c.clear.colorMask);
 			if (c.clear.clearMask & GL_COLOR_BUFFER_BIT) {
 				float color[4];
 				Uint8x4ToFloat4(color, c.clear.clearColor);
@@ -634,7 +839,7 @@ void GLQueueRunner::PerformRenderPass(const GLRStep &step) {
 			}
 			glClear(c.clear.clearMask);
 			if (c.clear.scissorW == 0) {
-				glEnable(GL_SCISSOR_TEST);
+				SetCap(CAP_SCISSOR_TEST, true);
 			}
 			break;
 		case GLRRenderCommand::INVALIDATE:
@@ -680,7 +885,7 @@ void GLQueueRunner::PerformRenderPass(const GLRStep &step) {
 		{
 			int loc = c.uniform4.loc ? *c.uniform4.loc : -1;
 			if (c.uniform4.name) {
-				loc = curProgram->GetUniformLoc(c.uniform4.name);
+				loc = curProgram_->GetUniformLoc(c.uniform4.name);
 			}
 			if (loc >= 0) {
 				switch (c.uniform4.count) {
@@ -704,7 +909,7 @@ void GLQueueRunner::PerformRenderPass(const GLRStep &step) {
 		{
 			int loc = c.uniform4.loc ? *c.uniform4.loc : -1;
 			if (c.uniform4.name) {
-				loc = curProgram->GetUniformLoc(c.uniform4.name);
+				loc = curProgram_->GetUniformLoc(c.uniform4.name);
 			}
 			if (loc >= 0) {
 				switch (c.uniform4.count) {
@@ -728,7 +933,7 @@ void GLQueueRunner::PerformRenderPass(const GLRStep &step) {
 		{
 			int loc = c.uniform4.loc ? *c.uniform4.loc : -1;
 			if (c.uniform4.name) {
-				loc = curProgram->GetUniformLoc(c.uniform4.name);
+				loc = curProgram_->GetUniformLoc(c.uniform4.name);
 			}
 			if (loc >= 0) {
 				glUniformMatrix4fv(loc, 1, false, c.uniformMatrix4.m);
@@ -738,43 +943,49 @@ void GLQueueRunner::PerformRenderPass(const GLRStep &step) {
 		case GLRRenderCommand::BINDTEXTURE:
 		{
 			GLint slot = c.texture.slot;
-			if (slot != activeSlot) {
-				glActiveTexture(GL_TEXTURE0 + slot);
-				activeSlot = slot;
-			}
+			// Later commands like GENMIPS act on the active slot, so always switch.
+			SetActiveSlot(slot);
 			if (c.texture.texture) {
-				if (curTex[slot] != c.texture.texture) {
+				if (curTex_[slot] != c.texture.texture) {
 					glBindTexture(c.texture.texture->target, c.texture.texture->texture);
-					curTex[slot] = c.texture.texture;
+					curTex_[slot] = c.texture.texture;
+					stateCallsIssued_++;
+				} else {
+					stateCallsElided_++;
 				}
 			} else {
 				glBindTexture(GL_TEXTURE_2D, 0);  // Which target? Well we only use this one anyway...
-				curTex[slot] = nullptr;
+				curTex_[slot] = nullptr;
+				stateCallsIssued_++;
 			}
 			break;
 		}
 		case GLRRenderCommand::BIND_FB_TEXTURE:
 		{
 			GLint slot = c.bind_fb_texture.slot;
-			if (slot != activeSlot) {
-				glActiveTexture(GL_TEXTURE0 + slot);
-				activeSlot = slot;
-			}
+			SetActiveSlot(slot);
 			if (c.bind_fb_texture.aspect == GL_COLOR_BUFFER_BIT) {
-				if (curTex[slot] != &c.bind_fb_texture.framebuffer->color_texture)
-				glBindTexture(GL_TEXTURE_2D, c.bind_fb_texture.framebuffer->color_texture.texture);
-				curTex[slot] = &c.bind_fb_texture.framebuffer->color_texture;
+				if (curTex_[slot] != &c.bind_fb_texture.framebuffer->color_texture) {
+					glBindTexture(GL_TEXTURE_2D, c.bind_fb_texture.framebuffer->color_texture.texture);
+					curTex_[slot] = &c.bind_fb_texture.framebuffer->color_texture;
+					stateCallsIssued_++;
+				} else {
+					stateCallsElided_++;
+				}
 			} else {
 				// TODO: Depth texturing?
-				curTex[slot] = nullptr;
+				curTex_[slot] = nullptr;
 			}
 			break;
 		}
 		case GLRRenderCommand::BINDPROGRAM:
 		{
-			if (curProgram != c.program.program) {
+			if (curProgram_ != c.program.program) {
 				glUseProgram(c.program.program->program);
-				curProgram = c.program.program;
+				curProgram_ = c.program.program;
+				stateCallsIssued_++;
+			} else {
+				stateCallsElided_++;
 			}
 			break;
 		}
@@ -802,6 +1013,13 @@ void GLQueueRunner::PerformRenderPass(const GLRStep &step) {
 			for (size_t i = 0; i < layout->entries.size(); i++) {
 				auto &entry = layout->entries[i];
 				glVertexAttribPointer(entry.location, entry.count, entry.type, entry.normalized, entry.stride, (const void *)(c.bindVertexBuffer.offset + entry.offset));
+				if (entry.divisor || (attrDivisorMask & (1 << entry.location))) {
+					glVertexAttribDivisor(entry.location, entry.divisor);
+					if (entry.divisor)
+						attrDivisorMask |= 1 << entry.location;
+					else
+						attrDivisorMask &= ~(1 << entry.location);
+				}
 			}
 			break;
 		}
@@ -841,14 +1059,11 @@ void GLQueueRunner::PerformRenderPass(const GLRStep &step) {
 		case GLRRenderCommand::TEXTURESAMPLER:
 		{
 			GLint slot = c.textureSampler.slot;
-			if (slot != activeSlot) {
-				glActiveTexture(GL_TEXTURE0 + slot);
-				activeSlot = slot;
-			}
-			GLRTexture *tex = curTex[slot];
+			GLRTexture *tex = curTex_[slot];
 			if (!tex) {
 				break;
 			}
+			SetActiveSlot(slot);
 			if (tex->canWrap) {
 				if (tex->wrapS != c.textureSampler.wrapS) {
 					glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, c.textureSampler.wrapS);
@@ -878,14 +1093,11 @@ void GLQueueRunner::PerformRenderPass(const GLRStep &step) {
 		case GLRRenderCommand::TEXTURELOD:
 		{
 			GLint slot = c.textureSampler.slot;
-			if (slot != activeSlot) {
-				glActiveTexture(GL_TEXTURE0 + slot);
-				activeSlot = slot;
-			}
-			GLRTexture *tex = curTex[slot];
+			GLRTexture *tex = curTex_[slot];
 			if (!tex) {
 				break;
 			}
+			SetActiveSlot(slot);
 #ifndef USING_GLES2
 			if (tex->lodBias != c.textureLod.lodBias) {
 				glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_LOD_BIAS, c.textureLod.lodBias);
@@ -903,26 +1115,12 @@ void GLQueueRunner::PerformRenderPass(const GLRStep &step) {
 			break;
 		}
 		case GLRRenderCommand::RASTER:
+			SetCap(CAP_CULL_FACE, c.raster.cullEnable);
 			if (c.raster.cullEnable) {
-				if (!cullEnabled) {
-					glEnable(GL_CULL_FACE);
-					cullEnabled = true;
-				}
 				glFrontFace(c.raster.frontFace);
 				glCullFace(c.raster.cullFace);
-			} else if (!c.raster.cullEnable && cullEnabled) {
-				glDisable(GL_CULL_FACE);
-				cullEnabled = false;
-			}
-			if (c.raster.ditherEnable) {
-				if (!ditherEnabled) {
-					glEnable(GL_DITHER);
-					ditherEnabled = true;
-				}
-			} else if (!c.raster.ditherEnable && ditherEnabled) {
-				glDisable(GL_DITHER);
-				ditherEnabled = false;
 			}
+			SetCap(CAP_DITHER, c.raster.ditherEnable);
 			break;
 		default:
 			Crash();
@@ -934,28 +1132,18 @@ void GLQueueRunner::PerformRenderPass(const GLRStep &step) {
 		if (attrMask & (1 << i)) {
 			glDisableVertexAttribArray(i);
 		}
+		if (attrDivisorMask & (1 << i)) {
+			glVertexAttribDivisor(i, 0);
+		}
 	}
 
-	if (activeSlot != 0) {
-		glActiveTexture(GL_TEXTURE0);
-		activeSlot = 0;  // doesn't matter, just nice.
-	}
-
-	// Wipe out the current state.
+	// Wipe out the buffer state. The rest is left in the shadow state for the next pass,
+	// ResetRenderState() puts it back before anything else runs.
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 	if (gl_extensions.ARB_vertex_array_object) {
 		glBindVertexArray(0);
 	}
-	glDisable(GL_SCISSOR_TEST);
-	glDisable(GL_DEPTH_TEST);
-	glDisable(GL_STENCIL_TEST);
-	glDisable(GL_BLEND);
-	glDisable(GL_CULL_FACE);
-#ifndef USING_GLES2
-	glDisable(GL_COLOR_LOGIC_OP);
-#endif
-	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
 }
 
 void GLQueueRunner::PerformCopy(const GLRStep &step) {
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <cstdint>
 #include <vector>
 #include <unordered_map>
@@ -284,6 +285,10 @@ struct GLRStep {
 	GLRStep(GLRStepType _type) : stepType(_type) {}
 	GLRStepType stepType;
 	std::vector<GLRRenderData> commands;
+	// Render steps only. If >= 0, the pass is timed on the GPU, see GLQueueRunner::GetStepTime.
+	int timerSlot = -1;
+	// If set, the step is timed on the GPU and reported to the profiler under this name.
+	const char *timerName = nullptr;
 	union {
 		struct {
 			GLRFramebuffer *framebuffer;
@@ -320,7 +325,10 @@ struct GLRStep {
 
 class GLQueueRunner {
 public:
-	GLQueueRunner() {}
+	GLQueueRunner() {
+		for (int i = 0; i < NUM_TIMER_SLOTS; i++)
+			stepTimerCur_[i] = -1;
+	}
 
 	void RunInitSteps(const std::vector<GLRInitStep> &steps);
 
@@ -350,7 +358,62 @@ class GLQueueRunner {
 		return it != glStrings_.end() ? it->second : "";
 	}
 
+	// Call once per frame on the render thread, publishes the state call counters for GetStateCallStats.
+	void EndFrameStats() {
+		lastStateCallsIssued_ = stateCallsIssued_;
+		lastStateCallsElided_ = stateCallsElided_;
+		stateCallsIssued_ = 0;
+		stateCallsElided_ = 0;
+	}
+
+	// From the last completed frame. Safe to call from any thread.
+	void GetStateCallStats(int *issued, int *elided) const {
+		*issued = lastStateCallsIssued_;
+		*elided = lastStateCallsElided_;
+	}
+
+	enum {
+		MAX_STEP_TIMERS = 8,
+		// Brackets whole frames, see BeginFrameTimer.
+		FRAME_TIMER_SLOT = MAX_STEP_TIMERS,
+		NUM_TIMER_SLOTS,
+		STEP_TIMER_LATENCY = 4,
+		MAX_NAMED_TIMERS = 64,
+	};
+	// GPU time in milliseconds of the last resolved render pass with this timerSlot. Stays 0 without
+	// timestamp queries (desktop GL 3.3+ only for now.) Safe to call from any thread.
+	float GetStepTime(int slot) const {
+		return slot >= 0 && slot < NUM_TIMER_SLOTS ? lastStepTimes_[slot].load() : 0.0f;
+	}
+	// Times everything run from BeginFrameTimer to EndFrameTimer, read it with GetStepTime(FRAME_TIMER_SLOT).
+	void BeginFrameTimer() {
+		BeginStepTimer(FRAME_TIMER_SLOT);
+	}
+	void EndFrameTimer() {
+		EndStepTimer(FRAME_TIMER_SLOT);
+	}
+
 private:
+	// Capabilities tracked by the shadow state.
+	enum GLRCap {
+		CAP_DEPTH_TEST,
+		CAP_STENCIL_TEST,
+		CAP_BLEND,
+		CAP_CULL_FACE,
+		CAP_DITHER,
+		CAP_SCISSOR_TEST,
+		CAP_COLOR_LOGIC_OP,
+		CAP_COUNT,
+	};
+
+	void SetCap(GLRCap cap, bool enable);
+	void SetActiveSlot(int slot);
+	void SetColorMask(int mask);
+	// Forget everything we know, for when GL state may have been touched behind our back.
+	void InvalidateStateCache();
+	// Puts state back to what code outside the render passes expects.
+	void ResetRenderState();
+
 	void InitCreateFramebuffer(const GLRInitStep &step);
 
 	void PerformBindFramebufferAsRenderTarget(const GLRStep &pass);
@@ -368,6 +431,13 @@ class GLQueueRunner {
 
 	void ResizeReadbackBuffer(size_t requiredSize);
 
+	void BeginStepTimer(int slot);
+	void EndStepTimer(int slot);
+	void ResolveStepTimers();
+	int BeginNamedTimer(const char *name);
+	void EndNamedTimer(int index);
+	void ResolveNamedTimers();
+
 	void fbo_ext_create(const GLRInitStep &step);
 	void fbo_bind_fb_target(bool read, GLuint name);
 	GLenum fbo_get_fb_target(bool read, GLuint **cached);
@@ -402,4 +472,37 @@ class GLQueueRunner {
 	std::unordered_map<int, std::string> glStrings_;
 
 	bool sawOutOfMemory_ = false;
+
+	// Shadow state, kept across render passes within a RunSteps() call. -1 / nullptr means unknown.
+	int8_t capState_[CAP_COUNT];
+	GLRProgram *curProgram_ = nullptr;
+	GLRTexture *curTex_[8]{};
+	int activeSlot_ = -1;
+	int colorMask_ = -1;
+	int depthMask_ = -1;
+	int depthFunc_ = -1;
+	int logicOp_ = -1;
+	GLuint blendEqColor_ = (GLuint)-1;
+	GLuint blendEqAlpha_ = (GLuint)-1;
+
+	int stateCallsIssued_ = 0;
+	int stateCallsElided_ = 0;
+	std::atomic<int> lastStateCallsIssued_{ 0 };
+	std::atomic<int> lastStateCallsElided_{ 0 };
+
+	// Timestamp query pairs per timer slot, resolved a few frames later to avoid stalling.
+	bool stepTimersCreated_ = false;
+	GLuint stepTimerQueries_[NUM_TIMER_SLOTS][STEP_TIMER_LATENCY][2]{};
+	bool stepTimerPending_[NUM_TIMER_SLOTS][STEP_TIMER_LATENCY]{};
+	int stepTimerNext_[NUM_TIMER_SLOTS]{};
+	int stepTimerCur_[NUM_TIMER_SLOTS]{};
+	std::atomic<float> lastStepTimes_[NUM_TIMER_SLOTS]{};
+
+	// Timestamp pairs around steps with a timerName. A set name means the pair is in flight.
+	struct NamedTimer {
+		GLuint queries[2];
+		const char *name;
+	};
+	bool namedTimersCreated_ = false;
+	NamedTimer namedTimers_[MAX_NAMED_TIMERS]{};
 };
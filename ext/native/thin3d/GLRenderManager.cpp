@@ -7,6 +7,16 @@
 #include "GPU/GPUState.h"
 #include "Common/MemoryUtil.h"
 
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+#ifndef GL_DYNAMIC_STORAGE_BIT
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#endif
+
 #if 0 // def _DEBUG
 #define VLOG ILOG
 #else
@@ -70,6 +80,12 @@ void GLRenderManager::ThreadStart() {
 	// Notes on buffer mapping:
 	// NVIDIA GTX 9xx / 2017-10 drivers - mapping improves speed, basic unmap seems best.
 	// PowerVR GX6xxx / iOS 10.3 - mapping has little improvement, explicit flush is slower.
+	// With buffer storage we can skip the map/unmap dance entirely and fence frame reuse ourselves.
+#ifndef IOS
+	if (mapBuffers && hasBufferStorage) {
+		bufferStrategy_ = GLBufferStrategy::PERSISTENT;
+	} else
+#endif
 	if (mapBuffers) {
 		switch (gl_extensions.gpuVendor) {
 		case GPU_VENDOR_NVIDIA:
@@ -96,6 +112,8 @@ void GLRenderManager::ThreadEnd() {
 	queueRunner_.DestroyDeviceObjects();
 	VLOG("PULL: Quitting");
 
+	RetireFences(0);
+
 	// Good point to run all the deleters to get rid of leftover objects.
 	for (int i = 0; i < MAX_INFLIGHT_FRAMES; i++) {
 		frameData_[i].deleter.Perform();
@@ -123,9 +141,7 @@ bool GLRenderManager::ThreadFrame() {
 	// In case of syncs or other partial completion, we keep going until we complete a frame.
 	do {
 		if (nextFrame) {
-			threadFrame_++;
-			if (threadFrame_ >= MAX_INFLIGHT_FRAMES)
-				threadFrame_ = 0;
+			threadFrame_ = threadNextFrame_;
 		}
 		FrameData &frameData = frameData_[threadFrame_];
 		{
@@ -136,6 +152,8 @@ bool GLRenderManager::ThreadFrame() {
 			}
 			if (!frameData.readyForRun && !run_) {
 				// This means we're out of frames to render and run_ is false, so bail.
+				// Nothing more will be submitted, so let StopThread() see every frame as done.
+				RetireFences(0);
 				return false;
 			}
 			VLOG("PULL: Setting frame[%d].readyForRun = false", threadFrame_);
@@ -147,6 +165,8 @@ bool GLRenderManager::ThreadFrame() {
 
 			// Only increment next time if we're done.
 			nextFrame = frameData.type == GLRRunType::END;
+			if (nextFrame)
+				threadNextFrame_ = frameData.nextFrame;
 			assert(frameData.type == GLRRunType::END || frameData.type == GLRRunType::SYNC);
 		}
 		VLOG("PULL: Running frame %d", threadFrame_);
@@ -229,6 +249,7 @@ void GLRenderManager::BindFramebufferAsRenderTarget(GLRFramebuffer *fb, GLRRende
 	// This is what queues up new passes, and can end previous ones.
 	step->render.framebuffer = fb;
 	step->render.numDraws = 0;
+	step->timerName = gpuTimerName_;
 	steps_.push_back(step);
 
 	GLuint clearMask = 0;
@@ -277,6 +298,7 @@ void GLRenderManager::CopyFramebuffer(GLRFramebuffer *src, GLRect2D srcRect, GLR
 	step->copy.src = src;
 	step->copy.dst = dst;
 	step->copy.aspectMask = aspectMask;
+	step->timerName = gpuTimerName_;
 	steps_.push_back(step);
 
 	// Every step clears this state.
@@ -291,6 +313,7 @@ void GLRenderManager::BlitFramebuffer(GLRFramebuffer *src, GLRect2D srcRect, GLR
 	step->blit.dst = dst;
 	step->blit.aspectMask = aspectMask;
 	step->blit.filter = filter;
+	step->timerName = gpuTimerName_;
 	steps_.push_back(step);
 
 	// Every step clears this state.
@@ -303,6 +326,7 @@ bool GLRenderManager::CopyFramebufferToMemorySync(GLRFramebuffer *src, int aspec
 	step->readback.srcRect = { x, y, w, h };
 	step->readback.aspectMask = aspectBits;
 	step->readback.dstFormat = destFormat;
+	step->timerName = gpuTimerName_;
 	steps_.push_back(step);
 
 	// Every step clears this state.
@@ -332,6 +356,7 @@ void GLRenderManager::CopyImageToMemorySync(GLRTexture *texture, int mipLevel, i
 	step->readback_image.texture = texture;
 	step->readback_image.mipLevel = mipLevel;
 	step->readback_image.srcRect = { x, y, w, h };
+	step->timerName = gpuTimerName_;
 	steps_.push_back(step);
 
 	// Every step clears this state.
@@ -362,8 +387,6 @@ void GLRenderManager::BeginFrame() {
 
 	VLOG("PUSH: Fencing %d", curFrame);
 
-	// glFenceSync(&frameData.fence...)
-
 	// Must be after the fence - this performs deletes.
 	VLOG("PUSH: BeginFrame %d", curFrame);
 	if (!run_) {
@@ -380,6 +403,7 @@ void GLRenderManager::Finish() {
 	curRenderStep_ = nullptr;
 	int curFrame = GetCurFrame();
 	FrameData &frameData = frameData_[curFrame];
+	int next;
 	{
 		std::unique_lock<std::mutex> lock(frameData.pull_mutex);
 		VLOG("PUSH: Frame[%d].readyForRun = true, notifying pull", curFrame);
@@ -390,14 +414,21 @@ void GLRenderManager::Finish() {
 		frameData.readyForRun = true;
 		frameData.type = GLRRunType::END;
 		frameData_[curFrame_].deleter.Take(deleter_);
+
+		// Only change the ring size when it wraps, so the frame indices stay consistent.
+		frameData.inflightFrames = inflightFrames_;
+		next = curFrame_ + 1;
+		if (next >= inflightFrames_) {
+			next = 0;
+			inflightFrames_ = newInflightFrames_;
+		}
+		frameData.nextFrame = next;
 	}
 
 	// Notify calls do not in fact need to be done with the mutex locked.
 	frameData.pull_condVar.notify_all();
 
-	curFrame_++;
-	if (curFrame_ >= MAX_INFLIGHT_FRAMES)
-		curFrame_ = 0;
+	curFrame_ = next;
 
 	insideFrame_ = false;
 }
@@ -406,6 +437,7 @@ void GLRenderManager::BeginSubmitFrame(int frame) {
 	FrameData &frameData = frameData_[frame];
 	if (!frameData.hasBegun) {
 		frameData.hasBegun = true;
+		queueRunner_.BeginFrameTimer();
 	}
 }
 
@@ -417,7 +449,14 @@ void GLRenderManager::Submit(int frame, bool triggerFence) {
 
 	// When !triggerFence, we notify after syncing with Vulkan.
 
-	if (triggerFence) {
+	if (triggerFence && (bufferStrategy_ & GLBufferStrategy::MASK_PERSISTENT) != 0) {
+		// The CPU writes straight into this frame's mapped buffers next time around, so
+		// we can't hand the frame back until the GPU is actually done with it. See RetireFences().
+		assert(frameData.readyForSubmit);
+		assert(!frameData.fence);
+		frameData.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		pendingFences_.push_back(frame);
+	} else if (triggerFence) {
 		VLOG("PULL: Frame %d.readyForFence = true", frame);
 
 		std::unique_lock<std::mutex> lock(frameData.push_mutex);
@@ -428,11 +467,37 @@ void GLRenderManager::Submit(int frame, bool triggerFence) {
 	}
 }
 
+// Render thread
+void GLRenderManager::RetireFences(int maxPending) {
+	while ((int)pendingFences_.size() > maxPending) {
+		int frame = pendingFences_.front();
+		pendingFences_.erase(pendingFences_.begin());
+
+		FrameData &frameData = frameData_[frame];
+		if (frameData.fence) {
+			GLenum res;
+			do {
+				res = glClientWaitSync(frameData.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 100000000ULL);
+			} while (res == GL_TIMEOUT_EXPIRED);
+			glDeleteSync(frameData.fence);
+			frameData.fence = nullptr;
+		}
+
+		VLOG("PULL: Frame %d.readyForFence = true (fence)", frame);
+		std::unique_lock<std::mutex> lock(frameData.push_mutex);
+		frameData.readyForFence = true;
+		frameData.readyForSubmit = false;
+		frameData.push_condVar.notify_all();
+	}
+}
+
 // Render thread
 void GLRenderManager::EndSubmitFrame(int frame) {
 	FrameData &frameData = frameData_[frame];
 	frameData.hasBegun = false;
 
+	queueRunner_.EndFrameTimer();
+	queueRunner_.EndFrameStats();
 	Submit(frame, true);
 
 	if (!frameData.skipSwap) {
@@ -455,6 +520,8 @@ void GLRenderManager::Run(int frame) {
 	BeginSubmitFrame(frame);
 
 	FrameData &frameData = frameData_[frame];
+	// Read before submitting, the CPU may start reusing frameData right after.
+	int inflightFrames = frameData.inflightFrames;
 
 	auto &stepsOnThread = frameData_[frame].steps;
 	auto &initStepsOnThread = frameData_[frame].initSteps;
@@ -478,6 +545,8 @@ void GLRenderManager::Run(int frame) {
 	switch (frameData.type) {
 	case GLRRunType::END:
 		EndSubmitFrame(frame);
+		// Let the GPU keep up to inflightFrames - 1 frames queued while the CPU works on the next.
+		RetireFences(inflightFrames - 1);
 		break;
 
 	case GLRRunType::SYNC:
@@ -524,9 +593,8 @@ void GLRenderManager::EndSyncFrame(int frame) {
 	FrameData &frameData = frameData_[frame];
 	Submit(frame, false);
 
-	// glFinish is not actually necessary here, and won't be until we start using
-	// glBufferStorage. Then we need to use fences.
-	// glFinish();
+	// glFinish is not necessary here. Earlier frames are still guarded by their fences when
+	// using persistent buffers, and this frame keeps appending after what's already been queued.
 
 	// At this point we can resume filling the command buffers for the current frame since
 	// we know the device is idle - and thus all previously enqueued command buffers have been processed.
@@ -734,6 +802,10 @@ void GLPushBuffer::MapDevice(GLBufferStrategy strategy) {
 }
 
 void GLPushBuffer::UnmapDevice() {
+	// Persistent mappings stay valid while the GPU reads, the buffer deletion unmaps them.
+	if ((strategy_ & GLBufferStrategy::MASK_PERSISTENT) != 0) {
+		return;
+	}
 	for (auto &info : buffers_) {
 		if (info.deviceMemory) {
 			// TODO: Technically this can return false?
@@ -753,6 +825,9 @@ void *GLRBuffer::Map(GLBufferStrategy strategy) {
 	if ((strategy & GLBufferStrategy::MASK_INVALIDATE) != 0) {
 		access |= GL_MAP_INVALIDATE_BUFFER_BIT;
 	}
+	if ((strategy & GLBufferStrategy::MASK_PERSISTENT) != 0) {
+		access |= GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	}
 
 	void *p = nullptr;
 	bool allowNativeBuffer = strategy != GLBufferStrategy::SUBDATA;
@@ -762,7 +837,8 @@ void *GLRBuffer::Map(GLBufferStrategy strategy) {
 		if (gl_extensions.ARB_buffer_storage || gl_extensions.EXT_buffer_storage) {
 #ifndef IOS
 			if (!hasStorage_) {
-				GLbitfield storageFlags = access & ~(GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_FLUSH_EXPLICIT_BIT);
+				// Keep glBufferSubData legal in case a later map fails and we fall back to it.
+				GLbitfield storageFlags = (access & ~(GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_FLUSH_EXPLICIT_BIT)) | GL_DYNAMIC_STORAGE_BIT;
 #ifdef USING_GLES2
 				glBufferStorageEXT(target_, size_, nullptr, storageFlags);
 #else
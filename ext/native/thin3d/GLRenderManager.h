@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <thread>
 #include <unordered_map>
 #include <vector>
@@ -109,6 +110,15 @@ class GLRProgram {
 	std::vector<UniformLocQuery> queries_;
 	std::vector<Initializer> initialize_;
 
+	// Driver program binary. If set at creation, it's tried before compiling and linking the shaders.
+	// If retrieveBinary_ is set, it's filled in from the driver after a successful link, and binaryReady_
+	// tells the owner thread when it's safe to read.
+	std::vector<uint8_t> binary_;
+	GLenum binaryFormat_ = 0;
+	bool retrieveBinary_ = false;
+	std::atomic<bool> binaryReady_{ false };
+	bool linkedFromBinary_ = false;
+
 	struct UniformInfo {
 		int loc_;
 	};
@@ -136,6 +146,7 @@ enum class GLBufferStrategy {
 
 	MASK_FLUSH = 0x10,
 	MASK_INVALIDATE = 0x20,
+	MASK_PERSISTENT = 0x40,
 
 	// Map/unmap the buffer each frame.
 	FRAME_UNMAP = 1,
@@ -145,6 +156,9 @@ enum class GLBufferStrategy {
 	FLUSH_UNMAP = MASK_FLUSH,
 	// Map/unmap, invalidate on map, and explicit flush.
 	FLUSH_INVALIDATE_UNMAP = MASK_FLUSH | MASK_INVALIDATE,
+	// Map once with glBufferStorage (persistent + coherent) and never unmap.
+	// Reuse of a frame's buffers is then guarded by fences instead of the driver.
+	PERSISTENT = MASK_PERSISTENT,
 };
 
 static inline int operator &(const GLBufferStrategy &lhs, const GLBufferStrategy &rhs) {
@@ -221,6 +235,7 @@ class GLRInputLayout {
 		GLboolean normalized;
 		int stride;
 		intptr_t offset;
+		int divisor;  // 0 for per vertex data, otherwise per instance.
 	};
 	std::vector<Entry> entries;
 	int semanticsMask_ = 0;
@@ -290,10 +305,16 @@ class GLRenderManager {
 	// not be an active render pass.
 	GLRProgram *CreateProgram(
 		std::vector<GLRShader *> shaders, std::vector<GLRProgram::Semantic> semantics, std::vector<GLRProgram::UniformLocQuery> queries,
-		std::vector<GLRProgram::Initializer> initalizers, bool supportDualSource) {
+		std::vector<GLRProgram::Initializer> initalizers, bool supportDualSource,
+		bool retrieveBinary = false, GLenum binaryFormat = 0, const std::vector<uint8_t> *binary = nullptr) {
 		GLRInitStep step{ GLRInitStepType::CREATE_PROGRAM };
 		assert(shaders.size() <= ARRAY_SIZE(step.create_program.shaders));
 		step.create_program.program = new GLRProgram();
+		step.create_program.program->retrieveBinary_ = retrieveBinary;
+		if (binary && !binary->empty()) {
+			step.create_program.program->binary_ = *binary;
+			step.create_program.program->binaryFormat_ = binaryFormat;
+		}
 		step.create_program.program->semantics_ = semantics;
 		step.create_program.program->queries_ = queries;
 		step.create_program.program->initialize_ = initalizers;
@@ -672,6 +693,16 @@ class GLRenderManager {
 		return curFrame_;
 	}
 
+	// How many frames the CPU may run ahead of the GPU, 1 to MAX_INFLIGHT_FRAMES.
+	// Fewer frames means less input latency but less overlap. Applied when the frame ring wraps.
+	void SetInflightFrames(int frames) {
+		if (frames < 1)
+			frames = 1;
+		if (frames > MAX_INFLIGHT_FRAMES)
+			frames = MAX_INFLIGHT_FRAMES;
+		newInflightFrames_ = frames;
+	}
+
 	void Resize(int width, int height) {
 		targetWidth_ = width;
 		targetHeight_ = height;
@@ -711,6 +742,33 @@ class GLRenderManager {
 		return queueRunner_.SawOutOfMemory();
 	}
 
+	// Redundant state changes skipped by the queue runner, from the last frame.
+	void GetStateCallStats(int *issued, int *elided) const {
+		queueRunner_.GetStateCallStats(issued, elided);
+	}
+
+	// Times the current render pass on the GPU. Results show up in GetStepTime a few frames later.
+	void SetStepTimer(int slot) {
+		if (curRenderStep_ && curRenderStep_->stepType == GLRStepType::RENDER)
+			curRenderStep_->timerSlot = slot;
+	}
+	float GetStepTime(int slot) const {
+		return queueRunner_.GetStepTime(slot);
+	}
+	// GPU milliseconds of the last measured frame, 0 without timestamp queries.
+	float GetGPUFrameTime() const {
+		return queueRunner_.GetStepTime(GLQueueRunner::FRAME_TIMER_SLOT);
+	}
+
+	// Steps started until EndGPUTimer are timed on the GPU and reported to the profiler.
+	// name must stay valid, use string literals.
+	void BeginGPUTimer(const char *name) {
+		gpuTimerName_ = name;
+	}
+	void EndGPUTimer() {
+		gpuTimerName_ = nullptr;
+	}
+
 	// Only supports a common subset.
 	std::string GetGLString(int name) const {
 		return queueRunner_.GetGLString(name);
@@ -724,6 +782,8 @@ class GLRenderManager {
 	// Bad for performance but sometimes necessary for synchronous CPU readbacks (screenshots and whatnot).
 	void FlushSync();
 	void EndSyncFrame(int frame);
+	// Render thread. Waits for the GPU to finish older frames until at most maxPending remain in flight.
+	void RetireFences(int maxPending);
 
 	// Per-frame data, round-robin so we can overlap submission with execution of the previous frame.
 	struct FrameData {
@@ -739,7 +799,11 @@ class GLRenderManager {
 		bool skipSwap = false;
 		GLRRunType type = GLRRunType::END;
 
-		// GLuint fence; For future AZDO stuff?
+		// Only used with GLBufferStrategy::PERSISTENT, where the driver doesn't know when we overwrite.
+		GLsync fence = nullptr;
+		// Which frame comes after this one, decided at submit time so both threads agree on the ring size.
+		int nextFrame = 0;
+		int inflightFrames = MAX_INFLIGHT_FRAMES;
 		std::vector<GLRStep *> steps;
 		std::vector<GLRInitStep> initSteps;
 
@@ -757,6 +821,7 @@ class GLRenderManager {
 	// Submission time state
 	bool insideFrame_ = false;
 	GLRStep *curRenderStep_ = nullptr;
+	const char *gpuTimerName_ = nullptr;
 	std::vector<GLRStep *> steps_;
 	std::vector<GLRInitStep> initSteps_;
 
@@ -769,6 +834,9 @@ class GLRenderManager {
 
 	// Thread state
 	int threadFrame_;
+	int threadNextFrame_ = 0;
+	// Frames submitted to GL whose fences haven't been waited on yet, oldest first.
+	std::vector<int> pendingFences_;
 
 	bool nextFrame = false;
 	bool firstFrame = true;
@@ -776,6 +844,8 @@ class GLRenderManager {
 	GLDeleter deleter_;
 
 	int curFrame_ = 0;
+	int inflightFrames_ = MAX_INFLIGHT_FRAMES;
+	std::atomic<int> newInflightFrames_{ MAX_INFLIGHT_FRAMES };
 
 	std::function<void()> swapFunction_;
 	std::function<void(int)> swapIntervalFunction_;
@@ -791,8 +861,7 @@ class GLRenderManager {
 // Similar to VulkanPushBuffer but is currently less efficient - it collects all the data in
 // RAM then does a big memcpy/buffer upload at the end of the frame. This is at least a lot
 // faster than the hundreds of buffer uploads or memory array buffers we used before.
-// On modern GL we could avoid the copy using glBufferStorage but not sure it's worth the
-// trouble.
+// With GLBufferStrategy::PERSISTENT the buffers stay mapped and we write straight into them.
 class GLPushBuffer {
 public:
 	struct BufInfo {
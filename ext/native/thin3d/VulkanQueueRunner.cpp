@@ -1,4 +1,8 @@
+#include <algorithm>
+
 #include "DataFormat.h"
+#include "profiler/profiler.h"
+#include "thread/threadutil.h"
 #include "VulkanQueueRunner.h"
 #include "VulkanRenderManager.h"
 
@@ -11,6 +15,20 @@ void VulkanQueueRunner::CreateDeviceObjects() {
 	framebufferRenderPass_ = GetRenderPass(VKRRenderPassAction::CLEAR, VKRRenderPassAction::CLEAR, VKRRenderPassAction::CLEAR,
 		VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
 
+	// The emu thread is busy too, so leave a core for it.
+	numRecordThreads_ = std::min((int)MAX_RECORD_THREADS, std::max(1, (int)std::thread::hardware_concurrency() - 1));
+	if (numRecordThreads_ > 1) {
+		for (int i = 0; i < vulkan_->GetInflightFrames(); i++) {
+			for (int t = 0; t < numRecordThreads_; t++) {
+				VkCommandPoolCreateInfo cmd_pool_info = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+				cmd_pool_info.queueFamilyIndex = vulkan_->GetGraphicsQueueFamilyIndex();
+				cmd_pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+				VkResult res = vkCreateCommandPool(vulkan_->GetDevice(), &cmd_pool_info, nullptr, &recordPools_[i][t].pool);
+				assert(res == VK_SUCCESS);
+			}
+		}
+	}
+
 #if 0
 	// Just to check whether it makes sense to split some of these. drawidx is way bigger than the others...
 	// We should probably just move to variable-size data in a raw buffer anyway...
@@ -38,33 +56,71 @@ void VulkanQueueRunner::ResizeReadbackBuffer(VkDeviceSize requiredSize) {
 	}
 
 	readbackBufferSize_ = requiredSize;
+	bool success = AllocateReadbackBuffer(readbackBufferSize_, &readbackBuffer_, &readbackMemory_);
+	assert(success);
+}
 
+bool VulkanQueueRunner::AllocateReadbackBuffer(VkDeviceSize size, VkBuffer *buffer, VkDeviceMemory *memory) {
 	VkDevice device = vulkan_->GetDevice();
 
 	VkBufferCreateInfo buf{ VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
-	buf.size = readbackBufferSize_;
+	buf.size = size;
 	buf.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
 
-	vkCreateBuffer(device, &buf, nullptr, &readbackBuffer_);
+	vkCreateBuffer(device, &buf, nullptr, buffer);
 
 	VkMemoryRequirements reqs{};
-	vkGetBufferMemoryRequirements(device, readbackBuffer_, &reqs);
+	vkGetBufferMemoryRequirements(device, *buffer, &reqs);
 
 	VkMemoryAllocateInfo alloc{ VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
 	alloc.allocationSize = reqs.size;
 
 	VkFlags typeReqs = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-	bool success = vulkan_->MemoryTypeFromProperties(reqs.memoryTypeBits, typeReqs, &alloc.memoryTypeIndex);
-	assert(success);
-	vkAllocateMemory(device, &alloc, nullptr, &readbackMemory_);
+	if (!vulkan_->MemoryTypeFromProperties(reqs.memoryTypeBits, typeReqs, &alloc.memoryTypeIndex)) {
+		vkDestroyBuffer(device, *buffer, nullptr);
+		*buffer = VK_NULL_HANDLE;
+		return false;
+	}
+	vkAllocateMemory(device, &alloc, nullptr, memory);
 
 	uint32_t offset = 0;
-	vkBindBufferMemory(device, readbackBuffer_, readbackMemory_, offset);
+	vkBindBufferMemory(device, *buffer, *memory, offset);
+	return true;
+}
+
+bool VulkanQueueRunner::CreateAsyncReadbackBuffer(VKRAsyncReadback *readback, VkDeviceSize size) {
+	if (!AllocateReadbackBuffer(size, &readback->buffer, &readback->memory)) {
+		return false;
+	}
+	readback->size = size;
+	return true;
+}
+
+void VulkanQueueRunner::DestroyAsyncReadbackBuffer(VKRAsyncReadback *readback) {
+	if (readback->memory)
+		vulkan_->Delete().QueueDeleteDeviceMemory(readback->memory);
+	if (readback->buffer)
+		vulkan_->Delete().QueueDeleteBuffer(readback->buffer);
+	readback->size = 0;
 }
 
 void VulkanQueueRunner::DestroyDeviceObjects() {
 	ILOG("VulkanQueueRunner::DestroyDeviceObjects");
 	VkDevice device = vulkan_->GetDevice();
+	StopRecordThreads();
+	for (int i = 0; i < VulkanContext::MAX_INFLIGHT_FRAMES; i++) {
+		for (int t = 0; t < MAX_RECORD_THREADS; t++) {
+			RecordPool &pool = recordPools_[i][t];
+			if (pool.pool != VK_NULL_HANDLE) {
+				// Also frees the buffers.
+				vkDestroyCommandPool(device, pool.pool, nullptr);
+				pool.pool = VK_NULL_HANDLE;
+			}
+			pool.buffers.clear();
+			pool.used = 0;
+		}
+	}
+
 	vulkan_->Delete().QueueDeleteDeviceMemory(readbackMemory_);
 	vulkan_->Delete().QueueDeleteBuffer(readbackBuffer_);
 	readbackBufferSize_ = 0;
@@ -153,8 +209,8 @@ void VulkanQueueRunner::InitBackbufferRenderPass() {
 	assert(res == VK_SUCCESS);
 }
 
-VkRenderPass VulkanQueueRunner::GetRenderPass(VKRRenderPassAction colorLoadAction, VKRRenderPassAction depthLoadAction, VKRRenderPassAction stencilLoadAction, VkImageLayout prevColorLayout, VkImageLayout prevDepthLayout, VkImageLayout finalColorLayout) {
-	RPKey key{ colorLoadAction, depthLoadAction, stencilLoadAction, prevColorLayout, prevDepthLayout, finalColorLayout };
+VkRenderPass VulkanQueueRunner::GetRenderPass(VKRRenderPassAction colorLoadAction, VKRRenderPassAction depthLoadAction, VKRRenderPassAction stencilLoadAction, VkImageLayout prevColorLayout, VkImageLayout prevDepthLayout, VkImageLayout finalColorLayout, bool discardDepth) {
+	RPKey key{ colorLoadAction, depthLoadAction, stencilLoadAction, discardDepth, prevColorLayout, prevDepthLayout, finalColorLayout };
 	auto pass = renderPasses_.Get(key);
 	if (pass) {
 		return pass;
@@ -211,8 +267,10 @@ VkRenderPass VulkanQueueRunner::GetRenderPass(VKRRenderPassAction colorLoadActio
 		attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 		break;
 	}
-	attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-	attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_STORE;
+	// Store ops don't affect render pass compatibility, so this doesn't need a separate framebuffer.
+	// On tilers, not storing saves writing the depth tiles back to memory at the end of the pass.
+	attachments[1].storeOp = discardDepth ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
+	attachments[1].stencilStoreOp = discardDepth ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
 #ifdef VULKAN_USE_GENERAL_LAYOUT_FOR_DEPTH_STENCIL
 	attachments[1].initialLayout = VK_IMAGE_LAYOUT_GENERAL;
 	attachments[1].finalLayout = VK_IMAGE_LAYOUT_GENERAL;
@@ -348,7 +406,7 @@ VkRenderPass VulkanQueueRunner::GetRenderPass(VKRRenderPassAction colorLoadActio
 	return pass;
 }
 
-void VulkanQueueRunner::RunSteps(VkCommandBuffer cmd, const std::vector<VKRStep *> &steps) {
+void VulkanQueueRunner::RunSteps(VkCommandBuffer cmd, const std::vector<VKRStep *> &steps, int frame, VKRFrameTimers *timers) {
 	// Optimizes renderpasses, then sequences them.
 	// Planned optimizations: 
 	//  * Create copies of render target that are rendered to multiple times and textured from in sequence, and push those render passes
@@ -398,29 +456,338 @@ void VulkanQueueRunner::RunSteps(VkCommandBuffer cmd, const std::vector<VKRStep
 		}
 	}
 
+	MergeRenderSteps(steps);
+	DiscardUnusedDepth(steps);
+
+	bool parallel = PrepareParallelRecord(steps, frame);
+
 	for (size_t i = 0; i < steps.size(); i++) {
 		const VKRStep &step = *steps[i];
+		int timer = -1;
+		if (step.timerName && step.stepType != VKRStepType::RENDER_SKIP && timers && timers->pool != VK_NULL_HANDLE && timers->names.size() < VKRFrameTimers::MAX_TIMERS) {
+			timer = (int)timers->names.size();
+			timers->names.push_back(step.timerName);
+			vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timers->pool, timer * 2);
+		}
 		switch (step.stepType) {
 		case VKRStepType::RENDER:
-			PerformRenderPass(step, cmd);
+		{
+			PROFILE_THIS_SCOPE("vk_renderpass");
+			if (parallel) {
+				int job = recordJobIndex_[i];
+				PerformRenderPass(step, cmd, job >= 0 ? recordJobs_[job].cmd : VK_NULL_HANDLE, &stepState_[i]);
+			} else {
+				PerformRenderPass(step, cmd);
+			}
 			break;
+		}
 		case VKRStepType::COPY:
+		{
+			PROFILE_THIS_SCOPE("vk_copy");
 			PerformCopy(step, cmd);
 			break;
+		}
 		case VKRStepType::BLIT:
+		{
+			PROFILE_THIS_SCOPE("vk_blit");
 			PerformBlit(step, cmd);
 			break;
+		}
 		case VKRStepType::READBACK:
+		{
+			PROFILE_THIS_SCOPE("vk_readback");
 			PerformReadback(step, cmd);
 			break;
+		}
 		case VKRStepType::READBACK_IMAGE:
+		{
+			PROFILE_THIS_SCOPE("vk_readback");
 			PerformReadbackImage(step, cmd);
 			break;
+		}
 		case VKRStepType::RENDER_SKIP:
 			break;
 		}
+		if (timer >= 0) {
+			vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timers->pool, timer * 2 + 1);
+		}
 		delete steps[i];
 	}
+
+	if (parallel) {
+		recordJobs_.clear();
+	}
+}
+
+// Passes with fewer commands than this are cheaper to record inline than to hand off.
+static const size_t MIN_PARALLEL_RECORD_COMMANDS = 256;
+
+// Records the contents of the big render passes into secondary command buffers, spread over the
+// record threads. The primary command buffer then only begins the passes and executes them in order.
+// Returns false if it's not worth it, in which case nothing was recorded.
+bool VulkanQueueRunner::PrepareParallelRecord(const std::vector<VKRStep *> &steps, int frame) {
+	if (numRecordThreads_ <= 1) {
+		return false;
+	}
+	int bigPasses = 0;
+	for (const VKRStep *step : steps) {
+		if (step->stepType == VKRStepType::RENDER && step->commands.size() >= MIN_PARALLEL_RECORD_COMMANDS)
+			bigPasses++;
+	}
+	if (bigPasses < 2) {
+		return false;
+	}
+
+	// Everything recorded from these in this frame slot has finished executing by now.
+	for (int t = 0; t < numRecordThreads_; t++) {
+		RecordPool &pool = recordPools_[frame][t];
+		vkResetCommandPool(vulkan_->GetDevice(), pool.pool, 0);
+		pool.used = 0;
+	}
+
+	// Secondary command buffers start without any dynamic state, and the primary loses its own when
+	// executing one. So track what each pass would have inherited, and set it at the start of every pass.
+	recordJobs_.clear();
+	recordJobIndex_.assign(steps.size(), -1);
+	stepState_.resize(steps.size());
+	VKRDynamicStateSnapshot state;
+	for (size_t i = 0; i < steps.size(); i++) {
+		const VKRStep &step = *steps[i];
+		if (step.stepType != VKRStepType::RENDER)
+			continue;
+		stepState_[i] = state;
+		if (step.commands.size() >= MIN_PARALLEL_RECORD_COMMANDS) {
+			recordJobIndex_[i] = (int)recordJobs_.size();
+			recordJobs_.push_back({ &step, &stepState_[i], VK_NULL_HANDLE });
+		}
+		for (const auto &c : step.commands) {
+			switch (c.cmd) {
+			case VKRRenderCommand::VIEWPORT:
+			case VKRRenderCommand::SCISSOR:
+			case VKRRenderCommand::BLEND:
+			case VKRRenderCommand::STENCIL:
+				state.Apply(c);
+				break;
+			default:
+				break;
+			}
+		}
+	}
+
+	if (recordThreads_.empty()) {
+		// Thread 0 is this thread.
+		for (int t = 1; t < numRecordThreads_; t++) {
+			recordThreads_.push_back(std::thread(&VulkanQueueRunner::RecordThreadFunc, this, t));
+		}
+	}
+
+	recordFrame_ = frame;
+	recordNext_ = 0;
+	{
+		std::lock_guard<std::mutex> guard(recordLock_);
+		recordBusy_ = (int)recordThreads_.size();
+		recordGeneration_++;
+	}
+	recordCond_.notify_all();
+
+	RecordJobs(0);
+
+	std::unique_lock<std::mutex> lock(recordLock_);
+	recordDoneCond_.wait(lock, [&] { return recordBusy_ == 0; });
+	return true;
+}
+
+void VulkanQueueRunner::RecordJobs(int thread) {
+	RecordPool &pool = recordPools_[recordFrame_][thread];
+	while (true) {
+		int i = recordNext_++;
+		if (i >= (int)recordJobs_.size()) {
+			break;
+		}
+
+		PROFILE_THIS_SCOPE("vk_record");
+		RecordJob &job = recordJobs_[i];
+		const VKRStep &step = *job.step;
+
+		if (pool.used == pool.buffers.size()) {
+			VkCommandBufferAllocateInfo cmd_alloc = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+			cmd_alloc.commandPool = pool.pool;
+			cmd_alloc.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			cmd_alloc.commandBufferCount = 1;
+			VkCommandBuffer buffer;
+			VkResult res = vkAllocateCommandBuffers(vulkan_->GetDevice(), &cmd_alloc, &buffer);
+			_assert_msg_(G3D, res == VK_SUCCESS, "Failed to allocate a secondary command buffer: %s", VulkanResultToString(res));
+			pool.buffers.push_back(buffer);
+		}
+		VkCommandBuffer cmd = pool.buffers[pool.used++];
+
+		// Only needs to be compatible with the real one, which all our framebuffer render passes are.
+		VkCommandBufferInheritanceInfo inherit{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO };
+		inherit.renderPass = step.render.framebuffer ? framebufferRenderPass_ : backbufferRenderPass_;
+		inherit.subpass = 0;
+		inherit.framebuffer = VK_NULL_HANDLE;
+
+		VkCommandBufferBeginInfo begin{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+		begin.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		begin.pInheritanceInfo = &inherit;
+		vkBeginCommandBuffer(cmd, &begin);
+
+		int curWidth = step.render.framebuffer ? step.render.framebuffer->width : vulkan_->GetBackbufferWidth();
+		int curHeight = step.render.framebuffer ? step.render.framebuffer->height : vulkan_->GetBackbufferHeight();
+		RecordRenderCommands(job.inherited->commands, job.inherited->count, curWidth, curHeight, cmd);
+		RecordRenderCommands(step.commands.data(), step.commands.size(), curWidth, curHeight, cmd);
+
+		vkEndCommandBuffer(cmd);
+		job.cmd = cmd;
+	}
+}
+
+void VulkanQueueRunner::RecordThreadFunc(int thread) {
+	setCurrentThreadName("VulkanRecord");
+
+	uint64_t seen = 0;
+	std::unique_lock<std::mutex> lock(recordLock_);
+	while (true) {
+		recordCond_.wait(lock, [&] { return recordStop_ || recordGeneration_ != seen; });
+		if (recordStop_) {
+			break;
+		}
+		seen = recordGeneration_;
+
+		lock.unlock();
+		RecordJobs(thread);
+		lock.lock();
+
+		if (--recordBusy_ == 0) {
+			recordDoneCond_.notify_all();
+		}
+	}
+}
+
+void VulkanQueueRunner::StopRecordThreads() {
+	{
+		std::lock_guard<std::mutex> guard(recordLock_);
+		recordStop_ = true;
+	}
+	recordCond_.notify_all();
+	for (auto &thread : recordThreads_) {
+		thread.join();
+	}
+	recordThreads_.clear();
+	recordStop_ = false;
+	// New threads start out waiting for the first generation.
+	recordGeneration_ = 0;
+}
+
+// Each render pass costs a full load and store of the tiles on tile based GPUs, so join up passes
+// that render to the same framebuffer back to back. This happens a lot when games clear in between
+// draws, or when a bind got interrupted by something that was later optimized away.
+void VulkanQueueRunner::MergeRenderSteps(const std::vector<VKRStep *> &steps) {
+	VKRStep *prev = nullptr;
+	for (size_t i = 0; i < steps.size(); i++) {
+		VKRStep &step = *steps[i];
+		if (step.stepType == VKRStepType::RENDER_SKIP) {
+			continue;
+		}
+		if (step.stepType != VKRStepType::RENDER) {
+			// Copies, blits and readbacks need the data stored, can't merge across them.
+			prev = nullptr;
+			continue;
+		}
+
+		bool canMerge = prev && step.render.framebuffer && prev->render.framebuffer == step.render.framebuffer;
+		for (const auto &iter : step.preTransitions) {
+			// Texturing from itself needs the pass to end first.
+			if (iter.fb == step.render.framebuffer)
+				canMerge = false;
+		}
+		if (!canMerge) {
+			prev = &step;
+			continue;
+		}
+
+		prev->preTransitions.insert(prev->preTransitions.end(), step.preTransitions.begin(), step.preTransitions.end());
+		if (step.render.color == VKRRenderPassAction::CLEAR && step.render.depth == VKRRenderPassAction::CLEAR && step.render.stencil == VKRRenderPassAction::CLEAR) {
+			// Everything drawn before gets cleared away anyway, so just drop it.
+			prev->commands.swap(step.commands);
+			prev->render.color = step.render.color;
+			prev->render.depth = step.render.depth;
+			prev->render.stencil = step.render.stencil;
+			prev->render.clearColor = step.render.clearColor;
+			prev->render.clearDepth = step.render.clearDepth;
+			prev->render.clearStencil = step.render.clearStencil;
+			prev->render.numDraws = step.render.numDraws;
+		} else {
+			// DONT_CARE can just be treated as KEEP.
+			int clearMask = 0;
+			if (step.render.color == VKRRenderPassAction::CLEAR)
+				clearMask |= VK_IMAGE_ASPECT_COLOR_BIT;
+			if (step.render.depth == VKRRenderPassAction::CLEAR)
+				clearMask |= VK_IMAGE_ASPECT_DEPTH_BIT;
+			if (step.render.stencil == VKRRenderPassAction::CLEAR)
+				clearMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+
+			if (clearMask && prev->commands.empty()) {
+				// Nothing drawn yet, the clear can still go into the load ops.
+				if (clearMask & VK_IMAGE_ASPECT_COLOR_BIT) {
+					prev->render.color = VKRRenderPassAction::CLEAR;
+					prev->render.clearColor = step.render.clearColor;
+				}
+				if (clearMask & VK_IMAGE_ASPECT_DEPTH_BIT) {
+					prev->render.depth = VKRRenderPassAction::CLEAR;
+					prev->render.clearDepth = step.render.clearDepth;
+				}
+				if (clearMask & VK_IMAGE_ASPECT_STENCIL_BIT) {
+					prev->render.stencil = VKRRenderPassAction::CLEAR;
+					prev->render.clearStencil = step.render.clearStencil;
+				}
+			} else if (clearMask) {
+				VkRenderData data{ VKRRenderCommand::CLEAR };
+				data.clear.clearColor = step.render.clearColor;
+				data.clear.clearZ = step.render.clearDepth;
+				data.clear.clearStencil = step.render.clearStencil;
+				data.clear.clearMask = clearMask;
+				prev->commands.push_back(data);
+			}
+			prev->commands.insert(prev->commands.end(), step.commands.begin(), step.commands.end());
+			prev->render.numDraws += step.render.numDraws;
+		}
+		prev->render.finalColorLayout = step.render.finalColorLayout;
+		step.commands.clear();
+		step.stepType = VKRStepType::RENDER_SKIP;
+	}
+}
+
+// If the next thing that happens to a framebuffer's depth in this frame is another pass that clears
+// (or doesn't care about) it, there's no need to store it at the end of the pass. We can't see into
+// the next frame, so the last pass to each framebuffer always stores, unless the depth is transient.
+void VulkanQueueRunner::DiscardUnusedDepth(const std::vector<VKRStep *> &steps) {
+	const int depthAspects = VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+	for (size_t j = 0; j < steps.size(); j++) {
+		VKRStep &step = *steps[j];
+		VKRFramebuffer *fb = step.render.framebuffer;
+		if (step.stepType != VKRStepType::RENDER || !fb) {
+			continue;
+		}
+		if (fb->transientDepth) {
+			step.render.discardDepth = true;
+			continue;
+		}
+
+		for (size_t i = j + 1; i < steps.size(); i++) {
+			const VKRStep &next = *steps[i];
+			if (next.stepType == VKRStepType::RENDER && next.render.framebuffer == fb) {
+				step.render.discardDepth = next.render.depth != VKRRenderPassAction::KEEP && next.render.stencil != VKRRenderPassAction::KEEP;
+				break;
+			} else if (next.stepType == VKRStepType::COPY && (next.copy.src == fb || next.copy.dst == fb) && (next.copy.aspectMask & depthAspects)) {
+				break;
+			} else if (next.stepType == VKRStepType::BLIT && (next.blit.src == fb || next.blit.dst == fb) && (next.blit.aspectMask & depthAspects)) {
+				break;
+			} else if (next.stepType == VKRStepType::READBACK && next.readback.src == fb && (next.readback.aspectMask & depthAspects)) {
+				break;
+			}
+		}
+	}
 }
 
 void VulkanQueueRunner::LogSteps(const std::vector<VKRStep *> &steps) {
@@ -503,7 +870,7 @@ void VulkanQueueRunner::LogReadbackImage(const VKRStep &pass) {
 	ILOG("ReadbackImage");
 }
 
-void VulkanQueueRunner::PerformRenderPass(const VKRStep &step, VkCommandBuffer cmd) {
+void VulkanQueueRunner::PerformRenderPass(const VKRStep &step, VkCommandBuffer cmd, VkCommandBuffer secondary, const VKRDynamicStateSnapshot *inherited) {
 	// TODO: If there are multiple, we can transition them together.
 	for (const auto &iter : step.preTransitions) {
 		if (iter.fb->color.layout != iter.targetLayout) {
@@ -559,23 +926,38 @@ void VulkanQueueRunner::PerformRenderPass(const VKRStep &step, VkCommandBuffer c
 	}
 
 	// This is supposed to bind a vulkan render pass to the command buffer.
-	PerformBindFramebufferAsRenderTarget(step, cmd);
+	PerformBindFramebufferAsRenderTarget(step, cmd, secondary ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
 
 	int curWidth = step.render.framebuffer ? step.render.framebuffer->width : vulkan_->GetBackbufferWidth();
 	int curHeight = step.render.framebuffer ? step.render.framebuffer->height : vulkan_->GetBackbufferHeight();
 
 	VKRFramebuffer *fb = step.render.framebuffer;
 
-	VkPipeline lastPipeline = VK_NULL_HANDLE;
-	VkDescriptorSet lastDescSet = VK_NULL_HANDLE;
+	if (secondary) {
+		vkCmdExecuteCommands(cmd, 1, &secondary);
+	} else {
+		if (inherited) {
+			RecordRenderCommands(inherited->commands, inherited->count, curWidth, curHeight, cmd);
+		}
+		RecordRenderCommands(step.commands.data(), step.commands.size(), curWidth, curHeight, cmd);
+	}
+	vkCmdEndRenderPass(cmd);
 
-	auto &commands = step.commands;
+	// The renderpass handles the layout transition.
+	if (fb) {
+		fb->color.layout = step.render.finalColorLayout;
+	}
+}
+
+void VulkanQueueRunner::RecordRenderCommands(const VkRenderData *commands, size_t count, int curWidth, int curHeight, VkCommandBuffer cmd) {
+	VkPipeline lastPipeline = VK_NULL_HANDLE;
 
 	// TODO: Dynamic state commands (SetViewport, SetScissor, SetBlendConstants, SetStencil*) are only
 	// valid when a pipeline is bound with those as dynamic state. So we need to add some state tracking here
 	// for this to be correct. This is a bit of a pain but also will let us eliminate redundant calls.
 
-	for (const auto &c : commands) {
+	for (size_t i = 0; i < count; i++) {
+		const VkRenderData &c = commands[i];
 		switch (c.cmd) {
 		case VKRRenderCommand::BIND_PIPELINE:
 			if (c.pipeline.pipeline != lastPipeline) {
@@ -658,15 +1040,9 @@ void VulkanQueueRunner::PerformRenderPass(const VKRStep &step, VkCommandBuffer c
 			;
 		}
 	}
-	vkCmdEndRenderPass(cmd);
-
-	// The renderpass handles the layout transition.
-	if (fb) {
-		fb->color.layout = step.render.finalColorLayout;
-	}
 }
 
-void VulkanQueueRunner::PerformBindFramebufferAsRenderTarget(const VKRStep &step, VkCommandBuffer cmd) {
+void VulkanQueueRunner::PerformBindFramebufferAsRenderTarget(const VKRStep &step, VkCommandBuffer cmd, VkSubpassContents contents) {
 	VkRenderPass renderPass;
 	int numClearVals = 0;
 	VkClearValue clearVal[2]{};
@@ -697,7 +1073,7 @@ void VulkanQueueRunner::PerformBindFramebufferAsRenderTarget(const VKRStep &step
 
 		renderPass = GetRenderPass(
 			step.render.color, step.render.depth, step.render.stencil,
-			fb->color.layout, fb->depth.layout, step.render.finalColorLayout);
+			fb->color.layout, fb->depth.layout, step.render.finalColorLayout, step.render.discardDepth);
 
 		// We now do any layout pretransitions as part of the render pass.
 		fb->color.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
@@ -732,7 +1108,7 @@ void VulkanQueueRunner::PerformBindFramebufferAsRenderTarget(const VKRStep &step
 	rp_begin.renderArea.extent.height = h;
 	rp_begin.clearValueCount = numClearVals;
 	rp_begin.pClearValues = numClearVals ? clearVal : nullptr;
-	vkCmdBeginRenderPass(cmd, &rp_begin, VK_SUBPASS_CONTENTS_INLINE);
+	vkCmdBeginRenderPass(cmd, &rp_begin, contents);
 }
 
 void VulkanQueueRunner::PerformCopy(const VKRStep &step, VkCommandBuffer cmd) {
@@ -1000,7 +1376,11 @@ void VulkanQueueRunner::SetupTransitionToTransferDst(VKRImage &img, VkImageMemor
 }
 
 void VulkanQueueRunner::PerformReadback(const VKRStep &step, VkCommandBuffer cmd) {
-	ResizeReadbackBuffer(sizeof(uint32_t) * step.readback.srcRect.extent.width * step.readback.srcRect.extent.height);
+	VkBuffer dstBuffer = step.readback.dstBuffer;
+	if (dstBuffer == VK_NULL_HANDLE) {
+		ResizeReadbackBuffer(sizeof(uint32_t) * step.readback.srcRect.extent.width * step.readback.srcRect.extent.height);
+		dstBuffer = readbackBuffer_;
+	}
 
 	VkBufferImageCopy region{};
 	region.imageOffset = { step.readback.srcRect.offset.x, step.readback.srcRect.offset.y, 0 };
@@ -1046,7 +1426,7 @@ void VulkanQueueRunner::PerformReadback(const VKRStep &step, VkCommandBuffer cmd
 		copyLayout = srcImage->layout;
 	}
 
-	vkCmdCopyImageToBuffer(cmd, image, copyLayout, readbackBuffer_, 1, &region);
+	vkCmdCopyImageToBuffer(cmd, image, copyLayout, dstBuffer, 1, &region);
 
 	// NOTE: Can't read the buffer using the CPU here - need to sync first.
 
@@ -1106,24 +1486,41 @@ void VulkanQueueRunner::CopyReadbackBuffer(int width, int height, Draw::DataForm
 		ELOG("CopyReadbackBuffer: vkMapMemory failed! result=%d", (int)res);
 		return;
 	}
+	ConvertReadbackData((const uint8_t *)mappedData, width, height, srcFormat, destFormat, pixelStride, pixels);
+	vkUnmapMemory(vulkan_->GetDevice(), readbackMemory_);
+}
+
+void VulkanQueueRunner::CopyAsyncReadback(const VKRAsyncReadback &readback) {
+	void *mappedData;
+	const size_t srcPixelSize = DataFormatSizeInBytes(readback.srcFormat);
+
+	VkResult res = vkMapMemory(vulkan_->GetDevice(), readback.memory, 0, readback.width * readback.height * srcPixelSize, 0, &mappedData);
+	if (res != VK_SUCCESS) {
+		ELOG("CopyAsyncReadback: vkMapMemory failed! result=%d", (int)res);
+		return;
+	}
+	ConvertReadbackData((const uint8_t *)mappedData, readback.width, readback.height, readback.srcFormat, readback.destFormat, readback.pixelStride, readback.pixels);
+	vkUnmapMemory(vulkan_->GetDevice(), readback.memory);
+}
+
+void VulkanQueueRunner::ConvertReadbackData(const uint8_t *src, int width, int height, Draw::DataFormat srcFormat, Draw::DataFormat destFormat, int pixelStride, uint8_t *pixels) {
+	const size_t srcPixelSize = DataFormatSizeInBytes(srcFormat);
 	if (srcFormat == Draw::DataFormat::R8G8B8A8_UNORM) {
-		ConvertFromRGBA8888(pixels, (const uint8_t *)mappedData, pixelStride, width, width, height, destFormat);
+		ConvertFromRGBA8888(pixels, src, pixelStride, width, width, height, destFormat);
 	} else if (srcFormat == Draw::DataFormat::B8G8R8A8_UNORM) {
-		ConvertFromBGRA8888(pixels, (const uint8_t *)mappedData, pixelStride, width, width, height, destFormat);
+		ConvertFromBGRA8888(pixels, src, pixelStride, width, width, height, destFormat);
 	} else if (srcFormat == destFormat) {
 		uint8_t *dst = pixels;
-		const uint8_t *src = (const uint8_t *)mappedData;
 		for (int y = 0; y < height; ++y) {
 			memcpy(dst, src, width * srcPixelSize);
 			src += width * srcPixelSize;
 			dst += pixelStride * srcPixelSize;
 		}
 	} else if (destFormat == Draw::DataFormat::D32F) {
-		ConvertToD32F(pixels, (const uint8_t *)mappedData, pixelStride, width, width, height, srcFormat);
+		ConvertToD32F(pixels, src, pixelStride, width, width, height, srcFormat);
 	} else {
 		// TODO: Maybe a depth conversion or something?
 		ELOG("CopyReadbackBuffer: Unknown format");
 		assert(false);
 	}
-	vkUnmapMemory(vulkan_->GetDevice(), readbackMemory_);
 }
@@ -1,6 +1,11 @@
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
 #include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #include "Common/Hashmaps.h"
 #include "Common/Vulkan/VulkanContext.h"
@@ -95,6 +100,23 @@ enum class VKRRenderPassAction : uint8_t {
 	KEEP,
 };
 
+// The dynamic state (viewport, scissor, blend constants, stencil) left by the previous passes.
+// A secondary command buffer doesn't inherit any of it, and neither does the primary after executing one.
+struct VKRDynamicStateSnapshot {
+	VkRenderData commands[4];
+	int count = 0;
+
+	void Apply(const VkRenderData &c) {
+		for (int i = 0; i < count; i++) {
+			if (commands[i].cmd == c.cmd) {
+				commands[i] = c;
+				return;
+			}
+		}
+		commands[count++] = c;
+	}
+};
+
 struct TransitionRequest {
 	VKRFramebuffer *fb;
 	VkImageLayout targetLayout;
@@ -105,6 +127,8 @@ struct VKRStep {
 	VKRStepType stepType;
 	std::vector<VkRenderData> commands;
 	std::vector<TransitionRequest> preTransitions;
+	// If set, the step is timed on the GPU and reported to the profiler under this name.
+	const char *timerName = nullptr;
 	union {
 		struct {
 			VKRFramebuffer *framebuffer;
@@ -116,6 +140,7 @@ struct VKRStep {
 			int clearStencil;
 			int numDraws;
 			VkImageLayout finalColorLayout;
+			bool discardDepth;  // Nothing reads the depth/stencil after this pass, don't store it.
 		} render;
 		struct {
 			VKRFramebuffer *src;
@@ -136,6 +161,7 @@ struct VKRStep {
 			int aspectMask;
 			VKRFramebuffer *src;
 			VkRect2D srcRect;
+			VkBuffer dstBuffer;  // VK_NULL_HANDLE means the shared sync readback buffer.
 		} readback;
 		struct {
 			VkImage image;
@@ -145,6 +171,30 @@ struct VKRStep {
 	};
 };
 
+// Staging buffer for a readback that isn't waited for. The CPU side copies it out once the frame
+// it was recorded in has finished on the GPU.
+struct VKRAsyncReadback {
+	VkBuffer buffer = VK_NULL_HANDLE;
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize size = 0;
+	int width = 0;
+	int height = 0;
+	Draw::DataFormat srcFormat = Draw::DataFormat::UNDEFINED;
+	Draw::DataFormat destFormat = Draw::DataFormat::UNDEFINED;
+	// Cleared when the readback is discarded, the result is then just dropped.
+	uint8_t *pixels = nullptr;
+	int pixelStride = 0;
+};
+
+// Timestamps written around named steps during one frame, read back once its fence has passed.
+struct VKRFrameTimers {
+	// The last query pair after the named ones brackets the whole frame.
+	enum { MAX_TIMERS = 64, FRAME_QUERY = MAX_TIMERS * 2, NUM_QUERIES = FRAME_QUERY + 2 };
+	VkQueryPool pool = VK_NULL_HANDLE;
+	// One per begin/end query pair, in query order.
+	std::vector<const char *> names;
+};
+
 class VulkanQueueRunner {
 public:
 	VulkanQueueRunner(VulkanContext *vulkan) : vulkan_(vulkan), renderPasses_(16) {}
@@ -152,7 +202,9 @@ class VulkanQueueRunner {
 		backbuffer_ = fb;
 		backbufferImage_ = img;
 	}
-	void RunSteps(VkCommandBuffer cmd, const std::vector<VKRStep *> &steps);
+	// frame is the inflight frame index, used to pick the pools for secondary command buffers.
+	// timers may be null, or have no pool if the queue can't do timestamps.
+	void RunSteps(VkCommandBuffer cmd, const std::vector<VKRStep *> &steps, int frame, VKRFrameTimers *timers);
 	void LogSteps(const std::vector<VKRStep *> &steps);
 
 	void CreateDeviceObjects();
@@ -174,15 +226,25 @@ class VulkanQueueRunner {
 
 	void CopyReadbackBuffer(int width, int height, Draw::DataFormat srcFormat, Draw::DataFormat destFormat, int pixelStride, uint8_t *pixels);
 
+	// Host visible buffers for async readbacks. Only read them after the frame that used them has been fenced.
+	bool CreateAsyncReadbackBuffer(VKRAsyncReadback *readback, VkDeviceSize size);
+	void DestroyAsyncReadbackBuffer(VKRAsyncReadback *readback);
+	void CopyAsyncReadback(const VKRAsyncReadback &readback);
+
 private:
 	// Only call this from the render thread!
 	VkRenderPass GetRenderPass(VKRRenderPassAction colorLoadAction, VKRRenderPassAction depthLoadAction, VKRRenderPassAction stencilLoadAction,
-		VkImageLayout prevColorLayout, VkImageLayout prevDepthLayout, VkImageLayout finalColorLayout);
+		VkImageLayout prevColorLayout, VkImageLayout prevDepthLayout, VkImageLayout finalColorLayout, bool discardDepth = false);
 
 	void InitBackbufferRenderPass();
 
-	void PerformBindFramebufferAsRenderTarget(const VKRStep &pass, VkCommandBuffer cmd);
-	void PerformRenderPass(const VKRStep &pass, VkCommandBuffer cmd);
+	void MergeRenderSteps(const std::vector<VKRStep *> &steps);
+	void DiscardUnusedDepth(const std::vector<VKRStep *> &steps);
+
+	void PerformBindFramebufferAsRenderTarget(const VKRStep &pass, VkCommandBuffer cmd, VkSubpassContents contents);
+	// If secondary is set, it holds the already recorded commands of the pass.
+	void PerformRenderPass(const VKRStep &pass, VkCommandBuffer cmd, VkCommandBuffer secondary = VK_NULL_HANDLE, const VKRDynamicStateSnapshot *inherited = nullptr);
+	void RecordRenderCommands(const VkRenderData *commands, size_t count, int curWidth, int curHeight, VkCommandBuffer cmd);
 	void PerformCopy(const VKRStep &pass, VkCommandBuffer cmd);
 	void PerformBlit(const VKRStep &pass, VkCommandBuffer cmd);
 	void PerformReadback(const VKRStep &pass, VkCommandBuffer cmd);
@@ -195,6 +257,14 @@ class VulkanQueueRunner {
 	void LogReadbackImage(const VKRStep &pass);
 
 	void ResizeReadbackBuffer(VkDeviceSize requiredSize);
+	bool AllocateReadbackBuffer(VkDeviceSize size, VkBuffer *buffer, VkDeviceMemory *memory);
+	void ConvertReadbackData(const uint8_t *src, int width, int height, Draw::DataFormat srcFormat, Draw::DataFormat destFormat, int pixelStride, uint8_t *pixels);
+
+	// Parallel recording of big render passes into secondary command buffers.
+	bool PrepareParallelRecord(const std::vector<VKRStep *> &steps, int frame);
+	void RecordJobs(int thread);
+	void RecordThreadFunc(int thread);
+	void StopRecordThreads();
 
 	static void SetupTransitionToTransferSrc(VKRImage &img, VkImageMemoryBarrier &barrier, VkPipelineStageFlags &stage, VkImageAspectFlags aspect);
 	static void SetupTransitionToTransferDst(VKRImage &img, VkImageMemoryBarrier &barrier, VkPipelineStageFlags &stage, VkImageAspectFlags aspect);
@@ -212,6 +282,7 @@ class VulkanQueueRunner {
 		VKRRenderPassAction colorAction;
 		VKRRenderPassAction depthAction;
 		VKRRenderPassAction stencilAction;
+		bool discardDepth;
 		VkImageLayout prevColorLayout;
 		VkImageLayout prevDepthLayout;
 		VkImageLayout finalColorLayout;
@@ -227,4 +298,38 @@ class VulkanQueueRunner {
 	VkDeviceMemory readbackMemory_ = VK_NULL_HANDLE;
 	VkBuffer readbackBuffer_ = VK_NULL_HANDLE;
 	VkDeviceSize readbackBufferSize_ = 0;
+
+	enum {
+		MAX_RECORD_THREADS = 4,  // Including the render thread itself.
+	};
+
+	struct RecordJob {
+		const VKRStep *step;
+		const VKRDynamicStateSnapshot *inherited;
+		VkCommandBuffer cmd;
+	};
+
+	// Secondary command buffers, one pool per thread per inflight frame so they can be reset together.
+	struct RecordPool {
+		VkCommandPool pool = VK_NULL_HANDLE;
+		std::vector<VkCommandBuffer> buffers;
+		size_t used = 0;
+	};
+	RecordPool recordPools_[VulkanContext::MAX_INFLIGHT_FRAMES][MAX_RECORD_THREADS];
+	int numRecordThreads_ = 1;
+
+	// Indexed like the steps, only valid for the current RunSteps.
+	std::vector<RecordJob> recordJobs_;
+	std::vector<int> recordJobIndex_;
+	std::vector<VKRDynamicStateSnapshot> stepState_;
+	std::atomic<int> recordNext_{ 0 };
+	int recordFrame_ = 0;
+
+	std::vector<std::thread> recordThreads_;
+	std::mutex recordLock_;
+	std::condition_variable recordCond_;
+	std::condition_variable recordDoneCond_;
+	uint64_t recordGeneration_ = 0;
+	int recordBusy_ = 0;
+	bool recordStop_ = false;
 };
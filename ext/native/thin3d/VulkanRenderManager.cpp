@@ -6,6 +6,7 @@
 #include "Common/Vulkan/VulkanContext.h"
 #include "thin3d/VulkanRenderManager.h"
 #include "thread/threadutil.h"
+#include "profiler/profiler.h"
 
 #if 0 // def _DEBUG
 #define VLOG ILOG
@@ -18,7 +19,7 @@
 #endif
 
 
-void CreateImage(VulkanContext *vulkan, VkCommandBuffer cmd, VKRImage &img, int width, int height, VkFormat format, VkImageLayout initialLayout, bool color) {
+void CreateImage(VulkanContext *vulkan, VkCommandBuffer cmd, VKRImage &img, int width, int height, VkFormat format, VkImageLayout initialLayout, bool color, bool transient) {
 	VkImageCreateInfo ici{ VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
 	ici.arrayLayers = 1;
 	ici.mipLevels = 1;
@@ -37,6 +38,9 @@ void CreateImage(VulkanContext *vulkan, VkCommandBuffer cmd, VKRImage &img, int
 	} else {
 		ici.usage |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
 	}
+	if (transient) {
+		ici.usage = (color ? VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT : VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT) | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+	}
 
 	vkCreateImage(vulkan->GetDevice(), &ici, nullptr, &img.image);
 
@@ -54,7 +58,9 @@ void CreateImage(VulkanContext *vulkan, VkCommandBuffer cmd, VKRImage &img, int
 		dedicated.image = img.image;
 	}
 
-	vulkan->MemoryTypeFromProperties(memreq.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &alloc.memoryTypeIndex);
+	if (!transient || !vulkan->MemoryTypeFromProperties(memreq.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, &alloc.memoryTypeIndex)) {
+		vulkan->MemoryTypeFromProperties(memreq.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &alloc.memoryTypeIndex);
+	}
 	VkResult res = vkAllocateMemory(vulkan->GetDevice(), &alloc, nullptr, &img.memory);
 	assert(res == VK_SUCCESS);
 	res = vkBindImageMemory(vulkan->GetDevice(), img.image, img.memory, 0);
@@ -132,6 +138,19 @@ VulkanRenderManager::VulkanRenderManager(VulkanContext *vulkan) : vulkan_(vulkan
 		frameData_[i].fence = vulkan_->CreateFence(true);  // So it can be instantly waited on
 	}
 
+	const VkQueueFamilyProperties &queueProps = vulkan_->GetQueueFamilyProperties(vulkan_->GetGraphicsQueueFamilyIndex());
+	timestampValidBits_ = queueProps.timestampValidBits;
+	if (timestampValidBits_ != 0) {
+		for (int i = 0; i < vulkan_->GetInflightFrames(); i++) {
+			VkQueryPoolCreateInfo query_ci{ VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+			query_ci.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			query_ci.queryCount = VKRFrameTimers::NUM_QUERIES;
+			res = vkCreateQueryPool(vulkan_->GetDevice(), &query_ci, nullptr, &frameData_[i].timers.pool);
+			assert(res == VK_SUCCESS);
+			frameData_[i].timersNeedReset = true;
+		}
+	}
+
 	queueRunner_.CreateDeviceObjects();
 
 	// Temporary AMD hack for issue #10097
@@ -294,7 +313,19 @@ VulkanRenderManager::~VulkanRenderManager() {
 		vkDestroyCommandPool(device, frameData_[i].cmdPoolInit, nullptr);
 		vkDestroyCommandPool(device, frameData_[i].cmdPoolMain, nullptr);
 		vkDestroyFence(device, frameData_[i].fence, nullptr);
+		if (frameData_[i].timers.pool != VK_NULL_HANDLE)
+			vkDestroyQueryPool(device, frameData_[i].timers.pool, nullptr);
+		for (VKRAsyncReadback *readback : frameData_[i].readbacks) {
+			queueRunner_.DestroyAsyncReadbackBuffer(readback);
+			delete readback;
+		}
+		frameData_[i].readbacks.clear();
+	}
+	for (VKRAsyncReadback *readback : freeReadbacks_) {
+		queueRunner_.DestroyAsyncReadbackBuffer(readback);
+		delete readback;
 	}
+	freeReadbacks_.clear();
 	queueRunner_.DestroyDeviceObjects();
 }
 
@@ -372,9 +403,64 @@ void VulkanRenderManager::BeginFrame() {
 	}
 	vulkan_->BeginFrame();
 
+	// The fence also covers any readbacks this frame slot recorded last time around.
+	FinishAsyncReadbacks(frameData);
+	ResolveGPUTimers(frameData);
+
 	insideFrame_ = true;
 }
 
+void VulkanRenderManager::FinishAsyncReadbacks(FrameData &frameData) {
+	for (VKRAsyncReadback *readback : frameData.readbacks) {
+		if (readback->pixels) {
+			queueRunner_.CopyAsyncReadback(*readback);
+			readback->pixels = nullptr;
+		}
+		freeReadbacks_.push_back(readback);
+	}
+	frameData.readbacks.clear();
+}
+
+void VulkanRenderManager::ResolveGPUTimers(FrameData &frameData) {
+	VKRFrameTimers &timers = frameData.timers;
+	if (timers.pool == VK_NULL_HANDLE)
+		return;
+
+	if (frameData.frameTimerWritten) {
+		uint64_t stamps[2]{};
+		VkResult res = vkGetQueryPoolResults(vulkan_->GetDevice(), timers.pool, VKRFrameTimers::FRAME_QUERY, 2, sizeof(stamps), stamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+		if (res == VK_SUCCESS) {
+			uint64_t mask = timestampValidBits_ >= 64 ? ~0ULL : (1ULL << timestampValidBits_) - 1;
+			double period = vulkan_->GetPhysicalDeviceProperties().limits.timestampPeriod;
+			gpuFrameTime_ = (float)((double)((stamps[1] - stamps[0]) & mask) * period / 1000000.0);
+		}
+		frameData.frameTimerWritten = false;
+		frameData.timersNeedReset = true;
+	}
+
+	size_t count = timers.names.size();
+	if (count) {
+		std::vector<uint64_t> stamps(count * 2);
+		VkResult res = vkGetQueryPoolResults(vulkan_->GetDevice(), timers.pool, 0, (uint32_t)(count * 2), sizeof(uint64_t) * stamps.size(), stamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+		if (res == VK_SUCCESS) {
+			uint64_t mask = timestampValidBits_ >= 64 ? ~0ULL : (1ULL << timestampValidBits_) - 1;
+			double period = vulkan_->GetPhysicalDeviceProperties().limits.timestampPeriod;
+			for (size_t i = 0; i < count; i++) {
+				uint64_t ticks = (stamps[i * 2 + 1] - stamps[i * 2]) & mask;
+				PROFILE_GPU_TIME(timers.names[i], (double)ticks * period / 1000000000.0);
+			}
+		}
+		timers.names.clear();
+		frameData.timersNeedReset = true;
+	}
+
+	// Queries have to be reset before they can be written again, the init commands run first.
+	if (frameData.timersNeedReset) {
+		vkCmdResetQueryPool(GetInitCmd(), timers.pool, 0, VKRFrameTimers::NUM_QUERIES);
+		frameData.timersNeedReset = false;
+	}
+}
+
 VkCommandBuffer VulkanRenderManager::GetInitCmd() {
 	int curFrame = vulkan_->GetCurFrame();
 	FrameData &frameData = frameData_[curFrame];
@@ -421,7 +507,9 @@ void VulkanRenderManager::BindFramebufferAsRenderTarget(VKRFramebuffer *fb, VKRR
 	step->render.clearDepth = clearDepth;
 	step->render.clearStencil = clearStencil;
 	step->render.numDraws = 0;
+	step->render.discardDepth = false;
 	step->render.finalColorLayout = !fb ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+	step->timerName = gpuTimerName_;
 	steps_.push_back(step);
 
 	curRenderStep_ = step;
@@ -435,6 +523,8 @@ bool VulkanRenderManager::CopyFramebufferToMemorySync(VKRFramebuffer *src, int a
 	step->readback.src = src;
 	step->readback.srcRect.offset = { x, y };
 	step->readback.srcRect.extent = { (uint32_t)w, (uint32_t)h };
+	step->readback.dstBuffer = VK_NULL_HANDLE;
+	step->timerName = gpuTimerName_;
 	steps_.push_back(step);
 
 	curRenderStep_ = nullptr;
@@ -482,12 +572,72 @@ bool VulkanRenderManager::CopyFramebufferToMemorySync(VKRFramebuffer *src, int a
 	return true;
 }
 
+bool VulkanRenderManager::CopyFramebufferToMemoryAsync(VKRFramebuffer *src, int aspectBits, int x, int y, int w, int h, Draw::DataFormat destFormat, uint8_t *pixels, int pixelStride) {
+	// Backbuffer and depth/stencil readbacks are rare enough to always go through the sync path.
+	if (!src || aspectBits != VK_IMAGE_ASPECT_COLOR_BIT || src->color.format != VK_FORMAT_R8G8B8A8_UNORM) {
+		return false;
+	}
+
+	const VkDeviceSize size = sizeof(uint32_t) * w * h;
+	VKRAsyncReadback *readback = nullptr;
+	for (size_t i = 0; i < freeReadbacks_.size(); ++i) {
+		if (freeReadbacks_[i]->size >= size) {
+			readback = freeReadbacks_[i];
+			freeReadbacks_.erase(freeReadbacks_.begin() + i);
+			break;
+		}
+	}
+	if (!readback) {
+		// Replace a free one that is too small rather than letting the pool keep growing.
+		if (!freeReadbacks_.empty()) {
+			readback = freeReadbacks_.front();
+			freeReadbacks_.erase(freeReadbacks_.begin());
+			queueRunner_.DestroyAsyncReadbackBuffer(readback);
+		} else {
+			readback = new VKRAsyncReadback();
+		}
+		if (!queueRunner_.CreateAsyncReadbackBuffer(readback, size)) {
+			delete readback;
+			return false;
+		}
+	}
+
+	readback->width = w;
+	readback->height = h;
+	readback->srcFormat = Draw::DataFormat::R8G8B8A8_UNORM;
+	readback->destFormat = destFormat;
+	readback->pixels = pixels;
+	readback->pixelStride = pixelStride;
+	frameData_[vulkan_->GetCurFrame()].readbacks.push_back(readback);
+
+	VKRStep *step = new VKRStep{ VKRStepType::READBACK };
+	step->readback.aspectMask = aspectBits;
+	step->readback.src = src;
+	step->readback.srcRect.offset = { x, y };
+	step->readback.srcRect.extent = { (uint32_t)w, (uint32_t)h };
+	step->readback.dstBuffer = readback->buffer;
+	step->timerName = gpuTimerName_;
+	steps_.push_back(step);
+
+	curRenderStep_ = nullptr;
+	return true;
+}
+
+void VulkanRenderManager::DiscardAsyncReadbacks() {
+	for (int i = 0; i < vulkan_->GetInflightFrames(); i++) {
+		for (VKRAsyncReadback *readback : frameData_[i].readbacks) {
+			readback->pixels = nullptr;
+		}
+	}
+}
+
 void VulkanRenderManager::CopyImageToMemorySync(VkImage image, int mipLevel, int x, int y, int w, int h, Draw::DataFormat destFormat, uint8_t *pixels, int pixelStride) {
 	VKRStep *step = new VKRStep{ VKRStepType::READBACK_IMAGE };
 	step->readback_image.image = image;
 	step->readback_image.srcRect.offset = { x, y };
 	step->readback_image.srcRect.extent = { (uint32_t)w, (uint32_t)h };
 	step->readback_image.mipLevel = mipLevel;
+	step->timerName = gpuTimerName_;
 	steps_.push_back(step);
 
 	curRenderStep_ = nullptr;
@@ -672,6 +822,7 @@ void VulkanRenderManager::CopyFramebuffer(VKRFramebuffer *src, VkRect2D srcRect,
 	step->copy.dstPos = dstPos;
 
 	std::unique_lock<std::mutex> lock(mutex_);
+	step->timerName = gpuTimerName_;
 	steps_.push_back(step);
 	curRenderStep_ = nullptr;
 }
@@ -703,6 +854,7 @@ void VulkanRenderManager::BlitFramebuffer(VKRFramebuffer *src, VkRect2D srcRect,
 	step->blit.filter = filter;
 
 	std::unique_lock<std::mutex> lock(mutex_);
+	step->timerName = gpuTimerName_;
 	steps_.push_back(step);
 	curRenderStep_ = nullptr;
 }
@@ -757,6 +909,11 @@ void VulkanRenderManager::Wipe() {
 		delete step;
 	}
 	steps_.clear();
+
+	// Any readbacks of this frame went with the steps.
+	for (VKRAsyncReadback *readback : frameData_[vulkan_->GetCurFrame()].readbacks) {
+		readback->pixels = nullptr;
+	}
 }
 
 // Can be called multiple times with no bad side effects. This is so that we can either begin a frame the normal way,
@@ -783,6 +940,9 @@ void VulkanRenderManager::BeginSubmitFrame(int frame) {
 
 		queueRunner_.SetBackbuffer(framebuffers_[frameData.curSwapchainImage], swapchainImages_[frameData.curSwapchainImage].image);
 
+		if (frameData.timers.pool != VK_NULL_HANDLE) {
+			vkCmdWriteTimestamp(frameData.mainCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frameData.timers.pool, VKRFrameTimers::FRAME_QUERY);
+		}
 		frameData.hasBegun = true;
 	}
 }
@@ -851,6 +1011,10 @@ void VulkanRenderManager::EndSubmitFrame(int frame) {
 	FrameData &frameData = frameData_[frame];
 	frameData.hasBegun = false;
 
+	if (frameData.timers.pool != VK_NULL_HANDLE) {
+		vkCmdWriteTimestamp(frameData.mainCmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frameData.timers.pool, VKRFrameTimers::FRAME_QUERY + 1);
+		frameData.frameTimerWritten = true;
+	}
 	Submit(frame, true);
 
 	if (!frameData.skipSwap) {
@@ -881,7 +1045,7 @@ void VulkanRenderManager::Run(int frame) {
 	auto &stepsOnThread = frameData_[frame].steps;
 	VkCommandBuffer cmd = frameData.mainCmd;
 	// queueRunner_.LogSteps(stepsOnThread);
-	queueRunner_.RunSteps(cmd, stepsOnThread);
+	queueRunner_.RunSteps(cmd, stepsOnThread, frame, &frameData.timers);
 	stepsOnThread.clear();
 
 	switch (frameData.type) {
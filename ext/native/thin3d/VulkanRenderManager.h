@@ -25,16 +25,20 @@ struct VKRImage {
 	VkImageLayout layout;
 	VkFormat format;
 };
-void CreateImage(VulkanContext *vulkan, VkCommandBuffer cmd, VKRImage &img, int width, int height, VkFormat format, VkImageLayout initialLayout, bool color);
+// Transient images can only be attachments, and get lazily allocated memory where the GPU has it. Tilers may
+// then never back them at all.
+void CreateImage(VulkanContext *vulkan, VkCommandBuffer cmd, VKRImage &img, int width, int height, VkFormat format, VkImageLayout initialLayout, bool color, bool transient = false);
 
 class VKRFramebuffer {
 public:
-	VKRFramebuffer(VulkanContext *vk, VkCommandBuffer initCmd, VkRenderPass renderPass, int _width, int _height) : vulkan_(vk) {
+	// Without a real depth buffer (transientDepth), the depth can't be copied or sampled, only used while rendering.
+	VKRFramebuffer(VulkanContext *vk, VkCommandBuffer initCmd, VkRenderPass renderPass, int _width, int _height, bool _transientDepth = false) : vulkan_(vk) {
 		width = _width;
 		height = _height;
+		transientDepth = _transientDepth;
 
 		CreateImage(vulkan_, initCmd, color, width, height, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true);
-		CreateImage(vulkan_, initCmd, depth, width, height, vulkan_->GetDeviceInfo().preferredDepthStencilFormat, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, false);
+		CreateImage(vulkan_, initCmd, depth, width, height, vulkan_->GetDeviceInfo().preferredDepthStencilFormat, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, false, transientDepth);
 
 		VkFramebufferCreateInfo fbci{ VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO };
 		VkImageView views[2]{};
@@ -75,6 +79,7 @@ class VKRFramebuffer {
 	VKRImage depth{};
 	int width = 0;
 	int height = 0;
+	bool transientDepth = false;
 
 	VulkanContext *vulkan_;
 };
@@ -103,11 +108,29 @@ class VulkanRenderManager {
 	void BindFramebufferAsRenderTarget(VKRFramebuffer *fb, VKRRenderPassAction color, VKRRenderPassAction depth, VKRRenderPassAction stencil, uint32_t clearColor, float clearDepth, uint8_t clearStencil);
 	VkImageView BindFramebufferAsTexture(VKRFramebuffer *fb, int binding, int aspectBit, int attachment);
 	bool CopyFramebufferToMemorySync(VKRFramebuffer *src, int aspectBits, int x, int y, int w, int h, Draw::DataFormat destFormat, uint8_t *pixels, int pixelStride);
+	// Doesn't stall. The pixels get written in a later BeginFrame, once the GPU is done with the current frame.
+	// Only color readbacks from RGBA8888 framebuffers for now, returns false otherwise.
+	bool CopyFramebufferToMemoryAsync(VKRFramebuffer *src, int aspectBits, int x, int y, int w, int h, Draw::DataFormat destFormat, uint8_t *pixels, int pixelStride);
+	// Drops async readbacks that haven't been written yet. Use when their destination memory goes away.
+	void DiscardAsyncReadbacks();
 	void CopyImageToMemorySync(VkImage image, int mipLevel, int x, int y, int w, int h, Draw::DataFormat destFormat, uint8_t *pixels, int pixelStride);
 
 	void CopyFramebuffer(VKRFramebuffer *src, VkRect2D srcRect, VKRFramebuffer *dst, VkOffset2D dstPos, int aspectMask);
 	void BlitFramebuffer(VKRFramebuffer *src, VkRect2D srcRect, VKRFramebuffer *dst, VkRect2D dstRect, int aspectMask, VkFilter filter);
 
+	// Steps started until EndGPUTimer are timed on the GPU and reported to the profiler.
+	// name must stay valid, use string literals.
+	void BeginGPUTimer(const char *name) {
+		gpuTimerName_ = name;
+	}
+	void EndGPUTimer() {
+		gpuTimerName_ = nullptr;
+	}
+	// GPU milliseconds of the last measured frame, 0 without timestamp support.
+	float GetGPUFrameTime() const {
+		return gpuFrameTime_;
+	}
+
 	void BindPipeline(VkPipeline pipeline) {
 		_dbg_assert_(G3D, curRenderStep_ && curRenderStep_->stepType == VKRStepType::RENDER);
 		_dbg_assert_(G3D, pipeline != VK_NULL_HANDLE);
@@ -272,6 +295,12 @@ class VulkanRenderManager {
 		VkCommandBuffer mainCmd;
 		bool hasInitCommands = false;
 		std::vector<VKRStep *> steps;
+		// Async readbacks recorded in this frame, copied out once its fence has been waited on.
+		std::vector<VKRAsyncReadback *> readbacks;
+		// Named step timestamps, reported to the profiler once the fence has passed.
+		VKRFrameTimers timers;
+		bool timersNeedReset = false;
+		bool frameTimerWritten = false;
 
 		// Swapchain.
 		bool hasBegun = false;
@@ -279,11 +308,19 @@ class VulkanRenderManager {
 	};
 	FrameData frameData_[VulkanContext::MAX_INFLIGHT_FRAMES];
 
+	void FinishAsyncReadbacks(FrameData &frameData);
+	void ResolveGPUTimers(FrameData &frameData);
+	uint32_t timestampValidBits_ = 0;
+	std::atomic<float> gpuFrameTime_{ 0.0f };
+	// Staging buffers of finished async readbacks, for reuse.
+	std::vector<VKRAsyncReadback *> freeReadbacks_;
+
 	// Submission time state
 	int curWidth_;
 	int curHeight_;
 	bool insideFrame_ = false;
 	VKRStep *curRenderStep_ = nullptr;
+	const char *gpuTimerName_ = nullptr;
 	std::vector<VKRStep *> steps_;
 	bool splitSubmit_ = false;
 
@@ -258,6 +258,8 @@ enum class NativeObject {
 	BOUND_TEXTURE0_IMAGEVIEW,
 	BOUND_TEXTURE1_IMAGEVIEW,
 	RENDER_MANAGER,
+	// D3D11: changes whenever recorded commands get submitted. Dynamic buffers must then be mapped with DISCARD first.
+	COMMAND_LIST_SERIAL,
 };
 
 enum FBColorDepth {
@@ -297,6 +299,8 @@ enum class Event {
 	GOT_DEVICE,
 
 	RESIZED,
+	// Sent instead of presenting directly, by contexts that let the DrawContext present for them.
+	PRESENT_REQUESTED,
 	PRESENTED,
 };
 
@@ -562,6 +566,13 @@ class DrawContext {
 	virtual bool CopyFramebufferToMemorySync(Framebuffer *src, int channelBits, int x, int y, int w, int h, Draw::DataFormat format, void *pixels, int pixelStride) {
 		return false;
 	}
+	// Like the above but without waiting for the GPU, pixels gets written a few frames later.
+	// Returns false if the backend can't do it for this framebuffer, use the sync version then.
+	virtual bool CopyFramebufferToMemoryAsync(Framebuffer *src, int channelBits, int x, int y, int w, int h, Draw::DataFormat format, void *pixels, int pixelStride) {
+		return false;
+	}
+	// Drops async copies that haven't been written yet, for when their destination memory goes away.
+	virtual void DiscardAsyncReadbacks() {}
 
 	// These functions should be self explanatory.
 	// Binding a zero render target means binding the backbuffer.
@@ -611,6 +622,14 @@ class DrawContext {
 	virtual void EndFrame() {}
 	virtual void WipeQueue() {}
 
+	// GPU timing for the profiler. On GL and Vulkan, the render passes, copies and readbacks started
+	// between these are timed, on D3D11 the commands in between. Results show up as GPU categories
+	// in the profiler a few frames later. name must stay valid, use string literals. Doesn't nest.
+	virtual void BeginGPUTimer(const char *name) {}
+	virtual void EndGPUTimer() {}
+	// GPU milliseconds spent on a recent whole frame, from timestamp queries. 0 if unknown.
+	virtual float GetGPUFrameTime() const { return 0.0f; }
+
 	// This should be avoided as much as possible, in favor of clearing when binding a render target, which is native
 	// on Vulkan.
 	virtual void Clear(int mask, uint32_t colorval, float depthVal, int stencilVal) = 0;
@@ -644,6 +663,18 @@ class DrawContext {
 	int targetHeight_;
 };
 
+class GPUTimerScope {
+public:
+	GPUTimerScope(DrawContext *draw, const char *name) : draw_(draw) {
+		draw_->BeginGPUTimer(name);
+	}
+	~GPUTimerScope() {
+		draw_->EndGPUTimer();
+	}
+private:
+	DrawContext *draw_;
+};
+
 extern const UniformBufferDesc UBPresetDesc;
 
 // UBs for the preset shaders
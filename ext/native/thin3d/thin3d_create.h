@@ -1,5 +1,7 @@
 #pragma once
 
+#include <functional>
+
 #include "thin3d/thin3d.h"
 
 // Separated this stuff into its own file so we don't get Windows.h included if all we want is the thin3d declarations.
@@ -30,7 +32,9 @@ DrawContext *T3DCreateGLContext();
 
 #ifdef _WIN32
 DrawContext *T3DCreateDX9Context(IDirect3D9 *d3d, IDirect3D9Ex *d3dEx, int adapterId, IDirect3DDevice9 *device, IDirect3DDevice9Ex *deviceEx);
-DrawContext *T3DCreateD3D11Context(ID3D11Device *device, ID3D11DeviceContext *context, ID3D11Device1 *device1, ID3D11DeviceContext1 *context1, D3D_FEATURE_LEVEL featureLevel, HWND hWnd);
+// With deferredSubmission, draws are recorded on a deferred context and executed (and presented, using present) on a
+// separate thread. Silently falls back to the immediate context if the driver can't do it natively.
+DrawContext *T3DCreateD3D11Context(ID3D11Device *device, ID3D11DeviceContext *context, ID3D11Device1 *device1, ID3D11DeviceContext1 *context1, D3D_FEATURE_LEVEL featureLevel, HWND hWnd, bool deferredSubmission = false, std::function<void()> present = nullptr);
 #endif
 
 DrawContext *T3DCreateVulkanContext(VulkanContext *context, bool split);
@@ -9,11 +9,18 @@
 #include "base/display.h"
 #include "math/dataconv.h"
 #include "util/text/utf8.h"
+#include "thread/threadutil.h"
+#include "profiler/profiler.h"
 
 #include "Common/ColorConv.h"
 
 #include <cassert>
 #include <cfloat>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
 #include <D3DCommon.h>
 #include <d3d11.h>
 #include <d3d11_1.h>
@@ -38,7 +45,7 @@ class D3D11RasterState;
 
 class D3D11DrawContext : public DrawContext {
 public:
-	D3D11DrawContext(ID3D11Device *device, ID3D11DeviceContext *deviceContext, ID3D11Device1 *device1, ID3D11DeviceContext1 *deviceContext1, D3D_FEATURE_LEVEL featureLevel, HWND hWnd);
+	D3D11DrawContext(ID3D11Device *device, ID3D11DeviceContext *deviceContext, ID3D11Device1 *device1, ID3D11DeviceContext1 *deviceContext1, D3D_FEATURE_LEVEL featureLevel, HWND hWnd, bool deferredSubmission, std::function<void()> present);
 	~D3D11DrawContext();
 
 	const DeviceCaps &GetDeviceCaps() const override {
@@ -99,6 +106,9 @@ class D3D11DrawContext : public DrawContext {
 	void Clear(int mask, uint32_t colorval, float depthVal, int stencilVal);
 
 	void BeginFrame() override;
+	void EndFrame() override;
+	void BeginGPUTimer(const char *name) override;
+	void EndGPUTimer() override;
 
 	std::string GetInfoString(InfoField info) const override {
 		switch (info) {
@@ -144,6 +154,8 @@ class D3D11DrawContext : public DrawContext {
 			return (uintptr_t)bbDepthStencilView_;
 		case NativeObject::FEATURE_LEVEL:
 			return (uintptr_t)featureLevel_;
+		case NativeObject::COMMAND_LIST_SERIAL:
+			return (uintptr_t)commandListSerial_;
 		default:
 			return 0;
 		}
@@ -159,11 +171,55 @@ class D3D11DrawContext : public DrawContext {
 	void ApplyCurrentState();
 	void RotateRectToDisplay(FRect &rect);
 
+	// Deferred submission. The emu thread records into context_, the submit thread owns immediate_.
+	void SubmitThreadFunc();
+	void StopSubmitThread();
+	// Closes the current command list and queues it, optionally followed by a present.
+	void SubmitCommandList(bool present);
+	void WaitSubmitIdle();
+
 	HWND hWnd_;
 	ID3D11Device *device_;
 	ID3D11DeviceContext *context_;
 	ID3D11Device1 *device1_;
 	ID3D11DeviceContext1 *context1_;
+	// Same as context_ unless using deferred submission.
+	ID3D11DeviceContext *immediate_;
+
+	struct SubmitItem {
+		ID3D11CommandList *list;
+		bool present;
+	};
+	bool deferred_ = false;
+	uint32_t commandListSerial_ = 0;
+	std::function<void()> present_;
+	std::thread submitThread_;
+	std::mutex submitMutex_;
+	std::condition_variable submitCondVar_;
+	std::condition_variable submitDoneCondVar_;
+	std::deque<SubmitItem> submitQueue_;
+	int queuedPresents_ = 0;
+	bool submitBusy_ = false;
+	bool submitRun_ = true;
+
+	// GPU timers. Only with the immediate context, since reading them back needs it. Results are
+	// picked up when the frame slot comes around again, or dropped if they're not ready by then.
+	struct GPUTimer {
+		const char *name;
+		ID3D11Query *begin;
+		ID3D11Query *end;
+	};
+	struct GPUTimerFrame {
+		ID3D11Query *disjoint;
+		bool active;
+		std::vector<GPUTimer> timers;
+	};
+	enum { GPU_TIMER_FRAMES = 4 };
+	void ResolveGPUTimers(GPUTimerFrame &frame);
+	GPUTimerFrame gpuTimerFrames_[GPU_TIMER_FRAMES]{};
+	int curGPUTimerFrame_ = 0;
+	std::vector<GPUTimer> freeGPUTimers_;
+	GPUTimer curGPUTimer_{};
 
 	ID3D11Texture2D *bbRenderTargetTex_ = nullptr; // NOT OWNED
 	ID3D11RenderTargetView *bbRenderTargetView_ = nullptr;
@@ -212,13 +268,15 @@ class D3D11DrawContext : public DrawContext {
 	std::string adapterDesc_;
 };
 
-D3D11DrawContext::D3D11DrawContext(ID3D11Device *device, ID3D11DeviceContext *deviceContext, ID3D11Device1 *device1, ID3D11DeviceContext1 *deviceContext1, D3D_FEATURE_LEVEL featureLevel, HWND hWnd)
+D3D11DrawContext::D3D11DrawContext(ID3D11Device *device, ID3D11DeviceContext *deviceContext, ID3D11Device1 *device1, ID3D11DeviceContext1 *deviceContext1, D3D_FEATURE_LEVEL featureLevel, HWND hWnd, bool deferredSubmission, std::function<void()> present)
 	: device_(device),
 		context_(deviceContext1),
 		device1_(device1),
 		context1_(deviceContext1),
 		featureLevel_(featureLevel),
-		hWnd_(hWnd) {
+		hWnd_(hWnd),
+		present_(present) {
+	immediate_ = context_;
 
 	// Seems like a fair approximation...
 	caps_.dualSourceBlend = featureLevel_ >= D3D_FEATURE_LEVEL_10_0;
@@ -232,6 +290,28 @@ D3D11DrawContext::D3D11DrawContext(ID3D11Device *device, ID3D11DeviceContext *de
 
 	D3D11_FEATURE_DATA_D3D11_OPTIONS options{};
 	HRESULT result = device_->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options));
+
+	// Only bother with deferred submission if the driver does command lists natively (otherwise the runtime
+	// just replays them on the immediate context, and UpdateSubresource with boxes is buggy), and if the
+	// NO_OVERWRITE maps our push buffers rely on are allowed on deferred contexts.
+	D3D11_FEATURE_DATA_THREADING threading{};
+	if (deferredSubmission && present_ && SUCCEEDED(result) && options.MapNoOverwriteOnDynamicConstantBuffer &&
+		SUCCEEDED(device_->CheckFeatureSupport(D3D11_FEATURE_THREADING, &threading, sizeof(threading))) && threading.DriverCommandLists) {
+		ID3D11DeviceContext *deferredContext = nullptr;
+		ID3D11DeviceContext1 *deferredContext1 = nullptr;
+		if (SUCCEEDED(device_->CreateDeferredContext(0, &deferredContext))) {
+			if (SUCCEEDED(deferredContext->QueryInterface(__uuidof(ID3D11DeviceContext1), (void **)&deferredContext1))) {
+				context_ = deferredContext1;
+				context1_ = deferredContext1;
+				deferred_ = true;
+			}
+			deferredContext->Release();
+		}
+	}
+	if (deferred_) {
+		submitThread_ = std::thread(&D3D11DrawContext::SubmitThreadFunc, this);
+	}
+
 	if (SUCCEEDED(result)) {
 		if (options.OutputMergerLogicOp) {
 			// Actually, need to check that the format supports logic ops as well.
@@ -284,11 +364,105 @@ D3D11DrawContext::D3D11DrawContext(ID3D11Device *device, ID3D11DeviceContext *de
 D3D11DrawContext::~D3D11DrawContext() {
 	packTexture_->Release();
 
+	for (GPUTimerFrame &frame : gpuTimerFrames_) {
+		if (frame.disjoint)
+			frame.disjoint->Release();
+		freeGPUTimers_.insert(freeGPUTimers_.end(), frame.timers.begin(), frame.timers.end());
+	}
+	for (GPUTimer &timer : freeGPUTimers_) {
+		timer.begin->Release();
+		timer.end->Release();
+	}
+
 	// Release references.
 	ID3D11RenderTargetView *view = nullptr;
 	context_->OMSetRenderTargets(1, &view, nullptr);
 	ID3D11ShaderResourceView *srv[2]{};
 	context_->PSSetShaderResources(0, 2, srv);
+
+	if (deferred_) {
+		StopSubmitThread();
+		context_->Release();
+	}
+}
+
+void D3D11DrawContext::SubmitThreadFunc() {
+	setCurrentThreadName("D3D11Submit");
+	std::unique_lock<std::mutex> lock(submitMutex_);
+	while (true) {
+		while (submitQueue_.empty() && submitRun_) {
+			submitCondVar_.wait(lock);
+		}
+		if (submitQueue_.empty()) {
+			break;
+		}
+		SubmitItem item = submitQueue_.front();
+		submitQueue_.pop_front();
+		submitBusy_ = true;
+		lock.unlock();
+
+		if (item.list) {
+			immediate_->ExecuteCommandList(item.list, FALSE);
+			item.list->Release();
+		}
+		if (item.present) {
+			present_();
+		}
+
+		lock.lock();
+		submitBusy_ = false;
+		if (item.present) {
+			queuedPresents_--;
+		}
+		submitDoneCondVar_.notify_all();
+	}
+}
+
+void D3D11DrawContext::StopSubmitThread() {
+	{
+		std::lock_guard<std::mutex> guard(submitMutex_);
+		submitRun_ = false;
+		submitCondVar_.notify_all();
+	}
+	// Drains whatever is still queued before exiting.
+	submitThread_.join();
+}
+
+void D3D11DrawContext::SubmitCommandList(bool present) {
+	ID3D11CommandList *list = nullptr;
+	// Keep the recorded state, so we don't need to re-apply everything after a mid-frame flush.
+	if (FAILED(context_->FinishCommandList(TRUE, &list))) {
+		list = nullptr;
+	}
+	commandListSerial_++;
+
+	std::unique_lock<std::mutex> lock(submitMutex_);
+	// Don't let the emu thread get more than a frame ahead of the driver, or latency goes through the roof.
+	while (present && queuedPresents_ >= 1) {
+		submitDoneCondVar_.wait(lock);
+	}
+	submitQueue_.push_back(SubmitItem{ list, present });
+	if (present) {
+		queuedPresents_++;
+	}
+	submitCondVar_.notify_one();
+}
+
+void D3D11DrawContext::WaitSubmitIdle() {
+	std::unique_lock<std::mutex> lock(submitMutex_);
+	while (!submitQueue_.empty() || submitBusy_) {
+		submitDoneCondVar_.wait(lock);
+	}
+}
+
+void D3D11DrawContext::EndFrame() {
+	GPUTimerFrame &timerFrame = gpuTimerFrames_[curGPUTimerFrame_];
+	if (timerFrame.active) {
+		context_->End(timerFrame.disjoint);
+	}
+	if (deferred_) {
+		SubmitCommandList(false);
+	}
 }
 
 void D3D11DrawContext::HandleEvent(Event ev, int width, int height, void *param1, void *param2) {
@@ -300,6 +474,11 @@ void D3D11DrawContext::HandleEvent(Event ev, int width, int height, void *param1
 			curRenderTargetView_ = nullptr;
 			curDepthStencilView_ = nullptr;
 		}
+		if (deferred_) {
+			// The swap chain can only be resized once queued command lists no longer reference the backbuffer.
+			SubmitCommandList(false);
+			WaitSubmitIdle();
+		}
 		bbDepthStencilView_->Release();
 		bbDepthStencilView_ = nullptr;
 		bbDepthStencilTex_->Release();
@@ -346,6 +525,14 @@ void D3D11DrawContext::HandleEvent(Event ev, int width, int height, void *param1
 		curRTHeight_ = height;
 		break;
 	}
+	case Event::PRESENT_REQUESTED:
+		if (deferred_) {
+			// Anything recorded since EndFrame() needs to get in before the present.
+			SubmitCommandList(true);
+		} else if (present_) {
+			present_();
+		}
+		break;
 	case Event::PRESENTED:
 		// Make sure that we don't eliminate the next time the render target is set.
 		curRenderTargetView_ = nullptr;
@@ -1277,6 +1464,9 @@ void D3D11DrawContext::Clear(int mask, uint32_t colorval, float depthVal, int st
 }
 
 void D3D11DrawContext::BeginFrame() {
+	curGPUTimerFrame_ = (curGPUTimerFrame_ + 1) % GPU_TIMER_FRAMES;
+	ResolveGPUTimers(gpuTimerFrames_[curGPUTimerFrame_]);
+
 	context_->OMSetRenderTargets(1, &curRenderTargetView_, curDepthStencilView_);
 
 	if (curBlend_) {
@@ -1304,6 +1494,67 @@ void D3D11DrawContext::BeginFrame() {
 	}
 }
 
+void D3D11DrawContext::ResolveGPUTimers(GPUTimerFrame &frame) {
+	if (!frame.active)
+		return;
+	D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint{};
+	if (immediate_->GetData(frame.disjoint, &disjoint, sizeof(disjoint), D3D11_ASYNC_GETDATA_DONOTFLUSH) == S_OK && !disjoint.Disjoint && disjoint.Frequency != 0) {
+		for (const GPUTimer &timer : frame.timers) {
+			UINT64 begin = 0, end = 0;
+			if (immediate_->GetData(timer.begin, &begin, sizeof(begin), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+				continue;
+			if (immediate_->GetData(timer.end, &end, sizeof(end), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+				continue;
+			PROFILE_GPU_TIME(timer.name, (double)(end - begin) / (double)disjoint.Frequency);
+		}
+	}
+	freeGPUTimers_.insert(freeGPUTimers_.end(), frame.timers.begin(), frame.timers.end());
+	frame.timers.clear();
+	frame.active = false;
+}
+
+void D3D11DrawContext::BeginGPUTimer(const char *name) {
+	curGPUTimer_.name = nullptr;
+	if (deferred_)
+		return;
+
+	GPUTimerFrame &frame = gpuTimerFrames_[curGPUTimerFrame_];
+	if (!frame.disjoint) {
+		D3D11_QUERY_DESC desc{ D3D11_QUERY_TIMESTAMP_DISJOINT };
+		if (FAILED(device_->CreateQuery(&desc, &frame.disjoint)))
+			return;
+	}
+	GPUTimer timer{};
+	if (!freeGPUTimers_.empty()) {
+		timer = freeGPUTimers_.back();
+		freeGPUTimers_.pop_back();
+	} else {
+		D3D11_QUERY_DESC desc{ D3D11_QUERY_TIMESTAMP };
+		if (FAILED(device_->CreateQuery(&desc, &timer.begin)))
+			return;
+		if (FAILED(device_->CreateQuery(&desc, &timer.end))) {
+			timer.begin->Release();
+			return;
+		}
+	}
+
+	if (!frame.active) {
+		context_->Begin(frame.disjoint);
+		frame.active = true;
+	}
+	timer.name = name;
+	context_->End(timer.begin);
+	curGPUTimer_ = timer;
+}
+
+void D3D11DrawContext::EndGPUTimer() {
+	if (!curGPUTimer_.name)
+		return;
+	context_->End(curGPUTimer_.end);
+	gpuTimerFrames_[curGPUTimerFrame_].timers.push_back(curGPUTimer_);
+	curGPUTimer_.name = nullptr;
+}
+
 void D3D11DrawContext::CopyFramebufferImage(Framebuffer *srcfb, int level, int x, int y, int z, Framebuffer *dstfb, int dstLevel, int dstX, int dstY, int dstZ, int width, int height, int depth, int channelBit) {
 	D3D11Framebuffer *src = (D3D11Framebuffer *)srcfb;
 	D3D11Framebuffer *dst = (D3D11Framebuffer *)dstfb;
@@ -1426,9 +1677,16 @@ bool D3D11DrawContext::CopyFramebufferToMemorySync(Framebuffer *src, int channel
 	// Ideally, we'd round robin between two packTexture_, and simply use the other one. Though if the game
 	// does a once-off copy, that won't work at all.
 
+	if (deferred_) {
+		// Deferred contexts can't map for reading. Get everything executed, then map on the immediate
+		// context, which is safe to use from here while the submit thread is idle.
+		SubmitCommandList(false);
+		WaitSubmitIdle();
+	}
+
 	// BIG GPU STALL
 	D3D11_MAPPED_SUBRESOURCE map;
-	HRESULT result = context_->Map(packTex, 0, D3D11_MAP_READ, 0, &map);
+	HRESULT result = immediate_->Map(packTex, 0, D3D11_MAP_READ, 0, &map);
 	if (FAILED(result)) {
 		return false;
 	}
@@ -1459,7 +1717,7 @@ bool D3D11DrawContext::CopyFramebufferToMemorySync(Framebuffer *src, int channel
 		break;
 	}
 
-	context_->Unmap(packTex, 0);
+	immediate_->Unmap(packTex, 0);
 
 	if (!useGlobalPacktex) {
 		packTex->Release();
@@ -1541,8 +1799,8 @@ void D3D11DrawContext::GetFramebufferDimensions(Framebuffer *fbo, int *w, int *h
 	}
 }
 
-DrawContext *T3DCreateD3D11Context(ID3D11Device *device, ID3D11DeviceContext *context, ID3D11Device1 *device1, ID3D11DeviceContext1 *context1, D3D_FEATURE_LEVEL featureLevel, HWND hWnd) {
-	return new D3D11DrawContext(device, context, device1, context1, featureLevel, hWnd);
+DrawContext *T3DCreateD3D11Context(ID3D11Device *device, ID3D11DeviceContext *context, ID3D11Device1 *device1, ID3D11DeviceContext1 *context1, D3D_FEATURE_LEVEL featureLevel, HWND hWnd, bool deferredSubmission, std::function<void()> present) {
+	return new D3D11DrawContext(device, context, device1, context1, featureLevel, hWnd, deferredSubmission, present);
 }
 
 }  // namespace Draw
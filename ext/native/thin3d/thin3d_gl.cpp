@@ -369,6 +369,15 @@ class OpenGLContext : public DrawContext {
 
 	void BeginFrame() override;
 	void EndFrame() override;
+	void BeginGPUTimer(const char *name) override {
+		renderManager_.BeginGPUTimer(name);
+	}
+	void EndGPUTimer() override {
+		renderManager_.EndGPUTimer();
+	}
+	float GetGPUFrameTime() const override {
+		return renderManager_.GetGPUFrameTime();
+	}
 
 	void UpdateBuffer(Buffer *buffer, const uint8_t *data, size_t offset, size_t size, UpdateBufferFlags flags) override;
 
@@ -1043,6 +1052,7 @@ void OpenGLInputLayout::Compile(const InputLayoutDesc &desc) {
 	for (auto &attr : desc.attributes) {
 		GLRInputLayout::Entry entry;
 		entry.location = attr.location;
+		entry.divisor = 0;
 		entry.stride = (GLsizei)desc.bindings[attr.binding].stride;
 		entry.offset = attr.offset;
 		switch (attr.format) {
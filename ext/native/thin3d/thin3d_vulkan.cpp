@@ -364,6 +364,19 @@ class VKContext : public DrawContext {
 	void CopyFramebufferImage(Framebuffer *src, int level, int x, int y, int z, Framebuffer *dst, int dstLevel, int dstX, int dstY, int dstZ, int width, int height, int depth, int channelBits) override;
 	bool BlitFramebuffer(Framebuffer *src, int srcX1, int srcY1, int srcX2, int srcY2, Framebuffer *dst, int dstX1, int dstY1, int dstX2, int dstY2, int channelBits, FBBlitFilter filter) override;
 	bool CopyFramebufferToMemorySync(Framebuffer *src, int channelBits, int x, int y, int w, int h, Draw::DataFormat format, void *pixels, int pixelStride) override;
+	bool CopyFramebufferToMemoryAsync(Framebuffer *src, int channelBits, int x, int y, int w, int h, Draw::DataFormat format, void *pixels, int pixelStride) override;
+	void DiscardAsyncReadbacks() override {
+		renderManager_.DiscardAsyncReadbacks();
+	}
+	void BeginGPUTimer(const char *name) override {
+		renderManager_.BeginGPUTimer(name);
+	}
+	void EndGPUTimer() override {
+		renderManager_.EndGPUTimer();
+	}
+	float GetGPUFrameTime() const override {
+		return renderManager_.GetGPUFrameTime();
+	}
 
 	// These functions should be self explanatory.
 	void BindFramebufferAsRenderTarget(Framebuffer *fbo, const RenderPassInfo &rp) override;
@@ -1241,6 +1254,9 @@ std::vector<std::string> VKContext::GetFeatureList() const {
 	AddFeature(features, "multiDrawIndirect", available.multiDrawIndirect, enabled.multiDrawIndirect);
 
 	features.push_back(std::string("Preferred depth buffer format: ") + VulkanFormatToString(vulkan_->GetDeviceInfo().preferredDepthStencilFormat));
+	features.push_back(std::string("Present mode: ") + PresentModeString(vulkan_->GetPresentMode()));
+	features.push_back(StringFromFormat("Swapchain images: %d", (int)vulkan_->GetSwapchainImageCount()));
+	features.push_back(std::string("Surface transform: ") + SurfaceTransformString(vulkan_->GetSurfaceCapabilities().currentTransform) + ", pre-transform: " + SurfaceTransformString(vulkan_->GetPreTransform()));
 
 	// Also list texture formats and their properties.
 	for (int i = VK_FORMAT_BEGIN_RANGE; i <= VK_FORMAT_END_RANGE; i++) {
@@ -1316,7 +1332,8 @@ class VKFramebuffer : public Framebuffer {
 
 Framebuffer *VKContext::CreateFramebuffer(const FramebufferDesc &desc) {
 	VkCommandBuffer cmd = renderManager_.GetInitCmd();
-	VKRFramebuffer *vkrfb = new VKRFramebuffer(vulkan_, cmd, renderManager_.GetFramebufferRenderPass(), desc.width, desc.height);
+	// Framebuffers that don't ask for depth still need one for the render pass, but nothing will read it.
+	VKRFramebuffer *vkrfb = new VKRFramebuffer(vulkan_, cmd, renderManager_.GetFramebufferRenderPass(), desc.width, desc.height, !desc.z_stencil);
 	return new VKFramebuffer(vkrfb);
 }
 
@@ -1356,6 +1373,13 @@ bool VKContext::CopyFramebufferToMemorySync(Framebuffer *srcfb, int channelBits,
 	return renderManager_.CopyFramebufferToMemorySync(src ? src->GetFB() : nullptr, aspectMask, x, y, w, h, format, (uint8_t *)pixels, pixelStride);
 }
 
+bool VKContext::CopyFramebufferToMemoryAsync(Framebuffer *srcfb, int channelBits, int x, int y, int w, int h, Draw::DataFormat format, void *pixels, int pixelStride) {
+	VKFramebuffer *src = (VKFramebuffer *)srcfb;
+	if (!src || channelBits != FBChannel::FB_COLOR_BIT)
+		return false;
+	return renderManager_.CopyFramebufferToMemoryAsync(src->GetFB(), VK_IMAGE_ASPECT_COLOR_BIT, x, y, w, h, format, (uint8_t *)pixels, pixelStride);
+}
+
 void VKContext::BindFramebufferAsRenderTarget(Framebuffer *fbo, const RenderPassInfo &rp) {
 	VKFramebuffer *fb = (VKFramebuffer *)fbo;
 	VKRRenderPassAction color = (VKRRenderPassAction)rp.color;
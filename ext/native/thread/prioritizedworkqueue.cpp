@@ -20,7 +20,7 @@ void PrioritizedWorkQueue::Add(PrioritizedWorkQueueItem *item) {
 void PrioritizedWorkQueue::Stop() {
 	std::lock_guard<std::mutex> guard(mutex_);
 	done_ = true;
-	notEmpty_.notify_one();
+	notEmpty_.notify_all();
 }
 
 void PrioritizedWorkQueue::Flush() {
@@ -56,60 +56,76 @@ bool PrioritizedWorkQueue::WaitUntilDone(bool all) {
 
 void PrioritizedWorkQueue::NotifyDrain() {
 	std::lock_guard<std::mutex> guard(drainMutex_);
-	drain_.notify_one();
+	drain_.notify_all();
 }
 
 bool PrioritizedWorkQueue::AllItemsDone() {
 	std::lock_guard<std::mutex> guard(mutex_);
-	return queue_.empty() && !working_;
+	return queue_.empty() && working_ == 0;
 }
 
 // The worker should simply call this in a loop. Will block when appropriate.
 PrioritizedWorkQueueItem *PrioritizedWorkQueue::Pop() {
+	std::vector<PrioritizedWorkQueueItem *> canceled;
+	PrioritizedWorkQueueItem *poppedItem = nullptr;
 	{
-		std::lock_guard<std::mutex> guard(mutex_);
-		working_ = false;  // The thread only calls Pop if it's done.
-	}
-
-	// Important: make sure mutex_ is not locked while draining.
-	NotifyDrain();
-
-	std::unique_lock<std::mutex> guard(mutex_);
-	if (done_) {
-		return 0;
-	}
-
-	while (queue_.empty()) {
-		notEmpty_.wait(guard);
+		std::unique_lock<std::mutex> guard(mutex_);
 		if (done_) {
 			return 0;
 		}
-	}
 
-	// Find the top priority item (lowest value).
-	float best_prio = std::numeric_limits<float>::infinity();
-	std::vector<PrioritizedWorkQueueItem *>::iterator best = queue_.end();
-	for (auto iter = queue_.begin(); iter != queue_.end(); ++iter) {
-		if ((*iter)->priority() < best_prio) {
-			best = iter;
-			best_prio = (*iter)->priority();
+		while (queue_.empty()) {
+			notEmpty_.wait(guard);
+			if (done_) {
+				return 0;
+			}
+		}
+
+		// Find the top priority item (lowest value), dropping canceled ones on the way.
+		float best_prio = std::numeric_limits<float>::infinity();
+		size_t best = queue_.size();
+		for (size_t i = 0; i < queue_.size(); ) {
+			if (queue_[i]->canceled()) {
+				canceled.push_back(queue_[i]);
+				queue_[i] = queue_.back();
+				queue_.pop_back();
+				continue;
+			}
+			float prio = queue_[i]->priority();
+			if (best >= i || prio < best_prio) {
+				best = i;
+				best_prio = prio;
+			}
+			++i;
+		}
+
+		// If everything was canceled, we'll return null and the worker will just call again.
+		if (best < queue_.size()) {
+			poppedItem = queue_[best];
+			queue_.erase(queue_.begin() + best);
+			working_++;  // This will be worked on.
 		}
 	}
 
-	if (best != queue_.end()) {
-		PrioritizedWorkQueueItem *poppedItem = *best;
-		queue_.erase(best);
-		working_ = true;  // This will be worked on.
-		return poppedItem;
-	} else {
-		// Not really sure how this can happen, but let's be safe.
-		return 0;
+	// Outside the lock, in case the items do anything interesting on delete.
+	for (PrioritizedWorkQueueItem *item : canceled) {
+		delete item;
 	}
+	if (!canceled.empty()) {
+		NotifyDrain();
+	}
+	return poppedItem;
 }
 
-// TODO: This feels ugly. Revisit later.
+void PrioritizedWorkQueue::Finish() {
+	{
+		std::lock_guard<std::mutex> guard(mutex_);
+		working_--;
+	}
 
-static std::thread *workThread;
+	// Important: make sure mutex_ is not locked while draining.
+	NotifyDrain();
+}
 
 static void threadfunc(PrioritizedWorkQueue *wq) {
 	setCurrentThreadName("PrioQueue");
@@ -121,19 +137,21 @@ static void threadfunc(PrioritizedWorkQueue *wq) {
 		} else {
 			item->run();
 			delete item;
+			wq->Finish();
 		}
 	}
 }
 
-void ProcessWorkQueueOnThreadWhile(PrioritizedWorkQueue *wq) {
-	workThread = new std::thread([=](){threadfunc(wq);});
+void ProcessWorkQueueOnThreadWhile(PrioritizedWorkQueue *wq, int numThreads) {
+	for (int i = 0; i < numThreads; ++i) {
+		wq->threads_.push_back(std::thread([=](){threadfunc(wq);}));
+	}
 }
 
 void StopProcessingWorkQueue(PrioritizedWorkQueue *wq) {
 	wq->Stop();
-	if (workThread) {
-		workThread->join();
-		delete workThread;
+	for (std::thread &thread : wq->threads_) {
+		thread.join();
 	}
-	workThread = nullptr;
+	wq->threads_.clear();
 }
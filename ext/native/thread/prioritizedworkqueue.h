@@ -3,6 +3,7 @@
 #include <vector>
 #include <limits>
 #include <mutex>
+#include <thread>
 #include <condition_variable>
 
 #include "base/basictypes.h"
@@ -17,6 +18,8 @@ class PrioritizedWorkQueueItem {
 	virtual ~PrioritizedWorkQueueItem() {}
 	virtual void run() = 0;
 	virtual float priority() = 0;  // Low priority value = high priority!
+	// Checked before running, a canceled item is just deleted.  Also called a lot.
+	virtual bool canceled() { return false; }
 
 private:
 	DISALLOW_COPY_AND_ASSIGN(PrioritizedWorkQueueItem);
@@ -24,13 +27,15 @@ class PrioritizedWorkQueueItem {
 
 class PrioritizedWorkQueue {
 public:
-	PrioritizedWorkQueue() : done_(false), working_(false) {}
+	PrioritizedWorkQueue() : done_(false), working_(0) {}
 	~PrioritizedWorkQueue();
 	// Takes ownership.
 	void Add(PrioritizedWorkQueueItem *item);
 
-	// The worker should simply call this in a loop. Will block when appropriate.
+	// The worker should simply call this in a loop, and Finish() after running each item.
+	// Will block when appropriate.
 	PrioritizedWorkQueueItem *Pop();
+	void Finish();
 
 	void Flush();
 	bool Done() { return done_; }
@@ -38,7 +43,7 @@ class PrioritizedWorkQueue {
 	bool WaitUntilDone(bool all = true);
 
 	bool IsWorking() {
-		return working_;
+		return working_ != 0;
 	}
 
 private:
@@ -46,19 +51,24 @@ class PrioritizedWorkQueue {
 	bool AllItemsDone();
 
 	bool done_;
-	bool working_;
+	// Number of items being run right now.
+	int working_;
 	std::mutex mutex_;
 	std::mutex drainMutex_;
 	std::condition_variable notEmpty_;
 	std::condition_variable drain_;
 
 	std::vector<PrioritizedWorkQueueItem *> queue_;
+	std::vector<std::thread> threads_;
+
+	friend void ProcessWorkQueueOnThreadWhile(PrioritizedWorkQueue *wq, int numThreads);
+	friend void StopProcessingWorkQueue(PrioritizedWorkQueue *wq);
 
 	DISALLOW_COPY_AND_ASSIGN(PrioritizedWorkQueue);
 };
 
 
-// Starts up a thread that keeps trying to run this workqueue.
-// TODO: This feels ugly. Revisit later.
-void ProcessWorkQueueOnThreadWhile(PrioritizedWorkQueue *wq);
+// Starts up threads that keep trying to run this workqueue.  Items may run in parallel
+// when numThreads > 1, which also bounds how many are in progress at once.
+void ProcessWorkQueueOnThreadWhile(PrioritizedWorkQueue *wq, int numThreads = 1);
 void StopProcessingWorkQueue(PrioritizedWorkQueue *wq);
@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <cstdint>
+
 #include "base/logging.h"
 #include "thread/threadpool.h"
 #include "thread/threadutil.h"
@@ -48,39 +51,12 @@ void WorkerThread::WorkFunc() {
 	}
 }
 
-LoopWorkerThread::LoopWorkerThread() : WorkerThread(true) {
-	thread.reset(new std::thread(std::bind(&LoopWorkerThread::WorkFunc, this)));
-	while (!started) { };
-}
-
-void LoopWorkerThread::Process(const std::function<void(int, int)> &work, int start, int end) {
-	std::lock_guard<std::mutex> guard(mutex);
-	work_ = work;
-	start_ = start;
-	end_ = end;
-	jobsTarget = jobsDone + 1;
-	signal.notify_one();
-}
-
-void LoopWorkerThread::WorkFunc() {
-	setCurrentThreadName("LoopWorker");
-	std::unique_lock<std::mutex> guard(mutex);
-	started = true;
-	while (active) {
-		signal.wait(guard);
-		if (active) {
-			work_(start_, end_);
-			doneMutex.lock();
-			done.notify_one();
-			jobsDone++;
-			doneMutex.unlock();
-		}
-	}
-}
-
 ///////////////////////////// ThreadPool
 
-ThreadPool::ThreadPool(int numThreads) : workersStarted(false) {
+// More slices than threads, so one slow slice doesn't hold up the whole loop.
+static const int LOOP_SLICES_PER_THREAD = 4;
+
+ThreadPool::ThreadPool(int numThreads) : workersStarted_(false), queued_(0), idle_(0), waiting_(0), active_(true) {
 	if (numThreads <= 0) {
 		numThreads_ = 1;
 		ILOG("ThreadPool: Bad number of threads %i", numThreads);
@@ -90,38 +66,188 @@ ThreadPool::ThreadPool(int numThreads) : workersStarted(false) {
 	} else {
 		numThreads_ = numThreads;
 	}
+
+	for (int i = 0; i < numThreads_; ++i) {
+		queues_.push_back(std::unique_ptr<WorkQueue>(new WorkQueue()));
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> guard(sleepLock_);
+		active_ = false;
+		wake_.notify_all();
+	}
+	for (std::thread &worker : workers_) {
+		worker.join();
+	}
 }
 
 void ThreadPool::StartWorkers() {
-	if (!workersStarted) {
-		for(int i = 0; i < numThreads_; ++i) {
-			workers.push_back(std::make_shared<LoopWorkerThread>());
+	if (workersStarted_) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> guard(startLock_);
+	if (!workersStarted_) {
+		for (int i = 0; i < numThreads_ - 1; ++i) {
+			workers_.push_back(std::thread(std::bind(&ThreadPool::WorkFunc, this, i)));
+		}
+		for (std::thread &worker : workers_) {
+			workerIds_.push_back(worker.get_id());
 		}
-		workersStarted = true;
+		workersStarted_ = true;
 	}
 }
 
-void ThreadPool::ParallelLoop(const std::function<void(int,int)> &loop, int lower, int upper) {
-	int range = upper - lower;
-	if (range >= numThreads_ * 2) { // don't parallelize tiny loops (this could be better, maybe add optional parameter that estimates work per iteration)
-		std::lock_guard<std::mutex> guard(mutex);
-		StartWorkers();
-
-		// could do slightly better load balancing for the generic case, 
-		// but doesn't matter since all our loops are power of 2
-		int chunk = range / numThreads_;
-		int s = lower;
-		for (int i = 0; i < numThreads_ - 1; ++i) {
-			workers[i]->Process(loop, s, s+chunk);
-			s+=chunk;
+void ThreadPool::WorkFunc(int index) {
+	setCurrentThreadName("PoolWorker");
+	{
+		// Wait for StartWorkers to finish filling in workerIds_.
+		std::lock_guard<std::mutex> guard(startLock_);
+	}
+
+	while (true) {
+		if (RunOneTask(index)) {
+			continue;
 		}
-		// This is the final chunk.
-		loop(s, upper);
-		for (int i = 0; i < numThreads_ - 1; ++i) {
-			workers[i]->WaitForCompletion();
+
+		std::unique_lock<std::mutex> guard(sleepLock_);
+		idle_++;
+		wake_.wait(guard, [&] { return queued_ > 0 || !active_; });
+		idle_--;
+		if (!active_) {
+			break;
 		}
-	} else {
-		loop(lower, upper);
 	}
 }
 
+int ThreadPool::QueueIndex() const {
+	std::thread::id id = std::this_thread::get_id();
+	for (size_t i = 0; i < workerIds_.size(); ++i) {
+		if (workerIds_[i] == id) {
+			return (int)i;
+		}
+	}
+	return numThreads_ - 1;
+}
+
+bool ThreadPool::PopTask(int index, Task *task) {
+	if (queued_ == 0) {
+		return false;
+	}
+
+	for (int p = 0; p < (int)TaskPriority::COUNT; ++p) {
+		for (int i = 0; i < numThreads_; ++i) {
+			WorkQueue &queue = *queues_[(index + i) % numThreads_];
+			std::lock_guard<std::mutex> guard(queue.lock);
+			std::deque<Task> &tasks = queue.tasks[p];
+			if (tasks.empty()) {
+				continue;
+			}
+
+			// Our own newest task, or the oldest of someone else's.
+			if (i == 0) {
+				*task = std::move(tasks.back());
+				tasks.pop_back();
+			} else {
+				*task = std::move(tasks.front());
+				tasks.pop_front();
+			}
+			queued_--;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool ThreadPool::RunOneTask(int index) {
+	Task task;
+	if (!PopTask(index, &task)) {
+		return false;
+	}
+
+	task.func();
+	FinishTask(task.group);
+	return true;
+}
+
+void ThreadPool::FinishTask(TaskGroup *group) {
+	if (--group->pending_ == 0 && waiting_ > 0) {
+		std::lock_guard<std::mutex> guard(sleepLock_);
+		groupDone_.notify_all();
+	}
+}
+
+void ThreadPool::Run(TaskGroup &group, const std::function<void()> &task, TaskPriority priority) {
+	if (numThreads_ <= 1) {
+		task();
+		return;
+	}
+	StartWorkers();
+
+	group.pending_++;
+	WorkQueue &queue = *queues_[QueueIndex()];
+	{
+		std::lock_guard<std::mutex> guard(queue.lock);
+		queue.tasks[(int)priority].push_back(Task{ task, &group });
+	}
+	queued_++;
+
+	// Only take the lock if someone might be asleep.
+	if (idle_ > 0 || waiting_ > 0) {
+		std::lock_guard<std::mutex> guard(sleepLock_);
+		wake_.notify_one();
+		if (waiting_ > 0) {
+			groupDone_.notify_all();
+		}
+	}
+}
+
+void ThreadPool::Wait(TaskGroup &group) {
+	int index = QueueIndex();
+	while (!group.Done()) {
+		if (RunOneTask(index)) {
+			continue;
+		}
+
+		// The rest of the group is running on other threads, sleep until it's done or there's more to do.
+		std::unique_lock<std::mutex> guard(sleepLock_);
+		waiting_++;
+		groupDone_.wait(guard, [&] { return group.Done() || queued_ > 0; });
+		waiting_--;
+	}
+}
+
+void ThreadPool::ParallelLoop(const std::function<void(int,int)> &loop, int lower, int upper, int minGrain) {
+	int range = upper - lower;
+	if (minGrain < 1) {
+		minGrain = 1;
+	}
+	int slices = std::min(range / minGrain, numThreads_ * LOOP_SLICES_PER_THREAD);
+	if (numThreads_ <= 1 || slices < 2) {
+		if (range > 0) {
+			loop(lower, upper);
+		}
+		return;
+	}
+
+	// Each thread takes the next slice when it's done with one, rather than getting a fixed share.
+	std::atomic<int> nextSlice(0);
+	auto runSlices = [&]() {
+		int s;
+		while ((s = nextSlice++) < slices) {
+			int start = lower + (int)((int64_t)range * s / slices);
+			int end = lower + (int)((int64_t)range * (s + 1) / slices);
+			loop(start, end);
+		}
+	};
+
+	TaskGroup group;
+	int helpers = std::min(slices, numThreads_) - 1;
+	for (int i = 0; i < helpers; ++i) {
+		Run(group, runSlices, TaskPriority::HIGH);
+	}
+	runSlices();
+	Wait(group);
+}
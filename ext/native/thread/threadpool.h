@@ -1,6 +1,8 @@
 #pragma once
 
+#include <atomic>
 #include <functional>
+#include <deque>
 #include <memory>
 #include <vector>
 #include <thread>
@@ -38,39 +40,87 @@ class WorkerThread {
 	void operator =(const WorkerThread &other);
 };
 
-class LoopWorkerThread : public WorkerThread {
+enum class TaskPriority {
+	// Someone is waiting on the result, like the slices of a parallel loop.
+	HIGH,
+	NORMAL,
+	COUNT,
+};
+
+// Counts outstanding tasks, so they can be joined.  Must outlive the tasks added to it.
+class TaskGroup {
 public:
-	LoopWorkerThread();
-	void Process(const std::function<void(int, int)> &work, int start, int end);
+	TaskGroup() : pending_(0) {}
 
-protected:
-	virtual void WorkFunc();
+	bool Done() const {
+		return pending_ == 0;
+	}
 
 private:
-	int start_;
-	int end_;
-	std::function<void(int, int)> work_; // the work to be done by this thread
+	std::atomic<int> pending_;
+
+	friend class ThreadPool;
 };
 
-// A thread pool manages a set of worker threads, and allows the execution of parallel loops on them
-// individual parallel loops are fully sequentialized to simplify synchronization, which should not 
-// be a problem as they should each use the entire system
+// A work stealing thread pool.  Each worker has its own queue, and takes the newest task from it
+// (which keeps nested work close in cache), or steals the oldest from another when it runs dry.
+// Threads waiting on a TaskGroup run queued tasks meanwhile, so loops and tasks can nest freely,
+// and several threads may run loops at once.
 class ThreadPool {
 public:
+	// The calling thread counts as one, so this starts numThreads - 1 workers.
 	ThreadPool(int numThreads);
-	// don't need a destructor, "workers" is cleared on delete, 
-	// leading to the stopping and joining of all worker threads (RAII and all that)
+	// Tasks still queued when the pool is deleted are dropped, so wait on any groups first.
+	~ThreadPool();
+
+	// Runs slices of [lower, upper) and returns once they're all done.  Slices are at least
+	// minGrain long, and are handed out as threads become free, so uneven work balances itself.
+	void ParallelLoop(const std::function<void(int,int)> &loop, int lower, int upper, int minGrain = 1);
 
-	void ParallelLoop(const std::function<void(int,int)> &loop, int lower, int upper);
+	// Queues a task, counting it in group.  Use Wait() to join.
+	void Run(TaskGroup &group, const std::function<void()> &task, TaskPriority priority = TaskPriority::NORMAL);
+	// Runs queued tasks (not only this group's) until the group is done.
+	void Wait(TaskGroup &group);
+
+	int NumThreads() const {
+		return numThreads_;
+	}
 
 private:
-	int numThreads_;
-	std::vector<std::shared_ptr<LoopWorkerThread>> workers;
-	std::mutex mutex; // used to sequentialize loop execution
+	struct Task {
+		std::function<void()> func;
+		TaskGroup *group;
+	};
+	struct WorkQueue {
+		std::mutex lock;
+		std::deque<Task> tasks[(int)TaskPriority::COUNT];
+	};
 
-	bool workersStarted;
 	void StartWorkers();
-	
+	void WorkFunc(int index);
+	// Index of the calling thread's queue.  Threads not in the pool share the last one.
+	int QueueIndex() const;
+	bool PopTask(int index, Task *task);
+	bool RunOneTask(int index);
+	void FinishTask(TaskGroup *group);
+
+	int numThreads_;
+	std::vector<std::thread> workers_;
+	std::vector<std::thread::id> workerIds_;
+	std::vector<std::unique_ptr<WorkQueue>> queues_;
+	std::mutex startLock_;
+	std::atomic<bool> workersStarted_;
+
+	// Workers sleep on wake_ when there's nothing queued anywhere.
+	std::mutex sleepLock_;
+	std::condition_variable wake_;
+	std::condition_variable groupDone_;
+	std::atomic<int> queued_;
+	// Sleeping workers, and threads sleeping in Wait().
+	std::atomic<int> idle_;
+	std::atomic<int> waiting_;
+	bool active_;
+
 	ThreadPool(const ThreadPool& other); // prevent copies
 	void operator =(const ThreadPool &other);
 };
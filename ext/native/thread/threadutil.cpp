@@ -16,6 +16,13 @@
 #include <pthread.h>
 #endif
 
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
 #ifdef TLS_SUPPORTED
 static __THREAD const char *curThreadName;
 #endif
@@ -112,6 +119,20 @@ void setCurrentThreadName(const char* threadName) {
 #endif
 }
 
+void setCurrentThreadBackgroundIO() {
+#ifdef _WIN32
+	// Also lowers the I/O and memory priority of the thread.
+	SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+#elif defined(__linux__) && defined(SYS_ioprio_set)
+	// IOPRIO_WHO_PROCESS with 0 applies to the calling thread.  IOPRIO_CLASS_IDLE is 3.
+	const int IOPRIO_WHO_PROCESS = 1;
+	const int IOPRIO_CLASS_SHIFT = 13;
+	syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, 3 << IOPRIO_CLASS_SHIFT);
+#elif defined(__APPLE__) && defined(IOPOL_TYPE_DISK)
+	setiopolicy_np(IOPOL_TYPE_DISK, IOPOL_SCOPE_THREAD, IOPOL_THROTTLE);
+#endif
+}
+
 void AssertCurrentThreadName(const char *threadName) {
 #ifdef TLS_SUPPORTED
 	if (strcmp(curThreadName, threadName) != 0) {
@@ -3,4 +3,8 @@
 // Note that name must be a global string that lives until the end of the process,
 // for assertThreadName to work.
 void setCurrentThreadName(const char *threadName);
-void AssertCurrentThreadName(const char *threadName);
\ No newline at end of file
+void AssertCurrentThreadName(const char *threadName);
+
+// Drops the calling thread to background CPU and disk priority, where the OS supports it.
+// Meant for long bulk reads (like hashing a whole disc) that shouldn't stall the emulator.
+void setCurrentThreadBackgroundIO();
@@ -52,6 +52,20 @@ void UIContext::BeginNoTex() {
 	UIBegin(ui_pipeline_notex_);
 }
 
+void UIContext::EndFrameStats() {
+	lastRenderTime_ = renderTime_;
+	renderTime_ = 0.0;
+	lastDrawCalls_ = 0;
+	if (uidrawbuffer_) {
+		lastDrawCalls_ += uidrawbuffer_->DrawCallCount();
+		uidrawbuffer_->ResetDrawCallCount();
+	}
+	if (uidrawbufferTop_) {
+		lastDrawCalls_ += uidrawbufferTop_->DrawCallCount();
+		uidrawbufferTop_->ResetDrawCallCount();
+	}
+}
+
 void UIContext::RebindTexture() const {
 	draw_->BindTexture(0, uitexture_->GetTexture());
 }
@@ -165,14 +179,24 @@ void UIContext::DrawText(const char *str, float x, float y, uint32_t color, int
 	} else {
 		textDrawer_->SetFontScale(fontScaleX_, fontScaleY_);
 		textDrawer_->DrawString(*Draw(), str, x, y, color, align);
+		textDrawer_->FlushStrings(*Draw());
 		RebindTexture();
 	}
 }
 
 void UIContext::DrawTextShadow(const char *str, float x, float y, uint32_t color, int align) {
 	uint32_t alpha = (color >> 1) & 0xFF000000;
-	DrawText(str, x + 2, y + 2, alpha, align);
-	DrawText(str, x, y, color, align);
+	if (!textDrawer_ || (align & FLAG_DYNAMIC_ASCII)) {
+		DrawText(str, x + 2, y + 2, alpha, align);
+		DrawText(str, x, y, color, align);
+	} else {
+		// Both passes use the same string texture, so they go out as one draw.
+		textDrawer_->SetFontScale(fontScaleX_, fontScaleY_);
+		textDrawer_->DrawString(*Draw(), str, x + 2, y + 2, alpha, align);
+		textDrawer_->DrawString(*Draw(), str, x, y, color, align);
+		textDrawer_->FlushStrings(*Draw());
+		RebindTexture();
+	}
 }
 
 void UIContext::DrawTextRect(const char *str, const Bounds &bounds, uint32_t color, int align) {
@@ -186,6 +210,7 @@ void UIContext::DrawTextRect(const char *str, const Bounds &bounds, uint32_t col
 		rounded.x = floorf(rounded.x);
 		rounded.y = floorf(rounded.y);
 		textDrawer_->DrawStringRect(*Draw(), str, rounded, color, align);
+		textDrawer_->FlushStrings(*Draw());
 		RebindTexture();
 	}
 }
@@ -56,6 +56,12 @@ class UIContext {
 
 	void RebindTexture() const;
 
+	// UI rendering cost is accumulated over a frame and latched by EndFrameStats() for display.
+	void AddRenderTime(double seconds) { renderTime_ += seconds; }
+	void EndFrameStats();
+	double LastRenderTime() const { return lastRenderTime_; }
+	int LastDrawCalls() const { return lastDrawCalls_; }
+
 	// TODO: Support transformed bounds using stencil
 	void PushScissor(const Bounds &bounds);
 	void PopScissor();
@@ -110,4 +116,8 @@ class UIContext {
 
 	std::vector<Bounds> scissorStack_;
 	std::vector<UITransform> transformStack_;
+
+	double renderTime_ = 0.0;
+	double lastRenderTime_ = 0.0;
+	int lastDrawCalls_ = 0;
 };
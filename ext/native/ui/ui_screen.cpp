@@ -1,6 +1,7 @@
 #include <algorithm>
 #include <map>
 #include "base/display.h"
+#include "base/timeutil.h"
 #include "input/input_state.h"
 #include "input/keycodes.h"
 #include "math/curves.h"
@@ -105,6 +106,7 @@ void UIScreen::render() {
 	DoRecreateViews();
 
 	if (root_) {
+		double startTime = real_time_now();
 		UIContext *uiContext = screenManager()->getUIContext();
 		UI::LayoutViewHierarchy(*uiContext, root_);
 
@@ -117,6 +119,7 @@ void UIScreen::render() {
 		uiContext->Flush();
 
 		uiContext->PopTransform();
+		uiContext->AddRenderTime(real_time_now() - startTime);
 	}
 }
 
@@ -176,7 +176,12 @@ std::string ExpectedFromFilename(const std::string &bootFilename)
 
 std::string ExpectedScreenshotFromFilename(const std::string &bootFilename)
 {
-	return bootFilename.substr(0, bootFilename.length() - 4) + ".expected.bmp";
+	// Works for .ppdmp GE dumps as well as .prx/.elf tests.
+	size_t dot = bootFilename.find_last_of('.');
+	size_t slash = bootFilename.find_last_of("/\\");
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+		return bootFilename + ".expected.bmp";
+	return bootFilename.substr(0, dot) + ".expected.bmp";
 }
 
 static std::string ChopFront(std::string s, std::string front)
@@ -2,11 +2,23 @@
 // See headless.txt.
 // To build on non-windows systems, just run CMake in the SDL directory, it will build both a normal ppsspp and the headless version.
 
+#include <algorithm>
 #include <cstdio>
 #include <cstdlib>
+#include <functional>
 #include <limits>
+#include <thread>
 
+#if !defined(_WIN32)
+#include <cerrno>
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "file/file_util.h"
 #include "file/zip_read.h"
+#include "json/json_writer.h"
 #include "profiler/profiler.h"
 #include "Common/FileUtil.h"
 #include "Common/GraphicsContext.h"
@@ -14,12 +26,21 @@
 #include "Core/Core.h"
 #include "Core/CoreTiming.h"
 #include "Core/System.h"
+#include "Core/Debugger/SamplingProfiler.h"
+#include "Core/Debugger/StatsServer.h"
+#include "Core/HLE/HLE.h"
 #include "Core/HLE/sceUtility.h"
+#include "Core/MIPS/JitCommon/JitBlockCache.h"
+#include "Core/MIPS/JitCommon/JitCommon.h"
 #include "Core/Host.h"
 #include "Core/SaveState.h"
+#include "GPU/GPU.h"
+#include "GPU/Common/GPUDebugInterface.h"
+#include "GPU/Debugger/Record.h"
 #include "Log.h"
 #include "LogManager.h"
 #include "base/NativeApp.h"
+#include "base/stringutil.h"
 #include "base/timeutil.h"
 
 #include "Compare.h"
@@ -100,17 +121,83 @@ int printUsage(const char *progname, const char *reason)
 	}
 #endif
 	fprintf(stderr, "  --timeout=SECONDS     abort test it if takes longer than SECONDS\n");
+	fprintf(stderr, "  --report=FILE         write per-syscall and profiler timings to FILE\n");
+	fprintf(stderr, "  --bench[=FRAMES]      run each file (game, or .ppdmp GE dump, or directory of dumps)\n");
+	fprintf(stderr, "                        for FRAMES frames, and print ms/frame and screenshot diffs\n");
+	fprintf(stderr, "  --bench-json=FILE     with --bench, also write fps, frame times and stats as JSON\n");
+	fprintf(stderr, "  --draw-report=FILE    with --bench, append the slowest draws of each dump to FILE\n");
+	fprintf(stderr, "  --guest-profile=FILE  sample the emulated pc and write the hottest functions to FILE\n");
+#ifdef USE_PROFILER
+	fprintf(stderr, "  --trace=FILE          write a timeline trace (Chrome trace JSON) to FILE\n");
+#endif
 
 	fprintf(stderr, "  -v, --verbose         show the full passed/failed result\n");
 	fprintf(stderr, "  -i                    use the interpreter\n");
 	fprintf(stderr, "  --ir                  use ir interpreter\n");
 	fprintf(stderr, "  -j                    use jit (default)\n");
 	fprintf(stderr, "  -c, --compare         compare with output in file.expected\n");
+	fprintf(stderr, "  --workers[=N]         run up to N tests at once in forked processes (default: all cores)\n");
 	fprintf(stderr, "\nSee headless.txt for details.\n");
 
 	return 1;
 }
 
+static const char *reportFilename = nullptr;
+static bool reportStarted = false;
+static const char *drawReportFilename = nullptr;
+static const char *guestProfileFilename = nullptr;
+static JsonWriter *benchJson = nullptr;
+static bool guestProfileStarted = false;
+
+static void WriteGuestProfile(const std::string &testName) {
+	// One report per test, in the same file.
+	FILE *f = File::OpenCFile(guestProfileFilename, guestProfileStarted ? "a" : "w");
+	if (!f) {
+		fprintf(stderr, "Unable to write guest profile to %s\n", guestProfileFilename);
+		return;
+	}
+	fprintf(f, "== %s ==\n", testName.c_str());
+	fclose(f);
+	guestProfileStarted = true;
+
+	SamplingProfiler::Stop();
+	SamplingProfiler::WriteReport(guestProfileFilename);
+}
+
+static void WriteReport(const std::string &testName, double hostSeconds) {
+	FILE *f = File::OpenCFile(reportFilename, reportStarted ? "a" : "w");
+	if (!f) {
+		fprintf(stderr, "Unable to write report to %s\n", reportFilename);
+		return;
+	}
+	reportStarted = true;
+
+	fprintf(f, "== %s ==\n", testName.c_str());
+	fprintf(f, "Emulated: %lld cycles (%lld idle), host: %0.3f s, %d flips\n", (long long)CoreTiming::GetTicks(), (long long)CoreTiming::GetIdleTicks(), hostSeconds, gpuStats.numFlips);
+	fprintf(f, "Display list processing: %0.3f ms\n", gpuStats.secondsProcessingDisplayListsTotal * 1000.0);
+
+	fprintf(f, "\n%-48s %10s %12s %14s\n", "HLE function", "calls", "host ms", "cycles eaten");
+	for (const HLESyscallStatsEntry &e : hleGetSyscallStats()) {
+		std::string name = std::string(e.module) + "::" + e.name;
+		fprintf(f, "%-48s %10u %12.3f %14lld\n", name.c_str(), e.calls, e.seconds * 1000.0, (long long)e.cycles);
+	}
+
+#ifdef USE_PROFILER
+	// Covers jit compiles ("jitc"), texture decoding ("decodetex"), the GPU loop, etc.
+	fprintf(f, "\n%-48s %10s %12s\n", "Profiler category", "calls", "host ms");
+	for (int i = 0; i < Profiler_GetNumCategories(); ++i) {
+		double seconds;
+		int64_t count;
+		Profiler_GetTotal(i, &seconds, &count);
+		fprintf(f, "%-48s %10lld %12.3f\n", Profiler_GetCategoryName(i), (long long)count, seconds * 1000.0);
+	}
+#else
+	fprintf(f, "\nBuild with USE_PROFILER for jit compile, GPU and texture decode timings.\n");
+#endif
+	fprintf(f, "\n");
+	fclose(f);
+}
+
 static HeadlessHost *getHost(GPUCore gpuCore) {
 	switch (gpuCore) {
 	case GPUCORE_NULL:
@@ -158,7 +245,11 @@ bool RunAutoTest(HeadlessHost *headlessHost, CoreParameter &coreParameter, bool
 	static double deadline;
 	deadline = time_now() + timeout;
 
-	Core_UpdateDebugStats(g_Config.bShowDebugStats || g_Config.bLogFrameDrops);
+	// Debug stats make syscalls and display lists track their time, for the report.
+	Core_UpdateDebugStats(g_Config.bShowDebugStats || g_Config.bLogFrameDrops || reportFilename != nullptr || StatsServerHasClients());
+	double hostStart = time_now_d();
+	if (guestProfileFilename)
+		SamplingProfiler::Start();
 
 	PSP_BeginHostFrame();
 	if (coreParameter.thin3d)
@@ -191,6 +282,11 @@ bool RunAutoTest(HeadlessHost *headlessHost, CoreParameter &coreParameter, bool
 	if (coreParameter.thin3d)
 		coreParameter.thin3d->EndFrame();
 
+	if (reportFilename)
+		WriteReport(coreParameter.fileToStart, time_now_d() - hostStart);
+	if (guestProfileFilename)
+		WriteGuestProfile(coreParameter.fileToStart);
+
 	PSP_Shutdown();
 
 	headlessHost->FlushDebugOutput();
@@ -203,6 +299,314 @@ bool RunAutoTest(HeadlessHost *headlessHost, CoreParameter &coreParameter, bool
 	return passed;
 }
 
+static std::string JsonEscape(const std::string &s) {
+	std::string escaped;
+	for (char c : s) {
+		if (c == '"' || c == '\\')
+			escaped += '\\';
+		escaped += c;
+	}
+	return escaped;
+}
+
+static double Percentile(const std::vector<double> &sorted, double p) {
+	if (sorted.empty())
+		return 0.0;
+	size_t i = std::min(sorted.size() - 1, (size_t)(p * sorted.size()));
+	return sorted[i];
+}
+
+// Runs a game or GE dump for a number of frames, printing timings and the difference from
+// its .expected.bmp, if there is one.  Returns false if it failed to run.
+static bool RunBenchmark(HeadlessHost *headlessHost, CoreParameter &coreParameter, int frames, double timeout)
+{
+	std::string error_string;
+	if (!PSP_Init(coreParameter, &error_string)) {
+		fprintf(stderr, "Failed to start %s. Error: %s\n", coreParameter.fileToStart.c_str(), error_string.c_str());
+		return false;
+	}
+
+	host->BootDone();
+
+	time_update();
+	double deadline = time_now_d() + timeout;
+	double startTime = 0.0;
+	int startFlip = 0;
+	bool started = false;
+	double lastFlipTime = 0.0;
+	int lastFlip = 0;
+	std::vector<double> frameTimes;
+#ifdef USE_PROFILER
+	std::vector<double> startCategoryTimes;
+#endif
+
+	PSP_BeginHostFrame();
+	if (coreParameter.thin3d)
+		coreParameter.thin3d->BeginFrame();
+
+	coreState = CORE_RUNNING;
+	while (coreState == CORE_RUNNING)
+	{
+		int blockTicks = usToCycles(1000000 / 60);
+		PSP_RunLoopFor(blockTicks);
+
+		if (coreState == CORE_NEXTFRAME) {
+			coreState = CORE_RUNNING;
+			headlessHost->SwapBuffers();
+		}
+		time_update();
+
+		// The first frame includes jit and shader compiles, so it's not timed.
+		if (!started && gpuStats.numFlips >= 1) {
+			started = true;
+			startFlip = gpuStats.numFlips;
+			startTime = time_now_d();
+			lastFlip = startFlip;
+			lastFlipTime = startTime;
+			// Same for the draw timings and stats.
+			if (drawReportFilename)
+				GPURecord::SetReplayTiming(true);
+			gpuStats.ResetFrame();
+#ifdef USE_PROFILER
+			for (int i = 0; i < Profiler_GetNumCategories(); ++i) {
+				double seconds;
+				int64_t count;
+				Profiler_GetTotal(i, &seconds, &count);
+				startCategoryTimes.push_back(seconds);
+			}
+#endif
+		} else if (started && gpuStats.numFlips != lastFlip) {
+			// Usually one flip per loop, split the time if there were more.
+			const int flips = gpuStats.numFlips - lastFlip;
+			for (int i = 0; i < flips; ++i)
+				frameTimes.push_back((time_now_d() - lastFlipTime) / flips);
+			lastFlip = gpuStats.numFlips;
+			lastFlipTime = time_now_d();
+		}
+		if (started && gpuStats.numFlips - startFlip >= frames)
+			Core_Stop();
+		if (time_now_d() > deadline) {
+			fprintf(stderr, "%s: timeout\n", coreParameter.fileToStart.c_str());
+			Core_Stop();
+		}
+	}
+
+	const int timedFrames = started ? gpuStats.numFlips - startFlip : 0;
+	const double seconds = started ? time_now_d() - startTime : 0.0;
+
+	// Grab the displayed frame before shutting down, for the comparison.
+	std::string diff = "-";
+	const std::string reference = ExpectedScreenshotFromFilename(coreParameter.fileToStart);
+	GPUDebugBuffer buffer;
+	if (File::Exists(reference) && gpuDebug && gpuDebug->GetCurrentFramebuffer(buffer, GPU_DBG_FRAMEBUF_DISPLAY)) {
+		const std::vector<u32> pixels = TranslateDebugBufferToCompare(&buffer, 512, 272);
+		std::string error;
+		double errors = CompareScreenshot(pixels, 512, 480, 272, reference, error);
+		if (errors < 0) {
+			fprintf(stderr, "%s", error.c_str());
+		} else {
+			char temp[64];
+			snprintf(temp, sizeof(temp), "%0.3f%%", errors * 100.0);
+			diff = temp;
+		}
+	}
+
+	if (benchJson) {
+		std::vector<double> sorted = frameTimes;
+		std::sort(sorted.begin(), sorted.end());
+
+		benchJson->pushDict(JsonEscape(GetTestName(coreParameter.fileToStart)).c_str());
+		benchJson->writeInt("frames", timedFrames);
+		benchJson->writeFloat("seconds", seconds);
+		benchJson->writeFloat("fps", seconds > 0.0 ? timedFrames / seconds : 0.0);
+		benchJson->pushDict("frame_ms");
+		benchJson->writeFloat("p50", Percentile(sorted, 0.50) * 1000.0);
+		benchJson->writeFloat("p90", Percentile(sorted, 0.90) * 1000.0);
+		benchJson->writeFloat("p99", Percentile(sorted, 0.99) * 1000.0);
+		benchJson->writeFloat("max", sorted.empty() ? 0.0 : sorted.back() * 1000.0);
+		benchJson->pop();
+
+		benchJson->pushDict("jit");
+		JitBlockCacheDebugInterface *blockCache = MIPSComp::jit ? MIPSComp::jit->GetBlockCacheDebugInterface() : nullptr;
+		benchJson->writeInt("blocks", blockCache ? blockCache->GetNumBlocks() : 0);
+		benchJson->pop();
+
+		benchJson->pushDict("textures");
+		benchJson->writeInt("decoded", gpuStats.numTexturesDecoded);
+		benchJson->writeInt("invalidations", gpuStats.numTextureInvalidations);
+		benchJson->writeInt("hashes_skipped", gpuStats.numTextureHashesSkipped);
+		benchJson->writeInt("switches", gpuStats.numTextureSwitches);
+		benchJson->pop();
+
+#ifdef USE_PROFILER
+		// Covers jit compile time ("jitc"), texture decoding, the GPU loop, etc.
+		benchJson->pushDict("profiler_ms");
+		for (int i = 0; i < Profiler_GetNumCategories(); ++i) {
+			double total;
+			int64_t count;
+			Profiler_GetTotal(i, &total, &count);
+			double before = i < (int)startCategoryTimes.size() ? startCategoryTimes[i] : 0.0;
+			benchJson->writeFloat(Profiler_GetCategoryName(i), (total - before) * 1000.0);
+		}
+		benchJson->pop();
+#endif
+
+		if (diff != "-")
+			benchJson->writeString("diff", diff.c_str());
+		benchJson->pop();
+	}
+
+	PSP_EndHostFrame();
+	if (coreParameter.thin3d)
+		coreParameter.thin3d->EndFrame();
+
+	if (reportFilename)
+		WriteReport(coreParameter.fileToStart, seconds);
+	if (drawReportFilename)
+		GPURecord::WriteReplayTimingReport(drawReportFilename, coreParameter.fileToStart, 50);
+
+	PSP_Shutdown();
+	headlessHost->FlushDebugOutput();
+
+	// Pixels are the 480x272 displayed per frame, so this is comparable across backends.
+	const double msPerFrame = timedFrames > 0 ? seconds * 1000.0 / timedFrames : 0.0;
+	const double mpixels = seconds > 0.0 ? (double)timedFrames * 480 * 272 / seconds / 1000000.0 : 0.0;
+	printf("%-40s %8d %10.3f %10.2f %10s\n", GetTestName(coreParameter.fileToStart).c_str(), timedFrames, msPerFrame, mpixels, diff.c_str());
+	return timedFrames > 0;
+}
+
+struct TestResults {
+	std::vector<std::string> passed;
+	std::vector<std::string> failed;
+	std::vector<std::pair<double, std::string>> times;
+};
+
+static void RecordTestResult(const std::string &filename, bool passed, double seconds, TestResults &results)
+{
+	// test.py -j parses these lines to merge results from several processes.
+	std::string testName = GetTestName(filename);
+	results.times.push_back(std::make_pair(seconds, testName));
+	if (passed)
+	{
+		results.passed.push_back(testName);
+		printf("  %s - passed! (%0.3f s)\n", testName.c_str(), seconds);
+	}
+	else
+	{
+		results.failed.push_back(testName);
+		printf("  %s - failed (%0.3f s)\n", testName.c_str(), seconds);
+	}
+}
+
+#if !defined(_WIN32)
+// Emulator state is global, so parallel tests each get a forked copy of this process instead.
+// Everything loaded so far (code, config, flash0 and assets in the VFS) stays shared copy-on-write,
+// while each child gets its own emulated memory and JIT code space when it boots its test.
+// The parent never boots a test itself here, so no worker threads (like the global pool) exist yet to lose in fork.
+static void RunAutoTestsForked(HeadlessHost *headlessHost, CoreParameter coreParameter, const std::vector<std::string> &testFilenames, int workers, bool autoCompare, bool verbose, double timeout, TestResults &results)
+{
+	struct RunningTest {
+		pid_t pid;
+		int outFd;
+		size_t index;
+		double start;
+		std::string output;
+	};
+	std::vector<RunningTest> running;
+	size_t next = 0;
+
+	// Otherwise, anything still buffered would be printed again by each child.
+	fflush(stdout);
+	fflush(stderr);
+
+	while (next < testFilenames.size() || !running.empty())
+	{
+		while (next < testFilenames.size() && (int)running.size() < workers)
+		{
+			int fds[2];
+			pid_t pid = -1;
+			if (pipe(fds) == 0)
+			{
+				pid = fork();
+				if (pid == 0)
+				{
+					// Collect all output, so each test's output prints together.
+					close(fds[0]);
+					dup2(fds[1], STDOUT_FILENO);
+					dup2(fds[1], STDERR_FILENO);
+					close(fds[1]);
+
+					coreParameter.fileToStart = testFilenames[next];
+					bool passed = RunAutoTest(headlessHost, coreParameter, autoCompare, verbose, timeout);
+					fflush(stdout);
+					fflush(stderr);
+					// Skip static destructors, the parent still owns everything shared.
+					_exit(passed ? 0 : 1);
+				}
+				close(fds[1]);
+				if (pid < 0)
+					close(fds[0]);
+			}
+
+			if (pid < 0)
+			{
+				fprintf(stderr, "Unable to start a process for %s\n", testFilenames[next].c_str());
+				if (autoCompare)
+					RecordTestResult(testFilenames[next], false, 0.0, results);
+			}
+			else
+			{
+				running.push_back(RunningTest{ pid, fds[0], next, time_now_d(), std::string() });
+			}
+			++next;
+		}
+
+		if (running.empty())
+			continue;
+
+		std::vector<pollfd> pollFds;
+		for (const RunningTest &test : running)
+			pollFds.push_back(pollfd{ test.outFd, POLLIN, 0 });
+		if (poll(&pollFds[0], (nfds_t)pollFds.size(), -1) < 0 && errno != EINTR)
+			break;
+
+		// Backwards, so finished tests can be erased as we go.
+		for (size_t i = running.size(); i-- > 0; )
+		{
+			if (pollFds[i].revents == 0)
+				continue;
+
+			RunningTest &test = running[i];
+			char buf[4096];
+			ssize_t bytes = read(test.outFd, buf, sizeof(buf));
+			if (bytes > 0 || (bytes < 0 && errno == EINTR))
+			{
+				if (bytes > 0)
+					test.output.append(buf, bytes);
+				continue;
+			}
+
+			// The child closed its output, so it's done.
+			close(test.outFd);
+			int status = 0;
+			waitpid(test.pid, &status, 0);
+			bool passed = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+			if (WIFSIGNALED(status))
+				test.output += StringFromFormat("%s: crashed with signal %d\n", testFilenames[test.index].c_str(), WTERMSIG(status));
+
+			if (autoCompare)
+				printf("%s:\n", testFilenames[test.index].c_str());
+			fwrite(test.output.data(), 1, test.output.size(), stdout);
+			if (autoCompare)
+				RecordTestResult(testFilenames[test.index], passed, time_now_d() - test.start, results);
+			fflush(stdout);
+
+			running.erase(running.begin() + i);
+		}
+	}
+}
+#endif
+
 int main(int argc, const char* argv[])
 {
 	PROFILE_INIT();
@@ -228,7 +632,11 @@ int main(int argc, const char* argv[])
 	const char *mountIso = 0;
 	const char *mountRoot = 0;
 	const char *screenshotFilename = 0;
+	int benchFrames = 0;
+	const char *benchJsonFilename = nullptr;
+	const char *traceFilename = nullptr;
 	float timeout = std::numeric_limits<float>::infinity();
+	int workers = 1;
 
 	for (int i = 1; i < argc; i++)
 	{
@@ -281,6 +689,24 @@ int main(int argc, const char* argv[])
 			screenshotFilename = argv[i] + strlen("--screenshot=");
 		else if (!strncmp(argv[i], "--timeout=", strlen("--timeout=")) && strlen(argv[i]) > strlen("--timeout="))
 			timeout = strtod(argv[i] + strlen("--timeout="), NULL);
+		else if (!strncmp(argv[i], "--report=", strlen("--report=")) && strlen(argv[i]) > strlen("--report="))
+			reportFilename = argv[i] + strlen("--report=");
+		else if (!strncmp(argv[i], "--bench=", strlen("--bench=")) && strlen(argv[i]) > strlen("--bench="))
+			benchFrames = std::max(1, atoi(argv[i] + strlen("--bench=")));
+		else if (!strcmp(argv[i], "--bench"))
+			benchFrames = 60;
+		else if (!strncmp(argv[i], "--bench-json=", strlen("--bench-json=")) && strlen(argv[i]) > strlen("--bench-json="))
+			benchJsonFilename = argv[i] + strlen("--bench-json=");
+		else if (!strncmp(argv[i], "--guest-profile=", strlen("--guest-profile=")) && strlen(argv[i]) > strlen("--guest-profile="))
+			guestProfileFilename = argv[i] + strlen("--guest-profile=");
+		else if (!strncmp(argv[i], "--trace=", strlen("--trace=")) && strlen(argv[i]) > strlen("--trace="))
+			traceFilename = argv[i] + strlen("--trace=");
+		else if (!strncmp(argv[i], "--draw-report=", strlen("--draw-report=")) && strlen(argv[i]) > strlen("--draw-report="))
+			drawReportFilename = argv[i] + strlen("--draw-report=");
+		else if (!strncmp(argv[i], "--workers=", strlen("--workers=")) && strlen(argv[i]) > strlen("--workers="))
+			workers = std::max(1, atoi(argv[i] + strlen("--workers=")));
+		else if (!strcmp(argv[i], "--workers"))
+			workers = std::max(1, (int)std::thread::hardware_concurrency());
 		else if (!strcmp(argv[i], "--teamcity"))
 			teamCityMode = true;
 		else if (!strncmp(argv[i], "--state=", strlen("--state=")) && strlen(argv[i]) > strlen("--state="))
@@ -302,6 +728,29 @@ int main(int argc, const char* argv[])
 			testFilenames.push_back(temp);
 	}
 
+	if (benchFrames != 0)
+	{
+		// Expand directories to the dumps inside them, in a stable order.
+		std::vector<std::string> dumps;
+		for (const std::string &filename : testFilenames)
+		{
+			if (!File::IsDirectory(filename))
+			{
+				dumps.push_back(filename);
+				continue;
+			}
+			std::vector<FileInfo> files;
+			getFilesInDir(filename.c_str(), &files, "ppdmp");
+			std::sort(files.begin(), files.end());
+			for (const FileInfo &file : files)
+			{
+				if (!file.isDirectory)
+					dumps.push_back(file.fullName);
+			}
+		}
+		testFilenames = dumps;
+	}
+
 	if (testFilenames.empty())
 		return printUsage(argv[0], argc <= 1 ? NULL : "No executables specified");
 
@@ -408,37 +857,122 @@ int main(int argc, const char* argv[])
 	if (stateToLoad != NULL)
 		SaveState::Load(stateToLoad);
 
-	std::vector<std::string> failedTests;
-	std::vector<std::string> passedTests;
-	for (size_t i = 0; i < testFilenames.size(); ++i)
+	if (benchFrames != 0)
+		printf("%-40s %8s %10s %10s %10s\n", "Dump", "frames", "ms/frame", "Mpix/s", "diff");
+	if (benchFrames != 0 && benchJsonFilename)
+	{
+		benchJson = new JsonWriter();
+		benchJson->begin();
+		benchJson->pushDict("results");
+	}
+	if (benchFrames != 0 && drawReportFilename)
+	{
+		// Start with an empty file, each dump is appended.
+		FILE *f = File::OpenCFile(drawReportFilename, "w");
+		if (f)
+			fclose(f);
+		GPURecord::SetReplayTiming(true);
+	}
+
+#ifdef USE_PROFILER
+	if (traceFilename)
+		Profiler_SetTracing(true);
+#endif
+
+	if (workers > 1)
+	{
+		// A live graphics context can't be shared by forked children, and these outputs are per process.
+		const char *reason = nullptr;
+		if (benchFrames != 0)
+			reason = "--bench";
+		else if (graphicsContext)
+			reason = "a graphics backend";
+		else if (reportFilename || guestProfileFilename || traceFilename)
+			reason = "--report, --guest-profile or --trace";
+#if defined(_WIN32)
+		reason = "Windows";
+#endif
+		if (reason)
+		{
+			fprintf(stderr, "--workers isn't supported with %s, running tests one at a time.\n", reason);
+			workers = 1;
+		}
+	}
+
+	TestResults results;
+	if (workers > 1)
 	{
-		coreParameter.fileToStart = testFilenames[i];
-		if (autoCompare)
-			printf("%s:\n", coreParameter.fileToStart.c_str());
-		bool passed = RunAutoTest(headlessHost, coreParameter, autoCompare, verbose, timeout);
-		if (autoCompare)
+#if !defined(_WIN32)
+		RunAutoTestsForked(headlessHost, coreParameter, testFilenames, workers, autoCompare, verbose, timeout, results);
+#endif
+	}
+	else
+	{
+		for (size_t i = 0; i < testFilenames.size(); ++i)
 		{
-			std::string testName = GetTestName(coreParameter.fileToStart);
-			if (passed)
+			coreParameter.fileToStart = testFilenames[i];
+			if (benchFrames != 0)
 			{
-				passedTests.push_back(testName);
-				printf("  %s - passed!\n", testName.c_str());
+				if (!RunBenchmark(headlessHost, coreParameter, benchFrames, timeout))
+					results.failed.push_back(GetTestName(coreParameter.fileToStart));
+				continue;
 			}
-			else
-				failedTests.push_back(testName);
+			if (autoCompare)
+				printf("%s:\n", coreParameter.fileToStart.c_str());
+			double testStart = time_now_d();
+			bool passed = RunAutoTest(headlessHost, coreParameter, autoCompare, verbose, timeout);
+			if (autoCompare)
+				RecordTestResult(coreParameter.fileToStart, passed, time_now_d() - testStart, results);
 		}
 	}
 
+#ifdef USE_PROFILER
+	if (traceFilename)
+		Profiler_WriteTrace(traceFilename);
+#endif
+
+	if (benchJson)
+	{
+		benchJson->pop();
+		benchJson->end();
+		FILE *f = File::OpenCFile(benchJsonFilename, "w");
+		if (f)
+		{
+			const std::string json = benchJson->str();
+			fwrite(json.data(), 1, json.size(), f);
+			fclose(f);
+		}
+		else
+			fprintf(stderr, "Unable to write benchmark results to %s\n", benchJsonFilename);
+		delete benchJson;
+		benchJson = nullptr;
+	}
+
+	if (benchFrames != 0 && !results.failed.empty())
+	{
+		printf("Failed to replay:\n");
+		for (size_t i = 0; i < results.failed.size(); ++i)
+			printf("  %s\n", results.failed[i].c_str());
+	}
+
 	if (autoCompare)
 	{
-		printf("%d tests passed, %d tests failed.\n", (int)passedTests.size(), (int)failedTests.size());
-		if (!failedTests.empty())
+		printf("%d tests passed, %d tests failed.\n", (int)results.passed.size(), (int)results.failed.size());
+		if (!results.failed.empty())
 		{
 			printf("Failed tests:\n");
-			for (size_t i = 0; i < failedTests.size(); ++i) {
-				printf("  %s\n", failedTests[i].c_str());
+			for (size_t i = 0; i < results.failed.size(); ++i) {
+				printf("  %s\n", results.failed[i].c_str());
 			}
 		}
+
+		if (results.times.size() > 1)
+		{
+			std::sort(results.times.begin(), results.times.end(), std::greater<std::pair<double, std::string>>());
+			printf("Slowest tests:\n");
+			for (size_t i = 0; i < results.times.size() && i < 10; ++i)
+				printf("  %8.3f s  %s\n", results.times[i].first, results.times[i].second.c_str());
+		}
 	}
 
 	host->ShutdownGraphics();
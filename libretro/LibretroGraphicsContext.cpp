@@ -34,6 +34,15 @@ LibretroHWRenderContext::LibretroHWRenderContext(retro_hw_context_type context_t
 	hw_render_.depth = true;
 }
 
+void LibretroHWRenderContext::SwapBuffers() {
+	// Drawing was skipped, so the frontend can just keep showing the last frame.
+	if (gstate_c.skipDrawReason && Libretro::canDupe) {
+		video_cb(NULL, 0, 0, 0);
+	} else {
+		video_cb(RETRO_HW_FRAME_BUFFER_VALID, PSP_CoreParameter().pixelWidth, PSP_CoreParameter().pixelHeight, 0);
+	}
+}
+
 void LibretroHWRenderContext::ContextReset() {
 	INFO_LOG(G3D, "Context reset");
 
@@ -51,13 +51,7 @@ class LibretroHWRenderContext : public LibretroGraphicsContext {
 	LibretroHWRenderContext(retro_hw_context_type context_type, unsigned version_major = 0, unsigned version_minor = 0);
 	bool Init(bool cache_context);
 	void SetRenderTarget() override {}
-	void SwapBuffers() override {
-		if (gstate_c.skipDrawReason) {
-			video_cb(NULL, 0, 0, 0);
-		} else {
-			video_cb(RETRO_HW_FRAME_BUFFER_VALID, PSP_CoreParameter().pixelWidth, PSP_CoreParameter().pixelHeight, 0);
-		}
-	}
+	void SwapBuffers() override;
 	virtual void ContextReset();
 	virtual void ContextDestroy();
 
@@ -103,6 +97,8 @@ class LibretroNullContext : public LibretroGraphicsContext {
 namespace Libretro {
 extern LibretroGraphicsContext *ctx;
 extern retro_environment_t environ_cb;
+// The frontend takes a null frame to mean "show the last one again".
+extern bool canDupe;
 
 enum class EmuThreadState {
 	DISABLED,
@@ -3,6 +3,7 @@
 #include <cassert>
 #include <thread>
 #include <atomic>
+#include <mutex>
 #include <vector>
 
 #include "base/timeutil.h"
@@ -39,13 +40,49 @@
 #endif
 
 #define SAMPLERATE 44100
+// If the frontend stops running frames, drop audio older than this instead of building up latency.
+#define AUDIO_PENDING_MAX_FRAMES (SAMPLERATE / 4)
 
 namespace Libretro {
 LibretroGraphicsContext *ctx;
 retro_environment_t environ_cb;
+bool canDupe;
 static retro_audio_sample_batch_t audio_batch_cb;
 static retro_input_poll_t input_poll_cb;
 static retro_input_state_t input_state_cb;
+
+// Audio is mixed on the emu thread, but the callback has to be called from retro_run.
+// So we collect it here and hand it over in one batch per frame.
+static std::mutex audioPendingLock;
+static std::vector<int16_t> audioPending;
+static std::vector<int16_t> audioFlushing;
+
+static void AudioQueue(const int16_t *audio, int frames) {
+	std::lock_guard<std::mutex> guard(audioPendingLock);
+	audioPending.insert(audioPending.end(), audio, audio + frames * 2);
+	if (audioPending.size() > AUDIO_PENDING_MAX_FRAMES * 2) {
+		audioPending.erase(audioPending.begin(), audioPending.end() - AUDIO_PENDING_MAX_FRAMES * 2);
+	}
+}
+
+static void AudioFlush() {
+	{
+		std::lock_guard<std::mutex> guard(audioPendingLock);
+		audioFlushing.swap(audioPending);
+	}
+
+	const int16_t *data = audioFlushing.data();
+	size_t frames = audioFlushing.size() / 2;
+	while (frames > 0) {
+		size_t written = audio_batch_cb(data, frames);
+		if (written == 0 || written > frames) {
+			break;
+		}
+		data += written * 2;
+		frames -= written;
+	}
+	audioFlushing.clear();
+}
 } // namespace Libretro
 
 using namespace Libretro;
@@ -63,7 +100,7 @@ class LibretroHost : public Host {
 		assert(hostAttemptBlockSize <= blockSizeMax);
 
 		int samples = __AudioMix(audio, hostAttemptBlockSize, SAMPLERATE);
-		audio_batch_cb(audio, samples);
+		AudioQueue(audio, samples);
 	}
 	void ShutdownSound() override {}
 	bool IsDebuggingEnabled() override { return false; }
@@ -536,6 +573,11 @@ bool retro_load_game(const struct retro_game_info *game) {
 
 	VFSRegister("", new DirectoryAssetReader(retro_base_dir.c_str()));
 
+	// Lets us skip handing over a frame when nothing was drawn.
+	if (!environ_cb(RETRO_ENVIRONMENT_GET_CAN_DUPE, &canDupe)) {
+		canDupe = false;
+	}
+
 	coreState = CORE_POWERUP;
 	ctx = LibretroGraphicsContext::CreateGraphicsContext();
 	INFO_LOG(SYSTEM, "Using %s backend", ctx->Ident());
@@ -579,6 +621,11 @@ void retro_unload_game(void) {
 	PSP_Shutdown();
 	VFSShutdown();
 
+	{
+		std::lock_guard<std::mutex> guard(audioPendingLock);
+		audioPending.clear();
+	}
+
 	delete ctx;
 	ctx = nullptr;
 	PSP_CoreParameter().graphicsContext = nullptr;
@@ -678,6 +725,7 @@ void retro_run(void) {
 		EmuFrame();
 	}
 
+	AudioFlush();
 	ctx->SwapBuffers();
 }
 
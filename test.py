@@ -3,9 +3,11 @@
 
 import sys
 import os
+import re
 import subprocess
 import threading
 import glob
+import multiprocessing
 
 
 PPSSPP_EXECUTABLES = [
@@ -28,21 +30,26 @@ PPSSPP_EXE = None
 TEST_ROOT = "pspautotests/tests/"
 teamcity_mode = False
 TIMEOUT = 5
+JOBS = 1
 
 class Command(object):
-  def __init__(self, cmd, data = None):
+  def __init__(self, cmd, data = None, capture = False):
     self.cmd = cmd
     self.data = data
+    self.capture = capture
     self.process = None
     self.output = None
     self.timeout = False
 
   def run(self, timeout):
     def target():
-      self.process = subprocess.Popen(self.cmd, bufsize=1, stdin=subprocess.PIPE, stdout=sys.stdout, stderr=subprocess.STDOUT)
+      stdout = subprocess.PIPE if self.capture else sys.stdout
+      self.process = subprocess.Popen(self.cmd, bufsize=1, stdin=subprocess.PIPE, stdout=stdout, stderr=subprocess.STDOUT)
       self.process.stdin.write(self.data.encode('utf-8'))
       self.process.stdin.close()
-      self.process.communicate()
+      output = self.process.communicate()[0]
+      if output is not None:
+        self.output = output.decode('utf-8', 'replace')
 
     thread = threading.Thread(target=target)
     thread.start()
@@ -374,8 +381,68 @@ def tcprint(arg):
   if teamcity_mode:
     print(arg)
 
+# Headless prints one of these per test with --compare.
+RESULT_RE = re.compile(r"^  (\S+) - (passed!|failed) \(([0-9.]+) s\)$")
+
+def run_tests_parallel(cmdline, test_list, test_filenames, jobs):
+  # Each process runs a share of the tests, reusing its emulator between them.
+  # Interleaving the slow ones (by list order) keeps the shares roughly even.
+  shards = [test_filenames[i::jobs] for i in range(jobs)]
+  shards = [s for s in shards if s]
+  print_lock = threading.Lock()
+  commands = []
+
+  def run_shard(c, count):
+    c.run(TIMEOUT * count)
+    with print_lock:
+      sys.stdout.write(c.output or "")
+      if c.timeout:
+        print("Process timed out, killed: " + ' '.join(c.cmd))
+      sys.stdout.flush()
+
+  threads = []
+  for shard in shards:
+    c = Command(cmdline, '\n'.join(shard), capture=True)
+    commands.append(c)
+    t = threading.Thread(target=run_shard, args=(c, len(shard)))
+    t.start()
+    threads.append(t)
+  for t in threads:
+    t.join()
+
+  results = {}
+  for c in commands:
+    for line in (c.output or "").splitlines():
+      m = RESULT_RE.match(line)
+      if m:
+        results[m.group(1)] = (m.group(2) == "passed!", float(m.group(3)))
+
+  tests_passed = []
+  tests_failed = []
+  for name in test_list:
+    # Headless keeps the extension in the name for .elf tests.
+    if name + ".elf" in results:
+      results[name] = results.pop(name + ".elf")
+    if name in results and results[name][0]:
+      tests_passed.append(name)
+    else:
+      tests_failed.append(name)
+
+  print("")
+  print("%d tests passed, %d tests failed (%d processes)." % (len(tests_passed), len(tests_failed), len(shards)))
+  if tests_failed:
+    print("Failed tests:")
+    for name in tests_failed:
+      print("  " + name + ("" if name in results else " (no result)"))
+
+  timed = sorted(((t, name) for name, (passed, t) in results.items()), reverse=True)
+  if timed:
+    print("Slowest tests:")
+    for t, name in timed[:10]:
+      print("  %8.3f s  %s" % (t, name))
+
 def run_tests(test_list, args):
-  global PPSSPP_EXE, TIMEOUT
+  global PPSSPP_EXE, TIMEOUT, JOBS
   tests_passed = []
   tests_failed = []
 
@@ -394,6 +461,11 @@ def run_tests(test_list, args):
     cmdline = [PPSSPP_EXE, '--root', TEST_ROOT + '../', '--compare', '--timeout=' + str(TIMEOUT), '@-']
     cmdline.extend([i for i in args if i not in ['-g', '-m']])
 
+    if JOBS > 1:
+      run_tests_parallel(cmdline, test_list, test_filenames, JOBS)
+      print("Ran " + ' '.join(cmdline))
+      return
+
     c = Command(cmdline, '\n'.join(test_filenames))
     c.run(TIMEOUT * len(test_filenames))
 
@@ -401,7 +473,7 @@ def run_tests(test_list, args):
 
 
 def main():
-  global teamcity_mode
+  global teamcity_mode, JOBS
   init()
   tests = []
   args = []
@@ -409,6 +481,9 @@ def main():
     if arg == '--teamcity':
       teamcity_mode = True
       args.append(arg)
+    elif arg.startswith('-j'):
+      # -j alone uses all cores, -jN uses N processes.
+      JOBS = int(arg[2:]) if len(arg) > 2 else multiprocessing.cpu_count()
     elif arg[0] == '-':
       args.append(arg)
     else:
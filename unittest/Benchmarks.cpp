@@ -0,0 +1,542 @@
+// Copyright (c) 2017- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+#include "base/timeutil.h"
+#include "ext/cityhash/city.h"
+#include "ext/xxhash.h"
+
+#include "Common/ColorConv.h"
+#include "Common/CPUDetect.h"
+#include "Common/Crypto/md5.h"
+#include "Common/Crypto/sha1.h"
+#include "Common/Crypto/sha256.h"
+#include "Common/Hashmaps.h"
+#include "Core/Config.h"
+#include "Core/MemMap.h"
+#include "Core/MIPS/MIPS.h"
+#include "Core/MIPS/IR/IRInst.h"
+#include "Core/MIPS/IR/IRInterpreter.h"
+#include "Core/HW/StereoResampler.h"
+#include "Core/Util/AudioFormat.h"
+#include "GPU/Common/IndexGenerator.h"
+#include "GPU/Common/TextureDecoder.h"
+#include "GPU/Common/VertexDecoderCommon.h"
+#include "GPU/ge_constants.h"
+#include "GPU/GPUState.h"
+#include "GPU/Null/NullGpu.h"
+#include "unittest/Benchmarks.h"
+
+extern "C" {
+#include "ext/libkirk/AES.h"
+}
+
+// Each sample runs the function enough times to take at least this long, to keep timer noise down.
+static const double MIN_SAMPLE_SECONDS = 0.002;
+
+// Results go through here, so the compiler can't throw the work away.
+static volatile u64 benchSink;
+
+class BenchmarkRunner {
+public:
+	BenchmarkRunner(const char *filter, int samples) : filter_(filter), samples_(samples) {
+	}
+
+	// Times func, which processes bytes bytes per call (0 if throughput makes no sense.)
+	void Run(const char *name, size_t bytes, const std::function<void()> &func);
+
+private:
+	const char *filter_;
+	int samples_;
+	bool printedHeader_ = false;
+};
+
+void BenchmarkRunner::Run(const char *name, size_t bytes, const std::function<void()> &func) {
+	if (filter_ && *filter_ && !strstr(name, filter_))
+		return;
+	if (!printedHeader_) {
+		printf("%-32s %12s %12s %8s %12s\n", "Benchmark", "median us", "min us", "stddev", "MB/s");
+		printedHeader_ = true;
+	}
+
+	// Warm up caches (and the branch predictor), and find how many calls make a sample.
+	func();
+	int iterations = 1;
+	while (true) {
+		double start = real_time_now();
+		for (int i = 0; i < iterations; ++i)
+			func();
+		if (real_time_now() - start >= MIN_SAMPLE_SECONDS || iterations >= (1 << 24))
+			break;
+		iterations *= 2;
+	}
+
+	std::vector<double> times;
+	times.reserve(samples_);
+	for (int s = 0; s < samples_; ++s) {
+		double start = real_time_now();
+		for (int i = 0; i < iterations; ++i)
+			func();
+		times.push_back((real_time_now() - start) / iterations);
+	}
+	std::sort(times.begin(), times.end());
+
+	double mean = 0.0;
+	for (double t : times)
+		mean += t;
+	mean /= times.size();
+	double variance = 0.0;
+	for (double t : times)
+		variance += (t - mean) * (t - mean);
+	double stddev = sqrt(variance / times.size());
+
+	const double median = times[times.size() / 2];
+	printf("%-32s %12.3f %12.3f %7.1f%%", name, median * 1e6, times[0] * 1e6, stddev * 100.0 / mean);
+	if (bytes != 0)
+		printf(" %12.1f", bytes / median / 1048576.0);
+	printf("\n");
+}
+
+static std::vector<u8> RandomBytes(size_t size, u32 seed) {
+	std::vector<u8> data(size);
+	for (size_t i = 0; i < size; ++i) {
+		seed = seed * 1103515245 + 12345;
+		data[i] = seed >> 16;
+	}
+	return data;
+}
+
+static void BenchVertexDecoder(BenchmarkRunner &b) {
+	const int VERTS = 1024;
+	// Pretty typical formats: through mode sprites, skinned and textured, lit and textured.
+	struct Format {
+		const char *name;
+		u32 vtype;
+	};
+	const Format formats[] = {
+		{ "t16_c8888_p16", GE_VTYPE_TC_16BIT | GE_VTYPE_COL_8888 | GE_VTYPE_POS_16BIT | GE_VTYPE_THROUGH },
+		{ "w8x4_t16_n8_pf", GE_VTYPE_WEIGHT_8BIT | (3 << GE_VTYPE_WEIGHTCOUNT_SHIFT) | GE_VTYPE_TC_16BIT | GE_VTYPE_NRM_8BIT | GE_VTYPE_POS_FLOAT },
+		{ "tf_nf_pf", GE_VTYPE_TC_FLOAT | GE_VTYPE_NRM_FLOAT | GE_VTYPE_POS_FLOAT },
+	};
+
+	g_Config.bVertexDecoderJit = true;
+	// Required for jit to be enabled.
+	g_Config.iCpuCore = (int)CPUCore::JIT;
+	gstate_c.uv.uScale = 1.0f;
+	gstate_c.uv.vScale = 1.0f;
+	gstate_c.uv.uOff = 0.0f;
+	gstate_c.uv.vOff = 0.0f;
+
+	VertexDecoderJitCache jitCache;
+	VertexDecoderOptions options;
+	memset(&options, 0, sizeof(options));
+	std::vector<u8> src = RandomBytes(VERTS * 64, 0x1234);
+	std::vector<u8> dst(VERTS * 128);
+
+	for (const Format &format : formats) {
+		for (int jit = 0; jit < 2; ++jit) {
+			VertexDecoder dec;
+			dec.SetVertexType(format.vtype, options, jit ? &jitCache : nullptr);
+			char name[64];
+			snprintf(name, sizeof(name), "VertexDecoder/%s/%s", format.name, jit ? "jit" : "interp");
+			b.Run(name, VERTS * dec.VertexSize(), [&] {
+				dec.DecodeVerts(&dst[0], &src[0], 0, VERTS - 1);
+			});
+		}
+	}
+}
+
+static void BenchTextureDecoder(BenchmarkRunner &b) {
+	const int W = 512, H = 512, PIXELS = W * H;
+	std::vector<u8> src = RandomBytes(PIXELS * 4, 0x5678);
+	std::vector<u32> dst32(PIXELS);
+	std::vector<u16> dst16(PIXELS);
+
+	const u32 pitch = W * sizeof(u32);
+	b.Run("TextureDecoder/Unswizzle32", PIXELS * sizeof(u32), [&] {
+		DoUnswizzleTex16(&src[0], &dst32[0], pitch / 16, H / 8, pitch);
+	});
+
+	u32 oldClutformat = gstate.clutformat;
+	gstate.clutformat = 0xC500FF00 | GE_CMODE_32BIT_ABGR8888;
+	u32 clut32[16];
+	u16 clut16[16];
+	for (int i = 0; i < 16; ++i) {
+		clut32[i] = 0x01020304 * (i + 1) ^ 0x80F0F000;
+		clut16[i] = (u16)clut32[i];
+	}
+	b.Run("TextureDecoder/CLUT4->8888", PIXELS * sizeof(u32), [&] {
+		for (int y = 0; y < H; ++y)
+			DeIndexTexture4(&dst32[y * W], &src[y * W / 2], W, clut32);
+	});
+	b.Run("TextureDecoder/CLUT4->16", PIXELS * sizeof(u16), [&] {
+		for (int y = 0; y < H; ++y)
+			DeIndexTexture4(&dst16[y * W], &src[y * W / 2], W, clut16);
+	});
+	std::vector<u32> clut256(256);
+	for (int i = 0; i < 256; ++i)
+		clut256[i] = i * 0x01010101;
+	b.Run("TextureDecoder/CLUT8->8888", PIXELS * sizeof(u32), [&] {
+		for (int y = 0; y < H; ++y)
+			DeIndexTexture(&dst32[y * W], &src[y * W], W, &clut256[0]);
+	});
+	gstate.clutformat = oldClutformat;
+
+	b.Run("TextureDecoder/DXT1", PIXELS * sizeof(u32), [&] {
+		const DXT1Block *block = (const DXT1Block *)&src[0];
+		for (int y = 0; y < H; y += 4) {
+			for (int x = 0; x < W; x += 4)
+				DecodeDXT1Block(&dst32[y * W + x], block++, W, 4, false);
+		}
+	});
+	b.Run("TextureDecoder/DXT5", PIXELS * sizeof(u32), [&] {
+		const DXT5Block *block = (const DXT5Block *)&src[0];
+		for (int y = 0; y < H; y += 4) {
+			for (int x = 0; x < W; x += 4)
+				DecodeDXT5Block(&dst32[y * W + x], block++, W, 4);
+		}
+	});
+}
+
+static void BenchColorConv(BenchmarkRunner &b) {
+	const int PIXELS = 512 * 512;
+	std::vector<u8> src = RandomBytes(PIXELS * 4, 0x9ABC);
+	const u16 *src16 = (const u16 *)&src[0];
+	const u32 *src32 = (const u32 *)&src[0];
+	std::vector<u32> dst32(PIXELS);
+	std::vector<u16> dst16(PIXELS);
+
+	b.Run("ColorConv/565->8888", PIXELS * sizeof(u32), [&] {
+		ConvertRGBA565ToRGBA8888(&dst32[0], src16, PIXELS);
+	});
+	b.Run("ColorConv/5551->8888", PIXELS * sizeof(u32), [&] {
+		ConvertRGBA5551ToRGBA8888(&dst32[0], src16, PIXELS);
+	});
+	b.Run("ColorConv/4444->8888", PIXELS * sizeof(u32), [&] {
+		ConvertRGBA4444ToRGBA8888(&dst32[0], src16, PIXELS);
+	});
+	b.Run("ColorConv/BGRA8888->RGBA8888", PIXELS * sizeof(u32), [&] {
+		ConvertBGRA8888ToRGBA8888(&dst32[0], src32, PIXELS);
+	});
+	b.Run("ColorConv/8888->565", PIXELS * sizeof(u32), [&] {
+		ConvertRGBA8888ToRGB565(&dst16[0], src32, PIXELS);
+	});
+	b.Run("ColorConv/4444->ABGR4444", PIXELS * sizeof(u16), [&] {
+		ConvertRGBA4444ToABGR4444(&dst16[0], src16, PIXELS);
+	});
+}
+
+static void BenchHash(BenchmarkRunner &b) {
+	// About the size of a 256x256 16-bit texture.
+	const int SIZE = 128 * 1024;
+	std::vector<u8> data = RandomBytes(SIZE, 0xDEF0);
+
+	b.Run("Hash/QuickTexHash", SIZE, [&] {
+		benchSink = DoQuickTexHash(&data[0], SIZE);
+	});
+	b.Run("Hash/XXH32", SIZE, [&] {
+		benchSink = XXH32(&data[0], SIZE, 0xBACD7814);
+	});
+	b.Run("Hash/XXH64", SIZE, [&] {
+		benchSink = XXH64(&data[0], SIZE, 0xBACD7814);
+	});
+	b.Run("Hash/CityHash64", SIZE, [&] {
+		benchSink = CityHash64((const char *)&data[0], SIZE);
+	});
+}
+
+static void BenchCrypto(BenchmarkRunner &b) {
+	// About the size of a big savedata file.
+	const int SIZE = 256 * 1024;
+	std::vector<u8> data = RandomBytes(SIZE, 0x5A5A);
+	std::vector<u8> out(SIZE);
+	u8 digest[32];
+
+	// The SHA instructions are picked through cpu_info, so the portable code can be timed too.
+	const bool hadSHA = cpu_info.bSHA;
+	for (int accel = hadSHA ? 1 : 0; accel >= 0; --accel) {
+		cpu_info.bSHA = accel != 0;
+		b.Run(accel ? "Crypto/SHA1" : "Crypto/SHA1 (portable)", SIZE, [&] {
+			sha1(&data[0], SIZE, digest);
+			benchSink = digest[0];
+		});
+		b.Run(accel ? "Crypto/SHA256" : "Crypto/SHA256 (portable)", SIZE, [&] {
+			sha256_context ctx;
+			sha256_starts(&ctx);
+			sha256_update(&ctx, &data[0], SIZE);
+			sha256_finish(&ctx, digest);
+			benchSink = digest[0];
+		});
+	}
+	cpu_info.bSHA = hadSHA;
+
+	b.Run("Crypto/MD5", SIZE, [&] {
+		md5(&data[0], SIZE, digest);
+		benchSink = digest[0];
+	});
+
+	AES_ctx aes;
+	AES_set_key(&aes, &data[0], 128);
+	b.Run("Crypto/AES-CBC encrypt", SIZE, [&] {
+		AES_cbc_encrypt(&aes, &data[0], &out[0], SIZE);
+		benchSink = out[0];
+	});
+	b.Run("Crypto/AES-CBC decrypt", SIZE, [&] {
+		AES_cbc_decrypt(&aes, &data[0], &out[0], SIZE);
+		benchSink = out[0];
+	});
+	b.Run("Crypto/AES-CMAC", SIZE, [&] {
+		AES_CMAC(&aes, &data[0], SIZE, digest);
+		benchSink = digest[0];
+	});
+}
+
+static void BenchVagDecode(BenchmarkRunner &b) {
+	// A second of 44.1 kHz audio, 28 samples per 16 byte block.
+	const int BLOCKS = 44100 / 28;
+	std::vector<u8> data = RandomBytes(BLOCKS * 16 + 16, 0x1357);
+	s16 out[28];
+
+	b.Run("SasVag/UnpackSamples", BLOCKS * 28 * sizeof(s16), [&] {
+		for (int i = 0; i < BLOCKS; ++i) {
+			const u8 *block = &data[i * 16];
+			UnpackVagSamples(block + 2, block[0] & 0xF, out);
+		}
+		benchSink = out[0];
+	});
+}
+
+static void BenchResampler(BenchmarkRunner &b) {
+	const int FRAMES = 4096;
+	const int TAPS = PolyphaseFilterBank::TAPS;
+	const u32 ratio = (u32)(65536.0 * 44100 / 48000);
+
+	PolyphaseFilterBank bank;
+	bank.Design(0.455f);
+	std::vector<u8> input = RandomBytes((FRAMES + TAPS) * 2 * sizeof(s16), 0x2468);
+	const s16 *in = (const s16 *)&input[0];
+	std::vector<s16> out(FRAMES * 2 + 4);
+
+	b.Run("Resampler/Polyphase", FRAMES * 2 * sizeof(s16), [&] {
+		u32 frac = 0;
+		int pos = 0;
+		s16 *o = &out[0];
+		while (pos < FRAMES) {
+			bank.Filter(&in[pos * 2], frac, o);
+			o += 2;
+			frac += ratio;
+			pos += frac >> 16;
+			frac &= 0xFFFF;
+		}
+	});
+}
+
+static void BenchIndexGenerator(BenchmarkRunner &b) {
+	const int VERTS = 1024;
+	std::vector<u16> buf(VERTS * 3 * 4);
+	std::vector<u16_le> inds16(VERTS);
+	for (int i = 0; i < VERTS; ++i)
+		inds16[i] = (u16)((i * 1237 + 59) % VERTS);
+
+	const int prims[] = { GE_PRIM_TRIANGLES, GE_PRIM_TRIANGLE_STRIP, GE_PRIM_TRIANGLE_FAN };
+	const char *names[] = { "Tris", "Strip", "Fan" };
+	for (int p = 0; p < 3; ++p) {
+		IndexGenerator gen;
+		char name[64];
+		snprintf(name, sizeof(name), "IndexGenerator/Add%s", names[p]);
+		b.Run(name, 0, [&] {
+			gen.Setup(&buf[0]);
+			gen.AddPrim(prims[p], VERTS);
+		});
+		snprintf(name, sizeof(name), "IndexGenerator/Translate%s16", names[p]);
+		b.Run(name, 0, [&] {
+			gen.Setup(&buf[0]);
+			gen.TranslatePrim(prims[p], VERTS, &inds16[0], 0);
+		});
+	}
+}
+
+static void BenchIRInterpreter(BenchmarkRunner &b) {
+	InitIR();
+
+	// A long run of the sort of integer ops most blocks are made of.
+	IRWriter ir;
+	for (int i = 0; i < 256; ++i) {
+		ir.Write(IROp::Add, MIPS_REG_V0, MIPS_REG_A0, MIPS_REG_A1);
+		ir.Write(IROp::ShlImm, MIPS_REG_V1, MIPS_REG_V0, 3);
+		ir.Write(IROp::Xor, MIPS_REG_A0, MIPS_REG_V1, MIPS_REG_A2);
+		ir.Write(IROp::Sub, MIPS_REG_A1, MIPS_REG_A1, MIPS_REG_V0);
+	}
+	IRInst exit;
+	exit.op = IROp::ExitToConst;
+	exit.dest = 0;
+	exit.src1 = 0;
+	exit.src2 = 0;
+	exit.constant = 0x08804000;
+	ir.Write(exit);
+	const std::vector<IRInst> &insts = ir.GetInstructions();
+
+	MIPSState *mips = new MIPSState();
+	mips->r[MIPS_REG_A0] = 1;
+	mips->r[MIPS_REG_A1] = 2;
+	mips->r[MIPS_REG_A2] = 3;
+	char name[64];
+	snprintf(name, sizeof(name), "IRInterpreter/Alu%d", (int)insts.size());
+	b.Run(name, 0, [&] {
+		benchSink = IRInterpret(mips, &insts[0], (int)insts.size());
+	});
+	delete mips;
+}
+
+// Runs a display list through the real GPUCommon::FastRunLoop, without a backend behind it.
+class BenchGPU : public NullGPU {
+public:
+	void Run(DisplayList &list, u32 pc, int count) {
+		list.pc = pc;
+		list.stall = 0;
+		currentList = &list;
+		downcount = count;
+		GPUCommon::FastRunLoop(list);
+		currentList = nullptr;
+	}
+};
+
+static void BenchGECommands(BenchmarkRunner &b) {
+	Memory::g_MemorySize = Memory::RAM_NORMAL_SIZE;
+	Memory::Init();
+
+	// The state a game typically sets between draws: a world matrix, texture, blend and depth.
+	std::vector<u32> ops;
+	for (u32 i = 0; i < 64; ++i) {
+		ops.push_back(GE_CMD_WORLDMATRIXNUMBER << 24);
+		for (u32 j = 0; j < 12; ++j)
+			ops.push_back((GE_CMD_WORLDMATRIXDATA << 24) | (0x3F8000 + i * 12 + j));
+		ops.push_back((GE_CMD_TEXADDR0 << 24) | (i * 0x2000));
+		ops.push_back((GE_CMD_ALPHATEST << 24) | ((i & 1) ? 0x000407 : 0x008006));
+		ops.push_back((GE_CMD_BLENDMODE << 24) | ((i & 3) == 0 ? 0x000032 : 0x000010));
+		ops.push_back((GE_CMD_ZTEST << 24) | ((i & 1) ? 6 : 7));
+		ops.push_back((GE_CMD_MATERIALAMBIENT << 24) | (i * 0x010101));
+		ops.push_back((GE_CMD_MINZ << 24) | (i & 1));
+		ops.push_back((GE_CMD_VIEWPORTXSCALE << 24) | (0x43F000 + (i & 1)));
+		ops.push_back(GE_CMD_NOP << 24);
+	}
+	const u32 pc = 0x08800000;
+	Memory::MemcpyUnchecked(pc, &ops[0], (u32)ops.size() * 4);
+
+	BenchGPU *gpu = new BenchGPU();
+	DisplayList list;
+	memset(&list, 0, sizeof(list));
+
+	// Bytes here are command words, a quarter of the MB/s is millions of commands per second.
+	const bool oldCommandCache = g_Config.bGECommandCache;
+	char name[64];
+	for (int cache = 0; cache < 2; ++cache) {
+		g_Config.bGECommandCache = cache != 0;
+		snprintf(name, sizeof(name), "GE/FastRunLoop%s", cache ? "/Cache" : "");
+		b.Run(name, ops.size() * 4, [&] {
+			gpu->Run(list, pc, (int)ops.size());
+		});
+	}
+	g_Config.bGECommandCache = oldCommandCache;
+
+	delete gpu;
+	Memory::Shutdown();
+}
+
+// About the size of a pipeline key, with mostly similar bytes like real ones.
+struct BenchMapKey {
+	u32 words[12];
+};
+
+template <class Map, class Key>
+static void BenchMapLookups(BenchmarkRunner &b, const char *name, Map &map, const std::vector<Key> &keys, size_t count) {
+	for (size_t i = 0; i < count; ++i)
+		map.Insert(keys[i], (void *)(uintptr_t)(i + 1));
+	char label[64];
+	snprintf(label, sizeof(label), "%s/hit", name);
+	b.Run(label, 0, [&] {
+		uintptr_t sum = 0;
+		for (size_t i = 0; i < count; ++i)
+			sum += (uintptr_t)map.Get(keys[i]);
+		benchSink = sum;
+	});
+	snprintf(label, sizeof(label), "%s/miss", name);
+	b.Run(label, 0, [&] {
+		uintptr_t sum = 0;
+		for (size_t i = count; i < count * 2; ++i)
+			sum += (uintptr_t)map.Get(keys[i]);
+		benchSink = sum;
+	});
+}
+
+static void BenchHashmap(BenchmarkRunner &b) {
+	// Roughly a busy game's pipeline cache, and a big vertex cache.
+	const size_t KEYS = 512;
+	const size_t VAIS = 8192;
+
+	std::vector<u8> bytes = RandomBytes(KEYS * 2 * sizeof(BenchMapKey), 0x4242);
+	std::vector<BenchMapKey> keys(KEYS * 2);
+	for (size_t i = 0; i < keys.size(); ++i) {
+		for (int w = 0; w < 12; ++w)
+			keys[i].words[w] = bytes[i * sizeof(BenchMapKey) + w] & 7;
+		keys[i].words[0] = (u32)i;
+	}
+	std::vector<u32> hashes(VAIS * 2);
+	for (size_t i = 0; i < hashes.size(); ++i)
+		hashes[i] = (u32)(i + 1) * 2654435761U;
+
+	DenseHashMap<BenchMapKey, void *, nullptr> dense(16);
+	BenchMapLookups(b, "Hashmap/Dense", dense, keys, KEYS);
+	GroupHashMap<BenchMapKey, void *, nullptr> group(16);
+	BenchMapLookups(b, "Hashmap/Group", group, keys, KEYS);
+	PrehashMap<void *, nullptr> prehash(16);
+	BenchMapLookups(b, "Hashmap/Prehash", prehash, hashes, VAIS);
+	GroupHashMap<u32, void *, nullptr, PrehashedKey> groupPrehash(16);
+	BenchMapLookups(b, "Hashmap/GroupPrehash", groupPrehash, hashes, VAIS);
+}
+
+typedef void (*BenchFunc)(BenchmarkRunner &b);
+
+static const BenchFunc benchmarks[] = {
+	&BenchVertexDecoder,
+	&BenchTextureDecoder,
+	&BenchColorConv,
+	&BenchHash,
+	&BenchCrypto,
+	&BenchVagDecode,
+	&BenchResampler,
+	&BenchIndexGenerator,
+	&BenchIRInterpreter,
+	&BenchGECommands,
+	&BenchHashmap,
+};
+
+void RunBenchmarks(const char *filter, int samples) {
+	SetupColorConv();
+	SetupTextureDecoder();
+	SetupAudioFormats();
+
+	BenchmarkRunner runner(filter, std::max(samples, 1));
+	for (BenchFunc func : benchmarks)
+		func(runner);
+}
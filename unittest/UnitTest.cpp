@@ -25,30 +25,58 @@
 // Or just integrate with an existing testing framework.
 
 
+#include <atomic>
 #include <cstdio>
 #include <cstdlib>
 #include <cmath>
 #include <string>
 #include <sstream>
+#include <thread>
+#include <vector>
 
 #include "base/NativeApp.h"
+#include "base/timeutil.h"
 #include "base/logging.h"
 #include "input/input_state.h"
 #include "ext/disarm.h"
 #include "math/math_util.h"
+#include "thread/threadpool.h"
 #include "util/text/parsers.h"
 
+#include "Common/ChunkFile.h"
+#include "Common/ColorConv.h"
 #include "Common/CPUDetect.h"
+#include "Common/Crypto/crc32.h"
+#include "Common/Crypto/sha1.h"
+#include "Common/Crypto/sha256.h"
 #include "Common/ArmEmitter.h"
+#include "Common/Hashmaps.h"
 #include "Core/Config.h"
+#include "Core/CoreTiming.h"
+#include "Core/MIPS/MIPS.h"
 #include "Core/MIPS/MIPSVFPUUtils.h"
+#include "Core/MIPS/IR/IRInst.h"
+#include "Core/MIPS/IR/IRPassSimplify.h"
 #include "Core/FileSystems/ISOFileSystem.h"
+#include "Core/HLE/ThreadQueueList.h"
+#include "Core/HW/SasAudio.h"
+#include "Core/HW/SasReverb.h"
+#include "Core/HW/StereoResampler.h"
+#include "Core/Util/AudioFormat.h"
+#include "Core/Util/BlockAllocator.h"
+#include "GPU/Common/DrawEngineCommon.h"
+#include "GPU/Common/IndexGenerator.h"
 #include "GPU/Common/TextureDecoder.h"
 
+#include "unittest/Benchmarks.h"
 #include "unittest/JitHarness.h"
 #include "unittest/TestVertexJit.h"
 #include "unittest/UnitTest.h"
 
+extern "C" {
+#include "ext/libkirk/AES.h"
+}
+
 std::string System_GetProperty(SystemProperty prop) { return ""; }
 int System_GetPropertyInt(SystemProperty prop) {
 	return -1;
@@ -459,6 +487,851 @@ bool TestQuickTexHash() {
 	return false;
 }
 
+static void PrintDecodeSpeed(const char *name, size_t bytes, int reps, double elapsed) {
+	printf("TextureDecoding: %-12s %8.1f MB/s\n", name, (double)bytes * reps / elapsed / 1048576.0);
+}
+
+// Checks the SIMD decoders against the per-pixel reference, and prints their speed so regressions stand out.
+bool TestTextureDecoding() {
+	SetupTextureDecoder();
+	SetupColorConv();
+
+	const int W = 512, H = 512, PIXELS = W * H, REPS = 20;
+	std::vector<u16> src16(PIXELS);
+	std::vector<u8> src8(PIXELS * 4);
+	u32 seed = 0x1234567;
+	for (size_t i = 0; i < src8.size(); ++i) {
+		seed = seed * 1103515245 + 12345;
+		src8[i] = seed >> 16;
+	}
+	memcpy(&src16[0], &src8[0], PIXELS * sizeof(u16));
+	std::vector<u32> dst32(PIXELS);
+	std::vector<u16> dst16(PIXELS);
+
+	struct Convert16 {
+		const char *name;
+		Convert16bppTo32bppFunc func;
+		u32 (*ref)(u16);
+	};
+	const Convert16 converts[] = {
+		{ "565->8888", ConvertRGBA565ToRGBA8888, &RGB565ToRGBA8888 },
+		{ "5551->8888", ConvertRGBA5551ToRGBA8888, &RGBA5551ToRGBA8888 },
+		{ "4444->8888", ConvertRGBA4444ToRGBA8888, &RGBA4444ToRGBA8888 },
+	};
+	for (const Convert16 &conv : converts) {
+		conv.func(&dst32[0], &src16[0], PIXELS);
+		for (int i = 0; i < PIXELS; ++i) {
+			EXPECT_EQ_HEX(dst32[i], conv.ref(src16[i]));
+		}
+		// Odd lengths exercise the tail too.
+		conv.func(&dst32[0], &src16[0], 13);
+		EXPECT_EQ_HEX(dst32[12], conv.ref(src16[12]));
+
+		double start = time_now_d();
+		for (int r = 0; r < REPS; ++r)
+			conv.func(&dst32[0], &src16[0], PIXELS);
+		PrintDecodeSpeed(conv.name, PIXELS * sizeof(u32), REPS, time_now_d() - start);
+	}
+
+	// CLUT4 with a simple index goes through the table lookup path.
+	u32 oldClutformat = gstate.clutformat;
+	gstate.clutformat = 0xC500FF00 | GE_CMODE_32BIT_ABGR8888;
+	u32 clut32[16];
+	u16 clut16[16];
+	for (int i = 0; i < 16; ++i) {
+		clut32[i] = 0x01020304 * (i + 1) ^ 0x80F0F000;
+		clut16[i] = (u16)clut32[i];
+	}
+	for (int y = 0; y < H; ++y) {
+		DeIndexTexture4(&dst32[y * W], &src8[y * W / 2], W, clut32);
+		DeIndexTexture4(&dst16[y * W], &src8[y * W / 2], W, clut16);
+	}
+	for (int i = 0; i < PIXELS; ++i) {
+		u8 index = (src8[i / 2] >> ((i & 1) * 4)) & 0xF;
+		EXPECT_EQ_HEX(dst32[i], clut32[index]);
+		EXPECT_EQ_HEX(dst16[i], clut16[index]);
+	}
+
+	double start = time_now_d();
+	for (int r = 0; r < REPS; ++r) {
+		for (int y = 0; y < H; ++y)
+			DeIndexTexture4(&dst32[y * W], &src8[y * W / 2], W, clut32);
+	}
+	PrintDecodeSpeed("CLUT4->8888", PIXELS * sizeof(u32), REPS, time_now_d() - start);
+	start = time_now_d();
+	for (int r = 0; r < REPS; ++r) {
+		for (int y = 0; y < H; ++y)
+			DeIndexTexture4(&dst16[y * W], &src8[y * W / 2], W, clut16);
+	}
+	PrintDecodeSpeed("CLUT4->16", PIXELS * sizeof(u16), REPS, time_now_d() - start);
+
+	std::vector<u32> clut256(256);
+	for (int i = 0; i < 256; ++i)
+		clut256[i] = i * 0x01010101;
+	start = time_now_d();
+	for (int r = 0; r < REPS; ++r) {
+		for (int y = 0; y < H; ++y)
+			DeIndexTexture(&dst32[y * W], &src8[y * W], W, &clut256[0]);
+	}
+	PrintDecodeSpeed("CLUT8->8888", PIXELS * sizeof(u32), REPS, time_now_d() - start);
+	gstate.clutformat = oldClutformat;
+
+	// Unswizzle 32-bit, compared against a simple block copy.
+	const u32 pitch = W * sizeof(u32);
+	std::vector<u32> unswizzled(PIXELS);
+	DoUnswizzleTex16(&src8[0], &dst32[0], pitch / 16, H / 8, pitch);
+	const u8 *block = &src8[0];
+	for (int by = 0; by < H / 8; ++by) {
+		for (u32 bx = 0; bx < pitch / 16; ++bx) {
+			for (int n = 0; n < 8; ++n) {
+				memcpy((u8 *)&unswizzled[0] + (by * 8 + n) * pitch + bx * 16, block, 16);
+				block += 16;
+			}
+		}
+	}
+	EXPECT_TRUE(memcmp(&unswizzled[0], &dst32[0], PIXELS * sizeof(u32)) == 0);
+	start = time_now_d();
+	for (int r = 0; r < REPS; ++r)
+		DoUnswizzleTex16(&src8[0], &dst32[0], pitch / 16, H / 8, pitch);
+	PrintDecodeSpeed("Unswizzle", PIXELS * sizeof(u32), REPS, time_now_d() - start);
+
+	// DXT is still scalar, but worth keeping an eye on.
+	start = time_now_d();
+	for (int r = 0; r < REPS; ++r) {
+		const DXT1Block *src = (const DXT1Block *)&src8[0];
+		for (int y = 0; y < H; y += 4) {
+			for (int x = 0; x < W; x += 4)
+				DecodeDXT1Block(&dst32[y * W + x], src++, W, 4, false);
+		}
+	}
+	PrintDecodeSpeed("DXT1", PIXELS * sizeof(u32), REPS, time_now_d() - start);
+	start = time_now_d();
+	for (int r = 0; r < REPS; ++r) {
+		const DXT5Block *src = (const DXT5Block *)&src8[0];
+		for (int y = 0; y < H; y += 4) {
+			for (int x = 0; x < W; x += 4)
+				DecodeDXT5Block(&dst32[y * W + x], src++, W, 4);
+		}
+	}
+	PrintDecodeSpeed("DXT5", PIXELS * sizeof(u32), REPS, time_now_d() - start);
+
+	return true;
+}
+
+bool TestIRRegAlloc() {
+	InitIR();
+
+	IRWriter ir;
+	ir.Write(IROp::Add, MIPS_REG_V0, MIPS_REG_A0, MIPS_REG_A1);
+	ir.Write(IROp::Add, MIPS_REG_V1, MIPS_REG_V0, MIPS_REG_A0);
+	ir.Write(IROp::Syscall);
+	ir.Write(IROp::Mov, MIPS_REG_A0, MIPS_REG_V1);
+	ir.Write(IROp::ExitToConst);
+
+	std::vector<IRLiveRange> ranges = IRComputeLiveRanges(ir.GetInstructions());
+	EXPECT_EQ_INT((int)ranges.size(), 6);
+	// a0 is read first, and not needed after its last read.
+	EXPECT_EQ_INT(ranges[0].reg, MIPS_REG_A0);
+	EXPECT_TRUE(ranges[0].loadOnStart);
+	EXPECT_FALSE(ranges[0].dirty);
+	EXPECT_EQ_INT(ranges[0].end, 1);
+	// v0 is written first, and must be stored at the syscall.
+	EXPECT_EQ_INT(ranges[2].reg, MIPS_REG_V0);
+	EXPECT_FALSE(ranges[2].loadOnStart);
+	EXPECT_TRUE(ranges[2].dirty);
+	EXPECT_EQ_INT(ranges[2].end, 2);
+	// After the syscall, v1 must be reloaded.
+	EXPECT_EQ_INT(ranges[4].reg, MIPS_REG_V1);
+	EXPECT_EQ_INT(ranges[4].start, 3);
+	EXPECT_TRUE(ranges[4].loadOnStart);
+
+	// With two host regs, three ranges overlap at the first add, so one must spill.
+	EXPECT_EQ_INT(IRAllocateHostRegs(ranges, 2), 1);
+	for (size_t i = 0; i < ranges.size(); ++i) {
+		for (size_t j = i + 1; j < ranges.size(); ++j) {
+			bool overlap = ranges[i].start <= ranges[j].end && ranges[j].start <= ranges[i].end;
+			if (overlap && ranges[i].hostReg != -1) {
+				EXPECT_TRUE(ranges[i].hostReg != ranges[j].hostReg);
+			}
+		}
+	}
+	EXPECT_TRUE(ranges[4].hostReg != -1);
+	EXPECT_TRUE(ranges[5].hostReg != -1);
+
+	return true;
+}
+
+bool TestIRDeadStores() {
+	InitIR();
+
+	IRWriter ir;
+	ir.Write(IROp::Add, MIPS_REG_V0, MIPS_REG_A0, MIPS_REG_A1);
+	ir.Write(IROp::Add, MIPS_REG_V0, MIPS_REG_A0, MIPS_REG_A0);
+	ir.Write(IROp::Add, MIPS_REG_V1, MIPS_REG_A0, MIPS_REG_A0);
+	ir.Write(IROp::ExitToConstIfEq, 0, MIPS_REG_A0, MIPS_REG_A1);
+	ir.Write(IROp::Add, MIPS_REG_V1, MIPS_REG_A0, MIPS_REG_A0);
+	ir.Write(IROp::Add, IRTEMP_0, MIPS_REG_A0, MIPS_REG_A0);
+	ir.Write(IROp::FCmp, IRFpCompareMode::EqualOrdered, 4, 5);
+	ir.Write(IROp::FCmp, IRFpCompareMode::LessOrdered, 4, 6);
+	ir.Write(IROp::FpCondToReg, MIPS_REG_T0);
+	ir.Write(IROp::ExitToConst);
+
+	IRWriter out;
+	IROptions opts{};
+	RemoveDeadStores(ir, out, opts);
+	const std::vector<IRInst> &insts = out.GetInstructions();
+	// The first v0 write, the temp, and the first compare are dead.  v1 is read by the exit.
+	EXPECT_EQ_INT((int)insts.size(), 7);
+	EXPECT_EQ_INT(insts[0].src2, MIPS_REG_A0);
+	EXPECT_EQ_INT(insts[1].dest, MIPS_REG_V1);
+	EXPECT_TRUE(insts[4].op == IROp::FCmp);
+	EXPECT_EQ_INT(insts[4].src2, 6);
+
+	return true;
+}
+
+static int coreTimingFired;
+static int coreTimingOutOfOrder;
+static s64 coreTimingLastTicks;
+static int coreTimingEvent;
+
+static void CoreTimingTestCallback(u64 userdata, int cyclesLate) {
+	s64 now = (s64)CoreTiming::GetTicks();
+	if (cyclesLate < 0 || now < coreTimingLastTicks)
+		coreTimingOutOfOrder++;
+	coreTimingLastTicks = now;
+	coreTimingFired++;
+	// Keep roughly the same number of events pending, with scattered periods.
+	CoreTiming::ScheduleEvent(1000 + (userdata * 7919) % 50000, coreTimingEvent, userdata);
+}
+
+static int coreTimingThreadsafeFired;
+
+static void CoreTimingThreadsafeCallback(u64 userdata, int cyclesLate) {
+	coreTimingThreadsafeFired++;
+}
+
+bool TestCoreTiming() {
+	const int PENDING = 2000;
+	const int FIRES = 2000000;
+
+	CoreTiming::Init();
+	coreTimingEvent = CoreTiming::RegisterEvent("UnitTestEvent", &CoreTimingTestCallback);
+	coreTimingFired = 0;
+	coreTimingOutOfOrder = 0;
+	coreTimingLastTicks = 0;
+
+	double start = time_now_d();
+	for (int i = 0; i < PENDING; ++i)
+		CoreTiming::ScheduleEvent(1000 + (i * 104729) % 50000, coreTimingEvent, i);
+	double scheduled = time_now_d();
+
+	while (coreTimingFired < FIRES) {
+		// Pretend the CPU ran until the next event.
+		currentMIPS->downcount = 0;
+		CoreTiming::Advance();
+	}
+	double finished = time_now_d();
+
+	EXPECT_TRUE(CoreTiming::IsScheduled(coreTimingEvent));
+	CoreTiming::RemoveEvent(coreTimingEvent);
+	EXPECT_FALSE(CoreTiming::IsScheduled(coreTimingEvent));
+
+	// Events from other threads should all arrive, and only once.
+	const int THREADS = 4;
+	const int PER_THREAD = 10000;
+	coreTimingThreadsafeFired = 0;
+	int threadsafeEvent = CoreTiming::RegisterEvent("UnitTestThreadsafeEvent", &CoreTimingThreadsafeCallback);
+	std::vector<std::thread> threads;
+	for (int t = 0; t < THREADS; ++t) {
+		threads.push_back(std::thread([=] {
+			for (int i = 0; i < PER_THREAD; ++i)
+				CoreTiming::ScheduleEvent_Threadsafe(i, threadsafeEvent, t);
+		}));
+	}
+	for (int i = 0; i < 1000; ++i) {
+		currentMIPS->downcount = 0;
+		CoreTiming::Advance();
+	}
+	for (auto &thread : threads)
+		thread.join();
+	for (int i = 0; i < THREADS * PER_THREAD && coreTimingThreadsafeFired < THREADS * PER_THREAD; ++i) {
+		currentMIPS->downcount = 0;
+		CoreTiming::Advance();
+	}
+	EXPECT_EQ_INT(coreTimingThreadsafeFired, THREADS * PER_THREAD);
+	CoreTiming::Shutdown();
+
+	printf("CoreTiming: scheduled %d events in %0.2f ms, fired %d in %0.2f ms (%0.1f M/s)\n",
+		PENDING, (scheduled - start) * 1000.0, coreTimingFired, (finished - scheduled) * 1000.0,
+		coreTimingFired / (finished - scheduled) / 1000000.0);
+	EXPECT_EQ_INT(coreTimingOutOfOrder, 0);
+
+	return true;
+}
+
+bool TestThreadQueueList() {
+	ThreadQueueList queue;
+	for (u32 prio : { 0x20, 0x11, 0x7F, 0x40 })
+		queue.prepare(prio);
+
+	queue.push_back(0x20, 1);
+	queue.push_back(0x7F, 2);
+	queue.push_back(0x11, 3);
+	queue.push_front(0x11, 4);
+	queue.push_back(0x40, 5);
+	queue.remove(0x40, 5);
+
+	EXPECT_EQ_INT(queue.peek_first(), 4);
+	EXPECT_EQ_INT(queue.pop_first_better(0x11), 0);
+	EXPECT_EQ_INT(queue.pop_first_better(0x12), 4);
+	EXPECT_EQ_INT(queue.pop_first(), 3);
+	EXPECT_EQ_INT(queue.pop_first(), 1);
+	EXPECT_TRUE(queue.empty(0x40));
+	EXPECT_EQ_INT(queue.pop_first_better(0x7F), 0);
+	EXPECT_EQ_INT(queue.pop_first(), 2);
+	EXPECT_EQ_INT(queue.peek_first(), 0);
+
+	// Roughly what a reschedule does: take the best thread, and put the old one back.
+	const int THREADS = 64;
+	const int ITERATIONS = 4000000;
+	for (int i = 0; i < THREADS; ++i) {
+		queue.prepare(0x10 + i % 48);
+		queue.push_back(0x10 + i % 48, i + 1);
+	}
+	double start = time_now_d();
+	SceUID sum = 0;
+	for (int i = 0; i < ITERATIONS; ++i) {
+		SceUID threadID = queue.pop_first();
+		sum += threadID;
+		// Sink it toward the worse priorities, so the scan has to search.
+		queue.push_back(0x10 + (threadID * 7 + i) % 48, threadID);
+	}
+	double elapsed = time_now_d() - start;
+	printf("ThreadQueueList: %0.1f ns per reschedule (%d)\n", elapsed * 1000000000.0 / ITERATIONS, (int)(sum & 1));
+	for (int i = 0; i < THREADS; ++i)
+		EXPECT_TRUE(queue.pop_first() != 0);
+	EXPECT_EQ_INT(queue.peek_first(), 0);
+
+	return true;
+}
+
+bool TestThreadPool() {
+	for (int threads : { 1, 2, 4, 8 }) {
+		ThreadPool pool(threads);
+
+		// Every index exactly once, including from loops nested inside the slices.
+		std::vector<int> counts(1000);
+		std::atomic<int> innerTotal(0);
+		pool.ParallelLoop([&](int lower, int upper) {
+			for (int i = lower; i < upper; ++i)
+				counts[i]++;
+			pool.ParallelLoop([&](int a, int b) {
+				innerTotal += b - a;
+			}, 0, 100);
+		}, 0, (int)counts.size());
+		for (size_t i = 0; i < counts.size(); ++i)
+			EXPECT_EQ_INT(counts[i], 1);
+		EXPECT_TRUE(innerTotal % 100 == 0 && innerTotal > 0);
+
+		// Uneven slices from the grain.
+		std::atomic<int> sliceTotal(0);
+		std::atomic<int> shortSlices(0);
+		pool.ParallelLoop([&](int lower, int upper) {
+			if (upper - lower < 7)
+				shortSlices++;
+			sliceTotal += upper - lower;
+		}, 3, 103, 7);
+		EXPECT_EQ_INT((int)sliceTotal, 100);
+		EXPECT_EQ_INT((int)shortSlices, 0);
+
+		TaskGroup group;
+		std::atomic<int> ran(0);
+		for (int i = 0; i < 50; ++i)
+			pool.Run(group, [&] { ran++; }, (i & 1) ? TaskPriority::HIGH : TaskPriority::NORMAL);
+		pool.Wait(group);
+		EXPECT_TRUE(group.Done());
+		EXPECT_EQ_INT((int)ran, 50);
+	}
+
+	return true;
+}
+
+bool TestChunkCompression() {
+	// Something vaguely like RAM: runs of zeros, repeated patterns, and some noise.
+	const size_t SIZE = 24 * 1024 * 1024 + 1234;
+	std::vector<u8> data(SIZE);
+	u32 seed = 0x1234;
+	for (size_t i = 0; i < SIZE; ++i) {
+		seed = seed * 1103515245 + 12345;
+		if ((i >> 16) % 3 == 0)
+			data[i] = 0;
+		else if ((i >> 16) % 3 == 1)
+			data[i] = (u8)(i & 0x3F);
+		else
+			data[i] = (u8)(seed >> 24);
+	}
+
+	// Split unevenly, so chunks have to be gathered across segments.
+	std::vector<PointerWrap::Segment> segments;
+	segments.push_back({ &data[0], 1000 });
+	segments.push_back({ &data[1000], SIZE / 2 });
+	segments.push_back({ &data[1000 + SIZE / 2], SIZE - 1000 - SIZE / 2 });
+
+	for (int threads : { 1, 2, 4, 8 }) {
+		ThreadPool pool(threads);
+		auto loop = [&](const std::function<void(int, int)> &func, int lower, int upper) {
+			pool.ParallelLoop(func, lower, upper);
+		};
+
+		std::vector<u8> compressed;
+		std::vector<u8> result(SIZE);
+		double start = time_now_d();
+		CChunkFileReader::CompressChunks(segments, &compressed, loop);
+		double compressed_at = time_now_d();
+		EXPECT_TRUE(CChunkFileReader::DecompressChunks(&compressed[0], compressed.size(), &result[0], SIZE, loop));
+		double finished = time_now_d();
+
+		EXPECT_TRUE(memcmp(&result[0], &data[0], SIZE) == 0);
+		printf("ChunkCompression: %d threads, compress %0.1f MB/s, decompress %0.1f MB/s (%d%%)\n", threads,
+			SIZE / (compressed_at - start) / 1048576.0, SIZE / (finished - compressed_at) / 1048576.0,
+			(int)(compressed.size() * 100 / SIZE));
+	}
+
+	// Truncated or mismatched data shouldn't decode.
+	std::vector<u8> compressed;
+	std::vector<u8> result(SIZE);
+	auto serial = [](const std::function<void(int, int)> &func, int lower, int upper) {
+		func(lower, upper);
+	};
+	CChunkFileReader::CompressChunks(segments, &compressed, serial);
+	EXPECT_FALSE(CChunkFileReader::DecompressChunks(&compressed[0], compressed.size() - 1, &result[0], SIZE, serial));
+	EXPECT_FALSE(CChunkFileReader::DecompressChunks(&compressed[0], compressed.size(), &result[0], SIZE / 2, serial));
+
+	return true;
+}
+
+bool TestVagUnpack() {
+	SetupAudioFormats();
+
+	u32 seed = 0x5678;
+	for (int block = 0; block < 1000; ++block) {
+		// Room past the end, so a vector path that over-reads would show up as a mismatch.
+		u8 data[14 + 16];
+		for (int i = 0; i < (int)sizeof(data); ++i) {
+			seed = seed * 1103515245 + 12345;
+			data[i] = (u8)(seed >> 24);
+		}
+
+		for (int shift = 0; shift < 16; ++shift) {
+			s16 expected[28 + 4];
+			s16 actual[28 + 4];
+			memset(expected, 0x55, sizeof(expected));
+			memset(actual, 0x55, sizeof(actual));
+			UnpackVagSamplesStandard(data, shift, expected);
+			UnpackVagSamples(data, shift, actual);
+			EXPECT_TRUE(memcmp(expected, actual, sizeof(expected)) == 0);
+		}
+	}
+
+	return true;
+}
+
+bool TestSasReverb() {
+	const size_t FRAMES = 512;
+	std::vector<int16_t> input(FRAMES * 2);
+	std::vector<int16_t> expected(FRAMES * 4);
+	std::vector<int16_t> actual(FRAMES * 4);
+
+	for (int preset = -1; preset <= PSP_SAS_EFFECT_TYPE_MAX; ++preset) {
+		SasReverb reference;
+		SasReverb reverb;
+		reference.SetPreset(preset);
+		reverb.SetPreset(preset);
+
+		// Enough grains to wrap around the largest presets several times.
+		u32 seed = 0x4321 + preset;
+		for (int grain = 0; grain < 1000; ++grain) {
+			for (size_t i = 0; i < input.size(); ++i) {
+				seed = seed * 1103515245 + 12345;
+				input[i] = (int16_t)(seed >> 16);
+			}
+			reference.ProcessReverbReference(&expected[0], &input[0], FRAMES, 0x8000 - grain, 0x7000 + grain);
+			reverb.ProcessReverb(&actual[0], &input[0], FRAMES, 0x8000 - grain, 0x7000 + grain);
+			EXPECT_TRUE(expected == actual);
+		}
+	}
+
+	return true;
+}
+
+// Residual after fitting a sine at the known frequency, relative to that sine, in dB.
+static double SineDistortionDB(const std::vector<s16> &out, int stride, double step) {
+	double ss = 0.0, sc = 0.0, cc = 0.0, ys = 0.0, yc = 0.0;
+	for (size_t i = 0; i < out.size() / stride; ++i) {
+		double s = sin(step * i);
+		double c = cos(step * i);
+		double y = out[i * stride];
+		ss += s * s;
+		sc += s * c;
+		cc += c * c;
+		ys += y * s;
+		yc += y * c;
+	}
+	double det = ss * cc - sc * sc;
+	double a = (ys * cc - yc * sc) / det;
+	double b = (yc * ss - ys * sc) / det;
+	double signal = 0.0, noise = 0.0;
+	for (size_t i = 0; i < out.size() / stride; ++i) {
+		double fit = a * sin(step * i) + b * cos(step * i);
+		signal += fit * fit;
+		noise += (out[i * stride] - fit) * (out[i * stride] - fit);
+	}
+	return 10.0 * log10(noise / signal);
+}
+
+bool TestPolyphaseResampler() {
+	const int IN_RATE = 44100;
+	const int OUT_RATE = 48000;
+	const int FRAMES = 44100;
+	const int TAPS = PolyphaseFilterBank::TAPS;
+	const u32 ratio = (u32)(65536.0 * IN_RATE / OUT_RATE);
+
+	PolyphaseFilterBank bank;
+	bank.Design(0.455f);
+
+	for (double freq : { 1000.0, 5000.0, 12000.0 }) {
+		// Left gets the tone, right a quieter one an octave down, to catch any channel mixup.
+		std::vector<s16> input((FRAMES + TAPS) * 2);
+		for (int i = 0; i < FRAMES + TAPS; ++i) {
+			input[i * 2 + 0] = (s16)(16000.0 * sin(2.0 * M_PI * freq * i / IN_RATE));
+			input[i * 2 + 1] = (s16)(8000.0 * sin(M_PI * freq * i / IN_RATE));
+		}
+
+		std::vector<s16> linear;
+		std::vector<s16> sinc;
+		double times[2];
+		for (int pass = 0; pass < 2; ++pass) {
+			std::vector<s16> &out = pass == 0 ? linear : sinc;
+			out.reserve((size_t)FRAMES * OUT_RATE / IN_RATE * 2 + 2);
+			double start = time_now_d();
+			u32 frac = 0;
+			for (int pos = TAPS / 2 - 1; pos < FRAMES; ) {
+				s16 frame[2];
+				if (pass == 0) {
+					const s16 *cur = &input[pos * 2];
+					frame[0] = ((cur[0] << 16) + (cur[2] - cur[0]) * (int)frac) >> 16;
+					frame[1] = ((cur[1] << 16) + (cur[3] - cur[1]) * (int)frac) >> 16;
+				} else {
+					bank.Filter(&input[(pos - (TAPS / 2 - 1)) * 2], frac, frame);
+				}
+				out.push_back(frame[0]);
+				out.push_back(frame[1]);
+				frac += ratio;
+				pos += frac >> 16;
+				frac &= 0xFFFF;
+			}
+			times[pass] = time_now_d() - start;
+		}
+
+		// The fixed point ratio is a little off from OUT_RATE, so use the real step.
+		double step = 2.0 * M_PI * freq / IN_RATE * ratio / 65536.0;
+		double linearDB = SineDistortionDB(linear, 2, step);
+		double sincDB = SineDistortionDB(sinc, 2, step);
+		double sincRightDB = SineDistortionDB(std::vector<s16>(sinc.begin() + 1, sinc.end()), 2, step / 2.0);
+		printf("PolyphaseResampler: %0.0f Hz, linear %0.1f dB at %0.2f ns/sample, sinc %0.1f dB (right %0.1f dB) at %0.2f ns/sample\n",
+			freq, linearDB, times[0] * 1e9 / linear.size(), sincDB, sincRightDB, times[1] * 1e9 / sinc.size());
+		EXPECT_TRUE(sincDB < linearDB);
+		EXPECT_TRUE(sincDB < -60.0);
+		EXPECT_TRUE(sincRightDB < -60.0);
+	}
+
+	return true;
+}
+
+bool TestIndexGenerator() {
+	std::vector<u16> buf(4096);
+	u8 inds8[64];
+	u16_le inds16[64];
+	for (int i = 0; i < 64; ++i) {
+		inds8[i] = (u8)((i * 37 + 11) & 0xFF);
+		inds16[i] = (u16)((i * 1237 + 59) & 0xFFFF);
+	}
+
+	// Every length from a lone triangle up, so both the vector body and the tail get covered.
+	for (int n = 3; n <= 64; ++n) {
+		for (int prim : { GE_PRIM_TRIANGLE_STRIP, GE_PRIM_TRIANGLE_FAN }) {
+			IndexGenerator gen;
+			gen.Setup(&buf[0]);
+			// Start with a few points so the base index isn't zero.
+			gen.AddPrim(GE_PRIM_POINTS, 5);
+			gen.AddPrim(prim, n);
+			gen.TranslatePrim(prim, n, inds8, 0);
+			gen.Advance(256);
+			gen.TranslatePrim(prim, n, inds16, 100);
+
+			const u16 *out = &buf[5];
+			for (int pass = 0; pass < 3; ++pass) {
+				int wind = 1;
+				for (int i = 0; i < n - 2; ++i) {
+					int a, b, c;
+					if (prim == GE_PRIM_TRIANGLE_STRIP) {
+						a = i;
+						b = i + wind;
+						wind ^= 3;
+						c = i + wind;
+					} else {
+						a = 0;
+						b = i + 1;
+						c = i + 2;
+					}
+					u16 expected[3];
+					if (pass == 0) {
+						expected[0] = 5 + a;
+						expected[1] = 5 + b;
+						expected[2] = 5 + c;
+					} else if (pass == 1) {
+						expected[0] = 5 + n + inds8[a];
+						expected[1] = 5 + n + inds8[b];
+						expected[2] = 5 + n + inds8[c];
+					} else {
+						expected[0] = (u16)(5 + n + 256 - 100 + inds16[a]);
+						expected[1] = (u16)(5 + n + 256 - 100 + inds16[b]);
+						expected[2] = (u16)(5 + n + 256 - 100 + inds16[c]);
+					}
+					if (out[0] != expected[0] || out[1] != expected[1] || out[2] != expected[2]) {
+						printf("IndexGenerator: prim %d, %d verts, pass %d, tri %d: got %d %d %d, expected %d %d %d\n",
+							prim, n, pass, i, out[0], out[1], out[2], expected[0], expected[1], expected[2]);
+						return false;
+					}
+					out += 3;
+				}
+			}
+			EXPECT_EQ_INT(gen.VertexCount(), 5 + (n - 2) * 9);
+		}
+	}
+
+	return true;
+}
+
+bool TestBlockAllocator() {
+	const u32 START = 0x08800000;
+	const u32 SIZE = 0x01800000;
+	BlockAllocator alloc(256);
+	alloc.Init(START, SIZE);
+
+	u32 size = 0x1000;
+	u32 a = alloc.Alloc(size);
+	EXPECT_EQ_HEX(a, START);
+	size = 0x1000;
+	EXPECT_EQ_HEX(alloc.Alloc(size, true), START + SIZE - 0x1000);
+	size = 0x100;
+	EXPECT_EQ_HEX(alloc.AllocAligned(size, 0x100, 0x10000), START + 0x10000);
+	EXPECT_EQ_HEX(alloc.AllocAt(START + 0x100000, 0x100), START + 0x100000);
+	EXPECT_FALSE(alloc.IsBlockFree(START + 0x100000));
+	EXPECT_EQ_HEX(alloc.GetBlockStartFromAddress(START + 0x100080), START + 0x100000);
+
+	// First fit should prefer the lowest hole that's big enough.
+	EXPECT_TRUE(alloc.Free(a));
+	size = 0x800;
+	EXPECT_EQ_HEX(alloc.Alloc(size), START);
+	size = 0x1000;
+	EXPECT_EQ_HEX(alloc.Alloc(size), START + 0x1000);
+	EXPECT_EQ_HEX(alloc.GetTotalFreeBytes(), SIZE - 0x800 - 0x1000 - 0x1000 - 0x100 - 0x100);
+
+	// Survives a savestate.
+	std::vector<u8> state(CChunkFileReader::MeasurePtr(alloc));
+	EXPECT_TRUE(CChunkFileReader::SavePtr(&state[0], alloc) == CChunkFileReader::ERROR_NONE);
+	BlockAllocator loaded(256);
+	EXPECT_TRUE(CChunkFileReader::LoadPtr(&state[0], loaded) == CChunkFileReader::ERROR_NONE);
+	EXPECT_EQ_HEX(loaded.GetBlockStartFromAddress(START + 0x100080), START + 0x100000);
+	size = 0x1000;
+	EXPECT_EQ_HEX(loaded.Alloc(size), START + 0x2000);
+
+	// Lots of small allocations and frees out of order, like a busy game.
+	const int COUNT = 4096;
+	const int ROUNDS = 50;
+	std::vector<u32> addrs(COUNT);
+	double start = time_now_d();
+	for (int r = 0; r < ROUNDS; ++r) {
+		for (int i = 0; i < COUNT; ++i) {
+			size = 0x40 + ((i * 37 + r) % 64) * 0x20;
+			addrs[i] = alloc.Alloc(size, (i & 3) == 0);
+			EXPECT_TRUE(addrs[i] != (u32)-1);
+		}
+		for (int i = 0; i < COUNT; ++i) {
+			int n = (i * 1031 + r) % COUNT;
+			EXPECT_TRUE(alloc.Free(addrs[n]));
+		}
+	}
+	double elapsed = time_now_d() - start;
+	printf("BlockAllocator: %0.1f ns per alloc/free pair\n", elapsed * 1000000000.0 / (COUNT * ROUNDS));
+	EXPECT_EQ_HEX(alloc.GetTotalFreeBytes(), SIZE - 0x800 - 0x1000 - 0x1000 - 0x100 - 0x100);
+
+	return true;
+}
+
+bool TestBufferSubAllocator() {
+	BufferSubAllocator alloc(0x1000);
+	u32 a, b, c;
+	EXPECT_TRUE(alloc.Alloc(0x100, 16, &a));
+	EXPECT_EQ_HEX(a, 0);
+	EXPECT_TRUE(alloc.Alloc(0x33, 16, &b));
+	EXPECT_EQ_HEX(b, 0x100);
+	EXPECT_TRUE(alloc.Alloc(0x100, 16, &c));
+	EXPECT_EQ_HEX(c, 0x140);
+
+	// Best fit should pick the small hole between a and c.
+	alloc.Free(b, 0x33);
+	u32 d;
+	EXPECT_TRUE(alloc.Alloc(0x20, 16, &d));
+	EXPECT_EQ_HEX(d, 0x100);
+	EXPECT_FALSE(alloc.Alloc(0x1000, 16, &d));
+
+	// Everything freed in any order should merge back into one range.
+	alloc.Free(0x100, 0x20);
+	alloc.Free(c, 0x100);
+	EXPECT_FALSE(alloc.IsEmpty());
+	alloc.Free(a, 0x100);
+	EXPECT_TRUE(alloc.IsEmpty());
+	EXPECT_TRUE(alloc.Alloc(0x1000, 16, &d));
+	EXPECT_EQ_HEX(d, 0);
+	return true;
+}
+
+bool TestGroupHashMap() {
+	GroupHashMap<u32, void *, nullptr> map(16);
+	std::vector<bool> present(4096);
+	u32 seed = 0x13572468;
+	for (int i = 0; i < 100000; ++i) {
+		seed = seed * 1103515245 + 12345;
+		u32 key = (seed >> 8) % (u32)present.size();
+		void *value = (void *)(uintptr_t)(key + 1);
+		switch ((seed >> 4) & 3) {
+		case 0:
+		case 1:
+			if (!present[key]) {
+				EXPECT_TRUE(map.Insert(key, value));
+				present[key] = true;
+			}
+			break;
+		case 2:
+			EXPECT_TRUE(map.Remove(key) == present[key]);
+			present[key] = false;
+			break;
+		default:
+			EXPECT_TRUE(map.Get(key) == (present[key] ? value : nullptr));
+			break;
+		}
+		if ((i & 1023) == 0)
+			map.Maintain();
+	}
+
+	size_t count = 0;
+	for (bool p : present)
+		count += p ? 1 : 0;
+	EXPECT_EQ_INT((int)map.size(), (int)count);
+	size_t iterated = 0;
+	map.Iterate([&](const u32 &key, void *value) {
+		iterated++;
+		EXPECT_TRUE(present[key] && value == (void *)(uintptr_t)(key + 1));
+	});
+	EXPECT_EQ_INT((int)iterated, (int)count);
+
+	map.Clear();
+	EXPECT_EQ_INT((int)map.size(), 0);
+	EXPECT_TRUE(map.Get(1) == nullptr);
+	return true;
+}
+
+static bool HexMatches(const u8 *data, const char *hex) {
+	for (size_t i = 0; hex[i * 2]; ++i) {
+		unsigned int b;
+		if (sscanf(hex + i * 2, "%2x", &b) != 1 || data[i] != b)
+			return false;
+	}
+	return true;
+}
+
+bool TestCrypto() {
+	u8 digest[32];
+	u8 abc[] = { 'a', 'b', 'c' };
+	sha1(abc, 3, digest);
+	EXPECT_TRUE(HexMatches(digest, "a9993e364706816aba3e25717850c26c9cd0d89d"));
+	sha256_context sha256;
+	sha256_starts(&sha256);
+	sha256_update(&sha256, abc, 3);
+	sha256_finish(&sha256, digest);
+	EXPECT_TRUE(HexMatches(digest, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"));
+
+	// The instruction paths (if this CPU has them) have to match the portable code.
+	std::vector<u8> data(4096 + 63);
+	for (size_t i = 0; i < data.size(); ++i)
+		data[i] = (u8)(i * 7 + (i >> 5));
+	const bool hadSHA = cpu_info.bSHA;
+	for (int len = 0; len < (int)data.size(); len += 97) {
+		u8 ref1[20], ref256[32];
+		cpu_info.bSHA = false;
+		sha1(&data[0], len, ref1);
+		sha256_starts(&sha256);
+		sha256_update(&sha256, &data[0], len);
+		sha256_finish(&sha256, ref256);
+		cpu_info.bSHA = hadSHA;
+		sha1(&data[0], len, digest);
+		EXPECT_TRUE(memcmp(digest, ref1, sizeof(ref1)) == 0);
+		sha256_starts(&sha256);
+		sha256_update(&sha256, &data[0], len);
+		sha256_finish(&sha256, digest);
+		EXPECT_TRUE(memcmp(digest, ref256, sizeof(ref256)) == 0);
+	}
+
+	// Standard CRC-32 check value, then the same comparison for the CRC instruction paths.
+	const u8 check[] = { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+	EXPECT_EQ_HEX(crc32_update(0, check, sizeof(check)), 0xCBF43926);
+	const bool hadPCLMUL = cpu_info.bPCLMUL;
+	const bool hadCRC32 = cpu_info.bCRC32;
+	for (int len = 0; len < (int)data.size() - 3; len += 37) {
+		cpu_info.bPCLMUL = false;
+		cpu_info.bCRC32 = false;
+		const u32 ref = crc32_update(0x12345678, &data[len & 3], len);
+		cpu_info.bPCLMUL = hadPCLMUL;
+		cpu_info.bCRC32 = hadCRC32;
+		EXPECT_EQ_HEX(crc32_update(0x12345678, &data[len & 3], len), ref);
+	}
+
+	// AES-128 from FIPS-197, CMAC from RFC 4493.
+	static const u8 fipsKey[16] = { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f };
+	static const u8 fipsPlain[16] = { 0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff };
+	AES_ctx aes;
+	AES_set_key(&aes, fipsKey, 128);
+	u8 block[16];
+	memcpy(block, fipsPlain, 16);
+	AES_cbc_encrypt(&aes, block, block, 16);
+	EXPECT_TRUE(HexMatches(block, "69c4e0d86a7b0430d8cdb78070b4c55a"));
+	AES_cbc_decrypt(&aes, block, block, 16);
+	EXPECT_TRUE(memcmp(block, fipsPlain, 16) == 0);
+
+	std::vector<u8> enc(4096), dec(4096);
+	AES_cbc_encrypt(&aes, &data[0], &enc[0], 4096);
+	AES_cbc_decrypt(&aes, &enc[0], &dec[0], 4096);
+	EXPECT_TRUE(memcmp(&dec[0], &data[0], 4096) == 0);
+
+	static const u8 cmacKey[16] = { 0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c };
+	static const char *cmacMessageHex = "6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e5130c81c46a35ce411e5fbc1191a0a52eff69f2445df4f9b17ad2b417be66c3710";
+	u8 cmacMessage[64];
+	for (int i = 0; i < 64; ++i) {
+		unsigned int b = 0;
+		sscanf(cmacMessageHex + i * 2, "%2x", &b);
+		cmacMessage[i] = (u8)b;
+	}
+	AES_set_key(&aes, cmacKey, 128);
+	AES_CMAC(&aes, cmacMessage, 16, block);
+	EXPECT_TRUE(HexMatches(block, "070a16b46b4d4144f79bdd9dd04a287c"));
+	AES_CMAC(&aes, cmacMessage, 64, block);
+	EXPECT_TRUE(HexMatches(block, "51f0bebf7e3b9d92fc49741779363cfe"));
+	return true;
+}
+
 typedef bool (*TestFunc)();
 struct TestItem {
 	const char *name;
@@ -491,6 +1364,21 @@ TestItem availableTests[] = {
 	TEST_ITEM(MatrixTranspose),
 	TEST_ITEM(ParseLBN),
 	TEST_ITEM(QuickTexHash),
+	TEST_ITEM(TextureDecoding),
+	TEST_ITEM(IRRegAlloc),
+	TEST_ITEM(IRDeadStores),
+	TEST_ITEM(CoreTiming),
+	TEST_ITEM(ThreadQueueList),
+	TEST_ITEM(ThreadPool),
+	TEST_ITEM(ChunkCompression),
+	TEST_ITEM(BlockAllocator),
+	TEST_ITEM(BufferSubAllocator),
+	TEST_ITEM(GroupHashMap),
+	TEST_ITEM(Crypto),
+	TEST_ITEM(VagUnpack),
+	TEST_ITEM(SasReverb),
+	TEST_ITEM(PolyphaseResampler),
+	TEST_ITEM(IndexGenerator),
 };
 
 int main(int argc, const char *argv[]) {
@@ -500,6 +1388,12 @@ int main(int argc, const char *argv[]) {
 	cpu_info.bVFPv4 = true;
 	g_Config.bEnableLogging = true;
 
+	// unitTest bench [filter] [samples]
+	if (argc >= 2 && !strcasecmp(argv[1], "bench")) {
+		RunBenchmarks(argc >= 3 ? argv[2] : nullptr, argc >= 4 ? atoi(argv[3]) : 15);
+		return 0;
+	}
+
 	bool allTests = false;
 	TestFunc testFunc = nullptr;
 	if (argc >= 2) {
@@ -533,6 +1427,7 @@ int main(int argc, const char *argv[]) {
 		}
 	} else if (testFunc == nullptr) {
 		fprintf(stderr, "You may select a test to run by passing an argument.\n");
+		fprintf(stderr, "Pass bench [filter] [samples] to run the benchmarks instead.\n");
 		fprintf(stderr, "\n");
 		fprintf(stderr, "Available tests:\n");
 		for (auto f : availableTests) {